@@ -64,21 +64,21 @@ if [ -f fonts.js ]; then rm fonts.js; fi
 FOUND_FONTS=0
 if [ "$(ls -A ../resources/fonts/*.ttf)" ]; then
   FOUND_FONTS=1
-  python $EMSCRIPTEN/tools/file_packager.py fonts.data --preload ../resources/fonts/ --exclude *DS_Store --js-output=fonts.js
+  python $EMSCRIPTEN/tools/file_packager.py fonts.data --preload ../resources/fonts/ --use-preload-cache --indexedDB-name="/${PROJECT_NAME}_pkg" --exclude *DS_Store --js-output=fonts.js
 fi
 
 #package svgs
 FOUND_SVGS=0
 if [ "$(ls -A ../resources/img/*.svg)" ]; then
   FOUND_SVGS=1
-  python $EMSCRIPTEN/tools/file_packager.py svgs.data --preload ../resources/img/ --exclude *.png --exclude *DS_Store --js-output=svgs.js
+  python $EMSCRIPTEN/tools/file_packager.py svgs.data --preload ../resources/img/ --use-preload-cache --indexedDB-name="/${PROJECT_NAME}_pkg" --exclude *.png --exclude *DS_Store --js-output=svgs.js
 fi
 
 #package @1x pngs
 FOUND_PNGS=0
 if [ "$(ls -A ../resources/img/*.png)" ]; then
   FOUND_PNGS=1
-  python $EMSCRIPTEN/tools/file_packager.py imgs.data --use-preload-plugins --preload ../resources/img/ --use-preload-cache --indexedDB-name="/$PROJECT_NAME_pkg" --exclude *DS_Store --exclude  *@2x.png --exclude  *.svg >> imgs.js
+  python $EMSCRIPTEN/tools/file_packager.py imgs.data --use-preload-plugins --preload ../resources/img/ --use-preload-cache --indexedDB-name="/${PROJECT_NAME}_pkg" --exclude *DS_Store --exclude  *@2x.png --exclude  *.svg >> imgs.js
 fi
 
 # package @2x pngs into separate .data file
@@ -87,7 +87,7 @@ if [ "$(ls -A ../resources/img/*@2x*.png)" ]; then
   FOUND_2XPNGS=1
   mkdir ./2x/
   cp ../resources/img/*@2x* ./2x
-  python $EMSCRIPTEN/tools/file_packager.py imgs@2x.data --use-preload-plugins --preload ./2x@/resources/img/ --use-preload-cache --indexedDB-name="/$PROJECT_NAME_pkg" --exclude *DS_Store >> imgs@2x.js
+  python $EMSCRIPTEN/tools/file_packager.py imgs@2x.data --use-preload-plugins --preload ./2x@/resources/img/ --use-preload-cache --indexedDB-name="/${PROJECT_NAME}_pkg" --exclude *DS_Store >> imgs@2x.js
   rm -r ./2x
 fi
 
@@ -103,20 +103,30 @@ if [ "$WEBSOCKET_MODE" -eq "0" ]; then
     exit 1
   fi
 
+  # the same module with WebAssembly SIMD128, the -awn.js script falls back to the scalar one in browsers without SIMD
+  emmake make --makefile $PROJECT_NAME-wam-processor.mk WAM_SIMD=1 TARGET=../build-web/scripts/$PROJECT_NAME-wam-simd.js
+
+  if [ $? -ne "0" ]; then
+    echo IPlugWAM SIMD WASM compilation failed
+    exit 1
+  fi
+
   cd $PROJECT_ROOT/build-web/scripts
 
-  # prefix the -wam.js script with scope
-  echo "AudioWorkletGlobalScope.WAM = AudioWorkletGlobalScope.WAM || {}; AudioWorkletGlobalScope.WAM.$PROJECT_NAME = { ENVIRONMENT: 'WEB' };" > $PROJECT_NAME-wam.tmp.js;
-  cat $PROJECT_NAME-wam.js >> $PROJECT_NAME-wam.tmp.js
-  mv $PROJECT_NAME-wam.tmp.js $PROJECT_NAME-wam.js
+  # prefix the -wam.js scripts with scope
+  for WAM_SCRIPT in $PROJECT_NAME-wam.js $PROJECT_NAME-wam-simd.js; do
+    echo "AudioWorkletGlobalScope.WAM = AudioWorkletGlobalScope.WAM || {}; AudioWorkletGlobalScope.WAM.$PROJECT_NAME = { ENVIRONMENT: 'WEB' };" > $PROJECT_NAME-wam.tmp.js;
+    cat $WAM_SCRIPT >> $PROJECT_NAME-wam.tmp.js
+    mv $PROJECT_NAME-wam.tmp.js $WAM_SCRIPT
+  done
   
   # copy in WAM SDK and AudioWorklet polyfill scripts
   cp $IPLUG2_ROOT/Dependencies/IPlug/WAM_SDK/wamsdk/*.js .
   cp $IPLUG2_ROOT/Dependencies/IPlug/WAM_AWP/*.js .
 
-  # copy in template scripts
-  cp $IPLUG2_ROOT/IPlug/WEB/Template/scripts/IPlugWAM-awn.js $PROJECT_NAME-awn.js
-  cp $IPLUG2_ROOT/IPlug/WEB/Template/scripts/IPlugWAM-awp.js $PROJECT_NAME-awp.js
+  # copy in template scripts, with the SharedArrayBuffer ring that both of them use
+  cat $IPLUG2_ROOT/IPlug/WEB/Template/scripts/IPlugWAM-ring.js $IPLUG2_ROOT/IPlug/WEB/Template/scripts/IPlugWAM-awn.js > $PROJECT_NAME-awn.js
+  cat $IPLUG2_ROOT/IPlug/WEB/Template/scripts/IPlugWAM-ring.js $IPLUG2_ROOT/IPlug/WEB/Template/scripts/IPlugWAM-awp.js > $PROJECT_NAME-awp.js
 
   # replace NAME_PLACEHOLDER in the template -awn.js and -awp.js scripts
   sed -i.bak s/NAME_PLACEHOLDER/$PROJECT_NAME/g $PROJECT_NAME-awn.js
@@ -139,7 +149,7 @@ sed -i.bak s/NAME_PLACEHOLDER/$PROJECT_NAME/g index.html
 if [ $FOUND_FONTS -eq "0" ]; then sed -i.bak s/'<script async src="fonts.js"><\/script>'/'<!--<script async src="fonts.js"><\/script>-->'/g index.html; fi
 if [ $FOUND_SVGS -eq "0" ]; then sed -i.bak s/'<script async src="svgs.js"><\/script>'/'<!--<script async src="svgs.js"><\/script>-->'/g index.html; fi
 if [ $FOUND_PNGS -eq "0" ]; then sed -i.bak s/'<script async src="imgs.js"><\/script>'/'<!--<script async src="imgs.js"><\/script>-->'/g index.html; fi
-if [ $FOUND_2XPNGS -eq "0" ]; then sed -i.bak s/'<script async src="imgs@2x.js"><\/script>'/'<!--<script async src="imgs@2x.js"><\/script>-->'/g index.html; fi
+if [ $FOUND_2XPNGS -eq "0" ]; then sed -i.bak s/'let HIDPI_IMAGES=true;'/'let HIDPI_IMAGES=false;'/g index.html; fi
 if [ $WEBSOCKET_MODE -eq "1" ]; then
   cp $IPLUG2_ROOT/Dependencies/IPlug/WAM_SDK/wamsdk/wam-controller.js scripts/wam-controller.js
   cp $IPLUG2_ROOT/IPlug/WEB/Template/scripts/websocket.js scripts/websocket.js
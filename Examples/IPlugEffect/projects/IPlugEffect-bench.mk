@@ -0,0 +1,14 @@
+# IPLUG2_ROOT should point to the top level IPLUG2 folder from the project folder
+# By default, that is three directories up from /Examples/IPlugEffect/projects
+# Build with: make -f IPlugEffect-bench.mk, then run ../build-bench/IPlugEffect-bench --help
+IPLUG2_ROOT = ../../..
+
+include ../../../common-bench.mk
+
+SRC += $(PROJECT_ROOT)/IPlugEffect.cpp
+
+TARGET = ../build-bench/IPlugEffect-bench
+
+$(TARGET): $(SRC)
+	mkdir -p $(dir $@)
+	$(CXX) $(CFLAGS) $(EXTRA_CFLAGS) $(LDFLAGS) -o $@ $(SRC)
@@ -47,6 +47,7 @@ void IPlugFaustDSP::ProcessBlock(sample** inputs, sample** outputs, int nFrames)
 void IPlugFaustDSP::OnReset()
 {
   mFaustProcessor.SetSampleRate(GetSampleRate());
+  mFaustProcessor.SetBlockSize(GetBlockSize());
 }
 
 void IPlugFaustDSP::OnParamChange(int paramIdx)
@@ -71,8 +71,9 @@ IPlugReaperExtension::IPlugReaperExtension(reaper_plugin_info_t* pRec)
   };
 }
 
-void IPlugReaperExtension::OnIdle()
+void IPlugReaperExtension::OnProjectStateChanged()
 {
+  // only called when the project changes, rather than querying REAPER on every tick
   int tracks = CountTracks(0);
   
   if(tracks != mPrevTrackCount) {
@@ -15,7 +15,7 @@ class IPlugReaperExtension : public ReaperExtBase
 {
 public:
   IPlugReaperExtension(reaper_plugin_info_t* pRec);
-  void OnIdle() override;
+  void OnProjectStateChanged() override;
   void OnUIClose() override { mGUIToggle = 0; }
   
 private:
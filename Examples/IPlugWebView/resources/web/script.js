@@ -28,8 +28,79 @@ function SSMFD(offset, size, msg) {
   console.log("Got Sysex Message");
 }
 
+// BINARY BRIDGE, used when the delegate calls EnableBinaryBridge(true). Message types match WebViewEditorDelegate::EBinaryMessage
+var binaryOutbox = [];
+var binaryExchangeInFlight = false;
+var binaryExchangeAgain = false;
+
+function IPlugMessagesPending() {
+  IPlugExchangeMessages();
+}
+
+function queueBinaryMessage(type, ints, doubleValue, data) {
+  var size = 1 + ints.length * 4 + (doubleValue !== undefined ? 8 : 0) + (data ? data.byteLength : 0);
+  var msg = new ArrayBuffer(size);
+  var dv = new DataView(msg);
+  var pos = 0;
+  dv.setUint8(pos, type); pos += 1;
+  ints.forEach(function(i) { dv.setInt32(pos, i, true); pos += 4; });
+  if(doubleValue !== undefined) { dv.setFloat64(pos, doubleValue, true); pos += 8; }
+  if(data) new Uint8Array(msg, pos).set(new Uint8Array(data));
+  binaryOutbox.push(new Uint8Array(msg));
+  // send once per frame, however many messages the UI makes
+  if(binaryOutbox.length == 1) requestAnimationFrame(IPlugExchangeMessages);
+}
+
+function IPlugExchangeMessages() {
+  if(binaryExchangeInFlight) {
+    binaryExchangeAgain = true;
+    return;
+  }
+
+  var size = binaryOutbox.reduce(function(total, msg) { return total + msg.byteLength; }, 0);
+  var body = new Uint8Array(size);
+  var pos = 0;
+  binaryOutbox.forEach(function(msg) { body.set(msg, pos); pos += msg.byteLength; });
+  binaryOutbox = [];
+  binaryExchangeInFlight = true;
+
+  fetch("iplug://messages", { method: "POST", body: body }).then(function(response) { return response.arrayBuffer(); }).then(function(buf) {
+    var dv = new DataView(buf);
+    var pos = 0;
+
+    while(pos < buf.byteLength) {
+      var type = dv.getUint8(pos); pos += 1;
+
+      if(type == 0) { var paramIdx = dv.getInt32(pos, true); SPVFD(paramIdx, dv.getFloat64(pos + 4, true)); pos += 12; }
+      else if(type == 1) { var ctrlTag = dv.getInt32(pos, true); SCVFD(ctrlTag, dv.getFloat64(pos + 4, true)); pos += 12; }
+      else if(type == 2) {
+        var ctrlTag = dv.getInt32(pos, true), msgTag = dv.getInt32(pos + 4, true), dataSize = dv.getInt32(pos + 8, true); pos += 12;
+        SCMFD(ctrlTag, msgTag, dataSize, new Uint8Array(buf, pos, dataSize)); pos += dataSize;
+      }
+      else if(type == 3) {
+        var msgTag = dv.getInt32(pos, true), dataSize = dv.getInt32(pos + 8, true); pos += 12;
+        SAMFD(msgTag, dataSize, new Uint8Array(buf, pos, dataSize)); pos += dataSize;
+      }
+      else break;
+    }
+  }).finally(function() {
+    binaryExchangeInFlight = false;
+    if(binaryExchangeAgain || binaryOutbox.length) {
+      binaryExchangeAgain = false;
+      IPlugExchangeMessages();
+    }
+  });
+}
+
+// collect anything that was queued while the page was loading
+if(typeof IPLUG_BINARY_BRIDGE !== "undefined")
+  window.addEventListener("load", IPlugExchangeMessages);
+
 // FROM UI
 function SAMFUI(msgTag, ctrlTag = -1, dataSize = 0, data = 0) {
+  if(typeof IPLUG_BINARY_BRIDGE !== "undefined")
+    return queueBinaryMessage(3, [msgTag, ctrlTag, dataSize], undefined, dataSize ? data : null);
+
   var message = {
     "msg": "SAMFUI",
     "msgTag": msgTag,
@@ -63,6 +134,9 @@ function SSMFUI(dataSize = 0, data = 0) {
 }
 
 function EPCFUI(paramIdx) {
+  if(typeof IPLUG_BINARY_BRIDGE !== "undefined")
+    return queueBinaryMessage(5, [paramIdx]);
+
   var message = {
     "msg": "EPCFUI",
     "paramIdx": paramIdx,
@@ -72,6 +146,9 @@ function EPCFUI(paramIdx) {
 }
 
 function BPCFUI(paramIdx) {
+  if(typeof IPLUG_BINARY_BRIDGE !== "undefined")
+    return queueBinaryMessage(4, [paramIdx]);
+
   var message = {
     "msg": "BPCFUI",
     "paramIdx": paramIdx,
@@ -81,6 +158,9 @@ function BPCFUI(paramIdx) {
 }
 
 function SPVFUI(paramIdx, value) {
+  if(typeof IPLUG_BINARY_BRIDGE !== "undefined")
+    return queueBinaryMessage(0, [paramIdx], value);
+
   var message = {
     "msg": "SPVFUI",
     "paramIdx": paramIdx,
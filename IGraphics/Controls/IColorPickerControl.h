@@ -42,46 +42,28 @@ public:
     float w = mRECT.W();
     float h = mRECT.H();
 
-    int i;
-    float r0, r1, ax,ay, bx,by, cx,cy, aeps, r;
+    float r0, r1, ax,ay, bx,by, cx,cy, r;
     float hue = 0.;
     NVGpaint paint;
 
-    nvgSave(vg);
-
-    /*  nvgBeginPath(vg);
-     nvgRect(vg, x,y,w,h);
-     nvgFillColor(vg, nvgRGBA(255,0,0,128));
-     nvgFill(vg);*/
-
     cx = x + w*0.5f;
     cy = y + h*0.5f;
     r1 = (w < h ? w : h) * 0.5f - 5.0f;
     r0 = r1 - 20.0f;
-    aeps = 0.5f / r1;  // half a pixel arc length in radians (2pi cancels out).
 
-    for (i = 0; i < 6; i++) {
-      float a0 = (float)i / 6.0f * NVG_PI * 2.0f - aeps;
-      float a1 = (float)(i+1.0f) / 6.0f * NVG_PI * 2.0f + aeps;
-      nvgBeginPath(vg);
-      nvgArc(vg, cx,cy, r0, a0, a1, NVG_CW);
-      nvgArc(vg, cx,cy, r1, a1, a0, NVG_CCW);
-      nvgClosePath(vg);
-      ax = cx + cosf(a0) * (r0+r1)*0.5f;
-      ay = cy + sinf(a0) * (r0+r1)*0.5f;
-      bx = cx + cosf(a1) * (r0+r1)*0.5f;
-      by = cy + sinf(a1) * (r0+r1)*0.5f;
-      paint = nvgLinearGradient(vg, ax,ay, bx,by, nvgHSLA(a0/(NVG_PI*2),1.0f,0.55f,255), nvgHSLA(a1/(NVG_PI*2),1.0f,0.55f,255));
-      nvgFillPaint(vg, paint);
-      nvgFill(vg);
+    // the hue ring only changes with the size and scale, so it is drawn into a layer once rather than on every redraw.
+    // starting a layer begins a new NanoVG frame, so this comes before saving the NanoVG state
+    if (!g.CheckLayer(mFieldLayer) || mFieldBounds != mRECT)
+    {
+      g.StartLayer(mRECT);
+      DrawHueRing(vg, cx, cy, r0, r1);
+      mFieldLayer = g.EndLayer();
+      mFieldBounds = mRECT;
     }
 
-    nvgBeginPath(vg);
-    nvgCircle(vg, cx,cy, r0-0.5f);
-    nvgCircle(vg, cx,cy, r1+0.5f);
-    nvgStrokeColor(vg, nvgRGBA(0,0,0,64));
-    nvgStrokeWidth(vg, 1.0f);
-    nvgStroke(vg);
+    g.DrawLayer(mFieldLayer);
+
+    nvgSave(vg);
 
     // Selector
     nvgSave(vg);
@@ -150,6 +132,44 @@ public:
   {
   }
 private:
+#ifdef IGRAPHICS_NANOVG
+  void DrawHueRing(NVGcontext* vg, float cx, float cy, float r0, float r1)
+  {
+    float ax,ay, bx,by;
+    const float aeps = 0.5f / r1;  // half a pixel arc length in radians (2pi cancels out).
+    NVGpaint paint;
+
+    nvgSave(vg);
+
+    for (int i = 0; i < 6; i++) {
+      float a0 = (float)i / 6.0f * NVG_PI * 2.0f - aeps;
+      float a1 = (float)(i+1.0f) / 6.0f * NVG_PI * 2.0f + aeps;
+      nvgBeginPath(vg);
+      nvgArc(vg, cx,cy, r0, a0, a1, NVG_CW);
+      nvgArc(vg, cx,cy, r1, a1, a0, NVG_CCW);
+      nvgClosePath(vg);
+      ax = cx + cosf(a0) * (r0+r1)*0.5f;
+      ay = cy + sinf(a0) * (r0+r1)*0.5f;
+      bx = cx + cosf(a1) * (r0+r1)*0.5f;
+      by = cy + sinf(a1) * (r0+r1)*0.5f;
+      paint = nvgLinearGradient(vg, ax,ay, bx,by, nvgHSLA(a0/(NVG_PI*2),1.0f,0.55f,255), nvgHSLA(a1/(NVG_PI*2),1.0f,0.55f,255));
+      nvgFillPaint(vg, paint);
+      nvgFill(vg);
+    }
+
+    nvgBeginPath(vg);
+    nvgCircle(vg, cx,cy, r0-0.5f);
+    nvgCircle(vg, cx,cy, r1+0.5f);
+    nvgStrokeColor(vg, nvgRGBA(0,0,0,64));
+    nvgStrokeWidth(vg, 1.0f);
+    nvgStroke(vg);
+
+    nvgRestore(vg);
+  }
+#endif
+
+  ILayerPtr mFieldLayer;
+  IRECT mFieldBounds;
 };
 
 END_IGRAPHICS_NAMESPACE
@@ -565,9 +565,8 @@ IVKnobControl::IVKnobControl(const IRECT& bounds, IActionFunction actionFunc, co
 
 void IVKnobControl::Draw(IGraphics& g)
 {
-  DrawBackGround(g, mRECT);
+  DrawStaticLayer(g);
   DrawWidget(g);
-  DrawLabel(g);
   DrawValue(g, mValueMouseOver);
 }
 
@@ -1018,9 +1017,8 @@ IVPlotControl::IVPlotControl(const IRECT& bounds, const std::initializer_list<Pl
 , mMin(min)
 , mMax(max)
 , mUseLayer(useLayer)
+, mNumPoints(numPoints)
 {
-  mPoints.resize(numPoints);
-
   AttachIControl(this, label);
   
   for(auto plot : plots)
@@ -1033,20 +1031,18 @@ void IVPlotControl::Draw(IGraphics& g)
 {
   DrawBackGround(g, mRECT);
   DrawLabel(g);
+  UpdateSamples(g);
   
   auto drawFunc = [&](){
     g.DrawGrid(GetColor(kSH), mWidgetBounds, 8.f, 8.f);
         
     for (int p=0; p<mPlots.size(); p++)
     {
-      for (int i=0; i< mPoints.size(); i++)
-      {
-        auto v = mPlots[p].func(((float)i/(mPoints.size() -1.f)));
-        v = (v - mMin) / (mMax-mMin);
-        mPoints[i] = v;
-      }
+      std::vector<float>& samples = mSamples[p];
       
-      g.DrawData(mPlots[p].color, mWidgetBounds, mPoints.data(), (int) mPoints.size(), nullptr, nullptr, mStyle.frameThickness);
+      // a plot sampling in the background for the first time has nothing to draw yet
+      if (samples.size() > 1)
+        g.DrawData(mPlots[p].color, mWidgetBounds, samples.data(), (int) samples.size(), nullptr, nullptr, mStyle.frameThickness);
     }
   };
   
@@ -1068,18 +1064,153 @@ void IVPlotControl::Draw(IGraphics& g)
 void IVPlotControl::OnResize()
 {
   SetTargetRECT(MakeRects(mRECT));
+  
+  if(mLayer)
+    mLayer->Invalidate();
   SetDirty(false);
 }
 
 void IVPlotControl::AddPlotFunc(const IColor& color, const IPlotFunc& func)
 {
   mPlots.push_back({color, func});
+  mSamples.emplace_back();
+  mSamplesValid.push_back(false);
+  mSampleGenerations.push_back(0);
+  
+  if(mLayer)
+    mLayer->Invalidate();
+  SetDirty(false);
+}
+
+void IVPlotControl::InvalidatePlot(int plotIdx)
+{
+  for (int p = 0; p < mPlots.size(); p++)
+  {
+    if (plotIdx < 0 || p == plotIdx)
+    {
+      mSamplesValid[p] = false;
+      mSampleGenerations[p]++;
+    }
+  }
   
   if(mLayer)
     mLayer->Invalidate();
   SetDirty(false);
 }
 
+int IVPlotControl::GetNumPoints() const
+{
+  if (mNumPoints > 0)
+    return std::max(mNumPoints, 2);
+  
+  return std::max(static_cast<int>(std::ceil(mWidgetBounds.W())), 2);
+}
+
+void IVPlotControl::SamplePlot(const IPlotFunc& func, float min, float max, int numPoints, std::vector<float>& samples)
+{
+  samples.resize(numPoints);
+  
+  for (int i=0; i<numPoints; i++)
+  {
+    auto v = func(((float)i/(numPoints -1.f)));
+    v = (v - min) / (max-min);
+    samples[i] = static_cast<float>(v);
+  }
+}
+
+void IVPlotControl::UpdateSamples(IGraphics& g)
+{
+  const int numPoints = GetNumPoints();
+  
+  if (numPoints != mNumPointsSampled)
+  {
+    mNumPointsSampled = numPoints;
+    
+    for (int p = 0; p < mPlots.size(); p++)
+    {
+      mSamplesValid[p] = false;
+      mSampleGenerations[p]++;
+    }
+    
+    if(mLayer)
+      mLayer->Invalidate();
+  }
+  
+  if (!mSampleInBackground)
+  {
+    for (int p = 0; p < mPlots.size(); p++)
+    {
+      if (!mSamplesValid[p])
+      {
+        SamplePlot(mPlots[p].func, mMin, mMax, numPoints, mSamples[p]);
+        mSamplesValid[p] = true;
+      }
+    }
+    
+    return;
+  }
+  
+  // one job at a time, plots invalidated while it runs are sampled by the next
+  if (mSampling)
+    return;
+  
+  struct Job
+  {
+    std::vector<int> plots;
+    std::vector<int> generations;
+    std::vector<IPlotFunc> funcs;
+    std::vector<std::vector<float>> samples;
+  };
+  
+  auto pJob = std::make_shared<Job>();
+  
+  for (int p = 0; p < mPlots.size(); p++)
+  {
+    if (!mSamplesValid[p])
+    {
+      pJob->plots.push_back(p);
+      pJob->generations.push_back(mSampleGenerations[p]);
+      pJob->funcs.push_back(mPlots[p].func);
+    }
+  }
+  
+  if (pJob->plots.empty())
+    return;
+  
+  pJob->samples.resize(pJob->plots.size());
+  mSampling = true;
+  
+  const float min = mMin;
+  const float max = mMax;
+  std::weak_ptr<bool> alive = mAlive;
+  
+  g.RunInBackground([pJob, min, max, numPoints]() {
+    for (size_t i = 0; i < pJob->funcs.size(); i++)
+      SamplePlot(pJob->funcs[i], min, max, numPoints, pJob->samples[i]);
+  },
+  [this, pJob, alive]() {
+    if (alive.expired())
+      return;
+    
+    mSampling = false;
+    
+    for (size_t i = 0; i < pJob->plots.size(); i++)
+    {
+      const int p = pJob->plots[i];
+      
+      if (mSampleGenerations[p] == pJob->generations[i])
+      {
+        mSamples[p].swap(pJob->samples[i]);
+        mSamplesValid[p] = true;
+      }
+    }
+    
+    if(mLayer)
+      mLayer->Invalidate();
+    SetDirty(false);
+  });
+}
+
 #pragma mark - BITMAP CONTROLS
 
 void IBSwitchControl::OnMouseDown(float x, float y, const IMouseMod& mod)
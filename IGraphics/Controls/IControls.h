@@ -21,9 +21,12 @@
 #include "IVKeyboardControl.h"
 #include "IVMeterControl.h"
 #include "IVScopeControl.h"
+#include "IVSpectrumAnalyzerControl.h"
 #include "IVMultiSliderControl.h"
 #include "IRTTextControl.h"
 #include "IVDisplayControl.h"
+#include "IShaderControl.h"
+#include "IVWaveformControl.h"
 
 BEGIN_IPLUG_NAMESPACE
 BEGIN_IGRAPHICS_NAMESPACE
@@ -320,7 +323,8 @@ protected:
   bool mMouseDown = false;
 };
 
-/** a vector plot to display functions and waveforms **/
+/** a vector plot to display functions and waveforms. The functions are sampled once and the samples are cached, so call InvalidatePlot() when
+ * something a function depends on changes, such as a filter's parameters **/
 class IVPlotControl : public IControl
                     , public IVectorBase
 {
@@ -341,7 +345,7 @@ public:
     /** Constructs a vector plot
      * @param bounds The control's bounds
      * @param funcs A function list reference containing the functions to display
-     * @param numPoints The number of points used to draw the functions
+     * @param numPoints The number of points used to draw the functions, or 0 for one per point of the plot's width, which resamples when it resizes
      * @param label The label for the vector control, leave empty for no label
      * @param style The styling of this vector control \see IVStyle
      * @param shape The buttons shape \see IVShape
@@ -355,13 +359,38 @@ public:
      * @param color The function color
      * @param func A reference object containing the function implementation to display*/
   void AddPlotFunc(const IColor& color, const IPlotFunc& func);
+
+  /** Resample a plot before it is next drawn, e.g. after a parameter that its function depends on changes
+   * @param plotIdx The index of the plot, or -1 for all of them */
+  void InvalidatePlot(int plotIdx = -1);
+
+  /** Sample the functions on a background thread rather than in Draw(), for plots that are expensive to calculate. The functions must then be safe to call
+   * from another thread, e.g. by reading copies of the values they depend on. Until new samples arrive the previous ones are drawn
+   * @param enable \c true to sample in the background, see IGraphics::RunInBackground() */
+  void SetSampleInBackground(bool enable) { mSampleInBackground = enable; }
+
 protected:
+  /** @return The number of points each plot is sampled at */
+  int GetNumPoints() const;
+
+  /** Sample the plots that are invalid, or start doing so in the background */
+  void UpdateSamples(IGraphics& g);
+
+  static void SamplePlot(const IPlotFunc& func, float min, float max, int numPoints, std::vector<float>& samples);
+
   ILayerPtr mLayer;
   std::vector<Plot> mPlots;
   float mMin;
   float mMax;
   bool mUseLayer = true;
-  std::vector<float> mPoints;
+  int mNumPoints;
+  int mNumPointsSampled = 0;
+  std::vector<std::vector<float>> mSamples; // per plot, the function's values mapped to the range 0-1
+  std::vector<bool> mSamplesValid;
+  std::vector<int> mSampleGenerations; // bumped when a plot is invalidated, so that samples computed before then are discarded
+  bool mSampleInBackground = false;
+  bool mSampling = false;
+  std::shared_ptr<bool> mAlive = std::make_shared<bool>(true); // lets a background job tell whether the control still exists when it finishes
 };
 
 #pragma mark - SVG Vector Controls
@@ -378,14 +407,8 @@ public:
   
   void Draw(IGraphics& g) override
   {
-    if (!g.CheckLayer(mLayer))
-    {
-      g.StartLayer(mRECT);
-      g.DrawSVG(mSVG, mRECT);
-      mLayer = g.EndLayer();
-    }
-    
-    g.DrawRotatedLayer(mLayer, mStartAngle + GetValue() * (mEndAngle - mStartAngle));
+    // knobs that share an SVG and a size share one raster, which is rotated rather than refilled
+    g.DrawRotatedSVGCached(mSVG, mRECT.MW(), mRECT.MH(), mRECT.W(), mRECT.H(), mStartAngle + GetValue() * (mEndAngle - mStartAngle));
   }
   
   void SetSVG(ISVG& svg)
@@ -395,7 +418,6 @@ public:
   }
   
 private:
-  ILayerPtr mLayer;
   ISVG mSVG;
   float mStartAngle = -135.f;
   float mEndAngle = 135.f;
@@ -44,6 +44,7 @@ public:
   , mNameLabel(label)
   {
     AttachIControl(this, label);
+    SetPollDirty(true);
 
     SetColor(kBG, COLOR_WHITE);
 
@@ -223,6 +223,10 @@ void IPopupMenuControl::OnMouseOver(float x, float y, const IMouseMod& mod)
       else if (mMouseCellBounds == mActiveMenuPanel->mCellBounds.Get((mActiveMenuPanel->mCellBounds.GetSize()-1)))
       {
         mActiveMenuPanel->ScrollDown();
+        
+        // items that scroll into view may have widened the panel
+        SetTargetRECT(mTargetRECT.Union(mActiveMenuPanel->mTargetRECT));
+        SetRECT(mRECT.Union(mActiveMenuPanel->mRECT));
       }
     }
   
@@ -383,11 +387,14 @@ void IPopupMenuControl::CreatePopupMenu(IPopupMenu& menu, const IRECT& bounds)
     Expand(bounds);
 }
 
-IRECT IPopupMenuControl::GetLargestCellRectForMenu(IPopupMenu& menu, float x, float y) const
+IRECT IPopupMenuControl::GetLargestCellRectForMenu(IPopupMenu& menu, float x, float y, int startIdx, int endIdx) const
 {
   IRECT span;
   
-  for (auto i = 0; i < menu.NItems(); ++i)
+  if (endIdx < 0 || endIdx > menu.NItems())
+    endIdx = menu.NItems();
+  
+  for (auto i = startIdx; i < endIdx; ++i)
   {
     IPopupMenu::Item* pItem = menu.GetItem(i);
     IRECT textBounds;
@@ -404,12 +411,28 @@ IRECT IPopupMenuControl::GetLargestCellRectForMenu(IPopupMenu& menu, float x, fl
   return IRECT(x, y, x + span.W(), y + span.H());
 }
 
+int IPopupMenuControl::GetNumItemsToMeasure(IPopupMenu& menu) const
+{
+  // menus that don't scroll show every item, in columns if need be
+  if (!mScrollIfTooBig || mMaxColumnItems > 0 || !menu.NItems())
+    return menu.NItems();
+  
+  const IRECT cell = GetLargestCellRectForMenu(menu, 0.f, 0.f, 0, 1);
+  const int maxRows = static_cast<int>(mMaxBounds.H() / (cell.H() + mCellGap)) + 1;
+  
+  return std::min(menu.NItems(), maxRows);
+}
+
 void IPopupMenuControl::CalculateMenuPanels(float x, float y)
 {
   for(auto i = 0; i < mActiveMenuPanel->mCellBounds.GetSize(); i++)
   {
     IRECT* pCellRect = mActiveMenuPanel->mCellBounds.Get(i);
-    IPopupMenu::Item* pMenuItem = mActiveMenuPanel->mMenu.GetItem(i);
+    IPopupMenu::Item* pMenuItem = mActiveMenuPanel->mMenu.GetItem(mActiveMenuPanel->mScrollItemOffset + i);
+    
+    if(!pMenuItem)
+      break;
+    
     IPopupMenu* pSubMenu = pMenuItem->GetSubmenu();
     
     if(pCellRect == mMouseCellBounds)
@@ -622,10 +645,12 @@ void IPopupMenuControl::OnEndAnimation()
 }
 
 IPopupMenuControl::MenuPanel::MenuPanel(IPopupMenuControl& control, IPopupMenu& menu, float x, float y, int parentIdx)
-: mMenu(menu)
+: mControl(control)
+, mMenu(menu)
 , mParentIdx(parentIdx)
 {
-  mSingleCellBounds = control.GetLargestCellRectForMenu(menu, x, y);
+  mNMeasuredItems = control.GetNumItemsToMeasure(menu);
+  mSingleCellBounds = control.GetLargestCellRectForMenu(menu, x, y, 0, mNMeasuredItems);
   
   float left = x + control.PAD;
   float top = y + control.PAD;
@@ -711,6 +736,13 @@ IPopupMenuControl::MenuPanel::MenuPanel(IPopupMenuControl& control, IPopupMenu&
     top = bottom + control.mCellGap;
   }
   
+  UpdateBounds();
+  MeasureVisibleItems();
+}
+
+void IPopupMenuControl::MenuPanel::UpdateBounds()
+{
+  IPopupMenuControl& control = mControl;
   IRECT span;
   
   if(mCellBounds.GetSize())
@@ -775,6 +807,34 @@ IPopupMenuControl::MenuPanel::MenuPanel(IPopupMenuControl& control, IPopupMenu&
   }
 }
 
+void IPopupMenuControl::MenuPanel::MeasureVisibleItems()
+{
+  const int visibleEnd = std::min(mMenu.NItems(), mScrollItemOffset + mCellBounds.GetSize());
+  
+  if(visibleEnd <= mNMeasuredItems)
+    return;
+  
+  const float width = mControl.GetLargestCellRectForMenu(mMenu, 0.f, 0.f, mNMeasuredItems, visibleEnd).W();
+  mNMeasuredItems = visibleEnd;
+  
+  if(width <= CellWidth())
+    return;
+  
+  mSingleCellBounds.R = mSingleCellBounds.L + width;
+  
+  for(auto i = 0; i < mCellBounds.GetSize(); i++)
+  {
+    IRECT* pR = mCellBounds.Get(i);
+    pR->R = pR->L + width;
+  }
+  
+  UpdateBounds();
+  
+#ifndef IGRAPHICS_NANOVG
+  mShadowLayer = nullptr;
+#endif
+}
+
 IPopupMenuControl::MenuPanel::~MenuPanel()
 {
   mCellBounds.Empty(true);
@@ -785,7 +845,8 @@ IRECT* IPopupMenuControl::MenuPanel::HitTestCells(float x, float y) const
   for(auto i = 0; i < mCellBounds.GetSize(); i++)
   {
     IRECT* pR = mCellBounds.Get(i);
-    if(pR->Contains(x, y) && mMenu.GetItem(i)->GetEnabled())
+    const IPopupMenu::Item* pItem = mMenu.GetItem(mScrollItemOffset + i);
+    if(pR->Contains(x, y) && pItem && pItem->GetEnabled())
       return pR;
   }
   return nullptr;
@@ -118,8 +118,14 @@ public:
   void SetMaxBounds(const IRECT& bounds) { mMaxBounds = bounds; }
 
 private:
-  /** Get an IRECT represents the maximum dimensions of the longest text item in the menu */
-  IRECT GetLargestCellRectForMenu(IPopupMenu& menu, float x, float y) const;
+  /** Get an IRECT represents the maximum dimensions of the longest text item in a range of the menu's items
+   * @param startIdx The index of the first item to measure
+   * @param endIdx The index after the last item to measure, or -1 for the end of the menu */
+  IRECT GetLargestCellRectForMenu(IPopupMenu& menu, float x, float y, int startIdx = 0, int endIdx = -1) const;
+
+  /** @return How many of a menu's first items a new MenuPanel measures. A scrolling panel can only show as many as fit in the max bounds,
+   * so the rest are measured as they scroll into view, which lets a menu of thousands of items open as quickly as a short one */
+  int GetNumItemsToMeasure(IPopupMenu& menu) const;
 
   /** This method is called to expand the modal pop-up menu. It calculates the dimensions and wrapping, to keep the cells within the graphics context. It handles the dirtying of the graphics context, and modification of graphics behaviours such as tooltips and mouse cursor */
   void Expand(const IRECT& bounds);
@@ -147,7 +153,13 @@ private:
 
     void ScrollUp() { mScrollItemOffset--; mScrollItemOffset = Clip(mScrollItemOffset, 0, mCellBounds.GetSize()-1); }
 
-    void ScrollDown() { mScrollItemOffset++; mScrollItemOffset = Clip(mScrollItemOffset, 0, mMenu.NItems()-mCellBounds.GetSize()); }
+    void ScrollDown() { mScrollItemOffset++; mScrollItemOffset = Clip(mScrollItemOffset, 0, mMenu.NItems()-mCellBounds.GetSize()); MeasureVisibleItems(); }
+
+    /** Measure the items that have come into view since the panel was laid out, and widen the cells if any of them are too long */
+    void MeasureVisibleItems();
+
+    /** Calculate the panel's bounds from its cells, moving them left if they go off the right of the max bounds */
+    void UpdateBounds();
 
     /** Checks if any of the expanded cells for this panel contain a x, y coordinate, and if so returns an IRECT pointer to the cell bounds
      * @param x X position to test
@@ -156,6 +168,7 @@ private:
     IRECT* HitTestCells(float x, float y) const;
 
    public:
+    IPopupMenuControl& mControl;
     IPopupMenu& mMenu; // The IPopupMenu that this MenuPanel is displaying
     WDL_PtrList<IRECT> mCellBounds; // The size of this array will always correspond to the number of items in the top level of the menu
 
@@ -171,6 +184,7 @@ private:
     int mParentIdx = 0; // An index into the IPopupMenuControl::mMenuPanels lists, representing the parent menu panel
     bool mScroller = false;
     int mScrollItemOffset = 0;
+    int mNMeasuredItems = 0; // The menu's first items, which are the ones measured for mSingleCellBounds
       
 #ifndef IGRAPHICS_NANOVG
     ILayerPtr mShadowLayer;
@@ -18,7 +18,7 @@
 
 #include "IControl.h"
 #include "IPlugStructs.h"
-#include "IPlugQueue.h"
+#include "ISender.h"
 
 BEGIN_IPLUG_NAMESPACE
 BEGIN_IGRAPHICS_NAMESPACE
@@ -30,35 +30,21 @@ class IRTTextControl : public ITextControl
 public:
   static constexpr int kUpdateMessage = 0;
   
+  /** Only the latest value is displayed, so values are passed through an ISender rather than a queue. QUEUE_SIZE is no longer used */
   template <int QUEUE_SIZE = 64>
-  class Sender
+  class Sender : public ISender<T>
   {
   public:
     Sender(int controlTag)
-    : mControlTag(controlTag)
+    : ISender<T>(controlTag, kUpdateMessage)
     {
     }
     
     // this can be called on RT thread
     void SetValRT(T val)
     {
-      mQueue.Push(val);
+      ISender<T>::PushData(val);
     }
-    
-    // this must be called on the main thread - typically in MyPlugin::OnIdle()
-    void TransmitData(IEditorDelegate& dlg)
-    {
-      while(mQueue.ElementsAvailable())
-      {
-        T d;
-        mQueue.Pop(d);
-        dlg.SendControlMsgFromDelegate(mControlTag, kUpdateMessage, sizeof(T), (void*) &d);
-      }
-    }
-    
-  private:
-    int mControlTag;
-    IPlugQueue<T> mQueue {QUEUE_SIZE};
   };
   
   IRTTextControl(const IRECT& bounds, const char* fmtStr = "%f", const char* initStr = "", const IText& text = DEFAULT_TEXT, const IColor& BGColor = DEFAULT_BGCOLOR)
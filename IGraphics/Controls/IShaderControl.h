@@ -0,0 +1,153 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @ingroup Controls
+ * @copydoc IShaderControl
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "IControl.h"
+#include "IGraphicsShader.h"
+#include "IPlugQueue.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** A control that draws an IShader into its bounds, for visualizations that are too dense to draw with paths, such as spectrograms,
+ * waterfalls or wavetable views. On the OpenGL NanoVG backends the shader runs on the GPU, elsewhere its CPUFunc is drawn.
+ * The Sender queues rows of values on the audio thread for the shader's data textures. Each row either replaces a row of a texture, or
+ * scrolls the texture up and is added at the bottom, so a texture holds the last rows over time. Set the size of the textures with
+ * GetShader().ResizeTexture() before rows arrive
+ * @code
+ * // a spectrogram of 256 bins over the last 128 spectra, with time going up
+ * auto* pControl = new IShaderControl<>(bounds, "vec4 shade(vec2 uv) { float v = texture2D(tex0, uv).r; return vec4(v, v, v, 1.0); }");
+ * pControl->GetShader().ResizeTexture(0, 256, 128);
+ * // in ProcessBlock(), for each new spectrum of 256 values from 0. to 1.
+ * mSender.PushRow(0, spectrum, 256);
+ * // in OnIdle()
+ * mSender.TransmitData(*this);
+ * @endcode
+ * @tparam MAXROW The most values in a row
+ * @tparam QUEUE_SIZE The number of rows the Sender can hold between calls to TransmitData()
+ * @ingroup IControls */
+template <int MAXROW = 512, int QUEUE_SIZE = 64>
+class IShaderControl : public IControl
+{
+public:
+  static constexpr int kUpdateMessage = 0;
+
+  /** The row of a Data packet that scrolls its texture */
+  static constexpr int kScrollRow = -1;
+
+  /** A row of values for one of the shader's textures, only the first nVals of which are used */
+  struct Data
+  {
+    int texture = 0;
+    int row = kScrollRow;
+    int nVals = 0;
+    float vals[MAXROW];
+  };
+
+  /** Used on the DSP side to queue rows of values for the control. Rows that don't fit in the queue are dropped */
+  class Sender
+  {
+  public:
+    Sender(int controlTag)
+    : mControlTag(controlTag)
+    , mQueue(QUEUE_SIZE)
+    {
+    }
+
+    /** Queue a row. Realtime safe
+     * @param texture The texture, < IShader::kMaxTextures
+     * @param vals The values, from 0. to 1.
+     * @param nVals The number of values, up to MAXROW. The rest of the texture's row is set to 0.
+     * @param row The row to replace, from 0 at the top, or kScrollRow to scroll the texture and add the row at the bottom */
+    void PushRow(int texture, const float* vals, int nVals, int row = kScrollRow)
+    {
+      mPushBuf.texture = texture;
+      mPushBuf.row = row;
+      mPushBuf.nVals = std::min(std::max(nVals, 0), MAXROW);
+      std::copy(vals, vals + mPushBuf.nVals, mPushBuf.vals);
+      mQueue.Push(mPushBuf);
+    }
+
+    /** Sends the queued rows via IEditorDelegate, in the order they were pushed. This must be called on the main thread - typically in MyPlugin::OnIdle() */
+    void TransmitData(IEditorDelegate& dlg)
+    {
+      while (mQueue.Pop(mTransmitBuf))
+        dlg.SendControlMsgFromDelegate(mControlTag, kUpdateMessage, sizeof(Data), (void*) &mTransmitBuf);
+    }
+
+  private:
+    int mControlTag;
+    IPlugQueue<Data> mQueue;
+    Data mPushBuf; // audio thread only
+    Data mTransmitBuf; // main thread only
+  };
+
+  /** Constructs an IShaderControl
+   * @param bounds The rectangular area that the control occupies
+   * @param source The GLSL of the shader, see IShader
+   * @param cpuFunc The function to draw with where the shader can't run on the GPU, or nullptr to draw nothing there */
+  IShaderControl(const IRECT& bounds, const char* source, IShader::CPUFunc cpuFunc = nullptr)
+  : IControl(bounds)
+  , mShader(source, cpuFunc)
+  {
+    mIgnoreMouse = true;
+  }
+
+  void Draw(IGraphics& g) override
+  {
+    g.DrawShader(mShader, mRECT);
+  }
+
+  void OnMsgFromDelegate(int messageTag, int dataSize, const void* pData) override
+  {
+    if (messageTag != kUpdateMessage || dataSize != sizeof(Data))
+      return;
+
+    const Data* pRow = static_cast<const Data*>(pData);
+
+    if (pRow->texture < 0 || pRow->texture >= IShader::kMaxTextures)
+      return;
+
+    if (pRow->row == kScrollRow)
+      mShader.ScrollTexture(pRow->texture, pRow->vals, pRow->nVals);
+    else
+      mShader.SetTextureRow(pRow->texture, pRow->row, pRow->vals, pRow->nVals);
+
+    SetDirty(false);
+  }
+
+  /** Set one of the values the shader reads as params, and redraw
+   * @param idx The parameter, < IShader::kNumParams
+   * @param value The value */
+  void SetShaderParam(int idx, float value)
+  {
+    mShader.SetParam(idx, value);
+    SetDirty(false);
+  }
+
+  /** @return The shader, e.g. to resize its textures or to check GetError() after it has been drawn */
+  IShader& GetShader() { return mShader; }
+
+private:
+  IShader mShader;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
@@ -63,6 +63,7 @@ ITextEntryControl::ITextEntryControl()
 : IControl(IRECT())
 {
   stb_textedit_initialize_state(&mEditState, true);
+  std::fill(std::begin(mGlyphWidths), std::end(mGlyphWidths), -1.f);
   
   SetActionFunction([&](IControl* pCaller) {
     
@@ -360,7 +361,7 @@ void ITextEntryControl::Cut()
 int ITextEntryControl::DeleteChars(ITextEntryControl* _this, size_t pos, size_t num)
 {
   _this->mEditString.DeleteSub((int) pos, (int) num);
-  _this->OnTextChange();
+  _this->UpdateCharWidths((int) pos, (int) num, 0);
   return true; // TODO: Error checking
 }
 
@@ -369,7 +370,7 @@ int ITextEntryControl::InsertChars(ITextEntryControl* _this, size_t pos, const c
 {
   WDL_String str = WDL_String(text, (int) num);
   _this->mEditString.Insert(&str, (int) pos);
-  _this->OnTextChange();
+  _this->UpdateCharWidths((int) pos, 0, (int) num);
   return true; // TODO: Error checking
 }
 
@@ -391,11 +392,7 @@ void ITextEntryControl::Layout(StbTexteditRow* row, ITextEntryControl* _this, in
   assert (start_i == 0);
 
   _this->FillCharWidthCache();
-  float textWidth = 0.;
-  
-  for (int i = 0; i < _this->mCharWidths.GetSize(); i++) {
-    textWidth += _this->mCharWidths.Get()[i];
-  }
+  const float textWidth = _this->mTextWidth;
 
   row->num_chars = _this->mEditString.GetLength();
   row->baseline_y_delta = 1.25;
@@ -471,27 +468,89 @@ void ITextEntryControl::OnStateChanged()
 
 void ITextEntryControl::OnTextChange()
 {
-  // rebuild the cache when the text changes
+  // rebuild the cache when the text is replaced, edits go through UpdateCharWidths()
   mCharWidths.Resize(0, false);
+  mTextWidth = 0.f;
   FillCharWidthCache();
 }
 
 void ITextEntryControl::FillCharWidthCache()
 {
   // only calculate when empty
-  if (mCharWidths.GetSize())
+  if (mCharWidths.GetSize() || !mEditString.GetLength())
     return;
 
+  CheckGlyphCache();
+
   const int len = mEditString.GetLength();
   mCharWidths.Resize(len, false);
+  mTextWidth = 0.f;
   for (int i = 0; i < len; ++i)
   {
     char c = mEditString.Get()[i];
-    char nc = (i + 1) == len ? 0 : mEditString.Get()[i];
+    char nc = (i + 1) == len ? 0 : mEditString.Get()[i + 1];
     mCharWidths.Get()[i] = GetCharWidth(c, nc);
+    mTextWidth += mCharWidths.Get()[i];
   }
 }
 
+void ITextEntryControl::UpdateCharWidths(int pos, int nRemoved, int nInserted)
+{
+  const int len = mEditString.GetLength();
+  const int oldLen = len - nInserted + nRemoved;
+
+  if (mCharWidths.GetSize() != oldLen)
+  {
+    OnTextChange();
+    return;
+  }
+
+  CheckGlyphCache();
+
+  // the character before the edit kerns against a different neighbour now, so it is re-measured along with the inserted ones
+  const int first = std::max(pos - 1, 0);
+  float* pWidths = mCharWidths.Get();
+
+  for (int i = first; i < pos + nRemoved; i++)
+    mTextWidth -= pWidths[i];
+
+  if (nInserted > nRemoved)
+  {
+    mCharWidths.Resize(len, false);
+    pWidths = mCharWidths.Get();
+    memmove(pWidths + pos + nInserted, pWidths + pos + nRemoved, (oldLen - pos - nRemoved) * sizeof(float));
+  }
+  else if (nInserted < nRemoved)
+  {
+    memmove(pWidths + pos + nInserted, pWidths + pos + nRemoved, (oldLen - pos - nRemoved) * sizeof(float));
+    mCharWidths.Resize(len, false);
+    pWidths = mCharWidths.Get();
+  }
+
+  const char* str = mEditString.Get();
+
+  for (int i = first; i < pos + nInserted; i++)
+  {
+    char nc = (i + 1) == len ? 0 : str[i + 1];
+    pWidths[i] = GetCharWidth(str[i], nc);
+    mTextWidth += pWidths[i];
+  }
+
+  if (!len)
+    mTextWidth = 0.f;
+}
+
+void ITextEntryControl::CheckGlyphCache()
+{
+  if (mGlyphSize == mText.mSize && !strcmp(mGlyphFont.Get(), mText.mFont))
+    return;
+
+  mGlyphFont.Set(mText.mFont);
+  mGlyphSize = mText.mSize;
+  std::fill(std::begin(mGlyphWidths), std::end(mGlyphWidths), -1.f);
+  mPairWidths.clear();
+}
+
 void ITextEntryControl::CalcCursorSizes()
 {
   //TODO: cache cursor size and location?
@@ -505,24 +564,38 @@ void ITextEntryControl::CalcCursorSizes()
 // see: https://github.com/nothings/stb/issues/6
 float ITextEntryControl::GetCharWidth(char c, char nc)
 {
-  IRECT bounds;
-
   if (nc)
   {
-    WDL_String ncstr; ncstr.SetFormatted(1, "%c", nc);
-    WDL_String cstr; cstr.SetFormatted(1, "%c", c);
-
-    GetUI()->MeasureText(mText, ncstr.Get(), bounds);
-    float ncWidth = bounds.W();
-    cstr.Append(&ncstr);
-    GetUI()->MeasureText(mText, cstr.Get(), bounds);
-    float tcWidth = bounds.W();
-    return tcWidth - ncWidth;
+    const uint16_t key = static_cast<uint16_t>((static_cast<unsigned char>(c) << 8) | static_cast<unsigned char>(nc));
+    auto it = mPairWidths.find(key);
+
+    if (it != mPairWidths.end())
+      return it->second;
+
+    char pair[3] = { c, nc, 0 };
+    IRECT bounds;
+    GetUI()->MeasureText(mText, pair, bounds);
+    const float width = bounds.W() - GetGlyphWidth(nc);
+    mPairWidths.emplace(key, width);
+    return width;
   }
   
-  WDL_String cstr; cstr.SetFormatted(1, "%c", c);
-  GetUI()->MeasureText(mText, cstr.Get(), bounds);
-  return bounds.W();
+  return GetGlyphWidth(c);
+}
+
+float ITextEntryControl::GetGlyphWidth(char c)
+{
+  float& width = mGlyphWidths[static_cast<unsigned char>(c)];
+
+  if (width < 0.f)
+  {
+    char str[2] = { c, 0 };
+    IRECT bounds;
+    GetUI()->MeasureText(mText, str, bounds);
+    width = bounds.W();
+  }
+
+  return width;
 }
 
 void ITextEntryControl::CreateTextEntry(int paramIdx, const IText& text, const IRECT& bounds, int length, const char* str)
@@ -25,6 +25,8 @@
 
 #include "stb_textedit.h"
 
+#include <unordered_map>
+
 #include "IControl.h"
 
 BEGIN_IPLUG_NAMESPACE
@@ -73,8 +75,11 @@ private:
   void OnStateChanged();
   void OnTextChange();
   void FillCharWidthCache();
+  void UpdateCharWidths(int pos, int nRemoved, int nInserted);
+  void CheckGlyphCache();
   void CalcCursorSizes();
   float GetCharWidth (char c, char nc);
+  float GetGlyphWidth(char c);
   void CopySelection();
   void Paste();
   void Cut();
@@ -90,6 +95,13 @@ private:
   STB_TexteditState mEditState;
   WDL_String mEditString;
   WDL_TypedBuf<float> mCharWidths;
+  float mTextWidth = 0.f; // the sum of mCharWidths, updated with it
+
+  // advances measured for mGlyphFont at mGlyphSize, so that an edit only measures characters the field hasn't seen before
+  WDL_String mGlyphFont;
+  float mGlyphSize = 0.f;
+  float mGlyphWidths[256];
+  std::unordered_map<uint16_t, float> mPairWidths;
 };
 
 END_IGRAPHICS_NAMESPACE
@@ -33,6 +33,7 @@ public:
   , mHiValue(hi)
   , mBuffer(bufferSize, defaultVal)
   , mDirection(dir)
+  , mNValues(bufferSize)
   {
     assert(bufferSize > 0 && bufferSize < MAX_BUFFER_SIZE);
 
@@ -42,7 +43,18 @@ public:
   void Update(float v)
   {
     mBuffer[mReadPos] = v;
-    mReadPos = (mReadPos+1) % mBuffer.size();
+    mNValues++;
+    mReadPos = static_cast<int>(mNValues % mBuffer.size());
+    SetDirty(false);
+  }
+
+  /** Draw the plot on a canvas layer that scrolls as values arrive, so that an update only draws the newest segment rather than the whole history.
+   * In this mode the line is a solid color, rather than fading out towards the oldest values
+   * @param streaming \c true to draw on a scrolling canvas */
+  void SetStreaming(bool streaming)
+  {
+    mStreaming = streaming;
+    mCanvas = nullptr;
     SetDirty(false);
   }
   
@@ -54,7 +66,8 @@ public:
                                 mDirection == EDirection::Horizontal ? -mStrokeThickness : 0.,
                                 mDirection == EDirection::Horizontal ? 0. : -mStrokeThickness,
                                 mDirection == EDirection::Horizontal ? -mStrokeThickness : 0.);
-    
+
+    mCanvas = nullptr;
     SetDirty(false);
   }
   
@@ -70,6 +83,12 @@ public:
 
   void DrawWidget(IGraphics& g) override
   {
+    if (mStreaming && mBuffer.size() > 2)
+    {
+      DrawCanvas(g);
+      return;
+    }
+
     float x = mPlotBounds.L;
     float y = mPlotBounds.T;
     float w = mPlotBounds.W();
@@ -111,6 +130,124 @@ public:
     g.PathStroke(IPattern::CreateLinearGradient(mPlotBounds, mDirection, {{COLOR_TRANSPARENT, 0.f}, {GetColor(kX1), 1.f}}), mStrokeThickness);
   }
 private:
+  /* The canvas is a ring of one slot per segment along the time axis of mWidgetBounds. Value i ends at (i % nSlots) * step, and
+   * the canvas is drawn in two pieces either side of the newest value, so that it ends up at the end of the plot */
+  void DrawCanvas(IGraphics& g)
+  {
+    const int sz = static_cast<int>(mBuffer.size());
+    const int nSlots = sz - 1;
+    const float length = GetTimeLength();
+    const float step = length / nSlots;
+    const uint64_t newest = mNValues - 1;
+
+    auto slotPos = [&](uint64_t i) { return static_cast<float>(i % nSlots) * step; };
+
+    if (!g.CheckLayer(mCanvas) || mNValues - mNDrawn > static_cast<uint64_t>(sz - 3))
+    {
+      const uint64_t first = mNValues - sz;
+      const float pos = slotPos(first);
+      g.StartLayer(mWidgetBounds);
+      StrokeSpan(g, first, newest, pos, pos, pos + length, false);
+      mCanvas = g.EndLayer();
+    }
+    else if (mNDrawn != mNValues)
+    {
+      // the slot before the new values is redrawn too, as its end joins up with the first of them
+      const uint64_t firstSlot = mNDrawn - 2;
+      const uint64_t first = firstSlot - 1;
+      const float lo = slotPos(firstSlot);
+      const float hi = lo + static_cast<float>(newest - firstSlot) * step;
+      g.ResumeLayer(mCanvas);
+      StrokeSpan(g, first, newest, lo - step, lo, hi, true);
+      mCanvas = g.EndLayer();
+    }
+
+    mNDrawn = mNValues;
+
+    const IBitmap bitmap = mCanvas->GetBitmap();
+    const IRECT& layerBounds = mCanvas->Bounds();
+    const float newestPos = slotPos(newest);
+    const float seam = length - newestPos;
+    const bool horizontal = mDirection == EDirection::Horizontal;
+
+    g.PathTransformSave();
+    g.PathTransformReset();
+    g.PathClipRegion(GetTimeSpan(0.f, seam));
+    g.DrawBitmap(bitmap, horizontal ? layerBounds.GetTranslated(-newestPos, 0.f) : layerBounds.GetTranslated(0.f, -newestPos), 0, 0);
+    g.PathClipRegion(GetTimeSpan(seam, length));
+    g.DrawBitmap(bitmap, horizontal ? layerBounds.GetTranslated(seam, 0.f) : layerBounds.GetTranslated(0.f, seam), 0, 0);
+    g.PathClipRegion();
+    g.PathTransformRestore();
+  }
+
+  /** Stroke values first to last onto the canvas, clipped to the span [lo, hi) of the time axis, which wraps around the end of the canvas
+   * @param pos The position of the first value along the time axis
+   * @param clear \c true to erase the span first */
+  void StrokeSpan(IGraphics& g, uint64_t first, uint64_t last, float pos, float lo, float hi, bool clear)
+  {
+    const float length = GetTimeLength();
+
+    StrokeValues(g, first, last, pos, lo, std::min(hi, length), clear);
+
+    if (hi > length)
+      StrokeValues(g, first, last, pos - length, 0.f, hi - length, clear);
+  }
+
+  void StrokeValues(IGraphics& g, uint64_t first, uint64_t last, float pos, float lo, float hi, bool clear)
+  {
+    const int sz = static_cast<int>(mBuffer.size());
+    const float step = GetTimeLength() / (sz - 1);
+    const IRECT span = GetTimeSpan(lo, hi);
+
+    g.PathClipRegion(span);
+
+    if (clear)
+    {
+      const IBlend blend(EBlend::DestOut, 1.f);
+      g.FillRect(COLOR_BLACK, span, &blend);
+    }
+
+    for (uint64_t i = first; i <= last; i++)
+    {
+      const float t = pos + static_cast<float>(i - first) * step;
+      const float v = (mBuffer[i % sz] - mLoValue) / (mHiValue - mLoValue);
+      float x, y;
+
+      if (mDirection == EDirection::Horizontal)
+      {
+        x = mWidgetBounds.L + t;
+        y = mPlotBounds.T + mPlotBounds.H() - (v * mPlotBounds.H());
+      }
+      else
+      {
+        x = mPlotBounds.L + mPlotBounds.W() - (v * mPlotBounds.W());
+        y = mWidgetBounds.T + t;
+      }
+
+      if (i == first)
+        g.PathMoveTo(x, y);
+      else
+        g.PathLineTo(x, y);
+    }
+
+    g.PathStroke(GetColor(kX1), mStrokeThickness);
+    g.PathClipRegion();
+  }
+
+  float GetTimeLength() const
+  {
+    return mDirection == EDirection::Horizontal ? mWidgetBounds.W() : mWidgetBounds.H();
+  }
+
+  /** @return The part of the canvas from lo to hi along the time axis */
+  IRECT GetTimeSpan(float lo, float hi) const
+  {
+    if (mDirection == EDirection::Horizontal)
+      return IRECT(mWidgetBounds.L + lo, mWidgetBounds.T, mWidgetBounds.L + hi, mWidgetBounds.B);
+    else
+      return IRECT(mWidgetBounds.L, mWidgetBounds.T + lo, mWidgetBounds.R, mWidgetBounds.T + hi);
+  }
+
   std::vector<float> mBuffer;
   float mLoValue = 0.f;
   float mHiValue = 1.f;
@@ -118,6 +255,10 @@ private:
   float mStrokeThickness = 2.f;
   EDirection mDirection;
   IRECT mPlotBounds;
+  uint64_t mNValues; // the number of values so far, counting the defaults that fill the buffer
+  uint64_t mNDrawn = 0; // mNValues when the canvas was last drawn
+  bool mStreaming = false;
+  ILayerPtr mCanvas;
 };
 
 END_IGRAPHICS_NAMESPACE
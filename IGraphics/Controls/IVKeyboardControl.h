@@ -89,7 +89,8 @@ public:
     }
 
     SetNoteRange(minNote, maxNote, keepWidth);
-    SetWantsMidi(true);
+    // notes, and controller messages for all notes off
+    SetMidiFilter((1 << IMidiMsg::kNoteOn) | (1 << IMidiMsg::kNoteOff) | (1 << IMidiMsg::kControlChange));
   }
 
   void OnMouseDown(float x, float y, const IMouseMod& mod) override
@@ -108,7 +109,7 @@ public:
       TriggerMidiMsgFromKeyPress(mLastTouchedKey, (int) (mLastVelocity * 127.f));
     }
 
-    SetDirty(true);
+    OnKeysChanged(true);
   }
 
   void OnMouseUp(float x, float y, const IMouseMod& mod) override
@@ -122,7 +123,7 @@ public:
       mMouseOverKey = -1;
       mLastVelocity = 0.;
 
-      SetDirty(false);
+      OnKeysChanged(false);
     }
   }
 
@@ -133,7 +134,7 @@ public:
       mLastTouchedKey = -1;
       mMouseOverKey = -1;
       mLastVelocity = 0.;
-      SetDirty(false);
+      OnKeysChanged(false);
     }
   }
 
@@ -156,8 +157,7 @@ public:
       SetKeyIsPressed(prevKey, false);
     }
 
-    SetDirty(true);
-
+    OnKeysChanged(true);
   }
 
   void OnMouseOver(float x, float y, const IMouseMod& mod) override
@@ -182,7 +182,7 @@ public:
     }
 
     mTargetRECT = mRECT;
-    SetDirty(false);
+    InvalidateKeyBed();
   }
 
   void OnMidi(const IMidiMsg& msg) override
@@ -201,8 +201,6 @@ public:
         break;
       default: break;
     }
-
-    SetDirty(false);
   }
 
   void DrawKey(IGraphics& g, const IRECT& bounds, const IColor& color)
@@ -215,92 +213,143 @@ public:
       g.FillRect(color, bounds);
   }
 
-  void Draw(IGraphics& g) override
+  /** Draw a white key
+   * @param g The graphics context
+   * @param i The key index
+   * @param released \c true to draw the key unpressed and unhighlighted, as it is in the key bed
+   * @param rightBorder \c true to also draw the frame line on the key's right edge, which belongs to the next white key */
+  void DrawWhiteKey(IGraphics& g, int i, bool released, bool rightBorder)
   {
-    IColor shadowColor = IColor(60, 0, 0, 0);
+    const IColor shadowColor = IColor(60, 0, 0, 0);
+    float kL = *GetKeyXPos(i);
+    IRECT keyBounds = IRECT(kL, mRECT.T, kL + mWKWidth, mRECT.B);
+
+    DrawKey(g, keyBounds, (!released && i == mHighlight) ? mHK_COLOR : mWK_COLOR);
+
+    if (!released && GetKeyIsPressed(i))
+    {
+      // draw played white key
+      DrawKey(g, keyBounds, mPK_COLOR);
+
+      if (mDrawShadows)
+      {
+        IRECT shadowBounds = keyBounds;
+        shadowBounds.R = shadowBounds.L + 0.35f * shadowBounds.W();
+        
+        if(!mRoundedKeys)
+          g.FillRect(shadowColor, shadowBounds);
+        else {
+          g.FillRoundRect(shadowColor, shadowBounds, 0., 0., mRoundness, mRoundness); // this one looks strange with rounded corners
+        }
+      }
+    }
+    if (mDrawFrame)
+    {
+      // only draw the left border if it doesn't overlay mRECT left border
+      if (i != 0)
+        g.DrawLine(mFR_COLOR, kL, mRECT.T, kL, mRECT.B, nullptr, mFrameThickness);
+      if (rightBorder || (i == NKeys() - 2 && IsBlackKey(NKeys() - 1)))
+        g.DrawLine(mFR_COLOR, kL + mWKWidth, mRECT.T, kL + mWKWidth, mRECT.B, nullptr, mFrameThickness);
+    }
+  }
 
+  /** Draw a black key
+   * @param g The graphics context
+   * @param i The key index
+   * @param released \c true to draw the key unpressed and unhighlighted, as it is in the key bed
+   * @param drawShadow \c true to draw the shadow the key casts on the white key to its right */
+  void DrawBlackKey(IGraphics& g, int i, bool released, bool drawShadow)
+  {
+    const IColor shadowColor = IColor(60, 0, 0, 0);
+    const bool pressed = !released && GetKeyIsPressed(i);
     float BKBottom = mRECT.T + mRECT.H() * mBKHeightRatio;
     float BKWidth = GetBKWidth();
-
-    // first draw white keys
-    for (int i = 0; i < NKeys(); ++i)
+    float kL = *GetKeyXPos(i);
+    IRECT keyBounds = IRECT(kL, mRECT.T, kL + BKWidth, BKBottom);
+    // first draw underlying shadows
+    if (drawShadow && mDrawShadows && !pressed && i < NKeys() - 1)
     {
-      if (!IsBlackKey(i))
+      IRECT shadowBounds = keyBounds;
+      float w = shadowBounds.W();
+      shadowBounds.L += 0.6f * w;
+      if (!released && GetKeyIsPressed(i + 1))
       {
-        float kL = *GetKeyXPos(i);
-        IRECT keyBounds = IRECT(kL, mRECT.T, kL + mWKWidth, mRECT.B);
+        // if white to the right is pressed, shadow is longer
+        w *= 1.3f;
+        shadowBounds.B = shadowBounds.T + 1.05f * shadowBounds.H();
+      }
+      shadowBounds.R = shadowBounds.L + w;
+      DrawKey(g, shadowBounds, shadowColor);
+    }
+    DrawKey(g, keyBounds, (!released && i == mHighlight) ? mHK_COLOR : mBK_COLOR);
 
-        DrawKey(g, keyBounds, i == mHighlight ? mHK_COLOR : mWK_COLOR);
+    if (pressed)
+    {
+      // draw pressed black key
+      IColor cBP = mPK_COLOR;
+      cBP.A = (int) mBKAlpha;
+      g.FillRect(cBP, keyBounds);
+    }
 
-        if (GetKeyIsPressed(i))
-        {
-          // draw played white key
-          DrawKey(g, keyBounds, mPK_COLOR);
+    if(!mRoundedKeys)
+    {
+      // draw l, r and bottom if they don't overlay the mRECT borders
+      if (mBKHeightRatio != 1.0)
+        g.DrawLine(mFR_COLOR, kL, BKBottom, kL + BKWidth, BKBottom);
+      if (i > 0)
+        g.DrawLine(mFR_COLOR, kL, mRECT.T, kL, BKBottom);
+      if (i != NKeys() - 1)
+        g.DrawLine(mFR_COLOR, kL + BKWidth, mRECT.T, kL + BKWidth, BKBottom);
+    }
+  }
 
-          if (mDrawShadows)
-          {
-            IRECT shadowBounds = keyBounds;
-            shadowBounds.R = shadowBounds.L + 0.35f * shadowBounds.W();
-            
-            if(!mRoundedKeys)
-              g.FillRect(shadowColor, shadowBounds);
-            else {
-              g.FillRoundRect(shadowColor, shadowBounds, 0., 0., mRoundness, mRoundness); // this one looks strange with rounded corners
-            }
-          }
-        }
-        if (mDrawFrame && i != 0)
-        { // only draw the left border if it doesn't overlay mRECT left border
-          g.DrawLine(mFR_COLOR, kL, mRECT.T, kL, mRECT.B, nullptr, mFrameThickness);
-          if (i == NKeys() - 2 && IsBlackKey(NKeys() - 1))
-            g.DrawLine(mFR_COLOR, kL + mWKWidth, mRECT.T, kL + mWKWidth, mRECT.B, nullptr, mFrameThickness);
-        }
+  void Draw(IGraphics& g) override
+  {
+    // the released keys are cached, and only the pressed and highlighted keys are drawn over them, along with the keys that overlap those
+    if (!g.CheckLayer(mKeyBedLayer) || mKeyBedBounds != mRECT)
+    {
+      g.StartRecordedLayer(mRECT);
+
+      for (int i = 0; i < NKeys(); ++i)
+      {
+        if (!IsBlackKey(i))
+          DrawWhiteKey(g, i, true, false);
       }
+
+      for (int i = 0; i < NKeys(); ++i)
+      {
+        if (IsBlackKey(i))
+          DrawBlackKey(g, i, true, true);
+      }
+
+      mKeyBedLayer = g.EndLayer();
+      mKeyBedBounds = mRECT;
     }
 
-    // then blacks
+    g.DrawLayer(mKeyBedLayer);
+
+    auto isActive = [this](int i) { return i >= 0 && i < NKeys() && (GetKeyIsPressed(i) || i == mHighlight); };
+    auto isBlackAndActive = [&](int i) { return i >= 0 && i < NKeys() && IsBlackKey(i) && isActive(i); };
+
+    mRedrawWhiteKeys.Resize(NKeys(), false);
+    bool* pRedrawWhite = mRedrawWhiteKeys.Get();
+
     for (int i = 0; i < NKeys(); ++i)
-    {
-      if (IsBlackKey(i))
-      {
-        float kL = *GetKeyXPos(i);
-        IRECT keyBounds = IRECT(kL, mRECT.T, kL + BKWidth, BKBottom);
-        // first draw underlying shadows
-        if (mDrawShadows && !GetKeyIsPressed(i) && i < NKeys() - 1)
-        {
-          IRECT shadowBounds = keyBounds;
-          float w = shadowBounds.W();
-          shadowBounds.L += 0.6f * w;
-          if (GetKeyIsPressed(i + 1))
-          {
-            // if white to the right is pressed, shadow is longer
-            w *= 1.3f;
-            shadowBounds.B = shadowBounds.T + 1.05f * shadowBounds.H();
-          }
-          shadowBounds.R = shadowBounds.L + w;
-          DrawKey(g, shadowBounds, shadowColor);
-        }
-        DrawKey(g, keyBounds, i == mHighlight ? mHK_COLOR : mBK_COLOR);
+      pRedrawWhite[i] = !IsBlackKey(i) && (isActive(i) || isBlackAndActive(i - 1) || isBlackAndActive(i + 1));
 
-        if (GetKeyIsPressed(i))
-        {
-          // draw pressed black key
-          IColor cBP = mPK_COLOR;
-          cBP.A = (int) mBKAlpha;
-          g.FillRect(cBP, keyBounds);
-        }
+    auto redrawWhite = [&](int i) { return i >= 0 && i < NKeys() && pRedrawWhite[i]; };
 
-        if(!mRoundedKeys)
-        {
-          // draw l, r and bottom if they don't overlay the mRECT borders
-          if (mBKHeightRatio != 1.0)
-            g.DrawLine(mFR_COLOR, kL, BKBottom, kL + BKWidth, BKBottom);
-          if (i > 0)
-            g.DrawLine(mFR_COLOR, kL, mRECT.T, kL, BKBottom);
-          if (i != NKeys() - 1)
-            g.DrawLine(mFR_COLOR, kL + BKWidth, mRECT.T, kL + BKWidth, BKBottom);
-        }
-      }
+    for (int i = 0; i < NKeys(); ++i)
+    {
+      if (pRedrawWhite[i])
+        DrawWhiteKey(g, i, false, i < NKeys() - 1);
+    }
+
+    // a black key is redrawn over a white neighbour that was, but its shadow is already in the key bed unless the white key to its right was redrawn
+    for (int i = 0; i < NKeys(); ++i)
+    {
+      if (IsBlackKey(i) && (isActive(i) || redrawWhite(i - 1) || redrawWhite(i + 1)))
+        DrawBlackKey(g, i, false, redrawWhite(i + 1));
     }
 
     if (mDrawFrame)
@@ -372,22 +421,32 @@ public:
     SetKeyIsPressed(noteNum - mMinNote, played);
   }
 
+  /** Set whether a key is pressed. Only the area around the key is redrawn, and nothing is if its state does not change
+   * @param key The key index, from 0 for the lowest note
+   * @param pressed \c true if the key is pressed */
   void SetKeyIsPressed(int key, bool pressed)
   {
+    if (key < 0 || key >= NKeys() || GetKeyIsPressed(key) == pressed)
+      return;
+
     mPressedKeys.Get()[key] = pressed;
-    SetDirty(false);
+    SetKeyDirty(key);
   }
   
   void SetKeyHighlight(int key)
   {
+    if (key == mHighlight)
+      return;
+
+    SetKeyDirty(mHighlight);
     mHighlight = key;
-    SetDirty(false);
+    SetKeyDirty(mHighlight);
   }
 
   void ClearNotesFromMidi()
   {
-    memset(mPressedKeys.Get(), 0, mPressedKeys.GetSize() * sizeof(bool));
-    SetDirty(false);
+    for (int i = 0; i < NKeys(); ++i)
+      SetKeyIsPressed(i, false);
   }
 
   void SetBlackToWhiteRatios(float widthRatio, float heightRatio = 0.6)
@@ -412,7 +471,7 @@ public:
       }
     }
 
-    SetDirty(false);
+    InvalidateKeyBed();
   }
 
   void SetHeight(float h, bool keepAspectRatio = false)
@@ -422,10 +481,11 @@ public:
     mRECT.B = mRECT.T + mRECT.H() * r;
 
     mTargetRECT = mRECT;
+    InvalidateHitTestGrid();
 
     if (keepAspectRatio)
       SetWidth(mRECT.W() * r);
-    SetDirty(false);
+    InvalidateKeyBed();
   }
 
   void SetWidth(float w, bool keepAspectRatio = false)
@@ -442,11 +502,12 @@ public:
     }
 
     mTargetRECT = mRECT;
+    InvalidateHitTestGrid();
 
     if (keepAspectRatio)
       SetHeight(mRECT.H() * r);
 
-    SetDirty(false);
+    InvalidateKeyBed();
   }
 
   void SetShowNotesAndVelocity(bool show)
@@ -483,7 +544,7 @@ public:
       mBKAlpha = Clip(mBKAlpha, 15.f, 255.f);
     }
 
-    SetDirty(false);
+    InvalidateKeyBed();
   }
 
   // returns pressed Midi note number
@@ -578,7 +639,7 @@ private:
     }
 
     mTargetRECT = mRECT;
-    SetDirty(false);
+    InvalidateKeyBed();
   }
 
   int GetKeyAtPoint(float x, float y)
@@ -671,6 +732,60 @@ private:
     return w;
   }
 
+  /** Mark the area that a change to a key can affect as dirty, i.e. the key and its neighbours, which it overlaps or casts a shadow on */
+  void SetKeyDirty(int key)
+  {
+    if (key < 0 || key >= NKeys())
+      return;
+
+    IRECT r = GetKeyBounds(key);
+
+    if (key > 0)
+      r = r.Union(GetKeyBounds(key - 1));
+    if (key < NKeys() - 1)
+      r = r.Union(GetKeyBounds(key + 1));
+
+    SetDirtyRect(r.GetPadded(mFrameThickness));
+  }
+
+  /** Called after the mouse has pressed or released keys, which have already marked their areas dirty
+   * @param triggerAction \c true to call the action function */
+  void OnKeysChanged(bool triggerAction)
+  {
+    // the note name and velocity are drawn over the keys and move with the mouse, so they need the whole keyboard redrawn
+    if (mShowNoteAndVel)
+    {
+      SetDirty(triggerAction);
+      return;
+    }
+
+#ifdef _DEBUG
+    SetDirtyRect(IRECT(mRECT.L + 20, mRECT.B - 20, mRECT.L + 160, mRECT.B));
+#endif
+
+    if (triggerAction && GetActionFunction())
+      GetActionFunction()(this);
+  }
+
+  /** Redraw the cached key bed, after the geometry or colours change */
+  void InvalidateKeyBed()
+  {
+    if (mKeyBedLayer)
+      mKeyBedLayer->Invalidate();
+
+    SetDirty(false);
+  }
+
+  IRECT GetKeyBounds(int i)
+  {
+    float kL = *GetKeyXPos(i);
+
+    if (IsBlackKey(i))
+      return IRECT(kL, mRECT.T, kL + GetBKWidth(), mRECT.T + mRECT.H() * mBKHeightRatio);
+    else
+      return IRECT(kL, mRECT.T, kL + mWKWidth, mRECT.B);
+  }
+
   void TriggerMidiMsgFromKeyPress(int key, int velocity)
   {
     IMidiMsg msg;
@@ -710,6 +825,9 @@ protected:
   WDL_TypedBuf<bool> mPressedKeys;
   WDL_TypedBuf<float> mKeyXPos;
   int mHighlight = -1;
+  ILayerPtr mKeyBedLayer;
+  IRECT mKeyBedBounds;
+  WDL_TypedBuf<bool> mRedrawWhiteKeys;
 };
 
 END_IGRAPHICS_NAMESPACE
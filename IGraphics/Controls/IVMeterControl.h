@@ -17,15 +17,19 @@
  */
 
 #include "IControl.h"
-#include "IPlugQueue.h"
+#include "IPlugPeakRMS.h"
+#include "IPlugSampleRing.h"
 #include "IPlugStructs.h"
 
 BEGIN_IPLUG_NAMESPACE
 BEGIN_IGRAPHICS_NAMESPACE
 
 /** Vectorial multichannel capable meter control
+ * The Sender measures the peak and RMS of each block on the audio thread, and the control applies the meter ballistics on the UI side:
+ * the bar follows the RMS with separate attack and release times, and the peak marker holds the highest peak before falling, see SetBallistics()
+ * RING_SIZE is the number of block measurements buffered by the Sender, it should hold more blocks than are processed between calls to TransmitData()
  * @ingroup IControls */
-template <int MAXNC = 1, int QUEUE_SIZE = 1024>
+template <int MAXNC = 1, int RING_SIZE = 512>
 class IVMeterControl : public IVTrackControlBase
 {
 public:
@@ -35,24 +39,27 @@ public:
   struct Data
   {
     int nchans = MAXNC;
-    float vals[MAXNC] = {};
+    float peak[MAXNC] = {};
+    float rms[MAXNC] = {};
 
     bool AboveThreshold()
     {
       static const float threshold = (float) DBToAmp(-90.);
 
-      float sum = 0.f;
+      float max = 0.f;
 
       for(int i = 0; i < MAXNC; i++)
       {
-        sum += vals[i];
+        max = std::max(max, peak[i]);
       }
 
-      return std::abs(sum) > threshold;
+      return max > threshold;
     }
   };
 
-  /** Used on the DSP side in order to queue sample values and transfer data to low priority thread. */
+  /** Used on the DSP side in order to pass sample values to the low priority thread.
+   * The audio thread reduces each block to a peak and a sum of squares per channel and writes them into a ring, and TransmitData()
+   * combines everything written since it was last called into one Data packet */
   class Sender
   {
   public:
@@ -63,47 +70,85 @@ public:
 
     void ProcessBlock(sample** inputs, int nFrames)
     {
-      Data d;
-
-      for (auto s = 0; s < nFrames; s++)
-      {
-        for (auto c = 0; c < MAXNC; c++)
-        {
-          d.vals[c] += std::fabs((float) inputs[c][s]);
-        }
-      }
+      float frame[kNSummaryVals];
 
       for (auto c = 0; c < MAXNC; c++)
       {
-        d.vals[c] /= (float) nFrames;
+        IPeakRMS levels;
+        levels.Accumulate(inputs[c], nFrames);
+        frame[c] = levels.mPeak;
+        frame[MAXNC + c] = static_cast<float>(levels.mSumSquares);
       }
 
-      if(mPrevAboveThreshold)
-        mQueue.Push(d); // TODO: expensive?
-
-      mPrevAboveThreshold = d.AboveThreshold();
+      frame[2 * MAXNC] = static_cast<float>(nFrames);
+      mRing.WriteFrame(frame);
     }
 
+    /** Add precomputed meter values, which are combined with any other data in TransmitData() as if they measured a single frame */
     void ProcessData(Data d)
     {
-      mQueue.Push(d);
+      float frame[kNSummaryVals];
+
+      for (auto c = 0; c < MAXNC; c++)
+      {
+        frame[c] = d.peak[c];
+        frame[MAXNC + c] = d.rms[c] * d.rms[c];
+      }
+
+      frame[2 * MAXNC] = 1.f;
+      mRing.WriteFrame(frame);
     }
 
     // this must be called on the main thread - typically in MyPlugin::OnIdle()
     void TransmitData(IEditorDelegate& dlg)
     {
-      while(mQueue.ElementsAvailable())
+      const uint64_t writePos = mRing.GetWritePosition();
+
+      if (writePos == mTransmittedPos)
+        return;
+
+      // if we fell behind, the oldest blocks were overwritten, so combine the newest half of the ring
+      const int nBlocks = static_cast<int>(std::min<uint64_t>(writePos - mTransmittedPos, mRing.GetCapacity() / 2));
+      double sumSquares[MAXNC] = {};
+      double nFrames = 0.;
+      Data d;
+
+      const bool valid = mRing.Visit(writePos - nBlocks, nBlocks, [&](int c, const float* pData, int offset, int n) {
+        for (auto s = 0; s < n; s++)
+        {
+          if (c < MAXNC)
+            d.peak[c] = std::max(d.peak[c], pData[s]);
+          else if (c < 2 * MAXNC)
+            sumSquares[c - MAXNC] += pData[s];
+          else
+            nFrames += pData[s];
+        }
+      });
+
+      if (!valid)
+        return; // overwritten while we read it, try again next time
+
+      mTransmittedPos = writePos;
+
+      for (auto c = 0; c < MAXNC; c++)
       {
-        Data d;
-        mQueue.Pop(d);
-        dlg.SendControlMsgFromDelegate(mControlTag, kUpdateMessage, sizeof(Data), (void*) &d);
+        d.rms[c] = nFrames > 0. ? static_cast<float>(std::sqrt(sumSquares[c] / nFrames)) : 0.f;
       }
+
+      if(mPrevAboveThreshold)
+        dlg.SendControlMsgFromDelegate(mControlTag, kUpdateMessage, sizeof(Data), (void*) &d);
+
+      mPrevAboveThreshold = d.AboveThreshold();
     }
 
   private:
+    // a block measurement is the peaks, the sums of squares and the number of frames
+    static constexpr int kNSummaryVals = 2 * MAXNC + 1;
+
     int mControlTag;
     bool mPrevAboveThreshold = true;
-    IPlugQueue<Data> mQueue {QUEUE_SIZE};
+    uint64_t mTransmittedPos = 0;
+    IPlugSampleRing<float, kNSummaryVals> mRing {RING_SIZE};
   };
 
   IVMeterControl(const IRECT& bounds, const char* label, const IVStyle& style = DEFAULT_STYLE, EDirection dir = EDirection::Vertical, const char* trackNames = 0, ...)
@@ -124,6 +169,30 @@ public:
   //  void OnMouseDblClick(float x, float y, const IMouseMod& mod) override;
   //  void OnMouseDown(float x, float y, const IMouseMod& mod) override;
 
+  /** Set the ballistics applied to the levels received from the Sender
+   * @param attackMs The time constant of the bar rising towards the RMS level, in milliseconds
+   * @param releaseMs The time constant of the bar and the peak marker falling, in milliseconds
+   * @param peakHoldMs How long the peak marker holds the highest peak before falling, in milliseconds */
+  void SetBallistics(double attackMs, double releaseMs, double peakHoldMs)
+  {
+    mAttackMs = std::max(attackMs, 0.);
+    mReleaseMs = std::max(releaseMs, 0.);
+    mPeakHoldMs = std::max(peakHoldMs, 0.);
+  }
+
+  bool IsDirty() override
+  {
+    if (mBallisticsActive)
+      StepBallistics();
+
+    // a held peak doesn't move, and the Sender stops sending once the input is silent, so the meter asks to be stepped
+    // again until the bars and peaks have settled
+    if (mBallisticsActive)
+      QueueDirty();
+
+    return IVTrackControlBase::IsDirty();
+  }
+
   void OnMsgFromDelegate(int messageTag, int dataSize, const void* pData) override
   {
     IByteStream stream(pData, dataSize);
@@ -132,16 +201,103 @@ public:
     Data data;
     pos = stream.Get(&data.nchans, pos);
 
-    while(pos < stream.Size())
+    for (auto i = 0; i < MAXNC; i++)
+      pos = stream.Get(&data.peak[i], pos);
+
+    for (auto i = 0; i < MAXNC; i++)
+      pos = stream.Get(&data.rms[i], pos);
+
+    const auto now = std::chrono::high_resolution_clock::now();
+
+    if (!mBallisticsActive)
+      mLastStepTime = now;
+
+    for (auto i = 0; i < std::min(data.nchans, MAXNC); i++)
     {
-      for (auto i = 0; i < data.nchans; i++) {
-        pos = stream.Get(&data.vals[i], pos);
-        SetValue(Clip(data.vals[i], 0.f, 1.f), i);
+      mTargets[i] = Clip(data.rms[i], 0.f, 1.f);
+
+      const float peak = Clip(data.peak[i], 0.f, 1.f);
+
+      if (peak >= mPeaks[i])
+      {
+        mPeaks[i] = peak;
+        mPeakTimes[i] = now;
       }
     }
 
-    SetDirty(false);
+    mBallisticsActive = true;
+    QueueDirty(); // IsDirty() steps the ballistics and marks the tracks that moved
+  }
+
+protected:
+  void DrawTrackHandle(IGraphics& g, const IRECT& r, int chIdx) override
+  {
+    IRECT fillRect = r.FracRect(mDirection, GetValue(chIdx));
+
+    g.FillRect(GetColor(kFG), fillRect);
+
+    const IRECT peakFrac = chIdx < MAXNC ? r.FracRect(mDirection, std::max<double>(mPeaks[chIdx], GetValue(chIdx))) : fillRect;
+    IRECT peakRect;
+
+    if(mDirection == EDirection::Vertical)
+      peakRect = IRECT(peakFrac.L, peakFrac.T, peakFrac.R, peakFrac.T + mPeakSize);
+    else
+      peakRect = IRECT(peakFrac.R - mPeakSize, peakFrac.T, peakFrac.R, peakFrac.B);
+
+    DrawPeak(g, peakRect, chIdx);
+  }
+
+private:
+  // Move the bars towards their targets and let the peaks fall, for the time since the last step
+  void StepBallistics()
+  {
+    const auto now = std::chrono::high_resolution_clock::now();
+    const double dt = std::min(Milliseconds(now - mLastStepTime).count(), 1000.);
+    const double release = mReleaseMs > 0. ? std::exp(-dt / mReleaseMs) : 0.;
+    const double attack = mAttackMs > 0. ? std::exp(-dt / mAttackMs) : 0.;
+    bool moving = false;
+
+    mLastStepTime = now;
+
+    for (auto i = 0; i < std::min(NVals(), MAXNC); i++)
+    {
+      const double prevLevel = GetValue(i);
+      const float prevPeak = mPeaks[i];
+      double level = prevLevel;
+      const double coeff = mTargets[i] > level ? attack : release;
+
+      level = mTargets[i] + (level - mTargets[i]) * coeff;
+
+      if (std::fabs(level - mTargets[i]) < 1e-4)
+        level = mTargets[i];
+      else
+        moving = true;
+
+      SetValue(level, i);
+
+      if (Milliseconds(now - mPeakTimes[i]).count() > mPeakHoldMs)
+        mPeaks[i] = static_cast<float>(mPeaks[i] * release);
+
+      if (mPeaks[i] <= level)
+        mPeaks[i] = 0.f;
+      else
+        moving = true;
+
+      if (level != prevLevel || mPeaks[i] != prevPeak)
+        SetTrackDirty(i);
+    }
+
+    mBallisticsActive = moving;
   }
+
+  float mTargets[MAXNC] = {};
+  float mPeaks[MAXNC] = {};
+  TimePoint mPeakTimes[MAXNC];
+  TimePoint mLastStepTime;
+  double mAttackMs = 10.;
+  double mReleaseMs = 300.;
+  double mPeakHoldMs = 1000.;
+  bool mBallisticsActive = false;
 };
 
 END_IGRAPHICS_NAMESPACE
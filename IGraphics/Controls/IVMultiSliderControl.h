@@ -68,6 +68,21 @@ public:
       g.DrawRect(GetColor(kFR), mWidgetBounds, nullptr, mStyle.frameThickness);
   }
 
+  void SetValueFromDelegate(double value, int valIdx = 0) override
+  {
+    // values streamed from the delegate redraw only the slider that moved
+    if (valIdx > kNoValIdx && this != GetUI()->GetCapturedControl())
+    {
+      if (GetValue(valIdx) != value)
+      {
+        SetValue(value, valIdx);
+        SetTrackDirty(valIdx);
+      }
+    }
+    else
+      IVTrackControlBase::SetValueFromDelegate(value, valIdx);
+  }
+
   int GetValIdxForPos(float x, float y) const override
   {
     int nVals = NVals();
@@ -124,6 +139,7 @@ public:
     {
       SetValue(mMinTrackValue + Clip(value, 0.f, 1.f) * (mMaxTrackValue - mMinTrackValue), sliderTest);
       OnNewValue(sliderTest, GetValue(sliderTest));
+      SetTrackDirty(sliderTest);
 
       mSliderHit = sliderTest;
 
@@ -149,6 +165,7 @@ public:
             float frac = (float)(i - lowBounds) / float(highBounds-lowBounds);
             SetValue(linearInterp(GetValue(lowBounds), GetValue(highBounds), frac), i);
             OnNewValue(i, GetValue(i));
+            SetTrackDirty(i);
           }
         }
       }
@@ -159,7 +176,7 @@ public:
       mSliderHit = -1;
     }
 
-    SetDirty(true); // will send all param vals parameter value to delegate
+    TriggerAction(); // will send all param vals parameter value to delegate
   }
 
   //  void OnMouseDblClick(float x, float y, const IMouseMod& mod) override;
@@ -18,14 +18,17 @@
 
 #include "IControl.h"
 #include "IPlugStructs.h"
-#include "IPlugQueue.h"
+#include "IPlugSampleRing.h"
 
 BEGIN_IPLUG_NAMESPACE
 BEGIN_IGRAPHICS_NAMESPACE
 
 /** Vectorial multichannel capable oscilloscope control
+ * RING_SIZE is the number of frames buffered by the Sender, at least 2 * MAXBUF
+ * When there are more samples than pixels across the control, each pixel column is drawn as a line from the lowest to the highest
+ * sample it covers, so the cost of drawing is bounded by the width of the control rather than MAXBUF
  * @ingroup IControls */
-template <int MAXNC = 1, int MAXBUF = 128, int QUEUE_SIZE = 1024>
+template <int MAXNC = 1, int MAXBUF = 128, int RING_SIZE = 1024>
 class IVScopeControl : public IControl
                      , public IVectorBase
 {
@@ -56,7 +59,8 @@ public:
     }
   };
 
-  /** Used on the DSP side in order to queue sample values and transfer data to low priority thread. */
+  /** Used on the DSP side in order to pass sample values to the low priority thread.
+   * The audio thread writes raw samples into a ring, and TransmitData() sends the newest MAXBUF of them, so nothing is queued or dropped */
   class Sender
   {
   public:
@@ -69,22 +73,7 @@ public:
    * @param inputs data to visualize **/
     void Process(sample* inputs)
     {
-      if(mBufCount == MAXBUF)
-      {
-        if(mPrevAboveThreshold)
-          mQueue.Push(mBuf); // TODO: expensive?
-        
-        mPrevAboveThreshold = mBuf.AboveThreshold();
-        
-        mBufCount = 0;
-      }
-      
-      for (auto c = 0; c < MAXNC; c++)
-      {
-        mBuf.vals[c][mBufCount] = (float) inputs[c];
-      }
-      
-      mBufCount++;
+      mRing.WriteFrame(inputs);
     }
 
   /** add a block of multichannel sample data to the queue. Will crash if size of inputs < MAXNC
@@ -92,44 +81,40 @@ public:
    * @param nFrames number of frames to process **/
     void ProcessBlock(sample** inputs, int nFrames)
     {
-      for (auto s = 0; s < nFrames; s++)
-      {
-        if(mBufCount == MAXBUF)
-        {
-          if(mPrevAboveThreshold)
-            mQueue.Push(mBuf); // TODO: expensive?
+      mRing.Write(inputs, nFrames);
+    }
 
-          mPrevAboveThreshold = mBuf.AboveThreshold();
+    /** Sends the latest MAXBUF frames via IEditorDelegate, if anything new has been written. This must be called on the main thread - typically in MyPlugin::OnIdle() */
+    void TransmitData(IEditorDelegate& dlg)
+    {
+      const uint64_t writePos = mRing.GetWritePosition();
 
-          mBufCount = 0;
-        }
+      if (writePos == mTransmittedPos || writePos < MAXBUF)
+        return;
 
-        for (auto c = 0; c < MAXNC; c++)
-        {
-          mBuf.vals[c][mBufCount] = (float) inputs[c][s];
-        }
+      float* pChans[MAXNC];
 
-        mBufCount++;
-      }
-    }
+      for (auto c = 0; c < MAXNC; c++)
+        pChans[c] = mBuf.vals[c];
 
-    /** Sends data in the queue via IEditorDelegate. This must be called on the main thread - typically in MyPlugin::OnIdle() */
-    void TransmitData(IEditorDelegate& dlg)
-    {
-      Data d;
+      if (!mRing.Read(writePos - MAXBUF, MAXBUF, pChans))
+        return; // overwritten while we read it, try again next time
 
-      while(mQueue.ElementsAvailable())
-      {
-        mQueue.Pop(d);
-        dlg.SendControlMsgFromDelegate(mControlTag, kUpdateMessage, sizeof(Data), (void*) &d);
-      }
+      mTransmittedPos = writePos;
+
+      const bool aboveThreshold = mBuf.AboveThreshold();
+
+      if (aboveThreshold || mPrevAboveThreshold) // send one silent buffer, then stop until there is signal
+        dlg.SendControlMsgFromDelegate(mControlTag, kUpdateMessage, sizeof(Data), (void*) &mBuf);
+
+      mPrevAboveThreshold = aboveThreshold;
     }
 
   private:
     Data mBuf;
     int mControlTag;
-    int mBufCount = 0;
-    IPlugQueue<Data> mQueue {QUEUE_SIZE};
+    uint64_t mTransmittedPos = 0;
+    IPlugSampleRing<float, MAXNC> mRing {RING_SIZE > 2 * MAXBUF ? RING_SIZE : 2 * MAXBUF};
     bool mPrevAboveThreshold = true;
   };
 
@@ -162,6 +147,43 @@ public:
 
     const float maxY = (r.H() / 2.f); // y +/- centre
 
+    const float pixelScale = g.GetDrawScale() * g.GetScreenScale();
+    const int nColumns = static_cast<int>(std::ceil(r.W() * pixelScale));
+
+    if (nColumns > 0 && nColumns < MAXBUF)
+    {
+      if (nColumns != mNColumns)
+        Decimate(nColumns);
+
+      const float colW = r.W() / (float) nColumns;
+      const float minH = 1.f / pixelScale;
+
+      for (int c = 0; c < mBuf.nchans; c++)
+      {
+        for (int col = 0; col < nColumns; col++)
+        {
+          float yHi = Clip(mColumnMax[c][col] * maxY, -maxY, maxY);
+          float yLo = Clip(mColumnMin[c][col] * maxY, -maxY, maxY);
+
+          // a flat column is still a pixel high
+          if (yHi - yLo < minH)
+          {
+            const float mid = (yHi + yLo) * 0.5f;
+            yHi = mid + minH * 0.5f;
+            yLo = mid - minH * 0.5f;
+          }
+
+          const float x = r.L + ((float) col + 0.5f) * colW;
+          g.PathMoveTo(x, r.MH() - yHi);
+          g.PathLineTo(x, r.MH() - yLo);
+        }
+
+        g.PathStroke(GetColor(kFG), colW);
+      }
+
+      return;
+    }
+
     float xPerData = r.W() / (float) MAXBUF;
 
     for (int c = 0; c < mBuf.nchans; c++)
@@ -204,11 +226,47 @@ public:
       }
     }
 
+    if (mNColumns)
+      Decimate(mNColumns);
+
     SetDirty(false);
   }
 
 private:
+  /** Find the lowest and highest sample in each of nColumns columns. Each column includes the first sample of the next one,
+   * so that neighbouring columns join up */
+  void Decimate(int nColumns)
+  {
+    mNColumns = nColumns;
+
+    for (int c = 0; c < mBuf.nchans; c++)
+    {
+      mColumnMin[c].resize(nColumns);
+      mColumnMax[c].resize(nColumns);
+
+      for (int col = 0; col < nColumns; col++)
+      {
+        const int start = col * MAXBUF / nColumns;
+        const int end = std::min(MAXBUF - 1, (col + 1) * MAXBUF / nColumns);
+        float lo = mBuf.vals[c][start];
+        float hi = lo;
+
+        for (int s = start + 1; s <= end; s++)
+        {
+          lo = std::min(lo, mBuf.vals[c][s]);
+          hi = std::max(hi, mBuf.vals[c][s]);
+        }
+
+        mColumnMin[c][col] = lo;
+        mColumnMax[c][col] = hi;
+      }
+    }
+  }
+
   Data mBuf;
+  std::vector<float> mColumnMin[MAXNC];
+  std::vector<float> mColumnMax[MAXNC];
+  int mNColumns = 0;
   float mPadding = 2.f;
 };
 
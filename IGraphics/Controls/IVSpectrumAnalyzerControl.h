@@ -0,0 +1,379 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @ingroup Controls
+ * @copydoc IVSpectrumAnalyzerControl
+ */
+
+#include <cmath>
+#include <vector>
+
+#include "IControl.h"
+#include "IPlugStructs.h"
+#include "IPlugSampleRing.h"
+#include "fft.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** Vectorial multichannel capable spectrum analyzer control
+ * The Sender only writes raw samples into a ring on the audio thread. The windowing, the FFT, the smoothing and the mapping of the bins
+ * onto a logarithmic frequency axis all happen on the main thread, and the spectrum is reduced to one value per pixel column before it is drawn.
+ * FFTSIZE must be a power of two from 16 to 32768. RING_SIZE is the number of frames buffered by the Sender, at least 2 * FFTSIZE.
+ * WDL/fft.c must be compiled into the project
+ * @ingroup IControls */
+template <int MAXNC = 1, int FFTSIZE = 2048, int RING_SIZE = 8192>
+class IVSpectrumAnalyzerControl : public IControl
+                                , public IVectorBase
+{
+public:
+  static constexpr int kUpdateMessage = 0;
+
+  /* Data packet */
+  struct Data
+  {
+    int nchans = MAXNC;
+    float sampleRate = 44100.f;
+    float vals[MAXNC][FFTSIZE] = {};
+  };
+
+  /** Used on the DSP side in order to pass sample values to the low priority thread.
+   * The audio thread writes raw samples into a ring, and TransmitData() sends the newest FFTSIZE of them, so nothing is queued or dropped */
+  class Sender
+  {
+  public:
+    Sender(int controlTag)
+    : mControlTag(controlTag)
+    {
+    }
+
+    /** Set the sample rate that the analyzer labels its frequencies with, typically in MyPlugin::OnReset() */
+    void SetSampleRate(double sampleRate)
+    {
+      mBuf.sampleRate = static_cast<float>(sampleRate);
+    }
+
+  /** add an array of multichannel sample data, one for each channel to the queue. Will crash if size of inputs < MAXNC
+   * @param inputs data to analyze **/
+    void Process(sample* inputs)
+    {
+      mRing.WriteFrame(inputs);
+    }
+
+  /** add a block of multichannel sample data to the queue. Will crash if size of inputs < MAXNC
+   * @param inputs data to analyze, typically multichannel non interleaved audio samples
+   * @param nFrames number of frames to process **/
+    void ProcessBlock(sample** inputs, int nFrames)
+    {
+      mRing.Write(inputs, nFrames);
+    }
+
+    /** Sends the latest FFTSIZE frames via IEditorDelegate, if anything new has been written. This must be called on the main thread - typically in MyPlugin::OnIdle() */
+    void TransmitData(IEditorDelegate& dlg)
+    {
+      const uint64_t writePos = mRing.GetWritePosition();
+
+      if (writePos == mTransmittedPos || writePos < FFTSIZE)
+        return;
+
+      float* pChans[MAXNC];
+
+      for (auto c = 0; c < MAXNC; c++)
+        pChans[c] = mBuf.vals[c];
+
+      if (!mRing.Read(writePos - FFTSIZE, FFTSIZE, pChans))
+        return; // overwritten while we read it, try again next time
+
+      mTransmittedPos = writePos;
+      dlg.SendControlMsgFromDelegate(mControlTag, kUpdateMessage, sizeof(Data), (void*) &mBuf);
+    }
+
+  private:
+    Data mBuf;
+    int mControlTag;
+    uint64_t mTransmittedPos = 0;
+    IPlugSampleRing<float, MAXNC> mRing {RING_SIZE > 2 * FFTSIZE ? RING_SIZE : 2 * FFTSIZE};
+  };
+
+  /** Constructs an IVSpectrumAnalyzerControl
+   * @param bounds The rectangular area that the control occupies
+   * @param label A CString to label the control
+   * @param style, /see IVStyle
+   * @param minFreq The frequency at the left edge, in Hz
+   * @param maxFreq The frequency at the right edge, in Hz, which is limited to half the sample rate
+   * @param minDB The level at the bottom edge, in dB
+   * @param maxDB The level at the top edge, in dB */
+  IVSpectrumAnalyzerControl(const IRECT& bounds, const char* label = "", const IVStyle& style = DEFAULT_STYLE,
+                            float minFreq = 20.f, float maxFreq = 20000.f, float minDB = -90.f, float maxDB = 0.f)
+  : IControl(bounds)
+  , IVectorBase(style)
+  , mMinFreq(minFreq)
+  , mMaxFreq(maxFreq)
+  , mMinDB(minDB)
+  , mMaxDB(maxDB)
+  {
+    static_assert(FFTSIZE >= 16 && FFTSIZE <= 32768 && (FFTSIZE & (FFTSIZE - 1)) == 0, "FFTSIZE must be a power of two from 16 to 32768");
+
+    AttachIControl(this, label);
+    WDL_fft_init();
+
+    // a Hann window, normalised so that a full scale sine reads 0dB. WDL_real_fft()'s output is twice the amplitude of the bins, which
+    // accounts for the negative frequencies
+    double windowSum = 0.;
+
+    for (auto s = 0; s < FFTSIZE; s++)
+    {
+      mWindow[s] = static_cast<float>(0.5 - 0.5 * std::cos(2. * PI * s / FFTSIZE));
+      windowSum += mWindow[s];
+    }
+
+    mScale = static_cast<float>(1. / windowSum);
+  }
+
+  void Draw(IGraphics& g) override
+  {
+    DrawBackGround(g, mRECT);
+    DrawWidget(g);
+    DrawLabel(g);
+
+    if(mStyle.drawFrame)
+      g.DrawRect(GetColor(kFR), mWidgetBounds, nullptr, mStyle.frameThickness);
+  }
+
+  void DrawWidget(IGraphics& g) override
+  {
+    const IRECT r = mWidgetBounds.GetPadded(-mPadding);
+
+    const float pixelScale = g.GetDrawScale() * g.GetScreenScale();
+    const int nColumns = static_cast<int>(std::ceil(r.W() * pixelScale));
+
+    if (nColumns <= 0 || !mHasSpectrum)
+      return;
+
+    if (nColumns != mNColumns)
+    {
+      mNColumns = nColumns;
+      MapColumns();
+      Decimate();
+    }
+
+    const float colW = r.W() / (float) nColumns;
+
+    for (int c = 0; c < mNChans; c++)
+    {
+      for (int col = 0; col < nColumns; col++)
+      {
+        const float norm = Clip((mColumns[c][col] - mMinDB) / (mMaxDB - mMinDB), 0.f, 1.f);
+        const float x = r.L + ((float) col + 0.5f) * colW;
+        const float y = r.B - norm * r.H();
+
+        if (col == 0)
+          g.PathMoveTo(x, y);
+        else
+          g.PathLineTo(x, y);
+      }
+
+      g.PathStroke(GetColor(c ? kX1 : kFG), mStyle.frameThickness);
+    }
+  }
+
+  void OnResize() override
+  {
+    SetTargetRECT(MakeRects(mRECT));
+    SetDirty(false);
+  }
+
+  void OnMsgFromDelegate(int messageTag, int dataSize, const void* pData) override
+  {
+    if (messageTag != kUpdateMessage || dataSize != sizeof(Data))
+      return;
+
+    const Data* pPacket = static_cast<const Data*>(pData);
+    const int nChans = Clip(pPacket->nchans, 0, MAXNC);
+
+    if (pPacket->sampleRate != mSampleRate)
+    {
+      mSampleRate = pPacket->sampleRate;
+      mHasSpectrum = false;
+      MapColumns();
+    }
+
+    for (int c = 0; c < nChans; c++)
+      Analyze(c, pPacket->vals[c], !mHasSpectrum || c >= mNChans);
+
+    mNChans = nChans;
+    mHasSpectrum = true;
+    Decimate();
+    SetDirty(false);
+  }
+
+  /** Set how slowly the spectrum follows the signal
+   * @param smoothing From 0, where each update replaces the previous spectrum, up to but not including 1 */
+  void SetSmoothing(float smoothing)
+  {
+    mSmoothing = Clip(smoothing, 0.f, 0.999f);
+  }
+
+  /** Set the frequency range of the horizontal axis, which is logarithmic
+   * @param minFreq The frequency at the left edge, in Hz
+   * @param maxFreq The frequency at the right edge, in Hz */
+  void SetFreqRange(float minFreq, float maxFreq)
+  {
+    mMinFreq = minFreq;
+    mMaxFreq = maxFreq;
+    MapColumns();
+    Decimate();
+    SetDirty(false);
+  }
+
+  /** Set the level range of the vertical axis
+   * @param minDB The level at the bottom edge, in dB
+   * @param maxDB The level at the top edge, in dB */
+  void SetDBRange(float minDB, float maxDB)
+  {
+    mMinDB = minDB;
+    mMaxDB = maxDB;
+    SetDirty(false);
+  }
+
+private:
+  static constexpr int kNBins = FFTSIZE / 2 + 1;
+
+  /* The bins that make up one pixel column. If the column is narrower than a bin, frac is used to interpolate between bins lo and lo + 1 */
+  struct ColumnBins
+  {
+    int lo = 0;
+    int hi = 0;
+    float frac = -1.f;
+  };
+
+  /** Window and transform one channel, then smooth its magnitude spectrum into mSpectrum
+   * @param reset \c true to replace rather than smooth the previous spectrum */
+  void Analyze(int ch, const float* pSamples, bool reset)
+  {
+    for (auto s = 0; s < FFTSIZE; s++)
+      mFFTBuf[s] = pSamples[s] * mWindow[s];
+
+    WDL_real_fft(mFFTBuf, FFTSIZE, 0);
+
+    const WDL_FFT_COMPLEX* pBins = reinterpret_cast<const WDL_FFT_COMPLEX*>(mFFTBuf);
+    const int* pPermute = WDL_fft_permute_tab(FFTSIZE / 2);
+    float* pSpectrum = mSpectrum[ch];
+
+    for (auto k = 0; k < kNBins; k++)
+    {
+      float mag;
+
+      if (k == 0)
+        mag = std::fabs(pBins[0].re) * 0.5f; // DC and Nyquist are real, and not doubled
+      else if (k == FFTSIZE / 2)
+        mag = std::fabs(pBins[0].im) * 0.5f;
+      else
+      {
+        const WDL_FFT_COMPLEX& bin = pBins[pPermute[k]];
+        mag = std::sqrt(bin.re * bin.re + bin.im * bin.im);
+      }
+
+      mag *= mScale;
+      pSpectrum[k] = reset ? mag : mag + mSmoothing * (pSpectrum[k] - mag);
+    }
+  }
+
+  /** Work out which bins each pixel column covers, whenever the width, the sample rate or the frequency range change */
+  void MapColumns()
+  {
+    if (!mNColumns)
+      return;
+
+    mColumnBins.resize(mNColumns);
+
+    const float binHz = mSampleRate / FFTSIZE;
+    const float maxFreq = std::min(mMaxFreq, mSampleRate * 0.5f);
+    const float minFreq = std::max(std::min(mMinFreq, maxFreq * 0.5f), binHz * 0.5f);
+    const float ratio = std::log(maxFreq / minFreq);
+
+    auto colToBin = [&](float col) {
+      return minFreq * std::exp(ratio * col / mNColumns) / binHz;
+    };
+
+    for (int col = 0; col < mNColumns; col++)
+    {
+      const float k0 = colToBin((float) col);
+      const float k1 = colToBin((float) col + 1.f);
+      ColumnBins& bins = mColumnBins[col];
+
+      if (k1 - k0 >= 1.f)
+      {
+        bins.lo = Clip(static_cast<int>(std::ceil(k0)), 0, kNBins - 1);
+        bins.hi = Clip(static_cast<int>(std::floor(k1)), bins.lo, kNBins - 1);
+        bins.frac = -1.f;
+      }
+      else
+      {
+        const float kc = 0.5f * (k0 + k1);
+        bins.lo = Clip(static_cast<int>(kc), 0, kNBins - 2);
+        bins.frac = Clip(kc - bins.lo, 0.f, 1.f);
+      }
+    }
+  }
+
+  /** Reduce the spectrum to one level in dB for each pixel column, the loudest bin for columns that span several bins */
+  void Decimate()
+  {
+    if (!mNColumns || !mHasSpectrum)
+      return;
+
+    for (int c = 0; c < mNChans; c++)
+    {
+      mColumns[c].resize(mNColumns);
+      const float* pSpectrum = mSpectrum[c];
+
+      for (int col = 0; col < mNColumns; col++)
+      {
+        const ColumnBins& bins = mColumnBins[col];
+        float mag;
+
+        if (bins.frac < 0.f)
+        {
+          mag = pSpectrum[bins.lo];
+
+          for (int k = bins.lo + 1; k <= bins.hi; k++)
+            mag = std::max(mag, pSpectrum[k]);
+        }
+        else
+          mag = pSpectrum[bins.lo] + bins.frac * (pSpectrum[bins.lo + 1] - pSpectrum[bins.lo]);
+
+        mColumns[c][col] = static_cast<float>(AmpToDB(std::max(mag, 1e-9f)));
+      }
+    }
+  }
+
+  WDL_FFT_REAL mFFTBuf[FFTSIZE];
+  float mWindow[FFTSIZE];
+  float mSpectrum[MAXNC][kNBins] = {};
+  std::vector<float> mColumns[MAXNC];
+  std::vector<ColumnBins> mColumnBins;
+  float mScale = 1.f;
+  float mSampleRate = 44100.f;
+  float mSmoothing = 0.7f;
+  float mMinFreq, mMaxFreq;
+  float mMinDB, mMaxDB;
+  int mNColumns = 0;
+  int mNChans = 0;
+  bool mHasSpectrum = false;
+  float mPadding = 2.f;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
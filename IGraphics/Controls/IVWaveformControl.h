@@ -0,0 +1,559 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @ingroup Controls
+ * @copydoc IVWaveformControl
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "IControl.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** A pyramid of the minimum, maximum and sum of squares of blocks of audio, from which the peaks and RMS of any range can be read by looking
+ * at a few blocks rather than every sample. Level 0 summarises kBaseBinSize frames per bin, and each level above combines kLevelFactor bins
+ * of the one below, so the pyramid is about a 200th of the size of the audio it summarises */
+class IWaveformSummary
+{
+public:
+  static constexpr int kBaseBinSize = 256;
+  static constexpr int kLevelFactor = 4;
+
+  struct Bin
+  {
+    float mMin = 0.f;
+    float mMax = 0.f;
+    float mSumSquares = 0.f;
+  };
+
+  /** The peaks and RMS of the audio under a pixel column */
+  struct Column
+  {
+    float mMin = 0.f;
+    float mMax = 0.f;
+    float mRMS = 0.f;
+    bool mValid = false; // \c false past the end of the audio
+  };
+
+  /** Copies frames of one channel of the audio
+   * @param chan The channel
+   * @param start The first frame
+   * @param nFrames The number of frames, which are all within the audio
+   * @param pDest Filled with nFrames samples */
+  using ReadFunc = std::function<void(int chan, int64_t start, int nFrames, float* pDest)>;
+
+  /** Change the size of the audio, keeping the bins of the frames that are still there. The bins of new frames are empty until they are set
+   * @param nChans The number of channels, changing it clears every bin
+   * @param nFrames The number of frames */
+  void Resize(int nChans, int64_t nFrames)
+  {
+    if (nChans != mNChans)
+    {
+      mLevels.clear();
+      mNChans = std::max(nChans, 0);
+    }
+
+    mNFrames = std::max<int64_t>(nFrames, 0);
+
+    int nLevels = 1;
+
+    while (NBins(nLevels - 1) > 1)
+      nLevels++;
+
+    mLevels.resize(nLevels);
+
+    for (auto level = 0; level < nLevels; level++)
+      mLevels[level].resize(static_cast<size_t>(NBins(level)) * mNChans);
+  }
+
+  int NChans() const { return mNChans; }
+  int64_t NFrames() const { return mNFrames; }
+  int NLevels() const { return static_cast<int>(mLevels.size()); }
+
+  /** @return The number of frames a bin of a level summarises */
+  static int64_t BinSize(int level)
+  {
+    int64_t size = kBaseBinSize;
+
+    for (auto l = 0; l < level; l++)
+      size *= kLevelFactor;
+
+    return size;
+  }
+
+  /** @return The number of bins in a level */
+  int64_t NBins(int level) const { return (mNFrames + BinSize(level) - 1) / BinSize(level); }
+
+  /** Summarise a range of level 0 bins from the audio. This only reads the audio, so it can run on a background thread
+   * @param read The function to read the audio with
+   * @param nChans The number of channels
+   * @param nFrames The number of frames in the audio
+   * @param firstBin The first bin
+   * @param lastBin The last bin, inclusive
+   * @param bins Filled with the bins, a channel at a time for each bin */
+  static void ComputeBins(const ReadFunc& read, int nChans, int64_t nFrames, int64_t firstBin, int64_t lastBin, std::vector<Bin>& bins)
+  {
+    bins.resize(static_cast<size_t>(std::max<int64_t>(lastBin - firstBin + 1, 0)) * nChans);
+
+    float buf[kBaseBinSize];
+
+    for (auto b = firstBin; b <= lastBin; b++)
+    {
+      const int64_t start = b * kBaseBinSize;
+      const int n = static_cast<int>(std::min<int64_t>(kBaseBinSize, nFrames - start));
+
+      for (auto c = 0; c < nChans; c++)
+      {
+        Bin& bin = bins[static_cast<size_t>(b - firstBin) * nChans + c];
+        bin = Bin();
+
+        if (n <= 0)
+          continue;
+
+        read(c, start, n, buf);
+        bin.mMin = bin.mMax = buf[0];
+
+        for (auto s = 0; s < n; s++)
+        {
+          bin.mMin = std::min(bin.mMin, buf[s]);
+          bin.mMax = std::max(bin.mMax, buf[s]);
+          bin.mSumSquares += buf[s] * buf[s];
+        }
+      }
+    }
+  }
+
+  /** Store level 0 bins made by ComputeBins() and update the levels above them. Bins past the end of the audio are ignored
+   * @param firstBin The first bin
+   * @param bins The bins, a channel at a time for each bin */
+  void SetBins(int64_t firstBin, const std::vector<Bin>& bins)
+  {
+    if (!mNChans || bins.empty())
+      return;
+
+    const int64_t nBins = static_cast<int64_t>(bins.size()) / mNChans;
+    const int64_t lastBin = std::min(firstBin + nBins, NBins(0)) - 1;
+
+    if (lastBin < firstBin)
+      return;
+
+    std::copy(bins.begin(), bins.begin() + static_cast<size_t>(lastBin - firstBin + 1) * mNChans, mLevels[0].begin() + static_cast<size_t>(firstBin) * mNChans);
+    UpdateLevels(firstBin, lastBin);
+  }
+
+  /** Read the peaks and RMS under a row of pixel columns, in time proportional to the number of columns. Below kBaseBinSize frames per column
+   * the audio is read, otherwise the level with the largest bins that are no larger than a column is used
+   * @param read The function to read the audio with, when zoomed in
+   * @param start The frame at the left edge of the first column
+   * @param framesPerColumn The number of frames each column covers, which may be less than 1
+   * @param nColumns The number of columns
+   * @param columns Filled with the columns, a channel at a time for each column
+   * @param scratch Used to read the audio */
+  void GetColumns(const ReadFunc& read, double start, double framesPerColumn, int nColumns, std::vector<Column>& columns, std::vector<float>& scratch) const
+  {
+    columns.assign(static_cast<size_t>(std::max(nColumns, 0)) * mNChans, Column());
+
+    if (!mNChans || nColumns <= 0 || framesPerColumn <= 0.)
+      return;
+
+    if (framesPerColumn < kBaseBinSize)
+    {
+      // each column includes the first frame of the next one, so that neighbouring columns join up
+      const int64_t first = std::max<int64_t>(static_cast<int64_t>(std::floor(start)), 0);
+      const int64_t end = std::min<int64_t>(static_cast<int64_t>(std::floor(start + framesPerColumn * nColumns)) + 2, mNFrames);
+
+      if (end <= first || !read)
+        return;
+
+      const int n = static_cast<int>(end - first);
+      scratch.resize(n);
+
+      for (auto c = 0; c < mNChans; c++)
+      {
+        read(c, first, n, scratch.data());
+
+        for (auto col = 0; col < nColumns; col++)
+        {
+          const int64_t a = static_cast<int64_t>(std::floor(start + col * framesPerColumn)) - first;
+          const int64_t b = static_cast<int64_t>(std::floor(start + (col + 1) * framesPerColumn)) - first;
+
+          if (a < 0 || a >= n)
+            continue;
+
+          Column& column = columns[static_cast<size_t>(col) * mNChans + c];
+          const int64_t last = std::min<int64_t>(std::max(b, a + 1), n - 1);
+          float sumSquares = 0.f;
+          column.mMin = column.mMax = scratch[a];
+
+          for (auto s = a; s <= last; s++)
+          {
+            column.mMin = std::min(column.mMin, scratch[s]);
+            column.mMax = std::max(column.mMax, scratch[s]);
+          }
+
+          for (auto s = a; s < std::max(b, a + 1) && s < n; s++)
+            sumSquares += scratch[s] * scratch[s];
+
+          column.mRMS = std::sqrt(sumSquares / static_cast<float>(std::max<int64_t>(std::min<int64_t>(std::max(b, a + 1), n) - a, 1)));
+          column.mValid = true;
+        }
+      }
+
+      return;
+    }
+
+    int level = 0;
+
+    while (level + 1 < NLevels() && BinSize(level + 1) <= framesPerColumn)
+      level++;
+
+    const int64_t binSize = BinSize(level);
+    const int64_t nBins = NBins(level);
+    const std::vector<Bin>& bins = mLevels[level];
+
+    for (auto col = 0; col < nColumns; col++)
+    {
+      const int64_t a = static_cast<int64_t>(start + col * framesPerColumn);
+      const int64_t b = static_cast<int64_t>(start + (col + 1) * framesPerColumn);
+
+      if (a < 0 || a >= mNFrames)
+        continue;
+
+      const int64_t firstBin = a / binSize;
+      const int64_t lastBin = std::max(firstBin, std::min((b - 1) / binSize, nBins - 1));
+      const double nFrames = static_cast<double>(std::min((lastBin + 1) * binSize, mNFrames) - firstBin * binSize);
+
+      for (auto c = 0; c < mNChans; c++)
+      {
+        Column& column = columns[static_cast<size_t>(col) * mNChans + c];
+        const Bin& firstBinData = bins[static_cast<size_t>(firstBin) * mNChans + c];
+        column.mMin = firstBinData.mMin;
+        column.mMax = firstBinData.mMax;
+        double sumSquares = 0.;
+
+        for (auto i = firstBin; i <= lastBin; i++)
+        {
+          const Bin& bin = bins[static_cast<size_t>(i) * mNChans + c];
+          column.mMin = std::min(column.mMin, bin.mMin);
+          column.mMax = std::max(column.mMax, bin.mMax);
+          sumSquares += bin.mSumSquares;
+        }
+
+        column.mRMS = static_cast<float>(std::sqrt(sumSquares / nFrames));
+        column.mValid = true;
+      }
+    }
+  }
+
+  /** @return The memory used by the bins, in bytes */
+  size_t GetMemoryUsage() const
+  {
+    size_t size = 0;
+
+    for (auto& level : mLevels)
+      size += level.capacity() * sizeof(Bin);
+
+    return size;
+  }
+
+private:
+  /** Recombine the bins of the levels above a range of level 0 bins */
+  void UpdateLevels(int64_t firstBin, int64_t lastBin)
+  {
+    for (auto level = 1; level < NLevels(); level++)
+    {
+      const std::vector<Bin>& below = mLevels[level - 1];
+      std::vector<Bin>& bins = mLevels[level];
+      const int64_t nBelow = NBins(level - 1);
+
+      firstBin /= kLevelFactor;
+      lastBin /= kLevelFactor;
+
+      for (auto b = firstBin; b <= lastBin; b++)
+      {
+        const int64_t childEnd = std::min((b + 1) * kLevelFactor, nBelow);
+
+        for (auto c = 0; c < mNChans; c++)
+        {
+          Bin bin = below[static_cast<size_t>(b * kLevelFactor) * mNChans + c];
+
+          for (auto child = b * kLevelFactor + 1; child < childEnd; child++)
+          {
+            const Bin& childBin = below[static_cast<size_t>(child) * mNChans + c];
+            bin.mMin = std::min(bin.mMin, childBin.mMin);
+            bin.mMax = std::max(bin.mMax, childBin.mMax);
+            bin.mSumSquares += childBin.mSumSquares;
+          }
+
+          bins[static_cast<size_t>(b) * mNChans + c] = bin;
+        }
+      }
+    }
+  }
+
+  int mNChans = 0;
+  int64_t mNFrames = 0;
+  std::vector<std::vector<Bin>> mLevels; // for each level, the bins a channel at a time
+};
+
+/** Vectorial multichannel waveform overview, for showing minutes of audio, e.g. in a sampler or an editor. Each channel is drawn in its own lane
+ * as the peaks and the RMS under each pixel column, read from an IWaveformSummary, so drawing takes time proportional to the width of the control
+ * at any zoom. The summary is built on a background thread, see IGraphics::RunInBackground(), and only the frames that change are summarised
+ * again, so recording or editing the audio costs time proportional to the change. The control reads the audio with a ReadFunc, which must be safe
+ * to call on a background thread for the frames that aren't being written
+ * @ingroup IControls */
+class IVWaveformControl : public IControl
+                        , public IVectorBase
+{
+public:
+  using ReadFunc = IWaveformSummary::ReadFunc;
+
+  /** Ranges of up to this many frames are summarised on the main thread when they are drawn, larger ones in the background */
+  static constexpr int64_t kSyncFrames = 1 << 16;
+
+  /** Constructs an IVWaveformControl
+   * @param bounds The rectangular area that the control occupies
+   * @param label A CString to label the control
+   * @param style, /see IVStyle */
+  IVWaveformControl(const IRECT& bounds, const char* label = "", const IVStyle& style = DEFAULT_STYLE)
+  : IControl(bounds)
+  , IVectorBase(style)
+  {
+    AttachIControl(this, label);
+    mIgnoreMouse = true;
+  }
+
+  /** Show new audio, which is summarised when it is next drawn. Call on the main thread
+   * @param read The function to read the audio with, or nullptr to show nothing
+   * @param nChans The number of channels
+   * @param nFrames The number of frames */
+  void SetAudio(ReadFunc read, int nChans, int64_t nFrames)
+  {
+    mReadFunc = read;
+    mGeneration++;
+    mSummary.Resize(0, 0);
+    mSummary.Resize(read ? nChans : 0, nFrames);
+    mDirtyStart = 0;
+    mDirtyEnd = mSummary.NFrames();
+    SetDirty(false);
+  }
+
+  /** Change the length of the audio, e.g. as it is recorded. Frames past the previous length are summarised. Call on the main thread
+   * @param nFrames The number of frames */
+  void SetLength(int64_t nFrames)
+  {
+    const int64_t prevFrames = mSummary.NFrames();
+    mSummary.Resize(mSummary.NChans(), nFrames);
+
+    // the last bin of the previous length was partly empty
+    if (nFrames > prevFrames)
+      InvalidateRange(prevFrames - prevFrames % IWaveformSummary::kBaseBinSize, nFrames);
+    else
+      InvalidateRange(nFrames - nFrames % IWaveformSummary::kBaseBinSize, nFrames);
+  }
+
+  /** Summarise frames again after they have been edited. Call on the main thread
+   * @param start The first frame that changed
+   * @param end The frame after the last one that changed */
+  void InvalidateRange(int64_t start, int64_t end)
+  {
+    start = std::max<int64_t>(start, 0);
+    end = std::min(end, mSummary.NFrames());
+
+    if (end <= start)
+      return;
+
+    if (mDirtyEnd <= mDirtyStart)
+    {
+      mDirtyStart = start;
+      mDirtyEnd = end;
+    }
+    else
+    {
+      mDirtyStart = std::min(mDirtyStart, start);
+      mDirtyEnd = std::max(mDirtyEnd, end);
+    }
+
+    SetDirty(false);
+  }
+
+  /** Zoom into part of the audio
+   * @param start The frame at the left edge
+   * @param nFrames The number of frames across the control, or 0 to show all of the audio */
+  void SetView(double start, double nFrames)
+  {
+    mViewStart = std::max(start, 0.);
+    mViewFrames = std::max(nFrames, 0.);
+    SetDirty(false);
+  }
+
+  double GetViewStart() const { return mViewStart; }
+  double GetViewFrames() const { return mViewFrames > 0. ? mViewFrames : static_cast<double>(mSummary.NFrames()); }
+
+  /** @param show \c true to draw the RMS of each column inside its peaks */
+  void SetShowRMS(bool show) { mShowRMS = show; SetDirty(false); }
+
+  /** @return \c true while the summary is being built in the background */
+  bool IsSummarizing() const { return mSummarizing; }
+
+  const IWaveformSummary& GetSummary() const { return mSummary; }
+
+  void Draw(IGraphics& g) override
+  {
+    DrawBackGround(g, mRECT);
+    DrawWidget(g);
+    DrawLabel(g);
+
+    if (mStyle.drawFrame)
+      g.DrawRect(GetColor(kFR), mWidgetBounds, nullptr, mStyle.frameThickness);
+  }
+
+  void DrawWidget(IGraphics& g) override
+  {
+    UpdateSummary(g);
+
+    const IRECT r = mWidgetBounds.GetPadded(-mPadding);
+    const int nChans = mSummary.NChans();
+    const float pixelScale = g.GetDrawScale() * g.GetScreenScale();
+    const int nColumns = static_cast<int>(std::ceil(r.W() * pixelScale));
+
+    if (!nChans || nColumns <= 0 || !mSummary.NFrames())
+      return;
+
+    mSummary.GetColumns(mReadFunc, mViewStart, GetViewFrames() / nColumns, nColumns, mColumns, mScratch);
+
+    const float colW = r.W() / (float) nColumns;
+    const float minH = 1.f / pixelScale;
+
+    for (auto c = 0; c < nChans; c++)
+    {
+      const IRECT lane = r.SubRectVertical(nChans, c);
+      const float maxY = lane.H() / 2.f;
+
+      g.DrawHorizontalLine(GetColor(kSH), lane, 0.5, nullptr, mStyle.frameThickness);
+
+      for (auto pass = 0; pass < (mShowRMS ? 2 : 1); pass++)
+      {
+        for (auto col = 0; col < nColumns; col++)
+        {
+          const IWaveformSummary::Column& column = mColumns[static_cast<size_t>(col) * nChans + c];
+
+          if (!column.mValid)
+            continue;
+
+          float yHi = Clip(column.mMax * maxY, -maxY, maxY);
+          float yLo = Clip(column.mMin * maxY, -maxY, maxY);
+
+          if (pass)
+          {
+            // the RMS is drawn around the centre, inside the peaks
+            yHi = std::min(yHi, Clip(column.mRMS * maxY, 0.f, maxY));
+            yLo = std::max(yLo, -yHi);
+          }
+
+          // a flat column is still a pixel high
+          if (yHi - yLo < minH)
+          {
+            const float mid = (yHi + yLo) * 0.5f;
+            yHi = mid + minH * 0.5f;
+            yLo = mid - minH * 0.5f;
+          }
+
+          const float x = r.L + ((float) col + 0.5f) * colW;
+          g.PathMoveTo(x, lane.MH() - yHi);
+          g.PathLineTo(x, lane.MH() - yLo);
+        }
+
+        g.PathStroke(GetColor(pass ? kX1 : kFG), colW);
+      }
+    }
+  }
+
+  void OnResize() override
+  {
+    SetTargetRECT(MakeRects(mRECT));
+    SetDirty(false);
+  }
+
+private:
+  /** Summarise the frames that have changed, on the main thread if there are few of them, otherwise in the background.
+   * Frames that change while a job runs are summarised by the next one */
+  void UpdateSummary(IGraphics& g)
+  {
+    if (mSummarizing || !mReadFunc || mDirtyEnd <= mDirtyStart)
+      return;
+
+    const int64_t firstBin = mDirtyStart / IWaveformSummary::kBaseBinSize;
+    const int64_t lastBin = (mDirtyEnd - 1) / IWaveformSummary::kBaseBinSize;
+    mDirtyStart = mDirtyEnd = 0;
+
+    const int nChans = mSummary.NChans();
+    const int64_t nFrames = mSummary.NFrames();
+
+    if ((lastBin - firstBin + 1) * IWaveformSummary::kBaseBinSize <= kSyncFrames)
+    {
+      IWaveformSummary::ComputeBins(mReadFunc, nChans, nFrames, firstBin, lastBin, mBins);
+      mSummary.SetBins(firstBin, mBins);
+      return;
+    }
+
+    auto pBins = std::make_shared<std::vector<IWaveformSummary::Bin>>();
+    const ReadFunc read = mReadFunc;
+    const int generation = mGeneration;
+    std::weak_ptr<bool> alive = mAlive;
+    mSummarizing = true;
+
+    g.RunInBackground([read, nChans, nFrames, firstBin, lastBin, pBins]() {
+      IWaveformSummary::ComputeBins(read, nChans, nFrames, firstBin, lastBin, *pBins);
+    },
+    [this, alive, generation, firstBin, pBins]() {
+      if (alive.expired())
+        return;
+
+      mSummarizing = false;
+
+      // bins of audio that was replaced while they were computed are dropped
+      if (generation == mGeneration)
+        mSummary.SetBins(firstBin, *pBins);
+
+      SetDirty(false);
+    });
+  }
+
+  IWaveformSummary mSummary;
+  ReadFunc mReadFunc = nullptr;
+  int64_t mDirtyStart = 0; // the frames that need summarising, none if mDirtyEnd <= mDirtyStart
+  int64_t mDirtyEnd = 0;
+  double mViewStart = 0.;
+  double mViewFrames = 0.;
+  bool mShowRMS = true;
+  bool mSummarizing = false;
+  int mGeneration = 0; // bumped by SetAudio(), so that a job summarising the previous audio is discarded
+  std::vector<IWaveformSummary::Column> mColumns;
+  std::vector<IWaveformSummary::Bin> mBins;
+  std::vector<float> mScratch;
+  float mPadding = 2.f;
+  std::shared_ptr<bool> mAlive = std::make_shared<bool>(true); // lets a background job tell whether the control still exists when it finishes
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
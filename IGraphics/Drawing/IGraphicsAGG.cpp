@@ -218,6 +218,14 @@ IGraphicsAGG::~IGraphicsAGG()
   storage.Release();
 }
 
+void IGraphicsAGG::GetMemoryReport(IMemoryReport& report) const
+{
+  IGraphicsPathBase::GetMemoryReport(report);
+
+  StaticStorage<IFontData>::Accessor storage(sFontCache);
+  report.AddShared("Font cache", storage.GetMemoryUsage([](const IFontData& font) { return static_cast<size_t>(font.GetSize()); }), storage.GetCount());
+}
+
 void IGraphicsAGG::DrawResize()
 {
   mPixelMap.create(WindowWidth() * GetScreenScale(), WindowHeight() * GetScreenScale());
@@ -255,6 +263,14 @@ bool IGraphicsAGG::LoadAPIFont(const char* fontID, const PlatformFontPtr& font)
   return false;
 }
 
+bool IGraphicsAGG::LoadCachedAPIFont(const char* fontID)
+{
+  StaticStorage<IFontData>::Accessor storage(sFontCache);
+  IFontData* cached = storage.Find(fontID);
+  
+  return cached && SetFont(fontID, cached);
+}
+
 bool CheckTransform(const agg::trans_affine& mtx)
 {
   if (!agg::is_equal_eps(mtx.tx - std::round(mtx.tx), 0.0, 1e-3))
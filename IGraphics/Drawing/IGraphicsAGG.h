@@ -232,6 +232,8 @@ public:
 
   const char* GetDrawingAPIStr() override { return "AGG"; }
 
+  void GetMemoryReport(IMemoryReport& report) const override;
+
   void DrawResize() override;
 
   void DrawBitmap(const IBitmap& bitmap, const IRECT& dest, int srcX, int srcY, const IBlend* pBlend) override;
@@ -260,6 +262,7 @@ protected:
   APIBitmap* CreateAPIBitmap(int width, int height, int scale, double drawScale) override;
 
   bool LoadAPIFont(const char* fontID, const PlatformFontPtr& font) override;
+  bool LoadCachedAPIFont(const char* fontID) override;
 
   int AlphaChannel() const override { return PixelOrder().A; }
   bool FlippedBitmap() const override { return false; }
@@ -8,7 +8,10 @@
  ==============================================================================
 */
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <vector>
 
 #include "png.h"
 
@@ -20,12 +23,108 @@ using namespace igraphics;
 
 #pragma mark - Private Classes and Structs
 
+/** Keeps the image surfaces of released layers to reuse for later layers of the same size bucket, so that layers redrawn every frame don't
+ * allocate and page in a new surface each time */
+class IGraphicsCairo::SurfacePool
+{
+public:
+  SurfacePool() {}
+  
+  ~SurfacePool()
+  {
+    for (auto pSurface : mSurfaces)
+      cairo_surface_destroy(pSurface);
+  }
+  
+  SurfacePool(const SurfacePool&) = delete;
+  SurfacePool& operator=(const SurfacePool&) = delete;
+
+  /** @return A transparent image surface of at least width by height pixels, reused from the pool if possible */
+  cairo_surface_t* Acquire(cairo_surface_t* pSurfaceType, int width, int height)
+  {
+    width = Bucket(width);
+    height = Bucket(height);
+    
+    for (auto it = mSurfaces.rbegin(); it != mSurfaces.rend(); ++it)
+    {
+      cairo_surface_t* pSurface = *it;
+      
+      if (cairo_image_surface_get_width(pSurface) == width && cairo_image_surface_get_height(pSurface) == height)
+      {
+        mSurfaces.erase(std::next(it).base());
+        mBytes -= GetBytes(pSurface);
+        
+        cairo_surface_flush(pSurface);
+        memset(cairo_image_surface_get_data(pSurface), 0, GetBytes(pSurface));
+        cairo_surface_mark_dirty(pSurface);
+        return pSurface;
+      }
+    }
+    
+    if (pSurfaceType)
+      return cairo_surface_create_similar_image(pSurfaceType, CAIRO_FORMAT_ARGB32, width, height);
+    else
+      return cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+  }
+  
+  /** Return a surface from Acquire() to the pool, discarding the oldest surfaces once the pool holds more than kMaxBytes */
+  void Release(cairo_surface_t* pSurface)
+  {
+    // a pattern or snapshot may still reference it
+    if (cairo_surface_get_reference_count(pSurface) > 1 || cairo_surface_status(pSurface) != CAIRO_STATUS_SUCCESS)
+    {
+      cairo_surface_destroy(pSurface);
+      return;
+    }
+    
+    mSurfaces.push_back(pSurface);
+    mBytes += GetBytes(pSurface);
+    
+    while (mBytes > kMaxBytes)
+    {
+      mBytes -= GetBytes(mSurfaces.front());
+      cairo_surface_destroy(mSurfaces.front());
+      mSurfaces.erase(mSurfaces.begin());
+    }
+  }
+  
+  /** @return The size of the pooled surfaces in bytes */
+  size_t GetMemoryUsage() const { return mBytes; }
+
+private:
+  static constexpr int kBucketSize = 32;
+  static constexpr size_t kMaxBytes = 32 * 1024 * 1024;
+  
+  static int Bucket(int size) { return std::max(1, (size + kBucketSize - 1) / kBucketSize) * kBucketSize; }
+  
+  static size_t GetBytes(cairo_surface_t* pSurface)
+  {
+    return static_cast<size_t>(cairo_image_surface_get_stride(pSurface)) * cairo_image_surface_get_height(pSurface);
+  }
+  
+  std::vector<cairo_surface_t*> mSurfaces; // oldest first
+  size_t mBytes = 0;
+};
+
 class IGraphicsCairo::Bitmap : public APIBitmap
 {
 public:
   Bitmap(cairo_surface_t* pSurface, int scale, float drawScale);
-  Bitmap(cairo_surface_t* pSurfaceType, int width, int height, int scale, float drawScale);
+  Bitmap(cairo_surface_t* pSurfaceType, const std::shared_ptr<SurfacePool>& pool, int width, int height, int scale, float drawScale);
   virtual ~Bitmap();
+  
+  /** Keep successively halved copies of the surface, down to a single pixel, see IGraphics::SetBitmapMipmaps() */
+  void GenerateMips();
+  
+  /** @param pixelsPerUnitX The device pixels per user space unit the bitmap is drawn at horizontally
+   * @param pixelsPerUnitY The device pixels per user space unit the bitmap is drawn at vertically
+   * @return The smallest copy of the surface with at least as many pixels per unit, or the surface itself if it has no mipmaps.
+   * Each copy has a device scale that makes it cover the same user space as the surface */
+  cairo_surface_t* GetMip(double pixelsPerUnitX, double pixelsPerUnitY) const;
+  
+private:
+  std::shared_ptr<SurfacePool> mPool;
+  std::vector<cairo_surface_t*> mMips;
 };
 
 IGraphicsCairo::Bitmap::Bitmap(cairo_surface_t* pSurface, int scale, float drawScale)
@@ -37,14 +136,11 @@ IGraphicsCairo::Bitmap::Bitmap(cairo_surface_t* pSurface, int scale, float drawS
   SetBitmap(pSurface, width, height, scale, drawScale);
 }
 
-IGraphicsCairo::Bitmap::Bitmap(cairo_surface_t* pSurfaceType, int width, int height, int scale, float drawScale)
+IGraphicsCairo::Bitmap::Bitmap(cairo_surface_t* pSurfaceType, const std::shared_ptr<SurfacePool>& pool, int width, int height, int scale, float drawScale)
+: mPool(pool)
 {
-  cairo_surface_t* pSurface;
-  
-  if (pSurfaceType)
-    pSurface = cairo_surface_create_similar_image(pSurfaceType, CAIRO_FORMAT_ARGB32, width, height);
-  else
-    pSurface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+  // the surface may be larger than the bitmap, layers are clipped to their bounds
+  cairo_surface_t* pSurface = mPool->Acquire(pSurfaceType, width, height);
   
   cairo_surface_set_device_scale(pSurface, scale * drawScale, scale * drawScale);
   
@@ -53,7 +149,65 @@ IGraphicsCairo::Bitmap::Bitmap(cairo_surface_t* pSurfaceType, int width, int hei
 
 IGraphicsCairo::Bitmap::~Bitmap()
 {
-  cairo_surface_destroy(GetBitmap());
+  for (auto pMip : mMips)
+    cairo_surface_destroy(pMip);
+  
+  if (mPool)
+    mPool->Release(GetBitmap());
+  else
+    cairo_surface_destroy(GetBitmap());
+}
+
+void IGraphicsCairo::Bitmap::GenerateMips()
+{
+  cairo_surface_t* pSrc = GetBitmap();
+  const double deviceScale = GetScale() * GetDrawScale();
+  int w = GetWidth();
+  int h = GetHeight();
+  
+  cairo_surface_flush(pSrc);
+  
+  while (w > 1 || h > 1)
+  {
+    const int mipW = std::max(w / 2, 1);
+    const int mipH = std::max(h / 2, 1);
+    cairo_surface_t* pMip = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, mipW, mipH);
+    
+    if (cairo_surface_status(pMip) != CAIRO_STATUS_SUCCESS)
+    {
+      cairo_surface_destroy(pMip);
+      return;
+    }
+    
+    const uint32_t* pSrcPixels = reinterpret_cast<const uint32_t*>(cairo_image_surface_get_data(pSrc));
+    uint32_t* pDstPixels = reinterpret_cast<uint32_t*>(cairo_image_surface_get_data(pMip));
+    HalveBitmapPixels(pSrcPixels, w, h, cairo_image_surface_get_stride(pSrc) / 4, pDstPixels, cairo_image_surface_get_stride(pMip) / 4, true);
+    cairo_surface_mark_dirty(pMip);
+    cairo_surface_set_device_scale(pMip, deviceScale * mipW / GetWidth(), deviceScale * mipH / GetHeight());
+    
+    mMips.push_back(pMip);
+    pSrc = pMip;
+    w = mipW;
+    h = mipH;
+  }
+}
+
+cairo_surface_t* IGraphicsCairo::Bitmap::GetMip(double pixelsPerUnitX, double pixelsPerUnitY) const
+{
+  cairo_surface_t* pMip = GetBitmap();
+  
+  for (auto pLevel : mMips)
+  {
+    double scaleX, scaleY;
+    cairo_surface_get_device_scale(pLevel, &scaleX, &scaleY);
+    
+    if (scaleX < pixelsPerUnitX || scaleY < pixelsPerUnitY)
+      break;
+    
+    pMip = pLevel;
+  }
+  
+  return pMip;
 }
 
 class IGraphicsCairo::Font
@@ -155,6 +309,7 @@ IGraphicsCairo::IGraphicsCairo(IGEditorDelegate& dlg, int w, int h, int fps, flo
 : IGraphicsPathBase(dlg, w, h, fps, scale)
 , mSurface(nullptr)
 , mContext(nullptr)
+, mSurfacePool(std::make_shared<SurfacePool>())
 {
   DBGMSG("IGraphics Cairo @ %i FPS\n", fps);
   
@@ -204,12 +359,60 @@ APIBitmap* IGraphicsCairo::LoadAPIBitmap(const char* fileNameOrResID, int scale,
 
   assert(!pSurface || cairo_surface_status(pSurface) == CAIRO_STATUS_SUCCESS);
 
-  return new Bitmap(pSurface, scale, 1.f);
+  Bitmap* pBitmap = new Bitmap(pSurface, scale, 1.f);
+  
+  if (GetBitmapMipmaps() && pSurface && cairo_surface_status(pSurface) == CAIRO_STATUS_SUCCESS)
+    pBitmap->GenerateMips();
+  
+  return pBitmap;
 }
 
 APIBitmap* IGraphicsCairo::CreateAPIBitmap(int width, int height, int scale, double drawScale)
 {
-  return new Bitmap(mSurface, width, height, scale, drawScale);
+  return new Bitmap(mSurface, mSurfacePool, width, height, scale, drawScale);
+}
+
+APIBitmap* IGraphicsCairo::CreateAPIBitmapFromPixels(const uint8_t* pRGBA, int width, int height, int scale)
+{
+  cairo_surface_t* pSurface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+
+  if (cairo_surface_status(pSurface) != CAIRO_STATUS_SUCCESS)
+  {
+    cairo_surface_destroy(pSurface);
+    return nullptr;
+  }
+
+  cairo_surface_flush(pSurface);
+  uint8_t* pData = cairo_image_surface_get_data(pSurface);
+  const int stride = cairo_image_surface_get_stride(pSurface);
+
+  // Cairo's pixels are premultiplied, in native-endian 32-bit words
+  for (int y = 0; y < height; y++)
+  {
+    const uint8_t* pSrc = pRGBA + y * width * 4;
+    uint32_t* pDst = reinterpret_cast<uint32_t*>(pData + y * stride);
+
+    for (int x = 0; x < width; x++, pSrc += 4)
+    {
+      const uint32_t a = pSrc[3];
+      pDst[x] = (a << 24) | (((pSrc[0] * a + 127) / 255) << 16) | (((pSrc[1] * a + 127) / 255) << 8) | ((pSrc[2] * a + 127) / 255);
+    }
+  }
+
+  cairo_surface_mark_dirty(pSurface);
+
+  Bitmap* pBitmap = new Bitmap(pSurface, scale, 1.f);
+
+  if (GetBitmapMipmaps())
+    pBitmap->GenerateMips();
+
+  return pBitmap;
+}
+
+void IGraphicsCairo::GetMemoryReport(IMemoryReport& report) const
+{
+  IGraphicsPathBase::GetMemoryReport(report);
+  report.Add("Layer surface pool", mSurfacePool->GetMemoryUsage());
 }
 
 bool IGraphicsCairo::BitmapExtSupported(const char* ext)
@@ -293,7 +496,11 @@ void IGraphicsCairo::DrawBitmap(const IBitmap& bitmap, const IRECT& dest, int sr
   cairo_save(mContext);
   cairo_rectangle(mContext, dest.L, dest.T, dest.W(), dest.H());
   cairo_clip(mContext);
-  cairo_surface_t* surface = bitmap.GetAPIBitmap()->GetBitmap();
+  double unitX = 1.0, unitY = 0.0;
+  double unitYX = 0.0, unitYY = 1.0;
+  cairo_user_to_device_distance(mContext, &unitX, &unitY);
+  cairo_user_to_device_distance(mContext, &unitYX, &unitYY);
+  cairo_surface_t* surface = static_cast<const Bitmap*>(bitmap.GetAPIBitmap())->GetMip(std::hypot(unitX, unitY), std::hypot(unitYX, unitYY));
   cairo_set_source_surface(mContext, surface, dest.L - srcX, dest.T - srcY);
   cairo_set_operator(mContext, CairoBlendMode(pBlend));
   cairo_paint_with_alpha(mContext, BlendWeight(pBlend));
@@ -405,6 +612,12 @@ void IGraphicsCairo::SetCairoSourcePattern(cairo_t* context, const IPattern& pat
     case EPatternType::Linear:
     case EPatternType::Radial:
     {
+      if (const CairoPatternPtr* pCached = mGradientCache.Find(pattern, BlendWeight(pBlend)))
+      {
+        cairo_set_source(context, pCached->get());
+        break;
+      }
+
       cairo_pattern_t* cairoPattern;
       cairo_matrix_t matrix;
       const IMatrix& m = pattern.mTransform;
@@ -431,7 +644,7 @@ void IGraphicsCairo::SetCairoSourcePattern(cairo_t* context, const IPattern& pat
       cairo_matrix_init(&matrix, m.mXX, m.mYX, m.mXY, m.mYY, m.mTX, m.mTY);
       cairo_pattern_set_matrix(cairoPattern, &matrix);
       cairo_set_source(context, cairoPattern);
-      cairo_pattern_destroy(cairoPattern);
+      mGradientCache.Add(CairoPatternPtr(cairoPattern, cairo_pattern_destroy));
     }
     break;
   }
@@ -679,6 +892,12 @@ bool IGraphicsCairo::LoadAPIFont(const char* fontID, const PlatformFontPtr& font
   return false;
 }
 
+bool IGraphicsCairo::LoadCachedAPIFont(const char* fontID)
+{
+  StaticStorage<Font>::Accessor storage(sFontCache);
+  return storage.Find(fontID) != nullptr;
+}
+
 void IGraphicsCairo::PathTransformSetMatrix(const IMatrix& m)
 {
   double xTranslate = 0.0;
@@ -33,6 +33,7 @@
 #endif
 
 #include "IGraphicsPathBase.h"
+#include "IGraphicsPatternCache.h"
 
 BEGIN_IPLUG_NAMESPACE
 BEGIN_IGRAPHICS_NAMESPACE
@@ -43,6 +44,7 @@ class IGraphicsCairo : public IGraphicsPathBase
 {
 private:
   class Bitmap;
+  class SurfacePool;
   class Font;
   struct OSFont;
 #ifdef OS_WIN
@@ -54,6 +56,8 @@ public:
 
   const char* GetDrawingAPIStr() override { return "CAIRO"; }
 
+  void GetMemoryReport(IMemoryReport& report) const override;
+
   void DrawBitmap(const IBitmap& bitmap, const IRECT& dest, int srcX, int srcY, const IBlend* pBlend) override;
       
   void PathClear() override;
@@ -78,8 +82,10 @@ public:
 protected:
   APIBitmap* LoadAPIBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext) override;
   APIBitmap* CreateAPIBitmap(int width, int height, int scale, double drawScale) override;
+  APIBitmap* CreateAPIBitmapFromPixels(const uint8_t* pRGBA, int width, int height, int scale) override;
 
   bool LoadAPIFont(const char* fontID, const PlatformFontPtr& font) override;
+  bool LoadCachedAPIFont(const char* fontID) override;
     
   int AlphaChannel() const override { return 3; }
   bool FlippedBitmap() const override { return false; }
@@ -108,6 +114,10 @@ private:
     
   cairo_t* mContext;
   cairo_surface_t* mSurface;
+  std::shared_ptr<SurfacePool> mSurfacePool; // shared with the layer bitmaps, which may outlive this class
+
+  using CairoPatternPtr = std::shared_ptr<cairo_pattern_t>;
+  IPatternCache<CairoPatternPtr> mGradientCache; // patterns made by SetCairoSourcePattern() for gradients
 
   static StaticStorage<Font> sFontCache;
 };
@@ -26,27 +26,223 @@ extern IGraphicsWeb* gGraphics;
 extern val GetPreloadedImages();
 extern val GetCanvas();
 
+// The renderer replays the command buffer on the canvases it owns, on the main thread or in a worker. The host lives on the main thread
+// and forwards to a renderer, posting to the worker when there is one. This source is also the worker's script
+static const char* kCanvasRendererJS = R"JS(
+var IGraphicsCanvasRenderer = (function() {
+  var kComposite = ['source-over', 'source-in', 'source-out', 'source-atop', 'destination-over', 'destination-in', 'destination-out', 'destination-atop', 'lighter', 'xor'];
+  var kLineCap = ['butt', 'round', 'square'];
+  var kLineJoin = ['miter', 'round', 'bevel'];
+
+  function color(ops, i) { return 'rgba(' + ops[i] + ',' + ops[i + 1] + ',' + ops[i + 2] + ',' + ops[i + 3] + ')'; }
+
+  function Renderer() { this.objects = {}; this.contexts = {}; }
+
+  Renderer.prototype.register = function(id, obj) { this.objects[id] = obj; delete this.contexts[id]; };
+
+  Renderer.prototype.createCanvas = function(id, w, h) {
+    var canvas = (typeof document !== 'undefined') ? document.createElement('canvas') : new OffscreenCanvas(w, h);
+    canvas.width = w;
+    canvas.height = h;
+    this.register(id, canvas);
+    return canvas;
+  };
+
+  Renderer.prototype.resize = function(id, w, h) {
+    var canvas = this.objects[id];
+    if (canvas) { canvas.width = w; canvas.height = h; }
+  };
+
+  Renderer.prototype.release = function(ids) {
+    for (var i = 0; i < ids.length; i++) { delete this.objects[ids[i]]; delete this.contexts[ids[i]]; }
+  };
+
+  Renderer.prototype.context = function(id) {
+    var ctx = this.contexts[id];
+    if (!ctx && this.objects[id])
+      ctx = this.contexts[id] = this.objects[id].getContext('2d');
+    return ctx;
+  };
+
+  Renderer.prototype.replay = function(ops, strings) {
+    var ctx = this.context(0), gradient = null, n = ops.length, i = 0;
+    while (i < n) {
+      switch (ops[i++]) {
+        case 0: ctx = this.context(ops[i++]); break;
+        case 1: ctx.save(); break;
+        case 2: ctx.restore(); break;
+        case 3: ctx.beginPath(); break;
+        case 4: ctx.closePath(); break;
+        case 5: ctx.arc(ops[i], ops[i + 1], ops[i + 2], ops[i + 3], ops[i + 4], ops[i + 5] != 0); i += 6; break;
+        case 6: ctx.moveTo(ops[i], ops[i + 1]); i += 2; break;
+        case 7: ctx.lineTo(ops[i], ops[i + 1]); i += 2; break;
+        case 8: ctx.bezierCurveTo(ops[i], ops[i + 1], ops[i + 2], ops[i + 3], ops[i + 4], ops[i + 5]); i += 6; break;
+        case 9: ctx.quadraticCurveTo(ops[i], ops[i + 1], ops[i + 2], ops[i + 3]); i += 4; break;
+        case 10: ctx.rect(ops[i], ops[i + 1], ops[i + 2], ops[i + 3]); i += 4; break;
+        case 11: ctx.clip(); break;
+        case 12:
+          var nDashes = ops[i + 5];
+          ctx.lineCap = kLineCap[ops[i]];
+          ctx.lineJoin = kLineJoin[ops[i + 1]];
+          ctx.miterLimit = ops[i + 2];
+          ctx.lineWidth = ops[i + 3];
+          ctx.setLineDash(Array.from(ops.subarray(i + 6, i + 6 + nDashes)));
+          ctx.lineDashOffset = ops[i + 4];
+          ctx.stroke();
+          i += 6 + nDashes;
+          break;
+        case 13: ctx.fill(ops[i++] ? 'evenodd' : 'nonzero'); break;
+        case 14: ctx.globalCompositeOperation = kComposite[ops[i++]]; break;
+        case 15: ctx.globalAlpha = ops[i++]; break;
+        case 16: ctx.fillStyle = ctx.strokeStyle = color(ops, i); i += 4; break;
+        case 17: gradient = ctx.createLinearGradient(ops[i], ops[i + 1], ops[i + 2], ops[i + 3]); i += 4; break;
+        case 18: gradient = ctx.createRadialGradient(ops[i], ops[i + 1], 0, ops[i], ops[i + 1], ops[i + 2]); i += 3; break;
+        case 19: gradient.addColorStop(ops[i], color(ops, i + 1)); i += 5; break;
+        case 20: ctx.fillStyle = ctx.strokeStyle = gradient; break;
+        case 21:
+          var image = this.objects[ops[i]];
+          if (image)
+            ctx.drawImage(image, ops[i + 1], ops[i + 2], ops[i + 3], ops[i + 4], ops[i + 5], ops[i + 6], ops[i + 7], ops[i + 8]);
+          i += 9;
+          break;
+        case 22: ctx.setTransform(ops[i], ops[i + 1], ops[i + 2], ops[i + 3], ops[i + 4], ops[i + 5]); i += 6; break;
+        case 23: ctx.font = strings[ops[i++]]; break;
+        case 24: ctx.textBaseline = 'alphabetic'; ctx.fillText(strings[ops[i]], ops[i + 1], ops[i + 2]); i += 3; break;
+        case 25: ctx.clearRect(ops[i], ops[i + 1], ops[i + 2], ops[i + 3]); i += 4; break;
+      }
+    }
+  };
+
+  function Host(canvas, useWorker, source) {
+    this.worker = null;
+    this.pending = 0;
+    this.released = [];
+
+    if (useWorker && canvas.transferControlToOffscreen && typeof Worker !== 'undefined') {
+      try {
+        var script = source + '\nvar renderer = new IGraphicsCanvasRenderer.Renderer();\n' +
+                     'onmessage = function(e) { renderer[e.data.method].apply(renderer, e.data.args); };\n';
+        var worker = new Worker(URL.createObjectURL(new Blob([script], { type: 'text/javascript' })));
+        var offscreen = canvas.transferControlToOffscreen();
+        worker.postMessage({ method: 'register', args: [0, offscreen] }, [offscreen]);
+        this.worker = worker;
+      }
+      catch (e) {
+        console.log('IGraphicsCanvas: rendering on the main thread, ' + e);
+      }
+    }
+
+    if (!this.worker) {
+      this.renderer = new Renderer();
+      this.renderer.register(0, canvas);
+    }
+  }
+
+  Host.prototype.post = function(method, args, transfer) { this.worker.postMessage({ method: method, args: args }, transfer || []); };
+
+  Host.prototype.register = function(id, obj) {
+    if (!this.worker)
+      return this.renderer.register(id, obj);
+
+    var self = this;
+    self.pending++;
+    createImageBitmap(obj).then(function(bitmap) { self.post('register', [id, bitmap], [bitmap]); self.pending--; },
+                                function() { self.pending--; });
+  };
+
+  Host.prototype.createCanvas = function(id, w, h) {
+    if (!this.worker)
+      return this.renderer.createCanvas(id, w, h);
+
+    this.post('createCanvas', [id, w, h]);
+    return { width: w, height: h };
+  };
+
+  Host.prototype.resize = function(id, w, h) {
+    if (this.worker)
+      this.post('resize', [id, w, h]);
+    else
+      this.renderer.resize(id, w, h);
+  };
+
+  // Objects are released after the commands that may still draw them have been replayed
+  Host.prototype.release = function(id) { this.released.push(id); };
+
+  Host.prototype.replay = function(ops, bytes) {
+    var strings = bytes.length ? new TextDecoder().decode(bytes.slice()).split('\0') : [];
+    var released = this.released;
+    this.released = [];
+
+    if (this.worker) {
+      var copy = ops.slice();
+      this.post('replay', [copy, strings], [copy.buffer]);
+      if (released.length)
+        this.post('release', [released]);
+    }
+    else {
+      this.renderer.replay(ops, strings);
+      this.renderer.release(released);
+    }
+  };
+
+  return { Renderer: Renderer, Host: Host };
+})();
+)JS";
+
+static val CanvasHost()
+{
+  static val* sHost = nullptr;
+  
+  if (!sHost)
+  {
+#ifdef IGRAPHICS_CANVAS_WORKER
+    const bool useWorker = true;
+#else
+    const bool useWorker = false;
+#endif
+    // An indirect eval, so the renderer is defined in the global scope
+    val::global("eval")(std::string(kCanvasRendererJS));
+    sHost = new val(val::global("IGraphicsCanvasRenderer")["Host"].new_(GetCanvas(), useWorker, std::string(kCanvasRendererJS)));
+  }
+  
+  return *sHost;
+}
+
 class IGraphicsCanvas::Bitmap : public APIBitmap
 {
 public:
   Bitmap(val imageCanvas, const char* name, int scale)
+  : mID(NextID())
   {
+    CanvasHost().call<void>("register", mID, imageCanvas);
     SetBitmap(new val(imageCanvas), imageCanvas["width"].as<int>(), imageCanvas["height"].as<int>(), scale, 1.f);
   }
   
   Bitmap(int width, int height, int scale, float drawScale)
+  : mID(NextID())
   {
-    val canvas = val::global("document").call<val>("createElement", std::string("canvas"));
-    canvas.set("width", width);
-    canvas.set("height", height);
+    val canvas = CanvasHost().call<val>("createCanvas", mID, width, height);
     
     SetBitmap(new val(canvas), width, height, scale, drawScale);
   }
   
   virtual ~Bitmap()
   {
+    CanvasHost().call<void>("release", mID);
     delete GetBitmap();
   }
+  
+  /** @return The id the renderer knows this bitmap by, 0 is the main canvas */
+  int GetID() const { return mID; }
+  
+private:
+  static int NextID()
+  {
+    static int sNextID = 1;
+    return sNextID++;
+  }
+  
+  const int mID;
 };
 
 struct IGraphicsCanvas::Font
@@ -70,22 +266,16 @@ static std::string GetFontString(const char* fontName, const char* styleName, do
 
 StaticStorage<IGraphicsCanvas::Font> IGraphicsCanvas::sFontCache;
 
-#pragma mark - Utilities
-
-static std::string CanvasColor(const IColor& color, float alpha = 1.0)
-{
-  WDL_String str;
-  str.SetFormatted(64, "rgba(%d, %d, %d, %lf)", color.R, color.G, color.B, alpha * color.A / 255.0);
-  return str.Get();
-}
-
 #pragma mark -
 
 IGraphicsCanvas::IGraphicsCanvas(IGEditorDelegate& dlg, int w, int h, int fps, float scale)
 : IGraphicsPathBase(dlg, w, h, fps, scale)
+, mMeasureContext(val::global("document").call<val>("createElement", std::string("canvas")).call<val>("getContext", std::string("2d")))
 {
   StaticStorage<Font>::Accessor storage(sFontCache);
   storage.Retain();
+  
+  mInWorker = !CanvasHost()["worker"].isNull();
 }
 
 IGraphicsCanvas::~IGraphicsCanvas()
@@ -94,91 +284,126 @@ IGraphicsCanvas::~IGraphicsCanvas()
   storage.Release();
 }
 
+#pragma mark - Command buffer
+
+int IGraphicsCanvas::DrawTarget() const
+{
+  return mLayers.empty() ? 0 : static_cast<const Bitmap*>(mLayers.top()->GetAPIBitmap())->GetID();
+}
+
+void IGraphicsCanvas::Record(int target, ECommand command, std::initializer_list<float> args)
+{
+  if (target != mTarget)
+  {
+    mCommands.push_back(static_cast<float>(ECommand::Target));
+    mCommands.push_back(static_cast<float>(target));
+    mTarget = target;
+  }
+  
+  mCommands.push_back(static_cast<float>(command));
+  mCommands.insert(mCommands.end(), args.begin(), args.end());
+}
+
+float IGraphicsCanvas::AddString(const std::string& str)
+{
+  mStrings.append(str);
+  mStrings.push_back('\0');
+  return static_cast<float>(mNStrings++);
+}
+
+void IGraphicsCanvas::FlushCommands()
+{
+  if (mCommands.empty())
+    return;
+  
+  const unsigned char* pStrings = reinterpret_cast<const unsigned char*>(mStrings.data());
+  
+  CanvasHost().call<void>("replay", val(typed_memory_view(mCommands.size(), mCommands.data())), val(typed_memory_view(mStrings.size(), pStrings)));
+  
+  mCommands.clear();
+  mStrings.clear();
+  mNStrings = 0;
+  mTarget = 0;
+}
+
+void IGraphicsCanvas::EndFrame()
+{
+  FlushCommands();
+}
+
+void IGraphicsCanvas::DrawResize()
+{
+  FlushCommands();
+  CanvasHost().call<void>("resize", 0, static_cast<int>(Width() * GetBackingPixelScale()), static_cast<int>(Height() * GetBackingPixelScale()));
+}
+
+#pragma mark - Drawing
+
 void IGraphicsCanvas::DrawBitmap(const IBitmap& bitmap, const IRECT& bounds, int srcX, int srcY, const IBlend* pBlend)
 {
-  val context = GetContext();
-  val img = *bitmap.GetAPIBitmap()->GetBitmap();
-  context.call<void>("save");
-  SetCanvasBlendMode(context, pBlend);
-  context.set("globalAlpha", BlendWeight(pBlend));
+  const int target = DrawTarget();
+  const int id = static_cast<const Bitmap*>(bitmap.GetAPIBitmap())->GetID();
+  Record(target, ECommand::Save);
+  SetCanvasBlendMode(target, pBlend);
+  Record(target, ECommand::Alpha, { BlendWeight(pBlend) });
     
   const float bs = bitmap.GetScale();
   IRECT sr = bounds;
   sr.Scale(bs * bitmap.GetDrawScale());
 
   PathRect(bounds);
-  context.call<void>("clip");
-  context.call<void>("drawImage", img, srcX * bs, srcY * bs, sr.W(), sr.H(), bounds.L, bounds.T, bounds.W(), bounds.H());
-  GetContext().call<void>("restore");
+  Record(target, ECommand::Clip);
+  Record(target, ECommand::DrawImage, { static_cast<float>(id), srcX * bs, srcY * bs, sr.W(), sr.H(), bounds.L, bounds.T, bounds.W(), bounds.H() });
+  Record(target, ECommand::Restore);
 }
 
 void IGraphicsCanvas::PathClear()
 {
-  GetContext().call<void>("beginPath");
+  Emit(ECommand::BeginPath);
 }
 
 void IGraphicsCanvas::PathClose()
 {
-  GetContext().call<void>("closePath");
+  Emit(ECommand::ClosePath);
 }
 
 void IGraphicsCanvas::PathArc(float cx, float cy, float r, float a1, float a2, EWinding winding)
 {
-  GetContext().call<void>("arc", cx, cy, r, DegToRad(a1 - 90.f), DegToRad(a2 - 90.f), winding == EWinding::CCW);
+  Emit(ECommand::Arc, { cx, cy, r, DegToRad(a1 - 90.f), DegToRad(a2 - 90.f), winding == EWinding::CCW ? 1.f : 0.f });
 }
 
 void IGraphicsCanvas::PathMoveTo(float x, float y)
 {
-  GetContext().call<void>("moveTo", x, y);
+  Emit(ECommand::MoveTo, { x, y });
 }
 
 void IGraphicsCanvas::PathLineTo(float x, float y)
 {
-  GetContext().call<void>("lineTo", x, y);
+  Emit(ECommand::LineTo, { x, y });
 }
 
 void IGraphicsCanvas::PathCubicBezierTo(float c1x, float c1y, float c2x, float c2y, float x2, float y2)
 {
-  GetContext().call<void>("bezierCurveTo", c1x, c1y, c2x, c2y, x2, y2);
+  Emit(ECommand::BezierTo, { c1x, c1y, c2x, c2y, x2, y2 });
 }
 
 void IGraphicsCanvas::PathQuadraticBezierTo(float cx, float cy, float x2, float y2)
 {
-  GetContext().call<void>("quadraticCurveTo", cx, cy, x2, y2);
+  Emit(ECommand::QuadraticTo, { cx, cy, x2, y2 });
 }
 
 void IGraphicsCanvas::PathStroke(const IPattern& pattern, float thickness, const IStrokeOptions& options, const IBlend* pBlend)
 {
-  val context = GetContext();
+  const int target = DrawTarget();
+  const int nDashes = options.mDash.GetCount();
   
-  switch (options.mCapOption)
-  {
-    case ELineCap::Butt: context.set("lineCap", "butt"); break;
-    case ELineCap::Round: context.set("lineCap", "round"); break;
-    case ELineCap::Square: context.set("lineCap", "square"); break;
-  }
+  SetCanvasSourcePattern(target, pattern, pBlend);
   
-  switch (options.mJoinOption)
-  {
-    case ELineJoin::Miter: context.set("lineJoin", "miter"); break;
-    case ELineJoin::Round: context.set("lineJoin", "round"); break;
-    case ELineJoin::Bevel: context.set("lineJoin", "bevel"); break;
-  }
+  Record(target, ECommand::Stroke, { static_cast<float>(options.mCapOption), static_cast<float>(options.mJoinOption), options.mMiterLimit,
+                                     thickness, options.mDash.GetOffset(), static_cast<float>(nDashes) });
   
-  context.set("miterLimit", options.mMiterLimit);
-    
-  val dashArray = val::array();
-  
-  for (int i = 0; i < options.mDash.GetCount(); i++)
-    dashArray.call<void>("push", val(*(options.mDash.GetArray() + i)));
-  
-  context.call<void>("setLineDash", dashArray);
-  context.set("lineDashOffset", options.mDash.GetOffset());
-  context.set("lineWidth", thickness);
-  
-  SetCanvasSourcePattern(context, pattern, pBlend);
-
-  context.call<void>("stroke");
+  for (int i = 0; i < nDashes; i++)
+    mCommands.push_back(*(options.mDash.GetArray() + i));
   
   if (!options.mPreserve)
     PathClear();
@@ -186,30 +411,26 @@ void IGraphicsCanvas::PathStroke(const IPattern& pattern, float thickness, const
 
 void IGraphicsCanvas::PathFill(const IPattern& pattern, const IFillOptions& options, const IBlend* pBlend)
 {
-  val context = GetContext();
-  std::string fillRule(options.mFillRule == EFillRule::Winding ? "nonzero" : "evenodd");
+  const int target = DrawTarget();
   
-  SetCanvasSourcePattern(context, pattern, pBlend);
-
-  context.call<void>("fill", fillRule);
+  SetCanvasSourcePattern(target, pattern, pBlend);
+  Record(target, ECommand::Fill, { options.mFillRule == EFillRule::Winding ? 0.f : 1.f });
 
   if (!options.mPreserve)
     PathClear();
 }
 
-void IGraphicsCanvas::SetCanvasSourcePattern(val& context, const IPattern& pattern, const IBlend* pBlend)
+void IGraphicsCanvas::SetCanvasSourcePattern(int target, const IPattern& pattern, const IBlend* pBlend)
 {
-  SetCanvasBlendMode(context, pBlend);
+  SetCanvasBlendMode(target, pBlend);
   
   switch (pattern.mType)
   {
     case EPatternType::Solid:
     {
       const IColor color = pattern.GetStop(0).mColor;
-      std::string colorString = CanvasColor(color, BlendWeight(pBlend));
-
-      context.set("fillStyle", colorString);
-      context.set("strokeStyle", colorString);
+      
+      Record(target, ECommand::Color, { static_cast<float>(color.R), static_cast<float>(color.G), static_cast<float>(color.B), BlendWeight(pBlend) * color.A / 255.f });
     }
     break;
       
@@ -220,46 +441,50 @@ void IGraphicsCanvas::SetCanvasSourcePattern(val& context, const IPattern& patte
       IMatrix m = IMatrix(pattern.mTransform).Invert();
       m.TransformPoint(x, y, 0.0, 1.0);
         
-      val gradient = (pattern.mType == EPatternType::Linear) ?
-        context.call<val>("createLinearGradient", m.mTX, m.mTY, x, y) :
-        context.call<val>("createRadialGradient", m.mTX, m.mTY, 0.0, m.mTX, m.mTY, m.mXX);
+      if (pattern.mType == EPatternType::Linear)
+        Record(target, ECommand::LinearGradient, { static_cast<float>(m.mTX), static_cast<float>(m.mTY), static_cast<float>(x), static_cast<float>(y) });
+      else
+        Record(target, ECommand::RadialGradient, { static_cast<float>(m.mTX), static_cast<float>(m.mTY), static_cast<float>(m.mXX) });
       
       for (int i = 0; i < pattern.NStops(); i++)
       {
         const IColorStop& stop = pattern.GetStop(i);
-        gradient.call<void>("addColorStop", stop.mOffset, CanvasColor(stop.mColor));
+        const IColor& color = stop.mColor;
+        
+        Record(target, ECommand::ColorStop, { stop.mOffset, static_cast<float>(color.R), static_cast<float>(color.G), static_cast<float>(color.B), color.A / 255.f });
       }
       
-      context.set("fillStyle", gradient);
-      context.set("strokeStyle", gradient);
+      Record(target, ECommand::GradientStyle);
     }
     break;
   }
 }
 
-void IGraphicsCanvas::SetCanvasBlendMode(val& context, const IBlend* pBlend)
+void IGraphicsCanvas::SetCanvasBlendMode(int target, const IBlend* pBlend)
 {
-  if (!pBlend)
-    context.set("globalCompositeOperation", "source-over");
+  // The index into the renderer's table of globalCompositeOperation values
+  int operation = 0;
   
-  switch (pBlend->mMethod)
+  switch (pBlend ? pBlend->mMethod : EBlend::Default)
   {
     case EBlend::Default:       // fall through
     case EBlend::Clobber:       // fall through
-    case EBlend::SourceOver:    context.set("globalCompositeOperation", "source-over");        break;
-    case EBlend::SourceIn:      context.set("globalCompositeOperation", "source-in");          break;
-    case EBlend::SourceOut:     context.set("globalCompositeOperation", "source-out");         break;
-    case EBlend::SourceAtop:    context.set("globalCompositeOperation", "source-atop");        break;
-    case EBlend::DestOver:      context.set("globalCompositeOperation", "destination-over");   break;
-    case EBlend::DestIn:        context.set("globalCompositeOperation", "destination-in");     break;
-    case EBlend::DestOut:       context.set("globalCompositeOperation", "destination-out");    break;
-    case EBlend::DestAtop:      context.set("globalCompositeOperation", "destination-atop");   break;
-    case EBlend::Add:           context.set("globalCompositeOperation", "lighter");            break;
-    case EBlend::XOR:           context.set("globalCompositeOperation", "xor");                break;
+    case EBlend::SourceOver:    operation = 0;    break;
+    case EBlend::SourceIn:      operation = 1;    break;
+    case EBlend::SourceOut:     operation = 2;    break;
+    case EBlend::SourceAtop:    operation = 3;    break;
+    case EBlend::DestOver:      operation = 4;    break;
+    case EBlend::DestIn:        operation = 5;    break;
+    case EBlend::DestOut:       operation = 6;    break;
+    case EBlend::DestAtop:      operation = 7;    break;
+    case EBlend::Add:           operation = 8;    break;
+    case EBlend::XOR:           operation = 9;    break;
   }
+  
+  Record(target, ECommand::Composite, { static_cast<float>(operation) });
 }
 
-void IGraphicsCanvas::PrepareAndMeasureText(const IText& text, const char* str, IRECT& r, double& x, double & y) const
+void IGraphicsCanvas::PrepareAndMeasureText(const IText& text, const char* str, IRECT& r, double& x, double & y, std::string& fontString) const
 {
   StaticStorage<Font>::Accessor storage(sFontCache);
   Font* pFont = storage.Find(text.mFont);
@@ -267,8 +492,8 @@ void IGraphicsCanvas::PrepareAndMeasureText(const IText& text, const char* str,
   assert(pFont && "No font found - did you forget to load it?");
   
   FontDescriptor descriptor = &pFont->mDescriptor;
-  val context = GetContext();
-  std::string fontString = GetFontString(descriptor->first.Get(), descriptor->second.Get(), text.mSize * pFont->mEMRatio);
+  val context = mMeasureContext;
+  fontString = GetFontString(descriptor->first.Get(), descriptor->second.Get(), text.mSize * pFont->mEMRatio);
   
   context.set("font", fontString);
   
@@ -298,22 +523,23 @@ void IGraphicsCanvas::DoMeasureText(const IText& text, const char* str, IRECT& b
 {
   IRECT r = bounds;
   double x, y;
-  PrepareAndMeasureText(text, str, bounds, x, y);
+  std::string fontString;
+  PrepareAndMeasureText(text, str, bounds, x, y, fontString);
   DoMeasureTextRotation(text, r, bounds);
 }
 
 void IGraphicsCanvas::DoDrawText(const IText& text, const char* str, const IRECT& bounds, const IBlend* pBlend)
 {
   IRECT measured = bounds;
-  val context = GetContext();
   double x, y;
+  std::string fontString;
   
-  PrepareAndMeasureText(text, str, measured, x, y);
+  PrepareAndMeasureText(text, str, measured, x, y, fontString);
   PathTransformSave();
   DoTextRotation(text, bounds, measured);
-  context.set("textBaseline", std::string("alphabetic"));
-  SetCanvasSourcePattern(context, text.mFGColor, pBlend);
-  context.call<void>("fillText", std::string(str), x, y);
+  Emit(ECommand::Font, { AddString(fontString) });
+  SetCanvasSourcePattern(DrawTarget(), text.mFGColor, pBlend);
+  Emit(ECommand::Text, { AddString(str), static_cast<float>(x), static_cast<float>(y) });
   PathTransformRestore();
 }
 
@@ -322,20 +548,20 @@ void IGraphicsCanvas::PathTransformSetMatrix(const IMatrix& m)
   const double scale = GetBackingPixelScale();
   IMatrix t = IMatrix().Scale(scale, scale).Translate(XTranslate(), YTranslate()).Transform(m);
 
-  GetContext().call<void>("setTransform", t.mXX, t.mYX, t.mXY, t.mYY, t.mTX, t.mTY);
+  Emit(ECommand::Transform, { static_cast<float>(t.mXX), static_cast<float>(t.mYX), static_cast<float>(t.mXY),
+                              static_cast<float>(t.mYY), static_cast<float>(t.mTX), static_cast<float>(t.mTY) });
 }
 
 void IGraphicsCanvas::SetClipRegion(const IRECT& r)
 {
-  val context = GetContext();
-  context.call<void>("restore");
-  context.call<void>("save");
+  Emit(ECommand::Restore);
+  Emit(ECommand::Save);
   if (!r.Empty())
   {
-    context.call<void>("beginPath");
-    context.call<void>("rect", r.L, r.T, r.W(), r.H());
-    context.call<void>("clip");
-    context.call<void>("beginPath");
+    Emit(ECommand::BeginPath);
+    Emit(ECommand::Rect, { r.L, r.T, r.W(), r.H() });
+    Emit(ECommand::Clip);
+    Emit(ECommand::BeginPath);
   }
 }
 
@@ -390,7 +616,7 @@ bool IGraphicsCanvas::CompareFontMetrics(const char* style, const char* font1, c
 {
   WDL_String fontCombination;
   fontCombination.SetFormatted(FONT_LEN * 2 + 2, "%s, %s", font1, font2);
-  val context = GetContext();
+  val context = mMeasureContext;
   std::string textString("@BmwdWMoqPYyzZr1234567890.+-=_~'");
   const int size = 72;
     
@@ -480,6 +706,19 @@ bool IGraphicsCanvas::LoadAPIFont(const char* fontID, const PlatformFontPtr& fon
 
 bool IGraphicsCanvas::AssetsLoaded()
 {
+  // Bitmaps are sent to the worker asynchronously, and anything drawn before they arrive is redrawn
+  if (CanvasHost()["pending"].as<int>())
+  {
+    mWaitingForBitmaps = true;
+    return false;
+  }
+  
+  if (mWaitingForBitmaps)
+  {
+    mWaitingForBitmaps = false;
+    SetAllControlsDirty();
+  }
+  
   for (auto it = mCustomFonts.begin(); it != mCustomFonts.end(); it++)
   {
     if (!FontExists(it->first.Get(), it->second.Get()))
@@ -493,6 +732,15 @@ bool IGraphicsCanvas::AssetsLoaded()
 
 void IGraphicsCanvas::GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& data)
 {
+  // The worker's canvases can't be read back synchronously
+  if (mInWorker)
+  {
+    data.Resize(0);
+    return;
+  }
+  
+  FlushCommands();
+  
   const APIBitmap* pBitmap = layer->GetAPIBitmap();
   int size = pBitmap->GetWidth() * pBitmap->GetHeight() * 4;
   val context = pBitmap->GetBitmap()->call<val>("getContext", std::string("2d"));
@@ -502,12 +750,7 @@ void IGraphicsCanvas::GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData&
   
   // Copy pixels from context
   if (data.GetSize() >= size)
-  {
-    unsigned char* out = data.Get();
-    
-    for (auto i = 0; i < size; i++)
-      out[i] = pixelData[i].as<unsigned char>();
-  }
+    val(typed_memory_view(size, data.Get())).call<void>("set", pixelData);
 }
 
 void IGraphicsCanvas::ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const IShadow& shadow)
@@ -515,41 +758,44 @@ void IGraphicsCanvas::ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, con
   const APIBitmap* pBitmap = layer->GetAPIBitmap();
   int size = pBitmap->GetWidth() * pBitmap->GetHeight() * 4;
   
-  if (mask.GetSize() >= size)
+  if (!mInWorker && mask.GetSize() >= size)
   {
+    FlushCommands();
+    
     int width = pBitmap->GetWidth();
     int height = pBitmap->GetHeight();
-    double scale = pBitmap->GetScale() * pBitmap->GetDrawScale();
-    double x = shadow.mXOffset * scale;
-    double y = shadow.mYOffset * scale;
-    val layerCanvas = *pBitmap->GetBitmap();
-    val layerContext = layerCanvas.call<val>("getContext", std::string("2d"));
-    layerContext.call<void>("setTransform");
+    float scale = pBitmap->GetScale() * pBitmap->GetDrawScale();
+    float x = shadow.mXOffset * scale;
+    float y = shadow.mYOffset * scale;
+    float w = static_cast<float>(width);
+    float h = static_cast<float>(height);
+    const int layerID = static_cast<const Bitmap*>(pBitmap)->GetID();
+    
+    Record(layerID, ECommand::Transform, { 1.f, 0.f, 0.f, 1.f, 0.f, 0.f });
     
     if (!shadow.mDrawForeground)
     {
-      layerContext.call<void>("clearRect", 0, 0, width, height);
+      Record(layerID, ECommand::ClearRect, { 0.f, 0.f, w, h });
     }
     
     Bitmap localBitmap(width, height, pBitmap->GetScale(), pBitmap->GetDrawScale());
+    const int localID = localBitmap.GetID();
     val localCanvas = *localBitmap.GetBitmap();
     val localContext = localCanvas.call<val>("getContext", std::string("2d"));
     val imageData = localContext.call<val>("createImageData", width, height);
-    val pixelData = imageData["data"];
-    unsigned char* in = mask.Get();
-    
-    for (auto i = 0; i < size; i++)
-      pixelData.set(i, in[i]);
-    
+    imageData["data"].call<void>("set", val(typed_memory_view(size, mask.Get())));
     localContext.call<void>("putImageData", imageData, 0, 0);
+    
     IBlend blend(EBlend::SourceIn, shadow.mOpacity);
-    localContext.call<void>("rect", 0, 0, width, height);
-    localContext.call<void>("scale", scale, scale);
-    localContext.call<void>("translate", -(layer->Bounds().L + shadow.mXOffset), -(layer->Bounds().T + shadow.mYOffset));
-    SetCanvasSourcePattern(localContext, shadow.mPattern, &blend);
-    localContext.call<void>("fill");
+    const float tx = -(layer->Bounds().L + shadow.mXOffset) * scale;
+    const float ty = -(layer->Bounds().T + shadow.mYOffset) * scale;
+    Record(localID, ECommand::Rect, { 0.f, 0.f, w, h });
+    Record(localID, ECommand::Transform, { scale, 0.f, 0.f, scale, tx, ty });
+    SetCanvasSourcePattern(localID, shadow.mPattern, &blend);
+    Record(localID, ECommand::Fill, { 0.f });
     
-    layerContext.set("globalCompositeOperation", "destination-over");
-    layerContext.call<void>("drawImage", localCanvas, 0, 0, width, height, x, y, width, height);
+    Record(layerID, ECommand::Composite, { 4.f }); // destination-over
+    Record(layerID, ECommand::DrawImage, { static_cast<float>(localID), 0.f, 0.f, w, h, x, y, w, h });
+    FlushCommands();
   }
 }
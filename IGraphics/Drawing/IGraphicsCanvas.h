@@ -10,6 +10,10 @@
 
 #pragma once
 
+#include <initializer_list>
+#include <string>
+#include <vector>
+
 #include <emscripten/val.h>
 #include <emscripten/bind.h>
 
@@ -23,6 +27,11 @@ BEGIN_IPLUG_NAMESPACE
 BEGIN_IGRAPHICS_NAMESPACE
 
 /** IGraphics draw class HTML5 canvas
+* Drawing calls are recorded into a command buffer and replayed on the canvas by a small JavaScript renderer at the end of each frame,
+* so a frame costs one call into JavaScript rather than one per primitive.
+* Define IGRAPHICS_CANVAS_WORKER to replay the commands in a Web Worker that owns the canvas as an OffscreenCanvas, which takes rasterization
+* off the main thread. IGraphics and its input handling stay on the main thread. Where OffscreenCanvas is not supported it falls back to
+* drawing on the main thread. Layers can't be read back from the worker, so drop shadows are not drawn in that mode
 * @ingroup DrawClasses */
 class IGraphicsCanvas : public IGraphicsPathBase
 {
@@ -38,7 +47,9 @@ public:
 
   void DrawBitmap(const IBitmap& bitmap, const IRECT& bounds, int srcX, int srcY, const IBlend* pBlend) override;
 
-  void DrawResize() override {};
+  void DrawResize() override;
+
+  void EndFrame() override;
 
   void PathClear() override;
   void PathClose() override;
@@ -54,6 +65,9 @@ public:
   void* GetDrawContext() override { return nullptr; }
 
   bool BitmapExtSupported(const char* ext) override;
+
+  /** @return \c true if the canvas is drawn by a Web Worker, see IGRAPHICS_CANVAS_WORKER */
+  bool IsRenderingInWorker() const { return mInWorker; }
     
 protected:
   APIBitmap* LoadAPIBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext) override;
@@ -73,14 +87,46 @@ protected:
   void DoDrawText(const IText& text, const char* str, const IRECT& bounds, const IBlend* pBlend) override;
     
 private:
-  void PrepareAndMeasureText(const IText& text, const char* str, IRECT& r, double& x, double & y) const;
-    
-  val GetContext() const
+  /** The commands understood by the JavaScript renderer. Each is followed in the buffer by a fixed number of float arguments */
+  enum class ECommand
   {
-    val canvas = mLayers.empty() ? val::global("document").call<val>("getElementById", std::string("canvas")) : *(mLayers.top()->GetAPIBitmap()->GetBitmap());
-      
-    return canvas.call<val>("getContext", std::string("2d"));
-  }
+    Target,         // id
+    Save,
+    Restore,
+    BeginPath,
+    ClosePath,
+    Arc,            // cx, cy, r, a1, a2, ccw
+    MoveTo,         // x, y
+    LineTo,         // x, y
+    BezierTo,       // c1x, c1y, c2x, c2y, x2, y2
+    QuadraticTo,    // cx, cy, x2, y2
+    Rect,           // x, y, w, h
+    Clip,
+    Stroke,         // cap, join, miter limit, width, dash offset, dash count, dashes...
+    Fill,           // even odd
+    Composite,      // operation
+    Alpha,          // alpha
+    Color,          // r, g, b, a
+    LinearGradient, // x1, y1, x2, y2
+    RadialGradient, // cx, cy, r
+    ColorStop,      // offset, r, g, b, a
+    GradientStyle,
+    DrawImage,      // id, sx, sy, sw, sh, dx, dy, dw, dh
+    Transform,      // xx, yx, xy, yy, tx, ty
+    Font,           // string
+    Text,           // string, x, y
+    ClearRect       // x, y, w, h
+  };
+
+  void PrepareAndMeasureText(const IText& text, const char* str, IRECT& r, double& x, double & y, std::string& fontString) const;
+
+  /** @return The id of the canvas that drawing goes to, the top layer or the main canvas */
+  int DrawTarget() const;
+
+  void Record(int target, ECommand command, std::initializer_list<float> args = {});
+  void Emit(ECommand command, std::initializer_list<float> args = {}) { Record(DrawTarget(), command, args); }
+  float AddString(const std::string& str);
+  void FlushCommands();
     
   void GetFontMetrics(const char* font, const char* style, double& ascenderRatio, double& EMRatio);
   bool CompareFontMetrics(const char* style, const char* font1, const char* font2);
@@ -92,9 +138,16 @@ private:
   void PathTransformSetMatrix(const IMatrix& m) override;
   void SetClipRegion(const IRECT& r) override;
     
-  void SetCanvasSourcePattern(val& context, const IPattern& pattern, const IBlend* pBlend = nullptr);
-  void SetCanvasBlendMode(val& context, const IBlend* pBlend);
+  void SetCanvasSourcePattern(int target, const IPattern& pattern, const IBlend* pBlend = nullptr);
+  void SetCanvasBlendMode(int target, const IBlend* pBlend);
     
+  std::vector<float> mCommands;
+  std::string mStrings;
+  int mNStrings = 0;
+  int mTarget = 0;
+  bool mInWorker = false;
+  bool mWaitingForBitmaps = false;
+  val mMeasureContext;
   std::vector<std::pair<WDL_String, WDL_String>> mCustomFonts;
 
   static StaticStorage<Font> sFontCache;
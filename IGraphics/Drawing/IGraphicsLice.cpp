@@ -14,6 +14,7 @@
 #include "ITextEntryControl.h"
 
 #include "lice_combine.h"
+#include "IGraphicsLiceBlend.h"
 
 using namespace iplug;
 using namespace igraphics;
@@ -28,8 +29,39 @@ public:
   {}
   virtual ~Bitmap() { delete GetBitmap(); }
   bool IsPreMultiplied() { return mPremultiplied; }
+
+  /** Keep successively halved copies of the bitmap, down to a single pixel, see IGraphics::SetBitmapMipmaps() */
+  void GenerateMips()
+  {
+    LICE_IBitmap* pSrc = GetBitmap();
+
+    while (pSrc->getWidth() > 1 || pSrc->getHeight() > 1)
+    {
+      auto pMip = std::make_unique<LICE_MemBitmap>(std::max(pSrc->getWidth() / 2, 1), std::max(pSrc->getHeight() / 2, 1));
+      HalveBitmapPixels(pSrc->getBits(), pSrc->getWidth(), pSrc->getHeight(), pSrc->getRowSpan(), pMip->getBits(), pMip->getRowSpan(), mPremultiplied);
+      pSrc = pMip.get();
+      mMips.push_back(std::move(pMip));
+    }
+  }
+
+  /** @return The smallest copy of the bitmap that is at least width x height pixels, or the bitmap itself if it has no mipmaps */
+  LICE_IBitmap* GetMip(int width, int height)
+  {
+    LICE_IBitmap* pMip = GetBitmap();
+
+    for (auto& pLevel : mMips)
+    {
+      if (pLevel->getWidth() < width || pLevel->getHeight() < height)
+        break;
+
+      pMip = pLevel.get();
+    }
+
+    return pMip;
+  }
 private:
   bool mPremultiplied;
+  std::vector<std::unique_ptr<LICE_MemBitmap>> mMips;
 };
 
 struct IGraphicsLice::FontInfo
@@ -165,6 +197,72 @@ static void PreMulBlit(LICE_IBitmap *dest, LICE_IBitmap *src, int dstx, int dsty
   }
 }
 
+// Blits with the SIMD kernels in IGraphicsLiceBlend.h, clipping as LICE_Blit() does. Returns false for blends the kernels don't cover
+static bool BlendBlit(LICE_IBitmap *dest, LICE_IBitmap *src, int dstx, int dsty, int srcx, int srcy, int srcw, int srch, float alpha, int mode, bool preMultiplied)
+{
+  ILiceBlend::EMode blendMode;
+  
+  if (preMultiplied)
+  {
+    if ((mode & LICE_BLIT_MODE_MASK) != LICE_BLIT_MODE_COPY)
+      return false;
+    
+    blendMode = ILiceBlend::EMode::PreMulSourceOver;
+  }
+  else if ((mode & (LICE_BLIT_MODE_MASK | LICE_BLIT_USE_ALPHA)) == (LICE_BLIT_MODE_COPY | LICE_BLIT_USE_ALPHA))
+    blendMode = ILiceBlend::EMode::SourceOver;
+  else if ((mode & (LICE_BLIT_MODE_MASK | LICE_BLIT_USE_ALPHA)) == (LICE_BLIT_MODE_ADD | LICE_BLIT_USE_ALPHA))
+    blendMode = ILiceBlend::EMode::Add;
+  else
+    return false;
+  
+  const int weight = static_cast<int>(alpha * 256.f);
+  
+  if (!preMultiplied && weight <= 0)
+    return true;
+  
+  if (srcx < 0) { dstx -= srcx; srcw += srcx; srcx = 0; }
+  if (srcy < 0) { dsty -= srcy; srch += srcy; srcy = 0; }
+  if (dstx < 0) { srcx -= dstx; srcw += dstx; dstx = 0; }
+  if (dsty < 0) { srcy -= dsty; srch += dsty; dsty = 0; }
+  
+  srcw = std::min({ srcw, src->getWidth() - srcx, dest->getWidth() - dstx });
+  srch = std::min({ srch, src->getHeight() - srcy, dest->getHeight() - dsty });
+  
+  LICE_pixel* pIn = src->getBits();
+  LICE_pixel* pOut = dest->getBits();
+  
+  if (srcw <= 0 || srch <= 0 || !pIn || !pOut)
+    return true;
+  
+  int inSpan = src->getRowSpan();
+  int outSpan = dest->getRowSpan();
+  
+  if (src->isFlipped())
+  {
+    pIn += (src->getHeight() - srcy - 1) * inSpan;
+    inSpan = -inSpan;
+  }
+  else
+    pIn += srcy * inSpan;
+  
+  if (dest->isFlipped())
+  {
+    pOut += (dest->getHeight() - dsty - 1) * outSpan;
+    outSpan = -outSpan;
+  }
+  else
+    pOut += dsty * outSpan;
+  
+  pIn += srcx;
+  pOut += dstx;
+  
+  for (int i = 0; i < srch; i++, pIn += inSpan, pOut += outSpan)
+    ILiceBlend::BlendRow(blendMode, pOut, pIn, srcw, weight);
+  
+  return true;
+}
+
 #pragma mark -
 
 IGraphicsLice::IGraphicsLice(IGEditorDelegate& dlg, int w, int h, int fps, float scale)
@@ -245,10 +343,15 @@ void IGraphicsLice::DrawBitmap(const IBitmap& bitmap, const IRECT& bounds, int s
   srcX = (srcX * ds) + r.L - sr.L;
   srcY = (srcY * ds) + r.T - sr.T;
   
+  LICE_IBitmap* pSrc = bitmap.GetAPIBitmap()->GetBitmap();
+  
+  if (BlendBlit(mRenderBitmap, pSrc, r.L, r.T, srcX, srcY, r.W(), r.H(), BlendWeight(pBlend), LiceBlendMode(pBlend), preMultiplied))
+    return;
+  
   if (preMultiplied)
-    PreMulBlit(mRenderBitmap, bitmap.GetAPIBitmap()->GetBitmap(), r.L, r.T, srcX, srcY, r.W(), r.H(), BlendWeight(pBlend), LiceBlendMode(pBlend));
+    PreMulBlit(mRenderBitmap, pSrc, r.L, r.T, srcX, srcY, r.W(), r.H(), BlendWeight(pBlend), LiceBlendMode(pBlend));
   else
-    LICE_Blit(mRenderBitmap, bitmap.GetAPIBitmap()->GetBitmap(), r.L, r.T, srcX, srcY, r.W(), r.H(), BlendWeight(pBlend), LiceBlendMode(pBlend));
+    LICE_Blit(mRenderBitmap, pSrc, r.L, r.T, srcX, srcY, r.W(), r.H(), BlendWeight(pBlend), LiceBlendMode(pBlend));
 }
 
 void IGraphicsLice::DrawRotatedBitmap(const IBitmap& bitmap, float destCtrX, float destCtrY, double angle, int yOffsetZeroDeg, const IBlend* pBlend)
@@ -269,7 +372,7 @@ void IGraphicsLice::DrawFittedBitmap(const IBitmap& bitmap, const IRECT& bounds,
   NeedsClipping();
   // TODO - clipping
   IRECT r = TransformRECT(bounds);
-  LICE_IBitmap* pSrc = bitmap.GetAPIBitmap()->GetBitmap();
+  LICE_IBitmap* pSrc = static_cast<Bitmap*>(bitmap.GetAPIBitmap())->GetMip(static_cast<int>(r.W()), static_cast<int>(r.H()));
   LICE_ScaledBlit(mRenderBitmap, pSrc, r.L, r.T, r.W(), r.H(), 0.0f, 0.0f, (float) pSrc->getWidth(), (float) pSrc->getHeight(), BlendWeight(pBlend), LiceBlendMode(pBlend) | LICE_BLIT_FILTER_BILINEAR);
 }
 
@@ -535,9 +638,18 @@ void IGraphicsLice::PrepareAndMeasureText(const IText& text, const char* str, IR
 {
   pFont = CacheFont(text);
   RECT R = {0, 0, 0, 0};
-  UINT fmt = DT_NOCLIP | DT_TOP | DT_LEFT | LICE_DT_USEFGALPHA;
-  
-  pFont->DrawText(mRenderBitmap, str, -1, &R, fmt | DT_CALCRECT);
+
+  if (const IRECT* pExtents = mTextExtents.Find(text, str, static_cast<float>(GetScreenScale())))
+  {
+    R.right = static_cast<LONG>(pExtents->R);
+    R.bottom = static_cast<LONG>(pExtents->B);
+  }
+  else
+  {
+    UINT fmt = DT_NOCLIP | DT_TOP | DT_LEFT | LICE_DT_USEFGALPHA;
+    pFont->DrawText(mRenderBitmap, str, -1, &R, fmt | DT_CALCRECT);
+    mTextExtents.Add(IRECT(0.f, 0.f, static_cast<float>(R.right), static_cast<float>(R.bottom)));
+  }
   
   const float textWidth = R.right / static_cast<float>(GetScreenScale());
   const float textHeight = R.bottom / static_cast<float>(GetScreenScale());
@@ -690,6 +802,14 @@ void IGraphicsLice::UpdateLayer()
 
 LICE_IFont* IGraphicsLice::CacheFont(const IText& text) const
 {
+  const int scale = GetScreenScale();
+
+  for (const FontHandle& handle : mFontHandles)
+  {
+    if (handle.mSize == text.mSize && handle.mScale == scale && !strcmp(handle.mFontID, text.mFont))
+      return handle.mFont;
+  }
+
   StaticStorage<FontInfo>::Accessor fontInfoStorage(sFontInfoCache);
   FontInfo* pFontInfo = fontInfoStorage.Find(text.mFont);
   
@@ -723,10 +843,24 @@ LICE_IFont* IGraphicsLice::CacheFont(const IText& text) const
     font->SetFromHFont(hFont, LICE_FONT_FLAG_OWNS_HFONT | LICE_FONT_FLAG_FORCE_NATIVE);
     fontStorage.Add(font, hashStr.Get());
   }
+
+  FontHandle handle;
+  strncpy(handle.mFontID, text.mFont, FONT_LEN - 1);
+  handle.mFontID[FONT_LEN - 1] = 0;
+  handle.mSize = text.mSize;
+  handle.mScale = scale;
+  handle.mFont = font;
+  mFontHandles.push_back(handle);
     
   return font;
 }
 
+bool IGraphicsLice::LoadCachedAPIFont(const char* fontID)
+{
+  StaticStorage<FontInfo>::Accessor fontInfoStorage(sFontInfoCache);
+  return fontInfoStorage.Find(fontID) != nullptr;
+}
+
 bool IGraphicsLice::LoadAPIFont(const char* fontID, const PlatformFontPtr& font)
 {
   StaticStorage<FontInfo>::Accessor fontInfoStorage(sFontInfoCache);
@@ -791,15 +925,16 @@ APIBitmap* IGraphicsLice::LoadAPIBitmap(const char* fileNameOrResID, int scale,
   ToLower(extLower, ext);
   
   bool ispng = (strcmp(extLower, "png") == 0);
+  LICE_IBitmap* pLB = nullptr;
 
   if (ispng)
   {
 #if defined OS_WIN
     if (location == EResourceLocation::kWinBinary)
-      return new Bitmap(LICE_LoadPNGFromResource((HINSTANCE) GetWinModuleHandle(), fileNameOrResID, 0), scale, false);
+      pLB = LICE_LoadPNGFromResource((HINSTANCE) GetWinModuleHandle(), fileNameOrResID, 0);
     else
 #endif
-      return new Bitmap(LICE_LoadPNG(fileNameOrResID), scale, false);
+      pLB = LICE_LoadPNG(fileNameOrResID);
   }
 
 #ifdef LICE_JPEG_SUPPORT
@@ -809,14 +944,22 @@ APIBitmap* IGraphicsLice::LoadAPIBitmap(const char* fileNameOrResID, int scale,
   {
     #if defined OS_WIN
     if (location == EResourceLocation::kWinBinary)
-      return new Bitmap(LICE_LoadJPGFromResource((HINSTANCE)GetWinModuleHandle(), fileNameOrResID, 0), scale, false);
+      pLB = LICE_LoadJPGFromResource((HINSTANCE)GetWinModuleHandle(), fileNameOrResID, 0);
     else
     #endif
-      return new Bitmap(LICE_LoadJPG(fileNameOrResID), scale, false);
+      pLB = LICE_LoadJPG(fileNameOrResID);
   }
 #endif
 
-  return nullptr;
+  if (!pLB)
+    return nullptr;
+
+  Bitmap* pBitmap = new Bitmap(pLB, scale, false);
+
+  if (GetBitmapMipmaps())
+    pBitmap->GenerateMips();
+
+  return pBitmap;
 }
 
 APIBitmap* IGraphicsLice::CreateAPIBitmap(int width, int height, int scale, double drawScale)
@@ -826,6 +969,27 @@ APIBitmap* IGraphicsLice::CreateAPIBitmap(int width, int height, int scale, doub
   return new Bitmap(pBitmap, scale, true);
 }
 
+APIBitmap* IGraphicsLice::CreateAPIBitmapFromPixels(const uint8_t* pRGBA, int width, int height, int scale)
+{
+  LICE_IBitmap* pLB = new LICE_MemBitmap(width, height);
+
+  for (int y = 0; y < height; y++)
+  {
+    const uint8_t* pSrc = pRGBA + y * width * 4;
+    LICE_pixel* pDst = pLB->getBits() + y * pLB->getRowSpan();
+
+    for (int x = 0; x < width; x++, pSrc += 4)
+      pDst[x] = LICE_RGBA(pSrc[0], pSrc[1], pSrc[2], pSrc[3]);
+  }
+
+  Bitmap* pBitmap = new Bitmap(pLB, scale, false);
+
+  if (GetBitmapMipmaps())
+    pBitmap->GenerateMips();
+
+  return pBitmap;
+}
+
 void IGraphicsLice::GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& data)
 {
   const APIBitmap* pBitmap = layer->GetAPIBitmap();
@@ -837,6 +1001,44 @@ void IGraphicsLice::GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& da
     memcpy(data.Get(), pBitmap->GetBitmap()->getBits(), size);
 }
 
+bool IGraphicsLice::GetFramePixels(const IRECT& bounds, RawBitmapData& data, int& width, int& height)
+{
+  if (!mDrawBitmap)
+    return false;
+  
+  const IRECT r = bounds.GetScaled(GetScreenScale()).GetPixelAligned().Intersect(IRECT(0, 0, mDrawBitmap->getWidth(), mDrawBitmap->getHeight()));
+  const int x = static_cast<int>(r.L);
+  const int y = static_cast<int>(r.T);
+  width = static_cast<int>(r.W());
+  height = static_cast<int>(r.H());
+  
+  if (width <= 0 || height <= 0)
+    return false;
+  
+  data.Resize(width * height * 4, false);
+  
+  const LICE_pixel* pBits = mDrawBitmap->getBits();
+  const int span = mDrawBitmap->getRowSpan();
+  uint8_t* pOut = data.Get();
+  
+  for (int row = 0; row < height; row++)
+  {
+    // LICE bitmaps can be stored bottom-up
+    const int srcRow = mDrawBitmap->isFlipped() ? mDrawBitmap->getHeight() - 1 - (y + row) : y + row;
+    const LICE_pixel* pIn = pBits + srcRow * span + x;
+    
+    for (int col = 0; col < width; col++, pOut += 4)
+    {
+      pOut[0] = LICE_GETR(pIn[col]);
+      pOut[1] = LICE_GETG(pIn[col]);
+      pOut[2] = LICE_GETB(pIn[col]);
+      pOut[3] = 255;
+    }
+  }
+  
+  return true;
+}
+
 void IGraphicsLice::ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const IShadow& shadow)
 {
   const APIBitmap* pBitmap = layer->GetAPIBitmap();
@@ -866,42 +1068,48 @@ void IGraphicsLice::ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const
     {
       LICE_Clear(pLayerBitmap, 0);
     
-      for (int i = 0; i < nRows; i++, in += stride, out += stride)
-      {
-        LICE_pixel_chan* chans = out;
-
-        for (int j = 0; j < nCols; j++, chans += 4)
+      ParallelRows(nRows, [&](int start, int end) {
+        for (int i = start; i < end; i++)
         {
-          unsigned int maskAlpha = in[j * 4 + LICE_PIXEL_A];
+          const LICE_pixel_chan* inRow = in + i * stride;
+          LICE_pixel_chan* chans = out + i * stride;
+
+          for (int j = 0; j < nCols; j++, chans += 4)
+          {
+            unsigned int maskAlpha = inRow[j * 4 + LICE_PIXEL_A];
+          
+            unsigned int A = (ia * maskAlpha) >> 16;
+            unsigned int R = (ir * maskAlpha) >> 16;
+            unsigned int G = (ig * maskAlpha) >> 16;
+            unsigned int B = (ib * maskAlpha) >> 16;
         
-          unsigned int A = (ia * maskAlpha) >> 16;
-          unsigned int R = (ir * maskAlpha) >> 16;
-          unsigned int G = (ig * maskAlpha) >> 16;
-          unsigned int B = (ib * maskAlpha) >> 16;
-      
-          _LICE_MakePixelNoClamp(chans, R, G, B, A);
+            _LICE_MakePixelNoClamp(chans, R, G, B, A);
+          }
         }
-      }
+      });
     }
     else
     {
-      for (int i = 0; i < nRows; i++, in += stride, out += stride)
-      {
-        LICE_pixel_chan* chans = out;
-        
-        for (int j = 0; j < nCols; j++, chans += 4)
+      ParallelRows(nRows, [&](int start, int end) {
+        for (int i = start; i < end; i++)
         {
-          unsigned int maskAlpha = in[j * 4 + LICE_PIXEL_A];
-          unsigned int alphaCmp = 255 - chans[LICE_PIXEL_A];
-          
-          unsigned int A = chans[LICE_PIXEL_A] + ((alphaCmp * ia * maskAlpha) >> 24);
-          unsigned int R = chans[LICE_PIXEL_R] + ((alphaCmp * ir * maskAlpha) >> 24);
-          unsigned int G = chans[LICE_PIXEL_G] + ((alphaCmp * ig * maskAlpha) >> 24);
-          unsigned int B = chans[LICE_PIXEL_B] + ((alphaCmp * ib * maskAlpha) >> 24);
+          const LICE_pixel_chan* inRow = in + i * stride;
+          LICE_pixel_chan* chans = out + i * stride;
           
-          _LICE_MakePixelClamp(chans, R, G, B, A);
+          for (int j = 0; j < nCols; j++, chans += 4)
+          {
+            unsigned int maskAlpha = inRow[j * 4 + LICE_PIXEL_A];
+            unsigned int alphaCmp = 255 - chans[LICE_PIXEL_A];
+            
+            unsigned int A = chans[LICE_PIXEL_A] + ((alphaCmp * ia * maskAlpha) >> 24);
+            unsigned int R = chans[LICE_PIXEL_R] + ((alphaCmp * ir * maskAlpha) >> 24);
+            unsigned int G = chans[LICE_PIXEL_G] + ((alphaCmp * ig * maskAlpha) >> 24);
+            unsigned int B = chans[LICE_PIXEL_B] + ((alphaCmp * ib * maskAlpha) >> 24);
+            
+            _LICE_MakePixelClamp(chans, R, G, B, A);
+          }
         }
-      }
+      });
     }
   }
 }
@@ -954,14 +1162,29 @@ void IGraphicsLice::EndFrame()
   HWND hWnd = (HWND) GetWindow();
   HDC dc = BeginPaint(hWnd, &ps);
   
-  if (GetDrawScale() == 1.0)
-  {
-    BitBlt(dc, 0, 0, Width() * GetScreenScale(), Height() * GetScreenScale(), mDrawBitmap->getDC(), 0, 0, SRCCOPY);
-  }
-  else
+  // only present the regions drawn this frame, which are aligned to whole window pixels
+  const float screenScale = GetScreenScale();
+  const float windowScale = GetBackingPixelScale();
+
+  for (auto i = 0; i < mFrameRects.Size(); i++)
   {
-    LICE_ScaledBlit(mScaleBitmap.get(), mDrawBitmap.get(), 0, 0, WindowWidth() * GetScreenScale(), WindowHeight() * GetScreenScale(), 0, 0, Width() * GetScreenScale(), Height() * GetScreenScale(), 1.0, LICE_BLIT_MODE_COPY | LICE_BLIT_FILTER_BILINEAR);
-    BitBlt(dc, 0, 0, WindowWidth() * GetScreenScale(), WindowHeight() * GetScreenScale(), mScaleBitmap->getDC(), 0, 0, SRCCOPY);
+    const IRECT& bounds = mFrameRects.Get(i);
+    const IRECT r = bounds.GetScaled(windowScale).GetPixelAligned();
+    const int x = static_cast<int>(r.L);
+    const int y = static_cast<int>(r.T);
+    const int w = static_cast<int>(r.W());
+    const int h = static_cast<int>(r.H());
+    
+    if (GetDrawScale() == 1.0)
+    {
+      BitBlt(dc, x, y, w, h, mDrawBitmap->getDC(), x, y, SRCCOPY);
+    }
+    else
+    {
+      const IRECT src = bounds.GetScaled(screenScale);
+      LICE_ScaledBlit(mScaleBitmap.get(), mDrawBitmap.get(), x, y, w, h, src.L, src.T, src.W(), src.H(), 1.0, LICE_BLIT_MODE_COPY | LICE_BLIT_FILTER_BILINEAR);
+      BitBlt(dc, x, y, w, h, mScaleBitmap->getDC(), x, y, SRCCOPY);
+    }
   }
   
   EndPaint(hWnd, &ps);
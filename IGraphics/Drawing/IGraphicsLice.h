@@ -26,8 +26,10 @@
 
 #include "IGraphicsLice_src.h"
 #include "IGraphics.h"
+#include "IGraphicsTextMeasureCache.h"
 
 #include <memory>
+#include <vector>
 
 BEGIN_IPLUG_NAMESPACE
 BEGIN_IGRAPHICS_NAMESPACE
@@ -89,13 +91,16 @@ public:
 protected:
   APIBitmap* LoadAPIBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext) override;
   APIBitmap* CreateAPIBitmap(int width, int height, int scale, double drawScale) override;
+  APIBitmap* CreateAPIBitmapFromPixels(const uint8_t* pRGBA, int width, int height, int scale) override;
 
   bool LoadAPIFont(const char* fontID, const PlatformFontPtr& font) override;
+  bool LoadCachedAPIFont(const char* fontID) override;
 
   int AlphaChannel() const override { return LICE_PIXEL_A; }
   bool FlippedBitmap() const override { return false; }
 
   void GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& data) override;
+  bool GetFramePixels(const IRECT& bounds, RawBitmapData& data, int& width, int& height) override;
   void ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const IShadow& shadow) override;
 
   void DoMeasureText(const IText& text, const char* str, IRECT& bounds) const override;
@@ -142,6 +147,14 @@ private:
     
   LICE_IFont* CacheFont(const IText& text) const;
 
+  struct FontHandle
+  {
+    char mFontID[FONT_LEN];
+    float mSize;
+    int mScale;
+    LICE_IFont* mFont; // owned by sFontCache, which keeps it while this instance is alive
+  };
+
   IRECT mDrawRECT;
   IRECT mClipRECT;
     
@@ -156,6 +169,11 @@ private:
   LICE_IBitmap* mRenderBitmap = nullptr;
     
   ILayerPtr mClippingLayer;
+
+  // the fonts found by CacheFont(), so that drawing a string doesn't create or look up the font, and the pixel extents of the strings drawn,
+  // so that they are not laid out twice per draw
+  mutable std::vector<FontHandle> mFontHandles;
+  mutable ITextMeasureCache mTextExtents {1024};
   
   static StaticStorage<LICE_IFont> sFontCache;
   static StaticStorage<FontInfo> sFontInfoCache;
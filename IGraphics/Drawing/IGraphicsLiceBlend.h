@@ -0,0 +1,414 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief SIMD versions of the LICE alpha blends that IGraphicsLice uses to draw bitmaps
+ *
+ * Each kernel blends one row of 32-bit pixels, four (SSE2, NEON) or eight (AVX2, when the build enables it) at a time, with a scalar
+ * loop for the rest and for other targets. The source over and add blends of non pre-multiplied sources follow LICE's
+ * _LICE_CombinePixelsCopySourceAlpha and _LICE_CombinePixelsAddSourceAlpha, except that source over rounds colour down where LICE rounds
+ * towards the destination, which can differ by one level. The pre-multiplied source over matches PreMulCompositeSourceOver() exactly.
+ * Pixels are LICE_pixel values, so alpha is always the top byte whatever the channel order in memory
+ */
+
+#include <algorithm>
+#include <cstdint>
+
+#include "IPlugPlatform.h"
+
+#if defined _M_X64 || defined _M_IX86 || defined __x86_64__ || defined __i386__
+  #if defined _M_X64 || defined __x86_64__ || defined __SSE2__ || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define IGRAPHICS_LICE_BLEND_SSE2
+    #if defined __AVX2__
+      #include <immintrin.h>
+      #define IGRAPHICS_LICE_BLEND_AVX2
+    #endif
+  #endif
+#elif defined __ARM_NEON || defined __ARM_NEON__ || defined _M_ARM64
+  #include <arm_neon.h>
+  #define IGRAPHICS_LICE_BLEND_NEON
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** Row blend kernels for pixels in LICE's layout, see IGraphicsLiceBlend.h */
+struct ILiceBlend
+{
+  /** The blends supported by BlendRow() */
+  enum class EMode
+  {
+    SourceOver,       // A non pre-multiplied source over the destination, LICE_BLIT_MODE_COPY | LICE_BLIT_USE_ALPHA
+    Add,              // A non pre-multiplied source added to the destination, LICE_BLIT_MODE_ADD | LICE_BLIT_USE_ALPHA
+    PreMulSourceOver  // A pre-multiplied source over the destination. The weight is not used, as in IGraphicsLice's PreMulBlit()
+  };
+
+  /** Blend a row of pixels
+   * @param mode The blend
+   * @param pDest The destination pixels, which are blended in place
+   * @param pSrc The source pixels
+   * @param n The number of pixels
+   * @param weight The source weight from 0 to 256, as LICE scales the blend weight */
+  static void BlendRow(EMode mode, uint32_t* pDest, const uint32_t* pSrc, int n, int weight)
+  {
+    switch (mode)
+    {
+      case EMode::SourceOver:       SourceOverRow(pDest, pSrc, n, weight);   break;
+      case EMode::Add:              AddRow(pDest, pSrc, n, weight);          break;
+      case EMode::PreMulSourceOver: PreMulSourceOverRow(pDest, pSrc, n);     break;
+    }
+  }
+
+  /** @return The name of the instruction set used, for diagnostics */
+  static const char* GetInstructionSet()
+  {
+#if defined IGRAPHICS_LICE_BLEND_AVX2
+    return "AVX2";
+#elif defined IGRAPHICS_LICE_BLEND_SSE2
+    return "SSE2";
+#elif defined IGRAPHICS_LICE_BLEND_NEON
+    return "NEON";
+#else
+    return "scalar";
+#endif
+  }
+
+private:
+#pragma mark - Scalar
+
+  static inline uint32_t Channel(uint32_t px, int shift) { return (px >> shift) & 0xFF; }
+
+  static inline void SourceOverPixel(uint32_t& dest, uint32_t src, int weight)
+  {
+    const uint32_t a = src >> 24;
+
+    if (!a)
+      return;
+
+    const uint32_t sc2 = (weight * (a + 1)) >> 8;
+    const uint32_t sc = 256 - sc2;
+    uint32_t out = std::min(255u, sc2 + (dest >> 24)) << 24;
+
+    for (int shift = 0; shift < 24; shift += 8)
+      out |= ((Channel(src, shift) * sc2 + Channel(dest, shift) * sc) >> 8) << shift;
+
+    dest = out;
+  }
+
+  static inline void AddPixel(uint32_t& dest, uint32_t src, int weight)
+  {
+    const uint32_t a = src >> 24;
+
+    if (!a)
+      return;
+
+    const uint32_t sc2 = (weight * (a + 1)) >> 8;
+    uint32_t out = 0;
+
+    for (int shift = 0; shift < 32; shift += 8)
+      out |= std::min(255u, Channel(dest, shift) + ((Channel(src, shift) * sc2) >> 8)) << shift;
+
+    dest = out;
+  }
+
+  static inline void PreMulSourceOverPixel(uint32_t& dest, uint32_t src)
+  {
+    const uint32_t alphaCmp = 256 - (src >> 24);
+    uint32_t out = 0;
+
+    for (int shift = 0; shift < 32; shift += 8)
+      out |= std::min(255u, Channel(src, shift) + ((Channel(dest, shift) * alphaCmp) >> 8)) << shift;
+
+    dest = out;
+  }
+
+#pragma mark - SIMD
+
+  // The SIMD versions widen pixels to 16 bit channels. sc2 = (weight * (a + 1)) >> 8 is taken as the high half of ((a + 1) << 7) * (weight << 1),
+  // as both factors then fit in 16 bits. Colour products are at most 255 * 256, and packing with unsigned saturation clamps the sums
+
+#if defined IGRAPHICS_LICE_BLEND_SSE2
+  // Broadcast each pixel's alpha to its four channels
+  static inline __m128i SplatAlpha(__m128i px16) { return _mm_shufflehi_epi16(_mm_shufflelo_epi16(px16, 0xFF), 0xFF); }
+
+  static inline __m128i SourceOver16(__m128i s, __m128i d, __m128i weight2, __m128i alphaLanes)
+  {
+    const __m128i sc2 = _mm_mulhi_epu16(_mm_slli_epi16(_mm_add_epi16(SplatAlpha(s), _mm_set1_epi16(1)), 7), weight2);
+    const __m128i sc = _mm_sub_epi16(_mm_set1_epi16(256), sc2);
+    const __m128i color = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(s, sc2), _mm_mullo_epi16(d, sc)), 8);
+    const __m128i alpha = _mm_add_epi16(sc2, d);
+    return _mm_or_si128(_mm_and_si128(alphaLanes, alpha), _mm_andnot_si128(alphaLanes, color));
+  }
+
+  static inline __m128i Add16(__m128i s, __m128i d, __m128i weight2)
+  {
+    const __m128i sc2 = _mm_mulhi_epu16(_mm_slli_epi16(_mm_add_epi16(SplatAlpha(s), _mm_set1_epi16(1)), 7), weight2);
+    return _mm_add_epi16(d, _mm_srli_epi16(_mm_mullo_epi16(s, sc2), 8));
+  }
+
+  static inline __m128i PreMulSourceOver16(__m128i s, __m128i d)
+  {
+    const __m128i alphaCmp = _mm_sub_epi16(_mm_set1_epi16(256), SplatAlpha(s));
+    return _mm_add_epi16(s, _mm_srli_epi16(_mm_mullo_epi16(d, alphaCmp), 8));
+  }
+
+  // Pixels with a source alpha of zero keep the destination
+  static inline __m128i KeepTransparent(__m128i src, __m128i dest, __m128i blended)
+  {
+    const __m128i transparent = _mm_cmpeq_epi32(_mm_srli_epi32(src, 24), _mm_setzero_si128());
+    return _mm_or_si128(_mm_and_si128(transparent, dest), _mm_andnot_si128(transparent, blended));
+  }
+#endif
+
+#if defined IGRAPHICS_LICE_BLEND_AVX2
+  static inline __m256i SplatAlpha(__m256i px16) { return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(px16, 0xFF), 0xFF); }
+
+  static inline __m256i SourceOver16(__m256i s, __m256i d, __m256i weight2, __m256i alphaLanes)
+  {
+    const __m256i sc2 = _mm256_mulhi_epu16(_mm256_slli_epi16(_mm256_add_epi16(SplatAlpha(s), _mm256_set1_epi16(1)), 7), weight2);
+    const __m256i sc = _mm256_sub_epi16(_mm256_set1_epi16(256), sc2);
+    const __m256i color = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(s, sc2), _mm256_mullo_epi16(d, sc)), 8);
+    const __m256i alpha = _mm256_add_epi16(sc2, d);
+    return _mm256_blendv_epi8(color, alpha, alphaLanes);
+  }
+
+  static inline __m256i Add16(__m256i s, __m256i d, __m256i weight2)
+  {
+    const __m256i sc2 = _mm256_mulhi_epu16(_mm256_slli_epi16(_mm256_add_epi16(SplatAlpha(s), _mm256_set1_epi16(1)), 7), weight2);
+    return _mm256_add_epi16(d, _mm256_srli_epi16(_mm256_mullo_epi16(s, sc2), 8));
+  }
+
+  static inline __m256i PreMulSourceOver16(__m256i s, __m256i d)
+  {
+    const __m256i alphaCmp = _mm256_sub_epi16(_mm256_set1_epi16(256), SplatAlpha(s));
+    return _mm256_add_epi16(s, _mm256_srli_epi16(_mm256_mullo_epi16(d, alphaCmp), 8));
+  }
+
+  static inline __m256i KeepTransparent(__m256i src, __m256i dest, __m256i blended)
+  {
+    const __m256i transparent = _mm256_cmpeq_epi32(_mm256_srli_epi32(src, 24), _mm256_setzero_si256());
+    return _mm256_blendv_epi8(blended, dest, transparent);
+  }
+#endif
+
+#if defined IGRAPHICS_LICE_BLEND_NEON
+  // Broadcast each pixel's alpha byte to its four channels
+  static inline uint8x16_t SplatAlpha(uint8x16_t px) { return vreinterpretq_u8_u32(vmulq_n_u32(vshrq_n_u32(vreinterpretq_u32_u8(px), 24), 0x01010101)); }
+
+  static inline uint16x8_t Scale2(uint8x8_t alpha, uint16x4_t weight)
+  {
+    const uint16x8_t a1 = vaddw_u8(vdupq_n_u16(1), alpha);
+    return vcombine_u16(vshrn_n_u32(vmull_u16(vget_low_u16(a1), weight), 8), vshrn_n_u32(vmull_u16(vget_high_u16(a1), weight), 8));
+  }
+
+  static inline uint16x8_t SourceOver16(uint8x8_t s, uint8x8_t d, uint8x8_t alpha, uint16x4_t weight, uint16x8_t alphaLanes)
+  {
+    const uint16x8_t sc2 = Scale2(alpha, weight);
+    const uint16x8_t sc = vsubq_u16(vdupq_n_u16(256), sc2);
+    const uint16x8_t color = vshrq_n_u16(vmlaq_u16(vmulq_u16(vmovl_u8(s), sc2), vmovl_u8(d), sc), 8);
+    const uint16x8_t alphaSum = vaddw_u8(sc2, d);
+    return vbslq_u16(alphaLanes, alphaSum, color);
+  }
+
+  static inline uint16x8_t Add16(uint8x8_t s, uint8x8_t d, uint8x8_t alpha, uint16x4_t weight)
+  {
+    const uint16x8_t sc2 = Scale2(alpha, weight);
+    return vaddw_u8(vshrq_n_u16(vmulq_u16(vmovl_u8(s), sc2), 8), d);
+  }
+
+  static inline uint16x8_t PreMulSourceOver16(uint8x8_t s, uint8x8_t d, uint8x8_t alpha)
+  {
+    const uint16x8_t alphaCmp = vsubw_u8(vdupq_n_u16(256), alpha);
+    return vaddw_u8(vshrq_n_u16(vmulq_u16(vmovl_u8(d), alphaCmp), 8), s);
+  }
+
+  static inline uint8x16_t KeepTransparent(uint8x16_t src, uint8x16_t dest, uint8x16_t blended)
+  {
+    const uint32x4_t transparent = vceqq_u32(vshrq_n_u32(vreinterpretq_u32_u8(src), 24), vdupq_n_u32(0));
+    return vbslq_u8(vreinterpretq_u8_u32(transparent), dest, blended);
+  }
+#endif
+
+#pragma mark - Rows
+
+  static void SourceOverRow(uint32_t* pDest, const uint32_t* pSrc, int n, int weight)
+  {
+    int i = 0;
+
+#if defined IGRAPHICS_LICE_BLEND_AVX2
+    {
+      const __m256i weight2 = _mm256_set1_epi16(static_cast<short>(weight << 1));
+      const __m256i alphaLanes = _mm256_set1_epi64x(static_cast<long long>(0xFFFF000000000000ULL));
+
+      for (; i + 8 <= n; i += 8)
+      {
+        const __m256i src = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i));
+        const __m256i dest = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pDest + i));
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i lo = SourceOver16(_mm256_unpacklo_epi8(src, zero), _mm256_unpacklo_epi8(dest, zero), weight2, alphaLanes);
+        const __m256i hi = SourceOver16(_mm256_unpackhi_epi8(src, zero), _mm256_unpackhi_epi8(dest, zero), weight2, alphaLanes);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDest + i), KeepTransparent(src, dest, _mm256_packus_epi16(lo, hi)));
+      }
+    }
+#endif
+
+#if defined IGRAPHICS_LICE_BLEND_SSE2
+    {
+      const __m128i weight2 = _mm_set1_epi16(static_cast<short>(weight << 1));
+      const __m128i alphaLanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+
+      for (; i + 4 <= n; i += 4)
+      {
+        const __m128i src = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i));
+        const __m128i dest = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pDest + i));
+        const __m128i srcAlpha = _mm_srli_epi32(src, 24);
+
+        // skip fully transparent runs, and copy fully opaque ones at full weight
+        const int transparent = _mm_movemask_epi8(_mm_cmpeq_epi32(srcAlpha, _mm_setzero_si128()));
+
+        if (transparent == 0xFFFF)
+          continue;
+
+        if (weight == 256 && _mm_movemask_epi8(_mm_cmpeq_epi32(srcAlpha, _mm_set1_epi32(255))) == 0xFFFF)
+        {
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(pDest + i), src);
+          continue;
+        }
+
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i lo = SourceOver16(_mm_unpacklo_epi8(src, zero), _mm_unpacklo_epi8(dest, zero), weight2, alphaLanes);
+        const __m128i hi = SourceOver16(_mm_unpackhi_epi8(src, zero), _mm_unpackhi_epi8(dest, zero), weight2, alphaLanes);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDest + i), KeepTransparent(src, dest, _mm_packus_epi16(lo, hi)));
+      }
+    }
+#elif defined IGRAPHICS_LICE_BLEND_NEON
+    {
+      const uint16x4_t weight16 = vdup_n_u16(static_cast<uint16_t>(weight));
+      const uint16x8_t alphaLanes = vreinterpretq_u16_u64(vdupq_n_u64(0xFFFF000000000000ULL));
+
+      for (; i + 4 <= n; i += 4)
+      {
+        const uint8x16_t src = vreinterpretq_u8_u32(vld1q_u32(pSrc + i));
+        const uint8x16_t dest = vreinterpretq_u8_u32(vld1q_u32(pDest + i));
+        const uint8x16_t alpha = SplatAlpha(src);
+        const uint16x8_t lo = SourceOver16(vget_low_u8(src), vget_low_u8(dest), vget_low_u8(alpha), weight16, alphaLanes);
+        const uint16x8_t hi = SourceOver16(vget_high_u8(src), vget_high_u8(dest), vget_high_u8(alpha), weight16, alphaLanes);
+        vst1q_u32(pDest + i, vreinterpretq_u32_u8(KeepTransparent(src, dest, vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi)))));
+      }
+    }
+#endif
+
+    for (; i < n; i++)
+      SourceOverPixel(pDest[i], pSrc[i], weight);
+  }
+
+  static void AddRow(uint32_t* pDest, const uint32_t* pSrc, int n, int weight)
+  {
+    int i = 0;
+
+#if defined IGRAPHICS_LICE_BLEND_AVX2
+    {
+      const __m256i weight2 = _mm256_set1_epi16(static_cast<short>(weight << 1));
+
+      for (; i + 8 <= n; i += 8)
+      {
+        const __m256i src = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i));
+        const __m256i dest = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pDest + i));
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i lo = Add16(_mm256_unpacklo_epi8(src, zero), _mm256_unpacklo_epi8(dest, zero), weight2);
+        const __m256i hi = Add16(_mm256_unpackhi_epi8(src, zero), _mm256_unpackhi_epi8(dest, zero), weight2);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDest + i), KeepTransparent(src, dest, _mm256_packus_epi16(lo, hi)));
+      }
+    }
+#endif
+
+#if defined IGRAPHICS_LICE_BLEND_SSE2
+    {
+      const __m128i weight2 = _mm_set1_epi16(static_cast<short>(weight << 1));
+
+      for (; i + 4 <= n; i += 4)
+      {
+        const __m128i src = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i));
+        const __m128i dest = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pDest + i));
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i lo = Add16(_mm_unpacklo_epi8(src, zero), _mm_unpacklo_epi8(dest, zero), weight2);
+        const __m128i hi = Add16(_mm_unpackhi_epi8(src, zero), _mm_unpackhi_epi8(dest, zero), weight2);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDest + i), KeepTransparent(src, dest, _mm_packus_epi16(lo, hi)));
+      }
+    }
+#elif defined IGRAPHICS_LICE_BLEND_NEON
+    {
+      const uint16x4_t weight16 = vdup_n_u16(static_cast<uint16_t>(weight));
+
+      for (; i + 4 <= n; i += 4)
+      {
+        const uint8x16_t src = vreinterpretq_u8_u32(vld1q_u32(pSrc + i));
+        const uint8x16_t dest = vreinterpretq_u8_u32(vld1q_u32(pDest + i));
+        const uint8x16_t alpha = SplatAlpha(src);
+        const uint16x8_t lo = Add16(vget_low_u8(src), vget_low_u8(dest), vget_low_u8(alpha), weight16);
+        const uint16x8_t hi = Add16(vget_high_u8(src), vget_high_u8(dest), vget_high_u8(alpha), weight16);
+        vst1q_u32(pDest + i, vreinterpretq_u32_u8(KeepTransparent(src, dest, vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi)))));
+      }
+    }
+#endif
+
+    for (; i < n; i++)
+      AddPixel(pDest[i], pSrc[i], weight);
+  }
+
+  static void PreMulSourceOverRow(uint32_t* pDest, const uint32_t* pSrc, int n)
+  {
+    int i = 0;
+
+#if defined IGRAPHICS_LICE_BLEND_AVX2
+    for (; i + 8 <= n; i += 8)
+    {
+      const __m256i src = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i));
+      const __m256i dest = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pDest + i));
+      const __m256i zero = _mm256_setzero_si256();
+      const __m256i lo = PreMulSourceOver16(_mm256_unpacklo_epi8(src, zero), _mm256_unpacklo_epi8(dest, zero));
+      const __m256i hi = PreMulSourceOver16(_mm256_unpackhi_epi8(src, zero), _mm256_unpackhi_epi8(dest, zero));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDest + i), _mm256_packus_epi16(lo, hi));
+    }
+#endif
+
+#if defined IGRAPHICS_LICE_BLEND_SSE2
+    for (; i + 4 <= n; i += 4)
+    {
+      const __m128i src = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i));
+      const __m128i dest = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pDest + i));
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i lo = PreMulSourceOver16(_mm_unpacklo_epi8(src, zero), _mm_unpacklo_epi8(dest, zero));
+      const __m128i hi = PreMulSourceOver16(_mm_unpackhi_epi8(src, zero), _mm_unpackhi_epi8(dest, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(pDest + i), _mm_packus_epi16(lo, hi));
+    }
+#elif defined IGRAPHICS_LICE_BLEND_NEON
+    for (; i + 4 <= n; i += 4)
+    {
+      const uint8x16_t src = vreinterpretq_u8_u32(vld1q_u32(pSrc + i));
+      const uint8x16_t dest = vreinterpretq_u8_u32(vld1q_u32(pDest + i));
+      const uint8x16_t alpha = SplatAlpha(src);
+      const uint16x8_t lo = PreMulSourceOver16(vget_low_u8(src), vget_low_u8(dest), vget_low_u8(alpha));
+      const uint16x8_t hi = PreMulSourceOver16(vget_high_u8(src), vget_high_u8(dest), vget_high_u8(alpha));
+      vst1q_u32(pDest + i, vreinterpretq_u32_u8(vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi))));
+    }
+#endif
+
+    for (; i < n; i++)
+      PreMulSourceOverPixel(pDest[i], pSrc[i]);
+  }
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
@@ -11,6 +11,7 @@
 #include <cmath>
 
 #include "IGraphicsNanoVG.h"
+#include "IGraphicsShader.h"
 #include "ITextEntryControl.h"
 
 #if defined IGRAPHICS_GL
@@ -42,7 +43,13 @@
       #error Define either IGRAPHICS_GL2 or IGRAPHICS_GL3 when using IGRAPHICS_GL and IGRAPHICS_NANOVG with OS_WIN
     #endif
   #elif defined OS_LINUX
-    #error NOT IMPLEMENTED
+    #if defined IGRAPHICS_GL2
+      #define NANOVG_GL2_IMPLEMENTATION
+    #elif defined IGRAPHICS_GL3
+      #define NANOVG_GL3_IMPLEMENTATION
+    #else
+      #error Define either IGRAPHICS_GL2 or IGRAPHICS_GL3 when using IGRAPHICS_GL and IGRAPHICS_NANOVG with OS_LINUX
+    #endif
   #elif defined OS_WEB
     #if defined IGRAPHICS_GLES2
       #define NANOVG_GLES2_IMPLEMENTATION
@@ -64,6 +71,8 @@
   #error you must define either IGRAPHICS_GL2, IGRAPHICS_GLES2 etc or IGRAPHICS_METAL when using IGRAPHICS_NANOVG
 #endif
 
+#include "stb_image.h"
+
 #include <string>
 #include <map>
 
@@ -77,14 +86,90 @@ class IGraphicsNanoVG::Bitmap : public APIBitmap
 public:
   Bitmap(NVGcontext* pContext, const char* path, double sourceScale, int nvgImageID, bool shared = false);
   Bitmap(IGraphicsNanoVG* pGraphics, NVGcontext* pContext, int width, int height, int scale, float drawScale);
-  Bitmap(NVGcontext* pContext, int width, int height, const uint8_t* pData, int scale, float drawScale);
+  Bitmap(NVGcontext* pContext, int width, int height, const uint8_t* pData, int scale, float drawScale, int imageFlags = 0);
+  Bitmap(NVGcontext* pContext, int atlasImage, int atlasSize, int x, int y, int width, int height, int scale);
   virtual ~Bitmap();
+  /** Replace the texture with a new one made from pixels of the same size, with imageFlags */
+  void Recreate(const uint8_t* pData, int imageFlags);
   NVGframebuffer* GetFBO() const { return mFBO; }
+  /** @return \c true if the bitmap is a region of an atlas texture, see IGraphicsNanoVG::SetBitmapAtlas() */
+  bool InAtlas() const { return mAtlasSize > 0; }
+  int GetAtlasX() const { return mAtlasX; }
+  int GetAtlasY() const { return mAtlasY; }
+  int GetAtlasSize() const { return mAtlasSize; }
 private:
   IGraphicsNanoVG *mGraphics = nullptr;
   NVGcontext* mVG;
   NVGframebuffer* mFBO = nullptr;
   bool mSharedTexture = false;
+  int mAtlasX = 0;
+  int mAtlasY = 0;
+  int mAtlasSize = 0;
+};
+
+/** A square texture that bitmaps are packed into in shelves, rows as tall as the tallest bitmap placed in them.
+ * The pixels are kept, as NanoVG uploads regions of a texture from a buffer laid out like the whole texture */
+struct IGraphicsNanoVG::Atlas
+{
+  struct Shelf
+  {
+    int mX;
+    int mY;
+    int mHeight;
+  };
+  
+  Atlas(NVGcontext* pContext, int size)
+  : mSize(size)
+  {
+    mPixels.Resize(size * size * 4);
+    memset(mPixels.Get(), 0, mPixels.GetSize());
+    mImage = nvgCreateImageRGBA(pContext, size, size, 0, mPixels.Get());
+  }
+  
+  /** Find space for a w x h region, in the shortest shelf it fits in, or a new shelf
+   * @return \c true if there was room */
+  bool Allocate(int w, int h, int& x, int& y)
+  {
+    Shelf* pBest = nullptr;
+    
+    for (Shelf& shelf : mShelves)
+    {
+      if (h <= shelf.mHeight && shelf.mX + w <= mSize && (!pBest || shelf.mHeight < pBest->mHeight))
+        pBest = &shelf;
+    }
+    
+    if (!pBest)
+    {
+      const int top = mShelves.empty() ? 0 : mShelves.back().mY + mShelves.back().mHeight;
+      
+      if (w > mSize || top + h > mSize)
+        return false;
+      
+      mShelves.push_back({0, top, h});
+      pBest = &mShelves.back();
+    }
+    
+    x = pBest->mX;
+    y = pBest->mY;
+    pBest->mX += w;
+    return true;
+  }
+  
+  int mImage = 0;
+  int mSize;
+  RawBitmapData mPixels;
+  std::vector<Shelf> mShelves;
+};
+
+struct IGraphicsNanoVG::BitmapDecode
+{
+  APIBitmap* mBitmap = nullptr;
+  WDL_String mPath;
+  const unsigned char* mResData = nullptr;
+  int mResSize = 0;
+  int mWidth = 0;
+  int mHeight = 0;
+  RawBitmapData mPixels;
 };
 
 IGraphicsNanoVG::Bitmap::Bitmap(NVGcontext* pContext, const char* path, double sourceScale, int nvgImageID, bool shared)
@@ -120,13 +205,36 @@ IGraphicsNanoVG::Bitmap::Bitmap(IGraphicsNanoVG* pGraphics, NVGcontext* pContext
   SetBitmap(mFBO->image, width, height, scale, drawScale);
 }
 
-IGraphicsNanoVG::Bitmap::Bitmap(NVGcontext* pContext, int width, int height, const uint8_t* pData, int scale, float drawScale)
+IGraphicsNanoVG::Bitmap::Bitmap(NVGcontext* pContext, int width, int height, const uint8_t* pData, int scale, float drawScale, int imageFlags)
 {
-  int idx = nvgCreateImageRGBA(pContext, width, height, 0, pData);
+  int idx = nvgCreateImageRGBA(pContext, width, height, imageFlags, pData);
   mVG = pContext;
   SetBitmap(idx, width, height, scale, drawScale);
 }
 
+IGraphicsNanoVG::Bitmap::Bitmap(NVGcontext* pContext, int atlasImage, int atlasSize, int x, int y, int width, int height, int scale)
+{
+  mVG = pContext;
+  mSharedTexture = true;
+  mAtlasX = x;
+  mAtlasY = y;
+  mAtlasSize = atlasSize;
+  SetBitmap(atlasImage, width, height, scale, 1.f);
+}
+
+void IGraphicsNanoVG::Bitmap::Recreate(const uint8_t* pData, int imageFlags)
+{
+  assert(!mFBO && !mSharedTexture);
+  
+  const int idx = nvgCreateImageRGBA(mVG, GetWidth(), GetHeight(), imageFlags, pData);
+  
+  if (idx)
+  {
+    nvgDeleteImage(mVG, GetBitmap());
+    SetBitmap(idx, GetWidth(), GetHeight(), GetScale(), GetDrawScale());
+  }
+}
+
 IGraphicsNanoVG::Bitmap::~Bitmap()
 {
   if(!mSharedTexture)
@@ -138,6 +246,296 @@ IGraphicsNanoVG::Bitmap::~Bitmap()
   }
 }
 
+#if defined IGRAPHICS_GL
+/** The GL objects of an IShader: its program, its data textures and the frame buffer it is rendered into, which is drawn like a layer */
+class IGraphicsNanoVG::Shader : public APIShader
+{
+public:
+  Shader(IGraphicsNanoVG* pGraphics)
+  : mGraphics(pGraphics)
+  {
+  }
+
+  ~Shader()
+  {
+    // the controls are removed before the context is deleted, see OnViewDestroyed()
+    DeleteProgram();
+    glDeleteTextures(IShader::kMaxTextures, mTextures);
+
+    if (mVertexBuffer)
+      glDeleteBuffers(1, &mVertexBuffer);
+#if defined IGRAPHICS_GL3 || defined IGRAPHICS_GLES3
+    if (mVertexArray)
+      glDeleteVertexArrays(1, &mVertexArray);
+#endif
+  }
+
+  /** Compile and link the source of an IShader, setting its error if it fails */
+  void Compile(IShader& shader);
+
+  /** Upload the textures that have changed and render the shader into the frame buffer, which must be width x height */
+  void Render(const IShader& shader, int width, int height);
+
+  void DeleteProgram()
+  {
+    if (mProgram)
+      glDeleteProgram(mProgram);
+
+    mProgram = 0;
+  }
+
+  IGraphicsNanoVG* mGraphics;
+  std::unique_ptr<Bitmap> mTarget;
+  GLuint mProgram = 0;
+  uint64_t mSourceVersion = 0;
+
+private:
+  GLint mResolutionLoc = -1;
+  GLint mParamsLoc = -1;
+  GLint mTextureLocs[IShader::kMaxTextures] = {};
+  GLuint mTextures[IShader::kMaxTextures] = {};
+  int mTextureWidths[IShader::kMaxTextures] = {};
+  int mTextureHeights[IShader::kMaxTextures] = {};
+  uint64_t mTextureVersions[IShader::kMaxTextures] = {};
+  std::vector<uint8_t> mUpload;
+  GLuint mVertexBuffer = 0;
+  GLuint mVertexArray = 0;
+};
+
+// The shader source is written for GLSL 1.10 and adapted with these, like NanoVG's own shaders
+#if defined IGRAPHICS_GL3
+  #define SHADER_HEADER "#version 150 core\n"
+  #define SHADER_VERTEX_DEFINES "#define attribute in\n#define varying out\n"
+  #define SHADER_FRAGMENT_DEFINES "#define varying in\n#define texture2D texture\nout vec4 outColor;\n#define SHADER_OUT outColor\n"
+#elif defined IGRAPHICS_GLES3
+  #define SHADER_HEADER "#version 300 es\nprecision highp float;\n"
+  #define SHADER_VERTEX_DEFINES "#define attribute in\n#define varying out\n"
+  #define SHADER_FRAGMENT_DEFINES "#define varying in\n#define texture2D texture\nout vec4 outColor;\n#define SHADER_OUT outColor\n"
+#elif defined IGRAPHICS_GLES2
+  #define SHADER_HEADER "#version 100\nprecision highp float;\n"
+  #define SHADER_VERTEX_DEFINES ""
+  #define SHADER_FRAGMENT_DEFINES "#define SHADER_OUT gl_FragColor\n"
+#else
+  #define SHADER_HEADER "#version 110\n"
+  #define SHADER_VERTEX_DEFINES ""
+  #define SHADER_FRAGMENT_DEFINES "#define SHADER_OUT gl_FragColor\n"
+#endif
+
+static GLuint CompileGLShader(GLenum type, const std::string& source, std::string& error)
+{
+  GLuint shader = glCreateShader(type);
+  const char* pSource = source.c_str();
+  glShaderSource(shader, 1, &pSource, nullptr);
+  glCompileShader(shader);
+
+  GLint compiled = 0;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+
+  if (!compiled)
+  {
+    GLint length = 0;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+    std::vector<char> log(std::max(length, 1), '\0');
+    glGetShaderInfoLog(shader, static_cast<GLsizei>(log.size()), nullptr, log.data());
+    error = log.data();
+    glDeleteShader(shader);
+    return 0;
+  }
+
+  return shader;
+}
+
+void IGraphicsNanoVG::Shader::Compile(IShader& shader)
+{
+  DeleteProgram();
+  mSourceVersion = shader.GetSourceVersion();
+
+  static const char* kVertexSource =
+    SHADER_HEADER
+    SHADER_VERTEX_DEFINES
+    "attribute vec2 pos;\n"
+    "varying vec2 uv;\n"
+    "void main() {\n"
+    "  uv = vec2(pos.x * 0.5 + 0.5, 0.5 - pos.y * 0.5);\n"
+    "  gl_Position = vec4(pos, 0.0, 1.0);\n"
+    "}\n";
+
+  std::string fragmentSource =
+    SHADER_HEADER
+    SHADER_FRAGMENT_DEFINES
+    "varying vec2 uv;\n"
+    "uniform vec2 resolution;\n"
+    "uniform vec4 params[4];\n"
+    "uniform sampler2D tex0;\n"
+    "uniform sampler2D tex1;\n"
+    "uniform sampler2D tex2;\n"
+    "uniform sampler2D tex3;\n"
+    "#line 1\n";
+  fragmentSource += shader.GetSource();
+  fragmentSource += "\nvoid main() { SHADER_OUT = shade(uv); }\n";
+
+  std::string error;
+  GLuint vertexShader = CompileGLShader(GL_VERTEX_SHADER, kVertexSource, error);
+  GLuint fragmentShader = vertexShader ? CompileGLShader(GL_FRAGMENT_SHADER, fragmentSource, error) : 0;
+
+  if (vertexShader && fragmentShader)
+  {
+    mProgram = glCreateProgram();
+    glAttachShader(mProgram, vertexShader);
+    glAttachShader(mProgram, fragmentShader);
+    glBindAttribLocation(mProgram, 0, "pos");
+    glLinkProgram(mProgram);
+
+    GLint linked = 0;
+    glGetProgramiv(mProgram, GL_LINK_STATUS, &linked);
+
+    if (!linked)
+    {
+      GLint length = 0;
+      glGetProgramiv(mProgram, GL_INFO_LOG_LENGTH, &length);
+      std::vector<char> log(std::max(length, 1), '\0');
+      glGetProgramInfoLog(mProgram, static_cast<GLsizei>(log.size()), nullptr, log.data());
+      error = log.data();
+      DeleteProgram();
+    }
+  }
+
+  if (vertexShader)
+    glDeleteShader(vertexShader);
+
+  if (fragmentShader)
+    glDeleteShader(fragmentShader);
+
+  if (!mProgram)
+  {
+    DBGMSG("IShader failed to compile: %s\n", error.c_str());
+    shader.SetError(error.c_str());
+    return;
+  }
+
+  shader.SetError(nullptr);
+  mResolutionLoc = glGetUniformLocation(mProgram, "resolution");
+  mParamsLoc = glGetUniformLocation(mProgram, "params");
+
+  for (auto t = 0; t < IShader::kMaxTextures; t++)
+  {
+    const char name[] = {'t', 'e', 'x', static_cast<char>('0' + t), '\0'};
+    mTextureLocs[t] = glGetUniformLocation(mProgram, name);
+  }
+}
+
+void IGraphicsNanoVG::Shader::Render(const IShader& shader, int width, int height)
+{
+#if defined IGRAPHICS_GL3 || defined IGRAPHICS_GLES3
+  const GLint internalFormat = GL_R8;
+  const GLenum format = GL_RED;
+#else
+  const GLint internalFormat = GL_LUMINANCE;
+  const GLenum format = GL_LUMINANCE;
+#endif
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  for (auto t = 0; t < IShader::kMaxTextures; t++)
+  {
+    const uint64_t version = shader.GetTextureVersion(t);
+
+    if (version == mTextureVersions[t])
+      continue;
+
+    mTextureVersions[t] = version;
+
+    const int w = shader.GetTextureWidth(t);
+    const int h = shader.GetTextureHeight(t);
+    const float* pData = shader.GetTextureData(t);
+
+    mUpload.resize(static_cast<size_t>(w) * h);
+
+    for (size_t i = 0; i < mUpload.size(); i++)
+      mUpload[i] = static_cast<uint8_t>(pData[i] * 255.f + 0.5f);
+
+    if (!mTextures[t])
+    {
+      glGenTextures(1, &mTextures[t]);
+      glBindTexture(GL_TEXTURE_2D, mTextures[t]);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    else
+      glBindTexture(GL_TEXTURE_2D, mTextures[t]);
+
+    if (w != mTextureWidths[t] || h != mTextureHeights[t])
+    {
+      glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, w, h, 0, format, GL_UNSIGNED_BYTE, mUpload.data());
+      mTextureWidths[t] = w;
+      mTextureHeights[t] = h;
+    }
+    else if (w && h)
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, format, GL_UNSIGNED_BYTE, mUpload.data());
+  }
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  nvgBindFramebuffer(mTarget->GetFBO());
+  glViewport(0, 0, width, height);
+  glDisable(GL_SCISSOR_TEST);
+  glDisable(GL_STENCIL_TEST);
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_CULL_FACE);
+  glDisable(GL_BLEND);
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+  glUseProgram(mProgram);
+  glUniform2f(mResolutionLoc, static_cast<float>(width), static_cast<float>(height));
+  glUniform4fv(mParamsLoc, IShader::kNumParams / 4, shader.GetParams());
+
+  for (auto t = 0; t < IShader::kMaxTextures; t++)
+  {
+    glActiveTexture(GL_TEXTURE0 + t);
+    glBindTexture(GL_TEXTURE_2D, mTextures[t]);
+    glUniform1i(mTextureLocs[t], t);
+  }
+
+#if defined IGRAPHICS_GL3 || defined IGRAPHICS_GLES3
+  if (!mVertexArray)
+    glGenVertexArrays(1, &mVertexArray);
+
+  glBindVertexArray(mVertexArray);
+#endif
+
+  if (!mVertexBuffer)
+  {
+    static const float kQuad[] = {-1.f, -1.f, 1.f, -1.f, -1.f, 1.f, 1.f, 1.f};
+    glGenBuffers(1, &mVertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mVertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(kQuad), kQuad, GL_STATIC_DRAW);
+  }
+  else
+    glBindBuffer(GL_ARRAY_BUFFER, mVertexBuffer);
+
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  glDisableVertexAttribArray(0);
+
+  // NanoVG sets the rest of the state it needs when it next flushes
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+#if defined IGRAPHICS_GL3 || defined IGRAPHICS_GLES3
+  glBindVertexArray(0);
+#endif
+
+  for (auto t = IShader::kMaxTextures; t-- > 0;)
+  {
+    glActiveTexture(GL_TEXTURE0 + t);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+
+  glUseProgram(0);
+}
+#endif
+
 // Fonts
 static StaticStorage<IFontData> sFontCache;
 
@@ -220,11 +618,14 @@ IGraphicsNanoVG::IGraphicsNanoVG(IGEditorDelegate& dlg, int w, int h, int fps, f
 {
   DBGMSG("IGraphics NanoVG @ %i FPS\n", fps);
   StaticStorage<IFontData>::Accessor storage(sFontCache);
-  storage.Release();
+  storage.Retain();
 }
 
 IGraphicsNanoVG::~IGraphicsNanoVG() 
 {
+  WaitForAsyncAssets();
+  mLoadedBitmaps.clear();
+
   StaticStorage<IFontData>::Accessor storage(sFontCache);
   storage.Release();
   ClearFBOStack();
@@ -251,6 +652,30 @@ const char* IGraphicsNanoVG::GetDrawingAPIStr()
 #endif
 }
 
+void IGraphicsNanoVG::GetMemoryReport(IMemoryReport& report) const
+{
+  IGraphicsPathBase::GetMemoryReport(report);
+
+  {
+    StaticStorage<IFontData>::Accessor storage(sFontCache);
+    report.AddShared("Font cache", storage.GetMemoryUsage([](const IFontData& font) { return static_cast<size_t>(font.GetSize()); }), storage.GetCount());
+  }
+
+  // textures belong to this instance's context, so they are not shared
+  StaticStorage<APIBitmap>::Accessor storage(const_cast<StaticStorage<APIBitmap>&>(mBitmapCache));
+  report.Add("Bitmap textures (GPU)", storage.GetMemoryUsage([](const APIBitmap& bitmap) {
+    return static_cast<const Bitmap&>(bitmap).InAtlas() ? 0 : bitmap.GetMemoryUsage();
+  }));
+  
+  size_t atlasBytes = 0;
+  
+  for (auto& atlas : mAtlases)
+    atlasBytes += atlas->mPixels.GetSize();
+  
+  report.Add("Bitmap atlas textures (GPU)", atlasBytes);
+  report.Add("Bitmap atlas pixels", atlasBytes);
+}
+
 bool IGraphicsNanoVG::BitmapExtSupported(const char* ext)
 {
   char extLower[32];
@@ -276,6 +701,19 @@ IBitmap IGraphicsNanoVG::LoadBitmap(const char* name, int nStates, bool framesAr
 
     WDL_String fullPathOrResourceID;
     int sourceScale = 0;
+
+    // Bitmaps in the resource pack are uploaded from the mapped pixels
+    if (SearchPackedBitmap(name, targetScale, sourceScale))
+    {
+      pAPIBitmap = storage.Find(name, sourceScale);
+
+      if (!pAPIBitmap && (pAPIBitmap = LoadPackedAPIBitmap(name, sourceScale)))
+        storage.Add(pAPIBitmap, name, sourceScale);
+
+      if (pAPIBitmap)
+        return IBitmap(pAPIBitmap, nStates, framesAreHorizontal, name);
+    }
+
     EResourceLocation resourceFound = SearchImageResource(name, ext, fullPathOrResourceID, targetScale, sourceScale);
 
     bool bitmapTypeSupported = BitmapExtSupported(ext); // KTX textures pass this test (since ext is png)
@@ -296,14 +734,219 @@ IBitmap IGraphicsNanoVG::LoadBitmap(const char* name, int nStates, bool framesAr
   return IBitmap(pAPIBitmap, nStates, framesAreHorizontal, name);
 }
 
+IBitmap IGraphicsNanoVG::LoadBitmapAsync(const char* name, int nStates, bool framesAreHorizontal, int targetScale)
+{
+  if (targetScale == 0)
+    targetScale = GetScreenScale();
+
+  StaticStorage<APIBitmap>::Accessor storage(mBitmapCache);
+  APIBitmap* pAPIBitmap = storage.Find(name, targetScale);
+
+  if (!pAPIBitmap)
+  {
+    const char* ext = name + strlen(name) - 1;
+    while (ext >= name && *ext != '.') --ext;
+    ++ext;
+
+    WDL_String fullPathOrResourceID;
+    int sourceScale = 0;
+
+    // Bitmaps in the resource pack need no decoding, so are loaded straight away
+    if (SearchPackedBitmap(name, targetScale, sourceScale))
+      return LoadBitmap(name, nStates, framesAreHorizontal, targetScale);
+
+    EResourceLocation resourceFound = SearchImageResource(name, ext, fullPathOrResourceID, targetScale, sourceScale);
+
+    auto pDecode = std::make_shared<BitmapDecode>();
+    bool canDecode = false;
+    int nChannels = 0;
+
+    // Only image files can be decoded away from the context, so anything else (e.g. preloaded textures on iOS) loads synchronously
+    if (BitmapExtSupported(ext))
+    {
+#ifdef OS_WIN
+      if (resourceFound == EResourceLocation::kWinBinary)
+      {
+        pDecode->mResData = static_cast<const unsigned char*>(LoadWinResource(fullPathOrResourceID.Get(), ext, pDecode->mResSize, GetWinModuleHandle()));
+        canDecode = pDecode->mResData && stbi_info_from_memory(pDecode->mResData, pDecode->mResSize, &pDecode->mWidth, &pDecode->mHeight, &nChannels);
+      }
+      else
+#endif
+      if (resourceFound == EResourceLocation::kAbsolutePath)
+        canDecode = stbi_info(fullPathOrResourceID.Get(), &pDecode->mWidth, &pDecode->mHeight, &nChannels);
+    }
+
+    if (!canDecode)
+      return LoadBitmap(name, nStates, framesAreHorizontal, targetScale);
+
+    // A transparent texture of the right size stands in until the pixels are uploaded into it
+    RawBitmapData blank;
+    blank.Resize(pDecode->mWidth * pDecode->mHeight * 4);
+    memset(blank.Get(), 0, blank.GetSize());
+    pAPIBitmap = new Bitmap(mVG, pDecode->mWidth, pDecode->mHeight, blank.Get(), sourceScale, 1.f, GetImageFlags());
+    storage.Add(pAPIBitmap, name, sourceScale);
+
+    pDecode->mBitmap = pAPIBitmap;
+    pDecode->mPath.Set(fullPathOrResourceID.Get());
+
+    // The same settings as nvgCreateImage(), which sets them on every call
+    stbi_set_unpremultiply_on_load(1);
+    stbi_convert_iphone_png_to_rgb(1);
+
+    LoadAsync([pDecode]() {
+      int w = 0, h = 0, n = 0;
+      unsigned char* pImage = pDecode->mResData ? stbi_load_from_memory(pDecode->mResData, pDecode->mResSize, &w, &h, &n, 4)
+                                                : stbi_load(pDecode->mPath.Get(), &w, &h, &n, 4);
+
+      if (pImage && w == pDecode->mWidth && h == pDecode->mHeight)
+      {
+        pDecode->mPixels.Resize(w * h * 4);
+        memcpy(pDecode->mPixels.Get(), pImage, pDecode->mPixels.GetSize());
+      }
+
+      if (pImage)
+        stbi_image_free(pImage);
+    },
+    [this, pDecode]() {
+      if (pDecode->mPixels.GetSize())
+        mLoadedBitmaps.push_back(pDecode);
+      else
+        DBGMSG("Could not decode bitmap %s\n", pDecode->mPath.Get());
+    });
+  }
+
+  return IBitmap(pAPIBitmap, nStates, framesAreHorizontal, name);
+}
+
+void IGraphicsNanoVG::UploadLoadedBitmaps()
+{
+  for (auto& pDecode : mLoadedBitmaps)
+  {
+    // updating a texture doesn't regenerate its mip levels, so a texture with mipmaps is made again
+    if (GetImageFlags() & NVG_IMAGE_GENERATE_MIPMAPS)
+      static_cast<Bitmap*>(pDecode->mBitmap)->Recreate(pDecode->mPixels.Get(), GetImageFlags());
+    else
+      nvgUpdateImage(mVG, pDecode->mBitmap->GetBitmap(), pDecode->mPixels.Get());
+  }
+
+  mLoadedBitmaps.clear();
+}
+
+void IGraphicsNanoVG::SetBitmapAtlas(bool enable, int atlasSize, int maxBitmapSize)
+{
+  mAtlasEnabled = enable;
+  mAtlasSize = std::max(atlasSize, 64);
+  // each bitmap has a one pixel border
+  mAtlasMaxBitmapSize = std::min(maxBitmapSize, mAtlasSize - 2);
+}
+
+APIBitmap* IGraphicsNanoVG::LoadAtlasBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext)
+{
+  const unsigned char* pResData = nullptr;
+  int resSize = 0;
+  
+#ifdef OS_WIN
+  if (location == EResourceLocation::kWinBinary)
+  {
+    pResData = static_cast<const unsigned char*>(LoadWinResource(fileNameOrResID, ext, resSize, GetWinModuleHandle()));
+    
+    if (!pResData)
+      return nullptr;
+  }
+  else
+#endif
+  if (location != EResourceLocation::kAbsolutePath)
+    return nullptr;
+  
+  int w = 0, h = 0, n = 0;
+  const bool found = pResData ? stbi_info_from_memory(pResData, resSize, &w, &h, &n) : stbi_info(fileNameOrResID, &w, &h, &n);
+  
+  if (!found || w <= 0 || h <= 0 || w > mAtlasMaxBitmapSize || h > mAtlasMaxBitmapSize)
+    return nullptr;
+  
+  // The same settings as nvgCreateImage(), which sets them on every call
+  stbi_set_unpremultiply_on_load(1);
+  stbi_convert_iphone_png_to_rgb(1);
+  
+  unsigned char* pImage = pResData ? stbi_load_from_memory(pResData, resSize, &w, &h, &n, 4) : stbi_load(fileNameOrResID, &w, &h, &n, 4);
+  
+  if (!pImage)
+    return nullptr;
+  
+  // A one pixel border repeats the edges, so filtering samples the bitmap as if it were clamped in a texture of its own
+  const int paddedW = w + 2;
+  const int paddedH = h + 2;
+  Atlas* pAtlas = nullptr;
+  int x = 0, y = 0;
+  
+  for (auto& atlas : mAtlases)
+  {
+    if (atlas->Allocate(paddedW, paddedH, x, y))
+    {
+      pAtlas = atlas.get();
+      break;
+    }
+  }
+  
+  if (!pAtlas)
+  {
+    mAtlases.push_back(std::make_unique<Atlas>(mVG, mAtlasSize));
+    pAtlas = mAtlases.back().get();
+    
+    if (!pAtlas->mImage || !pAtlas->Allocate(paddedW, paddedH, x, y))
+    {
+      stbi_image_free(pImage);
+      mAtlases.pop_back();
+      return nullptr;
+    }
+  }
+  
+  const int stride = pAtlas->mSize * 4;
+  
+  for (int row = 0; row < paddedH; row++)
+  {
+    const unsigned char* pSrc = pImage + Clip(row - 1, 0, h - 1) * w * 4;
+    unsigned char* pDst = pAtlas->mPixels.Get() + (y + row) * stride + x * 4;
+    
+    memcpy(pDst, pSrc, 4);
+    memcpy(pDst + 4, pSrc, w * 4);
+    memcpy(pDst + (w + 1) * 4, pSrc + (w - 1) * 4, 4);
+  }
+  
+  stbi_image_free(pImage);
+  
+  NVGparams* pParams = nvgInternalParams(mVG);
+  pParams->renderUpdateTexture(pParams->userPtr, pAtlas->mImage, x, y, paddedW, paddedH, pAtlas->mPixels.Get());
+  
+  return new Bitmap(mVG, pAtlas->mImage, pAtlas->mSize, x + 1, y + 1, w, h, scale);
+}
+
+void IGraphicsNanoVG::ClearAtlases()
+{
+  for (auto& atlas : mAtlases)
+  {
+    if (atlas->mImage)
+      nvgDeleteImage(mVG, atlas->mImage);
+  }
+  
+  mAtlases.clear();
+}
+
 APIBitmap* IGraphicsNanoVG::LoadAPIBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext)
 {
+  // mip levels of an atlas would blend neighbouring bitmaps, so bitmaps with mipmaps get textures of their own
+  if (mAtlasEnabled && !GetBitmapMipmaps())
+  {
+    if (APIBitmap* pAtlasBitmap = LoadAtlasBitmap(fileNameOrResID, scale, location, ext))
+      return pAtlasBitmap;
+  }
+  
   int idx = 0;
 
 #ifdef OS_IOS
   if (location == EResourceLocation::kPreloadedTexture)
   {
-    idx = mnvgCreateImageFromHandle(mVG, gTextureMap[fileNameOrResID], 0 /*flags*/);
+    idx = mnvgCreateImageFromHandle(mVG, gTextureMap[fileNameOrResID], 0 /*flags*/); // preloaded textures come with their own mip levels, if any
   }
   else
 #endif
@@ -317,13 +960,13 @@ APIBitmap* IGraphicsNanoVG::LoadAPIBitmap(const char* fileNameOrResID, int scale
     pResData = LoadWinResource(fileNameOrResID, ext, size, GetWinModuleHandle());
 
     if (pResData)
-      idx = nvgCreateImageMem(mVG, 0 /*flags*/, (unsigned char*)pResData, size);
+      idx = nvgCreateImageMem(mVG, GetImageFlags(), (unsigned char*)pResData, size);
   }
   else
 #endif
   if (location == EResourceLocation::kAbsolutePath)
   {
-    idx = nvgCreateImage(mVG, fileNameOrResID, 0);
+    idx = nvgCreateImage(mVG, fileNameOrResID, GetImageFlags());
   }
 
   return new Bitmap(mVG, fileNameOrResID, scale, idx, location == EResourceLocation::kPreloadedTexture);
@@ -347,6 +990,11 @@ APIBitmap* IGraphicsNanoVG::CreateAPIBitmap(int width, int height, int scale, do
   return pAPIBitmap;
 }
 
+APIBitmap* IGraphicsNanoVG::CreateAPIBitmapFromPixels(const uint8_t* pRGBA, int width, int height, int scale)
+{
+  return new Bitmap(mVG, width, height, pRGBA, scale, 1.f, GetImageFlags());
+}
+
 void IGraphicsNanoVG::GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& data)
 {
   const APIBitmap* pBitmap = layer->GetAPIBitmap();
@@ -371,39 +1019,120 @@ void IGraphicsNanoVG::ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, con
   
   if (mask.GetSize() >= size)
   {
-    if (!shadow.mDrawForeground)
-    {
-      PushLayer(layer.get());
-      nvgGlobalCompositeBlendFunc(mVG, NVG_ZERO, NVG_ZERO);
-      PathRect(layer->Bounds());
-      nvgFillColor(mVG, NanoVGColor(COLOR_TRANSPARENT));
-      nvgFill(mVG);
-      PopLayer();
-    }
-    
-    IRECT bounds(layer->Bounds());
-    
     Bitmap maskRawBitmap(mVG, width, height, mask.Get(), pBitmap->GetScale(), pBitmap->GetDrawScale());
-    APIBitmap* shadowBitmap = CreateAPIBitmap(width, height, pBitmap->GetScale(), pBitmap->GetDrawScale());
-    IBitmap tempLayerBitmap(shadowBitmap, 1, false);
-    IBitmap maskBitmap(&maskRawBitmap, 1, false);
-    ILayer shadowLayer(shadowBitmap, layer->Bounds());
-    
-    PathTransformSave();
+    CompositeShadow(layer, &maskRawBitmap, shadow);
+  }
+}
+
+void IGraphicsNanoVG::ApplyLayerDropShadow(ILayerPtr& layer, const IShadow& shadow)
+{
+  // Blurring with NanoVG's own image fills avoids reading the layer back with glReadPixels(), which stalls the pipeline.
+  // The kernel is the same as IGraphics::ApplyLayerDropShadow(), applied as one weighted, additive draw of the layer per tap
+  const APIBitmap* pBitmap = layer->GetAPIBitmap();
+  const int width = pBitmap->GetWidth();
+  const int height = pBitmap->GetHeight();
+  const float scale = pBitmap->GetScale() * pBitmap->GetDrawScale();
+  const float blurSize = std::max(1.f, (shadow.mBlurSize * scale) + 1.f);
+  const float blurConst = 4.5f / (blurSize * blurSize);
+  const int iSize = static_cast<int>(std::ceil(blurSize));
+
+  std::vector<float> kernel(iSize);
+  float normFactor = 0.f;
+
+  for (int i = 0; i < iSize; i++)
+  {
+    kernel[i] = std::round(255.f * std::exp(-(i * i) * blurConst));
+    normFactor += i ? kernel[i] * 2.f : kernel[i];
+  }
+
+  for (auto& weight : kernel)
+    weight /= normFactor;
+
+  ILayer horizontal(CreateAPIBitmap(width, height, pBitmap->GetScale(), pBitmap->GetDrawScale()), layer->Bounds());
+  ILayer vertical(CreateAPIBitmap(width, height, pBitmap->GetScale(), pBitmap->GetDrawScale()), layer->Bounds());
+
+  PathTransformSave();
+  BlurPass(pBitmap, horizontal, kernel, 1.f / scale, 0.f);
+  BlurPass(horizontal.GetAPIBitmap(), vertical, kernel, 0.f, 1.f / scale);
+  PathTransformRestore();
+
+  CompositeShadow(layer, const_cast<APIBitmap*>(vertical.GetAPIBitmap()), shadow);
+}
+
+void IGraphicsNanoVG::BlurPass(const APIBitmap* pSource, ILayer& dest, const std::vector<float>& kernel, float dx, float dy)
+{
+  const IRECT bounds = dest.Bounds();
+  const int nTaps = static_cast<int>(kernel.size());
+  const double scale = 1.0 / (pSource->GetScale() * pSource->GetDrawScale());
+
+  PushLayer(&dest);
+  nvgShapeAntiAlias(mVG, 0); // antialiased edges would add up along the kernel
+  nvgGlobalCompositeBlendFunc(mVG, NVG_ONE, NVG_ONE);
+
+  for (int i = 1 - nTaps; i < nTaps; i++)
+  {
+    const IRECT r = bounds.GetTranslated(i * dx, i * dy);
+    const float weight = kernel[std::abs(i)];
+
+    NVGpaint imgPaint;
+    nvgTransformScale(imgPaint.xform, scale, scale);
+    imgPaint.xform[4] = r.L;
+    imgPaint.xform[5] = r.T;
+    imgPaint.extent[0] = pSource->GetWidth();
+    imgPaint.extent[1] = pSource->GetHeight();
+    imgPaint.image = pSource->GetBitmap();
+    imgPaint.radius = imgPaint.feather = 0.f;
+    imgPaint.innerColor = imgPaint.outerColor = nvgRGBAf(1, 1, 1, weight);
+
+    nvgBeginPath(mVG);
+    nvgRect(mVG, r.L, r.T, r.W(), r.H());
+    nvgFillPaint(mVG, imgPaint);
+    nvgFill(mVG);
+  }
+
+  nvgGlobalCompositeOperation(mVG, NVG_SOURCE_OVER);
+  nvgShapeAntiAlias(mVG, 1);
+  nvgBeginPath(mVG);
+  PopLayer();
+}
+
+void IGraphicsNanoVG::CompositeShadow(ILayerPtr& layer, APIBitmap* pMask, const IShadow& shadow)
+{
+  const APIBitmap* pBitmap = layer->GetAPIBitmap();
+  int width = pBitmap->GetWidth();
+  int height = pBitmap->GetHeight();
+
+  if (!shadow.mDrawForeground)
+  {
     PushLayer(layer.get());
-    PushLayer(&shadowLayer);
-    DrawBitmap(maskBitmap, bounds, 0, 0, nullptr);
-    IBlend blend1(EBlend::SourceIn, 1.0);
+    nvgGlobalCompositeBlendFunc(mVG, NVG_ZERO, NVG_ZERO);
     PathRect(layer->Bounds());
-    PathTransformTranslate(-shadow.mXOffset, -shadow.mYOffset);
-    PathFill(shadow.mPattern, IFillOptions(), &blend1);
-    PopLayer();
-    IBlend blend2(EBlend::DestOver, shadow.mOpacity);
-    bounds.Translate(shadow.mXOffset, shadow.mYOffset);
-    DrawBitmap(tempLayerBitmap, bounds, 0, 0, &blend2);
+    nvgFillColor(mVG, NanoVGColor(COLOR_TRANSPARENT));
+    nvgFill(mVG);
     PopLayer();
-    PathTransformRestore();
   }
+  
+  IRECT bounds(layer->Bounds());
+  
+  APIBitmap* shadowBitmap = CreateAPIBitmap(width, height, pBitmap->GetScale(), pBitmap->GetDrawScale());
+  IBitmap tempLayerBitmap(shadowBitmap, 1, false);
+  IBitmap maskBitmap(pMask, 1, false);
+  ILayer shadowLayer(shadowBitmap, layer->Bounds());
+  
+  PathTransformSave();
+  PushLayer(layer.get());
+  PushLayer(&shadowLayer);
+  DrawBitmap(maskBitmap, bounds, 0, 0, nullptr);
+  IBlend blend1(EBlend::SourceIn, 1.0);
+  PathRect(layer->Bounds());
+  PathTransformTranslate(-shadow.mXOffset, -shadow.mYOffset);
+  PathFill(shadow.mPattern, IFillOptions(), &blend1);
+  PopLayer();
+  IBlend blend2(EBlend::DestOver, shadow.mOpacity);
+  bounds.Translate(shadow.mXOffset, shadow.mYOffset);
+  DrawBitmap(tempLayerBitmap, bounds, 0, 0, &blend2);
+  PopLayer();
+  PathTransformRestore();
 }
 
 void IGraphicsNanoVG::OnViewInitialized(void* pContext)
@@ -420,11 +1149,21 @@ void IGraphicsNanoVG::OnViewInitialized(void* pContext)
 
 void IGraphicsNanoVG::OnViewDestroyed()
 {
+  // the bitmaps that are still loading are about to be deleted with the context
+  WaitForAsyncAssets();
+  mLoadedBitmaps.clear();
+
   // need to remove all the controls to free framebuffers, before deleting context
   RemoveAllControls();
+  ClearSVGRasterCache();
+
+  // font IDs belong to the context
+  mFontIDs.clear();
+  mTextBoundsCache.clear();
 
   StaticStorage<APIBitmap>::Accessor storage(mBitmapCache);
   storage.Clear();
+  ClearAtlases();
   
   if(mMainFrameBuffer != nullptr)
     nvgDeleteFramebuffer(mMainFrameBuffer);
@@ -447,6 +1186,8 @@ void IGraphicsNanoVG::DrawResize()
   
   if (mMainFrameBuffer == nullptr)
     DBGMSG("Could not init FBO.\n");
+
+  mCompositeAll = true;
 }
 
 void IGraphicsNanoVG::BeginFrame()
@@ -454,12 +1195,19 @@ void IGraphicsNanoVG::BeginFrame()
   mInDraw = true;
   IGraphics::BeginFrame(); // start perf graph timing
 
+  UploadLoadedBitmaps();
+
 #ifdef IGRAPHICS_METAL
   //  mnvgClearWithColor(mVG, nvgRGBAf(0, 0, 0, 0));
 #else
     glViewport(0, 0, WindowWidth() * GetScreenScale(), WindowHeight() * GetScreenScale());
-    glClearColor(0.f, 0.f, 0.f, 0.f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+  
+    // a preserved back buffer still holds the last frame, and EndFrame() only overwrites what changed
+    if (!mBackbufferPreserved || mCompositeAll)
+    {
+      glClearColor(0.f, 0.f, 0.f, 0.f);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    }
   #if defined OS_MAC
     glGetIntegerv(GL_FRAMEBUFFER_BINDING, &mInitialFBO); // stash apple fbo
   #endif
@@ -467,6 +1215,8 @@ void IGraphicsNanoVG::BeginFrame()
   
   nvgBindFramebuffer(mMainFrameBuffer); // begin main frame buffer update
   nvgBeginFrame(mVG, WindowWidth(), WindowHeight(), GetScreenScale());
+
+  RenderPendingGlyphs();
 }
 
 void IGraphicsNanoVG::EndFrame()
@@ -477,15 +1227,38 @@ void IGraphicsNanoVG::EndFrame()
   
   NVGpaint img = nvgImagePattern(mVG, 0, 0, WindowWidth(), WindowHeight(), 0, mMainFrameBuffer->image, 1.0f);
 
+  if (mXTranslation != mCompositeXTranslation || mYTranslation != mCompositeYTranslation)
+    mCompositeAll = true;
+
   nvgSave(mVG);
   nvgResetTransform(mVG);
   nvgTranslate(mVG, mXTranslation, mYTranslation);
   nvgBeginPath(mVG);
-  nvgRect(mVG, 0, 0, WindowWidth(), WindowHeight());
+  
+  if (!mBackbufferPreserved || mCompositeAll)
+    nvgRect(mVG, 0, 0, WindowWidth(), WindowHeight());
+  else
+  {
+    // the drawn regions are pixel aligned, so they can be copied without antialiasing
+    const float drawScale = GetDrawScale();
+
+    for (auto i = 0; i < mFrameRects.Size(); i++)
+    {
+      const IRECT r = mFrameRects.Get(i).GetScaled(drawScale);
+      nvgRect(mVG, r.L, r.T, r.W(), r.H());
+    }
+  }
+  
+  nvgShapeAntiAlias(mVG, false);
+  nvgGlobalCompositeBlendFunc(mVG, NVG_ONE, NVG_ZERO);
   nvgFillPaint(mVG, img);
   nvgFill(mVG);
   nvgRestore(mVG);
   
+  mCompositeAll = false;
+  mCompositeXTranslation = mXTranslation;
+  mCompositeYTranslation = mYTranslation;
+  
 #if defined OS_MAC && defined IGRAPHICS_GL
   glBindFramebuffer(GL_FRAMEBUFFER, mInitialFBO); // restore apple fbo
 #endif
@@ -507,6 +1280,9 @@ void IGraphicsNanoVG::DrawBitmap(const IBitmap& bitmap, const IRECT& dest, int s
   
   assert(pAPIBitmap);
     
+  const Bitmap* pNVGBitmap = static_cast<const Bitmap*>(pAPIBitmap);
+  IRECT drawn = dest;
+    
   // First generate a scaled image paint
   NVGpaint imgPaint;
   double scale = 1.0 / (pAPIBitmap->GetScale() * pAPIBitmap->GetDrawScale());
@@ -520,11 +1296,23 @@ void IGraphicsNanoVG::DrawBitmap(const IBitmap& bitmap, const IRECT& dest, int s
   imgPaint.image = pAPIBitmap->GetBitmap();
   imgPaint.radius = imgPaint.feather = 0.f;
   imgPaint.innerColor = imgPaint.outerColor = nvgRGBAf(1, 1, 1, BlendWeight(pBlend));
+  
+  if (pNVGBitmap->InAtlas())
+  {
+    // Paint with the whole atlas, offset to the bitmap's region, and keep the neighbouring bitmaps out of the drawn rect
+    imgPaint.xform[4] -= static_cast<float>(pNVGBitmap->GetAtlasX() * scale);
+    imgPaint.xform[5] -= static_cast<float>(pNVGBitmap->GetAtlasY() * scale);
+    imgPaint.extent[0] = imgPaint.extent[1] = static_cast<float>(pNVGBitmap->GetAtlasSize());
+    drawn = dest.Intersect(IRECT(dest.L - srcX, dest.T - srcY, dest.L - srcX + bitmap.W(), dest.T - srcY + bitmap.H()));
+    
+    if (drawn.Empty())
+      return;
+  }
     
   // Now draw
     
   nvgBeginPath(mVG); // Clears any existing path
-  nvgRect(mVG, dest.L, dest.T, dest.W(), dest.H());
+  nvgRect(mVG, drawn.L, drawn.T, drawn.W(), drawn.H());
   nvgFillPaint(mVG, imgPaint);
   NanoVGSetBlendMode(mVG, pBlend);
   nvgFill(mVG);
@@ -532,6 +1320,49 @@ void IGraphicsNanoVG::DrawBitmap(const IBitmap& bitmap, const IRECT& dest, int s
   nvgBeginPath(mVG); // Clears the bitmap rect from the path state
 }
 
+#if defined IGRAPHICS_GL
+bool IGraphicsNanoVG::DrawShader(IShader& shader, const IRECT& bounds, const IBlend* pBlend)
+{
+  const float scale = GetBackingPixelScale();
+  const int width = static_cast<int>(std::ceil(bounds.W() * scale));
+  const int height = static_cast<int>(std::ceil(bounds.H() * scale));
+
+  if (!mInDraw || width <= 0 || height <= 0 || !*shader.GetSource())
+    return IGraphics::DrawShader(shader, bounds, pBlend);
+
+  Shader* pShader = dynamic_cast<Shader*>(shader.GetAPIShader());
+
+  if (!pShader || pShader->mGraphics != this)
+  {
+    pShader = new Shader(this);
+    shader.SetAPIShader(pShader);
+  }
+
+  if (pShader->mSourceVersion != shader.GetSourceVersion())
+    pShader->Compile(shader);
+
+  if (!pShader->mProgram)
+    return IGraphics::DrawShader(shader, bounds, pBlend);
+
+  // the shader is rendered between NanoVG frames, as NanoVG only issues its GL calls when a frame ends
+  nvgEndFrame(mVG);
+
+  if (!pShader->mTarget || pShader->mTarget->GetWidth() != width || pShader->mTarget->GetHeight() != height)
+    pShader->mTarget.reset(new Bitmap(this, mVG, width, height, GetScreenScale(), GetDrawScale()));
+
+  pShader->Render(shader, width, height);
+
+  // a new frame starts without a transform or a scissor
+  BeginTargetFrame();
+  PathTransformSetMatrix(IMatrix());
+  SetClipRegion(mClipRegion);
+  PathTransformSetMatrix(GetTransformMatrix());
+
+  DrawFittedBitmap(IBitmap(pShader->mTarget.get(), 1, false), bounds, pBlend);
+  return true;
+}
+#endif
+
 void IGraphicsNanoVG::PathClear()
 {
   nvgBeginPath(mVG);
@@ -572,15 +1403,27 @@ IColor IGraphicsNanoVG::GetPoint(int x, int y)
   return COLOR_BLACK; //TODO:
 }
 
-void IGraphicsNanoVG::PrepareAndMeasureText(const IText& text, const char* str, IRECT& r, double& x, double & y) const
+void IGraphicsNanoVG::PrepareText(const IText& text, const IRECT& r, double& x, double& y) const
 {
-  float fbounds[4];
-  
-  assert(nvgFindFont(mVG, text.mFont) != -1 && "No font found - did you forget to load it?");
-  
+  // nvgFontFace() searches the fonts by name on every call, so the IDs are looked up once
+  auto it = mFontIDs.find(text.mFont);
+
+  if (it == mFontIDs.end())
+  {
+    const int fontID = nvgFindFont(mVG, text.mFont);
+    assert(fontID != -1 && "No font found - did you forget to load it?");
+
+    if (fontID != -1)
+      it = mFontIDs.emplace(text.mFont, fontID).first;
+  }
+
   nvgFontBlur(mVG, 0);
   nvgFontSize(mVG, text.mSize);
-  nvgFontFace(mVG, text.mFont);
+
+  if (it != mFontIDs.end())
+    nvgFontFaceId(mVG, it->second);
+  else
+    nvgFontFace(mVG, text.mFont);
   
   int align = 0;
   
@@ -599,9 +1442,57 @@ void IGraphicsNanoVG::PrepareAndMeasureText(const IText& text, const char* str,
   }
   
   nvgTextAlign(mVG, align);
-  nvgTextBounds(mVG, x, y, str, NULL, fbounds);
-  
-  r = IRECT(fbounds[0], fbounds[1], fbounds[2], fbounds[3]);
+}
+
+void IGraphicsNanoVG::MeasurePreparedText(const IText& text, const char* str, double x, double y, IRECT& r) const
+{
+  // NanoVG measures glyphs at the transform's scale, quantized as in nvg__getFontScale()
+  float xform[6];
+  nvgCurrentTransform(mVG, xform);
+  const float avgScale = (std::sqrt(xform[0] * xform[0] + xform[2] * xform[2]) + std::sqrt(xform[1] * xform[1] + xform[3] * xform[3])) * 0.5f;
+  const int fontScale = static_cast<int>(std::round(std::min(avgScale, 4.f) * 100.f * GetScreenScale()));
+
+  struct Key
+  {
+    char mFont[FONT_LEN];
+    float mSize;
+    int mAlign;
+    int mVAlign;
+    int mScale;
+  } key;
+
+  // the key's bytes are hashed, padding included
+  memset(&key, 0, sizeof(Key));
+  strcpy(key.mFont, text.mFont);
+  key.mSize = text.mSize;
+  key.mAlign = static_cast<int>(text.mAlign);
+  key.mVAlign = static_cast<int>(text.mVAlign);
+  key.mScale = fontScale;
+
+  std::string keyStr(reinterpret_cast<const char*>(&key), sizeof(Key));
+  keyStr.append(str);
+
+  auto it = mTextBoundsCache.find(keyStr);
+
+  if (it == mTextBoundsCache.end())
+  {
+    if (mTextBoundsCache.size() >= kMaxCachedTextBounds)
+      mTextBoundsCache.clear();
+
+    float fbounds[4];
+    nvgTextBounds(mVG, x, y, str, NULL, fbounds);
+
+    // glyph positions are rounded to pixels, so the bounds are the same to within a pixel at any other anchor
+    it = mTextBoundsCache.emplace(keyStr, IRECT(fbounds[0] - x, fbounds[1] - y, fbounds[2] - x, fbounds[3] - y)).first;
+  }
+
+  r = it->second.GetTranslated(x, y);
+}
+
+void IGraphicsNanoVG::PrepareAndMeasureText(const IText& text, const char* str, IRECT& r, double& x, double & y) const
+{
+  PrepareText(text, r, x, y);
+  MeasurePreparedText(text, str, x, y, r);
 }
 
 void IGraphicsNanoVG::DoMeasureText(const IText& text, const char* str, IRECT& bounds) const
@@ -617,7 +1508,12 @@ void IGraphicsNanoVG::DoDrawText(const IText& text, const char* str, const IRECT
   IRECT measured = bounds;
   double x, y;
   
-  PrepareAndMeasureText(text, str, measured, x, y);
+  // the text only needs measuring to work out its rotation, nvgText() aligns it itself
+  if (text.mAngle)
+    PrepareAndMeasureText(text, str, measured, x, y);
+  else
+    PrepareText(text, bounds, x, y);
+
   PathTransformSave();
   DoTextRotation(text, bounds, measured);
   nvgFillColor(mVG, NanoVGColor(text.mFGColor, pBlend));
@@ -627,6 +1523,36 @@ void IGraphicsNanoVG::DoDrawText(const IText& text, const char* str, const IRECT
   PathTransformRestore();
 }
 
+void IGraphicsNanoVG::PrepareGlyphs(const IText& text, const char* chars)
+{
+  if (!chars)
+  {
+    char ascii[96];
+
+    for (int i = 0; i < 95; i++)
+      ascii[i] = static_cast<char>(' ' + i);
+
+    ascii[95] = 0;
+    mPendingGlyphs.emplace_back(text, ascii);
+  }
+  else
+    mPendingGlyphs.emplace_back(text, chars);
+}
+
+void IGraphicsNanoVG::RenderPendingGlyphs()
+{
+  // Drawing the glyphs transparently is the only way to have NanoVG rasterize them into its atlas
+  for (auto& glyphs : mPendingGlyphs)
+  {
+    double x, y;
+    PrepareText(glyphs.first, IRECT(), x, y);
+    nvgFillColor(mVG, nvgRGBA(0, 0, 0, 0));
+    nvgText(mVG, 0.f, 0.f, glyphs.second.c_str(), NULL);
+  }
+
+  mPendingGlyphs.clear();
+}
+
 void IGraphicsNanoVG::PathStroke(const IPattern& pattern, float thickness, const IStrokeOptions& options, const IBlend* pBlend)
 {
   // First set options
@@ -679,17 +1605,24 @@ void IGraphicsNanoVG::PathFill(const IPattern& pattern, const IFillOptions& opti
     nvgBeginPath(mVG); // Clears the path state
 }
 
-bool IGraphicsNanoVG::LoadAPIFont(const char* fontID, const PlatformFontPtr& font)
+bool IGraphicsNanoVG::LoadCachedAPIFont(const char* fontID)
 {
+  // the font data is shared, but each context has its own font stash, which the face is added to without copying the data
+  if (nvgFindFont(mVG, fontID) != -1)
+    return true;
+  
   StaticStorage<IFontData>::Accessor storage(sFontCache);
   IFontData* cached = storage.Find(fontID);
-    
-  if (cached)
-  {
-    nvgCreateFontFaceMem(mVG, fontID, cached->Get(), cached->GetSize(), cached->GetFaceIdx(), 0);
+  
+  return cached && nvgCreateFontFaceMem(mVG, fontID, cached->Get(), cached->GetSize(), cached->GetFaceIdx(), 0) != -1;
+}
+
+bool IGraphicsNanoVG::LoadAPIFont(const char* fontID, const PlatformFontPtr& font)
+{
+  if (LoadCachedAPIFont(fontID))
     return true;
-  }
-    
+  
+  StaticStorage<IFontData>::Accessor storage(sFontCache);
   IFontDataPtr data = font->GetFontData();
 
   if (data->IsValid() && nvgCreateFontFaceMem(mVG, fontID, data->Get(), data->GetSize(), data->GetFaceIdx(), 0) != -1)
@@ -702,10 +1635,15 @@ bool IGraphicsNanoVG::LoadAPIFont(const char* fontID, const PlatformFontPtr& fon
 }
 
 void IGraphicsNanoVG::UpdateLayer()
+{
+  nvgEndFrame(mVG);
+  BeginTargetFrame();
+}
+
+void IGraphicsNanoVG::BeginTargetFrame()
 {
   if (mLayers.empty())
   {
-    nvgEndFrame(mVG);
 #ifdef IGRAPHICS_GL
     glViewport(0, 0, WindowWidth() * GetScreenScale(), WindowHeight() * GetScreenScale());
 #endif
@@ -714,7 +1652,6 @@ void IGraphicsNanoVG::UpdateLayer()
   }
   else
   {
-    nvgEndFrame(mVG);
 #ifdef IGRAPHICS_GL
     const double scale = GetBackingPixelScale();
     glViewport(0, 0, mLayers.top()->Bounds().W() * scale, mLayers.top()->Bounds().H() * scale);
@@ -745,6 +1682,8 @@ void IGraphicsNanoVG::PathTransformSetMatrix(const IMatrix& m)
 
 void IGraphicsNanoVG::SetClipRegion(const IRECT& r)
 {
+  mClipRegion = r;
+
   if (!r.Empty())
     nvgScissor(mVG, r.L, r.T, r.W(), r.H());
   else
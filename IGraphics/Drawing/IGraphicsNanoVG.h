@@ -15,7 +15,11 @@
 
 #include "nanovg.h"
 #include "mutex.h"
+#include <memory>
 #include <stack>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 // Thanks to Olli Wang/MOUI for much of this macro magic  https://github.com/ollix/moui
 
@@ -70,6 +74,9 @@ class IGraphicsNanoVG : public IGraphicsPathBase
 {
 private:
   class Bitmap;
+#if defined IGRAPHICS_GL
+  class Shader;
+#endif
   
 public:
   IGraphicsNanoVG(IGEditorDelegate& dlg, int w, int h, int fps, float scale);
@@ -77,6 +84,8 @@ public:
 
   const char* GetDrawingAPIStr() override;
 
+  void GetMemoryReport(IMemoryReport& report) const override;
+
   void BeginFrame() override;
   void EndFrame() override;
   void OnViewInitialized(void* pContext) override;
@@ -85,6 +94,11 @@ public:
 
   void DrawBitmap(const IBitmap& bitmap, const IRECT& dest, int srcX, int srcY, const IBlend* pBlend) override;
 
+#if defined IGRAPHICS_GL
+  /** Renders the shader into a frame buffer the size of bounds in pixels, which is then drawn like a layer */
+  bool DrawShader(IShader& shader, const IRECT& bounds, const IBlend* pBlend) override;
+#endif
+
   void DrawDottedLine(const IColor& color, float x1, float y1, float x2, float y2, const IBlend* pBlend, float thickness, float dashLen) override;
   void DrawDottedRect(const IColor& color, const IRECT& bounds, const IBlend* pBlend, float thickness, float dashLen) override;
 
@@ -102,17 +116,29 @@ public:
   void* GetDrawContext() override { return (void*) mVG; }
     
   IBitmap LoadBitmap(const char* name, int nStates, bool framesAreHorizontal, int targetScale) override;
+  IBitmap LoadBitmapAsync(const char* name, int nStates, bool framesAreHorizontal, int targetScale) override;
   void ReleaseBitmap(const IBitmap& bitmap) override { }; // NO-OP
   void RetainBitmap(const IBitmap& bitmap, const char * cacheName) override { }; // NO-OP
   bool BitmapExtSupported(const char* ext) override;
 
+  /** Pack the bitmaps loaded by LoadBitmap() into shared atlas textures, so filmstrips and small images share a few textures
+   * and drawing them switches textures less often. Only image files and Windows resources no larger than maxBitmapSize are packed,
+   * others get their own texture as usual. It applies to bitmaps loaded after the call. Each atlas keeps a copy of its pixels in memory
+   * for uploading new bitmaps into it. Bitmaps are not packed while SetBitmapMipmaps() is enabled
+   * @param enable \c true to pack bitmaps into atlases
+   * @param atlasSize The width and height of each atlas texture in pixels
+   * @param maxBitmapSize The largest width or height in pixels of a bitmap that is packed */
+  void SetBitmapAtlas(bool enable, int atlasSize = 1024, int maxBitmapSize = 256);
+
   void DeleteFBO(NVGframebuffer* pBuffer);
     
 protected:
   APIBitmap* LoadAPIBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext) override;
   APIBitmap* CreateAPIBitmap(int width, int height, int scale, double drawScale) override;
+  APIBitmap* CreateAPIBitmapFromPixels(const uint8_t* pRGBA, int width, int height, int scale) override;
 
   bool LoadAPIFont(const char* fontID, const PlatformFontPtr& font) override;
+  bool LoadCachedAPIFont(const char* fontID) override;
 
   int AlphaChannel() const override { return 3; }
   
@@ -125,26 +151,68 @@ protected:
 #endif
   }
 
+  /** Called by the platform once it knows whether the window's back buffer keeps its contents after being presented.
+   * If it does, EndFrame() only copies the regions drawn in the frame to the window, rather than the whole main frame buffer
+   * @param preserved \c true if the back buffer is preserved between frames */
+  void SetBackbufferPreserved(bool preserved) { mBackbufferPreserved = preserved; mCompositeAll = true; }
+
   void GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& data) override;
   void ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const IShadow& shadow) override;
 
+public:
+  void ApplyLayerDropShadow(ILayerPtr& layer, const IShadow& shadow) override;
+
+protected:
+
   void DoMeasureText(const IText& text, const char* str, IRECT& bounds) const override;
   void DoDrawText(const IText& text, const char* str, const IRECT& bounds, const IBlend* pBlend) override;
 
+public:
+  void PrepareGlyphs(const IText& text, const char* chars) override;
+
 private:
+  void PrepareText(const IText& text, const IRECT& r, double& x, double& y) const;
+  void MeasurePreparedText(const IText& text, const char* str, double x, double y, IRECT& r) const;
   void PrepareAndMeasureText(const IText& text, const char* str, IRECT& r, double& x, double & y) const;
+  void RenderPendingGlyphs();
+  void BlurPass(const APIBitmap* pSource, ILayer& dest, const std::vector<float>& kernel, float dx, float dy);
+  void CompositeShadow(ILayerPtr& layer, APIBitmap* pMask, const IShadow& shadow);
   void PathTransformSetMatrix(const IMatrix& m) override;
   void SetClipRegion(const IRECT& r) override;
   void UpdateLayer() override;
+  /** Bind the frame buffer of the top layer, or the main one, and begin a NanoVG frame on it */
+  void BeginTargetFrame();
   void ClearFBOStack();
+  void UploadLoadedBitmaps();
   
+  APIBitmap* LoadAtlasBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext);
+  void ClearAtlases();
+  int GetImageFlags() const { return GetBitmapMipmaps() ? NVG_IMAGE_GENERATE_MIPMAPS : 0; }
+  
+  struct BitmapDecode;
+  struct Atlas;
+
   bool mInDraw = false;
   WDL_Mutex mFBOMutex;
   std::stack<NVGframebuffer*> mFBOStack; // A stack of FBOs that requires freeing at the end of the frame
   StaticStorage<APIBitmap> mBitmapCache; //not actually static (doesn't require retaining or releasing)
+  std::vector<std::shared_ptr<BitmapDecode>> mLoadedBitmaps; // Decoded by LoadBitmapAsync(), waiting to be uploaded in BeginFrame()
+  mutable std::unordered_map<std::string, int> mFontIDs; // Font names resolved to NanoVG font IDs
+  mutable std::unordered_map<std::string, IRECT> mTextBoundsCache; // Text bounds relative to the anchor, keyed by font, size, alignment, scale and string
+  std::vector<std::pair<IText, std::string>> mPendingGlyphs; // Queued by PrepareGlyphs(), rendered in BeginFrame()
+  std::vector<std::unique_ptr<Atlas>> mAtlases; // The shared textures of SetBitmapAtlas(), which belong to the context
+  bool mAtlasEnabled = false;
+  int mAtlasSize = 1024;
+  int mAtlasMaxBitmapSize = 256;
+  static constexpr size_t kMaxCachedTextBounds = 1024;
   NVGcontext* mVG = nullptr;
   NVGframebuffer* mMainFrameBuffer = nullptr;
+  IRECT mClipRegion; // The last region passed to SetClipRegion(), to set again when a frame is interrupted
   int mInitialFBO = 0;
+  bool mBackbufferPreserved = false;
+  bool mCompositeAll = true; // The next EndFrame() must copy the whole main frame buffer, even if the back buffer is preserved
+  float mCompositeXTranslation = 0.f;
+  float mCompositeYTranslation = 0.f;
 };
 
 END_IGRAPHICS_NAMESPACE
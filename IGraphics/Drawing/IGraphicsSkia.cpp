@@ -1,5 +1,12 @@
 #include <cmath>
 
+#ifdef IGRAPHICS_RENDER_THREAD
+  #include <condition_variable>
+  #include <mutex>
+  #include <thread>
+  #include <vector>
+#endif
+
 #include "IGraphicsSkia.h"
 
 #include "SkDashPathEffect.h"
@@ -20,10 +27,13 @@
   //even though this is a .cpp we are in an objc(pp) compilation unit
     #import <Metal/Metal.h>
     #import <QuartzCore/CAMetalLayer.h>
-  #else
+  #elif !defined IGRAPHICS_CPU
     #error Define either IGRAPHICS_GL2, IGRAPHICS_GL3, IGRAPHICS_METAL, or IGRAPHICS_CPU for IGRAPHICS_SKIA with OS_MAC
   #endif
 #elif defined OS_WIN
+  #if !defined IGRAPHICS_GL && !defined IGRAPHICS_CPU
+    #error Define either IGRAPHICS_GL2, IGRAPHICS_GL3, or IGRAPHICS_CPU for IGRAPHICS_SKIA with OS_WIN
+  #endif
   #pragma comment(lib, "libpng.lib")
   #pragma comment(lib, "zlib.lib")
   #pragma comment(lib, "skia.lib")
@@ -45,8 +55,10 @@ class IGraphicsSkia::Bitmap : public APIBitmap
 {
 public:
   Bitmap(GrContext* context, int width, int height, int scale, float drawScale);
+  Bitmap(int width, int height, int scale, float drawScale);
   Bitmap(const char* path, double sourceScale);
   Bitmap(const void* pData, int size, double sourceScale);
+  Bitmap(const uint8_t* pRGBA, int width, int height, int scale);
   
 private:
   SkiaDrawable mDrawable;
@@ -54,17 +66,31 @@ private:
   
 IGraphicsSkia::Bitmap::Bitmap(GrContext* context, int width, int height, int scale, float drawScale)
 {
-#ifdef IGRAPHICS_GL
-  SkImageInfo info = SkImageInfo::MakeN32Premul(width, height);
-  mDrawable.mSurface = SkSurface::MakeRenderTarget(context, SkBudgeted::kYes, info);
-#else
-  mDrawable.mSurface = SkSurface::MakeRasterN32Premul(width, height);
-#endif
+  // layers live on the GPU with the main surface, so drawing them to it doesn't read back or upload pixels
+  if (context)
+  {
+    SkImageInfo info = SkImageInfo::MakeN32Premul(width, height);
+    mDrawable.mSurface = SkSurface::MakeRenderTarget(context, SkBudgeted::kYes, info);
+  }
+  
+  if (!mDrawable.mSurface)
+    mDrawable.mSurface = SkSurface::MakeRasterN32Premul(width, height);
+  
   mDrawable.mIsSurface = true;
   
   SetBitmap(&mDrawable, width, height, scale, drawScale);
 }
 
+IGraphicsSkia::Bitmap::Bitmap(int width, int height, int scale, float drawScale)
+{
+  // draw commands are recorded until the first time the layer is drawn, and replayed from then on
+  mDrawable.mRecorder.reset(new SkPictureRecorder);
+  mDrawable.mRecorder->beginRecording(SkRect::MakeIWH(width, height));
+  mDrawable.mIsSurface = false;
+  
+  SetBitmap(&mDrawable, width, height, scale, drawScale);
+}
+
 IGraphicsSkia::Bitmap::Bitmap(const char* path, double sourceScale)
 {
   auto data = SkData::MakeFromFileName(path);
@@ -83,6 +109,17 @@ IGraphicsSkia::Bitmap::Bitmap(const void* pData, int size, double sourceScale)
   SetBitmap(&mDrawable, mDrawable.mImage->width(), mDrawable.mImage->height(), sourceScale, 1.f);
 }
 
+IGraphicsSkia::Bitmap::Bitmap(const uint8_t* pRGBA, int width, int height, int scale)
+{
+  // the pixels are in the resource pack, which stays mapped, so they are wrapped rather than copied
+  SkImageInfo info = SkImageInfo::Make(width, height, kRGBA_8888_SkColorType, kUnpremul_SkAlphaType);
+  auto data = SkData::MakeWithoutCopy(pRGBA, width * height * 4);
+  mDrawable.mImage = SkImage::MakeRasterData(info, data, width * 4);
+
+  mDrawable.mIsSurface = false;
+  SetBitmap(&mDrawable, width, height, scale, 1.f);
+}
+
 struct IGraphicsSkia::Font
 {
   Font(IFontDataPtr&& data, sk_sp<SkTypeface> typeFace)
@@ -95,6 +132,148 @@ struct IGraphicsSkia::Font
 // Fonts
 StaticStorage<IGraphicsSkia::Font> IGraphicsSkia::sFontCache;
 
+#ifdef IGRAPHICS_RENDER_THREAD
+/** Replays the frames recorded on the main thread into the retained surface, and presents it to the Metal layer. Only this thread uses the GrContext while it runs */
+class IGraphicsSkia::RenderThread
+{
+public:
+  RenderThread(GrContext* pContext, void* pMTLLayer, void* pMTLCommandQueue)
+  : mContext(pContext)
+  , mMTLLayer(pMTLLayer)
+  , mMTLCommandQueue(pMTLCommandQueue)
+  {
+    mThread = std::thread([this]() { Run(); });
+  }
+
+  ~RenderThread()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mQuit = true;
+    }
+
+    mCondition.notify_one();
+    mThread.join();
+  }
+
+  RenderThread(const RenderThread&) = delete;
+  RenderThread& operator=(const RenderThread&) = delete;
+
+  /** Resize the retained surface before the next frame is replayed. Its contents are lost, so a full redraw should follow */
+  void Resize(int width, int height)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mWidth = width;
+    mHeight = height;
+    mResized = true;
+  }
+
+  /** Queue a frame and wake the thread. Frames that queue up while it is busy are replayed together and presented once
+   * @param picture The frame's drawing, or nullptr to present the last frame again */
+  void Submit(sk_sp<SkPicture> picture)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+
+      if (picture)
+        mPictures.push_back(std::move(picture));
+
+      mFramePending = true;
+    }
+
+    mCondition.notify_one();
+  }
+
+private:
+  void Run()
+  {
+    std::vector<sk_sp<SkPicture>> pictures;
+
+    while (true)
+    {
+      int width, height;
+      bool resized;
+
+      {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [this]() { return mQuit || mFramePending; });
+
+        if (mQuit)
+          break;
+
+        pictures.swap(mPictures);
+        width = mWidth;
+        height = mHeight;
+        resized = mResized;
+        mFramePending = false;
+        mResized = false;
+      }
+
+      if (resized)
+      {
+        SkImageInfo info = SkImageInfo::MakeN32Premul(width, height);
+        mSurface = SkSurface::MakeRenderTarget(mContext, SkBudgeted::kYes, info);
+      }
+
+      if (mSurface)
+      {
+        for (auto& picture : pictures)
+          mSurface->getCanvas()->drawPicture(picture);
+
+        Present();
+      }
+
+      pictures.clear();
+    }
+
+    // the surface belongs to the context, which is abandoned once this thread has gone
+    mSurface.reset();
+  }
+
+  void Present()
+  {
+    @autoreleasepool {
+      id<CAMetalDrawable> currentDrawable = [(CAMetalLayer*) mMTLLayer nextDrawable];
+
+      if (!currentDrawable)
+        return;
+
+      GrMtlTextureInfo fbInfo;
+      fbInfo.fTexture = currentDrawable.texture;
+
+      GrBackendRenderTarget backendRT(mSurface->width(), mSurface->height(), 1 /* sample count/MSAA */, fbInfo);
+      auto screenSurface = SkSurface::MakeFromBackendRenderTarget(mContext, backendRT, kTopLeft_GrSurfaceOrigin, kBGRA_8888_SkColorType, nullptr, nullptr);
+
+      if (!screenSurface)
+        return;
+
+      mSurface->draw(screenSurface->getCanvas(), 0.0, 0.0, nullptr);
+      screenSurface->getCanvas()->flush();
+
+      id<MTLCommandBuffer> commandBuffer = [(id<MTLCommandQueue>) mMTLCommandQueue commandBuffer];
+      commandBuffer.label = @"Present";
+      [commandBuffer presentDrawable:currentDrawable];
+      [commandBuffer commit];
+    }
+  }
+
+  GrContext* mContext;
+  void* mMTLLayer;
+  void* mMTLCommandQueue;
+  sk_sp<SkSurface> mSurface; // retained between frames, since only the dirty regions are drawn
+
+  std::thread mThread;
+  std::mutex mMutex;
+  std::condition_variable mCondition;
+  std::vector<sk_sp<SkPicture>> mPictures;
+  int mWidth = 0;
+  int mHeight = 0;
+  bool mResized = false;
+  bool mFramePending = false;
+  bool mQuit = false;
+};
+#endif
+
 #pragma mark -
 
 // Utility conversions
@@ -148,7 +327,7 @@ static inline SkTileMode SkiaTileMode(const IPattern& pattern)
   return SkTileMode::kClamp;
 }
 
-static SkPaint SkiaPaint(const IPattern& pattern, const IBlend* pBlend)
+static SkPaint SkiaPaint(const IPattern& pattern, const IBlend* pBlend, IPatternCache<sk_sp<SkShader>>& gradientCache)
 {
   SkPaint paint;
   paint.setAntiAlias(true);
@@ -158,6 +337,10 @@ static SkPaint SkiaPaint(const IPattern& pattern, const IBlend* pBlend)
   {
     paint.setColor(SkiaColor(pattern.GetStop(0).mColor, pBlend));
   }
+  else if (const sk_sp<SkShader>* pShader = gradientCache.Find(pattern, pBlend ? pBlend->mWeight : 1.f))
+  {
+    paint.setShader(*pShader);
+  }
   else
   {
     double x1 = 0.0;
@@ -189,14 +372,14 @@ static SkPaint SkiaPaint(const IPattern& pattern, const IBlend* pBlend)
     }
    
     if(pattern.mType == EPatternType::Linear)
-      paint.setShader(SkGradientShader::MakeLinear(points, colors, positions, pattern.NStops(), SkiaTileMode(pattern), 0, nullptr));
+      paint.setShader(gradientCache.Add(SkGradientShader::MakeLinear(points, colors, positions, pattern.NStops(), SkiaTileMode(pattern), 0, nullptr)));
     else
     {
       float xd = points[0].x() - points[1].x();
       float yd = points[0].y() - points[1].y();
       float radius = std::sqrt(xd * xd + yd * yd);
         
-      paint.setShader(SkGradientShader::MakeRadial(points[0], radius, colors, positions, pattern.NStops(), SkiaTileMode(pattern), 0, nullptr));
+      paint.setShader(gradientCache.Add(SkGradientShader::MakeRadial(points[0], radius, colors, positions, pattern.NStops(), SkiaTileMode(pattern), 0, nullptr)));
     }
   }
     
@@ -246,6 +429,9 @@ void IGraphicsSkia::OnViewInitialized(void* pContext)
 #if defined IGRAPHICS_GL
   auto glInterface = GrGLMakeNativeInterface();
   mGrContext = GrContext::MakeGL(glInterface);
+  
+  if (!mGrContext)
+    DBGMSG("Could not create Skia GL context.\n");
 #elif defined IGRAPHICS_METAL
   @autoreleasepool {
     id<MTLDevice> device = MTLCreateSystemDefaultDevice();
@@ -257,12 +443,32 @@ void IGraphicsSkia::OnViewInitialized(void* pContext)
     ((CAMetalLayer*) pContext).device = device;
   }
 #endif
+
+#ifdef IGRAPHICS_RENDER_THREAD
+  if (mGrContext)
+    mRenderThread.reset(new RenderThread(mGrContext.get(), mMTLLayer, mMTLCommandQueue));
+#endif
     
   DrawResize();
 }
 
 void IGraphicsSkia::OnViewDestroyed()
 {
+  // GPU surfaces belong to the platform's context, which is deleted after this returns
+  RemoveAllControls();
+  ClearSVGRasterCache();
+#ifdef IGRAPHICS_RENDER_THREAD
+  mRenderThread.reset();
+#endif
+  mCanvas = nullptr;
+  mScreenSurface.reset();
+  mSurface.reset();
+  
+  if (mGrContext)
+  {
+    mGrContext->releaseResourcesAndAbandonContext();
+    mGrContext.reset();
+  }
 }
 
 void IGraphicsSkia::DrawResize()
@@ -270,7 +476,10 @@ void IGraphicsSkia::DrawResize()
   auto w = WindowWidth() * GetScreenScale();
   auto h = WindowHeight() * GetScreenScale();
   
-#if defined IGRAPHICS_GL || defined IGRAPHICS_METAL
+#if defined IGRAPHICS_RENDER_THREAD
+  if (mRenderThread)
+    mRenderThread->Resize(w, h);
+#elif defined IGRAPHICS_GL || defined IGRAPHICS_METAL
   if (mGrContext.get())
   {
     SkImageInfo info = SkImageInfo::MakeN32Premul(w, h);
@@ -297,8 +506,16 @@ void IGraphicsSkia::DrawResize()
     mSurface = SkSurface::MakeRasterN32Premul(w, h);
   #endif
 #endif
-  if (mSurface)
-    mCanvas = mSurface->getCanvas();
+  mCanvas = GetMainCanvas();
+}
+
+SkCanvas* IGraphicsSkia::GetMainCanvas()
+{
+#ifdef IGRAPHICS_RENDER_THREAD
+  return mFrameRecorder.getRecordingCanvas();
+#else
+  return mSurface ? mSurface->getCanvas() : nullptr;
+#endif
 }
 
 void IGraphicsSkia::BeginFrame()
@@ -306,7 +523,10 @@ void IGraphicsSkia::BeginFrame()
   int width = WindowWidth() * GetScreenScale();
   int height = WindowHeight() * GetScreenScale();
   
-#if defined IGRAPHICS_GL
+#if defined IGRAPHICS_RENDER_THREAD
+  // the main thread only records the frame, the render thread rasterizes and presents it
+  mCanvas = mFrameRecorder.beginRecording(SkRect::MakeIWH(width, height));
+#elif defined IGRAPHICS_GL
   if (mGrContext.get())
   {
     // Bind to the current main framebuffer
@@ -347,7 +567,9 @@ void IGraphicsSkia::BeginFrame()
 void IGraphicsSkia::EndFrame()
 {
 #ifdef IGRAPHICS_CPU
-  #ifdef OS_MAC
+  #if defined IGRAPHICS_HEADLESS
+    // the surface is read back by IGraphicsHeadless::GetImage()
+  #elif defined OS_MAC
     SkPixmap pixmap;
     mSurface->peekPixels(&pixmap);
     SkBitmap bmp;
@@ -358,16 +580,32 @@ void IGraphicsSkia::EndFrame()
     SkCGDrawBitmap(pCGContext, bmp, 0, 0);
     CGContextRestoreGState(pCGContext);
   #elif defined OS_WIN
-    auto w = WindowWidth() * GetScreenScale();
-    auto h = WindowHeight() * GetScreenScale();
+    const float windowScale = GetBackingPixelScale();
     BITMAPINFO* bmpInfo = reinterpret_cast<BITMAPINFO*>(mSurfaceMemory.Get());
     HWND hwnd = (HWND)GetWindow();
     HDC dc = GetDC(hwnd);
-    StretchDIBits(dc, 0, 0, w, h, 0, 0, w, h, bmpInfo->bmiColors, bmpInfo,  DIB_RGB_COLORS, SRCCOPY);
+  
+    // only present the regions drawn this frame, the surface is top-down so rows count from the top
+    for (auto i = 0; i < mFrameRects.Size(); i++)
+    {
+      const IRECT r = mFrameRects.Get(i).GetScaled(windowScale).GetPixelAligned();
+      const int x = static_cast<int>(r.L);
+      const int y = static_cast<int>(r.T);
+      const int w = static_cast<int>(r.W());
+      const int h = static_cast<int>(r.H());
+      StretchDIBits(dc, x, y, w, h, x, y, w, h, bmpInfo->bmiColors, bmpInfo,  DIB_RGB_COLORS, SRCCOPY);
+    }
+  
     ReleaseDC(hwnd, dc);
   #else
     #error NOT IMPLEMENTED
   #endif
+#elif defined IGRAPHICS_RENDER_THREAD
+  sk_sp<SkPicture> picture = mFrameRecorder.finishRecordingAsPicture();
+  mCanvas = nullptr;
+
+  if (mRenderThread)
+    mRenderThread->Submit(mFrameRects.Size() ? std::move(picture) : nullptr);
 #else
   mSurface->draw(mScreenSurface->getCanvas(), 0.0, 0.0, nullptr);
   mScreenSurface->getCanvas()->flush();
@@ -404,8 +642,16 @@ void IGraphicsSkia::DrawBitmap(const IBitmap& bitmap, const IRECT& dest, int src
   mCanvas->scale(scale1, scale1);
   mCanvas->translate(-srcX * scale2, -srcY * scale2);
   
+  if (image->mRecorder)
+  {
+    image->mPicture = image->mRecorder->finishRecordingAsPicture();
+    image->mRecorder.reset();
+  }
+  
   if (image->mIsSurface)
     image->mSurface->draw(mCanvas, 0.0, 0.0, &p);
+  else if (image->mPicture)
+    mCanvas->drawPicture(image->mPicture, nullptr, pBlend ? &p : nullptr); // a paint makes Skia replay into a temporary layer
   else
     mCanvas->drawImage(image->mImage, 0.0, 0.0, &p);
     
@@ -442,6 +688,13 @@ IColor IGraphicsSkia::GetPoint(int x, int y)
   return COLOR_BLACK; //TODO:
 }
 
+bool IGraphicsSkia::LoadCachedAPIFont(const char* fontID)
+{
+  // typefaces, and Skia's glyph cache, are process-wide, so there is nothing to do per context
+  StaticStorage<Font>::Accessor storage(sFontCache);
+  return storage.Find(fontID) != nullptr;
+}
+
 bool IGraphicsSkia::LoadAPIFont(const char* fontID, const PlatformFontPtr& font)
 {
   StaticStorage<Font>::Accessor storage(sFontCache);
@@ -539,7 +792,7 @@ void IGraphicsSkia::DoDrawText(const IText& text, const char* str, const IRECT&
 
 void IGraphicsSkia::PathStroke(const IPattern& pattern, float thickness, const IStrokeOptions& options, const IBlend* pBlend)
 {
-  SkPaint paint = SkiaPaint(pattern, pBlend);
+  SkPaint paint = SkiaPaint(pattern, pBlend, mGradientCache);
   paint.setStyle(SkPaint::kStroke_Style);
 
   switch (options.mCapOption)
@@ -583,7 +836,7 @@ void IGraphicsSkia::PathStroke(const IPattern& pattern, float thickness, const I
 
 void IGraphicsSkia::PathFill(const IPattern& pattern, const IFillOptions& options, const IBlend* pBlend)
 {
-  SkPaint paint = SkiaPaint(pattern, pBlend);
+  SkPaint paint = SkiaPaint(pattern, pBlend, mGradientCache);
   paint.setStyle(SkPaint::kFill_Style);
   
   if (options.mFillRule == EFillRule::Winding)
@@ -632,12 +885,34 @@ void IGraphicsSkia::SetClipRegion(const IRECT& r)
 
 APIBitmap* IGraphicsSkia::CreateAPIBitmap(int width, int height, int scale, double drawScale)
 {
+#ifdef IGRAPHICS_RENDER_THREAD
+  // the GPU context belongs to the render thread, which uploads layers when it replays the frames that draw them
+  return new Bitmap(nullptr, width, height, scale, drawScale);
+#else
   return new Bitmap(mGrContext.get(), width, height, scale, drawScale);
+#endif
+}
+
+APIBitmap* IGraphicsSkia::CreateAPIBitmapFromPixels(const uint8_t* pRGBA, int width, int height, int scale)
+{
+  return new Bitmap(pRGBA, width, height, scale);
+}
+
+APIBitmap* IGraphicsSkia::CreateRecordingAPIBitmap(int width, int height, int scale, double drawScale)
+{
+  return new Bitmap(width, height, scale, drawScale);
 }
 
 void IGraphicsSkia::UpdateLayer()
 {
-  mCanvas = mLayers.empty() ? mSurface->getCanvas() : mLayers.top()->GetAPIBitmap()->GetBitmap()->mSurface->getCanvas();
+  if (mLayers.empty())
+  {
+    mCanvas = GetMainCanvas();
+    return;
+  }
+  
+  SkiaDrawable* pDrawable = mLayers.top()->GetAPIBitmap()->GetBitmap();
+  mCanvas = pDrawable->mRecorder ? pDrawable->mRecorder->getRecordingCanvas() : pDrawable->mSurface->getCanvas();
 }
 
 static size_t CalcRowBytes(int width)
@@ -692,7 +967,7 @@ void IGraphicsSkia::ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const
   m = SkMatrix::MakeScale(scale);
   pCanvas->setMatrix(m);
   pCanvas->translate(-layer->Bounds().L, -layer->Bounds().T);
-  SkPaint p = SkiaPaint(shadow.mPattern, &blend);
+  SkPaint p = SkiaPaint(shadow.mPattern, &blend, mGradientCache);
   p.setBlendMode(SkBlendMode::kSrcIn);
   pCanvas->drawPaint(p);
 
@@ -2,26 +2,38 @@
 
 #include "IPlugPlatform.h"
 #include "IGraphicsPathBase.h"
+#include "IGraphicsPatternCache.h"
 
 #if defined IGRAPHICS_METAL
 #define SK_METAL
 #endif
 
+#if defined IGRAPHICS_RENDER_THREAD && !defined IGRAPHICS_METAL
+  #error IGRAPHICS_RENDER_THREAD needs IGRAPHICS_METAL, since GL contexts belong to the thread the view draws on
+#endif
+
 #include "SkSurface.h"
 #include "SkPath.h"
 #include "SkCanvas.h"
 #include "SkImage.h"
+#include "SkShader.h"
 
 BEGIN_IPLUG_NAMESPACE
 BEGIN_IGRAPHICS_NAMESPACE
 
 /** IGraphics draw class using Skia
+* Define IGRAPHICS_RENDER_THREAD with IGRAPHICS_METAL to rasterize and present on a dedicated thread. Each frame is then recorded into an SkPicture
+* on the main thread, which is all the drawing the main thread does, and the render thread replays the pictures into the retained surface and presents it.
+* Layers are rasterized on the CPU in that mode, since the GPU context belongs to the render thread
 *   @ingroup DrawClasses */
 class IGraphicsSkia : public IGraphicsPathBase
 {
 private:
   class Bitmap;
   struct Font;
+#ifdef IGRAPHICS_RENDER_THREAD
+  class RenderThread;
+#endif
 public:
   IGraphicsSkia(IGEditorDelegate& dlg, int w, int h, int fps, float scale);
   ~IGraphicsSkia();
@@ -66,6 +78,8 @@ public:
   void ReleaseBitmap(const IBitmap& bitmap) override { } // NO-OP
   void RetainBitmap(const IBitmap& bitmap, const char * cacheName) override { } // NO-OP
   APIBitmap* CreateAPIBitmap(int width, int height, int scale, double drawScale) override;
+  APIBitmap* CreateAPIBitmapFromPixels(const uint8_t* pRGBA, int width, int height, int scale) override;
+  APIBitmap* CreateRecordingAPIBitmap(int width, int height, int scale, double drawScale) override;
 
   void GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& data) override;
   void ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const IShadow& shadow) override;
@@ -78,6 +92,7 @@ protected:
   void DoDrawText(const IText& text, const char* str, const IRECT& bounds, const IBlend* pBlend) override;
 
   bool LoadAPIFont(const char* fontID, const PlatformFontPtr& font) override;
+  bool LoadCachedAPIFont(const char* fontID) override;
 
   APIBitmap* LoadAPIBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext) override;
 private:
@@ -86,17 +101,27 @@ private:
 
   void PathTransformSetMatrix(const IMatrix& m) override;
   void SetClipRegion(const IRECT& r) override;
+
+  /** @return The canvas the main thread draws frames to, outside of layers */
+  SkCanvas* GetMainCanvas();
+
   sk_sp<SkSurface> mSurface;
   sk_sp<SkSurface> mScreenSurface;
   SkCanvas* mCanvas = nullptr;
   sk_sp<GrContext> mGrContext;
   std::unique_ptr<GrBackendRenderTarget> mBackendRenderTarget;
   SkPath mMainPath;
+  IPatternCache<sk_sp<SkShader>> mGradientCache; // shaders made by SkiaPaint() for gradients
 
 #if defined OS_WIN && defined IGRAPHICS_CPU
   WDL_TypedBuf<uint8_t> mSurfaceMemory;
 #endif
   
+#ifdef IGRAPHICS_RENDER_THREAD
+  std::unique_ptr<RenderThread> mRenderThread; // owns the retained surface, and uses mGrContext, while it runs
+  SkPictureRecorder mFrameRecorder;
+#endif
+
 #ifdef IGRAPHICS_METAL
   void* mMTLDevice;
   void* mMTLCommandQueue;
@@ -127,8 +127,72 @@ void ImGuiRenderer::DoFrame()
   ImGui::Render();
 }
 
+bool ImGuiRenderer::Update(IRECT& bounds)
+{
+  DoFrame();
+  mUpdated = true;
+
+  IRECT drawnBounds;
+  const uint64_t checksum = GetDrawDataChecksum(drawnBounds);
+  const bool changed = checksum != mChecksum || mInputActivity;
+
+  // while ImGui is unchanged the area it left behind is still covered by what it draws
+  bounds = changed ? drawnBounds.Union(mBounds) : drawnBounds;
+  mChecksum = checksum;
+  mBounds = drawnBounds;
+  mInputActivity = false;
+
+  return changed;
+}
+
+uint64_t ImGuiRenderer::GetDrawDataChecksum(IRECT& bounds) const
+{
+  const ImDrawData* pDrawData = ImGui::GetDrawData();
+  const float scale = 1.f / mGraphics->GetDrawScale();
+  uint64_t checksum = 14695981039346656037ull; // FNV-1a, a word at a time
+
+  auto hash = [&checksum](const void* pData, size_t size) {
+    const unsigned char* pBytes = static_cast<const unsigned char*>(pData);
+    size_t i = 0;
+
+    for (; i + sizeof(uint32_t) <= size; i += sizeof(uint32_t))
+    {
+      uint32_t word;
+      memcpy(&word, pBytes + i, sizeof(uint32_t));
+      checksum = (checksum ^ word) * 1099511628211ull;
+    }
+
+    for (; i < size; i++)
+      checksum = (checksum ^ pBytes[i]) * 1099511628211ull;
+  };
+
+  bounds = IRECT();
+
+  for (int l = 0; pDrawData && l < pDrawData->CmdListsCount; l++)
+  {
+    const ImDrawList* pList = pDrawData->CmdLists[l];
+    hash(pList->VtxBuffer.Data, pList->VtxBuffer.Size * sizeof(ImDrawVert));
+    hash(pList->IdxBuffer.Data, pList->IdxBuffer.Size * sizeof(ImDrawIdx));
+
+    for (int c = 0; c < pList->CmdBuffer.Size; c++)
+    {
+      const ImVec4& clip = pList->CmdBuffer[c].ClipRect;
+      hash(&clip, sizeof(ImVec4));
+      bounds = bounds.Union(IRECT(clip.x * scale, clip.y * scale, clip.z * scale, clip.w * scale));
+    }
+  }
+
+  bounds = bounds.Intersect(mGraphics->GetBounds());
+
+  if (!bounds.Empty())
+    bounds = bounds.GetPadded(1.f);
+
+  return checksum;
+}
+
 bool ImGuiRenderer::OnMouseDown(float x, float y, const IMouseMod &mod)
 {
+  mInputActivity = true;
   ImGuiIO &io = ImGui::GetIO();  
   io.MouseDown[0] = mod.L;
   io.MouseDown[1] = mod.R;
@@ -137,6 +201,7 @@ bool ImGuiRenderer::OnMouseDown(float x, float y, const IMouseMod &mod)
 
 bool ImGuiRenderer::OnMouseUp(float x, float y, const IMouseMod &mod)
 {
+  mInputActivity = true;
   ImGuiIO &io = ImGui::GetIO();
   io.MouseDown[0] = false;
   io.MouseDown[1] = false;
@@ -145,6 +210,7 @@ bool ImGuiRenderer::OnMouseUp(float x, float y, const IMouseMod &mod)
 
 bool ImGuiRenderer::OnMouseWheel(float x, float y, const IMouseMod& mod, float delta)
 {
+  mInputActivity = true;
   ImGuiIO &io = ImGui::GetIO();
   io.MouseWheel += (delta * 0.1f);
   return io.WantCaptureMouse;
@@ -152,12 +218,14 @@ bool ImGuiRenderer::OnMouseWheel(float x, float y, const IMouseMod& mod, float d
 
 void ImGuiRenderer::OnMouseMove(float x, float y, const IMouseMod& mod)
 {
+  mInputActivity = true;
   ImGuiIO &io = ImGui::GetIO();
   io.MousePos = ImVec2(x * mGraphics->GetDrawScale(), y * mGraphics->GetDrawScale());
 }
 
 bool ImGuiRenderer::OnKeyDown(float x, float y, const IKeyPress& keyPress)
 {
+  mInputActivity = true;
   ImGuiIO &io = ImGui::GetIO();
   
   if(keyPress.VK != kVK_BACK)
@@ -174,6 +242,7 @@ bool ImGuiRenderer::OnKeyDown(float x, float y, const IKeyPress& keyPress)
 
 bool ImGuiRenderer::OnKeyUp(float x, float y, const IKeyPress& keyPress)
 {
+  mInputActivity = true;
   ImGuiIO &io = ImGui::GetIO();
   io.KeysDown[keyPress.VK] = false;
   return io.WantCaptureKeyboard;
@@ -209,11 +278,15 @@ void ImGuiRenderer::NewFrame()
 {
 #if defined IGRAPHICS_GL2
   ImGui_ImplOpenGL2_NewFrame();
-  this->DoFrame();
+  if (!mUpdated)
+    this->DoFrame();
+  mUpdated = false;
   ImGui_ImplOpenGL2_RenderDrawData(ImGui::GetDrawData());
 #elif defined IGRAPHICS_GL3 || defined IGRAPHICS_GLES2 || defined IGRAPHICS_GLES3
   ImGui_ImplOpenGL3_NewFrame();
-  this->DoFrame();
+  if (!mUpdated)
+    this->DoFrame();
+  mUpdated = false;
   ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 #else
   //Metal rendering handled in IGRAPHICS_IMGUIVIEW
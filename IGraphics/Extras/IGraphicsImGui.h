@@ -26,6 +26,12 @@ public:
   
   /** Frame processing that is the same across platforms */
   void DoFrame();
+
+  /** Called by IGraphics::IsDirty() on each display refresh with the OpenGL backends, to run the ImGui frame ahead of drawing,
+   * so that the editor only repaints when ImGui changes, and only where ImGui draws
+   * @param bounds Set to the area ImGui covers, and covered the last time it changed, which needs redrawing under it whenever a frame is drawn
+   * @return \c true if ImGui's geometry changed or it had input since the last call */
+  bool Update(IRECT& bounds);
   
   bool OnMouseDown(float x, float y, const IMouseMod &mod);
   bool OnMouseUp(float x, float y, const IMouseMod &mod);
@@ -40,8 +46,15 @@ public:
   }
   
 private:
+  /** @return A checksum of the draw data, and its bounds in IGraphics coordinates */
+  uint64_t GetDrawDataChecksum(IRECT& bounds) const;
+
   IGraphics* mGraphics;
   std::function<void(IGraphics*)> mDrawFunc = nullptr;
+  uint64_t mChecksum = 0;
+  IRECT mBounds;
+  bool mInputActivity = true;
+  bool mUpdated = false;
   friend IGraphics;
 };
 
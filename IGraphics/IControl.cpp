@@ -8,6 +8,7 @@
  ==============================================================================
 */
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 #include "dirscan.h"
@@ -97,6 +98,15 @@ IControl::IControl(const IRECT& bounds, IActionFunction actionFunc)
 {
 }
 
+IControl::~IControl()
+{
+  if (mGraphics)
+    mGraphics->RemoveDirtyControl(this);
+
+  if (mParent)
+    mParent->RemoveChild(this);
+}
+
 int IControl::GetParamIdx(int valIdx) const
 {
   assert(valIdx > kNoValIdx && valIdx < NVals());
@@ -107,6 +117,7 @@ void IControl::SetParamIdx(int paramIdx, int valIdx)
 {
   assert(valIdx > kNoValIdx && valIdx < NVals());
   mVals.at(valIdx).idx = paramIdx;
+  InvalidateControlIndex();
 }
 
 const IParam* IControl::GetParam(int valIdx)
@@ -193,23 +204,84 @@ void IControl::SetDirty(bool triggerAction, int valIdx)
   ForValIdx(valIdx, setValue);
   
   mDirty = true;
+  mDirtyRects.Clear();
+  QueueDirty();
   
   if (triggerAction)
+    TriggerAction(valIdx);
+}
+
+void IControl::TriggerAction(int valIdx)
+{
+  valIdx = (NVals() == 1) ? 0 : valIdx;
+
+  auto paramUpdate = [this](int v)
   {
-    auto paramUpdate = [this](int v)
+    if (GetParamIdx(v) > kNoParameter)
     {
-      if (GetParamIdx(v) > kNoParameter)
-      {
-        GetDelegate()->SendParameterValueFromUI(GetParamIdx(v), GetValue(v)); //TODO: take tuple
-        GetUI()->UpdatePeers(this, v);
-      }
-    };
-      
-    ForValIdx(valIdx, paramUpdate);
+      GetDelegate()->SendParameterValueFromUI(GetParamIdx(v), GetValue(v)); //TODO: take tuple
+      GetUI()->UpdatePeers(this, v);
+    }
+  };
     
-    if (mActionFunc)
-      mActionFunc(this);
+  ForValIdx(valIdx, paramUpdate);
+  
+  if (mActionFunc)
+    mActionFunc(this);
+}
+
+void IControl::SetDirtyRect(const IRECT& r)
+{
+  // a control that is already dirty with no rects is redrawn in full
+  if (mDirty && !mDirtyRects.Size())
+    return;
+
+  const IRECT clipped = r.Intersect(mRECT);
+
+  if (clipped.Empty())
+    return;
+
+  mDirtyRects.Add(clipped);
+  mDirty = true;
+  QueueDirty();
+}
+
+void IControl::TakeDirtyRects(IRECTList& rects)
+{
+  // N.B padding outlines for single line outlines
+  if (mDirtyRects.Size())
+  {
+    for (auto i = 0; i < mDirtyRects.Size(); i++)
+      rects.Add(mDirtyRects.Get(i).GetPadded(0.75));
+
+    mDirtyRects.Clear();
   }
+  else
+    rects.Add(mRECT.GetPadded(0.75));
+}
+
+void IControl::QueueDirty()
+{
+  if (mGraphics && !mInDirtyList)
+    mGraphics->AddDirtyControl(this);
+}
+
+void IControl::StartAnimation(int duration)
+{
+  // the frame clock may be a frame old, so progress is clamped at 0. until it passes the start
+  mAnimationStartTime = std::chrono::high_resolution_clock::now();
+  mAnimationDuration = Milliseconds(duration);
+  QueueDirty();
+}
+
+double IControl::GetAnimationProgress() const
+{
+  if(!mAnimationFunc)
+    return 0.;
+
+  const TimePoint now = mGraphics ? mGraphics->GetFrameTime() : std::chrono::high_resolution_clock::now();
+  const Milliseconds elapsed = now - mAnimationStartTime;
+  return std::max(elapsed.count() / mAnimationDuration.count(), 0.);
 }
 
 bool IControl::IsDirty()
@@ -222,10 +294,79 @@ bool IControl::IsDirty()
   return mDirty;
 }
 
+void IControl::DrawCached(IGraphics& g, const IRECT& bounds)
+{
+  bool useCache = mCacheMode == ECacheMode::Always;
+
+  if (mCacheMode == ECacheMode::Auto)
+  {
+    if (++mCacheNDraws > kAutoCacheWindow)
+    {
+      mCacheNDraws /= 2;
+      mCacheNChanges /= 2;
+    }
+
+    useCache = mCacheNDraws >= kAutoCacheMinDraws && mCacheNChanges * 4 <= mCacheNDraws && mCacheDrawTime >= kAutoCacheMinDrawTime;
+
+    if (!useCache)
+      mCacheLayer = nullptr;
+  }
+
+  auto timedDraw = [&]() {
+    const double start = GetTimestamp();
+    Draw(g);
+    const double ms = (GetTimestamp() - start) * 1000.;
+    mCacheDrawTime += (mCacheDrawTime > 0. ? 0.1 : 1.) * (ms - mCacheDrawTime);
+  };
+
+  if (!useCache)
+  {
+    if (mCacheMode == ECacheMode::Auto)
+      timedDraw();
+    else
+      Draw(g);
+
+    return;
+  }
+
+  if (!g.CheckLayer(mCacheLayer) || mCacheBounds != bounds)
+  {
+    g.StartRecordedLayer(bounds);
+    timedDraw();
+    mCacheLayer = g.EndLayer();
+    mCacheBounds = bounds;
+  }
+
+  g.DrawLayer(mCacheLayer);
+}
+
 void IControl::Hide(bool hide)
 {
   mHide = hide;
   SetDirty(false);
+  InvalidateHitTestGrid();
+}
+
+bool IControl::IsHiddenByContainer() const
+{
+  for (const IContainerBase* pParent = mParent; pParent; pParent = pParent->GetParent())
+  {
+    if (pParent->IsHidden())
+      return true;
+  }
+
+  return false;
+}
+
+bool IControl::IsDrawnByContainer() const
+{
+  for (const IContainerBase* pParent = mParent; pParent; pParent = pParent->GetParent())
+  {
+    if (pParent->GetCacheChildren())
+      return true;
+  }
+
+  return false;
 }
 
 void IControl::GrayOut(bool gray)
@@ -541,6 +682,84 @@ void ICaptionControl::OnResize()
   }
 }
 
+IContainerBase::~IContainerBase()
+{
+  // the children may outlive the container, depending on the order the controls are deleted in
+  for (IControl* pChild : mChildren)
+    pChild->mParent = nullptr;
+}
+
+void IContainerBase::Hide(bool hide)
+{
+  IControl::Hide(hide);
+
+  // the children of a hidden container are left out of the hit-test and draw grid
+  InvalidateHitTestGrid();
+}
+
+IControl* IContainerBase::AddChildControl(IControl* pChild, int controlTag, const char* group)
+{
+  assert(GetUI() && "The container must be attached before its children");
+
+  GetUI()->AttachControl(pChild, controlTag, group);
+  pChild->mParent = this;
+  mChildren.push_back(pChild);
+  return pChild;
+}
+
+void IContainerBase::RemoveChild(IControl* pChild)
+{
+  mChildren.erase(std::remove(mChildren.begin(), mChildren.end(), pChild), mChildren.end());
+  InvalidateChildrenLayer();
+}
+
+void IContainerBase::ForAllChildrenFunc(std::function<void(IControl& child)> func)
+{
+  for (IControl* pChild : mChildren)
+    func(*pChild);
+}
+
+void IContainerBase::SetCacheChildren(bool cache)
+{
+  mCacheChildren = cache;
+  mChildrenLayer = nullptr;
+  SetDirty(false);
+}
+
+void IContainerBase::DrawChildren(IGraphics& g)
+{
+  for (IControl* pChild : mChildren)
+  {
+    if (pChild->IsHidden())
+      continue;
+
+    pChild->Draw(g);
+
+    if (IContainerBase* pContainer = dynamic_cast<IContainerBase*>(pChild))
+      pContainer->DrawChildren(g);
+  }
+}
+
+void IContainerBase::DrawCached(IGraphics& g, const IRECT& bounds)
+{
+  if (!mCacheChildren)
+  {
+    IControl::DrawCached(g, bounds);
+    return;
+  }
+
+  if (!g.CheckLayer(mChildrenLayer) || mChildrenBounds != bounds)
+  {
+    g.StartRecordedLayer(bounds);
+    Draw(g);
+    DrawChildren(g);
+    mChildrenLayer = g.EndLayer();
+    mChildrenBounds = bounds;
+  }
+
+  g.DrawLayer(mChildrenLayer);
+}
+
 IButtonControlBase::IButtonControlBase(const IRECT& bounds, IActionFunction actionFunc)
 : IControl(bounds, kNoParameter, actionFunc)
 {
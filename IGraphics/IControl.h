@@ -32,10 +32,13 @@
 #include "ptrlist.h"
 
 #include "IGraphics.h"
+#include "IGraphicsControlPool.h"
 
 BEGIN_IPLUG_NAMESPACE
 BEGIN_IGRAPHICS_NAMESPACE
 
+class IContainerBase;
+
 /** The lowest level base class of an IGraphics control. A control is anything on the GUI 
 *  @ingroup BaseControls */
 class IControl
@@ -75,7 +78,13 @@ public:
   void operator=(const IControl&) = delete;
   
   /** Destructor. Clean up any resources that your control owns. */
-  virtual ~IControl() {}
+  virtual ~IControl();
+
+#ifndef IGRAPHICS_NO_CONTROL_POOL
+  /** Controls are allocated from IControlPool, so that the controls of a UI are close together in memory */
+  static void* operator new(size_t size) { return IControlPool::Get().Allocate(size); }
+  static void operator delete(void* ptr, size_t size) { IControlPool::Get().Deallocate(ptr, size); }
+#endif
 
   /** Implement this method to respond to a mouse down event on this control. 
    * @param x The X coordinate of the mouse event
@@ -146,9 +155,22 @@ public:
   /** Implement to receive messages sent to the control, see IEditorDelegate:SendControlMsgFromDelegate() */
   virtual void OnMsgFromDelegate(int messageTag, int dataSize, const void* pData) {};
   
-  /** Implement to receive MIDI messages sent to the control if mWantsMidi == true, see IEditorDelegate:SendMidiMsgFromDelegate() */
+  /** Implement to receive MIDI messages sent to the control if mWantsMidi == true and the message passes the filter set with SetMidiFilter(), see IEditorDelegate:SendMidiMsgFromDelegate() */
   virtual void OnMidi(const IMidiMsg& msg) {};
 
+  /** Receives the MIDI messages sent to the control in one timer tick, if mWantsMidi == true and any of them passes the filter set with SetMidiFilter().
+   * Override this to handle them in one go, checking each with WantsMidiMsg(). The default calls OnMidi() for each message that passes the filter
+   * @param pMsgs The messages, in time order
+   * @param nMsgs The number of messages */
+  virtual void OnMidiMsgs(const IMidiMsg* pMsgs, int nMsgs)
+  {
+    for (int i = 0; i < nMsgs; i++)
+    {
+      if (WantsMidiMsg(pMsgs[i]))
+        OnMidi(pMsgs[i]);
+    }
+  }
+
   /** Called by default when the user right clicks a control. If IGRAPHICS_NO_CONTEXT_MENU is enabled as a preprocessor macro right clicking control will mean IControl::CreateContextMenu() and IControl::OnContextSelection() do not function on right clicking control. VST3 provides contextual menu support which is hard wired to right click controls by default. You can add custom items to the menu by implementing IControl::CreateContextMenu() and handle them in IControl::OnContextSelection(). In non-VST 3 hosts right clicking will still create the menu, but it will not feature entries added by the host. */
   virtual void CreateContextMenu(IPopupMenu& contextMenu) {}
   
@@ -281,7 +303,7 @@ public:
 
   /** Set the rectangular draw area for this control, within the graphics context
    * @param bounds The control's bounds */
-  void SetRECT(const IRECT& bounds) { mRECT = bounds; mMouseIsOver = false; OnResize(); }
+  void SetRECT(const IRECT& bounds) { mRECT = bounds; mMouseIsOver = false; OnResize(); InvalidateHitTestGrid(); }
   
   /** Get the rectangular mouse tracking target area, within the graphics context for this control
    * @return The control's target bounds within the graphics context */
@@ -289,11 +311,11 @@ public:
 
   /** Set the rectangular mouse tracking target area, within the graphics context for this control
    * @param bounds The control's new target bounds within the graphics context */
-  void SetTargetRECT(const IRECT& bounds) { mTargetRECT = bounds; mMouseIsOver = false; }
+  void SetTargetRECT(const IRECT& bounds) { mTargetRECT = bounds; mMouseIsOver = false; InvalidateHitTestGrid(); }
   
   /** Set BOTH the draw rect and the target area, within the graphics context for this control
    * @param bounds The control's new draw and target bounds within the graphics context */
-  void SetTargetAndDrawRECTs(const IRECT& bounds) { mRECT = mTargetRECT = bounds; mMouseIsOver = false; OnResize(); }
+  void SetTargetAndDrawRECTs(const IRECT& bounds) { mRECT = mTargetRECT = bounds; mMouseIsOver = false; OnResize(); InvalidateHitTestGrid(); }
 
   /** Used internally by the AAX wrapper view interface to set the control parmeter highlight 
    * @param isHighlighted /c true if the control should be highlighted 
@@ -313,6 +335,15 @@ public:
   /** @return \c true if the control is hidden. */
   bool IsHidden() const { return mHide; }
 
+  /** @return \c true if the control is inside a container that is hidden, see IContainerBase */
+  bool IsHiddenByContainer() const;
+
+  /** @return \c true if the control is inside a container that draws its children into its layer, see IContainerBase::SetCacheChildren() */
+  bool IsDrawnByContainer() const;
+
+  /** @return The container the control was added to with IContainerBase::AddChildControl(), or nullptr */
+  IContainerBase* GetParent() const { return mParent; }
+
   /** Sets gray out mode for the control
    * @param gray \c true for grayed out*/
   virtual void GrayOut(bool gray);
@@ -349,6 +380,70 @@ public:
    * NOTE: it is easy to forget that this method always sets the control dirty, the argument is about whether a consecutive action should be performed */
   virtual void SetDirty(bool triggerAction = true, int valIdx = kNoValIdx);
 
+  /** Mark only part of the control as dirty, e.g. one key of a keyboard. Until the next display refresh, IGraphics redraws the areas given here
+   * instead of the whole control, unless SetDirty() is called as well. Draw() is still called, clipped to those areas, so it must draw everything
+   * that overlaps them. Calling this does not trigger the action function or send parameter values
+   * @param r The area that has changed, which is clipped to the control's bounds */
+  void SetDirtyRect(const IRECT& r);
+
+  /** Used internally by IGraphics::IsDirty() to add the areas to redraw to the frame's, either the rects given to SetDirtyRect() or the control's bounds.
+   * The rects are cleared afterwards
+   * @param rects The list to add to */
+  void TakeDirtyRects(IRECTList& rects);
+
+  /** Called by IGraphics::DrawControl() with how long Draw() took, while IGraphics::ShowControlDrawTimes() is enabled
+   * @param ms The time in milliseconds */
+  void AddDrawTime(double ms)
+  {
+    mMeanDrawTime += (mMeanDrawTime > 0. ? 0.1 : 1.) * (ms - mMeanDrawTime);
+    mPeakDrawTime = std::max(mPeakDrawTime, ms);
+  }
+
+  /** Clears the draw time statistics, see AddDrawTime() */
+  void ResetDrawTime() { mMeanDrawTime = mPeakDrawTime = 0.; }
+
+  /** @return A moving average of how long Draw() takes in milliseconds, over roughly the last ten draws. Only measured while IGraphics::ShowControlDrawTimes() is enabled */
+  double GetMeanDrawTime() const { return mMeanDrawTime; }
+
+  /** @return The longest Draw() took in milliseconds since the statistics were last reset */
+  double GetPeakDrawTime() const { return mPeakDrawTime; }
+
+  /** Choose whether IGraphics draws the control into a layer and redraws it from the layer until the control is dirty, so that redrawing a
+   * control because a neighbour changed costs one bitmap draw instead of a Draw(). With ECacheMode::Auto the control is cached while it changes
+   * on fewer than a quarter of its draws and its Draw() is measured to cost more than a bitmap draw. Only cache a control that draws with the
+   * default blend within its bounds, and calls SetDirty() whenever its appearance changes
+   * @param mode ECacheMode::None (the default) to always call Draw() */
+  void SetCacheMode(ECacheMode mode)
+  {
+    mCacheMode = mode;
+    mCacheLayer = nullptr;
+    mCacheNDraws = mCacheNChanges = 0;
+  }
+
+  /** @return The caching mode, see SetCacheMode() */
+  ECacheMode GetCacheMode() const { return mCacheMode; }
+
+  /** Discard the cached drawing, so that Draw() is called the next time the control is drawn. IGraphics calls this whenever the control is dirty */
+  void InvalidateCache()
+  {
+    mCacheNChanges++;
+
+    if (mCacheLayer)
+      mCacheLayer->Invalidate();
+  }
+
+  /** @return The memory used by the cached drawing, see SetCacheMode() */
+  size_t GetCacheMemoryUsage() const
+  {
+    const APIBitmap* pBitmap = mCacheLayer ? mCacheLayer->GetAPIBitmap() : nullptr;
+    return pBitmap ? pBitmap->GetMemoryUsage() : 0;
+  }
+
+  /** Used internally by IGraphics::DrawControl() to draw the control according to its caching mode, see SetCacheMode()
+   * @param g The graphics context
+   * @param bounds The area to cache, the control's bounds padded for outlines */
+  virtual void DrawCached(IGraphics& g, const IRECT& bounds);
+
   /* Set the control clean, i.e. Called by IGraphics draw loop after control has been drawn */
   virtual void SetClean() { mDirty = false; }
   
@@ -358,6 +453,23 @@ public:
    * @return \c true if the control is marked dirty. */
   virtual bool IsDirty();
 
+  /** IGraphics only calls IsDirty() on controls that have called SetDirty() or are animating. Call this with \c true if your control overrides
+   * IsDirty() to poll something at the display refresh rate (e.g. a meter reading a queue), or sets mDirty itself, so that it is asked on every frame
+   * @param poll \c true to call IsDirty() on every frame */
+  void SetPollDirty(bool poll) { mPollDirty = poll; if (poll) QueueDirty(); }
+
+  /** @return \c true if IsDirty() is called on every frame, see SetPollDirty() */
+  bool GetPollDirty() const { return mPollDirty; }
+
+  /** Used internally by IGraphics to track whether the control is queued to be asked IsDirty() */
+  bool GetInDirtyList() const { return mInDirtyList; }
+
+  /** Used internally by IGraphics, see GetInDirtyList() */
+  void SetInDirtyList(bool inList) { mInDirtyList = inList; }
+
+  /** Queue the control to be asked IsDirty() on the next frame. Used internally by SetDirty() and the animation methods */
+  void QueueDirty();
+
   /** Disable/enable right-clicking the control to prompt for user input /todo check this
    * @param disable \c true*/
   void DisablePrompt(bool disable) { mDisablePrompt = disable; }
@@ -367,17 +479,30 @@ public:
   
   /** Set the control's tag. Controls can be given tags, in order to direct messages to them. @see Control Tags
    * @param tag A unique integer to identify this control */
-  void SetTag(int tag) { mTag = tag; }
+  void SetTag(int tag) { mTag = tag; InvalidateControlIndex(); }
   
   /** Get the control's tag. @see Control Tags */
   int GetTag() const { return mTag; }
   
   /** Specify whether this control wants to know about MIDI messages sent to the UI. See OnMIDIMsg() */
-  void SetWantsMidi(bool enable) { mWantsMidi = true; }
+  void SetWantsMidi(bool enable) { mWantsMidi = enable; InvalidateControlIndex(); }
 
   /** @return /c true if this control wants to know about MIDI messages send to the UI. See OnMIDIMsg() */
   bool GetWantsMidi() const { return mWantsMidi; }
 
+  /** Only receive some kinds of MIDI message, on some channels, so that e.g. a keyboard isn't sent controller messages. Calls SetWantsMidi(true)
+   * @param statusMask Bits (1 << IMidiMsg::EStatusMsg) of the kinds of message wanted, e.g. (1 << IMidiMsg::kNoteOn) | (1 << IMidiMsg::kNoteOff). System messages are IMidiMsg::kNone
+   * @param channelMask Bits (1 << channel) of the channels wanted, 0 to 15. System messages have no channel and only depend on statusMask */
+  void SetMidiFilter(uint16_t statusMask, uint16_t channelMask = 0xFFFF) { mMidiStatusMask = statusMask; mMidiChannelMask = channelMask; SetWantsMidi(true); }
+
+  /** @param msg A MIDI message
+   * @return \c true if the control wants the message, see SetWantsMidi() and SetMidiFilter() */
+  bool WantsMidiMsg(const IMidiMsg& msg) const
+  {
+    const IMidiMsg::EStatusMsg status = msg.StatusMsg();
+    return mWantsMidi && (mMidiStatusMask >> status & 1) && (status == IMidiMsg::kNone || (mMidiChannelMask >> msg.Channel() & 1));
+  }
+
   /** Gets a pointer to the class implementing the IEditorDelegate interface that handles parameter changes from this IGraphics instance.
    * If you need to call other methods on that class, you can use static_cast<PLUG_CLASS_NAME>(GetDelegate();
    * @return The class implementing the IEditorDelegate interface that handles communication to/from from this IGraphics instance.*/
@@ -388,6 +513,10 @@ public:
   {
     mDelegate = &dlg;
     mGraphics = dlg.GetUI();
+
+    if (mDirty || mPollDirty)
+      QueueDirty();
+
     OnInit();
     OnResize();
     OnRescale();
@@ -418,16 +547,13 @@ public:
     SetDirty(false);
   }
   
-  /** @param duration Duration in milliseconds for the animation  */
-  void StartAnimation(int duration)
-  {
-    mAnimationStartTime = std::chrono::high_resolution_clock::now();
-    mAnimationDuration = Milliseconds(duration);
-  }
+  /** Animating controls are kept on the IGraphics dirty list, and asked for IsDirty() on each frame until OnEndAnimation(), so only the running animations cost anything
+   * @param duration Duration in milliseconds for the animation  */
+  void StartAnimation(int duration);
   
   /** Set the animation function
    * @param func A std::function conforming to IAnimationFunction */
-  void SetAnimation(IAnimationFunction func) { mAnimationFunc = func;}
+  void SetAnimation(IAnimationFunction func) { mAnimationFunc = func; QueueDirty(); }
   
   /** Set the animation function and starts it
    * @param func A std::function conforming to IAnimationFunction
@@ -438,14 +564,8 @@ public:
   
   IAnimationFunction GetActionFunction() { return mActionFunc; }
 
-  double GetAnimationProgress()
-  {
-    if(!mAnimationFunc)
-      return 0.;
-    
-    auto elapsed = Milliseconds(std::chrono::high_resolution_clock::now() - mAnimationStartTime);
-    return elapsed.count() / mAnimationDuration.count();
-  }
+  /** @return The progress of the animation at the time of the current frame, see IGraphics::GetFrameTime(), from 0. at the start to 1. or more once it's due to end */
+  double GetAnimationProgress() const;
   
 #if defined VST3_API || defined VST3C_API
   Steinberg::tresult PLUGIN_API executeMenuItem (Steinberg::int32 tag) override { OnContextSelection(tag); return Steinberg::kResultOk; }
@@ -482,6 +602,7 @@ protected:
 
   int mTextEntryLength = DEFAULT_TEXT_ENTRY_LEN;
   bool mDirty = true;
+  bool mPollDirty = false;
   bool mHide = false;
   bool mGrayed = false;
   bool mDisablePrompt = true;
@@ -490,9 +611,13 @@ protected:
   bool mMEWhenGrayed = false;
   bool mIgnoreMouse = false;
   bool mWantsMidi = false;
+  uint16_t mMidiStatusMask = 0xFFFF; // see SetMidiFilter()
+  uint16_t mMidiChannelMask = 0xFFFF;
   /** if mGraphics::mHandleMouseOver = true, this will be true when the mouse is over control. If you need finer grained control of mouseovers, you can override OnMouseOver() and OnMouseOut() */
   bool mMouseIsOver = false;
   WDL_String mTooltip;
+  double mMeanDrawTime = 0.;
+  double mPeakDrawTime = 0.;
 
   IColor mPTHighlightColor = COLOR_RED;
   bool mPTisHighlighted = false;
@@ -501,6 +626,7 @@ protected:
   {
     assert(nVals > 0);
     mVals.resize(nVals);
+    InvalidateControlIndex();
   }
 
 #if defined VST3_API || defined VST3C_API
@@ -510,10 +636,40 @@ protected:
   END_DEFINE_INTERFACES (FObject)
   REFCOUNT_METHODS(FObject)
 #endif
+
+protected:
+  /** Call this if you assign mRECT or mTargetRECT directly after the control has been attached, so that the graphics context's hit-test
+   * and draw grid sees the new bounds. The methods that set the bounds call it for you */
+  void InvalidateHitTestGrid() { if (mGraphics) mGraphics->InvalidateHitTestGrid(); }
+
+  /** Tell the graphics context that the control's parameters, tag or MIDI flag changed, see IGraphics::InvalidateControlIndex() */
+  void InvalidateControlIndex() { if (mGraphics) mGraphics->InvalidateControlIndex(); }
+
+  /** Send the value(s) to the delegate and the control's peers, and call the action function, as SetDirty(true) does, without marking the whole control dirty.
+   * For controls that mark only part of themselves dirty with SetDirtyRect()
+   * @param valIdx The index of the value to send, or kNoValIdx for all of them */
+  void TriggerAction(int valIdx = kNoValIdx);
   
 private:
+
+  // see SetCacheMode(), the draw and change counts are halved once there are more than kAutoCacheWindow draws
+  static constexpr int kAutoCacheMinDraws = 8;
+  static constexpr int kAutoCacheWindow = 64;
+  static constexpr double kAutoCacheMinDrawTime = 0.05;
+
+  friend class IContainerBase;
+
   IEditorDelegate* mDelegate = nullptr;
   IGraphics* mGraphics = nullptr;
+  IContainerBase* mParent = nullptr;
+  bool mInDirtyList = false;
+  ECacheMode mCacheMode = ECacheMode::None;
+  IRECTList mDirtyRects;
+  ILayerPtr mCacheLayer;
+  IRECT mCacheBounds;
+  int mCacheNDraws = 0;
+  int mCacheNChanges = 0;
+  double mCacheDrawTime = 0.;
   IActionFunction mActionFunc = nullptr;
   IAnimationFunction mAnimationFunc = nullptr;
   TimePoint mAnimationStartTime;
@@ -528,6 +684,71 @@ private:
  * @{
  */
 
+/** A control that groups child controls, e.g. a page of a tabbed editor. The children are attached to IGraphics like any other control,
+ * with AddChildControl(), but hiding the container hides all of them at once without touching each one: while it is hidden they are left
+ * out of hit-testing and drawing, and their changes cost nothing to draw. Children are only hit and drawn within the container's bounds.
+ * With SetCacheChildren() the container and its children are drawn into one layer, which is only redrawn when one of them changes.
+ * A container ignores the mouse, so that clicks between its children reach the controls below it */
+class IContainerBase : public IControl
+{
+public:
+  IContainerBase(const IRECT& bounds, int paramIdx = kNoParameter, IActionFunction actionFunc = nullptr)
+  : IControl(bounds, paramIdx, actionFunc)
+  {
+    mIgnoreMouse = true;
+  }
+
+  virtual ~IContainerBase();
+
+  /** Override to draw a background behind the children, which IGraphics draws themselves */
+  void Draw(IGraphics& g) override {}
+
+  /** Hides or shows the container and so all of its children, whose own hidden states are kept */
+  void Hide(bool hide) override;
+
+  void DrawCached(IGraphics& g, const IRECT& bounds) override;
+
+  /** Attach a control to the graphics context as a child of this container, which must be attached already
+   * @param pChild The control, which is owned by the graphics context as AttachControl() does
+   * @param controlTag An integer tag that you can use to identify the control
+   * @param group A CString that you can use to address controlled by group
+   * @return The child */
+  IControl* AddChildControl(IControl* pChild, int controlTag = kNoTag, const char* group = "");
+
+  /** @return The number of children */
+  int NChildren() const { return static_cast<int>(mChildren.size()); }
+
+  /** @param idx The index of the child, in the order they were added
+   * @return The child */
+  IControl* GetChild(int idx) const { return mChildren[idx]; }
+
+  /** Call a function on every child
+   * @param func The function to call on each child */
+  void ForAllChildrenFunc(std::function<void(IControl& child)> func);
+
+  /** Draw the container and its children into one layer, which is redrawn when any of them is dirty, so that redrawing the area of a
+   * container whose children rarely change costs one bitmap draw. Only cache children that draw within the container's bounds
+   * @param cache \c true to draw the children into the container's layer */
+  void SetCacheChildren(bool cache);
+
+  /** @return \c true if the children are drawn into the container's layer, see SetCacheChildren() */
+  bool GetCacheChildren() const { return mCacheChildren; }
+
+  /** Discard the layer the children are drawn into, IGraphics calls this when a child is dirty */
+  void InvalidateChildrenLayer() { if (mChildrenLayer) mChildrenLayer->Invalidate(); }
+
+private:
+  friend class IControl;
+
+  void RemoveChild(IControl* pChild);
+  void DrawChildren(IGraphics& g);
+
+  std::vector<IControl*> mChildren;
+  bool mCacheChildren = false;
+  ILayerPtr mChildrenLayer;
+  IRECT mChildrenBounds;
+};
+
 /** A base interface, to be combined with IControl for bitmap-based controls "IBControls", managing an IBitmap and IBlend */
 class IBitmapBase
 {
@@ -607,6 +828,7 @@ public:
   void AddColor(const IColor& color)
   {
     mColors.Add(color);
+    InvalidateStaticLayer();
   }
   
   void AddColors(const IColor* pBGColor = 0,
@@ -635,6 +857,7 @@ public:
     if(colorIdx < mColors.GetSize())
       mColors.Get()[colorIdx] = color;
     
+    InvalidateStaticLayer();
     mControl->SetDirty(false);
   }
   
@@ -657,6 +880,7 @@ public:
     mColors.Get()[kX1] = X1Color;
     mColors.Get()[kX2] = X2Color;
     mColors.Get()[kX3] = X3Color;
+    InvalidateStaticLayer();
   }
 
   void SetColors(const IVColorSpec& spec)
@@ -680,17 +904,19 @@ public:
       return mColors.Get()[0];
   }
   
-  void SetLabelStr(const char* label) { mLabelStr.Set(label); mControl->SetDirty(false); }
+  void SetLabelStr(const char* label) { mLabelStr.Set(label); InvalidateStaticLayer(); mControl->SetDirty(false); }
   void SetValueStr(const char* value) { mValueStr.Set(value); mControl->SetDirty(false); }
-  void SetWidgetFrac(float frac) { mStyle.widgetFrac = Clip(frac, 0.f, 1.f);  mControl->OnResize(); mControl->SetDirty(false); }
-  void SetAngle(float angle) { mStyle.angle = Clip(angle, 0.f, 360.f);  mControl->SetDirty(false); }
-  void SetShowLabel(bool show) { mStyle.showLabel = show;  mControl->OnResize(); mControl->SetDirty(false); }
-  void SetShowValue(bool show) { mStyle.showValue = show;  mControl->OnResize(); mControl->SetDirty(false); }
-  void SetRoundness(float roundness) { mStyle.roundness = Clip(roundness, 0.f, 1.f); mControl->SetDirty(false); }
-  void SetDrawFrame(bool draw) { mStyle.drawFrame = draw; mControl->SetDirty(false); }
-  void SetDrawShadows(bool draw) { mStyle.drawShadows = draw; mControl->SetDirty(false); }
-  void SetShadowOffset(float offset) { mStyle.shadowOffset = offset; mControl->SetDirty(false); }
-  void SetFrameThickness(float thickness) { mStyle.frameThickness = thickness; mControl->SetDirty(false); }
+  void SetWidgetFrac(float frac) { mStyle.widgetFrac = Clip(frac, 0.f, 1.f);  mControl->OnResize(); InvalidateStaticLayer(); mControl->SetDirty(false); }
+  void SetAngle(float angle) { mStyle.angle = Clip(angle, 0.f, 360.f);  InvalidateStaticLayer(); mControl->SetDirty(false); }
+  void SetShowLabel(bool show) { mStyle.showLabel = show;  mControl->OnResize(); InvalidateStaticLayer(); mControl->SetDirty(false); }
+  void SetShowValue(bool show) { mStyle.showValue = show;  mControl->OnResize(); InvalidateStaticLayer(); mControl->SetDirty(false); }
+  void SetRoundness(float roundness) { mStyle.roundness = Clip(roundness, 0.f, 1.f); InvalidateStaticLayer(); mControl->SetDirty(false); }
+  void SetDrawFrame(bool draw) { mStyle.drawFrame = draw; InvalidateStaticLayer(); mControl->SetDirty(false); }
+  void SetDrawShadows(bool draw) { mStyle.drawShadows = draw; InvalidateStaticLayer(); mControl->SetDirty(false); }
+  void SetShadowOffset(float offset) { mStyle.shadowOffset = offset; InvalidateStaticLayer(); mControl->SetDirty(false); }
+  /** Soften the shadows with a blur of this radius in pixels, or draw them hard edged with 0. Blurred shadows are drawn from sprites cached by IGraphics, see IGraphics::FillRoundRectShadow() */
+  void SetShadowBlur(float blur) { mShadowBlur = std::max(blur, 0.f); InvalidateStaticLayer(); mControl->SetDirty(false); }
+  void SetFrameThickness(float thickness) { mStyle.frameThickness = thickness; InvalidateStaticLayer(); mControl->SetDirty(false); }
   void SetSplashRadius(float radius) { mSplashRadius = radius * mMaxSplashRadius; }
   void SetSplashPoint(float x, float y) { mSplashX = x; mSplashY = y; }
   
@@ -699,6 +925,56 @@ public:
     mStyle = style;
     mColors.Resize(kNumDefaultVColors); // TODO?
     SetColors(style.colorSpec);
+    InvalidateStaticLayer();
+  }
+
+  /** Draw the background and, unless it is drawn in the widget, the label from a layer that is only redrawn when the style, the colors, the
+   * label or the bounds change, so that a change of value only redraws the widget and the value. Off by default, as each control then keeps
+   * a layer the size of its bounds
+   * @param cache \c true to cache the background and label */
+  void SetCacheStaticLayer(bool cache)
+  {
+    mCacheStaticLayer = cache;
+    mStaticLayer = nullptr;
+  }
+
+  /** Discard the cached background and label, see SetCacheStaticLayer(). Call this if an override of DrawBackGround() or DrawLabel() changes
+   * what it draws without one of the IVectorBase setters being called */
+  void InvalidateStaticLayer()
+  {
+    if (mStaticLayer)
+      mStaticLayer->Invalidate();
+  }
+
+  /** Draw the background and, unless mLabelInWidget is set, the label, from the cached layer if SetCacheStaticLayer() is enabled.
+   * Call this in place of DrawBackGround() and DrawLabel() from a control's Draw(), before drawing the widget
+   * @param g The IGraphics context used for drawing */
+  void DrawStaticLayer(IGraphics& g)
+  {
+    const IRECT& bounds = mControl->GetRECT();
+
+    auto drawStatic = [&]() {
+      DrawBackGround(g, bounds);
+
+      if (!mLabelInWidget)
+        DrawLabel(g);
+    };
+
+    if (!mCacheStaticLayer)
+    {
+      drawStatic();
+      return;
+    }
+
+    if (!g.CheckLayer(mStaticLayer) || mStaticLayerBounds != bounds)
+    {
+      g.StartRecordedLayer(bounds);
+      drawStatic();
+      mStaticLayer = g.EndLayer();
+      mStaticLayerBounds = bounds;
+    }
+
+    g.DrawLayer(mStaticLayer);
   }
   
   IRECT GetAdjustedHandleBounds(IRECT handleBounds) const
@@ -778,7 +1054,12 @@ public:
     const float cx = bounds.MW(), cy = bounds.MH();
     
     if(!pressed && mStyle.drawShadows)
-      g.FillCircle(GetColor(kSH), cx + mStyle.shadowOffset, cy + mStyle.shadowOffset, radius);
+    {
+      if (mShadowBlur > 0.f)
+        g.FillEllipseShadow(GetColor(kSH), IRECT(cx - radius, cy - radius, cx + radius, cy + radius).GetTranslated(mStyle.shadowOffset, mStyle.shadowOffset), mShadowBlur);
+      else
+        g.FillCircle(GetColor(kSH), cx + mStyle.shadowOffset, cy + mStyle.shadowOffset, radius);
+    }
     
 //    if(pressed)
 //      g.DrawCircle(GetColor(kON), cx, cy, radius * 0.9f, 0, mStyle.frameThickness);
@@ -795,7 +1076,12 @@ public:
   void DrawPressableEllipse(IGraphics&g, const IRECT& bounds, bool pressed, bool mouseOver)
   {
     if(!pressed && mStyle.drawShadows)
-      g.FillEllipse(GetColor(kSH), bounds.GetTranslated(mStyle.shadowOffset, mStyle.shadowOffset));
+    {
+      if (mShadowBlur > 0.f)
+        g.FillEllipseShadow(GetColor(kSH), bounds.GetTranslated(mStyle.shadowOffset, mStyle.shadowOffset), mShadowBlur);
+      else
+        g.FillEllipse(GetColor(kSH), bounds.GetTranslated(mStyle.shadowOffset, mStyle.shadowOffset));
+    }
    
     if(pressed)
       g.FillEllipse(GetColor(kON), bounds);
@@ -832,7 +1118,12 @@ public:
     {
       //outer shadow
       if (mStyle.drawShadows)
-        g.FillRoundRect(GetColor(kSH), handleBounds.GetTranslated(mStyle.shadowOffset, mStyle.shadowOffset), topLeftR, topRightR, bottomLeftR, bottomRightR);
+      {
+        if (mShadowBlur > 0.f)
+          g.FillRoundRectShadow(GetColor(kSH), handleBounds.GetTranslated(mStyle.shadowOffset, mStyle.shadowOffset), topLeftR, topRightR, bottomLeftR, bottomRightR, mShadowBlur);
+        else
+          g.FillRoundRect(GetColor(kSH), handleBounds.GetTranslated(mStyle.shadowOffset, mStyle.shadowOffset), topLeftR, topRightR, bottomLeftR, bottomRightR);
+      }
       
       g.FillRoundRect(GetColor(kFG), handleBounds, topLeftR, topRightR, bottomLeftR, bottomRightR);
     }
@@ -883,7 +1174,12 @@ public:
     {
       //outer shadow
       if (mStyle.drawShadows)
-        g.FillTriangle(GetColor(kSH), x1 + mStyle.shadowOffset, y1 + mStyle.shadowOffset, x2 + mStyle.shadowOffset, y2 + mStyle.shadowOffset, x3 + mStyle.shadowOffset, y3 + mStyle.shadowOffset);
+      {
+        if (mShadowBlur > 0.f)
+          g.FillTriangleShadow(GetColor(kSH), x1 + mStyle.shadowOffset, y1 + mStyle.shadowOffset, x2 + mStyle.shadowOffset, y2 + mStyle.shadowOffset, x3 + mStyle.shadowOffset, y3 + mStyle.shadowOffset, mShadowBlur);
+        else
+          g.FillTriangle(GetColor(kSH), x1 + mStyle.shadowOffset, y1 + mStyle.shadowOffset, x2 + mStyle.shadowOffset, y2 + mStyle.shadowOffset, x3 + mStyle.shadowOffset, y3 + mStyle.shadowOffset);
+      }
       
       g.FillTriangle(GetColor(kFG), x1, y1, x2, y2, x3, y3);
     }
@@ -976,11 +1272,15 @@ protected:
   float mSplashX = 0.f;
   float mSplashY = 0.f;
   float mMaxSplashRadius = 50.f;
+  float mShadowBlur = 0.f;
   IRECT mWidgetBounds; // The knob/slider/button
   IRECT mLabelBounds; // A piece of text above the control
   IRECT mValueBounds; // Text below the contol, usually displaying the value of a parameter
   WDL_String mLabelStr;
   WDL_String mValueStr;
+  bool mCacheStaticLayer = false;
+  ILayerPtr mStaticLayer;
+  IRECT mStaticLayerBounds;
 };
 
 /** A base class for knob/dial controls, to handle mouse action and Sender. */
@@ -1100,12 +1400,23 @@ public:
   void DrawWidget(IGraphics& g) override
   {
     int nVals = NVals();
+    // tracks outside the area being drawn would be clipped away, see SetTrackDirty()
+    const IRECT region = g.GetDrawRegion();
     
     for (int ch = 0; ch < nVals; ch++)
     {
-      DrawTrack(g, mTrackBounds.Get()[ch], ch);
+      if (region.Intersects(GetTrackDirtyBounds(ch)))
+        DrawTrack(g, mTrackBounds.Get()[ch], ch);
     }
   }
+
+  /** Mark one track as dirty, so that only its area is redrawn on the next display refresh rather than the whole control, see IControl::SetDirtyRect()
+   * @param chIdx The index of the track */
+  void SetTrackDirty(int chIdx)
+  {
+    if (chIdx > kNoValIdx && chIdx < mTrackBounds.GetSize())
+      SetDirtyRect(GetTrackDirtyBounds(chIdx));
+  }
   
   //void SetAllTrackData(float val) { memset(mTrackData.Get(), (int) Clip(val, mMinTrackValue, mMaxTrackValue), mTrackData.GetSize() * sizeof(float) ); }
 protected:
@@ -1144,6 +1455,12 @@ protected:
   {
     g.FillRect(GetColor(kFR), r);
   }
+
+  /** @return The area that drawing a track can touch, its bounds padded for the frame */
+  virtual IRECT GetTrackDirtyBounds(int chIdx) const
+  {
+    return mTrackBounds.Get()[chIdx].GetPadded(mStyle.frameThickness);
+  }
   
   virtual void OnResize() override
   {
@@ -1374,7 +1691,7 @@ public:
   void GrayOut(bool gray) override { IBitmapBase::GrayOut(gray); IControl::GrayOut(gray); }
 };
 
-/** A basic control to draw an SVG image to the screen. Optionally, cache SVG to an ILayer. */
+/** A basic control to draw an SVG image to the screen. Optionally, draw it from a cached raster, see IGraphics::DrawSVGCached() */
 class ISVGControl : public IControl
 {
 public:
@@ -1389,16 +1706,7 @@ public:
   void Draw(IGraphics& g) override
   {
     if(mUseLayer)
-    {
-      if (!g.CheckLayer(mLayer))
-      {
-        g.StartLayer(mRECT);
-        g.DrawSVG(mSVG, mRECT);
-        mLayer = g.EndLayer();
-      }
-
-      g.DrawLayer(mLayer);
-    }
+      g.DrawSVGCached(mSVG, mRECT);
     else
       g.DrawSVG(mSVG, mRECT);
   }
@@ -1410,7 +1718,6 @@ public:
   
 private:
   bool mUseLayer;
-  ILayerPtr mLayer;
   ISVG mSVG;
 };
 
@@ -8,7 +8,14 @@
  ==============================================================================
 */
 
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+#include <typeinfo>
+#include <vector>
+
 #include "IGraphics.h"
+#include "IGraphicsResourcePack.h"
 
 #define NANOSVG_IMPLEMENTATION
 #include "nanosvg.h"
@@ -33,6 +40,10 @@ using VST3_API_BASE = iplug::IPlugVST3Controller;
 #include "IFPSDisplayControl.h"
 #include "ICornerResizerControl.h"
 #include "IPopupMenuControl.h"
+#include "IGraphicsRowWorkers.h"
+#include "IGraphicsAssetLoader.h"
+#include "IGraphicsTextMeasureCache.h"
+#include "IGraphicsShader.h"
 #include "ITextEntryControl.h"
 
 using namespace iplug;
@@ -41,6 +52,11 @@ using namespace igraphics;
 static StaticStorage<APIBitmap> sBitmapCache;
 static StaticStorage<SVGHolder> sSVGCache;
 
+// The resource pack is shared by every editor and never closed, since backends may wrap its pixels without copying them
+static IResourcePack sResourcePack;
+static WDL_String sResourcePackName;
+static std::mutex sResourcePackMutex;
+
 IGraphics::IGraphics(IGEditorDelegate& dlg, int w, int h, int fps, float scale)
 : mDelegate(&dlg)
 , mWidth(w)
@@ -63,6 +79,18 @@ IGraphics::IGraphics(IGEditorDelegate& dlg, int w, int h, int fps, float scale)
 
 IGraphics::~IGraphics()
 {
+  // finishing hands parsed SVGs to their cache entries, which must not be left empty for other instances
+  if (mAssetLoader)
+    mAssetLoader->WaitAll();
+
+  mAssetLoader = nullptr;
+
+  // jobs capture their controls, which are still attached here, so they are finished rather than abandoned
+  if (mBackgroundJobs)
+    mBackgroundJobs->WaitAll();
+
+  mBackgroundJobs = nullptr;
+
 #ifdef IGRAPHICS_IMGUI
   mImGuiRenderer = nullptr;
 #endif
@@ -79,6 +107,8 @@ void IGraphics::SetScreenScale(int scale)
 {
   mScreenScale = scale;
   PlatformResize(GetDelegate()->EditorResize());
+  ClearSVGRasterCache();
+  ClearTextMeasureCache();
   ForAllControls(&IControl::OnRescale);
   SetAllControlsDirty();
   DrawResize();
@@ -95,6 +125,9 @@ void IGraphics::Resize(int w, int h, float scale)
   DBGMSG("resize %i, resize %i, scale %f\n", w, h, scale);
   ReleaseMouseCapture();
 
+  if (scale != GetDrawScale())
+    ClearTextMeasureCache();
+
   mDrawScale = scale;
   mWidth = w;
   mHeight = h;
@@ -103,9 +136,11 @@ void IGraphics::Resize(int w, int h, float scale)
     mCornerResizer->OnRescale();
 
   PlatformResize(GetDelegate()->EditorResize());
+  ClearSVGRasterCache();
   ForAllControls(&IControl::OnResize);
   SetAllControlsDirty();
   DrawResize();
+  InvalidateHitTestGrid();
   
   if(mLayoutOnResize)
     GetDelegate()->LayoutUI(this);
@@ -138,6 +173,8 @@ void IGraphics::RemoveControls(int fromIdx)
     mControls.Delete(idx--, true);
   }
   
+  InvalidateHitTestGrid();
+  InvalidateControlIndex();
   SetAllControlsDirty();
 }
 
@@ -155,7 +192,15 @@ void IGraphics::RemoveAllControls()
   mLiveEdit = nullptr;
 #endif
   
+  // nothing is left to draw, and the controls don't have to be looked up one by one as they are deleted
+  mDirtyControls.clear();
+  mCheckingControls.clear();
+  mDrawnControls.clear();
+
   mControls.Empty(true);
+  mDeferredGroups.clear();
+  InvalidateHitTestGrid();
+  InvalidateControlIndex();
 }
 
 void IGraphics::SetControlValueAfterTextEdit(const char* str)
@@ -197,6 +242,8 @@ void IGraphics::AttachBackground(const char* name)
   IControl* pBG = new IBitmapControl(0, 0, bg, kNoParameter, EBlend::Clobber);
   pBG->SetDelegate(*GetDelegate());
   mControls.Insert(0, pBG);
+  InvalidateHitTestGrid();
+  InvalidateControlIndex();
 }
 
 void IGraphics::AttachPanelBackground(const IPattern& color)
@@ -204,6 +251,8 @@ void IGraphics::AttachPanelBackground(const IPattern& color)
   IControl* pBG = new IPanelControl(GetBounds(), color);
   pBG->SetDelegate(*GetDelegate());
   mControls.Insert(0, pBG);
+  InvalidateHitTestGrid();
+  InvalidateControlIndex();
 }
 
 IControl* IGraphics::AttachControl(IControl* pControl, int controlTag, const char* group)
@@ -212,9 +261,100 @@ IControl* IGraphics::AttachControl(IControl* pControl, int controlTag, const cha
   pControl->SetTag(controlTag);
   pControl->SetGroup(group);
   mControls.Add(pControl);
+  InvalidateHitTestGrid();
+  InvalidateControlIndex();
   return pControl;
 }
 
+void IGraphics::AttachDeferredGroup(const char* group, std::function<void(IGraphics* pGraphics)> buildFunc, bool preWarm)
+{
+  assert(CStringHasContents(group) && !IsGroupDeferred(group));
+
+  DeferredGroup deferred;
+  deferred.mName.Set(group);
+  deferred.mBuildFunc = std::move(buildFunc);
+  deferred.mInsertIdx = NControls();
+  deferred.mPreWarm = preWarm;
+  mDeferredGroups.push_back(std::move(deferred));
+}
+
+bool IGraphics::IsGroupDeferred(const char* group) const
+{
+  for (auto& deferred : mDeferredGroups)
+  {
+    if (!strcmp(deferred.mName.Get(), group))
+      return true;
+  }
+
+  return false;
+}
+
+bool IGraphics::BuildDeferredGroup(const char* group)
+{
+  auto it = std::find_if(mDeferredGroups.begin(), mDeferredGroups.end(), [group](const DeferredGroup& deferred) {
+    return !strcmp(deferred.mName.Get(), group);
+  });
+
+  if (it == mDeferredGroups.end())
+    return false;
+
+  TRACE_SCOPE("ui", "IGraphics::BuildDeferredGroup");
+
+  // removed first, so that the build function can register further groups, and the group isn't built again from within it
+  DeferredGroup deferred = std::move(*it);
+  const size_t registrationIdx = it - mDeferredGroups.begin();
+  mDeferredGroups.erase(it);
+
+  const size_t nRegistered = mDeferredGroups.size();
+  const int startIdx = NControls();
+  deferred.mBuildFunc(this);
+  const int nBuilt = NControls() - startIdx;
+  const int insertIdx = std::min(deferred.mInsertIdx, startIdx);
+
+  std::vector<IControl*> built;
+
+  for (int i = NControls() - 1; i >= startIdx; i--)
+  {
+    built.push_back(mControls.Get(i));
+    mControls.Delete(i, false);
+  }
+
+  for (int i = 0; i < nBuilt; i++)
+  {
+    IControl* pControl = built[nBuilt - 1 - i];
+    mControls.Insert(insertIdx + i, pControl);
+
+    if (!CStringHasContents(pControl->GetGroup()))
+      pControl->SetGroup(deferred.mName.Get());
+
+    pControl->Hide(true);
+
+    for (int v = 0; v < pControl->NVals(); v++)
+    {
+      if (const IParam* pParam = pControl->GetParam(v))
+        pControl->SetValueFromDelegate(pParam->GetNormalized(), v);
+    }
+  }
+
+  // groups registered later are above this one in the stack, and groups registered by the build function move with its controls
+  for (size_t i = registrationIdx; i < mDeferredGroups.size(); i++)
+  {
+    int& idx = mDeferredGroups[i].mInsertIdx;
+
+    if (i >= nRegistered)
+      idx = insertIdx + std::max(idx - startIdx, 0);
+    else if (idx >= insertIdx)
+      idx += nBuilt;
+  }
+
+  if (mMouseOver)
+    mMouseOverIdx = mControls.Find(mMouseOver);
+
+  InvalidateHitTestGrid();
+  InvalidateControlIndex();
+  return true;
+}
+
 void IGraphics::AttachCornerResizer(EUIResizerMode sizeMode, bool layoutOnResize)
 {
   AttachCornerResizer(new ICornerResizerControl(GetBounds(), 20), sizeMode, layoutOnResize);
@@ -274,16 +414,34 @@ void IGraphics::ShowFPSDisplay(bool enable)
 
 IControl* IGraphics::GetControlWithTag(int controlTag)
 {
+  if (mControlIndexDirty)
+    RebuildControlIndex();
+
+  auto it = mTagControls.find(controlTag);
+  return it != mTagControls.end() ? it->second : nullptr;
+}
+
+void IGraphics::RebuildControlIndex()
+{
+  mParamControls.clear();
+  mTagControls.clear();
+  mMidiControls.clear();
+
   for (auto c = 0; c < NControls(); c++)
   {
     IControl* pControl = GetControl(c);
-    if (pControl->GetTag() == controlTag)
-    {
-      return pControl;
-    }
+
+    for (int v = 0; v < pControl->NVals(); v++)
+      mParamControls[pControl->GetParamIdx(v)].push_back({pControl, v});
+
+    // the first control with a tag is the one found, as when the stack was searched
+    mTagControls.emplace(pControl->GetTag(), pControl);
+
+    if (pControl->GetWantsMidi())
+      mMidiControls.push_back(pControl);
   }
-  
-  return nullptr;
+
+  mControlIndexDirty = false;
 }
 
 void IGraphics::HideControl(int paramIdx, bool hide)
@@ -298,20 +456,50 @@ void IGraphics::GrayOutControl(int paramIdx, bool gray)
 
 void IGraphics::ForControlWithParam(int paramIdx, std::function<void(IControl& control)> func)
 {
-  for (auto c = 0; c < NControls(); c++)
-  {
-    IControl* pControl = GetControl(c);
+  IControl* pLast = nullptr;
 
-    if (pControl->LinkedToParam(paramIdx) > kNoValIdx)
+  // a control's values are next to each other in the index, so each control is called once
+  ForControlValueWithParam(paramIdx, [&pLast, &func](IControl& control, int valIdx) {
+    if (&control != pLast)
     {
-      func(*pControl);
-      // Could be more than one, don't break until we check them all.
+      pLast = &control;
+      func(control);
     }
-  }
+  });
+}
+
+void IGraphics::ForControlValueWithParam(int paramIdx, std::function<void(IControl& control, int valIdx)> func)
+{
+  if (mControlIndexDirty)
+    RebuildControlIndex();
+
+  auto it = mParamControls.find(paramIdx);
+
+  if (it == mParamControls.end())
+    return;
+
+  // copied, since func may change what the controls are linked to, and the index is rebuilt if it is used again
+  const std::vector<std::pair<IControl*, int>> linked = it->second;
+
+  for (auto& controlVal : linked)
+    func(*controlVal.first, controlVal.second);
+}
+
+void IGraphics::ForControlWantingMidi(std::function<void(IControl& control)> func)
+{
+  if (mControlIndexDirty)
+    RebuildControlIndex();
+
+  const std::vector<IControl*> controls = mMidiControls;
+
+  for (IControl* pControl : controls)
+    func(*pControl);
 }
 
 void IGraphics::ForControlInGroup(const char* group, std::function<void(IControl& control)> func)
 {
+  BuildDeferredGroup(group);
+
   for (auto c = 0; c < NControls(); c++)
   {
     IControl* pControl = GetControl(c);
@@ -325,6 +513,15 @@ void IGraphics::ForControlInGroup(const char* group, std::function<void(IControl
   }
 }
 
+void IGraphics::HideGroup(const char* group, bool hide)
+{
+  // the controls of a deferred group are built hidden, so it only needs building once it is shown
+  if (hide && IsGroupDeferred(group))
+    return;
+
+  ForControlInGroup(group, [hide](IControl& control) { control.Hide(hide); });
+}
+
 void IGraphics::ForStandardControlsFunc(std::function<void(IControl& control)> func)
 {
   for (auto c = 0; c < NControls(); c++)
@@ -372,7 +569,84 @@ void IGraphics::SetAllControlsDirty()
 
 void IGraphics::SetAllControlsClean()
 {
-  ForAllControls(&IControl::SetClean);
+  // controls dirtied since IsDirty() are still queued, and stay dirty so that they are drawn on the next frame
+  for (IControl* pControl : mDrawnControls)
+    pControl->SetClean();
+
+  mDrawnControls.clear();
+}
+
+void IGraphics::AddDirtyControl(IControl* pControl)
+{
+  const bool wasEmpty = mDirtyControls.empty();
+
+  pControl->SetInDirtyList(true);
+  mDirtyControls.push_back(pControl);
+
+  if (wasEmpty)
+    RequestFrame();
+}
+
+void IGraphics::SetOccluded(bool occluded)
+{
+  if (occluded == mOccluded)
+    return;
+
+  mOccluded = occluded;
+  GetDelegate()->OnUIOcclusionChanged(occluded);
+
+  // anything dirtied while the window was occluded is still queued
+  if (!occluded)
+    RequestFrame();
+}
+
+bool IGraphics::NeedsFrames() const
+{
+  if (mOccluded)
+    return false;
+
+#ifdef USE_IDLE_CALLS
+  return true;
+#else
+  if (!mDirtyControls.empty() || mShowControlDrawTimes)
+    return true;
+
+  if (mMouseOverPending || !mCoalescedDrags.empty())
+    return true;
+
+  if (mAssetLoader && mAssetLoader->HasPending())
+    return true;
+
+  if (mBackgroundJobs && mBackgroundJobs->HasPending())
+    return true;
+
+#if defined IGRAPHICS_IMGUI && (defined IGRAPHICS_GL2 || defined IGRAPHICS_GL3)
+  if (mImGuiRenderer && mImGuiRenderer->GetDrawFunc())
+    return true;
+#endif
+
+  return false;
+#endif
+}
+
+void IGraphics::RemoveDirtyControl(IControl* pControl)
+{
+  auto forget = [pControl](std::vector<IControl*>& list, bool keepIndices) {
+    for (size_t i = 0; i < list.size(); i++)
+    {
+      if (list[i] == pControl)
+      {
+        if (keepIndices)
+          list[i] = nullptr;
+        else
+          list.erase(list.begin() + i--);
+      }
+    }
+  };
+
+  forget(mDirtyControls, false);
+  forget(mCheckingControls, true);
+  forget(mDrawnControls, false);
 }
 
 void IGraphics::AssignParamNameToolTips()
@@ -386,23 +660,17 @@ void IGraphics::AssignParamNameToolTips()
   ForStandardControlsFunc(func);
 }
 
-void IGraphics::UpdatePeers(IControl* pCaller, int callerValIdx) // TODO: this could be really slow
+void IGraphics::UpdatePeers(IControl* pCaller, int callerValIdx)
 {
   double value = pCaller->GetValue(callerValIdx);
   int paramIdx = pCaller->GetParamIdx(callerValIdx);
-    
-  auto func = [pCaller, paramIdx, value](IControl& control)
-  {
-    int valIdx = control.LinkedToParam(paramIdx);
 
+  ForControlWithParam(paramIdx, [pCaller, paramIdx, value](IControl& control)
+  {
     // Not actually called from the delegate, but we don't want to push the updates back to the delegate
-    if ((valIdx > kNoValIdx) && (&control != pCaller))
-    {
-      control.SetValueFromDelegate(value, valIdx);
-    }
-  };
-    
-  ForStandardControlsFunc(func);
+    if (&control != pCaller)
+      control.SetValueFromDelegate(value, control.LinkedToParam(paramIdx));
+  });
 }
 
 void IGraphics::PromptUserInput(IControl& control, const IRECT& bounds, int valIdx)
@@ -456,8 +724,34 @@ void IGraphics::MeasureText(const IText& text, const char* str, IRECT& bounds) c
 {
   if (!str || str[0] == '\0')
     return;
-    
+  
+  // rotated text is measured around the centre of the bounds, so only level text is cached, relative to the point it is aligned to
+  if (text.mAngle != 0.f)
+  {
+    DoMeasureText(text, str, bounds);
+    return;
+  }
+  
+  const float anchorX = text.mAlign == EAlign::Near ? bounds.L : text.mAlign == EAlign::Center ? bounds.MW() : bounds.R;
+  const float anchorY = text.mVAlign == EVAlign::Top ? bounds.T : text.mVAlign == EVAlign::Middle ? bounds.MH() : bounds.B;
+  
+  if (!mTextMeasureCache)
+    mTextMeasureCache = std::make_unique<ITextMeasureCache>();
+  
+  if (const IRECT* pCached = mTextMeasureCache->Find(text, str, GetDrawScale() * GetScreenScale()))
+  {
+    bounds = pCached->GetTranslated(anchorX, anchorY);
+    return;
+  }
+  
   DoMeasureText(text, str, bounds);
+  mTextMeasureCache->Add(bounds.GetTranslated(-anchorX, -anchorY));
+}
+
+void IGraphics::ClearTextMeasureCache()
+{
+  if (mTextMeasureCache)
+    mTextMeasureCache->Clear();
 }
 
 void IGraphics::DrawText(const IText& text, const char* str, float x, float y, const IBlend* pBlend)
@@ -618,19 +912,76 @@ void IGraphics::DrawData(const IColor& color, const IRECT& bounds, float* normYP
 
 bool IGraphics::IsDirty(IRECTList& rects)
 {
+  TRACE_SCOPE_VALUE("ui", "IGraphics::IsDirty", static_cast<int>(mDirtyControls.size()));
+
   bool dirty = false;
-    
-  auto func = [&dirty, &rects](IControl& control)
+  mFrameTime = std::chrono::high_resolution_clock::now();
+
+  FlushCoalescedMouseInput();
+
+  if (mAssetLoader && mAssetLoader->ProcessFinished())
+    OnAsyncAssetsLoaded();
+
+  if (mBackgroundJobs)
+    mBackgroundJobs->ProcessFinished();
+
+  // one group a frame, so that pre-warming doesn't stall the editor
+  if (mFrameDrawn)
   {
-    if (control.IsDirty())
+    for (auto& deferred : mDeferredGroups)
     {
-      // N.B padding outlines for single line outlines
-      rects.Add(control.GetRECT().GetPadded(0.75));
-      dirty = true;
+      if (deferred.mPreWarm)
+      {
+        WDL_String group(deferred.mName);
+        BuildDeferredGroup(group.Get());
+        break;
+      }
     }
-  };
-    
-  ForAllControlsFunc(func);
+  }
+
+  // controls that queue themselves while they are asked, e.g. from an animation function, go on the next frame's list
+  mCheckingControls.swap(mDirtyControls);
+  mDrawnControls.clear();
+
+  for (size_t i = 0; i < mCheckingControls.size(); i++)
+  {
+    IControl* pControl = mCheckingControls[i];
+
+    if (!pControl) // deleted while the list was being checked
+      continue;
+
+    pControl->SetInDirtyList(false);
+
+    if (pControl->IsDirty())
+    {
+      pControl->InvalidateCache();
+
+      for (IContainerBase* pParent = pControl->GetParent(); pParent; pParent = pParent->GetParent())
+      {
+        if (pParent->GetCacheChildren())
+          pParent->InvalidateChildrenLayer();
+      }
+
+      // nothing inside a hidden container is drawn, and showing the container redraws its bounds
+      if (pControl->IsHiddenByContainer())
+      {
+        IRECTList hiddenRects;
+        pControl->TakeDirtyRects(hiddenRects);
+      }
+      else
+      {
+        pControl->TakeDirtyRects(rects);
+        dirty = true;
+      }
+
+      mDrawnControls.push_back(pControl);
+    }
+
+    if (pControl->GetPollDirty() || pControl->GetAnimationFunction())
+      pControl->QueueDirty();
+  }
+
+  mCheckingControls.clear();
   
 #ifdef USE_IDLE_CALLS
   if (dirty)
@@ -644,13 +995,28 @@ bool IGraphics::IsDirty(IRECTList& rects)
   }
 #endif
 
-  //TODO: for GL backends, having an ImGui on top currently requires repainting everything on each frame
-#if defined IGRAPHICS_IMGUI && (defined IGRAPHICS_GL2 || defined IGRAPHICS_GL3)
-  if (mImGuiRenderer && mImGuiRenderer->GetDrawFunc())
+  // the heatmap is relative to every control, so they are all drawn each frame
+  if (mShowControlDrawTimes)
   {
+    rects.Clear();
     rects.Add(GetBounds());
     return true;
   }
+
+  // with the GL backends ImGui is drawn over the composited frame, so the area it covers is redrawn under it whenever anything is drawn
+#if defined IGRAPHICS_IMGUI && (defined IGRAPHICS_GL2 || defined IGRAPHICS_GL3)
+  if (mImGuiRenderer && mImGuiRenderer->GetDrawFunc())
+  {
+    IRECT imGuiBounds;
+
+    if (mImGuiRenderer->Update(imGuiBounds) || dirty)
+    {
+      if (!imGuiBounds.Empty())
+        rects.Add(imGuiBounds);
+
+      return true;
+    }
+  }
 #endif
 
   return dirty;
@@ -670,17 +1036,32 @@ void IGraphics::BeginFrame()
 // Draw a control in a region if it needs to be drawn
 void IGraphics::DrawControl(IControl* pControl, const IRECT& bounds, float scale)
 {
-  if (pControl && (!pControl->IsHidden() || pControl == GetControl(0)))
+  // the children of a container that caches them are drawn into its layer
+  if (pControl && (!pControl->IsHidden() || pControl == GetControl(0)) && !pControl->IsHiddenByContainer() && !pControl->IsDrawnByContainer())
   {
     // N.B. Padding allows single line outlines on controls
     IRECT controlBounds = pControl->GetRECT().GetPadded(0.75).GetPixelAligned(scale);
     IRECT clipBounds = bounds.Intersect(controlBounds);
 
+    // children are only drawn within their containers
+    for (IContainerBase* pParent = pControl->GetParent(); pParent; pParent = pParent->GetParent())
+      clipBounds = clipBounds.Intersect(pParent->GetRECT().GetPadded(0.75).GetPixelAligned(scale));
+
     if (clipBounds.W() <= 0.0 || clipBounds.H() <= 0)
       return;
     
+    TRACE_SCOPE_VALUE("ui", typeid(*pControl).name(), pControl->GetTag());
     PrepareRegion(clipBounds);
-    pControl->Draw(*this);
+    mDrawRegion = clipBounds;
+
+    if (mShowControlDrawTimes)
+    {
+      const double start = GetTimestamp();
+      pControl->DrawCached(*this, controlBounds);
+      pControl->AddDrawTime((GetTimestamp() - start) * 1000.);
+    }
+    else
+      pControl->DrawCached(*this, controlBounds);
 #ifdef AAX_API
     pControl->DrawPTHighlight(*this);
 #endif
@@ -692,13 +1073,26 @@ void IGraphics::DrawControl(IControl* pControl, const IRECT& bounds, float scale
     }
 #endif
     
+    mDrawRegion = IRECT();
     CompleteRegion(clipBounds);
   }
 }
 
 void IGraphics::Draw(const IRECT& bounds, float scale)
 {
-  ForAllControlsFunc([this, bounds, scale](IControl& control) { DrawControl(&control, bounds, scale); });
+  if (const std::vector<int>* pCandidates = GetDrawCandidates(bounds))
+  {
+    for (int c : *pCandidates)
+    {
+      // the background is drawn even when hidden
+      if ((mControlHidden[c] && c > 0) || !mControlBounds[c].Intersects(bounds))
+        continue;
+
+      DrawControl(GetControl(c), bounds, scale);
+    }
+  }
+  else
+    ForAllControlsFunc([this, bounds, scale](IControl& control) { DrawControl(&control, bounds, scale); });
 
 #ifndef NDEBUG
   if (mShowAreaDrawn)
@@ -717,28 +1111,225 @@ void IGraphics::Draw(IRECTList& rects)
   if (!rects.Size())
     return;
   
+  TRACE_SCOPE_VALUE("ui", "IGraphics::Draw", rects.Size());
+
   float scale = GetBackingPixelScale();
-    
-  BeginFrame();
-    
+  
+  IRECT strictBounds;
+
   if (mStrict)
   {
-    IRECT r = rects.Bounds();
-    r.PixelAlign(scale);
-    Draw(r, scale);
+    strictBounds = rects.Bounds();
+    strictBounds.PixelAlign(scale);
   }
   else
   {
     rects.PixelAlign(scale);
     rects.Optimize();
+  }
+  
+  mFrameRects.Clear();
 
+  if (mShowControlDrawTimes)
+    mFrameRects.Add(GetBounds());
+  else if (mStrict)
+    mFrameRects.Add(strictBounds);
+  else
+  {
+    for (auto i = 0; i < rects.Size(); i++)
+      mFrameRects.Add(rects.Get(i));
+  }
+  
+  BeginFrame();
+    
+  if (mStrict)
+    Draw(strictBounds, scale);
+  else
+  {
     for (auto i = 0; i < rects.Size(); i++)
       Draw(rects.Get(i), scale);
   }
   
+  if (mShowControlDrawTimes)
+  {
+    PrepareRegion(GetBounds());
+    DrawControlDrawTimes();
+    CompleteRegion(GetBounds());
+  }
+  
+  EndFrame();
+  
+  mFrameDrawn = true;
+
+  if (mFrameDrawnFunc)
+    mFrameDrawnFunc(*this, mFrameRects);
+}
+
+void IGraphics::PresentLastFrame()
+{
+  TRACE_SCOPE("ui", "IGraphics::PresentLastFrame");
+
+  mFrameRects.Clear();
+  BeginFrame();
   EndFrame();
 }
 
+void IGraphics::ShowControlDrawTimes(bool enable, bool sortByPeak)
+{
+  mShowControlDrawTimes = enable;
+  mSortDrawTimesByPeak = sortByPeak;
+  ForStandardControlsFunc([](IControl& control) { control.ResetDrawTime(); });
+  SetAllControlsDirty();
+}
+
+void IGraphics::GetMemoryReport(IMemoryReport& report) const
+{
+  {
+    StaticStorage<APIBitmap>::Accessor storage(sBitmapCache);
+    report.AddShared("Bitmap cache", storage.GetMemoryUsage([](const APIBitmap& bitmap) { return bitmap.GetMemoryUsage(); }), storage.GetCount());
+  }
+
+  {
+    StaticStorage<SVGHolder>::Accessor storage(sSVGCache);
+    report.AddShared("SVG cache", storage.GetMemoryUsage([](const SVGHolder& svg) { return svg.GetMemoryUsage(); }), storage.GetCount());
+  }
+
+  const float pixelScale = GetBackingPixelScale();
+  report.Add("Backing store (estimate)", static_cast<size_t>(std::ceil(Width() * pixelScale) * std::ceil(Height() * pixelScale) * 4));
+  report.Add("Control list", mControls.GetSize() * (sizeof(IControl*) + sizeof(IControl)));
+#ifndef IGRAPHICS_NO_CONTROL_POOL
+  // the pool is shared by every editor, this one is charged for its share of the pooled controls
+  if (const int nPooled = IControlPool::Get().GetNumLive())
+    report.Add("Control pool", IControlPool::Get().GetMemoryUsage() * std::min(NControls(), nPooled) / nPooled);
+#endif
+
+  size_t cacheBytes = 0;
+
+  for (auto c = 0; c < mControls.GetSize(); c++)
+    cacheBytes += mControls.Get(c)->GetCacheMemoryUsage();
+
+  report.Add("Control layer caches", cacheBytes);
+
+  {
+    StaticStorage<APIBitmap>::Accessor storage(mSVGRasterCache);
+    report.Add("SVG raster cache", storage.GetMemoryUsage([](const APIBitmap& bitmap) { return bitmap.GetMemoryUsage(); }));
+  }
+
+  {
+    StaticStorage<APIBitmap>::Accessor storage(mShadowSpriteCache);
+    report.Add("Shadow sprite cache", storage.GetMemoryUsage([](const APIBitmap& bitmap) { return bitmap.GetMemoryUsage(); }));
+  }
+}
+
+void IGraphics::GetControlsByDrawTime(WDL_PtrList<IControl>& list, bool sortByPeak)
+{
+  std::vector<IControl*> controls;
+  ForStandardControlsFunc([&controls](IControl& control) { controls.push_back(&control); });
+
+  std::stable_sort(controls.begin(), controls.end(), [sortByPeak](IControl* a, IControl* b) {
+    return sortByPeak ? a->GetPeakDrawTime() > b->GetPeakDrawTime() : a->GetMeanDrawTime() > b->GetMeanDrawTime();
+  });
+
+  list.Empty();
+
+  for (auto* pControl : controls)
+    list.Add(pControl);
+}
+
+/** Reduces a name from typeid() to the class name, without namespaces. Handles the Itanium C++ ABI (clang, gcc) and MSVC formats */
+static void GetControlClassName(const IControl& control, WDL_String& str)
+{
+  const char* name = typeid(control).name();
+
+  if (*name == 'N') // nested name, a list of <length><identifier> ending in E
+  {
+    const char* last = nullptr;
+    int lastLen = 0;
+    name++;
+
+    while (isdigit(*name))
+    {
+      const int len = atoi(name);
+
+      while (isdigit(*name))
+        name++;
+
+      last = name;
+      lastLen = len;
+      name += len;
+    }
+
+    if (last)
+    {
+      str.Set(last, lastLen);
+      return;
+    }
+  }
+  else if (isdigit(*name)) // a class in the global namespace
+  {
+    while (isdigit(*name))
+      name++;
+  }
+  else if (const char* colons = strrchr(name, ':'))
+  {
+    name = colons + 1;
+  }
+  else if (const char* space = strrchr(name, ' '))
+  {
+    name = space + 1;
+  }
+
+  str.Set(name);
+}
+
+void IGraphics::DrawControlDrawTimes()
+{
+  static constexpr int kNumListed = 10;
+
+  WDL_PtrList<IControl> controls;
+  GetControlsByDrawTime(controls, mSortDrawTimesByPeak);
+
+  if (!controls.GetSize())
+    return;
+
+  auto getTime = [this](IControl* pControl) { return mSortDrawTimesByPeak ? pControl->GetPeakDrawTime() : pControl->GetMeanDrawTime(); };
+  const double maxTime = std::max(getTime(controls.Get(0)), 1e-6);
+
+  for (auto i = 0; i < controls.GetSize(); i++)
+  {
+    IControl* pControl = controls.Get(i);
+
+    if (pControl->IsHidden())
+      continue;
+
+    const float heat = static_cast<float>(getTime(pControl) / maxTime);
+    const int r = static_cast<int>(255 * heat), g = static_cast<int>(255 * (1.f - heat));
+    FillRect(IColor(static_cast<int>(64 + 96 * heat), r, g, 0), pControl->GetRECT());
+    DrawRect(IColor(255, r, g, 0), pControl->GetRECT());
+  }
+
+  const int nListed = std::min(controls.GetSize(), kNumListed);
+  const float rowHeight = 16.f;
+  const IRECT listBounds = GetBounds().GetFromTRHC(320.f, rowHeight * (nListed + 1) + 10.f).GetTranslated(-10.f, 10.f);
+  const IText text(12.f, COLOR_WHITE, DEFAULT_FONT, EAlign::Near);
+
+  FillRect(IColor(190, 0, 0, 0), listBounds);
+
+  IRECT row = listBounds.GetPadded(-5.f).GetFromTop(rowHeight);
+  DrawText(text, mSortDrawTimesByPeak ? "Slowest controls by peak draw time (ms)" : "Slowest controls by mean draw time (ms)", row);
+
+  WDL_String className, str;
+
+  for (auto i = 0; i < nListed; i++)
+  {
+    IControl* pControl = controls.Get(i);
+    row.Translate(0.f, rowHeight);
+    GetControlClassName(*pControl, className);
+    str.SetFormatted(128, "%.3f / %.3f  %s [%i] tag %i", pControl->GetMeanDrawTime(), pControl->GetPeakDrawTime(), className.Get(), mControls.Find(pControl), pControl->GetTag());
+    DrawText(text, str.Get(), row);
+  }
+}
+
 void IGraphics::SetStrictDrawing(bool strict)
 {
   mStrict = strict;
@@ -747,6 +1338,8 @@ void IGraphics::SetStrictDrawing(bool strict)
 
 void IGraphics::OnMouseDown(float x, float y, const IMouseMod& mod)
 {
+  FlushCoalescedMouseInput();
+
   Trace("IGraphics::OnMouseDown", __LINE__, "x:%0.2f, y:%0.2f, mod:LRSCA: %i%i%i%i%i",
         x, y, mod.L, mod.R, mod.S, mod.C, mod.A);
 
@@ -834,6 +1427,8 @@ void IGraphics::OnMouseDown(float x, float y, const IMouseMod& mod)
 
 void IGraphics::OnMouseUp(float x, float y, const IMouseMod& mod)
 {
+  FlushCoalescedMouseInput();
+
   Trace("IGraphics::OnMouseUp", __LINE__, "x:%0.2f, y:%0.2f, mod:LRSCA: %i%i%i%i%i",
         x, y, mod.L, mod.R, mod.S, mod.C, mod.A);
   
@@ -878,6 +1473,21 @@ void IGraphics::OnMouseUp(float x, float y, const IMouseMod& mod)
 }
 
 bool IGraphics::OnMouseOver(float x, float y, const IMouseMod& mod)
+{
+  if (!mCoalesceMouseInput)
+    return DispatchMouseOver(x, y, mod);
+
+  if (!NeedsFrames())
+    RequestFrame();
+
+  mPendingMouseOver = IMouseInfo { x, y, mod };
+  mMouseOverPending = true;
+
+  // until the next frame, the answer is the one for the last position sent
+  return mMouseOver != nullptr;
+}
+
+bool IGraphics::DispatchMouseOver(float x, float y, const IMouseMod& mod)
 {
   Trace("IGraphics::OnMouseOver", __LINE__, "x:%0.2f, y:%0.2f, mod:LRSCA: %i%i%i%i%i",
         x, y, mod.L, mod.R, mod.S, mod.C, mod.A);
@@ -908,6 +1518,8 @@ void IGraphics::OnMouseOut()
 {
   Trace("IGraphics::OnMouseOut", __LINE__, "");
 
+  FlushCoalescedMouseInput();
+
   // Store the old cursor type so this gets restored when the mouse enters again
   mCursorType = SetMouseCursor(ECursor::ARROW);
   ForAllControls(&IControl::OnMouseOut);
@@ -915,6 +1527,52 @@ void IGraphics::OnMouseOut()
 }
 
 void IGraphics::OnMouseDrag(float x, float y, float dX, float dY, const IMouseMod& mod)
+{
+  if (!mCoalesceMouseInput)
+  {
+    DispatchMouseDrag(x, y, dX, dY, mod);
+    return;
+  }
+
+  if (!NeedsFrames())
+    RequestFrame();
+
+  if (mCoalescedDrags.empty())
+    mPendingDragDX = mPendingDragDY = 0.f;
+
+  mCoalescedDrags.push_back(IMouseInfo { x, y, mod });
+  mPendingDragDX += dX;
+  mPendingDragDY += dY;
+}
+
+void IGraphics::SetCoalesceMouseInput(bool enable)
+{
+  if (!enable)
+    FlushCoalescedMouseInput();
+
+  mCoalesceMouseInput = enable;
+}
+
+void IGraphics::FlushCoalescedMouseInput()
+{
+  if (!mCoalescedDrags.empty())
+  {
+    // swapped, so that input arriving while the controls handle the drag is held for the next flush
+    mCoalescedDragsSent.swap(mCoalescedDrags);
+
+    const IMouseInfo& last = mCoalescedDragsSent.back();
+    DispatchMouseDrag(last.x, last.y, mPendingDragDX, mPendingDragDY, last.ms);
+    mCoalescedDragsSent.clear();
+  }
+
+  if (mMouseOverPending)
+  {
+    mMouseOverPending = false;
+    DispatchMouseOver(mPendingMouseOver.x, mPendingMouseOver.y, mPendingMouseOver.ms);
+  }
+}
+
+void IGraphics::DispatchMouseDrag(float x, float y, float dX, float dY, const IMouseMod& mod)
 {
   Trace("IGraphics::OnMouseDrag:", __LINE__, "x:%0.2f, y:%0.2f, dX:%0.2f, dY:%0.2f, mod:LRSCA: %i%i%i%i%i",
         x, y, dX, dY, mod.L, mod.R, mod.S, mod.C, mod.A);
@@ -937,6 +1595,8 @@ bool IGraphics::OnMouseDblClick(float x, float y, const IMouseMod& mod)
 {
   Trace("IGraphics::OnMouseDblClick", __LINE__, "x:%0.2f, y:%0.2f, mod:LRSCA: %i%i%i%i%i",
         x, y, mod.L, mod.R, mod.S, mod.C, mod.A);
+
+  FlushCoalescedMouseInput();
   
 #ifdef IGRAPHICS_IMGUI
   if(mImGuiRenderer)
@@ -966,6 +1626,8 @@ bool IGraphics::OnMouseDblClick(float x, float y, const IMouseMod& mod)
 
 void IGraphics::OnMouseWheel(float x, float y, const IMouseMod& mod, float d)
 {
+  FlushCoalescedMouseInput();
+
 #ifdef IGRAPHICS_IMGUI
     if(mImGuiRenderer)
     {
@@ -981,6 +1643,8 @@ void IGraphics::OnMouseWheel(float x, float y, const IMouseMod& mod, float d)
 
 bool IGraphics::OnKeyDown(float x, float y, const IKeyPress& key)
 {
+  FlushCoalescedMouseInput();
+
   Trace("IGraphics::OnKeyDown", __LINE__, "x:%0.2f, y:%0.2f, key:%s",
         x, y, key.utf8);
 
@@ -1009,6 +1673,8 @@ bool IGraphics::OnKeyDown(float x, float y, const IKeyPress& key)
 
 bool IGraphics::OnKeyUp(float x, float y, const IKeyPress& key)
 {
+  FlushCoalescedMouseInput();
+
   Trace("IGraphics::OnKeyUp", __LINE__, "x:%0.2f, y:%0.2f, key:%s",
         x, y, key.utf8);
   
@@ -1037,46 +1703,171 @@ bool IGraphics::OnKeyUp(float x, float y, const IKeyPress& key)
 
 void IGraphics::OnDrop(const char* str, float x, float y)
 {
+  FlushCoalescedMouseInput();
+
   IControl* pControl = GetMouseControl(x, y, false);
   if (pControl) pControl->OnDrop(str);
 }
 
-void IGraphics::ReleaseMouseCapture()
-{
-  mMouseCapture = nullptr;
-  HideMouseCursor(false);
+void IGraphics::ReleaseMouseCapture()
+{
+  mMouseCapture = nullptr;
+  HideMouseCursor(false);
+}
+
+void IGraphics::RebuildHitTestGrid()
+{
+  mHitGridCols = std::max(1, static_cast<int>(std::ceil(Width() / kHitGridCellSize)));
+  mHitGridRows = std::max(1, static_cast<int>(std::ceil(Height() / kHitGridCellSize)));
+  mHitGridCells.resize(mHitGridCols * mHitGridRows);
+
+  for (auto& cell : mHitGridCells)
+    cell.clear();
+
+  mControlBounds.assign(NControls(), IRECT());
+  mControlHidden.assign(NControls(), 1);
+
+  auto toCell = [](float v, int nCells) { return Clip(static_cast<int>(std::floor(v / kHitGridCellSize)), 0, nCells - 1); };
+
+  // in index order, so each cell lists its controls back to front
+  for (auto c = 0; c < NControls(); c++)
+  {
+    const IControl* pControl = GetControl(c);
+
+    // hiding a container takes its children out of the grid, see IContainerBase::Hide()
+    if (pControl->IsHiddenByContainer())
+      continue;
+
+    // padded to cover the outline padding and pixel alignment that DrawControl() adds
+    IRECT bounds = pControl->GetRECT().Union(pControl->GetTargetRECT()).GetPadded(kHitGridPadding);
+
+    // children are only hit and drawn within their containers
+    for (const IContainerBase* pParent = pControl->GetParent(); pParent; pParent = pParent->GetParent())
+      bounds = bounds.Intersect(pParent->GetRECT().Union(pParent->GetTargetRECT()).GetPadded(kHitGridPadding));
+
+    if (bounds.Empty() || bounds.R < 0.f || bounds.B < 0.f || bounds.L >= Width() || bounds.T >= Height())
+      continue;
+
+    mControlBounds[c] = bounds;
+    mControlHidden[c] = pControl->IsHidden();
+
+    const int l = toCell(bounds.L, mHitGridCols), r = toCell(bounds.R, mHitGridCols);
+    const int t = toCell(bounds.T, mHitGridRows), b = toCell(bounds.B, mHitGridRows);
+
+    for (auto row = t; row <= b; row++)
+    {
+      for (auto col = l; col <= r; col++)
+        mHitGridCells[row * mHitGridCols + col].push_back(c);
+    }
+  }
+
+  mHitGridDirty = false;
+}
+
+const std::vector<int>* IGraphics::GetHitTestCandidates(float x, float y)
+{
+  if (!mHitGridEnabled || x < 0.f || y < 0.f || x >= Width() || y >= Height())
+    return nullptr;
+
+  if (mHitGridDirty)
+    RebuildHitTestGrid();
+
+  const int col = std::min(static_cast<int>(x / kHitGridCellSize), mHitGridCols - 1);
+  const int row = std::min(static_cast<int>(y / kHitGridCellSize), mHitGridRows - 1);
+  return &mHitGridCells[row * mHitGridCols + col];
+}
+
+const std::vector<int>* IGraphics::GetDrawCandidates(const IRECT& bounds)
+{
+  if (!mHitGridEnabled)
+    return nullptr;
+
+  if (mHitGridDirty)
+    RebuildHitTestGrid();
+
+  mDrawCandidates.clear();
+
+  if (bounds.Empty() || bounds.R < 0.f || bounds.B < 0.f || bounds.L >= Width() || bounds.T >= Height())
+    return &mDrawCandidates;
+
+  auto toCell = [](float v, int nCells) { return Clip(static_cast<int>(std::floor(v / kHitGridCellSize)), 0, nCells - 1); };
+
+  const int l = toCell(bounds.L, mHitGridCols), r = toCell(bounds.R, mHitGridCols);
+  const int t = toCell(bounds.T, mHitGridRows), b = toCell(bounds.B, mHitGridRows);
+
+  if (l == 0 && t == 0 && r == mHitGridCols - 1 && b == mHitGridRows - 1)
+    return nullptr;
+
+  mDrawCandidateFlags.assign(NControls(), false);
+
+  for (auto row = t; row <= b; row++)
+  {
+    for (auto col = l; col <= r; col++)
+    {
+      for (int c : mHitGridCells[row * mHitGridCols + col])
+      {
+        if (!mDrawCandidateFlags[c])
+        {
+          mDrawCandidateFlags[c] = true;
+          mDrawCandidates.push_back(c);
+        }
+      }
+    }
+  }
+
+  // controls that span several cells are found out of order, and must be drawn in z-order
+  std::sort(mDrawCandidates.begin(), mDrawCandidates.end());
+
+  return &mDrawCandidates;
 }
 
 int IGraphics::GetMouseControlIdx(float x, float y, bool mouseOver)
 {
   if (!mouseOver || mHandleMouseOver)
   {
-    // Search from front to back
-    for (auto c = NControls() - 1; c >= (mouseOver ? 1 : 0); --c)
-    {
+    auto isHit = [&](int c) {
       IControl* pControl = GetControl(c);
 
 #if _DEBUG
-      if(!mLiveEdit)
-      {
+      if (mLiveEdit)
+        return pControl->GetRECT().Contains(x, y);
 #endif
-        if (!pControl->IsHidden() && !pControl->GetIgnoreMouse())
-        {
-          if ((!pControl->IsGrayed() || (mouseOver ? pControl->GetMOWhenGrayed() : pControl->GetMEWhenGrayed())))
-          {
-            if (pControl->IsHit(x, y))
-            {
-              return c;
-            }
-          }
-        }
+      if (!pControl->IsHidden() && !pControl->GetIgnoreMouse() && !pControl->IsHiddenByContainer())
+      {
+        if ((!pControl->IsGrayed() || (mouseOver ? pControl->GetMOWhenGrayed() : pControl->GetMEWhenGrayed())))
+          return pControl->IsHit(x, y);
+      }
+
+      return false;
+    };
+
+    const int minIdx = mouseOver ? 1 : 0;
+
+    // Search from front to back
+    if (const std::vector<int>* pCandidates = GetHitTestCandidates(x, y))
+    {
+      // the cell's other controls are ruled out by their hot fields, live editing hits hidden controls too
+      auto mayHit = [&](int c) {
 #if _DEBUG
+        if (mLiveEdit)
+          return true;
+#endif
+        return !mControlHidden[c] && mControlBounds[c].Contains(x, y);
+      };
+
+      for (auto it = pCandidates->rbegin(); it != pCandidates->rend(); ++it)
+      {
+        if (*it >= minIdx && mayHit(*it) && isHit(*it))
+          return *it;
       }
-      else if (pControl->GetRECT().Contains(x, y))
+    }
+    else
+    {
+      for (auto c = NControls() - 1; c >= minIdx; --c)
       {
-        return c;
+        if (isHit(c))
+          return c;
       }
-#endif
     }
   }
   
@@ -1261,6 +2052,76 @@ void IGraphics::EnableLiveEdit(bool enable, const char* file, int gridsize)
 #endif
 }
 
+/** @return A new image of an SVG in the resource pack, or nullptr if it isn't in the pack or was parsed with other units or dpi */
+static NSVGimage* LoadPackedSVG(const char* fileName, const char* units, float dpi)
+{
+  std::lock_guard<std::mutex> lock(sResourcePackMutex);
+  const IResourcePack::Entry* pEntry = sResourcePack.IsOpen() ? sResourcePack.FindSVG(fileName) : nullptr;
+
+  return pEntry ? sResourcePack.CreateSVG(*pEntry, units, dpi) : nullptr;
+}
+
+bool IGraphics::LoadResourcePack(const char* fileName)
+{
+  std::lock_guard<std::mutex> lock(sResourcePackMutex);
+
+  if (sResourcePack.IsOpen())
+  {
+    if (!strcmp(sResourcePackName.Get(), fileName))
+      return true;
+
+    DBGMSG("Resource pack %s is already loaded, %s is ignored\n", sResourcePackName.Get(), fileName);
+    return false;
+  }
+
+  WDL_String path;
+  EResourceLocation resourceFound = LocateResource(fileName, "pack", path, GetBundleID(), GetWinModuleHandle());
+  bool opened = false;
+
+#ifdef OS_WIN
+  if (resourceFound == EResourceLocation::kWinBinary)
+  {
+    int size = 0;
+    const void* pResData = LoadWinResource(path.Get(), "pack", size, GetWinModuleHandle());
+    opened = pResData && sResourcePack.Open(pResData, size);
+  }
+#endif
+
+  if (resourceFound == EResourceLocation::kAbsolutePath)
+    opened = sResourcePack.Open(path.Get());
+
+  if (!opened)
+  {
+    DBGMSG("Could not load resource pack %s\n", fileName);
+    return false;
+  }
+
+  sResourcePackName.Set(fileName);
+  return true;
+}
+
+bool IGraphics::SearchPackedBitmap(const char* fileName, int targetScale, int& sourceScale)
+{
+  std::lock_guard<std::mutex> lock(sResourcePackMutex);
+  const IResourcePack::Entry* pEntry = sResourcePack.IsOpen() ? sResourcePack.FindBitmap(fileName, targetScale) : nullptr;
+
+  if (pEntry)
+    sourceScale = pEntry->mScale;
+
+  return pEntry != nullptr;
+}
+
+APIBitmap* IGraphics::LoadPackedAPIBitmap(const char* fileName, int scale)
+{
+  std::lock_guard<std::mutex> lock(sResourcePackMutex);
+  const IResourcePack::Entry* pEntry = sResourcePack.IsOpen() ? sResourcePack.FindBitmap(fileName, scale) : nullptr;
+
+  if (!pEntry || pEntry->mScale != scale)
+    return nullptr;
+
+  return CreateAPIBitmapFromPixels(sResourcePack.GetData(*pEntry), pEntry->mWidth, pEntry->mHeight, scale);
+}
+
 ISVG IGraphics::LoadSVG(const char* fileName, const char* units, float dpi)
 {
   StaticStorage<SVGHolder>::Accessor storage(sSVGCache);
@@ -1268,14 +2129,21 @@ ISVG IGraphics::LoadSVG(const char* fileName, const char* units, float dpi)
 
   if(!pHolder)
   {
+    NSVGimage* pImage = LoadPackedSVG(fileName, units, dpi);
+
+    if (pImage)
+    {
+      pHolder = new SVGHolder(pImage);
+      storage.Add(pHolder, fileName);
+      return ISVG(pHolder->mImage);
+    }
+
     WDL_String path;
     EResourceLocation resourceFound = LocateResource(fileName, "svg", path, GetBundleID(), GetWinModuleHandle());
 
     if (resourceFound == EResourceLocation::kNotFound)
       return ISVG(nullptr); // return invalid SVG
 
-    NSVGimage* pImage = nullptr;
-
 #ifdef OS_WIN    
     if (resourceFound == EResourceLocation::kWinBinary)
     {
@@ -1309,6 +2177,302 @@ ISVG IGraphics::LoadSVG(const char* fileName, const char* units, float dpi)
   return ISVG(pHolder->mImage);
 }
 
+ISVG IGraphics::LoadSVGAsync(const char* fileName, const char* units, float dpi)
+{
+  StaticStorage<SVGHolder>::Accessor storage(sSVGCache);
+  SVGHolder* pHolder = storage.Find(fileName);
+
+  if (!pHolder)
+  {
+    // SVGs in the resource pack are already parsed, so there is nothing to wait for
+    if (NSVGimage* pImage = LoadPackedSVG(fileName, units, dpi))
+    {
+      pHolder = new SVGHolder(pImage);
+      storage.Add(pHolder, fileName);
+      return ISVG(pHolder->mImage);
+    }
+
+    WDL_String path;
+    EResourceLocation resourceFound = LocateResource(fileName, "svg", path, GetBundleID(), GetWinModuleHandle());
+
+    if (resourceFound == EResourceLocation::kNotFound)
+      return ISVG(nullptr); // return invalid SVG
+
+    pHolder = storage.Find(path.Get());
+
+    if (pHolder)
+      return ISVG(pHolder->mImage);
+
+    struct SVGParse
+    {
+      WDL_String mPath;
+      WDL_String mText;
+      WDL_String mUnits;
+      float mDPI;
+      NSVGimage* mImage = nullptr;
+    };
+
+    auto pParse = std::make_shared<SVGParse>();
+    pParse->mPath.Set(path.Get());
+    pParse->mUnits.Set(units);
+    pParse->mDPI = dpi;
+
+#ifdef OS_WIN
+    if (resourceFound == EResourceLocation::kWinBinary)
+    {
+      int size = 0;
+      const void* pResData = LoadWinResource(path.Get(), "svg", size, GetWinModuleHandle());
+
+      if (!pResData)
+        return ISVG(nullptr); // return invalid SVG
+
+      pParse->mText.Set(static_cast<const char*>(pResData));
+    }
+#endif
+
+    // An empty image, which the parsed one is swapped into on the main thread, so that every copy of the ISVG sees it
+    NSVGimage* pPlaceholder = static_cast<NSVGimage*>(calloc(1, sizeof(NSVGimage)));
+    pHolder = new SVGHolder(pPlaceholder);
+    storage.Add(pHolder, path.Get());
+
+    LoadAsync([pParse]() {
+      if (pParse->mText.GetLength())
+        pParse->mImage = nsvgParse(pParse->mText.Get(), pParse->mUnits.Get(), pParse->mDPI);
+      else
+        pParse->mImage = nsvgParseFromFile(pParse->mPath.Get(), pParse->mUnits.Get(), pParse->mDPI);
+    },
+    [pParse, pPlaceholder]() {
+      if (pParse->mImage)
+      {
+        std::swap(*pPlaceholder, *pParse->mImage);
+        nsvgDelete(pParse->mImage);
+      }
+      else
+        DBGMSG("Could not parse SVG %s\n", pParse->mPath.Get());
+    });
+  }
+
+  return ISVG(pHolder->mImage);
+}
+
+void IGraphics::DrawSVGCached(const ISVG& svg, const IRECT& bounds, const IBlend* pBlend)
+{
+  APIBitmap* pRaster = GetSVGRaster(svg, bounds.W(), bounds.H());
+
+  if (pRaster)
+  {
+    IBitmap bitmap(pRaster, 1, false);
+    const float w = bitmap.W() / bitmap.GetDrawScale();
+    const float h = bitmap.H() / bitmap.GetDrawScale();
+    DrawBitmap(bitmap, IRECT(bounds.L, bounds.T, bounds.L + w, bounds.T + h), 0, 0, pBlend);
+  }
+}
+
+void IGraphics::DrawRotatedSVGCached(const ISVG& svg, float destCentreX, float destCentreY, float width, float height, double angle, const IBlend* pBlend)
+{
+  APIBitmap* pRaster = GetSVGRaster(svg, width, height);
+
+  if (pRaster)
+    DrawRotatedBitmap(IBitmap(pRaster, 1, false), destCentreX, destCentreY, angle, 0, pBlend);
+}
+
+APIBitmap* IGraphics::GetSVGRaster(const ISVG& svg, float width, float height)
+{
+  // nothing to rasterize, e.g. an SVG from LoadSVGAsync() that is still being parsed
+  if (svg.W() <= 0.f || svg.H() <= 0.f || width <= 0.f || height <= 0.f)
+    return nullptr;
+
+  WDL_String key;
+  key.SetFormatted(64, "%p-%.2fx%.2f", static_cast<void*>(svg.mImage), width, height);
+  const double scale = GetBackingPixelScale();
+
+  StaticStorage<APIBitmap>::Accessor storage(mSVGRasterCache);
+  APIBitmap* pRaster = storage.Find(key.Get(), scale);
+
+  if (!pRaster)
+  {
+    if (storage.GetCount() >= kMaxSVGRasters)
+      storage.Clear();
+
+    // Layers reset the path transform, so the caller's is saved around rasterizing
+    const IRECT bounds(0.f, 0.f, width, height);
+    PathTransformSave();
+    StartLayer(bounds);
+    DrawSVG(svg, bounds);
+    ILayerPtr layer = EndLayer();
+    PathTransformRestore();
+
+    pRaster = layer->mBitmap.release();
+    storage.Add(pRaster, key.Get(), scale);
+  }
+
+  return pRaster;
+}
+
+bool IGraphics::DrawShader(IShader& shader, const IRECT& bounds, const IBlend* pBlend)
+{
+  const IShader::CPUFunc& func = shader.GetCPUFunc();
+
+  if (!func || bounds.Empty())
+    return false;
+
+  const float scale = GetBackingPixelScale();
+  const int width = static_cast<int>(std::ceil(bounds.W() * scale));
+  const int height = static_cast<int>(std::ceil(bounds.H() * scale));
+  APIBitmap* pBitmap = shader.GetCPUBitmap();
+
+  // the backend couldn't make a bitmap from the pixels last time
+  if (!pBitmap && shader.GetCPUBitmapVersion() == shader.GetVersion())
+    return false;
+
+  if (!pBitmap || pBitmap->GetWidth() != width || pBitmap->GetHeight() != height || shader.GetCPUBitmapVersion() != shader.GetVersion())
+  {
+    uint8_t* pPixels = shader.ResetCPUBitmap(width, height);
+
+    ParallelRows(height, [&](int startRow, int endRow) {
+      for (auto y = startRow; y < endRow; y++)
+      {
+        uint8_t* pDst = pPixels + y * width * 4;
+        const float v = (y + 0.5f) / height;
+
+        for (auto x = 0; x < width; x++, pDst += 4)
+        {
+          const IColor color = func(shader, (x + 0.5f) / width, v);
+          pDst[0] = static_cast<uint8_t>(Clip(color.R, 0, 255));
+          pDst[1] = static_cast<uint8_t>(Clip(color.G, 0, 255));
+          pDst[2] = static_cast<uint8_t>(Clip(color.B, 0, 255));
+          pDst[3] = static_cast<uint8_t>(Clip(color.A, 0, 255));
+        }
+      }
+    });
+
+    pBitmap = CreateAPIBitmapFromPixels(pPixels, width, height, GetScreenScale());
+    shader.SetCPUBitmap(pBitmap);
+  }
+
+  if (!pBitmap)
+    return false;
+
+  DrawFittedBitmap(IBitmap(pBitmap, 1, false), bounds, pBlend);
+  return true;
+}
+
+void IGraphics::FillRoundRectShadow(const IColor& color, const IRECT& bounds, float cRTL, float cRTR, float cRBR, float cRBL, float blur)
+{
+  WDL_String key;
+  key.SetFormatted(64, "rect-%.2f-%.2f-%.2f-%.2f", cRTL, cRTR, cRBR, cRBL);
+  DrawShadowSprite(key.Get(), color, bounds, blur, [&](const IRECT& r) { FillRoundRect(COLOR_BLACK, r, cRTL, cRTR, cRBR, cRBL); });
+}
+
+void IGraphics::FillEllipseShadow(const IColor& color, const IRECT& bounds, float blur)
+{
+  DrawShadowSprite("ellipse", color, bounds, blur, [&](const IRECT& r) { FillEllipse(COLOR_BLACK, r); });
+}
+
+void IGraphics::FillTriangleShadow(const IColor& color, float x1, float y1, float x2, float y2, float x3, float y3, float blur)
+{
+  const IRECT bounds(std::min({x1, x2, x3}), std::min({y1, y2, y3}), std::max({x1, x2, x3}), std::max({y1, y2, y3}));
+
+  // the vertices relative to the bounds, so that the sprite is reused wherever the triangle is
+  x1 -= bounds.L; x2 -= bounds.L; x3 -= bounds.L;
+  y1 -= bounds.T; y2 -= bounds.T; y3 -= bounds.T;
+
+  WDL_String key;
+  key.SetFormatted(128, "triangle-%.2f-%.2f-%.2f-%.2f-%.2f-%.2f", x1, y1, x2, y2, x3, y3);
+  DrawShadowSprite(key.Get(), color, bounds, blur, [&](const IRECT& r) {
+    FillTriangle(COLOR_BLACK, r.L + x1, r.T + y1, r.L + x2, r.T + y2, r.L + x3, r.T + y3);
+  });
+}
+
+void IGraphics::DrawShadowSprite(const char* key, const IColor& color, const IRECT& bounds, float blur, const std::function<void(const IRECT& bounds)>& drawShape)
+{
+  if (bounds.Empty())
+    return;
+
+  // the blur spreads by about its radius, at the sprite's scale
+  blur = std::max(blur, 0.f);
+  const float pad = std::ceil(blur) + 1.f;
+  const float w = bounds.W();
+  const float h = bounds.H();
+
+  WDL_String spriteKey;
+  spriteKey.SetFormatted(256, "%s-%.2fx%.2f-%.2f-%02x%02x%02x%02x", key, w, h, blur, color.A, color.R, color.G, color.B);
+  const double scale = GetBackingPixelScale();
+
+  StaticStorage<APIBitmap>::Accessor storage(mShadowSpriteCache);
+  APIBitmap* pSprite = storage.Find(spriteKey.Get(), scale);
+
+  if (!pSprite)
+  {
+    if (storage.GetCount() >= kMaxShadowSprites)
+      storage.Clear();
+
+    // Layers reset the path transform, so the caller's is saved around rendering
+    PathTransformSave();
+    StartLayer(IRECT(0.f, 0.f, w + 2.f * pad, h + 2.f * pad));
+    drawShape(IRECT(pad, pad, pad + w, pad + h));
+    ILayerPtr layer = EndLayer();
+    ApplyLayerDropShadow(layer, IShadow(color, blur, 0.f, 0.f, 1.f, false));
+    PathTransformRestore();
+
+    pSprite = layer->mBitmap.release();
+    storage.Add(pSprite, spriteKey.Get(), scale);
+  }
+
+  DrawBitmap(IBitmap(pSprite, 1, false), bounds.GetPadded(pad), 0, 0);
+}
+
+void IGraphics::ClearSVGRasterCache()
+{
+  StaticStorage<APIBitmap>::Accessor storage(mSVGRasterCache);
+  storage.Clear();
+
+  StaticStorage<APIBitmap>::Accessor shadowStorage(mShadowSpriteCache);
+  shadowStorage.Clear();
+}
+
+void IGraphics::LoadAsync(std::function<void()> load, std::function<void()> finish)
+{
+#ifdef OS_WEB
+  // there are no threads to load on, so the asset arrives straight away
+  load();
+  finish();
+#else
+  if (!mAssetLoader)
+    mAssetLoader = std::make_unique<IAssetLoader>();
+
+  mAssetLoader->Add(std::move(load), std::move(finish));
+  RequestFrame();
+#endif
+}
+
+void IGraphics::RunInBackground(std::function<void()> work, std::function<void()> finish)
+{
+#ifdef OS_WEB
+  work();
+  finish();
+#else
+  if (!mBackgroundJobs)
+    mBackgroundJobs = std::make_unique<IAssetLoader>();
+
+  mBackgroundJobs->Add(std::move(work), std::move(finish));
+  RequestFrame();
+#endif
+}
+
+void IGraphics::WaitForAsyncAssets()
+{
+  if (mAssetLoader && mAssetLoader->WaitAll())
+    OnAsyncAssetsLoaded();
+}
+
+void IGraphics::OnAsyncAssetsLoaded()
+{
+  // Layers and control caches may hold placeholders, so they are all redrawn
+  mAssetGeneration++;
+  SetAllControlsDirty();
+}
+
 IBitmap IGraphics::LoadBitmap(const char* name, int nStates, bool framesAreHorizontal, int targetScale)
 {
   if (targetScale == 0)
@@ -1323,34 +2487,50 @@ IBitmap IGraphics::LoadBitmap(const char* name, int nStates, bool framesAreHoriz
     WDL_String fullPath;
     std::unique_ptr<APIBitmap> loadedBitmap;
     int sourceScale = 0;
-    
-    const char* ext = name + strlen(name) - 1;
-    while (ext >= name && *ext != '.') --ext;
-    ++ext;
-    
-    bool bitmapTypeSupported = BitmapExtSupported(ext);
-    
-    if (!bitmapTypeSupported)
-      return IBitmap(); // return invalid IBitmap
-
-    EResourceLocation resourceLocation = SearchImageResource(name, ext, fullPath, targetScale, sourceScale);
 
-    if (resourceLocation == EResourceLocation::kNotFound)
-    {
-      // If no resource exists then search the cache for a suitable match
-      pAPIBitmap = SearchBitmapInCache(name, targetScale, sourceScale);
-    }
-    else
+    // Bitmaps in the resource pack are already decoded
+    if (SearchPackedBitmap(name, targetScale, sourceScale))
     {
-      // Try in the cache for a mismatched bitmap
       if (sourceScale != targetScale)
         pAPIBitmap = storage.Find(name, sourceScale);
 
-      // Load the resource if no match found
       if (!pAPIBitmap)
       {
-        loadedBitmap = std::unique_ptr<APIBitmap>(LoadAPIBitmap(fullPath.Get(), sourceScale, resourceLocation, ext));
-        pAPIBitmap= loadedBitmap.get();
+        loadedBitmap = std::unique_ptr<APIBitmap>(LoadPackedAPIBitmap(name, sourceScale));
+        pAPIBitmap = loadedBitmap.get();
+      }
+    }
+
+    if (!pAPIBitmap)
+    {
+      const char* ext = name + strlen(name) - 1;
+      while (ext >= name && *ext != '.') --ext;
+      ++ext;
+
+      bool bitmapTypeSupported = BitmapExtSupported(ext);
+
+      if (!bitmapTypeSupported)
+        return IBitmap(); // return invalid IBitmap
+
+      EResourceLocation resourceLocation = SearchImageResource(name, ext, fullPath, targetScale, sourceScale);
+
+      if (resourceLocation == EResourceLocation::kNotFound)
+      {
+        // If no resource exists then search the cache for a suitable match
+        pAPIBitmap = SearchBitmapInCache(name, targetScale, sourceScale);
+      }
+      else
+      {
+        // Try in the cache for a mismatched bitmap
+        if (sourceScale != targetScale)
+          pAPIBitmap = storage.Find(name, sourceScale);
+
+        // Load the resource if no match found
+        if (!pAPIBitmap)
+        {
+          loadedBitmap = std::unique_ptr<APIBitmap>(LoadAPIBitmap(fullPath.Get(), sourceScale, resourceLocation, ext));
+          pAPIBitmap= loadedBitmap.get();
+        }
       }
     }
 
@@ -1360,6 +2540,10 @@ IBitmap IGraphics::LoadBitmap(const char* name, int nStates, bool framesAreHoriz
     // Scale or retain if needed (N.B. - scaling retains in the cache)
     if (pAPIBitmap->GetScale() != targetScale)
     {
+      // the decoded source is kept too, so that other scales are resampled from it rather than loaded again
+      if (loadedBitmap)
+        RetainBitmap(IBitmap(loadedBitmap.release(), nStates, framesAreHorizontal, name), name);
+
       return ScaleBitmap(IBitmap(pAPIBitmap, nStates, framesAreHorizontal, name), name, targetScale);
     }
     else if (loadedBitmap)
@@ -1454,6 +2638,28 @@ APIBitmap* IGraphics::SearchBitmapInCache(const char* name, int targetScale, int
   return nullptr;
 }
 
+void IGraphics::PrescaleBitmaps(int scale)
+{
+  const int screenScale = GetScreenScale();
+
+  if (scale == screenScale)
+    return;
+
+  std::vector<WDL_String> names;
+
+  {
+    StaticStorage<APIBitmap>::Accessor storage(sBitmapCache);
+
+    storage.ForEach([&](const char* name, double cacheScale, const APIBitmap*) {
+      if (cacheScale == screenScale && !storage.Find(name, scale))
+        names.emplace_back(name);
+    });
+  }
+
+  for (const WDL_String& name : names)
+    LoadBitmap(name.Get(), 1, false, scale);
+}
+
 void IGraphics::StyleAllVectorControls(const IVStyle& style)
 {
   for (auto c = 0; c < NControls(); c++)
@@ -1500,12 +2706,25 @@ void IGraphics::CreatePopupMenu(IControl& control, IPopupMenu& menu, const IRECT
 }
 
 void IGraphics::StartLayer(const IRECT& r)
+{
+  DoStartLayer(r, false);
+}
+
+void IGraphics::StartRecordedLayer(const IRECT& r)
+{
+  DoStartLayer(r, true);
+}
+
+void IGraphics::DoStartLayer(const IRECT& r, bool record)
 {
   IRECT alignedBounds = r.GetPixelAligned(GetBackingPixelScale());
   const int w = static_cast<int>(std::ceil(GetBackingPixelScale() * std::ceil(alignedBounds.W())));
   const int h = static_cast<int>(std::ceil(GetBackingPixelScale() * std::ceil(alignedBounds.H())));
+  APIBitmap* pBitmap = record ? CreateRecordingAPIBitmap(w, h, GetScreenScale(), GetDrawScale()) : CreateAPIBitmap(w, h, GetScreenScale(), GetDrawScale());
 
-  PushLayer(new ILayer(CreateAPIBitmap(w, h, GetScreenScale(), GetDrawScale()), alignedBounds));
+  ILayer* pLayer = new ILayer(pBitmap, alignedBounds);
+  pLayer->mAssetGeneration = mAssetGeneration;
+  PushLayer(pLayer);
 }
 
 void IGraphics::ResumeLayer(ILayerPtr& layer)
@@ -1535,6 +2754,14 @@ void IGraphics::PushLayer(ILayer *layer)
   PathClear();
 }
 
+IRECT IGraphics::GetDrawRegion() const
+{
+  if (!mLayers.empty())
+    return mLayers.top()->Bounds();
+
+  return mDrawRegion.Empty() ? GetBounds() : mDrawRegion;
+}
+
 ILayer* IGraphics::PopLayer()
 {
   ILayer* pLayer = nullptr;
@@ -1556,7 +2783,7 @@ ILayer* IGraphics::PopLayer()
 bool IGraphics::CheckLayer(const ILayerPtr& layer)
 {
   const APIBitmap* pBitmap = layer ? layer->GetAPIBitmap() : nullptr;
-  return pBitmap && !layer->mInvalid && pBitmap->GetDrawScale() == GetDrawScale() && pBitmap->GetScale() == GetScreenScale();
+  return pBitmap && !layer->mInvalid && layer->mAssetGeneration == mAssetGeneration && pBitmap->GetDrawScale() == GetDrawScale() && pBitmap->GetScale() == GetScreenScale();
 }
 
 void IGraphics::DrawLayer(const ILayerPtr& layer, const IBlend* pBlend)
@@ -1624,8 +2851,9 @@ void IGraphics::ApplyLayerDropShadow(ILayerPtr& layer, const IShadow& shadow)
     }
   };
   
-  RawBitmapData temp1;
-  RawBitmapData temp2;
+  // the buffers are kept between calls, so shadows redrawn every frame don't reallocate them
+  RawBitmapData& temp1 = mShadowBuffer1;
+  RawBitmapData& temp2 = mShadowBuffer2;
   RawBitmapData kernel;
     
   // Get bitmap in 32-bit form
@@ -1663,15 +2891,53 @@ void IGraphics::ApplyLayerDropShadow(ILayerPtr& layer, const IShadow& shadow)
   uint8_t* inRows = flipped ? asRows + stride3 * (height - 1) : asRows;
   uint8_t* asCols = temp2.Get() + AlphaChannel();
   
-  GaussianBlurSwap(asCols, inRows, kernel.Get(), width, height, stride1, stride2, iSize, normFactor);
-  GaussianBlurSwap(asRows, asCols, kernel.Get(), height, width, stride3, stride1, iSize, normFactor);
+  // Each pass reads whole rows and writes whole columns of its output, so bands of rows can be blurred in parallel
+  ParallelRows(height, [&](int start, int end) {
+    GaussianBlurSwap(asCols + start * 4, inRows + start * stride2, kernel.Get(), width, end - start, stride1, stride2, iSize, normFactor);
+  });
+  ParallelRows(width, [&](int start, int end) {
+    GaussianBlurSwap(asRows + start * 4, asCols + start * stride1, kernel.Get(), height, end - start, stride3, stride1, iSize, normFactor);
+  });
   
   // Apply alphas to the pattern and recombine/replace the image
   ApplyShadowMask(layer, temp1, shadow);
 }
 
+void IGraphics::SetRasterThreads(int nThreads)
+{
+  if (nThreads <= 0)
+    nThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+  if (nThreads == GetRasterThreads())
+    return;
+
+  mRowWorkers.reset(nThreads > 1 ? new IRowWorkerPool(nThreads) : nullptr);
+}
+
+int IGraphics::GetRasterThreads() const
+{
+  return mRowWorkers ? mRowWorkers->NThreads() : 1;
+}
+
+void IGraphics::ParallelRows(int nRows, const std::function<void(int, int)>& func)
+{
+  // Fewer rows than this per thread cost more in synchronisation than they save
+  constexpr int kMinRowsPerThread = 16;
+
+  if (mRowWorkers)
+    mRowWorkers->ParallelFor(nRows, kMinRowsPerThread, func);
+  else
+    func(0, nRows);
+}
+
 bool IGraphics::LoadFont(const char* fontID, const char* fileNameOrResID)
 {
+  if (PlatformFontIsCached(fontID) && LoadCachedAPIFont(fontID))
+  {
+    ClearTextMeasureCache();
+    return true;
+  }
+  
   PlatformFontPtr font = LoadPlatformFont(fontID, fileNameOrResID);
   
   if (font)
@@ -1679,6 +2945,7 @@ bool IGraphics::LoadFont(const char* fontID, const char* fileNameOrResID)
     if (LoadAPIFont(fontID, font))
     {
       CachePlatformFont(fontID, font);
+      ClearTextMeasureCache();
       return true;
     }
   }
@@ -1689,6 +2956,12 @@ bool IGraphics::LoadFont(const char* fontID, const char* fileNameOrResID)
 
 bool IGraphics::LoadFont(const char* fontID, const char* fontName, ETextStyle style)
 {
+  if (PlatformFontIsCached(fontID) && LoadCachedAPIFont(fontID))
+  {
+    ClearTextMeasureCache();
+    return true;
+  }
+  
   PlatformFontPtr font = LoadPlatformFont(fontID, fontName, style);
   
   if (font)
@@ -1696,6 +2969,7 @@ bool IGraphics::LoadFont(const char* fontID, const char* fontName, ETextStyle st
     if (LoadAPIFont(fontID, font))
     {
       CachePlatformFont(fontID, font);
+      ClearTextMeasureCache();
       return true;
     }
   }
@@ -1827,6 +3101,8 @@ void IGraphics::AttachImGui(std::function<void(IGraphics*)> drawFunc, std::funct
   
 #if !defined IGRAPHICS_GL2 && !defined IGRAPHICS_GL3 // TODO: IGRAPHICS_GL!
   CreatePlatformImGui();
+#else
+  RequestFrame();
 #endif
 }
 #endif
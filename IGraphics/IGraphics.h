@@ -54,6 +54,8 @@
 #endif
 
 #include <stack>
+#include <unordered_map>
+#include <vector>
 #include <memory>
 
 #ifdef FillRect
@@ -72,6 +74,10 @@ class IPopupMenuControl;
 class ITextEntryControl;
 class ICornerResizerControl;
 class IFPSDisplayControl;
+class IRowWorkerPool;
+class IAssetLoader;
+class ITextMeasureCache;
+class IShader;
 
 
 /**  The lowest level base class of an IGraphics context */
@@ -111,6 +117,51 @@ public:
    * @param pBlend Optional blend method, see IBlend documentation */
   virtual void DrawRotatedSVG(const ISVG& svg, float destCentreX, float destCentreY, float width, float height, double angle, const IBlend* pBlend = 0) = 0;
 
+  /** Draw an SVG image from a raster of it that is cached for each size and scale, rather than filling its paths on every draw.
+   * Use this for SVGs that are redrawn often at a fixed size, such as knobs and backgrounds. The cache belongs to this graphics context and is cleared when the UI is resized or rescaled
+   * @param svg The SVG image to draw to the graphics context
+   * @param bounds The rectangular region to draw the image in
+   * @param pBlend Optional blend method, see IBlend documentation */
+  void DrawSVGCached(const ISVG& svg, const IRECT& bounds, const IBlend* pBlend = 0);
+
+  /** Draw an SVG image with rotation, by rotating its cached raster, see DrawSVGCached()
+   * @param svg The SVG image to draw to the graphics context
+   * @param destCentreX The X coordinate in the graphics context of the centre point at which to rotate the image around
+   * @param destCentreY The Y coordinate in the graphics context of the centre point at which to rotate the image around
+   * @param width The width of the region to draw the image in
+   * @param height The height of the region to draw the image in
+   * @param angle The angle to rotate the image at in degrees clockwise
+   * @param pBlend Optional blend method, see IBlend documentation */
+  void DrawRotatedSVGCached(const ISVG& svg, float destCentreX, float destCentreY, float width, float height, double angle, const IBlend* pBlend = 0);
+
+  /** Fill a soft shadow of a rounded rectangle from a sprite, which is rendered with ApplyLayerDropShadow() the first time a shadow of the same
+   * size, corners, color and blur is drawn, so that drawing it again costs one bitmap draw. Sprites are cached like the rasters of DrawSVGCached()
+   * @param color The color of the shadow
+   * @param bounds The rectangle that casts the shadow, already offset, which the shadow extends beyond by the blur
+   * @param cRTL The top left corner radius in pixels
+   * @param cRTR The top right corner radius in pixels
+   * @param cRBR The bottom right corner radius in pixels
+   * @param cRBL The bottom left corner radius in pixels
+   * @param blur The blur radius in pixels */
+  void FillRoundRectShadow(const IColor& color, const IRECT& bounds, float cRTL, float cRTR, float cRBR, float cRBL, float blur);
+
+  /** Fill a soft shadow of an ellipse from a cached sprite, see FillRoundRectShadow()
+   * @param color The color of the shadow
+   * @param bounds The bounds of the ellipse that casts the shadow, already offset
+   * @param blur The blur radius in pixels */
+  void FillEllipseShadow(const IColor& color, const IRECT& bounds, float blur);
+
+  /** Fill a soft shadow of a triangle from a cached sprite, see FillRoundRectShadow()
+   * @param color The color of the shadow
+   * @param x1 The X coordinate of the first vertex, already offset
+   * @param y1 The Y coordinate of the first vertex
+   * @param x2 The X coordinate of the second vertex
+   * @param y2 The Y coordinate of the second vertex
+   * @param x3 The X coordinate of the third vertex
+   * @param y3 The Y coordinate of the third vertex
+   * @param blur The blur radius in pixels */
+  void FillTriangleShadow(const IColor& color, float x1, float y1, float x2, float y2, float x3, float y3, float blur);
+
   /** Draw a bitmap (raster) image to the graphics context
    * @param bitmap The bitmap image to draw to the graphics context
    * @param bounds The rectangular region to draw the image in
@@ -134,6 +185,14 @@ public:
    * @param pBlend Optional blend method, see IBlend documentation */
   virtual void DrawRotatedBitmap(const IBitmap& bitmap, float destCentreX, float destCentreY, double angle, int yOffsetZeroDeg = 0, const IBlend* pBlend = 0) = 0;
 
+  /** Run a fragment shader for every pixel of a rectangle, see IShader. The OpenGL NanoVG backends run it on the GPU, the others, or a shader
+   * that doesn't compile, draw its CPUFunc into a bitmap which is only redrawn when the shader's data or the size change
+   * @param shader The shader, which keeps what it is drawn with between calls
+   * @param bounds The rectangular region to draw the shader in
+   * @param pBlend Optional blend method, see IBlend documentation
+   * @return \c false if nothing could be drawn, because the shader can't run and has no CPUFunc */
+  virtual bool DrawShader(IShader& shader, const IRECT& bounds, const IBlend* pBlend = 0);
+
   /** Fill a rectangle corresponding to a pixel on a 1:1 screen with a color
    * @param color The color to fill the point with
    * @param x The X coordinate in the graphics context at which to draw
@@ -342,12 +401,20 @@ public:
    * @param y The y position in the graphics where you would like to draw the text */
   void DrawText(const IText& text, const char* str, float x, float y, const IBlend* pBlend = 0);
   
-  /** Measure the rectangular region that some text will occupy
+  /** Measure the rectangular region that some text will occupy. Level text is measured by the backend once, and then found in an LRU cache
+   * until a font is loaded or the scale changes
    * @param text An IText struct containing font and text properties and layout info
    * @param str The text string to draw in the graphics context
    * @param bounds after calling the method this IRECT will be updated with the rectangular region the text will occupy */
   virtual void MeasureText(const IText& text, const char* str, IRECT& bounds) const;
 
+  /** Render the glyphs of a font and size ahead of time, on backends that keep a glyph atlas (NanoVG), so that the first frames that show them,
+   * e.g. a changing value readout, do not have to rasterize glyphs or grow the atlas. Call it when laying out the UI, with the IText of text that changes often.
+   * Other backends ignore it
+   * @param text The font and size to render
+   * @param chars The characters to render, or nullptr for printable ASCII */
+  virtual void PrepareGlyphs(const IText& text, const char* chars = nullptr) {}
+
   /** Get the color of a point in the graphics context. On a 1:1 screen this corresponds to a pixel. \todo check this
    * @param x The X coordinate in the graphics context of the pixel
    * @param y The Y coordinate in the graphics context of the pixel
@@ -487,11 +554,21 @@ public:
   /** /todo 
    * @param r /todo*/
   void StartLayer(const IRECT& r);
+
+  /** Start a layer that will only be drawn with DrawLayer(), such as a cache of a control's drawing. On Skia the draw commands are recorded
+   * and replayed rather than rendered to pixels. A recorded layer cannot be resumed, read back, or given a drop shadow
+   * @param r The bounds of the layer */
+  void StartRecordedLayer(const IRECT& r);
   
   /** /todo
    * @param layer /todo*/
   void ResumeLayer(ILayerPtr& layer);
 
+  /** @return The area being drawn. In IControl::Draw() this is the part of the control within the dirty rect being drawn, or the bounds of the layer
+   * being drawn into. Drawing is clipped to it, so a control made of many parts, such as a multi-slider, can skip the parts outside it.
+   * It is in untransformed coordinates */
+  IRECT GetDrawRegion() const;
+
   /** /todo
    * @return ILayerPtr /todo */
   ILayerPtr EndLayer();
@@ -517,10 +594,18 @@ public:
    * @param angle /todo */
   void DrawRotatedLayer(const ILayerPtr& layer, double angle);
     
-  /** Applies a dropshadow directly onto a layer
+  /** Applies a dropshadow directly onto a layer. The layer is read back and blurred on the CPU, except on NanoVG, which blurs it on the GPU
   * @param layer - the layer to add the shadow to 
   * @param shadow - the shadow to add */
-  void ApplyLayerDropShadow(ILayerPtr& layer, const IShadow& shadow);
+  virtual void ApplyLayerDropShadow(ILayerPtr& layer, const IShadow& shadow);
+
+  /** Spread the CPU pixel work of drawing over several threads: blurring layer drop shadows on the CPU backends, and applying the shadow
+   * mask on LICE. This is worth enabling for software-rendered UIs on large or high resolution displays
+   * @param nThreads The number of threads including the UI thread, 1 (the default) to do the work on the UI thread only, or 0 for one per CPU core */
+  void SetRasterThreads(int nThreads);
+
+  /** @return The number of threads used for pixel work, see SetRasterThreads() */
+  int GetRasterThreads() const;
     
   /** /todo */
   virtual void UpdateLayer() {}
@@ -530,6 +615,14 @@ public:
    * @param data /todo */
   virtual void GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& data) = 0;
   
+  /** Copy a region of the frame that was last drawn, for backends that draw into memory. Call this from an IFrameDrawnFunc
+   * @param bounds The region in UI coordinates
+   * @param data Filled with 8-bit RGBA pixels, a row at a time
+   * @param width Set to the width of the copied region in pixels, which is the width of bounds scaled by the screen scale
+   * @param height Set to the height of the copied region in pixels
+   * @return \c false if the backend can't read back its frame */
+  virtual bool GetFramePixels(const IRECT& bounds, RawBitmapData& data, int& width, int& height) { return false; }
+  
   /** /todo
    * @param layer /todo
    * @param mask /todo
@@ -854,6 +947,11 @@ public:
    * @param font A const PlatformFontPtr reference to the relevant font */
   virtual void CachePlatformFont(const char* fontID, const PlatformFontPtr& font) = 0;
 
+  /** Platform font caches are shared by every IGraphics instance, so a font that another editor has loaded needn't be loaded again
+   * @param fontID A string that is used to reference the font
+   * @return \c true if the platform has cached what it needs for fontID, or needs nothing cached */
+  virtual bool PlatformFontIsCached(const char* fontID) { return false; }
+
   /** Get the bundle ID on macOS and iOS, returns emtpy string on other OSs */
   virtual const char* GetBundleID() { return ""; }
   
@@ -888,14 +986,24 @@ public:
   void SetTranslation(float x, float y) { mXTranslation = x; mYTranslation = y; }
   
   /** Called repeatedly at frame rate by the platform class to check what the graphics context says is dirty.
+   * Only the controls that have queued themselves, with SetDirty(), an animation, or IControl::SetPollDirty(), are asked, so an idle frame costs nothing per control
    * @param rects The rectangular regions which will be added to to mark what is dirty in the context
    * @return /c true if a control is dirty */
   bool IsDirty(IRECTList& rects);
 
+  /** The clock that animations run on, read once at the start of each frame, so that every control animating in a frame sees the same time
+   * and nothing reads the system clock per control, see IControl::GetAnimationProgress()
+   * @return The time of the current frame */
+  TimePoint GetFrameTime() const { return mFrameTime; }
+
   /** Called by the platform class indicating a number of rectangles in the UI that need to redraw
    * @param rects A set of rectangular regions to draw */
   void Draw(IRECTList& rects);
 
+  /** Called by platform classes whose drawable doesn't keep its contents, e.g. a layer-backed view that the system has asked to redisplay.
+   * GPU backends draw into a surface that is retained between frames, so the last frame is presented again without drawing any controls */
+  void PresentLastFrame();
+
   /** Prompt for user input either using a text entry or pop up menu
    * @param control Reference to the control which the prompt relates to
    * @param bounds Rectangular region of the graphics context that the prompt (e.g. text entry box) should occupy
@@ -1033,6 +1141,25 @@ public:
   /** @param enable Set \c true if you wish to show the rectangular region that is drawn on each frame, in order to debug redraw problems */
   inline void ShowAreaDrawn(bool enable) { mShowAreaDrawn = enable; if(!enable) SetAllControlsDirty(); }
   
+  /** Time each control's Draw() method and show a heatmap over the controls, from green for the cheapest to red for the most expensive, with a list of the slowest ones.
+   * The whole UI is redrawn on every frame while this is enabled. With GPU backends, only the time taken to issue the drawing commands is measured
+   * @param enable Set \c true to show the overlay, this also resets the statistics
+   * @param sortByPeak Set \c true to sort the list by the longest single draw, rather than the average */
+  void ShowControlDrawTimes(bool enable, bool sortByPeak = false);
+
+  /**@return \c true if showing the per control draw times */
+  bool ShowControlDrawTimesEnabled() const { return mShowControlDrawTimes; }
+
+  /** Get the controls sorted by how long they take to draw, slowest first. Times are only measured while ShowControlDrawTimes() is enabled
+   * @param list Filled with the controls
+   * @param sortByPeak Set \c true to sort by the longest single draw, rather than the average */
+  void GetControlsByDrawTime(WDL_PtrList<IControl>& list, bool sortByPeak = false);
+
+  /** Add this UI's memory to a report: its share of the bitmap and SVG caches that all instances share, an estimate of the backing store, and in
+   * drawing backends that override this, fonts and textures. IGEditorDelegate::GetMemoryReport() calls this while the UI is open
+   * @param report The report to add to */
+  virtual void GetMemoryReport(IMemoryReport& report) const;
+
   /**@return \c true if showning the area drawn on each frame */
   bool ShowAreaDrawnEnabled() const { return mShowAreaDrawn; }
   
@@ -1056,6 +1183,10 @@ public:
   /** /todo
    * @param keyHandlerFunc /todo */
   void SetKeyHandlerFunc(IKeyHandlerFunc func) { mKeyHandlerFunc = func; }
+  
+  /** Set a function to be called after each frame has been drawn, with the regions that were drawn, e.g. to mirror them with GetFramePixels()
+   * @param func The function, or nullptr to remove it */
+  void SetFrameDrawnFunc(IFrameDrawnFunc func) { mFrameDrawnFunc = func; }
 
   /** A helper to set the IGraphics KeyHandlerFunc in order to make an instrument playable via QWERTY keys
    * @param func A function to do something when a MIDI message is triggered */
@@ -1071,6 +1202,10 @@ public:
 private:
   /* /todo */
   virtual void CreatePlatformImGui() {}
+
+  /** Called on the UI thread when IsDirty() has new work after NeedsFrames() was \c false, e.g. a control was marked dirty while nothing else
+   * was queued. Platforms whose frame clock stops while the UI is idle override this to restart it */
+  virtual void RequestFrame() {}
   
   /** /todo */
   virtual void PlatformResize(bool parentHasResized) {}
@@ -1088,6 +1223,9 @@ private:
    * @param bounds /todo
    * @param scale /todo */
   void DrawControl(IControl* pControl, const IRECT& bounds, float scale);
+
+  /** Draws the ShowControlDrawTimes() overlay on top of everything else */
+  void DrawControlDrawTimes();
   
   /** Shows a pop up/contextual menu in relation to a rectangular region of the graphics context
    * @param control A reference to the IControl creating this pop-up menu. If it exists IControl::OnPopupMenuSelection() will be called on successful selection
@@ -1129,15 +1267,29 @@ public:
   template<typename T, typename... Args>
   void ForMatchingControls(T method, int paramIdx, Args... args);
 
-  /** /todo
-   * @param paramIdx /todo
-   * @param func /todo */
+  /** Call a function on every control linked to a parameter, once per control, looked up in the control index (see InvalidateControlIndex())
+   * @param paramIdx The parameter index
+   * @param func The function to call on each control */
   void ForControlWithParam(int paramIdx, std::function<void(IControl& control)> func);
+
+  /** Call a function on every value of every control that is linked to a parameter, looked up in the control index (see InvalidateControlIndex())
+   * @param paramIdx The parameter index
+   * @param func The function to call with each control and the index of its value that is linked to the parameter */
+  void ForControlValueWithParam(int paramIdx, std::function<void(IControl& control, int valIdx)> func);
+
+  /** Call a function on every control that wants MIDI, see IControl::SetWantsMidi()
+   * @param func The function to call on each control */
+  void ForControlWantingMidi(std::function<void(IControl& control)> func);
   
-  /** \todo
-   * @param group /todo
-   * @param func /todo */
+  /** Call a function on every control in a group. A group registered with AttachDeferredGroup() is built first, so func sees its controls
+   * @param group The name of the group
+   * @param func The function to call on each control */
   void ForControlInGroup(const char* group, std::function<void(IControl& control)> func);
+
+  /** Hide or show every control in a group. A group registered with AttachDeferredGroup() is built when it is first shown
+   * @param group The name of the group
+   * @param hide \c true to hide */
+  void HideGroup(const char* group, bool hide);
   
   /** Attach an IBitmapControl as the lowest IControl in the control stack to be the background for the graphics context
    * @param fileName CString fileName resource id for the bitmap image \todo check this */
@@ -1178,6 +1330,25 @@ public:
    * @return The index of the control (and the number of controls in the stack) */
   IControl* AttachControl(IControl* pControl, int controlTag = kNoTag, const char* group = "");
 
+  /** Register a group of controls to be built when it is first needed rather than by the layout function, so that hidden pages and tabs
+   * don't hold up the editor's first paint. The group is built by ForControlInGroup(), HideGroup(), BuildDeferredGroup() or, with preWarm,
+   * one group per frame once the editor has painted. Its controls are placed in the control stack where this was called, so they stack as
+   * if they had been attached here, are given the group's name if they have no group, start hidden and are set to the current parameter values.
+   * Until then GetControlWithTag() can't find them. Registrations are forgotten by RemoveAllControls()
+   * @param group The name of the group
+   * @param buildFunc Called on the UI thread to attach the group's controls with AttachControl()
+   * @param preWarm \c true to build the group while the editor is open but not showing it, so that showing it is instant */
+  void AttachDeferredGroup(const char* group, std::function<void(IGraphics* pGraphics)> buildFunc, bool preWarm = false);
+
+  /** Build a group registered with AttachDeferredGroup() now, if it hasn't been built yet
+   * @param group The name of the group
+   * @return \c true if the group was built by this call */
+  bool BuildDeferredGroup(const char* group);
+
+  /** @param group The name of the group
+   * @return \c true if the group was registered with AttachDeferredGroup() and hasn't been built yet */
+  bool IsGroupDeferred(const char* group) const;
+
   /** @param idx The index of the control to get
    * @return A pointer to the IControl object at idx or nullptr if not found */
   IControl* GetControl(int idx) { return mControls.Get(idx); }
@@ -1230,9 +1401,34 @@ public:
   /** Calls SetDirty() on every control */
   void SetAllControlsDirty();
   
-  /** Calls SetClean() on every control */
+  /** Calls SetClean() on every control that the last IsDirty() found dirty. The platform classes call this after IsDirty(), before drawing */
   void SetAllControlsClean();
 
+  /** Used internally by IControl::QueueDirty(), to have IsDirty() ask the control on the next frame */
+  void AddDirtyControl(IControl* pControl);
+
+  /** Called by the platform classes when the window is minimized, hidden or moved to another desktop, and again when it can be seen.
+   * While occluded NeedsFrames() is \c false, so the frame clock stops, and the delegate is told via IEditorDelegate::OnUIOcclusionChanged()
+   * @param occluded \c true if the user can't see the window */
+  void SetOccluded(bool occluded);
+
+  /** @return \c true if the platform has reported that the window can't be seen, see SetOccluded() */
+  bool IsOccluded() const { return mOccluded; }
+
+  /** @return \c true if IsDirty() has work to do on the next display refresh: a control is queued, polling or animating, or the draw time
+   * heatmap, an ImGui overlay or idle calls need every frame. Platforms may stop their frame clock while this is \c false, see RequestFrame() */
+  bool NeedsFrames() const;
+
+  /** Used internally by the IControl destructor, to forget a control that is being deleted */
+  void RemoveDirtyControl(IControl* pControl);
+
+  /** Handle a mouse drag, what OnMouseDrag() does unless it is coalescing */
+  void DispatchMouseDrag(float x, float y, float dX, float dY, const IMouseMod& mod);
+
+  /** Handle a mouse over, what OnMouseOver() does unless it is coalescing
+   * @return \c true if the mouse is over a control */
+  bool DispatchMouseOver(float x, float y, const IMouseMod& mod);
+
 private:
   /** /todo
    * @param x /todo
@@ -1324,6 +1520,21 @@ public:
   /** @return \c true if the context can handle mouse overs */
   bool CanHandleMouseOver() const { return mHandleMouseOver; }
 
+  /** Mouse events are hit-tested against a uniform grid of the controls' bounds, so that only the controls near the mouse are asked IsHit(),
+   * and each dirty region is only drawn with the controls in the grid cells it overlaps. This assumes IsHit() is never \c true, and
+   * Draw() never draws, outside the union of a control's draw and target areas. On by default
+   * @param enable \c false to test and draw every control instead */
+  void EnableHitTestGrid(bool enable) { mHitGridEnabled = enable; InvalidateHitTestGrid(); }
+
+  /** The grid is rebuilt on the next mouse event or draw. Adding and removing controls, resizing the UI, and the IControl methods that set its bounds or hide it
+   * call this for you. Call it yourself if a control assigns mRECT or mTargetRECT directly after it has been attached */
+  void InvalidateHitTestGrid() { mHitGridDirty = true; }
+
+  /** Parameter updates, GetControlWithTag() and MIDI are routed through maps from parameters, tags and the MIDI flag to the controls, so that
+   * they cost the number of controls they reach rather than the number of controls. The maps are rebuilt on their next use. Adding, removing
+   * and building controls, and the IControl methods that set the parameters, tag and MIDI flag call this for you */
+  void InvalidateControlIndex() { mControlIndexDirty = true; }
+
   /** @return An integer representing the control index in IGraphics::mControls which the mouse is over, or -1 if it is not */
   inline int GetMouseOver() const { return mMouseOverIdx; }
 
@@ -1335,6 +1546,23 @@ public:
   /**  Set by the platform class if the mouse input is coming from a tablet/stylus
    * @param tablet \c true means input is from a tablet */
   void SetTabletInput(bool tablet) { mTabletInput = tablet; }
+
+  /** High polling rate mice and pens send many more drag and move events than there are frames, and each one is hit-tested and handled
+   * by the controls. With coalescing on, OnMouseDrag() and OnMouseOver() only record the event, and on the next frame the controls get one
+   * drag with the deltas summed and one mouse over at the latest position. Any other input sends the held events first, so the order is kept.
+   * A control that wants every position, e.g. a drawing surface, can read GetCoalescedMouseEvents() in IControl::OnMouseDrag(). Off by default
+   * @param enable \c true to coalesce mouse drags and mouse overs to one per frame */
+  void SetCoalesceMouseInput(bool enable);
+
+  /** @return \c true if mouse drags and mouse overs are coalesced, see SetCoalesceMouseInput() */
+  bool GetCoalesceMouseInput() const { return mCoalesceMouseInput; }
+
+  /** @return The positions of the drag events coalesced into the current IControl::OnMouseDrag() call, oldest first, the last being the position
+   * passed to it. Empty if the drag was not coalesced */
+  const std::vector<IMouseInfo>& GetCoalescedMouseEvents() const { return mCoalescedDragsSent; }
+
+  /** Send the held mouse drag and mouse over to the controls. Called at the start of IsDirty() and before any other input is handled */
+  void FlushCoalescedMouseInput();
 #pragma mark - Plug-in API Specific
 
   /** [AAX only] This can be called by the ProTools API class (e.g. IPlugAAX) in order to ascertain the parameter linked to the control under the mouse.
@@ -1379,12 +1607,87 @@ public:
    * @return An IBitmap representing the image */
   virtual IBitmap LoadBitmap(const char* fileNameOrResID, int nStates = 1, bool framesAreHorizontal = false, int targetScale = 0);
 
+  /** Generate mipmaps, successively halved copies of each bitmap, when it is loaded, so that bitmaps drawn smaller than their size (e.g. with
+   * DrawFittedBitmap() or in a zoomed out editor) are sampled from a copy near the drawn size, which is faster and doesn't alias.
+   * NanoVG creates textures with mip levels, LICE and Cairo keep downscaled copies with the bitmap. This costs a third more memory per bitmap.
+   * Bitmaps are cached and shared, so this applies to bitmaps loaded after it is called; call it before loading any, e.g. at the start of the layout function
+   * @param enable Set \c true to generate mipmaps */
+  void SetBitmapMipmaps(bool enable) { mBitmapMipmaps = enable; }
+
+  /** @return \c true if bitmaps are loaded with mipmaps, see SetBitmapMipmaps() */
+  bool GetBitmapMipmaps() const { return mBitmapMipmaps; }
+
   /** Load an SVG from disk or from windows resource
    * @param fileNameOrResID A CString absolute path or resource ID
    * @return An ISVG representing the image */
   virtual ISVG LoadSVG(const char* fileNameOrResID, const char* units = "px", float dpi = 72.f);
+
+  /** Load a resource pack made by Scripts/resource_pack/MakeResourcePack (see IResourcePack), after which LoadBitmap() and LoadSVG() take
+   * the bitmaps and SVGs that are in it from the pack instead of decoding their files. The pack is shared by every editor in the process and
+   * stays mapped until it exits, so calling this again with the same pack does nothing and only one pack can be loaded. Call it before loading any bitmaps or SVGs, e.g. at the
+   * start of the layout function
+   * @param fileNameOrResID CString file name or resource ID of the pack, with the type "pack"
+   * @return \c true if the pack is loaded */
+  bool LoadResourcePack(const char* fileNameOrResID);
+
+  /** Load a bitmap without waiting for it to be decoded, so that OnLayout() is not held up by large images. The IBitmap has its final size straight away
+   * and draws as transparent until the pixels arrive, when every control is marked dirty and every layer is redrawn.
+   * NanoVG decodes PNG and JPEG files on a background thread and uploads the texture at the start of the next frame. Other backends load synchronously, like LoadBitmap()
+   * @param fileNameOrResID CString file name or resource ID
+   * @param nStates The number of states/frames in a multi-frame stacked bitmap
+   * @param framesAreHorizontal Set \c true if the frames in a bitmap are stacked horizontally
+   * @param targetScale Set \c to a number > 0 to explicity load e.g. an @2x.png
+   * @return An IBitmap representing the image */
+  virtual IBitmap LoadBitmapAsync(const char* fileNameOrResID, int nStates = 1, bool framesAreHorizontal = false, int targetScale = 0)
+  {
+    return LoadBitmap(fileNameOrResID, nStates, framesAreHorizontal, targetScale);
+  }
+
+  /** Load an SVG without waiting for it to be parsed, which happens on a background thread. Until then the ISVG is empty (W() and H() are 0 and
+   * it draws nothing), and when it arrives every control is marked dirty and every layer is redrawn
+   * @param fileNameOrResID A CString absolute path or resource ID
+   * @return An ISVG representing the image */
+  ISVG LoadSVGAsync(const char* fileNameOrResID, const char* units = "px", float dpi = 72.f);
+
+  /** Block until every asset loading with LoadBitmapAsync() or LoadSVGAsync() has arrived, e.g. before taking a screenshot of the UI */
+  void WaitForAsyncAssets();
+
+  /** Run work on a background thread, then finish on the main thread at the start of a later IsDirty(), e.g. for a control to compute something
+   * expensive without holding up drawing. Unlike the async asset loads nothing else is redrawn, so finish should mark whatever it changes dirty.
+   * work must only touch its own data. On the web, where there are no threads, both are called straight away
+   * @param work The function to call on the background thread
+   * @param finish The function to call on the main thread once work has returned */
+  void RunInBackground(std::function<void()> work, std::function<void()> finish);
   
 protected:
+  /** Run load on the asset loader thread, then finish on the main thread at the start of a later IsDirty(), after which every control is marked dirty.
+   * load must only touch its own data. Used by LoadSVGAsync() and by the drawing backends' LoadBitmapAsync()
+   * @param load The function that does the slow part of loading
+   * @param finish The function that hands the result over */
+  void LoadAsync(std::function<void()> load, std::function<void()> finish);
+
+  /** Delete the rasters cached by DrawSVGCached() and the shadow sprites cached by FillRoundRectShadow() etc. GPU backends call this before their context goes away */
+  void ClearSVGRasterCache();
+
+  /** Forget the bounds cached by MeasureText(), e.g. when a backend's fonts change other than through LoadFont() */
+  void ClearTextMeasureCache();
+
+private:
+  void OnAsyncAssetsLoaded();
+
+  /** @return The cached raster of svg drawn at a size, which is created if needed */
+  APIBitmap* GetSVGRaster(const ISVG& svg, float width, float height);
+
+  static constexpr int kMaxSVGRasters = 64; // the cache is emptied when it reaches this many rasters, e.g. during a resize drag
+
+  /** Draw a shadow sprite, rendering it with drawShape the first time
+   * @param key What the sprite depends on other than its color, size, blur and scale */
+  void DrawShadowSprite(const char* key, const IColor& color, const IRECT& bounds, float blur, const std::function<void(const IRECT& bounds)>& drawShape);
+
+  static constexpr int kMaxShadowSprites = 64; // the cache is emptied when it reaches this many sprites
+
+protected:
+
   /** /todo
    * @param fileNameOrResID /todo 
    * @param scale /todo
@@ -1401,12 +1704,48 @@ protected:
    * @return APIBitmap* /todo */
   virtual APIBitmap* CreateAPIBitmap(int width, int height, int scale, double drawScale) = 0;
 
+  /** Create the bitmap for StartRecordedLayer(). Backends that can record draw commands override this to record them, the default renders pixels
+   * @param width The width in pixels
+   * @param height The height in pixels
+   * @param scale The screen scale
+   * @param drawScale The draw scale
+   * @return APIBitmap* The new bitmap */
+  virtual APIBitmap* CreateRecordingAPIBitmap(int width, int height, int scale, double drawScale) { return CreateAPIBitmap(width, height, scale, drawScale); }
+
+  /** Create a bitmap from pixels that are already decoded, used for bitmaps in a resource pack. Backends that don't override this load the
+   * bitmap's file instead
+   * @param pRGBA width * height 8-bit RGBA pixels that are not premultiplied, top row first, which must stay valid for the life of the bitmap
+   * @param width The width in pixels
+   * @param height The height in pixels
+   * @param scale The scale of the bitmap
+   * @return APIBitmap* The new bitmap, or nullptr if the backend can't create one */
+  virtual APIBitmap* CreateAPIBitmapFromPixels(const uint8_t* pRGBA, int width, int height, int scale) { return nullptr; }
+
+  /** Search the resource pack for a bitmap, see LoadResourcePack()
+   * @param fileName The file name the bitmap is loaded with
+   * @param targetScale The scale wanted
+   * @param sourceScale Set to the scale of the bitmap in the pack, which is targetScale if the pack has it and otherwise the largest
+   * @return \c true if the bitmap is in the pack */
+  bool SearchPackedBitmap(const char* fileName, int targetScale, int& sourceScale);
+
+  /** Create a bitmap from the resource pack with CreateAPIBitmapFromPixels()
+   * @param fileName The file name the bitmap is loaded with
+   * @param scale A scale found with SearchPackedBitmap()
+   * @return APIBitmap* The new bitmap, or nullptr if it isn't in the pack or the backend can't create it */
+  APIBitmap* LoadPackedAPIBitmap(const char* fileName, int scale);
+
   /** /todo
    * @param fontID /todo
    * @param font /todo
    * @return bool* /todo */
   virtual bool LoadAPIFont(const char* fontID, const PlatformFontPtr& font) = 0;
 
+  /** Make a font available to this context from the drawing API's process-wide font cache, without the platform font, when another
+   * instance has already loaded it. LoadFont() tries this first, so that opening another editor doesn't locate and decode its fonts again
+   * @param fontID A string that is used to reference the font
+   * @return \c true if the font was in the cache and is ready to use */
+  virtual bool LoadCachedAPIFont(const char* fontID) { return false; }
+
   /** /todo */
   virtual bool AssetsLoaded() { return true; }
     
@@ -1437,6 +1776,12 @@ protected:
    * @return  pointer to the bitmap in the cache,  or null pointer if not found */
   APIBitmap* SearchBitmapInCache(const char* fileName, int targetScale, int& sourceScale);
 
+  /** Resamples the bitmaps cached at the current screen scale to another scale, or loads its @Nx resources, so that a later
+   * SetScreenScale() to that scale finds them in the cache. Platforms call this for the scales of the other displays, with the
+   * drawing context current, so that moving the window between displays doesn't resample on the UI thread during the move
+   * @param scale The screen scale to cache the bitmaps at */
+  void PrescaleBitmaps(int scale);
+
   /** /todo
    * @param text /todo
    * @param str /todo
@@ -1477,9 +1822,59 @@ private:
     mMouseOver = nullptr;
     mMouseOverIdx = -1;
   }
+
+  /** @return The indices of the controls whose bounds overlap the grid cell containing x, y in ascending (back to front) order, or
+   * nullptr if the grid is disabled or the point is outside it. Rebuilds the grid if it is out of date */
+  const std::vector<int>* GetHitTestCandidates(float x, float y);
+  void RebuildHitTestGrid();
+
+  /** @return The indices of the controls whose bounds overlap the grid cells that \p bounds covers in ascending (back to front) order, or
+   * nullptr if the grid is disabled or \p bounds covers all of it, in which case every control should be drawn */
+  const std::vector<int>* GetDrawCandidates(const IRECT& bounds);
+
+  void RebuildControlIndex();
+
+  static constexpr float kHitGridCellSize = 32.f;
+  static constexpr float kHitGridPadding = 3.f;
   
   WDL_PtrList<IControl> mControls;
 
+  // see AttachDeferredGroup(), removed once built
+  struct DeferredGroup
+  {
+    WDL_String mName;
+    std::function<void(IGraphics* pGraphics)> mBuildFunc;
+    int mInsertIdx;
+    bool mPreWarm;
+  };
+
+  std::vector<DeferredGroup> mDeferredGroups;
+  bool mFrameDrawn = false; // pre-warming waits for the first paint
+
+  // the controls to ask IsDirty() on the next frame, the ones being asked, and the ones found dirty that SetAllControlsClean() will clean
+  std::vector<IControl*> mDirtyControls;
+  std::vector<IControl*> mCheckingControls;
+  std::vector<IControl*> mDrawnControls;
+
+  // see EnableHitTestGrid()
+  std::vector<std::vector<int>> mHitGridCells;
+  int mHitGridCols = 0;
+  int mHitGridRows = 0;
+  bool mHitGridEnabled = true;
+  bool mHitGridDirty = true;
+  std::vector<int> mDrawCandidates;
+  std::vector<bool> mDrawCandidateFlags;
+
+  // the fields the grid scans read, per control in index order and refreshed with the grid, so candidates can be skipped without touching the controls
+  std::vector<IRECT> mControlBounds; // the padded bounds clipped to the containers, empty if the control is not in the grid
+  std::vector<uint8_t> mControlHidden; // hidden, or hidden by a container
+
+  // see InvalidateControlIndex(), each in stack order: the values linked to each parameter, the first control with each tag and the controls that want MIDI
+  std::unordered_map<int, std::vector<std::pair<IControl*, int>>> mParamControls;
+  std::unordered_map<int, IControl*> mTagControls;
+  std::vector<IControl*> mMidiControls;
+  bool mControlIndexDirty = true;
+
   // Order (front-to-back) ToolTip / PopUp / TextEntry / LiveEdit / Corner / PerfDisplay
   std::unique_ptr<ICornerResizerControl> mCornerResizer;
   std::unique_ptr<IPopupMenuControl> mPopupControl;
@@ -1519,27 +1914,60 @@ private:
   bool mEnableTooltips = false;
   bool mShowControlBounds = false;
   bool mShowAreaDrawn = false;
+  bool mShowControlDrawTimes = false;
+  bool mOccluded = false;
+  bool mSortDrawTimesByPeak = false;
   bool mResizingInProcess = false;
   bool mLayoutOnResize = false;
   EUIResizerMode mGUISizeMode = EUIResizerMode::Scale;
   double mPrevTimestamp = 0.;
+  TimePoint mFrameTime = std::chrono::high_resolution_clock::now();
   IKeyHandlerFunc mKeyHandlerFunc = nullptr;
+  IFrameDrawnFunc mFrameDrawnFunc = nullptr;
 protected:
   IGEditorDelegate* mDelegate;
   void* mPlatformContext = nullptr;
   bool mCursorHidden = false;
   bool mCursorLock = false;
   bool mTabletInput = false;
+  bool mBitmapMipmaps = false;
+  // mouse input held for the next frame, see SetCoalesceMouseInput()
+  bool mCoalesceMouseInput = false;
+  bool mMouseOverPending = false;
+  IMouseInfo mPendingMouseOver;
+  float mPendingDragDX = 0.f;
+  float mPendingDragDY = 0.f;
+  std::vector<IMouseInfo> mCoalescedDrags; // the drags held, oldest first
+  std::vector<IMouseInfo> mCoalescedDragsSent; // the drags being sent, see GetCoalescedMouseEvents()
   float mCursorX = -1.f;
   float mCursorY = -1.f;
   float mXTranslation = 0.f;
   float mYTranslation = 0.f;
+  IRECTList mFrameRects; // The pixel aligned regions drawn in the current frame, for EndFrame() to present
   
   friend class IGraphicsLiveEdit;
   friend class ICornerResizerControl;
   friend class ITextEntryControl;
 
   std::stack<ILayer*> mLayers;
+  IRECT mDrawRegion; // see GetDrawRegion(), empty outside DrawControl()
+
+  /** Call func(startRow, endRow) for bands of rows covering [0, nRows), on the threads set with SetRasterThreads(). Each band must only write to its own rows
+   * @param nRows The number of rows
+   * @param func The function to call for each band */
+  void ParallelRows(int nRows, const std::function<void(int, int)>& func);
+
+  void DoStartLayer(const IRECT& r, bool record);
+
+  std::unique_ptr<IRowWorkerPool> mRowWorkers;
+  RawBitmapData mShadowBuffer1; // reused by ApplyLayerDropShadow()
+  RawBitmapData mShadowBuffer2;
+  std::unique_ptr<IAssetLoader> mAssetLoader;
+  mutable std::unique_ptr<ITextMeasureCache> mTextMeasureCache; // see MeasureText(), created by the first measurement
+  std::unique_ptr<IAssetLoader> mBackgroundJobs; // see RunInBackground(), apart from mAssetLoader so that finishing a job doesn't redraw everything
+  mutable StaticStorage<APIBitmap> mSVGRasterCache; // not actually static, since rasters may be textures linked to a context
+  mutable StaticStorage<APIBitmap> mShadowSpriteCache; // see FillRoundRectShadow()
+  int mAssetGeneration = 0; // counts arrivals of async assets, so that CheckLayer() fails for layers drawn before
   
 #ifdef IGRAPHICS_IMGUI
 public:
@@ -0,0 +1,153 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IAssetLoader
+ */
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "IPlugPlatform.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** A background thread that loads assets for IGraphics::LoadSVGAsync() and IGraphics::LoadBitmapAsync(), and runs the jobs of IGraphics::RunInBackground().
+ * Each job has a load function, which runs on the loader thread and must only touch the job's own data, and a finish function,
+ * which runs on the main thread from ProcessFinished() and hands the result over. The thread is started by the first job */
+class IAssetLoader final
+{
+public:
+  IAssetLoader() {}
+
+  ~IAssetLoader()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mQuit = true;
+    }
+
+    mCondition.notify_all();
+
+    if (mThread.joinable())
+      mThread.join();
+  }
+
+  IAssetLoader(const IAssetLoader&) = delete;
+  IAssetLoader& operator=(const IAssetLoader&) = delete;
+
+  /** Queue a job, from the main thread
+   * @param load The function to call on the loader thread
+   * @param finish The function to call on the main thread once load has returned */
+  void Add(std::function<void()> load, std::function<void()> finish)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mQueue.push_back({ std::move(load), std::move(finish) });
+      mNPending++;
+    }
+
+    if (!mThread.joinable())
+      mThread = std::thread([this]() { ThreadLoop(); });
+
+    mCondition.notify_one();
+  }
+
+  /** Call the finish functions of the jobs that have loaded, from the main thread
+   * @return The number of jobs finished */
+  int ProcessFinished()
+  {
+    std::vector<Job> finished;
+
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      finished.swap(mFinished);
+    }
+
+    for (auto& job : finished)
+      job.mFinish();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mNPending -= static_cast<int>(finished.size());
+    return static_cast<int>(finished.size());
+  }
+
+  /** Block until every queued job has loaded, then call ProcessFinished()
+   * @return The number of jobs finished */
+  int WaitAll()
+  {
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mDoneCondition.wait(lock, [this]() { return mQueue.empty() && !mLoading; });
+    }
+
+    return ProcessFinished();
+  }
+
+  /** @return \c true if any job is queued, loading, or waiting for ProcessFinished() */
+  bool HasPending() const
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mNPending > 0;
+  }
+
+private:
+  struct Job
+  {
+    std::function<void()> mLoad;
+    std::function<void()> mFinish;
+  };
+
+  void ThreadLoop()
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (true)
+    {
+      mCondition.wait(lock, [this]() { return mQuit || !mQueue.empty(); });
+
+      if (mQuit)
+        return;
+
+      Job job = std::move(mQueue.front());
+      mQueue.pop_front();
+      mLoading = true;
+
+      lock.unlock();
+      job.mLoad();
+      lock.lock();
+
+      mLoading = false;
+      mFinished.push_back(std::move(job));
+      mDoneCondition.notify_all();
+    }
+  }
+
+  std::thread mThread;
+  mutable std::mutex mMutex;
+  std::condition_variable mCondition;
+  std::condition_variable mDoneCondition;
+  std::deque<Job> mQueue;
+  std::vector<Job> mFinished;
+  int mNPending = 0;
+  bool mLoading = false;
+  bool mQuit = false;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
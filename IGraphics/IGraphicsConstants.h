@@ -80,6 +80,9 @@ enum class EFileAction { Open, Save };
 /** /todo */
 enum class EDirection { Vertical, Horizontal };
 
+/** Used to choose whether IGraphics caches a control's drawing in a layer, see IControl::SetCacheMode() */
+enum class ECacheMode { None, Always, Auto };
+
 /** Used to specify text styles when loading fonts. */
 enum class ETextStyle { Normal, Bold, Italic };
 
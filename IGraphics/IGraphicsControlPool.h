@@ -0,0 +1,156 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IControlPool
+ */
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "IPlugPlatform.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** The allocator behind IControl's operator new. Controls are carved from slabs of equally sized chunks, one free list per 16 byte size class,
+ * so the controls a UI creates in LayoutUI() sit next to each other in memory instead of being scattered over the heap, and walking
+ * them while drawing touches fewer cache lines and pages. The pool is shared by every editor in the process, because a control is allocated
+ * before it is attached to an IGraphics, and it gives its slabs back once the last control is deleted, i.e. when the last editor closes.
+ * Controls larger than the biggest size class use the global operator new. Define IGRAPHICS_NO_CONTROL_POOL to allocate controls from the heap */
+class IControlPool final
+{
+public:
+  static IControlPool& Get()
+  {
+    // never destroyed, in case a control is deleted by a static destructor
+    static IControlPool* sPool = new IControlPool();
+    return *sPool;
+  }
+
+  IControlPool(const IControlPool&) = delete;
+  IControlPool& operator=(const IControlPool&) = delete;
+
+  /** @param size The size of the control in bytes
+   * @return Memory for the control, aligned like the global operator new */
+  void* Allocate(size_t size)
+  {
+    const size_t sizeClass = GetSizeClass(size);
+
+    if (sizeClass >= kNumSizeClasses)
+      return ::operator new(size);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    FreeChunk*& pFree = mFreeLists[sizeClass];
+
+    if (!pFree)
+      AddSlab(sizeClass);
+
+    FreeChunk* pChunk = pFree;
+    pFree = pChunk->mNext;
+    mNumLive++;
+
+    return pChunk;
+  }
+
+  /** @param ptr Memory returned by Allocate()
+   * @param size The size it was allocated with */
+  void Deallocate(void* ptr, size_t size)
+  {
+    if (!ptr)
+      return;
+
+    const size_t sizeClass = GetSizeClass(size);
+
+    if (sizeClass >= kNumSizeClasses)
+    {
+      ::operator delete(ptr);
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    FreeChunk* pChunk = static_cast<FreeChunk*>(ptr);
+    pChunk->mNext = mFreeLists[sizeClass];
+    mFreeLists[sizeClass] = pChunk;
+
+    if (--mNumLive == 0)
+      ReleaseSlabs();
+  }
+
+  /** @return The number of bytes held in slabs, whether or not they are in use */
+  size_t GetMemoryUsage()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mSlabBytes;
+  }
+
+  /** @return The number of controls allocated from slabs */
+  int GetNumLive()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mNumLive;
+  }
+
+private:
+  IControlPool() = default;
+
+  struct FreeChunk
+  {
+    FreeChunk* mNext;
+  };
+
+  static constexpr size_t kGranularity = 16;
+  static constexpr size_t kNumSizeClasses = 128; // up to 2 kB
+  static constexpr size_t kChunksPerSlab = 32;
+
+  static size_t GetSizeClass(size_t size) { return size ? (size - 1) / kGranularity : 0; }
+
+  void AddSlab(size_t sizeClass)
+  {
+    const size_t chunkSize = (sizeClass + 1) * kGranularity;
+    char* pSlab = static_cast<char*>(::operator new(chunkSize * kChunksPerSlab));
+    mSlabs.push_back(pSlab);
+    mSlabBytes += chunkSize * kChunksPerSlab;
+
+    // threaded in address order, so consecutive allocations are adjacent
+    for (size_t i = kChunksPerSlab; i-- > 0;)
+    {
+      FreeChunk* pChunk = reinterpret_cast<FreeChunk*>(pSlab + i * chunkSize);
+      pChunk->mNext = mFreeLists[sizeClass];
+      mFreeLists[sizeClass] = pChunk;
+    }
+  }
+
+  void ReleaseSlabs()
+  {
+    for (char* pSlab : mSlabs)
+      ::operator delete(pSlab);
+
+    mSlabs.clear();
+    mSlabBytes = 0;
+
+    for (FreeChunk*& pFree : mFreeLists)
+      pFree = nullptr;
+  }
+
+  std::mutex mMutex;
+  FreeChunk* mFreeLists[kNumSizeClasses] = {};
+  std::vector<char*> mSlabs;
+  size_t mSlabBytes = 0;
+  int mNumLive = 0;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
@@ -8,6 +8,8 @@
  ==============================================================================
 */
 
+#include <algorithm>
+
 #include "IGraphicsEditorDelegate.h"
 #include "IGraphics.h"
 #include "IControl.h"
@@ -127,45 +129,75 @@ void IGEditorDelegate::SendParameterValueFromDelegate(int paramIdx, double value
     if (!normalized)
       value = GetParam(paramIdx)->ToNormalized(value);
 
+    mGraphics->ForControlValueWithParam(paramIdx, [value](IControl& control, int valIdx) {
+      control.SetValueFromDelegate(value, valIdx);
+    });
+  }
+  
+  IEditorDelegate::SendParameterValueFromDelegate(paramIdx, value, normalized);
+}
+
+void IGEditorDelegate::SendCurrentParamValuesFromDelegate()
+{
+  if (mGraphics)
+  {
     for (int c = 0; c < mGraphics->NControls(); c++)
     {
       IControl* pControl = mGraphics->GetControl(c);
-      
-      int nVals = pControl->NVals();
-      
-      for(int v = 0; v < nVals; v++)
+
+      for (int v = 0; v < pControl->NVals(); v++)
       {
-        if (pControl->GetParamIdx(v) == paramIdx)
-        {
-          pControl->SetValueFromDelegate(value, v);
-          // Could be more than one, don't break until we check them all.
-        }
-      }
+        const int paramIdx = pControl->GetParamIdx(v);
 
+        if (paramIdx > kNoParameter && paramIdx < NParams())
+          pControl->SetValueFromDelegate(GetParam(paramIdx)->GetNormalized(), v);
+      }
     }
   }
-  
-  IEditorDelegate::SendParameterValueFromDelegate(paramIdx, value, normalized);
+
+  for (int i = 0; i < NParams(); ++i)
+    IEditorDelegate::SendParameterValueFromDelegate(i, GetParam(i)->GetNormalized(), true);
 }
 
 void IGEditorDelegate::SendMidiMsgFromDelegate(const IMidiMsg& msg)
 {
   if(mGraphics)
   {
-    for (auto c = 0; c < mGraphics->NControls(); c++) // TODO: could keep a map
-    {
-      IControl* pControl = mGraphics->GetControl(c);
-      
-      if (pControl->GetWantsMidi())
-      {
-        pControl->OnMidi(msg);
-      }
-    }
+    mGraphics->ForControlWantingMidi([&msg](IControl& control) {
+      if (control.WantsMidiMsg(msg))
+        control.OnMidi(msg);
+    });
   }
   
   IEditorDelegate::SendMidiMsgFromDelegate(msg);
 }
 
+void IGEditorDelegate::SendMidiMsgsFromDelegate(const IMidiMsg* pMsgs, int nMsgs)
+{
+  if (!nMsgs)
+    return;
+
+  if(mGraphics)
+  {
+    mGraphics->ForControlWantingMidi([pMsgs, nMsgs](IControl& control) {
+      // controls whose filter passes none of the messages aren't called
+      if (std::any_of(pMsgs, pMsgs + nMsgs, [&control](const IMidiMsg& msg) { return control.WantsMidiMsg(msg); }))
+        control.OnMidiMsgs(pMsgs, nMsgs);
+    });
+  }
+  
+  for (int i = 0; i < nMsgs; i++)
+    IEditorDelegate::SendMidiMsgFromDelegate(pMsgs[i]);
+}
+
+void IGEditorDelegate::GetMemoryReport(IMemoryReport& report) const
+{
+  IEditorDelegate::GetMemoryReport(report);
+
+  if (mGraphics)
+    mGraphics->GetMemoryReport(report);
+}
+
 void IGEditorDelegate::AttachGraphics(IGraphics* pGraphics)
 {
   assert(!mGraphics); // protect against calling AttachGraphics() when mGraphics already exists
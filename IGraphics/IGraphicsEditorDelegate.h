@@ -36,15 +36,19 @@ public:
   IGEditorDelegate& operator=(const IGEditorDelegate&) = delete;
     
   //IEditorDelegate
-  void* OpenWindow(void* pHandle) final;
-  void CloseWindow() final;
+  void* OpenWindow(void* pHandle) override;
+  void CloseWindow() override;
   void SetScreenScale(double scale) final;
 
   //The rest should be final, but the WebSocketEditorDelegate needs to override them
   void SendControlValueFromDelegate(int controlTag, double normalizedValue) override;
   void SendControlMsgFromDelegate(int controlTag, int messageTag, int dataSize = 0, const void* pData = nullptr) override;
   void SendMidiMsgFromDelegate(const IMidiMsg& msg) override;
+  /** Hands the whole batch to each control that wants MIDI, in a single pass over the controls */
+  void SendMidiMsgsFromDelegate(const IMidiMsg* pMsgs, int nMsgs) override;
   void SendParameterValueFromDelegate(int paramIdx, double value, bool normalized) override;
+  /** Updates every control linked to a parameter in a single pass over the controls, rather than one pass per parameter */
+  void SendCurrentParamValuesFromDelegate() override;
   int SetEditorData(const IByteChunk& data, int startPos) override;
 
   /** If you override this method you must call the parent! */
@@ -74,6 +78,9 @@ public:
   /** Get a pointer to the IGraphics context */
   IGraphics* GetUI() { return mGraphics.get(); };
 
+  /** Adds the user interface to the report if it is open, see IEditorDelegate::GetMemoryReport() */
+  void GetMemoryReport(IMemoryReport& report) const override;
+
   /** Called from the UI to resize the editor via the plugin and store editor in the base.
    & This calls through to EditorResizeFromUI after updating the data.
    * @return \c true if the base API resized the window */
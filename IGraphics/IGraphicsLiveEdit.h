@@ -37,6 +37,7 @@ public:
   , mMouseOversEnabled(mouseOversEnabled)
   {
     mTargetRECT = mRECT;
+    SetPollDirty(true);
   }
   
   ~IGraphicsLiveEdit()
@@ -416,6 +416,10 @@ public:
   
   void DrawSVG(const ISVG& svg, const IRECT& dest, const IBlend* pBlend) override
   {
+    // nothing to draw, e.g. an SVG from IGraphics::LoadSVGAsync() that is still being parsed
+    if (svg.W() <= 0.f || svg.H() <= 0.f)
+      return;
+
     float xScale = dest.W() / svg.W();
     float yScale = dest.H() / svg.H();
     float scale = xScale < yScale ? xScale : yScale;
@@ -0,0 +1,122 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPatternCache
+ */
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "IPlugPlatform.h"
+#include "IGraphicsStructs.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** A least recently used cache of the gradient objects a backend makes from an IPattern, e.g. Skia shaders or Cairo patterns, so that controls
+ * that fill the same gradient on every draw don't build it again each time. Gradients are keyed by their type, extend, stops and transform,
+ * and by the blend weight, which the backends multiply into the stop colors
+ * @tparam T A copyable handle to the backend's gradient, e.g. sk_sp<SkShader> */
+template <class T>
+class IPatternCache final
+{
+public:
+  /** @param capacity The number of gradients to keep, after which the least recently used is dropped */
+  IPatternCache(size_t capacity = 128)
+  : mCapacity(capacity)
+  {
+  }
+
+  IPatternCache(const IPatternCache&) = delete;
+  IPatternCache& operator=(const IPatternCache&) = delete;
+
+  /** Look up the gradient for a pattern, which becomes the most recently used. If it is not found, Add() stores it under the same key
+   * @param pattern The pattern, which should not be solid
+   * @param weight The blend weight the gradient is made with
+   * @return The gradient, or nullptr if it is not cached */
+  const T* Find(const IPattern& pattern, float weight)
+  {
+    // the key is built in a reused string, so a hit doesn't allocate
+    mKey.clear();
+    Append(static_cast<int>(pattern.mType));
+    Append(static_cast<int>(pattern.mExtend));
+    Append(weight);
+    Append(pattern.mTransform.mXX);
+    Append(pattern.mTransform.mYX);
+    Append(pattern.mTransform.mXY);
+    Append(pattern.mTransform.mYY);
+    Append(pattern.mTransform.mTX);
+    Append(pattern.mTransform.mTY);
+
+    for (int i = 0; i < pattern.NStops(); i++)
+    {
+      const IColorStop& stop = pattern.GetStop(i);
+      Append(stop.mOffset);
+      Append(stop.mColor.A);
+      Append(stop.mColor.R);
+      Append(stop.mColor.G);
+      Append(stop.mColor.B);
+    }
+
+    auto it = mMap.find(mKey);
+
+    if (it == mMap.end())
+      return nullptr;
+
+    mEntries.splice(mEntries.begin(), mEntries, it->second);
+    return &it->second->second;
+  }
+
+  /** Store the gradient for the pattern that the last Find() did not find
+   * @param gradient The gradient
+   * @return The stored gradient */
+  const T& Add(const T& gradient)
+  {
+    if (mEntries.size() >= mCapacity)
+    {
+      mMap.erase(mEntries.back().first);
+      mEntries.pop_back();
+    }
+
+    mEntries.emplace_front(mKey, gradient);
+    mMap.emplace(mKey, mEntries.begin());
+    return mEntries.front().second;
+  }
+
+  /** Forget every gradient, e.g. when the context they belong to goes away */
+  void Clear()
+  {
+    mMap.clear();
+    mEntries.clear();
+  }
+
+private:
+  template <class V>
+  void Append(V value)
+  {
+    mKey.append(reinterpret_cast<const char*>(&value), sizeof(V));
+  }
+
+  using Entry = std::pair<std::string, T>;
+
+  size_t mCapacity;
+  std::string mKey;
+  std::list<Entry> mEntries; // most recently used first
+  std::unordered_map<std::string, typename std::list<Entry>::iterator> mMap;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
@@ -10,11 +10,16 @@
 
 #pragma once
 
+#include <atomic>
 #include <cmath>
+#include <cstdint>
 #include <cstring>
 #include <cstdio>
 #include <cassert>
 #include <memory>
+#include <new>
+#include <utility>
+#include <vector>
 
 #include "wdlstring.h"
 #include "ptrlist.h"
@@ -34,7 +39,9 @@ BEGIN_IGRAPHICS_NAMESPACE
  * An IPopupMenu must not be declared as a temporary. In order for a receiving IControl or lambda function
  * to be triggered when something is selected, the menu should persist across function calls, therefore
  * it should almost always be a member variable.
- * An IPopupMenu owns its sub items, including submenus
+ * An IPopupMenu owns its sub items, including submenus. The items it creates are allocated in blocks rather than one by one,
+ * so that the large menus of e.g. preset browsers are quick to build and rebuild, and the pointers to them stay valid until they are removed.
+ * The platforms keep the native menus they make and only rebuild a menu when its version has changed, see GetVersion()
  * This (and the platform implementations) are largely based on the VSTGUI COptionMenu */
 class IPopupMenu
 {
@@ -106,6 +113,10 @@ public:
     std::unique_ptr<IPopupMenu> mSubmenu;
     int mFlags;
     int mTag = -1;
+
+  private:
+    friend class IPopupMenu;
+    bool mPooled = false; // created in the menu's item blocks, rather than with new by the caller
   };
   
   using IPopupFunction = std::function<void(int indexInMenu, IPopupMenu::Item* itemChosen)>;
@@ -116,6 +127,8 @@ public:
   : mPrefix(prefix)
   , mCanMultiCheck(multicheck)
   {
+    SetModified();
+
     for (auto& item : items)
       AddItem(item);
   }
@@ -124,6 +137,8 @@ public:
   : mPrefix(0)
   , mCanMultiCheck(false)
   {
+    SetModified();
+
     for (auto& item : items)
       AddItem(item);
     
@@ -135,7 +150,7 @@ public:
   
   ~IPopupMenu()
   {
-    mMenuItems.Empty(true);
+    DeleteAllItems();
   }
 
   static int Sortfunc(const Item **a, const Item **b)
@@ -145,6 +160,8 @@ public:
   
   Item* AddItem(Item* pItem, int index = -1)
   {
+    SetModified();
+
     if (index == -1)
       mMenuItems.Add(pItem); // add it to the end
     else if (index == -2)
@@ -155,7 +172,7 @@ public:
     return pItem;
   }
   
-  Item* AddItem(const char* str, int index = -1, int itemFlags = Item::kNoFlags) { return AddItem(new Item(str, itemFlags), index); }
+  Item* AddItem(const char* str, int index = -1, int itemFlags = Item::kNoFlags) { return AddItem(NewItem(str, itemFlags), index); }
   
   Item* AddItem(const char* str, int index, IPopupMenu* pSubmenu)
   {
@@ -164,7 +181,7 @@ public:
     if(GetFunction())
       pSubmenu->SetFunction(GetFunction());
     
-    return AddItem(new Item(str, pSubmenu), index);
+    return AddItem(NewItem(str, pSubmenu), index);
   }
   
   Item* AddItem(const char* str, IPopupMenu* pSubmenu, int index = -1)
@@ -174,12 +191,12 @@ public:
     if(GetFunction())
       pSubmenu->SetFunction(GetFunction());
     
-    return AddItem(new Item(str, pSubmenu), index);
+    return AddItem(NewItem(str, pSubmenu), index);
   }
   
   Item* AddSeparator(int index = -1)
   {
-    Item* pItem = new Item ("", Item::kSeparator);
+    Item* pItem = NewItem("", Item::kSeparator);
     return AddItem(pItem, index);
   }
   
@@ -203,8 +220,23 @@ public:
     
     for (int i = 0; i < toDelete.GetSize(); i++)
     {
-      mMenuItems.DeletePtr(toDelete.Get(i));
+      mMenuItems.DeletePtr(toDelete.Get(i), false);
+      DeleteItem(toDelete.Get(i));
     }
+
+    if (toDelete.GetSize())
+      SetModified();
+  }
+
+  /** @return A number that changes whenever items are added or removed or the prefix changes, and is never the same for two menus.
+   * The platform classes rebuild their cached native menu when it changes. Checked and enabled states are read each time the menu opens */
+  uint32_t GetVersion() const { return mVersion; }
+
+  /** Call this after changing the text of an item that is already in the menu, so that the native menu is rebuilt */
+  void SetModified()
+  {
+    static std::atomic<uint32_t> sVersion {0};
+    mVersion = ++sVersion;
   }
 
   void SetChosenItemIdx(int index) { mChosenItemIdx = index; };
@@ -243,9 +275,10 @@ public:
   
   void SetPrefix(int count)
   {
-    if (count >= 0 && count < 4)
+    if (count >= 0 && count < 4 && count != mPrefix)
     {
       mPrefix = count;
+      SetModified();
     }
   }
   
@@ -259,7 +292,7 @@ public:
       mCanMultiCheck = false;
     }
     
-    mMenuItems.Empty(true);
+    DeleteAllItems();
   }
 
   bool CheckItem(int index, bool state)
@@ -308,10 +341,68 @@ public:
   }
   
 private:
+  static constexpr int kItemsPerBlock = 64;
+
+  struct ItemSlot
+  {
+    alignas(Item) unsigned char mBytes[sizeof(Item)];
+  };
+
+  template <typename... Args>
+  Item* NewItem(Args&&... args)
+  {
+    void* pSlot;
+
+    if (!mFreeSlots.empty())
+    {
+      pSlot = mFreeSlots.back();
+      mFreeSlots.pop_back();
+    }
+    else
+    {
+      if (mNUsedSlots == static_cast<int>(mItemBlocks.size()) * kItemsPerBlock)
+        mItemBlocks.emplace_back(new ItemSlot[kItemsPerBlock]);
+
+      pSlot = &mItemBlocks[mNUsedSlots / kItemsPerBlock][mNUsedSlots % kItemsPerBlock];
+      mNUsedSlots++;
+    }
+
+    Item* pItem = new (pSlot) Item(std::forward<Args>(args)...);
+    pItem->mPooled = true;
+    return pItem;
+  }
+
+  void DeleteItem(Item* pItem)
+  {
+    if (pItem->mPooled)
+    {
+      pItem->~Item();
+      mFreeSlots.push_back(pItem);
+    }
+    else
+      delete pItem;
+  }
+
+  // once every item is gone the blocks are reused from the start
+  void DeleteAllItems()
+  {
+    for (int i = 0; i < mMenuItems.GetSize(); i++)
+      DeleteItem(mMenuItems.Get(i));
+
+    mMenuItems.Empty(false);
+    mFreeSlots.clear();
+    mNUsedSlots = 0;
+    SetModified();
+  }
+
   int mPrefix; // 0 = no prefix, 1 = numbers no leading zeros, 2 = 1 lz, 3 = 2lz
+  uint32_t mVersion = 0; // see GetVersion()
   int mChosenItemIdx = -1;
   bool mCanMultiCheck; // multicheck = 0 doesn't actually prohibit multichecking, you should do that in your code, by calling CheckItemAlone instead of CheckItem
-  WDL_PtrList<Item> mMenuItems;
+  WDL_PtrList<Item> mMenuItems; // the order of the items, which are in mItemBlocks unless they were added with AddItem(Item*)
+  std::vector<std::unique_ptr<ItemSlot[]>> mItemBlocks;
+  std::vector<void*> mFreeSlots; // slots in mItemBlocks of removed items
+  int mNUsedSlots = 0;
   IPopupFunction mPopupFunc = nullptr;
 };
 
@@ -43,13 +43,17 @@
 #elif defined IGRAPHICS_NANOVG
   #define BITMAP_DATA_TYPE int;
 #elif defined IGRAPHICS_SKIA
+  #include <memory>
   #include "SkImage.h"
   #include "SkSurface.h"
+  #include "SkPictureRecorder.h"
   struct SkiaDrawable
   {
     bool mIsSurface;
     sk_sp<SkImage> mImage;
     sk_sp<SkSurface> mSurface;
+    sk_sp<SkPicture> mPicture; // for recorded layers, see IGraphics::StartRecordedLayer()
+    std::unique_ptr<SkPictureRecorder> mRecorder; // while a recorded layer is being drawn
   };
   #define BITMAP_DATA_TYPE SkiaDrawable*
 #elif defined IGRAPHICS_LICE
@@ -70,7 +74,7 @@
   #include "wingdi.h"
   #include "Stringapiset.h"
   #define FONT_DESCRIPTOR_TYPE HFONT
-#elif defined OS_WEB
+#elif defined OS_WEB || defined OS_LINUX
   #define FONT_DESCRIPTOR_TYPE std::pair<WDL_String, WDL_String>*
 #else 
   // NO_IGRAPHICS
@@ -146,6 +150,9 @@ public:
   /** /todo */
   float GetDrawScale() const { return mDrawScale; }
 
+  /** @return The size of the pixel data in bytes, assuming 4 bytes per pixel */
+  size_t GetMemoryUsage() const { return static_cast<size_t>(mWidth) * mHeight * 4; }
+
 private:
   BitmapData mBitmap; // for most drawing APIs BitmapData is a pointer. For Nanovg it is an integer index
   int mWidth;
@@ -154,6 +161,18 @@ private:
   float mDrawScale;
 };
 
+/** The GPU objects a drawing back end makes for an IShader, such as its compiled program and its textures, which the IShader owns.
+ * Like the textures of an APIBitmap with NanoVG, they are freed with the controls, before the back end deletes its context */
+class APIShader
+{
+public:
+  APIShader() {}
+  virtual ~APIShader() {}
+
+  APIShader(const APIShader&) = delete;
+  APIShader& operator=(const APIShader&) = delete;
+};
+
 /** Used to retrieve font info directly from a raw memory buffer. */
 class IFontInfo
 {
@@ -433,6 +452,27 @@ struct SVGHolder
   
   SVGHolder(const SVGHolder&) = delete;
   SVGHolder& operator=(const SVGHolder&) = delete;
+
+  /** @return An estimate of the size of the parsed image in bytes */
+  size_t GetMemoryUsage() const
+  {
+    size_t bytes = sizeof(SVGHolder);
+
+    if (mImage)
+    {
+      bytes += sizeof(NSVGimage);
+
+      for (NSVGshape* pShape = mImage->shapes; pShape; pShape = pShape->next)
+      {
+        bytes += sizeof(NSVGshape);
+
+        for (NSVGpath* pPath = pShape->paths; pPath; pPath = pPath->next)
+          bytes += sizeof(NSVGpath) + pPath->npts * 2 * sizeof(float);
+      }
+    }
+
+    return bytes;
+  }
 };
 
 /** Used internally to store data statically, making sure memory is not wasted when there are multiple plug-in instances loaded */
@@ -455,6 +495,11 @@ public:
     void Clear()                                              { return mStorage.Clear(); }
     void Retain()                                             { return mStorage.Retain(); }
     void Release()                                            { return mStorage.Release(); }
+    int GetCount() const                                      { return mStorage.mCount; }
+    template <class F>
+    size_t GetMemoryUsage(F sizeOf) const                     { return mStorage.GetMemoryUsage(sizeOf); }
+    template <class F>
+    void ForEach(F func) const                                { mStorage.ForEach(func); }
       
   private:
     StaticStorage& mStorage;
@@ -551,6 +596,33 @@ private:
     mDatas.Empty(true);
   };
 
+  /** @param sizeOf A function that returns the size of an item in bytes
+   * @return The total size of the items and their keys in bytes */
+  template <class F>
+  size_t GetMemoryUsage(F sizeOf) const
+  {
+    size_t bytes = 0;
+
+    for (int i = 0; i < mDatas.GetSize(); ++i)
+    {
+      const DataKey* pKey = mDatas.Get(i);
+      bytes += sizeof(DataKey) + pKey->name.GetLength() + (pKey->data ? sizeOf(*pKey->data) : 0);
+    }
+
+    return bytes;
+  }
+
+  /** @param func A function called with the name, scale and data of each item, which must not add or remove items */
+  template <class F>
+  void ForEach(F func) const
+  {
+    for (int i = 0; i < mDatas.GetSize(); ++i)
+    {
+      const DataKey* pKey = mDatas.Get(i);
+      func(pKey->name.Get(), pKey->scale, pKey->data.get());
+    }
+  }
+
   /** /todo  */
   void Retain()
   {
@@ -0,0 +1,548 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IResourcePack
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifdef OS_WIN
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#include "IPlugPlatform.h"
+#include "IPlugPaths.h"
+#include "IPlugStructs.h"
+#include "wdlstring.h"
+#include "nanosvg.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** A file of bitmaps that are already decoded and SVGs that are already parsed, so that opening an editor for the first time in a process
+ * costs uploading them rather than decoding PNGs and parsing SVG text. A pack is made at build time by Scripts/resource_pack/MakeResourcePack
+ * from the plug-in's resources, added to the bundle or Windows resources like any other resource, and loaded with IGraphics::LoadResourcePack().
+ * From then on LoadBitmap() and LoadSVG() take what they can from the pack and fall back to the usual resources for the rest.
+ *
+ * The pack is memory-mapped, so pages are only read from disk as their bitmaps are used, and the pixels of bitmaps that are uploaded to
+ * textures or wrapped without a copy (NanoVG, Skia) are never held in memory twice.
+ *
+ * Bitmaps are stored as rows of 8-bit RGBA pixels that are not premultiplied, which NanoVG uploads as they are and the other backends convert
+ * in one pass. SVGs are stored as NanoSVG shapes, paths and gradients, parsed with particular units and dpi.
+ *
+ * The format is little-endian: a header (magic, version, number of entries), a table of entries (name, type, scale, width, height, offset
+ * and size of the data), then the data of each entry, aligned to kAlignment bytes. */
+class IResourcePack final
+{
+public:
+  static constexpr int kMagic = 0x4B505249; // "IRPK"
+  static constexpr int kVersion = 1;
+  static constexpr int kAlignment = 16;
+
+  enum class EType
+  {
+    kBitmap = 0,
+    kSVG
+  };
+
+  struct Entry
+  {
+    WDL_String mName;
+    EType mType;
+    int mScale;
+    int mWidth;
+    int mHeight;
+    int mOffset;
+    int mSize;
+  };
+
+  IResourcePack() {}
+
+  ~IResourcePack() { Close(); }
+
+  IResourcePack(const IResourcePack&) = delete;
+  IResourcePack& operator=(const IResourcePack&) = delete;
+
+  /** Memory-map a pack file
+   * @param path The absolute path of the file
+   * @return \c true if the file was mapped and is a valid pack */
+  bool Open(const char* path)
+  {
+    Close();
+
+#ifdef OS_WIN
+    wchar_t pathW[MAX_PATH];
+    UTF8ToUTF16(pathW, path, MAX_PATH);
+    HANDLE file = CreateFileW(pathW, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+      return false;
+
+    LARGE_INTEGER size;
+    HANDLE mapping = GetFileSizeEx(file, &size) && size.QuadPart > 0 && size.QuadPart < INT_MAX ? CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    CloseHandle(file);
+
+    if (!mapping)
+      return false;
+
+    mMapping = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+
+    if (!mMapping)
+      return false;
+
+    mMappedSize = static_cast<size_t>(size.QuadPart);
+#else
+    const int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+      return false;
+
+    struct stat info;
+
+    if (fstat(fd, &info) != 0 || info.st_size <= 0 || info.st_size >= INT_MAX)
+    {
+      close(fd);
+      return false;
+    }
+
+    // the mapping holds its own reference to the file
+    void* pMapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (pMapping == MAP_FAILED)
+      return false;
+
+    mMapping = pMapping;
+    mMappedSize = static_cast<size_t>(info.st_size);
+#endif
+
+    if (!ReadTable(mMapping, static_cast<int>(mMappedSize)))
+    {
+      Close();
+      return false;
+    }
+
+    return true;
+  }
+
+  /** Use a pack that is already in memory, e.g. a Windows resource. The memory must stay valid until the pack is closed
+   * @param pData The pack data
+   * @param size The size of the data in bytes
+   * @return \c true if the data is a valid pack */
+  bool Open(const void* pData, int size)
+  {
+    Close();
+
+    if (!ReadTable(pData, size))
+    {
+      Close();
+      return false;
+    }
+
+    return true;
+  }
+
+  void Close()
+  {
+    if (mMapping)
+    {
+#ifdef OS_WIN
+      UnmapViewOfFile(mMapping);
+#else
+      munmap(mMapping, mMappedSize);
+#endif
+    }
+
+    mMapping = nullptr;
+    mMappedSize = 0;
+    mData = nullptr;
+    mSize = 0;
+    mEntries.clear();
+  }
+
+  bool IsOpen() const { return mData != nullptr; }
+
+  /** @return The number of bytes of the pack that are mapped or viewed */
+  int GetSize() const { return mSize; }
+
+  /** Find a bitmap, preferring the one stored for targetScale and otherwise taking the largest, which IGraphics scales as it would a bitmap
+   * loaded from a file at another scale
+   * @param name The file name the bitmap is loaded with, e.g. "knob.png" for knob.png and knob@2x.png
+   * @param targetScale The scale wanted
+   * @return The entry, or nullptr if the pack has no bitmap of that name */
+  const Entry* FindBitmap(const char* name, int targetScale) const
+  {
+    const Entry* pBest = nullptr;
+
+    for (auto& entry : mEntries)
+    {
+      if (entry.mType != EType::kBitmap || strcmp(entry.mName.Get(), name))
+        continue;
+
+      if (entry.mScale == targetScale)
+        return &entry;
+
+      if (!pBest || entry.mScale > pBest->mScale)
+        pBest = &entry;
+    }
+
+    return pBest;
+  }
+
+  /** @param name The file name the SVG is loaded with
+   * @return The entry, or nullptr if the pack has no SVG of that name */
+  const Entry* FindSVG(const char* name) const
+  {
+    for (auto& entry : mEntries)
+    {
+      if (entry.mType == EType::kSVG && !strcmp(entry.mName.Get(), name))
+        return &entry;
+    }
+
+    return nullptr;
+  }
+
+  /** @return The data of an entry, for a bitmap mWidth * mHeight RGBA pixels, top row first */
+  const uint8_t* GetData(const Entry& entry) const { return mData + entry.mOffset; }
+
+  /** Make a NanoSVG image from an SVG entry, allocated as nsvgParse() would, so that nsvgDelete() frees it
+   * @param entry An entry found with FindSVG()
+   * @param units The units that LoadSVG() was called with, which must match those the SVG was parsed with when the pack was made
+   * @param dpi The dpi that LoadSVG() was called with, which must match too
+   * @return The image, or nullptr if the units or dpi don't match or the entry is corrupt */
+  NSVGimage* CreateSVG(const Entry& entry, const char* units, float dpi) const
+  {
+    IByteStream stream(GetData(entry), entry.mSize);
+    WDL_String packUnits;
+    float packDPI = 0.f;
+    int pos = stream.GetStr(packUnits, 0);
+    pos = stream.Get(&packDPI, pos);
+
+    if (pos < 0 || strcmp(packUnits.Get(), units) || packDPI != dpi)
+      return nullptr;
+
+    NSVGimage* pImage = static_cast<NSVGimage*>(calloc(1, sizeof(NSVGimage)));
+    int nShapes = 0;
+    pos = stream.Get(&pImage->width, pos);
+    pos = stream.Get(&pImage->height, pos);
+    pos = stream.Get(&nShapes, pos);
+
+    NSVGshape** ppNextShape = &pImage->shapes;
+
+    for (int s = 0; s < nShapes && pos >= 0; s++)
+    {
+      NSVGshape* pShape = static_cast<NSVGshape*>(calloc(1, sizeof(NSVGshape)));
+      *ppNextShape = pShape;
+      ppNextShape = &pShape->next;
+
+      int nPaths = 0;
+      pos = stream.GetArray(pShape->id, sizeof(pShape->id), pos);
+      pos = GetPaint(stream, pShape->fill, pos);
+      pos = GetPaint(stream, pShape->stroke, pos);
+      pos = stream.Get(&pShape->opacity, pos);
+      pos = stream.Get(&pShape->strokeWidth, pos);
+      pos = stream.Get(&pShape->strokeDashOffset, pos);
+      pos = stream.GetArray(pShape->strokeDashArray, 8, pos);
+      pos = stream.Get(&pShape->strokeDashCount, pos);
+      pos = stream.Get(&pShape->strokeLineJoin, pos);
+      pos = stream.Get(&pShape->strokeLineCap, pos);
+      pos = stream.Get(&pShape->miterLimit, pos);
+      pos = stream.Get(&pShape->fillRule, pos);
+      pos = stream.Get(&pShape->flags, pos);
+      pos = stream.GetArray(pShape->bounds, 4, pos);
+      pos = stream.Get(&nPaths, pos);
+
+      NSVGpath** ppNextPath = &pShape->paths;
+
+      for (int p = 0; p < nPaths && pos >= 0; p++)
+      {
+        NSVGpath* pPath = static_cast<NSVGpath*>(calloc(1, sizeof(NSVGpath)));
+        *ppNextPath = pPath;
+        ppNextPath = &pPath->next;
+
+        pos = stream.Get(&pPath->npts, pos);
+
+        if (pos < 0 || pPath->npts < 0 || pPath->npts > (stream.Size() - pos) / static_cast<int>(2 * sizeof(float)))
+        {
+          pos = -1;
+          break;
+        }
+
+        pPath->pts = static_cast<float*>(malloc(std::max(pPath->npts, 1) * 2 * sizeof(float)));
+        pos = stream.GetArray(pPath->pts, pPath->npts * 2, pos);
+        pos = stream.Get(&pPath->closed, pos);
+        pos = stream.GetArray(pPath->bounds, 4, pos);
+      }
+    }
+
+    if (pos < 0)
+    {
+      nsvgDelete(pImage);
+      return nullptr;
+    }
+
+    return pImage;
+  }
+
+  /** Builds a pack, used by the MakeResourcePack tool */
+  class Writer
+  {
+  public:
+    /** @param name The file name the bitmap will be loaded with, without any @2x suffix
+     * @param scale The scale of the bitmap, e.g. 2 for an @2x bitmap
+     * @param width The width in pixels
+     * @param height The height in pixels
+     * @param pRGBA width * height RGBA pixels that are not premultiplied, top row first */
+    void AddBitmap(const char* name, int scale, int width, int height, const uint8_t* pRGBA)
+    {
+      Item item { WDL_String(name), EType::kBitmap, scale, width, height };
+      item.mData.PutBytes(pRGBA, width * height * 4);
+      mItems.push_back(std::move(item));
+    }
+
+    /** @param name The file name the SVG will be loaded with
+     * @param pImage The parsed image
+     * @param units The units the image was parsed with
+     * @param dpi The dpi the image was parsed with */
+    void AddSVG(const char* name, const NSVGimage* pImage, const char* units, float dpi)
+    {
+      Item item { WDL_String(name), EType::kSVG, 1, static_cast<int>(pImage->width), static_cast<int>(pImage->height) };
+      IByteChunk& data = item.mData;
+      int nShapes = 0;
+
+      for (NSVGshape* pShape = pImage->shapes; pShape; pShape = pShape->next)
+        nShapes++;
+
+      data.PutStr(units);
+      data.Put(&dpi);
+      data.Put(&pImage->width);
+      data.Put(&pImage->height);
+      data.Put(&nShapes);
+
+      for (NSVGshape* pShape = pImage->shapes; pShape; pShape = pShape->next)
+      {
+        int nPaths = 0;
+
+        for (NSVGpath* pPath = pShape->paths; pPath; pPath = pPath->next)
+          nPaths++;
+
+        data.PutArray(pShape->id, sizeof(pShape->id));
+        PutPaint(data, pShape->fill);
+        PutPaint(data, pShape->stroke);
+        data.Put(&pShape->opacity);
+        data.Put(&pShape->strokeWidth);
+        data.Put(&pShape->strokeDashOffset);
+        data.PutArray(pShape->strokeDashArray, 8);
+        data.Put(&pShape->strokeDashCount);
+        data.Put(&pShape->strokeLineJoin);
+        data.Put(&pShape->strokeLineCap);
+        data.Put(&pShape->miterLimit);
+        data.Put(&pShape->fillRule);
+        data.Put(&pShape->flags);
+        data.PutArray(pShape->bounds, 4);
+        data.Put(&nPaths);
+
+        for (NSVGpath* pPath = pShape->paths; pPath; pPath = pPath->next)
+        {
+          data.Put(&pPath->npts);
+          data.PutArray(pPath->pts, pPath->npts * 2);
+          data.Put(&pPath->closed);
+          data.PutArray(pPath->bounds, 4);
+        }
+      }
+
+      mItems.push_back(std::move(item));
+    }
+
+    /** @param chunk Filled with the pack */
+    void Write(IByteChunk& chunk) const
+    {
+      // the table is written twice, first to find its size and so the offsets of the data
+      const int tableSize = WriteTable(chunk, 0);
+      chunk.Clear();
+      WriteTable(chunk, Align(tableSize));
+      Pad(chunk);
+
+      for (auto& item : mItems)
+      {
+        chunk.PutBytes(item.mData.GetData(), item.mData.Size());
+        Pad(chunk);
+      }
+    }
+
+  private:
+    struct Item
+    {
+      WDL_String mName;
+      EType mType;
+      int mScale;
+      int mWidth;
+      int mHeight;
+      IByteChunk mData;
+    };
+
+    static int Align(int size) { return (size + kAlignment - 1) / kAlignment * kAlignment; }
+
+    static void Pad(IByteChunk& chunk)
+    {
+      static const uint8_t zeros[kAlignment] = {};
+      chunk.PutBytes(zeros, Align(chunk.Size()) - chunk.Size());
+    }
+
+    int WriteTable(IByteChunk& chunk, int dataOffset) const
+    {
+      const int magic = kMagic;
+      const int version = kVersion;
+      const int nEntries = static_cast<int>(mItems.size());
+      chunk.Put(&magic);
+      chunk.Put(&version);
+      chunk.Put(&nEntries);
+
+      for (auto& item : mItems)
+      {
+        const int type = static_cast<int>(item.mType);
+        const int size = item.mData.Size();
+        chunk.PutStr(item.mName.Get());
+        chunk.Put(&type);
+        chunk.Put(&item.mScale);
+        chunk.Put(&item.mWidth);
+        chunk.Put(&item.mHeight);
+        chunk.Put(&dataOffset);
+        chunk.Put(&size);
+        dataOffset += Align(size);
+      }
+
+      return chunk.Size();
+    }
+
+    static void PutPaint(IByteChunk& data, const NSVGpaint& paint)
+    {
+      data.Put(&paint.type);
+
+      if (paint.type == NSVG_PAINT_COLOR)
+        data.Put(&paint.color);
+      else if (paint.type == NSVG_PAINT_LINEAR_GRADIENT || paint.type == NSVG_PAINT_RADIAL_GRADIENT)
+      {
+        const NSVGgradient* pGradient = paint.gradient;
+        data.PutArray(pGradient->xform, 6);
+        data.Put(&pGradient->spread);
+        data.Put(&pGradient->fx);
+        data.Put(&pGradient->fy);
+        data.Put(&pGradient->nstops);
+        data.PutArray(pGradient->stops, pGradient->nstops);
+      }
+    }
+
+    std::vector<Item> mItems;
+  };
+
+private:
+  bool ReadTable(const void* pData, int size)
+  {
+    IByteStream stream(pData, size);
+    int magic = 0, version = 0, nEntries = 0;
+    int pos = stream.Get(&magic, 0);
+    pos = stream.Get(&version, pos);
+    pos = stream.Get(&nEntries, pos);
+
+    if (pos < 0 || magic != kMagic || version != kVersion || nEntries < 0)
+      return false;
+
+    mEntries.resize(nEntries);
+
+    for (auto& entry : mEntries)
+    {
+      int type = 0;
+      pos = stream.GetStr(entry.mName, pos);
+      pos = stream.Get(&type, pos);
+      pos = stream.Get(&entry.mScale, pos);
+      pos = stream.Get(&entry.mWidth, pos);
+      pos = stream.Get(&entry.mHeight, pos);
+      pos = stream.Get(&entry.mOffset, pos);
+      pos = stream.Get(&entry.mSize, pos);
+      entry.mType = static_cast<EType>(type);
+
+      if (pos < 0 || entry.mOffset < 0 || entry.mSize < 0 || entry.mOffset > size - entry.mSize)
+        return false;
+
+      if (entry.mType == EType::kBitmap && (entry.mWidth <= 0 || entry.mHeight <= 0 || entry.mSize != entry.mWidth * entry.mHeight * 4))
+        return false;
+    }
+
+    mData = static_cast<const uint8_t*>(pData);
+    mSize = size;
+    return true;
+  }
+
+  static int GetPaint(const IByteStream& stream, NSVGpaint& paint, int pos)
+  {
+    pos = stream.Get(&paint.type, pos);
+
+    if (pos < 0)
+      return pos;
+
+    if (paint.type == NSVG_PAINT_COLOR)
+      return stream.Get(&paint.color, pos);
+
+    if (paint.type == NSVG_PAINT_LINEAR_GRADIENT || paint.type == NSVG_PAINT_RADIAL_GRADIENT)
+    {
+      float xform[6];
+      char spread = 0;
+      float fx = 0.f, fy = 0.f;
+      int nStops = 0;
+      pos = stream.GetArray(xform, 6, pos);
+      pos = stream.Get(&spread, pos);
+      pos = stream.Get(&fx, pos);
+      pos = stream.Get(&fy, pos);
+      pos = stream.Get(&nStops, pos);
+
+      if (pos < 0 || nStops < 1 || nStops > (stream.Size() - pos) / static_cast<int>(sizeof(NSVGgradientStop)))
+      {
+        paint.type = NSVG_PAINT_NONE; // nothing for nsvgDelete() to free
+        return -1;
+      }
+
+      // allocated as NanoSVG does, with the first stop in the struct
+      NSVGgradient* pGradient = static_cast<NSVGgradient*>(malloc(sizeof(NSVGgradient) + sizeof(NSVGgradientStop) * (nStops - 1)));
+      memcpy(pGradient->xform, xform, sizeof(xform));
+      pGradient->spread = spread;
+      pGradient->fx = fx;
+      pGradient->fy = fy;
+      pGradient->nstops = nStops;
+      paint.gradient = pGradient;
+      return stream.GetArray(pGradient->stops, nStops, pos);
+    }
+
+    return pos;
+  }
+
+  void* mMapping = nullptr;
+  size_t mMappedSize = 0;
+  const uint8_t* mData = nullptr;
+  int mSize = 0;
+  std::vector<Entry> mEntries;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
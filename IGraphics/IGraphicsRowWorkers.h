@@ -0,0 +1,162 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IRowWorkerPool
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "IPlugPlatform.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** A fork-join pool of worker threads for the CPU pixel work of drawing, see IGraphics::SetRasterThreads().
+ * ParallelFor() splits a loop over the rows of a bitmap into one band per thread, and the calling thread renders a band too.
+ * Only use it for work where each band reads shared data and writes to its own rows, such as a blur pass */
+class IRowWorkerPool final
+{
+public:
+  /** @param nThreads The number of threads to render with, including the calling thread */
+  IRowWorkerPool(int nThreads)
+  {
+    for (auto i = 1; i < nThreads; i++)
+      mWorkers.emplace_back([this]() { WorkerLoop(); });
+  }
+
+  ~IRowWorkerPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mQuit = true;
+    }
+
+    mCondition.notify_all();
+
+    for (auto& worker : mWorkers)
+      worker.join();
+  }
+
+  IRowWorkerPool(const IRowWorkerPool&) = delete;
+  IRowWorkerPool& operator=(const IRowWorkerPool&) = delete;
+
+  /** @return The number of threads used, including the calling thread */
+  int NThreads() const { return static_cast<int>(mWorkers.size()) + 1; }
+
+  /** Call func(startRow, endRow) for bands of rows that together cover [0, nRows), and return once every band is done
+   * @param nRows The number of rows
+   * @param minRows The fewest rows worth giving to a thread. Loops of fewer than twice this run on the calling thread
+   * @param func The function to call for each band */
+  void ParallelFor(int nRows, int minRows, const std::function<void(int, int)>& func)
+  {
+    const int nBands = std::min(NThreads(), nRows / std::max(1, minRows));
+
+    if (nBands < 2)
+    {
+      func(0, nRows);
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mFunc = &func;
+      mNRows = nRows;
+      mNBands = nBands;
+      mNextBand = 0;
+      mNDone = 0;
+      mGeneration++;
+    }
+
+    mCondition.notify_all();
+
+    RunBands(mGeneration);
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDoneCondition.wait(lock, [this]() { return mNDone == mNBands; });
+    mFunc = nullptr;
+  }
+
+private:
+  // bands are claimed under the lock and only for the current job, so a worker that wakes up late cannot run a finished one
+  void RunBands(uint64_t generation)
+  {
+    while (true)
+    {
+      const std::function<void(int, int)>* pFunc;
+      int start, end;
+
+      {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        if (generation != mGeneration || !mFunc || mNextBand >= mNBands)
+          return;
+
+        const int band = mNextBand++;
+        start = static_cast<int>(static_cast<int64_t>(mNRows) * band / mNBands);
+        end = static_cast<int>(static_cast<int64_t>(mNRows) * (band + 1) / mNBands);
+        pFunc = mFunc;
+      }
+
+      (*pFunc)(start, end);
+
+      std::lock_guard<std::mutex> lock(mMutex);
+
+      if (++mNDone == mNBands)
+        mDoneCondition.notify_one();
+    }
+  }
+
+  void WorkerLoop()
+  {
+    uint64_t lastGeneration = 0;
+
+    while (true)
+    {
+      uint64_t generation;
+
+      {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [&]() { return mQuit || mGeneration != lastGeneration; });
+
+        if (mQuit)
+          return;
+
+        generation = lastGeneration = mGeneration;
+      }
+
+      RunBands(generation);
+    }
+  }
+
+  std::vector<std::thread> mWorkers;
+  std::mutex mMutex;
+  std::condition_variable mCondition;
+  std::condition_variable mDoneCondition;
+  const std::function<void(int, int)>* mFunc = nullptr;
+  uint64_t mGeneration = 0;
+  int mNRows = 0;
+  int mNBands = 0;
+  int mNextBand = 0;
+  int mNDone = 0;
+  bool mQuit = false;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
@@ -0,0 +1,270 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IShader
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "IPlugPlatform.h"
+#include "IGraphicsStructs.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** A fragment shader and the data it reads, which IGraphics::DrawShader() runs for every pixel of a rectangle. A dense visualization such as a
+ * spectrogram or a waterfall then costs the GPU one quad, rather than costing the CPU a path for each pixel column.
+ *
+ * The shader is GLSL, written as for GLSL 1.10 and without a version directive, which the OpenGL NanoVG backends adapt to the version they use.
+ * It defines a function returning the premultiplied color of a point, and can use the declarations that come before it:
+ * @code
+ * varying vec2 uv;              // from (0, 0) at the top left of the rectangle to (1, 1) at the bottom right
+ * uniform vec2 resolution;      // the size of the rectangle in pixels
+ * uniform vec4 params[4];       // the values set with SetParam(), params[0].x is parameter 0
+ * uniform sampler2D tex0;       // the data textures, tex0 to tex3, one value in the red channel of each texel, the first row at the top
+ *
+ * vec4 shade(vec2 uv)
+ * {
+ *   float level = texture2D(tex0, uv).r;
+ *   return vec4(level, level * level, 0.0, 1.0);
+ * }
+ * @endcode
+ * The other backends, and the GL backends if the shader doesn't compile, draw the CPUFunc instead, if there is one, into a bitmap of the
+ * rectangle's pixel size which is only redrawn when the data, the parameters or the size change.
+ * Textures hold values from 0. to 1., which are uploaded with 8 bits of precision when they have changed. Use an IShader on the main thread only */
+class IShader
+{
+public:
+  static constexpr int kMaxTextures = 4;
+  static constexpr int kNumParams = 16;
+
+  /** Computes the color of a pixel when the shader can't run on the GPU. It is called from the threads set with IGraphics::SetRasterThreads(),
+   * so it must only read the shader
+   * @param shader The shader, to read its textures and parameters
+   * @param u The horizontal position in the rectangle, from 0 at the left to 1 at the right
+   * @param v The vertical position in the rectangle, from 0 at the top to 1 at the bottom
+   * @return The color, which is not premultiplied */
+  using CPUFunc = std::function<IColor(const IShader& shader, float u, float v)>;
+
+  /** @param source The GLSL of the shader
+   * @param cpuFunc The function to draw with where the shader can't run, or nullptr to draw nothing there */
+  IShader(const char* source = "", CPUFunc cpuFunc = nullptr)
+  : mCPUFunc(cpuFunc)
+  {
+    SetSource(source);
+  }
+
+  IShader(const IShader&) = delete;
+  IShader& operator=(const IShader&) = delete;
+
+  /** Replace the GLSL, which is compiled the next time the shader is drawn */
+  void SetSource(const char* source)
+  {
+    mSource = source ? source : "";
+    mError.clear();
+    mSourceVersion = ++mVersion;
+  }
+
+  const char* GetSource() const { return mSource.c_str(); }
+
+  /** @return The compiler's message if the source failed to compile when it was last drawn, or an empty string */
+  const char* GetError() const { return mError.c_str(); }
+
+  void SetCPUFunc(CPUFunc func) { mCPUFunc = func; mVersion++; }
+  const CPUFunc& GetCPUFunc() const { return mCPUFunc; }
+
+  /** Set the size of a texture, which clears it
+   * @param idx The texture, < kMaxTextures
+   * @param width The number of values in a row
+   * @param height The number of rows */
+  void ResizeTexture(int idx, int width, int height)
+  {
+    assert(idx >= 0 && idx < kMaxTextures);
+
+    Texture& texture = mTextures[idx];
+    texture.mWidth = std::max(width, 0);
+    texture.mHeight = std::max(height, 0);
+    texture.mData.assign(static_cast<size_t>(texture.mWidth) * texture.mHeight, 0.f);
+    texture.mVersion = ++mVersion;
+  }
+
+  /** Replace a row of a texture
+   * @param idx The texture
+   * @param row The row, from 0 at the top
+   * @param vals The values, from 0. to 1.
+   * @param nVals The number of values. If there are fewer than the width of the texture, the rest of the row is set to 0. */
+  void SetTextureRow(int idx, int row, const float* vals, int nVals)
+  {
+    assert(idx >= 0 && idx < kMaxTextures);
+
+    Texture& texture = mTextures[idx];
+
+    if (row < 0 || row >= texture.mHeight)
+      return;
+
+    CopyRow(texture, row, vals, nVals);
+  }
+
+  /** Move the rows of a texture up by one, dropping the top row, and put a new row at the bottom, e.g. for a spectrogram or a waterfall
+   * @param idx The texture
+   * @param vals The values of the new row, from 0. to 1.
+   * @param nVals The number of values */
+  void ScrollTexture(int idx, const float* vals, int nVals)
+  {
+    assert(idx >= 0 && idx < kMaxTextures);
+
+    Texture& texture = mTextures[idx];
+
+    if (texture.mHeight <= 0)
+      return;
+
+    std::memmove(texture.mData.data(), texture.mData.data() + texture.mWidth, (texture.mData.size() - texture.mWidth) * sizeof(float));
+    CopyRow(texture, texture.mHeight - 1, vals, nVals);
+  }
+
+  int GetTextureWidth(int idx) const { return mTextures[idx].mWidth; }
+  int GetTextureHeight(int idx) const { return mTextures[idx].mHeight; }
+
+  /** @return The values of a texture, a row at a time from the top */
+  const float* GetTextureData(int idx) const { return mTextures[idx].mData.data(); }
+
+  /** Read a texture at a point with linear filtering like the GPU, e.g. from a CPUFunc
+   * @param idx The texture
+   * @param u The horizontal position, from 0 at the left to 1 at the right
+   * @param v The vertical position, from 0 at the top to 1 at the bottom
+   * @return The value, or 0. if the texture is empty */
+  float SampleTexture(int idx, float u, float v) const
+  {
+    const Texture& texture = mTextures[idx];
+
+    if (texture.mData.empty())
+      return 0.f;
+
+    // texel centres are at half integers, and the edges are clamped
+    const float x = Clip(u * texture.mWidth - 0.5f, 0.f, static_cast<float>(texture.mWidth - 1));
+    const float y = Clip(v * texture.mHeight - 0.5f, 0.f, static_cast<float>(texture.mHeight - 1));
+    const int x0 = static_cast<int>(x);
+    const int y0 = static_cast<int>(y);
+    const int x1 = std::min(x0 + 1, texture.mWidth - 1);
+    const int y1 = std::min(y0 + 1, texture.mHeight - 1);
+    const float fx = x - x0;
+    const float fy = y - y0;
+
+    const float* pRow0 = texture.mData.data() + y0 * texture.mWidth;
+    const float* pRow1 = texture.mData.data() + y1 * texture.mWidth;
+    const float top = pRow0[x0] + (pRow0[x1] - pRow0[x0]) * fx;
+    const float bottom = pRow1[x0] + (pRow1[x1] - pRow1[x0]) * fx;
+    return top + (bottom - top) * fy;
+  }
+
+  /** @param idx The parameter, < kNumParams
+   * @param value The value, which the shader reads as params[idx / 4][idx % 4] */
+  void SetParam(int idx, float value)
+  {
+    assert(idx >= 0 && idx < kNumParams);
+
+    if (mParams[idx] != value)
+    {
+      mParams[idx] = value;
+      mVersion++;
+    }
+  }
+
+  float GetParam(int idx) const { return mParams[idx]; }
+
+  /** @return The kNumParams parameter values */
+  const float* GetParams() const { return mParams; }
+
+  /** @return A number that changes whenever the source, the textures, the parameters or the CPUFunc change */
+  uint64_t GetVersion() const { return mVersion; }
+
+  /** @return A number that changes whenever the source changes */
+  uint64_t GetSourceVersion() const { return mSourceVersion; }
+
+  /** @return A number that changes whenever a texture's size or contents change */
+  uint64_t GetTextureVersion(int idx) const { return mTextures[idx].mVersion; }
+
+#pragma mark - Used by the backends
+
+  /** Called by the backend when the source fails to compile */
+  void SetError(const char* error) { mError = error ? error : ""; }
+
+  /** @return The GPU objects a backend made for this shader, or nullptr */
+  APIShader* GetAPIShader() const { return mAPIShader.get(); }
+
+  /** Give the shader the GPU objects a backend made for it, deleting any previous ones */
+  void SetAPIShader(APIShader* pAPIShader) { mAPIShader.reset(pAPIShader); }
+
+  /** @return The bitmap the CPUFunc was last drawn into, or nullptr */
+  APIBitmap* GetCPUBitmap() const { return mCPUBitmap.get(); }
+
+  /** @return The version the bitmap the CPUFunc was last drawn into was made from */
+  uint64_t GetCPUBitmapVersion() const { return mCPUBitmapVersion; }
+
+  /** Delete the bitmap the CPUFunc was drawn into, and make room for the pixels of a new one
+   * @return A buffer for width * height 8-bit RGBA pixels, which must not change while the bitmap made from it is alive */
+  uint8_t* ResetCPUBitmap(int width, int height)
+  {
+    mCPUBitmap.reset();
+    mCPUPixels.Resize(width * height * 4);
+    return mCPUPixels.Get();
+  }
+
+  /** Keep the bitmap the CPUFunc was drawn into, made from the pixels of ResetCPUBitmap() */
+  void SetCPUBitmap(APIBitmap* pBitmap) { mCPUBitmap.reset(pBitmap); mCPUBitmapVersion = mVersion; }
+
+private:
+  struct Texture
+  {
+    int mWidth = 0;
+    int mHeight = 0;
+    std::vector<float> mData;
+    uint64_t mVersion = 0;
+  };
+
+  void CopyRow(Texture& texture, int row, const float* vals, int nVals)
+  {
+    float* pRow = texture.mData.data() + row * texture.mWidth;
+    const int n = Clip(nVals, 0, texture.mWidth);
+
+    for (auto i = 0; i < n; i++)
+      pRow[i] = Clip(vals[i], 0.f, 1.f);
+
+    std::fill(pRow + n, pRow + texture.mWidth, 0.f);
+    texture.mVersion = ++mVersion;
+  }
+
+  std::string mSource;
+  std::string mError;
+  CPUFunc mCPUFunc;
+  Texture mTextures[kMaxTextures];
+  float mParams[kNumParams] = {};
+  uint64_t mVersion = 0;
+  uint64_t mSourceVersion = 0;
+  std::unique_ptr<APIShader> mAPIShader;
+  std::unique_ptr<APIBitmap> mCPUBitmap;
+  RawBitmapData mCPUPixels;
+  uint64_t mCPUBitmapVersion = 0;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
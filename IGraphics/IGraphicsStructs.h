@@ -16,9 +16,11 @@
  * @{
  */
 
+#include <algorithm>
 #include <functional>
 #include <chrono>
 #include <numeric>
+#include <vector>
 
 #include "IGraphicsPrivate.h"
 #include "IGraphicsUtilities.h"
@@ -33,6 +35,7 @@ class IGraphics;
 class IControl;
 class ILambdaControl;
 struct IRECT;
+class IRECTList;
 struct IMouseInfo;
 struct IKeyPress;
 struct IColor;
@@ -43,6 +46,7 @@ using ILambdaDrawFunction = std::function<void(ILambdaControl*, IGraphics&, IREC
 using IKeyHandlerFunc = std::function<bool(const IKeyPress& key, bool isUp)>;
 using IMsgBoxCompletionHanderFunc = std::function<void(EMsgBoxResult result)>;
 using IColorPickerHandlerFunc = std::function<void(const IColor& result)>;
+using IFrameDrawnFunc = std::function<void(IGraphics& graphics, const IRECTList& rects)>;
 
 void EmptyClickActionFunc(IControl* pCaller);
 void DefaultClickActionFunc(IControl* pCaller);
@@ -1526,105 +1530,116 @@ public:
     return true;
   }
   
-  /** /todo  */
-  void Optimize()
+  /** Replace the list with non-overlapping rects that cover the same area, merging rects that share an edge. A sweep down the list's
+   * horizontal edges keeps the cost close to linear when few rects overlap, as with scattered meters and animated controls. If the
+   * result would be more than \p maxRects rects, the list is replaced with its bounding box instead, as IGraphics does in strict mode
+   * @param maxRects The most rects to return before falling back to the bounding box */
+  void Optimize(int maxRects = kMaxOptimizedRects)
   {
-    // Remove rects that are contained by other rects and intersections
-    for (int i = 0; i < Size(); i++)
+    struct Edge
+    {
+      float y;
+      int idx;
+      bool start;
+    };
+
+    std::vector<Edge> edges;
+    std::vector<IRECT> result;
+    std::vector<IRECT> open;
+    std::vector<IRECT> nextOpen;
+    std::vector<int> active;
+    std::vector<std::pair<float, float>> spans;
+    IRECT bounds;
+
+    edges.reserve(Size() * 2);
+
+    for (auto i = 0; i < Size(); i++)
     {
-      for (int j = i + 1; j < Size(); j++)
+      const IRECT& r = Get(i);
+
+      if (r.W() > 0.f && r.H() > 0.f)
       {
-        if (Get(i).Contains(Get(j)))
-        {
-          mRects.Delete(j);
-          j--;
-        }
-        else if (Get(j).Contains(Get(i)))
-        {
-          mRects.Delete(i);
-          i--;
-          break;
-        }
-        else if (Get(i).Intersects(Get(j)))
-        {
-          IRECT intersection = Get(i).Intersect(Get(j));
-            
-          if (Get(i).Mergeable(intersection))
-            Set(i, Shrink(Get(i), intersection));
-          else if (Get(j).Mergeable(intersection))
-            Set(j, Shrink(Get(j), intersection));
-          else if (Get(i).Area() < Get(j).Area())
-            Set(i, Split(Get(i), intersection));
-          else
-            Set(j, Split(Get(j), intersection));
-        }
+        edges.push_back({r.T, i, true});
+        edges.push_back({r.B, i, false});
+        bounds = bounds.Union(r);
       }
     }
-    
-    // Merge any rects that can be merged
-    for (int i = 0; i < Size(); i++)
+
+    std::sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) { return a.y < b.y; });
+
+    auto byLeft = [this](int a, int b) { return Get(a).L < Get(b).L; };
+
+    for (size_t e = 0; e < edges.size();)
     {
-      for (int j = i + 1; j < Size(); j++)
+      const float y = edges[e].y;
+
+      // update the rects crossing the band that starts at y, kept in order of their left edge
+      for (; e < edges.size() && edges[e].y == y; e++)
       {
-        if (Get(i).Mergeable(Get(j)))
-        {
-          Set(j, Get(i).Union(Get(j)));
-          mRects.Delete(i);
-          i = -1;
-          break;
-        }
+        const int idx = edges[e].idx;
+
+        if (edges[e].start)
+          active.insert(std::upper_bound(active.begin(), active.end(), idx, byLeft), idx);
+        else
+          active.erase(std::find(active.begin(), active.end(), idx));
       }
-    }
-  }
-  
-private:
-  /** /todo 
-   * @param r /todo
-   * @param i /todo
-   * @return IRECT /todo */
-  IRECT Shrink(const IRECT &r, const IRECT &i)
-  {
-    if (i.L != r.L)
-      return IRECT(r.L, r.T, i.L, r.B);
-    if (i.T != r.T)
-      return IRECT(r.L, r.T, r.R, i.T);
-    if (i.R != r.R)
-      return IRECT(i.R, r.T, r.R, r.B);
-    return IRECT(r.L, i.B, r.R, r.B);
-  }
-  
-  /** /todo 
-   * @param r /todo
-   * @param i /todo
-   * @return IRECT /todo */
-  IRECT Split(const IRECT r, const IRECT &i)
-  {
-    if (r.L == i.L)
-    {
-      if (r.T == i.T)
+
+      const float nextY = e < edges.size() ? edges[e].y : y;
+
+      // the band's covered spans
+      spans.clear();
+
+      for (int idx : active)
       {
-        Add(IRECT(i.R, r.T, r.R, i.B));
-        return IRECT(r.L, i.B, r.R, r.B);
+        const IRECT& r = Get(idx);
+
+        if (!spans.empty() && r.L <= spans.back().second)
+          spans.back().second = std::max(spans.back().second, r.R);
+        else
+          spans.emplace_back(r.L, r.R);
       }
-      else
+
+      // extend the rects open from the band above that have the same span, close the others
+      nextOpen.clear();
+      size_t o = 0, sp = 0;
+
+      while (o < open.size() || sp < spans.size())
       {
-        Add(IRECT(r.L, r.T, r.R, i.T));
-        return IRECT(i.R, i.T, r.R, r.B);
+        if (o < open.size() && sp < spans.size() && open[o].L == spans[sp].first && open[o].R == spans[sp].second)
+        {
+          open[o].B = nextY;
+          nextOpen.push_back(open[o++]);
+          sp++;
+        }
+        else if (o < open.size() && (sp == spans.size() || open[o].L < spans[sp].first || (open[o].L == spans[sp].first && open[o].R < spans[sp].second)))
+          result.push_back(open[o++]);
+        else
+        {
+          nextOpen.push_back(IRECT(spans[sp].first, y, spans[sp].second, nextY));
+          sp++;
+        }
+      }
+
+      std::swap(open, nextOpen);
+
+      if (static_cast<int>(result.size() + open.size()) > maxRects)
+      {
+        Clear();
+        Add(bounds);
+        return;
       }
     }
-    
-    if (r.T == i.T)
-    {
-      Add(IRECT(r.L, r.T, i.L, i.B));
-      return IRECT(r.L, i.B, r.R, r.B);
-    }
-    else
-    {
-      Add(IRECT(r.L, r.T, r.R, i.T));
-      return IRECT(r.L, i.T, i.L, r.B);
-    }
+
+    Clear();
+
+    for (const IRECT& r : result)
+      Add(r);
   }
-  
+
+  /** The default cap on the number of rects Optimize() returns */
+  static constexpr int kMaxOptimizedRects = 128;
+
+private:
   WDL_TypedBuf<IRECT> mRects;
 };
 
@@ -1965,6 +1980,7 @@ private:
   std::unique_ptr<APIBitmap> mBitmap;
   IRECT mRECT;
   bool mInvalid;
+  int mAssetGeneration = 0;
 };
 
 /** ILayerPtr is a managed pointer for transferring the ownership of layers */
@@ -0,0 +1,113 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc ITextMeasureCache
+ */
+
+#include <cstring>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "IPlugPlatform.h"
+#include "IGraphicsStructs.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** A least recently used cache of the text bounds measured by IGraphics::MeasureText(), so that controls that measure the same strings over and over,
+ * e.g. labels in OnResize() or value strings on every draw, don't go back to the backend each time. Bounds are stored relative to the text's anchor point,
+ * and keyed by the font, size, alignment, scale and string. Backends can also use it for the extents of the strings they lay out to draw */
+class ITextMeasureCache final
+{
+public:
+  /** @param capacity The number of strings to keep, after which the least recently used is dropped */
+  ITextMeasureCache(size_t capacity = 2048)
+  : mCapacity(capacity)
+  {
+  }
+
+  ITextMeasureCache(const ITextMeasureCache&) = delete;
+  ITextMeasureCache& operator=(const ITextMeasureCache&) = delete;
+
+  /** Look up the bounds of a string, which become the most recently used. If they are not found, Add() stores them under the same key
+   * @param text The text style
+   * @param str The string
+   * @param scale The scale the text is measured at
+   * @return The bounds relative to the anchor point, or nullptr if they are not cached */
+  const IRECT* Find(const IText& text, const char* str, float scale)
+  {
+    struct Key
+    {
+      char mFont[FONT_LEN];
+      float mSize;
+      float mScale;
+      int mAlign;
+      int mVAlign;
+    } key;
+
+    // the key's bytes are hashed, padding included
+    memset(&key, 0, sizeof(Key));
+    strcpy(key.mFont, text.mFont);
+    key.mSize = text.mSize;
+    key.mScale = scale;
+    key.mAlign = static_cast<int>(text.mAlign);
+    key.mVAlign = static_cast<int>(text.mVAlign);
+
+    // the key is built in a reused string, so a hit doesn't allocate
+    mKey.assign(reinterpret_cast<const char*>(&key), sizeof(Key));
+    mKey.append(str);
+
+    auto it = mMap.find(mKey);
+
+    if (it == mMap.end())
+      return nullptr;
+
+    mEntries.splice(mEntries.begin(), mEntries, it->second);
+    return &it->second->second;
+  }
+
+  /** Store the bounds of the string that the last Find() did not find
+   * @param bounds The bounds relative to the anchor point */
+  void Add(const IRECT& bounds)
+  {
+    if (mEntries.size() >= mCapacity)
+    {
+      mMap.erase(mEntries.back().first);
+      mEntries.pop_back();
+    }
+
+    mEntries.emplace_front(mKey, bounds);
+    mMap.emplace(mKey, mEntries.begin());
+  }
+
+  /** Forget every string, e.g. when a font is loaded or the scale changes */
+  void Clear()
+  {
+    mMap.clear();
+    mEntries.clear();
+  }
+
+private:
+  using Entry = std::pair<std::string, IRECT>;
+
+  size_t mCapacity;
+  std::string mKey;
+  std::list<Entry> mEntries; // most recently used first
+  std::unordered_map<std::string, std::list<Entry>::iterator> mMap;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
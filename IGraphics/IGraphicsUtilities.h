@@ -9,6 +9,9 @@
 */
 
 #pragma once
+#include <algorithm>
+#include <cstdint>
+
 #include "IPlugConstants.h"
 #include "IGraphicsConstants.h"
 
@@ -57,6 +60,53 @@ static inline void RadialPoints(float angleDegrees, float cx, float cy, float rM
   }
 }
 
+/** Downsample 32-bit pixels with alpha in the top byte (LICE and Cairo bitmaps) to half size, averaging 2x2 blocks, to build the next level of a mip chain.
+ * An odd last row or column is averaged with itself
+ * @param pSrc The source pixels
+ * @param srcW The width of the source in pixels
+ * @param srcH The height of the source in pixels
+ * @param srcSpan The distance between source rows in pixels
+ * @param pDst The destination pixels, at least std::max(srcW / 2, 1) by std::max(srcH / 2, 1)
+ * @param dstSpan The distance between destination rows in pixels
+ * @param preMultiplied Set \c false if the colors are not premultiplied by alpha, so that they are weighted by it and transparent pixels don't darken the edges */
+static inline void HalveBitmapPixels(const uint32_t* pSrc, int srcW, int srcH, int srcSpan, uint32_t* pDst, int dstSpan, bool preMultiplied)
+{
+  const int dstW = std::max(srcW / 2, 1);
+  const int dstH = std::max(srcH / 2, 1);
+
+  for (int y = 0; y < dstH; y++)
+  {
+    const uint32_t* pRow0 = pSrc + (2 * y) * srcSpan;
+    const uint32_t* pRow1 = pSrc + std::min(2 * y + 1, srcH - 1) * srcSpan;
+
+    for (int x = 0; x < dstW; x++)
+    {
+      const int x0 = 2 * x;
+      const int x1 = std::min(x0 + 1, srcW - 1);
+      const uint32_t px[4] = { pRow0[x0], pRow0[x1], pRow1[x0], pRow1[x1] };
+      uint32_t sum[4] = {};
+
+      for (int i = 0; i < 4; i++)
+      {
+        const uint32_t weight = preMultiplied ? 1 : px[i] >> 24;
+
+        for (int c = 0; c < 3; c++)
+          sum[c] += ((px[i] >> (c * 8)) & 0xFF) * weight;
+
+        sum[3] += px[i] >> 24;
+      }
+
+      const uint32_t total = preMultiplied ? 4 : sum[3];
+      uint32_t result = ((sum[3] + 2) / 4) << 24;
+
+      for (int c = 0; c < 3 && total; c++)
+        result |= ((sum[c] + total / 2) / total) << (c * 8);
+
+      pDst[y * dstSpan + x] = result;
+    }
+  }
+}
+
 END_IGRAPHICS_NAMESPACE
 END_IPLUG_NAMESPACE
 
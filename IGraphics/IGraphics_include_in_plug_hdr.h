@@ -37,7 +37,7 @@
   #endif
 #elif defined IGRAPHICS_GL2 || defined IGRAPHICS_GL3
   #define IGRAPHICS_GL
-  #if defined OS_WIN
+  #if defined OS_WIN || defined OS_LINUX
     #include <glad/glad.h>
   #elif defined OS_MAC
     #if defined IGRAPHICS_GL2
@@ -50,7 +50,9 @@
   #endif
 #endif
 
-#ifdef OS_WIN
+#if defined IGRAPHICS_HEADLESS
+  #include "IGraphicsHeadless.h"
+#elif defined OS_WIN
   #include "IGraphicsWin.h"
 #elif defined OS_MAC
   #include "IGraphicsMac.h"
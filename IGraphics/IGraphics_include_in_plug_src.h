@@ -40,7 +40,12 @@
   BEGIN_IPLUG_NAMESPACE
   BEGIN_IGRAPHICS_NAMESPACE
 
-  #if defined OS_WIN
+  #if defined IGRAPHICS_HEADLESS
+  IGraphics* MakeGraphics(IGEditorDelegate& dlg, int w, int h, int fps = 0, float scale = 1.)
+  {
+    return new IGraphicsHeadless(dlg, w, h, fps, scale);
+  }
+  #elif defined OS_WIN
   IGraphics* MakeGraphics(IGEditorDelegate& dlg, int w, int h, int fps = 0, float scale = 1.)
   {
     IGraphicsWin* pGraphics = new IGraphicsWin(dlg, w, h, fps, scale);
@@ -63,6 +68,11 @@
 
     return pGraphics;
   }
+  #elif defined OS_LINUX
+  IGraphics* MakeGraphics(IGEditorDelegate& dlg, int w, int h, int fps = 0, float scale = 1.)
+  {
+    return new IGraphicsLinux(dlg, w, h, fps, scale);
+  }
   #elif defined OS_WEB
   IGraphics* MakeGraphics(IGEditorDelegate& dlg, int w, int h, int fps = 0, float scale = 1.)
   {
@@ -98,6 +98,8 @@ namespace CoreTextHelpers
   extern PlatformFontPtr LoadPlatformFont(const char* fontID, const char* fontName, ETextStyle style);
 
   extern void CachePlatformFont(const char* fontID, const PlatformFontPtr& font, StaticStorage<CoreTextFontDescriptor>& cache);
+
+  extern bool PlatformFontIsCached(const char* fontID, StaticStorage<CoreTextFontDescriptor>& cache);
   
   CoreTextFontDescriptor* GetCTFontDescriptor(const IText& text, StaticStorage<CoreTextFontDescriptor>& cache);
 }
@@ -78,11 +78,18 @@ void CoreTextHelpers::CachePlatformFont(const char* fontID, const PlatformFontPt
 {
   StaticStorage<CoreTextFontDescriptor>::Accessor storage(cache);
   
-  CTFontDescriptorRef descriptor = font->GetDescriptor();
-  IFontDataPtr data = font->GetFontData();
-    
   if (!storage.Find(fontID))
-    storage.Add(new CoreTextFontDescriptor(descriptor, data->GetHeightEMRatio()), fontID);
+  {
+    // copies the font's data, so only done for fonts that aren't cached
+    IFontDataPtr data = font->GetFontData();
+    storage.Add(new CoreTextFontDescriptor(font->GetDescriptor(), data->GetHeightEMRatio()), fontID);
+  }
+}
+
+bool CoreTextHelpers::PlatformFontIsCached(const char* fontID, StaticStorage<CoreTextFontDescriptor>& cache)
+{
+  StaticStorage<CoreTextFontDescriptor>::Accessor storage(cache);
+  return storage.Find(fontID) != nullptr;
 }
 
 CoreTextFontDescriptor* CoreTextHelpers::GetCTFontDescriptor(const IText& text, StaticStorage<CoreTextFontDescriptor>& cache)
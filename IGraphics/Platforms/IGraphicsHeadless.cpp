@@ -0,0 +1,311 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "IGraphicsHeadless.h"
+#include "IPlugPaths.h"
+
+using namespace iplug;
+using namespace igraphics;
+
+#pragma mark - Private Classes and Structs
+
+// Fonts are read from files, there are no system fonts to look up without a platform
+class IGraphicsHeadless::Font : public PlatformFont
+{
+public:
+  Font(const char* fontName, const char* fontPath)
+  : PlatformFont(false), mDescriptor{fontName, ""}, mPath(fontPath)
+  {}
+
+  FontDescriptor GetDescriptor() override { return &mDescriptor; }
+  IFontDataPtr GetFontData() override;
+
+private:
+  std::pair<WDL_String, WDL_String> mDescriptor;
+  WDL_String mPath;
+};
+
+IFontDataPtr IGraphicsHeadless::Font::GetFontData()
+{
+  IFontDataPtr fontData(new IFontData());
+  FILE* fp = fopen(mPath.Get(), "rb");
+
+  if (!fp)
+    return fontData;
+
+  fseek(fp, 0, SEEK_END);
+  fontData = std::make_unique<IFontData>((int) ftell(fp));
+
+  if (!fontData->GetSize())
+  {
+    fclose(fp);
+    return fontData;
+  }
+
+  fseek(fp, 0, SEEK_SET);
+  size_t readSize = fread(fontData->Get(), 1, fontData->GetSize(), fp);
+  fclose(fp);
+
+  if (readSize && readSize == fontData->GetSize())
+    fontData->SetFaceIdx(0);
+
+  return fontData;
+}
+
+#pragma mark -
+
+IGraphicsHeadless::IGraphicsHeadless(IGEditorDelegate& dlg, int w, int h, int fps, float scale)
+: IGRAPHICS_DRAW_CLASS(dlg, w, h, fps, scale)
+{
+}
+
+IGraphicsHeadless::~IGraphicsHeadless()
+{
+  CloseWindow();
+}
+
+void* IGraphicsHeadless::OpenWindow(void* pParent)
+{
+  mOpen = true;
+
+  // there are no native text entries or menus to fall back on
+  AttachPopupMenuControl();
+  AttachTextEntryControl();
+
+  OnViewInitialized(nullptr);
+  SetScreenScale(1); // resizes draw context
+  GetDelegate()->LayoutUI(this);
+  SetAllControlsDirty();
+  GetDelegate()->OnUIOpen();
+
+  return this;
+}
+
+void IGraphicsHeadless::CloseWindow()
+{
+  if (mOpen)
+  {
+    OnViewDestroyed();
+    mOpen = false;
+  }
+}
+
+EMsgBoxResult IGraphicsHeadless::ShowMessageBox(const char* str, const char* caption, EMsgBoxType type, IMsgBoxCompletionHanderFunc completionHandler)
+{
+  ReleaseMouseCapture();
+
+  DBGMSG("%s: %s\n", caption ? caption : "", str ? str : "");
+  const EMsgBoxResult result = type == kMB_OK ? kOK : kCANCEL;
+
+  if (completionHandler)
+    completionHandler(result);
+
+  return result;
+}
+
+#pragma mark - Drawing
+
+bool IGraphicsHeadless::DrawFrame()
+{
+  IRECTList rects;
+
+  if (!IsDirty(rects))
+    return false;
+
+  SetAllControlsClean();
+  DrawRects(rects);
+  return true;
+}
+
+void IGraphicsHeadless::DrawAll()
+{
+  SetAllControlsDirty();
+
+  IRECTList rects;
+
+  if (IsDirty(rects))
+    SetAllControlsClean();
+
+  rects.Add(GetBounds());
+  DrawRects(rects);
+}
+
+void IGraphicsHeadless::DrawRects(IRECTList& rects)
+{
+  const double start = GetTimestamp();
+  Draw(rects);
+  mLastDrawTime = (GetTimestamp() - start) * 1000.;
+}
+
+void IGraphicsHeadless::GetImage(WDL_TypedBuf<uint8_t>& rgba, int& width, int& height)
+{
+  width = static_cast<int>(WindowWidth() * GetScreenScale());
+  height = static_cast<int>(WindowHeight() * GetScreenScale());
+  rgba.Resize(width * height * 4);
+  memset(rgba.Get(), 0, rgba.GetSize());
+
+#if defined IGRAPHICS_LICE
+  LICE_IBitmap* pBitmap = GetDrawBitmap();
+
+  if (!pBitmap)
+    return;
+
+  width = std::min(width, pBitmap->getWidth());
+  height = std::min(height, pBitmap->getHeight());
+  const LICE_pixel* pBits = pBitmap->getBits();
+  const int span = pBitmap->getRowSpan();
+
+  for (int y = 0; y < height; y++)
+  {
+    const LICE_pixel* pRow = pBits + span * (pBitmap->isFlipped() ? pBitmap->getHeight() - 1 - y : y);
+    uint8_t* pDest = rgba.Get() + y * width * 4;
+
+    // the draw bitmap is premultiplied
+    for (int x = 0; x < width; x++, pDest += 4)
+    {
+      const int r = LICE_GETR(pRow[x]), g = LICE_GETG(pRow[x]), b = LICE_GETB(pRow[x]), a = LICE_GETA(pRow[x]);
+      pDest[0] = a ? static_cast<uint8_t>(std::min(255, r * 255 / a)) : 0;
+      pDest[1] = a ? static_cast<uint8_t>(std::min(255, g * 255 / a)) : 0;
+      pDest[2] = a ? static_cast<uint8_t>(std::min(255, b * 255 / a)) : 0;
+      pDest[3] = static_cast<uint8_t>(a);
+    }
+  }
+#elif defined IGRAPHICS_SKIA
+  SkCanvas* pCanvas = static_cast<SkCanvas*>(GetDrawContext());
+
+  if (pCanvas)
+  {
+    SkImageInfo info = SkImageInfo::Make(width, height, kRGBA_8888_SkColorType, kUnpremul_SkAlphaType);
+    pCanvas->readPixels(info, rgba.Get(), width * 4, 0, 0);
+  }
+#endif
+
+  rgba.Resize(width * height * 4);
+}
+
+#pragma mark - Images
+
+bool IGraphicsHeadless::WriteImage(const char* path, const WDL_TypedBuf<uint8_t>& rgba, int width, int height)
+{
+  if (rgba.GetSize() < width * height * 4)
+    return false;
+
+  FILE* fp = fopen(path, "wb");
+
+  if (!fp)
+    return false;
+
+  fprintf(fp, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n", width, height);
+  const size_t size = static_cast<size_t>(width) * height * 4;
+  const bool written = fwrite(rgba.Get(), 1, size, fp) == size;
+  fclose(fp);
+
+  return written;
+}
+
+bool IGraphicsHeadless::ReadImage(const char* path, WDL_TypedBuf<uint8_t>& rgba, int& width, int& height)
+{
+  FILE* fp = fopen(path, "rb");
+
+  if (!fp)
+    return false;
+
+  char line[256];
+  int depth = 0;
+  width = height = 0;
+
+  if (!fgets(line, sizeof(line), fp) || strncmp(line, "P7", 2))
+  {
+    fclose(fp);
+    return false;
+  }
+
+  while (fgets(line, sizeof(line), fp) && strncmp(line, "ENDHDR", 6))
+  {
+    if (!strncmp(line, "WIDTH ", 6))
+      width = atoi(line + 6);
+    else if (!strncmp(line, "HEIGHT ", 7))
+      height = atoi(line + 7);
+    else if (!strncmp(line, "DEPTH ", 6))
+      depth = atoi(line + 6);
+  }
+
+  if (width <= 0 || height <= 0 || depth != 4)
+  {
+    fclose(fp);
+    return false;
+  }
+
+  const size_t size = static_cast<size_t>(width) * height * 4;
+  rgba.Resize(static_cast<int>(size));
+  const bool read = rgba.GetSize() == static_cast<int>(size) && fread(rgba.Get(), 1, size, fp) == size;
+  fclose(fp);
+
+  return read;
+}
+
+int IGraphicsHeadless::CompareImages(const WDL_TypedBuf<uint8_t>& a, const WDL_TypedBuf<uint8_t>& b, int width, int height, int tolerance)
+{
+  const int nPixels = width * height;
+
+  if (a.GetSize() < nPixels * 4 || b.GetSize() < nPixels * 4)
+    return nPixels;
+
+  const uint8_t* pA = a.Get();
+  const uint8_t* pB = b.Get();
+  int nDiffering = 0;
+
+  for (int i = 0; i < nPixels; i++, pA += 4, pB += 4)
+  {
+    for (int c = 0; c < 4; c++)
+    {
+      if (std::abs(pA[c] - pB[c]) > tolerance)
+      {
+        nDiffering++;
+        break;
+      }
+    }
+  }
+
+  return nDiffering;
+}
+
+#pragma mark - Fonts
+
+PlatformFontPtr IGraphicsHeadless::LoadPlatformFont(const char* fontID, const char* fileNameOrResID)
+{
+  WDL_String fullPath;
+  const EResourceLocation fontLocation = LocateResource(fileNameOrResID, "ttf", fullPath, GetBundleID(), nullptr);
+
+  if (fontLocation == kNotFound)
+    return nullptr;
+
+  return PlatformFontPtr(new Font(fontID, fullPath.Get()));
+}
+
+PlatformFontPtr IGraphicsHeadless::LoadPlatformFont(const char* fontID, const char* fontName, ETextStyle style)
+{
+  // results would depend on the fonts installed on the machine, so only fonts loaded from files are supported
+  DBGMSG("IGraphicsHeadless: system font %s is not available, load it from a file\n", fontName);
+  return nullptr;
+}
+
+#ifndef NO_IGRAPHICS
+#if defined IGRAPHICS_LICE
+  #include "IGraphicsLice.cpp"
+#elif defined IGRAPHICS_SKIA
+  #include "IGraphicsSkia.cpp"
+#endif
+#endif
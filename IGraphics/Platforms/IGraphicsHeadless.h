@@ -0,0 +1,109 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+#include "IGraphics_select.h"
+
+#if !defined IGRAPHICS_LICE && !(defined IGRAPHICS_SKIA && defined IGRAPHICS_CPU)
+  #error IGRAPHICS_HEADLESS needs a CPU drawing backend, IGRAPHICS_LICE or IGRAPHICS_SKIA with IGRAPHICS_CPU
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** IGraphics platform class with no window, selected by defining IGRAPHICS_HEADLESS on any OS. It draws into the backend's offscreen surface,
+ * so a UI can be laid out, driven by calling IGraphics::OnMouseDown() etc. and drawn on build agents that have no display, e.g. to time frames
+ * or to compare screenshots against reference images. Nothing is drawn until DrawFrame() is called, there is no frame clock.
+ * Popup menus and text entries use the IGraphics controls, and dialogs return as if they were cancelled
+ * @ingroup PlatformClasses */
+class IGraphicsHeadless final : public IGRAPHICS_DRAW_CLASS
+{
+  class Font;
+public:
+  IGraphicsHeadless(IGEditorDelegate& dlg, int w, int h, int fps, float scale);
+  ~IGraphicsHeadless();
+
+  /** Lay out the UI, as if a window had been opened
+   * @param pParent Ignored
+   * @return The graphics, which stands in for a window handle */
+  void* OpenWindow(void* pParent) override;
+  void CloseWindow() override;
+  bool WindowIsOpen() override { return mOpen; }
+  void* GetWindow() override { return mOpen ? this : nullptr; }
+
+  void EndFrame() override {} // there is nothing to present
+
+  void HideMouseCursor(bool hide, bool lock) override {}
+  void MoveMouseCursor(float x, float y) override {}
+
+  EMsgBoxResult ShowMessageBox(const char* str, const char* caption, EMsgBoxType type, IMsgBoxCompletionHanderFunc completionHandler) override;
+  void ForceEndUserEdit() override {}
+
+  const char* GetPlatformAPIStr() override { return "Headless"; }
+
+  void UpdateTooltips() override {}
+
+  void PromptForFile(WDL_String& fileName, WDL_String& path, EFileAction action, const char* ext) override { fileName.Set(""); }
+  void PromptForDirectory(WDL_String& dir) override { dir.Set(""); }
+  bool PromptForColor(IColor& color, const char* str, IColorPickerHandlerFunc func) override { return false; }
+
+  bool OpenURL(const char* url, const char* msgWindowTitle, const char* confirmMsg, const char* errMsgOnFailure) override { return false; }
+
+  bool GetTextFromClipboard(WDL_String& str) override { str.Set(mClipboardText.Get()); return true; }
+  bool SetTextInClipboard(const WDL_String& str) override { mClipboardText.Set(str.Get()); return true; }
+
+  /** Draw the dirty regions, as the platform classes do on each frame
+   * @return \c true if anything was dirty, in which case GetLastDrawTime() is the time it took */
+  bool DrawFrame();
+
+  /** Mark every control dirty and draw the whole UI */
+  void DrawAll();
+
+  /** @return How long the last frame drawn by DrawFrame() or DrawAll() took, in milliseconds */
+  double GetLastDrawTime() const { return mLastDrawTime; }
+
+  /** Copy what has been drawn so far
+   * @param rgba Filled with width * height unpremultiplied RGBA pixels, with the top row first
+   * @param width Set to the width in pixels, which is the UI's width times the draw and screen scales
+   * @param height Set to the height in pixels */
+  void GetImage(WDL_TypedBuf<uint8_t>& rgba, int& width, int& height);
+
+  /** Write an image to a PAM file (the RGBA variant of the netpbm formats)
+   * @return \c true on success */
+  static bool WriteImage(const char* path, const WDL_TypedBuf<uint8_t>& rgba, int width, int height);
+
+  /** Read an image written by WriteImage()
+   * @return \c true on success */
+  static bool ReadImage(const char* path, WDL_TypedBuf<uint8_t>& rgba, int& width, int& height);
+
+  /** Compare two images of the same size, ignoring the small differences left by antialiasing or by a different version of a backend
+   * @param tolerance The largest difference in any channel for which pixels count as equal
+   * @return The number of pixels that differ */
+  static int CompareImages(const WDL_TypedBuf<uint8_t>& a, const WDL_TypedBuf<uint8_t>& b, int width, int height, int tolerance = 2);
+
+protected:
+  IPopupMenu* CreatePlatformPopupMenu(IPopupMenu& menu, const IRECT& bounds) override { return nullptr; }
+  void CreatePlatformTextEntry(int paramIdx, const IText& text, const IRECT& bounds, int length, const char* str) override {}
+
+private:
+  PlatformFontPtr LoadPlatformFont(const char* fontID, const char* fileNameOrResID) override;
+  PlatformFontPtr LoadPlatformFont(const char* fontID, const char* fontName, ETextStyle style) override;
+  void CachePlatformFont(const char* fontID, const PlatformFontPtr& font) override {}
+
+  void DrawRects(IRECTList& rects);
+
+  bool mOpen = false;
+  double mLastDrawTime = 0.;
+  WDL_String mClipboardText;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
@@ -55,6 +55,7 @@ public:
   bool SetTextInClipboard(const WDL_String& str) override;
 
   void CreatePlatformImGui() override;
+  void RequestFrame() override;
 
   void LaunchBluetoothMidiDialog(float x, float y);
   
@@ -62,6 +63,7 @@ protected:
   PlatformFontPtr LoadPlatformFont(const char* fontID, const char* fileNameOrResID) override;
   PlatformFontPtr LoadPlatformFont(const char* fontID, const char* fontName, ETextStyle style) override;
   void CachePlatformFont(const char* fontID, const PlatformFontPtr& font) override;
+  bool PlatformFontIsCached(const char* fontID) override;
   
   IPopupMenu* CreatePlatformPopupMenu(IPopupMenu& menu, const IRECT& bounds) override;
   void CreatePlatformTextEntry(int paramIdx, const IText& text, const IRECT& bounds, int length, const char* str) override;
@@ -106,6 +106,7 @@ void IGraphicsIOS::CloseWindow()
     [view removeFromSuperview];
     [view release];
     mView = nullptr;
+    SetOccluded(false); // removing the view reports it as occluded
 
     OnViewDestroyed();
   }
@@ -210,6 +211,12 @@ bool IGraphicsIOS::SetTextInClipboard(const WDL_String& str)
   return false;
 }
 
+void IGraphicsIOS::RequestFrame()
+{
+  if (mView && !IsOccluded())
+    ((IGraphicsIOS_View*) mView).displayLink.paused = NO;
+}
+
 void IGraphicsIOS::CreatePlatformImGui()
 {
 #ifdef IGRAPHICS_IMGUI
@@ -239,6 +246,11 @@ void IGraphicsIOS::CachePlatformFont(const char* fontID, const PlatformFontPtr&
   CoreTextHelpers::CachePlatformFont(fontID, font, sFontDescriptorCache);
 }
 
+bool IGraphicsIOS::PlatformFontIsCached(const char* fontID)
+{
+  return CoreTextHelpers::PlatformFontIsCached(fontID, sFontDescriptorCache);
+}
+
 void IGraphicsIOS::LaunchBluetoothMidiDialog(float x, float y)
 {
   ReleaseMouseCapture();
@@ -49,6 +49,7 @@ using namespace igraphics;
   IGraphicsIOS* mGraphics;
   UITextField* mTextField;
   int mTextFieldLength;
+  BOOL mInBackground;
 }
 - (id) initWithIGraphics: (IGraphicsIOS*) pGraphics;
 - (BOOL) isOpaque;
@@ -60,6 +61,9 @@ using namespace igraphics;
 - (void) endUserInput;
 - (void) showMessageBox: (const char*) str : (const char*) caption : (EMsgBoxType) type : (IMsgBoxCompletionHanderFunc) completionHandler;
 - (void) getTouchXY: (CGPoint) pt x: (float*) pX y: (float*) pY;
+- (void) updateOcclusion;
+- (void) didEnterBackground: (NSNotification*) notification;
+- (void) willEnterForeground: (NSNotification*) notification;
 @property (readonly) CAMetalLayer* metalLayer;
 @property (nonatomic, strong) CADisplayLink *displayLink;
 
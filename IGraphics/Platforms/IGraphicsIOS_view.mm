@@ -45,6 +45,12 @@ extern StaticStorage<CoreTextFontDescriptor> sFontDescriptorCache;
   
   [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(keyboardWillShow:) name:UIKeyboardWillShowNotification object:nil];
   [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(keyboardWillBeHidden:) name:UIKeyboardWillHideNotification object:nil];
+
+  // an AUv3's view lives in an extension, which is told about its host app rather than receiving the UIApplication notifications
+  [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(didEnterBackground:) name:UIApplicationDidEnterBackgroundNotification object:nil];
+  [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(willEnterForeground:) name:UIApplicationWillEnterForegroundNotification object:nil];
+  [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(didEnterBackground:) name:NSExtensionHostDidEnterBackgroundNotification object:nil];
+  [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(willEnterForeground:) name:NSExtensionHostWillEnterForegroundNotification object:nil];
   
   return self;
 }
@@ -139,10 +145,42 @@ extern StaticStorage<CoreTextFontDescriptor> sFontDescriptorCache;
 - (void)dealloc
 {
   [_displayLink invalidate];
+  [[NSNotificationCenter defaultCenter] removeObserver:self];
   
   [super dealloc];
 }
 
+- (void) updateOcclusion
+{
+  if (mGraphics)
+    mGraphics->SetOccluded(mInBackground || !self.window || self.hidden);
+}
+
+- (void) didEnterBackground: (NSNotification*) notification
+{
+  mInBackground = YES;
+  [self updateOcclusion];
+}
+
+- (void) willEnterForeground: (NSNotification*) notification
+{
+  mInBackground = NO;
+  [self updateOcclusion];
+}
+
+// hosts may take the view out of their window rather than closing it, e.g. when switching between plug-ins
+- (void) didMoveToWindow
+{
+  [super didMoveToWindow];
+  [self updateOcclusion];
+}
+
+- (void) setHidden: (BOOL) hidden
+{
+  [super setHidden:hidden];
+  [self updateOcclusion];
+}
+
 - (void)didMoveToSuperview
 {
   [super didMoveToSuperview];
@@ -170,6 +208,9 @@ extern StaticStorage<CoreTextFontDescriptor> sFontDescriptorCache;
       mGraphics->SetAllControlsClean();
       mGraphics->Draw(rects);
     }
+
+    // IGraphicsIOS::RequestFrame() resumes it
+    displayLink.paused = !mGraphics->NeedsFrames();
   }
 }
 
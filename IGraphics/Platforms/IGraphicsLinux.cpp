@@ -8,4 +8,1326 @@
  ==============================================================================
 */
 
-//todo
+#include <cmath>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "IGraphicsLinux.h"
+#include "IPlugPaths.h"
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Xatom.h>
+#include <X11/Xresource.h>
+#include <X11/keysym.h>
+#include <X11/cursorfont.h>
+#include <GL/glx.h>
+#include <fontconfig/fontconfig.h>
+
+using namespace iplug;
+using namespace igraphics;
+
+#define IPLUG_DBLCLICK_TIME 400 // ms
+#define IPLUG_DBLCLICK_DISTANCE 4 // pixels
+
+typedef GLXContext (*GLXCreateContextAttribsARBProc)(Display*, GLXFBConfig, GLXContext, Bool, const int*);
+typedef void (*GLXSwapIntervalEXTProc)(Display*, GLXDrawable, int);
+typedef int (*GLXSwapIntervalMESAProc)(unsigned int);
+
+#pragma mark - Private Classes and Structs
+
+// Fonts
+
+class IGraphicsLinux::Font : public PlatformFont
+{
+public:
+  Font(const char* fontName, const char* fontStyle, const char* fontPath, int faceIdx, bool system)
+  : PlatformFont(system), mDescriptor{fontName, fontStyle}, mPath(fontPath), mFaceIdx(faceIdx)
+  {}
+
+  FontDescriptor GetDescriptor() override { return &mDescriptor; }
+  IFontDataPtr GetFontData() override;
+
+private:
+  std::pair<WDL_String, WDL_String> mDescriptor;
+  WDL_String mPath;
+  int mFaceIdx;
+};
+
+IFontDataPtr IGraphicsLinux::Font::GetFontData()
+{
+  IFontDataPtr fontData(new IFontData());
+  FILE* fp = fopen(mPath.Get(), "rb");
+
+  if (!fp)
+    return fontData;
+
+  fseek(fp, 0, SEEK_END);
+  fontData = std::make_unique<IFontData>((int) ftell(fp));
+
+  if (!fontData->GetSize())
+  {
+    fclose(fp);
+    return fontData;
+  }
+
+  fseek(fp, 0, SEEK_SET);
+  size_t readSize = fread(fontData->Get(), 1, fontData->GetSize(), fp);
+  fclose(fp);
+
+  if (readSize && readSize == fontData->GetSize())
+    fontData->SetFaceIdx(mFaceIdx);
+
+  return fontData;
+}
+
+#pragma mark - Utilities
+
+// Runs a helper such as zenity or xdg-open, waits for it to exit and collects what it printed, with the trailing newline removed
+// Returns its exit status, or -1 if it couldn't be started
+static int RunProcess(std::vector<const char*> args, WDL_String* pOutput = nullptr)
+{
+  int fds[2];
+
+  if (pipe(fds))
+    return -1;
+
+  args.push_back(nullptr);
+
+  const pid_t pid = fork();
+
+  if (pid == 0)
+  {
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    execvp(args[0], const_cast<char* const*>(args.data()));
+    _exit(127);
+  }
+
+  close(fds[1]);
+
+  if (pid < 0)
+  {
+    close(fds[0]);
+    return -1;
+  }
+
+  char buf[256];
+  ssize_t n;
+
+  while ((n = read(fds[0], buf, sizeof(buf))) > 0)
+  {
+    if (pOutput)
+      pOutput->Append(buf, static_cast<int>(n));
+  }
+
+  close(fds[0]);
+
+  if (pOutput && pOutput->GetLength() && pOutput->Get()[pOutput->GetLength() - 1] == '\n')
+    pOutput->SetLen(pOutput->GetLength() - 1);
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static int KeySymToVK(KeySym sym)
+{
+  if (sym >= XK_a && sym <= XK_z) return kVK_A + static_cast<int>(sym - XK_a);
+  if (sym >= XK_A && sym <= XK_Z) return kVK_A + static_cast<int>(sym - XK_A);
+  if (sym >= XK_0 && sym <= XK_9) return kVK_0 + static_cast<int>(sym - XK_0);
+  if (sym >= XK_KP_0 && sym <= XK_KP_9) return kVK_NUMPAD0 + static_cast<int>(sym - XK_KP_0);
+  if (sym >= XK_F1 && sym <= XK_F24) return kVK_F1 + static_cast<int>(sym - XK_F1);
+
+  switch (sym)
+  {
+    case XK_BackSpace:    return kVK_BACK;
+    case XK_Tab:          return kVK_TAB;
+    case XK_Clear:        return kVK_CLEAR;
+    case XK_Return:
+    case XK_KP_Enter:     return kVK_RETURN;
+    case XK_Shift_L:
+    case XK_Shift_R:      return kVK_SHIFT;
+    case XK_Control_L:
+    case XK_Control_R:    return kVK_CONTROL;
+    case XK_Alt_L:
+    case XK_Alt_R:        return kVK_MENU;
+    case XK_Pause:        return kVK_PAUSE;
+    case XK_Caps_Lock:    return kVK_CAPITAL;
+    case XK_Escape:       return kVK_ESCAPE;
+    case XK_space:        return kVK_SPACE;
+    case XK_Page_Up:      return kVK_PRIOR;
+    case XK_Page_Down:    return kVK_NEXT;
+    case XK_End:          return kVK_END;
+    case XK_Home:         return kVK_HOME;
+    case XK_Left:         return kVK_LEFT;
+    case XK_Up:           return kVK_UP;
+    case XK_Right:        return kVK_RIGHT;
+    case XK_Down:         return kVK_DOWN;
+    case XK_Select:       return kVK_SELECT;
+    case XK_Print:        return kVK_SNAPSHOT;
+    case XK_Insert:       return kVK_INSERT;
+    case XK_Delete:       return kVK_DELETE;
+    case XK_Help:         return kVK_HELP;
+    case XK_Super_L:      return kVK_LWIN;
+    case XK_KP_Multiply:  return kVK_MULTIPLY;
+    case XK_KP_Add:       return kVK_ADD;
+    case XK_KP_Separator: return kVK_SEPARATOR;
+    case XK_KP_Subtract:  return kVK_SUBTRACT;
+    case XK_KP_Decimal:   return kVK_DECIMAL;
+    case XK_KP_Divide:    return kVK_DIVIDE;
+    case XK_Num_Lock:     return kVK_NUMLOCK;
+    case XK_Scroll_Lock:  return kVK_SCROLL;
+    default:              return kVK_NONE;
+  }
+}
+
+// Finds the file of an installed font with fontconfig, failing if the best match is from another family
+static bool FindSystemFont(const char* fontName, ETextStyle style, WDL_String& path, int& faceIdx)
+{
+  if (!FcInit())
+    return false;
+
+  const int weight = style == ETextStyle::Bold ? FC_WEIGHT_BOLD : FC_WEIGHT_REGULAR;
+  const int slant = style == ETextStyle::Italic ? FC_SLANT_ITALIC : FC_SLANT_ROMAN;
+
+  FcPattern* pPattern = FcPatternBuild(nullptr, FC_FAMILY, FcTypeString, fontName, FC_WEIGHT, FcTypeInteger, weight,
+                                       FC_SLANT, FcTypeInteger, slant, nullptr);
+  if (!pPattern)
+    return false;
+
+  FcConfigSubstitute(nullptr, pPattern, FcMatchPattern);
+  FcDefaultSubstitute(pPattern);
+
+  FcResult result;
+  FcPattern* pMatch = FcFontMatch(nullptr, pPattern, &result);
+  bool found = false;
+
+  if (pMatch)
+  {
+    FcChar8* pFamily = nullptr;
+    FcChar8* pFile = nullptr;
+
+    if (FcPatternGetString(pMatch, FC_FAMILY, 0, &pFamily) == FcResultMatch && !strcasecmp(reinterpret_cast<const char*>(pFamily), fontName)
+        && FcPatternGetString(pMatch, FC_FILE, 0, &pFile) == FcResultMatch)
+    {
+      path.Set(reinterpret_cast<const char*>(pFile));
+
+      if (FcPatternGetInteger(pMatch, FC_INDEX, 0, &faceIdx) != FcResultMatch)
+        faceIdx = 0;
+
+      found = true;
+    }
+
+    FcPatternDestroy(pMatch);
+  }
+
+  FcPatternDestroy(pPattern);
+
+  return found;
+}
+
+static bool HasGLXExtension(Display* pDisplay, const char* name)
+{
+  const char* pExtensions = glXQueryExtensionsString(pDisplay, DefaultScreen(pDisplay));
+
+  if (!pExtensions)
+    return false;
+
+  const size_t len = strlen(name);
+
+  for (const char* p = strstr(pExtensions, name); p; p = strstr(p + len, name))
+  {
+    if ((p == pExtensions || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\0'))
+      return true;
+  }
+
+  return false;
+}
+
+#pragma mark -
+
+IGraphicsLinux::IGraphicsLinux(IGEditorDelegate& dlg, int w, int h, int fps, float scale)
+: IGRAPHICS_DRAW_CLASS(dlg, w, h, fps, scale)
+{
+}
+
+IGraphicsLinux::~IGraphicsLinux()
+{
+  CloseWindow();
+}
+
+int IGraphicsLinux::GetScaleForDisplay() const
+{
+  double dpi = 96.0;
+  const char* pResources = XResourceManagerString(mDisplay);
+
+  if (pResources)
+  {
+    XrmInitialize();
+    XrmDatabase db = XrmGetStringDatabase(pResources);
+    char* pType = nullptr;
+    XrmValue value;
+
+    if (db && XrmGetResource(db, "Xft.dpi", "Xft.Dpi", &pType, &value) && value.addr)
+      dpi = atof(value.addr);
+
+    if (db)
+      XrmDestroyDatabase(db);
+  }
+
+  return std::max(1, static_cast<int>(std::round(dpi / 96.0)));
+}
+
+inline IMouseInfo IGraphicsLinux::GetMouseInfo(int x, int y, unsigned int state)
+{
+  const float scale = GetDrawScale() * GetScreenScale();
+
+  IMouseInfo info;
+  info.x = mCursorX = x / scale;
+  info.y = mCursorY = y / scale;
+  info.ms = IMouseMod(state & Button1Mask, state & Button3Mask, state & ShiftMask, state & ControlMask, state & Mod1Mask);
+  return info;
+}
+
+void* IGraphicsLinux::OpenWindow(void* pParent)
+{
+  if (mWindow)
+    CloseWindow();
+
+  mDisplay = XOpenDisplay(nullptr);
+
+  if (!mDisplay)
+    return nullptr;
+
+  const int screen = DefaultScreen(mDisplay);
+  mParentWindow = pParent ? reinterpret_cast<Window>(pParent) : RootWindow(mDisplay, screen);
+
+  const int fbAttributes[] =
+  {
+    GLX_X_RENDERABLE, True,
+    GLX_DRAWABLE_TYPE, GLX_WINDOW_BIT,
+    GLX_RENDER_TYPE, GLX_RGBA_BIT,
+    GLX_X_VISUAL_TYPE, GLX_TRUE_COLOR,
+    GLX_RED_SIZE, 8,
+    GLX_GREEN_SIZE, 8,
+    GLX_BLUE_SIZE, 8,
+    GLX_ALPHA_SIZE, 8,
+    GLX_DEPTH_SIZE, 24,
+    GLX_STENCIL_SIZE, 8,
+    GLX_DOUBLEBUFFER, True,
+    0
+  };
+
+  int numConfigs = 0;
+  GLXFBConfig* pConfigs = glXChooseFBConfig(mDisplay, screen, fbAttributes, &numConfigs);
+  XVisualInfo* pVisual = pConfigs && numConfigs ? glXGetVisualFromFBConfig(mDisplay, pConfigs[0]) : nullptr;
+
+  if (!pVisual)
+  {
+    DBGMSG("No GLX framebuffer config\n");
+
+    if (pConfigs)
+      XFree(pConfigs);
+
+    XCloseDisplay(mDisplay);
+    mDisplay = nullptr;
+    return nullptr;
+  }
+
+  const int screenScale = GetScaleForDisplay();
+
+  mColormap = XCreateColormap(mDisplay, mParentWindow, pVisual->visual, AllocNone);
+
+  XSetWindowAttributes attributes = {};
+  attributes.colormap = mColormap;
+  attributes.border_pixel = 0;
+  attributes.event_mask = ExposureMask | StructureNotifyMask | ButtonPressMask | ButtonReleaseMask | PointerMotionMask
+                        | LeaveWindowMask | KeyPressMask | KeyReleaseMask | FocusChangeMask;
+
+  mWindow = XCreateWindow(mDisplay, mParentWindow, 0, 0, WindowWidth() * screenScale, WindowHeight() * screenScale, 0,
+                          pVisual->depth, InputOutput, pVisual->visual, CWColormap | CWBorderPixel | CWEventMask, &attributes);
+
+  XFree(pVisual);
+
+  mClipboardAtom = XInternAtom(mDisplay, "CLIPBOARD", False);
+  mUTF8Atom = XInternAtom(mDisplay, "UTF8_STRING", False);
+  mTargetsAtom = XInternAtom(mDisplay, "TARGETS", False);
+  mPropertyAtom = XInternAtom(mDisplay, "IPLUG_SELECTION", False);
+  mDeleteWindowAtom = XInternAtom(mDisplay, "WM_DELETE_WINDOW", False);
+
+  if (!pParent)
+  {
+    Atom deleteWindowAtom = mDeleteWindowAtom;
+    XSetWMProtocols(mDisplay, mWindow, &deleteWindowAtom, 1);
+  }
+
+  // an empty 1x1 bitmap, for hiding the cursor
+  const char emptyData[1] = { 0 };
+  XColor black = {};
+  Pixmap emptyPixmap = XCreateBitmapFromData(mDisplay, mWindow, emptyData, 1, 1);
+  mBlankCursor = XCreatePixmapCursor(mDisplay, emptyPixmap, emptyPixmap, &black, &black, 0, 0);
+  XFreePixmap(mDisplay, emptyPixmap);
+
+  XMapWindow(mDisplay, mWindow);
+  XFlush(mDisplay);
+
+  const bool glOK = CreateGLContext(pConfigs[0]);
+  XFree(pConfigs);
+
+  if (!glOK)
+  {
+    DBGMSG("Error creating GLX context\n");
+    CloseWindow();
+    return nullptr;
+  }
+
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+  StartFrameClock();
+#endif
+
+  // there are no native text entries or menus to fall back on
+  AttachPopupMenuControl();
+  AttachTextEntryControl();
+
+  SetPlatformContext(mDisplay);
+
+  // GPU resources are created with the context current
+  ActivateGLContext();
+
+  OnViewInitialized(mGLXContext);
+
+  SetScreenScale(screenScale); // resizes draw context
+
+  GetDelegate()->LayoutUI(this);
+
+  SetAllControlsDirty();
+
+  DeactivateGLContext();
+
+  GetDelegate()->OnUIOpen();
+
+  return reinterpret_cast<void*>(mWindow);
+}
+
+void IGraphicsLinux::CloseWindow()
+{
+  if (mWindow)
+  {
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+    StopFrameClock();
+#endif
+
+    if (mGLXContext)
+    {
+      ActivateGLContext(); // GPU resources must be freed with the context current
+      OnViewDestroyed();
+      DeactivateGLContext();
+      DestroyGLContext();
+    }
+
+    SetPlatformContext(nullptr);
+
+    if (mCursor)
+      XFreeCursor(mDisplay, mCursor);
+
+    if (mBlankCursor)
+      XFreeCursor(mDisplay, mBlankCursor);
+
+    XDestroyWindow(mDisplay, mWindow);
+    XFreeColormap(mDisplay, mColormap);
+    XCloseDisplay(mDisplay);
+
+    mCursor = mBlankCursor = 0;
+    mColormap = 0;
+    mWindow = 0;
+    mParentWindow = 0;
+    mDisplay = nullptr;
+    mExposedRects.Clear();
+    mClipboardText.Set("");
+  }
+}
+
+void IGraphicsLinux::PlatformResize(bool parentHasResized)
+{
+  if (WindowIsOpen())
+  {
+    // the host resizes its own window when the delegate asks it to, via EditorResize()
+    XResizeWindow(mDisplay, mWindow, WindowWidth() * GetScreenScale(), WindowHeight() * GetScreenScale());
+    XFlush(mDisplay);
+  }
+}
+
+void IGraphicsLinux::DrawResize()
+{
+  ActivateGLContext();
+  IGRAPHICS_DRAW_CLASS::DrawResize();
+  DeactivateGLContext();
+}
+
+#pragma mark - GL context
+
+bool IGraphicsLinux::CreateGLContext(void* pFBConfig)
+{
+  GLXFBConfig config = static_cast<GLXFBConfig>(pFBConfig);
+  GLXContext context = nullptr;
+
+#if defined IGRAPHICS_GL3
+  auto createContextAttribs = (GLXCreateContextAttribsARBProc) glXGetProcAddressARB((const GLubyte*) "glXCreateContextAttribsARB");
+
+  if (createContextAttribs)
+  {
+    const int contextAttributes[] =
+    {
+      GLX_CONTEXT_MAJOR_VERSION_ARB, 3,
+      GLX_CONTEXT_MINOR_VERSION_ARB, 2,
+      GLX_CONTEXT_PROFILE_MASK_ARB, GLX_CONTEXT_CORE_PROFILE_BIT_ARB,
+      0
+    };
+
+    context = createContextAttribs(mDisplay, config, nullptr, True, contextAttributes);
+  }
+#else
+  context = glXCreateNewContext(mDisplay, config, GLX_RGBA_TYPE, nullptr, True);
+#endif
+
+  if (!context)
+    return false;
+
+  mGLXContext = context;
+
+  ActivateGLContext();
+
+  // without the GL functions nothing can be drawn, so the context is destroyed rather than handed to OnViewInitialized()
+  if (!gladLoadGL())
+  {
+    DBGMSG("Error initializing glad\n");
+    DeactivateGLContext();
+    DestroyGLContext();
+    return false;
+  }
+
+  glGetError();
+
+  // the buffer swap waits for the vertical blank, which paces the frame clock to the display
+  if (HasGLXExtension(mDisplay, "GLX_EXT_swap_control"))
+  {
+    auto swapInterval = (GLXSwapIntervalEXTProc) glXGetProcAddressARB((const GLubyte*) "glXSwapIntervalEXT");
+    if (swapInterval)
+      swapInterval(mDisplay, mWindow, 1);
+  }
+  else if (HasGLXExtension(mDisplay, "GLX_MESA_swap_control"))
+  {
+    auto swapInterval = (GLXSwapIntervalMESAProc) glXGetProcAddressARB((const GLubyte*) "glXSwapIntervalMESA");
+    if (swapInterval)
+      swapInterval(1);
+  }
+
+  DeactivateGLContext();
+
+  // the back buffer's age says whether it still holds the previous frame, in which case only the dirty regions are composited
+  mHasBufferAge = HasGLXExtension(mDisplay, "GLX_EXT_buffer_age");
+  mBufferAge = -1;
+
+  return true;
+}
+
+void IGraphicsLinux::DestroyGLContext()
+{
+  if (glXGetCurrentContext() == static_cast<GLXContext>(mGLXContext))
+    glXMakeCurrent(mDisplay, 0, nullptr);
+
+  glXDestroyContext(mDisplay, static_cast<GLXContext>(mGLXContext));
+  mGLXContext = nullptr;
+}
+
+void IGraphicsLinux::ActivateGLContext()
+{
+  if (mGLContextDepth++ > 0 || !mGLXContext)
+    return;
+
+  mStartDisplay = glXGetCurrentDisplay();
+  mStartDrawable = glXGetCurrentDrawable();
+  mStartGLXContext = glXGetCurrentContext();
+  glXMakeCurrent(mDisplay, mWindow, static_cast<GLXContext>(mGLXContext));
+}
+
+void IGraphicsLinux::DeactivateGLContext()
+{
+  if (--mGLContextDepth > 0 || !mGLXContext)
+    return;
+
+  // return current ctxt to start
+  if (mStartGLXContext)
+    glXMakeCurrent(mStartDisplay, mStartDrawable, static_cast<GLXContext>(mStartGLXContext));
+  else
+    glXMakeCurrent(mDisplay, 0, nullptr);
+
+  mStartDisplay = nullptr;
+  mStartDrawable = 0;
+  mStartGLXContext = nullptr;
+}
+
+#pragma mark - Events and frames
+
+int IGraphicsLinux::GetEventFD() const
+{
+  return mDisplay ? ConnectionNumber(mDisplay) : -1;
+}
+
+int IGraphicsLinux::GetFrameFD() const
+{
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+  return mFramePipe[0];
+#else
+  return -1;
+#endif
+}
+
+void IGraphicsLinux::ProcessEvents()
+{
+  while (mDisplay && XPending(mDisplay))
+  {
+    XEvent event;
+    XNextEvent(mDisplay, &event);
+    HandleEvent(event);
+  }
+}
+
+void IGraphicsLinux::OnFrame()
+{
+  if (!WindowIsOpen())
+    return;
+
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+  char buf[16];
+  while (read(mFramePipe[0], buf, sizeof(buf)) > 0) {}
+
+  mFramePosted = false;
+
+  if (!NeedsFrames() && !mExposedRects.Size())
+    PauseFrameClock();
+#endif
+
+  IRECTList rects;
+
+  if (IsDirty(rects))
+    SetAllControlsClean();
+
+  // exposed regions are in pixels
+  for (int i = 0; i < mExposedRects.Size(); i++)
+  {
+    IRECT r = mExposedRects.Get(i);
+    r.Scale(1.f / (GetDrawScale() * GetScreenScale()));
+    r.PixelAlign();
+    rects.Add(r);
+  }
+
+  mExposedRects.Clear();
+
+  if (!rects.Size())
+    return;
+
+  ActivateGLContext();
+
+#ifdef IGRAPHICS_NANOVG
+  if (mHasBufferAge)
+  {
+    unsigned int age = 0;
+    glXQueryDrawable(mDisplay, mWindow, GLX_BACK_BUFFER_AGE_EXT, &age);
+
+    if ((static_cast<int>(age) == 1) != (mBufferAge == 1))
+      SetBackbufferPreserved(age == 1);
+
+    mBufferAge = static_cast<int>(age);
+  }
+#endif
+
+  Draw(rects);
+
+  glXSwapBuffers(mDisplay, mWindow);
+  DeactivateGLContext();
+}
+
+void IGraphicsLinux::HandleEvent(XEvent& event)
+{
+  if (event.xany.window != mWindow)
+    return;
+
+  switch (event.type)
+  {
+    case Expose:
+    {
+      mExposedRects.Add(IRECT(event.xexpose.x, event.xexpose.y, event.xexpose.x + event.xexpose.width, event.xexpose.y + event.xexpose.height));
+
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+      RequestFrame();
+#endif
+      break;
+    }
+    case ButtonPress:
+    {
+      const unsigned int button = event.xbutton.button;
+
+      if (button == Button4 || button == Button5)
+      {
+        IMouseInfo info = GetMouseInfo(event.xbutton.x, event.xbutton.y, event.xbutton.state);
+        OnMouseWheel(info.x, info.y, info.ms, button == Button4 ? 1.f : -1.f);
+        break;
+      }
+
+      if (button > Button3)
+        break;
+
+      XSetInputFocus(mDisplay, mWindow, RevertToParent, CurrentTime);
+
+      // the state is from before the press, so it doesn't include this button
+      IMouseInfo info = GetMouseInfo(event.xbutton.x, event.xbutton.y, event.xbutton.state | (Button1Mask << (button - 1)));
+
+      const bool dblClick = button == Button1 && mLastClickTime && event.xbutton.time - mLastClickTime < IPLUG_DBLCLICK_TIME
+                            && std::abs(event.xbutton.x - mLastClickX) <= IPLUG_DBLCLICK_DISTANCE
+                            && std::abs(event.xbutton.y - mLastClickY) <= IPLUG_DBLCLICK_DISTANCE;
+
+      if (dblClick)
+      {
+        mLastClickTime = 0;
+        OnMouseDblClick(info.x, info.y, info.ms);
+      }
+      else
+      {
+        if (button == Button1)
+        {
+          mLastClickTime = event.xbutton.time;
+          mLastClickX = event.xbutton.x;
+          mLastClickY = event.xbutton.y;
+        }
+
+        OnMouseDown(info.x, info.y, info.ms);
+      }
+      break;
+    }
+    case ButtonRelease:
+    {
+      if (event.xbutton.button > Button3)
+        break;
+
+      IMouseInfo info = GetMouseInfo(event.xbutton.x, event.xbutton.y, event.xbutton.state);
+      OnMouseUp(info.x, info.y, info.ms);
+      break;
+    }
+    case MotionNotify:
+    {
+      // only the latest position matters
+      while (XCheckTypedWindowEvent(mDisplay, mWindow, MotionNotify, &event)) {}
+
+      if (event.xmotion.state & (Button1Mask | Button3Mask))
+      {
+        if (IsInTextEntry())
+          break;
+
+        const float oldX = mCursorX;
+        const float oldY = mCursorY;
+        IMouseInfo info = GetMouseInfo(event.xmotion.x, event.xmotion.y, event.xmotion.state);
+        const float dX = info.x - oldX;
+        const float dY = info.y - oldY;
+
+        if (dX || dY)
+        {
+          OnMouseDrag(info.x, info.y, dX, dY, info.ms);
+
+          if (mCursorLock)
+            MoveMouseCursor(mHiddenCursorX, mHiddenCursorY);
+        }
+      }
+      else
+      {
+        IMouseInfo info = GetMouseInfo(event.xmotion.x, event.xmotion.y, event.xmotion.state);
+        OnMouseOver(info.x, info.y, info.ms);
+      }
+      break;
+    }
+    case LeaveNotify:
+    {
+      OnMouseOut();
+      break;
+    }
+    case KeyPress:
+    case KeyRelease:
+    {
+      char latin1[8] = {};
+      KeySym sym = 0;
+      const int len = XLookupString(&event.xkey, latin1, sizeof(latin1) - 1, &sym, nullptr);
+      const unsigned char c = len == 1 ? static_cast<unsigned char>(latin1[0]) : 0;
+
+      // XLookupString() gives Latin-1, which is a single UTF-8 code unit below 0x80 and two above it
+      char utf8[3] = {};
+
+      if (c >= 0x20 && c < 0x80)
+        utf8[0] = static_cast<char>(c);
+      else if (c >= 0xA0)
+      {
+        utf8[0] = static_cast<char>(0xC0 | (c >> 6));
+        utf8[1] = static_cast<char>(0x80 | (c & 0x3F));
+      }
+
+      const unsigned int state = event.xkey.state;
+      IKeyPress keyPress { utf8, KeySymToVK(XLookupKeysym(&event.xkey, 0)),
+                           static_cast<bool>(state & ShiftMask),
+                           static_cast<bool>(state & ControlMask),
+                           static_cast<bool>(state & Mod1Mask) };
+
+      const bool handled = event.type == KeyPress ? OnKeyDown(mCursorX, mCursorY, keyPress) : OnKeyUp(mCursorX, mCursorY, keyPress);
+
+      // pass on what we don't use, so the host's shortcuts keep working while the editor has focus
+      if (!handled && mParentWindow != RootWindow(mDisplay, DefaultScreen(mDisplay)))
+      {
+        event.xkey.window = mParentWindow;
+        XSendEvent(mDisplay, mParentWindow, True, event.type == KeyPress ? KeyPressMask : KeyReleaseMask, &event);
+      }
+      break;
+    }
+    case SelectionRequest:
+    {
+      HandleSelectionRequest(event);
+      break;
+    }
+    case SelectionClear:
+    {
+      mClipboardText.Set("");
+      break;
+    }
+    case ClientMessage:
+    {
+      if (static_cast<unsigned long>(event.xclient.data.l[0]) == mDeleteWindowAtom)
+        CloseWindow();
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+void IGraphicsLinux::StartFrameClock()
+{
+  if (pipe2(mFramePipe, O_NONBLOCK | O_CLOEXEC))
+  {
+    mFramePipe[0] = mFramePipe[1] = -1;
+    return;
+  }
+
+  mFrameClockQuit = false;
+  mFrameClockRunning = true;
+  mFramePosted = false;
+  mFrameClockThread = std::thread(&IGraphicsLinux::FrameClockThread, this);
+}
+
+void IGraphicsLinux::StopFrameClock()
+{
+  if (mFrameClockThread.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(mFrameClockMutex);
+      mFrameClockQuit = true;
+    }
+
+    mFrameClockCV.notify_one();
+    mFrameClockThread.join();
+  }
+
+  for (int& fd : mFramePipe)
+  {
+    if (fd >= 0)
+      close(fd);
+
+    fd = -1;
+  }
+}
+
+void IGraphicsLinux::PauseFrameClock()
+{
+  std::lock_guard<std::mutex> lock(mFrameClockMutex);
+  mFrameClockRunning = false;
+}
+
+void IGraphicsLinux::RequestFrame()
+{
+  {
+    std::lock_guard<std::mutex> lock(mFrameClockMutex);
+
+    if (mFrameClockRunning)
+      return;
+
+    mFrameClockRunning = true;
+  }
+
+  mFrameClockCV.notify_one();
+}
+
+void IGraphicsLinux::FrameClockThread()
+{
+  const auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / FPS()));
+  auto nextFrameTime = std::chrono::steady_clock::now();
+
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mFrameClockMutex);
+      mFrameClockCV.wait(lock, [this]() { return mFrameClockRunning || mFrameClockQuit; });
+
+      if (mFrameClockQuit)
+        return;
+    }
+
+    // after a pause, start again from now rather than catching up
+    const auto now = std::chrono::steady_clock::now();
+    nextFrameTime = std::max(nextFrameTime + interval, now);
+    std::this_thread::sleep_until(nextFrameTime);
+
+    // skip the frame if the UI thread has not handled the previous one yet
+    if (!mFramePosted.exchange(true))
+    {
+      const char c = 0;
+      if (write(mFramePipe[1], &c, 1) != 1)
+        mFramePosted = false;
+    }
+  }
+}
+#endif
+
+#pragma mark - Mouse cursor
+
+void IGraphicsLinux::HideMouseCursor(bool hide, bool lock)
+{
+  if (mCursorHidden == hide || !WindowIsOpen())
+    return;
+
+  if (hide)
+  {
+    mHiddenCursorX = mCursorX;
+    mHiddenCursorY = mCursorY;
+
+    XDefineCursor(mDisplay, mWindow, mBlankCursor);
+    mCursorHidden = true;
+    mCursorLock = lock && !mTabletInput;
+  }
+  else
+  {
+    if (mCursorLock)
+      MoveMouseCursor(mHiddenCursorX, mHiddenCursorY);
+
+    XDefineCursor(mDisplay, mWindow, mCursor);
+    mCursorHidden = false;
+    mCursorLock = false;
+  }
+
+  XFlush(mDisplay);
+}
+
+void IGraphicsLinux::MoveMouseCursor(float x, float y)
+{
+  if (mTabletInput || !WindowIsOpen())
+    return;
+
+  const float scale = GetDrawScale() * GetScreenScale();
+
+  XWarpPointer(mDisplay, 0, mWindow, 0, 0, 0, 0, static_cast<int>(std::round(x * scale)), static_cast<int>(std::round(y * scale)));
+  XFlush(mDisplay);
+
+  mCursorX = x;
+  mCursorY = y;
+
+  if (mCursorHidden && !mCursorLock)
+  {
+    mHiddenCursorX = x;
+    mHiddenCursorY = y;
+  }
+}
+
+ECursor IGraphicsLinux::SetMouseCursor(ECursor cursorType)
+{
+  if (WindowIsOpen())
+  {
+    unsigned int shape;
+
+    switch (cursorType)
+    {
+      case ECursor::ARROW:            shape = XC_left_ptr;            break;
+      case ECursor::IBEAM:            shape = XC_xterm;               break;
+      case ECursor::WAIT:             shape = XC_watch;               break;
+      case ECursor::CROSS:            shape = XC_crosshair;           break;
+      case ECursor::UPARROW:          shape = XC_sb_up_arrow;         break;
+      case ECursor::SIZENWSE:         shape = XC_bottom_right_corner; break;
+      case ECursor::SIZENESW:         shape = XC_bottom_left_corner;  break;
+      case ECursor::SIZEWE:           shape = XC_sb_h_double_arrow;   break;
+      case ECursor::SIZENS:           shape = XC_sb_v_double_arrow;   break;
+      case ECursor::SIZEALL:          shape = XC_fleur;               break;
+      case ECursor::INO:              shape = XC_X_cursor;            break;
+      case ECursor::HAND:             shape = XC_hand2;               break;
+      case ECursor::APPSTARTING:      shape = XC_watch;               break;
+      case ECursor::HELP:             shape = XC_question_arrow;      break;
+      default:                        shape = XC_left_ptr;
+    }
+
+    if (mCursor)
+      XFreeCursor(mDisplay, mCursor);
+
+    mCursor = XCreateFontCursor(mDisplay, shape);
+
+    if (!mCursorHidden)
+      XDefineCursor(mDisplay, mWindow, mCursor);
+
+    XFlush(mDisplay);
+  }
+
+  return IGraphics::SetMouseCursor(cursorType);
+}
+
+#pragma mark - Dialogs
+
+EMsgBoxResult IGraphicsLinux::ShowMessageBox(const char* str, const char* caption, EMsgBoxType type, IMsgBoxCompletionHanderFunc completionHandler)
+{
+  ReleaseMouseCapture();
+
+  WDL_String title, text, output;
+  title.SetFormatted(1024, "--title=%s", caption ? caption : "");
+  text.SetFormatted(4096, "--text=%s", str ? str : "");
+
+  std::vector<const char*> args { "zenity", title.Get(), text.Get(), "--no-markup" };
+  EMsgBoxResult yes = kOK, no = kCANCEL;
+
+  switch (type)
+  {
+    case kMB_OK:
+      args.push_back("--info");
+      break;
+    case kMB_OKCANCEL:
+      args.insert(args.end(), { "--question", "--ok-label=OK", "--cancel-label=Cancel" });
+      break;
+    case kMB_YESNOCANCEL:
+      args.insert(args.end(), { "--question", "--ok-label=Yes", "--cancel-label=No", "--extra-button=Cancel" });
+      yes = kYES;
+      no = kNO;
+      break;
+    case kMB_YESNO:
+      args.insert(args.end(), { "--question", "--ok-label=Yes", "--cancel-label=No" });
+      yes = kYES;
+      no = kNO;
+      break;
+    case kMB_RETRYCANCEL:
+      args.insert(args.end(), { "--question", "--ok-label=Retry", "--cancel-label=Cancel" });
+      yes = kRETRY;
+      break;
+  }
+
+  const int status = RunProcess(args, &output);
+  EMsgBoxResult result;
+
+  if (status == 0)
+    result = yes;
+  else if (type == kMB_OK)
+    result = kOK;
+  else if (!strcmp(output.Get(), "Cancel")) // zenity prints the label of an extra button
+    result = kCANCEL;
+  else
+    result = no;
+
+  if (completionHandler)
+    completionHandler(result);
+
+  return result;
+}
+
+void IGraphicsLinux::PromptForFile(WDL_String& fileName, WDL_String& path, EFileAction action, const char* ext)
+{
+  if (!WindowIsOpen())
+  {
+    fileName.Set("");
+    return;
+  }
+
+  WDL_String initial, filter, output;
+  initial.SetFormatted(4096, "--filename=%s/%s", path.Get(), fileName.Get());
+
+  std::vector<const char*> args { "zenity", "--file-selection", initial.Get() };
+
+  if (action == EFileAction::Save)
+    args.insert(args.end(), { "--save", "--confirm-overwrite" });
+
+  if (CStringHasContents(ext))
+  {
+    // "wav aif" becomes "--file-filter=*.wav *.aif"
+    filter.Set("--file-filter=");
+
+    for (const char* p = ext; *p; p++)
+    {
+      if (p == ext || p[-1] == ' ')
+        filter.Append("*.");
+
+      filter.Append(p, 1);
+    }
+
+    args.push_back(filter.Get());
+  }
+
+  if (RunProcess(args, &output) == 0 && output.GetLength())
+  {
+    fileName.Set(output.Get());
+
+    const char* pSlash = strrchr(output.Get(), '/');
+    if (pSlash)
+      path.Set(output.Get(), static_cast<int>(pSlash - output.Get()) + 1);
+  }
+  else
+  {
+    fileName.Set("");
+  }
+
+  ReleaseMouseCapture();
+}
+
+void IGraphicsLinux::PromptForDirectory(WDL_String& dir)
+{
+  WDL_String output;
+
+  if (RunProcess({ "zenity", "--file-selection", "--directory" }, &output) == 0 && output.GetLength())
+  {
+    dir.Set(output.Get());
+    dir.Append("/");
+  }
+  else
+  {
+    dir.Set("");
+  }
+
+  ReleaseMouseCapture();
+}
+
+bool IGraphicsLinux::PromptForColor(IColor& color, const char* str, IColorPickerHandlerFunc func)
+{
+  ReleaseMouseCapture();
+
+  if (!WindowIsOpen())
+    return false;
+
+  WDL_String title, initial, output;
+  title.SetFormatted(1024, "--title=%s", str ? str : "");
+  initial.SetFormatted(64, "--color=rgb(%d,%d,%d)", color.R, color.G, color.B);
+
+  if (RunProcess({ "zenity", "--color-selection", title.Get(), initial.Get() }, &output) != 0)
+    return false;
+
+  // zenity prints rgb(r,g,b), or rgba(r,g,b,a) when the alpha was changed
+  int r, g, b;
+
+  if (sscanf(output.Get(), "rgb(%d,%d,%d)", &r, &g, &b) != 3 && sscanf(output.Get(), "rgba(%d,%d,%d", &r, &g, &b) != 3)
+    return false;
+
+  color.R = r;
+  color.G = g;
+  color.B = b;
+
+  if (func)
+    func(color);
+
+  return true;
+}
+
+IPopupMenu* IGraphicsLinux::CreatePlatformPopupMenu(IPopupMenu& menu, const IRECT& bounds)
+{
+  // OpenWindow() attaches an IPopupMenuControl, which is used instead
+  return nullptr;
+}
+
+void IGraphicsLinux::CreatePlatformTextEntry(int paramIdx, const IText& text, const IRECT& bounds, int length, const char* str)
+{
+  // OpenWindow() attaches an ITextEntryControl, which is used instead
+}
+
+#pragma mark - Shell
+
+bool IGraphicsLinux::RevealPathInExplorerOrFinder(WDL_String& path, bool select)
+{
+  if (!path.GetLength())
+    return false;
+
+  if (select)
+  {
+    // file managers that implement org.freedesktop.FileManager1 can select the item, otherwise fall back to opening its folder
+    WDL_String item;
+    item.SetFormatted(4096, "array:string:file://%s", path.Get());
+
+    if (RunProcess({ "dbus-send", "--session", "--dest=org.freedesktop.FileManager1", "--type=method_call", "/org/freedesktop/FileManager1",
+                     "org.freedesktop.FileManager1.ShowItems", item.Get(), "string:" }) == 0)
+      return true;
+
+    WDL_String dir(path.Get());
+    char* pSlash = strrchr(dir.Get(), '/');
+    if (pSlash)
+      *pSlash = '\0';
+
+    return RunProcess({ "xdg-open", dir.Get() }) == 0;
+  }
+
+  return RunProcess({ "xdg-open", path.Get() }) == 0;
+}
+
+bool IGraphicsLinux::OpenURL(const char* url, const char* msgWindowTitle, const char* confirmMsg, const char* errMsgOnFailure)
+{
+  if (confirmMsg && ShowMessageBox(confirmMsg, msgWindowTitle, kMB_YESNO, nullptr) != kYES)
+    return false;
+
+  if (RunProcess({ "xdg-open", url }) == 0)
+    return true;
+
+  if (errMsgOnFailure)
+    ShowMessageBox(errMsgOnFailure, msgWindowTitle, kMB_OK, nullptr);
+
+  return false;
+}
+
+#pragma mark - Clipboard
+
+bool IGraphicsLinux::GetTextFromClipboard(WDL_String& str)
+{
+  str.Set("");
+
+  if (!WindowIsOpen())
+    return false;
+
+  if (XGetSelectionOwner(mDisplay, mClipboardAtom) == mWindow)
+  {
+    str.Set(mClipboardText.Get());
+    return str.GetLength();
+  }
+
+  XConvertSelection(mDisplay, mClipboardAtom, mUTF8Atom, mPropertyAtom, mWindow, CurrentTime);
+  XFlush(mDisplay);
+
+  // the owner answers asynchronously, so wait a little for its SelectionNotify, handling anything else that arrives meanwhile
+  XEvent event;
+  bool notified = false;
+
+  for (int i = 0; i < 100 && !notified; i++)
+  {
+    if (XCheckTypedWindowEvent(mDisplay, mWindow, SelectionNotify, &event))
+      notified = true;
+    else
+      usleep(5000);
+  }
+
+  if (!notified || event.xselection.property == 0)
+    return false;
+
+  Atom type;
+  int format;
+  unsigned long numItems, bytesLeft;
+  unsigned char* pData = nullptr;
+
+  if (XGetWindowProperty(mDisplay, mWindow, mPropertyAtom, 0, ~0L, True, AnyPropertyType, &type, &format, &numItems, &bytesLeft, &pData) == Success && pData)
+  {
+    if (type == mUTF8Atom || type == XA_STRING)
+      str.Set(reinterpret_cast<const char*>(pData), static_cast<int>(numItems));
+
+    XFree(pData);
+  }
+
+  return str.GetLength();
+}
+
+bool IGraphicsLinux::SetTextInClipboard(const WDL_String& str)
+{
+  if (!WindowIsOpen())
+    return false;
+
+  // X has no clipboard storage, the text is served to other clients from HandleSelectionRequest() while we own the selection
+  mClipboardText.Set(str.Get());
+  XSetSelectionOwner(mDisplay, mClipboardAtom, mWindow, CurrentTime);
+  XFlush(mDisplay);
+
+  return XGetSelectionOwner(mDisplay, mClipboardAtom) == mWindow && str.GetLength() > 0;
+}
+
+void IGraphicsLinux::HandleSelectionRequest(XEvent& event)
+{
+  const XSelectionRequestEvent& request = event.xselectionrequest;
+
+  XEvent reply = {};
+  reply.xselection.type = SelectionNotify;
+  reply.xselection.requestor = request.requestor;
+  reply.xselection.selection = request.selection;
+  reply.xselection.target = request.target;
+  reply.xselection.time = request.time;
+  reply.xselection.property = 0;
+
+  if (request.target == mTargetsAtom)
+  {
+    const Atom targets[] = { static_cast<Atom>(mTargetsAtom), static_cast<Atom>(mUTF8Atom), XA_STRING };
+    XChangeProperty(mDisplay, request.requestor, request.property, XA_ATOM, 32, PropModeReplace,
+                    reinterpret_cast<const unsigned char*>(targets), 3);
+    reply.xselection.property = request.property;
+  }
+  else if (request.target == mUTF8Atom || request.target == XA_STRING)
+  {
+    XChangeProperty(mDisplay, request.requestor, request.property, request.target, 8, PropModeReplace,
+                    reinterpret_cast<const unsigned char*>(mClipboardText.Get()), mClipboardText.GetLength());
+    reply.xselection.property = request.property;
+  }
+
+  XSendEvent(mDisplay, request.requestor, False, 0, &reply);
+  XFlush(mDisplay);
+}
+
+#pragma mark - Fonts
+
+PlatformFontPtr IGraphicsLinux::LoadPlatformFont(const char* fontID, const char* fileNameOrResID)
+{
+  WDL_String fullPath;
+  const EResourceLocation fontLocation = LocateResource(fileNameOrResID, "ttf", fullPath, GetBundleID(), nullptr);
+
+  if (fontLocation == kNotFound)
+    return nullptr;
+
+  return PlatformFontPtr(new Font(fontID, "", fullPath.Get(), 0, false));
+}
+
+PlatformFontPtr IGraphicsLinux::LoadPlatformFont(const char* fontID, const char* fontName, ETextStyle style)
+{
+  WDL_String path;
+  int faceIdx = 0;
+
+  if (!FindSystemFont(fontName, style, path, faceIdx))
+    return nullptr;
+
+  return PlatformFontPtr(new Font(fontName, TextStyleString(style), path.Get(), faceIdx, true));
+}
+
+// Xlib's macros clash with names in the drawing classes
+#undef None
+#undef Bool
+#undef Status
+#undef Always
+#undef Success
+#undef True
+#undef False
+
+#ifndef NO_IGRAPHICS
+#if defined IGRAPHICS_SKIA
+  #include "IGraphicsSkia.cpp"
+  #include "glad.c"
+#elif defined IGRAPHICS_NANOVG
+  #include "IGraphicsNanoVG.cpp"
+#ifdef IGRAPHICS_FREETYPE
+#define FONS_USE_FREETYPE
+#endif
+  #include "nanovg.c"
+  #include "glad.c"
+#else
+  #error Define IGRAPHICS_NANOVG or IGRAPHICS_SKIA, with IGRAPHICS_GL2 or IGRAPHICS_GL3, when using IGraphicsLinux
+#endif
+#endif
@@ -10,49 +10,147 @@
 
 #pragma once
 
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
 #include "IGraphics_select.h"
 
+// Xlib's headers define macros such as None and Bool that clash with IGraphics, so they are only included in IGraphicsLinux.cpp
+struct _XDisplay;
+union _XEvent;
+
 BEGIN_IPLUG_NAMESPACE
 BEGIN_IGRAPHICS_NAMESPACE
 
-/** IGraphics platform class for linux
-*   @ingroup PlatformClasses
-*/
+/** IGraphics platform class for Linux, using an X11 child window with a GLX context.
+ * A plug-in on Linux doesn't own the event loop, so the wrapper registers GetEventFD() and GetFrameFD() with the host's run loop
+ * (e.g. VST3's Steinberg::Linux::IRunLoop) and calls ProcessEvents() and OnFrame() when they are readable. A wrapper that only has a timer
+ * can call both from it at FPS().
+ * Frames are drawn like on Windows and macOS: only the dirty and exposed regions are redrawn, on a frame clock that pauses while nothing is dirty,
+ * and the buffer swap waits for the vertical blank where the driver supports swap control. Drawing needs IGRAPHICS_GL2 or IGRAPHICS_GL3
+ * @ingroup PlatformClasses */
 class IGraphicsLinux final : public IGRAPHICS_DRAW_CLASS
 {
+  class Font;
 public:
   IGraphicsLinux(IGEditorDelegate& dlg, int w, int h, int fps, float scale);
-  virtual ~IGraphicsLinux);
+  ~IGraphicsLinux();
 
-  void* OpenWindow(void* pWindow) override;
+  void* OpenWindow(void* pParent) override;
   void CloseWindow() override;
-  bool WindowIsOpen() override;
+  bool WindowIsOpen() override { return mWindow; }
+  void* GetWindow() override { return reinterpret_cast<void*>(mWindow); }
   void PlatformResize(bool parentHasResized) override;
 
-  void HideMouseCursor() override;
-  void ShowMouseCursor() override;
+  void DrawResize() override; // overriden here to deal with GL graphics context capture
+
+  void HideMouseCursor(bool hide, bool lock) override;
+  void MoveMouseCursor(float x, float y) override;
+  ECursor SetMouseCursor(ECursor cursorType) override;
 
   EMsgBoxResult ShowMessageBox(const char* str, const char* caption, EMsgBoxType type, IMsgBoxCompletionHanderFunc completionHandler) override;
-  void ForceEndUserEdit() override;
+  void ForceEndUserEdit() override {}
 
-  const char* GetPlatformAPIStr() override;
+  const char* GetPlatformAPIStr() override { return "X11"; }
 
-  void UpdateTooltips() override;
+  void UpdateTooltips() override {}
 
   bool RevealPathInExplorerOrFinder(WDL_String& path, bool select) override;
-  void PromptForFile(WDL_String& fileName, WDL_String& path, EFileAction action,  const char* ext, IColorPickerHandlerFunc func) override;
-  bool PromptForColor(IColor& color, const char* str) override;
+  void PromptForFile(WDL_String& fileName, WDL_String& path, EFileAction action, const char* ext) override;
+  void PromptForDirectory(WDL_String& dir) override;
+  bool PromptForColor(IColor& color, const char* str, IColorPickerHandlerFunc func) override;
 
   bool OpenURL(const char* url, const char* msgWindowTitle, const char* confirmMsg, const char* errMsgOnFailure) override;
 
-  static int GetUserOSVersion();
   bool GetTextFromClipboard(WDL_String& str) override;
-  bool SetTextInClipboard(const WDL_String& str) override { return false; } // TODO
+  bool SetTextInClipboard(const WDL_String& str) override;
+
+  /** @return The file descriptor of the X connection, which is readable when ProcessEvents() has events to handle, or -1 if the window isn't open */
+  int GetEventFD() const;
+
+  /** @return The file descriptor that the frame clock writes to when a frame is due, which is readable when OnFrame() should be called, or -1 */
+  int GetFrameFD() const;
+
+  /** Handle the pending X events, on the main thread */
+  void ProcessEvents();
+
+  /** Draw the dirty and exposed regions, on the main thread, when GetFrameFD() is readable or from a timer */
+  void OnFrame();
 
 protected:
-  IPopupMenu* CreatePlatformPopupMenu(const IPopupMenu& menu, IRECT& bounds) override;
+  IPopupMenu* CreatePlatformPopupMenu(IPopupMenu& menu, const IRECT& bounds) override;
   void CreatePlatformTextEntry(int paramIdx, const IText& text, const IRECT& bounds, int length, const char* str) override;
-}
+
+private:
+  PlatformFontPtr LoadPlatformFont(const char* fontID, const char* fileNameOrResID) override;
+  PlatformFontPtr LoadPlatformFont(const char* fontID, const char* fontName, ETextStyle style) override;
+  void CachePlatformFont(const char* fontID, const PlatformFontPtr& font) override {}
+  bool PlatformFontIsCached(const char* fontID) override { return true; }
+
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+  void RequestFrame() override;
+  void StartFrameClock();
+  void StopFrameClock();
+  void PauseFrameClock();
+  void FrameClockThread();
+#endif
+
+  void HandleEvent(_XEvent& event);
+  void HandleSelectionRequest(_XEvent& event);
+  IMouseInfo GetMouseInfo(int x, int y, unsigned int state);
+  int GetScaleForDisplay() const;
+
+  bool CreateGLContext(void* pFBConfig);
+  void DestroyGLContext();
+
+  // Captures the previously current GLX context, for restoring, and makes ours current. Calls can nest, only the outermost one captures
+  void ActivateGLContext();
+  // Restores the previous GLX context, once the outermost ActivateGLContext() is matched
+  void DeactivateGLContext();
+
+  void* mGLXContext = nullptr;
+  void* mStartGLXContext = nullptr;
+  _XDisplay* mStartDisplay = nullptr;
+  unsigned long mStartDrawable = 0;
+  int mGLContextDepth = 0;
+  int mBufferAge = -1; // the age of the back buffer in the last frame, from GLX_EXT_buffer_age, 1 if it held the previous frame
+  bool mHasBufferAge = false;
+
+  _XDisplay* mDisplay = nullptr;
+  unsigned long mWindow = 0;
+  unsigned long mParentWindow = 0;
+  unsigned long mColormap = 0;
+  unsigned long mCursor = 0;
+  unsigned long mBlankCursor = 0;
+  unsigned long mClipboardAtom = 0;
+  unsigned long mUTF8Atom = 0;
+  unsigned long mTargetsAtom = 0;
+  unsigned long mPropertyAtom = 0;
+  unsigned long mDeleteWindowAtom = 0;
+  unsigned long mLastClickTime = 0;
+  int mLastClickX = 0;
+  int mLastClickY = 0;
+  float mHiddenCursorX = 0.f;
+  float mHiddenCursorY = 0.f;
+
+  IRECTList mExposedRects; // the regions the X server asked us to redraw, in pixels
+  WDL_String mClipboardText; // the text we hold while we own the CLIPBOARD selection
+
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+  // a thread that writes to mFramePipe once per refresh, paused while nothing is dirty
+  std::thread mFrameClockThread;
+  std::mutex mFrameClockMutex;
+  std::condition_variable mFrameClockCV;
+  std::atomic<bool> mFramePosted {false};
+  int mFramePipe[2] = { -1, -1 };
+  bool mFrameClockRunning = false;
+  bool mFrameClockQuit = false;
+#endif
+};
 
 END_IGRAPHICS_NAMESPACE
 END_IPLUG_NAMESPACE
@@ -72,6 +72,7 @@ public:
 
 protected:
   void CreatePlatformImGui() override;
+  void RequestFrame() override;
 
   IPopupMenu* CreatePlatformPopupMenu(IPopupMenu& menu, const IRECT& bounds) override;
   void CreatePlatformTextEntry(int paramIdx, const IText& text, const IRECT& bounds, int length, const char* str) override;
@@ -79,6 +80,7 @@ private:
   PlatformFontPtr LoadPlatformFont(const char* fontID, const char* fileNameOrResID) override;
   PlatformFontPtr LoadPlatformFont(const char* fontID, const char* fontName, ETextStyle style) override;
   void CachePlatformFont(const char* fontID, const PlatformFontPtr& font) override;
+  bool PlatformFontIsCached(const char* fontID) override;
 
   void RepositionCursor(CGPoint point);
   void StoreCursorPosition();
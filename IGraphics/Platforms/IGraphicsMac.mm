@@ -87,6 +87,11 @@ void IGraphicsMac::CachePlatformFont(const char* fontID, const PlatformFontPtr&
   CoreTextHelpers::CachePlatformFont(fontID, font, sFontDescriptorCache);
 }
 
+bool IGraphicsMac::PlatformFontIsCached(const char* fontID)
+{
+  return CoreTextHelpers::PlatformFontIsCached(fontID, sFontDescriptorCache);
+}
+
 void IGraphicsMac::MeasureText(const IText& text, const char* str, IRECT& bounds) const
 {
 #ifdef IGRAPHICS_LICE
@@ -131,6 +136,8 @@ void IGraphicsMac::CloseWindow()
 {
   if (mView)
   {
+    SetOccluded(false);
+
 #ifdef IGRAPHICS_IMGUI
     if(mImGuiView)
     {
@@ -622,6 +629,14 @@ void IGraphicsMac::CreatePlatformImGui()
 #endif
 }
 
+void IGraphicsMac::RequestFrame()
+{
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+  if (mView && !IsOccluded())
+    [(IGRAPHICS_VIEW*) mView startFrameClock];
+#endif
+}
+
 #ifdef IGRAPHICS_AGG
   #include "IGraphicsAGG.cpp"
 #elif defined IGRAPHICS_CAIRO
@@ -14,6 +14,12 @@
 #import <QuartzCore/QuartzCore.h>
 #endif
 
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+#import <CoreVideo/CoreVideo.h>
+#include <atomic>
+#include <unordered_map>
+#endif
+
 #include "IGraphicsMac.h"
 #include "IGraphicsStructs.h"
 
@@ -80,12 +86,16 @@ END_IPLUG_NAMESPACE
 using namespace iplug;
 using namespace igraphics;
 
-@interface IGRAPHICS_MENU : NSMenu
+// Kept between pop ups, and filled when it opens if the IPopupMenu's version has changed
+@interface IGRAPHICS_MENU : NSMenu <NSMenuDelegate>
 {
-  IPopupMenu* mIPopupMenu;
+  IPopupMenu* mIPopupMenu; // only dereferenced while a menu it is in is open
+  uint32_t mVersion; // the version of mIPopupMenu it was filled from, 0 if it hasn't been
+  NSView* mReceiver;
 }
 - (id) initWithIPopupMenuAndReciever:(IPopupMenu*)pMenu : (NSView*)pView;
 - (IPopupMenu*) iPopupMenu;
+- (void) refresh;
 @end
 
 // Dummy view class used to receive Menu Events inline
@@ -95,6 +105,7 @@ using namespace igraphics;
 }
 - (void) onMenuSelection:(id)sender;
 - (NSMenuItem*) menuItem;
+- (void) reset;
 @end
 
 @interface IGRAPHICS_TEXTFIELD : NSTextField
@@ -107,11 +118,19 @@ using namespace igraphics;
 {
   NSTrackingArea* mTrackingArea;
   NSTimer* mTimer;
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+  CVDisplayLinkRef mDisplayLink;
+  std::atomic<bool> mFramePending;
+  double mFrameInterval;
+  double mLastFrameTime;
+#endif
   IGRAPHICS_TEXTFIELD* mTextFieldView;
   NSCursor* mMoveCursor;
   float mPrevX, mPrevY;
   IRECTList mDirtyRects;
   IColorPickerHandlerFunc mColorPickerFunc;
+  IGRAPHICS_MENU_RCVR* mMenuReceiver;
+  std::unordered_map<IPopupMenu*, IGRAPHICS_MENU*> mPopupMenus; // the menus that have been popped up, retained
 @public
   IGraphicsMac* mGraphics; // OBJC instance variables have to be pointers
 }
@@ -124,7 +143,18 @@ using namespace igraphics;
 - (void) drawRect: (NSRect) bounds;
 - (void) render;
 - (void) onTimer: (NSTimer*) pTimer;
+- (void) onFrame;
 - (void) killTimer;
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+- (void) onDisplayLink: (const CVTimeStamp*) pOutputTime;
+- (void) startFrameClock;
+- (void) updateDisplayLinkScreen;
+- (void) windowDidChangeScreen: (NSNotification*) notification;
+#endif
+- (void) updateOcclusion;
+- (void) windowDidChangeOcclusionState: (NSNotification*) notification;
+- (void) viewDidHide;
+- (void) viewDidUnhide;
 //mouse
 - (void) getMouseXY: (NSEvent*) pEvent x: (float&) pX y: (float&) pY;
 - (IMouseInfo) getMouseLeft: (NSEvent*) pEvent;
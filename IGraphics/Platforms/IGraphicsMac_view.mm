@@ -145,6 +145,11 @@ static int MacKeyEventToVK(NSEvent* pEvent, int& flag)
   nsMenuItem = sender;
 }
 
+- (void)reset
+{
+  nsMenuItem = nil;
+}
+
 @end
 
 @implementation IGRAPHICS_MENU
@@ -152,13 +157,60 @@ static int MacKeyEventToVK(NSEvent* pEvent, int& flag)
 - (id)initWithIPopupMenuAndReciever:(IPopupMenu*)pMenu : (NSView*)pView
 {
   [self initWithTitle: @""];
+  [self setAutoenablesItems:NO];
+  [self setDelegate:self];
 
-  NSMenuItem* nsMenuItem;
-  NSMutableString* nsMenuItemTitle;
+  mIPopupMenu = pMenu;
+  mVersion = 0;
+  mReceiver = pView;
 
-  [self setAutoenablesItems:NO];
+  return self;
+}
+
+- (void)menuNeedsUpdate:(NSMenu*)menu
+{
+  [self refresh];
+}
+
+- (void)refresh
+{
+  IPopupMenu* pMenu = mIPopupMenu;
+  const int numItems = pMenu->NItems();
+
+  if (mVersion == pMenu->GetVersion())
+  {
+    // the items are the same, only their states may have changed
+    for (int i = 0; i < numItems; ++i)
+    {
+      IPopupMenu::Item* pMenuItem = pMenu->GetItem(i);
+
+      if (!pMenuItem->GetSubmenu() && !pMenuItem->GetIsSeparator())
+      {
+        NSMenuItem* nsMenuItem = [self itemAtIndex:i];
+        [nsMenuItem setState:pMenuItem->GetChecked() ? NSOnState : NSOffState];
+        [nsMenuItem setEnabled:pMenuItem->GetEnabled() ? YES : NO];
+      }
+    }
+
+    return;
+  }
+
+  // the submenus that are still in the menu are kept with their items, and filled again when they open if they have changed
+  std::unordered_map<IPopupMenu*, IGRAPHICS_MENU*> oldSubmenus;
+
+  for (NSMenuItem* nsMenuItem in [self itemArray])
+  {
+    if ([nsMenuItem hasSubmenu])
+    {
+      IGRAPHICS_MENU* subMenu = (IGRAPHICS_MENU*) [nsMenuItem submenu];
+      oldSubmenus[[subMenu iPopupMenu]] = [subMenu retain];
+    }
+  }
 
-  int numItems = pMenu->NItems();
+  [self removeAllItems];
+
+  NSMenuItem* nsMenuItem;
+  NSMutableString* nsMenuItemTitle;
 
   for (int i = 0; i < numItems; ++i)
   {
@@ -184,7 +236,18 @@ static int MacKeyEventToVK(NSEvent* pEvent, int& flag)
     if (pMenuItem->GetSubmenu())
     {
       nsMenuItem = [self addItemWithTitle:nsMenuItemTitle action:nil keyEquivalent:@""];
-      NSMenu* subMenu = [[IGRAPHICS_MENU alloc] initWithIPopupMenuAndReciever:pMenuItem->GetSubmenu() :pView];
+
+      IGRAPHICS_MENU* subMenu;
+      auto old = oldSubmenus.find(pMenuItem->GetSubmenu());
+
+      if (old != oldSubmenus.end())
+      {
+        subMenu = old->second;
+        oldSubmenus.erase(old);
+      }
+      else
+        subMenu = [[IGRAPHICS_MENU alloc] initWithIPopupMenuAndReciever:pMenuItem->GetSubmenu() :mReceiver];
+
       [self setSubmenu: subMenu forItem:nsMenuItem];
       [subMenu release];
     }
@@ -194,7 +257,7 @@ static int MacKeyEventToVK(NSEvent* pEvent, int& flag)
     {
       nsMenuItem = [self addItemWithTitle:nsMenuItemTitle action:@selector(onMenuSelection:) keyEquivalent:@""];
       
-      [nsMenuItem setTarget:pView];
+      [nsMenuItem setTarget:mReceiver];
       
       if (pMenuItem->GetIsTitle ())
         [nsMenuItem setIndentationLevel:1];
@@ -212,9 +275,10 @@ static int MacKeyEventToVK(NSEvent* pEvent, int& flag)
     }
   }
 
-  mIPopupMenu = pMenu;
+  for (auto& old : oldSubmenus)
+    [old.second release];
 
-  return self;
+  mVersion = pMenu->GetVersion();
 }
 
 - (IPopupMenu*)iPopupMenu
@@ -443,6 +507,14 @@ static int MacKeyEventToVK(NSEvent* pEvent, int& flag)
 
 extern StaticStorage<CoreTextFontDescriptor> sFontDescriptorCache;
 
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+static CVReturn DisplayLinkCallback(CVDisplayLinkRef displayLink, const CVTimeStamp* pNow, const CVTimeStamp* pOutputTime, CVOptionFlags flagsIn, CVOptionFlags* pFlagsOut, void* pContext)
+{
+  [(IGRAPHICS_VIEW*) pContext onDisplayLink: pOutputTime];
+  return kCVReturnSuccess;
+}
+#endif
+
 @implementation IGRAPHICS_VIEW
 
 - (id) initWithIGraphics: (IGraphicsMac*) pGraphics
@@ -470,14 +542,38 @@ extern StaticStorage<CoreTextFontDescriptor> sFontDescriptorCache;
   [self registerForDraggedTypes:[NSArray arrayWithObjects: NSFilenamesPboardType, nil]];
 
   double sec = 1.0 / (double) pGraphics->FPS();
-  mTimer = [NSTimer timerWithTimeInterval:sec target:self selector:@selector(onTimer:) userInfo:nil repeats:YES];
-  [[NSRunLoop currentRunLoop] addTimer: mTimer forMode: (NSString*) kCFRunLoopCommonModes];
+
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+  // frames are driven by the display's refresh, and the display link is stopped while nothing is dirty
+  mDisplayLink = nullptr;
+  mFramePending = false;
+  mFrameInterval = sec;
+  mLastFrameTime = 0.;
+
+  if (CVDisplayLinkCreateWithActiveCGDisplays(&mDisplayLink) == kCVReturnSuccess)
+  {
+    CVDisplayLinkSetOutputCallback(mDisplayLink, DisplayLinkCallback, self);
+    CVDisplayLinkStart(mDisplayLink);
+  }
+  else
+    mDisplayLink = nullptr;
+  
+  if (!mDisplayLink)
+#endif
+  {
+    mTimer = [NSTimer timerWithTimeInterval:sec target:self selector:@selector(onTimer:) userInfo:nil repeats:YES];
+    [[NSRunLoop currentRunLoop] addTimer: mTimer forMode: (NSString*) kCFRunLoopCommonModes];
+  }
 
   return self;
 }
 
 - (void)dealloc
 {  
+  for (auto& menu : mPopupMenus)
+    [menu.second release];
+
+  [mMenuReceiver release];
   [mMoveCursor release];
   [mTrackingArea release];
   [[NSNotificationCenter defaultCenter] removeObserver:self];
@@ -518,6 +614,20 @@ extern StaticStorage<CoreTextFontDescriptor> sFontDescriptorCache;
     if (mGraphics)
       mGraphics->SetScreenScale(newScale);
     
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+    [self updateDisplayLinkScreen];
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(windowDidChangeScreen:)
+                                                 name:NSWindowDidChangeScreenNotification
+                                               object:pWindow];
+#endif
+
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(windowDidChangeOcclusionState:)
+                                                 name:NSWindowDidChangeOcclusionStateNotification
+                                               object:pWindow];
+    [self updateOcclusion];
+
     #ifdef IGRAPHICS_METAL
     [[NSNotificationCenter defaultCenter] addObserver:self
                                              selector:@selector(frameDidChange:)
@@ -596,12 +706,28 @@ extern StaticStorage<CoreTextFontDescriptor> sFontDescriptorCache;
   for (int i = 0; i < mDirtyRects.Size(); i++)
     [self setNeedsDisplayInRect:ToNSRect(mGraphics, mDirtyRects.Get(i))];
 #else
-  // so just draw on each frame, if something is dirty
-  mGraphics->Draw(mDirtyRects);
+  // so the dirty regions are drawn into the backend's retained surface, which is then presented as a whole. The GL layer is
+  // also redisplayed by the system, e.g. on resize or when the window is revealed, and then only the last frame is needed
+  if (!mDirtyRects.Size() && mGraphics->IsDirty(mDirtyRects))
+    mGraphics->SetAllControlsClean();
+
+  if (mDirtyRects.Size())
+  {
+    mGraphics->Draw(mDirtyRects);
+    mDirtyRects.Clear();
+  }
+  else
+    mGraphics->PresentLastFrame();
 #endif
 }
 
 - (void) onTimer: (NSTimer*) pTimer
+{
+  if (!mGraphics->IsOccluded())
+    [self onFrame];
+}
+
+- (void) onFrame
 {
   mDirtyRects.Clear();
   
@@ -615,6 +741,87 @@ extern StaticStorage<CoreTextFontDescriptor> sFontDescriptorCache;
     [self render];
 #endif
   }
+
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+  // IGraphicsMac::RequestFrame() restarts it
+  if (mDisplayLink && !mGraphics->NeedsFrames())
+    CVDisplayLinkStop(mDisplayLink);
+#endif
+}
+
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+// called on the display link's thread
+- (void) onDisplayLink: (const CVTimeStamp*) pOutputTime
+{
+  const double time = pOutputTime->videoTimeScale ? (double) pOutputTime->videoTime / (double) pOutputTime->videoTimeScale : 0.;
+
+  // keep to FPS() on displays that refresh faster, allowing for jitter in the refresh period
+  if (time - mLastFrameTime < mFrameInterval * 0.9)
+    return;
+
+  mLastFrameTime = time;
+
+  // skip the refresh if the main thread has not drawn the previous one yet
+  if (mFramePending.exchange(true))
+    return;
+
+  dispatch_async(dispatch_get_main_queue(), ^{
+    mFramePending = false;
+
+    if (mDisplayLink && mGraphics)
+      [self onFrame];
+  });
+}
+
+- (void) startFrameClock
+{
+  if (mDisplayLink && !CVDisplayLinkIsRunning(mDisplayLink))
+  {
+    mLastFrameTime = 0.;
+    CVDisplayLinkStart(mDisplayLink);
+  }
+}
+
+- (void) updateDisplayLinkScreen
+{
+  NSScreen* pScreen = [[self window] screen];
+
+  if (mDisplayLink && pScreen)
+  {
+    NSNumber* pScreenNumber = [[pScreen deviceDescription] objectForKey:@"NSScreenNumber"];
+    CVDisplayLinkSetCurrentCGDisplay(mDisplayLink, (CGDirectDisplayID) [pScreenNumber unsignedIntValue]);
+  }
+}
+
+- (void) windowDidChangeScreen: (NSNotification*) notification
+{
+  [self updateDisplayLinkScreen];
+}
+#endif
+
+- (void) updateOcclusion
+{
+  NSWindow* pWindow = [self window];
+
+  if (mGraphics && pWindow)
+    mGraphics->SetOccluded(!([pWindow occlusionState] & NSWindowOcclusionStateVisible) || [self isHiddenOrHasHiddenAncestor]);
+}
+
+// minimized, on another space, or entirely covered by other windows
+- (void) windowDidChangeOcclusionState: (NSNotification*) notification
+{
+  [self updateOcclusion];
+}
+
+// some hosts hide the view rather than closing it, e.g. when switching tabs
+- (void) viewDidHide
+{
+  [self updateOcclusion];
+}
+
+- (void) viewDidUnhide
+{
+  [self updateOcclusion];
 }
 
 - (void) getMouseXY: (NSEvent*) pEvent x: (float&) pX y: (float&) pY
@@ -953,6 +1160,15 @@ static void MakeCursorFromName(NSCursor*& cursor, const char *name)
 
 - (void) killTimer
 {
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+  if (mDisplayLink)
+  {
+    CVDisplayLinkStop(mDisplayLink);
+    CVDisplayLinkRelease(mDisplayLink);
+    mDisplayLink = nullptr;
+  }
+#endif
+
   [mTimer invalidate];
   mTimer = 0;
 }
@@ -982,13 +1198,38 @@ static void MakeCursorFromName(NSCursor*& cursor, const char *name)
 
 - (IPopupMenu*) createPopupMenu: (IPopupMenu&) menu : (NSRect) bounds;
 {
-  IGRAPHICS_MENU_RCVR* pDummyView = [[[IGRAPHICS_MENU_RCVR alloc] initWithFrame:bounds] autorelease];
-  NSMenu* pNSMenu = [[[IGRAPHICS_MENU alloc] initWithIPopupMenuAndReciever:&menu : pDummyView] autorelease];
+  // the native menus are kept and only refilled when the IPopupMenu changes, submenus are filled as they open
+  if (!mMenuReceiver)
+    mMenuReceiver = [[IGRAPHICS_MENU_RCVR alloc] initWithFrame:NSZeroRect];
+
+  [mMenuReceiver reset];
+
+  auto cached = mPopupMenus.find(&menu);
+  IGRAPHICS_MENU* pNSMenu;
+
+  if (cached != mPopupMenus.end())
+    pNSMenu = cached->second;
+  else
+  {
+    if (mPopupMenus.size() >= 16)
+    {
+      for (auto& old : mPopupMenus)
+        [old.second release];
+
+      mPopupMenus.clear();
+    }
+
+    pNSMenu = [[IGRAPHICS_MENU alloc] initWithIPopupMenuAndReciever:&menu : mMenuReceiver];
+    mPopupMenus[&menu] = pNSMenu;
+  }
+
+  [pNSMenu refresh];
+
   NSPoint wp = {bounds.origin.x, bounds.origin.y - 4};
 
   [pNSMenu popUpMenuPositioningItem:nil atLocation:wp inView:self];
   
-  NSMenuItem* pChosenItem = [pDummyView menuItem];
+  NSMenuItem* pChosenItem = [mMenuReceiver menuItem];
   NSMenu* pChosenMenu = [pChosenItem menu];
   IPopupMenu* pIPopupMenu = [(IGRAPHICS_MENU*) pChosenMenu iPopupMenu];
 
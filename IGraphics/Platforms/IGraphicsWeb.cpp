@@ -716,8 +716,11 @@ void IGraphicsWeb::DrawResize()
   canvas["style"].set("width", val(Width() * GetDrawScale()));
   canvas["style"].set("height", val(Height() * GetDrawScale()));
   
+#ifndef IGRAPHICS_CANVAS
+  // IGraphicsCanvas sizes the canvas itself, as it may belong to a worker
   canvas.set("width", Width() * GetBackingPixelScale());
   canvas.set("height", Height() * GetBackingPixelScale());
+#endif
   
   IGRAPHICS_DRAW_CLASS::DrawResize();
 }
@@ -82,6 +82,7 @@ private:
   PlatformFontPtr LoadPlatformFont(const char* fontID, const char* fileNameOrResID) override;
   PlatformFontPtr LoadPlatformFont(const char* fontID, const char* fontName, ETextStyle style) override;
   void CachePlatformFont(const char* fontID, const PlatformFontPtr& font) override {}
+  bool PlatformFontIsCached(const char* fontID) override { return true; }
 };
 
 END_IGRAPHICS_NAMESPACE
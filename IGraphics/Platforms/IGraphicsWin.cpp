@@ -21,6 +21,9 @@
 
 #include <wininet.h>
 
+#include <dwmapi.h>
+#pragma comment(lib, "dwmapi.lib")
+
 using namespace iplug;
 using namespace igraphics;
 
@@ -34,6 +37,9 @@ static double sFPS = 0.0;
 
 #define PARAM_EDIT_ID 99
 #define IPLUG_TIMER_ID 2
+#define IPLUG_OCCLUSION_TIMER_ID 3
+#define IPLUG_OCCLUSION_CHECK_MS 250
+#define IPLUG_FRAME_MSG (WM_APP + 0x100)
 #define IPLUG_WIN_MAX_WIDE_PATH 4096
 
 #pragma mark - Private Classes and Structs
@@ -135,6 +141,7 @@ StaticStorage<IGraphicsWin::HFontHolder> IGraphicsWin::sHFontCache;
 
 // DPI helper
 UINT(WINAPI *__GetDpiForWindow)(HWND);
+HRESULT(WINAPI *__GetDpiForMonitor)(HMONITOR, int, UINT*, UINT*);
 
 // Mouse and tablet helpers
 static int GetScaleForWindow(HWND hWnd)
@@ -149,6 +156,35 @@ static int GetScaleForWindow(HWND hWnd)
   return 1;
 }
 
+// The distinct scales of the connected monitors, from their effective DPI (MDT_EFFECTIVE_DPI)
+static std::vector<int> GetMonitorScales()
+{
+  std::vector<int> scales;
+
+  if (!__GetDpiForMonitor)
+    return scales;
+
+  auto enumProc = [](HMONITOR hMonitor, HDC, LPRECT, LPARAM lParam) -> BOOL
+  {
+    std::vector<int>& scales = *reinterpret_cast<std::vector<int>*>(lParam);
+    UINT dpiX = USER_DEFAULT_SCREEN_DPI, dpiY = USER_DEFAULT_SCREEN_DPI;
+
+    if (SUCCEEDED(__GetDpiForMonitor(hMonitor, 0, &dpiX, &dpiY)))
+    {
+      const int scale = std::max(1, static_cast<int>(std::round(static_cast<double>(dpiX) / USER_DEFAULT_SCREEN_DPI)));
+
+      if (std::find(scales.begin(), scales.end(), scale) == scales.end())
+        scales.push_back(scale);
+    }
+
+    return TRUE;
+  };
+
+  EnumDisplayMonitors(NULL, NULL, enumProc, reinterpret_cast<LPARAM>(&scales));
+
+  return scales;
+}
+
 #pragma mark -
 
 inline IMouseInfo IGraphicsWin::GetMouseInfo(LPARAM lParam, WPARAM wParam)
@@ -215,8 +251,12 @@ LRESULT CALLBACK IGraphicsWin::WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
   {
     LPCREATESTRUCT lpcs = (LPCREATESTRUCT) lParam;
     SetWindowLongPtr(hWnd, GWLP_USERDATA, (LPARAM) (lpcs->lpCreateParams));
+#ifdef IGRAPHICS_NO_DISPLAY_SYNC
     int mSec = static_cast<int>(std::round(1000.0 / (sFPS)));
     SetTimer(hWnd, IPLUG_TIMER_ID, mSec, NULL);
+#endif
+    // a child window isn't sent WM_ACTIVATE or WM_SIZE when the host's window is minimized, so its state is polled
+    SetTimer(hWnd, IPLUG_OCCLUSION_TIMER_ID, IPLUG_OCCLUSION_CHECK_MS, NULL);
     SetFocus(hWnd); // gets scroll wheel working straight away
     DragAcceptFiles(hWnd, true);
     return 0;
@@ -245,10 +285,27 @@ LRESULT CALLBACK IGraphicsWin::WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
   
   switch (msg)
   {
+    case IPLUG_FRAME_MSG:
     case WM_TIMER:
     {
-      if (wParam == IPLUG_TIMER_ID)
+      if (msg == WM_TIMER && wParam == IPLUG_OCCLUSION_TIMER_ID)
+      {
+        pGraphics->CheckOcclusion();
+        return 0;
+      }
+
+      if (msg == IPLUG_FRAME_MSG || wParam == IPLUG_TIMER_ID)
       {
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+        pGraphics->mFramePosted = false;
+        // the edit box is polled for commits on each frame, so the clock keeps running while it is open
+        if (!pGraphics->NeedsFrames() && !pGraphics->mParamEditWnd)
+          pGraphics->PauseFrameClock();
+#endif
+
+        if (pGraphics->IsOccluded() && !pGraphics->mParamEditWnd)
+          return 0;
+
         if (pGraphics->mParamEditWnd && pGraphics->mParamEditMsg != kNone)
         {
           switch (pGraphics->mParamEditMsg)
@@ -271,6 +328,14 @@ LRESULT CALLBACK IGraphicsWin::WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
           return 0; // TODO: check this!
         }
 
+        // a monitor connected since the window opened is cached for as soon as the window reaches it, before its scale applies
+        HMONITOR monitor = MonitorFromWindow(hWnd, MONITOR_DEFAULTTONEAREST);
+        if (monitor != pGraphics->mMonitor)
+        {
+          pGraphics->mMonitor = monitor;
+          pGraphics->PrescaleBitmapsForMonitors();
+        }
+
         int scale = GetScaleForWindow(pGraphics->mPlugWnd);
         if (scale != pGraphics->GetScreenScale())
           pGraphics->SetScreenScale(scale);
@@ -310,6 +375,14 @@ LRESULT CALLBACK IGraphicsWin::WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
       return 0;
     }
 
+#if !defined IGRAPHICS_NO_DISPLAY_SYNC && defined WM_DPICHANGED_AFTERPARENT
+    case WM_DPICHANGED_AFTERPARENT:
+    {
+      pGraphics->RequestFrame(); // the screen scale is checked on each frame
+      return 0;
+    }
+#endif
+
     case WM_RBUTTONDOWN:
     case WM_LBUTTONDOWN:
     case WM_MBUTTONDOWN:
@@ -536,6 +609,12 @@ LRESULT CALLBACK IGraphicsWin::WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
       
       return 0;
     }
+    case WM_INITMENUPOPUP:
+    {
+      // pop up menus are filled as they open, see CreatePlatformPopupMenu()
+      pGraphics->UpdateMenu((HMENU) wParam);
+      return 0;
+    }
     case WM_CLOSE:
     {
       pGraphics->CloseWindow();
@@ -663,6 +742,12 @@ IGraphicsWin::IGraphicsWin(IGEditorDelegate& dlg, int w, int h, int fps, float s
     if (h) *(void **)&__GetDpiForWindow = GetProcAddress(h, "GetDpiForWindow");
   }
 
+  if (!__GetDpiForMonitor)
+  {
+    HINSTANCE h = LoadLibrary("shcore.dll");
+    if (h) *(void **)&__GetDpiForMonitor = GetProcAddress(h, "GetDpiForMonitor");
+  }
+
   StaticStorage<InstalledFont>::Accessor fontStorage(sPlatformFontCache);
   StaticStorage<HFontHolder>::Accessor hfontStorage(sHFontCache);
   fontStorage.Retain();
@@ -677,6 +762,7 @@ IGraphicsWin::~IGraphicsWin()
   hfontStorage.Release();
   DestroyEditWindow();
   CloseWindow();
+  ClearMenuCache();
 }
 
 static void GetWindowSize(HWND pWnd, int* pW, int* pH)
@@ -753,6 +839,20 @@ void IGraphicsWin::PlatformResize(bool parentHasResized)
   }
 }
 
+void IGraphicsWin::PrescaleBitmapsForMonitors()
+{
+#ifdef IGRAPHICS_GL
+  ActivateGLContext();
+#endif
+
+  for (int scale : GetMonitorScales())
+    PrescaleBitmaps(scale);
+
+#ifdef IGRAPHICS_GL
+  DeactivateGLContext();
+#endif
+}
+
 #ifdef IGRAPHICS_GL
 void IGraphicsWin::DrawResize()
 {
@@ -856,7 +956,7 @@ void IGraphicsWin::CreateGLContext()
   {
     sizeof(PIXELFORMATDESCRIPTOR),
     1,
-    PFD_DRAW_TO_WINDOW | PFD_SUPPORT_OPENGL | PFD_DOUBLEBUFFER, //Flags
+    PFD_DRAW_TO_WINDOW | PFD_SUPPORT_OPENGL | PFD_DOUBLEBUFFER | PFD_SWAP_COPY, //Flags
     PFD_TYPE_RGBA, // The kind of framebuffer. RGBA or palette.
     32, // Colordepth of the framebuffer.
     0, 0, 0, 0, 0, 0,
@@ -876,6 +976,13 @@ void IGraphicsWin::CreateGLContext()
   int fmt = ChoosePixelFormat(dc, &pfd);
   SetPixelFormat(dc, fmt, &pfd);
 
+#ifdef IGRAPHICS_NANOVG
+  // PFD_SWAP_COPY is only a request, so check whether SwapBuffers() will keep the back buffer
+  PIXELFORMATDESCRIPTOR chosen = {};
+  DescribePixelFormat(dc, fmt, sizeof(chosen), &chosen);
+  SetBackbufferPreserved((chosen.dwFlags & PFD_SWAP_COPY) != 0);
+#endif
+
   mHGLRC = wglCreateContext(dc);
   wglMakeCurrent(dc, mHGLRC);
 
@@ -948,6 +1055,10 @@ void* IGraphicsWin::OpenWindow(void* pParent)
   sFPS = FPS();
   mPlugWnd = CreateWindow(wndClassName, "IPlug", WS_CHILD | WS_VISIBLE, x, y, w, h, mParentWnd, 0, mHInstance, this);
 
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+  StartFrameClock();
+#endif
+
   HDC dc = GetDC(mPlugWnd);
   SetPlatformContext(dc);
   ReleaseDC(mPlugWnd, dc);
@@ -962,6 +1073,12 @@ void* IGraphicsWin::OpenWindow(void* pParent)
 
   GetDelegate()->LayoutUI(this);
 
+  if (mPlugWnd)
+  {
+    mMonitor = MonitorFromWindow(mPlugWnd, MONITOR_DEFAULTTONEAREST);
+    PrescaleBitmapsForMonitors();
+  }
+
   if (!mPlugWnd && --nWndClassReg == 0)
   {
     UnregisterClass(wndClassName, mHInstance);
@@ -994,10 +1111,22 @@ void* IGraphicsWin::OpenWindow(void* pParent)
   }
 
   GetDelegate()->OnUIOpen();
+  CheckOcclusion();
   
   return mPlugWnd;
 }
 
+void IGraphicsWin::CheckOcclusion()
+{
+  HWND rootWnd = GetAncestor(mPlugWnd, GA_ROOT);
+  BOOL cloaked = FALSE; // e.g. on another virtual desktop
+
+  if (FAILED(DwmGetWindowAttribute(rootWnd, DWMWA_CLOAKED, &cloaked, sizeof(cloaked))))
+    cloaked = FALSE;
+
+  SetOccluded(!IsWindowVisible(mPlugWnd) || IsIconic(rootWnd) || cloaked);
+}
+
 static void GetWndClassName(HWND hWnd, WDL_String* pStr)
 {
   char cStr[MAX_CLASSNAME_LEN];
@@ -1070,9 +1199,20 @@ void IGraphicsWin::CloseWindow()
 {
   if (mPlugWnd)
   {
+    SetOccluded(false);
+
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+    StopFrameClock();
+#endif
+
+#ifdef IGRAPHICS_GL
+    ActivateGLContext(); // GPU resources must be freed with the context current
+#endif
+
     OnViewDestroyed();
 
 #ifdef IGRAPHICS_GL
+    DeactivateGLContext();
     DestroyGLContext();
 #endif
 
@@ -1096,178 +1236,303 @@ void IGraphicsWin::CloseWindow()
   }
 }
 
-IPopupMenu* IGraphicsWin::GetItemMenu(long idx, long& idxInMenu, long& offsetIdx, IPopupMenu& baseMenu)
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+void IGraphicsWin::StartFrameClock()
+{
+  mFrameClockQuit = false;
+  mFrameClockRunning = true;
+  mFramePosted = false;
+  mFrameClockThread = std::thread(&IGraphicsWin::FrameClockThread, this);
+}
+
+void IGraphicsWin::StopFrameClock()
+{
+  if (mFrameClockThread.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(mFrameClockMutex);
+      mFrameClockQuit = true;
+    }
+
+    mFrameClockCV.notify_one();
+    mFrameClockThread.join();
+  }
+}
+
+void IGraphicsWin::PauseFrameClock()
 {
-  long oldIDx = offsetIdx;
-  offsetIdx += baseMenu.NItems();
+  std::lock_guard<std::mutex> lock(mFrameClockMutex);
+  mFrameClockRunning = false;
+}
+
+void IGraphicsWin::RequestFrame()
+{
+  if (IsOccluded())
+    return;
 
-  if (idx < offsetIdx)
   {
-    idxInMenu = idx - oldIDx;
-    return &baseMenu;
+    std::lock_guard<std::mutex> lock(mFrameClockMutex);
+
+    if (mFrameClockRunning)
+      return;
+
+    mFrameClockRunning = true;
   }
 
-  IPopupMenu* pMenu = nullptr;
+  mFrameClockCV.notify_one();
+}
 
-  for(int i = 0; i< baseMenu.NItems(); i++)
+void IGraphicsWin::FrameClockThread()
+{
+  const double interval = 1000.0 / FPS();
+  double lastFrameTime = 0.;
+
+  while (true)
   {
-    IPopupMenu::Item* pMenuItem = baseMenu.GetItem(i);
-    if(pMenuItem->GetSubmenu())
     {
-      pMenu = GetItemMenu(idx, idxInMenu, offsetIdx, *pMenuItem->GetSubmenu());
+      std::unique_lock<std::mutex> lock(mFrameClockMutex);
+      mFrameClockCV.wait(lock, [this]() { return mFrameClockRunning || mFrameClockQuit; });
 
-      if(pMenu)
-        break;
+      if (mFrameClockQuit)
+        return;
     }
+
+    // DwmFlush() returns after the compositor's next frame, and fails while desktop composition is off (Windows 7 basic themes)
+    if (FAILED(DwmFlush()))
+      Sleep(static_cast<DWORD>(interval));
+
+    // keep to FPS() on displays that refresh faster, allowing for jitter in the refresh period
+    const double time = GetTimestamp() * 1000.;
+
+    if (time - lastFrameTime < interval * 0.9)
+      continue;
+
+    lastFrameTime = time;
+
+    // skip the refresh if the UI thread has not handled the previous one yet
+    if (!mFramePosted.exchange(true))
+      PostMessage(mPlugWnd, IPLUG_FRAME_MSG, 0, 0);
+  }
+}
+#endif
+
+static void GetMenuItemText(IPopupMenu& menu, int idx, WDL_String& entryText)
+{
+  const char* str = menu.GetItem(idx)->GetText();
+
+  switch (menu.GetPrefix())
+  {
+    case 1: entryText.SetFormatted(static_cast<int>(strlen(str)) + 50, "%1d: %s", idx + 1, str); break;
+    case 2: entryText.SetFormatted(static_cast<int>(strlen(str)) + 50, "%02d: %s", idx + 1, str); break;
+    case 3: entryText.SetFormatted(static_cast<int>(strlen(str)) + 50, "%03d: %s", idx + 1, str); break;
+    default: entryText.Set(str); break;
   }
 
-  return pMenu;
+  // Escape ampersands if present
+  if (strchr(entryText.Get(), '&'))
+  {
+    for (int c = 0; c < entryText.GetLength(); c++)
+      if (entryText.Get()[c] == '&')
+        entryText.Insert("&", c++);
+  }
 }
 
-HMENU IGraphicsWin::CreateMenu(IPopupMenu& menu, long* pOffsetIdx)
+static UINT GetMenuItemStateFlags(IPopupMenu::Item& item)
 {
-  HMENU hMenu = ::CreatePopupMenu();
+  UINT flags = item.GetEnabled() ? MF_ENABLED : MF_GRAYED;
+
+  if (item.GetIsTitle())
+    flags |= MF_DISABLED;
+
+  return flags | (item.GetChecked() ? MF_CHECKED : MF_UNCHECKED);
+}
+
+void IGraphicsWin::UpdateMenu(HMENU hMenu)
+{
+  auto it = mMenus.find(hMenu);
+
+  if (it == mMenus.end())
+    return;
+
+  CachedMenu& cached = it->second;
+  IPopupMenu& menu = *cached.mMenu;
+  const int nItems = menu.NItems();
+
+  if (cached.mVersion == menu.GetVersion())
+  {
+    // the items are the same, only their states may have changed
+    for (int i = 0; i < nItems; i++)
+    {
+      IPopupMenu::Item* pItem = menu.GetItem(i);
+
+      if (!pItem->GetIsSeparator() && !pItem->GetSubmenu())
+      {
+        const UINT flags = GetMenuItemStateFlags(*pItem);
+        CheckMenuItem(hMenu, i, MF_BYPOSITION | (flags & MF_CHECKED));
+        EnableMenuItem(hMenu, i, MF_BYPOSITION | (flags & (MF_GRAYED | MF_DISABLED)));
+      }
+    }
+
+    return;
+  }
+
+  // the submenus are taken out rather than destroyed, so that the ones still in the menu keep their items
+  std::unordered_map<IPopupMenu*, HMENU> oldSubmenus;
+
+  for (int i = GetMenuItemCount(hMenu); i-- > 0;)
+  {
+    if (HMENU hSubmenu = GetSubMenu(hMenu, i))
+      oldSubmenus[mMenus[hSubmenu].mMenu] = hSubmenu;
 
-  WDL_String escapedText;
+    RemoveMenu(hMenu, i, MF_BYPOSITION);
+  }
+
+  if (cached.mFirstCommandID)
+    mMenuCommands.erase(cached.mFirstCommandID);
 
-  int flags = 0;
-  long offset = *pOffsetIdx;
-  long nItems = menu.NItems();
-  *pOffsetIdx += nItems;
-  long inc = 0;
+  cached.mFirstCommandID = mNextMenuCommandID;
+  mNextMenuCommandID += std::max(nItems, 1);
+  mMenuCommands[cached.mFirstCommandID] = hMenu;
 
-  for(int i = 0; i < nItems; i++)
+  WDL_String entryText;
+
+  for (int i = 0; i < nItems; i++)
   {
     IPopupMenu::Item* pMenuItem = menu.GetItem(i);
 
     if (pMenuItem->GetIsSeparator())
     {
       AppendMenu(hMenu, MF_SEPARATOR, 0, 0);
+      continue;
     }
-    else
+
+    GetMenuItemText(menu, i, entryText);
+
+    if (IPopupMenu* pSubmenu = pMenuItem->GetSubmenu())
     {
-      const char* str = pMenuItem->GetText();
-      int maxlen = strlen(str) + menu.GetPrefix() ? 50 : 0;
-      WDL_String entryText(str);
+      HMENU hSubmenu;
+      auto old = oldSubmenus.find(pSubmenu);
 
-      if (menu.GetPrefix())
+      if (old != oldSubmenus.end())
       {
-        switch (menu.GetPrefix())
-        {
-          case 1:
-          {
-            entryText.SetFormatted(maxlen, "%1d: %s", i+1, str); break;
-          }
-          case 2:
-          {
-            entryText.SetFormatted(maxlen, "%02d: %s", i+1, str); break;
-          }
-          case 3:
-          {
-            entryText.SetFormatted(maxlen, "%03d: %s", i+1, str); break;
-          }
-        }
+        hSubmenu = old->second;
+        oldSubmenus.erase(old);
       }
-
-      // Escape ampersands if present
-
-      if (strchr(entryText.Get(), '&'))
+      else
       {
-        for (int c = 0; c < entryText.GetLength(); c++)
-          if (entryText.Get()[c] == '&')
-            entryText.Insert("&", c++);
+        // filled when it opens
+        hSubmenu = ::CreatePopupMenu();
+        mMenus[hSubmenu].mMenu = pSubmenu;
       }
 
-      flags = MF_STRING;
-      //if (nItems < 160 && pMenu->getNbItemsPerColumn () > 0 && inc && !(inc % _menu->getNbItemsPerColumn ()))
-      //  flags |= MF_MENUBARBREAK;
+      AppendMenu(hMenu, MF_STRING | MF_POPUP | MF_ENABLED, (UINT_PTR) hSubmenu, entryText.Get());
+    }
+    else
+      AppendMenu(hMenu, MF_STRING | GetMenuItemStateFlags(*pMenuItem), cached.mFirstCommandID + i, entryText.Get());
+  }
 
-      if (pMenuItem->GetSubmenu())
-      {
-        HMENU submenu = CreateMenu(*pMenuItem->GetSubmenu(), pOffsetIdx);
-        if (submenu)
-        {
-          AppendMenu(hMenu, flags|MF_POPUP|MF_ENABLED, (UINT_PTR)submenu, (const TCHAR*)entryText.Get());
-        }
-      }
-      else
-      {
-        if (pMenuItem->GetEnabled())
-          flags |= MF_ENABLED;
-        else
-          flags |= MF_GRAYED;
-        if (pMenuItem->GetIsTitle())
-          flags |= MF_DISABLED;
-        if (pMenuItem->GetChecked())
-          flags |= MF_CHECKED;
-        else
-          flags |= MF_UNCHECKED;
+  for (auto& old : oldSubmenus)
+    DestroyCachedMenu(old.second);
 
-        AppendMenu(hMenu, flags, offset + inc, entryText.Get());
-      }
+  cached.mVersion = menu.GetVersion();
+}
+
+void IGraphicsWin::DestroyCachedMenu(HMENU hMenu)
+{
+  for (int i = GetMenuItemCount(hMenu); i-- > 0;)
+  {
+    if (HMENU hSubmenu = GetSubMenu(hMenu, i))
+    {
+      RemoveMenu(hMenu, i, MF_BYPOSITION);
+      DestroyCachedMenu(hSubmenu);
     }
-    inc++;
   }
 
-  return hMenu;
+  auto it = mMenus.find(hMenu);
+
+  if (it != mMenus.end())
+  {
+    if (it->second.mFirstCommandID)
+      mMenuCommands.erase(it->second.mFirstCommandID);
+
+    mMenus.erase(it);
+  }
+
+  DestroyMenu(hMenu);
+}
+
+void IGraphicsWin::ClearMenuCache()
+{
+  for (auto& root : mRootMenus)
+    DestroyCachedMenu(root.second);
+
+  mRootMenus.clear();
+  mMenus.clear();
+  mMenuCommands.clear();
+  mNextMenuCommandID = 1;
 }
 
 IPopupMenu* IGraphicsWin::CreatePlatformPopupMenu(IPopupMenu& menu, const IRECT& bounds)
 {
-  long offsetIdx = 0;
-  HMENU hMenu = CreateMenu(menu, &offsetIdx);
+  static constexpr size_t kMaxCachedMenus = 16;
+
+  // the native menu is kept and only refilled when the IPopupMenu changes, its submenus are filled as they open (WM_INITMENUPOPUP)
+  auto root = mRootMenus.find(&menu);
 
-  if(hMenu)
+  if (root == mRootMenus.end())
   {
-    long offsetIdx = 0;
-    HMENU hMenu = CreateMenu(menu, &offsetIdx);
-    IPopupMenu* result = nullptr;
+    if (mRootMenus.size() >= kMaxCachedMenus)
+      ClearMenuCache();
 
-    if (hMenu)
-    {
-      POINT cPos;
+    HMENU hNewMenu = ::CreatePopupMenu();
+
+    if (!hNewMenu)
+      return nullptr;
+
+    mMenus[hNewMenu].mMenu = &menu;
+    root = mRootMenus.emplace(&menu, hNewMenu).first;
+  }
+
+  HMENU hMenu = root->second;
+  UpdateMenu(hMenu);
 
-      cPos.x = bounds.L * (GetDrawScale() * GetScreenScale());
-      cPos.y = bounds.B * (GetDrawScale() * GetScreenScale());
+  POINT cPos;
 
-      ::ClientToScreen(mPlugWnd, &cPos);
+  cPos.x = bounds.L * (GetDrawScale() * GetScreenScale());
+  cPos.y = bounds.B * (GetDrawScale() * GetScreenScale());
 
-      if (TrackPopupMenu(hMenu, TPM_LEFTALIGN, cPos.x, cPos.y, 0, mPlugWnd, 0))
+  ::ClientToScreen(mPlugWnd, &cPos);
+
+  IPopupMenu* result = nullptr;
+  const UINT commandID = TrackPopupMenu(hMenu, TPM_LEFTALIGN | TPM_RETURNCMD, cPos.x, cPos.y, 0, mPlugWnd, 0);
+
+  if (commandID)
+  {
+    // the command IDs of each menu start at the key of its entry
+    auto command = mMenuCommands.upper_bound(commandID);
+
+    if (command != mMenuCommands.begin())
+    {
+      --command;
+      IPopupMenu* pReturnMenu = mMenus[command->second].mMenu;
+      const int idx = static_cast<int>(commandID - command->first);
+
+      if (pReturnMenu && idx < pReturnMenu->NItems())
       {
-        MSG msg;
-        if (PeekMessage(&msg, mPlugWnd, WM_COMMAND, WM_COMMAND, PM_REMOVE))
-        {
-          if (HIWORD(msg.wParam) == 0)
-          {
-            long res = LOWORD(msg.wParam);
-            if (res != -1)
-            {
-              long idx = 0;
-              offsetIdx = 0;
-              IPopupMenu* pReturnMenu = GetItemMenu(res, idx, offsetIdx, menu);
-              if (pReturnMenu)
-              {
-                result = pReturnMenu;
-                result->SetChosenItemIdx(idx);
-                
-                //synchronous
-                if(pReturnMenu && pReturnMenu->GetFunction())
-                  pReturnMenu->ExecFunction();
-              }
-            }
-          }
-        }
-      }
-      DestroyMenu(hMenu);
+        result = pReturnMenu;
+        result->SetChosenItemIdx(idx);
 
-      RECT r = { 0, 0, WindowWidth() * GetScreenScale(), WindowHeight() * GetScreenScale() };
-      InvalidateRect(mPlugWnd, &r, FALSE);
+        //synchronous
+        if (pReturnMenu->GetFunction())
+          pReturnMenu->ExecFunction();
+      }
     }
-
-    return result;
   }
 
-  return nullptr;
+  RECT r = { 0, 0, WindowWidth() * GetScreenScale(), WindowHeight() * GetScreenScale() };
+  InvalidateRect(mPlugWnd, &r, FALSE);
+
+  return result;
 }
 
 void IGraphicsWin::CreatePlatformTextEntry(int paramIdx, const IText& text, const IRECT& bounds, int length, const char* str)
@@ -1314,6 +1579,10 @@ void IGraphicsWin::CreatePlatformTextEntry(int paramIdx, const IText& text, cons
 
   mDefEditProc = (WNDPROC) SetWindowLongPtr(mParamEditWnd, GWLP_WNDPROC, (LONG_PTR) ParamEditProc);
   SetWindowLongPtr(mParamEditWnd, GWLP_USERDATA, 0xdeadf00b);
+
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+  RequestFrame(); // the edit box's messages are handled on each frame
+#endif
 }
 
 bool IGraphicsWin::RevealPathInExplorerOrFinder(WDL_String& path, bool select)
@@ -1802,6 +2071,12 @@ void IGraphicsWin::CachePlatformFont(const char* fontID, const PlatformFontPtr&
     hfontStorage.Add(new HFontHolder(hfont), fontID);
 }
 
+bool IGraphicsWin::PlatformFontIsCached(const char* fontID)
+{
+  StaticStorage<HFontHolder>::Accessor hfontStorage(sHFontCache);
+  return hfontStorage.Find(fontID) != nullptr;
+}
+
 #ifndef NO_IGRAPHICS
 #if defined IGRAPHICS_AGG
   #include "IGraphicsAGG.cpp"
@@ -14,6 +14,15 @@
 #include <windowsx.h>
 #include <winuser.h>
 
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#endif
+
 #include "IGraphics_select.h"
 
 BEGIN_IPLUG_NAMESPACE
@@ -62,9 +71,6 @@ public:
   void PromptForDirectory(WDL_String& dir) override;
   bool PromptForColor(IColor& color, const char* str, IColorPickerHandlerFunc func) override;
 
-  IPopupMenu* GetItemMenu(long idx, long& idxInMenu, long& offsetIdx, IPopupMenu& baseMenu);
-  HMENU CreateMenu(IPopupMenu& menu, long* pOffsetIdx);
-
   bool OpenURL(const char* url, const char* msgWindowTitle, const char* confirmMsg, const char* errMsgOnFailure);
 
   void* GetWindow() override { return mPlugWnd; }
@@ -105,6 +111,35 @@ private:
   PlatformFontPtr LoadPlatformFont(const char* fontID, const char* fileNameOrResID) override;
   PlatformFontPtr LoadPlatformFont(const char* fontID, const char* fontName, ETextStyle style) override;
   void CachePlatformFont(const char* fontID, const PlatformFontPtr& font) override;
+  bool PlatformFontIsCached(const char* fontID) override;
+
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+  void RequestFrame() override;
+  void StartFrameClock();
+  void StopFrameClock();
+  void PauseFrameClock();
+  void FrameClockThread();
+#endif
+
+  // Reports to SetOccluded() whether the host's window is minimized or cloaked, or the plug-in window is hidden
+  void CheckOcclusion();
+
+  // Caches the loaded bitmaps at the scale of each connected monitor, so that moving the window between monitors only swaps them
+  void PrescaleBitmapsForMonitors();
+
+  /** A native menu made from an IPopupMenu. It is kept between pop ups, and filled when it opens if the IPopupMenu's version has changed */
+  struct CachedMenu
+  {
+    IPopupMenu* mMenu = nullptr; // only dereferenced while a menu it is in is open
+    uint32_t mVersion = 0; // the version of mMenu it was filled from, 0 if it hasn't been
+    UINT mFirstCommandID = 0;
+  };
+
+  // Called for each menu as it opens: fill it if its IPopupMenu has changed, otherwise refresh the check marks and enabled states
+  void UpdateMenu(HMENU hMenu);
+  // Destroy a cached menu and its submenus
+  void DestroyCachedMenu(HMENU hMenu);
+  void ClearMenuCache();
 
   inline IMouseInfo GetMouseInfo(LPARAM lParam, WPARAM wParam);
   inline IMouseInfo GetMouseInfoDeltas(float&dX, float& dY, LPARAM lParam, WPARAM wParam);
@@ -130,6 +165,7 @@ private:
   HWND mTooltipWnd = nullptr;
   HWND mParentWnd = nullptr;
   HWND mMainWnd = nullptr;
+  HMONITOR mMonitor = nullptr;
   WNDPROC mDefEditProc = nullptr;
   HFONT mEditFont = nullptr;
   DWORD mPID = 0;
@@ -145,6 +181,21 @@ private:
   int mTooltipIdx = -1;
 
   WDL_String mMainWndClassName;
+
+  std::unordered_map<HMENU, CachedMenu> mMenus;
+  std::unordered_map<IPopupMenu*, HMENU> mRootMenus; // the menus that have been popped up
+  std::map<UINT, HMENU> mMenuCommands; // the filled menus by their first command ID
+  UINT mNextMenuCommandID = 1;
+
+#ifndef IGRAPHICS_NO_DISPLAY_SYNC
+  // a thread that waits for the compositor and posts a frame message to mPlugWnd, paused while nothing is dirty
+  std::thread mFrameClockThread;
+  std::mutex mFrameClockMutex;
+  std::condition_variable mFrameClockCV;
+  std::atomic<bool> mFramePosted {false};
+  bool mFrameClockRunning = false;
+  bool mFrameClockQuit = false;
+#endif
     
   static StaticStorage<InstalledFont> sPlatformFontCache;
   static StaticStorage<HFontHolder> sHFontCache;
@@ -22,6 +22,9 @@
 
 using namespace iplug;
 
+// automation can be dispatched ahead of the block it belongs to. Changes stamped further ahead than this (e.g. after a relocation) are applied straight away
+static const int64_t kMaxParamChangeLookahead = 8192;
+
 AAX_CEffectParameters *AAX_CALLBACK IPlugAAX::Create()
 {
   return MakePlug(InstanceInfo());
@@ -109,6 +112,7 @@ IPlugAAX::IPlugAAX(const InstanceInfo& info, const Config& config)
   }
   
   SetBlockSize(DEFAULT_BLOCK_SIZE);
+  mMidiOutputQueue.Reserve(DEFAULT_BLOCK_SIZE); // fixed capacity, so that SendMidiMsg() never allocates on the audio thread
   
   CreateTimer();
 }
@@ -124,6 +128,9 @@ AAX_Result IPlugAAX::EffectInit()
 
   if (GetHost() == kHostUninit)
     SetHost("ProTools", 0); // TODO:vendor version correct?
+
+  if (GetFixedBlockSize())
+    Controller()->SetSignalLatency(GetLatency()); // the description only knows PLUG_LATENCY
     
   AAX_CString bypassID = NULL;
   this->GetMasterBypassParameter(&bypassID);
@@ -213,6 +220,13 @@ AAX_Result IPlugAAX::EffectInit()
   AAX_CSampleRate sr;
   Controller()->GetSampleRate(&sr);
   SetSampleRate(sr);
+  
+  // one point per queued change, so RenderAudio() never allocates
+  mParamChangePoints.Resize(PARAM_TRANSFER_SIZE * 2, false);
+  mParamChangePoints.Resize(0, false);
+  mFutureParamChanges.Resize(PARAM_TRANSFER_SIZE, false);
+  mFutureParamChanges.Resize(0, false);
+  
   OnReset();
   
   return AAX_SUCCESS;
@@ -236,11 +250,9 @@ AAX_Result IPlugAAX::UpdateParameterNormalizedValue(AAX_CParamID paramID, double
   
   if ((paramIdx > kNoParameter) && (paramIdx < NParams())) 
   {
-    ENTER_PARAMS_MUTEX;
-    GetParam(paramIdx)->SetNormalized(iValue);
+    // the IParam is set in RenderAudio(), once GenerateCoefficients() has given the change a timestamp
     SendParameterValueFromAPI(paramIdx, iValue, true);
-    OnParamChange(paramIdx, kHost);
-    LEAVE_PARAMS_MUTEX;
+    mPendingParamChanges.Add({paramIdx, iValue, 0});
   }
   
   // Now the control has changed
@@ -251,9 +263,165 @@ AAX_Result IPlugAAX::UpdateParameterNormalizedValue(AAX_CParamID paramID, double
   return result;
 }
 
+AAX_Result IPlugAAX::GenerateCoefficients()
+{
+  // only valid here, and only non-zero when the update came from automation playback rather than an immediate change
+  AAX_CTransportCounter timestamp = 0;
+  
+  if (Controller()->GetCurrentAutomationTimestamp(&timestamp) != AAX_SUCCESS)
+    timestamp = 0;
+  
+  for (auto i = 0; i < mPendingParamChanges.GetSize(); i++)
+  {
+    ParamChange change = mPendingParamChanges.Get()[i];
+    change.timestamp = timestamp;
+    
+    if (!mParamChangesToRender.Push(change))
+    {
+      // the queue is full, so apply the change here, as if it came from a chunk
+      ENTER_PARAMS_MUTEX;
+      BeginParamsWrite();
+      GetParam(change.idx)->SetNormalized(change.value);
+      EndParamsWrite();
+      LEAVE_PARAMS_MUTEX;
+      WakeFromSilence();
+#ifdef PARAMS_LOCKFREE
+      DeferParamChange(change.idx, kHost);
+#else
+      OnParamChange(change.idx, kHost);
+#endif
+    }
+  }
+  
+  mPendingParamChanges.Resize(0, false);
+  
+  return AAX_CIPlugParameters::GenerateCoefficients();
+}
+
+void IPlugAAX::SetSampleAccurateAutomation(bool enable, int minSubBlockSize)
+{
+  mSampleAccurateAutomation = enable;
+  mMinSubBlockSize = std::max(minSubBlockSize, 1);
+}
+
+void IPlugAAX::BuildParamChangePoints(int nFrames, int64_t blockSamplePos)
+{
+  mParamChangePoints.Resize(0, false);
+  
+  // @return false if the change belongs to a later block
+  auto addChange = [&](const ParamChange& change, bool canDefer) {
+    int offset = 0;
+    
+    if (change.timestamp > 0)
+    {
+      const int64_t delta = change.timestamp - blockSamplePos;
+      
+      if (canDefer && delta >= nFrames && delta < kMaxParamChangeLookahead)
+        return false;
+      
+      offset = (int) Clip<int64_t>(delta, 0, nFrames - 1);
+    }
+    
+    mParamChangePoints.Add({offset, mParamChangePoints.GetSize(), change.idx, change.value});
+    mBlockEvents.AddParamChange(offset, change.idx, change.value);
+    return true;
+  };
+  
+  // changes that were stamped beyond the previous block come first, they were dequeued before anything in the queue now
+  int nFuture = 0;
+  
+  for (auto i = 0; i < mFutureParamChanges.GetSize(); i++)
+  {
+    const ParamChange change = mFutureParamChanges.Get()[i];
+    
+    if (!addChange(change, true))
+      mFutureParamChanges.Get()[nFuture++] = change;
+  }
+  
+  mFutureParamChanges.Resize(nFuture, false);
+  
+  ParamChange change;
+  
+  while (mParamChangePoints.GetSize() < PARAM_TRANSFER_SIZE && mParamChangesToRender.Pop(change))
+  {
+    if (!addChange(change, mFutureParamChanges.GetSize() < PARAM_TRANSFER_SIZE))
+      mFutureParamChanges.Add(change);
+  }
+  
+  if (mParamChangePoints.GetSize())
+  {
+    // order is used to keep std::sort stable without allocating
+    std::sort(mParamChangePoints.Get(), mParamChangePoints.Get() + mParamChangePoints.GetSize(), [](const ParamChangePoint& a, const ParamChangePoint& b) {
+      return a.offset != b.offset ? a.offset < b.offset : a.order < b.order;
+    });
+  }
+}
+
+void IPlugAAX::ApplyParamChangePoints()
+{
+  const ParamChangePoint* pPoints = mParamChangePoints.Get();
+  
+  for (auto i = 0; i < mParamChangePoints.GetSize(); i++)
+    SetParameterFromRender(pPoints[i].idx, pPoints[i].value, pPoints[i].offset);
+  
+  mParamChangePoints.Resize(0, false);
+}
+
+void IPlugAAX::ProcessSubBlocks(int nFrames)
+{
+  const ParamChangePoint* pPoints = mParamChangePoints.Get();
+  const int nPoints = mParamChangePoints.GetSize();
+  const ITimeInfo blockTimeInfo = mTimeInfo;
+  const double samplesPerBeat = GetSamplesPerBeat();
+  int pointIdx = 0;
+  int startIdx = 0;
+  
+  while (startIdx < nFrames)
+  {
+    // changes that fell inside the previous sub-block are applied at the start of this one
+    while (pointIdx < nPoints && pPoints[pointIdx].offset <= startIdx)
+    {
+      SetParameterFromRender(pPoints[pointIdx].idx, pPoints[pointIdx].value, pPoints[pointIdx].offset);
+      pointIdx++;
+    }
+    
+    int endIdx = nFrames;
+    
+    if (pointIdx < nPoints)
+      endIdx = std::min(std::max(pPoints[pointIdx].offset, startIdx + mMinSubBlockSize), nFrames);
+    
+    mTimeInfo.mSamplePos = blockTimeInfo.mSamplePos + startIdx;
+    
+    if (samplesPerBeat > 0.)
+      mTimeInfo.mPPQPos = blockTimeInfo.mPPQPos + (startIdx / samplesPerBeat);
+    
+    ProcessBuffers(0.0f, endIdx - startIdx, startIdx);
+    startIdx = endIdx;
+  }
+  
+  for (; pointIdx < nPoints; pointIdx++)
+    SetParameterFromRender(pPoints[pointIdx].idx, pPoints[pointIdx].value, pPoints[pointIdx].offset);
+  
+  mTimeInfo = blockTimeInfo;
+  mParamChangePoints.Resize(0, false);
+}
+
+void IPlugAAX::SetParameterFromRender(int idx, double value, int offset)
+{
+  // IParam values are atomic, the editor was already updated from UpdateParameterNormalizedValue()
+  BeginParamsWrite();
+  GetParam(idx)->SetNormalized(value);
+  EndParamsWrite();
+  OnParamChange(idx, kHost, offset);
+}
+
 void IPlugAAX::RenderAudio(AAX_SIPlugRenderInfo* pRenderInfo)
 {
   TRACE;
+  REALTIME_SCOPE;
+  IFlushDenormalsScope denormalsScope(GetFlushDenormals());
+
+  ProcessDeferredParamChanges();
 
   // Get bypass parameter value
   bool bypass;
@@ -273,13 +441,16 @@ void IPlugAAX::RenderAudio(AAX_SIPlugRenderInfo* pRenderInfo)
     for (int i = 0; i<packets_count; i++, pMidiPacket++) 
     {
       IMidiMsg msg(pMidiPacket->mTimestamp, pMidiPacket->mData[0], pMidiPacket->mData[1], pMidiPacket->mData[2]);
-      ProcessMidiMsg(msg);
+      ReceiveMidiMsg(msg);
       mMidiMsgsFromProcessor.Push(msg);
     }
   }
   
   AAX_IMIDINode* pTransportNode = pRenderInfo->mTransportNode;
   mTransport = pTransportNode->GetTransport();
+  
+  int64_t samplePos = 0;
+  mTransport->GetCurrentNativeSampleLocation(&samplePos);
 
   int32_t numSamples = *(pRenderInfo->mNumSamples);
   int32_t numInChannels = AAX_STEM_FORMAT_CHANNEL_COUNT(inFormat);
@@ -293,12 +464,17 @@ void IPlugAAX::RenderAudio(AAX_SIPlugRenderInfo* pRenderInfo)
   SetChannelConnections(ERoute::kOutput, numOutChannels, MaxNChannels(ERoute::kOutput) - numOutChannels, false);
   AttachBuffers(ERoute::kOutput, 0, MaxNChannels(ERoute::kOutput), pRenderInfo->mAudioOutputs, numSamples);
   
+  BuildParamChangePoints(numSamples, samplePos);
+  
   if (bypass) 
+  {
+    ApplyParamChangePoints();
     PassThroughBuffers(0.0f, numSamples);
+  }
   else 
   {
     int32_t num, denom;
-    int64_t ppqPos, samplePos, cStart, cEnd;
+    int64_t ppqPos, cStart, cEnd;
     ITimeInfo timeInfo;
     
     mTransport->GetCurrentTempo(&timeInfo.mTempo);
@@ -314,7 +490,6 @@ void IPlugAAX::RenderAudio(AAX_SIPlugRenderInfo* pRenderInfo)
     if(timeInfo.mPPQPos < 0)
       timeInfo.mPPQPos = 0;
  
-    mTransport->GetCurrentNativeSampleLocation(&samplePos);
     timeInfo.mSamplePos = (double) samplePos;
     
     mTransport->GetCurrentLoopPosition(&timeInfo.mTransportLoopEnabled, &cStart, &cEnd);
@@ -328,12 +503,24 @@ void IPlugAAX::RenderAudio(AAX_SIPlugRenderInfo* pRenderInfo)
     
     while (mMidiMsgsFromEditor.Pop(msg))
     {
-      ProcessMidiMsg(msg);
+      ReceiveMidiMsg(msg);
     }
     
-    ProcessBuffers(0.0f, numSamples);
+    if (SkipSilentBuffers(0.0f, numSamples))
+    {
+      // the input has been silent for longer than the tail, the outputs were zeroed
+    }
+    else if (mSampleAccurateAutomation && mParamChangePoints.GetSize())
+      ProcessSubBlocks(numSamples);
+    else
+    {
+      ApplyParamChangePoints();
+      ProcessBuffers(0.0f, numSamples);
+    }
   }
   
+  ClearBlockEvents();
+  
   // Midi Out
   if (DoesMIDIOut())
   {
@@ -368,32 +555,33 @@ void IPlugAAX::RenderAudio(AAX_SIPlugRenderInfo* pRenderInfo)
       mMidiOutputQueue.Flush(numSamples);
       
       //Output SYSEX from the editor, which has bypassed ProcessSysEx()
-      if(mSysExDataFromEditor.ElementsAvailable())
+      ISysEx smsg;
+      
+      while (mSysExDataFromEditor.Peek(smsg))
       {
-        while (mSysExDataFromEditor.Pop(mSysexBuf))
+        int numPackets = (int) ceil((float) smsg.mSize/4.); // each packet can store 4 bytes of data
+        int bytesPos = 0;
+        
+        for (int p = 0; p < numPackets; p++)
         {
-          int numPackets = (int) ceil((float) mSysexBuf.mSize/4.); // each packet can store 4 bytes of data
-          int bytesPos = 0;
+          AAX_CMidiPacket packet;
+          
+          packet.mTimestamp = (uint32_t) smsg.mOffset;
+          packet.mIsImmediate = true;
+          
+          int b = 0;
           
-          for (int p = 0; p < numPackets; p++)
+          while (b < 4 && bytesPos < smsg.mSize)
           {
-            AAX_CMidiPacket packet;
-            
-            packet.mTimestamp = (uint32_t) mSysexBuf.mOffset;
-            packet.mIsImmediate = true;
-            
-            int b = 0;
-            
-            while (b < 4 && bytesPos < mSysexBuf.mSize)
-            {
-              packet.mData[b++] = mSysexBuf.mData[bytesPos++];
-            }
-            
-            packet.mLength = (uint32_t) b;
-            
-            midiOut->PostMIDIPacket (&packet);
+            packet.mData[b++] = smsg.mData[bytesPos++];
           }
+          
+          packet.mLength = (uint32_t) b;
+          
+          midiOut->PostMIDIPacket (&packet);
         }
+        
+        mSysExDataFromEditor.Pop();
       }
     }
   }
@@ -464,8 +652,7 @@ AAX_Result IPlugAAX::SetChunk(AAX_CTypeID chunkID, const AAX_SPlugInChunk* pChun
   
   if (chunkID == GetUniqueID())
   {    
-    IByteChunk chunk;
-    chunk.PutBytes(pChunk->fData, pChunk->fSize);
+    const IByteChunkView chunk(pChunk->fData, pChunk->fSize);
     int pos = 0;
     //IByteChunk::GetIPlugVerFromChunk(chunk, pos); // TODO: IPlugVer should be in chunk!
     pos = UnserializeState(chunk, pos);
@@ -536,9 +723,9 @@ bool IPlugAAX::EditorResizeFromDelegate(int viewWidth, int viewHeight)
 
 void IPlugAAX::SetLatency(int latency)
 {
-  Controller()->SetSignalLatency(latency);
-  
   IPlugProcessor::SetLatency(latency); // will update delay time
+
+  Controller()->SetSignalLatency(GetLatency());
 }
 
 bool IPlugAAX::SendMidiMsg(const IMidiMsg& msg)
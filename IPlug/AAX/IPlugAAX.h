@@ -21,6 +21,7 @@
 #include "IPlugAPIBase.h"
 #include "IPlugProcessor.h"
 #include "IPlugMidi.h"
+#include "IPlugQueue.h"
 
 #include "IPlugAAX_Parameters.h"
 
@@ -73,6 +74,8 @@ private:
 };
 
 /**  AAX API base class for an IPlug plug-in
+* Parameter updates from the host arrive on the data model thread. They are stamped with the automation timestamp when Pro Tools provides one,
+* and handed to RenderAudio() through a lock-free queue, where they are put on the same block timeline as the other APIs, see SetSampleAccurateAutomation()
 *   @ingroup APIClasses */
 class IPlugAAX : public IPlugAPIBase
                , public IPlugProcessor
@@ -96,6 +99,7 @@ public:
   bool SendMidiMsg(const IMidiMsg& msg) override;
   
   AAX_Result UpdateParameterNormalizedValue(AAX_CParamID iParameterID, double iValue, AAX_EUpdateSource iSource) override;
+  AAX_Result GenerateCoefficients() override;
   
   //AAX_CIPlugParameters Overrides
   static AAX_CEffectParameters *AAX_CALLBACK Create();
@@ -114,11 +118,49 @@ public:
    */
   void DirtyPTCompareState() { mNumPlugInChanges++; }
 
+  /** Opt-in to sample accurate parameter automation. Rather than applying the parameter changes queued for RenderAudio() before processing,
+   * they are placed in the block at their automation timestamps, and the block is split into sub-blocks between change points, calling ProcessBlock() for each sub-block.
+   * If you use IMidiQueue, make sure you call Flush(nFrames) at the end of ProcessBlock(), so that MIDI message offsets remain valid across sub-blocks.
+   * @param enable \c true in order to split the block at parameter change points
+   * @param minSubBlockSize The smallest sub-block (in samples) that will be processed. Changes closer together than this will be applied at the start of the next sub-block */
+  void SetSampleAccurateAutomation(bool enable, int minSubBlockSize = DEFAULT_MIN_SUBBLOCK_SIZE);
+
+  /** @return \c true if sample accurate parameter automation is enabled, see SetSampleAccurateAutomation() */
+  bool GetSampleAccurateAutomation() const { return mSampleAccurateAutomation; }
+
 private:
+  /** A host parameter update, passed from the data model thread to RenderAudio(). A timestamp of zero means the change is immediate */
+  struct ParamChange
+  {
+    int idx;
+    double value;
+    int64_t timestamp;
+  };
+
+  /** A single point on the block's timeline of parameter changes */
+  struct ParamChangePoint
+  {
+    int offset;
+    int order;
+    int idx;
+    double value;
+  };
+
+  void BuildParamChangePoints(int nFrames, int64_t blockSamplePos);
+  void ApplyParamChangePoints();
+  void ProcessSubBlocks(int nFrames);
+  void SetParameterFromRender(int idx, double value, int offset);
+
   AAX_CParameter<bool>* mBypassParameter = nullptr;
   AAX_ITransport* mTransport = nullptr;
   WDL_PtrList<WDL_String> mParamIDs;
   IMidiQueue mMidiOutputQueue;
+  WDL_TypedBuf<ParamChange> mPendingParamChanges; // data model thread only, waiting for GenerateCoefficients()
+  IPlugQueue<ParamChange> mParamChangesToRender {PARAM_TRANSFER_SIZE};
+  WDL_TypedBuf<ParamChange> mFutureParamChanges; // render thread only, changes stamped beyond the end of the last block
+  WDL_TypedBuf<ParamChangePoint> mParamChangePoints;
+  bool mSampleAccurateAutomation = false;
+  int mMinSubBlockSize = DEFAULT_MIN_SUBBLOCK_SIZE;
 };
 
 IPlugAAX* MakePlug(const InstanceInfo& info);
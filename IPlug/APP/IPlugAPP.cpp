@@ -102,12 +102,17 @@ void IPlugAPP::SendSysexMsgFromUI(const ISysEx& msg)
   SendSysEx(msg);
 }
 
-void IPlugAPP::AppProcess(double** inputs, double** outputs, int nFrames)
+void IPlugAPP::AppProcess(sample** inputs, sample** outputs, int nFrames)
 {
+  REALTIME_SCOPE;
+  IFlushDenormalsScope denormalsScope(GetFlushDenormals());
+
+  ProcessDeferredParamChanges();
+
   SetChannelConnections(ERoute::kInput, 0, MaxNChannels(ERoute::kInput), !IsInstrument()); //TODO: go elsewhere - enable inputs
   SetChannelConnections(ERoute::kOutput, 0, MaxNChannels(ERoute::kOutput), true); //TODO: go elsewhere
-  AttachBuffers(ERoute::kInput, 0, NChannelsConnected(ERoute::kInput), inputs, GetBlockSize());
-  AttachBuffers(ERoute::kOutput, 0, NChannelsConnected(ERoute::kOutput), outputs, GetBlockSize());
+  AttachBuffers(ERoute::kInput, 0, NChannelsConnected(ERoute::kInput), inputs, nFrames);
+  AttachBuffers(ERoute::kOutput, 0, NChannelsConnected(ERoute::kOutput), outputs, nFrames);
   
   if(mMidiMsgsFromCallback.ElementsAvailable())
   {
@@ -115,21 +120,18 @@ void IPlugAPP::AppProcess(double** inputs, double** outputs, int nFrames)
     
     while (mMidiMsgsFromCallback.Pop(msg))
     {
-      ProcessMidiMsg(msg);
+      ReceiveMidiMsg(msg);
       mMidiMsgsFromProcessor.Push(msg); // queue incoming MIDI for UI
     }
   }
   
-  if(mSysExMsgsFromCallback.ElementsAvailable())
+  ISysEx sysExMsg;
+  
+  while (mSysExMsgsFromCallback.Peek(sysExMsg))
   {
-    SysExData data;
-    
-    while (mSysExMsgsFromCallback.Pop(data))
-    {
-      ISysEx msg { data.mOffset, data.mData, data.mSize };
-      ProcessSysEx(msg);
-      mSysExDataFromProcessor.Push(data); // queue incoming Sysex for UI
-    }
+    ProcessSysEx(sysExMsg);
+    mSysExDataFromProcessor.Push(sysExMsg); // queue incoming Sysex for UI
+    mSysExMsgsFromCallback.Pop();
   }
   
   if(mMidiMsgsFromEditor.ElementsAvailable())
@@ -138,11 +140,14 @@ void IPlugAPP::AppProcess(double** inputs, double** outputs, int nFrames)
 
     while (mMidiMsgsFromEditor.Pop(msg))
     {
-      ProcessMidiMsg(msg);
+      ReceiveMidiMsg(msg);
     }
   }
 
   //Do not handle Sysex messages here - SendSysexMsgFromUI overridden
 
-  ProcessBuffers(0.0, GetBlockSize());
+  if (!SkipSilentBuffers(sample(0.), nFrames))
+    ProcessBuffers(sample(0.), nFrames);
+
+  ClearBlockEvents();
 }
@@ -40,25 +40,31 @@ public:
   
   //IPlugAPIBase
   void BeginInformHostOfParamChange(int idx) override {};
-  void InformHostOfParamChange(int idx, double normalizedValue) override {};
+  void InformHostOfParamChange(int idx, double normalizedValue) override { WakeFromSilence(); }; // the UI is the only source of parameter changes
   void EndInformHostOfParamChange(int idx) override {};
   void InformHostOfProgramChange() override {};
   bool EditorResizeFromDelegate(int viewWidth, int viewHeight) override;
 
   //IEditorDelegate
   void SendSysexMsgFromUI(const ISysEx& msg) override;
+  void GetMemoryReport(IMemoryReport& report) const override
+  {
+    IPlugAPIBase::GetMemoryReport(report);
+    report.Add("MIDI queue from driver", mMidiMsgsFromCallback.GetMemoryUsage());
+    report.Add("SysEx queue from driver", mSysExMsgsFromCallback.GetMemoryUsage());
+  }
   
   //IPlugProcessor
   bool SendMidiMsg(const IMidiMsg& msg) override;
   bool SendSysEx(const ISysEx& msg) override;
   
   //IPlugAPP
-  void AppProcess(double** inputs, double** outputs, int nFrames);
+  void AppProcess(sample** inputs, sample** outputs, int nFrames);
 
 private:
   IPlugAPPHost* mAppHost = nullptr;
   IPlugQueue<IMidiMsg> mMidiMsgsFromCallback {MIDI_TRANSFER_SIZE};
-  IPlugQueue<SysExData> mSysExMsgsFromCallback {SYSEX_TRANSFER_SIZE};
+  IPlugSysExQueue mSysExMsgsFromCallback {SYSEX_TRANSFER_BYTES};
 
   friend class IPlugAPPHost;
 };
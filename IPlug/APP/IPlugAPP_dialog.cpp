@@ -17,6 +17,8 @@
 #define GET_MENU() GetMenu(gHWND)
 #elif defined OS_MAC
 #define GET_MENU() SWELL_GetCurrentMenu()
+#elif defined OS_LINUX
+#define GET_MENU() GetMenu(gHWND)
 #endif
 
 using namespace iplug;
@@ -129,6 +131,10 @@ void IPlugAPPHost::PopulateDriverSpecificControls(HWND hwndDlg)
     ComboBox_Enable(GetDlgItem(hwndDlg, IDC_COMBO_AUDIO_IN_DEV), TRUE);
     Button_Enable(GetDlgItem(hwndDlg, IDC_BUTTON_OS_DEV_SETTINGS), FALSE);
   }
+#elif defined OS_LINUX
+  int driverType = (int) SendDlgItemMessage(hwndDlg, IDC_COMBO_AUDIO_DRIVER, CB_GETCURSEL, 0, 0);
+  // JACK's connections and period are managed by the server, so the settings button opens its control app
+  Button_Enable(GetDlgItem(hwndDlg, IDC_BUTTON_OS_DEV_SETTINGS), driverType == kDeviceJack);
 #endif
 
   int indevidx = 0;
@@ -288,10 +294,32 @@ void IPlugAPPHost::PopulatePreferencesDialog(HWND hwndDlg)
   PopulateAudioDialogs(hwndDlg);
   PopulateMidiDialogs(hwndDlg);
 }
+
+#elif defined OS_LINUX
+void IPlugAPPHost::PopulatePreferencesDialog(HWND hwndDlg)
+{
+  SendDlgItemMessage(hwndDlg,IDC_COMBO_AUDIO_DRIVER,CB_ADDSTRING,0,(LPARAM)"ALSA");
+  SendDlgItemMessage(hwndDlg,IDC_COMBO_AUDIO_DRIVER,CB_ADDSTRING,0,(LPARAM)"JACK");
+  SendDlgItemMessage(hwndDlg,IDC_COMBO_AUDIO_DRIVER,CB_SETCURSEL, mState.mAudioDriverType, 0);
+
+  PopulateAudioDialogs(hwndDlg);
+  PopulateMidiDialogs(hwndDlg);
+}
 #else
   #error NOT IMPLEMENTED
 #endif
 
+#ifdef IDC_STATIC_AUDIO_STATS
+static constexpr UINT_PTR kAudioStatsTimerID = 1;
+
+void IPlugAPPHost::UpdateAudioStatsText(HWND hwndDlg)
+{
+  WDL_String str;
+  GetAudioStatsText(str);
+  SetDlgItemText(hwndDlg, IDC_STATIC_AUDIO_STATS, str.Get());
+}
+#endif
+
 WDL_DLGRET IPlugAPPHost::PreferencesDlgProc(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
   IPlugAPPHost* _this = sInstance.get();
@@ -305,9 +333,24 @@ WDL_DLGRET IPlugAPPHost::PreferencesDlgProc(HWND hwndDlg, UINT uMsg, WPARAM wPar
     case WM_INITDIALOG:
       _this->PopulatePreferencesDialog(hwndDlg);
       mTempState = mState;
+#ifdef IDC_STATIC_AUDIO_STATS
+      _this->UpdateAudioStatsText(hwndDlg);
+      SetTimer(hwndDlg, kAudioStatsTimerID, 250, NULL);
+#endif
       
       return TRUE;
 
+#ifdef IDC_STATIC_AUDIO_STATS
+    case WM_TIMER:
+      if (wParam == kAudioStatsTimerID)
+        _this->UpdateAudioStatsText(hwndDlg);
+      break;
+
+    case WM_DESTROY:
+      KillTimer(hwndDlg, kAudioStatsTimerID);
+      break;
+#endif
+
     case WM_COMMAND:
       switch (LOWORD(wParam))
       {
@@ -457,6 +500,9 @@ WDL_DLGRET IPlugAPPHost::PreferencesDlgProc(HWND hwndDlg, UINT uMsg, WPARAM wPar
               ASIOControlPanel();
             #elif defined OS_MAC
             system("open \"/Applications/Utilities/Audio MIDI Setup.app\"");
+            #elif defined OS_LINUX
+            if (_this->mState.mAudioDriverType == kDeviceJack)
+              system("qjackctl &");
             #else
               #error NOT IMPLEMENTED
             #endif
@@ -480,6 +526,16 @@ WDL_DLGRET IPlugAPPHost::PreferencesDlgProc(HWND hwndDlg, UINT uMsg, WPARAM wPar
           }
           break;
 
+#ifdef IDC_STATIC_AUDIO_STATS
+        case IDC_BUTTON_MEASURE_LATENCY:
+          _this->StartLatencyTest();
+          break;
+
+        case IDC_BUTTON_RESET_STATS:
+          _this->ResetAudioStats();
+          break;
+#endif
+
         case IDC_COMBO_MIDI_IN_CHAN:
           if (HIWORD(wParam) == CBN_SELCHANGE)
             mState.mMidiInChan = (int) SendDlgItemMessage(hwndDlg, IDC_COMBO_MIDI_IN_CHAN, CB_GETCURSEL, 0, 0);
@@ -675,6 +731,26 @@ WDL_DLGRET IPlugAPPHost::MainDlgProc(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPA
           
           return 0;
         }
+#ifdef ID_SHOW_DRAW_TIMES
+        case ID_SHOW_DRAW_TIMES:
+        {
+          IGEditorDelegate* pPlug = dynamic_cast<IGEditorDelegate*>(pAppHost->GetPlug());
+          
+          if(pPlug)
+          {
+            IGraphics* pGraphics = pPlug->GetUI();
+            
+            if(pGraphics)
+            {
+              bool enabled = pGraphics->ShowControlDrawTimesEnabled();
+              pGraphics->ShowControlDrawTimes(!enabled);
+              CheckMenuItem(GET_MENU(), ID_SHOW_DRAW_TIMES, MF_BYCOMMAND | enabled ? MF_UNCHECKED : MF_CHECKED);
+            }
+          }
+          
+          return 0;
+        }
+#endif
 #endif
       }
       return 0;
@@ -10,10 +10,17 @@
 
 #include "IPlugAPP_host.h"
 
+#include <cmath>
+
 #ifdef OS_WIN
 #include <sys/stat.h>
 #endif
 
+#ifdef __UNIX_JACK__
+#include <jack/jack.h>
+#include <jack/transport.h>
+#endif
+
 #include "IPlugLogger.h"
 
 using namespace iplug;
@@ -24,6 +31,11 @@ using namespace iplug;
 
 #define STRBUFSZ 100
 
+// loopback latency test
+static constexpr int kLatencyTestNImpulses = 5;
+static constexpr double kLatencyTestImpulseLevel = 0.5;
+static constexpr double kLatencyTestThreshold = 0.1;
+
 std::unique_ptr<IPlugAPPHost> IPlugAPPHost::sInstance;
 UINT gSCROLLMSG;
 
@@ -45,6 +57,10 @@ IPlugAPPHost::~IPlugAPPHost()
     if(mDAC->isStreamOpen())
       mDAC->abortStream();
   }
+
+#ifdef __UNIX_JACK__
+  CloseJackTransport();
+#endif
 }
 
 //static
@@ -92,6 +108,13 @@ bool IPlugAPPHost::InitState()
   mINIPath.SetFormatted(MAX_PATH_LEN, "%s\\%s\\", strPath, BUNDLE_NAME);
 #elif defined OS_MAC
   mINIPath.SetFormatted(MAX_PATH_LEN, "%s/Library/Application Support/%s/", getenv("HOME"), BUNDLE_NAME);
+#elif defined OS_LINUX
+  const char* pConfigDir = getenv("XDG_CONFIG_HOME");
+
+  if (pConfigDir && *pConfigDir)
+    mINIPath.SetFormatted(MAX_PATH_LEN, "%s/%s/", pConfigDir, BUNDLE_NAME);
+  else
+    mINIPath.SetFormatted(MAX_PATH_LEN, "%s/.config/%s/", getenv("HOME"), BUNDLE_NAME);
 #else
   #error NOT IMPLEMENTED
 #endif
@@ -141,14 +164,14 @@ bool IPlugAPPHost::InitState()
     CreateDirectory(mINIPath.Get(), NULL);
     mINIPath.Append("settings.ini");
     UpdateINI(); // will write file if doesn't exist
-#elif defined OS_MAC
+#elif defined OS_MAC || defined OS_LINUX
     mode_t process_mask = umask(0);
     int result_code = mkdir(mINIPath.Get(), S_IRWXU | S_IRWXG | S_IRWXO);
     umask(process_mask);
 
     if(!result_code)
     {
-      mINIPath.Append("\\settings.ini");
+      mINIPath.Append("settings.ini");
       UpdateINI(); // will write file if doesn't exist
     }
     else
@@ -225,7 +248,7 @@ int IPlugAPPHost::GetMIDIPortNumber(ERoute direction, const char* nameToTest) co
   {
     if(!strcmp(nameToTest, OFF_TEXT)) return 0;
     
-  #ifdef OS_MAC
+  #if defined OS_MAC || defined OS_LINUX
     start = 2;
     if(!strcmp(nameToTest, "virtual input")) return 1;
   #endif
@@ -240,7 +263,7 @@ int IPlugAPPHost::GetMIDIPortNumber(ERoute direction, const char* nameToTest) co
   {
     if(!strcmp(nameToTest, OFF_TEXT)) return 0;
   
-  #ifdef OS_MAC
+  #if defined OS_MAC || defined OS_LINUX
     start = 2;
     if(!strcmp(nameToTest, "virtual output")) return 1;
   #endif
@@ -313,7 +336,7 @@ void IPlugAPPHost::ProbeMidiIO()
 
     mMidiInputDevNames.push_back(OFF_TEXT);
 
-#ifdef OS_MAC
+#if defined OS_MAC || defined OS_LINUX
     mMidiInputDevNames.push_back("virtual input");
 #endif
 
@@ -326,7 +349,7 @@ void IPlugAPPHost::ProbeMidiIO()
 
     mMidiOutputDevNames.push_back(OFF_TEXT);
 
-#ifdef OS_MAC
+#if defined OS_MAC || defined OS_LINUX
     mMidiOutputDevNames.push_back("virtual output");
 #endif
 
@@ -386,6 +409,12 @@ bool IPlugAPPHost::TryToChangeAudioDriverType()
     mDAC = std::make_unique<RtAudio>(RtAudio::MACOSX_CORE);
   //else
   //mDAC = std::make_unique<RtAudio>(RtAudio::UNIX_JACK);
+#elif defined OS_LINUX
+  // PipeWire serves both of these through its ALSA plug-in and its JACK replacement library
+  if(mState.mAudioDriverType == kDeviceJack)
+    mDAC = std::make_unique<RtAudio>(RtAudio::UNIX_JACK);
+  else
+    mDAC = std::make_unique<RtAudio>(RtAudio::LINUX_ALSA);
 #else
   #error NOT IMPLEMENTED
 #endif
@@ -406,7 +435,7 @@ bool IPlugAPPHost::TryToChangeAudio()
     inputID = GetAudioDeviceIdx(mState.mAudioOutDev.Get());
   else
     inputID = GetAudioDeviceIdx(mState.mAudioInDev.Get());
-#elif defined OS_MAC
+#elif defined OS_MAC || defined OS_LINUX
   inputID = GetAudioDeviceIdx(mState.mAudioInDev.Get());
 #else
   #error NOT IMPLEMENTED
@@ -491,7 +520,7 @@ bool IPlugAPPHost::SelectMIDIDevice(ERoute direction, const char* pPortName)
         mMidiIn->openPort(port-1);
         return true;
       }
-  #elif defined OS_MAC
+  #elif defined OS_MAC || defined OS_LINUX
       else if(port == 1)
       {
         std::string virtualMidiInputName = "To ";
@@ -531,7 +560,7 @@ bool IPlugAPPHost::SelectMIDIDevice(ERoute direction, const char* pPortName)
         mMidiOut->openPort(port-1);
         return true;
       }
-#elif defined OS_MAC
+#elif defined OS_MAC || defined OS_LINUX
       else if(port == 1)
       {
         std::string virtualMidiOutputName = "From ";
@@ -572,35 +601,97 @@ bool IPlugAPPHost::InitAudio(uint32_t inId, uint32_t outId, uint32_t sr, uint32_
     mDAC->closeStream();
   }
 
+  // the plug-in's channels are mapped to consecutive device channels, starting at the ones chosen in the preferences
+  uint32_t nDevInputs = 0, nDevOutputs = 0;
+
+  try
+  {
+    nDevInputs = mDAC->getDeviceInfo(inId).inputChannels;
+    const RtAudio::DeviceInfo outInfo = mDAC->getDeviceInfo(outId);
+    nDevOutputs = outInfo.outputChannels;
+
+    // the JACK server runs at one sample rate, and RtAudio won't open a stream at any other
+    if (mDAC->getCurrentApi() == RtAudio::UNIX_JACK && outInfo.preferredSampleRate && sr != outInfo.preferredSampleRate)
+    {
+      DBGMSG("using the JACK server's sample rate of %i instead of %i\n", outInfo.preferredSampleRate, sr);
+      sr = mState.mAudioSR = outInfo.preferredSampleRate;
+    }
+  }
+  catch (RtAudioError& e)
+  {
+    e.printMessage();
+  }
+
+  const uint32_t firstInput = std::min(mState.mAudioInChanL > 0 ? mState.mAudioInChanL - 1 : 0, nDevInputs);
+  const uint32_t firstOutput = std::min(mState.mAudioOutChanL > 0 ? mState.mAudioOutChanL - 1 : 0, nDevOutputs);
+
+  mNInputChans = std::min<int>(mIPlug->MaxNChannels(ERoute::kInput), nDevInputs - firstInput);
+  mNOutputChans = std::min<int>(mIPlug->MaxNChannels(ERoute::kOutput), nDevOutputs - firstOutput);
+
   RtAudio::StreamParameters iParams, oParams;
   iParams.deviceId = inId;
-  iParams.nChannels = 2; // TODO: flexible channel count
-  iParams.firstChannel = 0; // TODO: flexible channel count
+  iParams.nChannels = mNInputChans;
+  iParams.firstChannel = firstInput;
 
   oParams.deviceId = outId;
-  oParams.nChannels = 2; // TODO: flexible channel count
-  oParams.firstChannel = 0; // TODO: flexible channel count
+  oParams.nChannels = mNOutputChans;
+  oParams.firstChannel = firstOutput;
 
   mBufferSize = iovs; // mBufferSize may get changed by stream
 
-  DBGMSG("\ntrying to start audio stream @ %i sr, %i buffersize\nindev = %i:%s\noutdev = %i:%s\n", sr, mBufferSize, inId, GetAudioDeviceName(inId).c_str(), outId, GetAudioDeviceName(outId).c_str());
+  DBGMSG("\ntrying to start audio stream @ %i sr, %i buffersize\nindev = %i:%s, %i channels\noutdev = %i:%s, %i channels\n", sr, mBufferSize, inId, GetAudioDeviceName(inId).c_str(), mNInputChans, outId, GetAudioDeviceName(outId).c_str(), mNOutputChans);
 
   RtAudio::StreamOptions options;
   options.flags = RTAUDIO_NONINTERLEAVED;
-  // options.streamName = BUNDLE_NAME; // JACK stream name, not used on other streams
+  options.streamName = BUNDLE_NAME; // JACK client name, not used on other streams
+#ifdef OS_LINUX
+  // ALSA gets a SCHED_RR callback thread (when the user is allowed one) and two periods of mBufferSize, so the output latency is a single period
+  options.flags |= RTAUDIO_SCHEDULE_REALTIME | RTAUDIO_MINIMIZE_LATENCY;
+  options.priority = APP_AUDIO_THREAD_PRIORITY;
+#endif
 
-  mBufIndex = 0;
   mSamplesElapsed = 0;
+  ClearAudioStats(); // the stream is closed, so the audio thread can't be using them
   mFadeMult = 0.;
   mSampleRate = (double) sr;
-  
-  mIPlug->SetBlockSize(APP_SIGNAL_VECTOR_SIZE);
-  mIPlug->SetSampleRate(mSampleRate);
-  mIPlug->OnReset();
 
   try
   {
-    mDAC->openStream(&oParams, &iParams, RTAUDIO_FLOAT64, sr, &mBufferSize, &AudioCallback, NULL, &options /*, &ErrorCallback */);
+    // open the stream in the plug-in's sample type, so that the buffers can be processed without conversion
+#ifdef SAMPLE_TYPE_FLOAT
+    const RtAudioFormat format = RTAUDIO_FLOAT32;
+#else
+    const RtAudioFormat format = RTAUDIO_FLOAT64;
+#endif
+    mDAC->openStream(mNOutputChans ? &oParams : nullptr, mNInputChans ? &iParams : nullptr, format, sr, &mBufferSize, &AudioCallback, NULL, &options /*, &ErrorCallback */);
+
+    // the device (or the JACK server, whose period is fixed) may not support the requested buffer size, show the one that was negotiated
+    if (mBufferSize != iovs)
+    {
+      DBGMSG("the device is using a buffer size of %i instead of %i\n", mBufferSize, iovs);
+      mState.mBufferSize = mBufferSize;
+    }
+
+    // the plug-in processes a whole device buffer per call, unless the config asks for smaller blocks
+    const int blockSize = (APP_SIGNAL_VECTOR_SIZE > 0) ? std::min<int>(APP_SIGNAL_VECTOR_SIZE, mBufferSize) : static_cast<int>(mBufferSize);
+
+    mIPlug->SetBlockSize(blockSize);
+    mIPlug->SetSampleRate(mSampleRate);
+    mIPlug->OnReset();
+
+    // plug-in channels that the device doesn't have read silence and write to a scratch buffer
+    mInputPtrs.assign(mIPlug->MaxNChannels(ERoute::kInput), nullptr);
+    mOutputPtrs.assign(mIPlug->MaxNChannels(ERoute::kOutput), nullptr);
+    mSilentBuffer.assign(blockSize, 0.);
+    mScratchBuffer.assign(blockSize, 0.);
+
+#ifdef __UNIX_JACK__
+    if (mDAC->getCurrentApi() == RtAudio::UNIX_JACK)
+      OpenJackTransport();
+    else
+      CloseJackTransport();
+#endif
+
     mDAC->startStream();
 
     mActiveState = mState;
@@ -652,53 +743,284 @@ int IPlugAPPHost::AudioCallback(void* pOutputBuffer, void* pInputBuffer, uint32_
 
   IPlugAPPHost* _this = sInstance.get();
 
-  double* pInputBufferD = static_cast<double*>(pInputBuffer);
-  double* pOutputBufferD = static_cast<double*>(pOutputBuffer);
-
-  int inRightOffset = 0;
+  _this->MeasureCallbackTiming(nFrames, status);
 
-//  if(!mState.mAudioInIsMono)
-    inRightOffset = nFrames;
+  sample* pInputBufferD = static_cast<sample*>(pInputBuffer);
+  sample* pOutputBufferD = static_cast<sample*>(pOutputBuffer);
 
   if (_this->mVecElapsed > APP_N_VECTOR_WAIT ) // wait APP_N_VECTOR_WAIT * iovs before processing audio, to avoid clicks
   {
-    for (int i=0; i<nFrames; i++)
+    _this->ProcessBlocks(pInputBufferD, pOutputBufferD, nFrames);
+  }
+  else
+  {
+    memset(pOutputBufferD, 0, nFrames * _this->mNOutputChans * sizeof(sample));
+  }
+
+  if (pInputBufferD && (_this->mLatencyTestRequested.exchange(false) || _this->mLatencyTestRunning))
+    _this->ProcessLatencyTest(pInputBufferD, pOutputBufferD, nFrames);
+  
+  _this->mVecElapsed++;
+
+  return 0;
+}
+
+void IPlugAPPHost::ProcessBlocks(sample* pInputs, sample* pOutputs, uint32_t nFrames)
+{
+  const int blockSize = mIPlug->GetBlockSize();
+  const int nInputs = static_cast<int>(mInputPtrs.size());
+  const int nOutputs = static_cast<int>(mOutputPtrs.size());
+
+#ifdef __UNIX_JACK__
+  ITimeInfo timeInfo;
+  const bool hasTransport = GetJackTimeInfo(timeInfo);
+  const double samplesPerBeat = mSampleRate * 60. / timeInfo.mTempo;
+#endif
+
+  // the stream is non-interleaved, so each channel is a contiguous run of nFrames samples
+  for (uint32_t offset = 0; offset < nFrames; offset += blockSize)
+  {
+    const int n = std::min<int>(blockSize, nFrames - offset);
+
+    for (int c = 0; c < nInputs; c++)
+      mInputPtrs[c] = c < mNInputChans ? pInputs + (c * nFrames) + offset : mSilentBuffer.data();
+
+    for (int c = 0; c < nOutputs; c++)
+      mOutputPtrs[c] = c < mNOutputChans ? pOutputs + (c * nFrames) + offset : mScratchBuffer.data();
+
+#ifdef __UNIX_JACK__
+    if (hasTransport)
     {
-      _this->mBufIndex %= APP_SIGNAL_VECTOR_SIZE;
+      ITimeInfo blockTimeInfo = timeInfo;
 
-      if (_this->mBufIndex == 0)
+      if (timeInfo.mTransportIsRunning)
       {
-        double* inputs[2] = {pInputBufferD + i, pInputBufferD + inRightOffset + i};
-        double* outputs[2] = {pOutputBufferD + i, pOutputBufferD + nFrames + i};
-
-        _this->mIPlug->AppProcess(inputs, outputs, APP_SIGNAL_VECTOR_SIZE);
+        blockTimeInfo.mSamplePos += offset;
 
-        _this->mSamplesElapsed += APP_SIGNAL_VECTOR_SIZE;
+        if (timeInfo.mPPQPos >= 0.)
+          blockTimeInfo.mPPQPos += offset / samplesPerBeat;
       }
 
-      // fade in
-      if (_this->mFadeMult < 1.)
+      mIPlug->SetTimeInfo(blockTimeInfo);
+    }
+#endif
+
+    mIPlug->AppProcess(mInputPtrs.data(), mOutputPtrs.data(), n);
+    mSamplesElapsed += n;
+  }
+
+  // fade in over the first buffer, then only APP_MULT is applied
+  const double fadeStart = mFadeMult;
+  const double fadeInc = 1. / nFrames;
+
+  if (fadeStart < 1. || APP_MULT != 1)
+  {
+    for (int c = 0; c < mNOutputChans; c++)
+    {
+      sample* pChan = pOutputs + (c * nFrames);
+      double fade = fadeStart;
+
+      for (uint32_t i = 0; i < nFrames; i++)
       {
-        _this->mFadeMult += (1. / nFrames);
+        if (fade < 1.)
+          fade = std::min(fade + fadeInc, 1.);
+
+        pChan[i] *= static_cast<sample>(fade * APP_MULT);
       }
+    }
 
-      pOutputBufferD[i] *= _this->mFadeMult;
-      pOutputBufferD[i + nFrames] *= _this->mFadeMult;
+    mFadeMult = std::min(fadeStart + fadeInc * nFrames, 1.);
+  }
+}
 
-      pOutputBufferD[i] *= APP_MULT;
-      pOutputBufferD[i + nFrames] *= APP_MULT;
+#ifdef __UNIX_JACK__
+void IPlugAPPHost::OpenJackTransport()
+{
+  if (mJackTransportClient)
+    return;
+
+  WDL_String name;
+  name.SetFormatted(64, "%s transport", BUNDLE_NAME);
+
+  mJackTransportClient = jack_client_open(name.Get(), JackNoStartServer, nullptr);
+
+  if (mJackTransportClient)
+    jack_activate(mJackTransportClient);
+  else
+    DBGMSG("couldn't open a JACK client for the transport, the plug-in won't get any time info\n");
+}
+
+void IPlugAPPHost::CloseJackTransport()
+{
+  if (mJackTransportClient)
+  {
+    jack_deactivate(mJackTransportClient);
+    jack_client_close(mJackTransportClient);
+    mJackTransportClient = nullptr;
+  }
+}
+
+bool IPlugAPPHost::GetJackTimeInfo(ITimeInfo& timeInfo) const
+{
+  if (!mJackTransportClient)
+    return false;
+
+  // jack_transport_query() is real-time safe
+  jack_position_t pos;
+  const jack_transport_state_t state = jack_transport_query(mJackTransportClient, &pos);
+
+  timeInfo.mSamplePos = (double) pos.frame;
+  timeInfo.mTransportIsRunning = (state == JackTransportRolling);
+
+  // bars, beats and tempo are only there when a timebase master (e.g. a DAW) is running
+  if ((pos.valid & JackPositionBBT) && pos.beats_per_minute > 0. && pos.ticks_per_beat > 0. && pos.beat_type > 0.f)
+  {
+    // JACK counts bars and beats from 1, and its beats are beat_type notes rather than quarter notes
+    const double quartersPerBeat = 4. / pos.beat_type;
+    const double barStartBeats = (pos.bar - 1) * (double) pos.beats_per_bar;
+
+    timeInfo.mTempo = pos.beats_per_minute / quartersPerBeat;
+    timeInfo.mNumerator = (int) pos.beats_per_bar;
+    timeInfo.mDenominator = (int) pos.beat_type;
+    timeInfo.mLastBar = barStartBeats * quartersPerBeat;
+    timeInfo.mPPQPos = (barStartBeats + (pos.beat - 1) + (pos.tick / pos.ticks_per_beat)) * quartersPerBeat;
+  }
 
-      _this->mBufIndex++;
+  return true;
+}
+#endif
+
+void IPlugAPPHost::ClearAudioStats()
+{
+  mAudioStats.mNCallbacks = 0;
+  mAudioStats.mNXRuns = 0;
+  mAudioStats.mMeanIntervalMs = 0.;
+  mAudioStats.mMaxIntervalMs = 0.;
+  mAudioStats.mMeanJitterMs = 0.;
+  mAudioStats.mMaxJitterMs = 0.;
+  mHasLastCallbackTime = false;
+  mNIntervals = 0;
+  mIntervalSumMs = 0.;
+  mJitterSumMs = 0.;
+}
+
+void IPlugAPPHost::MeasureCallbackTiming(uint32_t nFrames, RtAudioStreamStatus status)
+{
+  const auto now = std::chrono::steady_clock::now();
+
+  if (mResetStatsRequested.exchange(false))
+    ClearAudioStats();
+
+  mAudioStats.mNCallbacks++;
+
+  if (status)
+    mAudioStats.mNXRuns++;
+
+  // the first callbacks are often delivered in a burst while the driver fills its buffers
+  if (mVecElapsed > APP_N_VECTOR_WAIT && mHasLastCallbackTime)
+  {
+    const double intervalMs = std::chrono::duration<double, std::milli>(now - mLastCallbackTime).count();
+    const double jitterMs = std::fabs(intervalMs - 1000. * nFrames / mSampleRate);
+
+    mNIntervals++;
+    mIntervalSumMs += intervalMs;
+    mJitterSumMs += jitterMs;
+
+    mAudioStats.mMeanIntervalMs = mIntervalSumMs / mNIntervals;
+    mAudioStats.mMeanJitterMs = mJitterSumMs / mNIntervals;
+
+    if (intervalMs > mAudioStats.mMaxIntervalMs)
+      mAudioStats.mMaxIntervalMs = intervalMs;
+
+    if (jitterMs > mAudioStats.mMaxJitterMs)
+      mAudioStats.mMaxJitterMs = jitterMs;
+  }
+
+  mLastCallbackTime = now;
+  mHasLastCallbackTime = true;
+}
+
+void IPlugAPPHost::ProcessLatencyTest(const sample* pInputL, sample* pOutputs, uint32_t nFrames)
+{
+  const int impulseGap = static_cast<int>(mSampleRate / 10.); // let the previous impulse die away
+  const int timeout = static_cast<int>(mSampleRate / 2.);
+
+  if (!mLatencyTestRunning)
+  {
+    mLatencyTestImpulsesLeft = kLatencyTestNImpulses;
+    mLatencyTestFramesToImpulse = impulseGap;
+    mLatencyTestFramesSinceImpulse = -1;
+    mLatencyTestSum = 0;
+    mLatencyTestNDetected = 0;
+    mLatencyTestRunning = true;
+  }
+
+  memset(pOutputs, 0, nFrames * mNOutputChans * sizeof(sample));
+
+  for (uint32_t i = 0; i < nFrames; i++)
+  {
+    if (mLatencyTestFramesSinceImpulse >= 0)
+    {
+      mLatencyTestFramesSinceImpulse++;
+
+      if (std::fabs(pInputL[i]) > kLatencyTestThreshold)
+      {
+        mLatencyTestSum += mLatencyTestFramesSinceImpulse;
+        mLatencyTestNDetected++;
+        mLatencyTestFramesSinceImpulse = -1;
+        mLatencyTestFramesToImpulse = impulseGap;
+      }
+      else if (mLatencyTestFramesSinceImpulse > timeout)
+      {
+        mLatencyTestFramesSinceImpulse = -1;
+        mLatencyTestFramesToImpulse = impulseGap;
+      }
+    }
+    else if (mLatencyTestImpulsesLeft == 0)
+    {
+      mAudioStats.mLoopbackLatency = mLatencyTestNDetected ? (mLatencyTestSum + mLatencyTestNDetected / 2) / mLatencyTestNDetected : static_cast<int>(AudioStats::kLatencyNoSignal);
+      mLatencyTestRunning = false;
+      return;
+    }
+    else if (--mLatencyTestFramesToImpulse <= 0)
+    {
+      for (int c = 0; c < std::min(mNOutputChans, 2); c++)
+        pOutputs[i + (c * nFrames)] = kLatencyTestImpulseLevel;
+
+      mLatencyTestFramesSinceImpulse = 0;
+      mLatencyTestImpulsesLeft--;
     }
   }
-  else
+}
+
+void IPlugAPPHost::GetAudioStatsText(WDL_String& str) const
+{
+  const AudioStats& stats = mAudioStats;
+  const double bufferMs = 1000. * mBufferSize / mSampleRate;
+
+  str.SetFormatted(1024, "Callbacks: %u, xruns: %u\n"
+                         "Interval: mean %.2f ms, max %.2f ms (buffer %.2f ms)\n"
+                         "Jitter: mean %.3f ms, max %.3f ms\n",
+                   stats.mNCallbacks.load(), stats.mNXRuns.load(),
+                   stats.mMeanIntervalMs.load(), stats.mMaxIntervalMs.load(), bufferMs,
+                   stats.mMeanJitterMs.load(), stats.mMaxJitterMs.load());
+
+  if (mDAC && mDAC->isStreamOpen())
   {
-    memset(pOutputBufferD, 0, nFrames * APP_NUM_CHANNELS * sizeof(double));
+    const long reported = mDAC->getStreamLatency();
+    str.AppendFormatted(256, "Driver latency: %ld frames (%.2f ms)\n", reported, 1000. * reported / mSampleRate);
   }
-  
-  _this->mVecElapsed++;
 
-  return 0;
+  const int loopback = stats.mLoopbackLatency;
+
+  if (mLatencyTestRunning)
+    str.Append("Loopback latency: measuring...");
+  else if (loopback == AudioStats::kLatencyNoSignal)
+    str.Append("Loopback latency: no signal on input 1");
+  else if (loopback >= 0)
+    str.AppendFormatted(256, "Loopback latency: %i frames (%.2f ms)", loopback, 1000. * loopback / mSampleRate);
+  else
+    str.Append("Loopback latency: not measured");
 }
 
 // static
@@ -711,15 +1033,9 @@ void IPlugAPPHost::MIDICallback(double deltatime, std::vector<uint8_t>* pMsg, vo
   
   if (pMsg->size() > 3)
   {
-    if(pMsg->size() > MAX_SYSEX_SIZE)
-    {
-      DBGMSG("SysEx message exceeds MAX_SYSEX_SIZE\n");
-      return;
-    }
-    
-    SysExData data { 0, static_cast<int>(pMsg->size()), pMsg->data() };
+    if (!_this->mIPlug->mSysExMsgsFromCallback.Push(0, pMsg->data(), static_cast<int>(pMsg->size())))
+      DBGMSG("SysEx message dropped, it is too big or the queue is full, increase SYSEX_TRANSFER_BYTES\n");
     
-    _this->mIPlug->mSysExMsgsFromCallback.Push(data);
     return;
   }
   else if (pMsg->size())
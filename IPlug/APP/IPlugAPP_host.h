@@ -25,9 +25,12 @@
  macOS: /Users/USERNAME/Library/Application\ Support/BUNDLE_NAME/settings.ini
  OR
  /Users/USERNAME/Library/Containers/BUNDLE_ID/Data/Library/Application Support/BUNDLE_NAME/settings.ini
+ Linux: $XDG_CONFIG_HOME/BUNDLE_NAME/settings.ini, or ~/.config/BUNDLE_NAME/settings.ini if XDG_CONFIG_HOME isn't set
  
  */
 
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
 #include <string>
 #include <vector>
@@ -57,6 +60,9 @@
   #define DEFAULT_OUTPUT_DEV "Built-in Output"
 #elif defined(OS_LINUX)
   #include "IPlugSWELL.h"
+  #define SLEEP( milliseconds ) usleep( (unsigned long) (milliseconds * 1000.0) )
+  #define DEFAULT_INPUT_DEV "default"
+  #define DEFAULT_OUTPUT_DEV "default"
 #endif
 
 #include "RtAudio.h"
@@ -64,6 +70,15 @@
 
 #define OFF_TEXT "off"
 
+/** The SCHED_RR priority requested for the ALSA callback thread on Linux. The JACK server creates its own real-time threads */
+#ifndef APP_AUDIO_THREAD_PRIORITY
+  #define APP_AUDIO_THREAD_PRIORITY 70
+#endif
+
+#ifdef __UNIX_JACK__
+typedef struct _jack_client jack_client_t;
+#endif
+
 extern HWND gHWND;
 extern HINSTANCE gHINSTANCE;
 
@@ -105,7 +120,7 @@ public:
     , mAudioOutDev(DEFAULT_OUTPUT_DEV)
     , mMidiInDev(OFF_TEXT)
     , mMidiOutDev(OFF_TEXT)
-    , mAudioDriverType(0) // DirectSound / CoreAudio by default
+    , mAudioDriverType(0) // DirectSound / CoreAudio / ALSA by default
     , mBufferSize(512)
     , mAudioSR(44100)
     , mMidiInChan(0)
@@ -156,6 +171,25 @@ public:
     bool operator!=(const AppState& rhs) { return !operator==(rhs); }
   };
   
+  /** Audio callback timing and loopback latency, written on the audio thread and read by the preferences dialog */
+  struct AudioStats
+  {
+    std::atomic<uint32_t> mNCallbacks {0};
+    /** Callbacks where the driver reported an input overflow or output underflow */
+    std::atomic<uint32_t> mNXRuns {0};
+    /** Mean and largest interval between callbacks, in milliseconds */
+    std::atomic<double> mMeanIntervalMs {0.};
+    std::atomic<double> mMaxIntervalMs {0.};
+    /** Mean and largest difference between the callback interval and the buffer duration, in milliseconds */
+    std::atomic<double> mMeanJitterMs {0.};
+    std::atomic<double> mMaxJitterMs {0.};
+    /** The round trip latency measured by the last loopback test in frames, kLatencyUnknown if there was none, kLatencyNoSignal if the impulses never came back */
+    std::atomic<int> mLoopbackLatency {kLatencyUnknown};
+
+    static constexpr int kLatencyUnknown = -1;
+    static constexpr int kLatencyNoSignal = -2;
+  };
+
   static IPlugAPPHost* Create();
   static std::unique_ptr<IPlugAPPHost> sInstance;
   
@@ -166,6 +200,7 @@ public:
   void PopulateAudioDialogs(HWND hwndDlg);
   bool PopulateMidiDialogs(HWND hwndDlg);
   void PopulatePreferencesDialog(HWND hwndDlg);
+  void UpdateAudioStatsText(HWND hwndDlg);
   
   IPlugAPPHost();
   ~IPlugAPPHost();
@@ -206,6 +241,20 @@ public:
   bool SelectMIDIDevice(ERoute direction, const char* portName);
   
   static int AudioCallback(void* pOutputBuffer, void* pInputBuffer, uint32_t nFrames, double streamTime, RtAudioStreamStatus status, void* pUserData);
+
+  /** Clear the callback statistics. The audio thread does the reset at the start of its next callback */
+  void ResetAudioStats() { mResetStatsRequested = true; }
+
+  /** Play impulses on both outputs, in place of the plug-in's output, and time how long they take to arrive at input 1.
+   * Connect an output to input 1 with a cable (or hold a microphone to a speaker) first. The result is in AudioStats::mLoopbackLatency */
+  void StartLatencyTest() { mLatencyTestRequested = true; }
+
+  bool IsLatencyTestRunning() const { return mLatencyTestRunning; }
+
+  const AudioStats& GetAudioStats() const { return mAudioStats; }
+
+  /** Describes the statistics for the preferences dialog */
+  void GetAudioStatsText(WDL_String& str) const;
   static void MIDICallback(double deltatime, std::vector<uint8_t>* pMsg, void* pUserData);
   static void ErrorCallback(RtAudioError::Type type, const std::string& errorText);
 
@@ -233,7 +282,50 @@ private:
   uint32_t mSamplesElapsed = 0;
   uint32_t mVecElapsed = 0;
   uint32_t mBufferSize = 512;
-  uint32_t mBufIndex; // index for signal vector, loops from 0 to mSigVS
+
+  /** The channels in the stream, which may be fewer than the plug-in's if the device doesn't have enough */
+  int mNInputChans = 0;
+  int mNOutputChans = 0;
+  /** Channel pointers into the stream's buffers for AppProcess(), allocated when the stream is opened */
+  std::vector<sample*> mInputPtrs;
+  std::vector<sample*> mOutputPtrs;
+  std::vector<sample> mSilentBuffer;
+  std::vector<sample> mScratchBuffer;
+
+  /** Calls AppProcess() with the stream's channels, in blocks of at most the plug-in's block size, then applies the fade in and APP_MULT */
+  void ProcessBlocks(sample* pInputs, sample* pOutputs, uint32_t nFrames);
+  void MeasureCallbackTiming(uint32_t nFrames, RtAudioStreamStatus status);
+  void ProcessLatencyTest(const sample* pInputL, sample* pOutputs, uint32_t nFrames);
+
+#ifdef __UNIX_JACK__
+  /** RtAudio doesn't expose its JACK client, so a second client with no ports is used to follow the JACK transport */
+  void OpenJackTransport();
+  void CloseJackTransport();
+  /** Fills timeInfo from the JACK transport, called on the audio thread at the start of each callback
+   * @return \c true if there is a transport client and the transport's position is valid */
+  bool GetJackTimeInfo(ITimeInfo& timeInfo) const;
+
+  jack_client_t* mJackTransportClient = nullptr;
+#endif
+
+  void ClearAudioStats();
+
+  AudioStats mAudioStats;
+  /* Audio thread state of the callback timing */
+  std::chrono::steady_clock::time_point mLastCallbackTime;
+  bool mHasLastCallbackTime = false;
+  uint32_t mNIntervals = 0;
+  double mIntervalSumMs = 0.;
+  double mJitterSumMs = 0.;
+  std::atomic<bool> mResetStatsRequested {false};
+  std::atomic<bool> mLatencyTestRequested {false};
+  std::atomic<bool> mLatencyTestRunning {false};
+  /* Audio thread state of the loopback test */
+  int mLatencyTestImpulsesLeft = 0;
+  int mLatencyTestFramesToImpulse = 0;
+  int mLatencyTestFramesSinceImpulse = -1;
+  int mLatencyTestSum = 0;
+  int mLatencyTestNDetected = 0;
   
   /** The index of the operating systems default input device, -1 if not detected */
   int32_t mDefaultInputDev = -1;
@@ -16,6 +16,7 @@
 #include "dfx-au-utilities.h"
 #include "IPlugAU.h"
 #include "IPlugAU_ioconfig.h"
+#include "IPlugWorkerPool.h"
 
 using namespace iplug;
 
@@ -111,15 +112,14 @@ inline bool IPlugAU::GetStrFromDict(CFDictionaryRef pDict, const char* key, char
   return false;
 }
 
-inline bool IPlugAU::GetDataFromDict(CFDictionaryRef pDict, const char* key, IByteChunk* pChunk)
+inline bool IPlugAU::GetDataFromDict(CFDictionaryRef pDict, const char* key, IByteChunkView* pChunk)
 {
   CFStrLocal cfKey(key);
   CFDataRef pData = (CFDataRef) CFDictionaryGetValue(pDict, cfKey.Get());
   if (pData)
   {
-    CFIndex n = CFDataGetLength(pData);
-    pChunk->Resize((int) n);
-    memcpy(pChunk->GetData(), CFDataGetBytePtr(pData), n);
+    // the dictionary owns the data, and outlives the view
+    *pChunk = IByteChunkView(CFDataGetBytePtr(pData), (int) CFDataGetLength(pData));
     return true;
   }
   return false;
@@ -1070,6 +1070,30 @@ OSStatus IPlugAU::GetProperty(AudioUnitPropertyID propID, AudioUnitScope scope,
     }
     NO_OP(kAudioUnitProperty_InputSamplesInOutput);       // 49,
     NO_OP(kAudioUnitProperty_ClassInfoFromDocument);      // 50
+#if defined(MAC_OS_VERSION_13_0)
+    case kAudioUnitProperty_RenderContextObserver:        // 60,
+    {
+      ASSERT_SCOPE(kAudioUnitScope_Global);
+      if (__builtin_available(macOS 13.0, *))
+      {
+        *pDataSize = sizeof(AURenderContextObserver);
+        if (pData)
+        {
+          // called on the render thread when the host's workgroup changes, so that the helper threads run as part of it
+          *((AURenderContextObserver*) pData) = ^(const AudioUnitRenderContext* pContext) {
+            _this->mHostWorkgroup = pContext ? (void*) pContext->workgroup : nullptr;
+            HostWorkgroup::Set(_this->mHostWorkgroup);
+          };
+        }
+        else
+        {
+          *pWriteable = false;
+        }
+        return noErr;
+      }
+      return kAudioUnitErr_InvalidProperty;
+    }
+#endif
       
     default:
     {
@@ -1472,7 +1496,7 @@ OSStatus IPlugAU::SetState(CFPropertyListRef pPropList)
   
   RestorePreset(presetName);
 
-  IByteChunk chunk;
+  IByteChunkView chunk(nullptr, 0);
 
   if (!GetDataFromDict(pDict, kAUPresetDataKey, &chunk))
   {
@@ -1555,9 +1579,16 @@ OSStatus IPlugAU::SetParamProc(void* pPlug, AudioUnitParameterID paramID, AudioU
   ASSERT_SCOPE(kAudioUnitScope_Global);
   IPlugAU* _this = (IPlugAU*) pPlug;
   ENTER_PARAMS_MUTEX_STATIC;
+  _this->BeginParamsWrite();
   _this->GetParam(paramID)->Set(value);
+  _this->EndParamsWrite();
   _this->SendParameterValueFromAPI(paramID, value, false);
-  _this->OnParamChange(paramID, kHost);
+#ifdef PARAMS_LOCKFREE
+  // the host may call this on any thread, so OnParamChange() is queued for the audio thread, at the start of the next block
+  _this->DeferParamChange(paramID, kHost);
+#else
+  _this->OnParamChange(paramID, kHost, offsetFrames);
+#endif
   LEAVE_PARAMS_MUTEX_STATIC;
   return noErr;
 }
@@ -1573,8 +1604,10 @@ OSStatus IPlugAU::RenderProc(void* pPlug, AudioUnitRenderActionFlags* pFlags, co
                                     UInt32 outputBusIdx, UInt32 nFrames, AudioBufferList* pOutBufList)
 {
   Trace(TRACELOC, "%d:%d:%d", outputBusIdx, pOutBufList->mNumberBuffers, nFrames);
+  REALTIME_SCOPE;
 
   IPlugAU* _this = (IPlugAU*) pPlug;
+  IFlushDenormalsScope denormalsScope(_this->GetFlushDenormals());
   
   _this->mLastRenderTimeStamp = *pTimestamp;
 
@@ -1595,18 +1628,13 @@ OSStatus IPlugAU::RenderProc(void* pPlug, AudioUnitRenderActionFlags* pFlags, co
     }
   }
 
-  int lastConnectedOutputBus = -1;
-
   if(!_this->IsMidiEffect())
   {
     double renderSampleTime = pTimestamp->mSampleTime;
 
     // Pull input buffers.
-    if (renderSampleTime != _this->mLastRenderSampleTime)
+    if (renderSampleTime != _this->mLastRenderSampleTime || _this->mInputConsumed)
     {
-      BufferList bufList;
-      AudioBufferList* pInBufList = (AudioBufferList*) &bufList;
-
       int nIn = _this->mInBuses.GetSize();
 
       for (int i = 0; i < nIn; ++i)
@@ -1616,6 +1644,10 @@ OSStatus IPlugAU::RenderProc(void* pPlug, AudioUnitRenderActionFlags* pFlags, co
 
         if (pInBus->mConnected)
         {
+          AudioBufferList* pInBufList = (AudioBufferList*) (_this->mInBufLists.Get() + i);
+
+          // upstream units give us their own buffers, a render callback fills our scratch. Either may replace the pointers, so they are reset for each pull
+          AudioSampleType* pScratchInput = pInBusConn->mInputType == eRenderCallback ? _this->mInScratch + pInBus->mPlugChannelStartIdx * _this->mScratchStride : nullptr;
           pInBufList->mNumberBuffers = pInBus->mNHostChannels;
 
           for (int b = 0; b < pInBufList->mNumberBuffers; ++b)
@@ -1623,7 +1655,7 @@ OSStatus IPlugAU::RenderProc(void* pPlug, AudioUnitRenderActionFlags* pFlags, co
             AudioBuffer* pBuffer = &(pInBufList->mBuffers[b]);
             pBuffer->mNumberChannels = 1;
             pBuffer->mDataByteSize = nFrames * sizeof(AudioSampleType);
-            pBuffer->mData = 0;
+            pBuffer->mData = pScratchInput ? pScratchInput + b * _this->mScratchStride : nullptr;
           }
 
           AudioUnitRenderActionFlags flags = 0;
@@ -1643,13 +1675,6 @@ OSStatus IPlugAU::RenderProc(void* pPlug, AudioUnitRenderActionFlags* pFlags, co
             }
             case eRenderCallback:
             {
-              AudioSampleType* pScratchInput = _this->mInScratchBuf.Get() + pInBus->mPlugChannelStartIdx * nFrames;
-
-              for (int b = 0; b < pInBufList->mNumberBuffers; ++b, pScratchInput += nFrames)
-              {
-                pInBufList->mBuffers[b].mData = pScratchInput;
-              }
-
               r = RenderCallback(&(pInBusConn->mUpstreamRenderCallback), &flags, pTimestamp, i, nFrames, pInBufList);
               break;
             }
@@ -1668,6 +1693,7 @@ OSStatus IPlugAU::RenderProc(void* pPlug, AudioUnitRenderActionFlags* pFlags, co
         }
       }
       _this->mLastRenderSampleTime = renderSampleTime;
+      _this->mInputConsumed = false;
     }
   
     BusChannels* pOutBus = _this->mOutBuses.Get(outputBusIdx);
@@ -1683,42 +1709,45 @@ OSStatus IPlugAU::RenderProc(void* pPlug, AudioUnitRenderActionFlags* pFlags, co
       _this->SetChannelConnections(ERoute::kOutput, startChannelIdx, nConnected, true);
       _this->SetChannelConnections(ERoute::kOutput, startChannelIdx + nConnected, nUnconnected, false); // This will disconnect the right handle channel on a single stereo bus
       pOutBus->mConnected = true;
+      _this->UpdateLastConnectedOutputBus();
     }
 
+    // with a single output bus, the block is processed in this render, so outputs that downstream gave no buffers for are processed in place in the
+    // input scratch a render callback filled, which is pulled again next time. With several buses an earlier bus's render would be overwritten
+    const InputBusConnection* pMainInConn = _this->mInBusConnections.GetSize() ? _this->mInBusConnections.Get(0) : nullptr;
+    const bool inPlace = _this->mOutBuses.GetSize() == 1 && pMainInConn && pMainInConn->mInputType == eRenderCallback;
+    const int nInPlace = inPlace ? std::min(_this->mInBuses.Get(0)->mNHostChannels, pOutBus->mNPlugChannels) : 0;
+
     for (int i = 0, chIdx = pOutBus->mPlugChannelStartIdx; i < pOutBufList->mNumberBuffers; ++i, ++chIdx)
     {
       if (!(pOutBufList->mBuffers[i].mData)) // Downstream unit didn't give us buffers.
-        pOutBufList->mBuffers[i].mData = _this->mOutScratchBuf.Get() + chIdx * nFrames;
-
-      _this->AttachBuffers(ERoute::kOutput, chIdx, 1, (AudioSampleType**) &(pOutBufList->mBuffers[i].mData), nFrames);
-    }
-
-    for(int i = 0; i < _this->mOutBuses.GetSize(); i++)
-    {
-      if(!_this->mOutBuses.Get(i)->mConnected)
-      {
-        break;
-      }
-      else
       {
-        lastConnectedOutputBus++;
+        if (chIdx < nInPlace)
+        {
+          pOutBufList->mBuffers[i].mData = _this->mInScratch + chIdx * _this->mScratchStride;
+          _this->mInputConsumed = true;
+        }
+        else
+          pOutBufList->mBuffers[i].mData = _this->mOutScratch + chIdx * _this->mScratchStride;
       }
+
+      _this->AttachBuffers(ERoute::kOutput, chIdx, 1, (AudioSampleType**) &(pOutBufList->mBuffers[i].mData), nFrames);
     }
   }
 
-  if (_this->IsMidiEffect() || outputBusIdx == lastConnectedOutputBus)
+  if (_this->IsMidiEffect() || (int) outputBusIdx == _this->mLastConnectedOutputBus)
   {
-    int busIdx1based = outputBusIdx+1;
+    // a MIDI effect's outputs are never marked connected, see UpdateLastConnectedOutputBus() for the others
+    if (_this->IsMidiEffect())
+      _this->DisconnectOutputBusesAfter(outputBusIdx);
 
-    if (busIdx1based < _this->mOutBuses.GetSize() /*&& (_this->GetHost() != kHostAbletonLive)*/)
-    {
-      int totalNumChans = _this->mOutBuses.GetSize() * 2; // stereo only for the time being
-      int nConnected = busIdx1based * 2;
-      _this->SetChannelConnections(ERoute::kOutput, nConnected, totalNumChans - nConnected, false); // this will disconnect the channels that are on the unconnected buses
-    }
+    _this->ProcessDeferredParamChanges();
+
+    _this->BuildParamChangePoints(nFrames);
 
     if (_this->GetBypassed())
     {
+      _this->ApplyParamChangePoints();
       _this->PassThroughBuffers((AudioSampleType) 0, nFrames);
     }
     else
@@ -1729,13 +1758,26 @@ OSStatus IPlugAU::RenderProc(void* pPlug, AudioUnitRenderActionFlags* pFlags, co
         
         while (_this->mMidiMsgsFromEditor.Pop(msg))
         {
-          _this->ProcessMidiMsg(msg);
+          _this->ReceiveMidiMsg(msg);
         }
       }
       
       _this->PreProcess();
-      _this->ProcessBuffers((AudioSampleType) 0, nFrames);
+
+      if (_this->SkipSilentBuffers((AudioSampleType) 0, nFrames))
+      {
+        // the input has been silent for longer than the tail, the outputs were zeroed
+      }
+      else if (_this->mSampleAccurateAutomation && _this->mParamChangePoints.GetSize())
+        _this->ProcessSubBlocks(nFrames);
+      else
+      {
+        _this->ApplyParamChangePoints();
+        _this->ProcessBuffers((AudioSampleType) 0, nFrames);
+      }
     }
+    
+    _this->ClearBlockEvents();
   }
 
   if (nRenderNotify)
@@ -1753,6 +1795,120 @@ OSStatus IPlugAU::RenderProc(void* pPlug, AudioUnitRenderActionFlags* pFlags, co
   return noErr;
 }
 
+void IPlugAU::SetSampleAccurateAutomation(bool enable, int minSubBlockSize)
+{
+  mSampleAccurateAutomation = enable;
+  mMinSubBlockSize = std::max(minSubBlockSize, 1);
+}
+
+void IPlugAU::BuildParamChangePoints(int nFrames)
+{
+  mParamChangePoints.Resize(0, false);
+
+  // the buffer never grows here, a point that doesn't fit is dropped
+  auto addPoint = [&](int offset, int idx, double value) {
+    if (mParamChangePoints.GetSize() >= mMaxParamChangePoints)
+      return;
+
+    mParamChangePoints.Add({offset, mParamChangePoints.GetSize(), idx, value});
+    mBlockEvents.AddParamChange(std::min(offset, nFrames - 1), idx, value);
+  };
+
+  // Initialize() makes room for one ramp per parameter at mMinSubBlockSize, so the points of a ramp are spaced further apart when there are more
+  int nRamps = 0;
+
+  for (auto i = 0; i < mScheduledParams.GetSize(); i++)
+  {
+    if (mScheduledParams.Get()[i].duration > 0)
+      nRamps++;
+  }
+
+  const int nParams = std::max(NParams(), 1);
+  const int rampStep = mMinSubBlockSize * std::max((nRamps + nParams - 1) / nParams, 1);
+
+  for (auto i = 0; i < mScheduledParams.GetSize(); i++)
+  {
+    const ScheduledParamEvent& event = mScheduledParams.Get()[i];
+
+    if (event.duration <= 0)
+    {
+      addPoint(std::max(event.offset, 0), event.idx, event.endValue);
+      continue;
+    }
+
+    // a ramp that continues past this block is scheduled again for the next one, with its start offset moved back
+    const int endOffset = event.offset + event.duration;
+    const double slope = (event.endValue - event.startValue) / event.duration;
+
+    for (int offset = std::max(event.offset, 0); offset < std::min(endOffset, nFrames); offset += rampStep)
+      addPoint(offset, event.idx, event.startValue + slope * (offset - event.offset));
+
+    if (endOffset <= nFrames)
+      addPoint(endOffset, event.idx, event.endValue);
+  }
+
+  mScheduledParams.Resize(0, false);
+
+  if (mParamChangePoints.GetSize())
+  {
+    // the events are rarely in time order across parameters. order is used to keep std::sort stable without allocating
+    std::sort(mParamChangePoints.Get(), mParamChangePoints.Get() + mParamChangePoints.GetSize(), [](const ParamChangePoint& a, const ParamChangePoint& b) {
+      return a.offset != b.offset ? a.offset < b.offset : a.order < b.order;
+    });
+  }
+}
+
+void IPlugAU::ApplyParamChangePoints()
+{
+  const ParamChangePoint* pPoints = mParamChangePoints.Get();
+
+  for (auto i = 0; i < mParamChangePoints.GetSize(); i++)
+    SetParamProc(this, pPoints[i].idx, kAudioUnitScope_Global, 0, pPoints[i].value, pPoints[i].offset);
+
+  mParamChangePoints.Resize(0, false);
+}
+
+void IPlugAU::ProcessSubBlocks(int nFrames)
+{
+  const ParamChangePoint* pPoints = mParamChangePoints.Get();
+  const int nPoints = mParamChangePoints.GetSize();
+  const ITimeInfo blockTimeInfo = mTimeInfo;
+  const double samplesPerBeat = GetSamplesPerBeat();
+  int pointIdx = 0;
+  int startIdx = 0;
+
+  while (startIdx < nFrames)
+  {
+    // changes that fell inside the previous sub-block are applied at the start of this one
+    while (pointIdx < nPoints && pPoints[pointIdx].offset <= startIdx)
+    {
+      SetParamProc(this, pPoints[pointIdx].idx, kAudioUnitScope_Global, 0, pPoints[pointIdx].value, pPoints[pointIdx].offset);
+      pointIdx++;
+    }
+
+    int endIdx = nFrames;
+
+    if (pointIdx < nPoints)
+      endIdx = std::min(std::max(pPoints[pointIdx].offset, startIdx + mMinSubBlockSize), nFrames);
+
+    if (blockTimeInfo.mSamplePos >= 0.)
+      mTimeInfo.mSamplePos = blockTimeInfo.mSamplePos + startIdx;
+
+    if (blockTimeInfo.mPPQPos >= 0. && samplesPerBeat > 0.)
+      mTimeInfo.mPPQPos = blockTimeInfo.mPPQPos + (startIdx / samplesPerBeat);
+
+    ProcessBuffers((AudioSampleType) 0, endIdx - startIdx, startIdx);
+    startIdx = endIdx;
+  }
+
+  // any changes at or beyond the end of the block
+  for (; pointIdx < nPoints; pointIdx++)
+    SetParamProc(this, pPoints[pointIdx].idx, kAudioUnitScope_Global, 0, pPoints[pointIdx].value, pPoints[pointIdx].offset);
+
+  mTimeInfo = blockTimeInfo;
+  mParamChangePoints.Resize(0, false);
+}
+
 IPlugAU::BusChannels* IPlugAU::GetBus(AudioUnitScope scope, AudioUnitElement busIdx)
 {
   if (scope == kAudioUnitScope_Input && busIdx < mInBuses.GetSize())
@@ -1789,6 +1945,32 @@ void IPlugAU::ClearConnections()
     pOutBus->mConnected = false;
     pOutBus->mNHostChannels = -1;
   }
+  UpdateLastConnectedOutputBus();
+}
+
+void IPlugAU::UpdateLastConnectedOutputBus()
+{
+  int lastConnected = -1;
+
+  while (lastConnected + 1 < mOutBuses.GetSize() && mOutBuses.Get(lastConnected + 1)->mConnected)
+    lastConnected++;
+
+  mLastConnectedOutputBus = lastConnected;
+
+  if (lastConnected >= 0)
+    DisconnectOutputBusesAfter(lastConnected);
+}
+
+void IPlugAU::DisconnectOutputBusesAfter(int busIdx)
+{
+  int busIdx1based = busIdx+1;
+
+  if (busIdx1based < mOutBuses.GetSize() /*&& (GetHost() != kHostAbletonLive)*/)
+  {
+    int totalNumChans = mOutBuses.GetSize() * 2; // stereo only for the time being
+    int nConnected = busIdx1based * 2;
+    SetChannelConnections(ERoute::kOutput, nConnected, totalNumChans - nConnected, false); // this will disconnect the channels that are on the unconnected buses
+  }
 }
 
 #pragma mark - IPlugAU Constructor
@@ -1809,12 +1991,13 @@ IPlugAU::IPlugAU(const InstanceInfo& info, const Config& config)
 
   PtrListInitialize(&mInBusConnections, maxNIBuses);
   PtrListInitialize(&mInBuses, maxNIBuses);
+  mInBufLists.Resize(maxNIBuses);
   
   for (auto bus = 0; bus < maxNIBuses; bus++)
   {
     BusChannels* pInBus = mInBuses.Get(bus);
     pInBus->mNHostChannels = -1;
-    pInBus->mPlugChannelStartIdx = 0;
+    pInBus->mPlugChannelStartIdx = GetBusChannelStartIdx(ERoute::kInput, bus);
     pInBus->mNPlugChannels = std::abs(MaxNChannelsForBus(ERoute::kInput, bus));
   }
   
@@ -1824,7 +2007,7 @@ IPlugAU::IPlugAU(const InstanceInfo& info, const Config& config)
   {
     BusChannels* pOutBus = mOutBuses.Get(bus);
     pOutBus->mNHostChannels = -1;
-    pOutBus->mPlugChannelStartIdx = 0;
+    pOutBus->mPlugChannelStartIdx = GetBusChannelStartIdx(ERoute::kOutput, bus);
     pOutBus->mNPlugChannels = std::abs(MaxNChannelsForBus(ERoute::kOutput, bus));
   }
 
@@ -1838,6 +2021,7 @@ IPlugAU::IPlugAU(const InstanceInfo& info, const Config& config)
 
 IPlugAU::~IPlugAU()
 {
+  HostWorkgroup::Clear(mHostWorkgroup);
   mRenderNotify.Empty(true);
   mInBuses.Empty(true);
   mOutBuses.Empty(true);
@@ -1942,12 +2126,18 @@ void IPlugAU::PreProcess()
 void IPlugAU::ResizeScratchBuffers()
 {
   TRACE;
-  int NInputs = MaxNChannels(ERoute::kInput) * GetBlockSize();
-  int NOutputs = MaxNChannels(ERoute::kOutput) * GetBlockSize();
+  // each channel starts on a cache line at an offset that doesn't depend on the number of frames rendered, with room to align the start
+  const int kAlignBytes = 64;
+  const int kAlignSamples = kAlignBytes / sizeof(AudioSampleType);
+  mScratchStride = (GetBlockSize() + kAlignSamples - 1) / kAlignSamples * kAlignSamples;
+  int NInputs = MaxNChannels(ERoute::kInput) * mScratchStride + kAlignSamples;
+  int NOutputs = MaxNChannels(ERoute::kOutput) * mScratchStride + kAlignSamples;
   mInScratchBuf.Resize(NInputs);
   mOutScratchBuf.Resize(NOutputs);
   memset(mInScratchBuf.Get(), 0, NInputs * sizeof(AudioSampleType));
   memset(mOutScratchBuf.Get(), 0, NOutputs * sizeof(AudioSampleType));
+  mInScratch = mInScratchBuf.GetAligned(kAlignBytes);
+  mOutScratch = mOutScratchBuf.GetAligned(kAlignBytes);
 }
 
 void IPlugAU::InformListeners(AudioUnitPropertyID propID, AudioUnitScope scope)
@@ -1969,6 +2159,8 @@ void IPlugAU::InformListeners(AudioUnitPropertyID propID, AudioUnitScope scope)
 void IPlugAU::SetLatency(int samples)
 {
   TRACE;
+  IPlugProcessor::SetLatency(samples); // before notifying, since the listeners query the latency
+
   int i, n = mPropertyListeners.GetSize();
   
   for (i = 0; i < n; ++i)
@@ -1979,8 +2171,6 @@ void IPlugAU::SetLatency(int samples)
       pListener->mListenerProc(pListener->mProcArgs, mCI, kAudioUnitProperty_Latency, kAudioUnitScope_Global, 0);
     }
   }
-  
-  IPlugProcessor::SetLatency(samples);
 }
 
 bool IPlugAU::SendMidiMsg(const IMidiMsg& msg)
@@ -2077,13 +2267,12 @@ bool IPlugAU::SendSysEx(const ISysEx& sysEx)
 void IPlugAU::OutputSysexFromEditor()
 {
   //Output SYSEX from the editor, which has bypassed ProcessSysEx()
-  if(mSysExDataFromEditor.ElementsAvailable())
+  ISysEx smsg;
+  
+  while (mSysExDataFromEditor.Peek(smsg))
   {
-    while (mSysExDataFromEditor.Pop(mSysexBuf))
-    {
-      ISysEx smsg {mSysexBuf.mOffset, mSysexBuf.mData, mSysexBuf.mSize};
-      SendSysEx(smsg);
-    }
+    SendSysEx(smsg);
+    mSysExDataFromEditor.Pop();
   }
 }
 
@@ -2229,6 +2418,15 @@ OSStatus IPlugAU::DoInitialize(IPlugAU* _this)
     return badComponentSelector;
   }
 
+  // reserve space for scheduled parameter events, they are capped at these sizes so that they never grow on the audio thread.
+  // each event adds at most a start and an end point, and the ramps of a block share a point every mMinSubBlockSize samples per parameter
+  _this->mMaxScheduledParams = _this->NParams() * 4;
+  _this->mMaxParamChangePoints = _this->mMaxScheduledParams * 2 + _this->NParams() * (_this->GetBlockSize() / _this->mMinSubBlockSize + 1);
+  _this->mScheduledParams.Resize(_this->mMaxScheduledParams, false);
+  _this->mScheduledParams.Resize(0, false);
+  _this->mParamChangePoints.Resize(_this->mMaxParamChangePoints, false);
+  _this->mParamChangePoints.Resize(0, false);
+
   _this->mActive = true;
   _this->OnParamReset(kReset);
   _this->OnActivate(true);
@@ -2241,6 +2439,8 @@ OSStatus IPlugAU::DoUninitialize(IPlugAU* _this)
 {
   _this->mActive = false;
   _this->OnActivate(false);
+  HostWorkgroup::Clear(_this->mHostWorkgroup);
+  _this->mHostWorkgroup = nullptr;
   return noErr;
 }
 
@@ -2384,24 +2584,44 @@ OSStatus IPlugAU::DoGetParameter(IPlugAU* _this, AudioUnitParameterID param, Aud
 OSStatus IPlugAU::DoSetParameter(IPlugAU* _this, AudioUnitParameterID param, AudioUnitScope scope, AudioUnitElement elem, AudioUnitParameterValue value, UInt32 bufferOffset)
 {
   //mutex locked below
+  _this->WakeFromSilence();
   return _this->SetParamProc(_this, param, scope, elem, value, bufferOffset);
 }
 
 //static
 OSStatus IPlugAU::DoScheduleParameters(IPlugAU* _this, const AudioUnitParameterEvent *pEvent, UInt32 nEvents)
 {
-  //mutex locked below
+  // the events apply to the next render call, and are added to its timeline of parameter changes once the block size is known
   for (int i = 0; i < nEvents; ++i, ++pEvent)
   {
+    if (pEvent->scope != kAudioUnitScope_Global)
+      return kAudioUnitErr_InvalidProperty;
+
+    if (pEvent->parameter >= _this->NParams())
+      return kAudioUnitErr_InvalidParameter;
+
+    ScheduledParamEvent event {static_cast<int>(pEvent->parameter), 0, 0, 0., 0.};
+
     if (pEvent->eventType == kParameterEvent_Immediate)
     {
-      OSStatus r = SetParamProc(_this, pEvent->parameter, pEvent->scope, pEvent->element,
-                                pEvent->eventValues.immediate.value, pEvent->eventValues.immediate.bufferOffset);
-      if (r != noErr)
-      {
-        return r;
-      }
+      event.offset = pEvent->eventValues.immediate.bufferOffset;
+      event.startValue = event.endValue = pEvent->eventValues.immediate.value;
     }
+    else if (pEvent->eventType == kParameterEvent_Ramped)
+    {
+      event.offset = pEvent->eventValues.ramp.startBufferOffset;
+      event.duration = pEvent->eventValues.ramp.durationInFrames;
+      event.startValue = pEvent->eventValues.ramp.startValue;
+      event.endValue = pEvent->eventValues.ramp.endValue;
+    }
+    else
+      continue;
+
+    // the events are only reserved for in Initialize(), so drop the rest rather than allocate on the render thread
+    if (_this->mScheduledParams.GetSize() >= _this->mMaxScheduledParams)
+      break;
+
+    _this->mScheduledParams.Add(event);
   }
   return noErr;
 }
@@ -2422,6 +2642,8 @@ OSStatus IPlugAU::DoReset(IPlugAU* _this)
 //static
 OSStatus IPlugAU::DoMIDIEvent(IPlugAU* _this, UInt32 inStatus, UInt32 inData1, UInt32 inData2, UInt32 inOffsetSampleFrame)
 {
+  REALTIME_SCOPE;
+
   if(_this->DoesMIDIIn())
   {
     IMidiMsg msg;
@@ -2429,7 +2651,7 @@ OSStatus IPlugAU::DoMIDIEvent(IPlugAU* _this, UInt32 inStatus, UInt32 inData1, U
     msg.mData1 = inData1;
     msg.mData2 = inData2;
     msg.mOffset = inOffsetSampleFrame;
-    _this->ProcessMidiMsg(msg);
+    _this->ReceiveMidiMsg(msg);
     _this->mMidiMsgsFromProcessor.Push(msg);
     return noErr;
   }
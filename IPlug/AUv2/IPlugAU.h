@@ -77,10 +77,29 @@ public:
   void OutputSysexFromEditor();
   void PreProcess();
   void ResizeScratchBuffers();
+
+  /** Find the last output bus of the run of connected buses from the first, which is the one whose render processes the block, and disconnect
+   * the channels after it. Called when the output connections change, rather than on every render */
+  void UpdateLastConnectedOutputBus();
+
+  void DisconnectOutputBusesAfter(int busIdx);
   static const char* AUInputTypeStr(int type);
 #ifndef AU_NO_COMPONENT_ENTRY
   static OSStatus IPlugAUEntry(ComponentParameters* pParams, void* pPlug);
 #endif
+
+  /** Opt-in to sample accurate parameter automation from hosts that schedule parameter events, such as Logic. Rather than applying each event before
+   * the render call, immediate events and points sampled along ramped events are merged into a sorted timeline, and the render block is split into
+   * sub-blocks between change points, calling ProcessBlock() for each sub-block.
+   * If you use IMidiQueue, make sure you call Flush(nFrames) at the end of ProcessBlock(), so that MIDI message offsets remain valid across sub-blocks.
+   * @param enable \c true in order to split the render block at parameter change points
+   * @param minSubBlockSize The smallest sub-block (in samples) that will be processed, and the spacing of the points taken along a ramp.
+   * Changes closer together than this will be applied at the start of the next sub-block */
+  void SetSampleAccurateAutomation(bool enable, int minSubBlockSize = DEFAULT_MIN_SUBBLOCK_SIZE);
+
+  /** @return \c true if sample accurate parameter automation is enabled, see SetSampleAccurateAutomation() */
+  bool GetSampleAccurateAutomation() const { return mSampleAccurateAutomation; }
+
 private:
 
   enum EAUInputType
@@ -121,6 +140,25 @@ private:
     AudioUnitPropertyListenerProc mListenerProc;
     void* mProcArgs;
   };
+
+  /** An event from AudioUnitScheduleParameters(), kept until the next render call, when the block size is known. Immediate events have no duration */
+  struct ScheduledParamEvent
+  {
+    int idx;
+    int offset;
+    int duration;
+    double startValue;
+    double endValue;
+  };
+
+  /** A single point on the render block's timeline of parameter changes */
+  struct ParamChangePoint
+  {
+    int offset;
+    int order;
+    int idx;
+    double value;
+  };
   
   int NHostChannelsConnected(WDL_PtrList<BusChannels>* pBuses, int excludeIdx = -1);
   void ClearConnections();
@@ -129,6 +167,10 @@ private:
   bool CheckLegalIO();
   void AssessInputConnections();
 
+  void BuildParamChangePoints(int nFrames);
+  void ApplyParamChangePoints();
+  void ProcessSubBlocks(int nFrames);
+
   UInt32 GetTagForNumChannels(int numChannels);
   UInt32 GetChannelLayoutTags(AudioUnitScope scope, AudioUnitElement element, AudioChannelLayoutTag* pTags);
   
@@ -194,12 +236,13 @@ private:
   static inline void PutDataInDict(CFMutableDictionaryRef pDict, const char* key, IByteChunk* pChunk);
   static inline bool GetNumberFromDict(CFDictionaryRef pDict, const char* key, void* pNumber, CFNumberType type);
   static inline bool GetStrFromDict(CFDictionaryRef pDict, const char* key, char* value);
-  static inline bool GetDataFromDict(CFDictionaryRef pDict, const char* key, IByteChunk* pChunk);
+  static inline bool GetDataFromDict(CFDictionaryRef pDict, const char* key, IByteChunkView* pChunk);
   
 #pragma mark -
 
   bool mActive = false; // TODO: is this necessary? is it correct?
   double mLastRenderSampleTime = -1.0;
+  void* mHostWorkgroup = nullptr; // the last workgroup the render context observer set, cleared when uninitialized
   WDL_String mCocoaViewFactoryClassName;
   AudioComponentInstance mCI = nullptr;
   HostCallbackInfo mHostCallbacks;
@@ -208,9 +251,21 @@ private:
   WDL_PtrList<PropertyListener> mPropertyListeners;
   WDL_TypedBuf<AudioSampleType> mInScratchBuf;
   WDL_TypedBuf<AudioSampleType> mOutScratchBuf;
+  AudioSampleType* mInScratch = nullptr; // the cache line aligned start of mInScratchBuf
+  AudioSampleType* mOutScratch = nullptr;
+  int mScratchStride = 0; // the samples between channels in the scratch buffers, a whole number of cache lines, so every channel is aligned whatever the number of frames
+  WDL_TypedBuf<BufferList> mInBufLists; // one for each input bus, for pulling input without building a list on the stack
+  int mLastConnectedOutputBus = -1;
+  bool mInputConsumed = false; // the outputs were processed in place in the pulled input, so it must be pulled again even if the time hasn't changed
   WDL_PtrList<AURenderCallbackStruct> mRenderNotify;
   AUMIDIOutputCallbackStruct mMidiCallback;
   AudioTimeStamp mLastRenderTimeStamp;
+  WDL_TypedBuf<ScheduledParamEvent> mScheduledParams;
+  WDL_TypedBuf<ParamChangePoint> mParamChangePoints;
+  int mMaxScheduledParams = 0; // the capacities reserved in Initialize(), neither buffer grows on the render thread
+  int mMaxParamChangePoints = 0;
+  bool mSampleAccurateAutomation = false;
+  int mMinSubBlockSize = DEFAULT_MIN_SUBBLOCK_SIZE;
 
   template <class Plug, bool DoesMIDIIn>
   friend class IPlugAUFactory;
@@ -0,0 +1,114 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+#import <AudioToolbox/AudioToolbox.h>
+#import <AVFoundation/AVFoundation.h>
+
+/** An AUAudioUnitBus with a buffer that is allocated in allocateRenderResources. The render block only touches the C pointers that are cached
+ * alongside the AVAudioPCMBuffer, never the Objective-C objects */
+struct BufferedAudioBus
+{
+  AUAudioUnitBus* mBus = nil;
+  AUAudioFrameCount mMaxFrames = 0;
+  AVAudioPCMBuffer* mPCMBuffer = nil;
+  const AudioBufferList* mOriginalAudioBufferList = nullptr;
+  AudioBufferList* mMutableAudioBufferList = nullptr;
+
+  void Init(AVAudioFormat* pDefaultFormat, AVAudioChannelCount maxChannels)
+  {
+    mMaxFrames = 0;
+    mPCMBuffer = nil;
+    mOriginalAudioBufferList = nullptr;
+    mMutableAudioBufferList = nullptr;
+
+    mBus = [[AUAudioUnitBus alloc] initWithFormat:pDefaultFormat error:nil];
+    mBus.maximumChannelCount = maxChannels;
+  }
+
+  void AllocateRenderResources(AUAudioFrameCount maxFrames)
+  {
+    mMaxFrames = maxFrames;
+    mPCMBuffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:mBus.format frameCapacity:maxFrames];
+    mOriginalAudioBufferList = mPCMBuffer.audioBufferList;
+    mMutableAudioBufferList = mPCMBuffer.mutableAudioBufferList;
+  }
+
+  void DeallocateRenderResources()
+  {
+    mPCMBuffer = nil;
+    mOriginalAudioBufferList = nullptr;
+    mMutableAudioBufferList = nullptr;
+  }
+
+  int NChannels() const
+  {
+    return mOriginalAudioBufferList ? (int) mOriginalAudioBufferList->mNumberBuffers : 0;
+  }
+};
+
+/** An output bus. If the host passes a buffer list with null data pointers, they are pointed at our buffer */
+struct BufferedOutputBus : BufferedAudioBus
+{
+  void PrepareOutputBufferList(AudioBufferList* pOutBufferList, AVAudioFrameCount frameCount, bool zeroFill)
+  {
+    const UInt32 byteSize = frameCount * sizeof(float);
+
+    for (UInt32 i = 0; i < pOutBufferList->mNumberBuffers; ++i)
+    {
+      pOutBufferList->mBuffers[i].mNumberChannels = mOriginalAudioBufferList->mBuffers[i].mNumberChannels;
+      pOutBufferList->mBuffers[i].mDataByteSize = byteSize;
+
+      if (pOutBufferList->mBuffers[i].mData == nullptr)
+        pOutBufferList->mBuffers[i].mData = mOriginalAudioBufferList->mBuffers[i].mData;
+
+      if (zeroFill)
+        memset(pOutBufferList->mBuffers[i].mData, 0, byteSize);
+    }
+  }
+};
+
+/** An input bus, which pulls its input into our buffer. The host may replace the data pointers with its own for the duration of the render call */
+struct BufferedInputBus : BufferedAudioBus
+{
+  AUAudioUnitStatus PullInput(AudioUnitRenderActionFlags* pActionFlags, const AudioTimeStamp* pTimestamp, AVAudioFrameCount frameCount, NSInteger inputBusNumber, AURenderPullInputBlock pullInputBlock)
+  {
+    if (pullInputBlock == nullptr)
+      return kAudioUnitErr_NoConnection;
+
+    PrepareInputBufferList(frameCount);
+
+    return pullInputBlock(pActionFlags, pTimestamp, frameCount, inputBusNumber, mMutableAudioBufferList);
+  }
+
+  void PrepareInputBufferList(AVAudioFrameCount frameCount)
+  {
+    const UInt32 byteSize = frameCount * sizeof(float);
+
+    mMutableAudioBufferList->mNumberBuffers = mOriginalAudioBufferList->mNumberBuffers;
+
+    for (UInt32 i = 0; i < mOriginalAudioBufferList->mNumberBuffers; ++i)
+    {
+      mMutableAudioBufferList->mBuffers[i].mNumberChannels = mOriginalAudioBufferList->mBuffers[i].mNumberChannels;
+      mMutableAudioBufferList->mBuffers[i].mData = mOriginalAudioBufferList->mBuffers[i].mData;
+      mMutableAudioBufferList->mBuffers[i].mDataByteSize = byteSize;
+    }
+  }
+
+  /** Used for a bus that isn't connected, such as an unused sidechain */
+  void ZeroFill(AVAudioFrameCount frameCount)
+  {
+    PrepareInputBufferList(frameCount);
+
+    for (UInt32 i = 0; i < mMutableAudioBufferList->mNumberBuffers; ++i)
+      memset(mMutableAudioBufferList->mBuffers[i].mData, 0, frameCount * sizeof(float));
+  }
+};
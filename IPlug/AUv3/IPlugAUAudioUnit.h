@@ -0,0 +1,31 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+#import <AudioToolbox/AudioToolbox.h>
+
+/** The AUAudioUnit subclass for an IPlugAUv3 plug-in. It owns the plug-in instance, the parameter tree and the buses */
+@interface IPlugAUAudioUnit : AUAudioUnit
+
+/** @return The IPlugAUv3 instance, as a void* so that this header stays Objective-C */
+- (void*) getPlug;
+
+/** Called by IPlugAUViewController when the editor is opened and closed */
+- (void*) openWindow: (void*) pParent;
+- (void) closeWindow;
+- (CGSize) editorSize;
+
+- (void) beginInformHostOfParamChange: (uint64_t) address;
+- (void) informHostOfParamChange: (uint64_t) address : (float) realValue;
+- (void) endInformHostOfParamChange: (uint64_t) address;
+- (void) informHostOfLatencyChange;
+
+@end
@@ -0,0 +1,590 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#import <AVFoundation/AVFoundation.h>
+#import <CoreAudioKit/CoreAudioKit.h>
+
+#include <memory>
+#include <vector>
+
+#import "IPlugAUAudioUnit.h"
+#include "BufferedAudioBus.hpp"
+#include "IPlugAUv3.h"
+#include "IPlugWorkerPool.h"
+
+#if !__has_feature(objc_arc)
+#error This file must be compiled with ARC. Use -fobjc-arc flag
+#endif
+
+using namespace iplug;
+
+/** Everything the render block needs, set up in allocateRenderResources. The block captures a pointer to this rather than self */
+struct RenderState
+{
+  IPlugAUv3* mPlug = nullptr;
+  BufferedInputBus* mInputBuses = nullptr;
+  int mNInputBuses = 0;
+  BufferedOutputBus* mOutputBus = nullptr;
+  AUAudioFrameCount mMaxFrames = 0;
+  AUHostMusicalContextBlock mMusicalContext = nil;
+  AUHostTransportStateBlock mTransportState = nil;
+  AUMIDIOutputEventBlock mMidiOutput = nil;
+  void* mHostWorkgroup = nullptr; // the last workgroup the render context observer set, cleared when the render resources are deallocated
+};
+
+static AUParameter* CreateParameter(IParam* pParam, int idx)
+{
+  AudioUnitParameterOptions flags = kAudioUnitParameterFlag_IsWritable | kAudioUnitParameterFlag_IsReadable;
+
+#ifndef IPLUG1_COMPATIBILITY
+  flags |= kAudioUnitParameterFlag_IsHighResolution;
+#endif
+
+  if (!pParam->GetCanAutomate()) flags |= kAudioUnitParameterFlag_NonRealTime;
+  if (pParam->GetMeta()) flags |= kAudioUnitParameterFlag_IsElementMeta;
+  if (pParam->NDisplayTexts()) flags |= kAudioUnitParameterFlag_ValuesHaveStrings;
+
+  switch (pParam->DisplayType())
+  {
+    case IParam::kDisplayLinear: break;
+    case IParam::kDisplaySquared: flags |= kAudioUnitParameterFlag_DisplaySquared; break;
+    case IParam::kDisplaySquareRoot: flags |= kAudioUnitParameterFlag_DisplaySquareRoot; break;
+    case IParam::kDisplayCubed: flags |= kAudioUnitParameterFlag_DisplayCubed; break;
+    case IParam::kDisplayCubeRoot: flags |= kAudioUnitParameterFlag_DisplayCubeRoot; break;
+    case IParam::kDisplayExp: flags |= kAudioUnitParameterFlag_DisplayExponential; break;
+    case IParam::kDisplayLog: flags |= kAudioUnitParameterFlag_DisplayLogarithmic; break;
+  }
+
+  AudioUnitParameterUnit unit = kAudioUnitParameterUnit_Generic;
+  NSString* pUnitName = nil;
+  NSMutableArray<NSString*>* pValueStrings = nil;
+
+  switch (pParam->Type())
+  {
+    case IParam::kTypeBool:
+      unit = kAudioUnitParameterUnit_Boolean;
+      break;
+    case IParam::kTypeEnum:
+      //fall through
+    case IParam::kTypeInt:
+      unit = kAudioUnitParameterUnit_Indexed;
+      break;
+    default:
+    {
+      switch (pParam->Unit())
+      {
+        case IParam::kUnitPercentage:     unit = kAudioUnitParameterUnit_Percent;            break;
+        case IParam::kUnitSeconds:        unit = kAudioUnitParameterUnit_Seconds;            break;
+        case IParam::kUnitMilliseconds:   unit = kAudioUnitParameterUnit_Milliseconds;       break;
+        case IParam::kUnitSamples:        unit = kAudioUnitParameterUnit_SampleFrames;       break;
+        case IParam::kUnitDB:             unit = kAudioUnitParameterUnit_Decibels;           break;
+        case IParam::kUnitLinearGain:     unit = kAudioUnitParameterUnit_LinearGain;         break;
+        case IParam::kUnitPan:            unit = kAudioUnitParameterUnit_Pan;                break;
+        case IParam::kUnitPhase:          unit = kAudioUnitParameterUnit_Phase;              break;
+        case IParam::kUnitDegrees:        unit = kAudioUnitParameterUnit_Degrees;            break;
+        case IParam::kUnitMeters:         unit = kAudioUnitParameterUnit_Meters;             break;
+        case IParam::kUnitRate:           unit = kAudioUnitParameterUnit_Rate;               break;
+        case IParam::kUnitRatio:          unit = kAudioUnitParameterUnit_Ratio;              break;
+        case IParam::kUnitFrequency:      unit = kAudioUnitParameterUnit_Hertz;              break;
+        case IParam::kUnitOctaves:        unit = kAudioUnitParameterUnit_Octaves;            break;
+        case IParam::kUnitCents:          unit = kAudioUnitParameterUnit_Cents;              break;
+        case IParam::kUnitAbsCents:       unit = kAudioUnitParameterUnit_AbsoluteCents;      break;
+        case IParam::kUnitSemitones:      unit = kAudioUnitParameterUnit_RelativeSemiTones;  break;
+        case IParam::kUnitMIDINote:       unit = kAudioUnitParameterUnit_MIDINoteNumber;     break;
+        case IParam::kUnitMIDICtrlNum:    unit = kAudioUnitParameterUnit_MIDIController;     break;
+        case IParam::kUnitBPM:            unit = kAudioUnitParameterUnit_BPM;                break;
+        case IParam::kUnitBeats:          unit = kAudioUnitParameterUnit_Beats;              break;
+        case IParam::kUnitCustom:
+        {
+          if (CStringHasContents(pParam->GetCustomUnit()))
+          {
+            unit = kAudioUnitParameterUnit_CustomUnit;
+            pUnitName = [NSString stringWithUTF8String:pParam->GetCustomUnit()];
+          }
+          break;
+        }
+        default:
+          break;
+      }
+    }
+  }
+
+  // value strings are only used by hosts for indexed parameters
+  if (unit == kAudioUnitParameterUnit_Indexed && pParam->NDisplayTexts())
+  {
+    pValueStrings = [NSMutableArray arrayWithCapacity:pParam->NDisplayTexts()];
+
+    for (int i = 0; i < pParam->NDisplayTexts(); i++)
+      [pValueStrings addObject:[NSString stringWithUTF8String:pParam->GetDisplayText(i)]];
+  }
+
+  return [AUParameterTree createParameterWithIdentifier:[NSString stringWithFormat:@"%d", idx]
+                                                   name:[NSString stringWithUTF8String:pParam->GetNameForHost()]
+                                                address:(AUParameterAddress) idx
+                                                    min:(AUValue) pParam->GetMin()
+                                                    max:(AUValue) pParam->GetMax()
+                                                   unit:unit
+                                               unitName:pUnitName
+                                                  flags:flags
+                                           valueStrings:pValueStrings
+                                    dependentParameters:nil];
+}
+
+@implementation IPlugAUAudioUnit
+{
+  std::unique_ptr<IPlugAUv3> mPlug;
+  std::vector<BufferedInputBus> mInputBuses;
+  BufferedOutputBus mOutputBus;
+  RenderState mRenderState;
+  AUAudioUnitBusArray* mInputBusArray;
+  AUAudioUnitBusArray* mOutputBusArray;
+  AUParameterTree* mParameterTree;
+  NSArray<AUAudioUnitPreset*>* mFactoryPresets;
+  AUAudioUnitPreset* mCurrentPreset;
+}
+
+- (instancetype) initWithComponentDescription: (AudioComponentDescription) componentDescription options: (AudioComponentInstantiationOptions) options error: (NSError**) outError
+{
+  self = [super initWithComponentDescription:componentDescription options:options error:outError];
+
+  if (self == nil)
+    return nil;
+
+  mPlug.reset(MakePlug(InstanceInfo()));
+  mPlug->SetAUAudioUnit((__bridge void*) self);
+
+  IPlugAUv3* pPlug = mPlug.get();
+
+  // buses
+  NSMutableArray<AUAudioUnitBus*>* pInputBuses = [NSMutableArray array];
+  const int nInputBuses = pPlug->MaxNBuses(ERoute::kInput);
+
+  mInputBuses.reserve(nInputBuses);
+
+  for (int i = 0; i < nInputBuses; i++)
+  {
+    const int nChans = std::abs(pPlug->MaxNChannelsForBus(ERoute::kInput, i));
+
+    if (nChans == 0)
+      continue;
+
+    AVAudioFormat* pFormat = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:DEFAULT_SAMPLE_RATE channels:nChans];
+    mInputBuses.emplace_back();
+    mInputBuses.back().Init(pFormat, nChans);
+    [pInputBuses addObject:mInputBuses.back().mBus];
+  }
+
+  // a MIDI effect still needs an output bus for the host to pull on
+  const int nOutputChans = std::max(std::abs(pPlug->MaxNChannelsForBus(ERoute::kOutput, 0)), pPlug->IsMidiEffect() ? 2 : 1);
+  AVAudioFormat* pOutputFormat = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:DEFAULT_SAMPLE_RATE channels:nOutputChans];
+  mOutputBus.Init(pOutputFormat, nOutputChans);
+
+  mInputBusArray = [[AUAudioUnitBusArray alloc] initWithAudioUnit:self busType:AUAudioUnitBusTypeInput busses:pInputBuses];
+  mOutputBusArray = [[AUAudioUnitBusArray alloc] initWithAudioUnit:self busType:AUAudioUnitBusTypeOutput busses:@[mOutputBus.mBus]];
+
+  // parameters, the address of each is its index
+  NSMutableArray<AUParameterNode*>* pParams = [NSMutableArray arrayWithCapacity:pPlug->NParams()];
+
+  for (int i = 0; i < pPlug->NParams(); i++)
+    [pParams addObject:CreateParameter(pPlug->GetParam(i), i)];
+
+  mParameterTree = [AUParameterTree createTreeWithChildren:pParams];
+
+  mParameterTree.implementorValueObserver = ^(AUParameter* pParam, AUValue value) {
+    pPlug->SetParameterFromValueObserver((int) pParam.address, value);
+  };
+
+  mParameterTree.implementorValueProvider = ^AUValue(AUParameter* pParam) {
+    return (AUValue) pPlug->GetParameter((int) pParam.address);
+  };
+
+  mParameterTree.implementorStringFromValueCallback = ^NSString*(AUParameter* pParam, const AUValue* pValue) {
+    WDL_String str;
+    pPlug->GetParameterDisplayString((int) pParam.address, pValue ? *pValue : pParam.value, str);
+    return [NSString stringWithUTF8String:str.Get()];
+  };
+
+  mParameterTree.implementorValueFromStringCallback = ^AUValue(AUParameter* pParam, NSString* pString) {
+    return (AUValue) pPlug->GetParameterValueFromString((int) pParam.address, [pString UTF8String]);
+  };
+
+  // presets
+  NSMutableArray<AUAudioUnitPreset*>* pPresets = [NSMutableArray arrayWithCapacity:pPlug->NPresets()];
+
+  for (int i = 0; i < pPlug->NPresets(); i++)
+  {
+    AUAudioUnitPreset* pPreset = [[AUAudioUnitPreset alloc] init];
+    pPreset.number = i;
+    pPreset.name = [NSString stringWithUTF8String:pPlug->GetPresetName(i)];
+    [pPresets addObject:pPreset];
+  }
+
+  mFactoryPresets = pPresets;
+  mCurrentPreset = pPresets.count ? pPresets[0] : nil;
+
+  self.maximumFramesToRender = 1024;
+
+  return self;
+}
+
+- (void) dealloc
+{
+  HostWorkgroup::Clear(mRenderState.mHostWorkgroup);
+  mPlug->SetAUAudioUnit(nullptr);
+}
+
+- (void*) getPlug
+{
+  return mPlug.get();
+}
+
+#pragma mark - AUAudioUnit overrides
+
+- (AUParameterTree*) parameterTree
+{
+  return mParameterTree;
+}
+
+- (AUAudioUnitBusArray*) inputBusses
+{
+  return mInputBusArray;
+}
+
+- (AUAudioUnitBusArray*) outputBusses
+{
+  return mOutputBusArray;
+}
+
+- (NSArray<NSNumber*>*) channelCapabilities
+{
+  NSMutableArray<NSNumber*>* pCapabilities = [NSMutableArray array];
+
+  for (int i = 0; i < mPlug->NIOConfigs(); i++)
+  {
+    IOConfig* pConfig = mPlug->GetIOConfig(i);
+    [pCapabilities addObject:@(pConfig->NChansOnBusSAFE(ERoute::kInput, 0))];
+    [pCapabilities addObject:@(pConfig->NChansOnBusSAFE(ERoute::kOutput, 0))];
+  }
+
+  return pCapabilities;
+}
+
+- (NSTimeInterval) latency
+{
+  return mPlug->GetLatency() / mPlug->GetSampleRate();
+}
+
+- (NSTimeInterval) tailTime
+{
+  return mPlug->GetTailSize() / mPlug->GetSampleRate();
+}
+
+- (BOOL) canProcessInPlace
+{
+  return NO;
+}
+
+- (BOOL) shouldBypassEffect
+{
+  return mPlug->GetBypassed();
+}
+
+- (void) setShouldBypassEffect: (BOOL) shouldBypassEffect
+{
+  mPlug->SetBypassedFromHost(shouldBypassEffect);
+}
+
+- (BOOL) supportsMPE
+{
+  return mPlug->DoesMPE();
+}
+
+- (NSArray<NSString*>*) MIDIOutputNames
+{
+  return mPlug->DoesMIDIOut() ? @[@"MIDI Out"] : @[];
+}
+
+- (NSArray<AUAudioUnitPreset*>*) factoryPresets
+{
+  return mFactoryPresets;
+}
+
+- (AUAudioUnitPreset*) currentPreset
+{
+  return mCurrentPreset;
+}
+
+- (void) setCurrentPreset: (AUAudioUnitPreset*) pPreset
+{
+  if (pPreset == nil)
+    return;
+
+  // user presets have negative numbers, and are restored by the host through fullState
+  if (pPreset.number >= 0)
+    mPlug->RestorePreset((int) pPreset.number);
+
+  mCurrentPreset = pPreset;
+}
+
+- (NSDictionary<NSString*, id>*) fullState
+{
+  NSMutableDictionary<NSString*, id>* pState = [[NSMutableDictionary alloc] initWithDictionary:[super fullState]];
+
+  IByteChunk chunk;
+
+  if (mPlug->SerializeState(chunk))
+    pState[@kAUPresetDataKey] = [NSData dataWithBytes:chunk.GetData() length:chunk.Size()];
+
+  return pState;
+}
+
+- (void) setFullState: (NSDictionary<NSString*, id>*) pFullState
+{
+  NSData* pData = pFullState[@kAUPresetDataKey];
+
+  if (![pData isKindOfClass:[NSData class]])
+    return;
+
+  const IByteChunkView chunk(pData.bytes, (int) pData.length);
+
+  if (mPlug->UnserializeState(chunk, 0) >= 0)
+    mPlug->OnRestoreState();
+}
+
+- (NSArray<NSNumber*>*) parametersForOverviewWithCount: (NSInteger) count
+{
+  WDL_TypedBuf<int> results;
+  mPlug->OnHostRequestingImportantParameters((int) count, results);
+
+  NSMutableArray<NSNumber*>* pAddresses = [NSMutableArray arrayWithCapacity:results.GetSize()];
+
+  for (int i = 0; i < results.GetSize(); i++)
+    [pAddresses addObject:@(results.Get()[i])];
+
+  return pAddresses;
+}
+
+- (NSIndexSet*) supportedViewConfigurations: (NSArray<AUAudioUnitViewConfiguration*>*) pAvailableViewConfigurations API_AVAILABLE(macos(10.13), ios(11))
+{
+  NSMutableIndexSet* pResult = [NSMutableIndexSet indexSet];
+
+  for (NSUInteger i = 0; i < pAvailableViewConfigurations.count; i++)
+  {
+    AUAudioUnitViewConfiguration* pConfig = pAvailableViewConfigurations[i];
+
+    if (mPlug->OnHostRequestingSupportedViewConfiguration((int) pConfig.width, (int) pConfig.height))
+      [pResult addIndex:i];
+  }
+
+  return pResult;
+}
+
+- (void) selectViewConfiguration: (AUAudioUnitViewConfiguration*) pViewConfiguration API_AVAILABLE(macos(10.13), ios(11))
+{
+  mPlug->OnHostSelectedViewConfiguration((int) pViewConfiguration.width, (int) pViewConfiguration.height);
+}
+
+#pragma mark - Render
+
+- (BOOL) allocateRenderResourcesAndReturnError: (NSError**) outError
+{
+  if (![super allocateRenderResourcesAndReturnError:outError])
+    return NO;
+
+  const AUAudioFrameCount maxFrames = self.maximumFramesToRender;
+  const int nMainInputChans = mInputBuses.size() ? (int) mInputBuses[0].mBus.format.channelCount : 0;
+  const int nOutputChans = (int) mOutputBus.mBus.format.channelCount;
+
+  if (!mPlug->IsMidiEffect() && !mPlug->LegalIO(nMainInputChans, nOutputChans))
+  {
+    if (outError)
+      *outError = [NSError errorWithDomain:NSOSStatusErrorDomain code:kAudioUnitErr_FormatNotSupported userInfo:nil];
+
+    self.renderResourcesAllocated = NO;
+    return NO;
+  }
+
+  int nInputChans = 0;
+
+  for (auto& bus : mInputBuses)
+  {
+    bus.AllocateRenderResources(maxFrames);
+    nInputChans += bus.NChannels();
+  }
+
+  mOutputBus.AllocateRenderResources(maxFrames);
+
+  mRenderState.mPlug = mPlug.get();
+  mRenderState.mInputBuses = mInputBuses.data();
+  mRenderState.mNInputBuses = (int) mInputBuses.size();
+  mRenderState.mOutputBus = &mOutputBus;
+  mRenderState.mMaxFrames = maxFrames;
+  mRenderState.mMusicalContext = self.musicalContextBlock;
+  mRenderState.mTransportState = self.transportStateBlock;
+  mRenderState.mMidiOutput = self.MIDIOutputEventBlock;
+
+  mPlug->SetMidiOutputBlock((__bridge void*) mRenderState.mMidiOutput);
+  mPlug->Prepare(mOutputBus.mBus.format.sampleRate, maxFrames, nInputChans, nOutputChans);
+
+  return YES;
+}
+
+- (void) deallocateRenderResources
+{
+  HostWorkgroup::Clear(mRenderState.mHostWorkgroup);
+  mRenderState.mHostWorkgroup = nullptr;
+  mPlug->Unprepare();
+  mPlug->SetMidiOutputBlock(nullptr);
+
+  mRenderState.mMusicalContext = nil;
+  mRenderState.mTransportState = nil;
+  mRenderState.mMidiOutput = nil;
+
+  for (auto& bus : mInputBuses)
+    bus.DeallocateRenderResources();
+
+  mOutputBus.DeallocateRenderResources();
+
+  [super deallocateRenderResources];
+}
+
+- (AUInternalRenderBlock) internalRenderBlock
+{
+  // only a C++ pointer is captured: the block never messages self, retains anything or allocates
+  RenderState* pState = &mRenderState;
+
+  return ^AUAudioUnitStatus(AudioUnitRenderActionFlags* pActionFlags, const AudioTimeStamp* pTimestamp, AVAudioFrameCount frameCount, NSInteger outputBusNumber,
+                            AudioBufferList* pOutputData, const AURenderEvent* pRealtimeEventListHead, AURenderPullInputBlock pullInputBlock) {
+    IPlugAUv3* pPlug = pState->mPlug;
+
+    if (frameCount > pState->mMaxFrames)
+      return kAudioUnitErr_TooManyFramesToProcess;
+
+    int chanIdx = 0;
+
+    for (int i = 0; i < pState->mNInputBuses; i++)
+    {
+      BufferedInputBus& bus = pState->mInputBuses[i];
+      AudioUnitRenderActionFlags pullFlags = 0;
+
+      if (bus.PullInput(&pullFlags, pTimestamp, frameCount, i, pullInputBlock) != noErr)
+      {
+        if (i == 0)
+          return kAudioUnitErr_NoConnection;
+
+        bus.ZeroFill(frameCount); // an unconnected sidechain
+      }
+
+      pPlug->AttachInputBuffers(chanIdx, bus.mMutableAudioBufferList, frameCount);
+      chanIdx += bus.NChannels();
+    }
+
+    pState->mOutputBus->PrepareOutputBufferList(pOutputData, frameCount, false);
+    pPlug->AttachOutputBuffers(pOutputData, frameCount);
+
+    ITimeInfo timeInfo;
+
+    double tempo = 0., tsNum = 0., currentBeat = 0., currentMeasureDownBeat = 0.;
+    NSInteger tsDenom = 0, sampleOffsetToNextBeat = 0;
+
+    if (pState->mMusicalContext && pState->mMusicalContext(&tempo, &tsNum, &tsDenom, &currentBeat, &sampleOffsetToNextBeat, &currentMeasureDownBeat))
+    {
+      if (tempo > 0.)
+        timeInfo.mTempo = tempo;
+
+      if (currentBeat >= 0.)
+        timeInfo.mPPQPos = currentBeat;
+
+      if (tsDenom > 0)
+      {
+        timeInfo.mNumerator = (int) tsNum;
+        timeInfo.mDenominator = (int) tsDenom;
+      }
+
+      if (currentMeasureDownBeat > 0.)
+        timeInfo.mLastBar = currentMeasureDownBeat;
+    }
+
+    AUHostTransportStateFlags transportFlags = 0;
+    double samplePos = 0., cycleStart = 0., cycleEnd = 0.;
+
+    if (pState->mTransportState && pState->mTransportState(&transportFlags, &samplePos, &cycleStart, &cycleEnd))
+    {
+      if (samplePos > 0.)
+        timeInfo.mSamplePos = samplePos;
+
+      if (cycleStart > 0.)
+        timeInfo.mCycleStart = cycleStart;
+
+      if (cycleEnd > 0.)
+        timeInfo.mCycleEnd = cycleEnd;
+
+      timeInfo.mTransportIsRunning = transportFlags & AUHostTransportStateMoving;
+      timeInfo.mTransportLoopEnabled = transportFlags & AUHostTransportStateCycling;
+    }
+
+    pPlug->ProcessWithEvents(pTimestamp, frameCount, pRealtimeEventListHead, timeInfo);
+
+    return noErr;
+  };
+}
+
+- (AURenderContextObserver) renderContextObserver API_AVAILABLE(macos(13.0), ios(16.0))
+{
+  // called on the render thread when the host's workgroup changes, so that the helper threads run as part of it
+  RenderState* pState = &mRenderState;
+
+  return ^(const AudioUnitRenderContext* pContext) {
+    pState->mHostWorkgroup = pContext ? (__bridge void*) pContext->workgroup : nullptr;
+    HostWorkgroup::Set(pState->mHostWorkgroup);
+  };
+}
+
+#pragma mark - IPlugAUv3
+
+- (void) beginInformHostOfParamChange: (uint64_t) address
+{
+  AUParameter* pParam = [mParameterTree parameterWithAddress:address];
+  [pParam setValue:pParam.value originator:nil atHostTime:0 eventType:AUParameterAutomationEventTypeTouch];
+}
+
+- (void) informHostOfParamChange: (uint64_t) address : (float) realValue
+{
+  [[mParameterTree parameterWithAddress:address] setValue:realValue originator:nil];
+}
+
+- (void) endInformHostOfParamChange: (uint64_t) address
+{
+  AUParameter* pParam = [mParameterTree parameterWithAddress:address];
+  [pParam setValue:pParam.value originator:nil atHostTime:0 eventType:AUParameterAutomationEventTypeRelease];
+}
+
+- (void) informHostOfLatencyChange
+{
+  [self willChangeValueForKey:@"latency"];
+  [self didChangeValueForKey:@"latency"];
+}
+
+- (void*) openWindow: (void*) pParent
+{
+  return mPlug->OpenWindow(pParent);
+}
+
+- (void) closeWindow
+{
+  mPlug->CloseWindow();
+}
+
+- (CGSize) editorSize
+{
+  return CGSizeMake(mPlug->GetEditorWidth(), mPlug->GetEditorHeight());
+}
+
+@end
@@ -0,0 +1,23 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+#import <CoreAudioKit/CoreAudioKit.h>
+
+@class IPlugAUAudioUnit;
+
+/** The principal class of an AUv3 app extension. It creates the IPlugAUAudioUnit, and hosts the plug-in's editor in its view
+ * NOTE: the class name is not prefixed, because it is named in the extension's Info.plist and storyboard */
+@interface IPlugAUViewController : AUViewController <AUAudioUnitFactory>
+
+@property (nonatomic, strong) IPlugAUAudioUnit* audioUnit;
+
+@end
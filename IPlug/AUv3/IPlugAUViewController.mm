@@ -0,0 +1,69 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#import "IPlugAUViewController.h"
+#import "IPlugAUAudioUnit.h"
+
+#if !__has_feature(objc_arc)
+#error This file must be compiled with ARC. Use -fobjc-arc flag
+#endif
+
+@implementation IPlugAUViewController
+{
+  BOOL mEditorOpen;
+}
+
+- (AUAudioUnit*) createAudioUnitWithComponentDescription: (AudioComponentDescription) desc error: (NSError**) error
+{
+  IPlugAUAudioUnit* pAudioUnit = [[IPlugAUAudioUnit alloc] initWithComponentDescription:desc error:error];
+
+  // this may be called on any thread, the editor is opened on the main thread
+  dispatch_async(dispatch_get_main_queue(), ^{
+    self.audioUnit = pAudioUnit;
+  });
+
+  return pAudioUnit;
+}
+
+- (void) setAudioUnit: (IPlugAUAudioUnit*) pAudioUnit
+{
+  _audioUnit = pAudioUnit;
+
+  if ([self isViewLoaded])
+    [self openEditor];
+}
+
+- (void) viewDidLoad
+{
+  [super viewDidLoad];
+
+  if (_audioUnit)
+    [self openEditor];
+}
+
+- (void) openEditor
+{
+  if (mEditorOpen)
+    return;
+
+  if ([_audioUnit openWindow:(__bridge void*) self.view])
+  {
+    mEditorOpen = YES;
+    self.preferredContentSize = [_audioUnit editorSize];
+  }
+}
+
+- (void) dealloc
+{
+  if (mEditorOpen)
+    [_audioUnit closeWindow];
+}
+
+@end
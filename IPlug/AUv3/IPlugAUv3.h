@@ -0,0 +1,179 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#ifndef _IPLUGAPI_
+#define _IPLUGAPI_
+// Only load one API class!
+
+/**
+ * @file
+ * @copydoc IPlugAUv3
+ */
+
+#include <CoreAudio/CoreAudioTypes.h>
+
+#include "IPlugAPIBase.h"
+#include "IPlugProcessor.h"
+
+// defined in AudioToolbox/AUAudioUnitImplementation.h, which needs Objective-C, so it is only used in IPlugAUv3.mm
+union AURenderEvent;
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Used to pass various instance info to the API class */
+struct InstanceInfo
+{};
+
+/**  AudioUnit v3 API base class for an IPlug plug-in
+ * The host facing Objective-C side lives in IPlugAUAudioUnit, which builds its parameter tree and buses from this class. Its internalRenderBlock only
+ * captures C++ pointers, pulls the inputs into buffers that were allocated in allocateRenderResources and then calls ProcessWithEvents(),
+ * so rendering involves no Objective-C messaging and no allocation.
+ * Parameter and MIDI events in the AURenderEvent list are put on the same block timeline as the other APIs, see SetSampleAccurateAutomation()
+ *   @ingroup APIClasses */
+class IPlugAUv3 : public IPlugAPIBase
+                , public IPlugProcessor
+{
+public:
+  IPlugAUv3(const InstanceInfo& info, const Config& config);
+  ~IPlugAUv3();
+
+//IPlugAPIBase
+  void BeginInformHostOfParamChange(int idx) override;
+  void InformHostOfParamChange(int idx, double normalizedValue) override;
+  void EndInformHostOfParamChange(int idx) override;
+  void InformHostOfProgramChange() override {}
+
+//IPlugProcessor
+  bool SendMidiMsg(const IMidiMsg& msg) override;
+  bool SendSysEx(const ISysEx& msg) override;
+  void SetLatency(int samples) override;
+
+//IPlugAUv3
+  /** Opt-in to sample accurate parameter automation. Rather than applying the parameter events in the render event list before processing, immediate
+   * events and points sampled along ramped events are merged into a sorted timeline, and the render block is split into sub-blocks between change points,
+   * calling ProcessBlock() for each sub-block.
+   * If you use IMidiQueue, make sure you call Flush(nFrames) at the end of ProcessBlock(), so that MIDI message offsets remain valid across sub-blocks.
+   * @param enable \c true in order to split the render block at parameter change points
+   * @param minSubBlockSize The smallest sub-block (in samples) that will be processed, and the spacing of the points taken along a ramp.
+   * Changes closer together than this will be applied at the start of the next sub-block */
+  void SetSampleAccurateAutomation(bool enable, int minSubBlockSize = DEFAULT_MIN_SUBBLOCK_SIZE);
+
+  /** @return \c true if sample accurate parameter automation is enabled, see SetSampleAccurateAutomation() */
+  bool GetSampleAccurateAutomation() const { return mSampleAccurateAutomation; }
+
+  /** Called by IPlugAUAudioUnit on the main thread, from allocateRenderResources. Everything the render block needs is allocated here
+   * @param sampleRate The sample rate of the output bus
+   * @param maxFramesToRender The largest block the host will render
+   * @param nInputChans The number of channels on each connected input bus, summed
+   * @param nOutputChans The number of channels on the output bus */
+  void Prepare(double sampleRate, int maxFramesToRender, int nInputChans, int nOutputChans);
+
+  /** Called by IPlugAUAudioUnit on the main thread, from deallocateRenderResources */
+  void Unprepare();
+
+  /** Called from the render block, after the inputs have been pulled. Attaches the channels of one input bus
+   * @param chanIdx The plug-in channel index of the first channel in the buffer list
+   * @param pBufferList A non-interleaved buffer list, which must remain valid until ProcessWithEvents() returns
+   * @param nFrames The number of frames in this block */
+  void AttachInputBuffers(int chanIdx, const AudioBufferList* pBufferList, int nFrames);
+
+  /** Called from the render block. Attaches the channels of the output bus, which must already point at memory
+   * @param pBufferList A non-interleaved buffer list, which must remain valid until ProcessWithEvents() returns
+   * @param nFrames The number of frames in this block */
+  void AttachOutputBuffers(AudioBufferList* pBufferList, int nFrames);
+
+  /** Called from the render block, on the realtime thread. Applies the events in the render event list and processes the attached buffers
+   * @param pTimestamp The timestamp of the block, the event sample times are relative to its mSampleTime
+   * @param nFrames The number of frames in this block
+   * @param pEvents The head of the render event list, may be nullptr
+   * @param timeInfo The transport state, which the render block gets from the host's musical context and transport state blocks */
+  void ProcessWithEvents(const AudioTimeStamp* pTimestamp, int nFrames, const AURenderEvent* pEvents, const ITimeInfo& timeInfo);
+
+  /** Called by the parameter tree's implementorValueObserver, when the host or another AUParameterTree observer sets a parameter outside of the render block
+   * @param paramIdx The parameter index, which is also its AUParameterAddress
+   * @param value The non-normalized value */
+  void SetParameterFromValueObserver(int paramIdx, double value);
+
+  /** Called by the parameter tree's implementorValueProvider
+   * @param paramIdx The parameter index, which is also its AUParameterAddress
+   * @return The non-normalized value */
+  double GetParameter(int paramIdx);
+
+  /** Called by the parameter tree's implementorStringFromValueCallback
+   * @param paramIdx The parameter index
+   * @param value The non-normalized value
+   * @param str Receives the display text */
+  void GetParameterDisplayString(int paramIdx, double value, WDL_String& str);
+
+  /** Called by the parameter tree's implementorValueFromStringCallback
+   * @param paramIdx The parameter index
+   * @param str The display text to parse
+   * @return The non-normalized value */
+  double GetParameterValueFromString(int paramIdx, const char* str);
+
+  /** Called by IPlugAUAudioUnit when the host sets shouldBypassEffect
+   * @param bypassed \c true if the host wants the effect bypassed */
+  void SetBypassedFromHost(bool bypassed) { SetBypassed(bypassed); }
+
+  /** Set by IPlugAUAudioUnit, so that the Inform* methods can reach its parameter tree
+   * @param pAUAudioUnit An unretained IPlugAUAudioUnit* */
+  void SetAUAudioUnit(void* pAUAudioUnit) { mAUAudioUnit = pAUAudioUnit; }
+
+  /** Set by IPlugAUAudioUnit in allocateRenderResources, which keeps the block alive until deallocateRenderResources
+   * @param pMidiOutputBlock An unretained AUMIDIOutputEventBlock, or nullptr if the host does not take MIDI output */
+  void SetMidiOutputBlock(void* pMidiOutputBlock) { mMidiOutputBlock = pMidiOutputBlock; }
+
+private:
+  /** A parameter event from the render event list. Immediate events have no duration. A ramp that continues past the block is kept for the next one,
+   * with its offset moved back, until it finishes or another event for the same parameter cuts it short */
+  struct ScheduledParamEvent
+  {
+    int idx;
+    int offset;
+    int duration;
+    int cutOffset;
+    double startValue;
+    double endValue;
+  };
+
+  /** A single point on the render block's timeline of parameter changes */
+  struct ParamChangePoint
+  {
+    int offset;
+    int order;
+    int idx;
+    double value;
+  };
+
+  void AddParamEvent(int idx, int offset, int duration, double value);
+  void BuildParamChangePoints(int nFrames);
+  void ApplyParamChangePoints();
+  void ProcessSubBlocks(int nFrames);
+  void SetParameterFromRenderEvent(int idx, double value, int offset);
+  void OutputSysexFromEditor();
+
+  void* mAUAudioUnit = nullptr;
+  void* mMidiOutputBlock = nullptr;
+  double mLastRenderSampleTime = 0.;
+  int mParamIdxFromUI = kNoParameter;
+  WDL_TypedBuf<float*> mInputPtrs;
+  WDL_TypedBuf<float*> mOutputPtrs;
+  WDL_TypedBuf<ScheduledParamEvent> mScheduledParams;
+  WDL_TypedBuf<ScheduledParamEvent> mContinuingRamps;
+  WDL_TypedBuf<ParamChangePoint> mParamChangePoints;
+  bool mSampleAccurateAutomation = false;
+  int mMinSubBlockSize = DEFAULT_MIN_SUBBLOCK_SIZE;
+};
+
+IPlugAUv3* MakePlug(const InstanceInfo& info);
+
+END_IPLUG_NAMESPACE
+
+#endif //_IPLUGAPI_
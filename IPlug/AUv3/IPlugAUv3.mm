@@ -0,0 +1,440 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#include <climits>
+#include <AudioToolbox/AudioToolbox.h>
+
+#include "IPlugAUv3.h"
+#import "IPlugAUAudioUnit.h"
+
+using namespace iplug;
+
+IPlugAUv3::IPlugAUv3(const InstanceInfo& info, const Config& config)
+: IPlugAPIBase(config, kAPIAUv3)
+, IPlugProcessor(config, kAPIAUv3)
+{
+  Trace(TRACELOC, "%s", config.pluginName);
+
+  int nInputs = MaxNChannels(ERoute::kInput), nOutputs = MaxNChannels(ERoute::kOutput);
+
+  SetChannelConnections(ERoute::kInput, 0, nInputs, true);
+  SetChannelConnections(ERoute::kOutput, 0, nOutputs, true);
+
+  SetBlockSize(DEFAULT_BLOCK_SIZE);
+
+  CreateTimer();
+}
+
+IPlugAUv3::~IPlugAUv3()
+{
+}
+
+void IPlugAUv3::BeginInformHostOfParamChange(int idx)
+{
+  Trace(TRACELOC, "%d", idx);
+  [(__bridge IPlugAUAudioUnit*) mAUAudioUnit beginInformHostOfParamChange:idx];
+}
+
+void IPlugAUv3::InformHostOfParamChange(int idx, double normalizedValue)
+{
+  Trace(TRACELOC, "%d:%f", idx, normalizedValue);
+
+  // the tree calls its implementorValueObserver for our own changes too, which would set the parameter a second time
+  mParamIdxFromUI = idx;
+  [(__bridge IPlugAUAudioUnit*) mAUAudioUnit informHostOfParamChange:idx :(float) GetParam(idx)->Value()];
+  mParamIdxFromUI = kNoParameter;
+}
+
+void IPlugAUv3::EndInformHostOfParamChange(int idx)
+{
+  Trace(TRACELOC, "%d", idx);
+  [(__bridge IPlugAUAudioUnit*) mAUAudioUnit endInformHostOfParamChange:idx];
+}
+
+void IPlugAUv3::SetLatency(int samples)
+{
+  IPlugProcessor::SetLatency(samples);
+  [(__bridge IPlugAUAudioUnit*) mAUAudioUnit informHostOfLatencyChange];
+}
+
+bool IPlugAUv3::SendMidiMsg(const IMidiMsg& msg)
+{
+  if (!mMidiOutputBlock)
+    return false;
+
+  const uint8_t data[3] = { msg.mStatus, msg.mData1, msg.mData2 };
+  AUMIDIOutputEventBlock midiOutputBlock = (__bridge AUMIDIOutputEventBlock) mMidiOutputBlock;
+
+  return midiOutputBlock((AUEventSampleTime) mLastRenderSampleTime + msg.mOffset, 0, 3, data) == noErr;
+}
+
+bool IPlugAUv3::SendSysEx(const ISysEx& msg)
+{
+  if (!mMidiOutputBlock)
+    return false;
+
+  AUMIDIOutputEventBlock midiOutputBlock = (__bridge AUMIDIOutputEventBlock) mMidiOutputBlock;
+
+  return midiOutputBlock((AUEventSampleTime) mLastRenderSampleTime + msg.mOffset, 0, msg.mSize, msg.mData) == noErr;
+}
+
+void IPlugAUv3::OutputSysexFromEditor()
+{
+  //Output SYSEX from the editor, which has bypassed ProcessSysEx()
+  ISysEx smsg;
+
+  while (mSysExDataFromEditor.Peek(smsg))
+  {
+    SendSysEx(smsg);
+    mSysExDataFromEditor.Pop();
+  }
+}
+
+void IPlugAUv3::SetSampleAccurateAutomation(bool enable, int minSubBlockSize)
+{
+  mSampleAccurateAutomation = enable;
+  mMinSubBlockSize = std::max(minSubBlockSize, 1);
+}
+
+void IPlugAUv3::Prepare(double sampleRate, int maxFramesToRender, int nInputChans, int nOutputChans)
+{
+  TRACE;
+
+  SetSampleRate(sampleRate);
+  SetBlockSize(maxFramesToRender);
+
+  SetChannelConnections(ERoute::kInput, 0, MaxNChannels(ERoute::kInput), false);
+  SetChannelConnections(ERoute::kInput, 0, nInputChans, true);
+  SetChannelConnections(ERoute::kOutput, 0, MaxNChannels(ERoute::kOutput), false);
+  SetChannelConnections(ERoute::kOutput, 0, nOutputChans, true);
+
+  mInputPtrs.Resize(std::max(MaxNChannels(ERoute::kInput), 1));
+  mOutputPtrs.Resize(std::max(MaxNChannels(ERoute::kOutput), 1));
+
+  // ramps are sampled every mMinSubBlockSize frames, so the number of points per block is bounded by the block size
+  mScheduledParams.Resize(NParams() * 4, false);
+  mScheduledParams.Resize(0, false);
+  mContinuingRamps.Resize(NParams(), false);
+  mContinuingRamps.Resize(0, false);
+  mParamChangePoints.Resize(NParams() * 4 + maxFramesToRender, false);
+  mParamChangePoints.Resize(0, false);
+
+  OnParamReset(kReset);
+  OnReset();
+  OnActivate(true);
+}
+
+void IPlugAUv3::Unprepare()
+{
+  TRACE;
+  mContinuingRamps.Resize(0, false);
+  OnActivate(false);
+}
+
+void IPlugAUv3::AttachInputBuffers(int chanIdx, const AudioBufferList* pBufferList, int nFrames)
+{
+  const int nChans = std::min((int) pBufferList->mNumberBuffers, mInputPtrs.GetSize() - chanIdx);
+
+  for (int i = 0; i < nChans; i++)
+    mInputPtrs.Get()[chanIdx + i] = (float*) pBufferList->mBuffers[i].mData;
+
+  AttachBuffers(ERoute::kInput, chanIdx, nChans, mInputPtrs.Get() + chanIdx, nFrames);
+}
+
+void IPlugAUv3::AttachOutputBuffers(AudioBufferList* pBufferList, int nFrames)
+{
+  const int nChans = std::min((int) pBufferList->mNumberBuffers, mOutputPtrs.GetSize());
+
+  for (int i = 0; i < nChans; i++)
+    mOutputPtrs.Get()[i] = (float*) pBufferList->mBuffers[i].mData;
+
+  AttachBuffers(ERoute::kOutput, 0, nChans, mOutputPtrs.Get(), nFrames);
+}
+
+void IPlugAUv3::ProcessWithEvents(const AudioTimeStamp* pTimestamp, int nFrames, const AURenderEvent* pEvents, const ITimeInfo& timeInfo)
+{
+  REALTIME_SCOPE;
+  IFlushDenormalsScope denormalsScope(GetFlushDenormals());
+
+  mLastRenderSampleTime = pTimestamp->mSampleTime;
+
+  ProcessDeferredParamChanges();
+
+  for (const AURenderEvent* pEvent = pEvents; pEvent; pEvent = pEvent->head.next)
+  {
+    const int offset = Clip((int) (pEvent->head.eventSampleTime - (AUEventSampleTime) pTimestamp->mSampleTime), 0, nFrames - 1);
+
+    switch (pEvent->head.eventType)
+    {
+      case AURenderEventParameter:
+      case AURenderEventParameterRamp:
+      {
+        const AUParameterEvent& paramEvent = pEvent->parameter;
+
+        if (paramEvent.parameterAddress < (AUParameterAddress) NParams())
+          AddParamEvent((int) paramEvent.parameterAddress, offset, (int) paramEvent.rampDurationSampleFrames, paramEvent.value);
+        break;
+      }
+      case AURenderEventMIDI:
+      {
+        const AUMIDIEvent& midiEvent = pEvent->MIDI;
+        IMidiMsg msg(offset, midiEvent.data[0], midiEvent.data[1], midiEvent.data[2]);
+        ReceiveMidiMsg(msg);
+        break;
+      }
+      case AURenderEventMIDISysEx:
+      {
+        const AUMIDIEvent& midiEvent = pEvent->MIDI;
+        ISysEx sysex(offset, midiEvent.data, midiEvent.length);
+        ProcessSysEx(sysex);
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  BuildParamChangePoints(nFrames);
+
+  if (GetBypassed())
+  {
+    ApplyParamChangePoints();
+    PassThroughBuffers((float) 0, nFrames);
+  }
+  else
+  {
+    if (mMidiMsgsFromEditor.ElementsAvailable())
+    {
+      IMidiMsg msg;
+
+      while (mMidiMsgsFromEditor.Pop(msg))
+      {
+        ReceiveMidiMsg(msg);
+      }
+    }
+
+    SetTimeInfo(timeInfo);
+
+    if (SkipSilentBuffers((float) 0, nFrames))
+    {
+      // the input has been silent for longer than the tail, the outputs were zeroed
+    }
+    else if (mSampleAccurateAutomation && mParamChangePoints.GetSize())
+      ProcessSubBlocks(nFrames);
+    else
+    {
+      ApplyParamChangePoints();
+      ProcessBuffers((float) 0, nFrames);
+    }
+  }
+
+  ClearBlockEvents();
+  OutputSysexFromEditor();
+}
+
+void IPlugAUv3::AddParamEvent(int idx, int offset, int duration, double value)
+{
+  // a ramp starts from wherever the parameter is at that point in the block
+  double startValue = GetParam(idx)->Value();
+
+  for (auto i = 0; i < mScheduledParams.GetSize(); i++)
+  {
+    ScheduledParamEvent& event = mScheduledParams.Get()[i];
+
+    if (event.idx == idx && event.offset <= offset)
+    {
+      event.cutOffset = std::min(event.cutOffset, offset);
+      startValue = event.duration > 0 ? event.startValue + (event.endValue - event.startValue) * std::min(double(offset - event.offset) / event.duration, 1.) : event.endValue;
+    }
+  }
+
+  mScheduledParams.Add({idx, offset, std::max(duration, 0), INT_MAX, startValue, value});
+}
+
+void IPlugAUv3::BuildParamChangePoints(int nFrames)
+{
+  mParamChangePoints.Resize(0, false);
+
+  auto addPoint = [&](int offset, int idx, double value) {
+    mParamChangePoints.Add({offset, mParamChangePoints.GetSize(), idx, value});
+    mBlockEvents.AddParamChange(std::min(offset, nFrames - 1), idx, value);
+  };
+
+  auto addEventPoints = [&](const ScheduledParamEvent& event) {
+    if (event.duration <= 0)
+    {
+      addPoint(event.offset, event.idx, event.endValue);
+      return;
+    }
+
+    const int endOffset = event.offset + event.duration;
+    const int lastOffset = std::min({endOffset, nFrames, event.cutOffset});
+    const double slope = (event.endValue - event.startValue) / event.duration;
+
+    for (int offset = std::max(event.offset, 0); offset < lastOffset; offset += mMinSubBlockSize)
+      addPoint(offset, event.idx, event.startValue + slope * (offset - event.offset));
+
+    if (endOffset <= nFrames && endOffset <= event.cutOffset)
+      addPoint(endOffset, event.idx, event.endValue);
+  };
+
+  // ramps from earlier blocks come first, unless an event in this block has cut them short
+  int nContinuing = 0;
+
+  for (auto i = 0; i < mContinuingRamps.GetSize(); i++)
+  {
+    ScheduledParamEvent event = mContinuingRamps.Get()[i];
+
+    for (auto j = 0; j < mScheduledParams.GetSize(); j++)
+    {
+      if (mScheduledParams.Get()[j].idx == event.idx)
+        event.cutOffset = std::min(event.cutOffset, mScheduledParams.Get()[j].offset);
+    }
+
+    addEventPoints(event);
+
+    if (event.cutOffset == INT_MAX && event.offset + event.duration > nFrames)
+    {
+      event.offset -= nFrames;
+      mContinuingRamps.Get()[nContinuing++] = event;
+    }
+  }
+
+  mContinuingRamps.Resize(nContinuing, false);
+
+  for (auto i = 0; i < mScheduledParams.GetSize(); i++)
+  {
+    ScheduledParamEvent event = mScheduledParams.Get()[i];
+    addEventPoints(event);
+
+    // a host sends a ramp once, so the rest of it is kept for the following blocks
+    if (event.duration > 0 && event.cutOffset == INT_MAX && event.offset + event.duration > nFrames)
+    {
+      event.offset -= nFrames;
+      mContinuingRamps.Add(event);
+    }
+  }
+
+  mScheduledParams.Resize(0, false);
+
+  if (mParamChangePoints.GetSize())
+  {
+    // order is used to keep std::sort stable without allocating
+    std::sort(mParamChangePoints.Get(), mParamChangePoints.Get() + mParamChangePoints.GetSize(), [](const ParamChangePoint& a, const ParamChangePoint& b) {
+      return a.offset != b.offset ? a.offset < b.offset : a.order < b.order;
+    });
+  }
+}
+
+void IPlugAUv3::ApplyParamChangePoints()
+{
+  const ParamChangePoint* pPoints = mParamChangePoints.Get();
+
+  for (auto i = 0; i < mParamChangePoints.GetSize(); i++)
+    SetParameterFromRenderEvent(pPoints[i].idx, pPoints[i].value, pPoints[i].offset);
+
+  mParamChangePoints.Resize(0, false);
+}
+
+void IPlugAUv3::ProcessSubBlocks(int nFrames)
+{
+  const ParamChangePoint* pPoints = mParamChangePoints.Get();
+  const int nPoints = mParamChangePoints.GetSize();
+  const ITimeInfo blockTimeInfo = mTimeInfo;
+  const double samplesPerBeat = GetSamplesPerBeat();
+  int pointIdx = 0;
+  int startIdx = 0;
+
+  while (startIdx < nFrames)
+  {
+    // changes that fell inside the previous sub-block are applied at the start of this one
+    while (pointIdx < nPoints && pPoints[pointIdx].offset <= startIdx)
+    {
+      SetParameterFromRenderEvent(pPoints[pointIdx].idx, pPoints[pointIdx].value, pPoints[pointIdx].offset);
+      pointIdx++;
+    }
+
+    int endIdx = nFrames;
+
+    if (pointIdx < nPoints)
+      endIdx = std::min(std::max(pPoints[pointIdx].offset, startIdx + mMinSubBlockSize), nFrames);
+
+    if (blockTimeInfo.mSamplePos >= 0.)
+      mTimeInfo.mSamplePos = blockTimeInfo.mSamplePos + startIdx;
+
+    if (blockTimeInfo.mPPQPos >= 0. && samplesPerBeat > 0.)
+      mTimeInfo.mPPQPos = blockTimeInfo.mPPQPos + (startIdx / samplesPerBeat);
+
+    ProcessBuffers((float) 0, endIdx - startIdx, startIdx);
+    startIdx = endIdx;
+  }
+
+  // any changes at or beyond the end of the block
+  for (; pointIdx < nPoints; pointIdx++)
+    SetParameterFromRenderEvent(pPoints[pointIdx].idx, pPoints[pointIdx].value, pPoints[pointIdx].offset);
+
+  mTimeInfo = blockTimeInfo;
+  mParamChangePoints.Resize(0, false);
+}
+
+void IPlugAUv3::SetParameterFromRenderEvent(int idx, double value, int offset)
+{
+  ENTER_PARAMS_MUTEX;
+  BeginParamsWrite();
+  GetParam(idx)->Set(value);
+  EndParamsWrite();
+  LEAVE_PARAMS_MUTEX;
+  SendParameterValueFromAPI(idx, value, false);
+  OnParamChange(idx, kHost, offset);
+}
+
+void IPlugAUv3::SetParameterFromValueObserver(int paramIdx, double value)
+{
+  if (paramIdx == mParamIdxFromUI || paramIdx >= NParams())
+    return;
+
+  ENTER_PARAMS_MUTEX;
+  BeginParamsWrite();
+  GetParam(paramIdx)->Set(value);
+  EndParamsWrite();
+  LEAVE_PARAMS_MUTEX;
+  SendParameterValueFromAPI(paramIdx, value, false);
+#ifdef PARAMS_LOCKFREE
+  DeferParamChange(paramIdx, kHost);
+#else
+  OnParamChange(paramIdx, kHost);
+#endif
+}
+
+double IPlugAUv3::GetParameter(int paramIdx)
+{
+  if (paramIdx >= NParams())
+    return 0.;
+
+  ENTER_PARAMS_MUTEX;
+  const double value = GetParam(paramIdx)->Value();
+  LEAVE_PARAMS_MUTEX;
+  return value;
+}
+
+void IPlugAUv3::GetParameterDisplayString(int paramIdx, double value, WDL_String& str)
+{
+  ENTER_PARAMS_MUTEX;
+  GetParam(paramIdx)->GetDisplayForHost(value, false, str);
+  LEAVE_PARAMS_MUTEX;
+}
+
+double IPlugAUv3::GetParameterValueFromString(int paramIdx, const char* str)
+{
+  ENTER_PARAMS_MUTEX;
+  const double value = GetParam(paramIdx)->StringToValue(str);
+  LEAVE_PARAMS_MUTEX;
+  return value;
+}
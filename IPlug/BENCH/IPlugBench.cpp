@@ -0,0 +1,96 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#include <cstdio>
+
+#include "IPlugBench.h"
+
+using namespace iplug;
+
+IPlugBench::IPlugBench(const InstanceInfo& info, const Config& config)
+: IPlugAPIBase(config, kAPIBENCH)
+, IPlugProcessor(config, kAPIBENCH)
+{
+  Trace(TRACELOC, "%s%s", config.pluginName, config.channelIOStr);
+
+  SetChannelConnections(ERoute::kInput, 0, MaxNChannels(ERoute::kInput), !IsInstrument());
+  SetChannelConnections(ERoute::kOutput, 0, MaxNChannels(ERoute::kOutput), true);
+
+  SetBlockSize(DEFAULT_BLOCK_SIZE);
+
+  // no timer: there is no UI to update, and the benchmark should only measure processing
+}
+
+void IPlugBench::BenchPrepare(double sampleRate, int blockSize)
+{
+  SetSampleRate(sampleRate);
+  SetBlockSize(blockSize);
+  mMidiQueue.Reserve(blockSize);
+  mSamplePos = 0.;
+  OnActivate(true);
+  OnReset();
+}
+
+bool IPlugBench::BenchLoadState(const char* path)
+{
+  FILE* pFile = fopen(path, "rb");
+
+  if (!pFile)
+    return false;
+
+  fseek(pFile, 0, SEEK_END);
+  const long size = ftell(pFile);
+  fseek(pFile, 0, SEEK_SET);
+
+  IByteChunk chunk;
+  chunk.Resize(static_cast<int>(size));
+  const bool read = size > 0 && fread(chunk.GetData(), 1, size, pFile) == static_cast<size_t>(size);
+  fclose(pFile);
+
+  if (!read || UnserializeState(chunk, 0) < 0)
+    return false;
+
+  OnRestoreState();
+  return true;
+}
+
+void IPlugBench::BenchSendMidiMsg(const IMidiMsg& msg)
+{
+  mMidiQueue.Add(msg);
+}
+
+void IPlugBench::BenchProcess(sample** inputs, sample** outputs, int nFrames)
+{
+  IFlushDenormalsScope denormalsScope(GetFlushDenormals());
+
+  ProcessDeferredParamChanges();
+
+  ITimeInfo timeInfo;
+  timeInfo.mSamplePos = mSamplePos;
+  timeInfo.mPPQPos = mSamplePos / GetSampleRate() * (timeInfo.mTempo / 60.);
+  timeInfo.mTransportIsRunning = true;
+  SetTimeInfo(timeInfo);
+
+  while (!mMidiQueue.Empty() && mMidiQueue.Peek().mOffset < nFrames)
+  {
+    IMidiMsg& msg = mMidiQueue.Peek();
+    ReceiveMidiMsg(msg);
+    mMidiQueue.Remove();
+  }
+
+  mMidiQueue.Flush(nFrames);
+
+  AttachBuffers(ERoute::kInput, 0, NChannelsConnected(ERoute::kInput), inputs, nFrames);
+  AttachBuffers(ERoute::kOutput, 0, NChannelsConnected(ERoute::kOutput), outputs, nFrames);
+  ProcessBuffers(sample(0.), nFrames);
+  ClearBlockEvents();
+
+  mSamplePos += nFrames;
+}
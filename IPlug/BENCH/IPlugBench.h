@@ -0,0 +1,76 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#ifndef _IPLUGAPI_
+#define _IPLUGAPI_
+
+/**
+ * @file
+ * @copydoc IPlugBench
+ */
+
+#include "IPlugPlatform.h"
+#include "IPlugAPIBase.h"
+#include "IPlugProcessor.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+struct InstanceInfo
+{
+};
+
+/**  Headless base class used to benchmark an IPlug plug-in offline, without a host, audio device or user interface. See IPlugBench_main.cpp
+*   @ingroup APIClasses */
+class IPlugBench : public IPlugAPIBase
+                 , public IPlugProcessor
+{
+public:
+  IPlugBench(const InstanceInfo& info, const Config& config);
+
+  //IPlugAPIBase
+  void BeginInformHostOfParamChange(int idx) override {};
+  void InformHostOfParamChange(int idx, double normalizedValue) override {};
+  void EndInformHostOfParamChange(int idx) override {};
+  void InformHostOfProgramChange() override {};
+
+  //IPlugProcessor
+  bool SendMidiMsg(const IMidiMsg& msg) override { return true; } // MIDI output is discarded
+  bool SendSysEx(const ISysEx& msg) override { return true; }
+
+  //IPlugBench
+  /** Set up processing as a host would before starting playback
+   * @param sampleRate The sample rate
+   * @param blockSize The maximum number of frames passed to BenchProcess() */
+  void BenchPrepare(double sampleRate, int blockSize);
+
+  /** Restore state saved by SerializeState(), e.g. a chunk saved from a DAW project
+   * @param path The file containing the raw state bytes
+   * @return \c true on success */
+  bool BenchLoadState(const char* path);
+
+  /** Queue a MIDI message for the next call to BenchProcess() */
+  void BenchSendMidiMsg(const IMidiMsg& msg);
+
+  /** Process one block, with the transport running from the start of the render
+   * @param inputs MaxNChannels(ERoute::kInput) channel pointers
+   * @param outputs MaxNChannels(ERoute::kOutput) channel pointers
+   * @param nFrames The number of frames, no more than the block size passed to BenchPrepare() */
+  void BenchProcess(sample** inputs, sample** outputs, int nFrames);
+
+private:
+  IMidiQueue mMidiQueue;
+  double mSamplePos = 0.;
+};
+
+IPlugBench* MakePlug(const InstanceInfo& info);
+
+END_IPLUG_NAMESPACE
+
+#endif
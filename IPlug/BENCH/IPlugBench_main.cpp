@@ -0,0 +1,562 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line benchmark for IPlug plug-ins, built with BENCH_API. It renders audio through the plug-in as fast as possible and reports
+ * the real-time factor, per-block processing time percentiles and the number of allocations made while rendering. Run with --help for the options.
+ * Allocations are counted by replacing the global operator new, so blocks allocated with malloc()/realloc() (e.g. by WDL_TypedBuf) are not included.
+ * Built with IPLUG_EDITOR=1 and IGRAPHICS_HEADLESS (make BENCH_UI=1), the --ui options time the plug-in's UI instead, and compare a screenshot of it with a reference
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "wavwrite.h"
+
+#include "IPlugBench.h"
+
+#if IPLUG_EDITOR && defined IGRAPHICS_HEADLESS
+  #include "IGraphics_include_in_plug_hdr.h"
+  #include "IControl.h"
+  #define BENCH_UI
+#endif
+
+using namespace iplug;
+
+#pragma mark - Allocation counting
+
+static std::atomic<bool> sCountAllocations{false};
+static std::atomic<uint64_t> sNumAllocations{0};
+static std::atomic<uint64_t> sAllocatedBytes{0};
+
+void* operator new(std::size_t size)
+{
+  if (sCountAllocations.load(std::memory_order_relaxed))
+  {
+    sNumAllocations.fetch_add(1, std::memory_order_relaxed);
+    sAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+  }
+
+  if (void* ptr = std::malloc(size ? size : 1))
+    return ptr;
+
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+#pragma mark - Input
+
+enum EBenchInput
+{
+  kInputNoise = 0,
+  kInputImpulse,
+  kInputSilence,
+  kInputFile
+};
+
+/** Reads 16, 24 or 32 bit integer or 32 bit float PCM WAV files into one buffer per channel */
+static bool ReadWavFile(const char* path, std::vector<std::vector<float>>& channels, int& sampleRate)
+{
+  FILE* pFile = fopen(path, "rb");
+
+  if (!pFile)
+    return false;
+
+  auto readU32 = [pFile](uint32_t& v) { uint8_t b[4]; if (fread(b, 1, 4, pFile) != 4) return false; v = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t) b[3] << 24); return true; };
+  auto readU16 = [pFile](uint16_t& v) { uint8_t b[2]; if (fread(b, 1, 2, pFile) != 2) return false; v = b[0] | (b[1] << 8); return true; };
+
+  char id[4];
+  uint32_t size = 0;
+  uint16_t format = 0, nChans = 0, bits = 0;
+  uint32_t rate = 0;
+  bool ok = fread(id, 1, 4, pFile) == 4 && !memcmp(id, "RIFF", 4) && readU32(size) && fread(id, 1, 4, pFile) == 4 && !memcmp(id, "WAVE", 4);
+
+  while (ok && fread(id, 1, 4, pFile) == 4 && readU32(size))
+  {
+    if (!memcmp(id, "fmt ", 4))
+    {
+      uint32_t byteRate;
+      uint16_t blockAlign;
+      ok = readU16(format) && readU16(nChans) && readU32(rate) && readU32(byteRate) && readU16(blockAlign) && readU16(bits);
+
+      if (ok && format == 0xFFFE && size >= 40) // WAVE_FORMAT_EXTENSIBLE, the sub format is the first two bytes of the GUID
+      {
+        uint16_t cbSize, validBits, subFormat;
+        uint32_t channelMask;
+        ok = readU16(cbSize) && readU16(validBits) && readU32(channelMask) && readU16(subFormat);
+        format = subFormat;
+        fseek(pFile, size - 26, SEEK_CUR);
+      }
+      else
+        fseek(pFile, size - 16, SEEK_CUR);
+    }
+    else if (!memcmp(id, "data", 4))
+    {
+      const bool isFloat = format == 3 && bits == 32;
+
+      if (!nChans || !(format == 1 || isFloat) || !(bits == 16 || bits == 24 || bits == 32))
+        break;
+
+      const int bytesPerSample = bits / 8;
+      const int nFrames = size / (bytesPerSample * nChans);
+      std::vector<uint8_t> data(size);
+      ok = fread(data.data(), 1, size, pFile) == size;
+      channels.assign(nChans, std::vector<float>(nFrames));
+
+      for (auto s = 0; ok && s < nFrames; s++)
+      {
+        for (auto c = 0; c < nChans; c++)
+        {
+          const uint8_t* p = data.data() + (s * nChans + c) * bytesPerSample;
+          float v;
+
+          if (isFloat)
+            memcpy(&v, p, 4);
+          else if (bits == 16)
+            v = (int16_t) (p[0] | (p[1] << 8)) / 32768.f;
+          else if (bits == 24)
+            v = (int32_t) ((p[0] << 8) | (p[1] << 16) | ((uint32_t) p[2] << 24)) / 2147483648.f;
+          else
+            v = (int32_t) (p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24)) / 2147483648.f;
+
+          channels[c][s] = v;
+        }
+      }
+
+      sampleRate = static_cast<int>(rate);
+      fclose(pFile);
+      return ok && nFrames > 0;
+    }
+    else
+      fseek(pFile, size + (size & 1), SEEK_CUR);
+  }
+
+  fclose(pFile);
+  return false;
+}
+
+#ifdef BENCH_UI
+#pragma mark - UI
+
+using namespace igraphics;
+
+/** Opens the plug-in's UI without a window, writes or checks a screenshot of its first frame, then drags each control that takes the mouse
+ * in turn, drawing and timing a frame after every mouse event
+ * @return The exit code, which is 1 if the screenshot differs from the reference */
+static int RunUIBench(IPlugBench& plug, int nFrames, const char* screenshotPath, const char* referencePath, int tolerance)
+{
+  plug.OpenWindow(nullptr);
+  IGraphicsHeadless* pGraphics = static_cast<IGraphicsHeadless*>(plug.GetUI());
+
+  if (!pGraphics)
+  {
+    fprintf(stderr, "The plug-in has no IGraphics UI\n");
+    return 1;
+  }
+
+  pGraphics->DrawAll();
+  printf("%s UI, %s, %i x %i, first frame %.2f ms\n", plug.GetPluginName(), pGraphics->GetDrawingAPIStr(), pGraphics->Width(), pGraphics->Height(), pGraphics->GetLastDrawTime());
+
+  int result = 0;
+  WDL_TypedBuf<uint8_t> image;
+  int width, height;
+  pGraphics->GetImage(image, width, height);
+
+  if (screenshotPath && !IGraphicsHeadless::WriteImage(screenshotPath, image, width, height))
+  {
+    fprintf(stderr, "Could not write %s\n", screenshotPath);
+    result = 1;
+  }
+
+  if (referencePath)
+  {
+    WDL_TypedBuf<uint8_t> reference;
+    int refWidth, refHeight;
+
+    if (!IGraphicsHeadless::ReadImage(referencePath, reference, refWidth, refHeight))
+    {
+      fprintf(stderr, "Could not read %s\n", referencePath);
+      result = 1;
+    }
+    else if (refWidth != width || refHeight != height)
+    {
+      printf("screenshot is %i x %i pixels, but %s is %i x %i\n", width, height, referencePath, refWidth, refHeight);
+      result = 1;
+    }
+    else
+    {
+      const int nDiffering = IGraphicsHeadless::CompareImages(image, reference, width, height, tolerance);
+      printf("%i of %i pixels differ from %s by more than %i\n", nDiffering, width * height, referencePath, tolerance);
+      result = nDiffering ? 1 : 0;
+    }
+  }
+
+  std::vector<IControl*> controls;
+  pGraphics->ForStandardControlsFunc([&controls](IControl& control) {
+    if (!control.IsHidden() && !control.GetIgnoreMouse())
+      controls.push_back(&control);
+  });
+
+  if (nFrames > 0 && controls.size())
+  {
+    // each control is pressed, dragged up through its height and released
+    constexpr int kFramesPerControl = 8;
+    std::vector<double> frameTimes;
+    IMouseMod mod;
+    mod.L = true;
+
+    for (auto f = 0; f < nFrames; f++)
+    {
+      const IRECT bounds = controls[(f / kFramesPerControl) % controls.size()]->GetRECT();
+      const int step = f % kFramesPerControl;
+      const float dY = -bounds.H() / kFramesPerControl;
+      const float x = bounds.MW();
+      const float y = bounds.B - 1.f + dY * step;
+
+      if (step == 0)
+        pGraphics->OnMouseDown(x, y, mod);
+      else if (step == kFramesPerControl - 1)
+        pGraphics->OnMouseUp(x, y, mod);
+      else
+        pGraphics->OnMouseDrag(x, y, 0.f, dY, mod);
+
+      if (pGraphics->DrawFrame())
+        frameTimes.push_back(pGraphics->GetLastDrawTime());
+    }
+
+    if (frameTimes.size())
+    {
+      std::vector<double> sorted(frameTimes);
+      std::sort(sorted.begin(), sorted.end());
+
+      auto percentile = [&sorted](double p) {
+        return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p / 100. * (sorted.size() - 1) + 0.5))];
+      };
+
+      double total = 0.;
+
+      for (auto t : frameTimes)
+        total += t;
+
+      printf("drew %i of %i frames over %i controls\n", static_cast<int>(frameTimes.size()), nFrames, static_cast<int>(controls.size()));
+      printf("frame time (ms): mean %.3f  p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+             total / frameTimes.size(), percentile(50.), percentile(90.), percentile(99.), sorted.back());
+    }
+    else
+      printf("no frames were drawn, the controls did not respond to the mouse\n");
+  }
+
+  plug.CloseWindow();
+  return result;
+}
+#endif
+
+#pragma mark - Main
+
+static void PrintUsage(const char* name)
+{
+  printf("Usage: %s [options]\n"
+         "  --sr <rate>            sample rate (default 44100)\n"
+         "  --bs <frames>          block size (default 512)\n"
+         "  --seconds <s>          length of audio to render (default 10)\n"
+         "  --input <type>         noise, impulse, silence or a WAV file, which is looped (default noise)\n"
+         "  --preset <idx>         restore a factory preset\n"
+         "  --fxp <file>           load a program from an .fxp file\n"
+         "  --state <file>         load state saved by SerializeState()\n"
+         "  --note <pitch>         hold a MIDI note for the whole render, for instruments\n"
+         "  --warmup <blocks>      blocks to process before measuring (default 16)\n"
+         "  --output <file>        write the rendered audio to a 32 bit float WAV file\n", name);
+#ifdef BENCH_UI
+  printf("UI, instead of rendering audio:\n"
+         "  --ui-frames <n>        drag each control in turn, timing n frames\n"
+         "  --ui-screenshot <file> write the first frame to a PAM image\n"
+         "  --ui-reference <file>  compare the first frame with a PAM image, failing if they differ\n"
+         "  --ui-tolerance <n>     the largest channel difference for pixels to count as equal (default 2)\n");
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+  double sampleRate = 44100.;
+  int blockSize = 512;
+  double seconds = 10.;
+  int warmupBlocks = 16;
+  int preset = -1;
+  int note = -1;
+  EBenchInput inputType = kInputNoise;
+  const char* inputPath = nullptr;
+  const char* fxpPath = nullptr;
+  const char* statePath = nullptr;
+  const char* outputPath = nullptr;
+#ifdef BENCH_UI
+  bool benchUI = false;
+  int uiFrames = 0;
+  int uiTolerance = 2;
+  const char* uiScreenshotPath = nullptr;
+  const char* uiReferencePath = nullptr;
+#endif
+
+  for (auto i = 1; i < argc; i++)
+  {
+    const char* arg = argv[i];
+    const char* val = i + 1 < argc ? argv[i + 1] : nullptr;
+
+    if (!strcmp(arg, "--help") || !strcmp(arg, "-h"))
+    {
+      PrintUsage(argv[0]);
+      return 0;
+    }
+
+    if (!val)
+    {
+      fprintf(stderr, "Missing value for %s\n", arg);
+      PrintUsage(argv[0]);
+      return 1;
+    }
+
+    i++;
+
+    if (!strcmp(arg, "--sr")) sampleRate = atof(val);
+    else if (!strcmp(arg, "--bs")) blockSize = atoi(val);
+    else if (!strcmp(arg, "--seconds")) seconds = atof(val);
+    else if (!strcmp(arg, "--warmup")) warmupBlocks = std::max(atoi(val), 0);
+    else if (!strcmp(arg, "--preset")) preset = atoi(val);
+    else if (!strcmp(arg, "--note")) note = atoi(val);
+    else if (!strcmp(arg, "--fxp")) fxpPath = val;
+    else if (!strcmp(arg, "--state")) statePath = val;
+    else if (!strcmp(arg, "--output")) outputPath = val;
+#ifdef BENCH_UI
+    else if (!strcmp(arg, "--ui-frames")) { uiFrames = std::max(atoi(val), 0); benchUI = true; }
+    else if (!strcmp(arg, "--ui-screenshot")) { uiScreenshotPath = val; benchUI = true; }
+    else if (!strcmp(arg, "--ui-reference")) { uiReferencePath = val; benchUI = true; }
+    else if (!strcmp(arg, "--ui-tolerance")) { uiTolerance = std::max(atoi(val), 0); benchUI = true; }
+#endif
+    else if (!strcmp(arg, "--input"))
+    {
+      if (!strcmp(val, "noise")) inputType = kInputNoise;
+      else if (!strcmp(val, "impulse")) inputType = kInputImpulse;
+      else if (!strcmp(val, "silence")) inputType = kInputSilence;
+      else { inputType = kInputFile; inputPath = val; }
+    }
+    else
+    {
+      fprintf(stderr, "Unknown option %s\n", arg);
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (sampleRate <= 0. || blockSize <= 0 || seconds <= 0.)
+  {
+    fprintf(stderr, "The sample rate, block size and length must be positive\n");
+    return 1;
+  }
+
+  std::vector<std::vector<float>> fileChannels;
+
+  if (inputType == kInputFile)
+  {
+    int fileSampleRate = 0;
+
+    if (!ReadWavFile(inputPath, fileChannels, fileSampleRate))
+    {
+      fprintf(stderr, "Could not read %s, it must be a 16, 24 or 32 bit PCM or 32 bit float WAV file\n", inputPath);
+      return 1;
+    }
+
+    if (fileSampleRate != static_cast<int>(sampleRate))
+      fprintf(stderr, "Warning: %s is %i Hz, but the render is at %g Hz. It is not resampled\n", inputPath, fileSampleRate, sampleRate);
+  }
+
+  std::unique_ptr<IPlugBench> pPlug(MakePlug(InstanceInfo()));
+
+  if (preset >= 0 && !pPlug->RestorePreset(preset))
+    fprintf(stderr, "Warning: could not restore preset %i\n", preset);
+
+  if (fxpPath && !pPlug->LoadProgramFromFXP(fxpPath))
+    fprintf(stderr, "Warning: could not load %s\n", fxpPath);
+
+  if (statePath && !pPlug->BenchLoadState(statePath))
+    fprintf(stderr, "Warning: could not load state from %s\n", statePath);
+
+#ifdef BENCH_UI
+  if (benchUI)
+    return RunUIBench(*pPlug, uiFrames, uiScreenshotPath, uiReferencePath, uiTolerance);
+#endif
+
+  const int nIn = pPlug->MaxNChannels(ERoute::kInput);
+  const int nOut = pPlug->MaxNChannels(ERoute::kOutput);
+  const int64_t totalFrames = static_cast<int64_t>(seconds * sampleRate);
+  const int nBlocks = static_cast<int>((totalFrames + blockSize - 1) / blockSize);
+
+  std::vector<std::vector<sample>> inBufs(nIn, std::vector<sample>(blockSize, 0.));
+  std::vector<std::vector<sample>> outBufs(nOut, std::vector<sample>(blockSize, 0.));
+  std::vector<sample*> inPtrs(nIn), outPtrs(nOut);
+  std::vector<double> blockTimes(nBlocks);
+  std::vector<float> outputFrames;
+
+  for (auto c = 0; c < nIn; c++) inPtrs[c] = inBufs[c].data();
+  for (auto c = 0; c < nOut; c++) outPtrs[c] = outBufs[c].data();
+
+  if (outputPath)
+    outputFrames.reserve(static_cast<size_t>(totalFrames) * nOut);
+
+  uint32_t noiseState = 22222;
+  int64_t inputPos = 0;
+
+  // generating input is not part of the measurement
+  auto fillInput = [&](int nFrames) {
+    for (auto s = 0; s < nFrames; s++, inputPos++)
+    {
+      for (auto c = 0; c < nIn; c++)
+      {
+        sample v = 0.;
+
+        switch (inputType)
+        {
+          case kInputNoise:
+            noiseState = noiseState * 1664525u + 1013904223u;
+            v = static_cast<sample>(static_cast<int32_t>(noiseState) / 2147483648.);
+            break;
+          case kInputImpulse:
+            v = inputPos == 0 ? 1. : 0.;
+            break;
+          case kInputFile:
+          {
+            const std::vector<float>& ch = fileChannels[c % fileChannels.size()];
+            v = ch[inputPos % ch.size()];
+            break;
+          }
+          default:
+            break;
+        }
+
+        inBufs[c][s] = v;
+      }
+    }
+  };
+
+  pPlug->BenchPrepare(sampleRate, blockSize);
+
+  if (note >= 0)
+  {
+    IMidiMsg msg;
+    msg.MakeNoteOnMsg(note, 100, 0);
+    pPlug->BenchSendMidiMsg(msg);
+  }
+
+  // let the plug-in settle, e.g. allocate on its first block, before measuring
+  for (auto b = 0; b < warmupBlocks; b++)
+  {
+    for (auto c = 0; c < nIn; c++)
+      std::fill(inBufs[c].begin(), inBufs[c].end(), 0.);
+
+    pPlug->BenchProcess(inPtrs.data(), outPtrs.data(), blockSize);
+  }
+
+  double totalTime = 0.;
+  int64_t framesDone = 0;
+
+  sNumAllocations = 0;
+  sAllocatedBytes = 0;
+
+  for (auto b = 0; b < nBlocks; b++)
+  {
+    const int nFrames = static_cast<int>(std::min<int64_t>(blockSize, totalFrames - framesDone));
+    fillInput(nFrames);
+
+    sCountAllocations = true;
+    const auto startTime = std::chrono::steady_clock::now();
+    pPlug->BenchProcess(inPtrs.data(), outPtrs.data(), nFrames);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+    sCountAllocations = false;
+
+    blockTimes[b] = elapsed.count();
+    totalTime += elapsed.count();
+    framesDone += nFrames;
+
+    if (outputPath)
+    {
+      for (auto s = 0; s < nFrames; s++)
+        for (auto c = 0; c < nOut; c++)
+          outputFrames.push_back(static_cast<float>(outBufs[c][s]));
+    }
+  }
+
+  std::vector<double> sorted(blockTimes);
+  std::sort(sorted.begin(), sorted.end());
+
+  auto percentile = [&sorted](double p) {
+    const size_t idx = std::min(sorted.size() - 1, static_cast<size_t>(p / 100. * (sorted.size() - 1) + 0.5));
+    return sorted[idx] * 1e6;
+  };
+
+  const double budget = blockSize / sampleRate;
+  int deadlineMisses = 0;
+
+  for (auto t : blockTimes)
+    deadlineMisses += t >= budget;
+
+  WDL_String version;
+  pPlug->GetPluginVersionStr(version);
+
+  printf("%s %s, %i in / %i out, %g Hz, %i frame blocks (%.3f ms budget)\n", pPlug->GetPluginName(), version.Get(), nIn, nOut, sampleRate, blockSize, budget * 1e3);
+  printf("rendered %.3f s in %.3f s, real-time factor %.1fx\n", framesDone / sampleRate, totalTime, totalTime > 0. ? (framesDone / sampleRate) / totalTime : 0.);
+  printf("block time (us): mean %.1f  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+         totalTime / nBlocks * 1e6, percentile(50.), percentile(90.), percentile(99.), percentile(99.9), sorted.back() * 1e6);
+  printf("peak block load %.1f%%, deadline misses %i of %i blocks\n", sorted.back() / budget * 100., deadlineMisses, nBlocks);
+  printf("allocations while rendering: %llu (%llu bytes)\n", (unsigned long long) sNumAllocations.load(), (unsigned long long) sAllocatedBytes.load());
+
+  if (outputPath)
+  {
+    WaveWriter writer(outputPath, 32, nOut, static_cast<int>(sampleRate), 0);
+
+    if (writer.Status())
+      writer.WriteFloats(outputFrames.data(), static_cast<int>(outputFrames.size()));
+    else
+      fprintf(stderr, "Could not write %s\n", outputPath);
+  }
+
+  return 0;
+}
@@ -8,7 +8,13 @@
  ==============================================================================
  */
 
+#pragma once
+
+#include <cmath>
+#include <functional>
+
 #include "IPlugPlatform.h"
+#include "IPlugUtilities.h"
 
 BEGIN_IPLUG_NAMESPACE
 
@@ -269,7 +275,160 @@ public:
     mPrevOutput = (result * mLevel);
     return mPrevOutput;
   }
+
+  /** Process a block of the envelope. Equivalent to calling Process() for each sample, but each stage is rendered as a whole segment:
+  * idle and sustain are constant fills and the ramps are filled without per-sample branching, so the cost depends on the number of stage changes rather than the block size.
+  * The values match Process() to within rounding. The linear ramps are not accumulated sample by sample, so with T = float they can differ from Process() by around one step
+  * @param pOutput Buffer for nFrames envelope values
+  * @param nFrames The number of samples to render
+  * @param sustainLevel The sustain level, held for the whole block */
+  void ProcessBlock(T* pOutput, int nFrames, T sustainLevel = 0.)
+  {
+    auto s = 0;
+
+    while (s < nFrames)
+    {
+      const int remaining = nFrames - s;
+      int n = 0;
+
+      switch (mStage)
+      {
+        case kIdle:
+          n = FillConstant(pOutput + s, remaining, mEnvValue);
+          break;
+        case kSustain:
+          n = FillConstant(pOutput + s, remaining, sustainLevel);
+          break;
+        case kAttack:
+        {
+          const T incr = mAttackIncr * mScalar;
+          n = incr > 0. ? SegmentLength((ENV_VALUE_HIGH - mEnvValue) / incr, remaining) : 0;
+          FillLinear(pOutput + s, n, incr, 1., 0.);
+          break;
+        }
+        case kDecay:
+          n = SegmentLengthExp(1. - mDecayIncr * mScalar, remaining);
+          FillExp(pOutput + s, n, 1. - mDecayIncr * mScalar, 1. - sustainLevel, sustainLevel);
+          break;
+        case kRelease:
+          n = mReleaseIncr > 0. ? SegmentLengthExp(1. - mReleaseIncr * mScalar, remaining) : 0;
+          FillExp(pOutput + s, n, 1. - mReleaseIncr * mScalar, mReleaseLevel, 0.);
+          break;
+        case kReleasedToRetrigger:
+          n = SegmentLength((mEnvValue - ENV_VALUE_LOW) / mRetriggerReleaseIncr, remaining);
+          FillLinear(pOutput + s, n, -mRetriggerReleaseIncr, mReleaseLevel, 0.);
+          break;
+        case kReleasedToEndEarly:
+          n = SegmentLength((mEnvValue - ENV_VALUE_LOW) / mEarlyReleaseIncr, remaining);
+          FillLinear(pOutput + s, n, -mEarlyReleaseIncr, mReleaseLevel, 0.);
+          break;
+        default:
+          break;
+      }
+
+      // the sample that changes stage (or one a segment could not be sized for) goes through Process(), so the transitions are identical
+      if (n == 0)
+      {
+        pOutput[s] = Process(sustainLevel);
+        n = 1;
+      }
+
+      s += n;
+    }
+  }
+
 private:
+  /** @param nSteps How many steps the ramp can take before it reaches its threshold
+   * @return The number of samples that can be filled without a stage change, one short of the estimate so that rounding can't overshoot it */
+  static inline int SegmentLength(double nSteps, int remaining)
+  {
+    if (!(nSteps >= 2.))
+      return 0;
+
+    return static_cast<int>(std::min(std::floor(nSteps) - 1., static_cast<double>(remaining)));
+  }
+
+  /** SegmentLength() for a ramp multiplied by decay every sample, which ends below ENV_VALUE_LOW */
+  inline int SegmentLengthExp(double decay, int remaining) const
+  {
+    if (decay >= 1.) // never reaches the threshold
+      return remaining;
+
+    if (decay <= 0. || mEnvValue <= ENV_VALUE_LOW)
+      return 0;
+
+    return SegmentLength(std::log(ENV_VALUE_LOW / mEnvValue) / std::log(decay), remaining);
+  }
+
+  inline int FillConstant(T* pOutput, int nFrames, T result)
+  {
+    mPrevResult = result;
+    mPrevOutput = result * mLevel;
+
+    for (auto s = 0; s < nFrames; s++)
+      pOutput[s] = mPrevOutput;
+
+    return nFrames;
+  }
+
+  /** Fill a ramp where the envelope value changes by incr each sample, outputting (value * scale + offset) * level */
+  inline void FillLinear(T* pOutput, int nFrames, T incr, T scale, T offset)
+  {
+    if (nFrames == 0)
+      return;
+
+    const T start = mEnvValue;
+    const T level = mLevel;
+
+    for (auto s = 0; s < nFrames; s++)
+      pOutput[s] = ((start + (s + 1) * incr) * scale + offset) * level;
+
+    mEnvValue = start + nFrames * incr;
+    mPrevResult = mEnvValue * scale + offset;
+    mPrevOutput = pOutput[nFrames - 1];
+  }
+
+  /** Fill a ramp where the envelope value is multiplied by decay each sample, outputting (value * scale + offset) * level.
+   * The powers of decay are computed for kExpLanes samples at a time, so the inner loop has no dependency between samples */
+  inline void FillExp(T* pOutput, int nFrames, T decay, T scale, T offset)
+  {
+    static constexpr int kExpLanes = 8;
+
+    if (nFrames == 0)
+      return;
+
+    T powers[kExpLanes];
+    T power = 1.;
+
+    for (auto l = 0; l < kExpLanes; l++)
+    {
+      power *= decay;
+      powers[l] = power;
+    }
+
+    const T level = mLevel;
+    T value = mEnvValue;
+    auto s = 0;
+
+    for (; s + kExpLanes <= nFrames; s += kExpLanes)
+    {
+      for (auto l = 0; l < kExpLanes; l++)
+        pOutput[s + l] = ((value * powers[l]) * scale + offset) * level;
+
+      value *= powers[kExpLanes - 1];
+    }
+
+    for (; s < nFrames; s++)
+    {
+      value *= decay;
+      pOutput[s] = (value * scale + offset) * level;
+    }
+
+    mEnvValue = value;
+    mPrevResult = value * scale + offset;
+    mPrevOutput = pOutput[nFrames - 1];
+  }
+
   inline T CalcIncrFromTimeLinear(T timeMS, T sr) const
   {
     if (timeMS <= 0.) return 0.;
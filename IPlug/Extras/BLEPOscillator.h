@@ -0,0 +1,273 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc BLEPOscillator
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "IPlugPlatform.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+enum EBLEPWaveform
+{
+  kBLEPSaw = 0,
+  kBLEPPulse,
+  kBLEPTriangle,
+  kNumBLEPWaveforms
+};
+
+/** Band-limited sawtooth, pulse and triangle oscillators for up to NL voices at once, with pulse width modulation and hard sync.
+ * The naive waveforms are corrected around each discontinuity with a two sample polynomial residual, PolyBLEP for the steps of the
+ * sawtooth and pulse and PolyBLAMP for the corners of the triangle, which removes most of the aliasing at a fraction of the cost of
+ * oversampling. The discontinuities that hard sync and modulation create at any point in a sample are corrected the same way,
+ * so the output is delayed by one sample, in which the correction before each discontinuity is added.
+ * Like ModulatedSVF, each voice runs in its own lane and the lanes are stored contiguously. The inner loop over the lanes has no
+ * branches, so that it maps onto SIMD registers (choose NL to match: 4 doubles or 8 floats for AVX). Nothing allocates.
+ *
+ * \code
+ * // in a SynthVoiceBank, with one frequency buffer per lane
+ * mOsc.ProcessBlock(mOscOut, mFreqCPS, nullptr, nullptr, lanes.mNLanes, nFrames);
+ * \endcode
+ * @tparam T The sample type of the buffers and the oscillator state
+ * @tparam NL The number of lanes */
+template <typename T = double, int NL = 4>
+class BLEPOscillator
+{
+public:
+  BLEPOscillator(EBLEPWaveform waveform = kBLEPSaw)
+  : mWaveform(waveform)
+  {
+    Reset();
+  }
+
+  void SetWaveform(EBLEPWaveform waveform) { mWaveform = waveform; }
+
+  void SetSampleRate(double sampleRate) { mSampleRateReciprocal = static_cast<T>(1. / sampleRate); }
+
+  /** @param width The width used when ProcessBlock() is not given a pulse width for each sample, between 0. and 1.
+   * For the triangle it is the fraction of the cycle spent rising, so it morphs the triangle into a sawtooth towards either end */
+  void SetPulseWidth(double width) { mPulseWidth = static_cast<T>(width); }
+
+  /** Restart every lane at a phase */
+  void Reset(double phase = 0.)
+  {
+    for (auto l = 0; l < NL; l++)
+      Reset(l, phase);
+  }
+
+  /** Restart one lane, e.g. on a note on
+   * @param lane The lane, < NL
+   * @param phase The phase to start at, between 0. and 1. */
+  void Reset(int lane, double phase)
+  {
+    assert(lane >= 0 && lane < NL);
+
+    mPhase[lane] = static_cast<T>(phase - std::floor(phase));
+    mSyncPhase[lane] = 0.;
+
+    // the lane's first output sample is the one held back
+    Shape shape;
+    shape.Set(mWaveform, ClipWidth(mPulseWidth));
+    mHeld[lane] = shape.Value(mPhase[lane]);
+  }
+
+  /** Render a block for up to NL lanes
+   * @param outputs Output arrays, one per lane, overwritten
+   * @param freqCPS The frequency in Hz for each sample, one array per lane. Lanes may share an array
+   * @param pulseWidth The pulse width for each sample, one array per lane, or nullptr to use the width set with SetPulseWidth()
+   * @param syncFreqCPS The frequency in Hz of the oscillator each lane is hard synced to, for each sample, one array per lane, or nullptr for no sync.
+   * The sync source is run inside, so it need not be rendered to be heard
+   * @param nChans The number of lanes to process, <= NL. The other lanes keep their state
+   * @param nFrames The number of samples to render */
+  void ProcessBlock(T** outputs, const T* const* freqCPS, const T* const* pulseWidth, const T* const* syncFreqCPS, int nChans, int nFrames)
+  {
+    assert(nChans <= NL);
+
+    // each combination gets its own loop, so that the waveform and sync tests are not made per sample
+    switch (mWaveform)
+    {
+      case kBLEPSaw:
+        syncFreqCPS ? ProcessLanes<kBLEPSaw, true>(outputs, freqCPS, pulseWidth, syncFreqCPS, nChans, nFrames)
+                    : ProcessLanes<kBLEPSaw, false>(outputs, freqCPS, pulseWidth, syncFreqCPS, nChans, nFrames);
+        break;
+      case kBLEPPulse:
+        syncFreqCPS ? ProcessLanes<kBLEPPulse, true>(outputs, freqCPS, pulseWidth, syncFreqCPS, nChans, nFrames)
+                    : ProcessLanes<kBLEPPulse, false>(outputs, freqCPS, pulseWidth, syncFreqCPS, nChans, nFrames);
+        break;
+      case kBLEPTriangle:
+        syncFreqCPS ? ProcessLanes<kBLEPTriangle, true>(outputs, freqCPS, pulseWidth, syncFreqCPS, nChans, nFrames)
+                    : ProcessLanes<kBLEPTriangle, false>(outputs, freqCPS, pulseWidth, syncFreqCPS, nChans, nFrames);
+        break;
+      default:
+        break;
+    }
+  }
+
+private:
+  /** Every waveform is two line segments over the cycle, a + b * phase below the edge and c + d * phase from the edge on.
+   * The steps and the changes of slope at the edge and at the wrap are what the residuals correct */
+  struct Shape
+  {
+    T a, b, c, d, edge;
+
+    inline void Set(EBLEPWaveform waveform, T width)
+    {
+      switch (waveform)
+      {
+        case kBLEPSaw: // the edge is in the middle of one line
+          a = c = T(-1); b = d = T(2); edge = T(0.5);
+          break;
+        case kBLEPPulse:
+          a = T(1); c = T(-1); b = d = T(0); edge = width;
+          break;
+        case kBLEPTriangle: // rises from -1 to 1 at the edge, then falls back
+          a = T(-1); b = T(2) / width; d = T(-2) / (T(1) - width); c = T(1) - d * width; edge = width;
+          break;
+        default:
+          break;
+      }
+    }
+
+    inline T Value(T phase) const { return phase < edge ? a + b * phase : c + d * phase; }
+    inline T Slope(T phase) const { return phase < edge ? b : d; }
+    inline T EdgeStep() const { return (c - a) + (d - b) * edge; }
+    inline T EdgeSlopeChange() const { return d - b; }
+    inline T WrapStep() const { return a - (c + d); }
+    inline T WrapSlopeChange() const { return b - d; }
+  };
+
+  static inline T ClipWidth(T width) { return std::max(T(0.01), std::min(width, T(0.99))); }
+
+  /** Add the residuals of a discontinuity to the held sample and the current one, or nothing if it did not happen
+   * @param t The time from the discontinuity to the current sample, in samples between 0 and 1
+   * @param step The step in value
+   * @param slopeChange The change of slope, per sample */
+  static inline void AddResiduals(bool happened, T t, T step, T slopeChange, T& held, T& current)
+  {
+    t = happened ? std::max(T(0), std::min(t, T(1))) : T(0);
+    step = happened ? step : T(0);
+    slopeChange = happened ? slopeChange : T(0);
+
+    const T t2 = t * t;
+    const T u = T(1) - t;
+    const T u2 = u * u;
+    held += step * T(0.5) * t2 + slopeChange * (T(1) / T(6)) * t2 * t;
+    current += -step * T(0.5) * u2 + slopeChange * (T(1) / T(6)) * u2 * u;
+  }
+
+  /** Advance a phase, adding the residuals of the edge and the wrap if it passes them
+   * @param phase The start phase, between 0 and 1
+   * @param delta How far to advance, < 0.5
+   * @param tEnd The time from the end of the advance to the current sample, in samples
+   * @return The end phase, wrapped */
+  static inline T Advance(const Shape& shape, T phase, T delta, T tEnd, T incr, T recipIncr, T& held, T& current)
+  {
+    T end = phase + delta;
+
+    // at most one edge can be passed, before or after the wrap
+    const bool edgeBeforeWrap = phase < shape.edge && end >= shape.edge;
+    AddResiduals(edgeBeforeWrap, tEnd + (end - shape.edge) * recipIncr, shape.EdgeStep(), shape.EdgeSlopeChange() * incr, held, current);
+
+    const bool wrap = end >= T(1);
+    end = wrap ? end - T(1) : end;
+    AddResiduals(wrap, tEnd + end * recipIncr, shape.WrapStep(), shape.WrapSlopeChange() * incr, held, current);
+
+    const bool edgeAfterWrap = wrap && end >= shape.edge;
+    AddResiduals(edgeAfterWrap, tEnd + (end - shape.edge) * recipIncr, shape.EdgeStep(), shape.EdgeSlopeChange() * incr, held, current);
+
+    return end;
+  }
+
+  template <EBLEPWaveform W, bool Sync>
+  void ProcessLanes(T** outputs, const T* const* freqCPS, const T* const* pulseWidth, const T* const* syncFreqCPS, int nChans, int nFrames)
+  {
+    const T sampleRateReciprocal = mSampleRateReciprocal;
+
+    // the state is kept in locals while processing, as the compiler can't tell that members don't alias the buffers
+    T phase[NL], syncPhase[NL], held[NL];
+    std::copy(mPhase, mPhase + NL, phase);
+    std::copy(mSyncPhase, mSyncPhase + NL, syncPhase);
+    std::copy(mHeld, mHeld + NL, held);
+
+    // padding lanes run at zero frequency, so their state doesn't change
+    T freq[NL] = {};
+    T syncFreq[NL] = {};
+    T width[NL];
+    std::fill(width, width + NL, ClipWidth(mPulseWidth));
+
+    for (auto s = 0; s < nFrames; s++)
+    {
+      for (auto l = 0; l < nChans; l++)
+      {
+        freq[l] = freqCPS[l][s];
+        width[l] = pulseWidth ? ClipWidth(pulseWidth[l][s]) : width[l];
+        syncFreq[l] = Sync ? syncFreqCPS[l][s] : T(0);
+      }
+
+      T out[NL];
+
+      for (auto l = 0; l < NL; l++)
+      {
+        Shape shape;
+        shape.Set(W, width[l]);
+
+        const T incr = std::max(T(0), std::min(freq[l] * sampleRateReciprocal, T(0.5)));
+        const T recipIncr = T(1) / std::max(incr, T(1e-9));
+        T heldSample = held[l];
+        T current = T(0);
+
+        if (Sync)
+        {
+          const T syncIncr = std::max(T(0), std::min(syncFreq[l] * sampleRateReciprocal, T(0.5)));
+          T sp = syncPhase[l] + syncIncr;
+          const bool reset = sp >= T(1);
+          sp = reset ? sp - T(1) : sp;
+          syncPhase[l] = sp;
+
+          // the time since the sync source wrapped, 0 if it didn't, so the second advance is empty
+          const T tReset = reset ? sp / std::max(syncIncr, T(1e-9)) : T(0);
+
+          const T resetPhase = Advance(shape, phase[l], incr * (T(1) - tReset), tReset, incr, recipIncr, heldSample, current);
+          AddResiduals(reset, tReset, shape.Value(T(0)) - shape.Value(resetPhase), (shape.Slope(T(0)) - shape.Slope(resetPhase)) * incr, heldSample, current);
+          phase[l] = Advance(shape, reset ? T(0) : resetPhase, incr * tReset, T(0), incr, recipIncr, heldSample, current);
+        }
+        else
+          phase[l] = Advance(shape, phase[l], incr, T(0), incr, recipIncr, heldSample, current);
+
+        out[l] = heldSample;
+        held[l] = shape.Value(phase[l]) + current;
+      }
+
+      for (auto l = 0; l < nChans; l++)
+        outputs[l][s] = out[l];
+    }
+
+    std::copy(phase, phase + NL, mPhase);
+    std::copy(syncPhase, syncPhase + NL, mSyncPhase);
+    std::copy(held, held + NL, mHeld);
+  }
+
+  EBLEPWaveform mWaveform;
+  T mPulseWidth = T(0.5);
+  T mSampleRateReciprocal = T(1. / 44100.);
+  T mPhase[NL];
+  T mSyncPhase[NL];
+  T mHeld[NL]; // the last sample, which still gets the residuals of discontinuities just after it
+};
+
+END_IPLUG_NAMESPACE
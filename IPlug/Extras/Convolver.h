@@ -0,0 +1,565 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc Convolver
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "IPlugPlatform.h"
+#include "IPlugWorkerPool.h"
+
+#include "fft.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** An impulse response split into partitions for Convolver, and transformed. Once created it is never modified,
+ * so one ConvolverIR can be shared by any number of Convolvers, e.g. every instance of a plug-in that loads the same file, see GetShared().
+ *
+ * The first headSize samples are kept as they are, for a zero latency direct convolution. The rest is split into stages of uniform partitions,
+ * each stage with partitions four times the size of the last, up to maxPartitionSize. Stage s starts at an offset of twice its partition size,
+ * which leaves each block of a stage one block's worth of time to be computed in the background. Needs WDL/fft.c in the project */
+class ConvolverIR final
+{
+public:
+  /** One stage of uniform partitions */
+  struct Stage
+  {
+    int size; // the partition size, a power of two
+    int offset; // the offset of the stage's first partition in the impulse response
+    int nParts; // the number of partitions
+  };
+
+  /** Transform an impulse response. Slow for long responses, so call it on a background thread, e.g. from an IResourceSwap build function
+   * @param pChannels The channels of the response
+   * @param nChans The number of channels. Convolver channel c uses response channel c % nChans
+   * @param length The length of the response in samples
+   * @param headSize The size of the direct convolution head, and the smallest partition size, a power of two. Larger sizes are cheaper but the head costs headSize multiply-adds per sample
+   * @param maxPartitionSize The largest partition size, a power of two of at most 16384. Larger sizes are cheaper, but give the workers longer jobs */
+  template <typename T>
+  static std::shared_ptr<const ConvolverIR> Create(const T* const* pChannels, int nChans, int length, int headSize = 64, int maxPartitionSize = 16384)
+  {
+    InitFFT();
+
+    std::shared_ptr<ConvolverIR> pIR(new ConvolverIR);
+    pIR->mNChans = nChans;
+    pIR->mLength = length;
+    pIR->mHeadSize = headSize;
+    maxPartitionSize = std::min(std::max(maxPartitionSize, headSize), 16384);
+
+    for (int offset = headSize, size = headSize; offset < length;)
+    {
+      const int nextSize = std::min(size * 4, maxPartitionSize);
+      const int end = nextSize > size ? std::min(nextSize * 2, length) : length;
+      const int nParts = (end - offset + size - 1) / size;
+      pIR->mStages.push_back({size, offset, nParts});
+      offset += nParts * size;
+      size = nextSize;
+    }
+
+    pIR->mHead.resize(nChans);
+    pIR->mSpectra.resize(pIR->mStages.size());
+
+    for (int c = 0; c < nChans; c++)
+    {
+      // reversed, so that the head is an inner product over the input history
+      std::vector<WDL_FFT_REAL>& head = pIR->mHead[c];
+      head.assign(headSize, 0.);
+
+      for (int i = 0; i < std::min(headSize, length); i++)
+        head[headSize - 1 - i] = static_cast<WDL_FFT_REAL>(pChannels[c][i]);
+    }
+
+    for (size_t s = 0; s < pIR->mStages.size(); s++)
+    {
+      const Stage& stage = pIR->mStages[s];
+      const int fftSize = stage.size * 2;
+      const WDL_FFT_REAL scale = static_cast<WDL_FFT_REAL>(0.25 / fftSize); // the round trip through WDL_real_fft() and the product gains 4 * fftSize
+      pIR->mSpectra[s].resize(nChans);
+
+      for (int c = 0; c < nChans; c++)
+      {
+        std::vector<WDL_FFT_REAL>& spectra = pIR->mSpectra[s][c];
+        spectra.assign(static_cast<size_t>(stage.nParts) * fftSize, 0.);
+
+        for (int p = 0; p < stage.nParts; p++)
+        {
+          WDL_FFT_REAL* pPart = spectra.data() + static_cast<size_t>(p) * fftSize;
+          const int start = stage.offset + p * stage.size;
+          const int n = std::min(stage.size, length - start);
+
+          for (int i = 0; i < n; i++)
+            pPart[i] = static_cast<WDL_FFT_REAL>(pChannels[c][start + i]) * scale;
+
+          WDL_real_fft(pPart, fftSize, 0);
+        }
+      }
+    }
+
+    return pIR;
+  }
+
+  /** Get a response from a cache shared by every Convolver in the process, creating it if it isn't there. The cache only holds the responses that are in use.
+   * Creation is serialized, so when many instances ask for the same response at once, it is only created once
+   * @param key Identifies the response, e.g. its file path, sample rate and partitioning
+   * @param create Called to create the response if it isn't cached */
+  static std::shared_ptr<const ConvolverIR> GetShared(const char* key, const std::function<std::shared_ptr<const ConvolverIR>()>& create)
+  {
+    static std::mutex sMutex;
+    static std::map<std::string, std::weak_ptr<const ConvolverIR>> sCache;
+
+    std::lock_guard<std::mutex> lock(sMutex);
+    std::weak_ptr<const ConvolverIR>& cached = sCache[key];
+    std::shared_ptr<const ConvolverIR> pIR = cached.lock();
+
+    if (!pIR)
+    {
+      pIR = create();
+      cached = pIR;
+    }
+
+    // forget the responses nobody is using any more
+    for (auto it = sCache.begin(); it != sCache.end();)
+      it = it->second.expired() ? sCache.erase(it) : std::next(it);
+
+    return pIR;
+  }
+
+  static void InitFFT()
+  {
+    static std::once_flag sOnce;
+    std::call_once(sOnce, []() { WDL_fft_init(); });
+  }
+
+  int NChans() const { return mNChans; }
+  int GetLength() const { return mLength; }
+  int GetHeadSize() const { return mHeadSize; }
+  int NStages() const { return static_cast<int>(mStages.size()); }
+  const Stage& GetStage(int stageIdx) const { return mStages[stageIdx]; }
+
+  /** @return The head of a channel, reversed */
+  const WDL_FFT_REAL* GetHead(int chan) const { return mHead[chan % mNChans].data(); }
+
+  /** @return The transformed partitions of a stage and channel, each twice the partition size */
+  const WDL_FFT_REAL* GetSpectra(int stageIdx, int chan) const { return mSpectra[stageIdx][chan % mNChans].data(); }
+
+  /** @return The size of the response in bytes */
+  size_t GetMemoryUsage() const
+  {
+    size_t size = 0;
+
+    for (auto& head : mHead)
+      size += head.size() * sizeof(WDL_FFT_REAL);
+
+    for (auto& stage : mSpectra)
+    {
+      for (auto& spectra : stage)
+        size += spectra.size() * sizeof(WDL_FFT_REAL);
+    }
+
+    return size;
+  }
+
+private:
+  ConvolverIR() = default;
+
+  int mNChans = 0;
+  int mLength = 0;
+  int mHeadSize = 0;
+  std::vector<Stage> mStages;
+  std::vector<std::vector<WDL_FFT_REAL>> mHead;
+  std::vector<std::vector<std::vector<WDL_FFT_REAL>>> mSpectra; // stage, channel
+};
+
+/** The state of one stage of a Convolver, which the audio thread and the workers take turns to run. Blocks are scheduled by the audio thread,
+ * and run in order by whoever claims the stage */
+class ConvolverStage final : public IWorkerJob
+{
+public:
+  ConvolverStage(const ConvolverIR& ir, int stageIdx, int nChans, const WDL_FFT_REAL* pInput, uint64_t inputMask, int inputSize)
+  : mIR(ir)
+  , mStageIdx(stageIdx)
+  , mStage(ir.GetStage(stageIdx))
+  , mNChans(nChans)
+  , mInput(pInput)
+  , mInputMask(inputMask)
+  , mInputSize(inputSize)
+  {
+    int outputSize = 1;
+
+    while (outputSize < mStage.offset + mStage.size * 2)
+      outputSize *= 2;
+
+    mOutputMask = outputSize - 1;
+    mOutputSize = outputSize;
+    mFDL.assign(static_cast<size_t>(nChans) * mStage.nParts * mStage.size * 2, 0.);
+    mOutput.assign(static_cast<size_t>(nChans) * outputSize, 0.);
+    mAccumulator.assign(mStage.size * 2, 0.);
+  }
+
+  ConvolverStage(const ConvolverStage&) = delete;
+  ConvolverStage& operator=(const ConvolverStage&) = delete;
+
+  int GetSize() const { return mStage.size; }
+  int GetOffset() const { return mStage.offset; }
+
+  /** @return The output of a channel at a sample position */
+  WDL_FFT_REAL GetOutput(int chan, int64_t pos) const { return mOutput[static_cast<size_t>(chan) * mOutputSize + (static_cast<uint64_t>(pos) & mOutputMask)]; }
+
+  bool HasWork() const { return mCompleted.load(std::memory_order_relaxed) < mScheduled.load(std::memory_order_acquire); }
+  bool TryClaim() { return !mBusy.load(std::memory_order_relaxed) && !mBusy.exchange(true, std::memory_order_acquire); }
+  void Release() { mBusy.store(false, std::memory_order_release); }
+  bool IsBusy() const { return mBusy.load(std::memory_order_acquire); }
+
+  /** Audio thread: make the blocks up to nBlocks available to run
+   * @param deadline When the output of the blocks is needed, see IWorkerPool::Now() */
+  void Schedule(int64_t nBlocks, int64_t deadline = kNoWork)
+  {
+    mDeadline.store(deadline, std::memory_order_relaxed);
+    mScheduled.store(nBlocks, std::memory_order_release);
+  }
+
+  int64_t GetDeadline() const override { return HasWork() && !IsBusy() ? mDeadline.load(std::memory_order_relaxed) : kNoWork; }
+
+  bool RunWork(int /*threadIdx*/) override
+  {
+    if (!HasWork() || !TryClaim())
+      return false;
+
+    RunPending();
+    Release();
+    return true;
+  }
+
+  /** Audio thread: wait until the first nBlocks have been run, running them if no worker has claimed the stage */
+  void Complete(int64_t nBlocks)
+  {
+    while (mCompleted.load(std::memory_order_acquire) < nBlocks)
+    {
+      if (TryClaim())
+      {
+        RunPending();
+        Release();
+      }
+    }
+  }
+
+  /** Run the scheduled blocks. Call only while the stage is claimed */
+  void RunPending()
+  {
+    int64_t block = mCompleted.load(std::memory_order_relaxed);
+
+    while (block < mScheduled.load(std::memory_order_acquire))
+    {
+      RunBlock(block);
+      mCompleted.store(++block, std::memory_order_release);
+    }
+  }
+
+  /** Clear the state and start again from position 0. Called with the stage claimed, and the audio thread not running */
+  void Reset()
+  {
+    mScheduled.store(0, std::memory_order_relaxed);
+    mCompleted.store(0, std::memory_order_relaxed);
+    std::fill(mFDL.begin(), mFDL.end(), 0.);
+    std::fill(mOutput.begin(), mOutput.end(), 0.);
+  }
+
+  size_t GetMemoryUsage() const { return (mFDL.size() + mOutput.size() + mAccumulator.size()) * sizeof(WDL_FFT_REAL); }
+
+private:
+  /** Overlap-save: transform the last two blocks of input, add it to the frequency domain delay line, multiply by the partitions and transform back */
+  void RunBlock(int64_t block)
+  {
+    const int size = mStage.size;
+    const int fftSize = size * 2;
+    const int nParts = mStage.nParts;
+    const int slot = static_cast<int>(block % nParts);
+    const int nUsed = static_cast<int>(std::min<int64_t>(nParts, block + 1));
+    const uint64_t start = static_cast<uint64_t>((block - 1) * size);
+
+    for (int c = 0; c < mNChans; c++)
+    {
+      const WDL_FFT_REAL* pInput = mInput + static_cast<size_t>(c) * mInputSize;
+      WDL_FFT_REAL* pFDL = mFDL.data() + static_cast<size_t>(c) * nParts * fftSize;
+      WDL_FFT_REAL* pSpectrum = pFDL + static_cast<size_t>(slot) * fftSize;
+
+      for (int i = 0; i < fftSize; i++)
+        pSpectrum[i] = pInput[(start + i) & mInputMask];
+
+      WDL_real_fft(pSpectrum, fftSize, 0);
+
+      const WDL_FFT_REAL* pParts = mIR.GetSpectra(mStageIdx, c);
+      WDL_FFT_REAL* pAcc = mAccumulator.data();
+      std::fill(mAccumulator.begin(), mAccumulator.end(), 0.);
+
+      for (int p = 0; p < nUsed; p++)
+      {
+        const int inputSlot = (slot - p + nParts) % nParts;
+        MultiplyAccumulate(pAcc, pFDL + static_cast<size_t>(inputSlot) * fftSize, pParts + static_cast<size_t>(p) * fftSize, size);
+      }
+
+      WDL_real_fft(pAcc, fftSize, 1);
+
+      WDL_FFT_REAL* pOutput = mOutput.data() + static_cast<size_t>(c) * mOutputSize;
+      const uint64_t outStart = static_cast<uint64_t>(block * size + mStage.offset);
+
+      for (int i = 0; i < size; i++)
+        pOutput[(outStart + i) & mOutputMask] = pAcc[size + i];
+    }
+  }
+
+  /** The spectra are packed as WDL_real_fft() leaves them: DC and Nyquist in the first pair, then complex bins */
+  static void MultiplyAccumulate(WDL_FFT_REAL* pAcc, const WDL_FFT_REAL* pA, const WDL_FFT_REAL* pB, int nBins)
+  {
+    pAcc[0] += pA[0] * pB[0];
+    pAcc[1] += pA[1] * pB[1];
+
+    for (int i = 2; i < nBins * 2; i += 2)
+    {
+      pAcc[i] += pA[i] * pB[i] - pA[i + 1] * pB[i + 1];
+      pAcc[i + 1] += pA[i] * pB[i + 1] + pA[i + 1] * pB[i];
+    }
+  }
+
+  const ConvolverIR& mIR;
+  const int mStageIdx;
+  const ConvolverIR::Stage mStage;
+  const int mNChans;
+  const WDL_FFT_REAL* mInput;
+  const uint64_t mInputMask;
+  const int mInputSize;
+  uint64_t mOutputMask;
+  int mOutputSize;
+
+  std::vector<WDL_FFT_REAL> mFDL; // channel, partition, spectrum
+  std::vector<WDL_FFT_REAL> mOutput; // channel, ring
+  std::vector<WDL_FFT_REAL> mAccumulator;
+
+  std::atomic<int64_t> mScheduled{0};
+  std::atomic<int64_t> mCompleted{0};
+  std::atomic<int64_t> mDeadline{kNoWork};
+  std::atomic<bool> mBusy{false};
+};
+
+/** A zero latency partitioned convolver for long impulse responses, that fits in ProcessBlock().
+ * The head of the response is convolved directly, its first stage of partitions on the audio thread, and the larger partitions on the IWorkerPool
+ * shared by all instances, each block with a deadline one block after it is scheduled. If a worker is late the audio thread runs the block itself,
+ * so the output never glitches, it just costs the audio thread more.
+ *
+ * The response can be shared between instances with ConvolverIR::GetShared(), and loaded in the background with IResourceSwap, which builds
+ * a new Convolver on its thread and can crossfade to it:
+ * @code
+ * // on any thread but the audio thread
+ * mConvolver.Load([path, nChans]() {
+ *   auto pIR = ConvolverIR::GetShared(path.Get(), [&]() { return LoadImpulseResponse(path.Get()); }); // returns ConvolverIR::Create(...)
+ *   return pIR ? std::make_unique<Convolver>(pIR, nChans) : nullptr;
+ * });
+ * // in ProcessBlock()
+ * mConvolver.Update();
+ * if (Convolver* pConvolver = mConvolver.Get())
+ *   pConvolver->ProcessBlock(inputs, outputs, nChans, nFrames);
+ * @endcode */
+class Convolver final
+{
+public:
+  /** Allocates everything the convolution needs, so call it on a background thread for long responses
+   * @param pIR The response
+   * @param nChans The number of channels to convolve
+   * @param useWorkers \c false to run every stage on the audio thread, e.g. when rendering offline
+   * @param sampleRate The sample rate, which gives the workers the deadlines of the blocks */
+  Convolver(std::shared_ptr<const ConvolverIR> pIR, int nChans, bool useWorkers = true, double sampleRate = 48000.)
+  : mIR(std::move(pIR))
+  , mSampleRate(sampleRate)
+  , mNChans(nChans)
+  , mHeadSize(mIR->GetHeadSize())
+  {
+    ConvolverIR::InitFFT();
+
+    int maxPartitionSize = mHeadSize;
+
+    for (int s = 0; s < mIR->NStages(); s++)
+      maxPartitionSize = std::max(maxPartitionSize, mIR->GetStage(s).size);
+
+    // a stage reads the two blocks before the one being written, so four blocks of the largest partition are enough
+    mInputSize = maxPartitionSize * 4;
+    mInputMask = mInputSize - 1;
+    mInput.assign(static_cast<size_t>(nChans) * mInputSize, 0.);
+    mHeadBuffer.assign(mHeadSize * 2, 0.);
+
+    for (int s = 0; s < mIR->NStages(); s++)
+      mStages.emplace_back(new ConvolverStage(*mIR, s, nChans, mInput.data(), mInputMask, mInputSize));
+
+    if (useWorkers && mStages.size() > 1)
+    {
+      mPool = IWorkerPool::Acquire();
+
+      for (size_t s = 1; s < mStages.size(); s++)
+        mPool->Register(mStages[s].get());
+    }
+  }
+
+  ~Convolver()
+  {
+    if (mPool)
+    {
+      for (size_t s = 1; s < mStages.size(); s++)
+        mPool->Unregister(mStages[s].get());
+    }
+  }
+
+  Convolver(const Convolver&) = delete;
+  Convolver& operator=(const Convolver&) = delete;
+
+  /** @return The response being convolved */
+  const ConvolverIR& GetIR() const { return *mIR; }
+
+  /** Clear the convolution's history, e.g. from OnReset(). Not realtime safe while workers may be running */
+  void Reset()
+  {
+    for (auto& pStage : mStages)
+    {
+      while (!pStage->TryClaim())
+        std::this_thread::yield();
+
+      pStage->Reset();
+      pStage->Release();
+    }
+
+    std::fill(mInput.begin(), mInput.end(), 0.);
+    mPos = 0;
+  }
+
+  /** Convolve a block. Call on the audio thread. Doesn't allocate or lock
+   * @param inputs The input channels, which may be the same buffers as the outputs
+   * @param outputs The output channels, which are overwritten with the convolution
+   * @param nChans The number of channels, no more than the number the Convolver was made for
+   * @param nFrames The number of frames */
+  template <typename T>
+  void ProcessBlock(T** inputs, T** outputs, int nChans, int nFrames)
+  {
+    nChans = std::min(nChans, mNChans);
+
+    for (int done = 0; done < nFrames;)
+    {
+      // chunks end at the head size, where blocks are scheduled
+      const int nChunk = std::min(nFrames - done, mHeadSize - static_cast<int>(mPos % mHeadSize));
+
+      for (size_t s = 1; s < mStages.size(); s++)
+      {
+        ConvolverStage& stage = *mStages[s];
+
+        if (mPos >= stage.GetOffset())
+          stage.Complete((mPos - stage.GetOffset()) / stage.GetSize() + 1);
+      }
+
+      for (int c = 0; c < nChans; c++)
+      {
+        WDL_FFT_REAL* pInput = mInput.data() + static_cast<size_t>(c) * mInputSize;
+        WDL_FFT_REAL* pHead = mHeadBuffer.data();
+        const WDL_FFT_REAL* pTaps = mIR->GetHead(c);
+
+        for (int i = 0; i < mHeadSize; i++)
+          pHead[i] = pInput[static_cast<uint64_t>(mPos - mHeadSize + i) & mInputMask];
+
+        for (int i = 0; i < nChunk; i++)
+        {
+          const WDL_FFT_REAL x = static_cast<WDL_FFT_REAL>(inputs[c][done + i]);
+          pHead[mHeadSize + i] = x;
+          pInput[static_cast<uint64_t>(mPos + i) & mInputMask] = x;
+        }
+
+        for (int i = 0; i < nChunk; i++)
+        {
+          const WDL_FFT_REAL* pHistory = pHead + i + 1;
+          WDL_FFT_REAL y = 0.;
+
+          for (int t = 0; t < mHeadSize; t++)
+            y += pTaps[t] * pHistory[t];
+
+          for (auto& pStage : mStages)
+            y += pStage->GetOutput(c, mPos + i);
+
+          outputs[c][done + i] = static_cast<T>(y);
+        }
+      }
+
+      done += nChunk;
+      mPos += nChunk;
+
+      if (mPos % mHeadSize == 0 && !mStages.empty())
+        ScheduleBlocks();
+    }
+  }
+
+  /** @return The size of the convolution state in bytes, not counting the shared response */
+  size_t GetMemoryUsage() const
+  {
+    size_t size = (mInput.size() + mHeadBuffer.size()) * sizeof(WDL_FFT_REAL);
+
+    for (auto& pStage : mStages)
+      size += pStage->GetMemoryUsage();
+
+    return size;
+  }
+
+private:
+  /** Called at each head size boundary: the first stage runs now, since its output is due straight away, and the others are handed to the workers */
+  void ScheduleBlocks()
+  {
+    bool notify = false;
+
+    for (size_t s = 0; s < mStages.size(); s++)
+    {
+      ConvolverStage& stage = *mStages[s];
+
+      if (mPos % stage.GetSize())
+        continue;
+
+      // the first block scheduled is added to the output a block from now
+      stage.Schedule(mPos / stage.GetSize(), s > 0 && mPool ? IWorkerPool::DeadlineIn(stage.GetSize() / mSampleRate) : IWorkerJob::kNoWork);
+
+      if (s == 0 || !mPool)
+        stage.Complete(mPos / stage.GetSize());
+      else
+        notify = true;
+    }
+
+    if (notify)
+      mPool->Notify();
+  }
+
+  std::shared_ptr<const ConvolverIR> mIR;
+  std::shared_ptr<IWorkerPool> mPool;
+  std::vector<std::unique_ptr<ConvolverStage>> mStages;
+  const double mSampleRate;
+  const int mNChans;
+  const int mHeadSize;
+  int mInputSize;
+  uint64_t mInputMask;
+  std::vector<WDL_FFT_REAL> mInput; // channel, ring
+  std::vector<WDL_FFT_REAL> mHeadBuffer;
+  int64_t mPos = 0;
+};
+
+END_IPLUG_NAMESPACE
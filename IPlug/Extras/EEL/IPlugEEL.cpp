@@ -0,0 +1,374 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#include "IPlugEEL.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+
+#include "mutex.h"
+#include "eel2/ns-eel.h"
+#include "eel2/ns-eel-addfuncs.h"
+
+using namespace iplug;
+
+static_assert(std::is_same<EEL_F, double>::value, "EELScript needs EEL_F_SIZE 8");
+
+#ifndef IPLUG_EEL_NO_HOSTSTUBS
+static WDL_Mutex sEELMutex;
+
+void NSEEL_HOSTSTUB_EnterMutex() { sEELMutex.Enter(); }
+void NSEEL_HOSTSTUB_LeaveMutex() { sEELMutex.Leave(); }
+#endif
+
+struct EELScript::Program
+{
+  ~Program()
+  {
+    for (NSEEL_CODEHANDLE code : {mInit, mBlock, mSample})
+    {
+      if (code)
+        NSEEL_code_free(code);
+    }
+
+    if (mVM)
+      NSEEL_VM_free(mVM);
+  }
+
+  NSEEL_VMCTX mVM = nullptr;
+  NSEEL_CODEHANDLE mInit = nullptr;
+  NSEEL_CODEHANDLE mBlock = nullptr;
+  NSEEL_CODEHANDLE mSample = nullptr;
+  EEL_F* mSampleRateVar = nullptr;
+  EEL_F* mSamplesBlockVar = nullptr;
+  std::vector<EEL_F*> mSplVars;
+  std::vector<EEL_F*> mParamVars; // one per binding
+  double mInitSampleRate = 0.; // the sample rate @init last ran at
+};
+
+// The functions scripts can call, which reach the EELScript through the VM's custom function this pointer
+struct EELScript::ScriptFunctions
+{
+  static EEL_F NSEEL_CGEN_CALL MidiRecv(void* opaque, INT_PTR np, EEL_F** parms)
+  {
+    EELScript* pScript = static_cast<EELScript*>(opaque);
+
+    if (!pScript || pScript->mMidiInPos >= pScript->mNMidiIn)
+      return 0.;
+
+    const IMidiMsg& msg = pScript->mMidiIn.Get()[pScript->mMidiInPos++];
+    *parms[0] = msg.mOffset;
+    *parms[1] = msg.mStatus;
+    *parms[2] = msg.mData1;
+    *parms[3] = msg.mData2;
+    return 1.;
+  }
+
+  static EEL_F NSEEL_CGEN_CALL MidiSend(void* opaque, INT_PTR np, EEL_F** parms)
+  {
+    EELScript* pScript = static_cast<EELScript*>(opaque);
+
+    if (!pScript || !pScript->mMidiSendFunc)
+      return 0.;
+
+    IMidiMsg msg(static_cast<int>(*parms[0]), static_cast<uint8_t>(*parms[1]), static_cast<uint8_t>(*parms[2]), static_cast<uint8_t>(*parms[3]));
+    pScript->mMidiSendFunc(msg);
+    return 1.;
+  }
+
+  static void Register()
+  {
+    static std::once_flag sOnce;
+    std::call_once(sOnce, []() {
+      NSEEL_init();
+      NSEEL_addfunc_exparms("midirecv", 4, NSEEL_PProc_THIS, &MidiRecv);
+      NSEEL_addfunc_exparms("midisend", 4, NSEEL_PProc_THIS, &MidiSend);
+    });
+  }
+};
+
+EELScript::EELScript(int maxNChans, int maxNMidiMsgs)
+: mMaxNChans(maxNChans)
+{
+  ScriptFunctions::Register();
+  mMidiIn.Resize(maxNMidiMsgs);
+  mTimer = std::unique_ptr<SharedTimer>(Timer::CreateShared(std::bind(&EELScript::OnTimer, this, std::placeholders::_1), EEL_COMPILE_POLL_INTERVAL));
+}
+
+EELScript::~EELScript()
+{
+  mTimer->Stop();
+  CancelCompile();
+
+  // the audio thread has stopped using this
+  for (Program* pProgram : {mProgram, mNextProgram, mPendingProgram.load(), mRetiredProgram.load()})
+    delete pProgram;
+
+  NSEEL_VM_FreeGRAM(&mGRAM);
+}
+
+void EELScript::BindParam(const char* varName, int paramIdx)
+{
+  std::unique_ptr<Binding> pBinding(new Binding);
+  pBinding->mVarName = varName;
+  pBinding->mParamIdx = paramIdx;
+  mBindings.push_back(std::move(pBinding));
+}
+
+void EELScript::SetParamValue(int paramIdx, double value)
+{
+  for (auto& pBinding : mBindings)
+  {
+    if (pBinding->mParamIdx == paramIdx)
+      pBinding->mValue.store(value, std::memory_order_relaxed);
+  }
+}
+
+void EELScript::Compile(const char* code)
+{
+  CancelCompile();
+
+  mSource = code;
+  mCompileDone = false;
+
+  const double sampleRate = mSampleRate;
+
+  mCompileThread = std::thread([this, code = mSource, sampleRate]() {
+    mCompiledProgram = CreateProgram(code, sampleRate, mCompiledError);
+    mCompileDone = true;
+  });
+}
+
+void EELScript::CancelCompile()
+{
+  // a compile can't be interrupted, its result is dropped
+  if (mCompileThread.joinable())
+    mCompileThread.join();
+
+  delete mCompiledProgram;
+  mCompiledProgram = nullptr;
+  mCompileDone = false;
+}
+
+EELScript::Program* EELScript::CreateProgram(const std::string& code, double sampleRate, std::string& error)
+{
+  std::unique_ptr<Program> pProgram(new Program);
+  pProgram->mVM = NSEEL_VM_alloc();
+
+  if (!pProgram->mVM)
+  {
+    error = "Could not allocate an EEL2 VM";
+    return nullptr;
+  }
+
+  NSEEL_VM_SetCustomFuncThis(pProgram->mVM, this);
+  NSEEL_VM_SetGRAM(pProgram->mVM, &mGRAM);
+
+  // registered before compiling, so that the code refers to these variables
+  pProgram->mSampleRateVar = NSEEL_VM_regvar(pProgram->mVM, "srate");
+  pProgram->mSamplesBlockVar = NSEEL_VM_regvar(pProgram->mVM, "samplesblock");
+
+  for (auto c = 0; c < mMaxNChans; c++)
+  {
+    const std::string name = "spl" + std::to_string(c);
+    pProgram->mSplVars.push_back(NSEEL_VM_regvar(pProgram->mVM, name.c_str()));
+  }
+
+  for (auto& pBinding : mBindings)
+  {
+    EEL_F* pVar = NSEEL_VM_regvar(pProgram->mVM, pBinding->mVarName.c_str());
+    *pVar = pBinding->mValue.load(std::memory_order_relaxed);
+    pProgram->mParamVars.push_back(pVar);
+  }
+
+  // split the script into its sections, keeping the line numbers for error messages
+  std::string sections[3];
+  int sectionLines[3] = {};
+  std::string* pSection = &sections[0];
+  size_t start = 0;
+  int line = 0;
+
+  while (start <= code.size())
+  {
+    size_t end = code.find('\n', start);
+
+    if (end == std::string::npos)
+      end = code.size();
+
+    const std::string text = code.substr(start, end - start);
+
+    if (text.compare(0, 5, "@init") == 0 || text.compare(0, 6, "@block") == 0 || text.compare(0, 7, "@sample") == 0)
+    {
+      const int idx = text[1] == 'i' ? 0 : text[1] == 'b' ? 1 : 2;
+      pSection = &sections[idx];
+      sectionLines[idx] = line + 1;
+      pSection->clear();
+    }
+    else
+    {
+      pSection->append(text);
+      pSection->append("\n");
+    }
+
+    start = end + 1;
+    line++;
+  }
+
+  NSEEL_CODEHANDLE* codes[3] = {&pProgram->mInit, &pProgram->mBlock, &pProgram->mSample};
+  const char* sectionNames[3] = {"@init", "@block", "@sample"};
+
+  for (auto i = 0; i < 3; i++)
+  {
+    if (sections[i].find_first_not_of(" \t\r\n") == std::string::npos)
+      continue;
+
+    *codes[i] = NSEEL_code_compile_ex(pProgram->mVM, sections[i].c_str(), sectionLines[i], 0);
+
+    if (!*codes[i])
+    {
+      const char* message = NSEEL_code_getcodeerror(pProgram->mVM);
+      error = std::string(sectionNames[i]) + ": " + (message ? message : "compile error");
+      return nullptr;
+    }
+  }
+
+  error.clear();
+
+  *pProgram->mSampleRateVar = sampleRate;
+  pProgram->mInitSampleRate = sampleRate;
+
+  if (pProgram->mInit)
+    NSEEL_code_execute(pProgram->mInit);
+
+  return pProgram.release();
+}
+
+void EELScript::OnTimer(Timer& timer)
+{
+  if (mCompileDone)
+  {
+    mCompileThread.join();
+    mCompileDone = false;
+
+    const bool success = mCompiledProgram != nullptr;
+    mCompileError = mCompiledError;
+
+    if (success)
+    {
+      // a program that was compiled but never swapped in is replaced
+      delete mNextProgram;
+      mNextProgram = mCompiledProgram;
+      mCompiledProgram = nullptr;
+    }
+    else
+      DBGMSG("EELScript: %s\n", mCompileError.c_str());
+
+    if (mCompileFunc)
+      mCompileFunc(success, mCompileError.c_str());
+  }
+
+  Program* pRetired = mRetiredProgram.load(std::memory_order_acquire);
+
+  if (pRetired)
+  {
+    delete pRetired;
+    mRetiredProgram.store(nullptr, std::memory_order_release);
+  }
+
+  if (mNextProgram && !mPendingProgram.load(std::memory_order_acquire))
+  {
+    mPendingProgram.store(mNextProgram, std::memory_order_release);
+    mNextProgram = nullptr;
+  }
+}
+
+void EELScript::ProcessMidiMsg(const IMidiMsg& msg)
+{
+  if (mNMidiIn < mMidiIn.GetSize())
+    mMidiIn.Get()[mNMidiIn++] = msg;
+}
+
+void EELScript::ProcessBlock(sample** inputs, sample** outputs, int nChans, int nFrames)
+{
+  assert(nChans <= mMaxNChans);
+
+  Program* pPending = mPendingProgram.load(std::memory_order_acquire);
+
+  if (pPending && !mRetiredProgram.load(std::memory_order_acquire))
+  {
+    mRetiredProgram.store(mProgram, std::memory_order_release);
+    mProgram = pPending;
+    mPendingProgram.store(nullptr, std::memory_order_release);
+  }
+
+  Program* pProgram = mProgram;
+
+  if (!pProgram)
+  {
+    for (auto c = 0; c < nChans; c++)
+    {
+      if (outputs[c] != inputs[c])
+        memcpy(outputs[c], inputs[c], nFrames * sizeof(sample));
+    }
+
+    mNMidiIn = 0;
+    return;
+  }
+
+  const double sampleRate = mSampleRate;
+
+  if (sampleRate != pProgram->mInitSampleRate)
+  {
+    *pProgram->mSampleRateVar = sampleRate;
+    pProgram->mInitSampleRate = sampleRate;
+
+    if (pProgram->mInit)
+      NSEEL_code_execute(pProgram->mInit);
+  }
+
+  const int nBound = std::min(static_cast<int>(pProgram->mParamVars.size()), static_cast<int>(mBindings.size()));
+
+  for (auto i = 0; i < nBound; i++)
+    *pProgram->mParamVars[i] = mBindings[i]->mValue.load(std::memory_order_relaxed);
+
+  *pProgram->mSamplesBlockVar = nFrames;
+  mMidiInPos = 0;
+
+  if (pProgram->mBlock)
+    NSEEL_code_execute(pProgram->mBlock);
+
+  EEL_F* const* pSpl = pProgram->mSplVars.data();
+
+  if (pProgram->mSample)
+  {
+    for (auto s = 0; s < nFrames; s++)
+    {
+      for (auto c = 0; c < nChans; c++)
+        *pSpl[c] = inputs[c][s];
+
+      NSEEL_code_execute(pProgram->mSample);
+
+      for (auto c = 0; c < nChans; c++)
+        outputs[c][s] = static_cast<sample>(*pSpl[c]);
+    }
+  }
+  else
+  {
+    for (auto c = 0; c < nChans; c++)
+    {
+      if (outputs[c] != inputs[c])
+        memcpy(outputs[c], inputs[c], nFrames * sizeof(sample));
+    }
+  }
+
+  mNMidiIn = 0;
+}
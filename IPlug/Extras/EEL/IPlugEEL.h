@@ -0,0 +1,179 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc EELScript
+ */
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "IPlugPlatform.h"
+#include "IPlugConstants.h"
+#include "IPlugMidi.h"
+#include "IPlugTimer.h"
+
+#include "heapbuf.h"
+#include "wdltypes.h"
+
+#ifndef EEL_COMPILE_POLL_INTERVAL
+  #define EEL_COMPILE_POLL_INTERVAL 100 //ms, how often to check whether a background compile has finished
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A DSP block whose processing is an EEL2 script, which the WDL EEL2 compiler turns into machine code, so that users can write waveshapers
+ * and MIDI processors that run at native speed. Like FaustGen, scripts are compiled on a background thread and the new program is swapped
+ * into the audio path at the start of a block without locking, while the previous one keeps running until then. If a script fails to compile,
+ * the previous program keeps running and the error is passed to the CompileFunc.
+ *
+ * Scripts are split into sections like JSFX: code after "@init" (or before any section) runs once after compiling and when the sample rate
+ * changes, "@block" runs at the start of each block and "@sample" runs for each sample. The variables are:
+ * - spl0, spl1... the sample of each channel, to read and overwrite in @sample
+ * - srate, the sample rate
+ * - samplesblock, the number of samples in the block
+ * - the variables bound to parameters with BindParam(), set before @block
+ *
+ * and midirecv(offset, msg1, msg2, msg3) returns 1 and sets its arguments to the next MIDI message of the block, or returns 0, and
+ * midisend(offset, msg1, msg2, msg3) sends a message through the MidiSendFunc. Each compile starts a new VM, so variables and mem[] start
+ * at zero again, but gmem[] is shared by the programs of an EELScript and keeps its contents. Memory a script touches for the first time
+ * in @block or @sample is allocated on the audio thread, so touch it in @init.
+ *
+ * Add WDL/eel2/nseel-caltab.c, nseel-cfunc.c, nseel-compiler.c, nseel-eval.c, nseel-lextab.c, nseel-ram.c and nseel-yylex.c to the project,
+ * and on x64 Windows or macOS the prebuilt asm-nseel-x64 object (on Linux, make it with "php a2x64.php elf64" or define EEL_TARGET_PORTABLE
+ * for the slower portable code generator). IPlugEEL.cpp defines NSEEL_HOSTSTUB_EnterMutex() and NSEEL_HOSTSTUB_LeaveMutex(),
+ * define IPLUG_EEL_NO_HOSTSTUBS if the project already does
+ * @code
+ * // in the constructor
+ * mScript.BindParam("drive", kDrive);
+ * mScript.Compile("@sample\n spl0 = tanh(spl0 * drive); spl1 = tanh(spl1 * drive);");
+ * // in OnReset()
+ * mScript.SetSampleRate(GetSampleRate());
+ * // in OnParamChange()
+ * mScript.SetParamValue(paramIdx, GetParam(paramIdx)->Value());
+ * // in ProcessBlock()
+ * mScript.ProcessBlock(inputs, outputs, NOutChansConnected(), nFrames);
+ * @endcode */
+class EELScript final
+{
+public:
+  /** Called on the main thread when a compile finishes
+   * @param success \c true if the new program is being swapped in
+   * @param error The compiler's error message, if it failed */
+  using CompileFunc = std::function<void(bool success, const char* error)>;
+
+  /** Called on the audio thread for each message a script sends with midisend() */
+  using MidiSendFunc = std::function<void(const IMidiMsg& msg)>;
+
+  /** @param maxNChans The most channels that will be processed, which is the number of splN variables
+   * @param maxNMidiMsgs The most MIDI messages a block can hand to the script with ProcessMidiMsg() */
+  EELScript(int maxNChans = 2, int maxNMidiMsgs = 1024);
+  ~EELScript();
+
+  EELScript(const EELScript&) = delete;
+  EELScript& operator=(const EELScript&) = delete;
+
+  /** Make a parameter's value available to scripts as a variable. Call on the main thread, before processing starts, and recompile to use the variable
+   * @param varName The name of the variable in the script
+   * @param paramIdx The parameter, which is passed to SetParamValue() */
+  void BindParam(const char* varName, int paramIdx);
+
+  /** Set the value of the variables bound to a parameter, from the start of the next block. Thread safe
+   * @param paramIdx The parameter
+   * @param value The value, typically the non-normalized IParam::Value() */
+  void SetParamValue(int paramIdx, double value);
+
+  /** Thread safe. The running program's @init section runs again at the start of the next block */
+  void SetSampleRate(double sampleRate) { mSampleRate = sampleRate; }
+
+  /** Start compiling a script on a worker thread. Call on the main thread. If a compile is in progress, this waits for it to finish first
+   * @param code The script */
+  void Compile(const char* code);
+
+  /** @return The last script passed to Compile() */
+  const char* GetSource() const { return mSource.c_str(); }
+
+  /** @return The error message of the last compile, or an empty string if it succeeded */
+  const char* GetCompileError() const { return mCompileError.c_str(); }
+
+  bool IsCompiling() const { return mCompileThread.joinable(); }
+
+  void SetCompileFunc(CompileFunc func) { mCompileFunc = std::move(func); }
+  void SetMidiSendFunc(MidiSendFunc func) { mMidiSendFunc = std::move(func); }
+
+  /** Queue a MIDI message for the script to read with midirecv() in the next block. Call on the audio thread, before ProcessBlock() */
+  void ProcessMidiMsg(const IMidiMsg& msg);
+
+  /** Run the script on a block. Without a program, e.g. before the first compile has finished, the inputs are copied to the outputs.
+   * Audio thread: swaps to a newly compiled program at the start of the block if one is waiting, without locking
+   * @param inputs Input channel arrays
+   * @param outputs Output channel arrays, can be the same as inputs
+   * @param nChans The number of channels, <= maxNChans
+   * @param nFrames The number of samples to process */
+  void ProcessBlock(sample** inputs, sample** outputs, int nChans, int nFrames);
+
+private:
+  struct Program;
+  struct ScriptFunctions;
+
+  struct Binding
+  {
+    std::string mVarName;
+    int mParamIdx;
+    std::atomic<double> mValue {0.};
+  };
+
+  /** Worker thread: compile the sections of a script into a new VM and run its @init section
+   * @return The program, or nullptr if it failed, in which case error is set */
+  Program* CreateProgram(const std::string& code, double sampleRate, std::string& error);
+
+  /** Main thread: install a finished compile, free the program the audio thread swapped out and queue the next one */
+  void OnTimer(Timer& timer);
+
+  void CancelCompile();
+
+  int mMaxNChans;
+  std::atomic<double> mSampleRate {DEFAULT_SAMPLE_RATE};
+  std::vector<std::unique_ptr<Binding>> mBindings;
+  void* mGRAM = nullptr; // gmem[], shared by this script's programs
+
+  std::string mSource;
+  std::string mCompileError;
+  CompileFunc mCompileFunc = nullptr;
+  MidiSendFunc mMidiSendFunc = nullptr;
+  std::unique_ptr<SharedTimer> mTimer;
+
+  // background compilation, the result is only read once mCompileDone is set
+  std::thread mCompileThread;
+  std::atomic<bool> mCompileDone {false};
+  Program* mCompiledProgram = nullptr;
+  std::string mCompiledError;
+
+  // The main thread only sets mPendingProgram when it is empty, the audio thread only takes it when mRetiredProgram is empty,
+  // stores the old program in mRetiredProgram and then clears mPendingProgram. Only the main thread deletes programs
+  Program* mProgram = nullptr; // audio thread only
+  Program* mNextProgram = nullptr; // main thread only, waiting for mPendingProgram to be free
+  std::atomic<Program*> mPendingProgram {nullptr};
+  std::atomic<Program*> mRetiredProgram {nullptr};
+
+  // audio thread only
+  WDL_TypedBuf<IMidiMsg> mMidiIn;
+  int mNMidiIn = 0;
+  int mMidiInPos = 0;
+};
+
+END_IPLUG_NAMESPACE
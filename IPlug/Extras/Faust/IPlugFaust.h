@@ -15,6 +15,7 @@
  * @copydoc IPlugFaust
  */
 
+#include <atomic>
 #include <memory>
 
 #include "faust/gui/UI.h"
@@ -68,6 +69,11 @@ public:
    * @param path The absolute path to process.svg for this instance. */
   virtual void GetDrawPath(WDL_String& path) {}
 
+  /** In FaustGen this recompiles DSP compiled with -vec so that its vector size matches the plug-in's block size.
+   * There is a NO-OP implementation here because a compiled C++ class uses the vector size it was generated with by CompileCPP()
+   * @param blockSize The maximum block size that will be passed to ProcessBlock() */
+  virtual void SetBlockSize(int blockSize) {}
+
   /** Call this method from FaustGen in order to execute a shell command and compile the C++ code against the IPlugFaust_arch architecture file
    * There is a NO-OP implementation here so that when not using the JIT compiler, the same class can be used interchangeably
    * @return \c true on success */
@@ -94,8 +100,10 @@ public:
     if(mOverSampler)
       multiplier = mOverSampler->GetRate();
     
+    mSampleRate = ((int) sampleRate) * multiplier;
+
     if (mDSP)
-      mDSP->init(((int) sampleRate) * multiplier);
+      mDSP->init((int) mSampleRate);
   }
 
   void ProcessMidiMsg(const IMidiMsg& msg)
@@ -131,8 +139,10 @@ public:
     {
       mParams.Get(paramIdx)->SetNormalized(normalizedValue);
     
-      if(mZones.GetSize() == NParams())
-        *(mZones.Get(paramIdx)) = mParams.Get(paramIdx)->Value();
+      WDL_PtrList<FAUSTFLOAT>* pZones = mDSPZones.load(std::memory_order_acquire);
+
+      if(pZones->GetSize() == NParams())
+        *(pZones->Get(paramIdx)) = mParams.Get(paramIdx)->Value();
       else
         DBGMSG("IPlugFaust-%s:: Missing zone for parameter %s\n", mName.Get(), mParams.Get(paramIdx)->GetNameForHost());
     }
@@ -146,8 +156,10 @@ public:
     
     mParams.Get(paramIdx)->Set(nonNormalizedValue);
 
-    if(mZones.GetSize() == NParams())
-      *(mZones.Get(paramIdx)) = nonNormalizedValue;
+    WDL_PtrList<FAUSTFLOAT>* pZones = mDSPZones.load(std::memory_order_acquire);
+
+    if(pZones->GetSize() == NParams())
+      *(pZones->Get(paramIdx)) = nonNormalizedValue;
     else
       DBGMSG("IPlugFaust-%s:: Missing zone for parameter %s\n", mName.Get(), mParams.Get(paramIdx)->GetNameForHost());
     }
@@ -320,10 +332,12 @@ protected:
   std::unique_ptr<::dsp> mDSP;
   std::unique_ptr<MidiUI> mMidiUI;
   WDL_PtrList<IParam> mParams;
-  WDL_PtrList<FAUSTFLOAT> mZones;
+  WDL_PtrList<FAUSTFLOAT> mZones; // filled by buildUserInterface()
+  std::atomic<WDL_PtrList<FAUSTFLOAT>*> mDSPZones{&mZones}; // the zones of mDSP, which parameter changes are written to. FaustGen swaps them together with the DSP
   WDL_StringKeyedArray<FAUSTFLOAT*> mMap; // map is used for setting FAUST parameters by name, also used to reconnect existing parameters
   int mIPlugParamStartIdx = -1; // if this is negative, it means there is no linking
   IPlugAPIBase* mPlug = nullptr;
+  double mSampleRate = 0.; // including oversampling, 0 until SetSampleRate() is called
   bool mInitialized = false;
 };
 
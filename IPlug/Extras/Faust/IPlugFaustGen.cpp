@@ -19,6 +19,11 @@
 #define LLVM_DSP
 #include "faust/dsp/poly-dsp.h"
 #include "fileread.h"
+#include "filewrite.h"
+#include "fnv64.h"
+
+#include <chrono>
+#include <functional>
 
 using namespace iplug;
 
@@ -28,6 +33,7 @@ bool FaustGen::sAutoRecompile = false;
 std::map<std::string, FaustGen::Factory *> FaustGen::Factory::sFactoryMap;
 std::list<GUI*> GUI::fGuiList;
 Timer* FaustGen::sTimer = nullptr;
+int FaustGen::sTimerTicks = 0;
 
 FaustGen::Factory::Factory(const char* name, const char* libraryPath, const char* drawPath, const char* inputDSP)
 {
@@ -45,6 +51,7 @@ FaustGen::Factory::Factory(const char* name, const char* libraryPath, const char
 
 FaustGen::Factory::~Factory()
 {
+  CancelBackgroundCompile();
   FreeDSPFactory();
   mSourceCodeStr.Set("");
   mBitCodeStr.Set("");
@@ -58,8 +65,16 @@ void FaustGen::Factory::FreeDSPFactory()
   for (auto inst : mInstances)
   {
     inst->FreeDSP();
+    inst->FreeSwapDSPs();
   }
 
+  for (auto pFactory : mRetiredFactories)
+  {
+    deleteDSPFactory(pFactory);
+  }
+
+  mRetiredFactories.clear();
+
   if(mLLVMFactory)
   {
     deleteDSPFactory(mLLVMFactory); // this is commented in faustgen~
@@ -67,6 +82,140 @@ void FaustGen::Factory::FreeDSPFactory()
   }
 }
 
+void FaustGen::Factory::StartBackgroundCompile()
+{
+  if (IsCompiling())
+    return;
+
+  WDL_String name;
+  name.SetFormatted(64, "FaustGen-%d", mInstanceIdx);
+
+  SetDefaultCompileOptions();
+  PrintCompileOptions();
+
+  // the worker thread gets its own copies, so that nothing it reads changes under it
+  std::string nameStr(name.Get());
+  std::string sourceCode(mSourceCodeStr.Get());
+  std::vector<std::string> compileOptions = mCompileOptions;
+  const int optimizationLevel = mOptimizationLevel;
+  const std::string cacheFile = GetCacheFilePath();
+
+  mCompiledFactory = nullptr;
+  mCompileError.clear();
+  mCompileDone = false;
+
+  mCompileThread = std::thread([this, nameStr, sourceCode, compileOptions, optimizationLevel, cacheFile]() {
+    // an edit that is undone, or a file that is touched but not changed, is in the cache already
+    mCompiledFactory = ReadCachedFactory(cacheFile);
+
+    if (mCompiledFactory)
+    {
+      mCompileDone = true;
+      return;
+    }
+
+    const char* argv[64];
+    const int N = (int) compileOptions.size();
+
+    assert(N < 64);
+
+    for (auto i = 0; i < N; i++)
+    {
+      argv[i] = compileOptions[i].c_str();
+    }
+
+    argv[N] = 0; // NULL terminated argv
+
+    std::string error;
+    mCompiledFactory = createDSPFactoryFromString(nameStr, sourceCode, N, argv, GetLLVMArchStr(), error, optimizationLevel);
+    mCompileError = error;
+
+    if (mCompiledFactory)
+      WriteCachedFactory(mCompiledFactory, cacheFile);
+
+    mCompileDone = true;
+  });
+}
+
+bool FaustGen::Factory::FinishBackgroundCompile()
+{
+  if (!IsCompiling() || !mCompileDone)
+    return false;
+
+  mCompileThread.join();
+
+  if (!mCompiledFactory)
+  {
+    DBGMSG("FaustGen-%s: Invalid Faust code or compile options, keeping the previous DSP : %s\n", mName.Get(), mCompileError.c_str());
+
+    if (!mLLVMFactory) // nothing to keep playing
+    {
+      for (auto inst : mInstances)
+      {
+        inst->SetErrored(true);
+      }
+    }
+
+    return false;
+  }
+
+  // DSPs made from the old factory may still be running, so it is deleted later by FreeRetired()
+  if (mLLVMFactory)
+    mRetiredFactories.push_back(mLLVMFactory);
+
+  mLLVMFactory = mCompiledFactory;
+  mCompiledFactory = nullptr;
+  mBitCodeStr.Set("");
+
+  for (auto inst : mInstances)
+  {
+    ::dsp* pDSP = CreateDSPInstance();
+    mNInputs = pDSP->getNumInputs();
+    mNOutputs = pDSP->getNumOutputs();
+    inst->InstallDSP(pDSP);
+    inst->SetErrored(false);
+  }
+
+  DBGMSG("FaustGen-%s: Background compilation succeeded, %i input(s), %i output(s)\n", mName.Get(), mNInputs, mNOutputs);
+
+  return true;
+}
+
+void FaustGen::Factory::CancelBackgroundCompile()
+{
+  if (!IsCompiling())
+    return;
+
+  mCompileThread.join();
+
+  if (mCompiledFactory)
+  {
+    deleteDSPFactory(mCompiledFactory);
+    mCompiledFactory = nullptr;
+  }
+}
+
+void FaustGen::Factory::FreeRetired()
+{
+  bool idle = true;
+
+  for (auto inst : mInstances)
+  {
+    if (!inst->FreeRetiredDSP())
+      idle = false;
+  }
+
+  if (idle)
+  {
+    for (auto pFactory : mRetiredFactories)
+    {
+      deleteDSPFactory(pFactory);
+    }
+
+    mRetiredFactories.clear();
+  }
+}
+
 llvm_dsp_factory* FaustGen::Factory::CreateFactoryFromBitCode()
 {
   //return readDSPFactoryFromBitCodeStr(mBitCodeStr.Get(), getTarget(), mOptimizationLevel);
@@ -113,7 +262,20 @@ llvm_dsp_factory *FaustGen::Factory::CreateFactoryFromSourceCode()
 
   argv[N] = 0; // NULL terminated argv
 
-  llvm_dsp_factory* pFactory = createDSPFactoryFromString(name.Get(), mSourceCodeStr.Get(), N, argv, GetLLVMArchStr(), error, mOptimizationLevel);
+  const std::string cacheFile = GetCacheFilePath();
+  llvm_dsp_factory* pFactory = ReadCachedFactory(cacheFile);
+
+  if (pFactory)
+  {
+    DBGMSG("FaustGen-%s: Loaded from cache %s\n", mName.Get(), cacheFile.c_str());
+  }
+  else
+  {
+    pFactory = createDSPFactoryFromString(name.Get(), mSourceCodeStr.Get(), N, argv, GetLLVMArchStr(), error, mOptimizationLevel);
+
+    if (pFactory)
+      WriteCachedFactory(pFactory, cacheFile);
+  }
 
   if (pFactory)
   {
@@ -260,9 +422,6 @@ void FaustGen::Factory::SetDefaultCompileOptions()
   // Clear and set default value
   mCompileOptions.clear();
 
-  if (sizeof(sample) == 8)
-    AddCompileOption("-double");
-
   // All library paths
   for (auto i = 0; i< mLibraryPaths.size(); i++)
   {
@@ -276,30 +435,82 @@ void FaustGen::Factory::SetDefaultCompileOptions()
     AddCompileOption("-O", mDrawPath.Get());
   }
 
-  // All options set in the 'compileoptions' message
-  for (auto c : mOptions)
+  // '-opt v' : parsed for LLVM optimization level
+  mOptimizationLevel = LLVM_OPTIMIZATION;
+
+  for (auto i = 0; i < mOptions.size(); i++)
   {
-    // '-opt v' : parsed for LLVM optimization level
-    if (c == "-opt")
-    {
-      mOptimizationLevel = atoi(c.c_str());
-    }
-    else
-    {
-      AddCompileOption(c.c_str());
-    }
+    if (mOptions[i] == "-opt" && i + 1 < mOptions.size())
+      mOptimizationLevel = atoi(mOptions[++i].c_str());
   }
 
-  // Vector mode by default
-  /*
-  AddCompileOption("-vec");
-  AddCompileOption("-lv");
-  AddCompileOption("1");
-  */
-  /*
-  Seems not necessary...
-  AddCompileOption("-vs", TOSTRING(GetBlockSize()));
-  */
+  std::vector<std::string> codeOptions;
+  GetCodeOptions(codeOptions);
+
+  for (auto& c : codeOptions)
+  {
+    AddCompileOption(c.c_str());
+  }
+}
+
+void FaustGen::Factory::GetCodeOptions(std::vector<std::string>& options) const
+{
+  options.clear();
+
+  // FAUSTFLOAT is sample, and the JIT compiled DSP's inputs and outputs are double with -double
+  if (sizeof(sample) == 8)
+    options.push_back("-double");
+
+  // All options set with SetCompileOptions(), apart from LLVM ones
+  for (auto i = 0; i < mOptions.size(); i++)
+  {
+    if (mOptions[i] == "-opt")
+      i++;
+    else if (mOptions[i] != "-double")
+      options.push_back(mOptions[i]);
+  }
+
+  if (IsAutoVectorSize())
+  {
+    options.push_back("-vs");
+    options.push_back(std::to_string(mBlockSize));
+  }
+}
+
+bool FaustGen::Factory::IsAutoVectorSize() const
+{
+  return std::find(mOptions.begin(), mOptions.end(), "-vec") != mOptions.end()
+      && std::find(mOptions.begin(), mOptions.end(), "-vs") == mOptions.end();
+}
+
+void FaustGen::Factory::RecompileInstances()
+{
+  // Delete the existing Faust module
+  CancelBackgroundCompile();
+  FreeDSPFactory();
+  mBitCodeStr.Set("");
+
+  // Update all instances
+  for (auto inst : mInstances)
+  {
+    inst->Init();
+  }
+}
+
+void FaustGen::Factory::SetBlockSize(int blockSize)
+{
+  blockSize = std::max(blockSize, 1);
+
+  if (blockSize == mBlockSize)
+    return;
+
+  mBlockSize = blockSize;
+
+  if (IsAutoVectorSize() && mLLVMFactory)
+  {
+    DBGMSG("FaustGen-%s: Block size changed, recompiling with -vs %i\n", mName.Get(), mBlockSize);
+    RecompileInstances();
+  }
 }
 
 void FaustGen::Factory::UpdateSourceCode(const char* str)
@@ -315,6 +526,7 @@ void FaustGen::Factory::UpdateSourceCode(const char* str)
     //    }
 
     // Delete the existing Faust module
+    CancelBackgroundCompile();
     FreeDSPFactory();
 
     mSourceCodeStr.Set(str);
@@ -334,6 +546,112 @@ void FaustGen::Factory::UpdateSourceCode(const char* str)
   }
 }
 
+std::string FaustGen::Factory::GetCacheFilePath() const
+{
+#ifdef FAUST_NO_CACHE
+  return "";
+#else
+  if (mDrawPath.GetLength()) // SVG files are generated by compiling, so always compile
+    return "";
+
+  WDL_String path;
+  AppSupportPath(path);
+
+  if (!path.GetLength())
+    return "";
+
+  path.Append(WDL_DIRCHAR_STR FAUST_CACHE_DIR_NAME);
+  MakeDirectory(path.Get()); // fails harmlessly if it exists
+
+  // anything that changes the generated code has to be part of the key
+  WDL_UINT64 hash = WDL_FNV64_IV;
+
+  auto addToHash = [&hash](const char* str) {
+    hash = WDL_FNV64(hash, (const unsigned char*) str, (int) strlen(str) + 1); // include the terminator, so that "ab" "c" differs from "a" "bc"
+  };
+
+  WDL_String optLevel;
+  optLevel.SetFormatted(32, "%d", mOptimizationLevel);
+
+  addToHash(getCLibFaustVersion());
+  addToHash(GetLLVMArchStr().c_str());
+  addToHash(optLevel.Get());
+
+  for (auto& option : mCompileOptions)
+  {
+    addToHash(option.c_str());
+  }
+
+  addToHash(mSourceCodeStr.Get());
+
+  path.AppendFormatted(64, WDL_DIRCHAR_STR "%016llx.fgc", (unsigned long long) hash);
+
+  return path.Get();
+#endif
+}
+
+//static
+llvm_dsp_factory* FaustGen::Factory::ReadCachedFactory(const std::string& cacheFile)
+{
+  if (cacheFile.empty())
+    return nullptr;
+
+  std::string machineCode;
+
+  {
+    WDL_FileRead infile(cacheFile.c_str());
+
+    if (!infile.IsOpen() || infile.GetSize() <= 0)
+      return nullptr;
+
+    machineCode.resize(static_cast<size_t>(infile.GetSize()));
+
+    if (infile.Read(&machineCode[0], static_cast<int>(machineCode.size())) != static_cast<int>(machineCode.size()))
+      return nullptr;
+  }
+
+  std::string error;
+  llvm_dsp_factory* pFactory = readDSPFactoryFromMachine(machineCode, GetLLVMArchStr(), error);
+
+  if (!pFactory)
+  {
+    DBGMSG("FaustGen: Removing unusable cache file %s : %s\n", cacheFile.c_str(), error.c_str());
+    remove(cacheFile.c_str());
+  }
+
+  return pFactory;
+}
+
+//static
+void FaustGen::Factory::WriteCachedFactory(llvm_dsp_factory* pFactory, const std::string& cacheFile)
+{
+  if (cacheFile.empty())
+    return;
+
+  const std::string machineCode = writeDSPFactoryToMachine(pFactory, GetLLVMArchStr());
+
+  if (machineCode.empty())
+    return;
+
+  // a name no other thread or process is likely to use, in case another instance is writing the same file
+  const unsigned long long uniqueID = std::hash<std::thread::id>()(std::this_thread::get_id()) ^ std::chrono::high_resolution_clock::now().time_since_epoch().count();
+  WDL_String tmpFile;
+  tmpFile.SetFormatted(MAX_WIN32_PATH_LEN, "%s.%llx.tmp", cacheFile.c_str(), uniqueID);
+
+  bool written = false;
+
+  {
+    WDL_FileWrite outfile(tmpFile.Get(), 0);
+
+    if (outfile.IsOpen())
+      written = outfile.Write(machineCode.data(), static_cast<int>(machineCode.size())) == static_cast<int>(machineCode.size());
+  }
+
+  // if another process got there first the rename fails on windows, but the file it wrote is the same
+  if (!written || rename(tmpFile.Get(), cacheFile.c_str()) != 0)
+    remove(tmpFile.Get());
+}
+
 void FaustGen::Factory::RemoveInstance(FaustGen* pDSP)
 {
   mInstances.erase(pDSP);
@@ -346,14 +664,10 @@ void FaustGen::Factory::RemoveInstance(FaustGen* pDSP)
   }
 }
 
-bool FaustGen::Factory::LoadFile(const char* file)
+bool FaustGen::Factory::ReadFile(const char* file)
 {
-  // Delete the existing Faust module
-  //FreeDSPFactory();
   WDL_String fileStr(file);
 
-  mBitCodeStr.Set("");
-
   WDL_FileRead infile(file);
 
   if (infile.IsOpen() == true)
@@ -366,6 +680,7 @@ bool FaustGen::Factory::LoadFile(const char* file)
     GetStat(fileStr.Get(), &buf);
     mPreviousTime = GetModifiedTime(buf);
 
+    mBitCodeStr.Set("");
     mSourceCodeStr.Set(buffer.data());
     
     // Add path of file to library path
@@ -374,6 +689,20 @@ bool FaustGen::Factory::LoadFile(const char* file)
     
     mInputDSPFile.Set(file);
     
+    return true;
+  }
+  
+  return false;
+}
+
+bool FaustGen::Factory::LoadFile(const char* file)
+{
+  // Delete the existing Faust module
+  //FreeDSPFactory();
+  CancelBackgroundCompile();
+
+  if (ReadFile(file))
+  {
     // Update all instances
     for (auto inst : mInstances)
     {
@@ -383,6 +712,8 @@ bool FaustGen::Factory::LoadFile(const char* file)
     return true;
   }
   
+  mBitCodeStr.Set("");
+
   assert(0); // The FAUST_BLOCK file was not found // TODO: warning about codesign
   
   return false;
@@ -400,39 +731,56 @@ void FaustGen::Factory::SetCompileOptions(std::initializer_list<const char*> opt
   if (options.size() == 0)
     DBGMSG("FaustGen-%s: No argument entered, no additional compilation option will be used", mName.Get());
 
-  //TODO
-//  mOptions = options;
-//
-//  /*
-//  if (optimize) {
-//
-//    DBGMSG("FaustGen-%s: Start looking for optimal compilation options...\n");
-//
-//  #ifdef OS_MAC
-//    double best;
-//    dsp_optimizer optimizer(string(mSourceCodeStr.Get()), (*mLibraryPaths.begin()).c_str(), getTarget(), sys_getblksize());
-//    mOptions = optimizer.findOptimizedParameters(best);
-//  #endif
-//
-//    DBGMSG("FaustGen-%s: Optimal compilation options found\n");
-//  }
-//  */
-//
-//  // Delete the existing Faust module
-//  FreeDSPFactory();
-//  mBitCodeStr.Set("");
-//
-//  // Update all instances
-//  for (auto i : fInstances) {
-//    i->UpdateSourceCode();
-//  }
+  std::vector<std::string> newOptions;
+
+  for (auto c : options)
+  {
+    if (CStringHasContents(c))
+      newOptions.push_back(c);
+  }
 
+  SetOptions(newOptions);
+}
+
+void FaustGen::Factory::SetCompileOptions(const char* options)
+{
+  std::vector<std::string> newOptions;
+  std::string option;
+
+  for (const char* c = options; c && *c; c++)
+  {
+    if (*c == ' ' || *c == '\t')
+    {
+      if (!option.empty())
+        newOptions.push_back(option);
+
+      option.clear();
+    }
+    else
+      option += *c;
+  }
+
+  if (!option.empty())
+    newOptions.push_back(option);
+
+  SetOptions(newOptions);
+}
+
+void FaustGen::Factory::SetOptions(const std::vector<std::string>& options)
+{
+  if (options == mOptions)
+    return;
+
+  mOptions = options;
+
+  if (mLLVMFactory)
+    RecompileInstances();
 }
 
 #pragma mark -
 
 FaustGen::FaustGen(const char* name, const char* inputDSPFile, int nVoices, int rate,
-                   const char* outputCPPFile, const char* drawPath, const char* libraryPath)
+                   const char* outputCPPFile, const char* drawPath, const char* libraryPath, const char* compileOptions)
 : IPlugFaust(name, nVoices, rate)
 {
   sFaustGenCounter++;
@@ -453,6 +801,9 @@ FaustGen::FaustGen(const char* name, const char* inputDSPFile, int nVoices, int
     FaustGen::Factory::sFactoryMap[name] = mFactory;
   }
 
+  if (CStringHasContents(compileOptions))
+    mFactory->SetCompileOptions(compileOptions);
+
   mFactory->AddInstance(this);
 }
 
@@ -464,6 +815,7 @@ FaustGen::~FaustGen()
   }
 
   FreeDSP();
+  FreeSwapDSPs();
 
   if(mFactory)
     mFactory->RemoveInstance(this);
@@ -472,6 +824,7 @@ FaustGen::~FaustGen()
 void FaustGen::Init()
 {
   mZones.Empty(); // remove existing pointers to zones
+  FreeSwapDSPs();
   
   mDSP = std::unique_ptr<::dsp>(mFactory->GetDSP(mMaxNInputs, mMaxNOutputs));
   assert(mDSP);
@@ -479,7 +832,7 @@ void FaustGen::Init()
 //    AddMidiHandler();
 //    mDSP->buildUserInterface(mMidiUI);
   mDSP->buildUserInterface(this);
-  mDSP->init(DEFAULT_SAMPLE_RATE);
+  mDSP->init(mSampleRate > 0. ? (int) mSampleRate : DEFAULT_SAMPLE_RATE);
 
   assert((mDSP->getNumInputs() <= mMaxNInputs) && (mDSP->getNumOutputs() <= mMaxNOutputs)); // don't have enough buffers to process the DSP
   
@@ -489,6 +842,8 @@ void FaustGen::Init()
   }
   
   BuildParameterMap(); // build a new map based on updated code
+  mRunningDSP.reset(MakeSwapDSP(nullptr));
+  mDSPZones.store(&mRunningDSP->mZones, std::memory_order_release);
   mInitialized = true;
   
   if(mPlug)
@@ -498,6 +853,67 @@ void FaustGen::Init()
     mOnCompileFunc();
 }
 
+void FaustGen::InstallDSP(::dsp* pDSP)
+{
+  assert(pDSP);
+  assert((pDSP->getNumInputs() <= mMaxNInputs) && (pDSP->getNumOutputs() <= mMaxNOutputs)); // don't have enough buffers to process the DSP
+
+  // connect the parameters to the new DSP now. The audio thread keeps writing parameter changes to the old DSP's zones until the swap
+  mZones.Empty();
+  pDSP->buildUserInterface(this);
+  pDSP->init(mSampleRate > 0. ? (int) mSampleRate : DEFAULT_SAMPLE_RATE);
+  BuildParameterMap();
+  mInitialized = true;
+
+  // a DSP that never reached the audio thread is superseded
+  delete mNextDSP;
+  mNextDSP = MakeSwapDSP(pDSP);
+  FreeRetiredDSP();
+
+  if(mPlug)
+    mPlug->OnParamReset(EParamSource::kRecompile);
+  
+  if(mOnCompileFunc)
+    mOnCompileFunc();
+}
+
+FaustGen::SwapDSP* FaustGen::MakeSwapDSP(::dsp* pDSP)
+{
+  SwapDSP* pSwapDSP = new SwapDSP;
+  pSwapDSP->mDSP.reset(pDSP);
+
+  for (auto i = 0; i < mZones.GetSize(); i++)
+    pSwapDSP->mZones.Add(mZones.Get(i));
+
+  return pSwapDSP;
+}
+
+bool FaustGen::FreeRetiredDSP()
+{
+  // once mPendingDSP is empty, the audio thread has finished with mRetiredDSP
+  if (mPendingDSP.load() != nullptr)
+    return false;
+
+  delete mRetiredDSP.exchange(nullptr);
+
+  if (mNextDSP)
+  {
+    mPendingDSP.store(mNextDSP);
+    mNextDSP = nullptr;
+    return false;
+  }
+
+  return true;
+}
+
+void FaustGen::FreeSwapDSPs()
+{
+  delete mNextDSP;
+  mNextDSP = nullptr;
+  delete mPendingDSP.exchange(nullptr);
+  delete mRetiredDSP.exchange(nullptr);
+}
+
 void FaustGen::GetDrawPath(WDL_String& path)
 {
   assert(!CStringHasContents(mFactory->mDrawPath.Get()));
@@ -516,6 +932,8 @@ bool FaustGen::CompileCPP()
   WDL_String command;
   WDL_String inputFile;
   WDL_String outputFile;
+  WDL_String codeOptions;
+  std::vector<std::string> options;
 
   for (auto f : Factory::sFactoryMap)
   {
@@ -523,8 +941,18 @@ bool FaustGen::CompileCPP()
     outputFile = inputFile;
     outputFile.remove_fileext();
     outputFile.AppendFormatted(1024, ".tmp");
-    //-double
-    command.SetFormatted(1024, "%s -cn %s -i -a %s -o %s %s", FAUST_EXE, f.second->mName.Get(), archFile.Get(), outputFile.Get(), inputFile.Get());
+
+    // the same options as the JIT compiled code, so that the static build sounds the same
+    f.second->GetCodeOptions(options);
+    codeOptions.Set("");
+
+    for (auto& o : options)
+    {
+      codeOptions.Append(o.c_str());
+      codeOptions.Append(" ");
+    }
+
+    command.SetFormatted(2048, "%s -cn %s %s-i -a %s -o %s %s", FAUST_EXE, f.second->mName.Get(), codeOptions.Get(), archFile.Get(), outputFile.Get(), inputFile.Get());
 
     DBGMSG("exec: %s\n", command.Get());
 
@@ -578,35 +1006,49 @@ bool FaustGen::CompileCPP()
 
 void FaustGen::OnTimer(Timer& timer)
 {
-  WDL_String* pInputFile;
+  // the timer fires often so that finished compiles are swapped in quickly, but files are only checked every FAUST_RECOMPILE_INTERVAL
+  bool checkFiles = false;
+
+  if (++sTimerTicks * FAUST_COMPILE_POLL_INTERVAL >= FAUST_RECOMPILE_INTERVAL)
+  {
+    checkFiles = true;
+    sTimerTicks = 0;
+  }
+
   bool recompile = false;
 
   for (auto f : Factory::sFactoryMap)
   {
-    pInputFile = &f.second->mInputDSPFile;
+    Factory* pFactory = f.second;
+
+    if (pFactory->FinishBackgroundCompile())
+      recompile = true;
+
+    pFactory->FreeRetired();
+
+    if (!checkFiles || pFactory->IsCompiling())
+      continue;
+
+    WDL_String* pInputFile = &pFactory->mInputDSPFile;
     StatType buf;
     GetStat(pInputFile->Get(), &buf);
-    StatTime oldTime = f.second->mPreviousTime;
+    StatTime oldTime = pFactory->mPreviousTime;
     StatTime newTime = GetModifiedTime(buf);
 
     if(!Equal(newTime, oldTime))
     {
-      WDL_MutexLock lock(&mMutex);
-
-      recompile = true;
-      f.second->FreeDSPFactory();
       DBGMSG("FaustGen-%s: File change detected ----------------------------------\n", mName.Get());
-      DBGMSG("FaustGen-%s: JIT compiling %s\n", mName.Get(), pInputFile->Get());
-      f.second->LoadFile(pInputFile->Get());
-      Init();
+      DBGMSG("FaustGen-%s: JIT compiling %s in the background\n", mName.Get(), pInputFile->Get());
+
+      if (pFactory->ReadFile(pInputFile->Get()))
+        pFactory->StartBackgroundCompile();
     }
       
-    f.second->mPreviousTime = newTime;
+    pFactory->mPreviousTime = newTime;
   }
 
   if(recompile)
   {
-    // TODO: should check for successfull JIT
     DBGMSG("FaustGen-%s: Statically compiling all FAUST blocks\n", mName.Get());
     CompileCPP();
     //WDL_String objFile;
@@ -629,7 +1071,7 @@ void FaustGen::SetAutoRecompile(bool enable)
   if(enable)
   {
     if(sTimer == nullptr)
-      sTimer = Timer::Create(std::bind(&FaustGen::OnTimer, this, std::placeholders::_1), FAUST_RECOMPILE_INTERVAL);
+      sTimer = Timer::CreateShared(std::bind(&FaustGen::OnTimer, this, std::placeholders::_1), FAUST_COMPILE_POLL_INTERVAL);
   }
   else
   {
@@ -645,7 +1087,27 @@ void FaustGen::SetAutoRecompile(bool enable)
 
 void FaustGen::ProcessBlock(sample** inputs, sample** outputs, int nFrames)
 {
-  WDL_MutexLock lock(&mMutex);
+  // swap in a newly compiled DSP and its zones, once the main thread has freed the last one we swapped out
+  SwapDSP* pNewDSP = mPendingDSP.load();
+
+  if (pNewDSP && mRetiredDSP.load() == nullptr)
+  {
+    SwapDSP* pOldDSP = mRunningDSP.release();
+    pOldDSP->mDSP.reset(mDSP.release());
+    mDSP.reset(pNewDSP->mDSP.release());
+    mRunningDSP.reset(pNewDSP);
+    mDSPZones.store(&pNewDSP->mZones, std::memory_order_release);
+    mRetiredDSP.store(pOldDSP);
+    mPendingDSP.store(nullptr);
+
+    // the sample rate may have changed since the main thread called init()
+    if (mSampleRate > 0. && mDSP->getSampleRate() != (int) mSampleRate)
+    {
+      mDSP->instanceConstants((int) mSampleRate);
+      mDSP->instanceClear();
+    }
+  }
+
   if(!mErrored)
     IPlugFaust::ProcessBlock(inputs, outputs, nFrames);
   else
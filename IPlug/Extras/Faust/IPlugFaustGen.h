@@ -10,10 +10,13 @@
 
 #pragma once
 
+// options is a string of Faust compiler options, e.g. "-vec -lv 1". With -vec and no -vs, the vector size follows the block size passed to SetBlockSize()
 #ifndef FAUST_COMPILED
 #define FAUST_BLOCK(class, member, file, nvoices, rate) FaustGen member {#class, file, nvoices, rate}
+#define FAUST_BLOCK_OPTIONS(class, member, file, nvoices, rate, options) FaustGen member {#class, file, nvoices, rate, 0, 0, DEFAULT_FAUST_LIBRARY_PATH, options}
 #else
 #define FAUST_BLOCK(class, member, file, nvoices, rate) Faust_##class member {#class, file, nvoices, rate}
+#define FAUST_BLOCK_OPTIONS(class, member, file, nvoices, rate, options) Faust_##class member {#class, file, nvoices, rate, 0, 0, DEFAULT_FAUST_LIBRARY_PATH, options}
 // if this file is not found, you need to run the code without FAUST_COMPILED defined and make sure to call CompileCPP();
 #include "FaustCode.hpp"
 using FaustGen = IPlugFaust; // not used, except for CompileCPP();
@@ -21,9 +24,11 @@ using FaustGen = IPlugFaust; // not used, except for CompileCPP();
 
 #ifndef FAUST_COMPILED
 
+#include <atomic>
 #include <iostream>
 #include <string>
 #include <set>
+#include <thread>
 #include <vector>
 #include <map>
 
@@ -38,6 +43,7 @@ typedef struct stat StatType;
 typedef timespec StatTime;
 
 static inline int GetStat(const char* path, StatType* pStatbuf) { return stat(path, pStatbuf); }
+static inline int MakeDirectory(const char* path) { return mkdir(path, S_IRWXU | S_IRWXG | S_IRWXO); }
 static inline StatTime GetModifiedTime(StatType &s) { return s.st_mtimespec; }
 static inline bool Equal(StatTime a, StatTime b) { return (a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec); }
 static inline StatTime TimeZero()
@@ -48,6 +54,8 @@ static inline StatTime TimeZero()
   return ts;
 }
 #else //OS_WIN
+#include <direct.h>
+
 typedef struct _stat64i32 StatType;
 typedef time_t StatTime;
 
@@ -57,6 +65,12 @@ static inline int GetStat(const char* path, StatType* pStatbuf)
   UTF8ToUTF16(utf16str, path, MAX_PATH);
   return _wstat(utf16str, pStatbuf);
 }
+static inline int MakeDirectory(const char* path)
+{
+  wchar_t utf16str[MAX_PATH];
+  UTF8ToUTF16(utf16str, path, MAX_PATH);
+  return _wmkdir(utf16str);
+}
 static inline StatTime GetModifiedTime(StatType &s) { return s.st_mtime; }
 static inline bool Equal(StatTime a, StatTime b) { return a == b; }
 static inline StatTime TimeZero() { return (StatTime) 0; }
@@ -84,6 +98,11 @@ static inline StatTime TimeZero() { return (StatTime) 0; }
 
 #define FAUST_CLASS_PREFIX "F"
 #define FAUST_RECOMPILE_INTERVAL 5000 //ms
+#define FAUST_COMPILE_POLL_INTERVAL 100 //ms, how often to check whether a background compile has finished
+
+#ifndef FAUST_CACHE_DIR_NAME
+  #define FAUST_CACHE_DIR_NAME "iPlug2 Faust Cache" // folder in AppSupportPath() where JIT compiled factories are kept, define FAUST_NO_CACHE to disable
+#endif
 
 #ifndef FAUST_EXE
   #if defined OS_MAC || defined OS_LINUX
@@ -161,11 +180,51 @@ class FaustGen : public IPlugFaust
 
     bool LoadFile(const char* file);
     bool WriteToFile(const char* file);
+
+    /** Set the Faust compiler options, and recompile if there is already a DSP. -double is added automatically when sample is double
+     * @param options Options as they would be passed to the faust command line, e.g. {"-vec", "-vs", "64"} */
     void SetCompileOptions(std::initializer_list<const char*> options);
 
+    /** Set the Faust compiler options from a string of space separated options, as passed to FAUST_BLOCK_OPTIONS() */
+    void SetCompileOptions(const char* options);
+
+    /** Set the vector size used when compiling with -vec and no -vs. Recompiles if it changed and there is already a vectorised DSP */
+    void SetBlockSize(int blockSize);
+
+    /** The options that change the generated code, shared by the JIT compiler and the static C++ build in CompileCPP() */
+    void GetCodeOptions(std::vector<std::string>& options) const;
+
+    /** Start JIT compiling the current source code on a worker thread. The running DSP instances are untouched until FinishBackgroundCompile() */
+    void StartBackgroundCompile();
+
+    /** Call on the main thread. If a background compile has finished, hand a new DSP instance to every FaustGen using this factory.
+     * If the compile failed, the previous DSP keeps running
+     * @return \c true if a compile finished successfully */
+    bool FinishBackgroundCompile();
+
+    /** Call on the main thread. Free DSP instances the audio thread has swapped out, and factories that no instance is using any more */
+    void FreeRetired();
+
+    bool IsCompiling() const { return mCompileThread.joinable(); }
+
   private:
     void AddLibraryPath(const char* libraryPath);
     void AddCompileOption(const char* key, const char* value = "");
+    bool ReadFile(const char* file);
+
+    /** @return The cache file for compiled machine code, keyed by a hash of the source, compile options, optimisation level and Faust version, or an empty string if caching is disabled */
+    std::string GetCacheFilePath() const;
+
+    /** Thread safe, so can be called from the background compile. Corrupt or incompatible cache files are deleted
+     * @return A factory loaded from the cache, or nullptr if there is no usable cache file */
+    static llvm_dsp_factory* ReadCachedFactory(const std::string& cacheFile);
+
+    /** Thread safe. Writes to a temporary file and renames it, so that other processes never read half a file */
+    static void WriteCachedFactory(llvm_dsp_factory* pFactory, const std::string& cacheFile);
+    void CancelBackgroundCompile();
+    void RecompileInstances();
+    void SetOptions(const std::vector<std::string>& options);
+    bool IsAutoVectorSize() const;
   private:
     struct FMeta : public Meta, public std::map<std::string, std::string>
     {
@@ -213,15 +272,24 @@ class FaustGen : public IPlugFaust
     int mNInputs = 0;
     int mNOutputs = 0;
     int mOptimizationLevel = LLVM_OPTIMIZATION;
+    int mBlockSize = DEFAULT_BLOCK_SIZE;
     static int sFactoryCounter;
     static std::map<std::string, Factory*> sFactoryMap;
     WDL_String mInputDSPFile;
     StatTime mPreviousTime;
+
+    // background compilation, the result is only read once mCompileDone is set
+    std::thread mCompileThread;
+    std::atomic<bool> mCompileDone{false};
+    llvm_dsp_factory* mCompiledFactory = nullptr;
+    std::string mCompileError;
+    std::vector<llvm_dsp_factory*> mRetiredFactories; // previous factories, deleted once no DSP instance made from them is left
   };
 public:
 
   FaustGen(const char* name, const char* inputDSPFile = 0, int nVoices = 1, int rate = 1,
-           const char* outputCPPFile = 0, const char* drawPath = 0, const char* libraryPath = DEFAULT_FAUST_LIBRARY_PATH);
+           const char* outputCPPFile = 0, const char* drawPath = 0, const char* libraryPath = DEFAULT_FAUST_LIBRARY_PATH,
+           const char* compileOptions = "");
 
   ~FaustGen();
 
@@ -237,6 +305,13 @@ public:
   void Init() override;
 
   void LoadFile(const char* path) { mFactory->FreeDSPFactory(); mFactory->LoadFile(path); }
+
+  /** Set the Faust compiler options for this block and every other one with the same name, recompiling if needed. Call on the main thread
+   * @param options Options as they would be passed to the faust command line, e.g. {"-vec", "-lv", "1"} */
+  void SetCompileOptions(std::initializer_list<const char*> options) { mFactory->SetCompileOptions(options); }
+
+  /** With -vec and no -vs, recompiles so that the vector size matches blockSize. Call from OnReset() */
+  void SetBlockSize(int blockSize) override { mFactory->SetBlockSize(blockSize); }
   
   /** This method allows SVG files generated by a specific instance of FaustGen can be located. The path to the SVG file for process.svg will be returned, if drawPath has been specified in the constructor.
    * This method will trigger an assertion if drawPath has not been specified
@@ -255,21 +330,49 @@ public:
   
   void OnTimer(Timer& timer);
   
+  /** Audio thread: swaps to a newly compiled DSP at the start of the block if one is waiting, without locking */
   void ProcessBlock(sample** inputs, sample** outputs, int nFrames) override;
   
   void SetErrored(bool errored) { mErrored = errored; }
   
 private:
+  /** A DSP instance and the zones of its parameters, which the audio thread swaps in together so that parameter changes never reach a
+   * DSP that isn't running, or one that has been freed */
+  struct SwapDSP
+  {
+    std::unique_ptr<::dsp> mDSP;
+    WDL_PtrList<FAUSTFLOAT> mZones;
+  };
+
+  /** Main thread: connect a newly compiled DSP instance's parameters, then queue it for the audio thread to swap in. We take ownership of pDSP */
+  void InstallDSP(::dsp* pDSP);
+
+  /** Main thread: @return A SwapDSP holding pDSP and a copy of mZones, which buildUserInterface() has just filled for it */
+  SwapDSP* MakeSwapDSP(::dsp* pDSP);
+
+  /** Main thread: delete the DSP instance the audio thread swapped out, and queue the next one if there is one
+   * @return \c true if no swap is in progress */
+  bool FreeRetiredDSP();
+
+  /** Main thread: delete every DSP instance waiting to be swapped in or freed */
+  void FreeSwapDSPs();
+
   Factory* mFactory = nullptr;
   static Timer* sTimer;
   static int sFaustGenCounter;
   static bool sAutoRecompile;
   int mMaxNInputs = -1;
   int mMaxNOutputs = -1;
-  bool mErrored = false;
+  std::atomic<bool> mErrored{false};
   std::function<void()> mOnCompileFunc = nullptr;
-  
-  WDL_Mutex mMutex;
+
+  // The main thread only sets mPendingDSP when it is empty, the audio thread only takes it when mRetiredDSP is empty,
+  // stores the old DSP and its zones in mRetiredDSP and then clears mPendingDSP. Only the main thread deletes DSPs
+  SwapDSP* mNextDSP = nullptr; // main thread only, waiting for mPendingDSP to be free
+  std::atomic<SwapDSP*> mPendingDSP{nullptr};
+  std::atomic<SwapDSP*> mRetiredDSP{nullptr};
+  std::unique_ptr<SwapDSP> mRunningDSP = std::make_unique<SwapDSP>(); // the zones of mDSP, which mDSPZones points to. Its own mDSP is empty while it runs
+  static int sTimerTicks;
 };
 
 END_IPLUG_NAMESPACE
@@ -16,8 +16,9 @@ class Faust_mydsp : public IPlugFaust
 {
 public:
 	Faust_mydsp(const char* name, const char* inputDSPFile = 0, int nVoices = 1, int rate = 1,
-						const char* outputCPPFile = 0, const char* drawPath = 0, const char* libraryPath = DEFAULT_FAUST_LIBRARY_PATH)
-	: IPlugFaust(name, nVoices)
+						const char* outputCPPFile = 0, const char* drawPath = 0, const char* libraryPath = DEFAULT_FAUST_LIBRARY_PATH,
+						const char* compileOptions = "") // the options are applied when CompileCPP() generates this class
+	: IPlugFaust(name, nVoices, rate)
 	{
 	}
 
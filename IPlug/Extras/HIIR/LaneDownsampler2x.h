@@ -0,0 +1,177 @@
+/*
+LaneDownsampler2x.h
+
+Downsamples by a factor 2 up to NL channels at once, one channel per lane.
+Gives the same results as one Downsampler2xFPU per channel.
+
+Template parameters:
+- NC: number of coefficients, > 0
+- T: sample type of the filter state and arithmetic
+- NL: number of lanes (channels), > 0
+- TIO: sample type of the channel buffers, converted to and from T
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include "LaneStageProc.h"
+
+namespace hiir
+{
+
+template <int NC, typename T, int NL, typename TIO = T>
+class Downsampler2xLanes
+{
+public:
+
+  enum { NBR_COEFS = NC };
+  enum { NBR_LANES = NL };
+
+  Downsampler2xLanes ();
+
+  /*
+  Name: set_coefs
+  Description:
+  Sets filter coefficients, shared by all lanes. Generate them with the
+  PolyphaseIir2Designer class.
+  Call this function before doing any processing.
+  Input parameters:
+  - coef_arr: Array of coefficients. There should be as many coefficients as
+  mentioned in the class template parameter.
+  */
+  void set_coefs (const double coef_arr [NBR_COEFS]);
+
+  /*
+  Name: process_block
+  Description:
+    Downsamples (x2) a block of samples for each channel.
+    The output of a channel may overlap the beginning of its input.
+  Input parameters:
+    - in_ptr_arr: Input arrays, one per channel, containing nbr_spl * 2 samples.
+    - nbr_chn: Number of channels to process, > 0 and <= NBR_LANES
+    - nbr_spl: Number of samples to output, > 0
+  Output parameters:
+    - out_ptr_arr: Output arrays, one per channel, capacity: nbr_spl samples.
+  */
+  void process_block (TIO* const out_ptr_arr [], const TIO* const in_ptr_arr [], int nbr_chn, long nbr_spl);
+
+  /*
+  Name: clear_buffers
+  Description:
+  Clears filter memory, as if it processed silence since an infinite amount
+  of time.
+  */
+  void clear_buffers ();
+
+private:
+  T _coef [NBR_COEFS];
+  T _x [NBR_COEFS][NBR_LANES];
+  T _y [NBR_COEFS][NBR_LANES];
+
+private:
+  bool operator == (const Downsampler2xLanes &other);
+  bool operator != (const Downsampler2xLanes &other);
+
+};  // class Downsampler2xLanes
+
+template <int NC, typename T, int NL, typename TIO>
+Downsampler2xLanes <NC, T, NL, TIO>::Downsampler2xLanes ()
+{
+  for (int i = 0; i < NBR_COEFS; ++i)
+  {
+    _coef [i] = 0;
+  }
+  clear_buffers ();
+}
+
+template <int NC, typename T, int NL, typename TIO>
+void Downsampler2xLanes <NC, T, NL, TIO>::set_coefs (const double coef_arr [NBR_COEFS])
+{
+  assert (coef_arr != 0);
+
+  for (int i = 0; i < NBR_COEFS; ++i)
+  {
+    _coef [i] = static_cast <T> (coef_arr [i]);
+  }
+}
+
+template <int NC, typename T, int NL, typename TIO>
+void Downsampler2xLanes <NC, T, NL, TIO>::process_block (TIO* const out_ptr_arr [], const TIO* const in_ptr_arr [], int nbr_chn, long nbr_spl)
+{
+  assert (out_ptr_arr != 0);
+  assert (in_ptr_arr != 0);
+  assert (nbr_chn > 0 && nbr_chn <= NBR_LANES);
+  assert (nbr_spl > 0);
+
+  // Samples are moved to and from the lanes a chunk at a time. Filling a lane vector one channel at a time right before
+  // the cascade reads it stalls store forwarding, which can cost more than the filtering itself
+  const int chunk_len = 32;
+  T spl_0 [chunk_len][NBR_LANES];
+  T spl_1 [chunk_len][NBR_LANES];
+
+  // the state is kept in locals while processing, as the compiler can't tell that members don't alias the channel buffers
+  T x [NBR_COEFS][NBR_LANES];
+  T y [NBR_COEFS][NBR_LANES];
+  std::copy (&_x [0][0], &_x [0][0] + NBR_COEFS * NBR_LANES, &x [0][0]);
+  std::copy (&_y [0][0], &_y [0][0] + NBR_COEFS * NBR_LANES, &y [0][0]);
+
+  for (long start = 0; start < nbr_spl; start += chunk_len)
+  {
+    const int len = static_cast <int> (std::min (nbr_spl - start, static_cast <long> (chunk_len)));
+
+    for (int l = 0; l < NBR_LANES; ++l)
+    {
+      // unused lanes process silence, so their state stays at zero
+      const TIO* in_ptr = l < nbr_chn ? in_ptr_arr [l] + start * 2 : nullptr;
+
+      for (int i = 0; i < len; ++i)
+      {
+        spl_0 [i][l] = in_ptr ? static_cast <T> (in_ptr [i * 2 + 1]) : T (0);
+        spl_1 [i][l] = in_ptr ? static_cast <T> (in_ptr [i * 2]) : T (0);
+      }
+    }
+
+    for (int i = 0; i < len; ++i)
+    {
+      StageProcLanes <NBR_COEFS, T, NBR_LANES>::process_sample_pos (spl_0 [i], spl_1 [i], _coef, x, y);
+    }
+
+    for (int l = 0; l < nbr_chn; ++l)
+    {
+      TIO* out_ptr = out_ptr_arr [l] + start;
+
+      for (int i = 0; i < len; ++i)
+      {
+        out_ptr [i] = static_cast <TIO> (0.5f * (spl_0 [i][l] + spl_1 [i][l]));
+      }
+    }
+  }
+
+  std::copy (&x [0][0], &x [0][0] + NBR_COEFS * NBR_LANES, &_x [0][0]);
+  std::copy (&y [0][0], &y [0][0] + NBR_COEFS * NBR_LANES, &_y [0][0]);
+}
+
+template <int NC, typename T, int NL, typename TIO>
+void Downsampler2xLanes <NC, T, NL, TIO>::clear_buffers ()
+{
+  for (int i = 0; i < NBR_COEFS; ++i)
+  {
+    for (int l = 0; l < NBR_LANES; ++l)
+    {
+      _x [i][l] = 0;
+      _y [i][l] = 0;
+    }
+  }
+}
+
+} // namespace hiir
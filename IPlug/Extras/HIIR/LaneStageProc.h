@@ -0,0 +1,92 @@
+/*
+        LaneStageProc.h
+
+Multi-channel version of StageProcFPU. Each channel is processed in its own
+lane and the lanes are stored contiguously, so that the inner loops map onto
+SSE2/AVX/NEON registers when the compiler targets them.
+
+Template parameters:
+  - NC: number of coefficients, > 0
+  - T: sample type
+  - NL: number of lanes (channels), > 0
+
+  --- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*/
+
+#pragma once
+
+namespace hiir
+{
+
+template <int NC, typename T, int NL>
+class StageProcLanes
+{
+public:
+  /*
+  Name: process_sample_pos
+  Description:
+    Runs the allpass cascade on one sample pair of every lane, equivalent to
+    StageProcFPU::process_sample_pos() for each lane.
+  */
+  static inline void process_sample_pos (T spl_0 [NL], T spl_1 [NL], const T coef [NC], T x [NC][NL], T y [NC][NL])
+  {
+    int cnt = 0;
+
+    for (; cnt + 1 < NC; cnt += 2)
+    {
+      const T c_0 = coef [cnt + 0];
+      const T c_1 = coef [cnt + 1];
+      T* x_0 = x [cnt + 0];
+      T* x_1 = x [cnt + 1];
+      T* y_0 = y [cnt + 0];
+      T* y_1 = y [cnt + 1];
+
+      for (int l = 0; l < NL; ++l)
+      {
+        const T temp_0 = (spl_0 [l] - y_0 [l]) * c_0 + x_0 [l];
+        const T temp_1 = (spl_1 [l] - y_1 [l]) * c_1 + x_1 [l];
+
+        x_0 [l] = spl_0 [l];
+        x_1 [l] = spl_1 [l];
+
+        y_0 [l] = temp_0;
+        y_1 [l] = temp_1;
+
+        spl_0 [l] = temp_0;
+        spl_1 [l] = temp_1;
+      }
+    }
+
+    if (cnt < NC) // odd number of coefficients, the last one only filters spl_0
+    {
+      const T c_0 = coef [cnt];
+      T* x_0 = x [cnt];
+      T* y_0 = y [cnt];
+
+      for (int l = 0; l < NL; ++l)
+      {
+        const T temp = (spl_0 [l] - y_0 [l]) * c_0 + x_0 [l];
+        x_0 [l] = spl_0 [l];
+        y_0 [l] = temp;
+        spl_0 [l] = temp;
+      }
+    }
+  }
+
+private:
+  StageProcLanes();
+  StageProcLanes(const StageProcLanes &other);
+  StageProcLanes& operator = (const StageProcLanes &other);
+  bool operator == (const StageProcLanes &other);
+  bool operator != (const StageProcLanes &other);
+
+};  // class StageProcLanes
+
+} // namespace hiir
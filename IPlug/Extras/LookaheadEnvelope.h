@@ -0,0 +1,208 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc LookaheadEnvelope
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "IPlugPlatform.h"
+#include "IPlugProcessor.h"
+#include "NChanDelay.h"
+
+#include "heapbuf.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** The lookahead stage of a limiter or compressor: the audio is delayed by the lookahead time, and the envelope of each delayed sample is
+ * the peak of the input over the window from that sample to the lookahead time after it, followed by a release. A gain computed from the
+ * envelope therefore starts to duck before the peak arrives.
+ * The window maximum uses the van Herk/Gil-Werman algorithm, three comparisons per sample whatever the lookahead, so a long lookahead costs
+ * memory but no CPU. All buffers are allocated by Configure(), so ProcessBlock() doesn't allocate
+ * @code
+ * // in OnReset()
+ * mLookahead.Configure(static_cast<int>(GetSampleRate() * 0.005), NOutChansConnected(), this);
+ * mLookahead.SetRelease(GetSampleRate(), 100.);
+ * // in ProcessBlock(), with mEnvelope a buffer per channel of the maximum block size
+ * mLookahead.ProcessBlock(inputs, outputs, mEnvelope, NOutChansConnected(), nFrames);
+ * @endcode */
+template <typename T = double>
+class LookaheadEnvelope
+{
+public:
+  LookaheadEnvelope() = default;
+
+  LookaheadEnvelope(const LookaheadEnvelope&) = delete;
+  LookaheadEnvelope& operator=(const LookaheadEnvelope&) = delete;
+
+  /** Allocate the buffers. Not realtime safe, call it from OnReset() or the constructor
+   * @param lookahead The lookahead time in samples, which is also the delay of the audio
+   * @param nChans The most channels that will be processed
+   * @param pProcessor If not nullptr, its latency is set to GetLatency() */
+  void Configure(int lookahead, int nChans, IPlugProcessor* pProcessor = nullptr)
+  {
+    mLookahead = std::max(lookahead, 0);
+    mNChans = std::max(nChans, 1);
+    mWindow = mLookahead + 1;
+
+    mDelay = NChanDelayLine<T>(mNChans, mNChans);
+    mDelay.SetDelayTime(mLookahead);
+
+    // per detector: the current segment, then the suffix maxima of the previous one with a zero after them
+    mDetectors.Resize(mNChans * (2 * mWindow + 1));
+    mPrefix.Resize(mNChans);
+    mEnvelope.Resize(mNChans);
+
+    Reset();
+
+    if (pProcessor)
+      pProcessor->SetLatency(GetLatency());
+  }
+
+  /** Clear the delay and the detectors */
+  void Reset()
+  {
+    mDelay.ClearBuffer();
+
+    std::fill(mDetectors.Get(), mDetectors.Get() + mDetectors.GetSize(), T(0));
+    std::fill(mPrefix.Get(), mPrefix.Get() + mPrefix.GetSize(), T(0));
+    std::fill(mEnvelope.Get(), mEnvelope.Get() + mEnvelope.GetSize(), T(0));
+    mSegmentPos = 0;
+  }
+
+  /** @param sampleRate The sample rate
+   * @param releaseMs The time for the envelope to fall by 63% once the peak has passed, 0. to follow the window maximum */
+  void SetRelease(double sampleRate, double releaseMs)
+  {
+    mReleaseCoeff = releaseMs > 0. ? static_cast<T>(std::exp(-1000. / (releaseMs * sampleRate))) : T(0);
+  }
+
+  /** @param linked \c true to detect the loudest of the channels, so that every channel gets the same envelope and the stereo image
+   * doesn't move when one side is turned down. \c false to follow each channel separately */
+  void SetLinked(bool linked) { mLinked = linked; }
+
+  /** @return The delay of the audio, in samples */
+  int GetLatency() const { return mLookahead; }
+
+  /** Delay a block and compute its envelope
+   * @param inputs Input channel arrays
+   * @param outputs Output channel arrays, can be the same as inputs
+   * @param envelopes Filled with the envelope of each delayed output sample, one array per channel
+   * @param nChans The number of channels, <= the number passed to Configure()
+   * @param nFrames The number of samples to process */
+  void ProcessBlock(T** inputs, T** outputs, T** envelopes, int nChans, int nFrames)
+  {
+    assert(nChans <= mNChans);
+
+    // detect before delaying, as outputs may be the same as inputs
+    if (mLinked)
+    {
+      for (auto s = 0; s < nFrames; s++)
+      {
+        T peak = T(0);
+
+        for (auto c = 0; c < nChans; c++)
+          peak = std::max(peak, std::abs(inputs[c][s]));
+
+        envelopes[0][s] = peak;
+      }
+
+      // the other channels' detectors stand still, so for a window after unlinking they hold stale peaks
+      Detect(0, envelopes[0], nFrames);
+
+      for (auto c = 1; c < nChans; c++)
+        std::copy(envelopes[0], envelopes[0] + nFrames, envelopes[c]);
+    }
+    else
+    {
+      const int segmentPos = mSegmentPos;
+
+      for (auto c = 0; c < nChans; c++)
+      {
+        mSegmentPos = segmentPos;
+
+        for (auto s = 0; s < nFrames; s++)
+          envelopes[c][s] = std::abs(inputs[c][s]);
+
+        Detect(c, envelopes[c], nFrames);
+      }
+    }
+
+    mDelay.ProcessBlock(inputs, outputs, nChans, nFrames);
+  }
+
+private:
+  /** Replace a block of rectified input with its window maximum, followed by the release */
+  void Detect(int chan, T* pBuf, int nFrames)
+  {
+    const int window = mWindow;
+    T* pSegment = mDetectors.Get() + chan * (2 * window + 1);
+    T* pSuffix = pSegment + window;
+    T prefix = mPrefix.Get()[chan];
+    T envelope = mEnvelope.Get()[chan];
+    const T releaseCoeff = mReleaseCoeff;
+    int pos = mSegmentPos;
+
+    for (auto s = 0; s < nFrames;)
+    {
+      const int n = std::min(nFrames - s, window - pos);
+
+      // the window ending at pos is the current segment up to pos and the previous segment after it
+      for (auto i = 0; i < n; i++, pos++)
+      {
+        const T x = pBuf[s + i];
+        pSegment[pos] = x;
+        prefix = pos ? std::max(prefix, x) : x;
+        const T peak = std::max(prefix, pSuffix[pos + 1]);
+        envelope = peak >= envelope ? peak : peak + (envelope - peak) * releaseCoeff;
+        pBuf[s + i] = envelope;
+      }
+
+      s += n;
+
+      if (pos == window)
+      {
+        // the segment is complete, its suffix maxima serve the next window length of samples
+        T suffix = T(0);
+
+        for (auto i = window; i-- > 0;)
+        {
+          suffix = std::max(suffix, pSegment[i]);
+          pSuffix[i] = suffix;
+        }
+
+        pos = 0;
+      }
+    }
+
+    mPrefix.Get()[chan] = prefix;
+    mEnvelope.Get()[chan] = envelope;
+    mSegmentPos = pos;
+  }
+
+  NChanDelayLine<T> mDelay {1, 1};
+  WDL_TypedBuf<T> mDetectors;
+  WDL_TypedBuf<T> mPrefix;
+  WDL_TypedBuf<T> mEnvelope;
+  T mReleaseCoeff = T(0);
+  int mLookahead = 0;
+  int mWindow = 1;
+  int mNChans = 0;
+  int mSegmentPos = 0;
+  bool mLinked = true;
+};
+
+END_IPLUG_NAMESPACE
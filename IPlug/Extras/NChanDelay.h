@@ -9,11 +9,18 @@
 */
 
 #pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
 #include "IPlugPlatform.h"
+#include "heapbuf.h"
 
 BEGIN_IPLUG_NAMESPACE
 
-// A static delayline used to delay bypassed signals to match mLatency in AAX/VST3/AU
+/** A static delayline used to delay bypassed signals to match mLatency in AAX/VST3/AU
+ * Each channel is a contiguous ring buffer, which is read and written a block at a time, in at most two segments per channel */
 template<typename T>
 class NChanDelayLine
 {
@@ -25,47 +32,120 @@ public:
 
   void SetDelayTime(int delayTimeSamples)
   {
-    mDTSamples = delayTimeSamples;
-    mBuffer.Resize(mNInChans * delayTimeSamples);
+    mDTSamples = std::max(delayTimeSamples, 0);
+    mBuffer.Resize(mNInChans * mDTSamples);
     mWriteAddress = 0;
     ClearBuffer();
   }
 
+  int GetDelayTime() const { return mDTSamples; }
+
+  /** @return The size of the delay buffer in bytes */
+  size_t GetMemoryUsage() const { return mBuffer.GetSize() * sizeof(T); }
+
   void ClearBuffer()
   {
     memset(mBuffer.Get(), 0, mNInChans * mDTSamples * sizeof(T));
   }
 
+  /** Delay a block of samples. outputs may be the same as inputs.
+   * Output channels with no corresponding input channel are zeroed */
   void ProcessBlock(T** inputs, T** outputs, int nFrames)
   {
-    T* buffer = mBuffer.Get();
+    const int nChans = std::min(mNInChans, mNOutChans);
+    ProcessBlock(inputs, outputs, nChans, nFrames);
 
-    for (auto s = 0 ; s < nFrames; ++s)
+    for (auto c = nChans; c < mNOutChans; c++)
     {
-      int32_t readAddress = mWriteAddress - mDTSamples;
-      readAddress %= mDTSamples;
+      memset(outputs[c], 0, nFrames * sizeof(T));
+    }
+  }
+
+  /** Delay a block of the first nChans channels, for when fewer channels are connected than the delay line was made for.
+   * outputs may be the same as inputs. The other channels' delays are not advanced */
+  void ProcessBlock(T** inputs, T** outputs, int nChans, int nFrames)
+  {
+    assert(nChans <= mNInChans);
+    int startIdx = 0;
 
-      for (auto c = 0; c < mNInChans; c++)
+    while (startIdx < nFrames)
+    {
+      // blocks longer than the delay time are processed in chunks, so that each chunk reads what was written before it
+      const int chunkSize = mDTSamples ? std::min(nFrames - startIdx, mDTSamples) : nFrames;
+
+      for (auto c = 0; c < nChans; c++)
       {
-        if (c < mNOutChans)
+        T* pIn = inputs[c] + startIdx;
+        T* pOut = outputs[c] + startIdx;
+
+        if (!mDTSamples)
         {
-          T input = inputs[c][s];
-          const int offset = c * mDTSamples;
-          outputs[c][s] = buffer[offset + readAddress];
-          buffer[offset + mWriteAddress] = input;
+          if (pOut != pIn)
+            memcpy(pOut, pIn, chunkSize * sizeof(T));
+
+          continue;
+        }
+
+        T* pChan = mBuffer.Get() + (c * mDTSamples);
+        const int firstSize = std::min(chunkSize, mDTSamples - mWriteAddress);
+        const int secondSize = chunkSize - firstSize;
+
+        if (pOut == pIn) // in place, swap the block with the oldest samples in the ring
+        {
+          std::swap_ranges(pOut, pOut + firstSize, pChan + mWriteAddress);
+          std::swap_ranges(pOut + firstSize, pOut + chunkSize, pChan);
+        }
+        else
+        {
+          memcpy(pOut, pChan + mWriteAddress, firstSize * sizeof(T));
+          memcpy(pOut + firstSize, pChan, secondSize * sizeof(T));
+          memcpy(pChan + mWriteAddress, pIn, firstSize * sizeof(T));
+          memcpy(pChan, pIn + firstSize, secondSize * sizeof(T));
         }
       }
 
-      mWriteAddress++;
-      mWriteAddress %= mDTSamples;
+      if (mDTSamples)
+        mWriteAddress = (mWriteAddress + chunkSize) % mDTSamples;
+
+      startIdx += chunkSize;
+    }
+  }
+
+  /** Read a block of past input from one channel, for reading taps in between ProcessBlock() calls
+   * @param chan The input channel to read
+   * @param delaySamples How many samples before the next write position the block starts, 1 being the most recent sample. Must be between nFrames and GetDelayTime()
+   * @param pDest The buffer to write nFrames samples to
+   * @param nFrames The number of samples to read */
+  void ReadTap(int chan, int delaySamples, T* pDest, int nFrames) const
+  {
+    assert(chan < mNInChans);
+    assert(nFrames <= delaySamples && delaySamples <= mDTSamples);
+
+    const T* pChan = mBuffer.Get() + (chan * mDTSamples);
+    const int readAddress = (mWriteAddress + mDTSamples - delaySamples) % mDTSamples;
+    const int firstSize = std::min(nFrames, mDTSamples - readAddress);
+
+    memcpy(pDest, pChan + readAddress, firstSize * sizeof(T));
+    memcpy(pDest + firstSize, pChan, (nFrames - firstSize) * sizeof(T));
+  }
+
+  /** Read several taps from one channel, see ReadTap()
+   * @param pDelays The delay in samples of each tap
+   * @param ppDest The buffers to write each tap to
+   * @param nTaps The number of taps */
+  void ReadTaps(int chan, const int* pDelays, T** ppDest, int nTaps, int nFrames) const
+  {
+    for (auto t = 0; t < nTaps; t++)
+    {
+      ReadTap(chan, pDelays[t], ppDest[t], nFrames);
     }
   }
 
 private:
   WDL_TypedBuf<T> mBuffer;
-  uint32_t mNInChans, mNOutChans;
-  uint32_t mWriteAddress = 0;
-  uint32_t mDTSamples = 0;
+  int mNInChans, mNOutChans;
+  int mWriteAddress = 0;
+  int mDTSamples = 0;
 } WDL_FIXALIGN;
 
 END_IPLUG_NAMESPACE
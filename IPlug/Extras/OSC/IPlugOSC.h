@@ -17,16 +17,25 @@
  *
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <cstring>
 #include <ctime>
 #include <unistd.h>
 #include <functional>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "jnetlib/jnetlib.h"
 
 #include "IPlugPlatform.h"
+#include "IPlugConstants.h"
 #include "IPlugOSC_msg.h"
+#include "IPlugQueue.h"
 #include "IPlugTimer.h"
 
 extern void Sleep(int ms);
@@ -270,7 +279,7 @@ public:
     JNL::open_socketlib();
     
     if(!mTimer)
-      mTimer = std::unique_ptr<Timer>(Timer::Create(std::bind(&OSCInterface::OnTimer, this, std::placeholders::_1), updateRateMs));
+      mTimer = std::unique_ptr<Timer>(Timer::CreateShared(std::bind(&OSCInterface::OnTimer, this, std::placeholders::_1), updateRateMs));
       
     sInstances++;
   }
@@ -394,70 +403,78 @@ public:
     g_devices.Get(0)->oscSend(msg, len); // TODO: device 0?
   }
   
-  struct incomingEvent
+  /** Dispatch the packets that have arrived to OnOSCTimedMessage(). The timer calls this, unless SetProcessIncomingOnTimer(false) has been called,
+   * in which case call it regularly from one other thread, e.g. at the start of ProcessBlock() for parameter and MIDI-style messages.
+   * It doesn't lock or allocate, but OnOSCTimedMessage() is then called on that thread too */
+  void ProcessIncoming()
   {
-    IODevice* dev_ptr;
-    int sz; // size of msg[], 1..3 for midi, anything for OSC
-    char type; // 0=midi, 1=OSC
-    unsigned char msg[3];
-  };
+    int len;
+    
+    // the receiver commits a packet's length and data together, so a length is always followed by its data
+    while (m_incoming_events.PopN((char*) &len, sizeof(len)) == sizeof(len))
+    {
+      m_incoming_events.PopN(m_incoming_packet, len);
+      DispatchPacket(m_incoming_packet, len, OSC_TIMETAG_IMMEDIATE);
+    }
+  }
+  
+  /** @param processOnTimer \c false to call ProcessIncoming() yourself, from another thread */
+  void SetProcessIncomingOnTimer(bool processOnTimer) { mProcessIncomingOnTimer = processOnTimer; }
   
   virtual void OnOSCMessage(OscMessageRead& msg) {};
   
+  /** Called for each message received, including the messages in (nested) bundles. Override this to schedule messages with OSCScheduler
+   * @param msg The message
+   * @param timetag The NTP timetag of the enclosing bundle, or OSC_TIMETAG_IMMEDIATE for a message that isn't in a bundle */
+  virtual void OnOSCTimedMessage(OscMessageRead& msg, uint64_t timetag) { OnOSCMessage(msg); }
+  
 private:
-  void OnTimer(Timer& timer)
+  /** Dispatch a message, or each element of a bundle, to OnOSCTimedMessage() */
+  void DispatchPacket(char* pBuf, int len, uint64_t timetag)
   {
-    if(mInputProc)
-      mInputProc();
-    
-    if (m_incoming_events.GetSize())
+    if (len >= 16 && !memcmp(pBuf, "#bundle", 8))
     {
-      static WDL_HeapBuf tmp;
+      uint32_t time[2];
+      memcpy(time, pBuf + 8, sizeof(time));
+      OSC_MAKEINTMEM4BE(&time[0]);
+      OSC_MAKEINTMEM4BE(&time[1]);
+      const uint64_t bundleTimetag = (static_cast<uint64_t>(time[0]) << 32) | time[1];
       
-      m_incoming_events_mutex.Enter();
-      tmp.CopyFrom(&m_incoming_events,false);
-      m_incoming_events.Resize(0,false);
-      m_incoming_events_mutex.Leave();
+      int rd_pos = 16;
       
-      int pos=0;
-      const int endpos = tmp.GetSize();
-      while (pos < endpos+1 - sizeof(incomingEvent))
+      while (rd_pos + 4 <= len)
       {
-        incomingEvent *evt = (incomingEvent*) ((char *)tmp.Get()+pos);
-        
-        const int this_sz = ((sizeof(incomingEvent) + (evt->sz-3)) + 7) & ~7;
+        int rd_sz;
+        memcpy(&rd_sz, pBuf + rd_pos, sizeof(rd_sz));
+        OSC_MAKEINTMEM4BE(&rd_sz);
+        rd_pos += 4;
         
-        if (pos+this_sz > endpos) break;
-        pos += this_sz;
-        
-        int rd_pos = 0;
-        int rd_sz = evt->sz;
-        if (evt->sz > 20 && !strcmp((char*)evt->msg, "#bundle"))
-        {
-          rd_sz = *(int *)(evt->msg+16);
-          OSC_MAKEINTMEM4BE(&rd_sz);
-          rd_pos += 20;
-        }
-        //        if (m_var_msgs[3]) m_var_msgs[3][0] = evt->dev_ptr ? *evt->dev_ptr : -1.0;
+        if (rd_sz < 1 || rd_pos + rd_sz > len)
+          break;
         
-        while (rd_pos + rd_sz <= evt->sz && rd_sz>=0)
-        {
-          OscMessageRead rmsg((char*)evt->msg + rd_pos, rd_sz);
-          
-          const char *mstr = rmsg.GetMessage();
-          if (mstr && *mstr)
-          {
-            OnOSCMessage(rmsg);
-          }
-          
-          rd_pos += rd_sz+4;
-          if (rd_pos >= evt->sz) break;
-          
-          rd_sz = *(int *)(evt->msg+rd_pos-4);
-          OSC_MAKEINTMEM4BE(&rd_sz);
-        }
+        DispatchPacket(pBuf + rd_pos, rd_sz, bundleTimetag);
+        rd_pos += rd_sz;
       }
     }
+    else if (len > 0)
+    {
+      OscMessageRead rmsg(pBuf, len);
+      
+      const char *mstr = rmsg.GetMessage();
+      if (mstr && *mstr)
+      {
+        OnOSCTimedMessage(rmsg, timetag);
+      }
+    }
+  }
+  
+  void OnTimer(Timer& timer)
+  {
+    if(mInputProc)
+      mInputProc();
+    
+    if (mProcessIncomingOnTimer)
+      ProcessIncoming();
     
     if(mOutputProc)
       mOutputProc();
@@ -471,8 +488,11 @@ protected:
   WDL_FastString results;
   std::function<void()> mInputProc = nullptr;
   std::function<void()> mOutputProc = nullptr;
-  WDL_HeapBuf m_incoming_events;  // incomingEvent list, each is 8-byte aligned
-  WDL_Mutex m_incoming_events_mutex;
+  static const int INCOMING_BUFFER_SIZE = 65536*8;
+  static const int MAX_INCOMING_PACKET_SIZE = 16384;
+  IPlugQueue<char> m_incoming_events {INCOMING_BUFFER_SIZE}; // lock-free ring of packets, each an int length followed by the data
+  char m_incoming_packet[MAX_INCOMING_PACKET_SIZE]; // the packet being dispatched, since OscMessageRead writes over its buffer
+  std::atomic<bool> mProcessIncomingOnTimer {true};
   static const int DEVICE_INDEX_BASE = 0x400000;
 };
 
@@ -502,6 +522,290 @@ public:
   }
 };
 
+/** Dispatches OSC messages to handlers registered by address pattern. The patterns are compiled into a trie of address parts, in which literal parts are found
+ * through a hash table, so dispatching a message costs about as much as its address is long, however many handlers there are. OSC wildcards (?, *, [abc], [!a-z]
+ * and {foo,bar}) are supported both in the registered patterns and in the addresses of incoming messages.
+ * Register handlers before messages arrive, or on the thread that dispatches them */
+class OSCDispatchTrie
+{
+public:
+  /** Called with a message that matches the handler's pattern, and the timetag of its bundle. Several handlers can match one message,
+   * so read the arguments with OscMessageRead::GetIndexedArg() or by peeking, rather than by popping them */
+  using HandlerFunc = std::function<void(OscMessageRead& msg, uint64_t timetag)>;
+  
+  /** Called with a parameter index and the first argument of a message that matches a pattern bound to the parameter */
+  using ParamFunc = std::function<void(int paramIdx, double value, uint64_t timetag)>;
+  
+  /** Register a handler
+   * @param pattern An OSC address, which may contain wildcards, e.g. "/mixer/fader/[1-8]" */
+  void AddHandler(const char* pattern, HandlerFunc func)
+  {
+    Find(pattern)->handlers.push_back({std::move(func), kNoParameter});
+  }
+  
+  /** Bind an address pattern to a parameter. The first argument of a matching message, a float or an int, is passed to the ParamFunc set with SetParamFunc()
+   * @param pattern An OSC address, which may contain wildcards
+   * @param paramIdx The parameter index */
+  void AddParam(const char* pattern, int paramIdx)
+  {
+    Find(pattern)->handlers.push_back({nullptr, paramIdx});
+  }
+  
+  /** @param func Called for the parameters bound with AddParam() */
+  void SetParamFunc(ParamFunc func) { mParamFunc = std::move(func); }
+  
+  /** Remove every handler and parameter binding */
+  void Clear() { mRoot = Node(); }
+  
+  /** Call the handlers whose patterns match the message's address
+   * @return The number of handlers called */
+  int Dispatch(OscMessageRead& msg, uint64_t timetag)
+  {
+    const char* address = msg.GetMessage();
+    
+    if (!address || *address != '/')
+      return 0;
+    
+    return Dispatch(mRoot, address + 1, msg, timetag);
+  }
+  
+  /** Match an OSC address part against a pattern part
+   * @param pattern The pattern, which may contain OSC wildcards, but not '/'
+   * @param str The string to match */
+  static bool Match(const char* pattern, const char* patternEnd, const char* str, const char* strEnd)
+  {
+    while (pattern < patternEnd)
+    {
+      switch (*pattern)
+      {
+        case '*':
+        {
+          while (pattern < patternEnd && *pattern == '*')
+            pattern++;
+          
+          if (pattern == patternEnd)
+            return true;
+          
+          for (const char* s = str; s <= strEnd; s++)
+          {
+            if (Match(pattern, patternEnd, s, strEnd))
+              return true;
+          }
+          
+          return false;
+        }
+        case '?':
+          if (str == strEnd)
+            return false;
+          
+          pattern++;
+          str++;
+          break;
+        case '[':
+        {
+          if (str == strEnd)
+            return false;
+          
+          pattern++;
+          const bool negate = pattern < patternEnd && *pattern == '!';
+          bool found = false;
+          
+          if (negate)
+            pattern++;
+          
+          for (; pattern < patternEnd && *pattern != ']'; pattern++)
+          {
+            if (pattern + 2 < patternEnd && pattern[1] == '-' && pattern[2] != ']')
+            {
+              found |= *str >= pattern[0] && *str <= pattern[2];
+              pattern += 2;
+            }
+            else
+              found |= *str == *pattern;
+          }
+          
+          if (found == negate)
+            return false;
+          
+          pattern++; // ']'
+          str++;
+          break;
+        }
+        case '{':
+        {
+          const char* close = static_cast<const char*>(memchr(pattern, '}', patternEnd - pattern));
+          
+          if (!close)
+            return false;
+          
+          for (const char* option = pattern + 1; option <= close; )
+          {
+            const char* optionEnd = option;
+            
+            while (optionEnd < close && *optionEnd != ',')
+              optionEnd++;
+            
+            const size_t len = optionEnd - option;
+            
+            if (static_cast<size_t>(strEnd - str) >= len && !memcmp(option, str, len) && Match(close + 1, patternEnd, str + len, strEnd))
+              return true;
+            
+            option = optionEnd + 1;
+          }
+          
+          return false;
+        }
+        default:
+          if (str == strEnd || *pattern != *str)
+            return false;
+          
+          pattern++;
+          str++;
+          break;
+      }
+    }
+    
+    return str == strEnd;
+  }
+  
+private:
+  struct Handler
+  {
+    HandlerFunc func;
+    int paramIdx;
+  };
+  
+  struct Node
+  {
+    std::unordered_map<std::string, std::unique_ptr<Node>> literals;
+    std::vector<std::pair<std::string, std::unique_ptr<Node>>> patterns;
+    std::vector<Handler> handlers;
+  };
+  
+  static bool HasWildcards(const char* str, const char* end)
+  {
+    for (; str < end; str++)
+    {
+      if (strchr("?*[]{}", *str))
+        return true;
+    }
+    
+    return false;
+  }
+  
+  /** Find or make the node for a pattern */
+  Node* Find(const char* pattern)
+  {
+    Node* pNode = &mRoot;
+    
+    if (*pattern == '/')
+      pattern++;
+    
+    while (*pattern)
+    {
+      const char* end = strchr(pattern, '/');
+      
+      if (!end)
+        end = pattern + strlen(pattern);
+      
+      std::string part(pattern, end);
+      std::unique_ptr<Node>* ppChild = nullptr;
+      
+      if (HasWildcards(pattern, end))
+      {
+        for (auto& child : pNode->patterns)
+        {
+          if (child.first == part)
+            ppChild = &child.second;
+        }
+        
+        if (!ppChild)
+        {
+          pNode->patterns.emplace_back(std::move(part), nullptr);
+          ppChild = &pNode->patterns.back().second;
+        }
+      }
+      else
+        ppChild = &pNode->literals[part];
+      
+      if (!*ppChild)
+        *ppChild = std::make_unique<Node>();
+      
+      pNode = ppChild->get();
+      pattern = *end ? end + 1 : end;
+    }
+    
+    return pNode;
+  }
+  
+  int Dispatch(Node& node, const char* address, OscMessageRead& msg, uint64_t timetag)
+  {
+    if (!*address)
+    {
+      for (auto& handler : node.handlers)
+        Call(handler, msg, timetag);
+      
+      return static_cast<int>(node.handlers.size());
+    }
+    
+    const char* end = strchr(address, '/');
+    
+    if (!end)
+      end = address + strlen(address);
+    
+    const char* next = *end ? end + 1 : end;
+    int nCalled = 0;
+    
+    if (HasWildcards(address, end))
+    {
+      // the message's address is itself a pattern, so it has to be matched against every part
+      for (auto& child : node.literals)
+      {
+        if (Match(address, end, child.first.c_str(), child.first.c_str() + child.first.size()))
+          nCalled += Dispatch(*child.second, next, msg, timetag);
+      }
+    }
+    else
+    {
+      mPart.assign(address, end); // reuses the string's storage, so dispatching doesn't allocate once it has grown
+      auto it = node.literals.find(mPart);
+      
+      if (it != node.literals.end())
+        nCalled += Dispatch(*it->second, next, msg, timetag);
+    }
+    
+    for (auto& child : node.patterns)
+    {
+      if (Match(child.first.c_str(), child.first.c_str() + child.first.size(), address, end))
+        nCalled += Dispatch(*child.second, next, msg, timetag);
+    }
+    
+    return nCalled;
+  }
+  
+  void Call(Handler& handler, OscMessageRead& msg, uint64_t timetag)
+  {
+    if (handler.func)
+    {
+      handler.func(msg, timetag);
+    }
+    else if (mParamFunc)
+    {
+      char type = 0;
+      const void* pArg = msg.GetIndexedArg(0, &type);
+      
+      if (pArg && type == 'f')
+        mParamFunc(handler.paramIdx, *static_cast<const float*>(pArg), timetag);
+      else if (pArg && type == 'i')
+        mParamFunc(handler.paramIdx, *static_cast<const int*>(pArg), timetag);
+    }
+  }
+  
+  Node mRoot;
+  ParamFunc mParamFunc;
+  std::string mPart;
+};
+
 class OSCReciever : public OSCInterface
 {
 public:
@@ -526,37 +830,224 @@ public:
     };
   }
   
-  virtual void OnOSCMessage(OscMessageRead& msg) = 0;
+  virtual void OnOSCMessage(OscMessageRead& msg) {}
+  
+  /** Dispatches the message to the handlers registered with AddHandler() and AddParam(), or to OnOSCMessage() if none match */
+  void OnOSCTimedMessage(OscMessageRead& msg, uint64_t timetag) override
+  {
+    if (!mDispatch.Dispatch(msg, timetag))
+      OnOSCMessage(msg);
+  }
+  
+  /** Register a handler for messages whose address matches a pattern, see OSCDispatchTrie::AddHandler() */
+  void AddHandler(const char* pattern, OSCDispatchTrie::HandlerFunc func) { mDispatch.AddHandler(pattern, std::move(func)); }
+  
+  /** Bind an address pattern to a parameter, see OSCDispatchTrie::AddParam() */
+  void AddParam(const char* pattern, int paramIdx) { mDispatch.AddParam(pattern, paramIdx); }
+  
+  /** @param func Called with the values of the parameters bound with AddParam(), e.g. to call IPlugAPIBase::SetParameterValue() */
+  void SetParamFunc(OSCDispatchTrie::ParamFunc func) { mDispatch.SetParamFunc(std::move(func)); }
   
 private:
   char mReadBuf[MAX_OSC_MSG_LEN] = {};
+  OSCDispatchTrie mDispatch;
 };
 
-//static
-void OSCInterface::MessageCallback(void *d1, int dev_idx, char type, int len, void *msg)
+/** Schedules events from timestamped OSC bundles into the audio timeline, so that they happen at the sample their timetag refers to,
+ * rather than at the next timer tick after they arrive. Events are converted from OSC on the timer thread, e.g. in OSCInterface::OnOSCTimedMessage(),
+ * and passed to the audio thread through a lock-free queue. The audio thread relates the wall clock to its blocks, smoothing out callback jitter,
+ * and delivers each event in the block that contains its time, with the sample offset within that block. Events that are late,
+ * or have the immediate timetag, are delivered at the start of the next block
+ * @code
+ * void OnOSCTimedMessage(OscMessageRead& msg, uint64_t timetag) override
+ * {
+ *   IMidiMsg midi;
+ *   midi.MakeNoteOnMsg(*msg.PopIntArg(false), 127, 0);
+ *   mScheduler.Schedule(timetag, midi);
+ * }
+ *
+ * void ProcessBlock(sample** inputs, sample** outputs, int nFrames) override
+ * {
+ *   mScheduler.Process(nFrames, GetSampleRate(), [&](IMidiMsg& midi, int offset) { midi.mOffset = offset; mSynth.AddMidiMsgToQueue(midi); });
+ *   ...
+ * }
+ * @endcode
+ * @tparam T The event type, which must be trivially copyable, e.g. IMidiMsg */
+template <typename T>
+class OSCScheduler
 {
-  OSCInterface* _this  = (OSCInterface *) d1;
+public:
+  /** @param capacity The maximum number of events that can be queued or waiting for their time */
+  OSCScheduler(int capacity = 1024)
+  : mQueue(capacity)
+  , mCapacity(capacity)
+  {
+    mPending.Resize(capacity);
+    mPending.Resize(0, false);
+  }
+  
+  OSCScheduler(const OSCScheduler&) = delete;
+  OSCScheduler& operator=(const OSCScheduler&) = delete;
+  
+  /** @return The current wall clock time as an NTP timetag */
+  static uint64_t Now()
+  {
+    using namespace std::chrono;
+    const int64_t ns = duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+    const uint64_t seconds = static_cast<uint64_t>(ns / 1000000000) + kNTPUnixOffset;
+    const uint64_t fraction = (static_cast<uint64_t>(ns % 1000000000) << 32) / 1000000000;
+    return (seconds << 32) | fraction;
+  }
+  
+  /** Queue an event for the audio thread. Call this from a single thread, e.g. the OSC timer
+   * @param timetag The NTP time at which the event should happen
+   * @return \c false if the queue is full */
+  bool Schedule(uint64_t timetag, const T& event)
+  {
+    return mQueue.Push({timetag, event});
+  }
   
-  if (_this && msg)
+  /** Deliver the events that are due in this block. Call this at the start of each block, on the audio thread
+   * @param nFrames The number of frames in the block
+   * @param sampleRate The sample rate
+   * @param func Called as func(T& event, int sampleOffset) for each event that is due, in time order */
+  template <typename F>
+  void Process(int nFrames, double sampleRate, F&& func)
   {
-    if (_this->m_incoming_events.GetSize() < 65536*8)
+    UpdateBlockTime(nFrames, sampleRate);
+    
+    Event event;
+    
+    while (mQueue.Pop(event))
     {
-      const int this_sz = ((sizeof(incomingEvent) + (len-3)) + 7) & ~7;
-      
-      _this->m_incoming_events_mutex.Enter();
-      const int oldsz = _this->m_incoming_events.GetSize();
-      _this->m_incoming_events.Resize(oldsz + this_sz,false);
-      
-      if (_this->m_incoming_events.GetSize() == oldsz+this_sz)
+      if (mPending.GetSize() == mCapacity)
       {
-        incomingEvent *item=(incomingEvent *) ((char *)_this->m_incoming_events.Get() + oldsz);
-        item->dev_ptr = _this->m_devs.Get(dev_idx);
-        item->sz = len;
-        item->type = type;
-        memcpy(item->msg,msg,len);
+        func(event.event, 0); // nowhere to wait, better early than never
+        continue;
       }
-      _this->m_incoming_events_mutex.Leave();
+      
+      // keep the pending events in time order, events usually arrive in order so this rarely moves anything
+      int i = mPending.GetSize();
+      mPending.Resize(i + 1, false);
+      Event* pPending = mPending.Get();
+      
+      for (; i > 0 && pPending[i - 1].timetag > event.timetag; i--)
+        pPending[i] = pPending[i - 1];
+      
+      pPending[i] = event;
+    }
+    
+    Event* pPending = mPending.Get();
+    const int nPending = mPending.GetSize();
+    int nDue = 0;
+    
+    for (; nDue < nPending; nDue++)
+    {
+      const int offset = ToSampleOffset(pPending[nDue].timetag, sampleRate);
+      
+      if (offset >= nFrames)
+        break;
+      
+      func(pPending[nDue].event, std::max(offset, 0));
+    }
+    
+    if (nDue)
+    {
+      memmove(pPending, pPending + nDue, (nPending - nDue) * sizeof(Event));
+      mPending.Resize(nPending - nDue, false);
+    }
+  }
+  
+  /** Forget the events that are waiting, e.g. when the transport stops. Audio thread only */
+  void Clear()
+  {
+    Event event;
+    while (mQueue.Pop(event)) {}
+    mPending.Resize(0, false);
+  }
+  
+private:
+  /** Seconds between the NTP epoch (1900) and the Unix epoch (1970) */
+  static constexpr uint64_t kNTPUnixOffset = 2208988800ull;
+  /** Larger differences between the predicted and actual block time are treated as a discontinuity */
+  static constexpr double kMaxDriftSeconds = 0.1;
+  
+  struct Event
+  {
+    uint64_t timetag;
+    T event;
+  };
+  
+  /** Estimates the wall clock time at the start of the block. Callbacks arrive with jitter, so the estimate follows the clock slowly,
+   * advancing by the length of each block in between */
+  void UpdateBlockTime(int nFrames, double sampleRate)
+  {
+    const uint64_t now = Now();
+    
+    if (!mBlockTimetag)
+    {
+      mBlockTimetag = now;
+    }
+    else
+    {
+      const uint64_t predicted = mBlockTimetag + SecondsToTimetag(mLastBlockFrames / sampleRate);
+      const double error = static_cast<double>(static_cast<int64_t>(now - predicted)) / 4294967296.;
+      
+      if (std::abs(error) > kMaxDriftSeconds)
+        mBlockTimetag = now;
+      else
+        mBlockTimetag = predicted + static_cast<int64_t>(error * 0.0625 * 4294967296.);
     }
+    
+    mLastBlockFrames = nFrames;
+  }
+  
+  int ToSampleOffset(uint64_t timetag, double sampleRate) const
+  {
+    if (timetag <= OSC_TIMETAG_IMMEDIATE)
+      return 0;
+    
+    const double seconds = static_cast<double>(static_cast<int64_t>(timetag - mBlockTimetag)) / 4294967296.;
+    return static_cast<int>(std::floor(std::min(std::max(seconds * sampleRate, -1.), 1e9)));
+  }
+  
+  static uint64_t SecondsToTimetag(double seconds) { return static_cast<uint64_t>(seconds * 4294967296.); }
+  
+  IPlugQueue<Event> mQueue;
+  WDL_TypedBuf<Event> mPending;
+  int mCapacity;
+  uint64_t mBlockTimetag = 0;
+  int mLastBlockFrames = 0;
+};
+
+//static
+void OSCInterface::MessageCallback(void *d1, int dev_idx, char type, int len, void *msg)
+{
+  OSCInterface* _this  = (OSCInterface *) d1;
+  
+  if (_this && msg && len > 0 && len <= MAX_INCOMING_PACKET_SIZE)
+  {
+    IPlugQueue<char>::Span<char> span = _this->m_incoming_events.WriteSpan(sizeof(int) + len);
+    
+    if (span.Size() < sizeof(int) + len)
+      return; // full, the packet is dropped rather than waiting for the consumer
+    
+    const char* pLen = (const char*) &len;
+    size_t pos = 0;
+    
+    for (size_t i = 0; i < sizeof(int); i++)
+      span[pos++] = pLen[i];
+    
+    // copy the data in at most two pieces, either side of the end of the ring
+    const size_t size1 = pos < span.size1 ? std::min(span.size1 - pos, (size_t) len) : 0;
+    
+    if (size1)
+      memcpy(span.pData1 + pos, msg, size1);
+    
+    if (size1 < (size_t) len)
+      memcpy(&span[pos + size1], (const char*) msg + size1, len - size1);
+    
+    _this->m_incoming_events.CommitWrite(sizeof(int) + len);
   }
 }
 
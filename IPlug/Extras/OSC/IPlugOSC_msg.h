@@ -23,6 +23,9 @@ BEGIN_IPLUG_NAMESPACE
 
 #define MAX_OSC_MSG_LEN 1024
 
+/** The NTP timetag that means "now" in an OSC bundle, also used for messages that aren't in a bundle */
+#define OSC_TIMETAG_IMMEDIATE 1ull
+
 static void OSC_BSWAPINTMEM(void *buf)
 {
   char *p=(char *)buf;
@@ -10,7 +10,12 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
 #include "IPlugPlatform.h"
+#include "IPlugConstants.h"
 
 BEGIN_IPLUG_NAMESPACE
 
@@ -74,6 +79,61 @@ public:
     IOscillator<T>::mPhase = IOscillator<T>::mPhase + IOscillator<T>::mPhaseIncr;
     return std::sin(IOscillator<T>::mPhase * PI * 2.);
   }
+
+  /** Render a block at the frequency set by SetFreqCPS(), equivalent to calling Process() nFrames times */
+  void ProcessBlock(T* pOutput, int nFrames)
+  {
+    const double phase = IOscillator<T>::mPhase;
+    const double phaseIncr = IOscillator<T>::mPhaseIncr;
+
+    // each phase is computed from the start of the block rather than accumulated, so the loop has no dependency between samples
+    for (auto s = 0; s < nFrames; s++)
+      pOutput[s] = static_cast<T>(std::sin((phase + (s + 1) * phaseIncr) * PI * 2.));
+
+    IOscillator<T>::mPhase = WrapPhase(phase + nFrames * phaseIncr);
+  }
+
+  /** Render a block with a frequency for each sample, equivalent to calling Process(freqHz) nFrames times
+   * @param pFreqCPS The frequency in Hz of each sample
+   * @param pOutput The output buffer
+   * @param nFrames The number of samples to render */
+  void ProcessBlock(const T* pFreqCPS, T* pOutput, int nFrames)
+  {
+    const double sampleRateReciprocal = IOscillator<T>::mSampleRateReciprocal;
+    double phase = IOscillator<T>::mPhase;
+    double phases[kChunkSize];
+
+    for (auto start = 0; start < nFrames; start += kChunkSize)
+    {
+      const int n = std::min(kChunkSize, nFrames - start);
+
+      // accumulate the phases in double first, so that the sin() loop can be vectorised
+      for (auto s = 0; s < n; s++)
+      {
+        phase += pFreqCPS[start + s] * sampleRateReciprocal;
+        phases[s] = phase;
+      }
+
+      for (auto s = 0; s < n; s++)
+        pOutput[start + s] = static_cast<T>(std::sin(phases[s] * PI * 2.));
+
+      phase = WrapPhase(phase);
+    }
+
+    if (nFrames)
+      IOscillator<T>::SetFreqCPS(pFreqCPS[nFrames - 1]);
+
+    IOscillator<T>::mPhase = WrapPhase(phase);
+  }
+
+private:
+  static inline double WrapPhase(double phase)
+  {
+    // keep the phase small, so that it does not lose precision over a long run
+    return phase - std::floor(phase);
+  }
+
+  static const int kChunkSize = 64;
 };
 
 /*
@@ -175,40 +235,91 @@ public:
     return f1 + frac * (f2 - f1);
   }
 
+  /** Render a block at the frequency set by SetFreqCPS() */
   void ProcessBlock(T* pOutput, int nFrames)
   {
-    double phase = IOscillator<T>::mPhase + (double) UNITBIT32;
-    const double phaseIncr = IOscillator<T>::mPhaseIncr * tableSize;
-
-    union tabfudge tf;
-    tf.d = UNITBIT32;
-    const int normhipart = tf.i[HIOFFSET];
+    const uint32_t phaseIncr = IncrToFixed(IOscillator<T>::mPhaseIncr);
+    uint32_t phase = ToFixed(IOscillator<T>::mPhase);
 
+    // each phase is computed from the start of the block rather than accumulated, so the loop has no dependency between samples
     for (auto s = 0; s < nFrames; s++)
+      pOutput[s] = Interpolate(phase + static_cast<uint32_t>(s) * phaseIncr);
+
+    phase += static_cast<uint32_t>(nFrames) * phaseIncr;
+
+    if (nFrames)
+      mLastOutput = pOutput[nFrames - 1];
+
+    IOscillator<T>::mPhase = FromFixed(phase);
+  }
+
+  /** Render a block with a frequency for each sample
+   * @param pFreqCPS The frequency in Hz of each sample
+   * @param pOutput The output buffer
+   * @param nFrames The number of samples to render */
+  void ProcessBlock(const T* pFreqCPS, T* pOutput, int nFrames)
+  {
+    const double sampleRateReciprocal = IOscillator<T>::mSampleRateReciprocal;
+    uint32_t phase = ToFixed(IOscillator<T>::mPhase);
+    uint32_t phases[kChunkSize];
+
+    for (auto start = 0; start < nFrames; start += kChunkSize)
     {
-      tf.d = phase;
-      phase += phaseIncr;
-      const T* addr = mLUT + (tf.i[HIOFFSET] & tableSizeM1); // Obtain the integer portion
-      tf.i[HIOFFSET] = normhipart; // Force the double to wrap.
-      const double frac = tf.d - UNITBIT32;
-      const T f1 = addr[0];
-      const T f2 = addr[1];
-      mLastOutput = pOutput[s] = T(f1 + frac * (f2 - f1));
+      const int n = std::min(kChunkSize, nFrames - start);
+
+      // the phase accumulation is a cheap serial integer add, the table lookups after it can be vectorised
+      for (auto s = 0; s < n; s++)
+      {
+        phases[s] = phase;
+        phase += IncrToFixed(pFreqCPS[start + s] * sampleRateReciprocal);
+      }
+
+      for (auto s = 0; s < n; s++)
+        pOutput[start + s] = Interpolate(phases[s]);
     }
 
-    // Restore mPhase
-    tf.d = UNITBIT32 * tableSize;
-    const int normhipart2 = tf.i[HIOFFSET];
-    tf.d = phase + (UNITBIT32 * tableSize - UNITBIT32); // Remove the offset we introduced at the start of UNITBIT32.
-    tf.i[HIOFFSET] = normhipart2;
-    IOscillator<T>::mPhase = tf.d - UNITBIT32 * tableSize;
+    if (nFrames)
+    {
+      IOscillator<T>::SetFreqCPS(pFreqCPS[nFrames - 1]);
+      mLastOutput = pOutput[nFrames - 1];
+    }
+
+    IOscillator<T>::mPhase = FromFixed(phase);
   }
 
   T mLastOutput = 0.;
 private:
   static const int tableSize = 512; // 2^9
   static const int tableSizeM1 = 511; // 2^9 -1
+  static const int kFracBits = 23; // 32 bit phase, the top 9 bits index the table
+  static const int kChunkSize = 64;
   static const T mLUT[513];
+
+  // mPhase is in table units, the block methods work on a 32 bit fixed point fraction of a cycle that wraps on overflow
+  static inline uint32_t ToFixed(double tablePhase)
+  {
+    const double phase = tablePhase / tableSize;
+    return static_cast<uint32_t>(static_cast<int64_t>((phase - std::floor(phase)) * 4294967296.));
+  }
+
+  static inline uint32_t IncrToFixed(double phaseIncr)
+  {
+    return static_cast<uint32_t>(static_cast<int64_t>(phaseIncr * 4294967296.));
+  }
+
+  static inline double FromFixed(uint32_t phase)
+  {
+    return phase * (tableSize / 4294967296.);
+  }
+
+  static inline T Interpolate(uint32_t phase)
+  {
+    const T* addr = mLUT + (phase >> kFracBits);
+    const T frac = static_cast<T>((phase & ((1u << kFracBits) - 1)) * (1. / (1u << kFracBits)));
+    const T f1 = addr[0];
+    const T f2 = addr[1];
+    return f1 + frac * (f2 - f1);
+  }
 } ALIGNED(8);
 
 #include "Oscillator_table.h"
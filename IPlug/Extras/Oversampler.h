@@ -11,12 +11,19 @@
 #pragma once
 
 #define OVERSAMPLING_FACTORS_VA_LIST "None", "2x", "4x", "8x", "16x"
+#define OVERSAMPLING_QUALITIES_VA_LIST "Draft", "Normal", "High"
 
+#include <algorithm>
+#include <cassert>
 #include <functional>
 #include <cmath>
+#include <memory>
+#include <type_traits>
 
 #include "HIIR/FPUUpsampler2x.h"
 #include "HIIR/FPUDownsampler2x.h"
+#include "HIIR/LaneUpsampler2x.h"
+#include "HIIR/LaneDownsampler2x.h"
 //#include "HIIR/PolyphaseIIR2Designer.h"
 
 #include "heapbuf.h"
@@ -38,79 +45,51 @@ enum EFactor
   kNumFactors
 };
 
+/** Resampling filter presets, trading stopband attenuation against CPU.
+ * Draft rejects aliases by roughly 70dB, Normal by 100dB and High by 140dB */
+enum EOverSamplingQuality
+{
+  kOSQualityDraft = 0,
+  kOSQualityNormal,
+  kOSQualityHigh,
+  kNumOSQualities
+};
+
 template<typename T = double>
 class OverSampler
 {
 public:
   using BlockProcessFunc = std::function<void(T**, T**, int)>;
-  
-  OverSampler(EFactor factor = kNone, bool blockProcessing = true, int nChannels = 1)
-  : mBlockProcessing(blockProcessing)
-  , mNChannels(nChannels)
-  {
-    for (auto c = 0; c < mNChannels; c++)
-    {
-      mUpsampler2x.Add(new Upsampler2xFPU<12, T>());
-      mDownsampler2x.Add(new Downsampler2xFPU<12, T>());
-      mUpsampler4x.Add(new Upsampler2xFPU<4, T>());
-      mDownsampler4x.Add(new Downsampler2xFPU<4, T>());
-      mUpsampler8x.Add(new Upsampler2xFPU<3, T>());
-      mDownsampler8x.Add(new Downsampler2xFPU<3, T>());
-      mUpsampler16x.Add(new Upsampler2xFPU<2, T>());
-      mDownsampler16x.Add(new Downsampler2xFPU<2, T>());
-      
-      static constexpr double coeffs2x[12] = { 0.036681502163648017, 0.13654762463195794, 0.27463175937945444, 0.42313861743656711, 0.56109869787919531, 0.67754004997416184, 0.76974183386322703, 0.83988962484963892, 0.89226081800387902, 0.9315419599631839, 0.96209454837808417, 0.98781637073289585 };
-      
-//    PolyphaseIir2Designer::compute_coefs(coeffs2x, 96., 0.01);
 
-//    printf("coeffs2x\n");
-//
-//    for(int i=0;i<12;i++)
-//      printf("%.17g,\n", coeffs2x[i]);
+  /** The number of channels that ProcessBlock() resamples at once, one per SIMD lane */
+  static constexpr int kNLanes = 4;
 
-      mUpsampler2x.Get(c)->set_coefs(coeffs2x);
-      mDownsampler2x.Get(c)->set_coefs(coeffs2x);
-      
-      
-      static constexpr double coeffs4x[4] = {0.041893991997656171, 0.16890348243995201, 0.39056077292116603, 0.74389574826847926 };
-  
-  //    PolyphaseIir2Designer::compute_coefs(coeffs4x, 96., 0.255);
-  
-  //    printf("coeffs4x\n");
-  //
-  //    for(int i=0;i<4;i++)
-  //      printf("%.17g,\n", coeffs4x[i]);
-  
-      mUpsampler4x.Get(c)->set_coefs(coeffs4x);
-      mDownsampler4x.Get(c)->set_coefs(coeffs4x);
+  /** The fewest channels in a group for the lane resamplers to be faster than resampling each channel with the FPU stages */
+  static constexpr int kMinLaneChans = 3;
   
-      static constexpr double coeffs8x[3] = {0.055748680811302048, 0.24305119574153072, 0.64669913119268196 };
+  /** The number of 2x stages needed for 16x */
+  static constexpr int kMaxStages = 4;
   
-  //  PolyphaseIir2Designer::compute_coefs(coeffs8x, 96., 0.3775);
-  
-  //    printf("coeffs8x\n");
-  //
-  //    for(int i=0;i<3;i++)
-  //      printf("%.17g,\n", coeffs8x[i]);
-  
-      mUpsampler8x.Get(c)->set_coefs(coeffs8x);
-      mDownsampler8x.Get(c)->set_coefs(coeffs8x);
-  
-      static constexpr double coeffs16x[2] = {0.10717745346023573, 0.53091435354504557 };
-  
-  //    PolyphaseIir2Designer::compute_coefs(coeffs16x, 96., 0.43865);
-  
-  //    printf("coeffs16x\n");
-  //
-  //    for(int i=0;i<2;i++)
-  //      printf("%.17g,\n", coeffs16x[i]);
-  
-      mUpsampler16x.Get(c)->set_coefs(coeffs16x);
-      mDownsampler16x.Get(c)->set_coefs(coeffs16x);
+  /** @param factor The initial oversampling factor
+   * @param blockProcessing Set false if the OverSampler will only be used per-sample, with Process() or ProcessGen()
+   * @param nChannels The maximum number of channels to process
+   * @param quality The initial resampling filter quality, see SetQuality()
+   * @param floatFilters Run the resampling filters in single precision, see SetFloatFilters() */
+  OverSampler(EFactor factor = kNone, bool blockProcessing = true, int nChannels = 1, EOverSamplingQuality quality = kOSQualityNormal, bool floatFilters = false)
+  : mQuality(quality)
+  , mFloatFilters(floatFilters)
+  , mBlockProcessing(blockProcessing)
+  , mNChannels(nChannels)
+  , mSampleChains(new StageChains<1>)
+  {
+    for (auto c = 0; c < mNChannels; c += kNLanes)
+    {
+      mLaneGroups.Add(new StageChains<kNLanes>);
     }
-    
+
     for (auto c = 0; c < mNChannels; c++)
     {
+      mChannelChains.Add(new StageChains<1>);
       mNextInputPtrs.Add(mUp2x.Get()); // ptr location doesn't matter at this stage
       mNextOutputPtrs.Add(mDown2x.Get());
     }
@@ -122,14 +101,8 @@ public:
   
   ~OverSampler()
   {
-    mUpsampler2x.Empty(true);
-    mDownsampler2x.Empty(true);
-    mUpsampler4x.Empty(true);
-    mDownsampler4x.Empty(true);
-    mUpsampler8x.Empty(true);
-    mDownsampler8x.Empty(true);
-    mUpsampler16x.Empty(true);
-    mDownsampler16x.Empty(true);
+    mLaneGroups.Empty(true);
+    mChannelChains.Empty(true);
   }
 
   OverSampler(const OverSampler&) = delete;
@@ -169,17 +142,10 @@ public:
     mDown4BufferPtrs.Empty();
     mDown2BufferPtrs.Empty();
     
+    ClearFilters();
+
     for (auto c = 0; c < mNChannels; c++)
     {
-      mUpsampler2x.Get(c)->clear_buffers();
-      mUpsampler4x.Get(c)->clear_buffers();
-      mUpsampler8x.Get(c)->clear_buffers();
-      mUpsampler16x.Get(c)->clear_buffers();
-      mDownsampler2x.Get(c)->clear_buffers();
-      mDownsampler4x.Get(c)->clear_buffers();
-      mDownsampler8x.Get(c)->clear_buffers();
-      mDownsampler16x.Get(c)->clear_buffers();
-      
       mUp2BufferPtrs.Add(mUp2x.Get() + c * 2 * blockSize);
       mUp4BufferPtrs.Add(mUp4x.Get() + (c * 4 * blockSize));
       mUp8BufferPtrs.Add(mUp8x.Get() + (c * 8 * blockSize));
@@ -227,30 +193,13 @@ public:
       mPrevRate = mRate;
     }
 
-    if (mRate >= 2) {
-      for(auto c = 0; c < nChans; c++) {
-        mUpsampler2x.Get(c)->process_block(mUp2BufferPtrs.Get(c), inputs[c], nFrames);
-      }
-    }
-    
-    if (mRate >= 4) {
-      for(auto c = 0; c < nChans; c++) {
-        mUpsampler4x.Get(c)->process_block(mUp4BufferPtrs.Get(c), mUp2BufferPtrs.Get(c), nFrames * 2);
-      }
-    }
-    
-    if (mRate >= 8) {
-      for(auto c = 0; c < nChans; c++) {
-        mUpsampler8x.Get(c)->process_block(mUp8BufferPtrs.Get(c), mUp4BufferPtrs.Get(c), nFrames * 4);
-      }
-    }
-    
-    if (mRate == 16) {
-      for(auto c = 0; c < nChans; c++) {
-        mUpsampler16x.Get(c)->process_block(mUp16BufferPtrs.Get(c), mUp8BufferPtrs.Get(c), nFrames * 8);
-      }
+    for (int c = 0, nGroupChans = 0; c < nChans; c += nGroupChans)
+    {
+      T** upPtrs[kMaxStages] = { mUp2BufferPtrs.GetList() + c, mUp4BufferPtrs.GetList() + c, mUp8BufferPtrs.GetList() + c, mUp16BufferPtrs.GetList() + c };
+      nGroupChans = GetGroupNChans(c, nChans);
+      GetGroupChain(c, nGroupChans).Upsample(upPtrs, inputs + c, mNStages, nGroupChans, nFrames);
     }
-    
+
     if (mRate == 1) {
       func(inputs, outputs, nFrames);
     }
@@ -264,28 +213,11 @@ public:
       }
     }
     
-    if (mRate == 16) {
-      for(auto c = 0; c < nChans; c++) {
-        mDownsampler16x.Get(c)->process_block(mDown8BufferPtrs.Get(c), mDown16BufferPtrs.Get(c), nFrames * 8);
-      }
-    }
-    
-    if (mRate >= 8) {
-      for(auto c = 0; c < nChans; c++) {
-        mDownsampler8x.Get(c)->process_block(mDown4BufferPtrs.Get(c), mDown8BufferPtrs.Get(c), nFrames * 4);
-      }
-    }
-    
-    if (mRate >= 4) {
-      for(auto c = 0; c < nChans; c++) {
-        mDownsampler4x.Get(c)->process_block(mDown2BufferPtrs.Get(c), mDown4BufferPtrs.Get(c), nFrames * 2);
-      }
-    }
-    
-    if (mRate >= 2) {
-      for(auto c = 0; c < nChans; c++) {
-        mDownsampler2x.Get(c)->process_block(outputs[c], mDown2BufferPtrs.Get(c), nFrames);
-      }
+    for (int c = 0, nGroupChans = 0; c < nChans; c += nGroupChans)
+    {
+      T** downPtrs[kMaxStages] = { mDown2BufferPtrs.GetList() + c, mDown4BufferPtrs.GetList() + c, mDown8BufferPtrs.GetList() + c, mDown16BufferPtrs.GetList() + c };
+      nGroupChans = GetGroupNChans(c, nChans);
+      GetGroupChain(c, nGroupChans).Downsample(outputs + c, downPtrs, mNStages, nGroupChans, nFrames);
     }
   }
   
@@ -295,188 +227,460 @@ public:
    * @return The audio sample output */
   T Process(T input, std::function<T(T)> func)
   {
+    if (mRate == 1)
+      return func(input);
+    
+    T* ups[kMaxStages] = { mUp2x.Get(), mUp4x.Get(), mUp8x.Get(), mUp16x.Get() };
+    T* downs[kMaxStages] = { mDown2x.Get(), mDown4x.Get(), mDown8x.Get(), mDown16x.Get() };
+    T** upPtrs[kMaxStages] = { &ups[0], &ups[1], &ups[2], &ups[3] };
+    T** downPtrs[kMaxStages] = { &downs[0], &downs[1], &downs[2], &downs[3] };
+    IStageChain& chain = mSampleChains->Get(mQuality, mFloatFilters);
+    
+    T* pInput = &input;
+    chain.Upsample(upPtrs, &pInput, mNStages, 1, 1);
+
+    for (auto i = 0; i < mRate; i++)
+    {
+      downs[mNStages - 1][i] = func(ups[mNStages - 1][i]);
+    }
+
     T output;
+    T* pOutput = &output;
+    chain.Downsample(&pOutput, downPtrs, mNStages, 1, 1);
+
+    return output;
+  }
+
+  /** Over-sample an per-sample synthesis function
+   * @param genFunc The function that generates the audio sample
+   * @return The audio sample output */
+  T ProcessGen(std::function<T()> genFunc)
+  {
+    if (mRate == 1)
+      return genFunc();
+    
+    T* downs[kMaxStages] = { mDown2x.Get(), mDown4x.Get(), mDown8x.Get(), mDown16x.Get() };
+    T** downPtrs[kMaxStages] = { &downs[0], &downs[1], &downs[2], &downs[3] };
 
-    if(mRate == 16)
+    for (auto i = 0; i < mRate; i++)
     {
-      mUpsampler2x.Get(0)->process_sample(mUp2x.Get()[0], mUp2x.Get()[1], input);
-      mUpsampler4x.Get(0)->process_block(mUp4x.Get(), mUp2x.Get(), 2);
-      mUpsampler8x.Get(0)->process_block(mUp8x.Get(), mUp4x.Get(), 4);
-      mUpsampler16x.Get(0)->process_block(mUp16x.Get(), mUp8x.Get(), 8);
+      downs[mNStages - 1][i] = genFunc();
+    }
 
-      for (auto i = 0; i < 16; i++)
-      {
-        mDown16x.Get()[i] = func(mUp16x.Get()[i]);
-      }
+    T output;
+    T* pOutput = &output;
+    mSampleChains->Get(mQuality, mFloatFilters).Downsample(&pOutput, downPtrs, mNStages, 1, 1);
+
+    return output;
+  }
 
-      mDownsampler16x.Get(0)->process_block(mDown8x.Get(), mDown16x.Get(), 8);
-      mDownsampler8x.Get(0)->process_block(mDown4x.Get(), mDown8x.Get(), 4);
-      mDownsampler4x.Get(0)->process_block(mDown2x.Get(), mDown4x.Get(), 2);
-      output = mDownsampler2x.Get(0)->process_sample(mDown2x.Get());
+  void SetOverSampling(EFactor factor)
+  {
+    if(factor != mFactor)
+    {
+      mFactor = factor;
+      mNStages = (int) factor;
+      mRate = 1 << mNStages;
+      
+      Reset();
+    }
+  }
+  
+  /** Choose the resampling filters. This is allocation free, so it can be switched on the audio thread,
+   * e.g. Draft for live use and High when GetRenderingOffline() is true. The filter memory is cleared on a change
+   * and GetLatency() may change, so the plug-in should report the new latency with SetLatency() */
+  void SetQuality(EOverSamplingQuality quality)
+  {
+    if(quality != mQuality)
+    {
+      mQuality = quality;
+      ClearFilters();
+    }
+  }
+  
+  EOverSamplingQuality GetQuality() const { return mQuality; }
+  
+  /** Run the resampling filters in single precision, even if T is double. This processes twice as many channels per SIMD
+   * register, at the cost of a noise floor around -140dB. Allocation free, the filter memory is cleared on a change */
+  void SetFloatFilters(bool floatFilters)
+  {
+    if(floatFilters != mFloatFilters)
+    {
+      mFloatFilters = floatFilters;
+      ClearFilters();
     }
-    else if (mRate == 8)
+  }
+  
+  bool GetFloatFilters() const { return mFloatFilters; }
+  
+  /** @return The delay added by the resampling filters at the current factor and quality, in samples at the base rate.
+   * The filters are minimum phase, so this is the group delay at low frequencies */
+  int GetLatency() const
+  {
+    return (int) std::round(mSampleChains->Get(mQuality, mFloatFilters).GetLatency(mNStages));
+  }
+  
+  static EFactor RateToFactor(int rate)
+  {
+    switch (rate)
     {
-      mUpsampler2x.Get(0)->process_sample(mUp2x.Get()[0], mUp2x.Get()[1], input);
-      mUpsampler4x.Get(0)->process_block(mUp4x.Get(), mUp2x.Get(), 2);
-      mUpsampler8x.Get(0)->process_block(mUp8x.Get(), mUp4x.Get(), 4);
+      case 1: return EFactor::kNone;
+      case 2: return EFactor::k2x;
+      case 4: return EFactor::k4x;
+      case 8: return EFactor::k8x;
+      case 16: return EFactor::k16x;
+      default: assert(0); return EFactor::kNone;
+    }
+  }
+  
+  int GetRate()
+  {
+    return mRate;
+  }
 
-      for (auto i = 0; i < 8; i++)
-      {
-        mDown8x.Get()[i] = func(mUp8x.Get()[i]);
-      }
+private:
+  // Each quality is a set of coefficients for the 2x, 4x, 8x and 16x stages, computed with PolyphaseIir2Designer::compute_coefs_spec_order_tbw().
+  // Later stages can have wider transition bands, since the earlier stages have already removed the top of their spectrum
+  static constexpr double kDraftCoeffs2x[6] = { 0.068204076045056364, 0.24027035797224575, 0.44867623592608163, 0.64112236714554882, 0.79999756368992903, 0.93448223553476439 }; // 0.04, 74dB
+  static constexpr double kDraftCoeffs4x[3] = { 0.069335046640009834, 0.28259198284381387, 0.68240339734172106 }; // 0.255, 91dB
+  static constexpr double kDraftCoeffs8x[2] = { 0.11219797897669925, 0.54027875192498487 }; // 0.3775, 95dB
+  static constexpr double kDraftCoeffs16x[1] = { 0.33645554842683073 }; // 0.43865, 73dB
+
+  static constexpr double kCoeffs2x[12] = { 0.036681502163648017, 0.13654762463195794, 0.27463175937945444, 0.42313861743656711, 0.56109869787919531, 0.67754004997416184, 0.76974183386322703, 0.83988962484963892, 0.89226081800387902, 0.9315419599631839, 0.96209454837808417, 0.98781637073289585 };
+  static constexpr double kCoeffs4x[4] = {0.041893991997656171, 0.16890348243995201, 0.39056077292116603, 0.74389574826847926 };
+  static constexpr double kCoeffs8x[3] = {0.055748680811302048, 0.24305119574153072, 0.64669913119268196 };
+  static constexpr double kCoeffs16x[2] = {0.10717745346023573, 0.53091435354504557 };
+
+  static constexpr double kHighCoeffs2x[16] = { 0.021274801903768466, 0.081597780905902612, 0.17163632098387976, 0.27910816644651831, 0.39196028503945063, 0.50062442942383301, 0.59891254401020544, 0.6838132915011228, 0.75472347754895752, 0.81257167392137952, 0.85908849282499389, 0.89630380512193342, 0.92625336148456439, 0.9508423666001653, 0.97181354832609768, 0.99078076615435162 }; // 0.01, 140dB
+  static constexpr double kHighCoeffs4x[6] = { 0.020064796406425996, 0.080457435089742277, 0.18236294761605376, 0.32979572611121966, 0.53308854475674061, 0.81539991256177258 }; // 0.255, 174dB
+  static constexpr double kHighCoeffs8x[4] = { 0.033368824360094466, 0.14033320650913481, 0.34611020894171052, 0.71334599251309128 }; // 0.3775, 176dB
+  static constexpr double kHighCoeffs16x[3] = { 0.052977654137171495, 0.23462600255471941, 0.63860799164168958 }; // 0.43865, 178dB
+
+  // A cascade of 2x resamplers for up to kNLanes channels, from the base rate up to 16x and back
+  class IStageChain
+  {
+  public:
+    virtual ~IStageChain() {}
+    
+    /** upPtrs[s] are the channel buffers that stage s writes to, at 2^(s+1) times the base rate */
+    virtual void Upsample(T** upPtrs[kMaxStages], T** inputs, int nStages, int nChans, int nFrames) = 0;
+    
+    /** downPtrs[s] are the channel buffers that stage s reads from, at 2^(s+1) times the base rate */
+    virtual void Downsample(T** outputs, T** downPtrs[kMaxStages], int nStages, int nChans, int nFrames) = 0;
+    
+    virtual void Clear() = 0;
+    
+    /** @return The group delay at DC of nStages up and down stages, in samples at the base rate */
+    double GetLatency(int nStages) const
+    {
+      double latency = 0.;
+      
+      // each 2x up or down sampler delays by mStageDelay[s] samples at the higher rate
+      for (auto s = 0; s < nStages; s++)
+        latency += 2. * mStageDelay[s] / (double) (2 << s);
+      
+      return latency;
+    }
+    
+  protected:
+    // Each coefficient is a first order allpass section in one of the two polyphase branches, which run at the lower rate.
+    // The odd branch is one sample later at the higher rate, and at DC the filter's delay is the mean of the two branches
+    void SetStageDelay(int stage, const double* coefs, int nCoefs)
+    {
+      double delay[2] = { 0., 1. };
+      
+      for (auto i = 0; i < nCoefs; i++)
+        delay[i & 1] += 2. * (1. - coefs[i]) / (1. + coefs[i]);
+      
+      mStageDelay[stage] = 0.5 * (delay[0] + delay[1]);
+    }
+    
+    double mStageDelay[kMaxStages] = {};
+  };
 
-      mDownsampler8x.Get(0)->process_block(mDown4x.Get(), mDown8x.Get(), 4);
-      mDownsampler4x.Get(0)->process_block(mDown2x.Get(), mDown4x.Get(), 2);
-      output = mDownsampler2x.Get(0)->process_sample(mDown2x.Get());
+  // S is the filter sample type, which can be float when T is double
+  template <typename S, int NL, int NC2, int NC4, int NC8, int NC16>
+  class StageChain final : public IStageChain
+  {
+  public:
+    StageChain(const double* coeffs2x, const double* coeffs4x, const double* coeffs8x, const double* coeffs16x)
+    {
+      mUpsampler2x.set_coefs(coeffs2x);
+      mDownsampler2x.set_coefs(coeffs2x);
+      mUpsampler4x.set_coefs(coeffs4x);
+      mDownsampler4x.set_coefs(coeffs4x);
+      mUpsampler8x.set_coefs(coeffs8x);
+      mDownsampler8x.set_coefs(coeffs8x);
+      mUpsampler16x.set_coefs(coeffs16x);
+      mDownsampler16x.set_coefs(coeffs16x);
+      this->SetStageDelay(0, coeffs2x, NC2);
+      this->SetStageDelay(1, coeffs4x, NC4);
+      this->SetStageDelay(2, coeffs8x, NC8);
+      this->SetStageDelay(3, coeffs16x, NC16);
     }
-    else if (mRate == 4)
+    
+    void Upsample(T** upPtrs[kMaxStages], T** inputs, int nStages, int nChans, int nFrames) override
     {
-      mUpsampler2x.Get(0)->process_sample(mUp2x.Get()[0], mUp2x.Get()[1], input);
-      mUpsampler4x.Get(0)->process_block(mUp4x.Get(), mUp2x.Get(), 2);
+      if (nStages >= 1)
+        mUpsampler2x.process_block(upPtrs[0], inputs, nChans, nFrames);
 
-      for (auto i = 0; i < 4; i++)
-      {
-        mDown4x.Get()[i] = func(mUp4x.Get()[i]);
-      }
+      if (nStages >= 2)
+        mUpsampler4x.process_block(upPtrs[1], upPtrs[0], nChans, nFrames * 2);
 
-      mDownsampler4x.Get(0)->process_block(mDown2x.Get(), mDown4x.Get(), 2);
-      output = mDownsampler2x.Get(0)->process_sample(mDown2x.Get());
+      if (nStages >= 3)
+        mUpsampler8x.process_block(upPtrs[2], upPtrs[1], nChans, nFrames * 4);
+
+      if (nStages == 4)
+        mUpsampler16x.process_block(upPtrs[3], upPtrs[2], nChans, nFrames * 8);
     }
-    else if (mRate == 2)
+    
+    void Downsample(T** outputs, T** downPtrs[kMaxStages], int nStages, int nChans, int nFrames) override
     {
-      mUpsampler2x.Get(0)->process_sample(mUp2x.Get()[0], mUp2x.Get()[1], input);
+      if (nStages == 4)
+        mDownsampler16x.process_block(downPtrs[2], downPtrs[3], nChans, nFrames * 8);
+
+      if (nStages >= 3)
+        mDownsampler8x.process_block(downPtrs[1], downPtrs[2], nChans, nFrames * 4);
 
-      mDown2x.Get()[0] = func(mUp2x.Get()[0]);
-      mDown2x.Get()[1] = func(mUp2x.Get()[1]);
-      output = mDownsampler2x.Get(0)->process_sample(mDown2x.Get());
+      if (nStages >= 2)
+        mDownsampler4x.process_block(downPtrs[0], downPtrs[1], nChans, nFrames * 2);
+
+      if (nStages >= 1)
+        mDownsampler2x.process_block(outputs, downPtrs[0], nChans, nFrames);
     }
-    else
+    
+    void Clear() override
     {
-      output = func(input);
+      mUpsampler2x.clear_buffers();
+      mUpsampler4x.clear_buffers();
+      mUpsampler8x.clear_buffers();
+      mUpsampler16x.clear_buffers();
+      mDownsampler2x.clear_buffers();
+      mDownsampler4x.clear_buffers();
+      mDownsampler8x.clear_buffers();
+      mDownsampler16x.clear_buffers();
     }
-
-    return output;
-  }
-
-  /** Over-sample an per-sample synthesis function
-   * @param genFunc The function that generates the audio sample
-   * @return The audio sample output */
-  T ProcessGen(std::function<T()> genFunc)
+    
+  private:
+    Upsampler2xLanes<NC2, S, NL, T> mUpsampler2x;     // for 1x to 2x SR
+    Upsampler2xLanes<NC4, S, NL, T> mUpsampler4x;     // for 2x to 4x SR
+    Upsampler2xLanes<NC8, S, NL, T> mUpsampler8x;     // for 4x to 8x SR
+    Upsampler2xLanes<NC16, S, NL, T> mUpsampler16x;   // for 8x to 16x SR
+    Downsampler2xLanes<NC2, S, NL, T> mDownsampler2x;   // decimator for 2x to 1x SR
+    Downsampler2xLanes<NC4, S, NL, T> mDownsampler4x;   // decimator for 4x to 2x SR
+    Downsampler2xLanes<NC8, S, NL, T> mDownsampler8x;   // decimator for 8x to 4x SR
+    Downsampler2xLanes<NC16, S, NL, T> mDownsampler16x; // decimator for 16x to 8x SR
+  };
+  
+  // One channel through the scalar FPU resamplers, which are faster than the lane resamplers for one or two channels
+  template <typename S, int NC2, int NC4, int NC8, int NC16>
+  class FPUStageChain final : public IStageChain
   {
-    auto ProcessDown16x = [&](T input)
+  public:
+    FPUStageChain(const double* coeffs2x, const double* coeffs4x, const double* coeffs8x, const double* coeffs16x)
+    {
+      mUpsampler2x.set_coefs(coeffs2x);
+      mDownsampler2x.set_coefs(coeffs2x);
+      mUpsampler4x.set_coefs(coeffs4x);
+      mDownsampler4x.set_coefs(coeffs4x);
+      mUpsampler8x.set_coefs(coeffs8x);
+      mDownsampler8x.set_coefs(coeffs8x);
+      mUpsampler16x.set_coefs(coeffs16x);
+      mDownsampler16x.set_coefs(coeffs16x);
+      this->SetStageDelay(0, coeffs2x, NC2);
+      this->SetStageDelay(1, coeffs4x, NC4);
+      this->SetStageDelay(2, coeffs8x, NC8);
+      this->SetStageDelay(3, coeffs16x, NC16);
+    }
+
+    void Upsample(T** upPtrs[kMaxStages], T** inputs, int nStages, int nChans, int nFrames) override
     {
-      mDown16x.Get()[mWritePos] = (T) input;
+      assert(nChans == 1);
 
-      mWritePos++;
-      mWritePos &= 15;
+      if (nFrames <= 0)
+        return;
 
-      if(mWritePos == 0)
-      {
-        mDownsampler16x.process_block(mDown8x.Get(), mDown16x.Get(), 8);
-        mDownsampler8x.process_block(mDown4x.Get(), mDown8x.Get(), 4);
-        mDownsampler4x.process_block(mDown2x.Get(), mDown4x.Get(), 2);
-        mDownSamplerOutput = mDownsampler2x.process_sample(mDown2x.Get());
-      }
-    };
+      if (nStages >= 1)
+        Upsample(mUpsampler2x, upPtrs[0][0], inputs[0], nFrames, IsSameType());
 
-    auto ProcessDown8x = [&](T input)
-    {
-      mDown8x.Get()[mWritePos] = (T) input;
+      if (nStages >= 2)
+        Upsample(mUpsampler4x, upPtrs[1][0], upPtrs[0][0], nFrames * 2, IsSameType());
 
-      mWritePos++;
-      mWritePos &= 7;
+      if (nStages >= 3)
+        Upsample(mUpsampler8x, upPtrs[2][0], upPtrs[1][0], nFrames * 4, IsSameType());
 
-      if(mWritePos == 0)
-      {
-        mDownsampler8x.process_block(mDown4x.Get(), mDown8x.Get(), 4);
-        mDownsampler4x.process_block(mDown2x.Get(), mDown4x.Get(), 2);
-        mDownSamplerOutput = mDownsampler2x.process_sample(mDown2x.Get());
-      }
-    };
+      if (nStages == 4)
+        Upsample(mUpsampler16x, upPtrs[3][0], upPtrs[2][0], nFrames * 8, IsSameType());
+    }
 
-    auto ProcessDown4x = [&](T input)
+    void Downsample(T** outputs, T** downPtrs[kMaxStages], int nStages, int nChans, int nFrames) override
     {
-      mDown4x.Get()[mWritePos] = (T) input;
+      assert(nChans == 1);
 
-      mWritePos++;
-      mWritePos &= 3;
+      if (nFrames <= 0)
+        return;
 
-      if(mWritePos == 0)
-      {
-        mDownsampler4x.process_block(mDown2x.Get(), mDown4x.Get(), 2);
-        mDownSamplerOutput = mDownsampler2x.process_sample(mDown2x.Get());
-      }
-    };
+      if (nStages == 4)
+        Downsample(mDownsampler16x, downPtrs[2][0], downPtrs[3][0], nFrames * 8, IsSameType());
+
+      if (nStages >= 3)
+        Downsample(mDownsampler8x, downPtrs[1][0], downPtrs[2][0], nFrames * 4, IsSameType());
+
+      if (nStages >= 2)
+        Downsample(mDownsampler4x, downPtrs[0][0], downPtrs[1][0], nFrames * 2, IsSameType());
+
+      if (nStages >= 1)
+        Downsample(mDownsampler2x, outputs[0], downPtrs[0][0], nFrames, IsSameType());
+    }
 
-    auto ProcessDown2x = [&](T input)
+    void Clear() override
     {
-      mDown2x.Get()[mWritePos] = (T) input;
+      mUpsampler2x.clear_buffers();
+      mUpsampler4x.clear_buffers();
+      mUpsampler8x.clear_buffers();
+      mUpsampler16x.clear_buffers();
+      mDownsampler2x.clear_buffers();
+      mDownsampler4x.clear_buffers();
+      mDownsampler8x.clear_buffers();
+      mDownsampler16x.clear_buffers();
+    }
+
+  private:
+    using IsSameType = typename std::is_same<S, T>::type;
 
-      mWritePos = !mWritePos;
+    // the resamplers run on a local copy, so that the compiler can keep the filter state in registers rather than storing
+    // it on every sample in case the buffers alias it
+    template <typename R>
+    static void Upsample(R& resampler, T* pOutput, const T* pInput, int nFrames, std::true_type)
+    {
+      R local = resampler;
+      local.process_block(pOutput, pInput, nFrames);
+      resampler = local;
+    }
 
-      if(mWritePos == 0)
+    // float filters with double buffers, converted a sample at a time
+    template <typename R>
+    static void Upsample(R& resampler, T* pOutput, const T* pInput, int nFrames, std::false_type)
+    {
+      R local = resampler;
+
+      for (auto i = 0; i < nFrames; i++)
       {
-        mDownSamplerOutput = mDownsampler2x.process_sample(mDown2x.Get());
+        S out0, out1;
+        local.process_sample(out0, out1, static_cast<S>(pInput[i]));
+        pOutput[i * 2] = static_cast<T>(out0);
+        pOutput[i * 2 + 1] = static_cast<T>(out1);
       }
-    };
 
-    T output;
+      resampler = local;
+    }
+
+    template <typename R>
+    static void Downsample(R& resampler, T* pOutput, const T* pInput, int nFrames, std::true_type)
+    {
+      R local = resampler;
+      local.process_block(pOutput, pInput, nFrames);
+      resampler = local;
+    }
 
-    for (int j = 0; j < mRate; j++)
+    template <typename R>
+    static void Downsample(R& resampler, T* pOutput, const T* pInput, int nFrames, std::false_type)
     {
-      output = genFunc();
+      R local = resampler;
 
-      switch(mRate)
+      for (auto i = 0; i < nFrames; i++)
       {
-        case 2: ProcessDown2x(output); break;
-        case 4: ProcessDown4x(output); break;
-        case 8: ProcessDown8x(output); break;
-        case 16: ProcessDown16x(output); break;
-        default: break;
+        const S in[2] = { static_cast<S>(pInput[i * 2]), static_cast<S>(pInput[i * 2 + 1]) };
+        pOutput[i] = static_cast<T>(local.process_sample(in));
       }
-    }
-
-    if(mRate > 1)
-      output = mDownSamplerOutput;
 
-    return output;
-  }
+      resampler = local;
+    }
 
-  void SetOverSampling(EFactor factor)
+    Upsampler2xFPU<NC2, S> mUpsampler2x;
+    Upsampler2xFPU<NC4, S> mUpsampler4x;
+    Upsampler2xFPU<NC8, S> mUpsampler8x;
+    Upsampler2xFPU<NC16, S> mUpsampler16x;
+    Downsampler2xFPU<NC2, S> mDownsampler2x;
+    Downsampler2xFPU<NC4, S> mDownsampler4x;
+    Downsampler2xFPU<NC8, S> mDownsampler8x;
+    Downsampler2xFPU<NC16, S> mDownsampler16x;
+  };
+
+  // A single channel uses the FPU resamplers, more channels the lane resamplers
+  template <typename S, int NL, int NC2, int NC4, int NC8, int NC16>
+  using StageChainFor = typename std::conditional<NL == 1, FPUStageChain<S, NC2, NC4, NC8, NC16>, StageChain<S, NL, NC2, NC4, NC8, NC16>>::type;
+
+  // The stage chains for NL channels in every quality and filter precision, all allocated up front so that switching is allocation free
+  template <int NL>
+  struct StageChains
   {
-    if(factor != mFactor)
+    StageChains()
     {
-      mFactor = factor;
-      mRate = std::pow(2, (int) factor);
-      
-      Reset();
+      Create<T>(mChains[0]);
+      Create<float>(mChains[1]);
     }
-  }
+    
+    template <typename S>
+    void Create(std::unique_ptr<IStageChain> chains[kNumOSQualities])
+    {
+      chains[kOSQualityDraft].reset(new StageChainFor<S, NL, 6, 3, 2, 1>(kDraftCoeffs2x, kDraftCoeffs4x, kDraftCoeffs8x, kDraftCoeffs16x));
+      chains[kOSQualityNormal].reset(new StageChainFor<S, NL, 12, 4, 3, 2>(kCoeffs2x, kCoeffs4x, kCoeffs8x, kCoeffs16x));
+      chains[kOSQualityHigh].reset(new StageChainFor<S, NL, 16, 6, 4, 3>(kHighCoeffs2x, kHighCoeffs4x, kHighCoeffs8x, kHighCoeffs16x));
+    }
+    
+    IStageChain& Get(EOverSamplingQuality quality, bool floatFilters) const
+    {
+      return *mChains[floatFilters ? 1 : 0][quality];
+    }
+    
+    void Clear()
+    {
+      for (auto p = 0; p < 2; p++)
+        for (auto q = 0; q < kNumOSQualities; q++)
+          mChains[p][q]->Clear();
+    }
+    
+    std::unique_ptr<IStageChain> mChains[2][kNumOSQualities];
+  };
   
-  static EFactor RateToFactor(int rate)
+  void ClearFilters()
   {
-    switch (rate)
+    mSampleChains->Clear();
+    
+    for (auto g = 0; g < mLaneGroups.GetSize(); g++)
     {
-      case 1: return EFactor::kNone;
-      case 2: return EFactor::k2x;
-      case 4: return EFactor::k4x;
-      case 8: return EFactor::k8x;
-      case 16: return EFactor::k16x;
-      default: assert(0); return EFactor::kNone;
+      mLaneGroups.Get(g)->Clear();
+    }
+
+    for (auto c = 0; c < mChannelChains.GetSize(); c++)
+    {
+      mChannelChains.Get(c)->Clear();
     }
   }
-  
-  int GetRate()
+
+  /** @return The number of channels from chIdx that ProcessBlock() resamples together: a group of kNLanes channels
+   * in the lane resamplers, or a single channel if its group is too small for the lanes to be faster */
+  int GetGroupNChans(int chIdx, int nChans) const
   {
-    return mRate;
+    const int nGroupChans = std::min(kNLanes, nChans - chIdx);
+    return nGroupChans >= kMinLaneChans ? nGroupChans : 1;
+  }
+
+  IStageChain& GetGroupChain(int chIdx, int nGroupChans) const
+  {
+    if (nGroupChans == 1)
+      return mChannelChains.Get(chIdx)->Get(mQuality, mFloatFilters);
+    else
+      return mLaneGroups.Get(chIdx / kNLanes)->Get(mQuality, mFloatFilters);
   }
 
-private:
   EFactor mFactor = kNone;
+  EOverSamplingQuality mQuality = kOSQualityNormal;
+  bool mFloatFilters = false;
   int mPrevRate = 0;
   int mRate = 1;
-  int mWritePos = 0;
-  T mDownSamplerOutput = 0.;
+  int mNStages = 0;
   bool mBlockProcessing; // false
   int mNChannels; // 1
   
@@ -509,16 +713,27 @@ private:
   WDL_PtrList<T>* mInPtrLoopSrc = nullptr;
   WDL_PtrList<T>* mOutPtrLoopSrc = nullptr;
   
-  //Ptrs to oversamplers for each channel
-  WDL_PtrList<Upsampler2xFPU<12, T>> mUpsampler2x; // for 1x to 2x SR
-  WDL_PtrList<Upsampler2xFPU<4, T>> mUpsampler4x;  // for 2x to 4x SR
-  WDL_PtrList<Upsampler2xFPU<3, T>> mUpsampler8x;  // for 4x to 8x SR
-  WDL_PtrList<Upsampler2xFPU<2, T>> mUpsampler16x; // for 8x to 16x SR
-
-  WDL_PtrList<Downsampler2xFPU<12, T>> mDownsampler2x; // decimator for 2x to 1x SR
-  WDL_PtrList<Downsampler2xFPU<4, T>> mDownsampler4x;  // decimator for 4x to 2x SR
-  WDL_PtrList<Downsampler2xFPU<3, T>> mDownsampler8x;  // decimator for 8x to 4x SR
-  WDL_PtrList<Downsampler2xFPU<2, T>> mDownsampler16x; // decimator for 16x to 8x SR
+  //Resamplers for Process() and ProcessGen(), one channel
+  std::unique_ptr<StageChains<1>> mSampleChains;
+
+  //Multi-channel resamplers for each group of kNLanes channels (block processing)
+  WDL_PtrList<StageChains<kNLanes>> mLaneGroups;
+
+  //Single channel resamplers for the channels in groups smaller than kMinLaneChans (block processing)
+  WDL_PtrList<StageChains<1>> mChannelChains;
 };
 
+template<typename T> constexpr double OverSampler<T>::kDraftCoeffs2x[6];
+template<typename T> constexpr double OverSampler<T>::kDraftCoeffs4x[3];
+template<typename T> constexpr double OverSampler<T>::kDraftCoeffs8x[2];
+template<typename T> constexpr double OverSampler<T>::kDraftCoeffs16x[1];
+template<typename T> constexpr double OverSampler<T>::kCoeffs2x[12];
+template<typename T> constexpr double OverSampler<T>::kCoeffs4x[4];
+template<typename T> constexpr double OverSampler<T>::kCoeffs8x[3];
+template<typename T> constexpr double OverSampler<T>::kCoeffs16x[2];
+template<typename T> constexpr double OverSampler<T>::kHighCoeffs2x[16];
+template<typename T> constexpr double OverSampler<T>::kHighCoeffs4x[6];
+template<typename T> constexpr double OverSampler<T>::kHighCoeffs8x[4];
+template<typename T> constexpr double OverSampler<T>::kHighCoeffs16x[3];
+
 END_IPLUG_NAMESPACE
@@ -0,0 +1,725 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc ProcessGraph
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+#include "IPlugPlatform.h"
+#include "IPlugConstants.h"
+#include "IPlugWorkerPool.h"
+#include "NChanDelay.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** The kind of signal a graph port carries. Ports can only be connected to ports of the same type and channel count.
+ * Both are sample buffers, control ports are a single channel of modulation */
+enum EGraphPortType
+{
+  kAudioPort = 0,
+  kControlPort
+};
+
+/** A processor in a ProcessGraph. Declare the ports in the constructor with AddInput() and AddOutput().
+ * ProcessBlock() may be called on any of the graph's threads, but never on two at once for the same node.
+ * @tparam T The sample type */
+template <typename T = sample>
+class GraphNode
+{
+public:
+  struct Port
+  {
+    EGraphPortType type;
+    int nChans;
+    int firstChan; // index of the port's first channel in the inputs or outputs of ProcessBlock()
+  };
+
+  virtual ~GraphNode() {}
+
+  /** Called by ProcessGraph::Compile(), before GetLatency() is queried. Allocate here, not in ProcessBlock() */
+  virtual void OnReset(double sampleRate, int maxBlockSize) {}
+
+  /** @return The latency of the node in samples. Parallel paths through the graph are delayed to line up */
+  virtual int GetLatency() const { return 0; }
+
+  /** Process a block. The channels of every port are concatenated in port order, see Port::firstChan.
+   * Input buffers are read only and may be shared with other nodes, unconnected inputs are silent.
+   * @param inputs The input channel buffers
+   * @param outputs The output channel buffers, which must all be written
+   * @param nFrames The number of samples */
+  virtual void ProcessBlock(T** inputs, T** outputs, int nFrames) = 0;
+
+  int NInputs() const { return static_cast<int>(mInputs.size()); }
+  int NOutputs() const { return static_cast<int>(mOutputs.size()); }
+  const Port& GetInput(int idx) const { return mInputs[idx]; }
+  const Port& GetOutput(int idx) const { return mOutputs[idx]; }
+  int NInputChans() const { return mNInputChans; }
+  int NOutputChans() const { return mNOutputChans; }
+
+protected:
+  /** @return The index of the new input port */
+  int AddInput(EGraphPortType type, int nChans)
+  {
+    mInputs.push_back({ type, nChans, mNInputChans });
+    mNInputChans += nChans;
+    return NInputs() - 1;
+  }
+
+  /** @return The index of the new output port */
+  int AddOutput(EGraphPortType type, int nChans)
+  {
+    mOutputs.push_back({ type, nChans, mNOutputChans });
+    mNOutputChans += nChans;
+    return NOutputs() - 1;
+  }
+
+private:
+  std::vector<Port> mInputs;
+  std::vector<Port> mOutputs;
+  int mNInputChans = 0;
+  int mNOutputChans = 0;
+};
+
+/** A graph of GraphNodes, for products whose signal flow is too complex to hard code in ProcessBlock(), such as multi-band processors or modular synths.
+ * Compile() sorts the nodes, plans the buffers and adds delays between parallel paths of different latency, then ProcessBlock() runs
+ * independent branches on the threads of the IWorkerPool.
+ *
+ * Several connections into one input port are summed. Buffers are shared between node outputs whose lifetimes can't overlap: a buffer
+ * is only reused by a node that depends on every node that wrote or read it before, so reuse is safe whichever thread runs what.
+ *
+ * Ready nodes are taken from a shared queue by whichever thread is free, the audio thread included, so a late or parked worker
+ * costs parallelism, never a dropout.
+ *
+ * Node 0 (kInputNode) has one output port with the graph's input channels, node 1 (kOutputNode) has one input port with the graph's outputs.
+ * @tparam T The sample type */
+template <typename T = sample>
+class ProcessGraph final : public IWorkerJob
+{
+public:
+  static constexpr int kInputNode = 0;
+  static constexpr int kOutputNode = 1;
+
+  /** Construct the graph, and register it with the IWorkerPool if it uses workers. Call from a non-realtime thread.
+   * @param nInputChans The number of graph input channels
+   * @param nOutputChans The number of graph output channels
+   * @param nWorkers The most worker threads that run nodes at once, in addition to the audio thread. 0 runs every node on the audio thread */
+  ProcessGraph(int nInputChans, int nOutputChans, int nWorkers = 0)
+  : mNWorkers(nWorkers)
+  {
+    mNodes.resize(2);
+    mNodes[kInputNode].mNode.reset(new EndpointNode(0, nInputChans));
+    mNodes[kOutputNode].mNode.reset(new EndpointNode(nOutputChans, 0));
+
+    if (nWorkers > 0)
+    {
+      mPool = IWorkerPool::Acquire();
+      mPool->Register(this);
+    }
+  }
+
+  ~ProcessGraph()
+  {
+    if (mPool)
+      mPool->Unregister(this);
+  }
+
+  ProcessGraph(const ProcessGraph&) = delete;
+  ProcessGraph& operator=(const ProcessGraph&) = delete;
+
+  /** Add a node to the graph. Call Compile() before processing again
+   * @param pNode The node, the graph takes ownership
+   * @return The index of the node, for Connect() */
+  int AddNode(GraphNode<T>* pNode)
+  {
+    mNodes.emplace_back();
+    mNodes.back().mNode.reset(pNode);
+    mCompiled = false;
+    return NNodes() - 1;
+  }
+
+  int NNodes() const { return static_cast<int>(mNodes.size()); }
+
+  GraphNode<T>* GetNode(int nodeIdx) { return mNodes[nodeIdx].mNode.get(); }
+
+  /** Connect an output port to an input port. Call Compile() before processing again
+   * @return \c false if a node or port doesn't exist, or the port types or channel counts differ */
+  bool Connect(int srcNode, int srcPort, int dstNode, int dstPort)
+  {
+    if (srcNode < 0 || srcNode >= NNodes() || dstNode < 0 || dstNode >= NNodes() || srcNode == dstNode)
+      return false;
+
+    const GraphNode<T>& src = *mNodes[srcNode].mNode;
+    const GraphNode<T>& dst = *mNodes[dstNode].mNode;
+
+    if (srcPort < 0 || srcPort >= src.NOutputs() || dstPort < 0 || dstPort >= dst.NInputs())
+      return false;
+
+    if (src.GetOutput(srcPort).type != dst.GetInput(dstPort).type || src.GetOutput(srcPort).nChans != dst.GetInput(dstPort).nChans)
+      return false;
+
+    std::unique_ptr<Connection> pConnection(new Connection);
+    pConnection->mSrcNode = srcNode;
+    pConnection->mSrcPort = srcPort;
+    pConnection->mDstNode = dstNode;
+    pConnection->mDstPort = dstPort;
+    mConnections.push_back(std::move(pConnection));
+    mCompiled = false;
+    return true;
+  }
+
+  /** Reset the nodes, then plan the schedule, buffers and latency compensation. Call from a non-realtime thread, while ProcessBlock() is not running.
+   * Until it has been called after a change to the graph, ProcessBlock() outputs silence
+   * @return \c false if the graph has a cycle */
+  bool Compile(double sampleRate, int maxBlockSize)
+  {
+    mCompiled = false;
+    StopWorkers();
+    mMaxBlockSize = maxBlockSize;
+    const int nNodes = NNodes();
+
+    for (auto& node : mNodes)
+    {
+      node.mNode->OnReset(sampleRate, maxBlockSize);
+      node.mPreds.clear();
+      node.mSuccs.clear();
+      node.mInputPorts.assign(node.mNode->NInputs(), InputPort());
+      node.mOutputSlots.assign(node.mNode->NOutputChans(), -1);
+    }
+
+    for (auto& pConnection : mConnections)
+    {
+      Node& src = mNodes[pConnection->mSrcNode];
+      Node& dst = mNodes[pConnection->mDstNode];
+      dst.mInputPorts[pConnection->mDstPort].mConnections.push_back(pConnection.get());
+
+      if (std::find(dst.mPreds.begin(), dst.mPreds.end(), pConnection->mSrcNode) == dst.mPreds.end())
+      {
+        dst.mPreds.push_back(pConnection->mSrcNode);
+        src.mSuccs.push_back(pConnection->mDstNode);
+      }
+    }
+
+    if (!SortNodes())
+      return false;
+
+    // ancestors[n][a] is true if node a always finishes before node n starts
+    std::vector<std::vector<bool>> ancestors(nNodes, std::vector<bool>(nNodes, false));
+
+    for (auto n : mOrder)
+    {
+      for (auto p : mNodes[n].mPreds)
+      {
+        ancestors[n][p] = true;
+
+        for (auto a = 0; a < nNodes; a++)
+          if (ancestors[p][a])
+            ancestors[n][a] = true;
+      }
+    }
+
+    CompensateLatency(maxBlockSize);
+    PlanBuffers(ancestors);
+
+    mBuffer.assign(static_cast<size_t>(mNSlots + 1) * maxBlockSize, T(0));
+    T* pSilence = mBuffer.data() + static_cast<size_t>(mNSlots) * maxBlockSize; // the last slot is never written
+
+    for (auto& node : mNodes)
+    {
+      node.mInputPtrs.resize(node.mNode->NInputChans());
+      node.mOutputPtrs.resize(node.mNode->NOutputChans());
+
+      for (auto c = 0; c < node.mNode->NOutputChans(); c++)
+        node.mOutputPtrs[c] = node.mOutputSlots[c] >= 0 ? SlotPtr(node.mOutputSlots[c]) : nullptr;
+
+      for (auto p = 0; p < node.mNode->NInputs(); p++)
+      {
+        InputPort& port = node.mInputPorts[p];
+        const typename GraphNode<T>::Port& info = node.mNode->GetInput(p);
+
+        for (auto c = 0; c < info.nChans; c++)
+        {
+          T* pChan = pSilence;
+
+          if (!port.mMixSlots.empty())
+            pChan = SlotPtr(port.mMixSlots[c]);
+          else if (port.mConnections.size() == 1)
+            pChan = ConnectionPtr(*port.mConnections[0], c);
+
+          node.mInputPtrs[info.firstChan + c] = pChan;
+        }
+      }
+    }
+
+    mPending.reset(new std::atomic<int>[nNodes]);
+    mReady.reset(new std::atomic<uint64_t>[nNodes]);
+
+    for (auto n = 0; n < nNodes; n++)
+      mReady[n].store(0);
+
+    mNJobNodes = nNodes;
+    mCompiled = true;
+    return true;
+  }
+
+  /** @return The latency of the graph from its inputs to its outputs, in samples. Valid after Compile() */
+  int GetLatency() const { return mLatency; }
+
+  /** @return The number of channel buffers that the node outputs and summed inputs share, after Compile() */
+  int GetNBuffers() const { return mNSlots; }
+
+  /** @return The memory used by the graph's buffers and delays in bytes */
+  size_t GetMemoryUsage() const
+  {
+    size_t bytes = mBuffer.size() * sizeof(T);
+
+    for (auto& pConnection : mConnections)
+      bytes += pConnection->mDelayed.size() * sizeof(T) + pConnection->mDelay.GetMemoryUsage();
+
+    return bytes;
+  }
+
+  /** Process a block through the graph. Called on the audio thread. Does not allocate or lock.
+   * @param inputs The graph input channels
+   * @param outputs The graph output channels
+   * @param nFrames The number of samples, at most the maxBlockSize passed to Compile() */
+  void ProcessBlock(T** inputs, T** outputs, int nFrames)
+  {
+    const GraphNode<T>& inputNode = *mNodes[kInputNode].mNode;
+    const GraphNode<T>& outputNode = *mNodes[kOutputNode].mNode;
+
+    if (!mCompiled)
+    {
+      for (auto c = 0; c < outputNode.NInputChans(); c++)
+        memset(outputs[c], 0, nFrames * sizeof(T));
+
+      return;
+    }
+
+    assert(nFrames <= mMaxBlockSize);
+
+    const Node& in = mNodes[kInputNode];
+
+    for (auto c = 0; c < inputNode.NOutputChans(); c++)
+    {
+      if (in.mOutputSlots[c] >= 0) // an unused input has no buffer
+        memcpy(in.mOutputPtrs[c], inputs[c], nFrames * sizeof(T));
+    }
+
+    mJobNFrames = nFrames;
+    const uint32_t gen = ++mGeneration;
+    mReadyWrite.store(0, std::memory_order_relaxed);
+    mNodesDone.store(0, std::memory_order_relaxed);
+
+    for (auto n = 0; n < mNJobNodes; n++)
+    {
+      const int nPreds = static_cast<int>(mNodes[n].mPreds.size());
+      mPending[n].store(nPreds, std::memory_order_relaxed);
+
+      if (!nPreds)
+        Push(gen, n);
+    }
+
+    // publishing the claim word hands the block to the workers
+    mClaim.store(static_cast<uint64_t>(gen) << 32, std::memory_order_release);
+    mBlockPending.store(true, std::memory_order_release);
+
+    if (mPool)
+      mPool->Notify();
+
+    RunNodes(gen);
+    mBlockPending.store(false, std::memory_order_relaxed);
+
+    // only nodes already claimed by a worker are still in flight here. They can't be taken back, so wait for them without hogging the core,
+    // and give way to the workers if one has been preempted
+    for (auto spins = 0; mNodesDone.load(std::memory_order_acquire) < mNJobNodes; spins++)
+    {
+      if (spins < kMaxSpins)
+        SpinPause();
+      else
+        std::this_thread::yield();
+    }
+
+    const Node& out = mNodes[kOutputNode];
+
+    for (auto c = 0; c < outputNode.NInputChans(); c++)
+      memcpy(outputs[c], out.mInputPtrs[c], nFrames * sizeof(T));
+  }
+
+  /** The audio thread is waiting for the block, so nodes that haven't been claimed are due immediately */
+  int64_t GetDeadline() const override
+  {
+    return mBlockPending.load(std::memory_order_acquire) ? 0 : kNoWork;
+  }
+
+  bool RunWork(int threadIdx) override
+  {
+    if (threadIdx >= mNWorkers)
+      return false;
+
+    mNActive.fetch_add(1, std::memory_order_acq_rel);
+    const bool didWork = RunNodes(CurrentGeneration());
+    mNActive.fetch_sub(1, std::memory_order_acq_rel);
+    return didWork;
+  }
+
+private:
+  static constexpr int kMaxSpins = 1000; // pauses before a thread yields while waiting for nodes that other threads are running
+
+  // kInputNode and kOutputNode, which only hold the graph's ports. The graph copies their buffers
+  class EndpointNode final : public GraphNode<T>
+  {
+  public:
+    EndpointNode(int nInputChans, int nOutputChans)
+    {
+      if (nInputChans)
+        GraphNode<T>::AddInput(kAudioPort, nInputChans);
+
+      if (nOutputChans)
+        GraphNode<T>::AddOutput(kAudioPort, nOutputChans);
+    }
+
+    void ProcessBlock(T** inputs, T** outputs, int nFrames) override {}
+  };
+
+  struct Connection
+  {
+    int mSrcNode, mSrcPort, mDstNode, mDstPort;
+    NChanDelayLine<T> mDelay;
+    std::vector<T> mDelayed; // the delayed channels, if the connection has a compensation delay
+  };
+
+  struct InputPort
+  {
+    std::vector<Connection*> mConnections;
+    std::vector<int> mMixSlots; // the buffers that several or delayed connections are summed into, otherwise empty
+  };
+
+  struct Node
+  {
+    std::unique_ptr<GraphNode<T>> mNode;
+    std::vector<int> mPreds; // distinct nodes that this node reads from
+    std::vector<int> mSuccs; // distinct nodes that read this node
+    std::vector<InputPort> mInputPorts;
+    std::vector<int> mOutputSlots; // one per output channel
+    std::vector<T*> mInputPtrs;
+    std::vector<T*> mOutputPtrs;
+    int mArrival = 0; // the latency of the paths up to this node's inputs
+  };
+
+  T* SlotPtr(int slot) { return mBuffer.data() + static_cast<size_t>(slot) * mMaxBlockSize; }
+
+  // a connection's channel as the destination reads it, before summing
+  T* ConnectionPtr(Connection& connection, int chan)
+  {
+    if (connection.mDelay.GetDelayTime())
+      return connection.mDelayed.data() + static_cast<size_t>(chan) * mMaxBlockSize;
+
+    const Node& src = mNodes[connection.mSrcNode];
+    return SlotPtr(src.mOutputSlots[src.mNode->GetOutput(connection.mSrcPort).firstChan + chan]);
+  }
+
+  // Kahn's algorithm, which fails if there is a cycle
+  bool SortNodes()
+  {
+    const int nNodes = NNodes();
+    std::vector<int> nPending(nNodes);
+    mOrder.clear();
+
+    for (auto n = 0; n < nNodes; n++)
+    {
+      nPending[n] = static_cast<int>(mNodes[n].mPreds.size());
+
+      if (!nPending[n])
+        mOrder.push_back(n);
+    }
+
+    for (size_t i = 0; i < mOrder.size(); i++)
+    {
+      for (auto s : mNodes[mOrder[i]].mSuccs)
+      {
+        if (--nPending[s] == 0)
+          mOrder.push_back(s);
+      }
+    }
+
+    return static_cast<int>(mOrder.size()) == nNodes;
+  }
+
+  // Each node's inputs arrive at the latency of its slowest input path. Faster paths are delayed to match
+  void CompensateLatency(int maxBlockSize)
+  {
+    for (auto n : mOrder)
+    {
+      Node& node = mNodes[n];
+      node.mArrival = 0;
+
+      for (auto& port : node.mInputPorts)
+        for (auto pConnection : port.mConnections)
+          node.mArrival = std::max(node.mArrival, SourceLatency(*pConnection));
+    }
+
+    for (auto& pConnection : mConnections)
+    {
+      const int nChans = mNodes[pConnection->mSrcNode].mNode->GetOutput(pConnection->mSrcPort).nChans;
+      const int delay = mNodes[pConnection->mDstNode].mArrival - SourceLatency(*pConnection);
+      pConnection->mDelay = NChanDelayLine<T>(nChans, nChans);
+      pConnection->mDelay.SetDelayTime(delay);
+      pConnection->mDelayed.assign(delay ? static_cast<size_t>(nChans) * maxBlockSize : 0, T(0));
+    }
+
+    mLatency = mNodes[kOutputNode].mArrival;
+  }
+
+  int SourceLatency(const Connection& connection) const
+  {
+    const Node& src = mNodes[connection.mSrcNode];
+    return src.mArrival + src.mNode->GetLatency();
+  }
+
+  // Assign a buffer to every output channel and summed input channel, in schedule order. A buffer can be reused by a node once every
+  // node that accessed it is an ancestor of that node
+  void PlanBuffers(const std::vector<std::vector<bool>>& ancestors)
+  {
+    std::vector<std::vector<int>> slotAccessors;
+
+    auto allocate = [&](int nodeIdx, const std::vector<int>& accessors) {
+      for (size_t slot = 0; slot < slotAccessors.size(); slot++)
+      {
+        const std::vector<int>& prev = slotAccessors[slot];
+
+        if (std::all_of(prev.begin(), prev.end(), [&](int a) { return ancestors[nodeIdx][a]; }))
+        {
+          slotAccessors[slot] = accessors;
+          return static_cast<int>(slot);
+        }
+      }
+
+      slotAccessors.push_back(accessors);
+      return static_cast<int>(slotAccessors.size()) - 1;
+    };
+
+    for (auto n : mOrder)
+    {
+      Node& node = mNodes[n];
+      const std::vector<int> self = { n };
+
+      for (auto p = 0; p < node.mNode->NInputs(); p++)
+      {
+        InputPort& port = node.mInputPorts[p];
+        const bool mix = port.mConnections.size() > 1 || (port.mConnections.size() == 1 && port.mConnections[0]->mDelay.GetDelayTime());
+
+        if (mix)
+        {
+          for (auto c = 0; c < node.mNode->GetInput(p).nChans; c++)
+            port.mMixSlots.push_back(allocate(n, self));
+        }
+      }
+
+      for (auto p = 0; p < node.mNode->NOutputs(); p++)
+      {
+        // the buffer stays live until every reader of the port has finished
+        std::vector<int> accessors = self;
+
+        for (auto& pConnection : mConnections)
+        {
+          if (pConnection->mSrcNode == n && pConnection->mSrcPort == p)
+            accessors.push_back(pConnection->mDstNode);
+        }
+
+        if (accessors.size() == 1 && n != kInputNode)
+          accessors.push_back(kOutputNode); // unread outputs are written while other nodes run, so keep them apart until the block ends
+
+        if (n == kInputNode && accessors.size() == 1)
+          continue; // an unused graph input needs no buffer
+
+        const typename GraphNode<T>::Port& info = node.mNode->GetOutput(p);
+
+        for (auto c = 0; c < info.nChans; c++)
+          node.mOutputSlots[info.firstChan + c] = allocate(n, accessors);
+      }
+    }
+
+    mNSlots = static_cast<int>(slotAccessors.size());
+  }
+
+  void Push(uint32_t gen, int nodeIdx)
+  {
+    const int idx = mReadyWrite.fetch_add(1, std::memory_order_relaxed);
+    mReady[idx].store((static_cast<uint64_t>(gen) << 32) | static_cast<uint32_t>(nodeIdx), std::memory_order_release);
+  }
+
+  enum EClaim { kClaimed, kNotReady, kFinished };
+
+  // The claim word packs generation (32 bits) | next ready queue index (32 bits), so a thread that is late can never claim a node from a newer block.
+  // Ready queue entries are stamped with the generation too, so an entry from an older block reads as not ready yet
+  EClaim Claim(uint32_t gen, int& nodeIdx)
+  {
+    uint64_t claim = mClaim.load(std::memory_order_acquire);
+
+    while (true)
+    {
+      if (static_cast<uint32_t>(claim >> 32) != gen)
+        return kFinished;
+
+      const uint32_t next = static_cast<uint32_t>(claim & 0xFFFFFFFF);
+
+      if (next >= static_cast<uint32_t>(mNJobNodes))
+        return kFinished;
+
+      const uint64_t entry = mReady[next].load(std::memory_order_acquire);
+
+      if (static_cast<uint32_t>(entry >> 32) != gen)
+        return kNotReady;
+
+      if (mClaim.compare_exchange_weak(claim, claim + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+      {
+        nodeIdx = static_cast<int>(entry & 0xFFFFFFFF);
+        return kClaimed;
+      }
+    }
+  }
+
+  // run ready nodes until every node of the block has been claimed
+  // @return \c true if any node was run
+  bool RunNodes(uint32_t gen)
+  {
+    int nodeIdx;
+    EClaim result;
+    bool didWork = false;
+
+    while ((result = Claim(gen, nodeIdx)) != kFinished)
+    {
+      if (result == kClaimed)
+      {
+        RunNode(gen, nodeIdx);
+        didWork = true;
+      }
+      else
+        SpinPause();
+    }
+
+    return didWork;
+  }
+
+  void RunNode(uint32_t gen, int nodeIdx)
+  {
+    Node& node = mNodes[nodeIdx];
+    const int nFrames = mJobNFrames;
+
+    for (auto p = 0; p < node.mNode->NInputs(); p++)
+    {
+      InputPort& port = node.mInputPorts[p];
+      const int nChans = node.mNode->GetInput(p).nChans;
+
+      for (auto pConnection : port.mConnections)
+      {
+        if (pConnection->mDelay.GetDelayTime())
+        {
+          T* srcPtrs[kMaxPortChans];
+          T* delayedPtrs[kMaxPortChans];
+          assert(nChans <= kMaxPortChans);
+
+          for (auto c = 0; c < nChans; c++)
+          {
+            const Node& src = mNodes[pConnection->mSrcNode];
+            srcPtrs[c] = SlotPtr(src.mOutputSlots[src.mNode->GetOutput(pConnection->mSrcPort).firstChan + c]);
+            delayedPtrs[c] = ConnectionPtr(*pConnection, c);
+          }
+
+          pConnection->mDelay.ProcessBlock(srcPtrs, delayedPtrs, nFrames);
+        }
+      }
+
+      if (port.mMixSlots.empty())
+        continue;
+
+      for (auto c = 0; c < nChans; c++)
+      {
+        T* pMix = SlotPtr(port.mMixSlots[c]);
+        memset(pMix, 0, nFrames * sizeof(T));
+
+        for (auto pConnection : port.mConnections)
+        {
+          const T* pSrc = ConnectionPtr(*pConnection, c);
+
+          for (auto s = 0; s < nFrames; s++)
+            pMix[s] += pSrc[s];
+        }
+      }
+    }
+
+    node.mNode->ProcessBlock(node.mInputPtrs.data(), node.mOutputPtrs.data(), nFrames);
+
+    for (auto s : node.mSuccs)
+    {
+      if (mPending[s].fetch_sub(1, std::memory_order_acq_rel) == 1)
+        Push(gen, s);
+    }
+
+    mNodesDone.fetch_add(1, std::memory_order_release);
+  }
+
+  uint32_t CurrentGeneration() const
+  {
+    return static_cast<uint32_t>(mClaim.load(std::memory_order_acquire) >> 32);
+  }
+
+  // Publish a generation with nothing to claim, then wait for workers that are still looking at the previous block, so that Compile()
+  // can replace the node state. A worker that arrives later finds nothing to claim without reading it
+  void StopWorkers()
+  {
+    const uint32_t gen = ++mGeneration;
+    mClaim.store((static_cast<uint64_t>(gen) << 32) | 0xFFFFFFFF, std::memory_order_release);
+
+    while (mNActive.load(std::memory_order_acquire) > 0)
+    {
+      std::this_thread::yield();
+    }
+  }
+
+  static constexpr int kMaxPortChans = 64;
+
+  std::vector<Node> mNodes;
+  std::vector<std::unique_ptr<Connection>> mConnections;
+  std::vector<int> mOrder;
+  std::vector<T> mBuffer; // mNSlots channel buffers of mMaxBlockSize, then a silent one for unconnected inputs
+  int mNSlots = 0;
+  int mMaxBlockSize = 0;
+  int mLatency = 0;
+  bool mCompiled = false;
+
+  std::shared_ptr<IWorkerPool> mPool;
+  int mNWorkers = 0;
+  std::unique_ptr<std::atomic<int>[]> mPending; // the number of unfinished predecessors of each node
+  std::unique_ptr<std::atomic<uint64_t>[]> mReady; // the nodes that are ready to run, in the order they became ready
+  int mNJobNodes = 0;
+  int mJobNFrames = 0;
+  uint32_t mGeneration = 0; // only touched by the audio thread, and by Compile() while the audio thread isn't processing
+
+  std::atomic<uint64_t> mClaim{0};
+  std::atomic<int> mReadyWrite{0};
+  std::atomic<int> mNodesDone{0};
+  std::atomic<int> mNActive{0}; // workers inside RunNodes()
+  std::atomic<bool> mBlockPending{false}; // ProcessBlock() has nodes left to claim
+};
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,362 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc Resampler
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include "heapbuf.h"
+
+#include "IPlugPlatform.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A table of windowed sinc kernels, one per fractional phase, for Resampler. Tables are immutable, and shared by every Resampler that uses the same
+ * length, phase count and cutoff, see Get() */
+template <typename T = double>
+class ResamplerKernel final
+{
+public:
+  /** Get a table from a cache shared by the process, making it if needed. Not realtime safe
+   * @param nTaps The kernel length, a multiple of 4
+   * @param nPhases The number of fractional phases. Phases in between are interpolated linearly
+   * @param cutoff The cutoff as a fraction of the input Nyquist frequency, below 1 to leave room for the transition band */
+  static std::shared_ptr<const ResamplerKernel> Get(int nTaps, int nPhases, double cutoff)
+  {
+    static std::mutex sMutex;
+    static std::map<std::tuple<int, int, int>, std::weak_ptr<const ResamplerKernel>> sCache;
+
+    const int cutoffKey = static_cast<int>(std::lround(cutoff * 10000.));
+    std::lock_guard<std::mutex> lock(sMutex);
+    std::weak_ptr<const ResamplerKernel>& cached = sCache[std::make_tuple(nTaps, nPhases, cutoffKey)];
+    std::shared_ptr<const ResamplerKernel> pKernel = cached.lock();
+
+    if (!pKernel)
+    {
+      pKernel.reset(new ResamplerKernel(nTaps, nPhases, cutoffKey / 10000.));
+      cached = pKernel;
+    }
+
+    return pKernel;
+  }
+
+  int NTaps() const { return mNTaps; }
+  int NPhases() const { return mNPhases; }
+  double GetCutoff() const { return mCutoff; }
+
+  /** @return The kernel for a phase, from 0 to NPhases() inclusive, so that the phase after the last can be interpolated */
+  const T* GetPhase(int phase) const { return mTable.data() + static_cast<size_t>(phase) * mNTaps; }
+
+private:
+  ResamplerKernel(int nTaps, int nPhases, double cutoff)
+  : mNTaps(nTaps)
+  , mNPhases(nPhases)
+  , mCutoff(cutoff)
+  {
+    const double pi = 3.14159265358979323846;
+    const double halfLength = nTaps / 2;
+    mTable.resize(static_cast<size_t>(nPhases + 1) * nTaps);
+
+    for (int p = 0; p <= nPhases; p++)
+    {
+      T* pPhase = mTable.data() + static_cast<size_t>(p) * nTaps;
+      double sum = 0.;
+
+      for (int t = 0; t < nTaps; t++)
+      {
+        // the distance from the output position to tap t, when the output is a fraction p / nPhases past the centre tap
+        const double u = t - halfLength + 1. - static_cast<double>(p) / nPhases;
+        const double x = pi * cutoff * u;
+        const double sinc = std::abs(x) < 1e-9 ? 1. : std::sin(x) / x;
+        // Blackman-Harris, across the full length of the kernel
+        const double w = 0.5 + 0.5 * u / halfLength;
+        const double window = w <= 0. || w >= 1. ? 0. : 0.35875 - 0.48829 * std::cos(2. * pi * w) + 0.14128 * std::cos(4. * pi * w) - 0.01168 * std::cos(6. * pi * w);
+        const double h = cutoff * sinc * window;
+        pPhase[t] = static_cast<T>(h);
+        sum += h;
+      }
+
+      // unity gain at DC for every phase
+      for (int t = 0; t < nTaps; t++)
+        pPhase[t] = static_cast<T>(pPhase[t] / sum);
+    }
+  }
+
+  int mNTaps;
+  int mNPhases;
+  double mCutoff;
+  std::vector<T> mTable;
+};
+
+/** A streaming multichannel polyphase resampler, with a windowed sinc kernel and a variable ratio. Input is written in, and output read out
+ * as it becomes available, so the two sides can use any block sizes. The inner loops are contiguous dot products, which compilers vectorize.
+ * For running DSP at a fixed rate regardless of the host's, see FixedRateProcessor */
+template <typename T = double>
+class Resampler final
+{
+public:
+  /** @param nChans The number of channels
+   * @param nTaps The kernel length, a multiple of 4. Longer kernels have a narrower transition band and more latency
+   * @param nPhases The number of precomputed fractional phases */
+  Resampler(int nChans = 1, int nTaps = 32, int nPhases = 256)
+  : mNChans(nChans)
+  , mNTaps(nTaps)
+  , mNPhases(nPhases)
+  {
+  }
+
+  /** Set the rates, and the capacity for input that hasn't been read yet. Not realtime safe
+   * @param inRate The input sample rate
+   * @param outRate The output sample rate
+   * @param maxInputFrames The most input frames that will be written between reads
+   * @param bandwidth The passband, as a fraction of the lower Nyquist frequency */
+  void Reset(double inRate, double outRate, int maxInputFrames, double bandwidth = 0.92)
+  {
+    mKernel = ResamplerKernel<T>::Get(mNTaps, mNPhases, bandwidth * std::min(1., outRate / inRate));
+    mStep = inRate / outRate;
+
+    int capacity = 1;
+
+    while (capacity < maxInputFrames + mNTaps * 2 + static_cast<int>(std::ceil(mStep)) + 1)
+      capacity *= 2;
+
+    mCapacity = capacity;
+    mHistory.Resize(mNChans * capacity * 2);
+    ClearBuffers();
+  }
+
+  /** Change the ratio without changing the kernel, e.g. for varispeed playback. Realtime safe. The kernel's cutoff stays as it was set by Reset(),
+   * so set the rates there for the fastest playback to avoid aliasing
+   * @param inFramesPerOutFrame The number of input frames consumed per output frame */
+  void SetRatio(double inFramesPerOutFrame) { mStep = inFramesPerOutFrame; }
+
+  double GetRatio() const { return mStep; }
+
+  /** @return The delay of the output, in input frames */
+  int GetLatency() const { return mNTaps / 2; }
+
+  /** Clear the history, and start reading from the next frame written */
+  void ClearBuffers()
+  {
+    std::fill(mHistory.Get(), mHistory.Get() + mHistory.GetSize(), T(0));
+    // the history starts with silence, so the first output is centred on the first frame written minus the latency
+    mWritten = mNTaps;
+    mReadPos = mNTaps / 2;
+    mReadFrac = 0.;
+  }
+
+  /** @return The number of input frames that can be written before the oldest unread input would be overwritten */
+  int GetSpace() const { return mCapacity - static_cast<int>(mWritten - (mReadPos - mNTaps / 2 + 1)); }
+
+  /** @return The number of input frames to write before nOutFrames can be read */
+  int GetInputFramesNeeded(int nOutFrames) const
+  {
+    if (nOutFrames <= 0)
+      return 0;
+
+    const int64_t lastPos = mReadPos + static_cast<int64_t>(std::floor(mReadFrac + (nOutFrames - 1) * mStep));
+    return std::max(0, static_cast<int>(lastPos + mNTaps / 2 + 1 - mWritten));
+  }
+
+  /** Write input frames. Realtime safe
+   * @return The number of frames written, fewer than nFrames if there isn't space */
+  template <typename S>
+  int Write(S** inputs, int nFrames, int startIdx = 0)
+  {
+    nFrames = std::min(nFrames, GetSpace());
+    const int64_t mask = mCapacity - 1;
+
+    for (int c = 0; c < mNChans; c++)
+    {
+      T* pHistory = mHistory.Get() + static_cast<size_t>(c) * mCapacity * 2;
+      const S* pIn = inputs[c] + startIdx;
+
+      // each frame is written twice, so the taps of any output are contiguous
+      for (int i = 0; i < nFrames; i++)
+      {
+        const int64_t pos = (mWritten + i) & mask;
+        pHistory[pos] = pHistory[pos + mCapacity] = static_cast<T>(pIn[i]);
+      }
+    }
+
+    mWritten += nFrames;
+    return nFrames;
+  }
+
+  /** Read as many output frames as the input written so far allows. Realtime safe
+   * @return The number of frames read */
+  template <typename S>
+  int Read(S** outputs, int maxFrames, int startIdx = 0)
+  {
+    const ResamplerKernel<T>& kernel = *mKernel;
+    const int64_t mask = mCapacity - 1;
+    const int halfTaps = mNTaps / 2;
+    int nRead = 0;
+
+    for (; nRead < maxFrames && mReadPos + halfTaps < mWritten; nRead++)
+    {
+      const double phase = mReadFrac * mNPhases;
+      const int p = std::min(static_cast<int>(phase), mNPhases - 1);
+      const T frac = static_cast<T>(phase - p);
+      const T* pKernel0 = kernel.GetPhase(p);
+      const T* pKernel1 = kernel.GetPhase(p + 1);
+      const int64_t first = (mReadPos - halfTaps + 1) & mask;
+
+      for (int c = 0; c < mNChans; c++)
+      {
+        const T* pHistory = mHistory.Get() + static_cast<size_t>(c) * mCapacity * 2 + first;
+        T sum0 = 0., sum1 = 0.;
+
+        for (int t = 0; t < mNTaps; t++)
+        {
+          sum0 += pHistory[t] * pKernel0[t];
+          sum1 += pHistory[t] * pKernel1[t];
+        }
+
+        outputs[c][startIdx + nRead] = static_cast<S>(sum0 + frac * (sum1 - sum0));
+      }
+
+      mReadFrac += mStep;
+      const double whole = std::floor(mReadFrac);
+      mReadPos += static_cast<int64_t>(whole);
+      mReadFrac -= whole;
+    }
+
+    return nRead;
+  }
+
+private:
+  int mNChans;
+  int mNTaps;
+  int mNPhases;
+  std::shared_ptr<const ResamplerKernel<T>> mKernel;
+  double mStep = 1.;
+  int mCapacity = 0;
+  WDL_TypedBuf<T> mHistory; // per channel, a ring written twice over
+  int64_t mWritten = 0; // the number of frames written, including the initial silence
+  int64_t mReadPos = 0; // the input frame of the next output
+  double mReadFrac = 0.;
+};
+
+/** Runs a block of DSP at a fixed internal sample rate, whatever the host's rate is, by resampling into and out of it.
+ * The output is delayed by GetLatency() host frames, which should be reported with SetLatency()
+ * @code
+ * // in OnReset()
+ * mFixedRate.Reset(GetSampleRate(), GetBlockSize());
+ * SetLatency(mFixedRate.GetLatency());
+ * // in ProcessBlock()
+ * mFixedRate.ProcessBlock(inputs, outputs, nFrames, [&](double** in, double** out, int n) { mModel.Process(in, out, n); });
+ * @endcode */
+template <typename T = double>
+class FixedRateProcessor final
+{
+public:
+  using BlockProcessFunc = std::function<void(T**, T**, int)>;
+
+  /** @param nChans The number of channels
+   * @param internalRate The rate the DSP runs at */
+  FixedRateProcessor(int nChans, double internalRate, int nTaps = 32)
+  : mNChans(nChans)
+  , mInternalRate(internalRate)
+  , mUp(nChans, nTaps)
+  , mDown(nChans, nTaps)
+  {
+  }
+
+  /** Not realtime safe
+   * @param hostRate The host's sample rate
+   * @param maxBlockSize The largest block passed to ProcessBlock() */
+  void Reset(double hostRate, int maxBlockSize)
+  {
+    mHostRate = hostRate;
+    const int maxInternalFrames = static_cast<int>(std::ceil(maxBlockSize * mInternalRate / hostRate)) + 2;
+
+    mUp.Reset(hostRate, mInternalRate, maxBlockSize);
+    mDown.Reset(mInternalRate, hostRate, maxInternalFrames + kPrimeFrames * 2);
+
+    mInternal.Resize(mNChans * maxInternalFrames * 2);
+    mInPtrs.Resize(mNChans);
+    mOutPtrs.Resize(mNChans);
+
+    for (int c = 0; c < mNChans; c++)
+    {
+      mInPtrs.Get()[c] = mInternal.Get() + static_cast<size_t>(c) * maxInternalFrames * 2;
+      mOutPtrs.Get()[c] = mInPtrs.Get()[c] + maxInternalFrames;
+    }
+
+    mMaxInternalFrames = maxInternalFrames;
+    ClearBuffers();
+  }
+
+  /** Clear the resamplers' history */
+  void ClearBuffers()
+  {
+    mUp.ClearBuffers();
+    mDown.ClearBuffers();
+
+    // a little silence ahead of the output, so that the downsampler always has a full block to read despite the rounding of the block sizes
+    std::fill(mInternal.Get(), mInternal.Get() + mInternal.GetSize(), T(0));
+    mDown.Write(mOutPtrs.Get(), kPrimeFrames);
+  }
+
+  /** @return The delay of the output, in host frames */
+  int GetLatency() const
+  {
+    const double internalFrames = mUp.GetLatency() * mInternalRate / mHostRate + mDown.GetLatency() + kPrimeFrames;
+    return static_cast<int>(std::lround(internalFrames * mHostRate / mInternalRate));
+  }
+
+  /** Resample a block to the internal rate, process it and resample it back. Realtime safe
+   * @param inputs The input channels
+   * @param outputs The output channels, which may be the same buffers as the inputs
+   * @param nFrames The number of frames, no more than the maxBlockSize passed to Reset()
+   * @param func Called with the block at the internal rate, whose size varies by a frame from block to block */
+  void ProcessBlock(T** inputs, T** outputs, int nFrames, BlockProcessFunc func)
+  {
+    mUp.Write(inputs, nFrames);
+    const int nInternal = mUp.Read(mInPtrs.Get(), mMaxInternalFrames);
+
+    func(mInPtrs.Get(), mOutPtrs.Get(), nInternal);
+
+    mDown.Write(mOutPtrs.Get(), nInternal);
+    const int nRead = mDown.Read(outputs, nFrames);
+
+    for (int c = 0; c < mNChans; c++)
+      std::fill(outputs[c] + nRead, outputs[c] + nFrames, T(0));
+  }
+
+private:
+  static constexpr int kPrimeFrames = 4;
+
+  int mNChans;
+  double mInternalRate;
+  double mHostRate = 44100.;
+  int mMaxInternalFrames = 0;
+  Resampler<T> mUp;
+  Resampler<T> mDown;
+  WDL_TypedBuf<T> mInternal;
+  WDL_TypedBuf<T*> mInPtrs;
+  WDL_TypedBuf<T*> mOutPtrs;
+};
+
+END_IPLUG_NAMESPACE
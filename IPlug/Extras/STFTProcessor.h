@@ -0,0 +1,377 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc STFTProcessor
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "IPlugPlatform.h"
+#include "IPlugProcessor.h"
+#include "IPlugWorkerPool.h"
+
+#include "fft.h"
+#include "heapbuf.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Short-time Fourier transform framing for spectral effects: each channel is windowed into overlapping frames, transformed,
+ * handed to a callback as bins from DC to Nyquist, transformed back, windowed again and overlap-added.
+ * All buffers are allocated by Configure(), 32 byte aligned, so ProcessBlock() doesn't allocate or lock.
+ * The output is delayed by the FFT size, which Configure() reports to the plug-in. Needs WDL/fft.c in the project
+ * @code
+ * // in OnReset()
+ * mSTFT.Configure(2048, 4, NOutChansConnected(), STFTProcessor::kHann, this);
+ * mSTFT.SetBinFunc([this](int chan, int bin, WDL_FFT_COMPLEX& value) {
+ *   if (bin > mCutoffBin) value.re = value.im = 0.; // a brickwall low pass
+ * });
+ * // in ProcessBlock()
+ * mSTFT.ProcessBlock(inputs, outputs, NOutChansConnected(), nFrames);
+ * @endcode */
+class STFTProcessor final
+{
+public:
+  /** The window used for analysis and synthesis. kHann needs an overlap of at least 4 for a flat response, kSqrtHann works from 2 */
+  enum EWindowType { kHann, kSqrtHann, kHamming, kRectangular };
+
+  /** Called once per frame and channel with the bins, from DC to Nyquist, to modify in place. May be called for different channels at once if there are workers */
+  using FrameFunc = std::function<void(int chan, WDL_FFT_COMPLEX* pBins, int nBins)>;
+
+  /** Called for each bin of each frame, to modify in place. Convenient, but a FrameFunc is cheaper */
+  using BinFunc = std::function<void(int chan, int bin, WDL_FFT_COMPLEX& value)>;
+
+  STFTProcessor() = default;
+
+  ~STFTProcessor()
+  {
+    SetNumWorkers(0);
+  }
+
+  STFTProcessor(const STFTProcessor&) = delete;
+  STFTProcessor& operator=(const STFTProcessor&) = delete;
+
+  /** Allocate the buffers and set the window. Not realtime safe, call it from OnReset() or the constructor
+   * @param fftSize The frame size, a power of two from 16 to 32768
+   * @param overlap The number of frames that overlap each sample, a power of two. The hop size is fftSize / overlap
+   * @param nChans The most channels that will be processed
+   * @param window The analysis and synthesis window
+   * @param pProcessor If not nullptr, its latency is set to GetLatency() */
+  void Configure(int fftSize, int overlap, int nChans, EWindowType window = kHann, IPlugProcessor* pProcessor = nullptr)
+  {
+    static std::once_flag sOnce;
+    std::call_once(sOnce, []() { WDL_fft_init(); });
+
+    mFFTSize = fftSize;
+    mHopSize = std::max(1, fftSize / std::max(1, overlap));
+    mNChans = nChans;
+    mPermute = WDL_fft_permute_tab(fftSize / 2);
+
+    MakeWindow(window);
+
+    mChannels.clear();
+
+    for (int c = 0; c < nChans; c++)
+    {
+      std::unique_ptr<Channel> pChannel(new Channel);
+      pChannel->mInput = Allocate(pChannel->mInputBuf, fftSize);
+      pChannel->mOutput = Allocate(pChannel->mOutputBuf, fftSize);
+      pChannel->mFrame = Allocate(pChannel->mFrameBuf, fftSize);
+      pChannel->mBins = reinterpret_cast<WDL_FFT_COMPLEX*>(Allocate(pChannel->mBinsBuf, NBins() * 2));
+      mChannels.push_back(std::move(pChannel));
+    }
+
+    Reset();
+
+    if (pProcessor)
+      pProcessor->SetLatency(GetLatency());
+  }
+
+  void SetFrameFunc(FrameFunc func) { mFrameFunc = std::move(func); }
+  void SetBinFunc(BinFunc func) { mBinFunc = std::move(func); }
+
+  /** Process the channels of each frame on worker threads as well as the audio thread. Not realtime safe
+   * @param nWorkers The number of threads in addition to the audio thread, 0 to process every channel on the audio thread */
+  void SetNumWorkers(int nWorkers)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mQuit = true;
+    }
+    mCondition.notify_all();
+
+    for (auto& thread : mWorkers)
+      thread.join();
+
+    mWorkers.clear();
+    mQuit = false;
+
+    for (int i = 0; i < nWorkers; i++)
+      mWorkers.emplace_back([this]() { WorkerLoop(); });
+  }
+
+  int GetFFTSize() const { return mFFTSize; }
+  int GetHopSize() const { return mHopSize; }
+
+  /** @return The number of bins passed to the callbacks, fftSize / 2 + 1 */
+  int NBins() const { return mFFTSize / 2 + 1; }
+
+  /** @return The delay of the output, in samples */
+  int GetLatency() const { return mFFTSize; }
+
+  /** Clear the input history and the overlap-add output */
+  void Reset()
+  {
+    for (auto& pChannel : mChannels)
+    {
+      std::fill(pChannel->mInput, pChannel->mInput + mFFTSize, 0.f);
+      std::fill(pChannel->mOutput, pChannel->mOutput + mFFTSize, 0.f);
+    }
+
+    mPos = 0;
+    mHopPos = 0;
+  }
+
+  /** Process a block. Realtime safe
+   * @param inputs The input channels, which may be the same buffers as the outputs
+   * @param outputs The output channels
+   * @param nChans The number of channels, no more than were configured
+   * @param nFrames The number of frames */
+  template <typename T>
+  void ProcessBlock(T** inputs, T** outputs, int nChans, int nFrames)
+  {
+    nChans = std::min(nChans, mNChans);
+    const int mask = mFFTSize - 1;
+
+    for (int done = 0; done < nFrames;)
+    {
+      const int nChunk = std::min(nFrames - done, mHopSize - mHopPos);
+
+      for (int c = 0; c < nChans; c++)
+      {
+        Channel& channel = *mChannels[c];
+        const T* pIn = inputs[c] + done;
+        T* pOut = outputs[c] + done;
+
+        for (int i = 0; i < nChunk; i++)
+        {
+          const int pos = (mPos + i) & mask;
+          channel.mInput[pos] = static_cast<WDL_FFT_REAL>(pIn[i]);
+          pOut[i] = static_cast<T>(channel.mOutput[pos]);
+          channel.mOutput[pos] = 0.f;
+        }
+      }
+
+      done += nChunk;
+      mPos = (mPos + nChunk) & mask;
+      mHopPos += nChunk;
+
+      if (mHopPos == mHopSize)
+      {
+        mHopPos = 0;
+        ProcessFrames(nChans);
+      }
+    }
+  }
+
+private:
+  struct Channel
+  {
+    WDL_TypedBuf<WDL_FFT_REAL> mInputBuf, mOutputBuf, mFrameBuf, mBinsBuf;
+    WDL_FFT_REAL* mInput = nullptr; // ring of the last fftSize samples
+    WDL_FFT_REAL* mOutput = nullptr; // ring of overlap-added output
+    WDL_FFT_REAL* mFrame = nullptr;
+    WDL_FFT_COMPLEX* mBins = nullptr;
+  };
+
+  static WDL_FFT_REAL* Allocate(WDL_TypedBuf<WDL_FFT_REAL>& buf, int size)
+  {
+    const int align = 32;
+    buf.Resize(size + align / sizeof(WDL_FFT_REAL));
+    return buf.GetAligned(align);
+  }
+
+  void MakeWindow(EWindowType window)
+  {
+    const double pi = 3.14159265358979323846;
+    WDL_FFT_REAL* pWindow = Allocate(mWindowBuf, mFFTSize);
+    double sumSquares = 0.;
+
+    for (int i = 0; i < mFFTSize; i++)
+    {
+      const double phase = 2. * pi * i / mFFTSize; // periodic, so that overlapping windows add up evenly
+      double w = 1.;
+
+      switch (window)
+      {
+        case kHann: w = 0.5 - 0.5 * std::cos(phase); break;
+        case kSqrtHann: w = std::sqrt(0.5 - 0.5 * std::cos(phase)); break;
+        case kHamming: w = 0.54 - 0.46 * std::cos(phase); break;
+        case kRectangular: break;
+      }
+
+      pWindow[i] = static_cast<WDL_FFT_REAL>(w);
+      sumSquares += w * w;
+    }
+
+    mWindow = pWindow;
+    // the window is applied twice, and WDL_real_fft() gains 2 * fftSize on the round trip
+    mScale = static_cast<WDL_FFT_REAL>(mHopSize / (sumSquares * 2. * mFFTSize));
+  }
+
+  void ProcessFrames(int nChans)
+  {
+    if (mWorkers.empty() || nChans < 2)
+    {
+      for (int c = 0; c < nChans; c++)
+        ProcessFrame(c);
+
+      return;
+    }
+
+    mJobNChans.store(nChans, std::memory_order_relaxed);
+    mChansDone.store(0, std::memory_order_relaxed);
+    mNextChan.store(0, std::memory_order_release);
+    mGeneration.fetch_add(1, std::memory_order_release);
+
+    if (mNParked.load(std::memory_order_acquire) > 0)
+      mCondition.notify_all();
+
+    RunClaimedFrames();
+
+    // only channels already claimed by a worker are still in flight here
+    while (mChansDone.load(std::memory_order_acquire) < nChans)
+    {
+    }
+  }
+
+  void RunClaimedFrames()
+  {
+    int chan;
+
+    while ((chan = mNextChan.fetch_add(1, std::memory_order_acq_rel)) < mJobNChans.load(std::memory_order_relaxed))
+    {
+      ProcessFrame(chan);
+      mChansDone.fetch_add(1, std::memory_order_release);
+    }
+  }
+
+  void ProcessFrame(int chan)
+  {
+    Channel& channel = *mChannels[chan];
+    const int size = mFFTSize;
+    const int half = size / 2;
+    const int mask = size - 1;
+    WDL_FFT_REAL* pFrame = channel.mFrame;
+    WDL_FFT_COMPLEX* pPacked = reinterpret_cast<WDL_FFT_COMPLEX*>(pFrame);
+    WDL_FFT_COMPLEX* pBins = channel.mBins;
+
+    // mPos is the oldest sample in the input ring
+    for (int i = 0; i < size; i++)
+      pFrame[i] = channel.mInput[(mPos + i) & mask] * mWindow[i];
+
+    WDL_real_fft(pFrame, size, 0);
+
+    // WDL_real_fft() leaves the bins in permuted order, with Nyquist in the imaginary part of DC
+    pBins[0].re = pPacked[0].re;
+    pBins[0].im = 0.f;
+    pBins[half].re = pPacked[0].im;
+    pBins[half].im = 0.f;
+
+    for (int k = 1; k < half; k++)
+      pBins[k] = pPacked[mPermute[k]];
+
+    if (mFrameFunc)
+      mFrameFunc(chan, pBins, half + 1);
+
+    if (mBinFunc)
+    {
+      for (int k = 0; k <= half; k++)
+        mBinFunc(chan, k, pBins[k]);
+    }
+
+    pPacked[0].re = pBins[0].re;
+    pPacked[0].im = pBins[half].re;
+
+    for (int k = 1; k < half; k++)
+      pPacked[mPermute[k]] = pBins[k];
+
+    WDL_real_fft(pFrame, size, 1);
+
+    for (int i = 0; i < size; i++)
+      channel.mOutput[(mPos + i) & mask] += pFrame[i] * mWindow[i] * mScale;
+  }
+
+  void WorkerLoop()
+  {
+    uint32_t lastGen = mGeneration.load(std::memory_order_acquire);
+    HostWorkgroup::Member workgroup;
+
+    while (true)
+    {
+      {
+        // the audio thread notifies without taking the lock, so a wakeup can be missed; the timeout bounds that
+        std::unique_lock<std::mutex> lock(mMutex);
+        mNParked.fetch_add(1, std::memory_order_acq_rel);
+        mCondition.wait_for(lock, std::chrono::milliseconds(1), [&]() { return mQuit || mGeneration.load(std::memory_order_acquire) != lastGen; });
+        mNParked.fetch_sub(1, std::memory_order_acq_rel);
+
+        if (mQuit)
+          return;
+      }
+
+      workgroup.Update();
+      const uint32_t gen = mGeneration.load(std::memory_order_acquire);
+
+      if (gen == lastGen)
+        continue;
+
+      lastGen = gen;
+      RunClaimedFrames();
+    }
+  }
+
+  int mFFTSize = 0;
+  int mHopSize = 0;
+  int mNChans = 0;
+  int mPos = 0; // the write position in the channels' rings
+  int mHopPos = 0; // samples since the last frame
+  const int* mPermute = nullptr;
+  WDL_TypedBuf<WDL_FFT_REAL> mWindowBuf;
+  const WDL_FFT_REAL* mWindow = nullptr;
+  WDL_FFT_REAL mScale = 1.f;
+  std::vector<std::unique_ptr<Channel>> mChannels;
+  FrameFunc mFrameFunc;
+  BinFunc mBinFunc;
+
+  std::vector<std::thread> mWorkers;
+  std::atomic<int> mJobNChans{0};
+  std::atomic<int> mNextChan{0};
+  std::atomic<int> mChansDone{0};
+  std::atomic<uint32_t> mGeneration{0};
+  std::atomic<int> mNParked{0};
+  bool mQuit = false;
+  std::mutex mMutex;
+  std::condition_variable mCondition;
+};
+
+END_IPLUG_NAMESPACE
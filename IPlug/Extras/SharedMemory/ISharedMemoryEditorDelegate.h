@@ -0,0 +1,593 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc ISharedMemoryEditorDelegate
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#include "IPlugPlatform.h"
+#include "IPlugEditorDelegate.h"
+#include "IPlugMidi.h"
+#include "IPlugStructs.h"
+
+#ifdef OS_WIN
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A named region of memory shared between processes. The plug-in creates it, and the editor process opens it by name */
+class ISharedMemoryRegion final
+{
+public:
+  /** @param name A name that identifies the region on this machine, e.g. made from the plug-in's unique ID and the instance
+   * @param size The size in bytes, only used when creating
+   * @param create \c true to create the region, \c false to open one that exists */
+  ISharedMemoryRegion(const char* name, size_t size, bool create)
+  : mCreated(create)
+  {
+#ifdef OS_WIN
+    WDL_String fullName;
+    fullName.SetFormatted(256, "Local\\iPlug_%s", name);
+    wchar_t nameWide[256];
+    MultiByteToWideChar(CP_UTF8, 0, fullName.Get(), -1, nameWide, 256);
+
+    if (create)
+      mMapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD) ((uint64_t) size >> 32), (DWORD) size, nameWide);
+    else
+      mMapping = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, nameWide);
+
+    if (!mMapping)
+      return;
+
+    mData = MapViewOfFile(mMapping, FILE_MAP_ALL_ACCESS, 0, 0, create ? size : 0);
+
+    if (mData && !create)
+    {
+      MEMORY_BASIC_INFORMATION info;
+      VirtualQuery(mData, &info, sizeof(info));
+      size = info.RegionSize;
+    }
+#else
+    mName.SetFormatted(256, "/iplug_%s", name);
+    const int fd = shm_open(mName.Get(), create ? (O_CREAT | O_RDWR | O_TRUNC) : O_RDWR, 0600);
+
+    if (fd < 0)
+      return;
+
+    struct stat info;
+
+    if (create ? ftruncate(fd, (off_t) size) == 0 : (fstat(fd, &info) == 0 && (size = (size_t) info.st_size) > 0))
+    {
+      void* pMapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+      if (pMapped != MAP_FAILED)
+        mData = pMapped;
+    }
+
+    close(fd); // the mapping stays valid
+#endif
+
+    if (mData)
+      mSize = size;
+  }
+
+  ~ISharedMemoryRegion()
+  {
+#ifdef OS_WIN
+    if (mData) UnmapViewOfFile(mData);
+    if (mMapping) CloseHandle(mMapping);
+#else
+    if (mData) munmap(mData, mSize);
+    if (mCreated && mData) shm_unlink(mName.Get());
+#endif
+  }
+
+  ISharedMemoryRegion(const ISharedMemoryRegion&) = delete;
+  ISharedMemoryRegion& operator=(const ISharedMemoryRegion&) = delete;
+
+  /** @return The region, or nullptr if it couldn't be created or opened */
+  void* Get() const { return mData; }
+
+  /** @return The size of the region in bytes */
+  size_t GetSize() const { return mSize; }
+
+private:
+  void* mData = nullptr;
+  size_t mSize = 0;
+  bool mCreated;
+#ifdef OS_WIN
+  HANDLE mMapping = NULL;
+#else
+  WDL_String mName;
+#endif
+};
+
+/** A lock-free single producer, single consumer ring of variable sized records, that lives in memory shared between two processes.
+ * Its indexes are lock-free atomics, which are address free, so they work across processes */
+class ISharedMemoryRing final
+{
+public:
+  /** The state at the start of the ring's memory */
+  struct Header
+  {
+    std::atomic<uint32_t> writePos;
+    std::atomic<uint32_t> readPos;
+    uint32_t capacity; // a power of two
+    uint32_t pad;
+  };
+
+  static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared memory rings need lock-free atomics");
+
+  /** @return The bytes needed for a ring with this capacity */
+  static size_t GetSize(uint32_t capacity) { return sizeof(Header) + capacity; }
+
+  /** Set up a ring in memory, on the side that creates the region
+   * @param capacity A power of two */
+  static void Init(void* pMemory, uint32_t capacity)
+  {
+    Header* pHeader = new (pMemory) Header;
+    pHeader->writePos.store(0, std::memory_order_relaxed);
+    pHeader->readPos.store(0, std::memory_order_relaxed);
+    pHeader->capacity = capacity;
+    pHeader->pad = 0;
+  }
+
+  ISharedMemoryRing(void* pMemory = nullptr)
+  : mHeader(static_cast<Header*>(pMemory))
+  , mData(static_cast<uint8_t*>(pMemory) + sizeof(Header))
+  {
+  }
+
+  /** Producer: write a record, made of up to two pieces so that a header and its payload needn't be copied together first
+   * @return \c false if there isn't room, in which case nothing is written */
+  bool Write(const void* pData1, uint32_t size1, const void* pData2 = nullptr, uint32_t size2 = 0)
+  {
+    const uint32_t size = size1 + size2;
+    const uint32_t writePos = mHeader->writePos.load(std::memory_order_relaxed);
+    const uint32_t readPos = mHeader->readPos.load(std::memory_order_acquire);
+
+    if (mHeader->capacity - (writePos - readPos) < sizeof(uint32_t) + size)
+      return false;
+
+    Copy(writePos, &size, sizeof(uint32_t));
+    Copy(writePos + sizeof(uint32_t), pData1, size1);
+    Copy(writePos + sizeof(uint32_t) + size1, pData2, size2);
+    mHeader->writePos.store(writePos + sizeof(uint32_t) + size, std::memory_order_release);
+    return true;
+  }
+
+  /** Consumer: read the next record
+   * @param data Filled with the record
+   * @return \c false if the ring is empty */
+  bool Read(WDL_TypedBuf<uint8_t>& data)
+  {
+    const uint32_t readPos = mHeader->readPos.load(std::memory_order_relaxed);
+    const uint32_t writePos = mHeader->writePos.load(std::memory_order_acquire);
+
+    if (readPos == writePos)
+      return false;
+
+    uint32_t size;
+    Paste(readPos, &size, sizeof(uint32_t));
+    data.Resize(size, false);
+    Paste(readPos + sizeof(uint32_t), data.Get(), size);
+    mHeader->readPos.store(readPos + sizeof(uint32_t) + size, std::memory_order_release);
+    return true;
+  }
+
+private:
+  void Copy(uint32_t pos, const void* pSrc, uint32_t size)
+  {
+    const uint32_t mask = mHeader->capacity - 1;
+    const uint32_t first = std::min(size, mHeader->capacity - (pos & mask));
+
+    if (first)
+      memcpy(mData + (pos & mask), pSrc, first);
+
+    if (size > first)
+      memcpy(mData, static_cast<const uint8_t*>(pSrc) + first, size - first);
+  }
+
+  void Paste(uint32_t pos, void* pDst, uint32_t size) const
+  {
+    const uint32_t mask = mHeader->capacity - 1;
+    const uint32_t first = std::min(size, mHeader->capacity - (pos & mask));
+
+    if (first)
+      memcpy(pDst, mData + (pos & mask), first);
+
+    if (size > first)
+      memcpy(static_cast<uint8_t*>(pDst) + first, mData, size - first);
+  }
+
+  Header* mHeader;
+  uint8_t* mData;
+};
+
+/** The layout of the region shared by ISharedMemoryEditorDelegate and ISharedMemoryEditorClient: a header, then three rings.
+ * Parameter values, control values and MIDI go to the editor on their own ring, so that bulky visualization data on the second ring can't hold them up */
+class ISharedMemoryEditorChannel
+{
+public:
+  static constexpr uint32_t kMagic = 0x4D535049; // "IPSM"
+  static constexpr uint32_t kVersion = 1;
+
+  /** The message types, a byte at the start of each record, followed by the fields in native byte order */
+  enum EMessage : uint8_t
+  {
+    kSPV = 0, // int paramIdx, double value
+    kSCV, // int ctrlTag, double value
+    kSCM, // int ctrlTag, int msgTag, data
+    kSAM, // int msgTag, int ctrlTag, data
+    kMIDI, // IMidiMsg
+    kSysex, // int offset, data
+    kBPC, // int paramIdx
+    kEPC // int paramIdx
+  };
+
+  struct Header
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t eventsCapacity;
+    uint32_t dataCapacity;
+    uint32_t fromEditorCapacity;
+    std::atomic<uint32_t> editorConnections; // incremented by each editor that connects, so the plug-in can send it the current state
+  };
+
+  /** Create or open the shared region
+   * @param name Identifies the region, the same in both processes
+   * @param create \c true on the plug-in side
+   * @param dataCapacity The size of the visualization data ring. The other rings are 64 KB. Powers of two */
+  ISharedMemoryEditorChannel(const char* name, bool create, uint32_t dataCapacity = 1 << 20)
+  : mRegion(name, GetSize(kEventsCapacity, dataCapacity, kFromEditorCapacity), create)
+  {
+    uint8_t* pMemory = static_cast<uint8_t*>(mRegion.Get());
+
+    if (!pMemory || mRegion.GetSize() < sizeof(Header))
+      return;
+
+    Header* pHeader = reinterpret_cast<Header*>(pMemory);
+
+    if (create)
+    {
+      pHeader = new (pMemory) Header;
+      pHeader->magic = kMagic;
+      pHeader->version = kVersion;
+      pHeader->eventsCapacity = kEventsCapacity;
+      pHeader->dataCapacity = dataCapacity;
+      pHeader->fromEditorCapacity = kFromEditorCapacity;
+      pHeader->editorConnections.store(0, std::memory_order_relaxed);
+    }
+
+    if (pHeader->magic != kMagic || pHeader->version != kVersion
+        || mRegion.GetSize() < GetSize(pHeader->eventsCapacity, pHeader->dataCapacity, pHeader->fromEditorCapacity))
+      return;
+
+    uint8_t* pEvents = pMemory + sizeof(Header);
+    uint8_t* pData = pEvents + ISharedMemoryRing::GetSize(pHeader->eventsCapacity);
+    uint8_t* pFromEditor = pData + ISharedMemoryRing::GetSize(pHeader->dataCapacity);
+
+    if (create)
+    {
+      ISharedMemoryRing::Init(pEvents, pHeader->eventsCapacity);
+      ISharedMemoryRing::Init(pData, pHeader->dataCapacity);
+      ISharedMemoryRing::Init(pFromEditor, pHeader->fromEditorCapacity);
+    }
+
+    mHeader = pHeader;
+    mEvents = ISharedMemoryRing(pEvents);
+    mData = ISharedMemoryRing(pData);
+    mFromEditor = ISharedMemoryRing(pFromEditor);
+  }
+
+  /** @return \c true if the region was created or opened, and has the expected layout */
+  bool IsValid() const { return mHeader; }
+
+protected:
+  static constexpr uint32_t kEventsCapacity = 1 << 16;
+  static constexpr uint32_t kFromEditorCapacity = 1 << 16;
+
+  static size_t GetSize(uint32_t eventsCapacity, uint32_t dataCapacity, uint32_t fromEditorCapacity)
+  {
+    return sizeof(Header) + ISharedMemoryRing::GetSize(eventsCapacity) + ISharedMemoryRing::GetSize(dataCapacity) + ISharedMemoryRing::GetSize(fromEditorCapacity);
+  }
+
+  /** Write a message of a type, some ints or a double, and optional data */
+  static bool WriteMessage(ISharedMemoryRing& ring, IByteChunk& scratch, EMessage type, const void* pFields, int fieldsSize, const void* pData = nullptr, int dataSize = 0)
+  {
+    scratch.Clear();
+    scratch.Put(&type);
+    scratch.PutBytes(pFields, fieldsSize);
+    return ring.Write(scratch.GetData(), scratch.Size(), pData, dataSize);
+  }
+
+  /** Write a message of a type, an int and a double, packed without padding */
+  static bool WriteValueMessage(ISharedMemoryRing& ring, IByteChunk& scratch, EMessage type, int idx, double value)
+  {
+    scratch.Clear();
+    scratch.Put(&type);
+    scratch.Put(&idx);
+    scratch.Put(&value);
+    return ring.Write(scratch.GetData(), scratch.Size());
+  }
+
+  ISharedMemoryRegion mRegion;
+  Header* mHeader = nullptr;
+  ISharedMemoryRing mEvents;
+  ISharedMemoryRing mData;
+  ISharedMemoryRing mFromEditor;
+  IByteChunk mScratch;
+  WDL_TypedBuf<uint8_t> mRecord;
+};
+
+/** An IEditorDelegate that mirrors the plug-in's editor messages to an editor in another process, through lock-free rings in shared memory.
+ * Use it as the editor delegate class, and call ProcessSharedMemoryQueue() regularly on the main thread, e.g. from OnIdle().
+ * The Send...FromDelegate() methods must be called from one thread, as they are by iPlug, since each ring has a single producer.
+ * If the editor isn't keeping up, messages that don't fit are dropped rather than waited for */
+class ISharedMemoryEditorDelegate : public IEditorDelegate, protected ISharedMemoryEditorChannel
+{
+public:
+  /** @param nParams The number of parameters
+   * @param name Identifies the shared region, which the editor process opens with ISharedMemoryEditorClient */
+  ISharedMemoryEditorDelegate(int nParams, const char* name)
+  : IEditorDelegate(nParams)
+  , ISharedMemoryEditorChannel(name, true)
+  {
+  }
+
+  using ISharedMemoryEditorChannel::IsValid;
+
+  //IEditorDelegate
+  void SendParameterValueFromDelegate(int paramIdx, double value, bool normalized) override
+  {
+    const double normalizedValue = normalized ? value : GetParam(paramIdx)->ToNormalized(value);
+
+    if (IsValid())
+      WriteValueMessage(mEvents, mScratch, kSPV, paramIdx, normalizedValue);
+
+    IEditorDelegate::SendParameterValueFromDelegate(paramIdx, value, normalized);
+  }
+
+  void SendControlValueFromDelegate(int controlTag, double normalizedValue) override
+  {
+    if (IsValid())
+      WriteValueMessage(mEvents, mScratch, kSCV, controlTag, normalizedValue);
+
+    IEditorDelegate::SendControlValueFromDelegate(controlTag, normalizedValue);
+  }
+
+  void SendControlMsgFromDelegate(int controlTag, int messageTag, int dataSize, const void* pData) override
+  {
+    const int fields[] = { controlTag, messageTag };
+
+    if (IsValid())
+      WriteMessage(mData, mScratch, kSCM, fields, sizeof(fields), pData, dataSize);
+
+    IEditorDelegate::SendControlMsgFromDelegate(controlTag, messageTag, dataSize, pData);
+  }
+
+  void SendArbitraryMsgFromDelegate(int messageTag, int dataSize, const void* pData) override
+  {
+    const int fields[] = { messageTag, kNoTag };
+
+    if (IsValid())
+      WriteMessage(mData, mScratch, kSAM, fields, sizeof(fields), pData, dataSize);
+
+    IEditorDelegate::SendArbitraryMsgFromDelegate(messageTag, dataSize, pData);
+  }
+
+  void SendMidiMsgFromDelegate(const IMidiMsg& msg) override
+  {
+    if (IsValid())
+      WriteMessage(mEvents, mScratch, kMIDI, &msg, sizeof(IMidiMsg));
+
+    IEditorDelegate::SendMidiMsgFromDelegate(msg);
+  }
+
+  void SendSysexMsgFromDelegate(const ISysEx& msg) override
+  {
+    if (IsValid())
+      WriteMessage(mEvents, mScratch, kSysex, &msg.mOffset, sizeof(int), msg.mData, msg.mSize);
+
+    IEditorDelegate::SendSysexMsgFromDelegate(msg);
+  }
+
+  /** Handle the messages from the editor process, and send a newly connected editor the current parameter values. Call this regularly on the main thread */
+  void ProcessSharedMemoryQueue()
+  {
+    if (!IsValid())
+      return;
+
+    const uint32_t connections = mHeader->editorConnections.load(std::memory_order_acquire);
+
+    if (connections != mEditorConnections)
+    {
+      mEditorConnections = connections;
+
+      for (int i = 0; i < NParams(); i++)
+        WriteValueMessage(mEvents, mScratch, kSPV, i, GetParam(i)->GetNormalized());
+    }
+
+    while (mFromEditor.Read(mRecord))
+    {
+      const uint8_t* pRecord = mRecord.Get();
+      const int size = mRecord.GetSize();
+      int idx, tag;
+      double value;
+
+      if (size < 1 + (int) sizeof(int))
+        continue;
+
+      memcpy(&idx, pRecord + 1, sizeof(int));
+
+      if (idx < 0 || (pRecord[0] != kSAM && idx >= NParams()))
+        continue;
+
+      switch (pRecord[0])
+      {
+        case kSPV:
+          if (size >= 1 + (int) (sizeof(int) + sizeof(double)))
+          {
+            memcpy(&value, pRecord + 1 + sizeof(int), sizeof(double));
+            SendParameterValueFromUI(idx, value);
+          }
+          break;
+        case kBPC: BeginInformHostOfParamChangeFromUI(idx); break;
+        case kEPC: EndInformHostOfParamChangeFromUI(idx); break;
+        case kSAM:
+          if (size >= 1 + 2 * (int) sizeof(int))
+          {
+            memcpy(&tag, pRecord + 1 + sizeof(int), sizeof(int));
+            const int dataSize = size - 1 - 2 * sizeof(int);
+            SendArbitraryMsgFromUI(idx, tag, dataSize, dataSize ? pRecord + 1 + 2 * sizeof(int) : nullptr);
+          }
+          break;
+        default:
+          break;
+      }
+    }
+  }
+
+private:
+  uint32_t mEditorConnections = 0;
+};
+
+/** The editor process's end of ISharedMemoryEditorDelegate. Messages from the plug-in are passed to an IEditorDelegate in the editor process,
+ * e.g. an IGEditorDelegate that draws the UI, and the editor's own changes are sent back with the Send...FromUI() methods */
+class ISharedMemoryEditorClient : public ISharedMemoryEditorChannel
+{
+public:
+  /** @param name The name the plug-in gave its ISharedMemoryEditorDelegate */
+  ISharedMemoryEditorClient(const char* name)
+  : ISharedMemoryEditorChannel(name, false)
+  {
+    if (IsValid())
+      mHeader->editorConnections.fetch_add(1, std::memory_order_release);
+  }
+
+  /** Pass the messages from the plug-in to the editor. Call this regularly, e.g. from a timer at the display rate
+   * @param editor The delegate that updates the editor process's UI */
+  void ProcessMessages(IEditorDelegate& editor)
+  {
+    if (!IsValid())
+      return;
+
+    while (mEvents.Read(mRecord))
+      Dispatch(editor);
+
+    while (mData.Read(mRecord))
+      Dispatch(editor);
+  }
+
+  bool SendParameterValueFromUI(int paramIdx, double normalizedValue)
+  {
+    return IsValid() && WriteValueMessage(mFromEditor, mScratch, kSPV, paramIdx, normalizedValue);
+  }
+
+  bool BeginInformHostOfParamChangeFromUI(int paramIdx)
+  {
+    return IsValid() && WriteMessage(mFromEditor, mScratch, kBPC, &paramIdx, sizeof(int));
+  }
+
+  bool EndInformHostOfParamChangeFromUI(int paramIdx)
+  {
+    return IsValid() && WriteMessage(mFromEditor, mScratch, kEPC, &paramIdx, sizeof(int));
+  }
+
+  bool SendArbitraryMsgFromUI(int messageTag, int controlTag = kNoTag, int dataSize = 0, const void* pData = nullptr)
+  {
+    const int fields[] = { messageTag, controlTag };
+    return IsValid() && WriteMessage(mFromEditor, mScratch, kSAM, fields, sizeof(fields), pData, dataSize);
+  }
+
+private:
+  void Dispatch(IEditorDelegate& editor)
+  {
+    const uint8_t* pRecord = mRecord.Get();
+    const int size = mRecord.GetSize();
+    const uint8_t* pFields = pRecord + 1;
+    int ints[2];
+    double value;
+
+    if (size < 1)
+      return;
+
+    switch (pRecord[0])
+    {
+      case kSPV:
+      case kSCV:
+        if (size < 1 + (int) (sizeof(int) + sizeof(double)))
+          return;
+
+        memcpy(ints, pFields, sizeof(int));
+        memcpy(&value, pFields + sizeof(int), sizeof(double));
+
+        if (pRecord[0] == kSCV)
+          editor.SendControlValueFromDelegate(ints[0], value);
+        else if (ints[0] >= 0 && ints[0] < editor.NParams())
+        {
+          editor.GetParam(ints[0])->SetNormalized(value);
+          editor.SendParameterValueFromDelegate(ints[0], value, true);
+        }
+        break;
+      case kSCM:
+      case kSAM:
+      {
+        if (size < 1 + 2 * (int) sizeof(int))
+          return;
+
+        memcpy(ints, pFields, 2 * sizeof(int));
+        const int dataSize = size - 1 - 2 * sizeof(int);
+        const void* pData = dataSize ? pFields + 2 * sizeof(int) : nullptr;
+
+        if (pRecord[0] == kSCM)
+          editor.SendControlMsgFromDelegate(ints[0], ints[1], dataSize, pData);
+        else
+          editor.SendArbitraryMsgFromDelegate(ints[0], dataSize, pData);
+        break;
+      }
+      case kMIDI:
+        if (size >= 1 + (int) sizeof(IMidiMsg))
+        {
+          IMidiMsg msg;
+          memcpy(&msg, pFields, sizeof(IMidiMsg));
+          editor.SendMidiMsgFromDelegate(msg);
+        }
+        break;
+      case kSysex:
+        if (size >= 1 + (int) sizeof(int))
+        {
+          memcpy(ints, pFields, sizeof(int));
+          editor.SendSysexMsgFromDelegate(ISysEx(ints[0], pFields + sizeof(int), size - 1 - sizeof(int)));
+        }
+        break;
+      default:
+        break;
+    }
+  }
+};
+
+END_IPLUG_NAMESPACE
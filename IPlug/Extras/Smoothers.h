@@ -8,17 +8,26 @@
  ==============================================================================
 */
 
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
 #include "denormal.h"
 #include "IPlugConstants.h"
 
 BEGIN_IPLUG_NAMESPACE
 
+/** A one pole smoother for NC channels of parameter values, processed together so that the per-sample loop vectorizes across channels.
+ * Each channel snaps to its input once it is within a threshold of it (or can get no closer), after which it is reported as
+ * settled: the output is then constant, and callers can use a constant value or skip the smoother entirely, see IsSettled() */
 template<typename T, int NC = 1>
 class LogParamSmooth
 {
 private:
   double mA, mB;
   T mOutM1[NC];
+  T mSettledThreshold = static_cast<T>(1e-6);
 
 public:
   LogParamSmooth(double timeMs = 5., T initalValue = 0.)
@@ -34,8 +43,8 @@ public:
   // only works for NC = 1
   inline T Process(T input)
   {
-    mOutM1[0] = (input * mB) + (mOutM1[0] * mA);
-    denormalFix(&mOutM1[0]);
+    const T output = (input * mB) + (mOutM1[0] * mA);
+    mOutM1[0] = Snap(output, mOutM1[0], input);
     return mOutM1[0];
   }
 
@@ -63,21 +72,74 @@ public:
     mB = 1.0 - mA;
   }
 
-  void ProcessBlock(T inputs[NC], T** outputs, int nFrames, int channelOffset = 0)
+  /** @param threshold How close (relative to the input, for inputs larger than 1) a channel needs to get to its input before it snaps to it and is settled. Must be > 0, since snapping also prevents denormals */
+  void SetSettledThreshold(T threshold) { mSettledThreshold = threshold; }
+
+  /** @return \c true if every channel has settled on its value in inputs, which means that ProcessBlock() would just output inputs */
+  bool IsSettled(const T inputs[NC], int channelOffset = 0) const
+  {
+    for (auto c = 0; c < NC; c++)
+    {
+      if (mOutM1[c] != inputs[channelOffset + c])
+        return false;
+    }
+
+    return true;
+  }
+
+  /** @return \c true if every channel was already settled, in which case each output channel is filled with its input value */
+  bool ProcessBlock(T inputs[NC], T** outputs, int nFrames, int channelOffset = 0)
   {
+    if (IsSettled(inputs, channelOffset))
+    {
+      for (auto c = 0; c < NC; c++)
+      {
+        std::fill(outputs[channelOffset + c], outputs[channelOffset + c] + nFrames, inputs[channelOffset + c]);
+      }
+
+      return true;
+    }
+
     const T b = mB;
     const T a = mA;
+    T state[NC];
+    T target[NC];
+
+    for (auto c = 0; c < NC; c++)
+    {
+      state[c] = mOutM1[c];
+      target[c] = inputs[channelOffset + c];
+    }
 
     for (auto s = 0; s < nFrames; ++s)
     {
       for (auto c = 0; c < NC; c++)
       {
-        T output = (inputs[channelOffset + c] * b) + (mOutM1[c] * a);
-        denormal_fix(&output);
-        mOutM1[c] = output;
-        outputs[channelOffset + c][s] = output;
+        const T output = (target[c] * b) + (state[c] * a);
+        state[c] = Snap(output, state[c], target[c]);
+      }
+
+      for (auto c = 0; c < NC; c++)
+      {
+        outputs[channelOffset + c][s] = state[c];
       }
     }
+
+    for (auto c = 0; c < NC; c++)
+    {
+      mOutM1[c] = state[c];
+    }
+
+    return false;
+  }
+
+private:
+  // branch-free, so that it can be vectorized
+  inline T Snap(T output, T prev, T target) const
+  {
+    const T diff = std::abs(output - target);
+    const T limit = mSettledThreshold * std::max(std::abs(target), static_cast<T>(1));
+    return (diff <= limit || output == prev) ? target : output;
   }
 
 } WDL_FIXALIGN;
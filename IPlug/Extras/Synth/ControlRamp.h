@@ -15,6 +15,7 @@
  * @copydoc ControlRamp
  */
 
+#include <algorithm>
 #include <array>
 #include <functional>
 #include <iostream>
@@ -47,33 +48,126 @@ struct ControlRamp
     return (startValue != 0.) || (endValue != 0.);
   }
 
+  /** @return \c true if the ramp holds one value for the whole block, in which case consumers can read endValue instead of writing a buffer */
+  bool IsConstant() const
+  {
+    return startValue == endValue;
+  }
+
   /** Writes the ramp signal to an output buffer.
+   * Each piece is written without a dependency between samples, so the loops can be vectorised.
    * @param buffer Pointer to the start of an output buffer.
    * @param startIdx Sample index of the start of the desired write within the buffer.
    * @param nFrames The number of samples to be written. */
-  void Write(float* buffer, int startIdx, int nFrames)
+  template<typename T>
+  void Write(T* buffer, int startIdx, int nFrames) const
   {
-    float val = startValue;
-    float dv = (endValue - startValue)/(transitionEnd - transitionStart);
-    for(int i=startIdx; i<startIdx + transitionStart; ++i)
-    {
-      buffer[i] = val;
-    }
-    for(int i=startIdx + transitionStart; i<startIdx + transitionEnd; ++i)
+    T* pOut = buffer + startIdx;
+
+    if(IsConstant())
     {
-      val += dv;
-      buffer[i] = val;
+      std::fill(pOut, pOut + nFrames, static_cast<T>(endValue));
+      return;
     }
-    for(int i=startIdx + transitionEnd; i<startIdx + nFrames; ++i)
+
+    const int rampStart = std::min(transitionStart, nFrames);
+    const int rampEnd = std::min(transitionEnd, nFrames);
+    const T start = static_cast<T>(startValue);
+    const T dv = static_cast<T>((endValue - startValue)/(transitionEnd - transitionStart));
+
+    std::fill(pOut, pOut + rampStart, start);
+
+    for(int i=rampStart; i<rampEnd; ++i)
     {
-      buffer[i] = val;
+      pOut[i] = start + (i - transitionStart + 1) * dv;
     }
+
+    std::fill(pOut + rampEnd, pOut + nFrames, static_cast<T>(endValue));
   }
     
   template<size_t N>
   using RampArray = std::array<ControlRamp, N>;
 };
 
+/** A value computed at control rate, for example an envelope or LFO in SynthVoice::ProcessControl(), and interpolated linearly at audio rate.
+ * SetTarget() starts a straight line from the current value that arrives at the target after a number of samples, which is normally the control block size.
+ * Read it with Process() per sample, or Write() a block of values to a buffer */
+struct ControlOutput
+{
+  double value = 0.;
+  double target = 0.;
+  double increment = 0.;
+  int samplesRemaining = 0;
+
+  /** Jump to a value, without interpolating. Use this when a voice is triggered */
+  void Reset(double newValue)
+  {
+    value = target = newValue;
+    increment = 0.;
+    samplesRemaining = 0;
+  }
+
+  /** Interpolate from the current value to a new target
+   * @param newTarget The value to arrive at
+   * @param nFrames The number of samples over which to interpolate */
+  void SetTarget(double newTarget, int nFrames)
+  {
+    if(nFrames < 1)
+    {
+      Reset(newTarget);
+      return;
+    }
+
+    target = newTarget;
+    increment = (newTarget - value) / nFrames;
+    samplesRemaining = nFrames;
+  }
+
+  /** @return \c true if the target has been reached */
+  bool IsSettled() const { return samplesRemaining == 0; }
+
+  /** Advance one sample
+   * @return The value for this sample */
+  double Process()
+  {
+    if(samplesRemaining > 0)
+    {
+      value = (--samplesRemaining == 0) ? target : value + increment;
+    }
+
+    return value;
+  }
+
+  /** Advance nFrames samples, writing the value for each to a buffer. The loops have no dependency between samples, so they can be vectorised
+   * @param buffer Pointer to the start of an output buffer
+   * @param startIdx Sample index of the start of the write within the buffer
+   * @param nFrames The number of samples to write */
+  template<typename T>
+  void Write(T* buffer, int startIdx, int nFrames)
+  {
+    T* pOut = buffer + startIdx;
+    const int rampEnd = std::min(samplesRemaining, nFrames);
+
+    for(int i=0; i<rampEnd; ++i)
+    {
+      pOut[i] = static_cast<T>(value + (i + 1) * increment);
+    }
+
+    if(rampEnd == samplesRemaining)
+    {
+      value = target;
+      samplesRemaining = 0;
+    }
+    else
+    {
+      value += rampEnd * increment;
+      samplesRemaining -= rampEnd;
+    }
+
+    std::fill(pOut + rampEnd, pOut + nFrames, static_cast<T>(value));
+  }
+};
+
 class ControlRampProcessor
 {
 public:
@@ -93,60 +187,75 @@ public:
   // process the glide and write changes to the output ramp.
   void Process(int blockSize)
   {
-    // always connect with previous block
+    // always connect with previous block. Not gliding is the common case, so avoid touching the ramp if it is already constant
+    if(!mSamplesRemaining)
+    {
+      if(mpOutput.startValue != mpOutput.endValue)
+        mpOutput.startValue = mpOutput.endValue;
+
+      return;
+    }
+
     mpOutput.startValue = mpOutput.endValue;
+    mPending = false;
 
-    if(mSamplesRemaining)
+    if(mSamplesRemaining == mGlideSamples)
     {
-      if(mSamplesRemaining == mGlideSamples)
+      // start glide
+      if(mStartOffset + mSamplesRemaining > blockSize)
       {
-        // start glide
-        if(mSamplesRemaining > blockSize)
-        {
-          // start with ramp to block end
-          int glideStartSamples = blockSize - mStartOffset;
-          mpOutput.endValue = mpOutput.startValue + glideStartSamples*mChangePerSample;
-          mpOutput.transitionStart = mStartOffset;
-          mpOutput.transitionEnd = blockSize;
-          mSamplesRemaining -= glideStartSamples;
-        }
-        else
-        {
-          // glide starts and finishes within block
-          mpOutput.endValue = mTargetValue;
-          mpOutput.transitionStart = mStartOffset;
-          mpOutput.transitionEnd = mStartOffset + mGlideSamples;
-          mSamplesRemaining = 0;
-        }
-      }
-      else if(mSamplesRemaining > blockSize)
-      {
-        // continue glide
-        mpOutput.endValue = mpOutput.startValue + mChangePerSample*blockSize;
-        mpOutput.transitionStart = 0;
+        // start with ramp to block end
+        int glideStartSamples = blockSize - mStartOffset;
+        mpOutput.endValue = mpOutput.startValue + glideStartSamples*mChangePerSample;
+        mpOutput.transitionStart = mStartOffset;
         mpOutput.transitionEnd = blockSize;
-        mSamplesRemaining -= blockSize;
+        mSamplesRemaining -= glideStartSamples;
       }
       else
       {
-        // finish glide
+        // glide starts and finishes within block
         mpOutput.endValue = mTargetValue;
-        mpOutput.transitionStart = 0;
-        mpOutput.transitionEnd = mSamplesRemaining;
+        mpOutput.transitionStart = mStartOffset;
+        mpOutput.transitionEnd = mStartOffset + mGlideSamples;
         mSamplesRemaining = 0;
       }
     }
+    else if(mSamplesRemaining > blockSize)
+    {
+      // continue glide
+      mpOutput.endValue = mpOutput.startValue + mChangePerSample*blockSize;
+      mpOutput.transitionStart = 0;
+      mpOutput.transitionEnd = blockSize;
+      mSamplesRemaining -= blockSize;
+    }
+    else
+    {
+      // finish glide
+      mpOutput.endValue = mTargetValue;
+      mpOutput.transitionStart = 0;
+      mpOutput.transitionEnd = mSamplesRemaining;
+      mSamplesRemaining = 0;
+    }
   }
 
   // set the next target for the glide without writing directly to the ramp.
+  // if a glide was already set in this block, the two are merged into one segment from the earlier start to the new target.
   void SetTarget(double targetValue, int startOffset, int glideSamples, int blockSize)
   {
     mTargetValue = targetValue;
     if(glideSamples < 1) glideSamples = 1;
+
+    if(mPending && startOffset >= mStartOffset)
+    {
+      glideSamples += startOffset - mStartOffset;
+      startOffset = mStartOffset;
+    }
+
     mGlideSamples = glideSamples;
     mSamplesRemaining = glideSamples;
     mChangePerSample = (targetValue - mpOutput.endValue)/glideSamples;
     mStartOffset = startOffset;
+    mPending = true;
   }
     
   // create an array of processors for an array of ramps
@@ -170,6 +279,7 @@ private:
   int mGlideSamples {0};
   int mSamplesRemaining {0};
   int mStartOffset {0};
+  bool mPending {false}; // SetTarget() was called since the last Process()
 };
 
 END_IPLUG_NAMESPACE
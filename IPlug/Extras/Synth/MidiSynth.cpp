@@ -397,6 +397,23 @@ void MidiSynth::HandleRPN(IMidiMsg msg)
 }
 
 bool MidiSynth::ProcessBlock(sample** inputs, sample** outputs, int nInputs, int nOutputs, int nFrames)
+{
+  return ProcessSubBlocks(nFrames, [&](int startIndex, int blockSize) {
+    mVoiceAllocator.ProcessVoices(inputs, outputs, nInputs, nOutputs, startIndex, blockSize);
+  });
+}
+
+bool MidiSynth::ProcessBlock(sample** inputs, int nInputs, const IBusBuffers* outputs, int nOutputBuses, int nFrames)
+{
+  mOutputBusesUsed = 0;
+
+  return ProcessSubBlocks(nFrames, [&](int startIndex, int blockSize) {
+    mOutputBusesUsed |= mVoiceAllocator.ProcessVoices(inputs, nInputs, outputs, nOutputBuses, startIndex, blockSize);
+  });
+}
+
+template <typename RenderFunc>
+bool MidiSynth::ProcessSubBlocks(int nFrames, RenderFunc&& renderFunc)
 {
   assert(NVoices());
 
@@ -406,34 +423,41 @@ bool MidiSynth::ProcessBlock(sample** inputs, sample** outputs, int nInputs, int
     int samplesRemaining = nFrames;
     int startIndex = 0;
 
-    while(samplesRemaining > 0)
+    // convert the whole block's messages up front, each sub-block then processes its range of the arena
+    mInputEvents.Clear();
+
+    // the queue is sorted by offset, so this block's messages are the span at its front
+    const IMidiMsg* pMsgs = mMidiQueue.GetMsgs();
+    const int nMsgs = mMidiQueue.NMsgsBefore(nFrames);
+    int msgIdx = 0;
+
+    for (; msgIdx < nMsgs && mInputEvents.Size() < mInputEvents.Capacity(); msgIdx++)
     {
-      if(samplesRemaining < blockSize)
-        blockSize = samplesRemaining;
+      const IMidiMsg& msg = pMsgs[msgIdx];
 
-      while (!mMidiQueue.Empty())
+      if(IsRPNMessage(msg))
       {
-        IMidiMsg msg = mMidiQueue.Peek();
+        HandleRPN(msg);
+      }
+      else
+      {
+        // message offset is relative to the start of this ProcessBlock() call. Messages that didn't fit in the arena in an earlier block
+        // have been flushed to negative offsets, and are processed at the start of this one
+        VoiceInputEvent event = MidiMessageToEvent(msg);
+        event.mSampleOffset = std::max(event.mSampleOffset, 0);
+        mInputEvents.Add(event);
+      }
+    }
 
-        // we assume the messages are in chronological order. If we find one later than the current block we are done.
-        if (msg.mOffset > startIndex + blockSize) break;
+    mMidiQueue.Remove(msgIdx);
 
-        if(IsRPNMessage(msg))
-        {
-          HandleRPN(msg);
-        }
-        else
-        {
-          // send performance messages to the voice allocator
-          // message offset is relative to the start of this processSamples() block
-          msg.mOffset -= startIndex;
-          mVoiceAllocator.AddEvent(MidiMessageToEvent(msg));
-        }
-        mMidiQueue.Remove();
-      }
+    while(samplesRemaining > 0)
+    {
+      if(samplesRemaining < blockSize)
+        blockSize = samplesRemaining;
 
-      mVoiceAllocator.ProcessEvents(blockSize, mSampleTime);
-      mVoiceAllocator.ProcessVoices(inputs, outputs, nInputs, nOutputs, startIndex, blockSize);
+      mVoiceAllocator.ProcessEvents(mInputEvents, startIndex, blockSize, mSampleTime);
+      renderFunc(startIndex, blockSize);
 
       samplesRemaining -= blockSize;
       startIndex += blockSize;
@@ -445,12 +469,12 @@ bool MidiSynth::ProcessBlock(sample** inputs, sample** outputs, int nInputs, int
 
     for(int v = 0; v < NVoices(); v++)
     {
-      bool busy = GetVoice(v)->GetBusy();
+      bool busy = mVoiceAllocator.IsVoiceBusy(v);
       voicesbusy |= busy;
 
       activeCount += (busy==true);
 #if DEBUG_VOICE_COUNT
-      if(GetVoice(v)->GetBusy()) printf("X");
+      if(mVoiceAllocator.IsVoiceBusy(v)) printf("X");
       else DBGMSG("_");
     }
     DBGMSG("\n");
@@ -476,9 +500,21 @@ void MidiSynth::SetSampleRateAndBlockSize(double sampleRate, int blockSize)
   Reset();
 
   mSampleRate = sampleRate;
-  mMidiQueue.Resize(blockSize);
+  mMaxBlockSize = blockSize;
+  mMidiQueue.Reserve(blockSize);
+  mInputEvents.Resize(blockSize > kMinInputEvents ? blockSize : kMinInputEvents);
   mVoiceAllocator.SetSampleRate(sampleRate);
 
+  if(mRenderThreads > 0)
+  {
+    mVoiceAllocator.SetRenderThreads(mRenderThreads, mRenderOutputs, mMaxBlockSize);
+  }
+
+  if(mSilenceBlocks > 0)
+  {
+    mVoiceAllocator.SetSilenceRelease(mSilenceThresholdDB, mSilenceBlocks, mSilenceOutputs, mMaxBlockSize);
+  }
+
   for(int v = 0; v < NVoices(); v++)
   {
     GetVoice(v)->SetSampleRate(sampleRate);
@@ -38,9 +38,12 @@ BEGIN_IPLUG_NAMESPACE
 class MidiSynth
 {
 public:
-  /** This defines the size in samples of a single block of processing that will be done by the synth. */
+  /** This defines the size in samples of a single block of processing that will be done by the synth, and so how often SynthVoice::ProcessControl() is called */
   static constexpr int kDefaultBlockSize = 32;
 
+  /** The minimum number of events that can be converted from MIDI in one call to ProcessBlock(), later events wait for the next call */
+  static constexpr int kMinInputEvents = 1024;
+
 #pragma mark - MidiSynth class
 
   MidiSynth(VoiceAllocator::EPolyMode mode, int blockSize = kDefaultBlockSize);
@@ -99,6 +102,48 @@ public:
     mVoiceAllocator.SetControlGlideTime(t);
   }
 
+  /** Render busy voices in groups through a SynthVoiceBank, for SIMD voice DSP. We do not take ownership of the bank.
+   * @param pBank The bank to render with, or nullptr to render each SynthVoice separately */
+  void SetVoiceBank(SynthVoiceBank* pBank)
+  {
+    mVoiceAllocator.SetVoiceBank(pBank);
+  }
+
+  /** Set a function to be called once per control block, after each busy voice's SynthVoice::ProcessControl() and before the voices are rendered,
+   * for control-rate work shared between voices, such as global LFOs or a ModMatrix. The control block size is the block size passed to the constructor.
+   * @param func Called with the start index and size of the block, or nullptr for none */
+  void SetControlFunc(const std::function<void(int startIdx, int nFrames)>& func)
+  {
+    mVoiceAllocator.SetControlFunc(func);
+  }
+
+  /** @return The size of the sub-blocks that ProcessBlock() splits the host's block into, which is the control rate of the voices */
+  int GetControlBlockSize() const { return mBlockSize; }
+
+  /** Render voices on up to nThreads threads of the IWorkerPool as well as the audio thread. The render buffers are rebuilt when SetSampleRateAndBlockSize() is called.
+   * Only use this if your voices do not share any state while processing.
+   * @param nThreads The most worker threads to render on at once, 0 (the default) renders all voices on the audio thread
+   * @param maxOutputs The maximum number of output channels that will be passed to ProcessBlock() */
+  void SetRenderThreads(int nThreads, int maxOutputs)
+  {
+    mRenderThreads = nThreads;
+    mRenderOutputs = maxOutputs;
+    mVoiceAllocator.SetRenderThreads(mRenderThreads, mRenderOutputs, mMaxBlockSize);
+  }
+
+  /** End voices that stay inaudible after their note is released, instead of waiting for GetBusy() to return false, see VoiceAllocator::SetSilenceRelease().
+   * The scratch buffer is reallocated when SetSampleRateAndBlockSize() is called
+   * @param thresholdDB The RMS level of a sub-block below which a voice counts as silent, e.g. -100.
+   * @param nBlocks The number of silent sub-blocks after which a voice is ended, 0 (the default) to turn this off
+   * @param maxOutputs The maximum number of output channels that will be passed to ProcessBlock() */
+  void SetSilenceRelease(double thresholdDB, int nBlocks, int maxOutputs)
+  {
+    mSilenceThresholdDB = thresholdDB;
+    mSilenceBlocks = nBlocks;
+    mSilenceOutputs = maxOutputs;
+    mVoiceAllocator.SetSilenceRelease(mSilenceThresholdDB, mSilenceBlocks, mSilenceOutputs, mMaxBlockSize);
+  }
+
   SynthVoice* GetVoice(int voiceIdx)
   {
     return mVoiceAllocator.GetVoice(voiceIdx);
@@ -126,6 +171,14 @@ public:
     mMidiQueue.Add(msg);
   }
 
+  /** Queue a batch of messages, e.g. a host's event list, which is merged with the queued messages by offset, see IMidiQueue::AddBatch()
+   * @param pMsgs The messages, preferably but not necessarily in offset order
+   * @param nMsgs The number of messages */
+  void AddMidiMsgsToQueue(const IMidiMsg* pMsgs, int nMsgs)
+  {
+    mMidiQueue.AddBatch(pMsgs, nMsgs);
+  }
+
   /** Processes a block of audio samples
    * @param inputs Pointer to input Arrays
    * @param outputs Pointer to output Arrays
@@ -135,7 +188,56 @@ public:
    * @return \c true if the synth is silent */
   bool ProcessBlock(sample** inputs, sample** outputs, int nInputs, int nOutputs, int nFrames);
 
+  /** Processes a block of audio samples for a multi-output instrument, rendering each voice straight into the channels of its output bus, see SetVoiceOutputBus().
+   * Afterwards IsOutputBusSilent() tells which buses no voice played on, so that they can be flagged to the host
+   * @code
+   * void ProcessBusBlock(const IBusBuffers* inputs, int nInputBuses, const IBusBuffers* outputs, int nOutputBuses, int nFrames) override
+   * {
+   *   // zero the connected output buses, then
+   *   mSynth.ProcessBlock(nullptr, 0, outputs, nOutputBuses, nFrames);
+   *
+   *   for (auto b = 0; b < nOutputBuses; b++)
+   *   {
+   *     if (mSynth.IsOutputBusSilent(b))
+   *       SetOutputBusSilent(b);
+   *   }
+   * }
+   * @endcode
+   * @param inputs Pointer to input Arrays
+   * @param nInputs The number of input channels that contain valid data
+   * @param outputs The output buses, e.g. those passed to IPlugProcessor::ProcessBusBlock()
+   * @param nOutputBuses The number of output buses, at least 1
+   * @param nFrames The number of sample frames to process
+   * @return \c true if the synth is silent */
+  bool ProcessBlock(sample** inputs, int nInputs, const IBusBuffers* outputs, int nOutputBuses, int nFrames);
+
+  /** @param busIdx An output bus
+   * @return \c true if no voice was rendered into the bus by the last call to the bus version of ProcessBlock() */
+  bool IsOutputBusSilent(int busIdx) const
+  {
+    return busIdx < 0 || busIdx >= 64 || !((mOutputBusesUsed >> busIdx) & 1);
+  }
+
+  /** Route a voice to an output bus, for the bus version of ProcessBlock(). Every voice starts on bus 0
+   * @param voiceIdx The voice
+   * @param busIdx The output bus, < 64 */
+  void SetVoiceOutputBus(int voiceIdx, int busIdx)
+  {
+    mVoiceAllocator.SetVoiceOutputBus(voiceIdx, busIdx);
+  }
+
+  /** Route all of the voices added with a zone to an output bus, e.g. one bus per drum pad */
+  void SetZoneOutputBus(uint8_t zone, int busIdx)
+  {
+    mVoiceAllocator.SetZoneOutputBus(zone, busIdx);
+  }
+
 private:
+  /** Convert the block's MIDI, then process events and render the voices a sub-block at a time
+   * @param renderFunc Called with the start index and size of each sub-block to render the voices
+   * @return \c true if the synth is silent */
+  template <typename RenderFunc>
+  bool ProcessSubBlocks(int nFrames, RenderFunc&& renderFunc);
 
   // maintain the state for one MIDI channel including RPN receipt state and pitch bend range.
   struct ChannelState
@@ -179,13 +281,21 @@ private:
   VoiceAllocator mVoiceAllocator;
   uint16_t mUnisonVoices{1};
   IMidiQueue mMidiQueue;
+  VoiceInputEventArena mInputEvents{kMinInputEvents}; // the current block's messages, converted for the voice allocator
   float mVelocityLUT[128];
   float mAfterTouchLUT[128];
   ChannelState mChannelStates[16]{};
   int mBlockSize;
+  int mMaxBlockSize = DEFAULT_BLOCK_SIZE;
+  int mRenderThreads = 0;
+  int mRenderOutputs = 0;
+  double mSilenceThresholdDB = -100.;
+  int mSilenceBlocks = 0;
+  int mSilenceOutputs = 0;
   int64_t mSampleTime{0};
   double mSampleRate = DEFAULT_SAMPLE_RATE;
   bool mVoicesAreActive = false;
+  uint64_t mOutputBusesUsed = 0; // a bit for each output bus voices were rendered into by the bus version of ProcessBlock()
 
   // the synth will startup in basic MIDI mode. When an MPE Zone setup message is received, MPE mode is entered.
   // To leave MPE mode, use RPNs to set all MPE zone channel counts to 0 as per the MPE spec.
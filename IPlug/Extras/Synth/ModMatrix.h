@@ -0,0 +1,361 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc ModMatrix
+ */
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "heapbuf.h"
+#include "wdlstring.h"
+
+#include "IPlugPlatform.h"
+#include "IPlugUtilities.h"
+#include "SynthVoiceBank.h"
+
+#if defined _M_X64 || defined _M_IX86 || defined __x86_64__ || defined __i386__
+  #if defined _M_X64 || defined __x86_64__ || defined __SSE2__ || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define IPLUG_MOD_MATRIX_SSE2
+  #endif
+#elif defined __ARM_NEON || defined __ARM_NEON__ || defined _M_ARM64
+  #include <arm_neon.h>
+  #define IPLUG_MOD_MATRIX_NEON
+#elif defined __wasm_simd128__
+  #include <wasm_simd128.h>
+  #define IPLUG_MOD_MATRIX_WASM_SIMD
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A polyphonic modulation matrix, evaluated at control rate for all voices at once.
+ * Sources (envelopes, LFOs, velocity, MPE dimensions...) and destinations are registered up front, and SetDepth() connects them.
+ * The depths form a dense source x destination matrix, which is compiled into a list of the non-zero routes, so that unused routes cost nothing.
+ * Values are stored one row per source or destination, with one lane per voice, and each route is a multiply-add across the voices
+ * four at a time with SSE2, NEON or WebAssembly SIMD128 where available.
+ * Process() is called once per control block, after the source values have been set. Each destination then has a value per voice for the end of the block,
+ * and an increment per sample from the previous block's value, for per-sample interpolation with WriteRamp() or GatherLanes().
+ * Registering sources and destinations allocates, so do it before processing. Everything else is realtime safe and should be called from the audio thread */
+class ModMatrix
+{
+public:
+  /** The number of voices in a SIMD register. Rows are padded to a multiple of this */
+  static constexpr int kVectorSize = 4;
+
+  /** @param maxNVoices The number of voices to evaluate, e.g. the number of voices added to the VoiceAllocator */
+  ModMatrix(int maxNVoices)
+  : mNVoices(std::max(maxNVoices, 1))
+  , mStride(((mNVoices + kVectorSize - 1) / kVectorSize) * kVectorSize)
+  {
+  }
+
+  ModMatrix(const ModMatrix&) = delete;
+  ModMatrix& operator=(const ModMatrix&) = delete;
+
+  /** Register a source. Allocates
+   * @param name A name for the source, e.g. for a UI
+   * @param perVoice \c true if the source has a value for each voice (e.g. an envelope), \c false if all voices share one (e.g. a global LFO or the mod wheel)
+   * @return The source index */
+  int AddSource(const char* name, bool perVoice = true)
+  {
+    mSources.push_back({WDL_String(name), perVoice});
+    Resize();
+    return NSources() - 1;
+  }
+
+  /** Register a destination. Allocates
+   * @param name A name for the destination, e.g. for a UI
+   * @param baseValue The value before modulation, see SetBaseValue()
+   * @param minValue The lowest modulated value
+   * @param maxValue The highest modulated value
+   * @return The destination index */
+  int AddDestination(const char* name, float baseValue = 0.f, float minValue = -std::numeric_limits<float>::max(), float maxValue = std::numeric_limits<float>::max())
+  {
+    mDestinations.push_back({WDL_String(name), baseValue, minValue, maxValue});
+    Resize();
+    return NDestinations() - 1;
+  }
+
+  int NSources() const { return static_cast<int>(mSources.size()); }
+  int NDestinations() const { return static_cast<int>(mDestinations.size()); }
+  int NVoices() const { return mNVoices; }
+  const char* GetSourceName(int srcIdx) const { return mSources[srcIdx].mName.Get(); }
+  const char* GetDestinationName(int destIdx) const { return mDestinations[destIdx].mName.Get(); }
+  bool GetSourceIsPerVoice(int srcIdx) const { return mSources[srcIdx].mPerVoice; }
+
+  /** Set the depth of the route from a source to a destination. A depth of zero removes the route. The routes are recompiled at the next Process()
+   * @param srcIdx The source index
+   * @param destIdx The destination index
+   * @param depth The amount of the source added to the destination */
+  void SetDepth(int srcIdx, int destIdx, float depth)
+  {
+    float& current = mDepths.Get()[destIdx * NSources() + srcIdx];
+
+    if (current != depth)
+    {
+      current = depth;
+      mRoutesDirty = true;
+    }
+  }
+
+  /** @return The depth of the route from srcIdx to destIdx, zero if there is none */
+  float GetDepth(int srcIdx, int destIdx) const { return mDepths.Get()[destIdx * NSources() + srcIdx]; }
+
+  /** Remove all routes */
+  void ClearDepths()
+  {
+    std::fill(mDepths.Get(), mDepths.Get() + mDepths.GetSize(), 0.f);
+    mRoutesDirty = true;
+  }
+
+  /** @return The number of routes with a non-zero depth, as of the last Process() */
+  int NActiveRoutes() const { return static_cast<int>(mRoutes.size()); }
+
+  /** Set the unmodulated value of a destination, typically from a parameter */
+  void SetBaseValue(int destIdx, float value) { mDestinations[destIdx].mBaseValue = value; }
+
+  /** Set a per-voice source's value for one voice, for the end of the next control block */
+  void SetSourceValue(int srcIdx, int voiceIdx, float value) { GetSourceRow(srcIdx)[voiceIdx] = value; }
+
+  /** Set a shared source's value, for every voice */
+  void SetGlobalSourceValue(int srcIdx, float value)
+  {
+    float* pRow = GetSourceRow(srcIdx);
+    std::fill(pRow, pRow + mStride, value);
+  }
+
+  /** Set a per-voice source from one of a voice's control ramps, e.g. the MPE pressure, timbre or pitch bend of SynthVoice::mInputs */
+  void SetSourceValue(int srcIdx, int voiceIdx, const ControlRamp& ramp) { SetSourceValue(srcIdx, voiceIdx, static_cast<float>(ramp.endValue)); }
+
+  /** @return The row of values for a source, one per voice, for filling from a SynthVoiceBank or a vectorised envelope */
+  float* GetSourceRow(int srcIdx) { return GetRow(mSourceValues, srcIdx); }
+
+  /** Evaluate the matrix for a control block. The previous values become the start of each destination's ramp
+   * @param nFrames The length of the control block in samples, over which the increments interpolate */
+  void Process(int nFrames)
+  {
+    if (mRoutesDirty)
+      CompileRoutes();
+
+    const int nDests = NDestinations();
+    const float invFrames = nFrames > 0 ? 1.f / static_cast<float>(nFrames) : 0.f;
+
+    for (int d = 0; d < nDests; d++)
+    {
+      const Destination& dest = mDestinations[d];
+      float* pValues = GetRow(mValues, d);
+      float* pPrevious = GetRow(mPreviousValues, d);
+      float* pIncrements = GetRow(mIncrements, d);
+
+      std::copy(pValues, pValues + mStride, pPrevious);
+      std::fill(pValues, pValues + mStride, dest.mBaseValue);
+
+      for (int r = mRouteStart[d]; r < mRouteStart[d + 1]; r++)
+        MultiplyAdd(pValues, GetSourceRow(mRoutes[r].mSrcIdx), mRoutes[r].mDepth, mStride);
+
+      for (int v = 0; v < mStride; v++)
+      {
+        pValues[v] = Clip(pValues[v], dest.mMinValue, dest.mMaxValue);
+        pIncrements[v] = (pValues[v] - pPrevious[v]) * invFrames;
+      }
+    }
+  }
+
+  /** Snap a voice's destinations to their current values, so that a newly triggered voice doesn't glide from where its last note left off.
+   * Call it after Process() for the block in which the voice starts */
+  void ResetVoice(int voiceIdx)
+  {
+    for (int d = 0; d < NDestinations(); d++)
+    {
+      GetRow(mPreviousValues, d)[voiceIdx] = GetRow(mValues, d)[voiceIdx];
+      GetRow(mIncrements, d)[voiceIdx] = 0.f;
+    }
+  }
+
+  /** @return A destination's modulated value for a voice, at the end of the control block */
+  float GetValue(int destIdx, int voiceIdx) const { return GetRow(mValues, destIdx)[voiceIdx]; }
+
+  /** @return A destination's value for a voice at the end of the previous control block */
+  float GetPreviousValue(int destIdx, int voiceIdx) const { return GetRow(mPreviousValues, destIdx)[voiceIdx]; }
+
+  /** @return The amount a destination's value changes per sample for a voice, over the control block */
+  float GetIncrement(int destIdx, int voiceIdx) const { return GetRow(mIncrements, destIdx)[voiceIdx]; }
+
+  /** Write a destination's per-sample values for a voice, interpolated from the previous control block's value
+   * @param buffer The output buffer
+   * @param startIdx The index in buffer of the start of the control block
+   * @param nFrames The number of samples to write, normally the length of the control block */
+  template <typename T>
+  void WriteRamp(int destIdx, int voiceIdx, T* buffer, int startIdx, int nFrames) const
+  {
+    const float start = GetPreviousValue(destIdx, voiceIdx);
+    const float inc = GetIncrement(destIdx, voiceIdx);
+
+    for (int s = 0; s < nFrames; s++)
+      buffer[startIdx + s] = static_cast<T>(start + (s + 1) * inc);
+  }
+
+  /** Gather a destination's previous values and increments for the voices of a SynthVoiceBank call, so the bank can interpolate them in its SIMD registers.
+   * Padding lanes get zero
+   * @param previousValues An array of SynthVoiceLanes::kMaxLanes values at the start of the block
+   * @param increments An array of SynthVoiceLanes::kMaxLanes increments per sample */
+  void GatherLanes(int destIdx, const SynthVoiceLanes& lanes, float* previousValues, float* increments) const
+  {
+    for (int l = 0; l < SynthVoiceLanes::kMaxLanes; l++)
+    {
+      const bool valid = l < lanes.mNLanes && lanes.mVoiceIdx[l] < mNVoices;
+      previousValues[l] = valid ? GetPreviousValue(destIdx, lanes.mVoiceIdx[l]) : 0.f;
+      increments[l] = valid ? GetIncrement(destIdx, lanes.mVoiceIdx[l]) : 0.f;
+    }
+  }
+
+private:
+  struct Source
+  {
+    WDL_String mName;
+    bool mPerVoice;
+  };
+
+  struct Destination
+  {
+    WDL_String mName;
+    float mBaseValue;
+    float mMinValue;
+    float mMaxValue;
+  };
+
+  struct Route
+  {
+    int mSrcIdx;
+    float mDepth;
+  };
+
+  float* GetRow(const WDL_TypedBuf<float>& buf, int idx) const { return buf.GetAligned(16) + idx * mStride; }
+
+  /** Resize the rows and the depth matrix after a source or destination was added, keeping existing depths */
+  void Resize()
+  {
+    const int nSrcs = NSources();
+    const int nDests = NDestinations();
+    WDL_TypedBuf<float> depths;
+    depths.Resize(nSrcs * nDests);
+    std::fill(depths.Get(), depths.Get() + depths.GetSize(), 0.f);
+
+    for (int d = 0; d < nDests; d++)
+    {
+      for (int s = 0; s < nSrcs; s++)
+      {
+        if (d < mNDepthDests && s < mNDepthSrcs)
+          depths.Get()[d * nSrcs + s] = mDepths.Get()[d * mNDepthSrcs + s];
+      }
+    }
+
+    mDepths.Resize(depths.GetSize());
+    std::copy(depths.Get(), depths.Get() + depths.GetSize(), mDepths.Get());
+    mNDepthSrcs = nSrcs;
+    mNDepthDests = nDests;
+
+    ResizeRows(mSourceValues, nSrcs);
+    ResizeRows(mValues, nDests);
+    ResizeRows(mPreviousValues, nDests);
+    ResizeRows(mIncrements, nDests);
+
+    for (int d = 0; d < nDests; d++)
+    {
+      std::fill(GetRow(mValues, d), GetRow(mValues, d) + mStride, mDestinations[d].mBaseValue);
+      std::fill(GetRow(mPreviousValues, d), GetRow(mPreviousValues, d) + mStride, mDestinations[d].mBaseValue);
+    }
+
+    mRoutes.reserve(static_cast<size_t>(nSrcs) * nDests);
+    mRouteStart.resize(nDests + 1);
+    mRoutesDirty = true;
+  }
+
+  /** Zeroes nRows rows, with kVectorSize floats of slack so that the first row can start on a 16 byte boundary */
+  void ResizeRows(WDL_TypedBuf<float>& buf, int nRows)
+  {
+    buf.Resize(nRows * mStride + kVectorSize);
+    std::fill(buf.Get(), buf.Get() + buf.GetSize(), 0.f);
+  }
+
+  /** Gather the non-zero depths into a list of routes per destination. mRoutes was reserved for every route, so this doesn't allocate */
+  void CompileRoutes()
+  {
+    const int nSrcs = NSources();
+    mRoutes.clear();
+
+    for (int d = 0; d < NDestinations(); d++)
+    {
+      mRouteStart[d] = static_cast<int>(mRoutes.size());
+
+      for (int s = 0; s < nSrcs; s++)
+      {
+        const float depth = mDepths.Get()[d * nSrcs + s];
+
+        if (depth != 0.f)
+          mRoutes.push_back({s, depth});
+      }
+    }
+
+    mRouteStart[NDestinations()] = static_cast<int>(mRoutes.size());
+    mRoutesDirty = false;
+  }
+
+  /** pDest[i] += pSrc[i] * depth, for 16 byte aligned rows whose length is a multiple of kVectorSize */
+  static void MultiplyAdd(float* pDest, const float* pSrc, float depth, int n)
+  {
+    int i = 0;
+
+#if defined IPLUG_MOD_MATRIX_SSE2
+    const __m128 vDepth = _mm_set1_ps(depth);
+
+    for (; i < n; i += 4)
+      _mm_store_ps(pDest + i, _mm_add_ps(_mm_load_ps(pDest + i), _mm_mul_ps(_mm_load_ps(pSrc + i), vDepth)));
+#elif defined IPLUG_MOD_MATRIX_NEON
+    const float32x4_t vDepth = vdupq_n_f32(depth);
+
+    for (; i < n; i += 4)
+      vst1q_f32(pDest + i, vmlaq_f32(vld1q_f32(pDest + i), vld1q_f32(pSrc + i), vDepth));
+#elif defined IPLUG_MOD_MATRIX_WASM_SIMD
+    const v128_t vDepth = wasm_f32x4_splat(depth);
+
+    for (; i < n; i += 4)
+      wasm_v128_store(pDest + i, wasm_f32x4_add(wasm_v128_load(pDest + i), wasm_f32x4_mul(wasm_v128_load(pSrc + i), vDepth)));
+#endif
+
+    for (; i < n; i++)
+      pDest[i] += pSrc[i] * depth;
+  }
+
+  const int mNVoices;
+  const int mStride;
+  std::vector<Source> mSources;
+  std::vector<Destination> mDestinations;
+  /** The dense depth matrix, one row of sources per destination */
+  WDL_TypedBuf<float> mDepths;
+  int mNDepthSrcs = 0;
+  int mNDepthDests = 0;
+  /** The non-zero routes, grouped by destination. The routes of destination d are [mRouteStart[d], mRouteStart[d + 1]) */
+  std::vector<Route> mRoutes;
+  std::vector<int> mRouteStart {0};
+  bool mRoutesDirty = true;
+  WDL_TypedBuf<float> mSourceValues;
+  WDL_TypedBuf<float> mValues;
+  WDL_TypedBuf<float> mPreviousValues;
+  WDL_TypedBuf<float> mIncrements;
+};
+
+END_IPLUG_NAMESPACE
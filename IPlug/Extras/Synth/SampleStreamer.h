@@ -0,0 +1,671 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+/**
+ * @file
+ * @brief Disk streaming sample playback: StreamedSample, SampleStreamEngine and SampleStreamVoice
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef OS_WIN
+  #include <unistd.h> // fileread.h uses pread() and close()
+#endif
+
+#include "fileread.h"
+#include "heapbuf.h"
+#include "wdlstring.h"
+
+#include "IPlugUtilities.h"
+#include "SynthVoice.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A sample on disk whose first frames are held in memory. Only the header and the attack segment are read when the sample is loaded,
+ * the rest is streamed by a SampleStreamEngine while it plays. Supports PCM WAV files of 16, 24 or 32 bit integers, or 32 or 64 bit floats */
+class StreamedSample
+{
+public:
+  /** Read a sample's header and preload its attack segment. Does file I/O and allocates, so call this on a non-realtime thread
+   * @param path The path of the WAV file
+   * @param preloadFrames The number of frames to hold in memory. This needs to cover the time it takes the I/O threads to start streaming, typically 100 ms or more
+   * @return The sample, or nullptr if the file could not be read */
+  static std::shared_ptr<const StreamedSample> Load(const char* path, int preloadFrames = kDefaultPreloadFrames)
+  {
+    std::shared_ptr<StreamedSample> pSample(new StreamedSample);
+    WDL_FileRead file(path, 0);
+
+    if (!file.IsOpen() || !pSample->ReadHeader(file))
+      return nullptr;
+
+    pSample->mPath.Set(path);
+    pSample->mPreloadFrames = static_cast<int>(std::min<int64_t>(std::max(preloadFrames, 0), pSample->mNFrames));
+    pSample->mPreload.Resize(pSample->mPreloadFrames * pSample->mNChans);
+
+    WDL_TypedBuf<unsigned char> bytes;
+    bytes.Resize(pSample->mPreloadFrames * pSample->mBytesPerFrame);
+
+    if (file.SetPosition(pSample->mDataOffset) || file.Read(bytes.Get(), bytes.GetSize()) != bytes.GetSize())
+      return nullptr;
+
+    pSample->Convert(bytes.Get(), pSample->mPreload.Get(), pSample->mPreloadFrames);
+    return pSample;
+  }
+
+  static constexpr int kDefaultPreloadFrames = 16384;
+
+  const char* GetPath() const { return mPath.Get(); }
+  int NChannels() const { return mNChans; }
+  int64_t NFrames() const { return mNFrames; }
+  double GetSampleRate() const { return mSampleRate; }
+  int GetPreloadFrames() const { return mPreloadFrames; }
+
+  /** @return The preloaded frames, interleaved */
+  const float* GetPreload() const { return mPreload.Get(); }
+
+  /** @return The number of bytes of memory used by the preloaded frames */
+  size_t GetMemoryUsage() const { return mPreload.GetSize() * sizeof(float); }
+
+private:
+  friend class SampleStreamEngine;
+
+  StreamedSample() = default;
+
+  static uint32_t ReadU32(const unsigned char* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24); }
+  static uint16_t ReadU16(const unsigned char* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+
+  bool ReadHeader(WDL_FileRead& file)
+  {
+    unsigned char header[12];
+
+    if (file.Read(header, 12) != 12 || memcmp(header, "RIFF", 4) || memcmp(header + 8, "WAVE", 4))
+      return false;
+
+    bool hasFormat = false;
+    unsigned char chunk[8];
+
+    while (file.Read(chunk, 8) == 8)
+    {
+      const uint32_t chunkSize = ReadU32(chunk + 4);
+      const int64_t chunkStart = file.GetPosition();
+
+      if (!memcmp(chunk, "fmt ", 4))
+      {
+        unsigned char fmt[40] = {};
+
+        if (chunkSize < 16 || file.Read(fmt, static_cast<int>(std::min<uint32_t>(chunkSize, 40))) < 16)
+          return false;
+
+        uint16_t format = ReadU16(fmt);
+
+        if (format == 0xFFFE && chunkSize >= 26) // WAVE_FORMAT_EXTENSIBLE, the sub-format GUID starts with the format tag
+          format = ReadU16(fmt + 24);
+
+        mNChans = ReadU16(fmt + 2);
+        mSampleRate = ReadU32(fmt + 4);
+        mBytesPerFrame = ReadU16(fmt + 12);
+        mBits = ReadU16(fmt + 14);
+        mIsFloat = format == 3;
+
+        const bool supported = (format == 1 && (mBits == 16 || mBits == 24 || mBits == 32)) || (format == 3 && (mBits == 32 || mBits == 64));
+
+        if (!supported || mNChans < 1 || mBytesPerFrame != mNChans * (mBits / 8))
+          return false;
+
+        hasFormat = true;
+      }
+      else if (!memcmp(chunk, "data", 4))
+      {
+        if (!hasFormat)
+          return false;
+
+        mDataOffset = chunkStart;
+        mNFrames = std::min<int64_t>(chunkSize, file.GetSize() - chunkStart) / mBytesPerFrame;
+        return true;
+      }
+
+      // chunks are padded to an even size
+      if (file.SetPosition(chunkStart + chunkSize + (chunkSize & 1)))
+        return false;
+    }
+
+    return false;
+  }
+
+  /** Convert nFrames frames from the file's format to interleaved floats */
+  void Convert(const unsigned char* pSrc, float* pDst, int nFrames) const
+  {
+    const int n = nFrames * mNChans;
+
+    if (mIsFloat && mBits == 32)
+      memcpy(pDst, pSrc, n * sizeof(float));
+    else if (mIsFloat)
+    {
+      for (int i = 0; i < n; i++)
+      {
+        double d;
+        memcpy(&d, pSrc + i * 8, 8);
+        pDst[i] = static_cast<float>(d);
+      }
+    }
+    else if (mBits == 16)
+    {
+      for (int i = 0; i < n; i++)
+        pDst[i] = static_cast<int16_t>(ReadU16(pSrc + i * 2)) * (1.f / 32768.f);
+    }
+    else if (mBits == 24)
+    {
+      for (int i = 0; i < n; i++)
+      {
+        const unsigned char* p = pSrc + i * 3;
+        pDst[i] = static_cast<int32_t>((p[0] << 8) | (p[1] << 16) | (static_cast<uint32_t>(p[2]) << 24)) * (1.f / 2147483648.f);
+      }
+    }
+    else
+    {
+      for (int i = 0; i < n; i++)
+        pDst[i] = static_cast<int32_t>(ReadU32(pSrc + i * 4)) * (1.f / 2147483648.f);
+    }
+  }
+
+  WDL_String mPath;
+  int mNChans = 0;
+  int64_t mNFrames = 0;
+  double mSampleRate = 0.;
+  int mBits = 0;
+  bool mIsFloat = false;
+  int mBytesPerFrame = 0;
+  int64_t mDataOffset = 0;
+  int mPreloadFrames = 0;
+  WDL_TypedBuf<float> mPreload;
+};
+
+/** Plays StreamedSamples from disk. A fixed number of streams share a pool of background I/O threads, which keep a ring buffer of frames
+ * ahead of each stream's playhead. Playback starts from the sample's preloaded attack segment, so a stream can start on the audio thread straight away.
+ * The I/O threads always fill the stream with the least audio buffered relative to its priority, so that voices which matter more are served first,
+ * see SampleStreamVoice. Each ring buffer has one producer (an I/O thread) and one consumer (the voice), and is handed over with atomic indices.
+ * StartStream(), Read(), SetPriority() and StopStream() are realtime safe: they don't allocate, lock or touch the disk */
+class SampleStreamEngine
+{
+public:
+  /** Allocates the ring buffers and starts the I/O threads. Call from a non-realtime thread
+   * @param maxStreams The number of streams that can play at once, typically the number of voices
+   * @param maxChannels The largest channel count of the samples that will be streamed
+   * @param nIOThreads The number of I/O threads
+   * @param bufferFrames The size of each stream's ring buffer, in frames
+   * @param readFrames The largest number of frames an I/O thread reads from a file at once */
+  SampleStreamEngine(int maxStreams, int maxChannels = 2, int nIOThreads = 2, int bufferFrames = 65536, int readFrames = 8192)
+  : mMaxChannels(std::max(maxChannels, 1))
+  , mBufferFrames(std::max(bufferFrames, 2))
+  , mReadFrames(Clip(readFrames, 1, mBufferFrames))
+  , mStreams(std::max(maxStreams, 1))
+  {
+    for (auto& stream : mStreams)
+      stream.mBuffer.Resize(mBufferFrames * mMaxChannels);
+
+    for (auto i = 0; i < std::max(nIOThreads, 1); i++)
+      mThreads.push_back(std::thread([this]() { IOLoop(); }));
+  }
+
+  ~SampleStreamEngine()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mQuit.store(true);
+    }
+    mCondition.notify_all();
+
+    for (auto& thread : mThreads)
+    {
+      if (thread.joinable())
+        thread.join();
+    }
+  }
+
+  SampleStreamEngine(const SampleStreamEngine&) = delete;
+  SampleStreamEngine& operator=(const SampleStreamEngine&) = delete;
+
+  /** Start playing a sample. Realtime safe
+   * @param pSample The sample. The stream keeps a reference to it until the stream has been stopped
+   * @param startFrame The first frame to play. Frames beyond the preloaded segment are silent until the I/O threads have read them
+   * @param priority How much this stream matters relative to others, see SetPriority()
+   * @return The stream index, or -1 if every stream is in use or the sample has too many channels */
+  int StartStream(const std::shared_ptr<const StreamedSample>& pSample, int64_t startFrame = 0, float priority = 1.f)
+  {
+    if (!pSample || pSample->NChannels() > mMaxChannels)
+      return -1;
+
+    for (auto i = 0; i < NStreams(); i++)
+    {
+      Stream& stream = mStreams[i];
+
+      // only the audio thread moves a stream out of kFree, and the I/O threads don't touch free streams
+      if (stream.mState.load(std::memory_order_acquire) != kFree)
+        continue;
+
+      const int64_t firstFrame = Clip<int64_t>(startFrame, 0, pSample->NFrames());
+      stream.mSample = pSample;
+      stream.mPlayFrame.store(firstFrame, std::memory_order_relaxed);
+      stream.mDiskStartFrame = std::max<int64_t>(firstFrame, pSample->GetPreloadFrames());
+      stream.mWriteFrames.store(0, std::memory_order_relaxed);
+      stream.mReadFrames.store(0, std::memory_order_relaxed);
+      stream.mPriority.store(std::max(priority, kMinPriority), std::memory_order_relaxed);
+      stream.mState.store(kPlaying, std::memory_order_release);
+      Wake();
+      return i;
+    }
+
+    return -1;
+  }
+
+  /** Read the next frames of a stream, replacing the contents of outputs. Realtime safe. Only one thread may read a stream at a time.
+   * If the I/O threads have fallen behind, the missing frames are silent and playback resumes where it left off once they arrive
+   * @param streamIdx The stream index returned by StartStream()
+   * @param outputs One buffer per channel. Channels beyond the sample's are silent
+   * @param nChans The number of buffers in outputs
+   * @param nFrames The number of frames to read
+   * @return The number of frames that were read, less than nFrames at the end of the sample or if the stream underran */
+  template <typename T>
+  int Read(int streamIdx, T** outputs, int nChans, int nFrames)
+  {
+    Stream& stream = mStreams[streamIdx];
+    const StreamedSample& sample = *stream.mSample;
+    const int sampleChans = sample.NChannels();
+    int64_t playFrame = stream.mPlayFrame.load(std::memory_order_relaxed);
+    int framesDone = 0;
+
+    // the attack segment comes from memory
+    if (playFrame < sample.GetPreloadFrames())
+    {
+      const int n = static_cast<int>(std::min<int64_t>(nFrames, sample.GetPreloadFrames() - playFrame));
+      Deinterleave(sample.GetPreload() + playFrame * sampleChans, sampleChans, outputs, nChans, 0, n);
+      framesDone = n;
+      playFrame += n;
+    }
+
+    // the rest from the ring buffer
+    if (framesDone < nFrames && playFrame < sample.NFrames())
+    {
+      const int64_t readFrames = stream.mReadFrames.load(std::memory_order_relaxed);
+      const int64_t available = stream.mWriteFrames.load(std::memory_order_acquire) - readFrames;
+      const int n = static_cast<int>(std::min<int64_t>(std::min<int64_t>(nFrames - framesDone, available), sample.NFrames() - playFrame));
+      const int pos = static_cast<int>(readFrames % mBufferFrames);
+      const int n1 = std::min(n, mBufferFrames - pos);
+
+      Deinterleave(stream.mBuffer.Get() + pos * sampleChans, sampleChans, outputs, nChans, framesDone, n1);
+      Deinterleave(stream.mBuffer.Get(), sampleChans, outputs, nChans, framesDone + n1, n - n1);
+      stream.mReadFrames.store(readFrames + n, std::memory_order_release);
+      framesDone += n;
+      playFrame += n;
+
+      if (framesDone < nFrames && playFrame < sample.NFrames())
+        mUnderruns.fetch_add(1, std::memory_order_relaxed);
+
+      Wake();
+    }
+
+    stream.mPlayFrame.store(playFrame, std::memory_order_relaxed);
+
+    for (auto c = 0; c < nChans; c++)
+      std::fill(outputs[c] + framesDone, outputs[c] + nFrames, T(0));
+
+    return framesDone;
+  }
+
+  /** @return \c true if a stream has played its sample to the end */
+  bool GetFinished(int streamIdx) const
+  {
+    const Stream& stream = mStreams[streamIdx];
+    return stream.mPlayFrame.load(std::memory_order_relaxed) >= stream.mSample->NFrames();
+  }
+
+  /** Set how much a stream matters. The I/O threads serve the stream with the fewest buffered frames divided by priority first, so a stream
+   * with priority 2 is kept twice as far ahead as one with priority 1. A released or quiet voice would lower its priority. Realtime safe */
+  void SetPriority(int streamIdx, float priority)
+  {
+    mStreams[streamIdx].mPriority.store(std::max(priority, kMinPriority), std::memory_order_relaxed);
+  }
+
+  /** Stop a stream. The stream index must not be used again. Its file is closed and it becomes free on an I/O thread. Realtime safe */
+  void StopStream(int streamIdx)
+  {
+    mStreams[streamIdx].mState.store(kStopping, std::memory_order_release);
+    Wake();
+  }
+
+  int NStreams() const { return static_cast<int>(mStreams.size()); }
+  int GetMaxChannels() const { return mMaxChannels; }
+
+  /** @return The number of times a stream ran out of buffered frames, since construction. Thread safe */
+  int GetUnderruns() const { return mUnderruns.load(std::memory_order_relaxed); }
+
+  /** @return The number of bytes of memory used by the ring buffers */
+  size_t GetMemoryUsage() const { return mStreams.size() * mBufferFrames * mMaxChannels * sizeof(float); }
+
+private:
+  static constexpr float kMinPriority = 1e-6f;
+
+  enum EState
+  {
+    kFree,
+    kPlaying,
+    kStopping
+  };
+
+  struct Stream
+  {
+    std::atomic<int> mState{kFree};
+    /** Set while an I/O thread works on the stream, so that only one does */
+    std::atomic<bool> mClaimed{false};
+    std::shared_ptr<const StreamedSample> mSample;
+    /** The frame of the sample the next Read() starts at. Written by the reader, read by the I/O threads */
+    std::atomic<int64_t> mPlayFrame{0};
+    /** The frame of the sample at the start of the ring buffer's data */
+    int64_t mDiskStartFrame = 0;
+    /** The frames written to and read from the ring buffer since the stream started */
+    std::atomic<int64_t> mWriteFrames{0};
+    std::atomic<int64_t> mReadFrames{0};
+    std::atomic<float> mPriority{1.f};
+    WDL_TypedBuf<float> mBuffer;
+    /** The open file, only used by the I/O thread that has claimed the stream */
+    std::unique_ptr<WDL_FileRead> mFile;
+  };
+
+  template <typename T>
+  static void Deinterleave(const float* pSrc, int srcChans, T** outputs, int nChans, int startIdx, int nFrames)
+  {
+    for (auto c = 0; c < nChans; c++)
+    {
+      T* pDst = outputs[c] + startIdx;
+
+      if (c >= srcChans)
+        std::fill(pDst, pDst + nFrames, T(0));
+      else
+      {
+        for (auto s = 0; s < nFrames; s++)
+          pDst[s] = static_cast<T>(pSrc[s * srcChans + c]);
+      }
+    }
+  }
+
+  void Wake()
+  {
+    // notifying without the lock can miss a thread that is about to wait; its timeout bounds that
+    if (mNWaiting.load(std::memory_order_acquire) > 0)
+      mCondition.notify_one();
+  }
+
+  /** @return The stream that most needs frames read, claimed for this thread, or -1 */
+  int ClaimMostUrgent()
+  {
+    int best = -1;
+    float bestUrgency = 0.f;
+
+    for (auto i = 0; i < NStreams(); i++)
+    {
+      Stream& stream = mStreams[i];
+      const int state = stream.mState.load(std::memory_order_acquire);
+
+      if (state == kFree || stream.mClaimed.load(std::memory_order_relaxed))
+        continue;
+
+      if (state == kStopping)
+      {
+        if (!stream.mClaimed.exchange(true, std::memory_order_acquire))
+        {
+          FreeStream(stream);
+          stream.mClaimed.store(false, std::memory_order_release);
+        }
+
+        continue;
+      }
+
+      const StreamedSample& sample = *stream.mSample;
+      const int64_t writeFrames = stream.mWriteFrames.load(std::memory_order_relaxed);
+      const int64_t space = mBufferFrames - (writeFrames - stream.mReadFrames.load(std::memory_order_acquire));
+      const int64_t remaining = sample.NFrames() - (stream.mDiskStartFrame + writeFrames);
+
+      // worth a read once there is room for a full read, or for the rest of the sample
+      if (remaining <= 0 || space < std::min<int64_t>(mReadFrames, remaining))
+        continue;
+
+      // the frames still to play before the stream runs dry, divided by priority
+      const int64_t playFrame = stream.mPlayFrame.load(std::memory_order_relaxed);
+      const int64_t ahead = stream.mDiskStartFrame + writeFrames - playFrame;
+      const float urgency = static_cast<float>(ahead) / stream.mPriority.load(std::memory_order_relaxed);
+
+      if (best < 0 || urgency < bestUrgency)
+      {
+        best = i;
+        bestUrgency = urgency;
+      }
+    }
+
+    if (best >= 0 && mStreams[best].mClaimed.exchange(true, std::memory_order_acquire))
+      return -1; // another thread got there first, look again
+
+    return best;
+  }
+
+  /** Called by the I/O thread that has claimed a stopping stream */
+  void FreeStream(Stream& stream)
+  {
+    stream.mFile.reset();
+    stream.mSample.reset();
+    stream.mState.store(kFree, std::memory_order_release);
+  }
+
+  /** Read the next frames into a claimed stream's ring buffer */
+  void FillStream(Stream& stream, WDL_TypedBuf<unsigned char>& bytes)
+  {
+    const StreamedSample& sample = *stream.mSample;
+    const int sampleChans = sample.NChannels();
+
+    if (!stream.mFile)
+      stream.mFile.reset(new WDL_FileRead(sample.GetPath(), 0));
+
+    const int64_t writeFrames = stream.mWriteFrames.load(std::memory_order_relaxed);
+    const int64_t firstFrame = stream.mDiskStartFrame + writeFrames;
+    const int64_t space = mBufferFrames - (writeFrames - stream.mReadFrames.load(std::memory_order_acquire));
+    const int n = static_cast<int>(std::min<int64_t>(std::min<int64_t>(mReadFrames, space), sample.NFrames() - firstFrame));
+
+    if (n <= 0)
+      return;
+
+    bytes.Resize(n * sample.mBytesPerFrame, false);
+
+    const bool ok = stream.mFile->IsOpen() && !stream.mFile->SetPosition(sample.mDataOffset + firstFrame * sample.mBytesPerFrame)
+                    && stream.mFile->Read(bytes.Get(), bytes.GetSize()) == bytes.GetSize();
+
+    if (!ok)
+      memset(bytes.Get(), 0, bytes.GetSize()); // a missing or truncated file plays silence rather than stalling the voice
+
+    const int pos = static_cast<int>(writeFrames % mBufferFrames);
+    const int n1 = std::min(n, mBufferFrames - pos);
+    sample.Convert(bytes.Get(), stream.mBuffer.Get() + pos * sampleChans, n1);
+    sample.Convert(bytes.Get() + n1 * sample.mBytesPerFrame, stream.mBuffer.Get(), n - n1);
+    stream.mWriteFrames.store(writeFrames + n, std::memory_order_release);
+  }
+
+  void IOLoop()
+  {
+    WDL_TypedBuf<unsigned char> bytes;
+    bytes.Resize(mReadFrames * mMaxChannels * 8);
+
+    while (!mQuit.load(std::memory_order_relaxed))
+    {
+      const int streamIdx = ClaimMostUrgent();
+
+      if (streamIdx >= 0)
+      {
+        Stream& stream = mStreams[streamIdx];
+
+        if (stream.mState.load(std::memory_order_acquire) == kPlaying)
+          FillStream(stream, bytes);
+
+        stream.mClaimed.store(false, std::memory_order_release);
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(mMutex);
+      mNWaiting.fetch_add(1, std::memory_order_acq_rel);
+      mCondition.wait_for(lock, std::chrono::milliseconds(kWaitMs));
+      mNWaiting.fetch_sub(1, std::memory_order_acq_rel);
+    }
+  }
+
+  /** How long an idle I/O thread sleeps before looking at the streams again, if it isn't woken */
+  static constexpr int kWaitMs = 5;
+
+  const int mMaxChannels;
+  const int mBufferFrames;
+  const int mReadFrames;
+  std::vector<Stream> mStreams;
+  std::vector<std::thread> mThreads;
+  std::mutex mMutex;
+  std::condition_variable mCondition;
+  std::atomic<int> mNWaiting{0};
+  std::atomic<bool> mQuit{false};
+  std::atomic<int> mUnderruns{0};
+};
+
+/** A SynthVoice that plays a StreamedSample through a SampleStreamEngine, at the sample's own rate.
+ * The voice's disk priority follows its state in the VoiceAllocator: a held voice has priority 1, a released voice kReleasedPriority,
+ * both scaled by its level, and a voice that the allocator has hard-killed lets its stream go. The priority is updated in ProcessControl().
+ * Implement GetSampleForNote() to choose the sample, e.g. from a key and velocity map built when the library is loaded */
+class SampleStreamVoice : public SynthVoice
+{
+public:
+  /** The priority of a released voice relative to a held one */
+  static constexpr float kReleasedPriority = 0.25f;
+
+  /** @param engine The engine to stream from, which must outlive the voice
+   * @param releaseTime The fade out time after the voice is released, in seconds */
+  SampleStreamVoice(SampleStreamEngine& engine, double releaseTime = 0.05)
+  : mEngine(engine)
+  , mReleaseTime(releaseTime)
+  {
+    mBuffer.Resize(engine.GetMaxChannels() * kChunkFrames);
+    mChannels.Resize(engine.GetMaxChannels());
+
+    for (auto c = 0; c < engine.GetMaxChannels(); c++)
+      mChannels.Get()[c] = mBuffer.Get() + c * kChunkFrames;
+  }
+
+  ~SampleStreamVoice()
+  {
+    StopStream();
+  }
+
+  /** Choose the sample for a note. Called on the audio thread, so don't load or allocate here
+   * @param key The MIDI key
+   * @param level The normalised velocity
+   * @return The sample to play, or nullptr for none */
+  virtual std::shared_ptr<const StreamedSample> GetSampleForNote(int key, double level) = 0;
+
+  bool GetBusy() const override { return mStreamIdx >= 0; }
+
+  void Trigger(double level, bool isRetrigger) override
+  {
+    StopStream();
+    mLevel = level;
+    mReleased = false;
+    mGainRamp.Reset(level);
+    mStreamIdx = mEngine.StartStream(GetSampleForNote(mKey, level), 0, static_cast<float>(level));
+  }
+
+  void Release() override
+  {
+    mReleased = true;
+  }
+
+  void ProcessControl(int startIdx, int nFrames) override
+  {
+    if (mStreamIdx < 0)
+      return;
+
+    // the allocator hard-kills a voice by zeroing its gain
+    if (mGain == 0.)
+    {
+      StopStream();
+      return;
+    }
+
+    float priority = static_cast<float>(mLevel);
+
+    if (mReleased)
+    {
+      priority *= kReleasedPriority;
+      mGainRamp.SetTarget(std::max(mGainRamp.target - mLevel * nFrames / std::max(mReleaseTime * mSampleRate, 1.), 0.), nFrames);
+    }
+
+    mEngine.SetPriority(mStreamIdx, priority);
+  }
+
+  void ProcessSamplesAccumulating(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIdx, int nFrames) override
+  {
+    if (mStreamIdx < 0)
+      return;
+
+    const int nChans = std::min(nOutputs, mEngine.GetMaxChannels());
+
+    for (auto chunkStart = 0; chunkStart < nFrames; chunkStart += kChunkFrames)
+    {
+      const int n = std::min(kChunkFrames, nFrames - chunkStart);
+      mEngine.Read(mStreamIdx, mChannels.Get(), nChans, n);
+
+      for (auto s = 0; s < n; s++)
+      {
+        const sample gain = static_cast<sample>(mGainRamp.Process());
+
+        for (auto c = 0; c < nChans; c++)
+          outputs[c][startIdx + chunkStart + s] += mChannels.Get()[c][s] * gain;
+      }
+    }
+
+    if (mEngine.GetFinished(mStreamIdx) || (mReleased && mGainRamp.IsSettled() && mGainRamp.value <= 0.))
+      StopStream();
+  }
+
+  void SetSampleRate(double sampleRate) override { mSampleRate = sampleRate; }
+
+private:
+  void StopStream()
+  {
+    if (mStreamIdx >= 0)
+      mEngine.StopStream(mStreamIdx);
+
+    mStreamIdx = -1;
+  }
+
+  SampleStreamEngine& mEngine;
+  double mReleaseTime;
+  double mSampleRate = DEFAULT_SAMPLE_RATE;
+  double mLevel = 0.;
+  bool mReleased = false;
+  int mStreamIdx = -1;
+  ControlOutput mGainRamp;
+  /** The size of the scratch buffers that the stream is read into, in frames */
+  static constexpr int kChunkFrames = 64;
+  WDL_TypedBuf<sample> mBuffer;
+  WDL_TypedBuf<sample*> mChannels;
+};
+
+END_IPLUG_NAMESPACE
@@ -69,6 +69,18 @@ public:
   /** As with Trigger, called to do optional tasks when a voice is released. */
   virtual void Release() {};
 
+  /** Called when the VoiceAllocator ends a released voice that has stayed inaudible, see VoiceAllocator::SetSilenceRelease().
+   * Reset envelopes and feedback here, so that GetBusy() returns false. The allocator treats the voice as free until it is triggered again either way */
+  virtual void Kill() {};
+
+  /** The control-rate stage of the voice, called once per control block for each busy voice, before ProcessSamplesAccumulating() for the same block.
+   * Update envelopes, LFOs and modulation here rather than per sample, and pass the results to the audio stage through ControlOutput members with
+   * ControlOutput::SetTarget(value, nFrames), which interpolates them across the block. The control block size is the MidiSynth block size.
+   * This is always called on the audio thread, even when voices are rendered on worker threads.
+   * @param startIdx The start index of the block of samples that will be processed
+   * @param nFrames The number of samples in the block */
+  virtual void ProcessControl(int startIdx, int nFrames) {};
+
   /** Process a block of audio data for the voice
    @param inputs Pointer to input channel arrays. Sometimes synthesisers have audio inputs. Alternatively you can pass in modulation from global LFOs etc here.
    @param outputs Pointer to output channel arrays. You should add to the existing data in these arrays (so that all the voices get summed)
@@ -0,0 +1,67 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc SynthVoiceBank
+ */
+
+#include "SynthVoice.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Several busy voices gathered into structure-of-arrays layout, one lane per voice, so that voice DSP can fill SIMD registers.
+ * Lanes at or above mNLanes are padding: their voice pointer is nullptr and their gain and ramps are zero.
+ * The arrays are not over-aligned, use unaligned loads. */
+struct SynthVoiceLanes
+{
+  static constexpr int kMaxLanes = 8;
+
+  /** Control ramp values for one of the eControlNames, for every lane */
+  struct Ramps
+  {
+    double startValue[kMaxLanes];
+    double endValue[kMaxLanes];
+    int transitionStart[kMaxLanes];
+    int transitionEnd[kMaxLanes];
+  };
+
+  int mNLanes = 0;
+  SynthVoice* mVoices[kMaxLanes] = {};
+  int mVoiceIdx[kMaxLanes] = {};
+  double mGain[kMaxLanes] = {};
+  double mBasePitch[kMaxLanes] = {};
+  int mKey[kMaxLanes] = {};
+  int mChannel[kMaxLanes] = {};
+  Ramps mInputs[kNumVoiceControlRamps] = {};
+};
+
+/** An optional interface for rendering several voices in one call, instead of calling SynthVoice::ProcessSamplesAccumulating() for each one.
+ * The VoiceAllocator still triggers, releases and queries the individual SynthVoices, a bank only takes over their rendering.
+ * Your voices would typically keep their DSP state in the bank, indexed by SynthVoiceLanes::mVoiceIdx.
+ * @see VoiceAllocator::SetVoiceBank() */
+class SynthVoiceBank
+{
+public:
+  virtual ~SynthVoiceBank() {}
+
+  /** @return The number of voices to hand to ProcessLanesAccumulating() at once, between 1 and SynthVoiceLanes::kMaxLanes (typically 4 or 8, to match the SIMD width) */
+  virtual int GetNLanes() const = 0;
+
+  /** Process a block of audio data for up to GetNLanes() voices
+   * @param lanes The busy voices for this call, in structure-of-arrays layout
+   * @param outputs Pointer to output channel arrays. You should add to the existing data in these arrays (so that all the voices get summed)
+   * @see SynthVoice::ProcessSamplesAccumulating() for the other arguments */
+  virtual void ProcessLanesAccumulating(const SynthVoiceLanes& lanes, sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIdx, int nFrames) = 0;
+};
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,231 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc UnisonOscillator
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+#include "IPlugPlatform.h"
+#include "IPlugConstants.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A stack of detuned sawtooth oscillators for one synth voice, rendered in SIMD lanes and mixed to stereo.
+ * Use one in your SynthVoice instead of allocating a SynthVoice per unison voice: the stack is triggered, released and enveloped as one voice,
+ * so the envelopes and filters that follow it are shared and the VoiceAllocator only sees the one voice.
+ * The unison settings are per patch, and can change while the voice plays without clicks in the phases.
+ * The oscillators are PolyBLEP sawtooths, with float state. Nothing allocates.
+ *
+ * \code
+ * void ProcessSamplesAccumulating(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIdx, int nFrames) override
+ * {
+ *   mUnison.ProcessBlock(mFreqCPS, mLeft, mRight, nFrames); // mFreqCPS, mLeft and mRight are scratch buffers of the maximum block size
+ *   for (auto s = 0; s < nFrames; s++)
+ *   {
+ *     const sample env = mEnv.Process(mSustain);
+ *     outputs[0][startIdx + s] += mLeft[s] * env;
+ *     outputs[1][startIdx + s] += mRight[s] * env;
+ *   }
+ * }
+ * \endcode
+ * @tparam T The sample type of the frequency and output buffers */
+template <typename T = double>
+class UnisonOscillator
+{
+public:
+  /** The number of oscillators rendered together, the float SIMD width */
+  static constexpr int kNLanes = 4;
+
+  static constexpr int kMaxVoices = 16;
+
+  UnisonOscillator()
+  {
+    std::fill(mPhase, mPhase + kMaxVoices, 0.f);
+    UpdateVoices();
+  }
+
+  void SetSampleRate(double sampleRate)
+  {
+    mSampleRateReciprocal = static_cast<float>(1. / sampleRate);
+  }
+
+  /** @param nVoices The number of oscillators in the stack, between 1 and kMaxVoices */
+  void SetNVoices(int nVoices)
+  {
+    nVoices = std::max(1, std::min(nVoices, kMaxVoices));
+
+    if (nVoices != mNVoices)
+    {
+      mNVoices = nVoices;
+      UpdateVoices();
+    }
+  }
+
+  /** @param cents The detune between the lowest and the highest oscillator, in cents */
+  void SetDetune(double cents)
+  {
+    mDetuneCents = cents;
+    UpdateVoices();
+  }
+
+  /** @param spread 0. for all oscillators in the middle, 1. to pan the outermost oscillators hard left and right */
+  void SetStereoSpread(double spread)
+  {
+    mSpread = Clip(spread, 0., 1.);
+    UpdateVoices();
+  }
+
+  /** @param blend The level of the outermost oscillators relative to the middle one, between 0. and 1.
+   * The levels between are interpolated, and the stack is normalised to the power of one oscillator */
+  void SetBlend(double blend)
+  {
+    mBlend = Clip(blend, 0., 1.);
+    UpdateVoices();
+  }
+
+  int GetNVoices() const { return mNVoices; }
+
+  /** Call on each note on. Unison sounds static if the oscillators start in phase, so by default they get pseudo random phases
+   * @param seed Varies the start phases, e.g. pass the key or a note counter
+   * @param randomness 0. to start every oscillator at phase 0., 1. to spread them over the whole cycle */
+  void Trigger(uint32_t seed = 0, double randomness = 1.)
+  {
+    uint32_t state = seed * 2654435761u + 1u;
+
+    for (auto v = 0; v < kMaxVoices; v++)
+    {
+      state = state * 1664525u + 1013904223u; // LCG
+      mPhase[v] = static_cast<float>(randomness * (state >> 8) * (1. / 16777216.));
+    }
+  }
+
+  /** Render the mix of the stack, with a frequency for each sample
+   * @param pFreqCPS The frequency in Hz of the middle of the stack, for each sample
+   * @param pLeft The left output buffer, overwritten
+   * @param pRight The right output buffer, overwritten
+   * @param nFrames The number of samples to render */
+  void ProcessBlock(const T* pFreqCPS, T* pLeft, T* pRight, int nFrames)
+  {
+    const int nGroups = (mNVoices + kNLanes - 1) / kNLanes;
+
+    // the state is kept in locals while processing, as the compiler can't tell that members don't alias the buffers
+    alignas(16) float phase[kMaxVoices];
+    alignas(16) float incrRatio[kMaxVoices];
+    std::copy(mPhase, mPhase + kMaxVoices, phase);
+
+    for (auto v = 0; v < kMaxVoices; v++)
+      incrRatio[v] = mRatio[v] * mSampleRateReciprocal;
+
+    for (auto s = 0; s < nFrames; s++)
+    {
+      const float freq = static_cast<float>(pFreqCPS[s]);
+      float sumL[kNLanes] = {};
+      float sumR[kNLanes] = {};
+
+      for (auto g = 0; g < nGroups; g++)
+      {
+        float* pPhase = phase + g * kNLanes;
+        const float* pIncrRatio = incrRatio + g * kNLanes;
+        const float* pGainL = mGainL + g * kNLanes;
+        const float* pGainR = mGainR + g * kNLanes;
+
+        // branch free, so that each group of lanes is processed as one SIMD vector
+        for (auto l = 0; l < kNLanes; l++)
+        {
+          const float incr = std::min(freq * pIncrRatio[l], 0.5f);
+          float p = pPhase[l] + incr;
+          p = p >= 1.f ? p - 1.f : p;
+          pPhase[l] = p;
+
+          const float recipIncr = 1.f / std::max(incr, 1e-9f);
+          const float tStart = p * recipIncr; // < 1 in the sample after the wrap
+          const float tEnd = (p - 1.f) * recipIncr; // > -1 in the sample before the wrap
+          const float blepStart = tStart < 1.f ? tStart + tStart - tStart * tStart - 1.f : 0.f;
+          const float blepEnd = tEnd > -1.f ? tEnd * tEnd + tEnd + tEnd + 1.f : 0.f;
+          const float saw = p + p - 1.f - blepStart - blepEnd;
+
+          sumL[l] += saw * pGainL[l];
+          sumR[l] += saw * pGainR[l];
+        }
+      }
+
+      pLeft[s] = static_cast<T>((sumL[0] + sumL[1]) + (sumL[2] + sumL[3]));
+      pRight[s] = static_cast<T>((sumR[0] + sumR[1]) + (sumR[2] + sumR[3]));
+    }
+
+    std::copy(phase, phase + kMaxVoices, mPhase);
+  }
+
+  /** Render the mix of the stack at a fixed frequency
+   * @see ProcessBlock() */
+  void ProcessBlock(double freqCPS, T* pLeft, T* pRight, int nFrames)
+  {
+    T freq[kFixedFreqChunk];
+    std::fill(freq, freq + kFixedFreqChunk, static_cast<T>(freqCPS));
+
+    for (auto s = 0; s < nFrames; s += kFixedFreqChunk)
+      ProcessBlock(freq, pLeft + s, pRight + s, std::min(kFixedFreqChunk, nFrames - s));
+  }
+
+private:
+  static constexpr int kFixedFreqChunk = 64;
+
+  static double Clip(double x, double lo, double hi) { return std::max(lo, std::min(x, hi)); }
+
+  // Recompute the per oscillator frequency ratios and pan gains. Oscillators past mNVoices get zero gain
+  void UpdateVoices()
+  {
+    double gainSum = 0.;
+
+    for (auto v = 0; v < kMaxVoices; v++)
+    {
+      // position in the stack, from -1. for the lowest to 1. for the highest oscillator
+      const double pos = mNVoices > 1 ? (2. * v / (mNVoices - 1)) - 1. : 0.;
+      const double level = v < mNVoices ? 1. + (mBlend - 1.) * std::fabs(pos) : 0.;
+
+      // equal power, PI/4 is the middle. Alternate oscillators go to opposite sides, so that the stack isn't panned by pitch
+      const double side = (v & 1) ? -1. : 1.;
+      const double panAngle = PI * 0.25 * (1. + pos * mSpread * side);
+
+      mRatio[v] = static_cast<float>(std::pow(2., pos * mDetuneCents * 0.5 / 1200.));
+      mGainL[v] = static_cast<float>(level * std::cos(panAngle));
+      mGainR[v] = static_cast<float>(level * std::sin(panAngle));
+      gainSum += level * level;
+    }
+
+    const float norm = static_cast<float>(1. / std::sqrt(std::max(gainSum, 1e-9)));
+
+    for (auto v = 0; v < kMaxVoices; v++)
+    {
+      mGainL[v] *= norm;
+      mGainR[v] *= norm;
+    }
+  }
+
+  int mNVoices = 1;
+  double mDetuneCents = 0.;
+  double mSpread = 0.;
+  double mBlend = 1.;
+  float mSampleRateReciprocal = 1.f / 44100.f;
+
+  alignas(16) float mPhase[kMaxVoices];
+  alignas(16) float mRatio[kMaxVoices];
+  alignas(16) float mGainL[kMaxVoices];
+  alignas(16) float mGainR[kMaxVoices];
+};
+
+END_IPLUG_NAMESPACE
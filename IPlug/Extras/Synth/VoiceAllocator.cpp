@@ -11,6 +11,7 @@
 #include "VoiceAllocator.h"
 
 #include <algorithm>
+#include <cmath>
 #include <numeric>
 #include <iostream>
 
@@ -55,11 +56,35 @@ void VoiceAllocator::AddVoice(SynthVoice* pVoice, uint8_t zone)
 {
   if(mVoicePtrs.size() + 1 < UCHAR_MAX)
   {
+    const int voiceIdx = static_cast<int>(mVoicePtrs.size());
     mVoicePtrs.push_back(pVoice);
+    mBusyVoices.reserve(mVoicePtrs.size());
+    mMatchingVoices.reserve(mVoicePtrs.size());
     ClearVoiceInputs(pVoice);
     pVoice->mKey = -1;
     pVoice->mZone = zone;
 
+    // a new voice is free, holds no key, and is the most recently triggered
+    mKeyLinks.emplace_back();
+    mChannelLinks.emplace_back();
+    mAgeLinks.emplace_back();
+    mFreeLinks.emplace_back();
+    mVoiceKeySlot.push_back(-1);
+    mVoiceChannelSlot.push_back(-1);
+    mVoiceReleased.push_back(true);
+    mVoiceOutputBus.push_back(0);
+    mVoiceRenderBus.push_back(0);
+    mVoiceSilentBlocks.push_back(0);
+    mVoiceSilenced.push_back(false);
+    ListPushBack(mAgeList, mAgeLinks, voiceIdx);
+    ListPushBack(mFreeList, mFreeLinks, voiceIdx);
+
+    if(pVoice->mChannel < kNumChannels)
+    {
+      mVoiceChannelSlot[voiceIdx] = pVoice->mChannel;
+      ListPushBack(mChannelLists[pVoice->mChannel], mChannelLinks, voiceIdx);
+    }
+
     // make a glides structures for the control ramps of the new voice
     mVoiceGlides.emplace_back(ControlRampProcessor::Create(pVoice->mInputs));
   }
@@ -69,211 +94,325 @@ void VoiceAllocator::AddVoice(SynthVoice* pVoice, uint8_t zone)
   }
 }
 
-VoiceAllocator::VoiceBitsArray VoiceAllocator::VoicesMatchingAddress(VoiceAddress addr)
+void VoiceAllocator::ListPushBack(VoiceList& list, std::vector<VoiceLink>& links, int voiceIdx)
 {
-  const int n = static_cast<int>(mVoicePtrs.size());
-  VoiceBitsArray v;
+  links[voiceIdx].prev = list.tail;
+  links[voiceIdx].next = -1;
 
-  // set all bits to true
-  for(int i=0; i<n; ++i)
-  {
-    v[i] = true;
-  }
+  if(list.tail >= 0)
+    links[list.tail].next = voiceIdx;
+  else
+    list.head = voiceIdx;
 
-  // for each criterion present in address, clear any voice bits not matching
+  list.tail = voiceIdx;
+}
 
-  // zone
-  if(addr.mZone != kAllZones)
-  {
-    for(int i=0; i<n; ++i)
-    {
-      v[i] = v[i] & (mVoicePtrs[i]->mZone == addr.mZone);
-    }
-  }
+void VoiceAllocator::ListRemove(VoiceList& list, std::vector<VoiceLink>& links, int voiceIdx)
+{
+  VoiceLink& link = links[voiceIdx];
+
+  if(link.prev >= 0)
+    links[link.prev].next = link.next;
+  else
+    list.head = link.next;
+
+  if(link.next >= 0)
+    links[link.next].prev = link.prev;
+  else
+    list.tail = link.prev;
+
+  link.prev = link.next = -1;
+}
+
+void VoiceAllocator::UpdateVoiceKeyList(int voiceIdx)
+{
+  const SynthVoice* pVoice = mVoicePtrs[voiceIdx];
+  const bool inRange = (pVoice->mChannel < kNumChannels) && (pVoice->mKey < kNumKeys);
+  const int slot = inRange ? (pVoice->mChannel * kNumKeys + pVoice->mKey) : -1;
+
+  if(slot == mVoiceKeySlot[voiceIdx])
+    return;
+
+  if(mVoiceKeySlot[voiceIdx] >= 0)
+    ListRemove(mKeyLists[mVoiceKeySlot[voiceIdx]], mKeyLinks, voiceIdx);
+
+  if(slot >= 0)
+    ListPushBack(mKeyLists[slot], mKeyLinks, voiceIdx);
+
+  mVoiceKeySlot[voiceIdx] = slot;
+}
+
+const VoiceAllocator::VoiceIndexArray& VoiceAllocator::VoicesMatchingAddress(VoiceAddress addr)
+{
+  VoiceIndexArray& v = mMatchingVoices;
+  v.clear();
 
   // setting the flag kVoicesAll returns all voices matching the zone of the address.
-  if(addr.mFlags & kVoicesAll) return v;
+  const bool allInZone = (addr.mFlags & kVoicesAll);
+  const bool matchChannel = !allInZone && (addr.mChannel != kAllChannels);
+  const bool matchKey = !allInZone && (addr.mKey != kAllKeys);
+  const bool matchBusy = !allInZone && (addr.mFlags & kVoicesBusy);
 
-  // channel
-  if(addr.mChannel != kAllChannels)
-  {
-    for(int i=0; i<n; ++i)
+  // for each criterion present in address, reject any voice not matching
+  auto addIfMatching = [&](int i) {
+    const SynthVoice* pVoice = mVoicePtrs[i];
+
+    if((addr.mZone != kAllZones) && (pVoice->mZone != addr.mZone)) return;
+    if(matchChannel && (pVoice->mChannel != addr.mChannel)) return;
+    if(matchKey && (pVoice->mKey != addr.mKey)) return;
+    if(matchBusy && !IsVoiceBusy(i)) return;
+
+    v.push_back(i);
+  };
+
+  auto addList = [&](const VoiceList& list, const std::vector<VoiceLink>& links) {
+    for(int i=list.head; i>=0; i=links[i].next)
     {
-      v[i] = v[i] & (mVoicePtrs[i]->mChannel == addr.mChannel);
+      addIfMatching(i);
     }
-  }
+  };
 
-  // Key
-  if(addr.mKey != kAllKeys)
+  // use the smallest index that covers the address, only falling back to a scan of every voice for zone-wide addresses
+  if(matchKey && (addr.mKey < kNumKeys) && !(matchChannel && addr.mChannel >= kNumChannels))
   {
-    for(int i=0; i<n; ++i)
+    if(matchChannel)
     {
-      v[i] = v[i] & (mVoicePtrs[i]->mKey == addr.mKey);
+      addList(mKeyLists[addr.mChannel * kNumKeys + addr.mKey], mKeyLinks);
+    }
+    else
+    {
+      for(int c=0; c<kNumChannels; ++c)
+      {
+        addList(mKeyLists[c * kNumKeys + addr.mKey], mKeyLinks);
+      }
     }
   }
-
-  // busy flag
-  if(addr.mFlags & kVoicesBusy)
+  else if(matchChannel && (addr.mChannel < kNumChannels))
   {
-    for(int i=0; i<n; ++i)
+    addList(mChannelLists[addr.mChannel], mChannelLinks);
+  }
+  else
+  {
+    for(int i=0; i<mVoicePtrs.size(); ++i)
     {
-      v[i] = v[i] & mVoicePtrs[i]->GetBusy();
+      addIfMatching(i);
     }
   }
 
   // most recent
-  if(addr.mFlags & kVoicesMostRecent)
+  if(!allInZone && (addr.mFlags & kVoicesMostRecent) && !v.empty())
   {
-    int64_t maxT = -1;
-    int maxIdx = -1;
-    for(int i=0; i<n; ++i)
+    int maxIdx = v[0];
+
+    for(int i : v)
     {
-      if(v[i])
+      if(mVoicePtrs[i]->mLastTriggeredTime > mVoicePtrs[maxIdx]->mLastTriggeredTime)
       {
-        int64_t vt = mVoicePtrs[i]->mLastTriggeredTime;
-        if(vt > maxT)
-        {
-          maxT = vt;
-          maxIdx = i;
-        }
+        maxIdx = i;
       }
     }
 
-    // set all bits to false
-    //v.reset();
-    for(int i=0; i<n; ++i)
-    {
-      v[i] = 0;
-    }
-
-    if(maxIdx >= 0)
-    {
-      v[maxIdx] = true;
-    }
+    v.assign(1, maxIdx);
   }
+
   return v;
 }
 
-void VoiceAllocator::SendControlToVoiceInputs(VoiceBitsArray v, int ctlIdx, float val, int glideSamples)
+void VoiceAllocator::SendControlToVoiceInputs(const VoiceIndexArray& v, int ctlIdx, float val, int glideSamples)
 {
   // send control change to all matched voices through glide generators
-  for(int i=0; i<mVoicePtrs.size(); ++i)
+  for(int i : v)
   {
-    if(v[i])
+    mVoiceGlides[i]->at(ctlIdx).SetTarget(val, 0, glideSamples, mBlockSize);
+  }
+}
+
+bool VoiceAllocator::QueueChannelExpression(const VoiceInputEvent& event)
+{
+  const VoiceAddress& addr = event.mAddress;
+
+  if((event.mAction != kPitchBendAction) && (event.mAction != kPressureAction) && (event.mAction != kTimbreAction))
+    return false;
+
+  // only expression for a whole channel, as MPE sends on member channels, can be held back. The voices on a channel are listed already
+  if((addr.mChannel >= kNumChannels) || (addr.mKey != kAllKeys) || addr.mFlags)
+    return false;
+
+  const int c = addr.mChannel;
+
+  if(mChannelExpressionDirty[c] && (mChannelExpressionZone[c] != addr.mZone))
+    FlushChannelExpression();
+
+  const int e = (event.mAction == kPitchBendAction) ? 0 : (event.mAction == kPressureAction) ? 1 : 2;
+  mChannelExpression[c][e] = event.mValue;
+  mChannelExpressionZone[c] = addr.mZone;
+  mChannelExpressionDirty[c] |= (1 << e);
+  mChannelExpressionPending = true;
+  return true;
+}
+
+void VoiceAllocator::FlushChannelExpression()
+{
+  if(!mChannelExpressionPending)
+    return;
+
+  // glides set within a block merge into one from the block start anyway, so sending only the last value of each gives the same ramp
+  for(int c=0; c<kNumChannels; ++c)
+  {
+    const uint8_t dirty = mChannelExpressionDirty[c];
+
+    if(!dirty)
+      continue;
+
+    const uint8_t zone = mChannelExpressionZone[c];
+
+    for(int i=mChannelLists[c].head; i>=0; i=mChannelLinks[i].next)
     {
-      mVoiceGlides[i]->at(ctlIdx).SetTarget(val, 0, glideSamples, mBlockSize);
+      if((zone != kAllZones) && (mVoicePtrs[i]->mZone != zone))
+        continue;
+
+      for(int e=0; e<kNumChannelExpressions; ++e)
+      {
+        if(dirty & (1 << e))
+          mVoiceGlides[i]->at(kVoiceControlPitchBend + e).SetTarget(mChannelExpression[c][e], 0, mControlGlideSamples, mBlockSize);
+      }
     }
+
+    mChannelExpressionDirty[c] = 0;
   }
+
+  mChannelExpressionPending = false;
 }
 
-void VoiceAllocator::SendControlToVoicesDirect(VoiceBitsArray v, int ctlIdx, float val)
+void VoiceAllocator::SendControlToVoicesDirect(const VoiceIndexArray& v, int ctlIdx, float val)
 {
   // send generic control change directly to voice
-  for(int i=0; i<mVoicePtrs.size(); ++i)
+  for(int i : v)
   {
-    if(v[i])
-    {
-      mVoicePtrs[i]->SetControl(ctlIdx, val);
-    }
+    mVoicePtrs[i]->SetControl(ctlIdx, val);
   }
 }
 
-void VoiceAllocator::SendProgramChangeToVoices(VoiceBitsArray v, int pgm)
+void VoiceAllocator::SendProgramChangeToVoices(const VoiceIndexArray& v, int pgm)
 {
-  for(int i=0; i<mVoicePtrs.size(); ++i)
+  for(int i : v)
   {
-    if(v[i])
-    {
-      mVoicePtrs[i]->SetProgramNumber(pgm);
-    }
+    mVoicePtrs[i]->SetProgramNumber(pgm);
   }
 }
 
 void VoiceAllocator::ProcessEvents(int blockSize, int64_t sampleTime)
 {
-  while(mInputQueue.ElementsAvailable())
+  for(const VoiceInputEvent& event : mInputEvents.GetAll())
   {
-    VoiceInputEvent event;
-    mInputQueue.Pop(event);
-    VoiceAllocator::VoiceBitsArray voices = VoicesMatchingAddress(event.mAddress);
+    ProcessEvent(event, sampleTime);
+  }
 
-    switch(event.mAction)
+  mInputEvents.Clear();
+  FlushChannelExpression();
+  ProcessGlides(blockSize);
+}
+
+void VoiceAllocator::ProcessEvents(const VoiceInputEventArena& events, int startIndex, int blockSize, int64_t sampleTime)
+{
+  for(const VoiceInputEvent& event : events.GetRange(startIndex, startIndex + blockSize))
+  {
+    // make the offset relative to this sub-block
+    VoiceInputEvent subBlockEvent = event;
+    subBlockEvent.mSampleOffset -= startIndex;
+    ProcessEvent(subBlockEvent, sampleTime);
+  }
+
+  ProcessEvents(blockSize, sampleTime);
+}
+
+void VoiceAllocator::ProcessEvent(const VoiceInputEvent& event, int64_t sampleTime)
+{
+  if(QueueChannelExpression(event))
+    return;
+
+  // anything else may start, stop or address the voices the held back expression is for, so send it first to keep the order of events
+  FlushChannelExpression();
+
+  switch(event.mAction)
+  {
+    case kNoteOnAction:
     {
-      case kNoteOnAction:
-      {
-        NoteOn(event, sampleTime);
-        break;
-      }
-      case kNoteOffAction:
-      {
-        if(event.mAddress.mFlags == kVoicesAll)
-        {
-          SoftKillAllVoices();
-        }
-        else
-        {
-          NoteOff(event, sampleTime);
-        }
-        break;
-      }
-      case kPitchBendAction:
-      {
-        SendControlToVoiceInputs(voices, kVoiceControlPitchBend, event.mValue, mControlGlideSamples);
-        break;
-      }
-      case kPressureAction:
+      NoteOn(event, sampleTime);
+      break;
+    }
+    case kNoteOffAction:
+    {
+      if(event.mAddress.mFlags == kVoicesAll)
       {
-        SendControlToVoiceInputs(voices, kVoiceControlPressure, event.mValue, mControlGlideSamples);
-        break;
+        SoftKillAllVoices();
       }
-      case kTimbreAction:
+      else
       {
-        SendControlToVoiceInputs(voices, kVoiceControlTimbre, event.mValue, mControlGlideSamples);
-        break;
+        NoteOff(event, sampleTime);
       }
-      case kSustainAction:
+      break;
+    }
+    case kPitchBendAction:
+    {
+      SendControlToVoiceInputs(VoicesMatchingAddress(event.mAddress), kVoiceControlPitchBend, event.mValue, mControlGlideSamples);
+      break;
+    }
+    case kPressureAction:
+    {
+      SendControlToVoiceInputs(VoicesMatchingAddress(event.mAddress), kVoiceControlPressure, event.mValue, mControlGlideSamples);
+      break;
+    }
+    case kTimbreAction:
+    {
+      SendControlToVoiceInputs(VoicesMatchingAddress(event.mAddress), kVoiceControlTimbre, event.mValue, mControlGlideSamples);
+      break;
+    }
+    case kSustainAction:
+    {
+      mSustainPedalDown = (bool) (event.mValue >= 0.5);
+      if (!mSustainPedalDown) // sustain pedal released
       {
-        mSustainPedalDown = (bool) (event.mValue >= 0.5);
-        if (!mSustainPedalDown) // sustain pedal released
+        // if notes are sustaining, check that they're not still held and if not then stop voice
+        if (!mSustainedNotes.empty())
         {
-          // if notes are sustaining, check that they're not still held and if not then stop voice
-          if (!mSustainedNotes.empty())
+          for (auto susNotesItr = mSustainedNotes.begin(); susNotesItr != mSustainedNotes.end();)
           {
-            for (auto susNotesItr = mSustainedNotes.begin(); susNotesItr != mSustainedNotes.end();)
+            uint8_t key = *susNotesItr;
+            bool held = std::find(mHeldKeys.begin(), mHeldKeys.end(), key) != mHeldKeys.end();
+            if (!held)
             {
-              uint8_t key = *susNotesItr;
-              bool held = std::find(mHeldKeys.begin(), mHeldKeys.end(), key) != mHeldKeys.end();
-              if (!held)
-              {
-                StopVoices(VoicesMatchingAddress({event.mAddress.mZone, kAllChannels, key, 0}), event.mSampleOffset);
-                susNotesItr = mSustainedNotes.erase(susNotesItr);
-              }
-              else
-                susNotesItr++;
+              StopVoices(VoicesMatchingAddress({event.mAddress.mZone, kAllChannels, key, 0}), event.mSampleOffset);
+              susNotesItr = mSustainedNotes.erase(susNotesItr);
             }
+            else
+              susNotesItr++;
           }
         }
-        break;
-      }
-      case kControllerAction:
-      {
-        // called for any continuous controller other than the special #74 specified in MPE
-        SendControlToVoicesDirect(voices, event.mControllerNumber, event.mValue);
-        break;
-      }
-      case kProgramChangeAction:
-      {
-        SendProgramChangeToVoices(voices, event.mControllerNumber);
-        break;
-      }
-      case kNullAction:
-      default:
-      {
-        break;
       }
+      break;
+    }
+    case kControllerAction:
+    {
+      // called for any continuous controller other than the special #74 specified in MPE
+      SendControlToVoicesDirect(VoicesMatchingAddress(event.mAddress), event.mControllerNumber, event.mValue);
+      break;
+    }
+    case kProgramChangeAction:
+    {
+      SendProgramChangeToVoices(VoicesMatchingAddress(event.mAddress), event.mControllerNumber);
+      break;
+    }
+    case kNullAction:
+    default:
+    {
+      break;
     }
   }
+}
 
+void VoiceAllocator::ProcessGlides(int blockSize)
+{
   // update any glides in progress, writing voice control outputs
   for(auto& glides : mVoiceGlides)
   {
@@ -290,36 +429,34 @@ void VoiceAllocator::CalcGlideTimesInSamples()
   mControlGlideSamples = mControlGlideTime*mSampleRate;
 }
 
-int VoiceAllocator::FindFreeVoiceIndex(int startIndex) const
+int VoiceAllocator::FindFreeVoiceIndex() const
 {
-  size_t voices = mVoicePtrs.size();
-  for(int i=0; i<voices; ++i)
+  // released voices are listed in the order they were released, so the first that has finished is usually at the front.
+  // without rotation, reuse the most recently released voice instead
+  if(mRotateVoices)
   {
-    int j = (startIndex + i)%voices;
-    SynthVoice* pv = mVoicePtrs[j];
-    if(!pv->GetBusy())
+    for(int i=mFreeList.head; i>=0; i=mFreeLinks[i].next)
     {
-      return j;
+      if(!IsVoiceBusy(i))
+        return i;
     }
   }
-  return -1;
-}
-
-int VoiceAllocator::FindVoiceIndexToSteal(int64_t sampleTime) const
-{
-  size_t voices = mVoicePtrs.size();
-  int64_t earliestTime = sampleTime;
-  int longestPlayingVoiceIdx = 0;
-  for(int i=0; i<voices; ++i)
+  else
   {
-    SynthVoice* pv = mVoicePtrs[i];
-    if(pv->mLastTriggeredTime < earliestTime)
+    for(int i=mFreeList.tail; i>=0; i=mFreeLinks[i].prev)
     {
-      earliestTime = pv->mLastTriggeredTime;
-      longestPlayingVoiceIdx = i;
+      if(!IsVoiceBusy(i))
+        return i;
     }
   }
-  return longestPlayingVoiceIdx;
+
+  return -1;
+}
+
+int VoiceAllocator::FindVoiceIndexToSteal() const
+{
+  // the least recently triggered voice
+  return mAgeList.head;
 }
 
 // start a single voice and set its current channel and key.
@@ -341,19 +478,42 @@ void VoiceAllocator::StartVoice(int voiceIdx, int channel, int key, float pitch,
   pVoice->mKey = key;
   pVoice->mGain = 1.;
 
+  // update the index structures
+  const int channelSlot = (pVoice->mChannel < kNumChannels) ? pVoice->mChannel : -1;
+
+  if(channelSlot != mVoiceChannelSlot[voiceIdx])
+  {
+    if(mVoiceChannelSlot[voiceIdx] >= 0)
+      ListRemove(mChannelLists[mVoiceChannelSlot[voiceIdx]], mChannelLinks, voiceIdx);
+
+    if(channelSlot >= 0)
+      ListPushBack(mChannelLists[channelSlot], mChannelLinks, voiceIdx);
+
+    mVoiceChannelSlot[voiceIdx] = channelSlot;
+  }
+
+  UpdateVoiceKeyList(voiceIdx);
+  ListRemove(mAgeList, mAgeLinks, voiceIdx);
+  ListPushBack(mAgeList, mAgeLinks, voiceIdx);
+
+  if(mVoiceReleased[voiceIdx])
+  {
+    ListRemove(mFreeList, mFreeLinks, voiceIdx);
+    mVoiceReleased[voiceIdx] = false;
+  }
+
+  mVoiceSilenced[voiceIdx] = false;
+
   // call voice's Trigger method
   pVoice->Trigger(velocity, retrig);
 }
 
 // start all of the voice indexes marked in the VoieBitsArray and set the current channel and key of each.
-void VoiceAllocator::StartVoices(VoiceBitsArray vbits, int channel, int key, float pitch, float velocity, int sampleOffset, int64_t sampleTime, bool retrig)
+void VoiceAllocator::StartVoices(const VoiceIndexArray& voices, int channel, int key, float pitch, float velocity, int sampleOffset, int64_t sampleTime, bool retrig)
 {
-  for(int i=0; i<mVoicePtrs.size(); ++i)
+  for(int i : voices)
   {
-    if(vbits[i])
-    {
-      StartVoice(i, channel, key, pitch, velocity, sampleOffset, sampleTime, retrig);
-    }
+    StartVoice(i, channel, key, pitch, velocity, sampleOffset, sampleTime, retrig);
   }
 }
 
@@ -362,17 +522,23 @@ void VoiceAllocator::StopVoice(int voiceIdx, int sampleOffset)
   mVoiceGlides[voiceIdx]->at(kVoiceControlGate).SetTarget(0.0, sampleOffset, 1, mBlockSize);
   mVoicePtrs[voiceIdx]->mKey = -1;
   mVoicePtrs[voiceIdx]->Release();
+
+  UpdateVoiceKeyList(voiceIdx);
+
+  if(!mVoiceReleased[voiceIdx])
+  {
+    ListPushBack(mFreeList, mFreeLinks, voiceIdx);
+    mVoiceReleased[voiceIdx] = true;
+    mVoiceSilentBlocks[voiceIdx] = 0;
+  }
 }
 
-// stop all voices marked in the VoiceBitsArray.
-void VoiceAllocator::StopVoices(VoiceBitsArray vbits, int sampleOffset)
+// stop all voices in the VoiceIndexArray.
+void VoiceAllocator::StopVoices(const VoiceIndexArray& voices, int sampleOffset)
 {
-  for(int i=0; i<mVoicePtrs.size(); ++i)
+  for(int i : voices)
   {
-    if(vbits[i])
-    {
-      StopVoice(i, sampleOffset);
-    }
+    StopVoice(i, sampleOffset);
   }
 }
 
@@ -422,14 +588,10 @@ void VoiceAllocator::NoteOn(VoiceInputEvent e, int64_t sampleTime)
     }
     case kPolyModePoly:
     {
-      int i = FindFreeVoiceIndex(mVoiceRotateIndex);
+      int i = FindFreeVoiceIndex();
       if(i < 0)
       {
-        i = FindVoiceIndexToSteal(sampleTime);
-      }
-      if(mRotateVoices)
-      {
-        mVoiceRotateIndex = i + 1;
+        i = FindVoiceIndexToSteal();
       }
       if(i >= 0)
       {
@@ -527,14 +689,266 @@ void VoiceAllocator::NoteOff(VoiceInputEvent e, int64_t sampleTime)
   }
 }
 
-void VoiceAllocator::ProcessVoices(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIndex, int blockSize)
+void VoiceAllocator::SetRenderThreads(int nThreads, int maxOutputs, int maxBlockSize)
+{
+  mRenderPool.reset();
+
+  if(nThreads > 0)
+  {
+    mRenderPool.reset(new VoiceRenderPool(nThreads, maxOutputs, maxBlockSize));
+  }
+}
+
+void VoiceAllocator::SetVoiceOutputBus(int voiceIdx, int busIdx)
 {
-  for(auto pVoice : mVoicePtrs)
+  assert(busIdx >= 0 && busIdx < 64);
+  mVoiceOutputBus[voiceIdx] = busIdx;
+}
+
+void VoiceAllocator::SetZoneOutputBus(uint8_t zone, int busIdx)
+{
+  for(int i=0; i<mVoicePtrs.size(); ++i)
+  {
+    if(mVoicePtrs[i]->mZone == zone)
+    {
+      SetVoiceOutputBus(i, busIdx);
+    }
+  }
+}
+
+void VoiceAllocator::ProcessVoiceBank(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIndex, int blockSize, int bus)
+{
+  const int nLanes = Clip(mVoiceBank->GetNLanes(), 1, SynthVoiceLanes::kMaxLanes);
+  SynthVoiceLanes& lanes = mVoiceLanes;
+  lanes.mNLanes = 0;
+
+  auto flushLanes = [&]() {
+    // zero the padding lanes so that they can be processed without masking
+    for(int l=lanes.mNLanes; l<nLanes; ++l)
+    {
+      lanes.mVoices[l] = nullptr;
+      lanes.mVoiceIdx[l] = -1;
+      lanes.mGain[l] = 0.;
+      lanes.mBasePitch[l] = 0.;
+      lanes.mKey[l] = -1;
+      lanes.mChannel[l] = 0;
+
+      for(int r=0; r<kNumVoiceControlRamps; ++r)
+      {
+        lanes.mInputs[r].startValue[l] = lanes.mInputs[r].endValue[l] = 0.;
+        lanes.mInputs[r].transitionStart[l] = lanes.mInputs[r].transitionEnd[l] = 0;
+      }
+    }
+
+    mVoiceBank->ProcessLanesAccumulating(lanes, inputs, outputs, nInputs, nOutputs, startIndex, blockSize);
+    lanes.mNLanes = 0;
+  };
+
+  for(int i=0; i<mVoicePtrs.size(); ++i)
+  {
+    SynthVoice* pVoice = mVoicePtrs[i];
+
+    if(!IsVoiceBusy(i) || (bus >= 0 && mVoiceRenderBus[i] != bus))
+      continue;
+
+    const int l = lanes.mNLanes++;
+    lanes.mVoices[l] = pVoice;
+    lanes.mVoiceIdx[l] = i;
+    lanes.mGain[l] = pVoice->mGain;
+    lanes.mBasePitch[l] = pVoice->mBasePitch;
+    lanes.mKey[l] = pVoice->mKey;
+    lanes.mChannel[l] = pVoice->mChannel;
+
+    for(int r=0; r<kNumVoiceControlRamps; ++r)
+    {
+      const ControlRamp& ramp = pVoice->mInputs[r];
+      lanes.mInputs[r].startValue[l] = ramp.startValue;
+      lanes.mInputs[r].endValue[l] = ramp.endValue;
+      lanes.mInputs[r].transitionStart[l] = ramp.transitionStart;
+      lanes.mInputs[r].transitionEnd[l] = ramp.transitionEnd;
+    }
+
+    if(lanes.mNLanes == nLanes)
+    {
+      flushLanes();
+    }
+  }
+
+  if(lanes.mNLanes > 0)
+  {
+    flushLanes();
+  }
+}
+
+void VoiceAllocator::ProcessVoiceControl(int startIndex, int blockSize)
+{
+  // the control-rate stage, for every voice and then for anything shared between them, before any audio is rendered
+  for(int i=0; i<mVoicePtrs.size(); ++i)
+  {
+    if(IsVoiceBusy(i))
+    {
+      mVoicePtrs[i]->ProcessControl(startIndex, blockSize);
+    }
+  }
+
+  if(mControlFunc)
+  {
+    mControlFunc(startIndex, blockSize);
+  }
+}
+
+void VoiceAllocator::RenderVoices(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIndex, int blockSize, int bus)
+{
+  if(mVoiceBank)
+  {
+    ProcessVoiceBank(inputs, outputs, nInputs, nOutputs, startIndex, blockSize, bus);
+    return;
+  }
+
+  // released voices are measured one at a time if SetSilenceRelease() is on and the block fits its scratch buffer
+  const bool measure = (mSilenceBlocks > 0) && (nOutputs > 0) && (nOutputs <= mSilenceMaxOutputs) && (startIndex + blockSize <= mSilenceMaxBlockSize);
+
+  mBusyVoices.clear();
+  for(int i=0; i<mVoicePtrs.size(); ++i)
   {
-    // TODO distribute voices across cores
-    if(pVoice->GetBusy())
+    if(IsVoiceBusy(i) && (bus < 0 || mVoiceRenderBus[i] == bus) && !(measure && mVoiceReleased[i]))
+    {
+      mBusyVoices.push_back(mVoicePtrs[i]);
+    }
+  }
+
+  const int nBusy = static_cast<int>(mBusyVoices.size());
+
+  // not worth waking the workers for a handful of voices
+  if(mRenderPool && nBusy >= mMinVoicesPerThread * 2 && mRenderPool->CanProcess(nOutputs, startIndex + blockSize))
+  {
+    mRenderPool->ProcessVoices(mBusyVoices.data(), nBusy, inputs, outputs, nInputs, nOutputs, startIndex, blockSize);
+  }
+  else
+  {
+    for(auto pVoice : mBusyVoices)
     {
       pVoice->ProcessSamplesAccumulating(inputs, outputs, nInputs, nOutputs, startIndex, blockSize);
     }
   }
+
+  if(measure)
+  {
+    for(int i=mFreeList.head; i>=0; i=mFreeLinks[i].next)
+    {
+      if(IsVoiceBusy(i) && (bus < 0 || mVoiceRenderBus[i] == bus))
+      {
+        RenderVoiceMeasuring(i, inputs, outputs, nInputs, nOutputs, startIndex, blockSize);
+      }
+    }
+  }
+}
+
+void VoiceAllocator::RenderVoiceMeasuring(int voiceIdx, sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIndex, int blockSize)
+{
+  sample** scratch = mSilenceOutputs.data();
+
+  for(int c=0; c<nOutputs; ++c)
+  {
+    std::fill(scratch[c] + startIndex, scratch[c] + startIndex + blockSize, 0.);
+  }
+
+  mVoicePtrs[voiceIdx]->ProcessSamplesAccumulating(inputs, scratch, nInputs, nOutputs, startIndex, blockSize);
+
+  // four partial sums, so that the reduction can be vectorised without reordering floating point additions
+  sample sums[4] = {};
+
+  for(int c=0; c<nOutputs; ++c)
+  {
+    const sample* pSrc = scratch[c] + startIndex;
+    sample* pDst = outputs[c] + startIndex;
+    int s = 0;
+
+    for(; s + 4 <= blockSize; s += 4)
+    {
+      for(int k=0; k<4; ++k)
+      {
+        sums[k] += pSrc[s + k] * pSrc[s + k];
+        pDst[s + k] += pSrc[s + k];
+      }
+    }
+
+    for(; s < blockSize; ++s)
+    {
+      sums[0] += pSrc[s] * pSrc[s];
+      pDst[s] += pSrc[s];
+    }
+  }
+
+  const double meanSquare = (sums[0] + sums[1] + sums[2] + sums[3]) / (nOutputs * blockSize);
+
+  if(meanSquare >= mSilenceThresholdSquared)
+  {
+    mVoiceSilentBlocks[voiceIdx] = 0;
+  }
+  else if(++mVoiceSilentBlocks[voiceIdx] >= mSilenceBlocks)
+  {
+    mVoiceSilenced[voiceIdx] = true;
+    mVoicePtrs[voiceIdx]->Kill();
+  }
+}
+
+void VoiceAllocator::SetSilenceRelease(double thresholdDB, int nBlocks, int maxOutputs, int maxBlockSize)
+{
+  mSilenceThresholdSquared = std::pow(10., thresholdDB / 10.);
+  mSilenceBlocks = std::max(nBlocks, 0);
+  mSilenceMaxOutputs = mSilenceBlocks ? maxOutputs : 0;
+  mSilenceMaxBlockSize = mSilenceBlocks ? maxBlockSize : 0;
+
+  mSilenceBuffer.assign(mSilenceMaxOutputs * mSilenceMaxBlockSize, 0.);
+  mSilenceOutputs.resize(mSilenceMaxOutputs);
+
+  for(int c=0; c<mSilenceMaxOutputs; ++c)
+  {
+    mSilenceOutputs[c] = mSilenceBuffer.data() + (c * mSilenceMaxBlockSize);
+  }
+
+  std::fill(mVoiceSilentBlocks.begin(), mVoiceSilentBlocks.end(), 0);
+}
+
+void VoiceAllocator::ProcessVoices(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIndex, int blockSize)
+{
+  ProcessVoiceControl(startIndex, blockSize);
+  RenderVoices(inputs, outputs, nInputs, nOutputs, startIndex, blockSize, -1);
+}
+
+uint64_t VoiceAllocator::ProcessVoices(sample** inputs, int nInputs, const IBusBuffers* outputBuses, int nOutputBuses, int startIndex, int blockSize)
+{
+  assert(nOutputBuses > 0);
+
+  ProcessVoiceControl(startIndex, blockSize);
+
+  // find the buses in use, so that each is rendered in one pass however many voices it has
+  uint64_t busesUsed = 0;
+
+  for(int i=0; i<mVoicePtrs.size(); ++i)
+  {
+    if(!IsVoiceBusy(i))
+      continue;
+
+    int bus = mVoiceOutputBus[i];
+
+    if(bus >= nOutputBuses || !outputBuses[bus].IsConnected())
+      bus = 0;
+
+    mVoiceRenderBus[i] = bus;
+    busesUsed |= (uint64_t(1) << bus);
+  }
+
+  for(int b=0; b<nOutputBuses && b<64; ++b)
+  {
+    if((busesUsed >> b) & 1)
+    {
+      // if bus 0 isn't connected either the voices still run, with nowhere to write
+      const IBusBuffers& bus = outputBuses[b];
+      RenderVoices(inputs, bus.mChannels, nInputs, bus.mNChans, startIndex, blockSize, b);
+    }
+  }
+
+  return busesUsed;
 }
@@ -15,17 +15,21 @@
  * @copydoc VoiceAllocator
  */
 
+#include <algorithm>
 #include <array>
+#include <climits>
 #include <vector>
 #include <stdint.h>
 #include <functional>
-#include <bitset>
 //#include <iostream>
 
 #include "IPlugLogger.h"
 #include "IPlugQueue.h"
+#include "IPlugStructs.h"
 
 #include "SynthVoice.h"
+#include "SynthVoiceBank.h"
+#include "VoiceRenderPool.h"
 
 BEGIN_IPLUG_NAMESPACE
 
@@ -78,6 +82,97 @@ struct VoiceInputEvent
   int mSampleOffset;
 };
 
+/** A fixed-capacity list of VoiceInputEvents for one processing block, kept sorted by mSampleOffset.
+ * It is filled and read on the same thread, so unlike a queue there are no atomics, and events can be added in bulk and read back as a range of sample offsets.
+ * Adding never allocates: when the arena is full further events are dropped. */
+class VoiceInputEventArena
+{
+public:
+  /** A range of events that can be used with range-based for loops */
+  struct Range
+  {
+    const VoiceInputEvent* pBegin;
+    const VoiceInputEvent* pEnd;
+
+    const VoiceInputEvent* begin() const { return pBegin; }
+    const VoiceInputEvent* end() const { return pEnd; }
+    int Size() const { return static_cast<int>(pEnd - pBegin); }
+  };
+
+  VoiceInputEventArena(int capacity = 1024) { Resize(capacity); }
+
+  /** Set the capacity, clearing the arena. Allocates, so call off the audio thread */
+  void Resize(int capacity)
+  {
+    mEvents.resize(capacity);
+    mSize = 0;
+  }
+
+  void Clear() { mSize = 0; }
+
+  int Size() const { return mSize; }
+  int Capacity() const { return static_cast<int>(mEvents.size()); }
+  bool Empty() const { return mSize == 0; }
+
+  /** Add an event. Events arriving in order are appended, an earlier one is inserted after any events with the same offset
+   * @return \c false if the arena is full and the event was dropped */
+  bool Add(const VoiceInputEvent& event)
+  {
+    if(mSize == Capacity())
+      return false;
+
+    VoiceInputEvent* pBegin = mEvents.data();
+    VoiceInputEvent* pEnd = pBegin + mSize;
+
+    if(mSize == 0 || (pEnd - 1)->mSampleOffset <= event.mSampleOffset)
+    {
+      *pEnd = event;
+    }
+    else
+    {
+      VoiceInputEvent* pPos = std::upper_bound(pBegin, pEnd, event, CompareOffsets);
+      std::move_backward(pPos, pEnd, pEnd + 1);
+      *pPos = event;
+    }
+
+    mSize++;
+    return true;
+  }
+
+  /** Add several events at once
+   * @return The number of events added, less than nEvents if the arena filled up */
+  int Add(const VoiceInputEvent* pEvents, int nEvents)
+  {
+    const int nToAdd = std::min(nEvents, Capacity() - mSize);
+
+    for(int i=0; i<nToAdd; ++i)
+    {
+      Add(pEvents[i]);
+    }
+
+    return nToAdd;
+  }
+
+  /** @return All the events, in order */
+  Range GetAll() const { return {mEvents.data(), mEvents.data() + mSize}; }
+
+  /** @return The events with startOffset <= mSampleOffset < endOffset, in order */
+  Range GetRange(int startOffset, int endOffset) const
+  {
+    const VoiceInputEvent* pBegin = mEvents.data();
+    const VoiceInputEvent* pEnd = pBegin + mSize;
+    auto lower = [](const VoiceInputEvent& e, int offset) { return e.mSampleOffset < offset; };
+    const VoiceInputEvent* pFirst = std::lower_bound(pBegin, pEnd, startOffset, lower);
+    return {pFirst, std::lower_bound(pFirst, pEnd, endOffset, lower)};
+  }
+
+private:
+  static bool CompareOffsets(const VoiceInputEvent& a, const VoiceInputEvent& b) { return a.mSampleOffset < b.mSampleOffset; }
+
+  std::vector<VoiceInputEvent> mEvents;
+  int mSize = 0;
+};
+
 #pragma mark - VoiceAllocator class
 
 class VoiceAllocator final
@@ -100,6 +195,9 @@ public:
 
   static constexpr int kVoiceMostRecent = 1 << 7;
 
+  /** The number of busy voices per thread below which ProcessVoices() renders on the audio thread alone */
+  static constexpr int kDefaultMinVoicesPerThread = 4;
+
   // one voice worth of ramp generators
   using VoiceControlRamps = ControlRampProcessor::ProcessorArray<kNumVoiceControlRamps>;
 
@@ -121,14 +219,26 @@ public:
    */
   void AddVoice(SynthVoice* pv, uint8_t zone);
 
-  /** Add a single event to the input queue for the current processing block.
+  /** Add a single event to the input events for the current processing block.
    */
-  void AddEvent(VoiceInputEvent e) { mInputQueue.Push(e); }
+  void AddEvent(VoiceInputEvent e) { mInputEvents.Add(e); }
 
-  /** Process all input events and generate voice outputs.
+  /** Add several events to the input events for the current processing block.
+   */
+  void AddEvents(const VoiceInputEvent* pEvents, int nEvents) { mInputEvents.Add(pEvents, nEvents); }
+
+  /** Process all input events added with AddEvent() and generate voice outputs.
    */
   void ProcessEvents(int samples, int64_t sampleTime);
 
+  /** Process the events in an arena that fall within a sub-block, followed by any added with AddEvent(), and generate voice outputs.
+   * This lets a caller convert a whole host block of events once and hand each sub-block its range, without copying them into the allocator.
+   * @param events Events with sample offsets relative to the start of the host block
+   * @param startIndex The offset of this sub-block within the host block, events in [startIndex, startIndex + samples) are processed
+   * @param samples The size of the sub-block
+   * @param sampleTime The sample time of the start of the sub-block */
+  void ProcessEvents(const VoiceInputEventArena& events, int startIndex, int samples, int64_t sampleTime);
+
   /** Turn all voice gates off, allowing any voice envelopes to finish.
    */
   void SoftKillAllVoices();
@@ -145,40 +255,165 @@ public:
 
   void ProcessVoices(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIndex, int blockSize);
 
+  /** Render each voice into the channels of its output bus, see SetVoiceOutputBus(). A voice whose bus the host hasn't connected is rendered into bus 0
+   * @param inputs Input channel arrays
+   * @param nInputs The number of input channels
+   * @param outputBuses The output buses, e.g. from IPlugProcessor::ProcessBusBlock()
+   * @param nOutputBuses The number of output buses, at least 1
+   * @param startIndex The offset of this sub-block in the channel arrays
+   * @param blockSize The size of the sub-block
+   * @return A bit for each bus that voices were rendered into, the other buses were not touched */
+  uint64_t ProcessVoices(sample** inputs, int nInputs, const IBusBuffers* outputBuses, int nOutputBuses, int startIndex, int blockSize);
+
+  /** Route a voice to an output bus, for multi-output instruments such as drum machines. Every voice starts on bus 0
+   * @param voiceIdx The voice
+   * @param busIdx The output bus, < 64 */
+  void SetVoiceOutputBus(int voiceIdx, int busIdx);
+
+  /** Route all of the voices in a zone to an output bus, see SetVoiceOutputBus() */
+  void SetZoneOutputBus(uint8_t zone, int busIdx);
+
+  /** Render busy voices on the threads of the IWorkerPool as well as the audio thread. Call from a non-realtime thread while audio is not running.
+   * Only use this if your voices do not share any state while processing.
+   * @param nThreads The most worker threads to render on at once, 0 renders all voices on the audio thread
+   * @param maxOutputs The maximum number of output channels that will be passed to ProcessVoices()
+   * @param maxBlockSize The maximum value of startIndex + blockSize that will be passed to ProcessVoices() */
+  void SetRenderThreads(int nThreads, int maxOutputs, int maxBlockSize);
+
+  /** End voices that stay inaudible after their note is released, for voices whose GetBusy() is true long after that, e.g. with long release tails or feedback.
+   * Each released voice is rendered into a scratch buffer and measured before it is added to the outputs, and it is killed, see SynthVoice::Kill(),
+   * once its level has been under the threshold for a number of sub-blocks in a row. Released voices are rendered on the audio thread while this is on,
+   * and it has no effect with a voice bank, which doesn't render voices one at a time. Call from a non-realtime thread while audio is not running.
+   * @param thresholdDB The RMS level of a sub-block, across the output channels, below which a voice counts as silent
+   * @param nBlocks The number of silent sub-blocks after which a voice is ended, 0 to turn this off
+   * @param maxOutputs The maximum number of output channels that will be passed to ProcessVoices()
+   * @param maxBlockSize The maximum value of startIndex + blockSize that will be passed to ProcessVoices() */
+  void SetSilenceRelease(double thresholdDB, int nBlocks, int maxOutputs, int maxBlockSize);
+
+  /** @return \c true if a voice is busy and hasn't been ended by SetSilenceRelease() */
+  bool IsVoiceBusy(int voiceIdx) const { return !mVoiceSilenced[voiceIdx] && mVoicePtrs[voiceIdx]->GetBusy(); }
+
+  /** @param n The minimum number of busy voices per participating thread before voices are rendered in parallel */
+  void SetMinVoicesPerThread(int n) { mMinVoicesPerThread = n; }
+
+  int GetNRenderThreads() const { return mRenderPool ? mRenderPool->NWorkers() : 0; }
+
+  /** Render busy voices in groups through a SynthVoiceBank instead of one at a time. We do not take ownership of the bank.
+   * When a bank is set it is used instead of the render threads.
+   * @param pBank The bank to render with, or nullptr to go back to calling each SynthVoice */
+  void SetVoiceBank(SynthVoiceBank* pBank) { mVoiceBank = pBank; }
+
+  /** Set a function to be called once per control block in ProcessVoices(), after every busy voice's SynthVoice::ProcessControl() and before the voices are rendered.
+   * Use it for control-rate work shared between voices, such as global LFOs or evaluating a ModMatrix
+   * @param func Called with the start index and size of the block, or nullptr for none */
+  void SetControlFunc(const std::function<void(int startIdx, int nFrames)>& func) { mControlFunc = func; }
+
   size_t GetNVoices() const {return mVoicePtrs.size();}
   SynthVoice* GetVoice(int voiceIndex) const {return mVoicePtrs[voiceIndex];}
   void SetPitchOffset(float offset) { mPitchOffset = offset; }
 
 private:
-  using VoiceBitsArray = std::bitset<UCHAR_MAX>;
+  using VoiceIndexArray = std::vector<int>;
+
+  static constexpr int kNumChannels = 16;
+  static constexpr int kNumKeys = 128;
+  static constexpr int kNumChannelExpressions = 3; // pitch bend, pressure and timbre, in the order of the voice control ramps
+
+  /** Links for a voice in one of the intrusive, doubly linked voice lists */
+  struct VoiceLink
+  {
+    int prev{-1};
+    int next{-1};
+  };
+
+  struct VoiceList
+  {
+    int head{-1};
+    int tail{-1};
+  };
+
+  static void ListPushBack(VoiceList& list, std::vector<VoiceLink>& links, int voiceIdx);
+  static void ListRemove(VoiceList& list, std::vector<VoiceLink>& links, int voiceIdx);
+
+  /** @return The voices matching an address. This is a reference to a scratch array that is overwritten by the next call */
+  const VoiceIndexArray& VoicesMatchingAddress(VoiceAddress va);
 
-  VoiceBitsArray VoicesMatchingAddress(VoiceAddress va);
+  void SendControlToVoiceInputs(const VoiceIndexArray& v, int ctlIdx, float val, int glideSamples);
+  /** If an event is pitch bend, pressure or timbre for a whole channel, hold on to its value instead of finding the voices it is for.
+   * With MPE a controller can send these on every member channel each millisecond, so only the last value per channel in a sub-block is sent
+   * @return \c true if the event was held back */
+  bool QueueChannelExpression(const VoiceInputEvent& event);
 
-  void SendControlToVoiceInputs(VoiceBitsArray v, int ctlIdx, float val, int glideSamples);
-  void SendControlToVoicesDirect(VoiceBitsArray v, int ctlIdx, float val);
-  void SendProgramChangeToVoices(VoiceBitsArray v, int pgm);
+  /** Send the held back expression to the voices on each channel */
+  void FlushChannelExpression();
+
+  void SendControlToVoicesDirect(const VoiceIndexArray& v, int ctlIdx, float val);
+  void SendProgramChangeToVoices(const VoiceIndexArray& v, int pgm);
 
   void StartVoice(int voiceIdx, int channel, int key, float pitch, float velocity, int sampleOffset, int64_t sampleTime, bool retrig);
-  void StartVoices(VoiceBitsArray voices, int channel, int key, float pitch, float velocity, int sampleOffset, int64_t sampleTime, bool retrig);
+  void StartVoices(const VoiceIndexArray& voices, int channel, int key, float pitch, float velocity, int sampleOffset, int64_t sampleTime, bool retrig);
 
   void StopVoice(int voiceIdx, int sampleOffset);
-  void StopVoices(VoiceBitsArray voices, int sampleOffset);
+  void StopVoices(const VoiceIndexArray& voices, int sampleOffset);
+
+  /** Move a voice to the key list for its channel and key, or out of the key lists if either is out of range */
+  void UpdateVoiceKeyList(int voiceIdx);
+
+  /** Call SynthVoice::ProcessControl() on the busy voices, then the control function */
+  void ProcessVoiceControl(int startIndex, int blockSize);
+
+  /** Render the busy voices, or only those being rendered into one output bus
+   * @param bus The bus, or -1 for every voice */
+  void RenderVoices(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIndex, int blockSize, int bus);
+
+  void ProcessVoiceBank(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIndex, int blockSize, int bus);
+
+  /** Render a released voice into the silence scratch buffer, add it to the outputs and end it if it has been silent for long enough */
+  void RenderVoiceMeasuring(int voiceIdx, sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIndex, int blockSize);
 
   void CalcGlideTimesInSamples();
   void ClearVoiceInputs(SynthVoice* pVoice);
-  int FindFreeVoiceIndex(int startIndex) const;
-  int FindVoiceIndexToSteal(int64_t sampleTime) const;
+  int FindFreeVoiceIndex() const;
+  int FindVoiceIndexToSteal() const;
+
+  void ProcessEvent(const VoiceInputEvent& event, int64_t sampleTime);
+  void ProcessGlides(int blockSize);
 
   void NoteOn(VoiceInputEvent e, int64_t sampleTime);
   void NoteOff(VoiceInputEvent e, int64_t sampleTime);
 
-  IPlugQueue<VoiceInputEvent> mInputQueue{1024};
+  VoiceInputEventArena mInputEvents{1024};
 
   std::vector<SynthVoice*> mVoicePtrs;
   std::vector<std::unique_ptr<VoiceControlRamps>> mVoiceGlides;
+  std::vector<SynthVoice*> mBusyVoices; // scratch list for ProcessVoices(), reserved in AddVoice()
   std::vector<int> mHeldKeys; // The currently physically held keys on the keyboard
   std::vector<int> mSustainedNotes; // Any notes that are sustained, including those that are physically held
 
+  // index structures so that voices can be found without scanning them all, sized in AddVoice()
+  std::vector<VoiceLink> mKeyLinks; // voices holding a key, listed per channel and key
+  std::vector<VoiceLink> mChannelLinks; // every voice, listed per channel
+  std::vector<VoiceLink> mAgeLinks; // every voice, least recently triggered first
+  std::vector<VoiceLink> mFreeLinks; // released voices, least recently released first
+  std::vector<int> mVoiceKeySlot; // the key list each voice is in, or -1
+  std::vector<int> mVoiceChannelSlot; // the channel list each voice is in, or -1
+  std::vector<bool> mVoiceReleased; // whether each voice is in the free list
+  std::vector<int> mVoiceOutputBus; // the output bus each voice is routed to
+  std::vector<int> mVoiceRenderBus; // the bus each voice is rendered into by the current ProcessVoices() call
+  std::vector<int> mVoiceSilentBlocks; // the number of silent sub-blocks in a row since each voice was released
+  std::vector<bool> mVoiceSilenced; // whether each voice has been ended by SetSilenceRelease() since it was last triggered
+  VoiceList mKeyLists[kNumChannels * kNumKeys];
+  VoiceList mChannelLists[kNumChannels];
+  VoiceList mAgeList;
+  VoiceList mFreeList;
+  VoiceIndexArray mMatchingVoices; // scratch array returned by VoicesMatchingAddress()
+
+  // expression held back by QueueChannelExpression() until the end of the sub-block
+  float mChannelExpression[kNumChannels][kNumChannelExpressions] = {};
+  uint8_t mChannelExpressionZone[kNumChannels] = {};
+  uint8_t mChannelExpressionDirty[kNumChannels] = {}; // a bit for each expression that has a value
+  bool mChannelExpressionPending{false};
+
   std::function<double(int)> mKeyToPitchFn;
   double mPitchOffset{0.};
 
@@ -186,11 +421,26 @@ private:
   double mControlGlideTime{0.01};
   int mNoteGlideSamples{0}; // glide for note-to-note portamento
   int mControlGlideSamples{0}; // glide for controls including pitch bend
-  double mSampleRate;
+  double mSampleRate{DEFAULT_SAMPLE_RATE};
   int mBlockSize;
 
+  SynthVoiceBank* mVoiceBank = nullptr;
+  SynthVoiceLanes mVoiceLanes;
+
+  std::function<void(int, int)> mControlFunc;
+
+  std::unique_ptr<VoiceRenderPool> mRenderPool;
+  int mMinVoicesPerThread{kDefaultMinVoicesPerThread};
+
+  // SetSilenceRelease()
+  std::vector<sample> mSilenceBuffer;
+  std::vector<sample*> mSilenceOutputs;
+  double mSilenceThresholdSquared{0.};
+  int mSilenceBlocks{0};
+  int mSilenceMaxOutputs{0};
+  int mSilenceMaxBlockSize{0};
+
   bool mRotateVoices{true};
-  int mVoiceRotateIndex{0};
   bool mSustainPedalDown{false};
   float mModWheel{0.f};
   float mMinHeldVelocity{1.f};
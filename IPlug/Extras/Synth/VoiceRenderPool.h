@@ -0,0 +1,232 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc VoiceRenderPool
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+#include "IPlugWorkerPool.h"
+#include "SynthVoice.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Renders busy SynthVoices on the shared IWorkerPool in parallel with the audio thread.
+ * Voices are claimed one at a time from a shared counter, so the audio thread always takes part
+ * and will render any voices the workers have not picked up yet: a late or parked worker
+ * costs parallelism, never a dropout. Each worker accumulates into its own buffers, which are
+ * summed into the outputs once all claimed voices have finished.
+ * Your SynthVoice::ProcessSamplesAccumulating() must only touch state owned by the voice when using this. */
+class VoiceRenderPool final : public IWorkerJob
+{
+public:
+  /** Construct the pool and register it with the IWorkerPool. Call from a non-realtime thread.
+   * @param nWorkers The most worker threads that render voices at once, in addition to the audio thread. Limited to the threads in the IWorkerPool
+   * @param maxOutputs The maximum number of output channels that will be rendered
+   * @param maxBlockSize The maximum host block size, in samples */
+  VoiceRenderPool(int nWorkers, int maxOutputs, int maxBlockSize)
+  : mPool(IWorkerPool::Acquire())
+  , mMaxOutputs(maxOutputs)
+  , mMaxBlockSize(maxBlockSize)
+  {
+    const int nBuffers = std::min(nWorkers, mPool->NThreads());
+
+    for (auto i = 0; i < nBuffers; i++)
+    {
+      std::unique_ptr<Worker> pWorker(new Worker);
+      pWorker->mBuffer.resize(maxOutputs * maxBlockSize);
+      pWorker->mOutputs.resize(maxOutputs);
+
+      for (auto c = 0; c < maxOutputs; c++)
+        pWorker->mOutputs[c] = pWorker->mBuffer.data() + (c * maxBlockSize);
+
+      mWorkers.push_back(std::move(pWorker));
+    }
+
+    mPool->Register(this);
+  }
+
+  ~VoiceRenderPool()
+  {
+    mPool->Unregister(this);
+  }
+
+  VoiceRenderPool(const VoiceRenderPool&) = delete;
+  VoiceRenderPool& operator=(const VoiceRenderPool&) = delete;
+
+  int NWorkers() const { return static_cast<int>(mWorkers.size()); }
+
+  /** @return \c true if the worker buffers are large enough for a job of this size */
+  bool CanProcess(int nOutputs, int endIdx) const
+  {
+    return nOutputs <= mMaxOutputs && endIdx <= mMaxBlockSize;
+  }
+
+  /** Render a list of voices, accumulating into outputs. Called on the audio thread. Does not allocate or lock.
+   * @param pVoices Pointer to an array of the voices to render
+   * @param nVoices The number of voices in pVoices
+   * @see SynthVoice::ProcessSamplesAccumulating() for the other arguments */
+  void ProcessVoices(SynthVoice** pVoices, int nVoices, sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIdx, int nFrames)
+  {
+    assert(CanProcess(nOutputs, startIdx + nFrames));
+
+    mJobVoices = pVoices;
+    mJobInputs = inputs;
+    mJobNInputs = nInputs;
+    mJobNOutputs = nOutputs;
+    mJobStartIdx = startIdx;
+    mJobNFrames = nFrames;
+    mVoicesDone.store(0, std::memory_order_relaxed);
+
+    // publishing the claim word hands the job to the workers
+    const uint32_t gen = ++mGeneration;
+    mClaim.store((static_cast<uint64_t>(gen) << 32) | (static_cast<uint64_t>(nVoices) << 16), std::memory_order_release);
+    mPool->Notify();
+
+    // the audio thread renders straight into the outputs
+    int voiceIdx;
+    while (Claim(gen, voiceIdx))
+    {
+      pVoices[voiceIdx]->ProcessSamplesAccumulating(inputs, outputs, nInputs, nOutputs, startIdx, nFrames);
+      mVoicesDone.fetch_add(1, std::memory_order_release);
+    }
+
+    // only voices already claimed by a worker are still in flight here. They can't be taken back, so wait for them without hogging the core,
+    // and give way to the workers if one has been preempted
+    for (auto spins = 0; mVoicesDone.load(std::memory_order_acquire) < nVoices; spins++)
+    {
+      if (spins < kMaxSpins)
+        SpinPause();
+      else
+        std::this_thread::yield();
+    }
+
+    for (auto& pWorker : mWorkers)
+    {
+      if (pWorker->mUsedGeneration.load(std::memory_order_relaxed) != gen)
+        continue;
+
+      for (auto c = 0; c < nOutputs; c++)
+      {
+        const sample* pSrc = pWorker->mOutputs[c];
+        sample* pDst = outputs[c];
+
+        for (auto s = startIdx; s < startIdx + nFrames; s++)
+          pDst[s] += pSrc[s];
+      }
+    }
+  }
+
+  /** The audio thread is waiting for the voices, so unclaimed ones are due immediately */
+  int64_t GetDeadline() const override
+  {
+    const uint64_t claim = mClaim.load(std::memory_order_acquire);
+    return (claim & 0xFFFF) < ((claim >> 16) & 0xFFFF) ? 0 : kNoWork;
+  }
+
+  bool RunWork(int threadIdx) override
+  {
+    if (threadIdx >= NWorkers())
+      return false;
+
+    Worker& worker = *mWorkers[threadIdx];
+    const uint32_t gen = CurrentGeneration();
+    bool didWork = false;
+    int voiceIdx;
+
+    // after a successful claim the job fields are stable until we report the voice done
+    while (Claim(gen, voiceIdx))
+    {
+      if (worker.mUsedGeneration.load(std::memory_order_relaxed) != gen)
+      {
+        for (auto c = 0; c < mJobNOutputs; c++)
+          std::fill(worker.mOutputs[c] + mJobStartIdx, worker.mOutputs[c] + mJobStartIdx + mJobNFrames, 0.);
+
+        worker.mUsedGeneration.store(gen, std::memory_order_relaxed);
+      }
+
+      mJobVoices[voiceIdx]->ProcessSamplesAccumulating(mJobInputs, worker.mOutputs.data(), mJobNInputs, mJobNOutputs, mJobStartIdx, mJobNFrames);
+      mVoicesDone.fetch_add(1, std::memory_order_release);
+      didWork = true;
+    }
+
+    return didWork;
+  }
+
+private:
+  static constexpr int kMaxSpins = 1000; // pauses before the audio thread yields while waiting for the workers' voices
+
+  // the buffers of one IWorkerPool thread
+  struct Worker
+  {
+    std::vector<sample> mBuffer;
+    std::vector<sample*> mOutputs;
+    std::atomic<uint32_t> mUsedGeneration{0};
+  };
+
+  // The claim word packs generation (32 bits) | number of voices (16 bits) | next voice (16 bits),
+  // so a worker that wakes up late can never claim a voice from a newer job.
+  bool Claim(uint32_t gen, int& voiceIdx)
+  {
+    uint64_t claim = mClaim.load(std::memory_order_acquire);
+
+    while (true)
+    {
+      if (static_cast<uint32_t>(claim >> 32) != gen)
+        return false;
+
+      const int count = static_cast<int>((claim >> 16) & 0xFFFF);
+      const int next = static_cast<int>(claim & 0xFFFF);
+
+      if (next >= count)
+        return false;
+
+      if (mClaim.compare_exchange_weak(claim, claim + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+      {
+        voiceIdx = next;
+        return true;
+      }
+    }
+  }
+
+  uint32_t CurrentGeneration() const
+  {
+    return static_cast<uint32_t>(mClaim.load(std::memory_order_acquire) >> 32);
+  }
+
+  std::shared_ptr<IWorkerPool> mPool;
+  std::vector<std::unique_ptr<Worker>> mWorkers; // indexed by IWorkerPool thread
+  int mMaxOutputs;
+  int mMaxBlockSize;
+
+  // the current job, written by the audio thread before the claim word is published
+  SynthVoice** mJobVoices = nullptr;
+  sample** mJobInputs = nullptr;
+  int mJobNInputs = 0;
+  int mJobNOutputs = 0;
+  int mJobStartIdx = 0;
+  int mJobNFrames = 0;
+  uint32_t mGeneration = 0; // only touched by the audio thread
+
+  std::atomic<uint64_t> mClaim{0};
+  std::atomic<int> mVoicesDone{0};
+};
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,282 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include <stdint.h>
+
+#include "IPlugPlatform.h"
+#include "IPlugConstants.h"
+#include "IPlugSharedStorage.h"
+#include "Oscillator.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+enum EWavetableWaveform
+{
+  kWavetableSine = 0,
+  kWavetableSaw,
+  kWavetableSquare,
+  kWavetableTriangle,
+  kNumWavetableWaveforms
+};
+
+/** A single-cycle waveform stored as a set of mip levels, one per octave, each band-limited to half the harmonics of the previous one.
+ * Building a bank is expensive and allocates, so do it off the audio thread, and share banks between oscillators with GetShared() */
+template <typename T>
+class WavetableBank
+{
+public:
+  static constexpr int kTableSizeBits = 12;
+  static constexpr int kTableSize = 1 << kTableSizeBits;
+  static constexpr int kMaxHarmonics = kTableSize / 4; // harmonics in level 0, 20kHz at a 20Hz fundamental
+  static constexpr int kNumLevels = 11; // kMaxHarmonics >> (kNumLevels - 1) == 1, a sine
+
+  /** Build a bank from harmonic amplitudes and phases
+   * @param amplitudes The amplitude of each harmonic, amplitudes[0] is the fundamental
+   * @param phases The phase of each harmonic in radians, can be empty for all sine phase */
+  WavetableBank(const std::vector<double>& amplitudes, const std::vector<double>& phases = {})
+  {
+    Build(amplitudes, phases);
+  }
+
+  /** Build a bank for one of the basic waveforms */
+  WavetableBank(EWavetableWaveform waveform)
+  {
+    std::vector<double> amplitudes(kMaxHarmonics, 0.);
+
+    for (auto k = 1; k <= kMaxHarmonics; k++)
+    {
+      double& amp = amplitudes[k - 1];
+
+      switch (waveform)
+      {
+        case kWavetableSine: amp = (k == 1) ? 1. : 0.; break;
+        case kWavetableSaw: amp = ((k & 1) ? 1. : -1.) / k; break;
+        case kWavetableSquare: amp = (k & 1) ? 1. / k : 0.; break;
+        case kWavetableTriangle: amp = (k & 1) ? (((k >> 1) & 1) ? -1. : 1.) / (k * k) : 0.; break;
+        default: break;
+      }
+    }
+
+    Build(amplitudes, {});
+  }
+
+  /** Build a bank from one cycle of a waveform, which is analysed to find its harmonics
+   * @param pCycle The samples of one cycle
+   * @param nSamples The number of samples in pCycle */
+  static std::shared_ptr<const WavetableBank> FromCycle(const T* pCycle, int nSamples)
+  {
+    const int nHarmonics = std::min(static_cast<int>(kMaxHarmonics), nSamples / 2);
+    std::vector<double> amplitudes(nHarmonics);
+    std::vector<double> phases(nHarmonics);
+
+    for (auto k = 1; k <= nHarmonics; k++)
+    {
+      double re = 0., im = 0.;
+
+      for (auto s = 0; s < nSamples; s++)
+      {
+        const double w = 2. * PI * k * s / nSamples;
+        re += pCycle[s] * std::cos(w);
+        im += pCycle[s] * std::sin(w);
+      }
+
+      // as a sine: a * sin(w + phi)
+      amplitudes[k - 1] = 2. * std::sqrt(re * re + im * im) / nSamples;
+      phases[k - 1] = std::atan2(re, im);
+    }
+
+    return std::make_shared<const WavetableBank>(amplitudes, phases);
+  }
+
+  /** @return A bank for one of the basic waveforms, shared with every other caller while anyone holds a reference to it */
+  static std::shared_ptr<const WavetableBank> GetShared(EWavetableWaveform waveform)
+  {
+    static SharedStorage<WavetableBank> sBanks;
+    static const char* sKeys[kNumWavetableWaveforms] = { "sine", "saw", "square", "triangle" };
+
+    return sBanks.FindOrCreate(sKeys[waveform], [waveform]() { return new WavetableBank(waveform); });
+  }
+
+  /** @param level The mip level, 0 has the most harmonics
+   * @return Pointer to kTableSize + 1 samples, the last being a copy of the first for interpolation */
+  const T* GetLevel(int level) const { return mTables.data() + (level * (kTableSize + 1)); }
+
+  /** @param phaseIncr The oscillator frequency as a fraction of the sample rate
+   * @return The mip level with the most harmonics that will not alias at this frequency */
+  static int LevelForPhaseIncr(double phaseIncr)
+  {
+    // the highest harmonic of level L is (kMaxHarmonics >> L) * phaseIncr, which needs to be below 0.5
+    const double ratio = 2. * kMaxHarmonics * std::abs(phaseIncr);
+
+    if (ratio <= 1.)
+      return 0;
+
+    return std::min(kNumLevels - 1, static_cast<int>(std::ceil(std::log2(ratio))));
+  }
+
+private:
+  void Build(const std::vector<double>& amplitudes, const std::vector<double>& phases)
+  {
+    mTables.assign(kNumLevels * (kTableSize + 1), T(0));
+    std::vector<double> cycle(kTableSize);
+    double norm = 1.;
+
+    for (auto level = 0; level < kNumLevels; level++)
+    {
+      const int nHarmonics = std::min<int>(static_cast<int>(amplitudes.size()), kMaxHarmonics >> level);
+      std::fill(cycle.begin(), cycle.end(), 0.);
+
+      for (auto k = 1; k <= nHarmonics; k++)
+      {
+        const double amp = amplitudes[k - 1];
+        const double phase = (k - 1) < static_cast<int>(phases.size()) ? phases[k - 1] : 0.;
+
+        if (amp == 0.)
+          continue;
+
+        for (auto s = 0; s < kTableSize; s++)
+        {
+          cycle[s] += amp * std::sin(2. * PI * k * s / kTableSize + phase);
+        }
+      }
+
+      // normalise every level by the peak of level 0, so that levels match in loudness
+      if (level == 0)
+      {
+        double peak = 0.;
+
+        for (auto s = 0; s < kTableSize; s++)
+          peak = std::max(peak, std::abs(cycle[s]));
+
+        norm = peak > 0. ? 1. / peak : 1.;
+      }
+
+      T* pTable = mTables.data() + (level * (kTableSize + 1));
+
+      for (auto s = 0; s < kTableSize; s++)
+        pTable[s] = static_cast<T>(cycle[s] * norm);
+
+      pTable[kTableSize] = pTable[0];
+    }
+  }
+
+  std::vector<T> mTables;
+};
+
+/** An oscillator that plays a WavetableBank, choosing the mip level from the frequency so that it does not alias.
+ * Prefer the ProcessBlock() methods, which render a buffer at a time. The phase is accumulated in 32 bit fixed point, so it wraps for free */
+template <typename T>
+class WavetableOscillator : public IOscillator<T>
+{
+public:
+  using Bank = WavetableBank<T>;
+
+  WavetableOscillator(std::shared_ptr<const Bank> pBank = Bank::GetShared(kWavetableSaw), double startPhase = 0., double startFreq = 1.)
+  : IOscillator<T>(startPhase, startFreq)
+  , mBank(pBank)
+  {
+  }
+
+  /** Swap the bank. Not realtime safe if this drops the last reference to the old bank */
+  void SetBank(std::shared_ptr<const Bank> pBank) { mBank = pBank; }
+
+  inline T Process(double freqHz) override
+  {
+    IOscillator<T>::SetFreqCPS(freqHz);
+
+    T output = 0.;
+    ProcessBlock(&output, 1);
+
+    return output;
+  }
+
+  /** Render a block at the frequency set by SetFreqCPS() */
+  void ProcessBlock(T* pOutput, int nFrames)
+  {
+    const T* pTable = mBank->GetLevel(Bank::LevelForPhaseIncr(IOscillator<T>::mPhaseIncr));
+    uint32_t phase = ToFixed(IOscillator<T>::mPhase);
+    const uint32_t phaseIncr = IncrToFixed(IOscillator<T>::mPhaseIncr);
+
+    for (auto s = 0; s < nFrames; s++)
+    {
+      pOutput[s] = Interpolate(pTable, phase);
+      phase += phaseIncr;
+    }
+
+    IOscillator<T>::mPhase = FromFixed(phase);
+  }
+
+  /** Render a block with a frequency for each sample. The mip level is chosen once per block, from the highest frequency
+   * @param pFreqCPS The frequency in Hz of each sample
+   * @param pOutput The output buffer
+   * @param nFrames The number of samples to render */
+  void ProcessBlock(const T* pFreqCPS, T* pOutput, int nFrames)
+  {
+    const double sampleRateReciprocal = IOscillator<T>::mSampleRateReciprocal;
+    T maxFreq = 0.;
+
+    for (auto s = 0; s < nFrames; s++)
+      maxFreq = std::max(maxFreq, static_cast<T>(std::abs(pFreqCPS[s])));
+
+    const T* pTable = mBank->GetLevel(Bank::LevelForPhaseIncr(maxFreq * sampleRateReciprocal));
+    uint32_t phase = ToFixed(IOscillator<T>::mPhase);
+
+    for (auto s = 0; s < nFrames; s++)
+    {
+      pOutput[s] = Interpolate(pTable, phase);
+      phase += IncrToFixed(pFreqCPS[s] * sampleRateReciprocal);
+    }
+
+    if (nFrames)
+      IOscillator<T>::SetFreqCPS(pFreqCPS[nFrames - 1]);
+
+    IOscillator<T>::mPhase = FromFixed(phase);
+  }
+
+private:
+  static constexpr int kFracBits = 32 - Bank::kTableSizeBits;
+  static constexpr uint32_t kFracMask = (1u << kFracBits) - 1;
+
+  static inline uint32_t ToFixed(double phase)
+  {
+    // wrap into [0, 1) first, so that negative phases and increments work
+    return static_cast<uint32_t>(static_cast<int64_t>((phase - std::floor(phase)) * 4294967296.));
+  }
+
+  static inline uint32_t IncrToFixed(double phaseIncr)
+  {
+    // increments are less than a cycle, so negative ones can rely on two's complement wrapping
+    return static_cast<uint32_t>(static_cast<int64_t>(phaseIncr * 4294967296.));
+  }
+
+  static inline double FromFixed(uint32_t phase)
+  {
+    return phase * (1. / 4294967296.);
+  }
+
+  static inline T Interpolate(const T* pTable, uint32_t phase)
+  {
+    const uint32_t idx = phase >> kFracBits;
+    const T frac = static_cast<T>((phase & kFracMask) * (1. / (1u << kFracBits)));
+    const T f1 = pTable[idx];
+    const T f2 = pTable[idx + 1];
+    return f1 + frac * (f2 - f1);
+  }
+
+  std::shared_ptr<const Bank> mBank;
+};
+
+END_IPLUG_NAMESPACE
@@ -1,12 +1,20 @@
 #include "IWebsocketEditorDelegate.h"
 #include "IPlugStructs.h"
+#include "IGraphics.h"
+#include "zlib.h"
 
 using namespace iplug;
+using namespace igraphics;
 
 IWebsocketEditorDelegate::IWebsocketEditorDelegate(int nParams)
 : IGEditorDelegate(nParams)
 {
-  
+  mPendingParams.Resize(nParams);
+  mPendingParamIdx.Resize(nParams);
+  mPendingParamIdx.Resize(0, false);
+
+  for (int i = 0; i < nParams; i++)
+    mPendingParams.Get()[i] = PendingParam();
 }
 
 IWebsocketEditorDelegate::~IWebsocketEditorDelegate()
@@ -16,6 +24,7 @@ IWebsocketEditorDelegate::~IWebsocketEditorDelegate()
 void IWebsocketEditorDelegate::OnWebsocketReady(int connIdx)
 {
   //TODO: need to send serialize state and send it to the client
+  mNeedFullFrame = true;
 }
 
 bool IWebsocketEditorDelegate::OnWebsocketText(int connIdx, const char* pStr, size_t dataSize)
@@ -45,8 +54,24 @@ bool IWebsocketEditorDelegate::OnWebsocketData(int connIdx, void* pData, size_t
     msg.mData1 = * ((uint8_t*)(pByteData + pos)); pos++;
     msg.mData2 = * ((uint8_t*)(pByteData + pos)); pos++;
 
+    DeferMidiMsg(msg); // straight to the processor, rather than waiting for ProcessWebsocketQueue()
     mMIDIFromClients.Push(msg);
   }
+  // Send Input Event from UI, when streaming frames
+  else if (memcmp(pData, "SIEFUI" , 6) == 0 && dataSize >= pos + 7 * sizeof(int) + 4)
+  {
+    RemoteInputEvent event;
+    memcpy(&event.type, pByteData + pos, sizeof(int)); pos += 4;
+    memcpy(&event.x, pByteData + pos, sizeof(float)); pos += 4;
+    memcpy(&event.y, pByteData + pos, sizeof(float)); pos += 4;
+    memcpy(&event.dX, pByteData + pos, sizeof(float)); pos += 4;
+    memcpy(&event.dY, pByteData + pos, sizeof(float)); pos += 4;
+    memcpy(&event.mods, pByteData + pos, sizeof(int)); pos += 4;
+    memcpy(&event.vk, pByteData + pos, sizeof(int)); pos += 4;
+    memcpy(event.utf8, pByteData + pos, 4);
+    
+    mInputFromClients.Push(event);
+  }
   // Send Sysex Message from UI
   else if (memcmp(pData, "SSMFUI" , 6) == 0)
   {
@@ -112,7 +137,7 @@ void IWebsocketEditorDelegate::SendArbitraryMsgFromUI(int messageTag, int contro
 
 void IWebsocketEditorDelegate::SendParameterValueFromUI(int paramIdx, double value)
 {
-  DoSPVFDToClients(paramIdx, value, -1 /*Server-side UI edit, send to all clients*/);
+  AddPendingParam(paramIdx, value, -1 /*Server-side UI edit, send to all clients*/);
   IGEditorDelegate::SendParameterValueFromUI(paramIdx, value);
 }
 
@@ -128,7 +153,8 @@ void IWebsocketEditorDelegate::SendControlValueFromDelegate(int controlTag, doub
   data.Put(&controlTag);
   data.Put(&normalizedValue);
   
-  SendDataToConnection(-1, data.GetData(), data.Size());
+  // only the latest value of a control needs to reach a client that is behind
+  SendDataToConnection(-1, data.GetData(), data.Size(), -1, MakeCompactKey('SCVF', controlTag));
   
   IGEditorDelegate::SendControlValueFromDelegate(controlTag, normalizedValue);
 }
@@ -173,6 +199,24 @@ void IWebsocketEditorDelegate::SendMidiMsgFromDelegate(const IMidiMsg& msg)
   IGEditorDelegate::SendMidiMsgFromDelegate(msg);
 }
 
+void IWebsocketEditorDelegate::SendMidiMsgsFromDelegate(const IMidiMsg* pMsgs, int nMsgs)
+{
+  IByteChunk data;
+  
+  for (int i = 0; i < nMsgs; i++)
+  {
+    data.Clear();
+    data.PutStr("SMMFD");
+    data.Put(&pMsgs[i].mStatus);
+    data.Put(&pMsgs[i].mData1);
+    data.Put(&pMsgs[i].mData2);
+    
+    SendDataToConnection(-1, data.GetData(), data.Size());
+  }
+  
+  IGEditorDelegate::SendMidiMsgsFromDelegate(pMsgs, nMsgs);
+}
+
 void IWebsocketEditorDelegate::SendSysexMsgFromDelegate(const ISysEx& msg)
 {
   IByteChunk data;
@@ -187,39 +231,271 @@ void IWebsocketEditorDelegate::SendSysexMsgFromDelegate(const ISysEx& msg)
 
 void IWebsocketEditorDelegate::ProcessWebsocketQueue()
 {
-  while(mParamChangeFromClients.ElementsAvailable())
+  ParamTupleCX p;
+
+  while (mParamChangeFromClients.Pop(p))
+    AddPendingParam(p.idx, p.value, p.connection);
+
+  const int nPending = mPendingParamIdx.GetSize();
+  const int* pPendingIdx = mPendingParamIdx.Get();
+
+  if (nPending)
   {
-    ParamTupleCX p;
-    mParamChangeFromClients.Pop(p);
-    
+    // apply every change from the clients under one lock. Changes that don't change the parameter are dropped, rather than being applied and echoed
     ENTER_PARAMS_MUTEX;
-    IParam* pParam = GetParam(p.idx);
-    
-    if(pParam)
-      pParam->SetNormalized(p.value);
+    for (int i = 0; i < nPending; i++)
+    {
+      PendingParam& pending = mPendingParams.Get()[pPendingIdx[i]];
+
+      if (pending.connection < 0)
+        continue;
+
+      IParam* pParam = GetParam(pPendingIdx[i]);
+
+      if (pParam->GetNormalized() == pending.value)
+        pending.pending = false;
+      else
+        pParam->SetNormalized(pending.value);
+    }
     LEAVE_PARAMS_MUTEX;
 
-    OnParamChange(p.idx, kHost, -1);
-    OnParamChangeUI(p.idx, kHost);
+    for (int i = 0; i < nPending; i++)
+    {
+      const int paramIdx = pPendingIdx[i];
+      const PendingParam& pending = mPendingParams.Get()[paramIdx];
 
-    DoSPVFDToClients(p.idx, p.value, p.connection /* exclude = connection */);
-    
-    SendParameterValueFromDelegate(p.idx, p.value, true); // TODO:  if the parameter hasn't changed maybe we shouldn't do anything?
+      if (pending.connection < 0 || !pending.pending)
+        continue;
+
+#ifdef PARAMS_LOCKFREE
+      DeferParamChange(paramIdx, kHost);
+#else
+      OnParamChange(paramIdx, kHost, -1);
+#endif
+      OnParamChangeUI(paramIdx, kHost);
+      SendParameterValueFromDelegate(paramIdx, pending.value, true);
+    }
+
+    SendPendingParamsToClients();
   }
   
-  while (mMIDIFromClients.ElementsAvailable()) {
-    IMidiMsg msg;
-    mMIDIFromClients.Pop(msg);
+  IMidiMsg msg;
+
+  while (mMIDIFromClients.Pop(msg))
+  {
     IGEditorDelegate::SendMidiMsgFromDelegate(msg); // Call the superclass, since we don't want to send another MIDI message to the websocket
-    DeferMidiMsg(msg); // can't just call SendMidiMsgFromUI here which would cause a feedback loop
   }
+  
+  IGraphics* pGraphics = GetUI();
+  
+  // the UI is recreated each time the editor opens, so the frame function is installed on whichever UI is open
+  if (mStreamFrames && pGraphics && pGraphics != mStreamingUI)
+  {
+    pGraphics->SetFrameDrawnFunc([this](IGraphics& graphics, const IRECTList& rects) { StreamFrame(graphics, rects); });
+    mStreamingUI = pGraphics;
+    mNeedFullFrame = true;
+  }
+  else if (!pGraphics)
+  {
+    mStreamingUI = nullptr;
+  }
+  
+  RemoteInputEvent event;
+  
+  while (mInputFromClients.Pop(event))
+  {
+    if (mStreamingUI)
+      ApplyRemoteInput(event);
+  }
+  
+  if (mStreamingUI && mNeedFullFrame.exchange(false))
+    mStreamingUI->SetAllControlsDirty();
 }
 
-void IWebsocketEditorDelegate::DoSPVFDToClients(int paramIdx, double value, int excludeIdx)
+void IWebsocketEditorDelegate::SetStreamFrames(bool stream)
 {
-  IByteChunk data;
-  data.PutStr("SPVFD");
-  data.Put(&paramIdx);
-  data.Put(&value);
-  SendDataToConnection(-1, data.GetData(), data.Size(), excludeIdx);
+  mStreamFrames = stream;
+  
+  if (!stream && mStreamingUI)
+  {
+    if (mStreamingUI == GetUI())
+      mStreamingUI->SetFrameDrawnFunc(nullptr);
+    
+    mStreamingUI = nullptr;
+  }
+}
+
+void IWebsocketEditorDelegate::StreamFrame(IGraphics& graphics, const IRECTList& rects)
+{
+  // strips bound the size of each message, so that a large redraw doesn't hold up everything else queued for a client
+  static constexpr int kStripHeight = 64;
+  
+  if (!NClients())
+    return;
+  
+  mFrameScale = graphics.GetScreenScale();
+  const int frameWidth = static_cast<int>(graphics.Width() * mFrameScale);
+  const int frameHeight = static_cast<int>(graphics.Height() * mFrameScale);
+  
+  for (int i = 0; i < rects.Size(); i++)
+  {
+    const IRECT bounds = rects.Get(i);
+    
+    for (float top = bounds.T; top < bounds.B; top += kStripHeight / mFrameScale)
+    {
+      const IRECT strip(bounds.L, top, bounds.R, std::min(bounds.B, top + kStripHeight / mFrameScale));
+      int width, height;
+      
+      if (!graphics.GetFramePixels(strip, mFramePixels, width, height))
+        return;
+      
+      uLongf compressedSize = compressBound(mFramePixels.GetSize());
+      mCompressedPixels.Resize(static_cast<int>(compressedSize), false);
+      
+      if (compress2(mCompressedPixels.Get(), &compressedSize, mFramePixels.Get(), mFramePixels.GetSize(), Z_BEST_SPEED) != Z_OK)
+        continue;
+      
+      const IRECT pixels = strip.GetScaled(mFrameScale).GetPixelAligned();
+      const int x = static_cast<int>(pixels.L);
+      const int y = static_cast<int>(pixels.T);
+      const int size = static_cast<int>(compressedSize);
+      
+      mFrame.Clear();
+      mFrame.PutStr("SFBFD");
+      mFrame.Put(&frameWidth);
+      mFrame.Put(&frameHeight);
+      mFrame.Put(&x);
+      mFrame.Put(&y);
+      mFrame.Put(&width);
+      mFrame.Put(&height);
+      mFrame.Put(&size);
+      mFrame.PutBytes(mCompressedPixels.Get(), size);
+      
+      SendDataToConnection(-1, mFrame.GetData(), mFrame.Size());
+    }
+  }
+}
+
+void IWebsocketEditorDelegate::ApplyRemoteInput(const RemoteInputEvent& event)
+{
+  const float x = event.x / mFrameScale;
+  const float y = event.y / mFrameScale;
+  const IMouseMod mod(event.mods & 1, event.mods & 2, event.mods & 4, event.mods & 8, event.mods & 16);
+  char utf8[8] = {};
+  memcpy(utf8, event.utf8, 4);
+  const IKeyPress key(utf8, event.vk, mod.S, mod.C, mod.A);
+  
+  switch (event.type)
+  {
+    case kRemoteMouseDown: mStreamingUI->OnMouseDown(x, y, mod); break;
+    case kRemoteMouseUp: mStreamingUI->OnMouseUp(x, y, mod); break;
+    case kRemoteMouseDrag: mStreamingUI->OnMouseDrag(x, y, event.dX / mFrameScale, event.dY / mFrameScale, mod); break;
+    case kRemoteMouseOver: mStreamingUI->OnMouseOver(x, y, mod); break;
+    case kRemoteMouseWheel: mStreamingUI->OnMouseWheel(x, y, mod, event.dY); break;
+    case kRemoteKeyDown: mStreamingUI->OnKeyDown(x, y, key); break;
+    case kRemoteKeyUp: mStreamingUI->OnKeyUp(x, y, key); break;
+    default: break;
+  }
+}
+
+void IWebsocketEditorDelegate::AddPendingParam(int paramIdx, double normalizedValue, int connection)
+{
+  if (paramIdx < 0 || paramIdx >= mPendingParams.GetSize())
+    return;
+
+  PendingParam& pending = mPendingParams.Get()[paramIdx];
+
+  if (!pending.pending)
+    mPendingParamIdx.Add(paramIdx);
+
+  pending.value = normalizedValue;
+  pending.connection = connection;
+  pending.pending = true;
+}
+
+void IWebsocketEditorDelegate::SendPendingParamsToClients()
+{
+  const int nPending = mPendingParamIdx.GetSize();
+  const int* pPendingIdx = mPendingParamIdx.Get();
+  bool fromClients = false;
+  int nToSend = 0;
+
+  for (int i = 0; i < nPending; i++)
+  {
+    const PendingParam& pending = mPendingParams.Get()[pPendingIdx[i]];
+    fromClients |= pending.pending && pending.connection >= 0;
+    nToSend += pending.pending;
+  }
+
+  if (nToSend)
+  {
+    if (!fromClients)
+    {
+      // every change came from the server, so all clients get the same frame
+      BeginBatch();
+
+      for (int i = 0; i < nPending; i++)
+      {
+        if (mPendingParams.Get()[pPendingIdx[i]].pending)
+          AddToBatch(pPendingIdx[i], mPendingParams.Get()[pPendingIdx[i]].value);
+      }
+
+      SendDataToConnection(-1, mBatch.GetData(), mBatch.Size());
+    }
+    else
+    {
+      for (int c = 0; c < NClients(); c++)
+      {
+        BeginBatch();
+        int nInBatch = 0;
+
+        for (int i = 0; i < nPending; i++)
+        {
+          const PendingParam& pending = mPendingParams.Get()[pPendingIdx[i]];
+
+          if (pending.pending && pending.connection != c)
+          {
+            AddToBatch(pPendingIdx[i], pending.value);
+            nInBatch++;
+          }
+        }
+
+        if (nInBatch)
+          SendDataToConnection(c, mBatch.GetData(), mBatch.Size());
+      }
+    }
+  }
+
+  for (int i = 0; i < nPending; i++)
+    mPendingParams.Get()[pPendingIdx[i]].pending = false;
+
+  mPendingParamIdx.Resize(0, false);
+}
+
+void IWebsocketEditorDelegate::BeginBatch()
+{
+  mBatch.Clear();
+  mBatch.PutStr("SPVFDB");
+}
+
+void IWebsocketEditorDelegate::AddToBatch(int paramIdx, double normalizedValue)
+{
+  uint8_t varint[5];
+  int nBytes = 0;
+  uint32_t idx = static_cast<uint32_t>(paramIdx);
+
+  do
+  {
+    varint[nBytes] = idx & 0x7f;
+    idx >>= 7;
+
+    if (idx)
+      varint[nBytes] |= 0x80;
+
+    nBytes++;
+  } while (idx);
+
+  const float value = static_cast<float>(normalizedValue);
+  mBatch.PutBytes(varint, nBytes);
+  mBatch.Put(&value);
 }
@@ -3,7 +3,7 @@
 #include "IGraphicsEditorDelegate.h"
 #include "IWebsocketServer.h"
 #include "IPlugStructs.h"
-#include "IPlugQueue.h"
+#include "IPlugMPSCQueue.h"
 
 /**
  * @file
@@ -11,6 +11,10 @@
  */
 
 BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+class IGraphics;
+class IRECTList;
+END_IGRAPHICS_NAMESPACE
 
 /** An IEditorDelegate base class that embeds a websocket server ... */
 class IWebsocketEditorDelegate : public IGEditorDelegate, public IWebsocketServer
@@ -39,15 +43,56 @@ public:
   void SendControlMsgFromDelegate(int controlTag, int messageTag, int dataSize, const void* pData) override;
   void SendArbitraryMsgFromDelegate(int messageTag, int dataSize, const void* pData) override;
   void SendMidiMsgFromDelegate(const IMidiMsg& msg) override;
+  void SendMidiMsgsFromDelegate(const IMidiMsg* pMsgs, int nMsgs) override;
   void SendSysexMsgFromDelegate(const ISysEx& msg) override;
 //  void SendParameterValueFromDelegate(int paramIdx, double value, bool normalized) override;
   
-  // Call this repeatedly in order to handle incoming data
+  /** Call this repeatedly in order to handle incoming data. Parameter changes from clients and from the server's own UI are coalesced, so that each parameter
+   * is applied once per call with its latest value, and sent to each client in a single "SPVFDB" frame: a varint parameter index and a float32 normalized value per change */
   void ProcessWebsocketQueue();
   
+  /** Stream the rendered UI to clients, so that they can show the real UI rather than one of their own. After each frame, the regions that were drawn
+   * are read back with IGraphics::GetFramePixels(), which needs a backend that draws into memory, and sent as "SFBFD" frames of deflated RGBA strips.
+   * Mouse and keyboard events that clients send back as "SIEFUI" frames are applied to the UI in ProcessWebsocketQueue()
+   * @param stream \c true to stream the UI while it is open */
+  void SetStreamFrames(bool stream);
+  
 private:
-  void DoSPVFDToClients(int paramIdx, double value, int excludeIdx);
+  enum ERemoteInputType { kRemoteMouseDown, kRemoteMouseUp, kRemoteMouseDrag, kRemoteMouseOver, kRemoteMouseWheel, kRemoteKeyDown, kRemoteKeyUp };
+  
+  /** A mouse or keyboard event from a client, in frame pixels */
+  struct RemoteInputEvent
+  {
+    int type = kRemoteMouseOver;
+    float x = 0.f, y = 0.f, dX = 0.f, dY = 0.f;
+    int mods = 0; // bits: left, right, shift, control, alt
+    int vk = 0;
+    char utf8[8] = {};
+  };
+  
+  /** Send the regions of a frame that were drawn to the clients */
+  void StreamFrame(igraphics::IGraphics& graphics, const igraphics::IRECTList& rects);
+  /** Apply a client's mouse or keyboard event to the UI */
+  void ApplyRemoteInput(const RemoteInputEvent& event);
+  
+  /** Record the latest value of a parameter, to be applied and sent by ProcessWebsocketQueue()
+   * @param connection The client the change came from, or -1 for the server */
+  void AddPendingParam(int paramIdx, double normalizedValue, int connection);
+  /** Send the pending parameter changes in one frame per client, leaving out the changes each client made itself */
+  void SendPendingParamsToClients();
+  /** Start the batch frame in mBatch */
+  void BeginBatch();
+  /** Append a varint parameter index and a float32 value to mBatch */
+  void AddToBatch(int paramIdx, double normalizedValue);
   
+  struct PendingParam
+  {
+    double value = 0.;
+    int connection = -1;
+    bool pending = false;
+  };
+  
+
   struct ParamTupleCX
   {
     int idx;
@@ -61,8 +106,23 @@ private:
     {}
   };
 
-  IPlugQueue<ParamTupleCX> mParamChangeFromClients {PARAM_TRANSFER_SIZE};
-  IPlugQueue<IMidiMsg> mMIDIFromClients {MIDI_TRANSFER_SIZE};
+  // pushed to by every connection's server thread
+  IPlugMPSCQueue<ParamTupleCX> mParamChangeFromClients {PARAM_TRANSFER_SIZE};
+  IPlugMPSCQueue<IMidiMsg> mMIDIFromClients {MIDI_TRANSFER_SIZE}; // only used to update the UI, the processor gets client MIDI directly
+  IPlugMPSCQueue<RemoteInputEvent> mInputFromClients {64};
+  std::atomic<bool> mNeedFullFrame {false}; // set when a client connects, so that it gets the whole UI
+
+  // only used on the main thread
+  WDL_TypedBuf<PendingParam> mPendingParams; // the latest change of each parameter since the last ProcessWebsocketQueue()
+  WDL_TypedBuf<int> mPendingParamIdx; // the parameters in mPendingParams, in the order they first changed
+  IByteChunk mBatch;
+  
+  bool mStreamFrames = false;
+  igraphics::IGraphics* mStreamingUI = nullptr; // the UI that mStreamFrames has installed its frame function on
+  float mFrameScale = 1.f; // frame pixels per UI point
+  WDL_TypedBuf<uint8_t> mFramePixels;
+  WDL_TypedBuf<uint8_t> mCompressedPixels;
+  IByteChunk mFrame;
 };
 
 END_IPLUG_NAMESPACE
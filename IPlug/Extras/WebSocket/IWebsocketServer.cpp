@@ -19,6 +19,13 @@ IWebsocketServer::IWebsocketServer()
 IWebsocketServer::~IWebsocketServer()
 {
   DestroyServer();
+  
+  WDL_MutexLock lock(&mMutex);
+  
+  for (int i = 0; i < mConnections.GetSize(); i++)
+    CloseConnection(mConnections.Get(i));
+  
+  mConnections.Empty();
 }
 
 bool IWebsocketServer::CreateServer(const char* DOCUMENT_ROOT, const char* PORT)
@@ -78,14 +85,14 @@ int IWebsocketServer::NClients()
   return mConnections.GetSize();
 }
 
-bool IWebsocketServer::SendTextToConnection(int idx, const char* str, int exclude)
+bool IWebsocketServer::SendTextToConnection(int idx, const char* str, int exclude, uint64_t compactKey)
 {
-  return DoSendToConnection(idx, MG_WEBSOCKET_OPCODE_TEXT, str, strlen(str), exclude);
+  return DoSendToConnection(idx, MG_WEBSOCKET_OPCODE_TEXT, str, strlen(str), exclude, compactKey);
 }
 
-bool IWebsocketServer::SendDataToConnection(int idx, void* pData, size_t sizeInBytes, int exclude)
+bool IWebsocketServer::SendDataToConnection(int idx, void* pData, size_t sizeInBytes, int exclude, uint64_t compactKey)
 {
-  return DoSendToConnection(idx, MG_WEBSOCKET_OPCODE_BINARY, (const char*) pData, sizeInBytes, exclude);
+  return DoSendToConnection(idx, MG_WEBSOCKET_OPCODE_BINARY, (const char*) pData, sizeInBytes, exclude, compactKey);
 }
 
 void IWebsocketServer::OnWebsocketReady(int idx)
@@ -102,37 +109,112 @@ bool IWebsocketServer::OnWebsocketData(int idx, void* pData, size_t dataSize)
   return true; // return true to keep the connection open
 }
 
-bool IWebsocketServer::DoSendToConnection(int idx, int opcode, const char* pData, size_t sizeInBytes, int exclude)
+bool IWebsocketServer::DoSendToConnection(int idx, int opcode, const char* pData, size_t sizeInBytes, int exclude, uint64_t compactKey)
 {
-  int nclients = NClients();
+  WDL_MutexLock lock(&mMutex);
   
-  std::function<bool(int)> sendFunc = [&](int connIdx) {
-    WDL_MutexLock lock(&mMutex);
-    mg_connection* pConn = mConnections.Get(connIdx);
+  if (idx == -1)
+  {
+    bool success = true;
     
-    if(pConn) {
-      if(mg_websocket_write(pConn, opcode, pData, sizeInBytes))
-        return true;
+    for (int i = 0; i < mConnections.GetSize(); i++) // TODO: sending to self?
+    {
+      if (i != exclude)
+        success &= Enqueue(*mConnections.Get(i), opcode, pData, sizeInBytes, compactKey);
     }
     
-    return false;
-  };
+    return success;
+  }
+  
+  Connection* pConnection = mConnections.Get(idx);
   
-  bool success = false;
+  return pConnection && Enqueue(*pConnection, opcode, pData, sizeInBytes, compactKey);
+}
+
+bool IWebsocketServer::Enqueue(Connection& connection, int opcode, const char* pData, size_t sizeInBytes, uint64_t compactKey)
+{
+  std::lock_guard<std::mutex> lock(connection.mutex);
   
-  if(idx == -1)
+  if (compactKey)
   {
-    for(int i=0;i<nclients;i++) // TODO: sending to self?
+    for (auto& message : connection.queue)
     {
-      if(i != exclude)
-        success &= sendFunc(i);
+      if (message.compactKey == compactKey)
+      {
+        connection.queuedBytes = connection.queuedBytes - message.data.GetSize() + sizeInBytes;
+        message.opcode = opcode;
+        message.data.Resize((int) sizeInBytes, false);
+        memcpy(message.data.Get(), pData, sizeInBytes);
+        return true;
+      }
     }
   }
-  else {
-    sendFunc(idx);
+  
+  if (connection.queuedBytes + sizeInBytes > mMaxQueuedBytes)
+  {
+    DBGMSG("WS client can't keep up, dropping a message of %i bytes\n", (int) sizeInBytes);
+    return false;
   }
   
-  return success;
+  connection.queue.emplace_back();
+  Message& message = connection.queue.back();
+  message.opcode = opcode;
+  message.compactKey = compactKey;
+  message.data.Resize((int) sizeInBytes, false);
+  memcpy(message.data.Get(), pData, sizeInBytes);
+  connection.queuedBytes += sizeInBytes;
+  
+  connection.condition.notify_one();
+  
+  return true;
+}
+
+void IWebsocketServer::SenderLoop(Connection* pConnection)
+{
+  std::unique_lock<std::mutex> lock(pConnection->mutex);
+  
+  while (true)
+  {
+    pConnection->condition.wait(lock, [pConnection]() { return pConnection->quit || !pConnection->queue.empty(); });
+    
+    if (pConnection->quit)
+      return;
+    
+    Message message = std::move(pConnection->queue.front());
+    pConnection->queue.pop_front();
+    pConnection->queuedBytes -= message.data.GetSize();
+    
+    // write without the lock, so that messages can be queued and compacted while this client is slow
+    lock.unlock();
+    mg_websocket_write(pConnection->pConn, message.opcode, message.data.Get(), message.data.GetSize());
+    lock.lock();
+  }
+}
+
+void IWebsocketServer::CloseConnection(Connection* pConnection)
+{
+  {
+    std::lock_guard<std::mutex> lock(pConnection->mutex);
+    pConnection->quit = true;
+  }
+  
+  pConnection->condition.notify_one();
+  
+  if (pConnection->sender.joinable())
+    pConnection->sender.join();
+  
+  delete pConnection;
+}
+
+int IWebsocketServer::FindConnection(const mg_connection* pConn)
+{
+  for (int i = 0; i < mConnections.GetSize(); i++)
+  {
+    if (mConnections.Get(i)->pConn == pConn)
+      return i;
+  }
+  
+  return -1;
 }
 
 // CivetWebSocketHandler
@@ -149,7 +231,9 @@ void IWebsocketServer::handleReadyState(CivetServer* pServer, struct mg_connecti
 {
   WDL_MutexLock lock(&mMutex);
   
-  mConnections.Add(pConn);
+  Connection* pConnection = new Connection(pConn);
+  pConnection->sender = std::thread(SenderLoop, pConnection);
+  mConnections.Add(pConnection);
   
   DBGMSG("WS ready NClients %i\n", NClients());
   
@@ -164,11 +248,11 @@ bool IWebsocketServer::handleData(CivetServer* pServer, struct mg_connection* pC
   
   if(*firstByte == 129) // TODO: check that
   {
-    return OnWebsocketText(mConnections.Find(pConn), pData, dataSize);
+    return OnWebsocketText(FindConnection(pConn), pData, dataSize);
   }
   else if(*firstByte == 130) // TODO: check that
   {
-    return OnWebsocketData(mConnections.Find(pConn), (void*) pData, dataSize);
+    return OnWebsocketData(FindConnection(pConn), (void*) pData, dataSize);
   }
   
   return true;
@@ -178,7 +262,13 @@ void IWebsocketServer::handleClose(CivetServer* pServer, const struct mg_connect
 {
   WDL_MutexLock lock(&mMutex);
 
-  mConnections.DeletePtr(pConn);
+  const int idx = FindConnection(pConn);
+  
+  if (idx > -1)
+  {
+    CloseConnection(mConnections.Get(idx));
+    mConnections.Delete(idx);
+  }
   
   DBGMSG("WS closed NClients %i\n", NClients());
 }
@@ -9,8 +9,12 @@
 */
 
 #include "CivetServer.h"
+#include <condition_variable>
 #include <cstring>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 #include "ptrlist.h"
 #include "IPlugLogger.h"
@@ -24,9 +28,16 @@
 
 BEGIN_IPLUG_NAMESPACE
 
+/** Serves websocket clients through Civetweb. Outgoing messages are queued per connection and written by a sender thread for each connection,
+ * so a slow client can't hold up the others or the thread that sends. Each queue is bounded, and messages sent with a compaction key replace
+ * a queued message with the same key, so that only the latest value of a parameter or control waits for a slow client */
 class IWebsocketServer : public CivetWebSocketHandler
 {
 public:
+  /** The default bound on the bytes queued for each connection, see SetMaxQueuedBytes() */
+  static constexpr size_t kDefaultMaxQueuedBytes = 1 << 20;
+  
+
   IWebsocketServer();
   virtual ~IWebsocketServer();
     
@@ -41,9 +52,24 @@ public:
 
   int NClients();
   
-  bool SendTextToConnection(int idx, const char* str, int exclude = -1);
+  /** Queue a text message. See SendDataToConnection() */
+  bool SendTextToConnection(int idx, const char* str, int exclude = -1, uint64_t compactKey = 0);
+  
+  /** Queue a binary message, to be written by the connections' sender threads
+   * @param idx The connection, or -1 for all connections
+   * @param exclude A connection to leave out when sending to all connections
+   * @param compactKey If not 0, a message with the same key that is still queued is replaced, rather than this message being added to the queue
+   * @return \c false if the message was dropped because a queue was full */
+  bool SendDataToConnection(int idx, void* pData, size_t sizeInBytes, int exclude = -1, uint64_t compactKey = 0);
   
-  bool SendDataToConnection(int idx, void* pData, size_t sizeInBytes, int exclude = -1);
+  /** Set the bound on the bytes queued for each connection. Messages that don't fit are dropped
+   * @param maxBytes The maximum number of bytes */
+  void SetMaxQueuedBytes(size_t maxBytes) { mMaxQueuedBytes = maxBytes; }
+  
+  /** Make a compaction key for SendDataToConnection()
+   * @param kind Identifies the type of message, e.g. its prefix, must not be 0
+   * @param id Identifies what the message updates, e.g. a parameter index or control tag */
+  static uint64_t MakeCompactKey(uint32_t kind, int id) { return (static_cast<uint64_t>(kind) << 32) | static_cast<uint32_t>(id); }
   
   virtual void OnWebsocketReady(int idx);
   
@@ -52,7 +78,39 @@ public:
   virtual bool OnWebsocketData(int idx, void* pData, size_t dataSize);
   
 private:
-  bool DoSendToConnection(int idx, int opcode, const char* pData, size_t sizeInBytes, int exclude);
+  struct Message
+  {
+    int opcode;
+    uint64_t compactKey;
+    WDL_TypedBuf<char> data;
+  };
+  
+  /** A client and its outbound queue */
+  struct Connection
+  {
+    Connection(mg_connection* pConn) : pConn(pConn) {}
+    
+    mg_connection* pConn;
+    std::deque<Message> queue;
+    size_t queuedBytes = 0;
+    bool quit = false;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::thread sender;
+  };
+  
+  bool DoSendToConnection(int idx, int opcode, const char* pData, size_t sizeInBytes, int exclude, uint64_t compactKey);
+  
+  /** Add a message to a connection's queue, or replace the queued message with the same compaction key */
+  bool Enqueue(Connection& connection, int opcode, const char* pData, size_t sizeInBytes, uint64_t compactKey);
+  
+  /** Writes a connection's queue, until the connection closes */
+  static void SenderLoop(Connection* pConnection);
+  
+  /** Stop the sender thread, and delete the connection */
+  static void CloseConnection(Connection* pConnection);
+  
+  int FindConnection(const mg_connection* pConn);
   
   // CivetWebSocketHandler
   bool handleConnection(CivetServer* pServer, const struct mg_connection* pConn) override;
@@ -63,7 +121,8 @@ private:
   
   void handleClose(CivetServer* pServer, const struct mg_connection* pConn) override;
   
-  WDL_PtrList<mg_connection> mConnections;
+  WDL_PtrList<Connection> mConnections;
+  size_t mMaxQueuedBytes = kDefaultMaxQueuedBytes;
   static std::unique_ptr<CivetServer> sServer;
   static int sInstances;
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "IPlugEditorDelegate.h"
+#include "IPlugStructs.h"
 #include <functional>
 
 /** This EditorDelegate allows using WKWebKitView for an iPlug user interface on macOS/iOS... */
@@ -30,6 +31,31 @@ public:
   void EvaluateJavaScript(const char* scriptStr);
   void EnableScroll(bool enable);
   virtual void OnWebContentLoaded() { OnUIOpen(); };
+  
+  /** Exchange messages with the page as batched binary data, rather than evaluating a JavaScript call per message and encoding data as base64.
+   * Messages from the delegate are queued, and the page is told once, with IPlugMessagesPending(), that there is something to collect. It collects them by
+   * posting its own queued messages to "iplug://messages", and the response holds everything queued since its last request.
+   * The page sees IPLUG_BINARY_BRIDGE defined. Call this before OpenWindow()
+   * @param enable \c true to use the binary bridge */
+  void EnableBinaryBridge(bool enable) { mBinaryBridge = enable; }
+  
+  /** Called by the "iplug://" scheme handler, with a batch of messages from the page
+   * @param pData The messages from the page, may be nullptr
+   * @param size The size of the data in bytes
+   * @param response Filled with the messages queued for the page */
+  void ExchangeBinaryMessages(const uint8_t* pData, int size, IByteChunk& response);
+  
+  /** The binary message types, the same in both directions: a byte for the type, then little endian fields */
+  enum EBinaryMessage : uint8_t
+  {
+    kBinarySPV = 0, // int paramIdx, double value
+    kBinarySCV, // int ctrlTag, double value
+    kBinarySCM, // int ctrlTag, int msgTag, int dataSize, data
+    kBinarySAM, // int msgTag, int ctrlTag, int dataSize, data. From the delegate, ctrlTag is kNoTag
+    kBinaryBPC, // int paramIdx
+    kBinaryEPC // int paramIdx
+  };
+  
 protected:
   std::function<void()> mEditorInitFunc = nullptr;
 
@@ -37,6 +63,17 @@ private:
   void* mWKWebView = nullptr;
   void* mWebConfig = nullptr;
   void* mScriptHandler = nullptr;
+  void* mSchemeHandler = nullptr;
+  
+  /** Queue a message for the page, and tell the page if it isn't already going to collect */
+  void QueueBinaryMessage(const IByteChunk& msg);
+  
+  /** Only messages that arrive in this many bytes are kept while the page doesn't collect, e.g. while it is loading */
+  static constexpr int kMaxBinaryQueueSize = 1 << 20;
+  bool mBinaryBridge = false;
+  bool mPageNotified = false;
+  IByteChunk mBinaryQueue;
+  IByteChunk mBinaryMsg;
 };
 
 END_IPLUG_NAMESPACE
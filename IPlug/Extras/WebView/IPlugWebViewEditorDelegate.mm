@@ -78,6 +78,44 @@ using namespace iplug;
 
 @end
 
+API_AVAILABLE(macos(10.13), ios(11.0))
+@interface BinaryBridgeHandler : NSObject <WKURLSchemeHandler>
+{
+  WebViewEditorDelegate* mWebViewEditorDelegate;
+}
+@end
+
+@implementation BinaryBridgeHandler
+
+-(id) initWithWebViewEditorDelegate:(WebViewEditorDelegate*) webViewEditorDelegate
+{
+  self = [super init];
+  
+  if(self)
+    mWebViewEditorDelegate = webViewEditorDelegate;
+  
+  return self;
+}
+
+- (void)webView:(WKWebView *)webView startURLSchemeTask:(id<WKURLSchemeTask>)urlSchemeTask
+{
+  NSData* body = urlSchemeTask.request.HTTPBody;
+  IByteChunk response;
+  mWebViewEditorDelegate->ExchangeBinaryMessages(static_cast<const uint8_t*>(body.bytes), static_cast<int>(body.length), response);
+  
+  NSDictionary* headers = @{@"Content-Type" : @"application/octet-stream", @"Access-Control-Allow-Origin" : @"*"};
+  NSHTTPURLResponse* urlResponse = [[[NSHTTPURLResponse alloc] initWithURL:urlSchemeTask.request.URL statusCode:200 HTTPVersion:@"HTTP/1.1" headerFields:headers] autorelease];
+  [urlSchemeTask didReceiveResponse:urlResponse];
+  [urlSchemeTask didReceiveData:[NSData dataWithBytes:response.GetData() length:response.Size()]];
+  [urlSchemeTask didFinish];
+}
+
+- (void)webView:(WKWebView *)webView stopURLSchemeTask:(id<WKURLSchemeTask>)urlSchemeTask
+{
+}
+
+@end
+
 WebViewEditorDelegate::WebViewEditorDelegate(int nParams)
 : IEditorDelegate(nParams)
 {
@@ -102,6 +140,21 @@ void* WebViewEditorDelegate::OpenWindow(void* pParent)
   [preferences setValue:@YES forKey:@"developerExtrasEnabled"];
   webConfig.preferences = preferences;
   
+  if (mBinaryBridge)
+  {
+    if (@available(macOS 10.13, iOS 11.0, *))
+    {
+      BinaryBridgeHandler* schemeHandler = [[BinaryBridgeHandler alloc] initWithWebViewEditorDelegate: this];
+      [webConfig setURLSchemeHandler:schemeHandler forURLScheme:@"iplug"];
+      mSchemeHandler = schemeHandler;
+      
+      WKUserScript* script = [[[WKUserScript alloc] initWithSource:@"var IPLUG_BINARY_BRIDGE = true;" injectionTime:WKUserScriptInjectionTimeAtDocumentStart forMainFrameOnly:YES] autorelease];
+      [controller addUserScript:script];
+    }
+    else
+      mBinaryBridge = false;
+  }
+  
   WKWebView* webView = [[WKWebView alloc] initWithFrame: MAKERECT(0.f, 0.f, PLUG_WIDTH, PLUG_HEIGHT) configuration:webConfig];
   
 #if defined OS_IOS
@@ -138,10 +191,30 @@ void WebViewEditorDelegate::CloseWindow()
   [(WKWebViewConfiguration*) mWebConfig release];
   [(WKWebView*) mWKWebView release];
   [(ScriptHandler*) mScriptHandler release];
+  
+  if (mSchemeHandler)
+  {
+    [(NSObject*) mSchemeHandler release];
+    mSchemeHandler = nullptr;
+  }
+  
+  mPageNotified = false;
+  mBinaryQueue.Clear();
 }
 
 void WebViewEditorDelegate::SendControlValueFromDelegate(int controlTag, double normalizedValue)
 {
+  if (mBinaryBridge)
+  {
+    const uint8_t type = kBinarySCV;
+    mBinaryMsg.Clear();
+    mBinaryMsg.Put(&type);
+    mBinaryMsg.Put(&controlTag);
+    mBinaryMsg.Put(&normalizedValue);
+    QueueBinaryMessage(mBinaryMsg);
+    return;
+  }
+  
   WDL_String str;
   str.SetFormatted(50, "SCVFD(%i, %f)", controlTag, normalizedValue);
   EvaluateJavaScript(str.Get());
@@ -149,6 +222,19 @@ void WebViewEditorDelegate::SendControlValueFromDelegate(int controlTag, double
 
 void WebViewEditorDelegate::SendControlMsgFromDelegate(int controlTag, int messageTag, int dataSize, const void* pData)
 {
+  if (mBinaryBridge)
+  {
+    const uint8_t type = kBinarySCM;
+    mBinaryMsg.Clear();
+    mBinaryMsg.Put(&type);
+    mBinaryMsg.Put(&controlTag);
+    mBinaryMsg.Put(&messageTag);
+    mBinaryMsg.Put(&dataSize);
+    mBinaryMsg.PutBytes(pData, dataSize);
+    QueueBinaryMessage(mBinaryMsg);
+    return;
+  }
+  
   WDL_String str;
   WDL_TypedBuf<char> base64;
   int sizeOfBase64 = 4 * std::ceil(((double) dataSize/3.));
@@ -160,6 +246,17 @@ void WebViewEditorDelegate::SendControlMsgFromDelegate(int controlTag, int messa
 
 void WebViewEditorDelegate::SendParameterValueFromDelegate(int paramIdx, double value, bool normalized)
 {
+  if (mBinaryBridge)
+  {
+    const uint8_t type = kBinarySPV;
+    mBinaryMsg.Clear();
+    mBinaryMsg.Put(&type);
+    mBinaryMsg.Put(&paramIdx);
+    mBinaryMsg.Put(&value);
+    QueueBinaryMessage(mBinaryMsg);
+    return;
+  }
+  
   WDL_String str;
   str.SetFormatted(50, "SPVFD(%i, %f)", paramIdx, value);
   EvaluateJavaScript(str.Get());
@@ -167,6 +264,20 @@ void WebViewEditorDelegate::SendParameterValueFromDelegate(int paramIdx, double
 
 void WebViewEditorDelegate::SendArbitraryMsgFromDelegate(int messageTag, int dataSize, const void* pData)
 {
+  if (mBinaryBridge)
+  {
+    const uint8_t type = kBinarySAM;
+    const int controlTag = kNoTag;
+    mBinaryMsg.Clear();
+    mBinaryMsg.Put(&type);
+    mBinaryMsg.Put(&messageTag);
+    mBinaryMsg.Put(&controlTag);
+    mBinaryMsg.Put(&dataSize);
+    mBinaryMsg.PutBytes(pData, dataSize);
+    QueueBinaryMessage(mBinaryMsg);
+    return;
+  }
+  
   WDL_String str;
   WDL_TypedBuf<char> base64;
   int sizeOfBase64 = 4 * std::ceil(((double) dataSize/3.));
@@ -176,6 +287,65 @@ void WebViewEditorDelegate::SendArbitraryMsgFromDelegate(int messageTag, int dat
   EvaluateJavaScript(str.Get());
 }
 
+void WebViewEditorDelegate::QueueBinaryMessage(const IByteChunk& msg)
+{
+  if (mBinaryQueue.Size() + msg.Size() > kMaxBinaryQueueSize)
+  {
+    DBGMSG("WebView page isn't collecting its messages, dropping %i bytes\n", mBinaryQueue.Size());
+    mBinaryQueue.Clear();
+  }
+  
+  mBinaryQueue.PutChunk(&msg);
+  
+  if (!mPageNotified)
+  {
+    mPageNotified = true;
+    EvaluateJavaScript("IPlugMessagesPending()");
+  }
+}
+
+void WebViewEditorDelegate::ExchangeBinaryMessages(const uint8_t* pData, int size, IByteChunk& response)
+{
+  int pos = 0;
+  
+  // each message is read field by field, and a truncated message ends the batch
+  auto read = [&](void* pField, int fieldSize) {
+    if (pos + fieldSize > size)
+      return false;
+    
+    memcpy(pField, pData + pos, fieldSize);
+    pos += fieldSize;
+    return true;
+  };
+  
+  uint8_t type;
+  
+  while (pData && read(&type, 1))
+  {
+    int idx, tag, dataSize;
+    double value;
+    
+    if (type == kBinarySPV && read(&idx, sizeof(int)) && read(&value, sizeof(double)))
+      SendParameterValueFromUI(idx, value);
+    else if (type == kBinaryBPC && read(&idx, sizeof(int)))
+      BeginInformHostOfParamChangeFromUI(idx);
+    else if (type == kBinaryEPC && read(&idx, sizeof(int)))
+      EndInformHostOfParamChangeFromUI(idx);
+    else if (type == kBinarySAM && read(&idx, sizeof(int)) && read(&tag, sizeof(int)) && read(&dataSize, sizeof(int)) && dataSize >= 0 && pos + dataSize <= size)
+    {
+      SendArbitraryMsgFromUI(idx, tag, dataSize, dataSize > 0 ? pData + pos : nullptr);
+      pos += dataSize;
+    }
+    else
+      break;
+  }
+  
+  response.Clear();
+  response.PutChunk(&mBinaryQueue);
+  mBinaryQueue.Clear();
+  mPageNotified = false;
+}
+
 void WebViewEditorDelegate::LoadHTML(const WDL_String& html)
 {
   WKWebView* webView = (WKWebView*) mWKWebView;
@@ -19,6 +19,7 @@
 #include <cassert>
 
 #include "IPlugAPIBase.h"
+#include "IPlugProcessor.h"
 
 using namespace iplug;
 
@@ -41,6 +42,9 @@ IPlugAPIBase::IPlugAPIBase(Config c, EAPI plugAPI)
   Trace(TRACELOC, "%s:%s", c.pluginName, CurrentTime());
   
   mParamDisplayStr.Set("", MAX_PARAM_DISPLAY_LEN);
+  mParamChangeFromProcessor.Resize(c.nParams);
+  mParamGestures.resize(c.nParams);
+  mSysexBuf.Resize(mSysExDataFromEditor.GetCapacity());
 }
 
 IPlugAPIBase::~IPlugAPIBase()
@@ -64,7 +68,35 @@ void IPlugAPIBase::OnHostRequestingImportantParameters(int count, WDL_TypedBuf<i
 
 void IPlugAPIBase::CreateTimer()
 {
-  mTimer = std::unique_ptr<Timer>(Timer::Create(std::bind(&IPlugAPIBase::OnTimer, this, std::placeholders::_1), IDLE_TIMER_RATE));
+  mTimer = std::unique_ptr<SharedTimer>(Timer::CreateShared(std::bind(&IPlugAPIBase::OnTimer, this, std::placeholders::_1), IDLE_TIMER_RATE));
+  mTimer->SetPaused(mPauseTimerWhileUIClosed && !mUIOpen);
+}
+
+void IPlugAPIBase::SetPauseTimerWhileUIClosed(bool pause)
+{
+  mPauseTimerWhileUIClosed = pause;
+
+  if (mTimer)
+    mTimer->SetPaused(pause && !mUIOpen);
+}
+
+void* IPlugAPIBase::OpenWindow(void* pParent)
+{
+  mUIOpen = true;
+
+  if (mTimer)
+    mTimer->SetPaused(false);
+
+  return EDITOR_DELEGATE_CLASS::OpenWindow(pParent);
+}
+
+void IPlugAPIBase::CloseWindow()
+{
+  EDITOR_DELEGATE_CLASS::CloseWindow();
+  mUIOpen = false;
+
+  if (mTimer)
+    mTimer->SetPaused(mPauseTimerWhileUIClosed);
 }
 
 bool IPlugAPIBase::CompareState(const uint8_t* pIncomingState, int startPos) const
@@ -124,8 +156,58 @@ void IPlugAPIBase::SetParameterValue(int idx, double normalizedValue)
 {
   Trace(TRACELOC, "%d:%f", idx, normalizedValue);
   GetParam(idx)->SetNormalized(normalizedValue);
-  InformHostOfParamChange(idx, normalizedValue);
+
+  ParamGesture& gesture = mParamGestures[idx];
+  const auto now = std::chrono::steady_clock::now();
+
+  // mid gesture, the host gets the latest value once per interval, the DSP still gets every value below
+  if (gesture.mActive && now - gesture.mLastInformTime < mGestureInterval)
+  {
+    gesture.mPending = true;
+    gesture.mPendingValue = normalizedValue;
+  }
+  else
+  {
+    gesture.mPending = false;
+    gesture.mLastInformTime = now;
+    InformHostOfParamChange(idx, normalizedValue);
+  }
+
+#ifdef PARAMS_LOCKFREE
+  DeferParamChange(idx, kUI);
+#else
   OnParamChange(idx, kUI);
+#endif
+}
+
+void IPlugAPIBase::BeginInformHostOfParamChangeFromUI(int paramIdx)
+{
+  ParamGesture& gesture = mParamGestures[paramIdx];
+  gesture.mActive = true;
+  gesture.mPending = false;
+  gesture.mLastInformTime = std::chrono::steady_clock::time_point();
+  BeginUndoParamGesture(paramIdx);
+  BeginInformHostOfParamChange(paramIdx);
+}
+
+void IPlugAPIBase::EndInformHostOfParamChangeFromUI(int paramIdx)
+{
+  FlushGestureValue(paramIdx);
+  mParamGestures[paramIdx].mActive = false;
+  EndUndoParamGesture(paramIdx);
+  EndInformHostOfParamChange(paramIdx);
+}
+
+void IPlugAPIBase::FlushGestureValue(int paramIdx)
+{
+  ParamGesture& gesture = mParamGestures[paramIdx];
+
+  if (gesture.mPending)
+  {
+    gesture.mPending = false;
+    gesture.mLastInformTime = std::chrono::steady_clock::now();
+    InformHostOfParamChange(paramIdx, gesture.mPendingValue);
+  }
 }
 
 void IPlugAPIBase::DirtyParametersFromUI()
@@ -139,56 +221,101 @@ void IPlugAPIBase::DirtyParametersFromUI()
 
 void IPlugAPIBase::SendParameterValueFromAPI(int paramIdx, double value, bool normalized)
 {
-  //TODO: Can we assume that no host is stupid enough to try and set parameters on multiple threads at the same time?
-  // If that is the case then we need a MPSPC queue not SPSC
+  // safe to call from several threads at once, and only the latest value of each parameter reaches the editor
   if (normalized)
     value = GetParam(paramIdx)->FromNormalized(value);
   
-  mParamChangeFromProcessor.Push(ParamTuple { paramIdx, value } );
+  mParamChangeFromProcessor.Set(paramIdx, value);
+}
+
+void IPlugAPIBase::SetDSPLoadControlTag(int ctrlTag)
+{
+  mDSPLoadCtrlTag = ctrlTag;
+  
+  if (IPlugProcessor* pProcessor = dynamic_cast<IPlugProcessor*>(this))
+    pProcessor->SetDSPLoadMeasurement(ctrlTag != kNoTag);
+}
+
+void IPlugAPIBase::GetMemoryReport(IMemoryReport& report) const
+{
+  IPluginBase::GetMemoryReport(report);
+
+  report.Add("Parameter changes from processor", mParamChangeFromProcessor.GetMemoryUsage());
+  report.Add("MIDI queue from editor", mMidiMsgsFromEditor.GetMemoryUsage());
+  report.Add("MIDI queue from processor", mMidiMsgsFromProcessor.GetMemoryUsage());
+  report.Add("MIDI batch to editor", mMidiBatch.GetSize() * sizeof(IMidiMsg));
+  report.Add("SysEx queue from editor", mSysExDataFromEditor.GetMemoryUsage());
+  report.Add("SysEx queue from processor", mSysExDataFromProcessor.GetMemoryUsage());
+  report.Add("SysEx buffer", mSysexBuf.GetSize());
+  report.Add("Parameter gestures", mParamGestures.capacity() * sizeof(ParamGesture));
+
+  if (const IPlugProcessor* pProcessor = dynamic_cast<const IPlugProcessor*>(this))
+    pProcessor->GetProcessorMemoryReport(report);
 }
 
 void IPlugAPIBase::OnTimer(Timer& t)
 {
+  TRACE_SCOPE("timer", "IPlugAPIBase::OnTimer");
+
+  const auto now = std::chrono::steady_clock::now();
+
+  for (int p = 0; p < static_cast<int>(mParamGestures.size()); p++)
+  {
+    if (mParamGestures[p].mPending && now - mParamGestures[p].mLastInformTime >= mGestureInterval)
+      FlushGestureValue(p);
+  }
+
+  // derived parameters are evaluated with the processor, which in distributed VST 3 can't edit the controller's parameters from here
+#if !defined VST3C_API && !defined VST3P_API
+  mDerivedParamChanges.ForEachChanged([&](int paramIdx, double value) {
+    BeginInformHostOfParamChange(paramIdx);
+    InformHostOfParamChange(paramIdx, GetParam(paramIdx)->ToNormalized(value));
+    EndInformHostOfParamChange(paramIdx);
+
+    if (HasUI())
+      SendParameterValueFromDelegate(paramIdx, value, false);
+  });
+#endif
+
   if(HasUI())
   {
     // in distributed VST 3, parameter changes are managed by the host
   #if !defined VST3C_API && !defined VST3P_API
-    while(mParamChangeFromProcessor.ElementsAvailable())
+    if (mDSPLoadCtrlTag != kNoTag)
     {
-      ParamTuple p;
-      mParamChangeFromProcessor.Pop(p);
-      SendParameterValueFromDelegate(p.idx, p.value, false); // TODO:  if the parameter hasn't changed maybe we shouldn't do anything?
+      if (IPlugProcessor* pProcessor = dynamic_cast<IPlugProcessor*>(this))
+        SendControlValueFromDelegate(mDSPLoadCtrlTag, std::min(pProcessor->GetDSPLoadMeter().GetLoad(), 1.f));
     }
     
-    while (mMidiMsgsFromProcessor.ElementsAvailable())
-    {
-      IMidiMsg msg;
-      mMidiMsgsFromProcessor.Pop(msg);
-      SendMidiMsgFromDelegate(msg);
-    }
+    // at most one update per parameter per tick, however often the processor changed it
+    mParamChangeFromProcessor.ForEachChanged([&](int paramIdx, double value) {
+      SendParameterValueFromDelegate(paramIdx, value, false);
+    });
+    
+    // MIDI goes to the editor as one batch per tick, without the notes that started and ended within it
+    if (const int nMsgs = PopMidiMsgsFromProcessor())
+      SendMidiMsgsFromDelegate(mMidiBatch.Get(), nMsgs);
     
-    while (mSysExDataFromProcessor.ElementsAvailable())
+    ISysEx sysExMsg;
+    
+    while (mSysExDataFromProcessor.Peek(sysExMsg))
     {
-      SysExData msg;
-      mSysExDataFromProcessor.Pop(msg);
-      SendSysexMsgFromDelegate({msg.mOffset, msg.mData, msg.mSize});
+      SendSysexMsgFromDelegate(sysExMsg);
+      mSysExDataFromProcessor.Pop();
     }
   #endif
     
     // Midi messages from the processor to the controller, are sent as IMessages and SendMidiMsgFromDelegate gets triggered on the other side's notify
   #if defined VST3P_API
-    while (mMidiMsgsFromProcessor.ElementsAvailable())
-    {
-      IMidiMsg msg;
-      mMidiMsgsFromProcessor.Pop(msg);
-      TransmitMidiMsgFromProcessor(msg);
-    }
+    if (const int nMsgs = PopMidiMsgsFromProcessor())
+      TransmitMidiMsgsFromProcessor(mMidiBatch.Get(), nMsgs);
+    
+    ISysEx sysExMsg;
     
-    while (mSysExDataFromProcessor.ElementsAvailable())
+    while (mSysExDataFromProcessor.Peek(sysExMsg))
     {
-      SysExData data;
-      mSysExDataFromProcessor.Pop(data);
-      TransmitSysExDataFromProcessor(data);
+      TransmitSysExDataFromProcessor(sysExMsg);
+      mSysExDataFromProcessor.Pop();
     }
   #endif
   }
@@ -196,6 +323,18 @@ void IPlugAPIBase::OnTimer(Timer& t)
   OnIdle();
 }
 
+int IPlugAPIBase::PopMidiMsgsFromProcessor()
+{
+  const int nAvailable = static_cast<int>(mMidiMsgsFromProcessor.ElementsAvailable());
+  
+  if (!nAvailable)
+    return 0;
+  
+  mMidiBatch.Resize(nAvailable, false);
+  const int nMsgs = static_cast<int>(mMidiMsgsFromProcessor.PopN(mMidiBatch.Get(), nAvailable));
+  return IMidiMsg::RemoveCancelledNotes(mMidiBatch.Get(), nMsgs);
+}
+
 void IPlugAPIBase::SendMidiMsgFromUI(const IMidiMsg& msg)
 {
   DeferMidiMsg(msg); // queue the message so that it will be handled by the processor
@@ -10,9 +10,11 @@
 
 #pragma once
 
+#include <chrono>
 #include <cstring>
 #include <cstdint>
 #include <memory>
+#include <vector>
 
 #include "ptrlist.h"
 #include "mutex.h"
@@ -24,6 +26,9 @@
 #include "IPlugUtilities.h"
 #include "IPlugParameter.h"
 #include "IPlugQueue.h"
+#include "IPlugMPSCQueue.h"
+#include "IPlugSysExQueue.h"
+#include "IPlugParamChangeSet.h"
 #include "IPlugTimer.h"
 
 /**
@@ -131,6 +136,7 @@ public:
 
   /** SetParameterValue is called from the UI in the middle of a parameter change gesture (possibly via delegate) in order to update a parameter's value.
    * It will update mParams[paramIdx], call InformHostOfParamChange and IPlugAPIBase::OnParamChange();
+   * During a gesture the DSP gets every value, but the host only gets one every PARAM_GESTURE_HOST_INTERVAL ms, see SetHostParamGestureInterval()
    * @param paramIdx The index of the parameter that changed
    * @param normalizedValue The new (normalised) value */
   void SetParameterValue(int paramIdx, double normalizedValue);
@@ -147,7 +153,7 @@ public:
 #pragma mark - Methods called by the API class - you do not call these methods in your plug-in class
 
   /** This is called from the plug-in API class in order to update UI controls linked to plug-in parameters, prior to calling OnParamChange()
-   * NOTE: It may be called on the high priority audio thread. Its purpose is to place parameter changes in a queue to defer to main thread for the UI
+   * NOTE: It may be called on the high priority audio thread. Its purpose is to record parameter changes to defer to main thread for the UI, which only receives the latest value of each parameter
    * @param paramIdx The index of the parameter that changed
    * @param value The new value
    * @param normalized /true if value is normalised */
@@ -163,9 +169,9 @@ public:
   virtual void HostSpecificInit() {}
 
   //IEditorDelegate
-  void BeginInformHostOfParamChangeFromUI(int paramIdx) override { BeginInformHostOfParamChange(paramIdx); }
+  void BeginInformHostOfParamChangeFromUI(int paramIdx) override;
   
-  void EndInformHostOfParamChangeFromUI(int paramIdx) override { EndInformHostOfParamChange(paramIdx); }
+  void EndInformHostOfParamChangeFromUI(int paramIdx) override;
   
   bool EditorResizeFromUI(int viewWidth, int viewHeight) override { return EditorResizeFromDelegate(viewWidth, viewHeight); }
     
@@ -184,16 +190,41 @@ public:
   
   void SendArbitraryMsgFromUI(int messageTag, int controlTag = kNoTag, int dataSize = 0, const void* pData = nullptr) override;
   
+  /** Queue a MIDI message for the processor. This can be called from any thread, e.g. the UI, an OSC receiver or a websocket connection */
   void DeferMidiMsg(const IMidiMsg& msg) override { mMidiMsgsFromEditor.Push(msg); }
   
   void DeferSysexMsg(const ISysEx& msg) override
   {
-    SysExData data(msg.mOffset, msg.mSize, msg.mData); // copies data
-    mSysExDataFromEditor.Push(data);
+    if (!mSysExDataFromEditor.Push(msg)) // copies data
+    {
+      DBGMSG("SysEx message from the editor was dropped, increase SYSEX_TRANSFER_BYTES\n");
+    }
   }
 
-  /** /todo */
+  /** Limit how often the values of a parameter change gesture in the UI are sent to the host, as some hosts do expensive work for each one.
+   * The values in between only reach the DSP, the latest is sent to the host on the next timer tick once the interval has passed, and the last
+   * value of a gesture is always sent before it ends. Main thread
+   * @param intervalMs The least time between two values sent to the host for a parameter, 0. to send every value */
+  void SetHostParamGestureInterval(double intervalMs) { mGestureInterval = std::chrono::duration<double, std::milli>(intervalMs); }
+
+  /** Show the DSP load in a control, e.g. an IVMeterControl<1>. Every timer tick the control is sent the average load, clipped between 0 and 1.
+   * This also calls IPlugProcessor::SetDSPLoadMeasurement(), it has no effect in distributed VST3 plug-ins
+   * @param ctrlTag The tag of the control, or kNoTag to stop */
+  void SetDSPLoadControlTag(int ctrlTag);
+
+  /** Adds the queues between the processor and the editor, and the processor's buffers, to the report, see IEditorDelegate::GetMemoryReport() */
+  void GetMemoryReport(IMemoryReport& report) const override;
+
+  /** Create the timer that sends data from the processor to the editor and calls OnIdle(). It is one of the process's shared timers, see Timer::CreateShared() */
   void CreateTimer();
+
+  /** Pause the timer while the editor is closed, so that an instance with no editor open doesn't take up the main thread. OnIdle() isn't called
+   * meanwhile, and the processor's MIDI waits in its queue, which drops what doesn't fit. Off by default
+   * @param pause \c true to pause the timer while the editor is closed */
+  void SetPauseTimerWhileUIClosed(bool pause);
+
+  void* OpenWindow(void* pParent) override;
+  void CloseWindow() override;
   
 private:
   /** Implemented by the API class, called by the UI via SetParameterValue() with the value of a parameter change gesture
@@ -205,21 +236,54 @@ private:
   /** /todo */
   virtual void TransmitMidiMsgFromProcessor(const IMidiMsg& msg) {};
   
+  /** Called with the MIDI received by the processor in one timer tick. The default calls TransmitMidiMsgFromProcessor() for each message
+   * @param pMsgs The messages, in time order
+   * @param nMsgs The number of messages */
+  virtual void TransmitMidiMsgsFromProcessor(const IMidiMsg* pMsgs, int nMsgs)
+  {
+    for (int i = 0; i < nMsgs; i++)
+      TransmitMidiMsgFromProcessor(pMsgs[i]);
+  }
+  
   /** /todo */
-  virtual void TransmitSysExDataFromProcessor(const SysExData& data) {};
+  virtual void TransmitSysExDataFromProcessor(const ISysEx& msg) {};
 
   void OnTimer(Timer& t);
+  
+  /** Pops the MIDI queued by the processor into mMidiBatch, and removes the note on/off pairs that cancel each other out
+   * @return The number of messages in mMidiBatch */
+  int PopMidiMsgsFromProcessor();
+
+  /** Send a parameter's held gesture value to the host, if it has one */
+  void FlushGestureValue(int paramIdx);
 
 protected:
   WDL_String mParamDisplayStr;
-  std::unique_ptr<Timer> mTimer;
+  std::unique_ptr<SharedTimer> mTimer;
+  bool mPauseTimerWhileUIClosed = false;
+  bool mUIOpen = false;
+  int mDSPLoadCtrlTag = kNoTag;
   
-  IPlugQueue<ParamTuple> mParamChangeFromProcessor {PARAM_TRANSFER_SIZE};
-  IPlugQueue<IMidiMsg> mMidiMsgsFromEditor {MIDI_TRANSFER_SIZE}; // a queue of midi messages generated in the editor by clicking keyboard UI etc
+  IPlugParamChangeSet mParamChangeFromProcessor; // the latest value of each parameter changed by the processor, to send to the editor
+  IPlugMPSCQueue<IMidiMsg> mMidiMsgsFromEditor {MIDI_TRANSFER_SIZE}; // a queue of midi messages generated in the editor by clicking keyboard UI etc, or by remote controllers on other threads
   IPlugQueue<IMidiMsg> mMidiMsgsFromProcessor {MIDI_TRANSFER_SIZE}; // a queue of MIDI messages received (potentially on the high priority thread), by the processor to send to the editor
-  IPlugQueue<SysExData> mSysExDataFromEditor {SYSEX_TRANSFER_SIZE}; // a queue of SYSEX data to send to the processor
-  IPlugQueue<SysExData> mSysExDataFromProcessor {SYSEX_TRANSFER_SIZE}; // a queue of SYSEX data to send to the editor
-  SysExData mSysexBuf;
+  IPlugSysExQueue mSysExDataFromEditor {SYSEX_TRANSFER_BYTES}; // a queue of SYSEX data to send to the processor
+  IPlugSysExQueue mSysExDataFromProcessor {SYSEX_TRANSFER_BYTES}; // a queue of SYSEX data to send to the editor
+  WDL_TypedBuf<uint8_t> mSysexBuf; // space to copy the SYSEX data from the editor into, for APIs that need it to outlive the queue entry
+  WDL_TypedBuf<IMidiMsg> mMidiBatch; // the MIDI from the processor for one timer tick, passed to the editor in one go
+
+private:
+  // main thread only, the state of the parameter change gestures from the UI
+  struct ParamGesture
+  {
+    bool mActive = false;
+    bool mPending = false; // mPendingValue hasn't been sent to the host yet
+    double mPendingValue = 0.;
+    std::chrono::steady_clock::time_point mLastInformTime;
+  };
+
+  std::vector<ParamGesture> mParamGestures;
+  std::chrono::duration<double, std::milli> mGestureInterval {PARAM_GESTURE_HOST_INTERVAL};
 };
 
 END_IPLUG_NAMESPACE
@@ -0,0 +1,147 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IBlockEventList
+ */
+
+#include "heapbuf.h"
+
+#include "IPlugMidi.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A single timestamped event in the current processing block */
+struct IBlockEvent
+{
+  enum EType
+  {
+    kMidi,          // mMidi is valid
+    kParamChange,   // mParamIdx and mValue are valid. The parameter has already been set, this just tells you when the change happened
+    kTransport      // the transport state in ITimeInfo changed, always at the start of a block, since no API reports changes within one
+  };
+
+  EType mType = kMidi;
+  int mOffset = 0;
+  IMidiMsg mMidi;
+  int mParamIdx = kNoParameter;
+  double mValue = 0.; // the non-normalised value of the parameter
+};
+
+/** A fixed capacity list of the events in the current processing block, kept sorted by offset. Events with the same offset stay in the order they were added.
+ * The API classes fill it before calling ProcessBlock(), see IPlugProcessor::ForEachSubBlock() */
+class IBlockEventList final
+{
+public:
+  IBlockEventList(int capacity = 0)
+  {
+    Reserve(capacity);
+  }
+
+  IBlockEventList(const IBlockEventList&) = delete;
+  IBlockEventList& operator=(const IBlockEventList&) = delete;
+
+  /** Allocates space, so don't call this on the audio thread. Clears the list
+   * @param capacity The maximum number of events in a block, events beyond this are dropped */
+  void Reserve(int capacity)
+  {
+    mEvents.Resize(capacity);
+    mSize = 0;
+  }
+
+  /** Empties the list, at the end of each block */
+  void Clear() { mSize = 0; }
+
+  /** Insert an event at its position in time. Realtime safe
+   * @return \c false if the list was full and the event was dropped */
+  bool Add(const IBlockEvent& event)
+  {
+    if (mSize >= mEvents.GetSize())
+      return false;
+
+    IBlockEvent* pEvents = mEvents.Get();
+    int i = mSize;
+
+    // events nearly always arrive in order, so this rarely moves anything
+    while (i > 0 && event.mOffset < pEvents[i - 1].mOffset)
+    {
+      pEvents[i] = pEvents[i - 1];
+      i--;
+    }
+
+    pEvents[i] = event;
+    mSize++;
+    return true;
+  }
+
+  bool AddMidi(const IMidiMsg& msg)
+  {
+    IBlockEvent event;
+    event.mType = IBlockEvent::kMidi;
+    event.mOffset = msg.mOffset;
+    event.mMidi = msg;
+    return Add(event);
+  }
+
+  bool AddParamChange(int offset, int paramIdx, double value)
+  {
+    IBlockEvent event;
+    event.mType = IBlockEvent::kParamChange;
+    event.mOffset = offset;
+    event.mParamIdx = paramIdx;
+    event.mValue = value;
+    return Add(event);
+  }
+
+  bool AddTransport()
+  {
+    IBlockEvent event;
+    event.mType = IBlockEvent::kTransport;
+    return Add(event);
+  }
+
+  /** Moves the events before offset to dest, keeping their offsets, and moves the remaining events offset samples earlier. Realtime safe
+   * @param offset The split point in samples
+   * @param dest The list that receives the earlier events */
+  void SplitAt(int offset, IBlockEventList& dest)
+  {
+    IBlockEvent* pEvents = mEvents.Get();
+    int n = 0;
+
+    while (n < mSize && pEvents[n].mOffset < offset)
+      dest.Add(pEvents[n++]);
+
+    for (int i = n; i < mSize; i++)
+    {
+      pEvents[i - n] = pEvents[i];
+      pEvents[i - n].mOffset -= offset;
+    }
+
+    mSize -= n;
+  }
+
+  /** @return The number of events */
+  int Size() const { return mSize; }
+
+  /** @return The event at idx, in time order */
+  const IBlockEvent& Get(int idx) const { return mEvents.Get()[idx]; }
+
+  /** @return The size of the list's storage in bytes */
+  size_t GetMemoryUsage() const { return mEvents.GetSize() * sizeof(IBlockEvent); }
+
+private:
+  WDL_TypedBuf<IBlockEvent> mEvents;
+  int mSize = 0;
+};
+
+END_IPLUG_NAMESPACE
@@ -23,6 +23,13 @@
 
 BEGIN_IPLUG_NAMESPACE
 
+/* The sample type ProcessBlock() works in is chosen per plug-in project, by adding SAMPLE_TYPE_FLOAT or SAMPLE_TYPE_DOUBLE (the default)
+ * to the project's preprocessor definitions (e.g. EXTRA_ALL_DEFS in the project xcconfig). Hosts that supply that type are processed without conversion.
+ * It must not be defined in config.h, since the IPlug sources need to see the same value. */
+#if defined(SAMPLE_TYPE_FLOAT) && defined(SAMPLE_TYPE_DOUBLE)
+#error "Only one of SAMPLE_TYPE_FLOAT and SAMPLE_TYPE_DOUBLE can be defined"
+#endif
+
 #if !defined(SAMPLE_TYPE_FLOAT) && !defined(SAMPLE_TYPE_DOUBLE)
 #define SAMPLE_TYPE_DOUBLE
 #endif
@@ -38,8 +45,7 @@ using PLUG_SAMPLE_SRC = double;
 using sample = PLUG_SAMPLE_DST;
 
 #define LOGFILE "IPlugLog.txt"
-#define MAX_PROCESS_TRACE_COUNT 100
-#define MAX_IDLE_TRACE_COUNT 15
+#define CHROME_TRACE_FILE "IPlugTrace.json"
 
 enum EIPlugPluginType
 {
@@ -98,6 +104,7 @@ static const int MAX_PRESET_NAME_LEN = 256;
 #define MAX_VERSION_STR_LEN 32
 #define MAX_BUILD_INFO_STR_LEN 256
 static const int MAX_PARAM_DISPLAY_PRECISION = 6;
+static const int DEFAULT_PARAM_LUT_SIZE = 1024; // see IParam::SetLookupTable()
 
 #define MAX_AAX_PARAMID_LEN 32
 
@@ -111,6 +118,10 @@ static const int MAX_PARAM_DISPLAY_PRECISION = 6;
 #define IDLE_TIMER_RATE 20 // this controls the frequency of data going from processor to editor (and OnIdle calls)
 #endif
 
+#ifndef PARAM_GESTURE_HOST_INTERVAL
+#define PARAM_GESTURE_HOST_INTERVAL 20 // ms, the least time between the values a parameter change gesture in the UI sends to the host
+#endif
+
 #ifndef MAX_SYSEX_SIZE
 #define MAX_SYSEX_SIZE 512
 #endif
@@ -119,11 +130,25 @@ static const int MAX_PARAM_DISPLAY_PRECISION = 6;
 #define MIDI_TRANSFER_SIZE 32
 #define SYSEX_TRANSFER_SIZE 4
 
+#ifndef SCRATCH_ARENA_BYTES_PER_FRAME
+#define SCRATCH_ARENA_BYTES_PER_FRAME 256 // the default size of IPlugProcessor's scratch arena, per sample of the maximum block size
+#endif
+
+#ifndef MAX_BLOCK_EVENTS
+#define MAX_BLOCK_EVENTS 1024 // the capacity of IPlugProcessor's per-block event list, see IPlugProcessor::ForEachSubBlock()
+#endif
+
+#ifndef SYSEX_TRANSFER_BYTES
+#define SYSEX_TRANSFER_BYTES 16384 // the size of each queue of SysEx messages between threads, a single message can use up to half of it
+#endif
+
 // All version ints are stored as 0xVVVVRRMM: V = version, R = revision, M = minor revision.
 #define IPLUG_VERSION 0x010000
 #define IPLUG_VERSION_MAGIC 'pfft'
 
 static const int DEFAULT_BLOCK_SIZE = 1024;
+static const int DEFAULT_MIN_SUBBLOCK_SIZE = 16;
+static const float DEFAULT_SILENCE_THRESHOLD = 1e-6f; // -120dB, see IPlugProcessor::SetSilenceSkipping()
 static const double DEFAULT_TEMPO = 120.0;
 static const int kNoParameter = -1;
 static const int kNoValIdx = -1;
@@ -183,7 +208,8 @@ enum EAPI
   kAPIAAX = 4,
   kAPIAPP = 5,
   kAPIWAM = 6,
-  kAPIWEB = 7
+  kAPIWEB = 7,
+  kAPIBENCH = 8
 };
 
 /** @enum EHost
@@ -0,0 +1,112 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IDSPLoadMeter
+ */
+
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Statistics of how much of its time budget each processing block used, where the budget is the duration of the audio in the block.
+ * Written by the audio thread without locks, and can be read from any thread. A load of 1 means the block took as long to process as it lasts */
+class IDSPLoadMeter final
+{
+public:
+  /** Each bin of the histogram covers 5% of the budget, the last one counts every block that used 95% or more */
+  static constexpr int kNumBins = 20;
+
+  IDSPLoadMeter()
+  {
+    Reset();
+  }
+
+  IDSPLoadMeter(const IDSPLoadMeter&) = delete;
+  IDSPLoadMeter& operator=(const IDSPLoadMeter&) = delete;
+
+  /** Audio thread: record one block
+   * @param elapsedSeconds How long processing the block took
+   * @param budgetSeconds The duration of the block, nFrames / sampleRate */
+  void AddBlock(double elapsedSeconds, double budgetSeconds)
+  {
+    if (budgetSeconds <= 0.)
+      return;
+
+    const float load = static_cast<float>(elapsedSeconds / budgetSeconds);
+    const int bin = std::min(static_cast<int>(load * kNumBins), kNumBins - 1);
+
+    // there is only one writer, so there is no need for read-modify-write atomics
+    mBins[bin].store(mBins[bin].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    mNumBlocks.store(mNumBlocks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    if (load >= 1.f)
+      mDeadlineMisses.store(mDeadlineMisses.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    if (load > mPeak.load(std::memory_order_relaxed))
+      mPeak.store(load, std::memory_order_relaxed);
+
+    // smooth over roughly kSmoothingTime seconds of audio, whatever the block size
+    const float coeff = static_cast<float>(1. - std::exp(-budgetSeconds / kSmoothingTime));
+    const float average = mAverage.load(std::memory_order_relaxed);
+    mAverage.store(average + coeff * (load - average), std::memory_order_relaxed);
+  }
+
+  /** @return The average load over the last few hundred milliseconds */
+  float GetLoad() const { return mAverage.load(std::memory_order_relaxed); }
+
+  /** @return The highest load of a single block since the last ResetPeak() or Reset() */
+  float GetPeak() const { return mPeak.load(std::memory_order_relaxed); }
+
+  /** @return The number of blocks that took longer to process than they last */
+  uint32_t GetDeadlineMisses() const { return mDeadlineMisses.load(std::memory_order_relaxed); }
+
+  /** @return The number of blocks recorded */
+  uint64_t GetNumBlocks() const { return mNumBlocks.load(std::memory_order_relaxed); }
+
+  /** @param pBins Filled with kNumBins block counts, see kNumBins */
+  void GetHistogram(uint32_t* pBins) const
+  {
+    for (auto i = 0; i < kNumBins; i++)
+      pBins[i] = mBins[i].load(std::memory_order_relaxed);
+  }
+
+  /** Can be called from any thread, but a block being recorded at the same time may still set the peak */
+  void ResetPeak() { mPeak.store(0.f, std::memory_order_relaxed); }
+
+  /** Clears everything. If it's called while the audio thread is recording a block, that block's counts may survive */
+  void Reset()
+  {
+    for (auto i = 0; i < kNumBins; i++)
+      mBins[i].store(0, std::memory_order_relaxed);
+
+    mNumBlocks.store(0, std::memory_order_relaxed);
+    mDeadlineMisses.store(0, std::memory_order_relaxed);
+    mPeak.store(0.f, std::memory_order_relaxed);
+    mAverage.store(0.f, std::memory_order_relaxed);
+  }
+
+private:
+  static constexpr double kSmoothingTime = 0.3;
+
+  std::atomic<uint32_t> mBins[kNumBins];
+  std::atomic<uint64_t> mNumBlocks{0};
+  std::atomic<uint32_t> mDeadlineMisses{0};
+  std::atomic<float> mPeak{0.f};
+  std::atomic<float> mAverage{0.f};
+};
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,102 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IFlushDenormalsScope
+ */
+
+#include <cstdint>
+
+#include "IPlugPlatform.h"
+
+#if defined _M_X64 || defined _M_IX86 || defined __x86_64__ || defined __i386__
+  #include <xmmintrin.h>
+  #define IPLUG_DENORMALS_X86
+#elif defined _M_ARM64
+  #include <intrin.h>
+  #define IPLUG_DENORMALS_ARM64_MSVC
+#elif defined __aarch64__
+  #define IPLUG_DENORMALS_ARM64
+#elif defined __arm__
+  #define IPLUG_DENORMALS_ARM
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+
+/** RAII helper that makes the CPU flush denormal results (and, on x86, denormal inputs) to zero for its lifetime, and restores the previous
+ * floating point mode afterwards. The API classes enter one around every audio callback, see IPlugProcessor::SetFlushDenormals().
+ * Decaying filter and reverb tails otherwise produce denormals, which are 10 to 100 times slower to process on most CPUs.
+ * On targets without a flush to zero mode, such as WebAssembly, it does nothing */
+class IFlushDenormalsScope final
+{
+public:
+  /** @param enable \c false to leave the floating point mode alone */
+  IFlushDenormalsScope(bool enable = true)
+  {
+    if (enable)
+    {
+      mOldState = GetState();
+      const StateType newState = mOldState | kFlushMask;
+
+      if ((mRestore = newState != mOldState))
+        SetState(newState);
+    }
+  }
+
+  ~IFlushDenormalsScope()
+  {
+    if (mRestore)
+      SetState(mOldState);
+  }
+
+  IFlushDenormalsScope(const IFlushDenormalsScope&) = delete;
+  IFlushDenormalsScope& operator=(const IFlushDenormalsScope&) = delete;
+
+private:
+#if defined IPLUG_DENORMALS_X86
+  using StateType = uint32_t;
+  // MXCSR flush to zero, plus denormals are zero where every CPU that can run the build supports it
+  #if defined _M_X64 || defined __x86_64__ || defined __SSE3__
+  static constexpr StateType kFlushMask = (1u << 15) | (1u << 6);
+  #else
+  static constexpr StateType kFlushMask = (1u << 15);
+  #endif
+  static StateType GetState() { return _mm_getcsr(); }
+  static void SetState(StateType state) { _mm_setcsr(state); }
+#elif defined IPLUG_DENORMALS_ARM64_MSVC
+  using StateType = uint64_t;
+  static constexpr StateType kFlushMask = (1u << 24); // FPCR.FZ
+  static StateType GetState() { return _ReadStatusReg(ARM64_FPCR); }
+  static void SetState(StateType state) { _WriteStatusReg(ARM64_FPCR, static_cast<__int64>(state)); }
+#elif defined IPLUG_DENORMALS_ARM64
+  using StateType = uint64_t;
+  static constexpr StateType kFlushMask = (1u << 24); // FPCR.FZ
+  static StateType GetState() { StateType state; asm volatile("mrs %0, fpcr" : "=r" (state)); return state; }
+  static void SetState(StateType state) { asm volatile("msr fpcr, %0" :: "r" (state)); }
+#elif defined IPLUG_DENORMALS_ARM
+  using StateType = uint32_t;
+  static constexpr StateType kFlushMask = (1u << 24); // FPSCR.FZ
+  static StateType GetState() { StateType state; asm volatile("vmrs %0, fpscr" : "=r" (state)); return state; }
+  static void SetState(StateType state) { asm volatile("vmsr fpscr, %0" :: "r" (state)); }
+#else
+  using StateType = uint32_t;
+  static constexpr StateType kFlushMask = 0;
+  static StateType GetState() { return 0; }
+  static void SetState(StateType) {}
+#endif
+
+  StateType mOldState = 0;
+  bool mRestore = false;
+};
+
+END_IPLUG_NAMESPACE
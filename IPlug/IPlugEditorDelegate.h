@@ -17,6 +17,7 @@
 
 #include <cassert>
 #include <cstring>
+#include <atomic>
 #include <stdint.h>
 
 #include "ptrlist.h"
@@ -24,6 +25,9 @@
 #include "IPlugParameter.h"
 #include "IPlugMidi.h"
 #include "IPlugStructs.h"
+#include "IPlugQueue.h"
+#include "IPlugMPSCQueue.h"
+#include "IPlugMemoryReport.h"
 
 BEGIN_IPLUG_NAMESPACE
 
@@ -49,13 +53,40 @@ class IEditorDelegate
 public:
   IEditorDelegate(int nParams)
   {
+#ifdef IPLUG_COMPACT_PARAMS
+    // one allocation for the parameters and one contiguous array for their values, instead of an allocation per parameter
+    mParamBlock.reset(new IParam[nParams]);
+    mParamValues.reset(new std::atomic<double>[nParams]);
+    mNBlockParams = nParams;
+
+    for (int i = 0; i < nParams; i++)
+    {
+      mParamValues[i].store(0.);
+      mParamBlock[i].mpValue = &mParamValues[i];
+      mParams.Add(&mParamBlock[i]);
+    }
+#else
     for (int i = 0; i < nParams; i++)
       AddParam();
+#endif
   }
   
   virtual ~IEditorDelegate()
   {
+#ifdef IPLUG_COMPACT_PARAMS
+    // only the parameters added after construction were allocated one by one
+    for (int i = 0; i < mParams.GetSize(); i++)
+    {
+      IParam* pParam = mParams.Get(i);
+
+      if (!IsInParamBlock(pParam))
+        delete pParam;
+    }
+
+    mParams.Empty(false);
+#else
     mParams.Empty(true);
+#endif
   }
   
   IEditorDelegate(const IEditorDelegate&) = delete;
@@ -69,7 +100,23 @@ public:
   /** Remove an IParam at a particular index
    * Note: This is only used in special circumstances, since most plug-in formats don't support dynamic parameters
    * @param idx The index of the parameter to remove */
-  void RemoveParam(int idx) { return mParams.Delete(idx); }
+  void RemoveParam(int idx)
+  {
+#ifdef IPLUG_COMPACT_PARAMS
+    mParamValuesInOrder = false;
+#endif
+    return mParams.Delete(idx);
+  }
+
+#ifdef IPLUG_COMPACT_PARAMS
+  /** With IPLUG_COMPACT_PARAMS the parameters passed to the constructor keep their values in one contiguous array, which lets
+   * whole-state operations such as IPluginBase::SerializeParams() run over the values without visiting each IParam
+   * @return The values in parameter index order, or nullptr if parameters have been added or removed since construction */
+  const std::atomic<double>* GetParamValues() const
+  {
+    return (mParamValuesInOrder && mParams.GetSize() == mNBlockParams) ? mParamValues.get() : nullptr;
+  }
+#endif
   
   /** Get a pointer to one of the delegate's IParam objects
    * @param paramIdx The index of the parameter object to be got
@@ -89,7 +136,7 @@ public:
   virtual void* OpenWindow(void* pParent) { OnUIOpen(); return nullptr; }
   
   /** If you are not using IGraphics you can if you need to free resources etc when the window closes. Call base implementation. */
-  virtual void CloseWindow() { OnUIClose(); }
+  virtual void CloseWindow() { mUIOccluded = false; OnUIClose(); }
   
 #pragma mark - Methods you may want to override...
   /** Override this method to do something before the UI is opened. You must call the base implementation to make sure controls linked to parameters get updated correctly. */
@@ -97,6 +144,13 @@ public:
   
   /** Override this method to do something before the UI is closed. */
   virtual void OnUIClose() {};
+
+  /** Called on the main thread when the open UI is minimized, hidden or otherwise can't be seen, and again when it can. Call the base implementation.
+   * @param occluded \c true if the user can't see the UI */
+  virtual void OnUIOcclusionChanged(bool occluded) { mUIOccluded = occluded; }
+
+  /** @return \c true while the UI is open but can't be seen. This can be read on the realtime thread, to skip analysis that only feeds an ISender */
+  bool IsUIOccluded() const { return mUIOccluded; }
   
   /** Override this method to do something to your DSP when a parameter changes.
    * WARNING: this method can in some cases be called on the realtime audio thread
@@ -106,27 +160,86 @@ public:
   virtual void OnParamChange(int paramIdx, EParamSource source, int sampleOffset = -1)
   {
     Trace(TRACELOC, "idx:%i src:%s\n", paramIdx, ParamSourceStrs[source]);
+    MarkParamChanged(paramIdx);
     OnParamChange(paramIdx);
   }
   
   /** Another version of the OnParamChange method without an EParamSource, for backwards compatibility / simplicity.
    * WARNING: this method can in some cases be called on the realtime audio thread */
   virtual void OnParamChange(int paramIdx) {}
+
+  /** Called by the default OnParamChange(int, EParamSource, int) for every parameter change, so that the parameters derived from it are re-evaluated,
+   * see IPluginBase::AddParamDependency(). Call it yourself if you override that method. Lock-free
+   * @param paramIdx The index of the parameter that changed */
+  virtual void MarkParamChanged(int paramIdx) {}
   
   /** This is an OnParamChange that will only trigger on the UI thread at low priority, and therefore is appropriate for hiding or showing elements of the UI.
    * You should not update parameter objects using this method.
    * @param paramIdx The index of the parameter that changed */
   virtual void OnParamChangeUI(int paramIdx, EParamSource source = kUnknown) {};
   
-  /** Calls OnParamChange() and OnParamChangeUI() for each parameter.
+  /** Called instead of OnParamChange() when every parameter may have changed at once, e.g. when a preset is recalled or state is loaded.
+   * The default implementation calls OnParamChange() for each parameter. Override it if your plug-in derives DSP state from several parameters,
+   * so that it is recalculated once rather than once per parameter
+   * WARNING: this method can in some cases be called on the realtime audio thread
+   * @param source One of the EParamSource options to indicate where the parameter changes came from */
+  virtual void OnParamsChangedBatch(EParamSource source)
+  {
+    for (int i = 0; i < NParams(); ++i)
+      OnParamChange(i, source);
+  }
+
+  /** Calls OnParamsChangedBatch() and then OnParamChangeUI() for each parameter.
    * @param source Specifies the source of the parameter changes */
   void OnParamReset(EParamSource source)
   {
+    TRACE_SCOPE_VALUE("param", "OnParamReset", NParams());
+
+    OnParamsChangedBatch(source);
+
     for (int i = 0; i < NParams(); ++i)
-    {
-      OnParamChange(i, source);
       OnParamChangeUI(i, source);
-    }
+  }
+  
+#ifdef PARAMS_LOCKFREE
+  /** Call this on a non-realtime thread instead of OnParamChange(), after a parameter's value has been updated. The change is queued and OnParamChange() will be called on the audio thread
+   * at the start of the next block. This can be called from any number of threads at once, e.g. the UI and the host's parameter callbacks
+   * @param paramIdx The index of the parameter that changed
+   * @param source One of the EParamSource options to indicate where the parameter change came from */
+  void DeferParamChange(int paramIdx, EParamSource source)
+  {
+    if (!mDeferredParamChanges.Push(ParamChangeNotification(paramIdx, source)))
+      mDeferredParamReset.store(source + 1); // the queue is full, so notify all parameters on the audio thread instead
+  }
+  
+  /** Call this on a non-realtime thread instead of OnParamReset(). OnParamChangeUI() is called immediately for each parameter, and OnParamChange() will be called for each parameter on the audio thread
+   * @param source Specifies the source of the parameter changes */
+  void DeferParamReset(EParamSource source)
+  {
+    for (int i = 0; i < NParams(); ++i)
+      OnParamChangeUI(i, source);
+    
+    mDeferredParamReset.store(source + 1);
+  }
+#endif
+  
+  /** Called by the API class on the audio thread, prior to processing each block. When PARAMS_LOCKFREE is defined this calls OnParamChange() for the changes that have been queued
+   * using DeferParamChange() or DeferParamReset() on other threads, otherwise it does nothing */
+  void ProcessDeferredParamChanges()
+  {
+#ifdef PARAMS_LOCKFREE
+    TRACE_SCOPE("param", "ProcessDeferredParamChanges");
+
+    ParamChangeNotification p;
+    
+    while (mDeferredParamChanges.Pop(p))
+      OnParamChange(p.idx, p.source);
+    
+    const int resetSource = mDeferredParamReset.exchange(0);
+    
+    if (resetSource)
+      OnParamsChangedBatch((EParamSource) (resetSource - 1));
+#endif
   }
   
   /** Handle incoming MIDI messages sent to the user interface
@@ -147,8 +260,9 @@ public:
   
 #pragma mark - Methods for sending values TO the user interface
   /** Loops through all parameters, calling SendParameterValueFromDelegate() with the current value of the parameter
-   *  This is important when modifying groups of parameters, restoring state and opening the UI, in order to update it with the latest values*/
-  void SendCurrentParamValuesFromDelegate()
+   *  This is important when modifying groups of parameters, restoring state and opening the UI, in order to update it with the latest values.
+   *  Editor delegates can override this to update all of their controls in one pass */
+  virtual void SendCurrentParamValuesFromDelegate()
   {
     for (int i = 0; i < NParams(); ++i)
     {
@@ -190,6 +304,18 @@ public:
    * The message can be handled at the destination via IEditorDelegate::OnMidiMsgUI()
    * @param msg an IMidiMsg Containing the MIDI message to send to the user interface. */
   virtual void SendMidiMsgFromDelegate(const IMidiMsg& msg) { OnMidiMsgUI(msg); }
+
+  /** SendMidiMsgsFromDelegate
+   * WARNING: should not be called on the realtime audio thread.
+   * Sends a batch of MIDI messages to the user interface, e.g. those received by the processor since the last timer tick.
+   * Override this to handle the batch in one go, the default calls SendMidiMsgFromDelegate() for each message
+   * @param pMsgs The messages, in time order
+   * @param nMsgs The number of messages */
+  virtual void SendMidiMsgsFromDelegate(const IMidiMsg* pMsgs, int nMsgs)
+  {
+    for (int i = 0; i < nMsgs; i++)
+      SendMidiMsgFromDelegate(pMsgs[i]);
+  }
   
   /** SendSysexMsgFromDelegate (Abbreviation: SSMFD)
    * WARNING: should not be called on the realtime audio thread.
@@ -296,6 +422,25 @@ public:
    *@param scale The new screen scale*/
   virtual void SetScreenScale(double scale) {}
 
+#pragma mark - Memory accounting
+
+  /** Add the memory this instance owns to a report. The base classes each add their own buffers, and IGEditorDelegate adds the user interface if it is open.
+   * Override this to add your plug-in's own large buffers (sample data, wavetables, impulse responses), and call the base class implementation
+   * @param report The report to add to. It is not cleared first */
+  virtual void GetMemoryReport(IMemoryReport& report) const
+  {
+    size_t paramBytes = mParams.GetSize() * sizeof(IParam*);
+
+    for (int i = 0; i < mParams.GetSize(); i++)
+      paramBytes += mParams.Get(i)->GetMemoryUsage();
+
+    report.Add("Parameters", paramBytes);
+    report.Add("Editor data", static_cast<size_t>(mEditorData.Size()));
+#ifdef PARAMS_LOCKFREE
+    report.Add("Deferred parameter queue", mDeferredParamChanges.GetMemoryUsage());
+#endif
+  }
+
 protected:
   /** The width of the plug-in editor in pixels. Can be updated by resizing, exists here for persistance, even if UI doesn't exist. */
   int mEditorWidth = 0;
@@ -305,6 +450,26 @@ protected:
   IByteChunk mEditorData;
   /** A list of IParam objects. This list is populated in the delegate constructor depending on the number of parameters passed as an argument to IPLUG_CTOR in the plug-in class implementation constructor */
   WDL_PtrList<IParam> mParams;
+#ifdef IPLUG_COMPACT_PARAMS
+  bool IsInParamBlock(const IParam* pParam) const
+  {
+    return !std::less<const IParam*>()(pParam, mParamBlock.get()) && std::less<const IParam*>()(pParam, mParamBlock.get() + mNBlockParams);
+  }
+
+  /** The parameters passed to the constructor, which mParams points into, see GetParamValues() */
+  std::unique_ptr<IParam[]> mParamBlock;
+  std::unique_ptr<std::atomic<double>[]> mParamValues;
+  int mNBlockParams = 0;
+  bool mParamValuesInOrder = true;
+#endif
+#ifdef PARAMS_LOCKFREE
+  /** Parameter changes made on non-realtime threads, waiting for OnParamChange() on the audio thread. Several threads push, so this is MPSC */
+  IPlugMPSCQueue<ParamChangeNotification> mDeferredParamChanges {PARAM_TRANSFER_SIZE};
+  /** Non-zero if all parameters should be notified on the audio thread, stores the EParamSource + 1 */
+  std::atomic<int> mDeferredParamReset {0};
+#endif
+  /** Set by OnUIOcclusionChanged(), see IsUIOccluded() */
+  std::atomic<bool> mUIOccluded {false};
 };
 
 END_IPLUG_NAMESPACE
@@ -0,0 +1,99 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Sample conversion routines specialized for a channel layout that is known at compile time
+ */
+
+#include "IPlugConstants.h"
+#include "IPlugUtilities.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Parse a channel I/O string at compile time, see ParseChannelIOStr(). A layout is fixed if the string has a single configuration
+ * with one bus in each direction and no wildcards, such as "2-2" or "0-2"
+ * @param ioStr The channel I/O string, e.g. PLUG_CHANNEL_IO
+ * @param direction Input or output
+ * @return The number of channels in that direction, or -1 if the layout isn't fixed */
+constexpr int FixedIOStrNChannels(const char* ioStr, ERoute direction)
+{
+  int nChans[2] = {0, 0};
+  bool hasDigits[2] = {false, false};
+  int dir = ERoute::kInput;
+
+  for (const char* p = ioStr; *p; p++)
+  {
+    if (*p >= '0' && *p <= '9')
+    {
+      nChans[dir] = nChans[dir] * 10 + (*p - '0');
+      hasDigits[dir] = true;
+    }
+    else if (*p == '-' && dir == ERoute::kInput)
+      dir = ERoute::kOutput;
+    else // several configurations, several buses or a wildcard
+      return -1;
+  }
+
+  if (!hasDigits[ERoute::kInput] || !hasDigits[ERoute::kOutput])
+    return -1;
+
+  return nChans[direction];
+}
+
+/** Converts whole blocks between the host's sample type and ProcessBlock()'s for a fixed channel layout. IPlugProcessor uses these
+ * in place of its per channel loops when every channel is connected, see IPlugFixedIO */
+struct IFixedIORoutines
+{
+  int mNInputs;
+  int mNOutputs;
+  /** Convert the host's input channels into ProcessBlock()'s input buffers */
+  void (*mConvertInputs)(PLUG_SAMPLE_SRC* const* ppSrc, PLUG_SAMPLE_DST* const* ppDest, int nFrames);
+  /** Convert ProcessBlock()'s output buffers into the host's output channels, from frame startIdx */
+  void (*mConvertOutputs)(PLUG_SAMPLE_DST* const* ppSrc, PLUG_SAMPLE_SRC* const* ppDest, int startIdx, int nFrames);
+};
+
+/** The conversion routines for NIN inputs and NOUT outputs. The channel counts are constants, so the loops over channels are unrolled
+ * and don't look up any per channel state */
+template <int NIN, int NOUT>
+struct IPlugFixedIO
+{
+  static void ConvertInputs(PLUG_SAMPLE_SRC* const* ppSrc, PLUG_SAMPLE_DST* const* ppDest, int nFrames)
+  {
+    for (int c = 0; c < NIN; c++)
+      CastCopy(ppDest[c], ppSrc[c], nFrames);
+  }
+
+  static void ConvertOutputs(PLUG_SAMPLE_DST* const* ppSrc, PLUG_SAMPLE_SRC* const* ppDest, int startIdx, int nFrames)
+  {
+    for (int c = 0; c < NOUT; c++)
+      CastCopy(ppDest[c] + startIdx, ppSrc[c] + startIdx, nFrames);
+  }
+
+  static const IFixedIORoutines* Get()
+  {
+    static const IFixedIORoutines sRoutines = { NIN, NOUT, &ConvertInputs, &ConvertOutputs };
+    return &sRoutines;
+  }
+};
+
+/** @return The routines for a channel layout parsed with FixedIOStrNChannels(), or nullptr if the layout isn't fixed
+ * @code
+ * MakeFixedIORoutines<FixedIOStrNChannels(PLUG_CHANNEL_IO, ERoute::kInput), FixedIOStrNChannels(PLUG_CHANNEL_IO, ERoute::kOutput)>()
+ * @endcode */
+template <int NIN, int NOUT>
+const IFixedIORoutines* MakeFixedIORoutines()
+{
+  return (NIN >= 0 && NOUT >= 0) ? IPlugFixedIO<(NIN < 0 ? 0 : NIN), (NOUT < 0 ? 0 : NOUT)>::Get() : nullptr;
+}
+
+END_IPLUG_NAMESPACE
@@ -17,6 +17,8 @@
  * To trace some arbitrary data:                 Trace(TRACELOC, "%s:%d", myStr, myInt);
  * To simply create a trace entry in the log:    TRACE;
  * No need to wrap tracer calls in #ifdef TRACER_BUILD because Trace is a no-op unless TRACER_BUILD is defined.
+ * Trace calls are recorded in binary form and formatted on a background thread, see ITracer, so the format string must be a string literal
+ * To time a scope on the Chrome/Perfetto timeline:  TRACE_SCOPE("ui", "MyControl::Draw");
  */
 
 #include <cstdio>
@@ -47,6 +49,12 @@ BEGIN_IPLUG_NAMESPACE
 
 #if defined TRACER_BUILD
   #define TRACE Trace(TRACELOC, "");
+  #define TRACE_SCOPE_VAR2(line) _traceScope##line
+  #define TRACE_SCOPE_VAR(line) TRACE_SCOPE_VAR2(line)
+  /** Records how long the rest of the enclosing scope takes, as a slice on the Chrome trace timeline. category and name must be string literals */
+  #define TRACE_SCOPE(category, name) iplug::ITraceScope TRACE_SCOPE_VAR(__LINE__)(category, name)
+  /** As TRACE_SCOPE(), with an integer shown in the slice's arguments, e.g. a block size or control tag */
+  #define TRACE_SCOPE_VALUE(category, name, value) iplug::ITraceScope TRACE_SCOPE_VAR(__LINE__)(category, name, static_cast<int64_t>(value))
 
   #if defined OS_WIN
     #define SYS_THREAD_ID (intptr_t) GetCurrentThreadId()
@@ -56,10 +64,13 @@ BEGIN_IPLUG_NAMESPACE
 
   #else
     #define TRACE
+    #define TRACE_SCOPE(category, name)
+    #define TRACE_SCOPE_VALUE(category, name, value)
   #endif
 
   #define TRACELOC __FUNCTION__,__LINE__
-  static void Trace(const char* funcName, int line, const char* fmtStr, ...);
+  template <typename... Args>
+  static void Trace(const char* funcName, int line, const char* fmtStr, Args... args);
 
   #define APPEND_TIMESTAMP(str) AppendTimestamp(__DATE__, __TIME__, str)
 
@@ -100,13 +111,13 @@ BEGIN_IPLUG_NAMESPACE
   {
     FILE* mFP;
     
-    LogFile()
+    LogFile(const char* fileName = LOGFILE)
     {
       char logFilePath[100];
   #ifdef OS_WIN
-      sprintf(logFilePath, "%s/%s", "C:\\", LOGFILE); // TODO: check windows logFilePath
+      sprintf(logFilePath, "%s/%s", "C:\\", fileName); // TODO: check windows logFilePath
   #else
-      sprintf(logFilePath, "%s/%s", getenv("HOME"), LOGFILE);
+      sprintf(logFilePath, "%s/%s", getenv("HOME"), fileName);
   #endif
       mFP = fopen(logFilePath, "w");
       assert(mFP);
@@ -179,109 +190,6 @@ BEGIN_IPLUG_NAMESPACE
 
   #if defined TRACER_BUILD
 
-  const int TXTLEN = 1024;
-
-  // _vsnsprintf
-
-  #define VARARGS_TO_STR(str) { \
-  try { \
-  va_list argList;  \
-  va_start(argList, format);  \
-  int i = vsnprintf(str, TXTLEN-2, format, argList); \
-  if (i < 0 || i > TXTLEN-2) {  \
-  str[TXTLEN-1] = '\0';  \
-  } \
-  va_end(argList);  \
-  } \
-  catch(...) {  \
-  strcpy(str, "parse error"); \
-  } \
-  strcat(str, "\r\n"); \
-  }
-
-  static intptr_t GetOrdinalThreadID(intptr_t sysThreadID)
-  {
-    static WDL_TypedBuf<intptr_t> sThreadIDs;
-    int i, n = sThreadIDs.GetSize();
-    intptr_t* pThreadID = sThreadIDs.Get();
-    for (i = 0; i < n; ++i, ++pThreadID)
-    {
-      if (sysThreadID == *pThreadID)
-      {
-        return i;
-      }
-    }
-    sThreadIDs.Resize(n + 1);
-    *(sThreadIDs.Get() + n) = sysThreadID;
-    return n;
-  }
-
-  #define MAX_LOG_LINES 16384
-  void Trace(const char* funcName, int line, const char* format, ...)
-  {
-    static int sTrace = 0;
-    static int32_t sProcessCount = 0;
-    static int32_t sIdleCount = 0;
-
-    if (sTrace++ < MAX_LOG_LINES)
-    {
-  #ifndef TRACETOSTDOUT
-      static LogFile sLogFile;
-      assert(sLogFile.mFP);
-  #endif
-      static WDL_Mutex sLogMutex;
-      char str[TXTLEN];
-      VARARGS_TO_STR(str);
-      
-  #ifdef TRACETOSTDOUT
-      DBGMSG("[%ld:%s:%d]%s", GetOrdinalThreadID(SYS_THREAD_ID), funcName, line, str);
-  #else
-      WDL_MutexLock lock(&sLogMutex);
-      intptr_t threadID = GetOrdinalThreadID(SYS_THREAD_ID);
-      
-      if(strstr(funcName, "rocess") || strstr(funcName, "ender")) // These are not typos! by excluding the first character, we can use TRACE; in methods called ProcessXXX or process etc.
-      {
-        if(++sProcessCount > MAX_PROCESS_TRACE_COUNT)
-        {
-          fflush(sLogFile.mFP);
-          return;
-        }
-        else if (sProcessCount == MAX_PROCESS_TRACE_COUNT)
-        {
-          fprintf(sLogFile.mFP, "**************** DISABLING PROCESS TRACING AFTER %d HITS ****************\n\n", sProcessCount);
-          fflush(sLogFile.mFP);
-          return;
-        }
-      }
-      
-#ifdef VST2_API
-      if(strstr(str, "effGetProgram") || strstr(str, "effEditGetRect") || strstr(funcName, "MouseOver"))
-#else
-      if(strstr(funcName, "MouseOver") || strstr(funcName, "idle"))
-#endif
-      {
-        if(++sIdleCount > MAX_IDLE_TRACE_COUNT)
-        {
-          fflush(sLogFile.mFP);
-          return;
-        }
-        else if (sIdleCount == MAX_IDLE_TRACE_COUNT)
-        {
-          fprintf(sLogFile.mFP, "**************** DISABLING IDLE/MOUSEOVER TRACING AFTER %d HITS ****************\n", sIdleCount);
-          fflush(sLogFile.mFP);
-          return;
-        }
-      }
-      
-      if (threadID > 0)
-        fprintf(sLogFile.mFP, "*** -");
-      
-      fprintf(sLogFile.mFP, "[%ld:%s:%d]%s", threadID, funcName, line, str);
-      fflush(sLogFile.mFP);
-  #endif
-    }
-  }
-
   #ifdef VST2_API
   #include "aeffectx.h"
   static const char* VSTOpcodeStr(int opCode)
@@ -648,7 +556,8 @@ BEGIN_IPLUG_NAMESPACE
   #endif // AU_API
 
 #else // TRACER_BUILD
-  static void Trace(const char* funcName, int line, const char* format, ...) {}
+  template <typename... Args>
+  static void Trace(const char* funcName, int line, const char* format, Args... args) {}
 static const char* VSTOpcodeStr(int opCode) { return ""; }
   static const char* AUSelectStr(int select) { return ""; }
   static const char* AUPropertyStr(int propID) { return ""; }
@@ -656,3 +565,7 @@ static const char* VSTOpcodeStr(int opCode) { return ""; }
 #endif // !TRACER_BUILD
 
 END_IPLUG_NAMESPACE
+
+#if defined TRACER_BUILD
+  #include "IPlugTracer.h"
+#endif
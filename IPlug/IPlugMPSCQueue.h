@@ -0,0 +1,151 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugMPSCQueue
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A bounded lock-free queue that any number of threads can push into, and one thread pops from.
+ * Use it where events for the processor come from the UI, OSC, websocket connections etc at the same time. Otherwise use IPlugQueue, which is cheaper.
+ * based on Dmitry Vyukov's bounded MPMC queue http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue */
+template<typename T>
+class IPlugMPSCQueue final
+{
+public:
+  /** @param size The minimum number of items the queue can hold, rounded up to a power of two */
+  IPlugMPSCQueue(int size)
+  {
+    Resize(size);
+  }
+
+  ~IPlugMPSCQueue() {}
+
+  IPlugMPSCQueue(const IPlugMPSCQueue&) = delete;
+  IPlugMPSCQueue& operator=(const IPlugMPSCQueue&) = delete;
+
+  /** Empties the queue, so this must not be called while any thread is pushing or popping
+   * @param size The minimum number of items the queue can hold, rounded up to a power of two */
+  void Resize(int size)
+  {
+    size_t capacity = 2;
+
+    while (capacity < static_cast<size_t>(size))
+      capacity <<= 1;
+
+    mCells.reset(new Cell[capacity]);
+    mMask = capacity - 1;
+
+    for (size_t i = 0; i < capacity; i++)
+      mCells[i].sequence.store(i, std::memory_order_relaxed);
+
+    mWritePos.store(0, std::memory_order_relaxed);
+    mReadPos.store(0, std::memory_order_relaxed);
+  }
+
+  /** Can be called from any thread
+   * @param item The item to copy into the queue
+   * @return \c true on success, \c false if the queue was full */
+  bool Push(const T& item)
+  {
+    Cell* pCell;
+    size_t pos = mWritePos.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+      pCell = &mCells[pos & mMask];
+      const size_t sequence = pCell->sequence.load(std::memory_order_acquire);
+      const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+      if (diff == 0) // the cell is free, try to claim it
+      {
+        if (mWritePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0) // the consumer has not read this cell yet
+      {
+        return false;
+      }
+      else // another producer claimed the cell
+      {
+        pos = mWritePos.load(std::memory_order_relaxed);
+      }
+    }
+
+    pCell->data = item;
+    pCell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** Only call from the consumer thread
+   * @param item Set to the oldest item, if there is one
+   * @return \c true on success, \c false if the queue was empty or the oldest item is still being pushed */
+  bool Pop(T& item)
+  {
+    const size_t pos = mReadPos.load(std::memory_order_relaxed);
+    Cell* pCell = &mCells[pos & mMask];
+    const intptr_t diff = static_cast<intptr_t>(pCell->sequence.load(std::memory_order_acquire)) - static_cast<intptr_t>(pos + 1);
+
+    if (diff < 0)
+      return false;
+
+    item = pCell->data;
+    pCell->sequence.store(pos + mMask + 1, std::memory_order_release); // free for the producers' next lap
+    mReadPos.store(pos + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  /** This can count items that producers have claimed but not yet finished writing, so always check the return value of Pop()
+   * @return The approximate number of items in the queue */
+  size_t ElementsAvailable() const
+  {
+    const size_t writePos = mWritePos.load(std::memory_order_acquire);
+    const size_t readPos = mReadPos.load(std::memory_order_relaxed);
+    return writePos > readPos ? writePos - readPos : 0;
+  }
+
+  /** @return \c true if the queue appeared empty */
+  bool WasEmpty() const
+  {
+    return ElementsAvailable() == 0;
+  }
+
+  /** @return \c true if the queue appeared full */
+  bool WasFull() const
+  {
+    return ElementsAvailable() > mMask;
+  }
+
+  /** @return The size of the queue's storage in bytes */
+  size_t GetMemoryUsage() const { return mCells ? (mMask + 1) * sizeof(Cell) : 0; }
+
+private:
+  struct Cell
+  {
+    std::atomic<size_t> sequence{0};
+    T data;
+  };
+
+  std::unique_ptr<Cell[]> mCells;
+  size_t mMask = 0;
+  alignas(64) std::atomic<size_t> mWritePos{0}; // on their own cache lines, so producers and the consumer don't slow each other down
+  alignas(64) std::atomic<size_t> mReadPos{0};
+};
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,126 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IMemoryReport
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "wdlstring.h"
+
+#include "IPlugPlatform.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A list of the memory a plug-in instance owns, filled by IEditorDelegate::GetMemoryReport() and its overrides.
+ * Memory that is shared between instances, such as the IGraphics bitmap cache, is listed with its total size and the number of instances
+ * that share it, and each instance is charged an equal share. The figures are the sizes of the buffers iPlug allocates, so they leave out
+ * allocator overhead, GPU memory, and anything your plug-in class allocates unless you add it in your own override */
+class IMemoryReport
+{
+public:
+  struct Entry
+  {
+    WDL_String mName;
+    /** The bytes charged to this instance */
+    size_t mBytes = 0;
+    /** For shared memory, the total size and the number of instances sharing it, otherwise 0 */
+    size_t mSharedTotal = 0;
+    int mNSharers = 0;
+  };
+
+  /** Add memory owned by this instance. Entries of 0 bytes are ignored
+   * @param name A description, e.g. "Presets"
+   * @param bytes The size in bytes */
+  void Add(const char* name, size_t bytes)
+  {
+    if (bytes)
+    {
+      Entry entry;
+      entry.mName.Set(name);
+      entry.mBytes = bytes;
+      mEntries.push_back(entry);
+    }
+  }
+
+  /** Add memory that is shared between several instances, which is charged to this one in equal share
+   * @param name A description, e.g. "Bitmap cache"
+   * @param totalBytes The total size in bytes
+   * @param nSharers The number of instances sharing it, including this one */
+  void AddShared(const char* name, size_t totalBytes, int nSharers)
+  {
+    if (totalBytes)
+    {
+      Entry entry;
+      entry.mName.Set(name);
+      entry.mNSharers = nSharers > 1 ? nSharers : 1;
+      entry.mBytes = totalBytes / entry.mNSharers;
+      entry.mSharedTotal = totalBytes;
+      mEntries.push_back(entry);
+    }
+  }
+
+  void Clear() { mEntries.clear(); }
+
+  const std::vector<Entry>& GetEntries() const { return mEntries; }
+
+  /** @param includeShared \c true to include this instance's share of shared memory
+   * @return The total bytes charged to this instance */
+  size_t GetTotal(bool includeShared = true) const
+  {
+    size_t total = 0;
+
+    for (const Entry& entry : mEntries)
+    {
+      if (includeShared || !entry.mNSharers)
+        total += entry.mBytes;
+    }
+
+    return total;
+  }
+
+  /** Write the report as text, one entry per line, with the largest entries first
+   * @param str WDL_String to write to */
+  void ToString(WDL_String& str) const
+  {
+    std::vector<const Entry*> sorted;
+    sorted.reserve(mEntries.size());
+
+    for (const Entry& entry : mEntries)
+      sorted.push_back(&entry);
+
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Entry* a, const Entry* b) { return a->mBytes > b->mBytes; });
+
+    str.Set("");
+
+    for (const Entry* pEntry : sorted)
+    {
+      str.AppendFormatted(256, "%-40s %10.1f KB", pEntry->mName.Get(), pEntry->mBytes / 1024.);
+
+      if (pEntry->mNSharers)
+        str.AppendFormatted(256, "  (1/%d of %.1f KB shared)", pEntry->mNSharers, pEntry->mSharedTotal / 1024.);
+
+      str.Append("\n");
+    }
+
+    str.AppendFormatted(256, "%-40s %10.1f KB, %.1f KB excluding shared memory\n", "Total", GetTotal(true) / 1024., GetTotal(false) / 1024.);
+  }
+
+private:
+  std::vector<Entry> mEntries;
+};
+
+END_IPLUG_NAMESPACE
@@ -19,9 +19,11 @@
 #include <cassert>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <algorithm>
 
 #include "IPlugLogger.h"
+#include "IPlugRealtimeGuard.h"
 
 BEGIN_IPLUG_NAMESPACE
 
@@ -341,7 +343,55 @@ struct IMidiMsg
     mOffset = 0;
     mStatus = mData1 = mData2 = 0;
   }
-  
+
+  /** Remove the note ons that are followed by their note off in the same list, along with the note off, when nothing else on that note comes between them.
+   * Used to thin out a batch of messages going to the editor, where a note that starts and ends within one batch would never be seen
+   * @param pMsgs The messages, in time order, which are compacted in place
+   * @param nMsgs The number of messages
+   * @return The number of messages left */
+  static int RemoveCancelledNotes(IMidiMsg* pMsgs, int nMsgs)
+  {
+    bool removed = false;
+
+    for (int i = 0; i < nMsgs; i++)
+    {
+      const IMidiMsg& off = pMsgs[i];
+
+      if (!(off.StatusMsg() == kNoteOff || (off.StatusMsg() == kNoteOn && off.Velocity() == 0)))
+        continue;
+
+      for (int j = i - 1; j >= 0; j--)
+      {
+        IMidiMsg& on = pMsgs[j];
+
+        if (on.NoteNumber() != off.NoteNumber() || on.Channel() != off.Channel())
+          continue;
+
+        if (on.StatusMsg() == kNoteOn && on.Velocity() > 0)
+        {
+          on.Clear();
+          pMsgs[i].Clear();
+          removed = true;
+        }
+
+        break;
+      }
+    }
+
+    if (!removed)
+      return nMsgs;
+
+    int nKept = 0;
+
+    for (int i = 0; i < nMsgs; i++)
+    {
+      if (pMsgs[i].mStatus)
+        pMsgs[nKept++] = pMsgs[i];
+    }
+
+    return nKept;
+  }
+
   /** /todo  
    * @param msg /todo
    * @return const char* /todo */
@@ -518,7 +568,7 @@ class IMidiQueue
 {
 public:
   IMidiQueue(int size = DEFAULT_BLOCK_SIZE)
-  : mBuf(NULL), mSize(0), mGrow(Granulize(size)), mFront(0), mBack(0)
+  : mBuf(NULL), mScratch(NULL), mSize(0), mGrow(Granulize(size)), mFront(0), mBack(0)
   {
     Expand();
   }
@@ -526,17 +576,19 @@ public:
   ~IMidiQueue()
   {
     free(mBuf);
+    free(mScratch);
   }
 
   // Adds a MIDI message at the back of the queue. If the queue is full,
-  // it will automatically expand itself.
-  void Add(const IMidiMsg& msg)
+  // it will automatically expand itself, unless Reserve() was used, in which
+  // case the message is dropped. Returns false if the message was dropped.
+  bool Add(const IMidiMsg& msg)
   {
     if (mBack >= mSize)
     {
       if (mFront > 0)
         Compact();
-      else if (!Expand()) return;
+      else if (!Expand()) return false;
     }
 
 #ifndef DONT_SORT_IMIDIQUEUE
@@ -553,12 +605,73 @@ public:
 #endif
       mBuf[mBack] = msg;
     ++mBack;
+    return true;
+  }
+
+  // Adds a batch of MIDI messages, e.g. one of the host's event lists or the
+  // messages from the editor, and merges them with the queued messages by
+  // offset, so that several unsorted sources can be added in any order. The
+  // batch needn't be sorted, but a sorted batch is merged in linear time.
+  // Messages with equal offsets keep the order they were added in. Returns
+  // the number of messages added, which is less than nMsgs if the queue was
+  // reserved and is full, in which case the end of the batch is dropped.
+  int AddBatch(const IMidiMsg* pMsgs, int nMsgs)
+  {
+    if (mBack + nMsgs > mSize && mFront > 0)
+      Compact();
+
+    while (mBack + nMsgs > mSize && Expand()) {}
+
+    nMsgs = std::min(nMsgs, mSize - mBack);
+
+    if (nMsgs <= 0)
+      return 0;
+
+    IMidiMsg* pBatch = mBuf + mBack;
+    memcpy(pBatch, pMsgs, nMsgs * sizeof(IMidiMsg));
+
+#ifndef DONT_SORT_IMIDIQUEUE
+    // insertion sort, which costs nothing on the usual sorted batch
+    for (int i = 1; i < nMsgs; ++i)
+    {
+      const IMidiMsg msg = pBatch[i];
+      int j = i - 1;
+      while (j >= 0 && msg.mOffset < pBatch[j].mOffset)
+      {
+        pBatch[j + 1] = pBatch[j];
+        --j;
+      }
+      pBatch[j + 1] = msg;
+    }
+
+    // merge from the back, unless the whole batch comes after what is queued
+    if (mBack > mFront && pBatch[0].mOffset < mBuf[mBack - 1].mOffset)
+    {
+      memcpy(mScratch, pBatch, nMsgs * sizeof(IMidiMsg));
+      int i = mBack - 1, j = nMsgs - 1, k = mBack + nMsgs - 1;
+
+      while (j >= 0)
+      {
+        if (i >= mFront && mScratch[j].mOffset < mBuf[i].mOffset)
+          mBuf[k--] = mBuf[i--];
+        else
+          mBuf[k--] = mScratch[j--];
+      }
+    }
+#endif
+
+    mBack += nMsgs;
+    return nMsgs;
   }
 
   // Removes a MIDI message from the front of the queue (but does *not*
   // free up its space until Compact() is called).
   inline void Remove() { ++mFront; }
 
+  // Removes n MIDI messages from the front of the queue, e.g. the
+  // NMsgsBefore() messages of a block once they have been handled.
+  inline void Remove(int n) { mFront = std::min(mFront + n, mBack); }
+
   // Returns true if the queue is empty.
   inline bool Empty() const { return mFront == mBack; }
 
@@ -573,6 +686,26 @@ public:
   // queue), but does *not* remove it from the queue.
   inline IMidiMsg& Peek() const { return mBuf[mFront]; }
 
+  // Returns the queued MIDI messages in offset order, ToDo() of them, so a
+  // block's messages can be handled as one span. The pointer is valid until
+  // the next call that adds messages, Flush() or Resize().
+  inline const IMidiMsg* GetMsgs() const { return mBuf + mFront; }
+
+  // Returns the number of queued MIDI messages with an offset before nFrames,
+  // i.e. the ones that fall in a block of nFrames. When the queue isn't
+  // sorted, this is the number at the front before the first one that isn't.
+  inline int NMsgsBefore(int nFrames) const
+  {
+#ifndef DONT_SORT_IMIDIQUEUE
+    const IMidiMsg* pEnd = std::lower_bound(mBuf + mFront, mBuf + mBack, nFrames, [](const IMidiMsg& msg, int offset) { return msg.mOffset < offset; });
+#else
+    // a binary search needs the offsets in order
+    const IMidiMsg* pEnd = mBuf + mFront;
+    while (pEnd < mBuf + mBack && pEnd->mOffset < nFrames) ++pEnd;
+#endif
+    return static_cast<int>(pEnd - (mBuf + mFront));
+  }
+
   // Moves back MIDI messages all the way to the front of the queue, thus
   // freeing up space at the back, and updates the sample offset of the
   // remaining MIDI messages by substracting nFrames.
@@ -588,6 +721,16 @@ public:
   // Clears the queue.
   inline void Clear() { mFront = mBack = 0; }
 
+  // Resizes the queue to a fixed capacity, after which Add() never allocates,
+  // so it is safe to use on the audio thread. Call this off the audio thread,
+  // e.g. from OnReset(). Resize() makes the queue expandable again.
+  int Reserve(int size)
+  {
+    size = Resize(size);
+    mGrow = 0;
+    return size;
+  }
+
   // Resizes (grows or shrinks) the queue, returns the new size.
   int Resize(int size)
   {
@@ -602,6 +745,7 @@ public:
 
     mBuf = (IMidiMsg*)buf;
     mSize = size;
+    ResizeScratch();
     return size;
   }
 
@@ -610,6 +754,7 @@ protected:
   bool Expand()
   {
     if (!mGrow) return false;
+    REALTIME_CHECK("IMidiQueue::Expand() realloc, call Resize() with a larger size in OnReset()");
     int size = (mSize / mGrow + 1) * mGrow;
 
     void* buf = realloc(mBuf, size * sizeof(IMidiMsg));
@@ -617,9 +762,18 @@ protected:
 
     mBuf = (IMidiMsg*)buf;
     mSize = size;
+    ResizeScratch();
     return true;
   }
 
+  // AddBatch() merges through a buffer as big as the queue, so it never
+  // allocates either.
+  void ResizeScratch()
+  {
+    void* buf = realloc(mScratch, mSize * sizeof(IMidiMsg));
+    if (buf) mScratch = (IMidiMsg*)buf;
+  }
+
   // Moves everything all the way to the front.
   inline void Compact()
   {
@@ -638,6 +792,7 @@ protected:
   }
 
   IMidiMsg* mBuf;
+  IMidiMsg* mScratch;
 
   int mSize, mGrow;
   int mFront, mBack;
@@ -0,0 +1,110 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugParamChangeSet
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Holds the latest value of each parameter and a dirty bit for each one, used to send parameter changes from the processor to the UI.
+ * Unlike a queue it can never overflow, and however many times a parameter changes between two reads, the reader only sees its latest value once.
+ * Set() is lock-free and can be called from any number of threads, ForEachChanged() must only be called from one */
+class IPlugParamChangeSet final
+{
+public:
+  IPlugParamChangeSet(int nParams = 0)
+  {
+    Resize(nParams);
+  }
+
+  IPlugParamChangeSet(const IPlugParamChangeSet&) = delete;
+  IPlugParamChangeSet& operator=(const IPlugParamChangeSet&) = delete;
+
+  /** Clears all changes, so this must not be called while any thread is using the set
+   * @param nParams The number of parameters */
+  void Resize(int nParams)
+  {
+    mNParams = nParams;
+    mNWords = (nParams + kBitsPerWord - 1) / kBitsPerWord;
+    mValues.reset(new std::atomic<double>[nParams]);
+    mDirty.reset(new std::atomic<uint64_t>[mNWords]);
+
+    for (auto i = 0; i < nParams; i++)
+      mValues[i].store(0., std::memory_order_relaxed);
+
+    for (auto w = 0; w < mNWords; w++)
+      mDirty[w].store(0, std::memory_order_relaxed);
+  }
+
+  /** @return The number of parameters */
+  int NParams() const { return mNParams; }
+
+  /** @return The size of the set's storage in bytes */
+  size_t GetMemoryUsage() const { return mNParams * sizeof(std::atomic<double>) + mNWords * sizeof(std::atomic<uint64_t>); }
+
+  /** Record a new value for a parameter, replacing any value that has not been read yet
+   * @param paramIdx The parameter index
+   * @param value The new (non-normalised) value */
+  void Set(int paramIdx, double value)
+  {
+    if (paramIdx < 0 || paramIdx >= mNParams)
+      return;
+
+    mValues[paramIdx].store(value, std::memory_order_relaxed);
+    mDirty[paramIdx / kBitsPerWord].fetch_or(uint64_t(1) << (paramIdx % kBitsPerWord), std::memory_order_release);
+  }
+
+  /** Calls func(paramIdx, value) for each parameter that has changed since the last call, in parameter order, and marks it as read.
+   * If a parameter is set again while this is running, it may be reported again next time with the same value, but its latest value is never missed
+   * @param func The function to call for each changed parameter */
+  template<typename F>
+  void ForEachChanged(F func)
+  {
+    for (auto w = 0; w < mNWords; w++)
+    {
+      if (mDirty[w].load(std::memory_order_relaxed) == 0)
+        continue;
+
+      // clear the bits before reading the values, so that a value set after this is flagged again
+      uint64_t bits = mDirty[w].exchange(0, std::memory_order_acquire);
+
+      while (bits)
+      {
+        int bit = 0;
+
+        while (!(bits & (uint64_t(1) << bit)))
+          bit++;
+
+        bits &= ~(uint64_t(1) << bit);
+
+        const int paramIdx = w * kBitsPerWord + bit;
+        func(paramIdx, mValues[paramIdx].load(std::memory_order_relaxed));
+      }
+    }
+  }
+
+private:
+  static constexpr int kBitsPerWord = 64;
+
+  std::unique_ptr<std::atomic<double>[]> mValues;
+  std::unique_ptr<std::atomic<uint64_t>[]> mDirty;
+  int mNParams = 0;
+  int mNWords = 0;
+};
+
+END_IPLUG_NAMESPACE
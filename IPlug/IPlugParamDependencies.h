@@ -0,0 +1,211 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugParamDependencies
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+BEGIN_IPLUG_NAMESPACE
+
+/** The dependencies between parameters whose values are derived from other parameters, such as the targets of a meta-parameter.
+ * Changes are flagged as they arrive and the derived parameters are evaluated later in one pass, in an order where each comes after its sources,
+ * so a derived parameter is evaluated once per change set however many of its sources changed, and never before them.
+ * Dependencies are added while the plug-in is constructed. MarkChanged() is lock-free and can be called from any thread, Evaluate() must only be
+ * called from one, and neither allocates */
+class IPlugParamDependencies final
+{
+public:
+  IPlugParamDependencies(int nParams = 0)
+  {
+    Resize(nParams);
+  }
+
+  IPlugParamDependencies(const IPlugParamDependencies&) = delete;
+  IPlugParamDependencies& operator=(const IPlugParamDependencies&) = delete;
+
+  /** Removes all dependencies, so this must not be called while any thread is using them
+   * @param nParams The number of parameters */
+  void Resize(int nParams)
+  {
+    mNParams = nParams;
+    mNWords = (nParams + kBitsPerWord - 1) / kBitsPerWord;
+    mDirty.reset(new std::atomic<uint64_t>[mNWords]);
+
+    for (auto w = 0; w < mNWords; w++)
+      mDirty[w].store(0, std::memory_order_relaxed);
+
+    mSources.assign(nParams, std::vector<int>());
+    mHasDependents.assign(nParams, 0);
+    mChanged.assign(nParams, 0);
+    mOrder.clear();
+    mSourceStart.clear();
+    mSourceIdx.clear();
+  }
+
+  /** Declare that a parameter is derived from another. Not realtime safe
+   * @param paramIdx The derived parameter
+   * @param sourceIdx The parameter it is derived from
+   * @return \c false if either index is out of range or the dependency would make a cycle, in which case it isn't added */
+  bool Add(int paramIdx, int sourceIdx)
+  {
+    if (paramIdx < 0 || paramIdx >= mNParams || sourceIdx < 0 || sourceIdx >= mNParams || paramIdx == sourceIdx)
+      return false;
+
+    mSources[paramIdx].push_back(sourceIdx);
+
+    if (!Sort())
+    {
+      mSources[paramIdx].pop_back();
+      Sort();
+      return false;
+    }
+
+    mHasDependents[sourceIdx] = 1;
+    return true;
+  }
+
+  /** @return \c true if no dependencies have been added */
+  bool IsEmpty() const { return mOrder.empty(); }
+
+  /** Flag a parameter as changed, so that the parameters derived from it are evaluated by the next Evaluate(). Does nothing for a parameter with no dependents
+   * @param paramIdx The parameter that changed */
+  void MarkChanged(int paramIdx)
+  {
+    if (paramIdx < 0 || paramIdx >= mNParams || !mHasDependents[paramIdx])
+      return;
+
+    mDirty[paramIdx / kBitsPerWord].fetch_or(uint64_t(1) << (paramIdx % kBitsPerWord), std::memory_order_release);
+  }
+
+  /** Calls func(paramIdx) once for each derived parameter with a source that has changed since the last call, sources first.
+   * func returns \c true if the parameter's value changed, in which case the parameters derived from it are evaluated too
+   * @param func The function to call for each parameter to evaluate
+   * @return The number of parameters for which func returned \c true */
+  template<typename F>
+  int Evaluate(F func)
+  {
+    bool anyDirty = false;
+
+    for (auto w = 0; w < mNWords; w++)
+    {
+      if (mDirty[w].load(std::memory_order_relaxed) == 0)
+        continue;
+
+      uint64_t bits = mDirty[w].exchange(0, std::memory_order_acquire);
+      anyDirty |= bits != 0;
+
+      for (auto bit = 0; bits; bit++, bits >>= 1)
+      {
+        if (bits & 1)
+          mChanged[w * kBitsPerWord + bit] = 1;
+      }
+    }
+
+    if (!anyDirty)
+      return 0;
+
+    int nChanged = 0;
+
+    for (size_t i = 0; i < mOrder.size(); i++)
+    {
+      bool sourceChanged = false;
+
+      for (auto s = mSourceStart[i]; s < mSourceStart[i + 1] && !sourceChanged; s++)
+        sourceChanged = mChanged[mSourceIdx[s]] != 0;
+
+      const int paramIdx = mOrder[i];
+
+      if (sourceChanged && func(paramIdx))
+      {
+        mChanged[paramIdx] = 1;
+        nChanged++;
+      }
+    }
+
+    std::fill(mChanged.begin(), mChanged.end(), 0);
+    return nChanged;
+  }
+
+private:
+  /** Order the derived parameters so that each comes after its sources, and flatten their source lists in that order
+   * @return \c false if there is a cycle */
+  bool Sort()
+  {
+    // Kahn's algorithm, counting for each parameter the sources that haven't been placed yet
+    std::vector<int> nPending(mNParams, 0);
+    std::vector<std::vector<int>> dependents(mNParams);
+    std::vector<int> ready;
+
+    for (auto p = 0; p < mNParams; p++)
+    {
+      nPending[p] = static_cast<int>(mSources[p].size());
+
+      for (int source : mSources[p])
+        dependents[source].push_back(p);
+
+      if (!nPending[p])
+        ready.push_back(p);
+    }
+
+    std::vector<int> order;
+
+    for (size_t i = 0; i < ready.size(); i++)
+    {
+      const int p = ready[i];
+
+      if (!mSources[p].empty())
+        order.push_back(p);
+
+      for (int dependent : dependents[p])
+      {
+        if (--nPending[dependent] == 0)
+          ready.push_back(dependent);
+      }
+    }
+
+    if (static_cast<int>(ready.size()) != mNParams)
+      return false;
+
+    mOrder = order;
+    mSourceStart.assign(1, 0);
+    mSourceIdx.clear();
+
+    for (int p : mOrder)
+    {
+      mSourceIdx.insert(mSourceIdx.end(), mSources[p].begin(), mSources[p].end());
+      mSourceStart.push_back(static_cast<int>(mSourceIdx.size()));
+    }
+
+    return true;
+  }
+
+  static constexpr int kBitsPerWord = 64;
+
+  std::vector<std::vector<int>> mSources; // the sources of each parameter, as added
+  std::vector<int> mOrder; // the derived parameters, each after its sources
+  std::vector<int> mSourceStart; // where the sources of each parameter in mOrder start in mSourceIdx, and one past the end
+  std::vector<int> mSourceIdx;
+  std::vector<uint8_t> mHasDependents;
+  std::vector<uint8_t> mChanged; // the parameters changed in the set being evaluated, only used by Evaluate()
+  std::unique_ptr<std::atomic<uint64_t>[]> mDirty;
+  int mNParams = 0;
+  int mNWords = 0;
+};
+
+END_IPLUG_NAMESPACE
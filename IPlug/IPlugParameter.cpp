@@ -15,6 +15,11 @@
 
 #include <cstdio>
 #include <algorithm>
+#ifdef IPLUG_COMPACT_PARAMS
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#endif
 
 #include "IPlugParameter.h"
 #include "IPlugLogger.h"
@@ -33,6 +38,24 @@ double IParam::ShapeLinear::ValueToNormalized(double value, const IParam& param)
   return (value - param.mMin) / (param.mMax - param.mMin);
 }
 
+void IParam::ShapeLinear::NormalizedToValues(const double* pNormalized, double* pValues, int nValues, const IParam& param) const
+{
+  const double min = param.mMin;
+  const double range = param.mMax - param.mMin;
+
+  for (int i = 0; i < nValues; i++)
+    pValues[i] = min + pNormalized[i] * range;
+}
+
+void IParam::ShapeLinear::ValuesToNormalized(const double* pValues, double* pNormalized, int nValues, const IParam& param) const
+{
+  const double min = param.mMin;
+  const double scale = 1.0 / (param.mMax - param.mMin);
+
+  for (int i = 0; i < nValues; i++)
+    pNormalized[i] = (pValues[i] - min) * scale;
+}
+
 IParam::ShapePowCurve::ShapePowCurve(double shape)
 : mShape(shape)
 {
@@ -58,6 +81,29 @@ double IParam::ShapePowCurve::ValueToNormalized(double value, const IParam& para
   return std::pow((value - param.GetMin()) / (param.GetMax() - param.GetMin()), 1.0 / mShape);
 }
 
+void IParam::ShapePowCurve::NormalizedToValues(const double* pNormalized, double* pValues, int nValues, const IParam& param) const
+{
+  const double min = param.GetMin();
+  const double range = param.GetMax() - param.GetMin();
+
+  // the common curves are cheaper as multiplications
+  if (mShape == 2.0)
+  {
+    for (int i = 0; i < nValues; i++)
+      pValues[i] = min + pNormalized[i] * pNormalized[i] * range;
+  }
+  else if (mShape == 3.0)
+  {
+    for (int i = 0; i < nValues; i++)
+      pValues[i] = min + pNormalized[i] * pNormalized[i] * pNormalized[i] * range;
+  }
+  else
+  {
+    for (int i = 0; i < nValues; i++)
+      pValues[i] = min + std::pow(pNormalized[i], mShape) * range;
+  }
+}
+
 void IParam::ShapeExp::Init(const IParam& param)
 {
   double min = param.GetMin();
@@ -79,16 +125,39 @@ double IParam::ShapeExp::ValueToNormalized(double value, const IParam& param) co
   return (std::log(value) - mAdd) / mMul;
 }
 
+void IParam::ShapeExp::NormalizedToValues(const double* pNormalized, double* pValues, int nValues, const IParam& param) const
+{
+  const double add = mAdd;
+  const double mul = mMul;
+
+  for (int i = 0; i < nValues; i++)
+    pValues[i] = std::exp(add + pNormalized[i] * mul);
+}
+
 #pragma mark -
 
 IParam::IParam()
 {
   mShape = std::make_unique<ShapeLinear>();
   memset(mName, 0, MAX_PARAM_NAME_LEN * sizeof(char));
+#ifndef IPLUG_COMPACT_PARAMS
   memset(mLabel, 0, MAX_PARAM_LABEL_LEN * sizeof(char));
-  memset(mParamGroup, 0, MAX_PARAM_LABEL_LEN * sizeof(char));
+  memset(mParamGroup, 0, MAX_PARAM_GROUP_LEN * sizeof(char));
+#endif
 };
 
+#ifdef IPLUG_COMPACT_PARAMS
+const char* IParam::InternString(const char* str, int maxLen)
+{
+  // never freed, since the strings are shared by the parameters of every instance
+  static std::mutex sMutex;
+  static auto* sStrings = new std::unordered_set<std::string>();
+
+  std::lock_guard<std::mutex> lock(sMutex);
+  return sStrings->emplace(str, strnlen(str, maxLen - 1)).first->c_str();
+}
+#endif
+
 void IParam::InitBool(const char* name, bool defaultVal, const char* label, int flags, const char* group, const char* offText, const char* onText)
 {
   if (mType == kTypeNone) mType = kTypeBool;
@@ -132,8 +201,8 @@ void IParam::InitDouble(const char* name, double defaultVal, double minVal, doub
 //  assert(CStringHasContents(name) && "Parameter must be given a name!");
 
   strcpy(mName, name);
-  strcpy(mLabel, label);
-  strcpy(mParamGroup, group);
+  SetMetaString(mLabel, label, MAX_PARAM_LABEL_LEN);
+  SetMetaString(mParamGroup, group, MAX_PARAM_GROUP_LEN);
   
   // N.B. apply stepping and constraints to the default value (and store the result)
   mMin = minVal;
@@ -143,6 +212,7 @@ void IParam::InitDouble(const char* name, double defaultVal, double minVal, doub
   mUnit = unit;
   mFlags = flags;
   mDisplayFunction = displayFunc;
+  InvalidateDisplayCache();
 
   Set(defaultVal);
   
@@ -155,6 +225,50 @@ void IParam::InitDouble(const char* name, double defaultVal, double minVal, doub
     
   mShape = std::unique_ptr<Shape>(shape.Clone());
   mShape->Init(*this);
+
+  if (mLUT.GetSize())
+    SetLookupTable(mLUT.GetSize() - 1);
+}
+
+void IParam::FromNormalized(const double* pNormalized, double* pValues, int nValues) const
+{
+  if (mLUT.GetSize())
+  {
+    for (int i = 0; i < nValues; i++)
+      pValues[i] = LookUp(pNormalized[i]);
+  }
+  else
+    mShape->NormalizedToValues(pNormalized, pValues, nValues, *this);
+
+  for (int i = 0; i < nValues; i++)
+    pValues[i] = Constrain(pValues[i]);
+}
+
+void IParam::ToNormalized(const double* pValues, double* pNormalized, int nValues) const
+{
+  for (int i = 0; i < nValues; i++)
+    pNormalized[i] = Constrain(pValues[i]);
+
+  mShape->ValuesToNormalized(pNormalized, pNormalized, nValues, *this);
+
+  for (int i = 0; i < nValues; i++)
+    pNormalized[i] = Clip(pNormalized[i], 0., 1.);
+}
+
+void IParam::SetLookupTable(int size)
+{
+  if (size <= 0)
+  {
+    mLUT.Resize(0);
+    return;
+  }
+
+  mLUT.Resize(size + 1);
+
+  for (int i = 0; i <= size; i++)
+    mLUT.Get()[i] = static_cast<double>(i) / size;
+
+  mShape->NormalizedToValues(mLUT.Get(), mLUT.Get(), size + 1, *this);
 }
 
 void IParam::InitFrequency(const char *name, double defaultVal, double minVal, double maxVal, double step, int flags, const char *group)
@@ -223,6 +337,7 @@ void IParam::Init(const IParam& p, const char* searchStr, const char* replaceStr
   }
   
   InitDouble(str.Get(), p.mDefault, p.mMin, p.mMax, p.mStep, p.mLabel, p.mFlags, group.Get(), *p.mShape, p.mUnit, p.mDisplayFunction);
+  mSmoothingTime = p.mSmoothingTime;
   
   for (auto i=0; i<p.NDisplayTexts(); i++)
   {
@@ -239,12 +354,45 @@ void IParam::SetDisplayText(double value, const char* str)
   DisplayText* pDT = mDisplayTexts.Get() + n;
   pDT->mValue = value;
   strcpy(pDT->mText, str);
+  InvalidateDisplayCache();
 }
 
 void IParam::GetDisplayForHost(double value, bool normalized, WDL_String& str, bool withDisplayText) const
 {
   if (normalized) value = FromNormalized(value);
 
+  // a display function may depend on more than the value, so it is only cached if the parameter says it doesn't
+  if (mDisplayFunction != nullptr && !(mFlags & kFlagCacheDisplayFunc))
+  {
+    mDisplayFunction(value, str);
+    return;
+  }
+
+  // hosts and the UI ask from different threads, whoever finds the cache in use formats the text without it rather than wait
+  if (mDisplayCacheBusy.exchange(true, std::memory_order_acquire))
+  {
+    FormatDisplay(value, str, withDisplayText);
+    return;
+  }
+
+  const uint32_t generation = mDisplayGeneration.load(std::memory_order_relaxed);
+
+  if (mDisplayCacheGeneration == generation && mDisplayCacheValue == value && mDisplayCacheWithText == withDisplayText)
+    str.Set(mDisplayCache.Get());
+  else
+  {
+    FormatDisplay(value, str, withDisplayText);
+    mDisplayCache.Set(str.Get());
+    mDisplayCacheGeneration = generation;
+    mDisplayCacheValue = value;
+    mDisplayCacheWithText = withDisplayText;
+  }
+
+  mDisplayCacheBusy.store(false, std::memory_order_release);
+}
+
+void IParam::FormatDisplay(double value, WDL_String& str, bool withDisplayText) const
+{
   if (mDisplayFunction != nullptr)
   {
     mDisplayFunction(value, str);
@@ -293,7 +441,7 @@ const char* IParam::GetNameForHost() const
 
 const char* IParam::GetLabelForHost() const
 {
-  return (CStringHasContents(GetDisplayText(static_cast<int>(mValue.load())))) ? "" : mLabel;
+  return (CStringHasContents(GetDisplayText(static_cast<int>(AtomicValue().load())))) ? "" : mLabel;
 }
 
 const char* IParam::GetGroupForHost() const
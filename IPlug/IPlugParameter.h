@@ -15,6 +15,7 @@
  * @copydoc IParam
  */
 
+#include <algorithm>
 #include <atomic>
 #include <cstring>
 #include <functional>
@@ -49,6 +50,7 @@ public:
     kFlagNegateDisplay    = 0x4, /** Indicates that the parameter should be displayed as a negative value */
     kFlagSignDisplay      = 0x8, /** Indicates that the parameter should be displayed as a signed value */
     kFlagMeta             = 0x10, /** Indicates that the parameter may influence the state of other parameters */
+    kFlagCacheDisplayFunc = 0x20, /** Indicates that the parameter's DisplayFunc only depends on the value, so its text can be cached like the built-in formatting */
   };
   
   using DisplayFunc = std::function<void(double, WDL_String&)>;
@@ -83,6 +85,28 @@ public:
      * @param param /todo
      * @return double /todo */
     virtual double ValueToNormalized(double value, const IParam& param) const = 0;
+
+    /** Maps a buffer of normalized values, override this if the shape can do better than calling NormalizedToValue() for each one
+     * @param pNormalized The normalized values
+     * @param pValues Receives the non-normalized values, may be the same buffer as pNormalized
+     * @param nValues The number of values
+     * @param param The parameter */
+    virtual void NormalizedToValues(const double* pNormalized, double* pValues, int nValues, const IParam& param) const
+    {
+      for (int i = 0; i < nValues; i++)
+        pValues[i] = NormalizedToValue(pNormalized[i], param);
+    }
+
+    /** Maps a buffer of non-normalized values, override this if the shape can do better than calling ValueToNormalized() for each one
+     * @param pValues The non-normalized values
+     * @param pNormalized Receives the normalized values, may be the same buffer as pValues
+     * @param nValues The number of values
+     * @param param The parameter */
+    virtual void ValuesToNormalized(const double* pValues, double* pNormalized, int nValues, const IParam& param) const
+    {
+      for (int i = 0; i < nValues; i++)
+        pNormalized[i] = ValueToNormalized(pValues[i], param);
+    }
   };
 
   /** Linear parameter shaping */
@@ -92,6 +116,8 @@ public:
     IParam::EDisplayType GetDisplayType() const override { return kDisplayLinear; }
     double NormalizedToValue(double value, const IParam& param) const override;
     double ValueToNormalized(double value, const IParam& param) const override;
+    void NormalizedToValues(const double* pNormalized, double* pValues, int nValues, const IParam& param) const override;
+    void ValuesToNormalized(const double* pValues, double* pNormalized, int nValues, const IParam& param) const override;
   
     double mShape;
   };
@@ -104,6 +130,7 @@ public:
     IParam::EDisplayType GetDisplayType() const override;
     double NormalizedToValue(double value, const IParam& param) const override;
     double ValueToNormalized(double value, const IParam& param) const override;
+    void NormalizedToValues(const double* pNormalized, double* pValues, int nValues, const IParam& param) const override;
     
     double mShape;
   };
@@ -116,6 +143,7 @@ public:
     IParam::EDisplayType GetDisplayType() const override { return kDisplayLog; }
     double NormalizedToValue(double value, const IParam& param) const override;
     double ValueToNormalized(double value, const IParam& param) const override;
+    void NormalizedToValues(const double* pNormalized, double* pValues, int nValues, const IParam& param) const override;
     
     double mMul = 1.0;
     double mAdd = 1.0;
@@ -269,12 +297,44 @@ public:
    * @return The corresponding real value, for this parameter */
   inline double FromNormalized(double normalizedValue) const
   {
+    if (mLUT.GetSize())
+      return Constrain(LookUp(normalizedValue));
+
     return Constrain(mShape->NormalizedToValue(normalizedValue, *this));
   }
 
+  /** Convert a buffer of normalized values to real values for this parameter, e.g. for per-sample modulation. This makes one virtual call per buffer rather than per value
+   * @param pNormalized The normalized input values in the range 0. to 1.
+   * @param pValues Receives the corresponding real values, may be the same buffer as pNormalized
+   * @param nValues The number of values */
+  void FromNormalized(const double* pNormalized, double* pValues, int nValues) const;
+
+  /** Convert a buffer of real values to normalized values for this parameter
+   * @param pValues The real input values
+   * @param pNormalized Receives the corresponding normalized values, may be the same buffer as pValues
+   * @param nValues The number of values */
+  void ToNormalized(const double* pValues, double* pNormalized, int nValues) const;
+
+  /** Use an interpolated lookup table for FromNormalized(), rather than calling the shape, which for ShapePowCurve and ShapeExp means a call to pow() or exp().
+   * The table is approximate, so only use it for parameters that are mapped often, such as per-sample modulation targets. Call this after the parameter has been
+   * initialized and before processing starts, the table is rebuilt if the parameter is initialized again
+   * @param size The number of intervals in the table, or 0 to remove it */
+  void SetLookupTable(int size = DEFAULT_PARAM_LUT_SIZE);
+
+  /** @return \c true if FromNormalized() uses a lookup table, see SetLookupTable() */
+  bool HasLookupTable() const { return mLUT.GetSize() > 0; }
+
+  /** Have the processor smooth this parameter, so that ProcessBlock() can read a block of values with IPlugProcessor::GetSmoothedBlock() rather than running
+   * its own smoother. Call this after the parameter has been initialized, in the plug-in's constructor
+   * @param timeMs The smoothing time in milliseconds, or 0 for no smoothing */
+  void SetSmoothing(double timeMs) { mSmoothingTime = timeMs; }
+
+  /** @return The smoothing time in milliseconds, or 0 if the parameter isn't smoothed, see SetSmoothing() */
+  double GetSmoothingTime() const { return mSmoothingTime; }
+
   /** Sets the parameter value
    * @param value Value to be set. Will be stepped and clamped between \c mMin and \c mMax */
-  void Set(double value) { mValue.store(Constrain(value)); }
+  void Set(double value) { AtomicValue().store(Constrain(value)); }
 
   /** Sets the parameter value from a normalized range (usually coming from the linked IControl)
    * @param normalizedValue The expected normalized value between 0. and 1. */
@@ -282,10 +342,10 @@ public:
 
   /** /todo 
    * @param str /todo */
-  void SetString(const char* str) { mValue.store(StringToValue(str)); }
+  void SetString(const char* str) { AtomicValue().store(StringToValue(str)); }
 
   /** /todo  */
-  void SetToDefault() { mValue.store(mDefault); }
+  void SetToDefault() { AtomicValue().store(mDefault); }
 
   /** /todo 
    * @param value /todo */
@@ -298,44 +358,49 @@ public:
   
   /** Set the parameters label after creation. WARNING: if this is called after the host has queried plugin parameters, the host may display the label as it was previously
    * @param label /todo */
-  void SetLabel(const char* label) { strcpy(mLabel, label); }
+  void SetLabel(const char* label) { SetMetaString(mLabel, label, MAX_PARAM_LABEL_LEN); }
+
+  /** The text GetDisplayForHost() made last is kept with the value it was made for, since hosts ask for the same value over and over.
+   * Setting the display texts or re-initializing the parameter calls this for you. Call it if a DisplayFunc that is cached with kFlagCacheDisplayFunc
+   * would now format the same value differently */
+  void InvalidateDisplayCache() { mDisplayGeneration.fetch_add(1, std::memory_order_relaxed); }
 
   /** Gets a readable value of the parameter
    * @return Current value of the parameter */
-  double Value() const { return mValue.load(); }
+  double Value() const { return AtomicValue().load(); }
 
   /** Returns the parameter's value as a boolean
    * @return \c true if value >= 0.5, else otherwise */
-  bool Bool() const { return (mValue.load() >= 0.5); }
+  bool Bool() const { return (AtomicValue().load() >= 0.5); }
 
   /** @return Current value of the parameter as an integer */
-  int Int() const { return static_cast<int>(mValue.load()); }
+  int Int() const { return static_cast<int>(AtomicValue().load()); }
   
   /** /todo 
    * @return double /todo */
-  double DBToAmp() const { return iplug::DBToAmp(mValue.load()); }
+  double DBToAmp() const { return iplug::DBToAmp(AtomicValue().load()); }
 
   /** /todo 
    * @return double /todo */
-  double GetNormalized() const { return ToNormalized(mValue.load()); }
+  double GetNormalized() const { return ToNormalized(AtomicValue().load()); }
 
   /** /todo 
    * @param display /todo
    * @param withDisplayText /todo */
-  void GetDisplayForHost(WDL_String& display, bool withDisplayText = true) const { GetDisplayForHost(mValue.load(), false, display, withDisplayText); }
+  void GetDisplayForHost(WDL_String& display, bool withDisplayText = true) const { GetDisplayForHost(AtomicValue().load(), false, display, withDisplayText); }
 
   void GetDisplayForHostWithLabel(WDL_String& display, bool withDisplayText = true) const
   {
-    GetDisplayForHost(mValue.load(), false, display, withDisplayText);
+    GetDisplayForHost(AtomicValue().load(), false, display, withDisplayText);
     display.Append(" ");
     display.Append(GetLabelForHost());
   }
   
-  /** /todo 
-   * @param value /todo
-   * @param normalized /todo
-   * @param display /todo
-   * @param withDisplayText /todo */
+  /** Format a value as hosts and the UI show it. The last result is cached, see InvalidateDisplayCache()
+   * @param value The value to format
+   * @param normalized \c true if \p value is normalized
+   * @param display Set to the text
+   * @param withDisplayText \c false to format the number even if the value has a display text */
   void GetDisplayForHost(double value, bool normalized, WDL_String& display, bool withDisplayText = true) const;
 
   /** /todo 
@@ -447,7 +512,39 @@ public:
 
   /** /todo */
   void PrintDetails() const;
+
+  /** @return The size of the parameter object and its display texts in bytes */
+  size_t GetMemoryUsage() const { return sizeof(IParam) + mDisplayTexts.GetSize() * sizeof(DisplayText) + mLUT.GetSize() * sizeof(double); }
 private:
+  friend class IEditorDelegate;
+
+#ifdef IPLUG_COMPACT_PARAMS
+  std::atomic<double>& AtomicValue() { return *mpValue; }
+  const std::atomic<double>& AtomicValue() const { return *mpValue; }
+
+  /** @return A copy of \p str, shortened to \p maxLen - 1 characters, that lives as long as the process and is shared by every parameter with the same string */
+  static const char* InternString(const char* str, int maxLen);
+  static void SetMetaString(const char*& dest, const char* str, int maxLen) { dest = InternString(str, maxLen); }
+#else
+  std::atomic<double>& AtomicValue() { return mValue; }
+  const std::atomic<double>& AtomicValue() const { return mValue; }
+
+  static void SetMetaString(char* dest, const char* str, int maxLen) { strcpy(dest, str); }
+#endif
+
+  /** Formats a non-normalized value without the cache, see GetDisplayForHost() */
+  void FormatDisplay(double value, WDL_String& display, bool withDisplayText) const;
+
+  /** Linear interpolation in the lookup table, see SetLookupTable() */
+  inline double LookUp(double normalizedValue) const
+  {
+    const int size = mLUT.GetSize() - 1;
+    const double pos = Clip(normalizedValue, 0., 1.) * size;
+    const int idx = std::min(static_cast<int>(pos), size - 1);
+    const double* pTable = mLUT.Get() + idx;
+    return pTable[0] + (pos - idx) * (pTable[1] - pTable[0]);
+  }
+
   /** /todo */
   struct DisplayText
   {
@@ -457,6 +554,9 @@ private:
 
   EParamType mType = kTypeNone;
   EParamUnit mUnit = kUnitCustom;
+#ifdef IPLUG_COMPACT_PARAMS
+  std::atomic<double>* mpValue = &mValue; // bound to IEditorDelegate's value array, or to mValue for parameters added later
+#endif
   std::atomic<double> mValue{0.0};
   double mMin = 0.0;
   double mMax = 1.0;
@@ -464,15 +564,32 @@ private:
   double mDefault = 0.0;
   int mDisplayPrecision = 0;
   int mFlags = 0;
+  double mSmoothingTime = 0.;
 
   char mName[MAX_PARAM_NAME_LEN];
+#ifdef IPLUG_COMPACT_PARAMS
+  const char* mLabel = ""; // interned, parameters tend to share the same few labels and groups
+  const char* mParamGroup = "";
+#else
   char mLabel[MAX_PARAM_LABEL_LEN];
   char mParamGroup[MAX_PARAM_GROUP_LEN];
+#endif
   
   std::unique_ptr<Shape> mShape;
   DisplayFunc mDisplayFunction = nullptr;
 
   WDL_TypedBuf<DisplayText> mDisplayTexts;
+
+  // the last text GetDisplayForHost() made, valid while mDisplayCacheGeneration matches mDisplayGeneration, and only touched by whoever holds mDisplayCacheBusy
+  std::atomic<uint32_t> mDisplayGeneration{1};
+  mutable std::atomic<bool> mDisplayCacheBusy{false};
+  mutable uint32_t mDisplayCacheGeneration = 0;
+  mutable double mDisplayCacheValue = 0.;
+  mutable bool mDisplayCacheWithText = false;
+  mutable WDL_String mDisplayCache;
+
+  /** Values at evenly spaced normalized positions, from 0. to 1. inclusive. Empty unless SetLookupTable() was called */
+  WDL_TypedBuf<double> mLUT;
 } WDL_FIXALIGN;
 
 END_IPLUG_NAMESPACE
@@ -23,6 +23,12 @@
 #include <windows.h>
 #include <Shlobj.h>
 #include <Shlwapi.h>
+#elif defined OS_LINUX
+#include <dlfcn.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #endif
 
 BEGIN_IPLUG_NAMESPACE
@@ -230,6 +236,164 @@ const void* LoadWinResource(const char* resid, const char* type, int& sizeInByte
   }
 }
 
+#elif defined OS_LINUX
+#pragma mark - OS_LINUX
+
+static void GetDirectory(const char* filePath, WDL_String& path)
+{
+  path.Set("");
+  const char* pSlash = strrchr(filePath, '/');
+
+  if (pSlash)
+    path.Set(filePath, static_cast<int>(pSlash - filePath) + 1);
+}
+
+// The module that this function is linked into, i.e. the plug-in's shared library, or the executable for an app
+static void GetModulePath(WDL_String& path)
+{
+  Dl_info info;
+  char realPath[PATH_MAX];
+
+  if (dladdr(reinterpret_cast<void*>(&GetModulePath), &info) && info.dli_fname && realpath(info.dli_fname, realPath))
+    GetDirectory(realPath, path);
+  else
+    path.Set("");
+}
+
+static void GetEnvPath(WDL_String& path, const char* envName, const char* homeFallback)
+{
+  const char* pEnv = getenv(envName);
+
+  if (CStringHasContents(pEnv))
+  {
+    path.Set(pEnv);
+  }
+  else
+  {
+    UserHomePath(path);
+    path.Append(homeFallback);
+  }
+}
+
+static bool FileExists(const char* path)
+{
+  struct stat info;
+  return stat(path, &info) == 0 && S_ISREG(info.st_mode);
+}
+
+void HostPath(WDL_String& path, const char* bundleID)
+{
+  char exePath[PATH_MAX];
+  const ssize_t len = readlink("/proc/self/exe", exePath, PATH_MAX - 1);
+
+  if (len > 0)
+  {
+    exePath[len] = '\0';
+    GetDirectory(exePath, path);
+  }
+  else
+    path.Set("");
+}
+
+void PluginPath(WDL_String& path, PluginIDType pExtra)
+{
+  GetModulePath(path);
+}
+
+void BundleResourcePath(WDL_String& path, PluginIDType pExtra)
+{
+  GetModulePath(path);
+
+#ifdef VST3_API
+  // Plugin.vst3/Contents/x86_64-linux/Plugin.so
+  path.SetLen(path.GetLength() - 1);
+  GetDirectory(path.Get(), path);
+  path.Append("Resources/");
+#else
+  path.Append("resources/");
+#endif
+}
+
+void DesktopPath(WDL_String& path)
+{
+  UserHomePath(path);
+  path.Append("/Desktop");
+}
+
+void UserHomePath(WDL_String & path)
+{
+  const char* pHome = getenv("HOME");
+  path.Set(pHome ? pHome : "");
+}
+
+void AppSupportPath(WDL_String& path, bool isSystem)
+{
+  if (isSystem)
+    path.Set("/etc/xdg");
+  else
+    GetEnvPath(path, "XDG_CONFIG_HOME", "/.config");
+}
+
+void VST3PresetsPath(WDL_String& path, const char* mfrName, const char* pluginName, bool isSystem)
+{
+  if (isSystem)
+    path.Set("/usr/share/vst3/presets");
+  else
+  {
+    UserHomePath(path);
+    path.Append("/.vst3/presets");
+  }
+
+  path.AppendFormatted(MAX_MACOS_PATH_LEN, "/%s/%s", mfrName, pluginName);
+}
+
+void SandboxSafeAppSupportPath(WDL_String& path, const char* appGroupID)
+{
+  AppSupportPath(path);
+}
+
+void INIPath(WDL_String& path, const char * pluginName)
+{
+  AppSupportPath(path);
+  path.AppendFormatted(MAX_MACOS_PATH_LEN, "/%s", pluginName);
+}
+
+EResourceLocation LocateResource(const char* name, const char* type, WDL_String& result, const char*, void*)
+{
+  if (CStringHasContents(name))
+  {
+    if (name[0] == '/' && FileExists(name))
+    {
+      result.Set(name);
+      return EResourceLocation::kAbsolutePath;
+    }
+
+    WDL_String resourcePath;
+    BundleResourcePath(resourcePath);
+
+    const char* subfolder = (strcmp(type, "ttf") == 0 || strcmp(type, "otf") == 0 || strcmp(type, "TTF") == 0 || strcmp(type, "OTF") == 0) ? "fonts" : "img";
+
+    result.SetFormatted(MAX_MACOS_PATH_LEN, "%s%s/%s", resourcePath.Get(), subfolder, name);
+
+    if (FileExists(result.Get()))
+      return EResourceLocation::kAbsolutePath;
+
+    result.SetFormatted(MAX_MACOS_PATH_LEN, "%s%s", resourcePath.Get(), name);
+
+    if (FileExists(result.Get()))
+      return EResourceLocation::kAbsolutePath;
+  }
+
+  result.Set("");
+  return EResourceLocation::kNotFound;
+}
+
+const void* LoadWinResource(const char* resid, const char* type, int& sizeInBytes, void* pHInstance)
+{
+  sizeInBytes = 0;
+  return nullptr;
+}
+
 #elif defined OS_WEB
 #pragma mark - OS_WEB
 
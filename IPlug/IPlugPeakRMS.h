@@ -0,0 +1,299 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPeakRMS
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "IPlugPlatform.h"
+
+#if defined _M_X64 || defined _M_IX86 || defined __x86_64__ || defined __i386__
+  #if defined _M_X64 || defined __x86_64__ || defined __SSE2__ || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define IPLUG_PEAK_RMS_SSE2
+  #endif
+#elif defined __ARM_NEON || defined __ARM_NEON__ || defined _M_ARM64
+  #include <arm_neon.h>
+  #define IPLUG_PEAK_RMS_NEON
+  #if defined __aarch64__ || defined _M_ARM64
+    #define IPLUG_PEAK_RMS_NEON_F64
+  #endif
+#elif defined __wasm_simd128__
+  #include <wasm_simd128.h>
+  #define IPLUG_PEAK_RMS_WASM_SIMD
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+
+/** The peak and the sum of squares of blocks of samples, for level meters on the audio thread.
+ * Blocks are reduced four floats or two doubles at a time with SSE2, NEON or WebAssembly SIMD128 where available, and a scalar loop otherwise.
+ * Several blocks can be accumulated into one result, and the RMS derived from the total at the end */
+struct IPeakRMS
+{
+  float mPeak = 0.f;
+  double mSumSquares = 0.;
+  int mNFrames = 0;
+
+  void Clear() { *this = IPeakRMS(); }
+
+  /** Add a block of samples
+   * @param pData The samples
+   * @param nFrames The number of samples */
+  template <typename T>
+  void Accumulate(const T* pData, int nFrames)
+  {
+    float peak = mPeak;
+    double sumSquares = 0.;
+    Reduce(pData, nFrames, peak, sumSquares);
+    mPeak = peak;
+    mSumSquares += sumSquares;
+    mNFrames += nFrames;
+  }
+
+  /** Add another result, e.g. of a later block */
+  void Accumulate(const IPeakRMS& other)
+  {
+    mPeak = std::max(mPeak, other.mPeak);
+    mSumSquares += other.mSumSquares;
+    mNFrames += other.mNFrames;
+  }
+
+  /** @return The root mean square of everything accumulated, or 0 if nothing was */
+  float GetRMS() const { return mNFrames ? static_cast<float>(std::sqrt(mSumSquares / mNFrames)) : 0.f; }
+
+  /** A cheaper test than Accumulate(), for silence detection. Only the peak is reduced, and the scan stops at the first chunk that exceeds the threshold
+   * @param pData The samples
+   * @param nFrames The number of samples
+   * @param threshold The largest absolute sample value that counts as silence
+   * @return \c true if no sample's absolute value is greater than threshold */
+  template <typename T>
+  static bool IsBelowThreshold(const T* pData, int nFrames, float threshold)
+  {
+    static constexpr int kChunkSize = 64;
+
+    for (int s = 0; s < nFrames; s += kChunkSize)
+    {
+      if (Peak(pData + s, std::min(kChunkSize, nFrames - s)) > threshold)
+        return false;
+    }
+
+    return true;
+  }
+
+private:
+  static float Peak(const float* pData, int nFrames)
+  {
+    int s = 0;
+    float peak = 0.f;
+
+#if defined IPLUG_PEAK_RMS_SSE2
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 vPeak = _mm_setzero_ps();
+
+    for (; s + 4 <= nFrames; s += 4)
+      vPeak = _mm_max_ps(vPeak, _mm_and_ps(_mm_loadu_ps(pData + s), absMask));
+
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, vPeak);
+    peak = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#elif defined IPLUG_PEAK_RMS_NEON
+    float32x4_t vPeak = vdupq_n_f32(0.f);
+
+    for (; s + 4 <= nFrames; s += 4)
+      vPeak = vmaxq_f32(vPeak, vabsq_f32(vld1q_f32(pData + s)));
+
+    float lanes[4];
+    vst1q_f32(lanes, vPeak);
+    peak = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#elif defined IPLUG_PEAK_RMS_WASM_SIMD
+    v128_t vPeak = wasm_f32x4_splat(0.f);
+
+    for (; s + 4 <= nFrames; s += 4)
+      vPeak = wasm_f32x4_pmax(vPeak, wasm_f32x4_abs(wasm_v128_load(pData + s)));
+
+    peak = std::max(std::max(wasm_f32x4_extract_lane(vPeak, 0), wasm_f32x4_extract_lane(vPeak, 1)),
+                    std::max(wasm_f32x4_extract_lane(vPeak, 2), wasm_f32x4_extract_lane(vPeak, 3)));
+#endif
+
+    for (; s < nFrames; s++)
+      peak = std::max(peak, std::fabs(pData[s]));
+
+    return peak;
+  }
+
+  static float Peak(const double* pData, int nFrames)
+  {
+    int s = 0;
+    double peak = 0.;
+
+#if defined IPLUG_PEAK_RMS_SSE2
+    const __m128d absMask = _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+    __m128d vPeak = _mm_setzero_pd();
+
+    for (; s + 2 <= nFrames; s += 2)
+      vPeak = _mm_max_pd(vPeak, _mm_and_pd(_mm_loadu_pd(pData + s), absMask));
+
+    alignas(16) double lanes[2];
+    _mm_store_pd(lanes, vPeak);
+    peak = std::max(lanes[0], lanes[1]);
+#elif defined IPLUG_PEAK_RMS_NEON_F64
+    float64x2_t vPeak = vdupq_n_f64(0.);
+
+    for (; s + 2 <= nFrames; s += 2)
+      vPeak = vmaxq_f64(vPeak, vabsq_f64(vld1q_f64(pData + s)));
+
+    peak = std::max(vgetq_lane_f64(vPeak, 0), vgetq_lane_f64(vPeak, 1));
+#elif defined IPLUG_PEAK_RMS_WASM_SIMD
+    v128_t vPeak = wasm_f64x2_splat(0.);
+
+    for (; s + 2 <= nFrames; s += 2)
+      vPeak = wasm_f64x2_pmax(vPeak, wasm_f64x2_abs(wasm_v128_load(pData + s)));
+
+    peak = std::max(wasm_f64x2_extract_lane(vPeak, 0), wasm_f64x2_extract_lane(vPeak, 1));
+#endif
+
+    for (; s < nFrames; s++)
+      peak = std::max(peak, std::fabs(pData[s]));
+
+    return static_cast<float>(peak);
+  }
+
+  static void Reduce(const float* pData, int nFrames, float& peak, double& sumSquares)
+  {
+    int s = 0;
+    float sum = 0.f;
+
+#if defined IPLUG_PEAK_RMS_SSE2
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 vPeak = _mm_set1_ps(peak);
+    __m128 vSum = _mm_setzero_ps();
+
+    for (; s + 4 <= nFrames; s += 4)
+    {
+      const __m128 x = _mm_loadu_ps(pData + s);
+      vPeak = _mm_max_ps(vPeak, _mm_and_ps(x, absMask));
+      vSum = _mm_add_ps(vSum, _mm_mul_ps(x, x));
+    }
+
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, vPeak);
+    peak = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+    _mm_store_ps(lanes, vSum);
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined IPLUG_PEAK_RMS_NEON
+    float32x4_t vPeak = vdupq_n_f32(peak);
+    float32x4_t vSum = vdupq_n_f32(0.f);
+
+    for (; s + 4 <= nFrames; s += 4)
+    {
+      const float32x4_t x = vld1q_f32(pData + s);
+      vPeak = vmaxq_f32(vPeak, vabsq_f32(x));
+      vSum = vmlaq_f32(vSum, x, x);
+    }
+
+    float lanes[4];
+    vst1q_f32(lanes, vPeak);
+    peak = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+    vst1q_f32(lanes, vSum);
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined IPLUG_PEAK_RMS_WASM_SIMD
+    v128_t vPeak = wasm_f32x4_splat(peak);
+    v128_t vSum = wasm_f32x4_splat(0.f);
+
+    for (; s + 4 <= nFrames; s += 4)
+    {
+      const v128_t x = wasm_v128_load(pData + s);
+      vPeak = wasm_f32x4_pmax(vPeak, wasm_f32x4_abs(x));
+      vSum = wasm_f32x4_add(vSum, wasm_f32x4_mul(x, x));
+    }
+
+    peak = std::max(std::max(wasm_f32x4_extract_lane(vPeak, 0), wasm_f32x4_extract_lane(vPeak, 1)),
+                    std::max(wasm_f32x4_extract_lane(vPeak, 2), wasm_f32x4_extract_lane(vPeak, 3)));
+    sum = (wasm_f32x4_extract_lane(vSum, 0) + wasm_f32x4_extract_lane(vSum, 1)) + (wasm_f32x4_extract_lane(vSum, 2) + wasm_f32x4_extract_lane(vSum, 3));
+#endif
+
+    for (; s < nFrames; s++)
+    {
+      peak = std::max(peak, std::fabs(pData[s]));
+      sum += pData[s] * pData[s];
+    }
+
+    sumSquares += sum;
+  }
+
+  static void Reduce(const double* pData, int nFrames, float& peak, double& sumSquares)
+  {
+    int s = 0;
+    double blockPeak = peak;
+    double sum = 0.;
+
+#if defined IPLUG_PEAK_RMS_SSE2
+    const __m128d absMask = _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+    __m128d vPeak = _mm_set1_pd(blockPeak);
+    __m128d vSum = _mm_setzero_pd();
+
+    for (; s + 2 <= nFrames; s += 2)
+    {
+      const __m128d x = _mm_loadu_pd(pData + s);
+      vPeak = _mm_max_pd(vPeak, _mm_and_pd(x, absMask));
+      vSum = _mm_add_pd(vSum, _mm_mul_pd(x, x));
+    }
+
+    alignas(16) double lanes[2];
+    _mm_store_pd(lanes, vPeak);
+    blockPeak = std::max(lanes[0], lanes[1]);
+    _mm_store_pd(lanes, vSum);
+    sum = lanes[0] + lanes[1];
+#elif defined IPLUG_PEAK_RMS_NEON_F64
+    float64x2_t vPeak = vdupq_n_f64(blockPeak);
+    float64x2_t vSum = vdupq_n_f64(0.);
+
+    for (; s + 2 <= nFrames; s += 2)
+    {
+      const float64x2_t x = vld1q_f64(pData + s);
+      vPeak = vmaxq_f64(vPeak, vabsq_f64(x));
+      vSum = vfmaq_f64(vSum, x, x);
+    }
+
+    blockPeak = std::max(vgetq_lane_f64(vPeak, 0), vgetq_lane_f64(vPeak, 1));
+    sum = vgetq_lane_f64(vSum, 0) + vgetq_lane_f64(vSum, 1);
+#elif defined IPLUG_PEAK_RMS_WASM_SIMD
+    v128_t vPeak = wasm_f64x2_splat(blockPeak);
+    v128_t vSum = wasm_f64x2_splat(0.);
+
+    for (; s + 2 <= nFrames; s += 2)
+    {
+      const v128_t x = wasm_v128_load(pData + s);
+      vPeak = wasm_f64x2_pmax(vPeak, wasm_f64x2_abs(x));
+      vSum = wasm_f64x2_add(vSum, wasm_f64x2_mul(x, x));
+    }
+
+    blockPeak = std::max(wasm_f64x2_extract_lane(vPeak, 0), wasm_f64x2_extract_lane(vPeak, 1));
+    sum = wasm_f64x2_extract_lane(vSum, 0) + wasm_f64x2_extract_lane(vSum, 1);
+#endif
+
+    for (; s < nFrames; s++)
+    {
+      blockPeak = std::max(blockPeak, std::fabs(pData[s]));
+      sum += pData[s] * pData[s];
+    }
+
+    peak = static_cast<float>(blockPeak);
+    sumSquares += sum;
+  }
+};
+
+END_IPLUG_NAMESPACE
@@ -44,10 +44,18 @@
 #include <cstring>
 #include <cstdlib>
 
+// PARAMS_LOCKFREE: parameter values are only accessed atomically, and OnParamChange() notifications from non-realtime threads are
+// queued and delivered on the audio thread (see IEditorDelegate::ProcessDeferredParamChanges()), so no mutex is required around processing
+// IPLUG_COMPACT_PARAMS: for plug-ins with thousands of parameters. The parameters are allocated together, their values are kept in one
+// contiguous array (see IEditorDelegate::GetParamValues()) that state serialization copies in bulk, and labels and groups are interned
+#if defined PARAMS_MUTEX && defined PARAMS_LOCKFREE
+  #error "PARAMS_MUTEX and PARAMS_LOCKFREE can not both be defined"
+#endif
+
 #ifdef PARAMS_MUTEX
-  #define ENTER_PARAMS_MUTEX mParams_mutex.Enter(); Trace(TRACELOC, "%s", "ENTER_PARAMS_MUTEX")
+  #define ENTER_PARAMS_MUTEX REALTIME_CHECK("ENTER_PARAMS_MUTEX, consider PARAMS_LOCKFREE"); mParams_mutex.Enter(); Trace(TRACELOC, "%s", "ENTER_PARAMS_MUTEX")
   #define LEAVE_PARAMS_MUTEX mParams_mutex.Leave(); Trace(TRACELOC, "%s", "LEAVE_PARAMS_MUTEX")
-  #define ENTER_PARAMS_MUTEX_STATIC _this->mParams_mutex.Enter(); Trace(TRACELOC, "%s", "ENTER_PARAMS_MUTEX")
+  #define ENTER_PARAMS_MUTEX_STATIC REALTIME_CHECK("ENTER_PARAMS_MUTEX, consider PARAMS_LOCKFREE"); _this->mParams_mutex.Enter(); Trace(TRACELOC, "%s", "ENTER_PARAMS_MUTEX")
   #define LEAVE_PARAMS_MUTEX_STATIC _this->mParams_mutex.Leave(); Trace(TRACELOC, "%s", "LEAVE_PARAMS_MUTEX")
 #else
   #define ENTER_PARAMS_MUTEX
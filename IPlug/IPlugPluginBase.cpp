@@ -21,6 +21,8 @@ using namespace iplug;
 
 IPluginBase::IPluginBase(int nParams, int nPresets)
 : EDITOR_DELEGATE_CLASS(nParams)
+, mDerivedParamChanges(nParams)
+, mParamDependencies(nParams)
 {  
 #ifndef NO_PRESETS
   for (int i = 0; i < nPresets; ++i)
@@ -79,6 +81,7 @@ const char* IPluginBase::GetAPIStr() const
     case kAPIAPP: return "Standalone";
     case kAPIWAM: return "WAM";
     case kAPIWEB: return "WEB";
+    case kAPIBENCH: return "Bench";
     default: return "";
   }
 }
@@ -106,15 +109,49 @@ void IPluginBase::GetBuildInfoStr(WDL_String& str) const
 bool IPluginBase::SerializeParams(IByteChunk& chunk) const
 {
   TRACE;
+  // after this many attempts the last copy is kept. Each value is still whole, as IParam values are atomic
+  static constexpr int kMaxSnapshotAttempts = 16;
+  const int startSize = chunk.Size();
   bool savedOK = true;
-  int i, n = mParams.GetSize();
-  for (i = 0; i < n && savedOK; ++i)
+
+  for (int attempt = 1; ; attempt++)
   {
-    IParam* pParam = mParams.Get(i);
-    Trace(TRACELOC, "%d %s %f", i, pParam->GetNameForHost(), pParam->Value());
-    double v = pParam->Value();
-    savedOK &= (chunk.Put(&v) > 0);
+    const uint32_t epoch = mParamsEpoch.load(std::memory_order_acquire);
+    int i, n = mParams.GetSize();
+#ifdef IPLUG_COMPACT_PARAMS
+    // the values are contiguous, so they are copied straight into the chunk in one pass
+    if (const std::atomic<double>* pValues = GetParamValues())
+    {
+      const int endSize = startSize + n * static_cast<int>(sizeof(double));
+      chunk.Resize(endSize);
+      savedOK = chunk.Size() == endSize;
+      uint8_t* pDest = chunk.GetData() + startSize;
+
+      for (i = 0; i < n && savedOK; ++i)
+      {
+        const double v = pValues[i].load(std::memory_order_relaxed);
+        memcpy(pDest + i * sizeof(double), &v, sizeof(double));
+      }
+    }
+    else
+#endif
+    for (i = 0; i < n && savedOK; ++i)
+    {
+      IParam* pParam = mParams.Get(i);
+      Trace(TRACELOC, "%d %s %f", i, pParam->GetNameForHost(), pParam->Value());
+      double v = pParam->Value();
+      savedOK &= (chunk.Put(&v) > 0);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const bool consistent = !(epoch % kParamsEpochStep) && epoch == mParamsEpoch.load(std::memory_order_relaxed);
+
+    if (!savedOK || consistent || attempt == kMaxSnapshotAttempts)
+      break;
+
+    chunk.Resize(startSize);
   }
+
   return savedOK;
 }
 
@@ -123,6 +160,24 @@ int IPluginBase::UnserializeParams(const IByteChunk& chunk, int startPos)
   TRACE;
   int i, n = mParams.GetSize(), pos = startPos;
   ENTER_PARAMS_MUTEX;
+  BeginParamsWrite();
+#ifdef IPLUG_COMPACT_PARAMS
+  // read straight out of the chunk when it holds every value, each is still constrained to its parameter's range
+  if (GetParamValues() && pos >= 0 && pos + n * static_cast<int>(sizeof(double)) <= chunk.Size())
+  {
+    const uint8_t* pSrc = chunk.GetData() + pos;
+
+    for (i = 0; i < n; ++i)
+    {
+      double v;
+      memcpy(&v, pSrc + i * sizeof(double), sizeof(double));
+      mParams.Get(i)->Set(v);
+    }
+
+    pos += n * static_cast<int>(sizeof(double));
+  }
+  else
+#endif
   for (i = 0; i < n && pos >= 0; ++i)
   {
     IParam* pParam = mParams.Get(i);
@@ -131,8 +186,13 @@ int IPluginBase::UnserializeParams(const IByteChunk& chunk, int startPos)
     pParam->Set(v);
     Trace(TRACELOC, "%d %s %f", i, pParam->GetNameForHost(), pParam->Value());
   }
+  EndParamsWrite();
 
+#ifdef PARAMS_LOCKFREE
+  DeferParamReset(kPresetRecall);
+#else
   OnParamReset(kPresetRecall);
+#endif
 
   LEAVE_PARAMS_MUTEX;
   return pos;
@@ -268,6 +328,129 @@ void IPluginBase::PrintParamValues()
   });
 }
 
+bool IPluginBase::AddParamDependency(int paramIdx, int sourceParamIdx)
+{
+  const bool added = mParamDependencies.Add(paramIdx, sourceParamIdx);
+  assert(added && "Parameter dependency out of range or cyclic");
+  return added;
+}
+
+int IPluginBase::EvaluateParamDependencies()
+{
+  return mParamDependencies.Evaluate([&](int paramIdx) {
+    BeginParamsWrite();
+    const bool changed = OnParamDependencyChange(paramIdx);
+    EndParamsWrite();
+
+    if (changed)
+      mDerivedParamChanges.Set(paramIdx, GetParam(paramIdx)->Value());
+
+    return changed;
+  });
+}
+
+void IPluginBase::BeginUndoableStateChange()
+{
+  if (mUndoStateChangeDepth++ == 0 && mUndoHistory.IsEnabled())
+  {
+    mUndoStateBefore.Clear();
+    SerializeState(mUndoStateBefore);
+  }
+}
+
+void IPluginBase::EndUndoableStateChange()
+{
+  assert(mUndoStateChangeDepth > 0 && "EndUndoableStateChange() without BeginUndoableStateChange()");
+
+  if (mUndoStateChangeDepth <= 0 || --mUndoStateChangeDepth > 0 || !mUndoHistory.IsEnabled())
+    return;
+
+  mUndoState.Clear();
+  SerializeState(mUndoState);
+  mUndoHistory.AddStateChange(mUndoStateBefore, mUndoState);
+}
+
+void IPluginBase::BeginUndoParamGesture(int paramIdx)
+{
+  if (!mApplyingUndo)
+    mUndoHistory.BeginParamGesture(paramIdx, GetParam(paramIdx)->Value());
+}
+
+void IPluginBase::EndUndoParamGesture(int paramIdx)
+{
+  if (!mApplyingUndo)
+    mUndoHistory.EndParamGesture(paramIdx, GetParam(paramIdx)->Value());
+}
+
+bool IPluginBase::ApplyUndoStep(bool undo)
+{
+  const IPlugUndoHistory::Step* pStep = undo ? mUndoHistory.GetUndoStep() : mUndoHistory.GetRedoStep();
+
+  if (!pStep)
+    return false;
+
+  if (pStep->mIsState)
+  {
+    mUndoState.Clear();
+    SerializeState(mUndoState);
+
+    if (!IPlugUndoHistory::ApplyStateStep(*pStep, mUndoState, undo, mUndoResult))
+    {
+      mUndoHistory.Clear();
+      return false;
+    }
+
+    if (UnserializeState(mUndoResult, 0) <= 0)
+      return false;
+
+    DirtyParametersFromUI();
+    OnRestoreState();
+  }
+  else
+  {
+    // the values are set as if the user had made the gestures, so that the host records them as automation
+    mApplyingUndo = true;
+
+    for (size_t i = 0; i < pStep->mParams.size(); i++)
+    {
+      const IPlugUndoHistory::ParamDelta& delta = pStep->mParams[undo ? pStep->mParams.size() - 1 - i : i];
+      const double normalizedValue = GetParam(delta.mParamIdx)->ToNormalized(undo ? delta.mOldValue : delta.mNewValue);
+      BeginInformHostOfParamChangeFromUI(delta.mParamIdx);
+      SendParameterValueFromUI(delta.mParamIdx, normalizedValue);
+      EndInformHostOfParamChangeFromUI(delta.mParamIdx);
+      SendParameterValueFromDelegate(delta.mParamIdx, normalizedValue, true);
+    }
+
+    mApplyingUndo = false;
+  }
+
+  if (undo)
+    mUndoHistory.StepBack();
+  else
+    mUndoHistory.StepForward();
+
+  return true;
+}
+
+void IPluginBase::GetMemoryReport(IMemoryReport& report) const
+{
+  EDITOR_DELEGATE_CLASS::GetMemoryReport(report);
+  report.Add("Derived parameter changes", mDerivedParamChanges.GetMemoryUsage());
+  report.Add("Undo history", mUndoHistory.GetMemoryUsage() + mUndoStateBefore.Size() + mUndoState.Size() + mUndoResult.Size());
+
+#ifndef NO_PRESETS
+  size_t presetBytes = mPresets.GetSize() * sizeof(IPreset);
+
+  for (int i = 0; i < mPresets.GetSize(); i++)
+    presetBytes += mPresets.Get(i)->mChunk.Size();
+
+  report.Add("Presets", presetBytes);
+
+  if (mPresetBank)
+    report.Add("Preset bank (shared)", mPresetBank->GetSize());
+#endif
+}
+
 #ifndef NO_PRESETS
 static IPreset* GetNextUninitializedPreset(WDL_PtrList<IPreset>* pPresets)
 {
@@ -382,6 +565,96 @@ void IPluginBase::MakePresetFromBlob(const char* name, const char* blob, int siz
   MakePresetFromChunk(name, presetChunk);
 }
 
+static const char* GetPresetNameFromBank(const IPreset* pPreset, const IPresetBank* pBank)
+{
+  return pPreset->mBankIdx >= 0 ? pBank->GetName(pPreset->mBankIdx) : pPreset->mName;
+}
+
+// gives a preset that was read from the bank its own name and state, before they are modified
+static void DetachPresetFromBank(IPreset* pPreset, const IPresetBank* pBank)
+{
+  if (pPreset->mBankIdx < 0)
+    return;
+
+  int size;
+  const uint8_t* pState = pBank->GetState(pPreset->mBankIdx, size);
+  strcpy(pPreset->mName, pBank->GetName(pPreset->mBankIdx));
+  pPreset->mChunk.Clear();
+  pPreset->mChunk.PutBytes(pState, size);
+  pPreset->mBankIdx = -1;
+}
+
+int IPluginBase::MakePresetsFromBank(std::shared_ptr<const IPresetBank> pBank)
+{
+  TRACE;
+
+  if (!pBank)
+    return 0;
+
+  // presets from an earlier bank keep theirs
+  if (mPresetBank && mPresetBank != pBank)
+  {
+    for (int i = 0; i < mPresets.GetSize(); i++)
+      DetachPresetFromBank(mPresets.Get(i), mPresetBank.get());
+  }
+
+  mPresetBank = pBank;
+
+  int nMade = 0;
+
+  for (; nMade < pBank->NPresets(); nMade++)
+  {
+    IPreset* pPreset = GetNextUninitializedPreset(&mPresets);
+
+    if (!pPreset)
+      break;
+
+    pPreset->mInitialized = true;
+    pPreset->mBankIdx = nMade;
+    pPreset->mChunk.Clear();
+  }
+
+  return nMade;
+}
+
+bool IPluginBase::SavePresetBank(const char* file) const
+{
+  if (!CStringHasContents(file))
+    return false;
+
+  IPresetBank::Builder builder;
+
+  for (int i = 0; i < mPresets.GetSize(); i++)
+  {
+    const IPreset* pPreset = mPresets.Get(i);
+
+    if (!pPreset->mInitialized)
+      continue;
+
+    if (pPreset->mBankIdx >= 0)
+    {
+      int size;
+      const uint8_t* pState = mPresetBank->GetState(pPreset->mBankIdx, size);
+      builder.Add(mPresetBank->GetName(pPreset->mBankIdx), pState, size);
+    }
+    else
+      builder.Add(pPreset->mName, pPreset->mChunk.GetData(), pPreset->mChunk.Size());
+  }
+
+  IByteChunk bank;
+  builder.Write(bank);
+
+  FILE* fp = fopen(file, "wb");
+
+  if (!fp)
+    return false;
+
+  const bool savedOK = fwrite(bank.GetData(), bank.Size(), 1, fp) == 1;
+  fclose(fp);
+
+  return savedOK;
+}
+
 static void MakeDefaultUserPresetName(WDL_PtrList<IPreset>* pPresets, char* str)
 {
   int nDefaultNames = 0;
@@ -435,6 +708,12 @@ bool IPluginBase::RestorePreset(int idx)
       MakeDefaultUserPresetName(&mPresets, pPreset->mName);
       restoredOK = SerializeState(pPreset->mChunk);
     }
+    else if (pPreset->mBankIdx >= 0)
+    {
+      int size;
+      const uint8_t* pState = mPresetBank->GetState(pPreset->mBankIdx, size);
+      restoredOK = (UnserializeState(IByteChunkView(pState, size), 0) > 0);
+    }
     else
     {
       restoredOK = (UnserializeState(pPreset->mChunk, 0) > 0);
@@ -455,10 +734,23 @@ bool IPluginBase::RestorePreset(const char* name)
   if (CStringHasContents(name))
   {
     int n = mPresets.GetSize();
+    
+    // presets from the bank are found through its hash table, then the bank index is matched to a preset without comparing names
+    const int bankIdx = mPresetBank ? mPresetBank->Find(name) : -1;
+    
+    if (bankIdx >= 0)
+    {
+      for (int i = 0; i < n; ++i)
+      {
+        if (mPresets.Get(i)->mBankIdx == bankIdx)
+          return RestorePreset(i);
+      }
+    }
+    
     for (int i = 0; i < n; ++i)
     {
       IPreset* pPreset = mPresets.Get(i);
-      if (!strcmp(pPreset->mName, name))
+      if (pPreset->mBankIdx < 0 && !strcmp(pPreset->mName, name))
       {
         return RestorePreset(i);
       }
@@ -471,7 +763,7 @@ const char* IPluginBase::GetPresetName(int idx) const
 {
   if (idx >= 0 && idx < mPresets.GetSize())
   {
-    return mPresets.Get(idx)->mName;
+    return GetPresetNameFromBank(mPresets.Get(idx), mPresetBank.get());
   }
   return "";
 }
@@ -481,6 +773,7 @@ void IPluginBase::ModifyCurrentPreset(const char* name)
   if (mCurrentPresetIdx >= 0 && mCurrentPresetIdx < mPresets.GetSize())
   {
     IPreset* pPreset = mPresets.Get(mCurrentPresetIdx);
+    DetachPresetFromBank(pPreset, mPresetBank.get());
     pPreset->mChunk.Clear();
     
     Trace(TRACELOC, "%d %s", mCurrentPresetIdx, pPreset->mName);
@@ -502,12 +795,19 @@ bool IPluginBase::SerializePresets(IByteChunk& chunk) const
   for (int i = 0; i < n && savedOK; ++i)
   {
     IPreset* pPreset = mPresets.Get(i);
-    chunk.PutStr(pPreset->mName);
+    const char* name = GetPresetNameFromBank(pPreset, mPresetBank.get());
+    chunk.PutStr(name);
     
-    Trace(TRACELOC, "%d %s", i, pPreset->mName);
+    Trace(TRACELOC, "%d %s", i, name);
     
     chunk.Put(&pPreset->mInitialized);
-    if (pPreset->mInitialized)
+    if (pPreset->mBankIdx >= 0)
+    {
+      int size;
+      const uint8_t* pState = mPresetBank->GetState(pPreset->mBankIdx, size);
+      savedOK &= (chunk.PutBytes(pState, size) > 0);
+    }
+    else if (pPreset->mInitialized)
     {
       savedOK &= (chunk.PutChunk(&(pPreset->mChunk)) > 0);
     }
@@ -515,7 +815,7 @@ bool IPluginBase::SerializePresets(IByteChunk& chunk) const
   return savedOK;
 }
 
-int IPluginBase::UnserializePresets(IByteChunk& chunk, int startPos)
+int IPluginBase::UnserializePresets(const IByteChunk& chunk, int startPos)
 {
   TRACE;
   WDL_String name;
@@ -525,6 +825,7 @@ int IPluginBase::UnserializePresets(IByteChunk& chunk, int startPos)
     IPreset* pPreset = mPresets.Get(i);
     pos = chunk.GetStr(name, pos);
     strcpy(pPreset->mName, name.Get());
+    pPreset->mBankIdx = -1;
     
     Trace(TRACELOC, "%d %s", i, pPreset->mName);
     
@@ -591,6 +892,7 @@ void IPluginBase::DumpAllPresetsBlob(const char* filename) const
   for (int i = 0; i< NPresets(); i++)
   {
     IPreset* pPreset = mPresets.Get(i);
+    DetachPresetFromBank(pPreset, mPresetBank.get()); // the dump is written from the preset's own copy
     fprintf(fp, "MakePresetFromBlob(\"%s\", \"", pPreset->mName);
     
     chnk.Clear();
@@ -610,6 +912,7 @@ void IPluginBase::DumpPresetBlob(const char* filename) const
   
   char buf[MAX_BLOB_LENGTH];
   
+  DetachPresetFromBank(mPresets.Get(mCurrentPresetIdx), mPresetBank.get());
   IByteChunk* pPresetChunk = &mPresets.Get(mCurrentPresetIdx)->mChunk;
   uint8_t* byteStart = pPresetChunk->GetData();
   
@@ -631,6 +934,7 @@ void IPluginBase::DumpBankBlob(const char* filename) const
   for (int i = 0; i< NPresets(); i++)
   {
     IPreset* pPreset = mPresets.Get(i);
+    DetachPresetFromBank(pPreset, mPresetBank.get()); // the dump is written from the preset's own copy
     fprintf(fp, "MakePresetFromBlob(\"%s\", \"", pPreset->mName);
     
     IByteChunk* pPresetChunk = &pPreset->mChunk;
@@ -785,6 +1089,7 @@ bool IPluginBase::SaveBankAsFXB(const char* file) const
       for (int p = 0; p < NPresets(); p++)
       {
         IPreset* pPreset = mPresets.Get(p);
+        DetachPresetFromBank(pPreset, mPresetBank.get());
         
         char prgName[28];
         memset(prgName, 0, 28);
@@ -894,6 +1199,7 @@ bool IPluginBase::LoadProgramFromFXP(const char* file)
       else if (fxpMagic == 'FxCk') // Due to the big Endian-ness of FXP/FXB format we cannot call SerialiseParams()
       {
         ENTER_PARAMS_MUTEX;
+        BeginParamsWrite();
         for (int i = 0; i< NParams(); i++)
         {
           WDL_EndianFloat v32;
@@ -901,6 +1207,7 @@ bool IPluginBase::LoadProgramFromFXP(const char* file)
           v32.int32 = WDL_bswap_if_le(v32.int32);
           GetParam(i)->SetNormalized((double) v32.f);
         }
+        EndParamsWrite();
         LEAVE_PARAMS_MUTEX;
         
         ModifyCurrentPreset(prgName);
@@ -1028,6 +1335,7 @@ bool IPluginBase::LoadBankFromFXB(const char* file)
           RestorePreset(i);
           
           ENTER_PARAMS_MUTEX;
+          BeginParamsWrite();
           for (int j = 0; j< NParams(); j++)
           {
             WDL_EndianFloat v32;
@@ -1035,6 +1343,7 @@ bool IPluginBase::LoadBankFromFXB(const char* file)
             v32.int32 = WDL_bswap_if_le(v32.int32);
             GetParam(j)->SetNormalized((double) v32.f);
           }
+          EndParamsWrite();
           LEAVE_PARAMS_MUTEX;
           
           ModifyCurrentPreset(prgName);
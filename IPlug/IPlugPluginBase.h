@@ -15,10 +15,17 @@
  * @copydoc IPluginBase
  */
 
+#include <atomic>
+
 #include "IPlugDelegate_select.h"
 #include "IPlugParameter.h"
+#include "IPlugParamChangeSet.h"
+#include "IPlugParamDependencies.h"
 #include "IPlugStructs.h"
 #include "IPlugLogger.h"
+#include "IPlugRealtimeGuard.h"
+#include "IPlugPresetBank.h"
+#include "IPlugUndoHistory.h"
 
 BEGIN_IPLUG_NAMESPACE
 
@@ -115,9 +122,22 @@ public:
   bool DoesStateChunks() const { return mStateChunks; }
   
   /** Serializes the current double precision floating point, non-normalised values (IParam::mValue) of all parameters, into a binary byte chunk.
+   * This never takes the params mutex. If parameters are written between BeginParamsWrite() and EndParamsWrite() while the values are being copied,
+   * the copy is thrown away and taken again, so a host saving state during playback gets a consistent snapshot without holding up the audio thread.
    * @param chunk The output chunk to serialize to. Will append data if the chunk has already been started.
    * @return \c true if the serialization was successful */
   bool SerializeParams(IByteChunk& chunk) const;
+
+  /** Called by the API class before it writes parameter values, e.g. from the audio thread when applying host automation. Doesn't block,
+   * it just lets SerializeParams() know that a copy taken now can't be trusted. Every call must be matched by a call to EndParamsWrite() */
+  void BeginParamsWrite()
+  {
+    mParamsEpoch.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  /** Called by the API class after the parameter values have been written, see BeginParamsWrite() */
+  void EndParamsWrite() { mParamsEpoch.fetch_add(kParamsEpochStep - 1, std::memory_order_release); }
   
   /** Unserializes double precision floating point, non-normalised values from a byte chunk into mParams.
    * @param chunk The incoming chunk where parameter values are stored to unserialize
@@ -250,6 +270,17 @@ public:
    * @param blob /todo
    * @param sizeOfChunk /todo */
   void MakePresetFromBlob(const char* name, const char* blob, int sizeOfChunk);
+
+  /** Fill the next uninitialized presets from a bank, see IPresetBank. Nothing is copied or decoded: names are read from the bank,
+   * and a preset's state is only unserialized when it is restored. A preset that is modified gets its own copy
+   * @param pBank The bank, e.g. from IPresetBank::FromFile() or IPresetBank::FromMemory(), which can be shared with other instances
+   * @return The number of presets that were filled */
+  int MakePresetsFromBank(std::shared_ptr<const IPresetBank> pBank);
+
+  /** Write the presets as a bank file, which can be memory-mapped or embedded and used with MakePresetsFromBank()
+   * @param file The full path of the file to write
+   * @return \c true on success */
+  bool SavePresetBank(const char* file) const;
   
   /** /todo */
   void PruneUninitializedPresets();
@@ -270,7 +301,7 @@ public:
    * @param chunk /todo
    * @param startPos /todo
    * @return int /todo */
-  int UnserializePresets(IByteChunk& chunk, int startPos); // Returns the new chunk position (endPos).
+  int UnserializePresets(const IByteChunk& chunk, int startPos); // Returns the new chunk position (endPos).
   
   // Dump the current state as source code for a call to MakePresetFromNamedParams / MakePresetFromBlob
 
@@ -452,6 +483,64 @@ public:
   /** Default parameter values for a parameter group  */
   void PrintParamValues();
 
+#pragma mark - Undo
+
+  /** Keep an undo history of the edits made in the editor, see IPlugUndoHistory. Parameter gestures from the UI are recorded without serializing anything,
+   * edits of custom state are recorded by calling BeginUndoableStateChange() and EndUndoableStateChange() around them. Call this in the constructor
+   * @param maxSteps The most steps to keep, 0 to disable undo
+   * @param maxBytes The most memory the steps can take */
+  void EnableUndo(int maxSteps = 100, size_t maxBytes = 4 * 1024 * 1024) { mUndoHistory.SetLimits(maxSteps, maxBytes); }
+
+  /** Call on the main thread before changing custom state, so that the change can be undone. Calls can be nested, and only the outermost pair records a step */
+  void BeginUndoableStateChange();
+
+  /** Call after the custom state has been changed, see BeginUndoableStateChange(). Only the bytes of the serialized state that changed are kept */
+  void EndUndoableStateChange();
+
+  /** @return \c true if there is an edit to undo */
+  bool CanUndo() const { return mUndoHistory.CanUndo(); }
+
+  /** @return \c true if there is an undone edit to redo */
+  bool CanRedo() const { return mUndoHistory.CanRedo(); }
+
+  /** Revert the last edit, telling the host and the UI about the parameters it changes. Call on the main thread
+   * @return \c true if an edit was undone. If the state no longer matches the history, e.g. because it was changed without being recorded, the history is cleared */
+  bool Undo() { return ApplyUndoStep(true); }
+
+  /** Apply the last undone edit again, see Undo()
+   * @return \c true if an edit was redone */
+  bool Redo() { return ApplyUndoStep(false); }
+
+  /** Remove all undo steps, e.g. after loading a preset that shouldn't be undone */
+  void ClearUndoHistory() { mUndoHistory.Clear(); }
+
+#pragma mark - Parameter dependencies
+
+  /** Declare that a parameter's value is derived from another's, e.g. the parameters a meta-parameter controls. Call it in the constructor, after the
+   * parameters have been initialised. Instead of setting the derived parameters in OnParamChange(), which recurses through OnParamChange() for each of them,
+   * override OnParamDependencyChange(). When any of its sources has changed, it is called once for each derived parameter before the next ProcessBlock(),
+   * after the parameters it is derived from, and the host and UI are told about each changed derived parameter once per timer tick
+   * @param paramIdx The derived parameter
+   * @param sourceParamIdx The parameter it is derived from
+   * @return \c false if the dependency would make a cycle, in which case it isn't added */
+  bool AddParamDependency(int paramIdx, int sourceParamIdx);
+
+  void MarkParamChanged(int paramIdx) override { mParamDependencies.MarkChanged(paramIdx); }
+
+  /** Override this to set a derived parameter's value from its sources and update any DSP state that depends on it, see AddParamDependency().
+   * OnParamChange() isn't called for the changes made here. Called on the audio thread
+   * @param paramIdx The derived parameter
+   * @return \c true if its value changed, so that the parameters derived from it are evaluated too */
+  virtual bool OnParamDependencyChange(int paramIdx) { return false; }
+
+  /** Calls OnParamDependencyChange() for the parameters derived from those that changed since the last call, in dependency order.
+   * Called by IPlugProcessor on the audio thread before each ProcessBlock(), it does nothing if no parameter with dependents has changed
+   * @return The number of derived parameters whose value changed */
+  int EvaluateParamDependencies();
+
+  /** Adds the factory and user presets to the report, see IEditorDelegate::GetMemoryReport() */
+  void GetMemoryReport(IMemoryReport& report) const override;
+
 protected:
   int mCurrentPresetIdx = 0;
   /** \c true if the plug-in does opaque state chunks. If false the host will provide a default interface */
@@ -491,12 +580,38 @@ protected:
   
 #ifndef NO_PRESETS
   WDL_PtrList<IPreset> mPresets;
+  /** Factory presets that are read on demand, see MakePresetsFromBank() */
+  std::shared_ptr<const IPresetBank> mPresetBank;
 #endif
 
 #ifdef PARAMS_MUTEX
   /** Lock when accessing mParams (including via GetParam) from the audio thread */
   WDL_Mutex mParams_mutex;
 #endif  
+
+  /** The derived parameters that EvaluateParamDependencies() changed, to tell the host and UI about on the main thread */
+  IPlugParamChangeSet mDerivedParamChanges;
+
+  /** Called by the API class when a parameter gesture from the UI starts, to record it for undo */
+  void BeginUndoParamGesture(int paramIdx);
+
+  /** Called by the API class when a parameter gesture from the UI ends */
+  void EndUndoParamGesture(int paramIdx);
+
+private:
+  bool ApplyUndoStep(bool undo);
+
+  /** The low bits of mParamsEpoch count the writers that are in progress, the rest count the finished writes */
+  static constexpr uint32_t kParamsEpochStep = 1 << 8;
+  /** Changes whenever parameters are written, see BeginParamsWrite() */
+  std::atomic<uint32_t> mParamsEpoch {0};
+  IPlugParamDependencies mParamDependencies;
+  IPlugUndoHistory mUndoHistory;
+  IByteChunk mUndoStateBefore; // the state when the outermost BeginUndoableStateChange() was called
+  IByteChunk mUndoState; // reused for serializing, so that the chunks settle at one allocation
+  IByteChunk mUndoResult;
+  int mUndoStateChangeDepth = 0;
+  bool mApplyingUndo = false; // so that the gestures an undo makes aren't recorded
 };
 
 END_IPLUG_NAMESPACE
@@ -0,0 +1,367 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPresetBank
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "IPlugPlatform.h"
+#include "IPlugStructs.h"
+
+#ifdef OS_WIN
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A read-only bank of factory presets, which is either embedded in the binary or memory-mapped from a file, and shared by every instance that uses it.
+ * Nothing is decoded up front: a preset's state is only read when it is restored, and names are looked up through a hash table stored in the bank.
+ *
+ * The format is little endian. A header { magic, version, nPresets, hashTableSize } is followed by an entry { nameOffset, dataOffset, dataSize, nameHash }
+ * for each preset, the hash table (preset index + 1, or 0 for an empty slot), and then the null terminated names and the state of each preset,
+ * as written by IPluginBase::SerializeState(). Use Builder, or IPluginBase::SavePresetBank(), to make one */
+class IPresetBank final
+{
+public:
+  static constexpr uint32_t kMagic = 'IPBk';
+  static constexpr uint32_t kVersion = 1;
+
+  /** Writes the bank format */
+  class Builder
+  {
+  public:
+    /** Add a preset. The state is copied
+     * @param name The preset name
+     * @param pData The preset state, as written by IPluginBase::SerializeState()
+     * @param size The size of the state in bytes */
+    void Add(const char* name, const void* pData, int size)
+    {
+      mNames.Add(new WDL_String(name));
+      mSizes.Add(size);
+      mData.PutBytes(pData, size);
+    }
+
+    /** Write the bank
+     * @param bank The chunk to append the bank to */
+    void Write(IByteChunk& bank) const
+    {
+      const uint32_t nPresets = mNames.GetSize();
+      const uint32_t hashTableSize = HashTableSize(nPresets);
+      uint32_t namesOffset = kHeaderSize + nPresets * kEntrySize + hashTableSize * sizeof(uint32_t);
+      uint32_t dataOffset = namesOffset;
+
+      for (auto i = 0; i < mNames.GetSize(); i++)
+        dataOffset += mNames.Get(i)->GetLength() + 1;
+
+      const uint32_t header[] = { kMagic, kVersion, nPresets, hashTableSize };
+      bank.PutBytes(header, sizeof(header));
+
+      WDL_TypedBuf<uint32_t> hashTable;
+      hashTable.Resize(hashTableSize);
+      memset(hashTable.Get(), 0, hashTableSize * sizeof(uint32_t));
+
+      for (uint32_t i = 0; i < nPresets; i++)
+      {
+        const char* name = mNames.Get(i)->Get();
+        const uint32_t hash = Hash(name);
+        const uint32_t entry[] = { namesOffset, dataOffset, (uint32_t) mSizes.Get()[i], hash };
+        bank.PutBytes(entry, sizeof(entry));
+
+        // the first of several presets with the same name wins, as it did with a linear search
+        uint32_t slot = hash & (hashTableSize - 1);
+
+        while (hashTable.Get()[slot])
+          slot = (slot + 1) & (hashTableSize - 1);
+
+        hashTable.Get()[slot] = i + 1;
+
+        namesOffset += mNames.Get(i)->GetLength() + 1;
+        dataOffset += mSizes.Get()[i];
+      }
+
+      bank.PutBytes(hashTable.Get(), hashTableSize * sizeof(uint32_t));
+
+      for (auto i = 0; i < mNames.GetSize(); i++)
+        bank.PutBytes(mNames.Get(i)->Get(), mNames.Get(i)->GetLength() + 1);
+
+      bank.PutBytes(mData.GetData(), mData.Size());
+    }
+
+    ~Builder() { mNames.Empty(true); }
+
+  private:
+    WDL_PtrList<WDL_String> mNames;
+    WDL_TypedBuf<int> mSizes;
+    IByteChunk mData;
+  };
+
+  /** Use a bank that is embedded in the binary. The data is not copied
+   * @param pData The bank, which must stay valid for as long as the bank is used, e.g. a static array or a resource
+   * @param size The size of the bank in bytes
+   * @return The bank, or nullptr if the data is not a valid bank */
+  static std::shared_ptr<const IPresetBank> FromMemory(const void* pData, size_t size)
+  {
+    std::shared_ptr<IPresetBank> pBank(new IPresetBank(static_cast<const uint8_t*>(pData), size));
+    return pBank->IsValid() ? pBank : nullptr;
+  }
+
+  /** Memory-map a bank file. Instances that open the same path share one mapping, for as long as any of them holds on to it
+   * @param path The UTF-8 path of the bank file
+   * @return The bank, or nullptr if the file can't be mapped or is not a valid bank */
+  static std::shared_ptr<const IPresetBank> FromFile(const char* path)
+  {
+    static std::mutex sMutex;
+    static std::map<std::string, std::weak_ptr<const IPresetBank>> sBanks;
+
+    std::lock_guard<std::mutex> lock(sMutex);
+    std::weak_ptr<const IPresetBank>& cached = sBanks[path];
+    std::shared_ptr<const IPresetBank> pBank = cached.lock();
+
+    if (!pBank)
+    {
+      std::shared_ptr<IPresetBank> pMapped(new IPresetBank(path));
+
+      if (!pMapped->IsValid())
+      {
+        sBanks.erase(path);
+        return nullptr;
+      }
+
+      pBank = pMapped;
+      cached = pBank;
+    }
+
+    return pBank;
+  }
+
+  IPresetBank(const IPresetBank&) = delete;
+  IPresetBank& operator=(const IPresetBank&) = delete;
+
+  ~IPresetBank()
+  {
+#ifdef OS_WIN
+    if (mMappedData) UnmapViewOfFile(mMappedData);
+#else
+    if (mMappedData) munmap(mMappedData, mSize);
+#endif
+  }
+
+  /** @return The number of presets in the bank */
+  int NPresets() const { return (int) mNPresets; }
+
+  /** @return The size of the bank in bytes, which is shared by every instance using it */
+  size_t GetSize() const { return mSize; }
+
+  /** @param idx The preset index
+   * @return The preset name */
+  const char* GetName(int idx) const { return reinterpret_cast<const char*>(mData + Entry(idx, 0)); }
+
+  /** @param idx The preset index
+   * @param size Set to the size of the state in bytes
+   * @return The preset state, as written by IPluginBase::SerializeState() */
+  const uint8_t* GetState(int idx, int& size) const
+  {
+    size = (int) Entry(idx, 2);
+    return mData + Entry(idx, 1);
+  }
+
+  /** Find a preset through the bank's hash table
+   * @param name The preset name
+   * @return The index of the first preset with that name, or -1 */
+  int Find(const char* name) const
+  {
+    const uint32_t hash = Hash(name);
+
+    for (uint32_t slot = hash & (mHashTableSize - 1); ; slot = (slot + 1) & (mHashTableSize - 1))
+    {
+      const uint32_t entry = Read(mHashTableOffset + slot * sizeof(uint32_t));
+
+      if (!entry)
+        return -1;
+
+      const int idx = (int) entry - 1;
+
+      if (Entry(idx, 3) == hash && !strcmp(GetName(idx), name))
+        return idx;
+    }
+  }
+
+private:
+  static constexpr uint32_t kHeaderSize = 4 * sizeof(uint32_t);
+  static constexpr uint32_t kEntrySize = 4 * sizeof(uint32_t);
+
+  /** FNV-1a */
+  static uint32_t Hash(const char* str)
+  {
+    uint32_t hash = 2166136261u;
+
+    for (; *str; str++)
+      hash = (hash ^ (uint8_t) *str) * 16777619u;
+
+    return hash;
+  }
+
+  /** A power of two, with at least one empty slot per preset so that probing stays short and always ends */
+  static uint32_t HashTableSize(uint32_t nPresets)
+  {
+    uint32_t size = 1;
+
+    while (size < nPresets * 2 + 1)
+      size <<= 1;
+
+    return size;
+  }
+
+  IPresetBank(const uint8_t* pData, size_t size)
+  : mData(pData)
+  , mSize(size)
+  {
+    ReadHeader();
+  }
+
+  explicit IPresetBank(const char* path)
+  {
+#ifdef OS_WIN
+    wchar_t pathWide[MAX_WIN32_PATH_LEN];
+    MultiByteToWideChar(CP_UTF8, 0, path, -1, pathWide, MAX_WIN32_PATH_LEN);
+    HANDLE file = CreateFileW(pathWide, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+      return;
+
+    LARGE_INTEGER fileSize;
+
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+    {
+      HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+      if (mapping)
+      {
+        mMappedData = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping); // the view keeps the mapping alive
+      }
+    }
+
+    CloseHandle(file);
+
+    if (!mMappedData)
+      return;
+
+    mSize = (size_t) fileSize.QuadPart;
+#else
+    const int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+      return;
+
+    struct stat fileInfo;
+
+    if (fstat(fd, &fileInfo) == 0 && fileInfo.st_size > 0)
+    {
+      void* pMapped = mmap(nullptr, (size_t) fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      if (pMapped != MAP_FAILED)
+      {
+        mMappedData = pMapped;
+        mSize = (size_t) fileInfo.st_size;
+      }
+    }
+
+    close(fd); // the mapping stays valid
+
+    if (!mMappedData)
+      return;
+#endif
+
+    mData = static_cast<const uint8_t*>(mMappedData);
+    ReadHeader();
+  }
+
+  uint32_t Read(size_t offset) const
+  {
+    uint32_t value;
+    memcpy(&value, mData + offset, sizeof(value));
+    return value;
+  }
+
+  uint32_t Entry(int idx, int field) const { return Read(kHeaderSize + idx * kEntrySize + field * sizeof(uint32_t)); }
+
+  /** Checks the header and that every entry lies within the data, so that the accessors don't have to */
+  void ReadHeader()
+  {
+    if (!mData || mSize < kHeaderSize || Read(0) != kMagic || Read(sizeof(uint32_t)) != kVersion)
+      return;
+
+    const uint64_t nPresets = Read(2 * sizeof(uint32_t));
+    const uint64_t hashTableSize = Read(3 * sizeof(uint32_t));
+    const uint64_t hashTableOffset = kHeaderSize + nPresets * kEntrySize;
+
+    if (hashTableSize <= nPresets || (hashTableSize & (hashTableSize - 1)) || hashTableOffset + hashTableSize * sizeof(uint32_t) > mSize)
+      return;
+
+    for (uint64_t i = 0; i < nPresets; i++)
+    {
+      const uint64_t nameOffset = Entry((int) i, 0);
+      const uint64_t dataOffset = Entry((int) i, 1);
+      const uint64_t dataSize = Entry((int) i, 2);
+
+      if (nameOffset >= mSize || !memchr(mData + nameOffset, 0, mSize - nameOffset) || dataOffset + dataSize > mSize || dataSize > INT32_MAX)
+        return;
+    }
+
+    uint64_t nEmptySlots = 0;
+
+    for (uint64_t slot = 0; slot < hashTableSize; slot++)
+    {
+      const uint32_t entry = Read(hashTableOffset + slot * sizeof(uint32_t));
+
+      if (entry > nPresets)
+        return;
+
+      nEmptySlots += !entry;
+    }
+
+    // Find() stops probing at an empty slot
+    if (!nEmptySlots)
+      return;
+
+    mNPresets = (uint32_t) nPresets;
+    mHashTableSize = (uint32_t) hashTableSize;
+    mHashTableOffset = (uint32_t) hashTableOffset;
+    mValid = true;
+  }
+
+  bool IsValid() const { return mValid; }
+
+  const uint8_t* mData = nullptr;
+  size_t mSize = 0;
+  void* mMappedData = nullptr;
+  uint32_t mNPresets = 0;
+  uint32_t mHashTableSize = 1;
+  uint32_t mHashTableOffset = 0;
+  bool mValid = false;
+};
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,198 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPresetMorpher
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "wdltypes.h"
+#include "heapbuf.h"
+
+#include "IPlugAPIBase.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Morphs continuously between two or more snapshots of the plug-in's parameter values, from a single position, e.g. a macro parameter.
+ * Snapshots are interpolated in the normalized domain, so each parameter follows its own Shape, and stepped parameters (bool, enum and int) jump at the midpoint.
+ * Parameters that have the same value in every snapshot are left out when the snapshots are added, so a morph only costs as much as the parameters that move.
+ * OnParamChange() is only called for parameters whose value actually changed after stepping and constraining.
+ *
+ * Add the snapshots on the main thread, before processing starts, then call Morph() from the audio thread, e.g. once per block from ProcessBlock()
+ * @code
+ * // in the constructor, once the parameters have been initialized
+ * mMorpher.AddSnapshot(); // the current values
+ * RestorePreset(1);
+ * mMorpher.AddSnapshot();
+ * // in ProcessBlock()
+ * mMorpher.Morph(GetParam(kMorph)->Value() / 100.);
+ * @endcode */
+class IPresetMorpher
+{
+public:
+  /** @param plug The plug-in whose parameters are morphed
+   * @param excludeParamIdx A parameter that is never morphed, usually the one that controls the morph */
+  IPresetMorpher(IPlugAPIBase& plug, int excludeParamIdx = kNoParameter)
+  : mPlug(plug)
+  , mExcludeParamIdx(excludeParamIdx)
+  {
+  }
+
+  IPresetMorpher(const IPresetMorpher&) = delete;
+  IPresetMorpher& operator=(const IPresetMorpher&) = delete;
+
+  /** Add a snapshot of the current parameter values. Call this on the main thread, not while Morph() may be running */
+  void AddSnapshot()
+  {
+    const int nParams = mPlug.NParams();
+    mSnapshots.Resize((NSnapshots() + 1) * nParams);
+    double* pSnapshot = mSnapshots.Get() + NSnapshots() * nParams;
+
+    for (int i = 0; i < nParams; i++)
+      pSnapshot[i] = mPlug.GetParam(i)->GetNormalized();
+
+    mNSnapshots++;
+    UpdateMorphedParams();
+  }
+
+  /** Add a snapshot of the given values. Call this on the main thread, not while Morph() may be running
+   * @param pValues A non-normalized value for each parameter, e.g. as written by IPluginBase::SerializeParams() */
+  void AddSnapshot(const double* pValues)
+  {
+    const int nParams = mPlug.NParams();
+    mSnapshots.Resize((NSnapshots() + 1) * nParams);
+    double* pSnapshot = mSnapshots.Get() + NSnapshots() * nParams;
+
+    for (int i = 0; i < nParams; i++)
+      pSnapshot[i] = mPlug.GetParam(i)->ToNormalized(pValues[i]);
+
+    mNSnapshots++;
+    UpdateMorphedParams();
+  }
+
+  /** Remove all snapshots. Call this on the main thread, not while Morph() may be running */
+  void Clear()
+  {
+    mSnapshots.Resize(0);
+    mMorphedParams.Resize(0);
+    mChangedParams.Resize(0);
+    mNSnapshots = 0;
+    mLastPosition = -1.;
+  }
+
+  /** @return The number of snapshots */
+  int NSnapshots() const { return mNSnapshots; }
+
+  /** @return The number of parameters that differ between the snapshots, and are therefore morphed */
+  int NMorphedParams() const { return mMorphedParams.GetSize(); }
+
+  /** Set the parameters to a position between the snapshots. Realtime safe. The editor is updated, but the host isn't told about the changes,
+   * so hosts that save the parameter values will save the morphed values
+   * @param position 0. is the first snapshot and 1. the last, with the others evenly spaced in between
+   * @param sampleOffset Passed to OnParamChange() for the parameters that change
+   * @return The number of parameters whose value changed */
+  int Morph(double position, int sampleOffset = -1)
+  {
+    if (mNSnapshots < 2)
+      return 0;
+
+    position = Clip(position, 0., 1.);
+
+    if (position == mLastPosition)
+      return 0;
+
+    mLastPosition = position;
+
+    const int nParams = mPlug.NParams();
+    const double scaled = position * (mNSnapshots - 1);
+    const int segment = std::min(static_cast<int>(scaled), mNSnapshots - 2);
+    const double frac = scaled - segment;
+    const double* pFrom = mSnapshots.Get() + segment * nParams;
+    const double* pTo = pFrom + nParams;
+    const int* pMorphed = mMorphedParams.Get();
+    int nChanged = 0;
+
+    mPlug.BeginParamsWrite();
+
+    for (int m = 0; m < mMorphedParams.GetSize(); m++)
+    {
+      const int paramIdx = pMorphed[m];
+      IParam* pParam = mPlug.GetParam(paramIdx);
+      const double normalized = pFrom[paramIdx] + frac * (pTo[paramIdx] - pFrom[paramIdx]);
+      const double value = pParam->FromNormalized(normalized);
+
+      if (value != pParam->Value())
+      {
+        pParam->Set(value);
+        // reuse the list, so that OnParamChange() is called after all of the values are set
+        mChangedParams.Get()[nChanged++] = paramIdx;
+      }
+    }
+
+    mPlug.EndParamsWrite();
+
+    for (int c = 0; c < nChanged; c++)
+    {
+      const int paramIdx = mChangedParams.Get()[c];
+      mPlug.SendParameterValueFromAPI(paramIdx, mPlug.GetParam(paramIdx)->Value(), false);
+      mPlug.OnParamChange(paramIdx, kPresetRecall, sampleOffset);
+    }
+
+    return nChanged;
+  }
+
+  /** @return The size of the snapshots and parameter lists in bytes */
+  size_t GetMemoryUsage() const { return mSnapshots.GetSize() * sizeof(double) + (mMorphedParams.GetSize() + mChangedParams.GetSize()) * sizeof(int); }
+
+private:
+  /** Finds the parameters that differ between any two snapshots */
+  void UpdateMorphedParams()
+  {
+    const int nParams = mPlug.NParams();
+    const double* pSnapshots = mSnapshots.Get();
+    mMorphedParams.Resize(0);
+
+    for (int i = 0; i < nParams; i++)
+    {
+      if (i == mExcludeParamIdx)
+        continue;
+
+      for (int s = 1; s < mNSnapshots; s++)
+      {
+        if (pSnapshots[s * nParams + i] != pSnapshots[i])
+        {
+          mMorphedParams.Add(i);
+          break;
+        }
+      }
+    }
+
+    mChangedParams.Resize(mMorphedParams.GetSize());
+    mLastPosition = -1.;
+  }
+
+  IPlugAPIBase& mPlug;
+  int mExcludeParamIdx;
+  int mNSnapshots = 0;
+  double mLastPosition = -1.;
+  /** The normalized value of every parameter, for each snapshot in turn */
+  WDL_TypedBuf<double> mSnapshots;
+  /** The parameters that differ between the snapshots */
+  WDL_TypedBuf<int> mMorphedParams;
+  /** The parameters that changed in the last call to Morph(), sized so that Morph() doesn't allocate */
+  WDL_TypedBuf<int> mChangedParams;
+};
+
+END_IPLUG_NAMESPACE
@@ -14,13 +14,87 @@
  */
 
 #include "IPlugProcessor.h"
+#include "IPlugPluginBase.h"
 
 #ifdef OS_WIN
 #define strtok_r strtok_s
 #endif
 
+#if IPLUG_REALTIME_GUARD && defined IPLUG_DETECT_AUDIO_ALLOCATIONS
+  #if defined OS_WIN && defined _DEBUG
+    #include <crtdbg.h>
+  #elif !defined OS_WIN
+    #include <new>
+  #endif
+#endif
+
 using namespace iplug;
 
+// Opt in, since replacing the global allocation functions affects the whole host process
+#if IPLUG_REALTIME_GUARD && defined IPLUG_DETECT_AUDIO_ALLOCATIONS
+#if defined OS_WIN
+#if defined _DEBUG
+static _CRT_ALLOC_HOOK sPrevAllocHook = nullptr;
+
+// The debug CRT reports every malloc/realloc/free, which also covers operator new and WDL_TypedBuf::Resize()
+static int RealtimeGuardAllocHook(int allocType, void* pData, size_t size, int blockType, long requestNumber, const unsigned char* pFileName, int lineNumber)
+{
+  if (allocType == _HOOK_ALLOC)
+    REALTIME_CHECK("malloc");
+  else if (allocType == _HOOK_REALLOC)
+    REALTIME_CHECK("realloc");
+  else if (allocType == _HOOK_FREE)
+    REALTIME_CHECK("free");
+
+  // another module in the process, or the host, may have installed a hook first
+  return sPrevAllocHook ? sPrevAllocHook(allocType, pData, size, blockType, requestNumber, pFileName, lineNumber) : TRUE;
+}
+
+static const bool sAllocHookInstalled = (sPrevAllocHook = _CrtSetAllocHook(RealtimeGuardAllocHook), true);
+#endif
+#else
+// malloc can't be hooked portably on macOS and Linux, so only C++ allocations are reported
+void* operator new(std::size_t size)
+{
+  REALTIME_CHECK("operator new");
+
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+  REALTIME_CHECK("operator new[]");
+
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+  if (p)
+    REALTIME_CHECK("operator delete");
+
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+  if (p)
+    REALTIME_CHECK("operator delete[]");
+
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, std::size_t) noexcept { operator delete[](p); }
+#endif
+#endif
+
 IPlugProcessor::IPlugProcessor(const Config& config, EAPI plugAPI)
 : mLatency(config.latency)
 , mPlugType((EIPlugPluginType) config.plugType)
@@ -35,6 +109,10 @@ IPlugProcessor::IPlugProcessor(const Config& config, EAPI plugAPI)
 
   mScratchData[ERoute::kInput].Resize(totalNInChans);
   mScratchData[ERoute::kOutput].Resize(totalNOutChans);
+  mOffsetData[ERoute::kInput].Resize(totalNInChans);
+  mOffsetData[ERoute::kOutput].Resize(totalNOutChans);
+  mSubBlockData[ERoute::kInput].Resize(totalNInChans);
+  mSubBlockData[ERoute::kOutput].Resize(totalNOutChans);
 
   sample** ppInData = mScratchData[ERoute::kInput].Get();
 
@@ -56,6 +134,35 @@ IPlugProcessor::IPlugProcessor(const Config& config, EAPI plugAPI)
     pOutChannel->mIncomingData = nullptr;
     mChannelData[ERoute::kOutput].Add(pOutChannel);
   }
+
+  // the layout parsed at compile time is only used if it is the one parsed here
+  if (config.fixedIO && config.fixedIO->mNInputs == totalNInChans && config.fixedIO->mNOutputs == totalNOutChans)
+  {
+    mFixedIO = config.fixedIO;
+    mFixedIOData[ERoute::kInput].Resize(totalNInChans);
+    mFixedIOData[ERoute::kOutput].Resize(totalNOutChans);
+    mFixedOutputs.Resize(totalNOutChans);
+  }
+
+  for (auto direction : { ERoute::kInput, ERoute::kOutput })
+  {
+    const int nBuses = MaxNBuses(direction);
+    const int nChans = MaxNChannels(direction);
+    mBusBuffers[direction].Resize(nBuses);
+    mBusChannelStartIdx[direction].Resize(nBuses + 1);
+
+    // a wildcard bus takes all the channels
+    for (int bus = 0, startIdx = 0; bus <= nBuses; bus++)
+    {
+      mBusChannelStartIdx[direction].Get()[bus] = std::min(startIdx, nChans);
+
+      if (bus < nBuses)
+      {
+        const int busNChans = MaxNChannelsForBus(direction, bus);
+        startIdx += busNChans < 0 ? nChans : busNChans;
+      }
+    }
+  }
 }
 
 IPlugProcessor::~IPlugProcessor()
@@ -68,6 +175,62 @@ IPlugProcessor::~IPlugProcessor()
 }
 
 void IPlugProcessor::ProcessBlock(sample** inputs, sample** outputs, int nFrames)
+{
+  const IBusBuffers* pInputBuses = GetBusBuffers(ERoute::kInput, inputs);
+  const IBusBuffers* pOutputBuses = GetBusBuffers(ERoute::kOutput, outputs);
+  ProcessBusBlock(pInputBuses, mBusBuffers[ERoute::kInput].GetSize(), pOutputBuses, mBusBuffers[ERoute::kOutput].GetSize(), nFrames);
+}
+
+void IPlugProcessor::ProcessBusBlock(const IBusBuffers* inputs, int nInputBuses, const IBusBuffers* outputs, int nOutputBuses, int nFrames)
+{
+  for (auto outBus = 0; outBus < nOutputBuses; outBus++)
+  {
+    for (auto c = 0; c < outputs[outBus].mNChans; c++)
+    {
+      const int chIdx = GetBusChannelStartIdx(ERoute::kOutput, outBus) + c;
+      const sample* pInput = nullptr;
+
+      for (auto inBus = 0; inBus < nInputBuses && !pInput; inBus++)
+      {
+        const int inChIdx = chIdx - GetBusChannelStartIdx(ERoute::kInput, inBus);
+
+        if (inChIdx >= 0 && inChIdx < inputs[inBus].mNChans)
+          pInput = inputs[inBus].mChannels[inChIdx];
+      }
+
+      sample* pOutput = outputs[outBus].mChannels[c];
+
+      if (!pInput)
+        memset(pOutput, 0, nFrames * sizeof(sample));
+      else if (pOutput != pInput) // in place
+        memcpy(pOutput, pInput, nFrames * sizeof(sample));
+    }
+  }
+}
+
+const IBusBuffers* IPlugProcessor::GetBusBuffers(ERoute direction, sample** ppData)
+{
+  const int nBuses = mBusBuffers[direction].GetSize();
+  const int nChans = MaxNChannels(direction);
+  IBusBuffers* pBuses = mBusBuffers[direction].Get();
+
+  for (auto bus = 0; bus < nBuses; bus++)
+  {
+    const int startIdx = GetBusChannelStartIdx(direction, bus);
+    const int endIdx = std::min(GetBusChannelStartIdx(direction, bus + 1), nChans);
+    int nConnected = 0;
+
+    while (startIdx + nConnected < endIdx && IsChannelConnected(direction, startIdx + nConnected))
+      nConnected++;
+
+    pBuses[bus].mChannels = nConnected ? ppData + startIdx : nullptr;
+    pBuses[bus].mNChans = nConnected;
+  }
+
+  return pBuses;
+}
+
+void IPlugProcessor::PassThroughBlock(sample** inputs, sample** outputs, int nFrames)
 {
   int i, nIn = mChannelData[ERoute::kInput].GetSize(), nOut = mChannelData[ERoute::kOutput].GetSize();
   int j = 0;
@@ -75,7 +238,8 @@ void IPlugProcessor::ProcessBlock(sample** inputs, sample** outputs, int nFrames
   {
     if (i < nIn)
     {
-      memcpy(outputs[i], inputs[i], nFrames * sizeof(sample));
+      if (outputs[i] != inputs[i]) // in place
+        memcpy(outputs[i], inputs[i], nFrames * sizeof(sample));
       j++;
     }
   }
@@ -91,6 +255,15 @@ void IPlugProcessor::ProcessMidiMsg(const IMidiMsg& msg)
   SendMidiMsg(msg);
 }
 
+void IPlugProcessor::ReceiveMidiMsg(const IMidiMsg& msg)
+{
+  // with a fixed block size the message reaches ProcessMidiMsg() from the block events, see ProcessFixedBlocks()
+  if (!mFixedBlockSize)
+    ProcessMidiMsg(msg);
+
+  mBlockEvents.AddMidi(msg);
+}
+
 bool IPlugProcessor::SendMidiMsgs(WDL_TypedBuf<IMidiMsg>& msgs)
 {
   bool rc = true;
@@ -134,6 +307,7 @@ int IPlugProcessor::MaxNChannelsForBus(ERoute direction, int busIdx) const
   const int maxNBuses = MaxNBuses(direction);
   WDL_TypedBuf<int> maxChansOnBuses;
   maxChansOnBuses.Resize(maxNBuses);
+  std::fill(maxChansOnBuses.Get(), maxChansOnBuses.Get() + maxNBuses, 0);
 
   //find the maximum channel count for each input or output bus
   for (auto configIdx = 0; configIdx < NIOConfigs(); configIdx++)
@@ -194,7 +368,86 @@ void IPlugProcessor::SetLatency(int samples)
   mLatency = samples;
 
   if (mLatencyDelay)
-    mLatencyDelay->SetDelayTime(mLatency);
+    mLatencyDelay->SetDelayTime(GetLatency());
+}
+
+void IPlugProcessor::SetRenderingOffline(bool renderingOffline)
+{
+  if (renderingOffline == mRenderingOffline)
+    return;
+
+  mRenderingOffline = renderingOffline;
+
+  const int fixedBlockSize = mFixedBlockSize;
+  OnRenderingOfflineChanged(renderingOffline);
+
+  // the fixed block size is part of the latency, but setting it doesn't tell the host
+  if (mFixedBlockSize != fixedBlockSize)
+    SetLatency(mLatency);
+}
+
+void IPlugProcessor::SetFixedBlockSize(int blockSize)
+{
+  const int nIn = mScratchData[ERoute::kInput].GetSize();
+  const int nOut = mScratchData[ERoute::kOutput].GetSize();
+
+  mFixedBlockSize = std::max(blockSize, 0);
+  mFixedBlockBuffer.Resize((nIn + nOut) * mFixedBlockSize);
+  mFixedBlockData[ERoute::kInput].Resize(nIn);
+  mFixedBlockData[ERoute::kOutput].Resize(nOut);
+
+  sample* pData = mFixedBlockBuffer.Get();
+
+  for (auto i = 0; i < nIn; i++, pData += mFixedBlockSize)
+    mFixedBlockData[ERoute::kInput].Get()[i] = pData;
+
+  for (auto i = 0; i < nOut; i++, pData += mFixedBlockSize)
+    mFixedBlockData[ERoute::kOutput].Get()[i] = pData;
+
+  ClearFixedBlockBuffers();
+
+  if (mLatencyDelay)
+    mLatencyDelay->SetDelayTime(GetLatency());
+
+  mScratchArena.Reserve(static_cast<size_t>(GetMaxProcessBlockFrames()) * SCRATCH_ARENA_BYTES_PER_FRAME);
+  ResetParamSmoothing();
+}
+
+void IPlugProcessor::ClearFixedBlockBuffers()
+{
+  if (mFixedBlockBuffer.GetSize())
+    memset(mFixedBlockBuffer.Get(), 0, mFixedBlockBuffer.GetSize() * sizeof(sample));
+
+  mFixedBlockFill = 0;
+  mFixedBlockEvents.Clear();
+  mFixedPendingEvents.Clear();
+}
+
+void IPlugProcessor::GetProcessorMemoryReport(IMemoryReport& report) const
+{
+  size_t channelBytes = 0;
+
+  for (int d = 0; d < 2; d++)
+  {
+    channelBytes += (mScratchData[d].GetSize() + mOffsetData[d].GetSize() + mSubBlockData[d].GetSize()) * sizeof(sample*);
+
+    for (int i = 0; i < mChannelData[d].GetSize(); i++)
+    {
+      const IChannelData<>* pChannel = mChannelData[d].Get(i);
+      channelBytes += sizeof(IChannelData<>) + pChannel->mScratchBuf.GetSize() * sizeof(*pChannel->mScratchBuf.Get()) + pChannel->mLabel.GetLength();
+    }
+  }
+
+  report.Add("Channel buffers", channelBytes);
+  report.Add("Scratch arena", mScratchArena.GetCapacity());
+  report.Add("Block events", mBlockEvents.GetMemoryUsage() + mFixedBlockEvents.GetMemoryUsage() + mFixedPendingEvents.GetMemoryUsage());
+
+  if (mFixedBlockSize)
+    report.Add("Fixed block buffers", mFixedBlockBuffer.GetSize() * sizeof(sample) + (mFixedBlockData[0].GetSize() + mFixedBlockData[1].GetSize()) * sizeof(sample*));
+  report.Add("Smoothed parameters", mSmoothedParams.capacity() * sizeof(SmoothedParam) + mSmoothedValues.GetSize() * sizeof(sample) + mSmoothedParamIdx.GetSize() * sizeof(int));
+
+  if (mLatencyDelay)
+    report.Add("Bypass latency delay", mLatencyDelay->GetMemoryUsage());
 }
 
 //static
@@ -336,6 +589,29 @@ void IPlugProcessor::SetChannelConnections(ERoute direction, int idx, int n, boo
     if (!connected)
       *(pChannel->mData) = pChannel->mScratchBuf.Get();
   }
+
+  UpdateFixedIO();
+}
+
+void IPlugProcessor::UpdateFixedIO()
+{
+  mFixedIOConnected = mFixedIO && NChannelsConnected(ERoute::kInput) == mFixedIO->mNInputs && NChannelsConnected(ERoute::kOutput) == mFixedIO->mNOutputs;
+  mFixedOutputsAttached = false;
+
+  if (!mFixedIOConnected)
+    return;
+
+  for (auto i = 0; i < mFixedIO->mNInputs; ++i)
+    mFixedIOData[ERoute::kInput].Get()[i] = mChannelData[ERoute::kInput].Get(i)->mScratchBuf.Get();
+
+  for (auto i = 0; i < mFixedIO->mNOutputs; ++i)
+  {
+    // the same choice as AttachBuffers() makes for each channel
+    if (mInPlaceSafe && i < mFixedIO->mNInputs)
+      mFixedIOData[ERoute::kOutput].Get()[i] = mFixedIOData[ERoute::kInput].Get()[i];
+    else
+      mFixedIOData[ERoute::kOutput].Get()[i] = mChannelData[ERoute::kOutput].Get(i)->mScratchBuf.Get();
+  }
 }
 
 void IPlugProcessor::AttachBuffers(ERoute direction, int idx, int n, PLUG_SAMPLE_DST** ppData, int)
@@ -355,6 +631,26 @@ void IPlugProcessor::AttachBuffers(ERoute direction, int idx, int n, PLUG_SAMPLE
 
 void IPlugProcessor::AttachBuffers(ERoute direction, int idx, int n, PLUG_SAMPLE_SRC** ppData, int nFrames)
 {
+  // all the channels of a fixed layout at once are converted by the routines specialized for it, without visiting each channel
+  if (mFixedIOConnected && idx == 0 && n == mFixedIOData[direction].GetSize())
+  {
+    sample** ppFixedData = mFixedIOData[direction].Get();
+
+    if (direction == ERoute::kInput)
+      mFixedIO->mConvertInputs(ppData, ppFixedData, nFrames);
+    else
+    {
+      memcpy(mFixedOutputs.Get(), ppData, n * sizeof(PLUG_SAMPLE_SRC*));
+      mFixedOutputsAttached = true;
+    }
+
+    memcpy(mScratchData[direction].Get(), ppFixedData, n * sizeof(sample*));
+    return;
+  }
+
+  if (direction == ERoute::kOutput)
+    mFixedOutputsAttached = false;
+
   WDL_PtrList<IChannelData<>>& channelData = mChannelData[direction];
 
   const auto endIdx = std::min(idx + n, channelData.GetSize());
@@ -373,7 +669,14 @@ void IPlugProcessor::AttachBuffers(ERoute direction, int idx, int n, PLUG_SAMPLE
       }
       else // output
       {
-        *(pChannel->mData) = pChannel->mScratchBuf.Get();
+        IChannelData<>* pInChannel = mInPlaceSafe ? mChannelData[ERoute::kInput].Get(i) : nullptr;
+
+        // process in the input's converted buffer, rather than converting out of a second one
+        if (pInChannel && pInChannel->mConnected)
+          *(pChannel->mData) = *(pInChannel->mData);
+        else
+          *(pChannel->mData) = pChannel->mScratchBuf.Get();
+
         pChannel->mIncomingData = *(ppData++);
       }
     }
@@ -382,10 +685,24 @@ void IPlugProcessor::AttachBuffers(ERoute direction, int idx, int n, PLUG_SAMPLE
 
 void IPlugProcessor::PassThroughBuffers(PLUG_SAMPLE_DST type, int nFrames)
 {
-  if (mLatency && mLatencyDelay)
+  mBlockEventsFrames = std::max(mBlockEventsFrames, nFrames);
+
+  // MIDI held back for a fixed size block is delivered straight away, so that note-offs aren't lost while bypassed
+  if (mFixedBlockSize)
+  {
+    for (auto i = mFixedEventsTaken; i < mBlockEvents.Size(); i++)
+    {
+      if (mBlockEvents.Get(i).mType == IBlockEvent::kMidi)
+        ProcessMidiMsg(mBlockEvents.Get(i).mMidi);
+    }
+
+    mFixedEventsTaken = mBlockEvents.Size();
+  }
+
+  if (GetLatency() && mLatencyDelay)
     mLatencyDelay->ProcessBlock(mScratchData[ERoute::kInput].Get(), mScratchData[ERoute::kOutput].Get(), nFrames);
   else
-    IPlugProcessor::ProcessBlock(mScratchData[ERoute::kInput].Get(), mScratchData[ERoute::kOutput].Get(), nFrames);
+    PassThroughBlock(mScratchData[ERoute::kInput].Get(), mScratchData[ERoute::kOutput].Get(), nFrames);
 }
 
 void IPlugProcessor::PassThroughBuffers(PLUG_SAMPLE_SRC type, int nFrames)
@@ -401,19 +718,279 @@ void IPlugProcessor::PassThroughBuffers(PLUG_SAMPLE_SRC type, int nFrames)
     IChannelData<>* pOutChannel = *ppOutChannel;
     if (pOutChannel->mConnected)
     {
-      CastCopy(pOutChannel->mIncomingData, *(pOutChannel->mData), nFrames);
+      CastCopy(GetOutgoingData(i), *(pOutChannel->mData), nFrames);
+    }
+  }
+}
+
+sample** IPlugProcessor::GetBuffersAtOffset(ERoute direction, int startIdx)
+{
+  if (startIdx == 0)
+    return mScratchData[direction].Get();
+
+  const int n = mScratchData[direction].GetSize();
+  sample** ppData = mScratchData[direction].Get();
+  sample** ppOffsetData = mOffsetData[direction].Get();
+
+  for (auto i = 0; i < n; ++i)
+    ppOffsetData[i] = ppData[i] + startIdx;
+
+  return ppOffsetData;
+}
+
+sample** IPlugProcessor::OffsetSubBlockBuffers(ERoute direction, sample** ppData, int startIdx)
+{
+  if (startIdx == 0)
+    return ppData;
+
+  const int n = mSubBlockData[direction].GetSize();
+  sample** ppOffsetData = mSubBlockData[direction].Get();
+
+  for (auto i = 0; i < n; ++i)
+    ppOffsetData[i] = ppData[i] ? ppData[i] + startIdx : nullptr;
+
+  return ppOffsetData;
+}
+
+void IPlugProcessor::SetTimeInfo(const ITimeInfo& timeInfo)
+{
+  // a change of play state, tempo, meter or looping, or a jump in position, is recorded as a transport event
+  const ITimeInfo& last = mLastTimeInfo;
+  const bool jumped = timeInfo.mTransportIsRunning && timeInfo.mSamplePos >= 0. && std::fabs(timeInfo.mSamplePos - (last.mSamplePos + mBlockEventsFrames)) >= 1.;
+
+  if (!mHasLastTimeInfo || jumped
+      || timeInfo.mTransportIsRunning != last.mTransportIsRunning || timeInfo.mTempo != last.mTempo
+      || timeInfo.mNumerator != last.mNumerator || timeInfo.mDenominator != last.mDenominator
+      || timeInfo.mTransportLoopEnabled != last.mTransportLoopEnabled)
+  {
+    mBlockEvents.AddTransport();
+  }
+
+  mTimeInfo = timeInfo;
+  mLastTimeInfo = timeInfo;
+  mHasLastTimeInfo = true;
+  mBlockEventsFrames = 0;
+}
+
+void IPlugProcessor::ProcessBlockMeasured(sample** inputs, sample** outputs, int nFrames)
+{
+  TRACE_SCOPE_VALUE("audio", "ProcessBlock", nFrames);
+  REALTIME_SCOPE;
+
+  if (mPlug)
+    mPlug->EvaluateParamDependencies();
+
+  if (!mMeasureDSPLoad.load(std::memory_order_relaxed))
+  {
+    ProcessBlock(inputs, outputs, nFrames);
+    return;
+  }
+
+  const auto startTime = std::chrono::steady_clock::now();
+  ProcessBlock(inputs, outputs, nFrames);
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+  mDSPLoadMeter.AddBlock(elapsed.count(), nFrames / GetSampleRate());
+}
+
+void IPlugProcessor::ClearBlockEvents()
+{
+  mBlockEvents.Clear();
+  mBlockEventsStart = 0;
+  mFixedEventsTaken = 0;
+  mInputSilenceFlags = 0;
+}
+
+void IPlugProcessor::ProcessAttachedBuffers(int nFrames, int startIdx)
+{
+  mBlockEventsFrames = std::max(mBlockEventsFrames, startIdx + nFrames);
+
+  if (mFixedBlockSize)
+  {
+    ProcessFixedBlocks(nFrames, startIdx);
+    return;
+  }
+
+  mScratchArena.Reset();
+  mProcessBlockCount++;
+  mProcessBlockFrames = nFrames;
+  mBlockEventsStart = startIdx;
+  mProcessBlockOutputSilence = 0;
+  ProcessBlockMeasured(GetBuffersAtOffset(ERoute::kInput, startIdx), GetBuffersAtOffset(ERoute::kOutput, startIdx), nFrames);
+  UpdateOutputSilenceFlags(startIdx);
+}
+
+void IPlugProcessor::ProcessFixedBlocks(int nFrames, int startIdx)
+{
+  const int blockSize = mFixedBlockSize;
+  const int nIn = mFixedBlockData[ERoute::kInput].GetSize();
+  const int nOut = mFixedBlockData[ERoute::kOutput].GetSize();
+  sample** ppFixedIn = mFixedBlockData[ERoute::kInput].Get();
+  sample** ppFixedOut = mFixedBlockData[ERoute::kOutput].Get();
+  sample** ppIn = GetBuffersAtOffset(ERoute::kInput, startIdx);
+  sample** ppOut = GetBuffersAtOffset(ERoute::kOutput, startIdx);
+
+  // move this sub-block's events onto the internal clock, relative to the start of the block being filled
+  for (; mFixedEventsTaken < mBlockEvents.Size() && mBlockEvents.Get(mFixedEventsTaken).mOffset < startIdx + nFrames; mFixedEventsTaken++)
+  {
+    IBlockEvent event = mBlockEvents.Get(mFixedEventsTaken);
+    event.mOffset = mFixedBlockFill + std::max(event.mOffset - startIdx, 0);
+    mFixedPendingEvents.Add(event);
+  }
+
+  int pos = 0;
+
+  while (pos < nFrames)
+  {
+    const int n = std::min(blockSize - mFixedBlockFill, nFrames - pos);
+
+    // inputs first, since the host may process in place
+    for (auto c = 0; c < nIn; c++)
+      memcpy(ppFixedIn[c] + mFixedBlockFill, ppIn[c] + pos, n * sizeof(sample));
+
+    for (auto c = 0; c < nOut; c++)
+      memcpy(ppOut[c] + pos, ppFixedOut[c] + mFixedBlockFill, n * sizeof(sample));
+
+    mFixedBlockFill += n;
+    pos += n;
+
+    if (mFixedBlockFill < blockSize)
+      break;
+
+    mFixedBlockEvents.Clear();
+    mFixedPendingEvents.SplitAt(blockSize, mFixedBlockEvents);
+
+    for (auto i = 0; i < mFixedBlockEvents.Size(); i++)
+    {
+      const IBlockEvent& event = mFixedBlockEvents.Get(i);
+
+      if (event.mType == IBlockEvent::kMidi)
+      {
+        IMidiMsg msg = event.mMidi;
+        msg.mOffset = event.mOffset;
+        ProcessMidiMsg(msg);
+      }
+    }
+
+    // the block started blockSize frames before the current position in the host's block
+    const ITimeInfo hostTimeInfo = mTimeInfo;
+    const int blockStart = startIdx + pos - blockSize;
+    const double samplesPerBeat = GetSamplesPerBeat();
+
+    if (hostTimeInfo.mSamplePos >= 0.)
+      mTimeInfo.mSamplePos = std::max(hostTimeInfo.mSamplePos + blockStart, 0.);
+
+    if (hostTimeInfo.mPPQPos >= 0. && samplesPerBeat > 0.)
+      mTimeInfo.mPPQPos = std::max(hostTimeInfo.mPPQPos + (blockStart / samplesPerBeat), 0.);
+
+    mScratchArena.Reset();
+    mProcessBlockCount++;
+    mProcessBlockFrames = blockSize;
+    mBlockEventsStart = 0;
+    mProcessBlockOutputSilence = 0;
+    ProcessBlockMeasured(ppFixedIn, ppFixedOut, blockSize);
+    mTimeInfo = hostTimeInfo;
+    mFixedBlockFill = 0;
+  }
+
+  // the host's block holds audio from more than one ProcessBlock() call, so no output is reported as silent
+  mOutputSilenceFlags = 0;
+}
+
+void IPlugProcessor::ProcessBuffers(PLUG_SAMPLE_DST type, int nFrames, int startIdx)
+{
+  ProcessAttachedBuffers(nFrames, startIdx);
+}
+
+void IPlugProcessor::ProcessBuffers(PLUG_SAMPLE_SRC type, int nFrames, int startIdx)
+{
+  ProcessAttachedBuffers(nFrames, startIdx);
+
+  if (mFixedOutputsAttached)
+  {
+    mFixedIO->mConvertOutputs(mScratchData[ERoute::kOutput].Get(), mFixedOutputs.Get(), startIdx, nFrames);
+    return;
+  }
+
+  int i, n = MaxNChannels(ERoute::kOutput);
+  IChannelData<>** ppOutChannel = mChannelData[ERoute::kOutput].GetList();
+
+  for (i = 0; i < n; ++i, ++ppOutChannel)
+  {
+    IChannelData<>* pOutChannel = *ppOutChannel;
+
+    if (pOutChannel->mConnected)
+    {
+      CastCopy(pOutChannel->mIncomingData + startIdx, *(pOutChannel->mData) + startIdx, nFrames);
     }
   }
 }
 
-void IPlugProcessor::ProcessBuffers(PLUG_SAMPLE_DST type, int nFrames)
+void IPlugProcessor::UpdateOutputSilenceFlags(int startIdx)
 {
-  ProcessBlock(mScratchData[ERoute::kInput].Get(), mScratchData[ERoute::kOutput].Get(), nFrames);
+  // a channel is only silent for the host block if it was silent in every sub-block
+  if (startIdx == 0)
+    mOutputSilenceFlags = mProcessBlockOutputSilence;
+  else
+    mOutputSilenceFlags &= mProcessBlockOutputSilence;
 }
 
-void IPlugProcessor::ProcessBuffers(PLUG_SAMPLE_SRC type, int nFrames)
+bool IPlugProcessor::UpdateSilentInputFrames(int nFrames)
 {
-  ProcessBlock(mScratchData[ERoute::kInput].Get(), mScratchData[ERoute::kOutput].Get(), nFrames);
+  const bool wake = mWakeFromSilence.exchange(false, std::memory_order_relaxed);
+
+  if (!mSilenceSkipping)
+  {
+    mSilentInputFrames = 0;
+    return false;
+  }
+
+  bool inputSilent = !wake && NChannelsConnected(ERoute::kInput) > 0;
+
+  for (auto i = 0; inputSilent && i < mBlockEvents.Size(); i++)
+  {
+    const auto type = mBlockEvents.Get(i).mType;
+
+    if (type == IBlockEvent::kMidi || type == IBlockEvent::kParamChange)
+      inputSilent = false;
+  }
+
+  // channels the host didn't flag are scanned, stopping at the first one that isn't silent
+  for (auto i = 0; inputSilent && i < MaxNChannels(ERoute::kInput); i++)
+  {
+    IChannelData<>* pInChannel = mChannelData[ERoute::kInput].Get(i);
+
+    if (!pInChannel->mConnected || IsInputChannelSilent(i))
+      continue;
+
+    if (!IPeakRMS::IsBelowThreshold(*(pInChannel->mData), nFrames, mSilenceThreshold))
+      inputSilent = false;
+    else if (i < 64)
+      mInputSilenceFlags |= (uint64_t(1) << i);
+  }
+
+  if (!inputSilent)
+  {
+    mSilentInputFrames = 0;
+    return false;
+  }
+
+  // a negative tail size is infinite
+  const bool skip = mTailSize >= 0 && mSilentInputFrames >= mTailSize + GetLatency();
+
+  if (!skip)
+    mSilentInputFrames += nFrames;
+
+  return skip;
+}
+
+bool IPlugProcessor::SkipSilentBuffers(PLUG_SAMPLE_DST type, int nFrames)
+{
+  if (!UpdateSilentInputFrames(nFrames))
+    return false;
+
+  mBlockEventsFrames = std::max(mBlockEventsFrames, nFrames);
+  mOutputSilenceFlags = 0;
+
   int i, n = MaxNChannels(ERoute::kOutput);
   IChannelData<>** ppOutChannel = mChannelData[ERoute::kOutput].GetList();
 
@@ -423,14 +1000,41 @@ void IPlugProcessor::ProcessBuffers(PLUG_SAMPLE_SRC type, int nFrames)
 
     if (pOutChannel->mConnected)
     {
-      CastCopy(pOutChannel->mIncomingData, *(pOutChannel->mData), nFrames);
+      memset(*(pOutChannel->mData), 0, nFrames * sizeof(PLUG_SAMPLE_DST));
+
+      if (i < 64)
+        mOutputSilenceFlags |= (uint64_t(1) << i);
     }
   }
+
+  return true;
+}
+
+bool IPlugProcessor::SkipSilentBuffers(PLUG_SAMPLE_SRC type, int nFrames)
+{
+  if (!SkipSilentBuffers(PLUG_SAMPLE_DST(0.), nFrames))
+    return false;
+
+  int i, n = MaxNChannels(ERoute::kOutput);
+  IChannelData<>** ppOutChannel = mChannelData[ERoute::kOutput].GetList();
+
+  for (i = 0; i < n; ++i, ++ppOutChannel)
+  {
+    IChannelData<>* pOutChannel = *ppOutChannel;
+
+    if (pOutChannel->mConnected)
+      memset(GetOutgoingData(i), 0, nFrames * sizeof(PLUG_SAMPLE_SRC));
+  }
+
+  return true;
 }
 
 void IPlugProcessor::ProcessBuffersAccumulating(int nFrames)
 {
-  ProcessBlock(mScratchData[ERoute::kInput].Get(), mScratchData[ERoute::kOutput].Get(), nFrames);
+  mScratchArena.Reset();
+  mBlockEventsStart = 0;
+  mBlockEventsFrames = std::max(mBlockEventsFrames, nFrames);
+  ProcessBlockMeasured(mScratchData[ERoute::kInput].Get(), mScratchData[ERoute::kOutput].Get(), nFrames);
   int i, n = MaxNChannels(ERoute::kOutput);
   IChannelData<>** ppOutChannel = mChannelData[ERoute::kOutput].GetList();
 
@@ -439,7 +1043,7 @@ void IPlugProcessor::ProcessBuffersAccumulating(int nFrames)
     IChannelData<>* pOutChannel = *ppOutChannel;
     if (pOutChannel->mConnected)
     {
-      PLUG_SAMPLE_SRC* pDest = pOutChannel->mIncomingData;
+      PLUG_SAMPLE_SRC* pDest = GetOutgoingData(i);
       PLUG_SAMPLE_DST* pSrc = *(pOutChannel->mData); // TODO : check this: PLUG_SAMPLE_DST will allways be float, because this is only for VST2 accumulating
       for (int j = 0; j < nFrames; ++j, ++pDest, ++pSrc)
       {
@@ -487,5 +1091,90 @@ void IPlugProcessor::SetBlockSize(int blockSize)
     }
 
     mBlockSize = blockSize;
+    UpdateFixedIO();
+  }
+
+  mScratchArena.Reserve(static_cast<size_t>(GetMaxProcessBlockFrames()) * SCRATCH_ARENA_BYTES_PER_FRAME);
+  ClearFixedBlockBuffers();
+  ResetParamSmoothing();
+}
+
+void IPlugProcessor::SetSampleRate(double sampleRate)
+{
+  mSampleRate = sampleRate;
+  ClearFixedBlockBuffers();
+  ResetParamSmoothing();
+}
+
+void IPlugProcessor::ResetParamSmoothing()
+{
+  // the parameters belong to the API class, which is also an IPluginBase
+  IPluginBase* pPlug = dynamic_cast<IPluginBase*>(this);
+  mPlug = pPlug;
+
+  mSmoothedParams.clear();
+  mSmoothedParamIdx.Resize(0);
+
+  if (!pPlug)
+    return;
+
+  const int nParams = pPlug->NParams();
+  mSmoothedParamIdx.Resize(nParams);
+
+  for (int i = 0; i < nParams; i++)
+  {
+    const IParam* pParam = pPlug->GetParam(i);
+
+    if (pParam->GetSmoothingTime() > 0.)
+    {
+      mSmoothedParamIdx.Get()[i] = static_cast<int>(mSmoothedParams.size());
+      const sample value = static_cast<sample>(pParam->Value());
+      SmoothedParam smoothed { pParam, LogParamSmooth<sample>(pParam->GetSmoothingTime(), value), mProcessBlockCount, ISmoothedBlock() };
+      smoothed.mSmoother.SetSmoothTime(pParam->GetSmoothingTime(), mSampleRate);
+      smoothed.mBlock.mValue = value;
+      mSmoothedParams.push_back(smoothed);
+    }
+    else
+      mSmoothedParamIdx.Get()[i] = -1;
   }
+
+  mSmoothedValues.Resize(static_cast<int>(mSmoothedParams.size()) * std::max(GetMaxProcessBlockFrames(), 1));
+}
+
+ISmoothedBlock IPlugProcessor::GetSmoothedBlock(int paramIdx)
+{
+  const int smoothedIdx = (paramIdx >= 0 && paramIdx < mSmoothedParamIdx.GetSize()) ? mSmoothedParamIdx.Get()[paramIdx] : -1;
+
+  if (smoothedIdx < 0)
+  {
+    assert(false && "Parameter isn't smoothed, call IParam::SetSmoothing() in the constructor");
+    return ISmoothedBlock();
+  }
+
+  SmoothedParam& smoothed = mSmoothedParams[smoothedIdx];
+
+  if (smoothed.mBlockCount != mProcessBlockCount)
+  {
+    sample target = static_cast<sample>(smoothed.mParam->Value());
+    smoothed.mBlockCount = mProcessBlockCount;
+
+    // a block longer than the one announced by the host can't be buffered, so it jumps to the target
+    if (mProcessBlockFrames > GetMaxProcessBlockFrames())
+      smoothed.mSmoother.SetValue(target);
+
+    if (smoothed.mSmoother.IsSettled(&target))
+    {
+      smoothed.mBlock.mValues = nullptr;
+      smoothed.mBlock.mValue = target;
+    }
+    else
+    {
+      sample* pValues = mSmoothedValues.Get() + smoothedIdx * GetMaxProcessBlockFrames();
+      smoothed.mSmoother.ProcessBlock(&target, &pValues, mProcessBlockFrames);
+      smoothed.mBlock.mValues = pValues;
+      smoothed.mBlock.mValue = target;
+    }
+  }
+
+  return smoothed.mBlock;
 }
@@ -10,6 +10,9 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstring>
 #include <cstdint>
 #include <ctime>
@@ -17,6 +20,7 @@
 #include <cstdio>
 #include <cassert>
 #include <memory>
+#include <vector>
 
 #include "ptrlist.h"
 
@@ -24,7 +28,16 @@
 #include "IPlugConstants.h"
 #include "IPlugStructs.h"
 #include "IPlugUtilities.h"
+#include "IPlugFixedIO.h"
 #include "NChanDelay.h"
+#include "IPlugScratchArena.h"
+#include "IPlugBlockEvents.h"
+#include "IPlugDSPLoad.h"
+#include "IPlugRealtimeGuard.h"
+#include "IPlugDenormals.h"
+#include "IPlugMemoryReport.h"
+#include "IPlugPeakRMS.h"
+#include "Smoothers.h"
 
 /**
  * @file
@@ -34,6 +47,8 @@
 BEGIN_IPLUG_NAMESPACE
 
 struct Config;
+class IParam;
+class IPluginBase;
 
 /** The base class for IPlug Audio Processing. It knows nothing about presets or parameters or user interface.  */
 class IPlugProcessor
@@ -60,6 +75,18 @@ public:
    * @param nFrames The block size for this block: number of samples per channel.*/
   virtual void ProcessBlock(sample** inputs, sample** outputs, int nFrames);
 
+  /** Override this instead of ProcessBlock() to process the audio bus by bus, e.g. to find a sidechain without mapping channel indices through the IOConfigs.
+   * The channels of each bus are the ones ProcessBlock() would get, see GetBusChannelStartIdx(), but a bus the host hasn't connected has no channels,
+   * so a plug-in can skip its work, e.g. take a cheaper path without a sidechain, rather than process zeros. Only called if ProcessBlock() isn't overridden.
+   * The default passes each input channel through to the output channel with the same index.
+   * THIS METHOD IS CALLED BY THE HIGH PRIORITY AUDIO THREAD - You should be careful not to do any unbounded, blocking operations such as file I/O which could cause audio dropouts
+   * @param inputs The input buses, MaxNBuses(ERoute::kInput) of them
+   * @param nInputBuses The number of input buses
+   * @param outputs The output buses, MaxNBuses(ERoute::kOutput) of them. Disconnected buses needn't be written
+   * @param nOutputBuses The number of output buses
+   * @param nFrames The block size for this block: number of samples per channel */
+  virtual void ProcessBusBlock(const IBusBuffers* inputs, int nInputBuses, const IBusBuffers* outputs, int nOutputBuses, int nFrames);
+
   /** Override this method to handle incoming MIDI messages. The method is called prior to ProcessBlock().
    * You can use IMidiQueue in combination with this method in order to queue the message and process at the appropriate time in ProcessBlock()
    * THIS METHOD IS CALLED BY THE HIGH PRIORITY AUDIO THREAD - You should be careful not to do any unbounded, blocking operations such as file I/O which could cause audio dropouts
@@ -79,6 +106,14 @@ public:
    * @param active \c true if the host has activated the plug-in */
   virtual void OnActivate(bool active) { TRACE; }
 
+  /** Override this method to switch to a configuration that is too expensive for real time when the host renders offline, e.g. a bounce,
+   * and back when it returns to real time: higher oversampling, longer FFTs, a larger SetFixedBlockSize(), or a Convolver without workers.
+   * Called before OnReset() when the host sets the mode while preparing to process. Some hosts only report the mode while processing (VST2),
+   * in which case this is called on the audio thread before the first block rendered in the new mode.
+   * If the new configuration changes the latency, call SetLatency(). A change of SetFixedBlockSize() is reported to the host for you
+   * @param renderingOffline \c true if the host is now rendering offline */
+  virtual void OnRenderingOfflineChanged(bool renderingOffline) { TRACE; }
+
 #pragma mark - Methods you can call - some of which have custom implementations in the API classes, some implemented in IPlugProcessor.cpp
 
   /** Send a single MIDI message // TODO: info about what thread should this be called on or not called on!
@@ -102,8 +137,142 @@ public:
   /** @return Current block size in samples */
   int GetBlockSize() const { return mBlockSize; }
 
-  /** @return Plugin latency (in samples) */
-  int GetLatency() const { return mLatency; }
+  /** Scratch memory for ProcessBlock(), which can be allocated from without calling the heap. It is reset before each call to ProcessBlock(),
+   * and holds SCRATCH_ARENA_BYTES_PER_FRAME bytes for each sample of the block size, unless you ask for more with ReserveScratchMemory()
+   * @return The arena, only use it on the audio thread */
+  IScratchArena& GetScratchArena() { return mScratchArena; }
+
+  /** Call this from ProcessBlock() to get the smoothed values of a parameter that was set up with IParam::SetSmoothing(). The parameter's value is read once
+   * per ProcessBlock() call, so with sample accurate automation (see SetSampleAccurateAutomation() in the API classes that support it) a change starts
+   * being smoothed at its sample offset. The smoother only advances when this is called, so call it in every ProcessBlock() for each smoothed parameter you use
+   * @param paramIdx The parameter index
+   * @return The values for this ProcessBlock() call, which only hold a buffer while the parameter is moving. A parameter that isn't smoothed is returned as constant */
+  ISmoothedBlock GetSmoothedBlock(int paramIdx);
+
+  /** Make sure the scratch arena holds at least nBytes. Call this from OnReset(), not from ProcessBlock()
+   * @param nBytes The number of bytes you will allocate in a single ProcessBlock() */
+  void ReserveScratchMemory(int nBytes) { mScratchArena.Reserve(static_cast<size_t>(nBytes)); }
+
+  /** Time each ProcessBlock() call with a monotonic clock, against the duration of the audio it processes. Off by default, since it costs two clock reads per block
+   * @param enable \c true to record the load in GetDSPLoadMeter() */
+  void SetDSPLoadMeasurement(bool enable) { mMeasureDSPLoad.store(enable, std::memory_order_relaxed); }
+
+  /** @return \c true if DSP load is being measured, see SetDSPLoadMeasurement() */
+  bool GetDSPLoadMeasurement() const { return mMeasureDSPLoad.load(std::memory_order_relaxed); }
+
+  /** @return The DSP load statistics, which can be read from any thread. See also IPlugAPIBase::SetDSPLoadControlTag() */
+  IDSPLoadMeter& GetDSPLoadMeter() { return mDSPLoadMeter; }
+
+  /** Flush denormals to zero while the API class is processing audio, see IFlushDenormalsScope. On by default. Call this from your constructor
+   * if your algorithms need denormals, or you want to manage the floating point mode yourself
+   * @param enable \c false to process with the host's floating point mode */
+  void SetFlushDenormals(bool enable) { mFlushDenormals = enable; }
+
+  /** @return \c true if denormals are flushed to zero while processing, see SetFlushDenormals() */
+  bool GetFlushDenormals() const { return mFlushDenormals; }
+
+  /** Stop calling ProcessBlock() once every connected input has been silent for longer than GetTailSize() + GetLatency() samples, and output silence instead.
+   * The block in which the input falls silent and the tail after it are still processed. MIDI input or a parameter change wakes the plug-in up, and the tail is processed again.
+   * Channels the host flags as silent (VST3) are trusted, the others are scanned against the threshold. A plug-in with no connected inputs is never skipped.
+   * Off by default, because a plug-in that doesn't call SetTailSize() would have its tail cut off.
+   * @param enable \c true to skip processing while the input is silent
+   * @param threshold The largest absolute sample value that counts as silence */
+  void SetSilenceSkipping(bool enable, float threshold = DEFAULT_SILENCE_THRESHOLD) { mSilenceSkipping = enable; mSilenceThreshold = threshold; }
+
+  /** @return \c true if processing is skipped while the input is silent, see SetSilenceSkipping() */
+  bool GetSilenceSkipping() const { return mSilenceSkipping; }
+
+  /** Call this from ProcessBlock() to avoid reading (or processing) an input that is known to be silent. This is set for channels the host flags as silent (VST3),
+   * and for channels found to be silent when SetSilenceSkipping() is enabled
+   * @param chIdx The input channel index
+   * @return \c true if the channel is silent for the current host block */
+  bool IsInputChannelSilent(int chIdx) const { return chIdx >= 0 && chIdx < 64 && ((mInputSilenceFlags >> chIdx) & 1); }
+
+  /** Call this from ProcessBlock() if an output channel is silent for the whole call, so that the host can skip processing after the plug-in.
+   * If the host block is split into sub-blocks, the channel is only reported as silent if it was flagged in every ProcessBlock() call
+   * @param chIdx The output channel index */
+  void SetOutputChannelSilent(int chIdx) { if (chIdx >= 0 && chIdx < 64) mProcessBlockOutputSilence |= (uint64_t(1) << chIdx); }
+
+  /** Call this from ProcessBusBlock() if an output bus is silent for the whole call, which flags each of its channels with SetOutputChannelSilent()
+   * @param busIdx The output bus index */
+  void SetOutputBusSilent(int busIdx)
+  {
+    for (auto c = GetBusChannelStartIdx(ERoute::kOutput, busIdx); c < GetBusChannelStartIdx(ERoute::kOutput, busIdx + 1); c++)
+      SetOutputChannelSilent(c);
+  }
+
+  /** Add the channel buffers, scratch arena, event list and bypass delay line to a report. IPlugAPIBase::GetMemoryReport() calls this
+   * @param report The report to add to */
+  void GetProcessorMemoryReport(IMemoryReport& report) const;
+
+  /** The MIDI messages, host parameter changes and transport changes of the current block, in time order, as filled in by the API class.
+   * MIDI messages are still sent to ProcessMidiMsg() and parameter changes to OnParamChange() as usual, before ProcessBlock() is called.
+   * Parameter changes are only recorded by APIs that report them with sample offsets on the audio thread (currently VST3, AUv2, AUv3 and AAX).
+   * Offsets are relative to the start of the host's block, which may be split into more than one call to ProcessBlock()
+   * @return The events of the current block */
+  const IBlockEventList& GetBlockEvents() const { return mFixedBlockSize ? mFixedBlockEvents : mBlockEvents; }
+
+  /** Call this from ProcessBlock() for sample accurate event handling. The block is split at each event in GetBlockEvents(),
+   * onEvent(const IBlockEvent&) is called for each event before the sub-block that starts with it, and onSubBlock(sample** inputs, sample** outputs, int nFrames)
+   * for each sub-block. The event offsets passed to onEvent are relative to this ProcessBlock() call. ITimeInfo positions are updated for each sub-block
+   * @param inputs The inputs passed to ProcessBlock()
+   * @param outputs The outputs passed to ProcessBlock()
+   * @param nFrames The number of frames passed to ProcessBlock()
+   * @param onEvent Called for each event
+   * @param onSubBlock Called to process each sub-block
+   * @param minSubBlockSize The smallest sub-block (in samples) that will be processed. Events closer together than this are handled at the start of the next sub-block */
+  template<typename FE, typename FB>
+  void ForEachSubBlock(sample** inputs, sample** outputs, int nFrames, FE onEvent, FB onSubBlock, int minSubBlockSize = DEFAULT_MIN_SUBBLOCK_SIZE)
+  {
+    const IBlockEventList& events = GetBlockEvents();
+    const int nEvents = events.Size();
+    const ITimeInfo blockTimeInfo = mTimeInfo;
+    const double samplesPerBeat = GetSamplesPerBeat();
+    int eventIdx = 0;
+    int startIdx = 0;
+
+    minSubBlockSize = std::max(minSubBlockSize, 1);
+
+    // skip events that were handled by an earlier ProcessBlock() call in the same host block
+    while (eventIdx < nEvents && events.Get(eventIdx).mOffset < mBlockEventsStart)
+      eventIdx++;
+
+    auto deliverUntil = [&](int endOffset) {
+      for (; eventIdx < nEvents && events.Get(eventIdx).mOffset - mBlockEventsStart <= endOffset; eventIdx++)
+      {
+        IBlockEvent event = events.Get(eventIdx);
+        event.mOffset -= mBlockEventsStart;
+        event.mMidi.mOffset = event.mOffset;
+        onEvent(event);
+      }
+    };
+
+    while (startIdx < nFrames)
+    {
+      deliverUntil(startIdx);
+
+      int endIdx = nFrames;
+
+      if (eventIdx < nEvents)
+        endIdx = std::min(std::max(events.Get(eventIdx).mOffset - mBlockEventsStart, startIdx + minSubBlockSize), nFrames);
+
+      if (blockTimeInfo.mSamplePos >= 0.)
+        mTimeInfo.mSamplePos = blockTimeInfo.mSamplePos + startIdx;
+
+      if (blockTimeInfo.mPPQPos >= 0. && samplesPerBeat > 0.)
+        mTimeInfo.mPPQPos = blockTimeInfo.mPPQPos + (startIdx / samplesPerBeat);
+
+      onSubBlock(OffsetSubBlockBuffers(ERoute::kInput, inputs, startIdx), OffsetSubBlockBuffers(ERoute::kOutput, outputs, startIdx), endIdx - startIdx);
+      startIdx = endIdx;
+    }
+
+    // events in the last sub-block that were too close to its start to split it
+    deliverUntil(nFrames - 1);
+    mTimeInfo = blockTimeInfo;
+  }
+
+  /** @return Plugin latency (in samples), including the latency added by SetFixedBlockSize() */
+  int GetLatency() const { return mLatency + mFixedBlockSize; }
 
   /** @return The tail size in samples (useful for reverberation plug-ins, that may need to decay after the transport stops or an audio item ends) */
   int GetTailSize() { return mTailSize; }
@@ -151,6 +320,12 @@ public:
    * @return \c true if the bus has a wildcard, meaning it should work on any number of channels */
   bool HasWildcardBus(ERoute direction) const { return mIOConfigs.Get(0)->ContainsWildcard(direction); } // \todo only supports a single I/O config
 
+  /** Buses are laid out one after the other in the channel arrays passed to ProcessBlock(), each with room for the most channels it has in any I/O config
+   * @param direction Input or output
+   * @param busIdx The index of the bus
+   * @return The index of the bus's first channel */
+  int GetBusChannelStartIdx(ERoute direction, int busIdx) const { return mBusChannelStartIdx[direction].Get()[busIdx]; }
+
   /** @param direction Whether you want to test inputs or outputs
    * @return Total number of input or output channel buffers (not necessarily connected) */
   int MaxNChannels(ERoute direction) const { return mChannelData[direction].GetSize(); }
@@ -244,6 +419,27 @@ public:
    * @param tailSize the new tailsize in samples*/
   void SetTailSize(int tailSize) { mTailSize = tailSize; }
 
+  /** Call this in your plug-in's constructor if your ProcessBlock() still works when outputs[c] and inputs[c] point to the same memory.
+   * When the host's sample type matches \c sample, host buffers are always handed straight to ProcessBlock() (and may already alias).
+   * When samples need converting, this lets each connected output channel reuse its input channel's converted buffer,
+   * halving the scratch memory touched per block.
+   * @param inPlaceSafe \c true if ProcessBlock() can process in place */
+  void SetInPlaceSafe(bool inPlaceSafe) { mInPlaceSafe = inPlaceSafe; UpdateFixedIO(); }
+
+  /** @return \c true if the plug-in declared that ProcessBlock() can process in place */
+  bool GetInPlaceSafe() const { return mInPlaceSafe; }
+
+  /** Call this in your plug-in's constructor, or from OnRenderingOfflineChanged(), to have ProcessBlock() called with exactly blockSize frames, however the host sizes its blocks,
+   * e.g. for FFT or partitioned DSP. The audio is buffered, which adds blockSize samples to GetLatency() and the latency reported to the host.
+   * MIDI messages are passed to ProcessMidiMsg() just before the ProcessBlock() call they fall in, and the offsets of the MIDI, parameter and transport
+   * events in GetBlockEvents() are relative to that call. Parameter values are still set when the host changes them, up to blockSize samples early,
+   * so use the kParamChange events to place changes in time. GetBlockSize() remains the host's maximum block size. Allocates, so don't call this on the audio thread
+   * @param blockSize The number of frames passed to every ProcessBlock() call, or 0 to process the host's blocks as they come */
+  void SetFixedBlockSize(int blockSize);
+
+  /** @return The block size set with SetFixedBlockSize(), or 0 if the host's blocks are processed as they come */
+  int GetFixedBlockSize() const { return mFixedBlockSize; }
+
   /** A static method to parse the config.h channel I/O string.
    * @param IOStr Space separated cstring list of I/O configurations for this plug-in in the format ninchans-noutchans.
    * A hypen character \c(-) deliminates input-output. Supports multiple buses, which are indicated using a period \c(.) character.
@@ -260,25 +456,85 @@ public:
 protected:
 #pragma mark - Methods called by the API class - you do not call these methods in your plug-in class
   void SetChannelConnections(ERoute direction, int idx, int n, bool connected);
+  /** Called by the API class for each incoming MIDI message, before the block is processed. Passes the message to ProcessMidiMsg() and adds it to the block events,
+   * or with SetFixedBlockSize() holds it back until the ProcessBlock() call it falls in */
+  void ReceiveMidiMsg(const IMidiMsg& msg);
 
   //The following methods are duplicated, in order to deal with either single or double precision processing,
-  //depending on the value of arguments passed in
+  //depending on the value of arguments passed in. When the host's type is PLUG_SAMPLE_DST its buffers are used without copying.
+  //Inputs must be attached before outputs, so that in-place safe plug-ins can share converted buffers
   void AttachBuffers(ERoute direction, int idx, int n, PLUG_SAMPLE_DST** ppData, int nFrames);
   void AttachBuffers(ERoute direction, int idx, int n, PLUG_SAMPLE_SRC** ppData, int nFrames);
   void PassThroughBuffers(PLUG_SAMPLE_SRC type, int nFrames);
   void PassThroughBuffers(PLUG_SAMPLE_DST type, int nFrames);
-  void ProcessBuffers(PLUG_SAMPLE_SRC type, int nFrames);
-  void ProcessBuffers(PLUG_SAMPLE_DST type, int nFrames);
+  /** Calls ProcessBlock() on the attached buffers. When an API class splits the host block into sub-blocks (e.g. for sample accurate automation),
+   * startIdx is the offset in samples into the attached buffers at which this sub-block starts, and nFrames its length */
+  void ProcessBuffers(PLUG_SAMPLE_SRC type, int nFrames, int startIdx = 0);
+  void ProcessBuffers(PLUG_SAMPLE_DST type, int nFrames, int startIdx = 0);
   void ProcessBuffersAccumulating(int nFrames); // only for VST2 deprecated method single precision
   void ZeroScratchBuffers();
-  void SetSampleRate(double sampleRate) { mSampleRate = sampleRate; }
+  void SetSampleRate(double sampleRate);
   void SetBlockSize(int blockSize);
   void SetBypassed(bool bypassed) { mBypassed = bypassed; }
-  void SetTimeInfo(const ITimeInfo& timeInfo) { mTimeInfo = timeInfo; }
-  void SetRenderingOffline(bool renderingOffline) { mRenderingOffline = renderingOffline; }
+  void SetTimeInfo(const ITimeInfo& timeInfo);
+  /** Called by the API class after each host block has been processed, to empty the block's event list and forget the input silence flags */
+  void ClearBlockEvents();
+  /** Called by the API class when it learns whether the host is rendering offline. Calls OnRenderingOfflineChanged() if the mode has changed */
+  void SetRenderingOffline(bool renderingOffline);
+  /** Called by the API class before each host block, with a bit set for each input channel the host flagged as silent. Clears the output silence flags */
+  void SetInputSilenceFlags(uint64_t flags) { mInputSilenceFlags = flags; mOutputSilenceFlags = 0; }
+  /** @return A bit for each output channel that is known to be silent, once the host block has been processed */
+  uint64_t GetOutputSilenceFlags() const { return mOutputSilenceFlags; }
+  /** Called by the API class in place of ProcessBuffers() for the whole host block, see SetSilenceSkipping().
+   * @return \c true if processing was skipped, in which case the connected outputs have been zeroed and flagged as silent */
+  bool SkipSilentBuffers(PLUG_SAMPLE_SRC type, int nFrames);
+  bool SkipSilentBuffers(PLUG_SAMPLE_DST type, int nFrames);
+  /** Called by API classes that set parameters outside of the block event list, so that a parameter change ends silence skipping. Thread safe */
+  void WakeFromSilence() { mWakeFromSilence.store(true, std::memory_order_relaxed); }
   const WDL_String& GetChannelLabel(ERoute direction, int idx) { return mChannelData[direction].Get(idx)->mLabel; }
 
 private:
+  /** @return Pointers to each channel of the attached buffers, offset by startIdx samples */
+  sample** GetBuffersAtOffset(ERoute direction, int startIdx);
+  /** The part of ProcessBuffers() that doesn't depend on the host's sample type */
+  void ProcessAttachedBuffers(int nFrames, int startIdx);
+  /** Buffers a sub-block of the attached buffers, calling ProcessBlock() for each complete fixed size block, see SetFixedBlockSize() */
+  void ProcessFixedBlocks(int nFrames, int startIdx);
+  /** Zeroes the buffers used by SetFixedBlockSize() and forgets any events waiting for a later block */
+  void ClearFixedBlockBuffers();
+  /** @return The longest block ProcessBlock() can be called with */
+  int GetMaxProcessBlockFrames() const { return std::max(mBlockSize, mFixedBlockSize); }
+  /** Copies each input channel to the output channel with the same index and zeroes the other outputs, for bypass and the default ProcessBlock() */
+  void PassThroughBlock(sample** inputs, sample** outputs, int nFrames);
+  /** Splits the channel arrays into buses for ProcessBusBlock(), with nullptr for disconnected buses */
+  const IBusBuffers* GetBusBuffers(ERoute direction, sample** ppData);
+  /** Calls ProcessBlock(), timing it if SetDSPLoadMeasurement() is enabled */
+  void ProcessBlockMeasured(sample** inputs, sample** outputs, int nFrames);
+  /** @return Pointers to each channel of ppData, which has a pointer for every channel, offset by startIdx samples, for ForEachSubBlock() */
+  sample** OffsetSubBlockBuffers(ERoute direction, sample** ppData, int startIdx);
+  /** Counts the frames for which every connected input has been silent
+   * @return \c true if the tail has elapsed and the block can be skipped */
+  bool UpdateSilentInputFrames(int nFrames);
+  /** Records the channels ProcessBlock() flagged with SetOutputChannelSilent(), see ProcessBuffers() */
+  void UpdateOutputSilenceFlags(int startIdx);
+  /** Finds the parameters that have a smoothing time and allocates their buffers, snapping each smoother to its parameter's value. Called when the sample rate or block size is set */
+  void ResetParamSmoothing();
+  /** Checks whether every channel of the fixed layout is connected and finds the scratch buffers to convert into, see IPlugFixedIO.h.
+   * Called when the connections, the block size or SetInPlaceSafe() change */
+  void UpdateFixedIO();
+  /** @return The host's buffer for an output channel attached with AttachBuffers() */
+  PLUG_SAMPLE_SRC* GetOutgoingData(int chIdx) const { return mFixedOutputsAttached ? mFixedOutputs.Get()[chIdx] : mChannelData[ERoute::kOutput].Get(chIdx)->mIncomingData; }
+
+  /** The smoother for a parameter with a smoothing time, see GetSmoothedBlock() */
+  struct SmoothedParam
+  {
+    const IParam* mParam;
+    LogParamSmooth<sample> mSmoother;
+    /** The value of mProcessBlockCount when the block was last computed, so that it is only computed once per ProcessBlock() */
+    uint32_t mBlockCount;
+    ISmoothedBlock mBlock;
+  };
+
   /** See EIPlugPluginTypes */
   EIPlugPluginType mPlugType;
   /** \c true if the plug-in accepts MIDI input */
@@ -297,19 +553,92 @@ private:
   int mTailSize = 0;
   /** \c true if the plug-in is bypassed */
   bool mBypassed = false;
+  /** \c true if ProcessBlock() can process in place, see SetInPlaceSafe() */
+  bool mInPlaceSafe = false;
   /** \c true if the plug-in is rendering off-line*/
   bool mRenderingOffline = false;
   /** A list of IOConfig structures populated by ParseChannelIOStr in the IPlugProcessor constructor */
   WDL_PtrList<IOConfig> mIOConfigs;
   /* Manages pointers to the actual data for each channel */
   WDL_TypedBuf<sample*> mScratchData[2];
+  /* Channel pointers offset into mScratchData, used when processing sub-blocks */
+  WDL_TypedBuf<sample*> mOffsetData[2];
+  /* Channel pointers offset into the buffers passed to ForEachSubBlock() */
+  WDL_TypedBuf<sample*> mSubBlockData[2];
+  /* The offset into the host block of the current ProcessBlock() call */
+  int mBlockEventsStart = 0;
+  /* The number of frames in the host block processed so far, and its transport, used to detect transport changes */
+  int mBlockEventsFrames = 0;
+  ITimeInfo mLastTimeInfo;
+  bool mHasLastTimeInfo = false;
   /* A list of IChannelData structures corresponding to every input/output channel */
   WDL_PtrList<IChannelData<>> mChannelData[2];
+  /* Conversion routines for the channel layout if it is fixed at compile time, see IPlugFixedIO.h */
+  const IFixedIORoutines* mFixedIO = nullptr;
+  /* true if every channel of the fixed layout is connected, so that the buffers can be converted with mFixedIO */
+  bool mFixedIOConnected = false;
+  /* true if the host's output channels were attached to mFixedOutputs rather than to each channel's mIncomingData */
+  bool mFixedOutputsAttached = false;
+  /* The buffers for ProcessBlock() when converting with mFixedIO, updated by UpdateFixedIO() */
+  WDL_TypedBuf<sample*> mFixedIOData[2];
+  /* The host's output channels when converting with mFixedIO */
+  WDL_TypedBuf<PLUG_SAMPLE_SRC*> mFixedOutputs;
+  /* Realtime safe temporary memory for ProcessBlock(), see GetScratchArena() */
+  IScratchArena mScratchArena;
+  /* The first channel of each bus, and one past the last bus, see GetBusChannelStartIdx() */
+  WDL_TypedBuf<int> mBusChannelStartIdx[2];
+  /* The buses passed to ProcessBusBlock() */
+  WDL_TypedBuf<IBusBuffers> mBusBuffers[2];
+  /* DSP load statistics, see SetDSPLoadMeasurement() */
+  IDSPLoadMeter mDSPLoadMeter;
+  std::atomic<bool> mMeasureDSPLoad{false};
+  /* Set flush to zero around processing, see SetFlushDenormals() */
+  bool mFlushDenormals = true;
+  /* Skip processing while the input is silent, see SetSilenceSkipping() */
+  bool mSilenceSkipping = false;
+  /* Input channels that the host doesn't flag are silent below this level, see SetSilenceSkipping() */
+  float mSilenceThreshold = DEFAULT_SILENCE_THRESHOLD;
+  /* Set by WakeFromSilence(), from any thread */
+  std::atomic<bool> mWakeFromSilence{false};
+  /* The number of frames for which every connected input has been silent */
+  int mSilentInputFrames = 0;
+  /* A bit for each input channel that is known to be silent, for the current host block */
+  uint64_t mInputSilenceFlags = 0;
+  /* A bit for each output channel that was silent in every ProcessBlock() call of the current host block */
+  uint64_t mOutputSilenceFlags = 0;
+  /* The output channels flagged by SetOutputChannelSilent() during the current ProcessBlock() call */
+  uint64_t mProcessBlockOutputSilence = 0;
+  /* The smoothers for parameters with a smoothing time, see GetSmoothedBlock() */
+  std::vector<SmoothedParam> mSmoothedParams;
+  /* The index into mSmoothedParams for each parameter, or -1 if it isn't smoothed */
+  WDL_TypedBuf<int> mSmoothedParamIdx;
+  /* A block size buffer for each smoothed parameter */
+  WDL_TypedBuf<sample> mSmoothedValues;
+  /* The API class as an IPluginBase, set by ResetParamSmoothing(), which evaluates the parameter dependencies before each ProcessBlock() */
+  IPluginBase* mPlug = nullptr;
+  /* Incremented for each ProcessBlock() call */
+  uint32_t mProcessBlockCount = 0;
+  /* The length of the current ProcessBlock() call */
+  int mProcessBlockFrames = 0;
+  /* The block size for every ProcessBlock() call, or 0, see SetFixedBlockSize() */
+  int mFixedBlockSize = 0;
+  /* The number of frames buffered towards the next fixed size block */
+  int mFixedBlockFill = 0;
+  /* The input and output buffers of the fixed size block, and pointers to each channel */
+  WDL_TypedBuf<sample> mFixedBlockBuffer;
+  WDL_TypedBuf<sample*> mFixedBlockData[2];
+  /* The events of the current fixed size block, and those buffered for later blocks with offsets relative to the block being filled */
+  IBlockEventList mFixedBlockEvents {MAX_BLOCK_EVENTS};
+  IBlockEventList mFixedPendingEvents {MAX_BLOCK_EVENTS};
+  /* The number of events in mBlockEvents already moved to mFixedPendingEvents */
+  int mFixedEventsTaken = 0;
 protected: // these members are protected because they need to be access by the API classes, and don't want a setter/getter
   /** A multichannel delay line used to delay the bypassed signal when a plug-in with latency is bypassed. */
   std::unique_ptr<NChanDelayLine<sample>> mLatencyDelay = nullptr;
   /** Contains detailed information about the transport state */
   ITimeInfo mTimeInfo;
+  /** The events of the current block, filled by the API class, see GetBlockEvents() */
+  IBlockEventList mBlockEvents {MAX_BLOCK_EVENTS};
 };
 
 END_IPLUG_NAMESPACE
@@ -15,6 +15,7 @@
  * @copydoc IPlugQueue
  */
 
+#include <algorithm>
 #include <atomic>
 #include <cstddef>
 
@@ -27,6 +28,19 @@ template<typename T>
 class IPlugQueue final
 {
 public:
+  /** A view of up to two contiguous regions of the queue's storage. The second region is only used when the first reaches the end of the buffer */
+  template<typename U>
+  struct Span
+  {
+    U* pData1 = nullptr;
+    size_t size1 = 0;
+    U* pData2 = nullptr;
+    size_t size2 = 0;
+
+    size_t Size() const { return size1 + size2; }
+    U& operator[](size_t i) const { return i < size1 ? pData1[i] : pData2[i - size1]; }
+  };
+
   /** IPlugQueue constructor 
    * @param size /todo */
   IPlugQueue(int size)
@@ -79,11 +93,90 @@ public:
     return true;
   }
 
+  /** Producer thread: push up to nItems items, with one atomic store for the lot
+   * @param pItems The items to push
+   * @param nItems The number of items in pItems
+   * @return The number of items pushed, less than nItems if the queue filled up */
+  size_t PushN(const T* pItems, size_t nItems)
+  {
+    Span<T> span = WriteSpan(nItems);
+    std::copy(pItems, pItems + span.size1, span.pData1);
+    std::copy(pItems + span.size1, pItems + span.Size(), span.pData2);
+    CommitWrite(span.Size());
+    return span.Size();
+  }
+
+  /** Consumer thread: pop up to nItems items, with one atomic store for the lot
+   * @param pItems Buffer to pop the items into
+   * @param nItems The capacity of pItems
+   * @return The number of items popped */
+  size_t PopN(T* pItems, size_t nItems)
+  {
+    Span<const T> span = ReadSpan(nItems);
+    std::copy(span.pData1, span.pData1 + span.size1, pItems);
+    std::copy(span.pData2, span.pData2 + span.size2, pItems + span.size1);
+    CommitRead(span.Size());
+    return span.Size();
+  }
+
+  /** Producer thread: get the free space in the queue, to write items into in place. Nothing is visible to the consumer until CommitWrite()
+   * @param maxItems The most items you want to write
+   * @return Up to maxItems free slots */
+  Span<T> WriteSpan(size_t maxItems = static_cast<size_t>(-1))
+  {
+    const size_t size = mData.GetSize();
+    const size_t writeIndex = mWriteIndex.load(std::memory_order_relaxed);
+    const size_t readIndex = mReadIndex.load(std::memory_order_acquire);
+    const size_t nFree = std::min((readIndex + size - writeIndex - 1) % size, maxItems); // one slot is kept empty, to tell full from empty
+
+    Span<T> span;
+    span.pData1 = mData.Get() + writeIndex;
+    span.size1 = std::min(nFree, size - writeIndex);
+    span.pData2 = mData.Get();
+    span.size2 = nFree - span.size1;
+    return span;
+  }
+
+  /** Producer thread: publish items written into a WriteSpan()
+   * @param nItems The number of items written, no more than the span's Size() */
+  void CommitWrite(size_t nItems)
+  {
+    if (nItems)
+      mWriteIndex.store((mWriteIndex.load(std::memory_order_relaxed) + nItems) % mData.GetSize(), std::memory_order_release);
+  }
+
+  /** Consumer thread: get the items in the queue, to read in place. The items stay valid until CommitRead()
+   * @param maxItems The most items you want to read
+   * @return Up to maxItems items */
+  Span<const T> ReadSpan(size_t maxItems = static_cast<size_t>(-1)) const
+  {
+    const size_t size = mData.GetSize();
+    const size_t readIndex = mReadIndex.load(std::memory_order_relaxed);
+    const size_t writeIndex = mWriteIndex.load(std::memory_order_acquire);
+    const size_t nAvailable = std::min((writeIndex + size - readIndex) % size, maxItems);
+
+    Span<const T> span;
+    span.pData1 = mData.Get() + readIndex;
+    span.size1 = std::min(nAvailable, size - readIndex);
+    span.pData2 = mData.Get();
+    span.size2 = nAvailable - span.size1;
+    return span;
+  }
+
+  /** Consumer thread: release items read from a ReadSpan(), so that the producer can reuse their slots
+   * @param nItems The number of items read, no more than the span's Size() */
+  void CommitRead(size_t nItems)
+  {
+    if (nItems)
+      mReadIndex.store((mReadIndex.load(std::memory_order_relaxed) + nItems) % mData.GetSize(), std::memory_order_release);
+  }
+
   /** /todo 
    * @return size_t /todo */
   size_t ElementsAvailable() const
   {
-    return (mWriteIndex.load(std::memory_order_acquire) - mReadIndex.load(std::memory_order_relaxed))%mData.GetSize();
+    const size_t size = mData.GetSize();
+    return (mWriteIndex.load(std::memory_order_acquire) + size - mReadIndex.load(std::memory_order_relaxed)) % size;
   }
 
   /** /todo
@@ -113,6 +206,9 @@ public:
     return (nextWriteIndex == mReadIndex.load());
   }
 
+  /** @return The size of the queue's storage in bytes */
+  size_t GetMemoryUsage() const { return mData.GetSize() * sizeof(T); }
+
 private:
   /** /todo 
    * @param idx /todo
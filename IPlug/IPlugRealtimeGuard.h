@@ -0,0 +1,155 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Debug build detection of heap allocations and locks on the audio thread
+ *
+ * The API classes enter an IRealtimeScope around every audio callback. Inside that scope IMidiQueue growth and ENTER_PARAMS_MUTEX are
+ * reported with a stack trace. To check your own code, e.g. a lock you take in ProcessBlock():    REALTIME_CHECK("mMyMutex.Enter()");
+ *
+ * Define IPLUG_DETECT_AUDIO_ALLOCATIONS to also report operator new and delete (on Windows, any debug CRT allocation). This replaces the
+ * global operator new and delete, or installs a CRT allocation hook that calls any previous one, so it is off by default.
+ *
+ * The guard is only compiled in debug builds. Define NO_REALTIME_GUARD to switch it off, and REALTIME_GUARD_ASSERT to stop in the
+ * debugger at the first violation rather than logging it.
+ */
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+
+#include "IPlugPlatform.h"
+#include "IPlugLogger.h"
+
+// the bench target replaces operator new to count allocations itself, and must measure a release build anyway
+#if !defined NDEBUG && !defined NO_REALTIME_GUARD && !defined BENCH_API && !defined OS_WEB
+  #define IPLUG_REALTIME_GUARD 1
+#else
+  #define IPLUG_REALTIME_GUARD 0
+#endif
+
+#if IPLUG_REALTIME_GUARD
+  #if defined OS_WIN
+    #include <windows.h>
+  #else
+    #include <execinfo.h>
+    #include <unistd.h>
+  #endif
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+
+#if IPLUG_REALTIME_GUARD
+
+/** Tracks whether the calling thread is inside an audio callback, and reports operations that are not real-time safe */
+class IRealtimeGuard
+{
+public:
+  /** The number of violations that are logged with a stack trace, later ones are only counted */
+  static constexpr uint32_t kMaxReports = 20;
+
+  /** @return \c true if the calling thread is inside an IRealtimeScope */
+  static bool IsActive() { return Depth() > 0; }
+
+  /** Report \p what if the calling thread is inside an IRealtimeScope
+   * @param what A description of the operation, e.g. "operator new" */
+  static void Check(const char* what)
+  {
+    if (Depth() > 0)
+      Report(what);
+  }
+
+  /** @return The number of violations since the process started, from all threads */
+  static uint32_t GetNumViolations() { return NumViolations().load(std::memory_order_relaxed); }
+
+  static void Enter() { ++Depth(); }
+  static void Leave() { --Depth(); }
+
+private:
+  static int& Depth()
+  {
+    static thread_local int depth = 0;
+    return depth;
+  }
+
+  static std::atomic<uint32_t>& NumViolations()
+  {
+    static std::atomic<uint32_t> numViolations {0};
+    return numViolations;
+  }
+
+  static void Report(const char* what)
+  {
+    // logging allocates, so the guard is suspended until the report is done
+    int& depth = Depth();
+    const int savedDepth = depth;
+    depth = 0;
+
+    const uint32_t num = NumViolations().fetch_add(1, std::memory_order_relaxed) + 1;
+
+    if (num <= static_cast<uint32_t>(kMaxReports))
+    {
+      DBGMSG("IPlug realtime guard: %s on the audio thread (violation %u)\n", what, num);
+      PrintStack();
+
+      if (num == static_cast<uint32_t>(kMaxReports))
+        DBGMSG("IPlug realtime guard: further violations will only be counted\n");
+    }
+
+#ifdef REALTIME_GUARD_ASSERT
+    assert(false && "operation that is not real-time safe on the audio thread");
+#endif
+
+    depth = savedDepth;
+  }
+
+  static void PrintStack()
+  {
+    constexpr int kMaxFrames = 32;
+    void* frames[kMaxFrames];
+#if defined OS_WIN
+    const int nFrames = CaptureStackBackTrace(2, kMaxFrames, frames, nullptr);
+
+    for (int i = 0; i < nFrames; i++)
+      DBGMSG("  %2d %p\n", i, frames[i]);
+#else
+    const int nFrames = backtrace(frames, kMaxFrames);
+    fflush(stdout);
+    backtrace_symbols_fd(frames + 2, nFrames > 2 ? nFrames - 2 : 0, STDERR_FILENO); // skip Report() and PrintStack()
+#endif
+  }
+};
+
+/** RAII helper that marks the calling thread as being inside an audio callback for its lifetime. Scopes can be nested */
+class IRealtimeScope
+{
+public:
+  IRealtimeScope() { IRealtimeGuard::Enter(); }
+  ~IRealtimeScope() { IRealtimeGuard::Leave(); }
+
+  IRealtimeScope(const IRealtimeScope&) = delete;
+  IRealtimeScope& operator=(const IRealtimeScope&) = delete;
+};
+
+#define REALTIME_SCOPE iplug::IRealtimeScope realtimeScope_
+#define REALTIME_CHECK(what) iplug::IRealtimeGuard::Check(what)
+
+#else
+
+#define REALTIME_SCOPE
+#define REALTIME_CHECK(what)
+
+#endif
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,238 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IResourceSwap
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "IPlugPlatform.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Builds a set of DSP resources (impulse responses, sample sets, models...) on a background thread, and swaps it in on the audio thread at a block boundary,
+ * optionally crossfading from the set it replaces. The audio thread never waits and never frees: replaced sets are handed back and deleted by CollectRetired()
+ * or the worker thread. The worker thread is started by the first Load(). If several loads are requested while one is building, only the latest is built.
+ *
+ * A typical use is loading custom state without blocking the thread the host calls on, or the audio thread via the params mutex:
+ * @code
+ * int MyPlug::UnserializeState(const IByteChunk& chunk, int startPos)
+ * {
+ *   WDL_String path;
+ *   int pos = chunk.GetStr(path, startPos);
+ *   mEngine.Load([path]() { return std::make_unique<Convolver>(path.Get()); });
+ *   return UnserializeParams(chunk, pos);
+ * }
+ *
+ * void MyPlug::ProcessBlock(sample** inputs, sample** outputs, int nFrames)
+ * {
+ *   mEngine.Update(256);
+ *   if (Convolver* pPrevious = mEngine.GetPrevious())
+ *     pPrevious->Process(inputs, mFadeBuffers, nFrames);
+ *   mEngine.Get()->Process(inputs, outputs, nFrames);
+ *   mEngine.Crossfade(outputs, mFadeBuffers, NOutChansConnected(), nFrames);
+ * }
+ *
+ * void MyPlug::OnIdle() { mEngine.CollectRetired(); }
+ * @endcode */
+template <typename T>
+class IResourceSwap final
+{
+public:
+  using BuildFunc = std::function<std::unique_ptr<T>()>;
+
+  /** @param pInitial The set to use until the first load has finished, may be nullptr */
+  IResourceSwap(std::unique_ptr<T> pInitial = nullptr)
+  : mCurrent(pInitial.release())
+  {
+  }
+
+  ~IResourceSwap()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mQuit = true;
+    }
+
+    mCondition.notify_all();
+
+    if (mThread.joinable())
+      mThread.join();
+
+    delete mPending.exchange(nullptr);
+    delete mRetired.exchange(nullptr);
+    delete mPrevious;
+    delete mCurrent;
+  }
+
+  IResourceSwap(const IResourceSwap&) = delete;
+  IResourceSwap& operator=(const IResourceSwap&) = delete;
+
+  /** Build a new set on the worker thread, replacing any build that hasn't started yet. Call this from any thread but the audio thread
+   * @param build Called on the worker thread, it must only touch data it owns or has captured by value. If it returns nullptr the current set is kept */
+  void Load(BuildFunc build)
+  {
+    CollectRetired();
+
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mBuild = std::move(build);
+    }
+
+    if (!mThread.joinable())
+      mThread = std::thread([this]() { ThreadLoop(); });
+
+    mCondition.notify_one();
+  }
+
+  /** Delete the sets that the audio thread has finished with. Call this regularly from a non-realtime thread, e.g. from OnIdle().
+   * Until a replaced set has been collected, the next one can't be swapped in */
+  void CollectRetired()
+  {
+    delete mRetired.exchange(nullptr, std::memory_order_acquire);
+  }
+
+  /** @return \c true if a load has been requested, and its set hasn't been swapped in yet */
+  bool IsLoading() const
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mBuild || mBuilding || mPending.load(std::memory_order_relaxed);
+  }
+
+#pragma mark - Audio thread
+
+  /** Call this at the start of each block, on the audio thread. Swaps in a newly built set, unless a crossfade is still running or the last replaced set hasn't been collected
+   * @param crossfadeFrames The length of the crossfade from the replaced set, or 0 to switch immediately. The replaced set is available from GetPrevious() until it ends
+   * @return \c true if a new set was swapped in */
+  bool Update(int crossfadeFrames = 0)
+  {
+    if (mPrevious || mRetired.load(std::memory_order_relaxed) || !mPending.load(std::memory_order_relaxed))
+      return false;
+
+    T* pNew = mPending.exchange(nullptr, std::memory_order_acquire);
+
+    if (!pNew)
+      return false;
+
+    T* pOld = mCurrent;
+    mCurrent = pNew;
+
+    if (pOld && crossfadeFrames > 0)
+    {
+      mPrevious = pOld;
+      mCrossfadeFrames = crossfadeFrames;
+      mCrossfadePos = 0;
+    }
+    else
+      mRetired.store(pOld, std::memory_order_release);
+
+    return true;
+  }
+
+  /** @return The current set, may be nullptr if nothing has been loaded yet. Audio thread only */
+  T* Get() const { return mCurrent; }
+
+  /** @return The set being faded out, or nullptr if there is no crossfade. Audio thread only */
+  T* GetPrevious() const { return mPrevious; }
+
+  /** Mix the output of the previous set into the output of the current set, along a linear crossfade, and retire the previous set once the crossfade ends.
+   * Does nothing when there is no crossfade. Audio thread only
+   * @param outputs The output of the current set, which is overwritten with the mix
+   * @param previousOutputs The output of GetPrevious() for the same block
+   * @param nChans The number of channels
+   * @param nFrames The number of frames */
+  template <typename S>
+  void Crossfade(S** outputs, S** previousOutputs, int nChans, int nFrames)
+  {
+    if (!mPrevious)
+      return;
+
+    const int nFade = std::min(nFrames, mCrossfadeFrames - mCrossfadePos);
+    const S step = static_cast<S>(1.) / static_cast<S>(mCrossfadeFrames);
+
+    for (int c = 0; c < nChans; c++)
+    {
+      S* pOut = outputs[c];
+      const S* pPrevious = previousOutputs[c];
+      S gain = static_cast<S>(mCrossfadePos) * step;
+
+      for (int s = 0; s < nFade; s++, gain += step)
+        pOut[s] = pPrevious[s] + gain * (pOut[s] - pPrevious[s]);
+    }
+
+    mCrossfadePos += nFade;
+
+    if (mCrossfadePos >= mCrossfadeFrames)
+    {
+      mRetired.store(mPrevious, std::memory_order_release);
+      mPrevious = nullptr;
+    }
+  }
+
+private:
+  void ThreadLoop()
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (true)
+    {
+      mCondition.wait(lock, [this]() { return mQuit || mBuild; });
+
+      if (mQuit)
+        return;
+
+      BuildFunc build = std::move(mBuild);
+      mBuild = nullptr;
+      mBuilding = true;
+
+      lock.unlock();
+      std::unique_ptr<T> pBuilt = build();
+
+      // a set that was built but never swapped in is replaced by the newer one
+      if (pBuilt)
+        delete mPending.exchange(pBuilt.release(), std::memory_order_release);
+
+      CollectRetired();
+      lock.lock();
+
+      mBuilding = false;
+    }
+  }
+
+  /** Only touched by the audio thread */
+  T* mCurrent = nullptr;
+  T* mPrevious = nullptr;
+  int mCrossfadeFrames = 0;
+  int mCrossfadePos = 0;
+
+  /** Handed from the worker thread to the audio thread */
+  std::atomic<T*> mPending {nullptr};
+  /** Handed from the audio thread to whoever collects it */
+  std::atomic<T*> mRetired {nullptr};
+
+  std::thread mThread;
+  mutable std::mutex mMutex;
+  std::condition_variable mCondition;
+  BuildFunc mBuild;
+  bool mBuilding = false;
+  bool mQuit = false;
+};
+
+END_IPLUG_NAMESPACE
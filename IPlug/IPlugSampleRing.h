@@ -0,0 +1,173 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugSampleRing
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+#include "heapbuf.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A lock-free ring of multichannel samples with a single writer, typically the audio thread, and a reader that only wants the most recent samples, e.g. for visualisation.
+ * The writer never waits and never drops data: old samples are simply overwritten. A reader can tell if the samples it read were overwritten while it was reading them, and try again later */
+template<typename T, int MAXNC>
+class IPlugSampleRing final
+{
+public:
+  /** @param size The minimum number of frames the ring can hold, rounded up to a power of two */
+  IPlugSampleRing(int size)
+  {
+    Resize(size);
+  }
+
+  IPlugSampleRing(const IPlugSampleRing&) = delete;
+  IPlugSampleRing& operator=(const IPlugSampleRing&) = delete;
+
+  /** Empties the ring, so this must not be called while either thread is using it
+   * @param size The minimum number of frames the ring can hold, rounded up to a power of two */
+  void Resize(int size)
+  {
+    int capacity = 1;
+
+    while (capacity < size)
+      capacity <<= 1;
+
+    for (auto c = 0; c < MAXNC; c++)
+    {
+      mData[c].Resize(capacity);
+      std::fill(mData[c].Get(), mData[c].Get() + capacity, T(0));
+    }
+
+    mMask = capacity - 1;
+    mWritePos.store(0, std::memory_order_relaxed);
+    mWriteBeginPos.store(0, std::memory_order_relaxed);
+  }
+
+  /** @return The number of frames the ring holds */
+  int GetCapacity() const { return mMask + 1; }
+
+  /** Writer thread: append a block of samples
+   * @param inputs MAXNC channel pointers
+   * @param nFrames The number of frames in each channel */
+  template<typename S>
+  void Write(const S* const* inputs, int nFrames)
+  {
+    const uint64_t writePos = mWritePos.load(std::memory_order_relaxed);
+    const int capacity = GetCapacity();
+    const int skip = std::max(nFrames - capacity, 0); // only the newest samples fit
+
+    BeginWrite(writePos + nFrames);
+
+    for (auto c = 0; c < MAXNC; c++)
+    {
+      T* pRing = mData[c].Get();
+      int idx = static_cast<int>((writePos + skip) & mMask);
+
+      for (auto s = skip; s < nFrames; s++)
+      {
+        pRing[idx] = static_cast<T>(inputs[c][s]);
+        idx = (idx + 1) & mMask;
+      }
+    }
+
+    mWritePos.store(writePos + nFrames, std::memory_order_release);
+  }
+
+  /** Writer thread: append a single frame
+   * @param frame One sample for each of the MAXNC channels */
+  template<typename S>
+  void WriteFrame(const S* frame)
+  {
+    const uint64_t writePos = mWritePos.load(std::memory_order_relaxed);
+    const int idx = static_cast<int>(writePos & mMask);
+
+    BeginWrite(writePos + 1);
+
+    for (auto c = 0; c < MAXNC; c++)
+      mData[c].Get()[idx] = static_cast<T>(frame[c]);
+
+    mWritePos.store(writePos + 1, std::memory_order_release);
+  }
+
+  /** Reader thread: @return The total number of frames written so far. The newest frame is at GetWritePosition() - 1 */
+  uint64_t GetWritePosition() const
+  {
+    return mWritePos.load(std::memory_order_acquire);
+  }
+
+  /** Reader thread: visit frames in place, without copying. func is called with (channel, pointer, offset into the range, number of samples) for each contiguous region
+   * @param startPos The position of the first frame, from GetWritePosition()
+   * @param nFrames The number of frames
+   * @param func The function to call for each region, which must not keep the pointer
+   * @return \c false if any of the frames were overwritten by the writer, in which case the data given to func was not valid */
+  template<typename F>
+  bool Visit(uint64_t startPos, int nFrames, F func) const
+  {
+    if (!IsValid(startPos, nFrames, GetWritePosition()))
+      return false;
+
+    const int startIdx = static_cast<int>(startPos & mMask);
+    const int size1 = std::min(nFrames, GetCapacity() - startIdx);
+
+    for (auto c = 0; c < MAXNC; c++)
+    {
+      const T* pRing = mData[c].Get();
+      func(c, pRing + startIdx, 0, size1);
+
+      if (size1 < nFrames)
+        func(c, pRing, size1, nFrames - size1);
+    }
+
+    // if the writer started overwriting any of the frames while we were reading, some of what func saw was torn
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return IsValid(startPos, nFrames, mWriteBeginPos.load(std::memory_order_relaxed));
+  }
+
+  /** Reader thread: copy frames out of the ring
+   * @param startPos The position of the first frame, from GetWritePosition()
+   * @param nFrames The number of frames
+   * @param outputs MAXNC channel pointers with space for nFrames samples
+   * @return \c false if any of the frames were overwritten by the writer */
+  bool Read(uint64_t startPos, int nFrames, T* const* outputs) const
+  {
+    return Visit(startPos, nFrames, [outputs](int c, const T* pData, int offset, int n) {
+      std::copy(pData, pData + n, outputs[c] + offset);
+    });
+  }
+
+private:
+  /** Announce the write position a write will reach before overwriting any samples, so that Visit() can tell its frames were torn even when
+   * the write hasn't finished */
+  void BeginWrite(uint64_t endPos)
+  {
+    mWriteBeginPos.store(endPos, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  bool IsValid(uint64_t startPos, int nFrames, uint64_t writePos) const
+  {
+    return nFrames <= GetCapacity() && startPos + nFrames <= writePos && writePos - startPos <= static_cast<uint64_t>(GetCapacity());
+  }
+
+  WDL_TypedBuf<T> mData[MAXNC];
+  int mMask = 0;
+  std::atomic<uint64_t> mWritePos{0}; // the end of the samples that have been written
+  std::atomic<uint64_t> mWriteBeginPos{0}; // the end of the samples being written, ahead of mWritePos during a write
+};
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,97 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IScratchArena
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "heapbuf.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A bump allocator for temporary buffers on the audio thread. Memory is reserved up front, off the audio thread, and Allocate() just moves a pointer along it.
+ * Everything allocated is released at once by Reset(), so buffers must not be kept beyond the block they were allocated in */
+class IScratchArena final
+{
+public:
+  /** Every allocation starts on a multiple of this many bytes, which suits SIMD loads and avoids false sharing */
+  static constexpr size_t kAlignment = 64;
+
+  IScratchArena() = default;
+  IScratchArena(const IScratchArena&) = delete;
+  IScratchArena& operator=(const IScratchArena&) = delete;
+
+  /** Make sure the arena can hold at least nBytes. This allocates and releases everything allocated, so it must not be called on the audio thread
+   * @param nBytes The minimum capacity in bytes. The arena never shrinks */
+  void Reserve(size_t nBytes)
+  {
+    nBytes = Align(nBytes);
+
+    if (nBytes > mCapacity)
+    {
+      mData.Resize(static_cast<int>(nBytes + kAlignment), false);
+      mCapacity = nBytes;
+    }
+
+    const uintptr_t base = reinterpret_cast<uintptr_t>(mData.Get());
+    mStart = mData.Get() + (Align(base) - base);
+    mUsed = 0;
+  }
+
+  /** @return The capacity in bytes */
+  size_t GetCapacity() const { return mCapacity; }
+
+  /** @return The most bytes that have been in use at once, the amount to Reserve() if the arena has run out */
+  size_t GetHighWaterMark() const { return mHighWaterMark; }
+
+  /** Realtime safe. The memory is not initialised
+   * @param count The number of elements
+   * @return Pointer to space for count elements, or nullptr if the arena doesn't have enough space left */
+  template<typename T>
+  T* Allocate(size_t count)
+  {
+    const size_t nBytes = Align(count * sizeof(T));
+
+    if (nBytes > mCapacity - mUsed)
+    {
+      mHighWaterMark = std::max(mHighWaterMark, mUsed + nBytes);
+      return nullptr;
+    }
+
+    T* ptr = reinterpret_cast<T*>(mStart + mUsed);
+    mUsed += nBytes;
+    mHighWaterMark = std::max(mHighWaterMark, mUsed);
+    return ptr;
+  }
+
+  /** Realtime safe. Releases everything that has been allocated */
+  void Reset() { mUsed = 0; }
+
+private:
+  static size_t Align(size_t n)
+  {
+    return (n + kAlignment - 1) & ~(kAlignment - 1);
+  }
+
+  WDL_TypedBuf<uint8_t> mData;
+  uint8_t* mStart = nullptr;
+  size_t mCapacity = 0;
+  size_t mUsed = 0;
+  size_t mHighWaterMark = 0;
+};
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,200 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc SharedStorage
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mutex.h"
+#include "wdlstring.h"
+
+#include "IPlugPlatform.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Process-wide storage of read-only DSP data such as wavetables, FFT tables, impulse responses and filter coefficients, so that every plug-in
+ * instance shares one copy of each item. The DSP equivalent of IGraphics' StaticStorage.
+ *
+ * Items are looked up by key, and reference counted: FindOrCreate() returns a std::shared_ptr<const T>, and an item is deleted when the last
+ * instance holding it lets go. Lookups lock, so do them when an instance is constructed or reset, not on the audio thread. Reading an item
+ * through the returned pointer needs no lock, as items are never modified after creation.
+ *
+ * Each key has its own creation lock, so instances that are constructed at the same time build different items in parallel, and an item
+ * requested by several instances at once is only built once.
+ *
+ * @code
+ * static SharedStorage<MyTables> sTables;
+ *
+ * void MyPlug::OnReset()
+ * {
+ *   WDL_String key;
+ *   key.SetFormatted(64, "tables-%.0f", GetSampleRate());
+ *   mTables = sTables.FindOrCreate(key.Get(), [this]() { return new MyTables(GetSampleRate()); });
+ * }
+ *
+ * void MyPlug::GetMemoryReport(IMemoryReport& report) const
+ * {
+ *   Plugin::GetMemoryReport(report);
+ *   report.AddShared("Tables", mTables->GetSize(), static_cast<int>(mTables.use_count()));
+ * }
+ * @endcode */
+template <class T>
+class SharedStorage
+{
+public:
+  using Ptr = std::shared_ptr<const T>;
+
+  SharedStorage() {}
+
+  SharedStorage(const SharedStorage&) = delete;
+  SharedStorage& operator=(const SharedStorage&) = delete;
+
+  /** @param key The identifier of the item
+   * @return The item, or nullptr if it isn't stored or is still being created */
+  Ptr Find(const char* key)
+  {
+    std::shared_ptr<DataKey> pKey;
+
+    {
+      WDL_MutexLock lock(&mMutex);
+      pKey = FindKey(key, Hash(key));
+    }
+
+    if (!pKey)
+      return nullptr;
+
+    WDL_MutexLock keyLock(&pKey->mutex);
+    return pKey->data.lock();
+  }
+
+  /** Return the item stored under key, or create and store it if there is none. Waits if another thread is already creating this item
+   * @param key The identifier of the item
+   * @param createFunc Called without arguments to create the item if needed, returning a T* or std::unique_ptr<T> that the storage takes ownership of
+   * @return The item, which is shared with every other caller until the last reference is released */
+  template <class F>
+  Ptr FindOrCreate(const char* key, F createFunc)
+  {
+    std::shared_ptr<DataKey> pKey;
+
+    {
+      WDL_MutexLock lock(&mMutex);
+      RemoveExpired();
+
+      const size_t hashID = Hash(key);
+      pKey = FindKey(key, hashID);
+
+      if (!pKey)
+      {
+        pKey = std::make_shared<DataKey>();
+        pKey->hashID = hashID;
+        pKey->name.Set(key);
+        mDatas.push_back(pKey);
+      }
+    }
+
+    // created under the key's own lock, so that creating one item doesn't hold up lookups of the others
+    WDL_MutexLock keyLock(&pKey->mutex);
+    Ptr pData = pKey->data.lock();
+
+    if (!pData)
+    {
+      pData = Ptr(createFunc());
+
+      // data is written under both locks, so that either is enough to read it
+      WDL_MutexLock lock(&mMutex);
+      pKey->data = pData;
+    }
+
+    return pData;
+  }
+
+  /** @return The number of items that are currently stored */
+  int GetCount()
+  {
+    WDL_MutexLock lock(&mMutex);
+    int count = 0;
+
+    for (auto& pKey : mDatas)
+    {
+      if (!pKey->data.expired())
+        count++;
+    }
+
+    return count;
+  }
+
+  /** @param sizeOf A function that returns the size of an item in bytes
+   * @return The total size of the stored items and their keys in bytes */
+  template <class F>
+  size_t GetMemoryUsage(F sizeOf)
+  {
+    WDL_MutexLock lock(&mMutex);
+    size_t bytes = 0;
+
+    for (auto& pKey : mDatas)
+    {
+      if (Ptr pData = pKey->data.lock())
+        bytes += sizeof(DataKey) + pKey->name.GetLength() + sizeOf(*pData);
+    }
+
+    return bytes;
+  }
+
+private:
+  struct DataKey
+  {
+    // N.B. - hashID is not guaranteed to be unique
+    size_t hashID;
+    WDL_String name;
+    WDL_Mutex mutex;
+    std::weak_ptr<const T> data;
+  };
+
+  size_t Hash(const char* str)
+  {
+    std::string string(str);
+    return std::hash<std::string>()(string);
+  }
+
+  std::shared_ptr<DataKey> FindKey(const char* key, size_t hashID)
+  {
+    for (auto& pKey : mDatas)
+    {
+      // Use the hash id for a quick search and then confirm with the identifier to ensure uniqueness
+      if (pKey->hashID == hashID && !strcmp(key, pKey->name.Get()))
+        return pKey;
+    }
+
+    return nullptr;
+  }
+
+  // forget the keys of items that have been deleted, unless another thread is creating them right now
+  void RemoveExpired()
+  {
+    mDatas.erase(std::remove_if(mDatas.begin(), mDatas.end(), [](const std::shared_ptr<DataKey>& pKey) {
+      return pKey.use_count() == 1 && pKey->data.expired();
+    }), mDatas.end());
+  }
+
+  WDL_Mutex mMutex;
+  std::vector<std::shared_ptr<DataKey>> mDatas;
+};
+
+END_IPLUG_NAMESPACE
@@ -18,6 +18,7 @@
  */
 
 #include <algorithm>
+#include <type_traits>
 #include "wdlstring.h"
 #include "ptrlist.h"
 
@@ -40,7 +41,19 @@ struct ParamTuple
   {}
 };
 
-/** This structure is used when queueing Sysex messages. You may need to set MAX_SYSEX_SIZE to reflect the max sysex payload in bytes */
+/** Used when PARAMS_LOCKFREE is defined, to queue a parameter change made on a non-realtime thread, so that OnParamChange() can be called on the audio thread */
+struct ParamChangeNotification
+{
+  int idx;
+  EParamSource source;
+  
+  ParamChangeNotification(int idx = kNoParameter, EParamSource source = kUnknown)
+  : idx(idx)
+  , source(source)
+  {}
+};
+
+/** A fixed size copy of a Sysex message. You may need to set MAX_SYSEX_SIZE to reflect the max sysex payload in bytes. The queues between threads use IPlugSysExQueue, which has no such limit */
 struct SysExData
 {
   SysExData(int offset = 0, int size = 0, const void* pData = 0)
@@ -107,7 +120,9 @@ struct IByteGetter
   }
 };
   
-/** Manages a block of memory, for plug-in settings store/recall */
+/** Manages a block of memory, for plug-in settings store/recall.
+ * The memory grows geometrically as data is put into the chunk, and Clear() keeps it, so that a chunk which is serialized into repeatedly settles at one allocation.
+ * A chunk can also be a read-only view of memory it doesn't own, see IByteChunkView */
 class IByteChunk : private IByteGetter
 {
 public:
@@ -140,13 +155,39 @@ public:
     return ver;
   }
   
+  /** Make sure the chunk can hold at least this many bytes without reallocating. Call this before serializing a large state, if its size is known
+   * @param capacity The capacity in bytes */
+  inline void Reserve(int capacity)
+  {
+    MakeOwned();
+    
+    if (capacity > mCapacity)
+    {
+      const int n = mBytes.GetSize();
+      mBytes.Resize(capacity, false);
+      mBytes.Resize(n, false);
+      mCapacity = capacity;
+    }
+  }
+  
+  /** @return The number of bytes the chunk can hold without reallocating */
+  inline int GetCapacity() const
+  {
+    return mView ? 0 : mCapacity;
+  }
+  
   /** Copies data into the chunk
    * @param pBuf Pointer to the object to copy data from
    * @param size Number of bytes to copy */
   inline int PutBytes(const void* pBuf, int size)
   {
+    MakeOwned();
     int n = mBytes.GetSize();
-    mBytes.Resize(n + size);
+    
+    if (n + size > mCapacity)
+      Reserve(std::max({n + size, mCapacity * 2, kMinCapacity}));
+    
+    mBytes.Resize(n + size, false);
     memcpy(mBytes.Get() + n, pBuf, size);
     return mBytes.GetSize();
   }
@@ -158,7 +199,7 @@ public:
    * @return int /todo */
   inline int GetBytes(void* pBuf, int size, int startPos) const
   {
-    return IByteGetter::GetBytes(mBytes.Get(), Size(), pBuf, size, startPos);
+    return IByteGetter::GetBytes(GetData(), Size(), pBuf, size, startPos);
   }
   
   /** /todo 
@@ -182,6 +223,29 @@ public:
     return GetBytes(pVal, sizeof(T), startPos);
   }
   
+  /** Copies an array into the chunk with a single copy, rather than a Put() per element
+   * @param pVals The array, of a trivially copyable type
+   * @param nVals The number of elements
+   * @return The new size of the chunk */
+  template <class T>
+  inline int PutArray(const T* pVals, int nVals)
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "PutArray() copies bytes, so T must be trivially copyable");
+    return PutBytes(pVals, nVals * (int) sizeof(T));
+  }
+  
+  /** Copies an array out of the chunk with a single copy, rather than a Get() per element
+   * @param pVals The array to fill, of a trivially copyable type
+   * @param nVals The number of elements
+   * @param startPos The position in the chunk to read from
+   * @return The position after the array, or -1 if the chunk is too short */
+  template <class T>
+  inline int GetArray(T* pVals, int nVals, int startPos) const
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "GetArray() copies bytes, so T must be trivially copyable");
+    return GetBytes(pVals, nVals * (int) sizeof(T), startPos);
+  }
+  
   /** /todo 
    * @param str /todo
    * @return int /todo */
@@ -198,7 +262,7 @@ public:
    * @return int /todo */
   inline int GetStr(WDL_String& str, int startPos) const
   {
-    return IByteGetter::GetStr(mBytes.Get(), Size(), str, startPos);
+    return IByteGetter::GetStr(GetData(), Size(), str, startPos);
   }
   
   /** /todo 
@@ -209,17 +273,19 @@ public:
     return PutBytes(pRHS->GetData(), pRHS->Size());
   }
   
-  /** Clears the chunk */
+  /** Clears the chunk. The memory is kept for the next time the chunk is filled, and a view is detached from the memory it was viewing */
   inline void Clear()
   {
-    mBytes.Resize(0);
+    mView = nullptr;
+    mViewSize = 0;
+    mBytes.Resize(0, false);
   }
   
   /** Returns the current size of the chunk
    * @return Current size (in bytes) */
   inline int Size() const
   {
-    return mBytes.GetSize();
+    return mView ? mViewSize : mBytes.GetSize();
   }
   
   /** Resizes the chunk /todo check
@@ -227,8 +293,10 @@ public:
    * @return Old size (in bytes) */
   inline int Resize(int newSize)
   {
+    MakeOwned();
     int n = mBytes.GetSize();
-    mBytes.Resize(newSize);
+    mBytes.Resize(newSize, false);
+    mCapacity = std::max(mCapacity, newSize);
     if (newSize > n)
     {
       memset(mBytes.Get() + n, 0, (newSize - n));
@@ -236,10 +304,11 @@ public:
     return n;
   }
   
-  /** /todo 
+  /** Writable access to the data. A view copies the memory it views first
    * @return uint8_t* /todo */
   inline uint8_t* GetData()
   {
+    MakeOwned();
     return mBytes.Get();
   }
   
@@ -247,20 +316,49 @@ public:
    * @return const uint8_t* /todo */
   inline const uint8_t* GetData() const
   {
-    return mBytes.Get();
+    return mView ? mView : mBytes.Get();
   }
   
   /** /todo 
    * @param otherChunk /todo
    * @return true /todo
    * @return false /todo */
-  inline bool IsEqual(IByteChunk& otherChunk) const
+  inline bool IsEqual(const IByteChunk& otherChunk) const
   {
-    return (otherChunk.Size() == Size() && !memcmp(otherChunk.mBytes.Get(), mBytes.Get(), Size()));
+    return (otherChunk.Size() == Size() && !memcmp(otherChunk.GetData(), GetData(), Size()));
+  }
+  
+protected:
+  /** Used by IByteChunkView */
+  inline void SetView(const void* pData, int dataSize)
+  {
+    mBytes.Resize(0, false);
+    mView = reinterpret_cast<const uint8_t*>(pData);
+    mViewSize = dataSize;
   }
   
 private:
+  static constexpr int kMinCapacity = 256;
+  
+  /** A view copies the memory it views before it is written to */
+  inline void MakeOwned()
+  {
+    if (mView)
+    {
+      const uint8_t* pView = mView;
+      const int size = mViewSize;
+      mView = nullptr;
+      mViewSize = 0;
+      mBytes.Resize(size, false);
+      memcpy(mBytes.Get(), pView, size);
+      mCapacity = std::max(mCapacity, size);
+    }
+  }
+  
   WDL_TypedBuf<uint8_t> mBytes;
+  int mCapacity = 0;
+  const uint8_t* mView = nullptr;
+  int mViewSize = 0;
 };
 
 /** Manages a non-owned block of memory, for receiving arbitrary message byte streams */
@@ -291,6 +389,14 @@ public:
     return GetBytes(pVal, sizeof(T), startPos);
   }
   
+  /** Copies an array out of the stream with a single copy, see IByteChunk::GetArray() */
+  template <class T>
+  inline int GetArray(T* pVals, int nVals, int startPos) const
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "GetArray() copies bytes, so T must be trivially copyable");
+    return GetBytes(pVals, nVals * (int) sizeof(T), startPos);
+  }
+  
   /** /todo  
    * @param str /todo
    * @param startPos /todo
@@ -328,7 +434,25 @@ private:
   int mSize;
 };
 
+/** A read-only IByteChunk of memory it doesn't own, so that state data provided by a host can be passed to IPluginBase::UnserializeState() without copying it.
+ * The memory must stay valid for as long as the view is used. Writing to a view (e.g. with PutBytes()) copies the memory first */
+class IByteChunkView : public IByteChunk
+{
+public:
+  IByteChunkView(const void* pData, int dataSize)
+  {
+    SetView(pData, dataSize);
+  }
+  
+  explicit IByteChunkView(IByteStream& stream)
+  {
+    SetView(stream.GetData(), stream.Size());
+  }
+};
+
 /** Helper struct to set compile time options to an API class constructor  */
+struct IFixedIORoutines;
+
 struct Config
 {
   int nParams;
@@ -350,6 +474,8 @@ struct Config
   int plugWidth;
   int plugHeight;
   const char* bundleID;
+  /** Conversion routines for the channel layout if it is fixed at compile time, otherwise nullptr, see IPlugFixedIO.h */
+  const IFixedIORoutines* fixedIO = nullptr;
   
   Config(int nParams,
               int nPresets,
@@ -422,6 +548,17 @@ struct IBusInfo
   }
 };
 
+/** The channels of one bus in a block, see IPlugProcessor::ProcessBusBlock(). The channel pointers are the ones passed to ProcessBlock(), nothing is copied */
+struct IBusBuffers
+{
+  /** The bus's channels, or nullptr if the host hasn't connected the bus */
+  sample** mChannels = nullptr;
+  /** The number of channels the host has connected, 0 if the bus is disconnected */
+  int mNChans = 0;
+
+  bool IsConnected() const { return mChannels != nullptr; }
+};
+
 /** An IOConfig is used to store bus info for each input/output configuration defined in the channel io string */
 struct IOConfig
 {
@@ -520,11 +657,29 @@ struct ITimeInfo
   bool mTransportLoopEnabled = false;
 };
 
+/** The smoothed values of a parameter for one ProcessBlock() call, see IPlugProcessor::GetSmoothedBlock() */
+struct ISmoothedBlock
+{
+  /** One value per frame, or nullptr if the parameter has settled and mValue holds for the whole block */
+  const sample* mValues = nullptr;
+  /** The value the parameter has settled on, only valid if IsConstant() */
+  sample mValue = 0.;
+
+  /** @return \c true if every frame has the same value, mValue */
+  bool IsConstant() const { return mValues == nullptr; }
+
+  /** @param s The frame index
+   * @return The value at frame s */
+  sample operator[](int s) const { return mValues ? mValues[s] : mValue; }
+};
+
 /** A struct used for specifying baked-in factory presets */
 struct IPreset
 {
   bool mInitialized = false;
   char mName[MAX_PRESET_NAME_LEN];
+  /** If this is not -1, the name and state are read from this index of the plug-in's IPresetBank, and mName and mChunk are unused */
+  int mBankIdx = -1;
 
   IByteChunk mChunk;
 
@@ -0,0 +1,185 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugSysExQueue
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include "heapbuf.h"
+
+#include "IPlugMidi.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A lock-free SPSC queue of variable length SysEx messages, stored back to back in a ring of bytes.
+ * Each message takes a small header plus its own size, so short messages are cheap and a large dump is only limited by the capacity of the queue.
+ * The bytes of a message are always contiguous, so the consumer can read them in place with Peek() and release them with Pop() */
+class IPlugSysExQueue final
+{
+public:
+  /** @param sizeInBytes The capacity of the queue, including a header of kHeaderSize bytes for each message. A message can use at most half of it */
+  IPlugSysExQueue(int sizeInBytes)
+  {
+    Resize(sizeInBytes);
+  }
+
+  IPlugSysExQueue(const IPlugSysExQueue&) = delete;
+  IPlugSysExQueue& operator=(const IPlugSysExQueue&) = delete;
+
+  /** Empties the queue, so this must not be called while either thread is using it
+   * @param sizeInBytes The capacity of the queue, rounded up to a multiple of twice kHeaderSize */
+  void Resize(int sizeInBytes)
+  {
+    mData.Resize(static_cast<int>(Align(Align(static_cast<size_t>(sizeInBytes)) / 2) * 2));
+    mWriteIndex.store(0, std::memory_order_relaxed);
+    mReadIndex.store(0, std::memory_order_relaxed);
+  }
+
+  /** @return The capacity of the queue in bytes */
+  int GetCapacity() const { return mData.GetSize(); }
+
+  /** @return The size of the queue's storage in bytes */
+  size_t GetMemoryUsage() const { return static_cast<size_t>(mData.GetSize()); }
+
+  /** A message has to fit either before the end of the ring or before the read position, one of which always has space for half of it
+   * @return The size of the largest message that can be pushed into an empty queue, in bytes */
+  int GetMaxMessageSize() const { return GetCapacity() / 2 - kHeaderSize; }
+
+  /** Only call from the producer thread. The bytes are copied into the queue
+   * @param offset The sample offset of the message
+   * @param pData The message bytes
+   * @param size The number of bytes
+   * @return \c true on success, \c false if there was not enough free space */
+  bool Push(int offset, const uint8_t* pData, int size)
+  {
+    if (size < 0 || size > GetMaxMessageSize())
+      return false;
+
+    const size_t capacity = static_cast<size_t>(GetCapacity());
+    const size_t need = kHeaderSize + Align(static_cast<size_t>(size));
+    const size_t writeIndex = mWriteIndex.load(std::memory_order_relaxed);
+    const size_t readIndex = mReadIndex.load(std::memory_order_acquire);
+    size_t msgIndex = writeIndex;
+
+    // the write index must never catch up with the read index, since equal indices mean the queue is empty
+    if (writeIndex >= readIndex)
+    {
+      const size_t toEnd = capacity - writeIndex;
+
+      if (need > toEnd || (need == toEnd && readIndex == 0))
+      {
+        // the message doesn't fit before the end, so mark the rest as unused and start again at the beginning
+        if (need >= readIndex)
+          return false;
+
+        WriteHeader(writeIndex, 0, kWrapMarker);
+        msgIndex = 0;
+      }
+    }
+    else if (need >= readIndex - writeIndex)
+    {
+      return false;
+    }
+
+    WriteHeader(msgIndex, offset, size);
+    memcpy(mData.Get() + msgIndex + kHeaderSize, pData, size);
+
+    const size_t nextIndex = msgIndex + need;
+    mWriteIndex.store(nextIndex == capacity ? 0 : nextIndex, std::memory_order_release);
+    return true;
+  }
+
+  /** Only call from the producer thread. The bytes are copied into the queue
+   * @param msg The message to push
+   * @return \c true on success, \c false if there was not enough free space */
+  bool Push(const ISysEx& msg)
+  {
+    return Push(msg.mOffset, msg.mData, msg.mSize);
+  }
+
+  /** Only call from the consumer thread
+   * @param msg Set to the oldest message, pointing at its bytes inside the queue. They stay valid until Pop() is called
+   * @return \c true on success, \c false if the queue was empty */
+  bool Peek(ISysEx& msg)
+  {
+    size_t readIndex = mReadIndex.load(std::memory_order_relaxed);
+
+    if (readIndex == mWriteIndex.load(std::memory_order_acquire))
+      return false;
+
+    int offset, size;
+    ReadHeader(readIndex, offset, size);
+
+    if (size == kWrapMarker) // the producer only writes a marker when a message follows at the beginning
+    {
+      readIndex = 0;
+      mReadIndex.store(0, std::memory_order_release);
+      ReadHeader(readIndex, offset, size);
+    }
+
+    msg = ISysEx(offset, mData.Get() + readIndex + kHeaderSize, size);
+    return true;
+  }
+
+  /** Only call from the consumer thread. Releases the message returned by the last successful call to Peek() */
+  void Pop()
+  {
+    const size_t readIndex = mReadIndex.load(std::memory_order_relaxed);
+    int offset, size;
+    ReadHeader(readIndex, offset, size);
+
+    const size_t nextIndex = readIndex + kHeaderSize + Align(static_cast<size_t>(size));
+    mReadIndex.store(nextIndex == static_cast<size_t>(GetCapacity()) ? 0 : nextIndex, std::memory_order_release);
+  }
+
+  /** @return \c true if the queue appeared empty */
+  bool WasEmpty() const
+  {
+    return mReadIndex.load(std::memory_order_relaxed) == mWriteIndex.load(std::memory_order_acquire);
+  }
+
+  /** Messages take kHeaderSize bytes plus their size rounded up to a multiple of kHeaderSize */
+  static constexpr int kHeaderSize = 2 * sizeof(int32_t);
+
+private:
+  static constexpr int kWrapMarker = -1;
+
+  static size_t Align(size_t size)
+  {
+    return (size + kHeaderSize - 1) & ~static_cast<size_t>(kHeaderSize - 1);
+  }
+
+  void WriteHeader(size_t index, int offset, int size)
+  {
+    const int32_t header[2] = { static_cast<int32_t>(offset), static_cast<int32_t>(size) };
+    memcpy(mData.Get() + index, header, kHeaderSize);
+  }
+
+  void ReadHeader(size_t index, int& offset, int& size) const
+  {
+    int32_t header[2];
+    memcpy(header, mData.Get() + index, kHeaderSize);
+    offset = header[0];
+    size = header[1];
+  }
+
+  WDL_TypedBuf<uint8_t> mData;
+  std::atomic<size_t> mWriteIndex{0};
+  std::atomic<size_t> mReadIndex{0};
+};
+
+END_IPLUG_NAMESPACE
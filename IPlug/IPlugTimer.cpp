@@ -13,10 +13,193 @@
  * @brief Timer implementation
  */
 
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+
 #include "IPlugTimer.h"
 
 using namespace iplug;
 
+#if !defined OS_WEB
+
+class SharedTimer_impl;
+
+/** Runs the shared timers off one platform timer, see Timer::CreateShared() */
+class TimerScheduler
+{
+public:
+  static TimerScheduler& Get()
+  {
+    // never destroyed, so shared timers can be stopped from static destructors
+    static TimerScheduler* sScheduler = new TimerScheduler();
+    return *sScheduler;
+  }
+
+  void Add(SharedTimer_impl* pTimer);
+  void Remove(SharedTimer_impl* pTimer);
+
+  /** Restart the platform timer at the shortest interval of the running timers, or stop it if there are none */
+  void Update();
+
+  static double Now()
+  {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+private:
+  void OnTick(Timer& t);
+
+  WDL_Mutex mMutex;
+  std::vector<SharedTimer_impl*> mTimers;
+  std::vector<SharedTimer_impl*> mDispatchList; // the timers being called this tick, nulled if they are removed meanwhile
+  std::unique_ptr<Timer> mPlatformTimer;
+  std::unique_ptr<Timer> mRetiredTimer; // a platform timer can't be deleted from its own callback, so the previous one is deleted on the next change
+  uint32_t mTickMs = 0;
+  bool mDispatching = false;
+  bool mUpdatePending = false;
+};
+
+class SharedTimer_impl final : public SharedTimer
+{
+public:
+  SharedTimer_impl(ITimerFunction func, uint32_t intervalMs)
+  : mTimerFunc(func)
+  , mIntervalMs(std::max(intervalMs, 1u))
+  , mNextDue(TimerScheduler::Now() + mIntervalMs)
+  {
+    TimerScheduler::Get().Add(this);
+  }
+
+  ~SharedTimer_impl()
+  {
+    Stop();
+  }
+
+  void Stop() override
+  {
+    if (mRunning)
+    {
+      mRunning = false;
+      TimerScheduler::Get().Remove(this);
+    }
+  }
+
+  void SetPaused(bool paused) override
+  {
+    if (mRunning && paused != mPaused)
+    {
+      mPaused = paused;
+      mNextDue = TimerScheduler::Now() + mIntervalMs;
+      TimerScheduler::Get().Update();
+    }
+  }
+
+private:
+  friend class TimerScheduler;
+
+  ITimerFunction mTimerFunc;
+  uint32_t mIntervalMs;
+  double mNextDue;
+  bool mRunning = true;
+  bool mPaused = false;
+};
+
+void TimerScheduler::Add(SharedTimer_impl* pTimer)
+{
+  WDL_MutexLock lock(&mMutex);
+  mTimers.push_back(pTimer);
+  Update();
+}
+
+void TimerScheduler::Remove(SharedTimer_impl* pTimer)
+{
+  WDL_MutexLock lock(&mMutex);
+  mTimers.erase(std::remove(mTimers.begin(), mTimers.end(), pTimer), mTimers.end());
+
+  if (mDispatching)
+    std::replace(mDispatchList.begin(), mDispatchList.end(), pTimer, static_cast<SharedTimer_impl*>(nullptr));
+
+  Update();
+}
+
+void TimerScheduler::Update()
+{
+  WDL_MutexLock lock(&mMutex);
+
+  // changing the platform timer from its own callback waits until every due timer has been called
+  if (mDispatching)
+  {
+    mUpdatePending = true;
+    return;
+  }
+
+  uint32_t tickMs = 0;
+
+  for (SharedTimer_impl* pTimer : mTimers)
+  {
+    if (!pTimer->mPaused)
+      tickMs = tickMs ? std::min(tickMs, pTimer->mIntervalMs) : pTimer->mIntervalMs;
+  }
+
+  if (tickMs == mTickMs && (mPlatformTimer || !tickMs))
+    return;
+
+  if (mPlatformTimer)
+    mPlatformTimer->Stop();
+
+  mRetiredTimer = std::move(mPlatformTimer);
+  mTickMs = tickMs;
+
+  if (tickMs)
+    mPlatformTimer.reset(Timer::Create(std::bind(&TimerScheduler::OnTick, this, std::placeholders::_1), tickMs));
+}
+
+void TimerScheduler::OnTick(Timer& t)
+{
+  WDL_MutexLock lock(&mMutex);
+
+  if (&t != mPlatformTimer.get())
+    return;
+
+  mRetiredTimer = nullptr;
+
+  const double now = Now();
+  const double horizon = now + mTickMs * 0.5;
+
+  mDispatchList.assign(mTimers.begin(), mTimers.end());
+  mDispatching = true;
+
+  for (size_t i = 0; i < mDispatchList.size(); i++)
+  {
+    SharedTimer_impl* pTimer = mDispatchList[i];
+
+    if (!pTimer || pTimer->mPaused || pTimer->mNextDue > horizon)
+      continue;
+
+    // a timer that fell more than an interval behind, e.g. while the main thread was blocked, is called once rather than catching up
+    pTimer->mNextDue = std::max(pTimer->mNextDue + pTimer->mIntervalMs, now);
+    pTimer->mTimerFunc(*pTimer);
+  }
+
+  mDispatchList.clear();
+  mDispatching = false;
+
+  if (mUpdatePending)
+  {
+    mUpdatePending = false;
+    Update();
+  }
+}
+
+SharedTimer* Timer::CreateShared(ITimerFunction func, uint32_t intervalMs)
+{
+  return new SharedTimer_impl(func, intervalMs);
+}
+
+#endif
+
 #if defined OS_MAC || defined OS_IOS
 
 Timer* Timer::Create(ITimerFunction func, uint32_t intervalMs)
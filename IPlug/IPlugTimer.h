@@ -34,6 +34,8 @@
 BEGIN_IPLUG_NAMESPACE
 
 #if defined OS_WEB
+struct SharedTimer;
+
 /** Base class for timer */
 struct Timer
 {
@@ -47,12 +49,29 @@ struct Timer
   {
     return new Timer();
   }
+
+  static SharedTimer* CreateShared(ITimerFunction func, uint32_t intervalMs);
   
   void Stop()
   {
   }
 };
+
+/** A timer made by Timer::CreateShared(). Like the other web timers it is never called, so pausing it does nothing */
+struct SharedTimer : public Timer
+{
+  void SetPaused(bool paused)
+  {
+  }
+};
+
+inline SharedTimer* Timer::CreateShared(ITimerFunction func, uint32_t intervalMs)
+{
+  return new SharedTimer();
+}
 #else
+struct SharedTimer;
+
 /** Base class for timer */
 struct Timer
 {
@@ -63,9 +82,26 @@ struct Timer
   using ITimerFunction = std::function<void(Timer& t)>;
 
   static Timer* Create(ITimerFunction func, uint32_t intervalMs);
+
+  /** Create a timer that shares one platform timer with the other shared timers in the process, instead of waking the main thread itself.
+   * The platform timer runs at the shortest interval of the shared timers that are running, and each tick calls the timers that are due
+   * within half a tick, so a timer whose interval is not a multiple of the tick is called early rather than late but keeps its average rate
+   * @param func Called on the main thread
+   * @param intervalMs The interval between calls in milliseconds
+   * @return The timer, which the caller owns */
+  static SharedTimer* CreateShared(ITimerFunction func, uint32_t intervalMs);
+
   virtual ~Timer() {};
   virtual void Stop() = 0;
 };
+
+/** A timer made by Timer::CreateShared() */
+struct SharedTimer : public Timer
+{
+  /** A paused timer is not called, but keeps its place. While every shared timer is paused or stopped the platform timer is stopped too
+   * @param paused \c true to pause the timer, \c false to resume it, with its next call one interval later */
+  virtual void SetPaused(bool paused) = 0;
+};
 #endif
 
 #if defined OS_MAC || defined OS_IOS
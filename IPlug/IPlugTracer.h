@@ -0,0 +1,626 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc ITracer
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "IPlugLogger.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** One call to Trace(), or one ITraceScope, stored in binary form to be formatted later by the flusher thread.
+ * The function name and format string must be string literals (or otherwise outlive the tracer), string arguments are copied */
+struct ITraceRecord
+{
+  static constexpr int kMaxArgs = 12;
+  static constexpr int kStringBytes = 112;
+
+  enum EKind : uint8_t
+  {
+    kLog,   // a Trace() call
+    kScope  // an ITraceScope: mFuncName is the category, mFormat the name and mDuration is valid. An optional kInt argument is the value
+  };
+
+  enum EArgType : uint8_t
+  {
+    kInt,
+    kUInt,
+    kDouble,
+    kPointer,
+    kString // the value is an offset into mStrings
+  };
+
+  uint64_t mTime;         // nanoseconds since the tracer started
+  uint64_t mDuration;     // nanoseconds, kScope only
+  const char* mFuncName;  // together with mLine and mFormat, this identifies the call site
+  const char* mFormat;
+  int32_t mLine;
+  uint16_t mThread;       // ordinal thread ID, the index of the thread's ring
+  uint8_t mNArgs;
+  uint8_t mStringBytesUsed;
+  EKind mKind;
+  EArgType mArgTypes[kMaxArgs];
+  uint64_t mArgs[kMaxArgs];
+  char mStrings[kStringBytes];
+
+  void AddArg(EArgType type, uint64_t value)
+  {
+    if (mNArgs < kMaxArgs)
+    {
+      mArgTypes[mNArgs] = type;
+      mArgs[mNArgs++] = value;
+    }
+  }
+
+  void AddString(const char* str)
+  {
+    if (!str)
+      str = "(null)";
+
+    // strings that don't fit in what's left are truncated
+    const int avail = kStringBytes - mStringBytesUsed;
+    const int len = avail > 0 ? std::min(static_cast<int>(strlen(str)), avail - 1) : -1;
+
+    if (len < 0)
+    {
+      AddArg(kString, kStringBytes - 1); // the last byte is always a terminator
+      return;
+    }
+
+    memcpy(mStrings + mStringBytesUsed, str, len);
+    mStrings[mStringBytesUsed + len] = '\0';
+    AddArg(kString, mStringBytesUsed);
+    mStringBytesUsed += len + 1;
+  }
+
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type Add(T value)
+  {
+    if (std::is_signed<T>::value)
+      AddArg(kInt, static_cast<uint64_t>(static_cast<int64_t>(value)));
+    else
+      AddArg(kUInt, static_cast<uint64_t>(value));
+  }
+
+  template <typename T>
+  typename std::enable_if<std::is_floating_point<T>::value>::type Add(T value)
+  {
+    double d = static_cast<double>(value);
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    AddArg(kDouble, bits);
+  }
+
+  void Add(const char* str) { AddString(str); }
+  void Add(char* str) { AddString(str); }
+  void Add(const void* ptr) { AddArg(kPointer, static_cast<uint64_t>(reinterpret_cast<uintptr_t>(ptr))); }
+  void Add(std::nullptr_t) { Add(static_cast<const void*>(nullptr)); }
+
+  void AddAll() {}
+
+  template <typename T, typename... Rest>
+  void AddAll(T first, Rest... rest)
+  {
+    Add(first);
+    AddAll(rest...);
+  }
+
+  /** Formats the record the way vsnprintf() would have at the call site. Called by the flusher thread
+   * @param out Where to write, always null terminated
+   * @param outSize The size of out in bytes */
+  void Format(char* out, int outSize) const
+  {
+    int pos = 0;
+    int argIdx = 0;
+    const char* f = mFormat;
+
+    auto append = [&](const char* str, int len) {
+      len = std::min(len, outSize - 1 - pos);
+      if (len > 0)
+      {
+        memcpy(out + pos, str, len);
+        pos += len;
+      }
+    };
+
+    while (*f && pos < outSize - 1)
+    {
+      if (*f != '%')
+      {
+        const char* next = strchr(f, '%');
+        const int len = next ? static_cast<int>(next - f) : static_cast<int>(strlen(f));
+        append(f, len);
+        f += len;
+        continue;
+      }
+
+      if (f[1] == '%')
+      {
+        append("%", 1);
+        f += 2;
+        continue;
+      }
+
+      // copy flags, width and precision, dropping any length modifier since the arguments are stored as 64 bit values
+      char spec[32] = "%";
+      int specLen = 1;
+      const char* s = f + 1;
+
+      while (*s && strchr("-+ #0123456789.*", *s) && specLen < 24)
+        spec[specLen++] = *s++;
+
+      while (*s && strchr("hljztL", *s))
+        s++;
+
+      const char conv = *s ? *s++ : 0;
+      f = s;
+
+      char buf[128];
+      int len = 0;
+
+      if (conv == 0 || strchr(spec, '*') || argIdx >= mNArgs)
+      {
+        len = snprintf(buf, sizeof(buf), "?");
+      }
+      else
+      {
+        const EArgType type = mArgTypes[argIdx];
+        const uint64_t value = mArgs[argIdx++];
+
+        switch (conv)
+        {
+          case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+          {
+            if (type == kDouble || type == kString)
+            {
+              len = snprintf(buf, sizeof(buf), "?");
+              break;
+            }
+
+            if (conv == 'c')
+            {
+              spec[specLen++] = 'c';
+              spec[specLen] = '\0';
+              len = snprintf(buf, sizeof(buf), spec, static_cast<int>(value));
+            }
+            else
+            {
+              spec[specLen++] = 'l';
+              spec[specLen++] = 'l';
+              spec[specLen++] = conv;
+              spec[specLen] = '\0';
+
+              if (conv == 'd' || conv == 'i')
+                len = snprintf(buf, sizeof(buf), spec, static_cast<long long>(value));
+              else
+                len = snprintf(buf, sizeof(buf), spec, static_cast<unsigned long long>(value));
+            }
+            break;
+          }
+          case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+          {
+            double d = 0.;
+
+            if (type == kDouble)
+              memcpy(&d, &value, sizeof(d));
+            else if (type == kInt)
+              d = static_cast<double>(static_cast<int64_t>(value));
+            else if (type == kUInt)
+              d = static_cast<double>(value);
+
+            spec[specLen++] = conv;
+            spec[specLen] = '\0';
+            len = snprintf(buf, sizeof(buf), spec, d);
+            break;
+          }
+          case 's':
+          {
+            spec[specLen++] = 's';
+            spec[specLen] = '\0';
+            len = snprintf(buf, sizeof(buf), spec, type == kString ? mStrings + value : "?");
+            break;
+          }
+          case 'p':
+          {
+            len = snprintf(buf, sizeof(buf), "%p", reinterpret_cast<void*>(static_cast<uintptr_t>(value)));
+            break;
+          }
+          default:
+            len = snprintf(buf, sizeof(buf), "?");
+            break;
+        }
+      }
+
+      append(buf, std::min(len, static_cast<int>(sizeof(buf)) - 1));
+    }
+
+    out[pos] = '\0';
+  }
+};
+
+/** A single producer, single consumer ring of trace records, one per thread that traces */
+class ITraceRing final
+{
+public:
+  static constexpr int kNumRecords = 1024; // must be a power of two
+
+  ITraceRing()
+  : mRecords(kNumRecords)
+  {
+  }
+
+  ITraceRing(const ITraceRing&) = delete;
+  ITraceRing& operator=(const ITraceRing&) = delete;
+
+  /** Producer: @return A record to fill in, or nullptr if the ring is full, in which case the record is counted as dropped */
+  ITraceRecord* BeginWrite()
+  {
+    const uint32_t writePos = mWritePos.load(std::memory_order_relaxed);
+
+    if (writePos - mReadPos.load(std::memory_order_acquire) >= kNumRecords)
+    {
+      mDropped.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    return &mRecords[writePos & (kNumRecords - 1)];
+  }
+
+  /** Producer: publish the record returned by BeginWrite() */
+  void EndWrite()
+  {
+    mWritePos.store(mWritePos.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  /** Consumer: copy every available record to dest
+   * @return The number of records dropped since the last call */
+  uint32_t Drain(std::vector<ITraceRecord>& dest)
+  {
+    uint32_t readPos = mReadPos.load(std::memory_order_relaxed);
+    const uint32_t writePos = mWritePos.load(std::memory_order_acquire);
+
+    for (; readPos != writePos; readPos++)
+      dest.push_back(mRecords[readPos & (kNumRecords - 1)]);
+
+    mReadPos.store(readPos, std::memory_order_release);
+    return mDropped.exchange(0, std::memory_order_relaxed);
+  }
+
+private:
+  std::vector<ITraceRecord> mRecords;
+  std::atomic<uint32_t> mWritePos{0};
+  std::atomic<uint32_t> mReadPos{0};
+  std::atomic<uint32_t> mDropped{0};
+};
+
+/** Records Trace() calls and ITraceScope timings into per-thread lock-free rings of binary records, so tracing costs a timestamp and a few copies at the call site.
+ * A background thread formats the Trace() records and writes them to the log file, or to stdout if TRACETOSTDOUT is defined. It also writes every record to
+ * CHROME_TRACE_FILE in the Chrome trace event format, which can be opened in chrome://tracing or https://ui.perfetto.dev to see audio blocks and UI frames on one timeline.
+ * The rings for kMaxThreads threads are allocated up front, so the first trace on the audio thread doesn't allocate */
+class ITracer final
+{
+public:
+  static constexpr int kMaxThreads = 32;
+  static constexpr int kFlushIntervalMs = 20;
+
+  /** @return The tracer, created and started on first use */
+  static ITracer& Get()
+  {
+    static ITracer sTracer;
+    return sTracer;
+  }
+
+  ITracer(const ITracer&) = delete;
+  ITracer& operator=(const ITracer&) = delete;
+
+  ~ITracer()
+  {
+    mRunning = false;
+
+    if (mFlushThread.joinable())
+      mFlushThread.join();
+
+    Flush();
+
+    fprintf(mChromeFile.mFP, "\n]\n");
+  }
+
+  /** Realtime safe, apart from the first call on each thread, which claims a ring with one atomic increment */
+  template <typename... Args>
+  void Record(const char* funcName, int line, const char* format, Args... args)
+  {
+    ITraceRing* pRing = GetThreadRing();
+
+    if (!pRing)
+    {
+      mDroppedNoRing.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    ITraceRecord* pRecord = pRing->BeginWrite();
+
+    if (!pRecord)
+      return;
+
+    pRecord->mTime = GetTime();
+    pRecord->mDuration = 0;
+    pRecord->mKind = ITraceRecord::kLog;
+    pRecord->mFuncName = funcName;
+    pRecord->mFormat = format;
+    pRecord->mLine = line;
+    pRecord->mThread = static_cast<uint16_t>(ThreadIndex());
+    pRecord->mNArgs = 0;
+    pRecord->mStringBytesUsed = 0;
+    pRecord->AddAll(args...);
+    pRing->EndWrite();
+  }
+
+  static constexpr int64_t kNoScopeValue = INT64_MIN;
+
+  /** Realtime safe. Record a slice of time on the calling thread's timeline, see ITraceScope
+   * @param category Groups slices in the trace viewer, e.g. "audio" or "ui". Must be a string literal
+   * @param name Must be a string literal, or otherwise outlive the tracer
+   * @param startTime From GetTime()
+   * @param endTime From GetTime()
+   * @param value Added to the slice's arguments, unless it is kNoScopeValue */
+  void RecordScope(const char* category, const char* name, uint64_t startTime, uint64_t endTime, int64_t value)
+  {
+    ITraceRing* pRing = GetThreadRing();
+
+    if (!pRing)
+    {
+      mDroppedNoRing.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    ITraceRecord* pRecord = pRing->BeginWrite();
+
+    if (!pRecord)
+      return;
+
+    pRecord->mTime = startTime;
+    pRecord->mDuration = endTime - startTime;
+    pRecord->mKind = ITraceRecord::kScope;
+    pRecord->mFuncName = category;
+    pRecord->mFormat = name;
+    pRecord->mLine = 0;
+    pRecord->mThread = static_cast<uint16_t>(ThreadIndex());
+    pRecord->mNArgs = 0;
+    pRecord->mStringBytesUsed = 0;
+
+    if (value != kNoScopeValue)
+      pRecord->Add(value);
+
+    pRing->EndWrite();
+  }
+
+  /** @return nanoseconds since the tracer started, the timebase of ITraceRecord::mTime */
+  uint64_t GetTime() const
+  {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - mStartTime).count());
+  }
+
+  /** @return The calling thread's ordinal ID, 0 for the first thread that traced, or -1 if there were more than kMaxThreads */
+  int GetThreadIndex()
+  {
+    GetThreadRing();
+    return ThreadIndex();
+  }
+
+  /** Format and write everything recorded so far. Normally called by the flusher thread, but can be called from anywhere except the audio thread */
+  void Flush()
+  {
+    WDL_MutexLock lock(&mFlushMutex);
+
+    mPending.clear();
+    const int nRings = std::min(mNumRings.load(std::memory_order_acquire), static_cast<int>(kMaxThreads));
+
+    for (auto i = 0; i < nRings; i++)
+    {
+      const uint32_t dropped = mRings[i].Drain(mPending);
+
+      if (dropped)
+        fprintf(mFP, "**************** %u RECORDS DROPPED ON THREAD %d, THE TRACE RING WAS FULL ****************\n", dropped, i);
+    }
+
+    const uint32_t droppedNoRing = mDroppedNoRing.exchange(0, std::memory_order_relaxed);
+
+    if (droppedNoRing)
+      fprintf(mFP, "**************** %u RECORDS DROPPED, MORE THAN %d THREADS TRACED ****************\n", droppedNoRing, kMaxThreads);
+
+    // each ring is already in order, this interleaves the threads
+    std::stable_sort(mPending.begin(), mPending.end(), [](const ITraceRecord& a, const ITraceRecord& b) { return a.mTime < b.mTime; });
+
+    char str[1024];
+
+    for (const ITraceRecord& record : mPending)
+    {
+      WriteChromeEvent(record, str, sizeof(str));
+
+      if (record.mKind != ITraceRecord::kLog)
+        continue;
+
+      record.Format(str, sizeof(str));
+
+      if (record.mThread > 0)
+        fprintf(mFP, "*** -");
+
+      fprintf(mFP, "[%d:%s:%d:%.3fms]%s", record.mThread, record.mFuncName, record.mLine, record.mTime / 1e6, str);
+
+      const size_t len = strlen(str);
+      if (!len || str[len - 1] != '\n')
+        fprintf(mFP, "\n");
+    }
+
+    if (!mPending.empty())
+    {
+      fflush(mFP);
+      fflush(mChromeFile.mFP);
+    }
+  }
+
+private:
+  ITracer()
+  : mStartTime(std::chrono::steady_clock::now())
+  , mChromeFile(CHROME_TRACE_FILE)
+  , mRings(kMaxThreads)
+  {
+    // the JSON array format. Viewers also accept a file without the closing bracket, if the process doesn't exit cleanly
+    fprintf(mChromeFile.mFP, "[\n");
+
+    mPending.reserve(kMaxThreads * ITraceRing::kNumRecords);
+
+#ifdef TRACETOSTDOUT
+    mFP = stdout;
+#else
+    mFP = mLogFile.mFP;
+#endif
+
+    mRunning = true;
+    mFlushThread = std::thread([this]() {
+      while (mRunning)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(kFlushIntervalMs)));
+        Flush();
+      }
+    });
+  }
+
+  /** Write str as the contents of a JSON string */
+  static void WriteJSONString(FILE* fp, const char* str)
+  {
+    for (; *str; str++)
+    {
+      const unsigned char c = static_cast<unsigned char>(*str);
+
+      if (c == '"' || c == '\\')
+        fprintf(fp, "\\%c", c);
+      else if (c < 0x20)
+        fprintf(fp, "\\u%04x", c);
+      else
+        fputc(c, fp);
+    }
+  }
+
+  /** Scopes become complete ("X") events and Trace() calls become instant ("i") events, with the formatted message as an argument.
+   * Timestamps are in microseconds */
+  void WriteChromeEvent(const ITraceRecord& record, char* str, int strSize)
+  {
+    FILE* fp = mChromeFile.mFP;
+
+    fprintf(fp, "%s{\"name\":\"", mNumChromeEvents++ ? ",\n" : "");
+
+    if (record.mKind == ITraceRecord::kScope)
+    {
+      WriteJSONString(fp, record.mFormat);
+      fprintf(fp, "\",\"cat\":\"");
+      WriteJSONString(fp, record.mFuncName);
+      fprintf(fp, "\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d", record.mTime / 1e3, record.mDuration / 1e3, record.mThread);
+
+      if (record.mNArgs)
+        fprintf(fp, ",\"args\":{\"value\":%lld}", static_cast<long long>(record.mArgs[0]));
+    }
+    else
+    {
+      record.Format(str, strSize);
+      WriteJSONString(fp, record.mFuncName);
+      fprintf(fp, "\",\"cat\":\"log\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"line\":%d,\"msg\":\"", record.mTime / 1e3, record.mThread, record.mLine);
+      WriteJSONString(fp, str);
+      fprintf(fp, "\"}");
+    }
+
+    fprintf(fp, "}");
+  }
+
+  static int& ThreadIndex()
+  {
+    static thread_local int sIndex = -2; // -2: not claimed yet, -1: no ring was left
+    return sIndex;
+  }
+
+  ITraceRing* GetThreadRing()
+  {
+    int& idx = ThreadIndex();
+
+    if (idx == -2)
+    {
+      const int claimed = mNumRings.fetch_add(1, std::memory_order_acq_rel);
+      idx = claimed < kMaxThreads ? claimed : -1;
+    }
+
+    return idx >= 0 ? &mRings[idx] : nullptr;
+  }
+
+  const std::chrono::steady_clock::time_point mStartTime;
+#ifndef TRACETOSTDOUT
+  LogFile mLogFile;
+#endif
+  FILE* mFP = nullptr;
+  LogFile mChromeFile;
+  uint64_t mNumChromeEvents = 0;
+  std::vector<ITraceRing> mRings;
+  std::atomic<int> mNumRings{0};
+  std::atomic<uint32_t> mDroppedNoRing{0};
+  std::vector<ITraceRecord> mPending;
+  WDL_Mutex mFlushMutex;
+  std::atomic<bool> mRunning{false};
+  std::thread mFlushThread;
+};
+
+/** Times its own lifetime and records it as a slice with ITracer::RecordScope(). Use it through the TRACE_SCOPE() and TRACE_SCOPE_VALUE() macros,
+ * which compile to nothing unless TRACER_BUILD is defined */
+class ITraceScope final
+{
+public:
+  ITraceScope(const char* category, const char* name, int64_t value = ITracer::kNoScopeValue)
+  : mCategory(category)
+  , mName(name)
+  , mValue(value)
+  , mStartTime(ITracer::Get().GetTime())
+  {
+  }
+
+  ~ITraceScope()
+  {
+    ITracer& tracer = ITracer::Get();
+    tracer.RecordScope(mCategory, mName, mStartTime, tracer.GetTime(), mValue);
+  }
+
+  ITraceScope(const ITraceScope&) = delete;
+  ITraceScope& operator=(const ITraceScope&) = delete;
+
+private:
+  const char* mCategory;
+  const char* mName;
+  int64_t mValue;
+  uint64_t mStartTime;
+};
+
+template <typename... Args>
+static void Trace(const char* funcName, int line, const char* format, Args... args)
+{
+  ITracer::Get().Record(funcName, line, format, args...);
+}
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,92 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc ITripleBuffer
+ */
+
+#include <atomic>
+#include <cstdint>
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A lock-free triple buffer, to pass the latest state from one thread to another when older states can be skipped, e.g. spectrum frames from the audio thread to the UI.
+ * The writer and the reader each own a buffer, and swap it with the third whenever they write or read. Neither ever waits, and the reader always gets the newest complete state */
+template<typename T>
+class ITripleBuffer final
+{
+public:
+  ITripleBuffer() = default;
+
+  /** @param initialValue The value all three buffers start with */
+  ITripleBuffer(const T& initialValue)
+  {
+    for (auto i = 0; i < 3; i++)
+      mBuffers[i] = initialValue;
+  }
+
+  ITripleBuffer(const ITripleBuffer&) = delete;
+  ITripleBuffer& operator=(const ITripleBuffer&) = delete;
+
+  /** Writer thread: @return The writer's buffer, to fill in place before calling Publish() */
+  T& GetWriteBuffer() { return mBuffers[mWriteIdx]; }
+
+  /** Writer thread: make the write buffer the newest state, and take another buffer to write into next. Its contents are stale */
+  void Publish()
+  {
+    mWriteIdx = mMiddle.exchange(static_cast<uint8_t>(mWriteIdx | kNewBit), std::memory_order_acq_rel) & kIndexMask;
+  }
+
+  /** Writer thread: copy in and publish a new state */
+  void Write(const T& value)
+  {
+    GetWriteBuffer() = value;
+    Publish();
+  }
+
+  /** Reader thread: take the newest state, if there is one that we have not read
+   * @return \c true if GetReadBuffer() changed */
+  bool Update()
+  {
+    if (!(mMiddle.load(std::memory_order_relaxed) & kNewBit))
+      return false;
+
+    mReadIdx = mMiddle.exchange(mReadIdx, std::memory_order_acq_rel) & kIndexMask;
+    return true;
+  }
+
+  /** Reader thread: @return The state from the last successful Update(), which the writer will not touch */
+  const T& GetReadBuffer() const { return mBuffers[mReadIdx]; }
+
+  /** Reader thread: copy out the newest state, if there is one that we have not read
+   * @return \c true if value was set */
+  bool Read(T& value)
+  {
+    if (!Update())
+      return false;
+
+    value = GetReadBuffer();
+    return true;
+  }
+
+private:
+  static constexpr uint8_t kIndexMask = 0x3;
+  static constexpr uint8_t kNewBit = 0x4; // set on the middle buffer when the writer has published it and the reader has not taken it
+
+  T mBuffers[3] {};
+  uint8_t mWriteIdx = 0;
+  uint8_t mReadIdx = 1;
+  std::atomic<uint8_t> mMiddle{2};
+};
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,256 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugUndoHistory
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "IPlugStructs.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A bounded undo history of plug-in edits, which stores what each edit changed rather than a copy of the whole state.
+ * A parameter edit is stored as the parameter's value before and after it, collapsed over a gesture, so that a knob drag is one step however many values
+ * it sent. Gestures that overlap, e.g. on the two parameters of an XY pad, make one step. An edit of custom state is stored as the bytes of the serialized
+ * state that differ before and after it, so a small change to a large state costs a few bytes.
+ * The oldest steps are dropped when there are more than the maximum number, or when they take more than the maximum memory. Use it on the main thread only */
+class IPlugUndoHistory final
+{
+public:
+  struct ParamDelta
+  {
+    int mParamIdx;
+    double mOldValue; // non-normalized
+    double mNewValue;
+  };
+
+  /** One undoable edit, either parameter changes or a change of the serialized state */
+  struct Step
+  {
+    std::vector<ParamDelta> mParams;
+    bool mIsState = false;
+    // the state before and after the edit share mPrefix bytes at the start and mSuffix bytes at the end, and differ by mOldBytes and mNewBytes between them
+    int mPrefix = 0;
+    int mSuffix = 0;
+    std::vector<uint8_t> mOldBytes;
+    std::vector<uint8_t> mNewBytes;
+
+    size_t GetMemoryUsage() const { return sizeof(Step) + mParams.capacity() * sizeof(ParamDelta) + mOldBytes.capacity() + mNewBytes.capacity(); }
+  };
+
+  /** @param maxSteps The most steps to keep, 0 to keep none
+   * @param maxBytes The most memory the steps can take, although the latest step is always kept */
+  IPlugUndoHistory(int maxSteps = 0, size_t maxBytes = 0)
+  {
+    SetLimits(maxSteps, maxBytes);
+  }
+
+  IPlugUndoHistory(const IPlugUndoHistory&) = delete;
+  IPlugUndoHistory& operator=(const IPlugUndoHistory&) = delete;
+
+  /** Set the size of the history, dropping the oldest steps if it is now too small
+   * @param maxSteps The most steps to keep, 0 to disable the history
+   * @param maxBytes The most memory the steps can take */
+  void SetLimits(int maxSteps, size_t maxBytes)
+  {
+    mMaxSteps = std::max(maxSteps, 0);
+    mMaxBytes = maxBytes;
+    Trim();
+  }
+
+  /** @return \c true if steps are recorded */
+  bool IsEnabled() const { return mMaxSteps > 0; }
+
+  /** Remove all steps, e.g. when a preset is loaded or the host restores the state */
+  void Clear()
+  {
+    mSteps.clear();
+    mNDone = 0;
+    mBytes = 0;
+    mGestures.clear();
+    mPending = Step();
+  }
+
+  bool CanUndo() const { return mNDone > 0; }
+  bool CanRedo() const { return mNDone < static_cast<int>(mSteps.size()); }
+
+  /** @return The step that Undo() would revert, or nullptr */
+  const Step* GetUndoStep() const { return CanUndo() ? &mSteps[mNDone - 1] : nullptr; }
+
+  /** @return The step that Redo() would apply, or nullptr */
+  const Step* GetRedoStep() const { return CanRedo() ? &mSteps[mNDone] : nullptr; }
+
+  /** Move back past the step returned by GetUndoStep(), once it has been reverted */
+  void StepBack() { if (CanUndo()) mNDone--; }
+
+  /** Move forward past the step returned by GetRedoStep(), once it has been applied */
+  void StepForward() { if (CanRedo()) mNDone++; }
+
+  /** @return The memory taken by the steps, in bytes */
+  size_t GetMemoryUsage() const { return mBytes; }
+
+  /** Called when a gesture on a parameter starts
+   * @param paramIdx The parameter
+   * @param value Its non-normalized value before the gesture */
+  void BeginParamGesture(int paramIdx, double value)
+  {
+    if (!IsEnabled())
+      return;
+
+    for (auto& gesture : mGestures)
+    {
+      if (gesture.mParamIdx == paramIdx)
+        return;
+    }
+
+    mGestures.push_back({paramIdx, value, value});
+  }
+
+  /** Called when a gesture on a parameter ends. The step is recorded once no gesture is in progress
+   * @param paramIdx The parameter
+   * @param value Its non-normalized value after the gesture */
+  void EndParamGesture(int paramIdx, double value)
+  {
+    auto it = std::find_if(mGestures.begin(), mGestures.end(), [paramIdx](const ParamDelta& d) { return d.mParamIdx == paramIdx; });
+
+    if (it == mGestures.end())
+      return;
+
+    const double oldValue = it->mOldValue;
+    mGestures.erase(it);
+
+    auto pending = std::find_if(mPending.mParams.begin(), mPending.mParams.end(), [paramIdx](const ParamDelta& d) { return d.mParamIdx == paramIdx; });
+
+    if (pending != mPending.mParams.end())
+      pending->mNewValue = value;
+    else
+      mPending.mParams.push_back({paramIdx, oldValue, value});
+
+    if (!mGestures.empty())
+      return;
+
+    // a gesture that ends where it started, e.g. a click on a knob, isn't a step
+    auto& params = mPending.mParams;
+    params.erase(std::remove_if(params.begin(), params.end(), [](const ParamDelta& d) { return d.mOldValue == d.mNewValue; }), params.end());
+
+    if (!params.empty())
+      Push(std::move(mPending));
+
+    mPending = Step();
+  }
+
+  /** Record an edit of the serialized state as the bytes that differ
+   * @param before The state before the edit
+   * @param after The state after the edit */
+  void AddStateChange(const IByteChunk& before, const IByteChunk& after)
+  {
+    if (!IsEnabled())
+      return;
+
+    const uint8_t* pOld = before.GetData();
+    const uint8_t* pNew = after.GetData();
+    const int oldSize = before.Size();
+    const int newSize = after.Size();
+    const int minSize = std::min(oldSize, newSize);
+
+    int prefix = 0;
+
+    while (prefix < minSize && pOld[prefix] == pNew[prefix])
+      prefix++;
+
+    if (prefix == oldSize && prefix == newSize)
+      return;
+
+    int suffix = 0;
+
+    while (suffix < minSize - prefix && pOld[oldSize - 1 - suffix] == pNew[newSize - 1 - suffix])
+      suffix++;
+
+    Step step;
+    step.mIsState = true;
+    step.mPrefix = prefix;
+    step.mSuffix = suffix;
+    step.mOldBytes.assign(pOld + prefix, pOld + oldSize - suffix);
+    step.mNewBytes.assign(pNew + prefix, pNew + newSize - suffix);
+    Push(std::move(step));
+  }
+
+  /** Rebuild the state on one side of a state step from the state on the other
+   * @param step The step
+   * @param current The current state, which is the state after the step when undoing and before it when redoing
+   * @param undo \c true to rebuild the state before the step, \c false to rebuild the state after it
+   * @param result Filled with the rebuilt state
+   * @return \c false if current can't be the state on that side of the step, e.g. because the state was changed without being recorded */
+  static bool ApplyStateStep(const Step& step, const IByteChunk& current, bool undo, IByteChunk& result)
+  {
+    const std::vector<uint8_t>& from = undo ? step.mNewBytes : step.mOldBytes;
+    const std::vector<uint8_t>& to = undo ? step.mOldBytes : step.mNewBytes;
+    const int size = current.Size();
+
+    if (size != step.mPrefix + static_cast<int>(from.size()) + step.mSuffix)
+      return false;
+
+    const uint8_t* pCurrent = current.GetData();
+
+    if (!std::equal(from.begin(), from.end(), pCurrent + step.mPrefix))
+      return false;
+
+    result.Clear();
+    result.PutBytes(pCurrent, step.mPrefix);
+    result.PutBytes(to.data(), static_cast<int>(to.size()));
+    result.PutBytes(pCurrent + size - step.mSuffix, step.mSuffix);
+    return true;
+  }
+
+private:
+  void Push(Step&& step)
+  {
+    // a new step discards the steps that were undone
+    while (CanRedo())
+    {
+      mBytes -= mSteps.back().GetMemoryUsage();
+      mSteps.pop_back();
+    }
+
+    step.mParams.shrink_to_fit();
+    mBytes += step.GetMemoryUsage();
+    mSteps.push_back(std::move(step));
+    mNDone = static_cast<int>(mSteps.size());
+    Trim();
+  }
+
+  void Trim()
+  {
+    while (!mSteps.empty() && (static_cast<int>(mSteps.size()) > mMaxSteps || (mBytes > mMaxBytes && mSteps.size() > 1)))
+    {
+      mBytes -= mSteps.front().GetMemoryUsage();
+      mSteps.pop_front();
+      mNDone = std::max(mNDone - 1, 0);
+    }
+  }
+
+  int mMaxSteps = 0;
+  size_t mMaxBytes = 0;
+  std::deque<Step> mSteps; // oldest first
+  int mNDone = 0; // the steps before this have been done, the rest have been undone
+  size_t mBytes = 0;
+  std::vector<ParamDelta> mGestures; // the gestures in progress, with the value each started from
+  Step mPending; // the deltas of the gestures that have ended while others are in progress
+};
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,525 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IWorkerPool
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+#include "IPlugPlatform.h"
+
+#if defined OS_WIN
+  #include <windows.h>
+#elif defined OS_MAC || defined OS_IOS
+  #include <mach/mach.h>
+  #include <mach/mach_time.h>
+  #include <mach/semaphore.h>
+  #include <mach/thread_policy.h>
+  #include <os/workgroup.h>
+#elif defined OS_LINUX
+  #include <pthread.h>
+  #include <sched.h>
+  #include <semaphore.h>
+#endif
+
+#if defined _M_X64 || defined _M_IX86 || defined __x86_64__ || defined __i386__
+  #include <xmmintrin.h>
+#elif defined _M_ARM64 || defined _M_ARM
+  #include <intrin.h>
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Tell the CPU that the calling thread is busy waiting for another one, so that it backs off, saving power and leaving more of a shared
+ * core to the thread that is doing the work. Call it on each iteration of a spin loop */
+inline void SpinPause()
+{
+#if defined _M_X64 || defined _M_IX86 || defined __x86_64__ || defined __i386__
+  _mm_pause();
+#elif defined _M_ARM64 || defined _M_ARM
+  __yield();
+#elif defined __aarch64__ || defined __arm__
+  __asm__ __volatile__("yield");
+#endif
+}
+
+/** The audio workgroup of the host, on macOS 11 and iOS 14 or later. On Apple silicon, threads that aren't in the workgroup of the thread
+ * waiting for their results can be scheduled on efficiency cores, and miss deadlines. The plug-in wrappers Set() the workgroup when the host
+ * provides one, and every helper thread that does real-time work for the audio thread should join it with a Member.
+ *
+ * There is one workgroup per process: with instances rendering in several workgroups, the last one set wins. Elsewhere this does nothing */
+class HostWorkgroup final
+{
+public:
+  /** Set the workgroup, an os_workgroup_t, or nullptr if the host has none. Realtime safe, so it can be called from a render context observer.
+   * The workgroup is retained until it is replaced, and the one it replaces is released */
+  static void Set(void* pWorkgroup)
+  {
+    Retain(pWorkgroup);
+    void* pPrevious = GetWorkgroup().exchange(pWorkgroup, std::memory_order_acq_rel);
+    GetGeneration().fetch_add(1, std::memory_order_acq_rel);
+    Release(pPrevious);
+  }
+
+  /** Set(nullptr), but only if the workgroup is still pWorkgroup. Call this when an instance stops rendering, with the last workgroup it set,
+   * so that the workgroup isn't kept alive after the host is done with it, without clearing one another instance set since */
+  static void Clear(void* pWorkgroup)
+  {
+    if (pWorkgroup && GetWorkgroup().compare_exchange_strong(pWorkgroup, nullptr, std::memory_order_acq_rel))
+    {
+      GetGeneration().fetch_add(1, std::memory_order_acq_rel);
+      Release(pWorkgroup);
+    }
+  }
+
+  /** @return The workgroup, an os_workgroup_t, or nullptr */
+  static void* Get() { return GetWorkgroup().load(std::memory_order_acquire); }
+
+  /** Keeps the thread that owns it in the workgroup. Threads can only join and leave a workgroup themselves, so create a Member on the
+   * helper thread, and call Update() whenever the thread wakes up */
+  class Member final
+  {
+  public:
+    Member() {}
+
+    Member(const Member&) = delete;
+    Member& operator=(const Member&) = delete;
+
+    ~Member()
+    {
+#if defined OS_MAC || defined OS_IOS
+      if (__builtin_available(macOS 11.0, iOS 14.0, *))
+      {
+        if (mJoined)
+          Leave();
+      }
+#endif
+    }
+
+    /** Join the current workgroup if it has changed. Doesn't lock
+     * @return \c true if the workgroup changed */
+    bool Update()
+    {
+      const uint32_t gen = GetGeneration().load(std::memory_order_acquire);
+
+      if (gen == mGeneration)
+        return false;
+
+      mGeneration = gen;
+
+#if defined OS_MAC || defined OS_IOS
+      if (__builtin_available(macOS 11.0, iOS 14.0, *))
+      {
+        if (mJoined)
+          Leave();
+
+        // hold on to the workgroup while joined, Set() releases it when it is replaced. Under ARC mJoined is a strong reference
+#if __has_feature(objc_arc)
+        mJoined = (__bridge os_workgroup_t) Get();
+#else
+        mJoined = (os_workgroup_t) Get();
+        Retain(mJoined);
+#endif
+
+        if (mJoined && os_workgroup_join(mJoined, &mToken) != 0)
+          Leave(false);
+      }
+#endif
+
+      return true;
+    }
+
+    /** @return The number of threads the joined workgroup can run in parallel, including the host's, or 0 if none was joined */
+    int GetMaxParallelThreads() const
+    {
+#if defined OS_MAC || defined OS_IOS
+      if (__builtin_available(macOS 11.0, iOS 14.0, *))
+      {
+        if (mJoined)
+          return os_workgroup_max_parallel_threads(mJoined, nullptr);
+      }
+#endif
+      return 0;
+    }
+
+  private:
+#if defined OS_MAC || defined OS_IOS
+    void Leave(bool joined = true) API_AVAILABLE(macos(11.0), ios(14.0))
+    {
+      if (joined)
+        os_workgroup_leave(mJoined, &mToken);
+
+#if !__has_feature(objc_arc)
+      Release(mJoined);
+#endif
+      mJoined = nullptr;
+    }
+
+    os_workgroup_t mJoined = nullptr;
+    os_workgroup_join_token_s mToken;
+#endif
+    uint32_t mGeneration = 0;
+  };
+
+private:
+  // os_retain() and os_release() are called as functions, since with ARC the macros of the same names message the object
+  static void Retain(void* pWorkgroup)
+  {
+#if defined OS_MAC || defined OS_IOS
+    if (pWorkgroup)
+      (os_retain)(pWorkgroup);
+#endif
+  }
+
+  static void Release(void* pWorkgroup)
+  {
+#if defined OS_MAC || defined OS_IOS
+    if (pWorkgroup)
+      (os_release)(pWorkgroup);
+#endif
+  }
+
+  static std::atomic<void*>& GetWorkgroup()
+  {
+    static std::atomic<void*> sWorkgroup{nullptr};
+    return sWorkgroup;
+  }
+
+  static std::atomic<uint32_t>& GetGeneration()
+  {
+    static std::atomic<uint32_t> sGeneration{0};
+    return sGeneration;
+  }
+};
+
+/** Work that an instance hands to the IWorkerPool. A job is registered once, and tells the pool when it has work by returning a deadline.
+ * Jobs are expected to be able to finish their own work on the audio thread if no worker has done it in time, so that a late worker never
+ * causes a dropout: the audio thread "steals back" whatever hasn't been claimed when it needs the result */
+class IWorkerJob
+{
+public:
+  static constexpr int64_t kNoWork = INT64_MAX;
+
+  virtual ~IWorkerJob() {}
+
+  /** Called by the workers, with the pool's lock held, to find the most urgent job. Keep it cheap and don't lock
+   * @return The time by which the pending work should be done, see IWorkerPool::Now(), or kNoWork if there is nothing to do */
+  virtual int64_t GetDeadline() const = 0;
+
+  /** Do some of the pending work. Several workers may call this at once, the job is responsible for dividing its work between them
+   * @param threadIdx The index of the calling worker, from 0 to IWorkerPool::NThreads() - 1, e.g. to pick a per-thread buffer
+   * @return \c true if any work was done, \c false if there was nothing left to claim */
+  virtual bool RunWork(int threadIdx) = 0;
+};
+
+/** A pool of real-time priority worker threads, shared by every plug-in instance in the process so that the number of threads doesn't grow
+ * with the number of instances. Voice rendering, graph processing and convolution tails all register their IWorkerJobs with it.
+ *
+ * Workers run the registered job with the earliest deadline, and park when no job has work. They sleep until the audio thread wakes them
+ * with Notify(), which doesn't lock or allocate, so an idle pool costs nothing.
+ *
+ * By default the pool has a thread per core, less one for the host's audio thread. Hosts that process on several threads of their own
+ * should be left those cores, see SetHostThreadCount(). If the host provides an audio workgroup, see HostWorkgroup, the workers join it
+ * and only as many workers as the workgroup allows are used.
+ *
+ * The pool is created by the first Acquire() and destroyed when the last holder releases it */
+class IWorkerPool final
+{
+public:
+  /** @return The pool, which is created if nobody holds it. Not realtime safe */
+  static std::shared_ptr<IWorkerPool> Acquire()
+  {
+    std::lock_guard<std::mutex> lock(GetStatics().mutex);
+    std::shared_ptr<IWorkerPool> pPool = GetStatics().pool.lock();
+
+    if (!pPool)
+    {
+      const int nCores = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+      const int nHostThreads = std::max(1, GetStatics().nHostThreads.load());
+      pPool.reset(new IWorkerPool(std::max(1, nCores - nHostThreads)));
+      GetStatics().pool = pPool;
+    }
+
+    return pPool;
+  }
+
+  /** Tell the pool how many threads the host processes audio on, so that it leaves them a core each. Takes effect when the pool is next created.
+   * @param nThreads The number of host audio threads, 1 by default */
+  static void SetHostThreadCount(int nThreads)
+  {
+    GetStatics().nHostThreads.store(std::max(1, nThreads));
+  }
+
+  /** @return The current time in nanoseconds, for IWorkerJob deadlines */
+  static int64_t Now()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /** @return A deadline seconds from now */
+  static int64_t DeadlineIn(double seconds)
+  {
+    return Now() + static_cast<int64_t>(seconds * 1e9);
+  }
+
+  ~IWorkerPool()
+  {
+    mQuit.store(true);
+    mWakeup.Signal(NThreads());
+
+    for (auto& thread : mThreads)
+      thread.join();
+  }
+
+  IWorkerPool(const IWorkerPool&) = delete;
+  IWorkerPool& operator=(const IWorkerPool&) = delete;
+
+  int NThreads() const { return static_cast<int>(mThreads.size()); }
+
+  /** Add a job for the workers to run. Not realtime safe */
+  void Register(IWorkerJob* pJob)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mJobs.push_back(pJob);
+    }
+
+    // the job may already have work
+    Notify();
+  }
+
+  /** Remove a job, and wait for any worker that is running it. Not realtime safe */
+  void Unregister(IWorkerJob* pJob)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mJobs.erase(std::remove(mJobs.begin(), mJobs.end(), pJob), mJobs.end());
+    }
+
+    for (auto& current : mCurrentJobs)
+    {
+      while (current.load(std::memory_order_acquire) == pJob)
+        std::this_thread::yield();
+    }
+  }
+
+  /** Audio thread: tell the workers that there is new work. Doesn't lock */
+  void Notify()
+  {
+    mGeneration.fetch_add(1);
+
+    if (const int nParked = mNParked.exchange(0))
+      mWakeup.Signal(nParked);
+  }
+
+private:
+  /** A counting semaphore, which C++14 lacks. Unlike a condition variable, it keeps a signal that arrives before the wait, so Signal()
+   * needn't lock to avoid lost wakeups */
+  class Semaphore final
+  {
+  public:
+    Semaphore()
+    {
+#if defined OS_WIN
+      mSemaphore = CreateSemaphore(nullptr, 0, LONG_MAX, nullptr);
+#elif defined OS_MAC || defined OS_IOS
+      semaphore_create(mach_task_self(), &mSemaphore, SYNC_POLICY_FIFO, 0);
+#else
+      sem_init(&mSemaphore, 0, 0);
+#endif
+    }
+
+    ~Semaphore()
+    {
+#if defined OS_WIN
+      CloseHandle(mSemaphore);
+#elif defined OS_MAC || defined OS_IOS
+      semaphore_destroy(mach_task_self(), mSemaphore);
+#else
+      sem_destroy(&mSemaphore);
+#endif
+    }
+
+    Semaphore(const Semaphore&) = delete;
+    Semaphore& operator=(const Semaphore&) = delete;
+
+    /** Wake n waiting threads, or let the next n waits return at once. Doesn't lock */
+    void Signal(int n)
+    {
+#if defined OS_WIN
+      ReleaseSemaphore(mSemaphore, n, nullptr);
+#else
+      for (int i = 0; i < n; i++)
+  #if defined OS_MAC || defined OS_IOS
+        semaphore_signal(mSemaphore);
+  #else
+        sem_post(&mSemaphore);
+  #endif
+#endif
+    }
+
+    void Wait()
+    {
+#if defined OS_WIN
+      WaitForSingleObject(mSemaphore, INFINITE);
+#elif defined OS_MAC || defined OS_IOS
+      while (semaphore_wait(mSemaphore) == KERN_ABORTED) {}
+#else
+      while (sem_wait(&mSemaphore) != 0 && errno == EINTR) {}
+#endif
+    }
+
+  private:
+#if defined OS_WIN
+    HANDLE mSemaphore;
+#elif defined OS_MAC || defined OS_IOS
+    semaphore_t mSemaphore;
+#else
+    sem_t mSemaphore;
+#endif
+  };
+
+  struct Statics
+  {
+    std::mutex mutex;
+    std::weak_ptr<IWorkerPool> pool;
+    std::atomic<int> nHostThreads{1};
+  };
+
+  static Statics& GetStatics()
+  {
+    static Statics sStatics;
+    return sStatics;
+  }
+
+  IWorkerPool(int nThreads)
+  : mCurrentJobs(nThreads)
+  {
+    mNActiveThreads.store(nThreads);
+
+    for (int i = 0; i < nThreads; i++)
+      mThreads.emplace_back([this, i]() { WorkerLoop(i); });
+  }
+
+  /** Claim the job whose work is due soonest */
+  IWorkerJob* Claim(int threadIdx)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    IWorkerJob* pBest = nullptr;
+    int64_t bestDeadline = IWorkerJob::kNoWork;
+
+    for (IWorkerJob* pJob : mJobs)
+    {
+      const int64_t deadline = pJob->GetDeadline();
+
+      if (deadline < bestDeadline)
+      {
+        pBest = pJob;
+        bestDeadline = deadline;
+      }
+    }
+
+    // set under the lock, so that Unregister() either sees it or removes the job before it can be picked
+    mCurrentJobs[threadIdx].store(pBest, std::memory_order_release);
+    return pBest;
+  }
+
+  void WorkerLoop(int threadIdx)
+  {
+    SetRealtimePriority();
+    HostWorkgroup::Member workgroup;
+
+    while (!mQuit.load(std::memory_order_relaxed))
+    {
+      // the workgroup knows how many threads can usefully run in parallel, one of which is the host's
+      if (workgroup.Update() && threadIdx == 0)
+      {
+        const int maxThreads = workgroup.GetMaxParallelThreads();
+        mNActiveThreads.store(maxThreads > 1 ? std::min(maxThreads - 1, NThreads()) : NThreads());
+      }
+
+      const uint32_t gen = mGeneration.load(std::memory_order_acquire);
+
+      if (threadIdx < mNActiveThreads.load(std::memory_order_relaxed))
+      {
+        if (IWorkerJob* pJob = Claim(threadIdx))
+        {
+          const bool didWork = pJob->RunWork(threadIdx);
+          mCurrentJobs[threadIdx].store(nullptr, std::memory_order_release);
+
+          if (didWork)
+            continue;
+        }
+      }
+
+      // Park until Notify(). Counting this worker as parked before looking at the generation again, while Notify() bumps the generation
+      // before it takes the count, means that either the new work is seen here or Notify() signals this worker
+      mNParked.fetch_add(1);
+
+      if (mQuit.load() || mGeneration.load() != gen)
+      {
+        // if Notify() has taken the count already, its signal only makes the next Wait() return early
+        int nParked = mNParked.load();
+        while (nParked > 0 && !mNParked.compare_exchange_weak(nParked, nParked - 1)) {}
+        continue;
+      }
+
+      mWakeup.Wait();
+    }
+  }
+
+  // Best effort: without the privileges to raise its priority, a worker runs at normal priority
+  static void SetRealtimePriority()
+  {
+#if defined OS_WIN
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#elif defined OS_MAC || defined OS_IOS
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    const double ticksPerMs = 1e6 * timebase.denom / timebase.numer;
+
+    thread_time_constraint_policy_data_t policy;
+    policy.period = 0;
+    policy.computation = static_cast<uint32_t>(ticksPerMs * 2.);
+    policy.constraint = static_cast<uint32_t>(ticksPerMs * 5.);
+    policy.preemptible = 1;
+    thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_TIME_CONSTRAINT_POLICY, reinterpret_cast<thread_policy_t>(&policy), THREAD_TIME_CONSTRAINT_POLICY_COUNT);
+#elif defined OS_LINUX
+    sched_param param;
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 1;
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+#endif
+  }
+
+  std::vector<std::thread> mThreads;
+  std::vector<IWorkerJob*> mJobs;
+  std::vector<std::atomic<IWorkerJob*>> mCurrentJobs; // the job each worker is running
+  std::atomic<int> mNActiveThreads{0};
+  std::atomic<uint32_t> mGeneration{0};
+  std::atomic<int> mNParked{0}; // workers that are about to wait on mWakeup, and haven't been signalled
+  std::atomic<bool> mQuit{false};
+  std::mutex mMutex; // guards mJobs
+  Semaphore mWakeup;
+};
+
+END_IPLUG_NAMESPACE
@@ -63,6 +63,10 @@
   #include "IPlugAPP.h"
   #define PLUGIN_API_BASE IPlugAPP
   #define API_EXT "app"
+#elif defined BENCH_API
+  #include "IPlugBench.h"
+  #define PLUGIN_API_BASE IPlugBench
+  #define API_EXT "bench"
 #elif defined WAM_API
   #include "IPlugWAM.h"
   #define PLUGIN_API_BASE IPlugWAM
@@ -101,7 +105,8 @@ END_IPLUG_NAMESPACE
   #define BUNDLE_ID BUNDLE_DOMAIN "." BUNDLE_MFR "." API_EXT "." BUNDLE_NAME API_EXT2
   #define EXPORT __attribute__ ((visibility("default")))
 #elif defined OS_LINUX
-  //TODO:
+  #define EXPORT __attribute__ ((visibility("default")))
+  #define BUNDLE_ID ""
 #elif defined OS_WEB
   #define BUNDLE_ID ""
 #else
@@ -216,6 +216,7 @@
       gPlug = std::unique_ptr<iplug::IPlugWeb>(iplug::MakePlug(InstanceInfo()));
       gPlug->SetHost("www", 0);
       gPlug->OpenWindow(nullptr);
+      EM_ASM({ Module.iplugReady = true; }); // the WAM controller script holds messages for the UI until this is set
       iplug_syncfs(); // plug in may initialise settings in constructor, write to persistent data after init
     }
   }
@@ -244,7 +245,7 @@
     
     return 0;
   }
-#elif defined AUv3_API || defined AAX_API || defined APP_API
+#elif defined AUv3_API || defined AAX_API || defined APP_API || defined BENCH_API
 // Nothing to do here
 #else
   #error "No API defined!"
@@ -255,9 +256,9 @@
 BEGIN_IPLUG_NAMESPACE
 
 #pragma mark -
-#pragma mark VST2, VST3, AAX, AUv3, APP, WAM, WEB
+#pragma mark VST2, VST3, AAX, AUv3, APP, WAM, WEB, BENCH
 
-#if defined VST2_API || defined VST3_API || defined AAX_API || defined AUv3_API || defined APP_API  || defined WAM_API || defined WEB_API
+#if defined VST2_API || defined VST3_API || defined AAX_API || defined AUv3_API || defined APP_API  || defined WAM_API || defined WEB_API || defined BENCH_API
 
 Plugin* MakePlug(const InstanceInfo& info)
 {
@@ -316,7 +317,14 @@ Steinberg::FUnknown* MakeProcessor()
 
 static Config MakeConfig(int nParams, int nPresets)
 {
-  return Config(nParams, nPresets, PLUG_CHANNEL_IO, PUBLIC_NAME, "", PLUG_MFR, PLUG_VERSION_HEX, PLUG_UNIQUE_ID, PLUG_MFR_ID, PLUG_LATENCY, PLUG_DOES_MIDI_IN, PLUG_DOES_MIDI_OUT, PLUG_DOES_MPE, PLUG_DOES_STATE_CHUNKS, PLUG_TYPE, PLUG_HAS_UI, PLUG_WIDTH, PLUG_HEIGHT, BUNDLE_ID);
+  Config config(nParams, nPresets, PLUG_CHANNEL_IO, PUBLIC_NAME, "", PLUG_MFR, PLUG_VERSION_HEX, PLUG_UNIQUE_ID, PLUG_MFR_ID, PLUG_LATENCY, PLUG_DOES_MIDI_IN, PLUG_DOES_MIDI_OUT, PLUG_DOES_MPE, PLUG_DOES_STATE_CHUNKS, PLUG_TYPE, PLUG_HAS_UI, PLUG_WIDTH, PLUG_HEIGHT, BUNDLE_ID);
+
+#ifndef NO_FIXED_CHANNEL_IO
+  // a plug-in with a single channel layout converts its buffers with routines specialized for its channel counts
+  config.fixedIO = MakeFixedIORoutines<FixedIOStrNChannels(PLUG_CHANNEL_IO, ERoute::kInput), FixedIOStrNChannels(PLUG_CHANNEL_IO, ERoute::kOutput)>();
+#endif
+
+  return config;
 }
 
 END_IPLUG_NAMESPACE
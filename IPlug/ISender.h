@@ -0,0 +1,69 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc ISender
+ */
+
+#include "IPlugEditorDelegate.h"
+#include "IPlugTripleBuffer.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A base class for control Senders that only need the latest state to reach the UI, e.g. spectrum frames, envelope positions or gain reduction.
+ * Unlike a Sender with an IPlugQueue, nothing is queued: the audio thread never blocks, and each TransmitData() sends at most one new state
+ * @tparam T The state, which must be trivially copyable since it is sent as bytes */
+template<typename T>
+class ISender
+{
+public:
+  /** @param controlTag The tag of the control to send to
+   * @param messageTag The message tag the control receives in OnMsgFromDelegate() */
+  ISender(int controlTag, int messageTag = 0)
+  : mControlTag(controlTag)
+  , mMessageTag(messageTag)
+  {
+  }
+
+  virtual ~ISender() {}
+
+  /** Realtime thread: replace the state to send with a copy of data */
+  void PushData(const T& data)
+  {
+    mBuffer.Write(data);
+  }
+
+  /** Realtime thread: @return A buffer to build the next state in, publish it with CommitData(). It does not contain the previous state */
+  T& GetDataToWrite() { return mBuffer.GetWriteBuffer(); }
+
+  /** Realtime thread: publish the state written with GetDataToWrite() */
+  void CommitData() { mBuffer.Publish(); }
+
+  /** Sends the latest state via IEditorDelegate, if there is a new one. This must be called on the main thread - typically in MyPlugin::OnIdle().
+   * Nothing is sent while the UI is occluded, the latest state is sent once it can be seen again */
+  virtual void TransmitData(IEditorDelegate& dlg)
+  {
+    if (dlg.IsUIOccluded())
+      return;
+
+    if (mBuffer.Update())
+      dlg.SendControlMsgFromDelegate(mControlTag, mMessageTag, sizeof(T), (const void*) &mBuffer.GetReadBuffer());
+  }
+
+protected:
+  int mControlTag;
+  int mMessageTag;
+  ITripleBuffer<T> mBuffer;
+};
+
+END_IPLUG_NAMESPACE
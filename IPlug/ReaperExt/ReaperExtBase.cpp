@@ -12,9 +12,59 @@ ReaperExtBase::~ReaperExtBase()
 
 void ReaperExtBase::OnTimer(Timer& t)
 {
+  UpdateProjectState();
   OnIdle();
 }
 
+void ReaperExtBase::UpdateProjectState()
+{
+  ReaProject* pProject = EnumProjects(-1, nullptr, 0);
+  const int changeCount = GetProjectStateChangeCount(pProject);
+
+  if (pProject == mProject && changeCount == mProjectChangeCount)
+    return;
+
+  mProject = pProject;
+  mProjectChangeCount = changeCount;
+
+  if (mCacheTracks)
+    RefreshTrackCache();
+
+  OnProjectStateChanged();
+}
+
+void ReaperExtBase::RefreshTrackCache()
+{
+  const int nTracks = CountTracks(mProject);
+
+  // resizing keeps the names' buffers, so a refresh settles without allocating
+  mTracks.resize(nTracks);
+
+  char name[256];
+
+  for (int i = 0; i < nTracks; i++)
+  {
+    ReaperTrackState& track = mTracks[i];
+    MediaTrack* pTrack = GetTrack(mProject, i);
+    track.mTrack = pTrack;
+
+    if (const GUID* pGUID = GetTrackGUID(pTrack))
+      track.mGUID = *pGUID;
+
+    if (GetTrackName(pTrack, name, sizeof(name)))
+      track.mName.Set(name);
+    else
+      track.mName.Set("");
+
+    track.mVolume = GetMediaTrackInfo_Value(pTrack, "D_VOL");
+    track.mPan = GetMediaTrackInfo_Value(pTrack, "D_PAN");
+    track.mMute = GetMediaTrackInfo_Value(pTrack, "B_MUTE") != 0.;
+    track.mSolo = GetMediaTrackInfo_Value(pTrack, "I_SOLO") != 0.;
+    track.mRecArm = GetMediaTrackInfo_Value(pTrack, "I_RECARM") != 0.;
+    track.mSelected = GetMediaTrackInfo_Value(pTrack, "I_SELECTED") != 0.;
+  }
+}
+
 auto ClientResize = [](HWND hWnd, int nWidth, int nHeight) {
   RECT rcClient, rcWindow;
   POINT ptDiff;
@@ -16,13 +16,31 @@
  * Include this file in the main header for your reaper extension
 */
 
+#include <vector>
+
 #include "IPlugTimer.h"
 #include "IPlugDelegate_select.h"
 
 struct reaper_plugin_info_t;
+class ReaProject;
+class MediaTrack;
 
 BEGIN_IPLUG_NAMESPACE
 
+/** The state of a track in the current project, as cached by ReaperExtBase, see ReaperExtBase::EnableTrackCache() */
+struct ReaperTrackState
+{
+  MediaTrack* mTrack = nullptr;
+  GUID mGUID = {};
+  WDL_String mName;
+  double mVolume = 1.; // linear gain
+  double mPan = 0.; // -1. to 1.
+  bool mMute = false;
+  bool mSolo = false;
+  bool mRecArm = false;
+  bool mSelected = false;
+};
+
 class ReaperExtBase : public EDITOR_DELEGATE_CLASS
 {
 public:
@@ -42,6 +60,25 @@ public:
 
   /** /todo */
   virtual void OnIdle() {}; // NO-OP
+
+  /** Called on the main thread, before OnIdle(), when a project is opened or switched to, or REAPER's state change count for the current project
+   * changes, i.e. when something that makes an undo point has changed. The cached tracks have been refreshed by the time this is called.
+   * Polling the change count costs two API calls per tick however big the project is, so an extension that mirrors project state should update here
+   * rather than querying REAPER in OnIdle() */
+  virtual void OnProjectStateChanged() {}
+
+  /** Keep a copy of the state of each track of the current project, refreshed only when the project state changes, see OnProjectStateChanged()
+   * @param enable \c true to cache the tracks */
+  void EnableTrackCache(bool enable) { mCacheTracks = enable; mProjectChangeCount = -1; if (!enable) mTracks.clear(); }
+
+  /** @return The cached tracks of the current project, in order, see EnableTrackCache() */
+  const std::vector<ReaperTrackState>& GetCachedTracks() const { return mTracks; }
+
+  /** @return The current project, as of the last timer tick */
+  ReaProject* GetCurrentProject() const { return mProject; }
+
+  /** Refresh the cached state on the next timer tick, e.g. after a change that doesn't make an undo point, such as moving a fader while it is held */
+  void InvalidateProjectState() { mProjectChangeCount = -1; }
   
   /** /todo
    * @param actionName /todo
@@ -65,9 +102,18 @@ private:
   
   void OnTimer(Timer& t);
 
+  /** Polls the current project and its state change count, and refreshes the cache if either changed */
+  void UpdateProjectState();
+
+  void RefreshTrackCache();
+
   reaper_plugin_info_t* mRec = nullptr;
   std::unique_ptr<Timer> mTimer;
   bool mDocked = false;
+  ReaProject* mProject = nullptr;
+  int mProjectChangeCount = -1;
+  bool mCacheTracks = false;
+  std::vector<ReaperTrackState> mTracks;
 };
 
 END_IPLUG_NAMESPACE
@@ -57,6 +57,13 @@ extern "C"
       IMPAPI(ShowConsoleMsg);
       IMPAPI(DockWindowAdd);
       IMPAPI(DockWindowActivate);
+      IMPAPI(EnumProjects);
+      IMPAPI(GetProjectStateChangeCount);
+      IMPAPI(CountTracks);
+      IMPAPI(GetTrack);
+      IMPAPI(GetTrackGUID);
+      IMPAPI(GetTrackName);
+      IMPAPI(GetMediaTrackInfo_Value);
       
       if (gErrorCount > 0)
         return 0;
@@ -126,8 +126,8 @@ bool IPlugVST2::EditorResizeFromDelegate(int viewWidth, int viewHeight)
 
 void IPlugVST2::SetLatency(int samples)
 {
-  mAEffect.initialDelay = samples;
   IPlugProcessor::SetLatency(samples);
+  mAEffect.initialDelay = GetLatency();
 }
 
 bool IPlugVST2::SendVSTEvent(VstEvent& event)
@@ -235,6 +235,7 @@ VstIntPtr VSTCALLBACK IPlugVST2::VSTDispatcher(AEffect *pEffect, VstInt32 opCode
         
         _this->SetHost(productStr, version);
       }
+      _this->mAEffect.initialDelay = _this->GetLatency(); // includes SetFixedBlockSize(), called after the constructor set it
       _this->OnParamReset(kReset);
       return 0;
     }
@@ -319,7 +320,11 @@ VstIntPtr VSTCALLBACK IPlugVST2::VSTDispatcher(AEffect *pEffect, VstInt32 opCode
           const double v = pParam->StringToValue((const char *)ptr);
           pParam->Set(v);
           _this->SendParameterValueFromAPI(idx, v, false);
+#ifdef PARAMS_LOCKFREE
+          _this->DeferParamChange(idx, kHost);
+#else
           _this->OnParamChange(idx, kHost);
+#endif
           LEAVE_PARAMS_MUTEX_STATIC;
         }
         return 1;
@@ -423,9 +428,7 @@ VstIntPtr VSTCALLBACK IPlugVST2::VSTDispatcher(AEffect *pEffect, VstInt32 opCode
       if (ptr)
       {
         bool isBank = (!idx);
-        IByteChunk& chunk = (isBank ? _this->mBankState : _this->mState);
-        chunk.Resize((int) value);
-        memcpy(chunk.GetData(), ptr, value);
+        IByteChunkView chunk(ptr, (int) value); // the host's memory is valid for the duration of the call
         int pos = 0;
         int iplugVer = IByteChunk::GetIPlugVerFromChunk(chunk, pos);
         isBank &= (iplugVer >= 0x010000);
@@ -450,6 +453,7 @@ VstIntPtr VSTCALLBACK IPlugVST2::VSTDispatcher(AEffect *pEffect, VstInt32 opCode
     }
     case effProcessEvents:
     {
+      REALTIME_SCOPE;
       VstEvents* pEvents = (VstEvents*) ptr;
       if (pEvents)
       {
@@ -462,7 +466,7 @@ VstIntPtr VSTCALLBACK IPlugVST2::VSTDispatcher(AEffect *pEffect, VstInt32 opCode
             {
               VstMidiEvent* pME = (VstMidiEvent*) pEvent;
               IMidiMsg msg(pME->deltaFrames, pME->midiData[0], pME->midiData[1], pME->midiData[2]);
-              _this->ProcessMidiMsg(msg);
+              _this->ReceiveMidiMsg(msg);
               _this->mMidiMsgsFromProcessor.Push(msg);
 
               //#ifdef TRACER_BUILD
@@ -789,6 +793,8 @@ VstIntPtr VSTCALLBACK IPlugVST2::VSTDispatcher(AEffect *pEffect, VstInt32 opCode
 template <class SAMPLETYPE>
 void IPlugVST2::VSTPreProcess(SAMPLETYPE** inputs, SAMPLETYPE** outputs, VstInt32 nFrames)
 {
+  ProcessDeferredParamChanges();
+
   if (DoesMIDIIn())
     mHostCallback(&mAEffect, __audioMasterWantMidiDeprecated, 0, 0, 0, 0.0f);
 
@@ -829,7 +835,7 @@ void IPlugVST2::VSTPreProcess(SAMPLETYPE** inputs, SAMPLETYPE** outputs, VstInt3
 
   while (mMidiMsgsFromEditor.Pop(msg))
   {
-    ProcessMidiMsg(msg);
+    ReceiveMidiMsg(msg);
   }
 }
 
@@ -837,28 +843,39 @@ void IPlugVST2::VSTPreProcess(SAMPLETYPE** inputs, SAMPLETYPE** outputs, VstInt3
 void VSTCALLBACK IPlugVST2::VSTProcess(AEffect* pEffect, float** inputs, float** outputs, VstInt32 nFrames)
 {
   TRACE;
+  REALTIME_SCOPE;
   IPlugVST2* _this = (IPlugVST2*) pEffect->object;
+  IFlushDenormalsScope denormalsScope(_this->GetFlushDenormals());
   _this->VSTPreProcess(inputs, outputs, nFrames);
   _this->ProcessBuffersAccumulating(nFrames);
   _this->OutputSysexFromEditor();
+  _this->ClearBlockEvents();
 }
 
 void VSTCALLBACK IPlugVST2::VSTProcessReplacing(AEffect* pEffect, float** inputs, float** outputs, VstInt32 nFrames)
 {
   TRACE;
+  REALTIME_SCOPE;
   IPlugVST2* _this = (IPlugVST2*) pEffect->object;
+  IFlushDenormalsScope denormalsScope(_this->GetFlushDenormals());
   _this->VSTPreProcess(inputs, outputs, nFrames);
-  _this->ProcessBuffers((float) 0.0f, nFrames);
+  if (!_this->SkipSilentBuffers((float) 0.0f, nFrames))
+    _this->ProcessBuffers((float) 0.0f, nFrames);
   _this->OutputSysexFromEditor();
+  _this->ClearBlockEvents();
 }
 
 void VSTCALLBACK IPlugVST2::VSTProcessDoubleReplacing(AEffect* pEffect, double** inputs, double** outputs, VstInt32 nFrames)
 {
   TRACE;
+  REALTIME_SCOPE;
   IPlugVST2* _this = (IPlugVST2*) pEffect->object;
+  IFlushDenormalsScope denormalsScope(_this->GetFlushDenormals());
   _this->VSTPreProcess(inputs, outputs, nFrames);
-  _this->ProcessBuffers((double) 0.0, nFrames);
+  if (!_this->SkipSilentBuffers((double) 0.0, nFrames))
+    _this->ProcessBuffers((double) 0.0, nFrames);
   _this->OutputSysexFromEditor();
+  _this->ClearBlockEvents();
 }
 
 float VSTCALLBACK IPlugVST2::VSTGetParameter(AEffect *pEffect, VstInt32 idx)
@@ -883,22 +900,28 @@ void VSTCALLBACK IPlugVST2::VSTSetParameter(AEffect *pEffect, VstInt32 idx, floa
   if (idx >= 0 && idx < _this->NParams())
   {
     ENTER_PARAMS_MUTEX_STATIC;
+    _this->BeginParamsWrite();
     _this->GetParam(idx)->SetNormalized(value);
+    _this->EndParamsWrite();
     _this->SendParameterValueFromAPI(idx, value, true);
+#ifdef PARAMS_LOCKFREE
+    _this->DeferParamChange(idx, kHost);
+#else
     _this->OnParamChange(idx, kHost);
+#endif
     LEAVE_PARAMS_MUTEX_STATIC;
+    _this->WakeFromSilence();
   }
 }
 
 void IPlugVST2::OutputSysexFromEditor()
 {
   //Output SYSEX from the editor, which has bypassed ProcessSysEx()
-  if(mSysExDataFromEditor.ElementsAvailable())
+  ISysEx smsg;
+  
+  while (mSysExDataFromEditor.Peek(smsg))
   {
-    while (mSysExDataFromEditor.Pop(mSysexBuf))
-    {
-      ISysEx smsg {mSysexBuf.mOffset, mSysexBuf.mData, mSysexBuf.mSize};
-      SendSysEx(smsg);
-    }
+    SendSysEx(smsg);
+    mSysExDataFromEditor.Pop();
   }
 }
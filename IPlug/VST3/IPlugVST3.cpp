@@ -75,10 +75,21 @@ tresult PLUGIN_API IPlugVST3::setActive(TBool state)
 {
   TRACE;
 
+  if (!state)
+    mProcessing = false;
+
   OnActivate((bool) state);
   return SingleComponentEffect::setActive(state);
 }
 
+tresult PLUGIN_API IPlugVST3::setProcessing(TBool state)
+{
+  TRACE;
+
+  mProcessing = state;
+  return SingleComponentEffect::setProcessing(state);
+}
+
 tresult PLUGIN_API IPlugVST3::setupProcessing(ProcessSetup& newSetup)
 {
   TRACE;
@@ -124,7 +135,9 @@ ParamValue PLUGIN_API IPlugVST3::getParamNormalized(ParamID tag)
 
 tresult PLUGIN_API IPlugVST3::setParamNormalized(ParamID tag, ParamValue value)
 {
-  IPlugVST3ControllerBase::setParamNormalized(this, tag, value);
+  // the processor and controller share the parameters, so while the host is processing, process() has already applied the host's value
+  // and only the UI is updated here. The host can stop processing while the plug-in stays active, so otherwise the value is set here
+  IPlugVST3ControllerBase::setParamNormalized(this, tag, value, !mProcessing);
   
   return EditControllerEx1::setParamNormalized(tag, value);
 }
@@ -74,6 +74,7 @@ public:
   tresult PLUGIN_API terminate() override;
   tresult PLUGIN_API setBusArrangements(Vst::SpeakerArrangement* pInputs, int32 numIns, Vst::SpeakerArrangement* pOutputs, int32 numOuts) override;
   tresult PLUGIN_API setActive(TBool state) override;
+  tresult PLUGIN_API setProcessing(TBool state) override;
   tresult PLUGIN_API setupProcessing(Vst::ProcessSetup& newSetup) override;
   tresult PLUGIN_API process(Vst::ProcessData& data) override;
   tresult PLUGIN_API canProcessSampleSize(int32 symbolicSampleSize) override;
@@ -116,6 +117,7 @@ public:
     
 private:
   ViewType* mView;
+  std::atomic<bool> mProcessing {false}; // see setParamNormalized()
 };
 
 IPlugVST3* MakePlug(const InstanceInfo& info);
@@ -56,7 +56,18 @@ struct IPlugVST3State
     
     IByteChunk chunk;
     
-    const int bytesPerBlock = 128;
+    // reserve the whole state up front if the stream can tell us its size, otherwise the chunk grows geometrically
+    int64 startPos = 0, endPos = 0;
+    
+    if (pState->tell(&startPos) == kResultOk && pState->seek(0, IBStream::kIBSeekEnd, &endPos) == kResultOk)
+    {
+      pState->seek(startPos, IBStream::kIBSeekSet);
+      
+      if (endPos > startPos && endPos - startPos < INT32_MAX)
+        chunk.Reserve((int) (endPos - startPos));
+    }
+    
+    const int bytesPerBlock = 4096;
     char buffer[bytesPerBlock];
     
     while(true)
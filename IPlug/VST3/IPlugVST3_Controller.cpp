@@ -202,11 +202,12 @@ tresult PLUGIN_API IPlugVST3Controller::notify(IMessage* message)
     
     if (message->getAttributes()->getBinary("D", data, size) == kResultOk)
     {
-      if (size == sizeof(IMidiMsg))
+      // a batch of messages, copied since the attribute data may not be aligned
+      if (size && size % sizeof(IMidiMsg) == 0)
       {
-        IMidiMsg msg;
-        memcpy(&msg, data, size);
-        SendMidiMsgFromDelegate(msg);
+        mMidiBatch.Resize(size / sizeof(IMidiMsg), false);
+        memcpy(mMidiBatch.Get(), data, size);
+        SendMidiMsgsFromDelegate(mMidiBatch.Get(), mMidiBatch.GetSize());
       }
     }
   }
@@ -140,7 +140,8 @@ public:
     return 0.0;
   }
     
-  void PLUGIN_API setParamNormalized(IPlugAPIBase* pPlug, ParamID tag, ParamValue value)
+  /** @param setValue \c false if the processor has set the parameter already, in a plug-in that isn't distributed, so only the UI is updated */
+  void PLUGIN_API setParamNormalized(IPlugAPIBase* pPlug, ParamID tag, ParamValue value, bool setValue = true)
   {
     if (tag >= kBypassParam)
     {
@@ -161,7 +162,9 @@ public:
       
       if (pParam)
       {
-        pParam->SetNormalized(value);
+        if (setValue)
+          pParam->SetNormalized(value);
+
         pPlug->OnParamChangeUI(tag, kHost);
         pPlug->SendParameterValueFromAPI(tag, value, true);
       }
@@ -210,7 +210,20 @@ void IPlugVST3Processor::TransmitMidiMsgFromProcessor(const IMidiMsg& msg)
   sendMessage(message);
 }
 
-void IPlugVST3Processor::TransmitSysExDataFromProcessor(const SysExData& data)
+void IPlugVST3Processor::TransmitMidiMsgsFromProcessor(const IMidiMsg* pMsgs, int nMsgs)
+{
+  OPtr<IMessage> message = allocateMessage();
+  
+  if (!message)
+    return;
+  
+  // one message per tick, rather than one per MIDI message
+  message->setMessageID("SMMFD");
+  message->getAttributes()->setBinary("D", (void*) pMsgs, nMsgs * sizeof(IMidiMsg));
+  sendMessage(message);
+}
+
+void IPlugVST3Processor::TransmitSysExDataFromProcessor(const ISysEx& msg)
 {
   OPtr<IMessage> message = allocateMessage();
   
@@ -218,7 +231,7 @@ void IPlugVST3Processor::TransmitSysExDataFromProcessor(const SysExData& data)
     return;
   
   message->setMessageID("SSMFD");
-  message->getAttributes()->setBinary("D", (void*) data.mData, data.mSize);
-  message->getAttributes()->setInt("O", data.mOffset);
+  message->getAttributes()->setBinary("D", (void*) msg.mData, msg.mSize);
+  message->getAttributes()->setInt("O", msg.mOffset);
   sendMessage(message);
 }
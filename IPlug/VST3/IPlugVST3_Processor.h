@@ -68,7 +68,8 @@ public:
   
 private:
   void TransmitMidiMsgFromProcessor(const IMidiMsg& msg) override;
-  void TransmitSysExDataFromProcessor(const SysExData& data) override;
+  void TransmitMidiMsgsFromProcessor(const IMidiMsg* pMsgs, int nMsgs) override;
+  void TransmitSysExDataFromProcessor(const ISysEx& msg) override;
 
   // IConnectionPoint
   tresult PLUGIN_API notify(IMessage* message) override;
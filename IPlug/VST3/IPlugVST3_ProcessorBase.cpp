@@ -64,7 +64,7 @@ IPlugVST3ProcessorBase::IPlugVST3ProcessorBase(Config c, IPlugAPIBase& plug)
   memset(&mProcessContext, 0, sizeof(ProcessContext));
 }
 
-void IPlugVST3ProcessorBase::ProcessMidiIn(IEventList* eventList, IPlugQueue<IMidiMsg>& editorQueue, IPlugQueue<IMidiMsg>& processorQueue)
+void IPlugVST3ProcessorBase::ProcessMidiIn(IEventList* eventList, IPlugMPSCQueue<IMidiMsg>& editorQueue, IPlugQueue<IMidiMsg>& processorQueue)
 {
   IMidiMsg msg;
   
@@ -83,7 +83,7 @@ void IPlugVST3ProcessorBase::ProcessMidiIn(IEventList* eventList, IPlugQueue<IMi
           case Event::kNoteOnEvent:
           {
             msg.MakeNoteOnMsg(event.noteOn.pitch, event.noteOn.velocity * 127, event.sampleOffset, event.noteOn.channel);
-            ProcessMidiMsg(msg);
+            ReceiveMidiMsg(msg);
             processorQueue.Push(msg);
             break;
           }
@@ -91,14 +91,14 @@ void IPlugVST3ProcessorBase::ProcessMidiIn(IEventList* eventList, IPlugQueue<IMi
           case Event::kNoteOffEvent:
           {
             msg.MakeNoteOffMsg(event.noteOff.pitch, event.sampleOffset, event.noteOff.channel);
-            ProcessMidiMsg(msg);
+            ReceiveMidiMsg(msg);
             processorQueue.Push(msg);
             break;
           }
           case Event::kPolyPressureEvent:
           {
             msg.MakePolyATMsg(event.polyPressure.pitch, event.polyPressure.pressure * 127., event.sampleOffset, event.polyPressure.channel);
-            ProcessMidiMsg(msg);
+            ReceiveMidiMsg(msg);
             processorQueue.Push(msg);
             break;
           }
@@ -116,11 +116,11 @@ void IPlugVST3ProcessorBase::ProcessMidiIn(IEventList* eventList, IPlugQueue<IMi
   
   while (editorQueue.Pop(msg))
   {
-    ProcessMidiMsg(msg);
+    ReceiveMidiMsg(msg);
   }
 }
 
-void IPlugVST3ProcessorBase::ProcessMidiOut(IPlugQueue<SysExData>& sysExQueue, SysExData& sysExBuf, IEventList* outputEvents, int32 numSamples)
+void IPlugVST3ProcessorBase::ProcessMidiOut(IPlugSysExQueue& sysExQueue, WDL_TypedBuf<uint8_t>& sysExBuf, IEventList* outputEvents, int32 numSamples)
 {
   // MIDI
   if (!mMidiOutputQueue.Empty() && outputEvents)
@@ -188,19 +188,24 @@ void IPlugVST3ProcessorBase::ProcessMidiOut(IPlugQueue<SysExData>& sysExQueue, S
   mMidiOutputQueue.Flush(numSamples);
   
   // Output SYSEX from the editor, which has bypassed the processors' ProcessSysEx()
-  if (sysExQueue.ElementsAvailable())
+  // the host reads the events after process() returns, so each message's bytes are copied to their own place in sysExBuf, which is as big as the queue
+  Event toAdd = {0};
+  ISysEx smsg;
+  int bufPos = 0;
+  
+  while (sysExQueue.Peek(smsg) && bufPos + smsg.mSize <= sysExBuf.GetSize())
   {
-    Event toAdd = {0};
+    uint8_t* pBytes = sysExBuf.Get() + bufPos;
+    memcpy(pBytes, smsg.mData, smsg.mSize);
+    bufPos += smsg.mSize;
     
-    while (sysExQueue.Pop(sysExBuf))
-    {
-      toAdd.type = Event::kDataEvent;
-      toAdd.sampleOffset = sysExBuf.mOffset;
-      toAdd.data.type = DataEvent::kMidiSysEx;
-      toAdd.data.size = sysExBuf.mSize;
-      toAdd.data.bytes = (uint8*) sysExBuf.mData; // TODO!  this is a problem if more than one message in this block!
-      outputEvents->addEvent(toAdd);
-    }
+    toAdd.type = Event::kDataEvent;
+    toAdd.sampleOffset = smsg.mOffset;
+    toAdd.data.type = DataEvent::kMidiSysEx;
+    toAdd.data.size = smsg.mSize;
+    toAdd.data.bytes = pBytes;
+    outputEvents->addEvent(toAdd);
+    sysExQueue.Pop();
   }
 }
 
@@ -209,6 +214,7 @@ void IPlugVST3ProcessorBase::SetBusArrangments(SpeakerArrangement* pInputBusArra
   // disconnect all io pins, they will be reconnected in process
   SetChannelConnections(ERoute::kInput, 0, MaxNChannels(ERoute::kInput), false);
   SetChannelConnections(ERoute::kOutput, 0, MaxNChannels(ERoute::kOutput), false);
+  mBusLayout.Resize(0, false);
   
   //TODO: setBusArrangements !!!
   //const int maxNInputChans = MaxNBuses(ERoute::kInput);
@@ -266,7 +272,21 @@ bool IPlugVST3ProcessorBase::SetupProcessing(const ProcessSetup& setup, ProcessS
   
   SetSampleRate(setup.sampleRate);
   IPlugProcessor::SetBlockSize(setup.maxSamplesPerBlock); // TODO: should IPlugVST3Processor call SetBlockSize in construct unlike other APIs?
-  mMidiOutputQueue.Resize(setup.maxSamplesPerBlock);
+  mMidiOutputQueue.Reserve(setup.maxSamplesPerBlock); // fixed capacity, so that SendMidiMsg() never allocates on the audio thread
+  
+  // reserve space for the parameter change timeline, so that it doesn't need to grow on the audio thread in typical use
+  mParamChangePoints.Resize(mPlug.NParams() * 4, false);
+  mParamChangePoints.Resize(0, false);
+  
+  // the scratch buffers that disconnected channels point to may have been reallocated, and the layout buffers shouldn't grow on the audio thread
+  const int layoutSize = 3 + MaxNBuses(ERoute::kInput) + 2 * MaxNBuses(ERoute::kOutput);
+  mBusLayout.Resize(layoutSize, false);
+  mNextBusLayout.Resize(layoutSize, false);
+  mBusLayout.Resize(0, false);
+  
+  // so that OnReset() can already pick e.g. an offline oversampling quality, and report its latency
+  SetRenderingOffline(setup.processMode == Steinberg::Vst::kOffline);
+  
   OnReset();
   
   return true;
@@ -290,6 +310,27 @@ static bool IsBusActive(const BusList& list, int32 idx)
   return exists;
 }
 
+bool IPlugVST3ProcessorBase::UpdateBusLayout(const ProcessData& data, const BusList& ins, const BusList& outs)
+{
+  mNextBusLayout.Resize(0, false);
+  mNextBusLayout.Add(data.numInputs);
+  mNextBusLayout.Add(data.numInputs ? data.inputs[0].numChannels : 0);
+  mNextBusLayout.Add(IsBusActive(ins, 1));
+  
+  for (int outBus = 0; outBus < data.numOutputs; outBus++)
+  {
+    mNextBusLayout.Add(data.outputs[outBus].numChannels);
+    mNextBusLayout.Add(IsBusActive(outs, outBus));
+  }
+  
+  if (mNextBusLayout.GetSize() == mBusLayout.GetSize() && !memcmp(mNextBusLayout.Get(), mBusLayout.Get(), mBusLayout.GetSize() * sizeof(int32)))
+    return false;
+  
+  mBusLayout.Resize(mNextBusLayout.GetSize(), false);
+  memcpy(mBusLayout.Get(), mNextBusLayout.Get(), mNextBusLayout.GetSize() * sizeof(int32));
+  return true;
+}
+
 void IPlugVST3ProcessorBase::PrepareProcessContext(ProcessData& data, ProcessSetup& setup)
 {
   ITimeInfo timeInfo;
@@ -315,8 +356,12 @@ void IPlugVST3ProcessorBase::PrepareProcessContext(ProcessData& data, ProcessSet
 
 void IPlugVST3ProcessorBase::ProcessParameterChanges(ProcessData& data)
 {
+  TRACE_SCOPE("param", "ProcessParameterChanges");
+
   IParameterChanges* paramChanges = data.inputParameterChanges;
   
+  mParamChangePoints.Resize(0, false);
+  
   if (paramChanges)
   {
     int32 numParamsChanged = paramChanges->getParameterCount();
@@ -330,10 +375,28 @@ void IPlugVST3ProcessorBase::ProcessParameterChanges(ProcessData& data)
         int32 offsetSamples;
         double value;
         
-        if (paramQueue->getPoint(numPoints - 1,  offsetSamples, value) == kResultTrue)
+        int idx = paramQueue->getParameterId();
+        
+        if (mSampleAccurateAutomation && idx >= 0 && idx < mPlug.NParams())
         {
-          int idx = paramQueue->getParameterId();
+          for (int32 pointIdx = 0; pointIdx < numPoints; pointIdx++)
+          {
+            if (paramQueue->getPoint(pointIdx, offsetSamples, value) == kResultTrue)
+            {
+              mBlockEvents.AddParamChange(std::max(offsetSamples, 0), idx, mPlug.GetParam(idx)->FromNormalized(value));
+              
+              if (offsetSamples <= 0)
+                SetParameterFromHost(idx, value, 0);
+              else
+                mParamChangePoints.Add({offsetSamples, mParamChangePoints.GetSize(), idx, value});
+            }
+          }
           
+          continue;
+        }
+        
+        if (paramQueue->getPoint(numPoints - 1,  offsetSamples, value) == kResultTrue)
+        {
           switch (idx)
           {
             case kBypassParam:
@@ -349,10 +412,14 @@ void IPlugVST3ProcessorBase::ProcessParameterChanges(ProcessData& data)
             {
               if (idx >= 0 && idx < mPlug.NParams())
               {
-                ENTER_PARAMS_MUTEX;
-                mPlug.GetParam(idx)->SetNormalized((double)value); // TODO: In VST3 non distributed the same parameter value is also set via IPlugVST3Controller::setParamNormalized(ParamID tag, ParamValue value)
-                mPlug.OnParamChange(idx, kHost, offsetSamples);
-                LEAVE_PARAMS_MUTEX;
+                SetParameterFromHost(idx, value, offsetSamples);
+                
+                // every point in the queue is recorded, even though only the last one is applied
+                for (int32 pointIdx = 0; pointIdx < numPoints; pointIdx++)
+                {
+                  if (paramQueue->getPoint(pointIdx, offsetSamples, value) == kResultTrue)
+                    mBlockEvents.AddParamChange(std::max(offsetSamples, 0), idx, mPlug.GetParam(idx)->FromNormalized(value));
+                }
               }
             }
               break;
@@ -361,6 +428,88 @@ void IPlugVST3ProcessorBase::ProcessParameterChanges(ProcessData& data)
       }
     }
   }
+  
+  if (mParamChangePoints.GetSize())
+  {
+    // points for a single parameter arrive in time order, but the queues need merging into one timeline. order is used to keep std::sort stable without allocating
+    std::sort(mParamChangePoints.Get(), mParamChangePoints.Get() + mParamChangePoints.GetSize(), [](const ParamChangePoint& a, const ParamChangePoint& b) {
+      return a.offset != b.offset ? a.offset < b.offset : a.order < b.order;
+    });
+  }
+}
+
+void IPlugVST3ProcessorBase::SetParameterFromHost(int idx, double normalizedValue, int32 offsetSamples)
+{
+  ENTER_PARAMS_MUTEX;
+  mPlug.BeginParamsWrite();
+  mPlug.GetParam(idx)->SetNormalized(normalizedValue); // in non-distributed VST3 this is the only place the value is set while processing, see IPlugVST3::setParamNormalized()
+  mPlug.EndParamsWrite();
+  mPlug.OnParamChange(idx, kHost, offsetSamples);
+  LEAVE_PARAMS_MUTEX;
+}
+
+void IPlugVST3ProcessorBase::SetSampleAccurateAutomation(bool enable, int minSubBlockSize)
+{
+  mSampleAccurateAutomation = enable;
+  mMinSubBlockSize = std::max(minSubBlockSize, 1);
+}
+
+void IPlugVST3ProcessorBase::ProcessSubBlocks(int32 sampleSize, int32 numSamples)
+{
+  const ParamChangePoint* pPoints = mParamChangePoints.Get();
+  const int nPoints = mParamChangePoints.GetSize();
+  const ITimeInfo blockTimeInfo = mTimeInfo;
+  const double samplesPerBeat = GetSamplesPerBeat();
+  int pointIdx = 0;
+  int startIdx = 0;
+  
+  while (startIdx < numSamples)
+  {
+    // changes that fell inside the previous sub-block are applied at the start of this one
+    while (pointIdx < nPoints && pPoints[pointIdx].offset <= startIdx)
+    {
+      SetParameterFromHost(pPoints[pointIdx].idx, pPoints[pointIdx].value, pPoints[pointIdx].offset);
+      pointIdx++;
+    }
+    
+    int endIdx = numSamples;
+    
+    if (pointIdx < nPoints)
+      endIdx = std::min(std::max(pPoints[pointIdx].offset, startIdx + mMinSubBlockSize), numSamples);
+    
+    if (blockTimeInfo.mSamplePos >= 0.)
+      mTimeInfo.mSamplePos = blockTimeInfo.mSamplePos + startIdx;
+    
+    if (blockTimeInfo.mPPQPos >= 0. && samplesPerBeat > 0.)
+      mTimeInfo.mPPQPos = blockTimeInfo.mPPQPos + (startIdx / samplesPerBeat);
+    
+    mSubBlockOffset = startIdx;
+    
+    if (sampleSize == kSample32)
+      ProcessBuffers(0.f, endIdx - startIdx, startIdx); // single precision
+    else
+      ProcessBuffers(0.0, endIdx - startIdx, startIdx); // double precision
+    
+    startIdx = endIdx;
+  }
+  
+  // any changes at or beyond the end of the block
+  for (; pointIdx < nPoints; pointIdx++)
+    SetParameterFromHost(pPoints[pointIdx].idx, pPoints[pointIdx].value, pPoints[pointIdx].offset);
+  
+  mSubBlockOffset = 0;
+  mTimeInfo = blockTimeInfo;
+  mParamChangePoints.Resize(0, false);
+}
+
+void IPlugVST3ProcessorBase::ApplyParamChangePoints()
+{
+  const ParamChangePoint* pPoints = mParamChangePoints.Get();
+  
+  for (auto i = 0; i < mParamChangePoints.GetSize(); i++)
+    SetParameterFromHost(pPoints[i].idx, pPoints[i].value, pPoints[i].offset);
+  
+  mParamChangePoints.Resize(0, false);
 }
 
 void IPlugVST3ProcessorBase::ProcessAudio(ProcessData& data, ProcessSetup& setup, const BusList& ins, const BusList& outs)
@@ -369,34 +518,57 @@ void IPlugVST3ProcessorBase::ProcessAudio(ProcessData& data, ProcessSetup& setup
   
   if (sampleSize == kSample32 || sampleSize == kSample64)
   {
+    uint64_t inputSilenceFlags = 0;
+
+    for (int inBus = 0, chanOffset = 0; inBus < data.numInputs && chanOffset < 64; inBus++)
+    {
+      inputSilenceFlags |= data.inputs[inBus].silenceFlags << chanOffset;
+      chanOffset += data.inputs[inBus].numChannels;
+    }
+
+    SetInputSilenceFlags(inputSilenceFlags);
+
+    // the connections only change with the bus layout, the buffers are attached every block
+    const bool layoutChanged = UpdateBusLayout(data, ins, outs);
+
     if (data.numInputs)
     {
       if (HasSidechainInput())
       {
-        if (IsBusActive(ins, 1)) // Sidechain is active
-        {
-          mSidechainActive = true;
-          SetChannelConnections(ERoute::kInput, 0, MaxNChannels(ERoute::kInput), true);
-        }
-        else
+        const int sidechainStartIdx = GetBusChannelStartIdx(ERoute::kInput, 1);
+
+        if (layoutChanged)
         {
-          if (mSidechainActive)
+          if (IsBusActive(ins, 1)) // Sidechain is active
           {
-            ZeroScratchBuffers();
-            mSidechainActive = false;
+            mSidechainActive = true;
+            SetChannelConnections(ERoute::kInput, 0, MaxNChannels(ERoute::kInput), true);
+          }
+          else
+          {
+            if (mSidechainActive)
+            {
+              ZeroScratchBuffers();
+              mSidechainActive = false;
+            }
+            
+            SetChannelConnections(ERoute::kInput, 0, MaxNChannels(ERoute::kInput), true);
+            SetChannelConnections(ERoute::kInput, data.inputs[0].numChannels, MaxNChannels(ERoute::kInput) - data.inputs[0].numChannels, false);
           }
-          
-          SetChannelConnections(ERoute::kInput, 0, MaxNChannels(ERoute::kInput), true);
-          SetChannelConnections(ERoute::kInput, data.inputs[0].numChannels, MaxNChannels(ERoute::kInput) - NSidechainChannels(), false);
         }
         
-        AttachBuffers(ERoute::kInput, 0, MaxNChannels(ERoute::kInput) - NSidechainChannels(), data.inputs[0], data.numSamples, sampleSize);
-        AttachBuffers(ERoute::kInput, NSidechainChannels(), MaxNChannels(ERoute::kInput) - NSidechainChannels(), data.inputs[1], data.numSamples, sampleSize);
+        // the sidechain's channels follow the main bus's, see GetBusChannelStartIdx()
+        AttachBuffers(ERoute::kInput, 0, sidechainStartIdx, data.inputs[0], data.numSamples, sampleSize);
+        AttachBuffers(ERoute::kInput, sidechainStartIdx, MaxNChannels(ERoute::kInput) - sidechainStartIdx, data.inputs[1], data.numSamples, sampleSize);
       }
       else
       {
-        SetChannelConnections(ERoute::kInput, 0, data.inputs[0].numChannels, true);
-        SetChannelConnections(ERoute::kInput, data.inputs[0].numChannels, MaxNChannels(ERoute::kInput) - data.inputs[0].numChannels, false);
+        if (layoutChanged)
+        {
+          SetChannelConnections(ERoute::kInput, 0, data.inputs[0].numChannels, true);
+          SetChannelConnections(ERoute::kInput, data.inputs[0].numChannels, MaxNChannels(ERoute::kInput) - data.inputs[0].numChannels, false);
+        }
+
         AttachBuffers(ERoute::kInput, 0, MaxNChannels(ERoute::kInput), data.inputs[0], data.numSamples, sampleSize);
       }
     }
@@ -404,19 +576,34 @@ void IPlugVST3ProcessorBase::ProcessAudio(ProcessData& data, ProcessSetup& setup
     for (int outBus = 0, chanOffset = 0; outBus < data.numOutputs; outBus++)
     {
       int busChannels = data.outputs[outBus].numChannels;
-      SetChannelConnections(ERoute::kOutput, chanOffset, busChannels, IsBusActive(outs, outBus));
-      SetChannelConnections(ERoute::kOutput, chanOffset + busChannels, MaxNChannels(ERoute::kOutput) - (chanOffset + busChannels), false);
+
+      if (layoutChanged)
+      {
+        SetChannelConnections(ERoute::kOutput, chanOffset, busChannels, IsBusActive(outs, outBus));
+        SetChannelConnections(ERoute::kOutput, chanOffset + busChannels, MaxNChannels(ERoute::kOutput) - (chanOffset + busChannels), false);
+      }
+
       AttachBuffers(ERoute::kOutput, chanOffset, busChannels, data.outputs[outBus], data.numSamples, sampleSize);
       chanOffset += busChannels;
     }
     
     if (GetBypassed())
     {
+      ApplyParamChangePoints();
+      
       if (sampleSize == kSample32)
         PassThroughBuffers(0.f, data.numSamples); // single precision
       else
         PassThroughBuffers(0.0, data.numSamples); // double precision
     }
+    else if (sampleSize == kSample32 ? SkipSilentBuffers(0.f, data.numSamples) : SkipSilentBuffers(0.0, data.numSamples))
+    {
+      // the input has been silent for longer than the tail, the outputs were zeroed
+    }
+    else if (mParamChangePoints.GetSize())
+    {
+      ProcessSubBlocks(sampleSize, data.numSamples);
+    }
     else
     {
       if (sampleSize == kSample32)
@@ -424,12 +611,26 @@ void IPlugVST3ProcessorBase::ProcessAudio(ProcessData& data, ProcessSetup& setup
       else
         ProcessBuffers(0.0, data.numSamples); // double precision
     }
+
+    const uint64_t outputSilenceFlags = GetOutputSilenceFlags();
+
+    for (int outBus = 0, chanOffset = 0; outBus < data.numOutputs; outBus++)
+    {
+      const int busChannels = data.outputs[outBus].numChannels;
+      const uint64_t busMask = busChannels >= 64 ? ~uint64_t(0) : (uint64_t(1) << busChannels) - 1;
+      data.outputs[outBus].silenceFlags = chanOffset < 64 ? (outputSilenceFlags >> chanOffset) & busMask : 0;
+      chanOffset += busChannels;
+    }
   }
 }
 
-void IPlugVST3ProcessorBase::Process(ProcessData& data, ProcessSetup& setup, const BusList& ins, const BusList& outs, IPlugQueue<IMidiMsg>& fromEditor, IPlugQueue<IMidiMsg>& fromProcessor, IPlugQueue<SysExData>& sysExFromEditor, SysExData& sysExBuf)
+void IPlugVST3ProcessorBase::Process(ProcessData& data, ProcessSetup& setup, const BusList& ins, const BusList& outs, IPlugMPSCQueue<IMidiMsg>& fromEditor, IPlugQueue<IMidiMsg>& fromProcessor, IPlugSysExQueue& sysExFromEditor, WDL_TypedBuf<uint8_t>& sysExBuf)
 {
+  REALTIME_SCOPE;
+  IFlushDenormalsScope denormalsScope(GetFlushDenormals());
+
   PrepareProcessContext(data, setup);
+  mPlug.ProcessDeferredParamChanges();
   ProcessParameterChanges(data);
   
   if (DoesMIDIIn())
@@ -439,14 +640,28 @@ void IPlugVST3ProcessorBase::Process(ProcessData& data, ProcessSetup& setup, con
   
   ProcessAudio(data, setup, ins, outs);
   
+  // apply any timeline points that were not consumed by sub-block processing, e.g. if the host called process() without audio
+  ApplyParamChangePoints();
+  
   if (DoesMIDIOut())
   {
     ProcessMidiOut(sysExFromEditor, sysExBuf, data.outputEvents, data.numSamples);
   }
+  
+  ClearBlockEvents();
 }
 
 bool IPlugVST3ProcessorBase::SendMidiMsg(const IMidiMsg& msg)
 {
-  mMidiOutputQueue.Add(msg);
+  if (mSubBlockOffset)
+  {
+    // messages sent from ProcessBlock() during sub-block processing are relative to the sub-block
+    IMidiMsg offsetMsg = msg;
+    offsetMsg.mOffset += mSubBlockOffset;
+    mMidiOutputQueue.Add(offsetMsg);
+  }
+  else
+    mMidiOutputQueue.Add(msg);
+  
   return true;
 }
@@ -85,8 +85,8 @@ public:
   }
   
   // MIDI Processing
-  void ProcessMidiIn(Vst::IEventList* eventList, IPlugQueue<IMidiMsg>& editorQueue, IPlugQueue<IMidiMsg>& processorQueue);
-  void ProcessMidiOut(IPlugQueue<SysExData>& sysExQueue, SysExData& sysExBuf, Vst::IEventList* outputEvents, int32 numSamples);
+  void ProcessMidiIn(Vst::IEventList* eventList, IPlugMPSCQueue<IMidiMsg>& editorQueue, IPlugQueue<IMidiMsg>& processorQueue);
+  void ProcessMidiOut(IPlugSysExQueue& sysExQueue, WDL_TypedBuf<uint8_t>& sysExBuf, Vst::IEventList* outputEvents, int32 numSamples);
   
   // Audio Processing Setup
   void SetBusArrangments(Vst::SpeakerArrangement* pInputBusArrangements, int32 numInBuses, Vst::SpeakerArrangement* pOutputBusArrangements, int32 numOutBuses);
@@ -98,16 +98,47 @@ public:
   void PrepareProcessContext(Vst::ProcessData& data, Vst::ProcessSetup& setup);
   void ProcessParameterChanges(Vst::ProcessData& data);
   void ProcessAudio(Vst::ProcessData& data, Vst::ProcessSetup& setup, const Vst::BusList& ins, const Vst::BusList& outs);
-  void Process(Vst::ProcessData& data, Vst::ProcessSetup& setup, const Vst::BusList& ins, const Vst::BusList& outs, IPlugQueue<IMidiMsg>& fromEditor, IPlugQueue<IMidiMsg>& fromProcessor, IPlugQueue<SysExData>& sysExFromEditor, SysExData& sysExBuf);
+  void Process(Vst::ProcessData& data, Vst::ProcessSetup& setup, const Vst::BusList& ins, const Vst::BusList& outs, IPlugMPSCQueue<IMidiMsg>& fromEditor, IPlugQueue<IMidiMsg>& fromProcessor, IPlugSysExQueue& sysExFromEditor, WDL_TypedBuf<uint8_t>& sysExBuf);
   
   // IPlugProcessor overrides
   bool SendMidiMsg(const IMidiMsg& msg) override;
 
+  /** Opt-in to sample accurate parameter automation. Rather than only applying the last point of each parameter queue, every queued point is merged into a
+   * sorted timeline and the host block is split into sub-blocks between change points, calling ProcessBlock() for each sub-block.
+   * If you use IMidiQueue, make sure you call Flush(nFrames) at the end of ProcessBlock(), so that MIDI message offsets remain valid across sub-blocks.
+   * @param enable \c true in order to split the host block at parameter change points
+   * @param minSubBlockSize The smallest sub-block (in samples) that will be processed. Changes closer together than this will be applied at the start of the next sub-block */
+  void SetSampleAccurateAutomation(bool enable, int minSubBlockSize = DEFAULT_MIN_SUBBLOCK_SIZE);
+
+  /** @return \c true if sample accurate parameter automation is enabled, see SetSampleAccurateAutomation() */
+  bool GetSampleAccurateAutomation() const { return mSampleAccurateAutomation; }
+
 private:
+  /** A single point from a VST3 parameter queue, used to build the per-block timeline of parameter changes */
+  struct ParamChangePoint
+  {
+    int32 offset;
+    int32 order;
+    int idx;
+    double value;
+  };
+
+  void SetParameterFromHost(int idx, double normalizedValue, int32 offsetSamples);
+
+  /** @return \c true if the buses' channel counts or activity differ from the last block's, in which case the channel connections need setting */
+  bool UpdateBusLayout(const Vst::ProcessData& data, const Vst::BusList& ins, const Vst::BusList& outs);
+  void ProcessSubBlocks(int32 sampleSize, int32 numSamples);
+  void ApplyParamChangePoints();
+
   IPlugAPIBase& mPlug;
   Vst::ProcessContext mProcessContext;
   IMidiQueue mMidiOutputQueue;
   bool mSidechainActive = false;
+  bool mSampleAccurateAutomation = false;
+  int mMinSubBlockSize = DEFAULT_MIN_SUBBLOCK_SIZE;
+  int mSubBlockOffset = 0;
+  WDL_TypedBuf<ParamChangePoint> mParamChangePoints;
+  WDL_TypedBuf<int32> mBusLayout, mNextBusLayout; // see UpdateBusLayout(), empty until the first block and after the arrangement or setup changes
 };
 
 END_IPLUG_NAMESPACE
@@ -10,8 +10,12 @@
 
 #include "IPlugWAM.h"
 
+#include <emscripten.h>
+
 using namespace iplug;
 
+static const int kMsgsToControllerReserve = 16384;
+
 IPlugWAM::IPlugWAM(const InstanceInfo& info, const Config& config)
 : IPlugAPIBase(config, kAPIWAM)
 , IPlugProcessor(config, kAPIWAM)
@@ -20,6 +24,9 @@ IPlugWAM::IPlugWAM(const InstanceInfo& info, const Config& config)
 
   SetChannelConnections(ERoute::kInput, 0, nInputs, true);
   SetChannelConnections(ERoute::kOutput, 0, nOutputs, true);
+
+  mMsgsToController.Resize(kMsgsToControllerReserve, false);
+  mMsgsToController.Resize(0, false);
 }
 
 const char* IPlugWAM::init(uint32_t bufsize, uint32_t sr, void* pDesc)
@@ -58,31 +65,36 @@ const char* IPlugWAM::init(uint32_t bufsize, uint32_t sr, void* pDesc)
 
 void IPlugWAM::onProcess(WAM::AudioBus* pAudio, void* pData)
 {
+  IFlushDenormalsScope denormalsScope(GetFlushDenormals());
   const int blockSize = GetBlockSize();
   
+  ProcessDeferredParamChanges();
+  
   SetChannelConnections(ERoute::kInput, 0, MaxNChannels(ERoute::kInput), !IsInstrument()); //TODO: go elsewhere
   SetChannelConnections(ERoute::kOutput, 0, MaxNChannels(ERoute::kOutput), true); //TODO: go elsewhere
   AttachBuffers(ERoute::kInput, 0, NChannelsConnected(ERoute::kInput), pAudio->inputs, blockSize);
   AttachBuffers(ERoute::kOutput, 0, NChannelsConnected(ERoute::kOutput), pAudio->outputs, blockSize);
-  ProcessBuffers((float) 0.0f, blockSize);
+
+  if (!SkipSilentBuffers((float) 0.0f, blockSize))
+    ProcessBuffers((float) 0.0f, blockSize);
+
+  ClearBlockEvents();
   
+  // parameter changes and MIDI are queued for the controller every block, the processor script passes them on after this returns
+  mParamChangeFromProcessor.ForEachChanged([&](int paramIdx, double value) {
+    SendParameterValueFromDelegate(paramIdx, value, false);
+  });
+
+  while (mMidiMsgsFromProcessor.ElementsAvailable())
+  {
+    IMidiMsg msg;
+    mMidiMsgsFromProcessor.Pop(msg);
+    SendMidiMsgFromDelegate(msg);
+  }
+
   //emulate IPlugAPIBase::OnTimer - should be called on the main thread - how to do that in audio worklet processor?
   if(mBlockCounter == 0)
   {
-    while(mParamChangeFromProcessor.ElementsAvailable())
-    {
-      ParamTuple p;
-      mParamChangeFromProcessor.Pop(p);
-      SendParameterValueFromDelegate(p.idx, p.value, false);
-    }
-    
-    while (mMidiMsgsFromProcessor.ElementsAvailable())
-    {
-      IMidiMsg msg;
-      mMidiMsgsFromProcessor.Pop(msg);
-      SendMidiMsgFromDelegate(msg);
-    }
-        
     OnIdle();
     
     mBlockCounter = 8; // 8 * 128 samples = 23ms @ 44100 sr
@@ -145,18 +157,14 @@ void IPlugWAM::onMidi(byte status, byte data1, byte data2)
   ProcessMidiMsg(msg); // onMidi is not called on HPT. We could queue things up, but just process the message straightaway for now
   //mMidiMsgsFromProcessor.Push(msg);
   
-  WDL_String dataStr;
-  dataStr.SetFormatted(16, "%i:%i:%i", msg.mStatus, msg.mData1, msg.mData2);
-  
-  // TODO: in the future this will be done via shared array buffer
-  // if onMidi ever gets called on HPT, should defer via queue
-  postMessage("SMMFD", dataStr.Get(), "");
+  SendMidiMsgFromDelegate(msg);
 }
 
 void IPlugWAM::onParam(uint32_t idparam, double value)
 {
 //  DBGMSG("IPlugWAM:: onParam %i %f\n", idparam, value);
   SetParameterValue(idparam, value);
+  WakeFromSilence();
 }
 
 void IPlugWAM::onSysex(byte* pData, uint32_t size)
@@ -164,52 +172,81 @@ void IPlugWAM::onSysex(byte* pData, uint32_t size)
   ISysEx sysex = {0 /* no offset */, pData, (int) size };
   ProcessSysEx(sysex);
   
-  WDL_String dataStr;
-  dataStr.SetFormatted(16, "%i", size);
-  
-  // TODO: in the future this will be done via shared array buffer
-  // if onSysex ever gets called on HPT, should defer via queue
-  postMessage("SSMFD", dataStr.Get(), "");
+  SendSysexMsgFromDelegate(sysex);
 }
 
-void IPlugWAM::SendControlValueFromDelegate(int controlTag, double normalizedValue)
+void IPlugWAM::AddMsgToController(EWAMMsgToController type, const void* pHeader, int headerSize, const void* pData, int dataSize)
 {
-  WDL_String propStr;
-  WDL_String dataStr;
+  const int pos = mMsgsToController.GetSize();
+  uint8_t* pMsg = mMsgsToController.ResizeOK(pos + 1 + headerSize + dataSize, false);
+
+  if (!pMsg)
+    return;
+
+  pMsg += pos;
+  *pMsg++ = type;
+  memcpy(pMsg, pHeader, headerSize);
+
+  if (dataSize)
+    memcpy(pMsg + headerSize, pData, dataSize);
+}
 
-  propStr.SetFormatted(16, "%i", controlTag);
-  dataStr.SetFormatted(16, "%f", normalizedValue);
+void IPlugWAM::SendControlValueFromDelegate(int controlTag, double normalizedValue)
+{
+  uint8_t header[sizeof(int) + sizeof(double)];
+  memcpy(header, &controlTag, sizeof(int));
+  memcpy(header + sizeof(int), &normalizedValue, sizeof(double));
 
-  // TODO: in the future this will be done via shared array buffer
-  postMessage("SCVFD", propStr.Get(), dataStr.Get());
+  AddMsgToController(kWAMMsgSCVFD, header, sizeof(header));
 }
 
 void IPlugWAM::SendControlMsgFromDelegate(int controlTag, int messageTag, int dataSize, const void* pData)
 {
-  WDL_String propStr;
-  propStr.SetFormatted(16, "%i:%i", controlTag, messageTag);
-  
-  // TODO: in the future this will be done via shared array buffer
-  postMessage("SCMFD", propStr.Get(), pData, (uint32_t) dataSize);
+  const int header[3] = {controlTag, messageTag, dataSize};
+  AddMsgToController(kWAMMsgSCMFD, header, sizeof(header), pData, dataSize);
 }
 
 void IPlugWAM::SendParameterValueFromDelegate(int paramIdx, double value, bool normalized)
 {
-  WDL_String propStr;
-  WDL_String dataStr;
-  propStr.SetFormatted(16, "%i", paramIdx);
-  dataStr.SetFormatted(16, "%f", value);
+  uint8_t header[sizeof(int) + sizeof(double)];
+  memcpy(header, &paramIdx, sizeof(int));
+  memcpy(header + sizeof(int), &value, sizeof(double));
 
-  // TODO: in the future this will be done via shared array buffer
-  postMessage("SPVFD", propStr.Get(), dataStr.Get());
+  AddMsgToController(kWAMMsgSPVFD, header, sizeof(header));
 }
 
 void IPlugWAM::SendArbitraryMsgFromDelegate(int messageTag, int dataSize, const void* pData)
 {
-  WDL_String propStr;
-  propStr.SetFormatted(16, "%i", messageTag);
-  
-  // TODO: in the future this will be done via shared array buffer
-  postMessage("SAMFD", propStr.Get(), pData, (uint32_t) dataSize);
+  const int header[2] = {messageTag, dataSize};
+  AddMsgToController(kWAMMsgSAMFD, header, sizeof(header), pData, dataSize);
+}
+
+void IPlugWAM::SendMidiMsgFromDelegate(const IMidiMsg& msg)
+{
+  const uint8_t header[3] = {msg.mStatus, msg.mData1, msg.mData2};
+  AddMsgToController(kWAMMsgSMMFD, header, sizeof(header));
+}
+
+void IPlugWAM::SendSysexMsgFromDelegate(const ISysEx& msg)
+{
+  AddMsgToController(kWAMMsgSSMFD, &msg.mSize, sizeof(int), msg.mData, msg.mSize);
 }
 
+// called by IPlugWAM-awp.js with the instance pointer that createModule() returned
+extern "C"
+{
+  EMSCRIPTEN_KEEPALIVE const uint8_t* iplug_wam_getmsgs(void* pInst)
+  {
+    return dynamic_cast<IPlugWAM*>(static_cast<Processor*>(pInst))->GetMsgsToController();
+  }
+
+  EMSCRIPTEN_KEEPALIVE int iplug_wam_getmsgssize(void* pInst)
+  {
+    return dynamic_cast<IPlugWAM*>(static_cast<Processor*>(pInst))->GetMsgsToControllerSize();
+  }
+
+  EMSCRIPTEN_KEEPALIVE void iplug_wam_clearmsgs(void* pInst)
+  {
+    dynamic_cast<IPlugWAM*>(static_cast<Processor*>(pInst))->ClearMsgsToController();
+  }
+}
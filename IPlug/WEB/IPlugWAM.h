@@ -23,6 +23,19 @@ BEGIN_IPLUG_NAMESPACE
 struct InstanceInfo
 {};
 
+/** The types of the binary messages that the processor sends to the controller, once per block. They must match the
+ * kMsg constants in IPlugWAM-ring.js. Every message starts with one of these bytes, followed by the data that the
+ * equivalent IEditorDelegate method takes, with ints as int32 and doubles as float64 */
+enum EWAMMsgToController : uint8_t
+{
+  kWAMMsgSPVFD = 1, // int paramIdx, double value
+  kWAMMsgSCVFD, // int controlTag, double normalizedValue
+  kWAMMsgSCMFD, // int controlTag, int messageTag, int dataSize, data
+  kWAMMsgSAMFD, // int messageTag, int dataSize, data
+  kWAMMsgSMMFD, // uint8 status, data1, data2
+  kWAMMsgSSMFD // int dataSize, data
+};
+
 /** WebAudioModule (WAM) API base class. This is used for the DSP processor side of a WAM, which is sandboxed and lives in the AudioWorkletGlobalScope
  * @ingroup APIClasses */
 class IPlugWAM : public IPlugAPIBase
@@ -55,9 +68,21 @@ public:
   void SendControlMsgFromDelegate(int controlTag, int messageTag, int dataSize, const void* pData) override;
   void SendParameterValueFromDelegate(int paramIdx, double value, bool normalized) override;
   void SendArbitraryMsgFromDelegate(int messageTag, int dataSize = 0, const void* pData = nullptr) override;
-  
+  void SendMidiMsgFromDelegate(const IMidiMsg& msg) override;
+  void SendMidiMsgsFromDelegate(const IMidiMsg* pMsgs, int nMsgs) override { IEditorDelegate::SendMidiMsgsFromDelegate(pMsgs, nMsgs); }
+  void SendSysexMsgFromDelegate(const ISysEx& msg) override;
+
+  /** The messages queued for the controller since the last call to ClearMsgsToController(). The processor script copies them
+   * into a SharedArrayBuffer ring after every block, or posts them in one message when the page isn't cross-origin isolated */
+  const uint8_t* GetMsgsToController() const { return mMsgsToController.Get(); }
+  int GetMsgsToControllerSize() const { return mMsgsToController.GetSize(); }
+  void ClearMsgsToController() { mMsgsToController.Resize(0, false); }
+
 private:
+  void AddMsgToController(EWAMMsgToController type, const void* pHeader, int headerSize, const void* pData = nullptr, int dataSize = 0);
+
   int mBlockCounter = 0;
+  WDL_TypedBuf<uint8_t> mMsgsToController;
 };
 
 IPlugWAM* MakePlug(const InstanceInfo& info);
@@ -19,14 +19,58 @@ class NAME_PLACEHOLDERController extends WAMController
       options.buflenSPN = 512
     }
 
+    // parameters, MIDI and messages go both ways through SharedArrayBuffer rings when the page allows it, rather than with postMessage()
+    let ringToProcessor, ringToController;
+
+    if (IPlugSharedRing.isSupported()) {
+      ringToProcessor = IPlugSharedRing.create(IPlugSharedRing.kCapacity);
+      ringToController = IPlugSharedRing.create(IPlugSharedRing.kCapacity);
+      options.processorOptions.iplugRings = { toProcessor: ringToProcessor, toController: ringToController };
+    }
+
     super(actx, "NAME_PLACEHOLDER", options);
+
+    if (ringToProcessor) {
+      this.ringToProcessor = new IPlugSharedRing(ringToProcessor);
+      this.ringToController = new IPlugSharedRing(ringToController);
+      this.ringMsg = new DataView(new ArrayBuffer(IPlugSharedRing.kCapacity));
+    }
+
+    // audio can start before the UI module has loaded, messages for the UI wait here until it is ready
+    this.pendingMsgs = [];
+
+    // the UI can't show anything faster than the display refreshes, so the ring is read once per frame
+    const readMessages = () => {
+      if (Module.iplugReady) {
+        this.pendingMsgs.forEach((msg) => this.onMessagesFromProcessor(msg));
+        this.pendingMsgs = [];
+
+        if (this.ringToController)
+          this.ringToController.popAll((msg) => this.onMessagesFromProcessor(msg));
+      }
+
+      requestAnimationFrame(readMessages);
+    }
+
+    requestAnimationFrame(readMessages);
+  }
+
+  // true if the browser can run the -wam-simd.js module, this validates a tiny module that uses SIMD128 instructions
+  static supportsSIMD() {
+    try {
+      return WebAssembly.validate(new Uint8Array([0,97,115,109,1,0,0,0,1,5,1,96,0,1,123,3,2,1,0,10,10,1,8,0,65,0,253,15,253,98,11]));
+    }
+    catch (e) {
+      return false;
+    }
   }
 
   static importScripts (actx) {
     var origin = "ORIGIN_PLACEHOLDER";
+    var wamScript = NAME_PLACEHOLDERController.supportsSIMD() ? "scripts/NAME_PLACEHOLDER-wam-simd.js" : "scripts/NAME_PLACEHOLDER-wam.js";
 
     return new Promise( (resolve) => {
-      actx.audioWorklet.addModule(origin + "scripts/NAME_PLACEHOLDER-wam.js").then(() => {
+      actx.audioWorklet.addModule(origin + wamScript).then(() => {
       actx.audioWorklet.addModule(origin + "scripts/wam-processor.js").then(() => {
       actx.audioWorklet.addModule(origin + "scripts/NAME_PLACEHOLDER-awp.js").then(() => {
         resolve();
@@ -34,49 +78,129 @@ class NAME_PLACEHOLDERController extends WAMController
     })
   }
 
-  onmessage(msg) {
-    //Received the WAM descriptor from the processor - could create an HTML UI here, based on descriptor
-    if(msg.type == "descriptor") {
-      console.log("got WAM descriptor...");
-    }
+  setParam(key, value) {
+    if (this.ringToProcessor && typeof key === "number") {
+      this.ringMsg.setUint8(0, IPlugSharedRing.kMsgParam);
+      this.ringMsg.setInt32(1, key, true);
+      this.ringMsg.setFloat64(5, value, true);
 
-    //Send Parameter Value From Delegate
-    if(msg.verb == "SPVFD") {
-      Module.SPVFD(parseInt(msg.prop), parseFloat(msg.data));
+      if (this.ringToProcessor.push(new Uint8Array(this.ringMsg.buffer, 0, 13)))
+        return;
     }
-    //Set Control Value From Delegate
-    else if(msg.verb == "SCVFD") {
-      Module.SCVFD(parseInt(msg.prop), parseFloat(msg.data));
+
+    super.setParam(key, value); // the ring is full, or there isn't one
+  }
+
+  sendMessage(verb, prop, data) {
+    if (this.ringToProcessor) {
+      const dv = this.ringMsg;
+      let pos = 0;
+
+      const putString = (str) => {
+        dv.setUint16(pos, str.length, true); pos += 2;
+        for (let i = 0; i < str.length; i++) { dv.setUint16(pos, str.charCodeAt(i), true); pos += 2; }
+      }
+
+      const dataBytes = (data instanceof ArrayBuffer) ? new Uint8Array(data) : ArrayBuffer.isView(data) ? new Uint8Array(data.buffer, data.byteOffset, data.byteLength) : undefined;
+      const dataString = (typeof data === "string") ? data : undefined;
+      const size = 1 + 2 * (2 + verb.length + 2 + prop.length) + 1 + (dataBytes ? 4 + dataBytes.length : dataString !== undefined ? 2 + 2 * dataString.length : 8);
+
+      if (size <= dv.byteLength) {
+        dv.setUint8(pos, IPlugSharedRing.kMsgMessage); pos++;
+        putString(verb);
+        putString(prop);
+
+        if (dataBytes) {
+          dv.setUint8(pos, IPlugSharedRing.kDataBytes); pos++;
+          dv.setUint32(pos, dataBytes.length, true); pos += 4;
+          new Uint8Array(dv.buffer, pos, dataBytes.length).set(dataBytes); pos += dataBytes.length;
+        }
+        else if (dataString !== undefined) {
+          dv.setUint8(pos, IPlugSharedRing.kDataString); pos++;
+          putString(dataString);
+        }
+        else {
+          dv.setUint8(pos, IPlugSharedRing.kDataNumber); pos++;
+          dv.setFloat64(pos, Number(data), true); pos += 8;
+        }
+
+        if (this.ringToProcessor.push(new Uint8Array(dv.buffer, 0, pos)))
+          return;
+      }
     }
-    //Send Control Message From Delegate
-    else if(msg.verb == "SCMFD") {
-      var res = msg.prop.split(":");
-      var data = new Uint8Array(msg.data);
-      const buffer = Module._malloc(data.length);
-      Module.HEAPU8.set(data, buffer);
-      Module.SCMFD(parseInt(res[0]), parseInt(res[1]), data.length, buffer);
+
+    super.sendMessage(verb, prop, data); // the ring is full, or there isn't one
+  }
+
+  // dispatches a block of messages queued by IPlugWAM, which arrive through the ring or, without one, as an IPLUGMSGS message
+  onMessagesFromProcessor(bytes) {
+    const dv = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+    let pos = 0;
+
+    const callWithData = (size, func) => {
+      const buffer = Module._malloc(size);
+      Module.HEAPU8.set(bytes.subarray(pos, pos + size), buffer);
+      func(buffer);
       Module._free(buffer);
+      pos += size;
     }
-    //Send Arbitrary Message From Delegate
-    else if(msg.verb == "SAMFD") {
-      var data = new Uint8Array(msg.data);
-      const buffer = Module._malloc(data.length);
-      Module.HEAPU8.set(data, buffer);
-      Module.SAMFD(parseInt(msg.prop), data.length, buffer);
-      Module._free(buffer);
+
+    while (pos < bytes.length) {
+      const type = dv.getUint8(pos); pos++;
+
+      //Send Parameter Value From Delegate
+      if (type == IPlugSharedRing.kMsgSPVFD) {
+        const paramIdx = dv.getInt32(pos, true); pos += 4;
+        const value = dv.getFloat64(pos, true); pos += 8;
+        Module.SPVFD(paramIdx, value);
+      }
+      //Set Control Value From Delegate
+      else if (type == IPlugSharedRing.kMsgSCVFD) {
+        const controlTag = dv.getInt32(pos, true); pos += 4;
+        const value = dv.getFloat64(pos, true); pos += 8;
+        Module.SCVFD(controlTag, value);
+      }
+      //Send Control Message From Delegate
+      else if (type == IPlugSharedRing.kMsgSCMFD) {
+        const controlTag = dv.getInt32(pos, true); pos += 4;
+        const msgTag = dv.getInt32(pos, true); pos += 4;
+        const dataSize = dv.getInt32(pos, true); pos += 4;
+        callWithData(dataSize, (buffer) => Module.SCMFD(controlTag, msgTag, dataSize, buffer));
+      }
+      //Send Arbitrary Message From Delegate
+      else if (type == IPlugSharedRing.kMsgSAMFD) {
+        const msgTag = dv.getInt32(pos, true); pos += 4;
+        const dataSize = dv.getInt32(pos, true); pos += 4;
+        callWithData(dataSize, (buffer) => Module.SAMFD(msgTag, dataSize, buffer));
+      }
+      //Send MIDI Message From Delegate
+      else if (type == IPlugSharedRing.kMsgSMMFD) {
+        Module.SMMFD(bytes[pos], bytes[pos + 1], bytes[pos + 2]); pos += 3;
+      }
+      //Send Sysex Message From Delegate
+      else if (type == IPlugSharedRing.kMsgSSMFD) {
+        const dataSize = dv.getInt32(pos, true); pos += 4;
+        callWithData(dataSize, (buffer) => Module.SSMFD(dataSize, buffer));
+      }
+      else {
+        console.log("unknown message from the processor");
+        break;
+      }
     }
-    //Send MIDI Message From Delegate
-    else if(msg.verb == "SMMFD") {
-      var res = msg.prop.split(":");
-      Module.SMMFD(parseInt(res[0]), parseInt(res[1]), parseInt(res[2]));
+  }
+
+  onmessage(msg) {
+    //Received the WAM descriptor from the processor - could create an HTML UI here, based on descriptor
+    if(msg.type == "descriptor") {
+      console.log("got WAM descriptor...");
     }
-    //Send Sysex Message From Delegate
-    else if(msg.verb == "SSMFD") {
-      var data = new Uint8Array(msg.data);
-      const buffer = Module._malloc(data.length);
-      Module.HEAPU8.set(data, buffer);
-      Module.SSMFD(parseInt(msg.prop), data.length, buffer);
-      Module._free(buffer);
+
+    //Messages from the processor that didn't go through the ring
+    if(msg.verb == "IPLUGMSGS") {
+      if (Module.iplugReady && this.pendingMsgs.length == 0)
+        this.onMessagesFromProcessor(new Uint8Array(msg.data));
+      else
+        this.pendingMsgs.push(new Uint8Array(msg.data));
     }
   }
 }
@@ -6,6 +6,78 @@ class NAME_PLACEHOLDER_AWP extends AudioWorkletGlobalScope.WAMProcessor
     options = options || {}
     options.mod = AudioWorkletGlobalScope.WAM.NAME_PLACEHOLDER;
     super(options);
+
+    this.mod = options.mod;
+
+    const rings = options.processorOptions && options.processorOptions.iplugRings;
+
+    if (rings) {
+      this.ringToProcessor = new IPlugSharedRing(rings.toProcessor);
+      this.ringToController = new IPlugSharedRing(rings.toController);
+    }
+  }
+
+  process(inputs, outputs, params) {
+    if (this.ringToProcessor)
+      this.ringToProcessor.popAll((msg) => this.onMessageFromController(msg));
+
+    const keepAlive = super.process(inputs, outputs, params);
+
+    this.sendMessagesToController();
+
+    return keepAlive;
+  }
+
+  // IPlugWAM queues its messages for the controller while processing, they are passed on once per block
+  sendMessagesToController() {
+    const size = this.mod._iplug_wam_getmsgssize(this.inst);
+
+    if (size == 0)
+      return;
+
+    const ptr = this.mod._iplug_wam_getmsgs(this.inst);
+    const msgs = this.mod.HEAPU8.subarray(ptr, ptr + size);
+
+    if (!this.ringToController || !this.ringToController.push(msgs)) {
+      const copy = msgs.slice(); // the ring is full, or there isn't one
+      this.port.postMessage({ verb: "IPLUGMSGS", prop: "", data: copy.buffer }, [copy.buffer]);
+    }
+
+    this.mod._iplug_wam_clearmsgs(this.inst);
+  }
+
+  // a setParam() or sendMessage() call on the controller, see IPlugWAM-awn.js
+  onMessageFromController(bytes) {
+    const dv = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+    let pos = 0;
+
+    const getString = () => {
+      const length = dv.getUint16(pos, true); pos += 2;
+      let str = "";
+      for (let i = 0; i < length; i++) { str += String.fromCharCode(dv.getUint16(pos, true)); pos += 2; }
+      return str;
+    }
+
+    const type = dv.getUint8(pos); pos++;
+
+    if (type == IPlugSharedRing.kMsgParam) {
+      const idx = dv.getInt32(pos, true); pos += 4;
+      this.onparam(idx, dv.getFloat64(pos, true));
+    }
+    else if (type == IPlugSharedRing.kMsgMessage) {
+      const verb = getString();
+      const prop = getString();
+      const dataType = dv.getUint8(pos); pos++;
+
+      if (dataType == IPlugSharedRing.kDataBytes) {
+        const size = dv.getUint32(pos, true); pos += 4;
+        this.onmsg(verb, prop, bytes.slice(pos, pos + size).buffer);
+      }
+      else if (dataType == IPlugSharedRing.kDataString)
+        this.onmsg(verb, prop, getString());
+      else
+        this.onmsg(verb, prop, dv.getFloat64(pos, true));
+    }
   }
 }
 
@@ -0,0 +1,93 @@
+/* A lock-free single producer, single consumer ring of variable length messages over a SharedArrayBuffer.
+ * The WAM controller creates one ring in each direction and passes them to the processor in its processorOptions.
+ * This script is prepended to the -awn.js and -awp.js scripts by makedist-web.sh */
+
+var IPlugSharedRing = IPlugSharedRing || class {
+  // returns the SharedArrayBuffer to pass to the constructor on both sides
+  static create(capacity) {
+    return new SharedArrayBuffer(IPlugSharedRing.kHeaderBytes + capacity);
+  }
+
+  // SharedArrayBuffer needs a cross-origin isolated page, if it isn't available the controller and processor use their MessagePort
+  static isSupported() {
+    return typeof SharedArrayBuffer !== "undefined" && (typeof crossOriginIsolated === "undefined" || crossOriginIsolated);
+  }
+
+  constructor(sab) {
+    this.indices = new Int32Array(sab, 0, 2); // read position, write position
+    this.data = new Uint8Array(sab, IPlugSharedRing.kHeaderBytes);
+    this.capacity = this.data.length;
+    this.scratch = new Uint8Array(this.capacity);
+    this.sizeBytes = new Uint8Array(4);
+    this.sizeView = new DataView(this.sizeBytes.buffer);
+  }
+
+  // writes a Uint8Array as one message, returns false without writing anything if there isn't room for it
+  push(bytes) {
+    const read = Atomics.load(this.indices, 0);
+    const write = Atomics.load(this.indices, 1);
+    const used = (write - read + this.capacity) % this.capacity;
+
+    if (4 + bytes.length > this.capacity - used - 1)
+      return false;
+
+    this.sizeView.setUint32(0, bytes.length, true);
+    let pos = this.copyIn(this.sizeBytes, write);
+    pos = this.copyIn(bytes, pos);
+    Atomics.store(this.indices, 1, pos);
+    return true;
+  }
+
+  // calls onMessage with each message that has been pushed. The Uint8Array it gets is only valid until it returns
+  popAll(onMessage) {
+    let read = Atomics.load(this.indices, 0);
+    const write = Atomics.load(this.indices, 1);
+
+    while (read != write) {
+      read = this.copyOut(this.sizeBytes, read);
+      const msg = this.scratch.subarray(0, this.sizeView.getUint32(0, true));
+      read = this.copyOut(msg, read);
+      onMessage(msg);
+    }
+
+    Atomics.store(this.indices, 0, read);
+  }
+
+  copyIn(bytes, pos) {
+    const first = Math.min(bytes.length, this.capacity - pos);
+    this.data.set(bytes.subarray(0, first), pos);
+
+    if (first < bytes.length)
+      this.data.set(bytes.subarray(first), 0);
+
+    return (pos + bytes.length) % this.capacity;
+  }
+
+  copyOut(dest, pos) {
+    const first = Math.min(dest.length, this.capacity - pos);
+    dest.set(this.data.subarray(pos, pos + first));
+
+    if (first < dest.length)
+      dest.set(this.data.subarray(0, dest.length - first), first);
+
+    return (pos + dest.length) % this.capacity;
+  }
+};
+
+IPlugSharedRing.kHeaderBytes = 8;
+IPlugSharedRing.kCapacity = 65536;
+
+// messages from the processor, these must match EWAMMsgToController in IPlugWAM.h
+IPlugSharedRing.kMsgSPVFD = 1;
+IPlugSharedRing.kMsgSCVFD = 2;
+IPlugSharedRing.kMsgSCMFD = 3;
+IPlugSharedRing.kMsgSAMFD = 4;
+IPlugSharedRing.kMsgSMMFD = 5;
+IPlugSharedRing.kMsgSSMFD = 6;
+
+// messages from the controller, which stand in for WAMController.setParam() and sendMessage()
+IPlugSharedRing.kMsgParam = 1; // int32 index, float64 value
+IPlugSharedRing.kMsgMessage = 2; // verb, prop, data type, data
+IPlugSharedRing.kDataNumber = 0; // float64
+IPlugSharedRing.kDataString = 1; // uint16 length, chars
+IPlugSharedRing.kDataBytes = 2; // uint32 length, bytes
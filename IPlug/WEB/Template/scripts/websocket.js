@@ -27,6 +27,21 @@ function setupWebSocket(onCompleted) {
           var value = dv.getFloat64(pos, true); pos += 8;
           Module.SPVFD(paramIdx, value);
         }
+        //Send Parameter Values From Delegate, a batch of varint parameter indexes and float32 values
+        else if(prefix == "SPVFDB") {
+          while(pos < buf.byteLength) {
+            var paramIdx = 0;
+            var shift = 0;
+            var byte;
+            do {
+              byte = dv.getUint8(pos++);
+              paramIdx |= (byte & 0x7f) << shift;
+              shift += 7;
+            } while(byte & 0x80);
+            var value = dv.getFloat32(pos, true); pos += 4;
+            Module.SPVFD(paramIdx, value);
+          }
+        }
         //Send Control Message From Delegate
         else if(prefix == "SCVDD") {
           var controlTag = dv.getInt32(pos, true); pos += 4;
@@ -63,6 +78,17 @@ function setupWebSocket(onCompleted) {
           var data2 = dv.getUint8(pos, true); pos ++;
           Module.SMMFD(status, data1, data2);
         }
+        //Send FrameBuffer From Delegate, a deflated RGBA strip of the server's UI, drawn into a canvas with the id "framebuffer" if the page has one
+        else if(prefix == "SFBFD") {
+          var frameWidth = dv.getInt32(pos, true); pos += 4;
+          var frameHeight = dv.getInt32(pos, true); pos += 4;
+          var x = dv.getInt32(pos, true); pos += 4;
+          var y = dv.getInt32(pos, true); pos += 4;
+          var w = dv.getInt32(pos, true); pos += 4;
+          var h = dv.getInt32(pos, true); pos += 4;
+          var size = dv.getInt32(pos, true); pos += 4;
+          drawFrameStrip(frameWidth, frameHeight, x, y, w, h, new Uint8Array(buf, pos, size));
+        }
         //Send Sysex Message From Delegate
         else if(prefix == "SSMFD") {
           var msgTag = dv.getInt32(pos, true); pos += 4;
@@ -83,4 +109,68 @@ function setupWebSocket(onCompleted) {
   }
 
   onCompleted();
-}
\ No newline at end of file
+}
+
+var frameCanvas = null;
+var frameStrips = Promise.resolve(); // strips are drawn in the order they arrive
+
+function drawFrameStrip(frameWidth, frameHeight, x, y, w, h, compressed) {
+  var canvas = document.getElementById("framebuffer");
+
+  if(!canvas)
+    return;
+
+  if(canvas !== frameCanvas) {
+    frameCanvas = canvas;
+    addFrameInputListeners(canvas);
+  }
+
+  if(canvas.width != frameWidth || canvas.height != frameHeight) {
+    canvas.width = frameWidth;
+    canvas.height = frameHeight;
+  }
+
+  var stream = new Blob([compressed]).stream().pipeThrough(new DecompressionStream("deflate"));
+  var pixels = new Response(stream).arrayBuffer();
+
+  frameStrips = frameStrips.then(function() { return pixels; }).then(function(rgba) {
+    canvas.getContext("2d").putImageData(new ImageData(new Uint8ClampedArray(rgba), w, h), x, y);
+  });
+}
+
+// event types and modifier bits match IWebsocketEditorDelegate
+function sendFrameInput(type, x, y, dX, dY, e, vk, key) {
+  var buttons = type <= 1 ? (e.button == 2 ? 2 : 1) : e.buttons; // buttons doesn't include the one being pressed or released
+  var mods = (buttons & 1 ? 1 : 0) | (buttons & 2 ? 2 : 0) | (e.shiftKey ? 4 : 0) | (e.ctrlKey || e.metaKey ? 8 : 0) | (e.altKey ? 16 : 0);
+  var prefix = new TextEncoder().encode("SIEFUI");
+  var utf8 = new TextEncoder().encode(key && key.length == 1 ? key : "");
+  var data = new ArrayBuffer(6 + 7 * 4 + 4);
+  var dv = new DataView(data);
+  new Uint8Array(data).set(prefix, 0);
+  var pos = 6;
+  dv.setInt32(pos, type, true); pos += 4;
+  dv.setFloat32(pos, x, true); pos += 4;
+  dv.setFloat32(pos, y, true); pos += 4;
+  dv.setFloat32(pos, dX, true); pos += 4;
+  dv.setFloat32(pos, dY, true); pos += 4;
+  dv.setInt32(pos, mods, true); pos += 4;
+  dv.setInt32(pos, vk, true); pos += 4;
+  new Uint8Array(data, pos, 4).set(utf8.subarray(0, 4));
+  ws.send(data);
+}
+
+function addFrameInputListeners(canvas) {
+  function toFrame(e) {
+    var r = canvas.getBoundingClientRect();
+    return [(e.clientX - r.left) * canvas.width / r.width, (e.clientY - r.top) * canvas.height / r.height, canvas.width / r.width];
+  }
+
+  canvas.tabIndex = 0;
+  canvas.addEventListener("contextmenu", function(e) { e.preventDefault(); });
+  canvas.addEventListener("mousedown", function(e) { var p = toFrame(e); canvas.focus(); sendFrameInput(0, p[0], p[1], 0, 0, e, 0); });
+  canvas.addEventListener("mouseup", function(e) { var p = toFrame(e); sendFrameInput(1, p[0], p[1], 0, 0, e, 0); });
+  canvas.addEventListener("mousemove", function(e) { var p = toFrame(e); sendFrameInput(e.buttons ? 2 : 3, p[0], p[1], e.movementX * p[2], e.movementY * p[2], e, 0); });
+  canvas.addEventListener("wheel", function(e) { var p = toFrame(e); e.preventDefault(); sendFrameInput(4, p[0], p[1], 0, -Math.sign(e.deltaY), e, 0); });
+  canvas.addEventListener("keydown", function(e) { sendFrameInput(5, 0, 0, 0, 0, e, e.keyCode, e.key); });
+  canvas.addEventListener("keyup", function(e) { sendFrameInput(6, 0, 0, 0, 0, e, e.keyCode, e.key); });
+}
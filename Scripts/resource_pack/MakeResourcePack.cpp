@@ -0,0 +1,153 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line tool that makes a resource pack (see IResourcePack) from a plug-in's PNG, JPEG and SVG resources, so that
+ * IGraphics::LoadResourcePack() can load them without decoding or parsing. Bitmaps named like knob@2x.png are stored as knob.png at scale 2.
+ * SVGs are parsed with the units and dpi given, which must match those LoadSVG() is called with (by default "px" and 72).
+ * Usage: MakeResourcePack [--units px] [--dpi 72] output.pack resources...
+ * Build with make -f MakeResourcePack.mk, or on Windows: cl /O2 /EHsc /DNDEBUG /I..\..\IPlug /I..\..\IGraphics /I..\..\WDL /I..\..\Dependencies\IGraphics\NanoSVG\src /I..\..\Dependencies\IGraphics\NanoVG\src MakeResourcePack.cpp
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#define NANOSVG_IMPLEMENTATION
+#include "IGraphicsResourcePack.h"
+
+using namespace iplug;
+using namespace igraphics;
+
+static void PrintUsage()
+{
+  printf("Usage: MakeResourcePack [--units px] [--dpi 72] output.pack resources...\n");
+}
+
+/** Split a path into the file name IGraphics loads the resource with and its scale, e.g. "res/knob@2x.png" into "knob.png" and 2 */
+static void GetNameAndScale(const char* path, WDL_String& name, int& scale)
+{
+  const char* fileName = path;
+
+  for (const char* p = path; *p; p++)
+  {
+    if (*p == '/' || *p == '\\')
+      fileName = p + 1;
+  }
+
+  const char* ext = strrchr(fileName, '.');
+  const char* at = strrchr(fileName, '@');
+  scale = 1;
+
+  if (ext && at && at < ext && ext[-1] == 'x' && atoi(at + 1) > 0)
+  {
+    scale = atoi(at + 1);
+    name.Set(fileName, static_cast<int>(at - fileName));
+    name.Append(ext);
+  }
+  else
+    name.Set(fileName);
+}
+
+int main(int argc, char* argv[])
+{
+  const char* units = "px";
+  float dpi = 72.f;
+  int arg = 1;
+
+  for (; arg < argc && !strncmp(argv[arg], "--", 2); arg++)
+  {
+    if (!strcmp(argv[arg], "--units") && arg + 1 < argc)
+      units = argv[++arg];
+    else if (!strcmp(argv[arg], "--dpi") && arg + 1 < argc)
+      dpi = static_cast<float>(atof(argv[++arg]));
+    else
+    {
+      PrintUsage();
+      return !strcmp(argv[arg], "--help") ? 0 : 1;
+    }
+  }
+
+  if (argc - arg < 2)
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  const char* outputPath = argv[arg++];
+  IResourcePack::Writer writer;
+
+  // the same settings as IGraphicsNanoVG, so that the pixels match what the backends decode themselves
+  stbi_set_unpremultiply_on_load(1);
+  stbi_convert_iphone_png_to_rgb(1);
+
+  for (; arg < argc; arg++)
+  {
+    const char* path = argv[arg];
+    const char* ext = strrchr(path, '.');
+    WDL_String name;
+    int scale;
+    GetNameAndScale(path, name, scale);
+
+    if (ext && (!strcmp(ext, ".svg") || !strcmp(ext, ".SVG")))
+    {
+      NSVGimage* pImage = nsvgParseFromFile(path, units, dpi);
+
+      if (!pImage)
+      {
+        fprintf(stderr, "Could not parse %s\n", path);
+        return 1;
+      }
+
+      writer.AddSVG(name.Get(), pImage, units, dpi);
+      printf("%s: SVG %gx%g\n", name.Get(), pImage->width, pImage->height);
+      nsvgDelete(pImage);
+    }
+    else
+    {
+      int width = 0, height = 0, nChannels = 0;
+      unsigned char* pPixels = stbi_load(path, &width, &height, &nChannels, 4);
+
+      if (!pPixels)
+      {
+        fprintf(stderr, "Could not decode %s\n", path);
+        return 1;
+      }
+
+      writer.AddBitmap(name.Get(), scale, width, height, pPixels);
+      stbi_image_free(pPixels);
+      printf("%s: %ix%i @%ix\n", name.Get(), width, height, scale);
+    }
+  }
+
+  IByteChunk chunk;
+  writer.Write(chunk);
+
+  FILE* pFile = fopen(outputPath, "wb");
+
+  if (!pFile || fwrite(chunk.GetData(), 1, chunk.Size(), pFile) != static_cast<size_t>(chunk.Size()))
+  {
+    fprintf(stderr, "Could not write %s\n", outputPath);
+
+    if (pFile)
+      fclose(pFile);
+
+    return 1;
+  }
+
+  fclose(pFile);
+  printf("Wrote %s, %i bytes\n", outputPath, chunk.Size());
+
+  return 0;
+}
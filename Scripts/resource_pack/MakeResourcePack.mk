@@ -0,0 +1,30 @@
+# Builds the resource pack tool, see MakeResourcePack.cpp and IGraphics/IGraphicsResourcePack.h
+# Build with: make -f MakeResourcePack.mk, then run ./build-pack/MakeResourcePack output.pack resources...
+
+IPLUG2_ROOT = ../..
+WDL_PATH = $(IPLUG2_ROOT)/WDL
+IPLUG_PATH = $(IPLUG2_ROOT)/IPlug
+IGRAPHICS_PATH = $(IPLUG2_ROOT)/IGraphics
+DEPS_PATH = $(IPLUG2_ROOT)/Dependencies/IGraphics
+
+CXX ?= c++
+
+INCLUDE_PATHS = -I$(WDL_PATH) \
+-I$(IPLUG_PATH) \
+-I$(IGRAPHICS_PATH) \
+-I$(DEPS_PATH)/NanoSVG/src \
+-I$(DEPS_PATH)/NanoVG/src
+
+SRC = MakeResourcePack.cpp
+
+CFLAGS = $(INCLUDE_PATHS) \
+-std=c++14 \
+-O2 \
+-DNDEBUG \
+-Wno-multichar
+
+TARGET = build-pack/MakeResourcePack
+
+$(TARGET): $(SRC) $(IGRAPHICS_PATH)/IGraphicsResourcePack.h
+	mkdir -p $(dir $@)
+	$(CXX) $(CFLAGS) $(EXTRA_CFLAGS) -o $@ $(SRC) $(LDFLAGS)
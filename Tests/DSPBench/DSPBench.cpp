@@ -0,0 +1,600 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line microbenchmarks for the DSP classes in IPlug/Extras. Each case is run at several block sizes, channel counts
+ * and sample types, and reported in nanoseconds per sample per channel. Results can be saved as CSV and compared against a
+ * previous run, in which case the exit code is non-zero if any case got slower than the tolerance. Run with --help for the options.
+ * Build with make -f DSPBench.mk, or on Windows: cl /O2 /EHsc /DNDEBUG /I..\..\IPlug /I..\..\IPlug\Extras /I..\..\IPlug\Extras\Synth /I..\..\WDL DSPBench.cpp ..\..\IPlug\Extras\Synth\VoiceAllocator.cpp
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ADSREnvelope.h"
+#include "NChanDelay.h"
+#include "Oscillator.h"
+#include "Oversampler.h"
+#include "Smoothers.h"
+#include "SVF.h"
+#include "WavetableOscillator.h"
+#include "VoiceAllocator.h"
+
+using namespace iplug;
+
+static constexpr double kSampleRate = 48000.;
+static constexpr int kMaxBlockSize = 1024;
+
+#pragma mark - Cases
+
+/** One benchmark case, set up for a given block size */
+class BenchCase
+{
+public:
+  virtual ~BenchCase() {}
+
+  /** Process one block of nFrames, no more than the block size the case was made with */
+  virtual void Process(int nFrames) = 0;
+
+  /** @return A value that depends on the output, so that the processing can't be optimised away */
+  virtual double GetOutput() const = 0;
+};
+
+/** A case that processes nChans channels of noise */
+template<typename T>
+class BufferedCase : public BenchCase
+{
+public:
+  BufferedCase(int blockSize, int nChans)
+  : mNChans(nChans)
+  , mInputData(blockSize * nChans)
+  , mOutputData(blockSize * nChans)
+  {
+    uint32_t seed = 1;
+
+    for (auto& s : mInputData)
+    {
+      seed = seed * 1664525u + 1013904223u;
+      s = static_cast<T>(seed >> 8) / static_cast<T>(1 << 24) * T(2) - T(1);
+    }
+
+    for (auto c = 0; c < nChans; c++)
+    {
+      mInputs.push_back(mInputData.data() + c * blockSize);
+      mOutputs.push_back(mOutputData.data() + c * blockSize);
+    }
+  }
+
+  double GetOutput() const override
+  {
+    double sum = 0.;
+
+    for (auto c = 0; c < mNChans; c++)
+      sum += mOutputs[c][0];
+
+    return sum;
+  }
+
+protected:
+  int mNChans;
+  std::vector<T> mInputData;
+  std::vector<T> mOutputData;
+  std::vector<T*> mInputs;
+  std::vector<T*> mOutputs;
+};
+
+template<typename T, int NC>
+class SVFCase : public BufferedCase<T>
+{
+public:
+  SVFCase(int blockSize)
+  : BufferedCase<T>(blockSize, NC)
+  {
+    mFilter.SetSampleRate(kSampleRate);
+    mFilter.SetQ(2.);
+  }
+
+  void Process(int nFrames) override { mFilter.ProcessBlock(this->mInputs.data(), this->mOutputs.data(), NC, nFrames); }
+
+private:
+  SVF<T, NC> mFilter {SVF<T, NC>::kLowPass, 1000.};
+};
+
+template<typename T>
+class OverSamplerCase : public BufferedCase<T>
+{
+public:
+  OverSamplerCase(int blockSize, int nChans, EFactor factor)
+  : BufferedCase<T>(blockSize, nChans)
+  , mOverSampler(factor, true, nChans)
+  {
+    mOverSampler.Reset(blockSize);
+
+    // only captures this, so std::function doesn't allocate
+    mFunc = [this](T** inputs, T** outputs, int nFrames) {
+      for (auto c = 0; c < this->mNChans; c++)
+        std::copy(inputs[c], inputs[c] + nFrames, outputs[c]);
+    };
+  }
+
+  void Process(int nFrames) override { mOverSampler.ProcessBlock(this->mInputs.data(), this->mOutputs.data(), nFrames, this->mNChans, mFunc); }
+
+private:
+  OverSampler<T> mOverSampler;
+  typename OverSampler<T>::BlockProcessFunc mFunc;
+};
+
+/** Retriggers the envelope every 100 ms, releasing it half way, so that every stage is measured */
+template<typename T>
+class ADSREnvelopeCase : public BufferedCase<T>
+{
+public:
+  ADSREnvelopeCase(int blockSize, bool perSample)
+  : BufferedCase<T>(blockSize, 1)
+  , mPerSample(perSample)
+  {
+    mEnv.SetSampleRate(static_cast<T>(kSampleRate));
+    mEnv.SetStageTime(ADSREnvelope<T>::kAttack, 5.);
+    mEnv.SetStageTime(ADSREnvelope<T>::kDecay, 20.);
+    mEnv.SetStageTime(ADSREnvelope<T>::kRelease, 30.);
+  }
+
+  void Process(int nFrames) override
+  {
+    const int cycleLength = static_cast<int>(kSampleRate / 10.);
+
+    if (mPos >= cycleLength)
+    {
+      mEnv.Start(1.);
+      mPos = 0;
+    }
+    else if (mPos >= cycleLength / 2 && mEnv.GetBusy() && !mReleased)
+    {
+      mEnv.Release();
+      mReleased = true;
+    }
+
+    if (mPos == 0)
+      mReleased = false;
+
+    T* pOutput = this->mOutputs[0];
+
+    if (mPerSample)
+    {
+      for (auto s = 0; s < nFrames; s++)
+        pOutput[s] = mEnv.Process(T(0.5));
+    }
+    else
+      mEnv.ProcessBlock(pOutput, nFrames, T(0.5));
+
+    mPos += nFrames;
+  }
+
+private:
+  ADSREnvelope<T> mEnv {"bench", nullptr, true};
+  bool mPerSample;
+  bool mReleased = false;
+  int mPos = INT_MAX;
+};
+
+/** Alternates the smoother's targets every block, so it never settles */
+template<typename T, int NC>
+class LogParamSmoothCase : public BufferedCase<T>
+{
+public:
+  LogParamSmoothCase(int blockSize)
+  : BufferedCase<T>(blockSize, NC)
+  {
+    mSmoother.SetSmoothTime(5., kSampleRate);
+  }
+
+  void Process(int nFrames) override
+  {
+    T targets[NC];
+
+    for (auto c = 0; c < NC; c++)
+      targets[c] = mHigh ? T(1) : T(0.1) * c;
+
+    mHigh = !mHigh;
+    mSmoother.ProcessBlock(targets, this->mOutputs.data(), nFrames);
+  }
+
+private:
+  LogParamSmooth<T, NC> mSmoother;
+  bool mHigh = true;
+};
+
+template<typename T, class OscType>
+class OscillatorCase : public BufferedCase<T>
+{
+public:
+  OscillatorCase(int blockSize)
+  : BufferedCase<T>(blockSize, 1)
+  {
+    mOsc.SetSampleRate(kSampleRate);
+    mOsc.SetFreqCPS(440.);
+  }
+
+  void Process(int nFrames) override { mOsc.ProcessBlock(this->mOutputs[0], nFrames); }
+
+private:
+  OscType mOsc;
+};
+
+template<typename T>
+class NChanDelayLineCase : public BufferedCase<T>
+{
+public:
+  NChanDelayLineCase(int blockSize, int nChans)
+  : BufferedCase<T>(blockSize, nChans)
+  , mDelayLine(nChans, nChans)
+  {
+    mDelayLine.SetDelayTime(static_cast<int>(kSampleRate / 10.));
+  }
+
+  void Process(int nFrames) override { mDelayLine.ProcessBlock(this->mInputs.data(), this->mOutputs.data(), nFrames); }
+
+private:
+  NChanDelayLine<T> mDelayLine;
+};
+
+/** A voice that only tracks its gate, so that the case measures the allocator rather than the voices */
+class BenchVoice : public SynthVoice
+{
+public:
+  bool GetBusy() const override { return mBusy; }
+  void Trigger(double level, bool isRetrigger) override { mBusy = true; }
+  void Release() override { mBusy = false; }
+
+  void ProcessSamplesAccumulating(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIdx, int nFrames) override
+  {
+    for (auto c = 0; c < nOutputs; c++)
+      outputs[c][startIdx] += 1.;
+  }
+
+private:
+  bool mBusy = false;
+};
+
+/** Plays a new note and pitch bends every block, with 8 notes held out of 32 voices */
+class VoiceAllocatorCase : public BufferedCase<sample>
+{
+public:
+  static constexpr int kNVoices = 32;
+  static constexpr int kNHeldNotes = 8;
+
+  VoiceAllocatorCase(int blockSize)
+  : BufferedCase<sample>(blockSize, 2)
+  , mVoices(kNVoices)
+  {
+    mAllocator.SetSampleRate(kSampleRate);
+
+    for (auto& voice : mVoices)
+      mAllocator.AddVoice(&voice, 0);
+  }
+
+  void Process(int nFrames) override
+  {
+    const uint8_t key = static_cast<uint8_t>(36 + mNoteCount % 48);
+    const uint8_t offKey = static_cast<uint8_t>(36 + (mNoteCount + 48 - kNHeldNotes) % 48);
+
+    mAllocator.AddEvent({{0, 0, offKey, 0}, kNoteOffAction, 0, 0.f, 0});
+    mAllocator.AddEvent({{0, 0, key, 0}, kNoteOnAction, 0, 0.8f, 0});
+    mAllocator.AddEvent({{0, kAllChannels, kAllKeys, 0}, kPitchBendAction, 0, (mNoteCount % 16) / 16.f, nFrames / 2});
+    mNoteCount++;
+
+    for (auto c = 0; c < mNChans; c++)
+      std::fill(mOutputs[c], mOutputs[c] + nFrames, 0.);
+
+    mAllocator.ProcessEvents(nFrames, mSampleTime);
+    mAllocator.ProcessVoices(nullptr, mOutputs.data(), 0, mNChans, 0, nFrames);
+    mSampleTime += nFrames;
+  }
+
+private:
+  std::vector<BenchVoice> mVoices;
+  VoiceAllocator mAllocator;
+  int mNoteCount = 0;
+  int64_t mSampleTime = 0;
+};
+
+#pragma mark - Registry
+
+struct CaseInfo
+{
+  std::string name;
+  const char* type;
+  int nChans;
+  std::function<BenchCase*(int blockSize)> make;
+};
+
+template<typename T>
+static const char* TypeName() { return sizeof(T) == sizeof(float) ? "float" : "double"; }
+
+template<typename T, int NC>
+static void AddFixedChannelCases(std::vector<CaseInfo>& cases)
+{
+  cases.push_back({"SVF lowpass", TypeName<T>(), NC, [](int bs) { return new SVFCase<T, NC>(bs); }});
+  cases.push_back({"LogParamSmooth", TypeName<T>(), NC, [](int bs) { return new LogParamSmoothCase<T, NC>(bs); }});
+
+  const struct { const char* name; EFactor factor; } factors[] = {{"OverSampler 2x", k2x}, {"OverSampler 4x", k4x}, {"OverSampler 16x", k16x}};
+
+  for (const auto& f : factors)
+  {
+    const EFactor factor = f.factor;
+    cases.push_back({f.name, TypeName<T>(), NC, [factor](int bs) { return new OverSamplerCase<T>(bs, NC, factor); }});
+  }
+
+  cases.push_back({"NChanDelayLine", TypeName<T>(), NC, [](int bs) { return new NChanDelayLineCase<T>(bs, NC); }});
+}
+
+template<typename T>
+static void AddCases(std::vector<CaseInfo>& cases)
+{
+  AddFixedChannelCases<T, 1>(cases);
+  AddFixedChannelCases<T, 2>(cases);
+  AddFixedChannelCases<T, 8>(cases);
+
+  cases.push_back({"ADSREnvelope block", TypeName<T>(), 1, [](int bs) { return new ADSREnvelopeCase<T>(bs, false); }});
+  cases.push_back({"ADSREnvelope sample", TypeName<T>(), 1, [](int bs) { return new ADSREnvelopeCase<T>(bs, true); }});
+  cases.push_back({"SinOscillator", TypeName<T>(), 1, [](int bs) { return new OscillatorCase<T, SinOscillator<T>>(bs); }});
+  cases.push_back({"FastSinOscillator", TypeName<T>(), 1, [](int bs) { return new OscillatorCase<T, FastSinOscillator<T>>(bs); }});
+  cases.push_back({"WavetableOscillator", TypeName<T>(), 1, [](int bs) { return new OscillatorCase<T, WavetableOscillator<T>>(bs); }});
+}
+
+#pragma mark - Running
+
+struct Result
+{
+  std::string name;
+  std::string type;
+  int blockSize;
+  int nChans;
+  double nsPerSample;
+};
+
+static volatile double sSink = 0.;
+
+/** @return The best of several rounds, in nanoseconds per sample per channel */
+static double RunCase(BenchCase& benchCase, int blockSize, int nChans, double seconds)
+{
+  using clock = std::chrono::steady_clock;
+  const int kNRounds = 5;
+
+  // warm up caches and branch predictors, and get the envelope/smoothers into their steady state
+  for (auto i = 0; i < std::max(1, 8192 / blockSize); i++)
+    benchCase.Process(blockSize);
+
+  double best = 1e300;
+
+  for (auto round = 0; round < kNRounds; round++)
+  {
+    const auto start = clock::now();
+    const auto end = start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds / kNRounds));
+    int64_t nBlocks = 0;
+    auto now = start;
+
+    do
+    {
+      // checking the clock every block would dominate the smallest cases
+      for (auto i = 0; i < 16; i++)
+        benchCase.Process(blockSize);
+
+      nBlocks += 16;
+      now = clock::now();
+    } while (now < end);
+
+    const double elapsed = std::chrono::duration<double, std::nano>(now - start).count();
+    best = std::min(best, elapsed / (static_cast<double>(nBlocks) * blockSize * nChans));
+    sSink = sSink + benchCase.GetOutput();
+  }
+
+  return best;
+}
+
+static std::vector<Result> ReadCSV(const char* path)
+{
+  std::vector<Result> results;
+  FILE* pFile = fopen(path, "r");
+
+  if (!pFile)
+    return results;
+
+  char line[512];
+
+  while (fgets(line, sizeof(line), pFile))
+  {
+    char name[256], type[32];
+    Result r;
+
+    if (sscanf(line, "%255[^,],%31[^,],%d,%d,%lf", name, type, &r.blockSize, &r.nChans, &r.nsPerSample) == 5)
+    {
+      r.name = name;
+      r.type = type;
+      results.push_back(r);
+    }
+  }
+
+  fclose(pFile);
+  return results;
+}
+
+static bool WriteCSV(const char* path, const std::vector<Result>& results)
+{
+  FILE* pFile = fopen(path, "w");
+
+  if (!pFile)
+    return false;
+
+  fprintf(pFile, "case,type,block size,channels,ns per sample\n");
+
+  for (const auto& r : results)
+    fprintf(pFile, "%s,%s,%d,%d,%.4f\n", r.name.c_str(), r.type.c_str(), r.blockSize, r.nChans, r.nsPerSample);
+
+  fclose(pFile);
+  return true;
+}
+
+static void PrintUsage(const char* exe)
+{
+  printf("Usage: %s [options]\n"
+         "  --filter <text>      only run cases whose name contains text, e.g. SVF\n"
+         "  --type <float|double> only run one sample type\n"
+         "  --bs <frames>        only run one block size (default 16, 64, 256 and 1024)\n"
+         "  --seconds <s>        time spent measuring each case (default 0.1)\n"
+         "  --csv <file>         write the results as CSV\n"
+         "  --baseline <file>    compare with the CSV from a previous run, exit with 1 if a case is slower\n"
+         "  --tolerance <pct>    how much slower than the baseline a case may be (default 10)\n"
+         "  --list               list the cases without running them\n", exe);
+}
+
+int main(int argc, char* argv[])
+{
+  const char* filter = nullptr;
+  const char* type = nullptr;
+  const char* csvPath = nullptr;
+  const char* baselinePath = nullptr;
+  std::vector<int> blockSizes = {16, 64, 256, 1024};
+  double seconds = 0.1;
+  double tolerance = 10.;
+  bool list = false;
+
+  for (auto i = 1; i < argc; i++)
+  {
+    const char* arg = argv[i];
+    const char* val = i + 1 < argc ? argv[i + 1] : nullptr;
+
+    if (!strcmp(arg, "--help") || !strcmp(arg, "-h"))
+    {
+      PrintUsage(argv[0]);
+      return 0;
+    }
+
+    if (!strcmp(arg, "--list"))
+    {
+      list = true;
+      continue;
+    }
+
+    if (!val)
+    {
+      fprintf(stderr, "Missing value for %s\n", arg);
+      PrintUsage(argv[0]);
+      return 1;
+    }
+
+    i++;
+
+    if (!strcmp(arg, "--filter")) filter = val;
+    else if (!strcmp(arg, "--type")) type = val;
+    else if (!strcmp(arg, "--bs")) blockSizes = {atoi(val)};
+    else if (!strcmp(arg, "--seconds")) seconds = atof(val);
+    else if (!strcmp(arg, "--csv")) csvPath = val;
+    else if (!strcmp(arg, "--baseline")) baselinePath = val;
+    else if (!strcmp(arg, "--tolerance")) tolerance = atof(val);
+    else
+    {
+      fprintf(stderr, "Unknown option %s\n", arg);
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (blockSizes[0] <= 0 || blockSizes[0] > kMaxBlockSize || seconds <= 0.)
+  {
+    fprintf(stderr, "The block size must be between 1 and %d, and the time positive\n", kMaxBlockSize);
+    return 1;
+  }
+
+  std::vector<CaseInfo> cases;
+  AddCases<float>(cases);
+  AddCases<double>(cases);
+  cases.push_back({"VoiceAllocator", TypeName<sample>(), 2, [](int bs) { return new VoiceAllocatorCase(bs); }});
+
+  cases.erase(std::remove_if(cases.begin(), cases.end(), [&](const CaseInfo& c) {
+    return (filter && c.name.find(filter) == std::string::npos) || (type && strcmp(c.type, type));
+  }), cases.end());
+
+  if (list)
+  {
+    for (const auto& c : cases)
+      printf("%s (%s, %d ch)\n", c.name.c_str(), c.type, c.nChans);
+
+    return 0;
+  }
+
+  std::vector<Result> baseline;
+
+  if (baselinePath)
+  {
+    baseline = ReadCSV(baselinePath);
+
+    if (baseline.empty())
+    {
+      fprintf(stderr, "Could not read a baseline from %s\n", baselinePath);
+      return 1;
+    }
+  }
+
+  std::vector<Result> results;
+  int nRegressions = 0;
+
+  printf("%-22s %-7s %6s %4s %12s%s\n", "case", "type", "block", "ch", "ns/sample/ch", baselinePath ? "   vs baseline" : "");
+
+  for (const auto& c : cases)
+  {
+    for (auto blockSize : blockSizes)
+    {
+      std::unique_ptr<BenchCase> pCase(c.make(blockSize));
+      const Result r {c.name, c.type, blockSize, c.nChans, RunCase(*pCase, blockSize, c.nChans, seconds)};
+      results.push_back(r);
+
+      printf("%-22s %-7s %6d %4d %12.3f", r.name.c_str(), r.type.c_str(), r.blockSize, r.nChans, r.nsPerSample);
+
+      auto base = std::find_if(baseline.begin(), baseline.end(), [&r](const Result& b) {
+        return b.name == r.name && b.type == r.type && b.blockSize == r.blockSize && b.nChans == r.nChans;
+      });
+
+      if (base != baseline.end() && base->nsPerSample > 0.)
+      {
+        const double change = (r.nsPerSample / base->nsPerSample - 1.) * 100.;
+        const bool regressed = change > tolerance;
+        nRegressions += regressed;
+        printf("   %+7.1f%%%s", change, regressed ? "  SLOWER" : "");
+      }
+
+      printf("\n");
+      fflush(stdout);
+    }
+  }
+
+  if (csvPath && !WriteCSV(csvPath, results))
+  {
+    fprintf(stderr, "Could not write %s\n", csvPath);
+    return 1;
+  }
+
+  if (nRegressions)
+  {
+    printf("%d case(s) more than %g%% slower than the baseline\n", nRegressions, tolerance);
+    return 1;
+  }
+
+  return 0;
+}
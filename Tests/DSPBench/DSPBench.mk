@@ -0,0 +1,34 @@
+# Builds the IPlug/Extras DSP microbenchmarks, see DSPBench.cpp
+# Build with: make -f DSPBench.mk, then run ./build-bench/DSPBench --help
+# Override CXX or add EXTRA_CFLAGS (e.g. EXTRA_CFLAGS=-march=native) to compare compilers and instruction sets
+
+IPLUG2_ROOT = ../..
+WDL_PATH = $(IPLUG2_ROOT)/WDL
+IPLUG_PATH = $(IPLUG2_ROOT)/IPlug
+IPLUG_EXTRAS_PATH = $(IPLUG_PATH)/Extras
+IPLUG_SYNTH_PATH = $(IPLUG_EXTRAS_PATH)/Synth
+
+CXX ?= c++
+
+INCLUDE_PATHS = -I$(WDL_PATH) \
+-I$(IPLUG_PATH) \
+-I$(IPLUG_EXTRAS_PATH) \
+-I$(IPLUG_SYNTH_PATH)
+
+SRC = DSPBench.cpp \
+	$(IPLUG_SYNTH_PATH)/VoiceAllocator.cpp
+
+# measure the same code as a release build of a plug-in
+CFLAGS = $(INCLUDE_PATHS) \
+-std=c++14 \
+-O3 \
+-DNDEBUG \
+-Wno-multichar
+
+LDFLAGS = -pthread
+
+TARGET = build-bench/DSPBench
+
+$(TARGET): $(SRC)
+	mkdir -p $(dir $@)
+	$(CXX) $(CFLAGS) $(EXTRA_CFLAGS) -o $@ $(SRC) $(LDFLAGS)
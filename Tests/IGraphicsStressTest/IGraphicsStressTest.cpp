@@ -1,3 +1,8 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <numeric>
+
 #include "IGraphicsStressTest.h"
 #include "IPlug_include_in_plug_src.h"
 
@@ -26,9 +31,9 @@ void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
     pGraphics->GetControlWithTag(kCtrlTagNumThings)->SetTargetAndDrawRECTs(bounds.GetGridCell(0, 2, 1));
     pGraphics->GetControlWithTag(kCtrlTagTestNum)->SetTargetAndDrawRECTs(bounds.GetGridCell(1, 2, 1));
     
-    auto bottomButtons = bounds.GetFromBRHC(400, 50).GetPadded(-10.);
-    for(int button=0;button<5;button++)
-      pGraphics->GetControlWithTag(kCtrlTagButton1 + button)->SetTargetAndDrawRECTs(bottomButtons.GetGridCell(button, 1, 5));
+    auto bottomButtons = bounds.GetFromBRHC(480, 50).GetPadded(-10.);
+    for(int button=0;button<6;button++)
+      pGraphics->GetControlWithTag(kCtrlTagButton1 + button)->SetTargetAndDrawRECTs(bottomButtons.GetGridCell(button, 1, 6));
     
     return;
   }
@@ -55,13 +60,14 @@ void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
     GetUI()->SetAllControlsDirty();
   };
   
-  pGraphics->SetKeyHandlerFunc([DoFunc](const IKeyPress& key, bool isUp)
+  pGraphics->SetKeyHandlerFunc([this, DoFunc](const IKeyPress& key, bool isUp)
   {
     if(!isUp) {
       switch (key.VK) {
         case kVK_UP: DoFunc(EFunc::More); return true;
         case kVK_DOWN: DoFunc(EFunc::Less); return true;
         case kVK_TAB: key.S ? DoFunc(EFunc::Prev) : DoFunc(EFunc::Next); return true;
+        case kVK_B: StartBenchmark(); return true;
         default: return false;
       }
     }
@@ -71,10 +77,12 @@ void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
   pGraphics->HandleMouseOver(false);
   pGraphics->LoadFont("Roboto-Regular", ROBOTO_FN);
   pGraphics->AttachPanelBackground(COLOR_GRAY);
-  pGraphics->AttachControl(new ILambdaControl(bounds, [&](ILambdaControl* pCaller, IGraphics& g, IRECT& r) {
+  mStressControl = pGraphics->AttachControl(new ILambdaControl(bounds, [&](ILambdaControl* pCaller, IGraphics& g, IRECT& r) {
     static IBitmap smiley = g.LoadBitmap(SMILEY_FN);
     static ISVG tiger = g.LoadSVG(TIGER_FN);
     
+    const auto frameStart = std::chrono::steady_clock::now();
+    
     if(mKindOfThing == 0)
       g.DrawText(IText(40), "Press tab to go to next test, up/down to change the # of things", r);
     
@@ -118,15 +126,23 @@ void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
     
     //      g.DrawLayer(pCaller->mLayer);
     
+    if (mBenchmarking)
+    {
+      const auto drawEnd = std::chrono::steady_clock::now();
+      const double drawMs = std::chrono::duration<double, std::milli>(drawEnd - frameStart).count();
+      const double frameMs = std::chrono::duration<double, std::milli>(frameStart - mLastFrameStart).count();
+      mLastFrameStart = frameStart;
+      OnBenchmarkFrame(drawMs, frameMs);
+    }
   }, 10000, false, false));
   
   pGraphics->AttachControl(new ITextControl(bounds.GetGridCell(0, 2, 1), "", IText(100)), kCtrlTagNumThings);
   pGraphics->AttachControl(new ITextControl(bounds.GetGridCell(1, 2, 1), "", IText(100)), kCtrlTagTestNum);
   
-  auto bottomButtons = bounds.GetFromBRHC(400, 50).GetPadded(-10.);
+  auto bottomButtons = bounds.GetFromBRHC(480, 50).GetPadded(-10.);
   int button = 0;
-  for (auto buttonLabel : {"Select test", "Next test", "Previous test", "NumThings++", "NumThings--"}) {
-    pGraphics->AttachControl(new IVButtonControl(bottomButtons.GetGridCell(button, 1, 5), [button, DoFunc, pGraphics](IControl* pCaller){
+  for (auto buttonLabel : {"Select test", "Next test", "Previous test", "NumThings++", "NumThings--", "Benchmark"}) {
+    pGraphics->AttachControl(new IVButtonControl(bottomButtons.GetGridCell(button, 1, 6), [this, button, DoFunc, pGraphics](IControl* pCaller){
       SplashClickActionFunc(pCaller);
       
       switch (button) {
@@ -143,6 +159,7 @@ void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
         case 2: DoFunc(EFunc::Prev); break;
         case 3: DoFunc(EFunc::More); break;
         case 4: DoFunc(EFunc::Less); break;
+        case 5: StartBenchmark(); break;
         default:
           break;
       }
@@ -151,5 +168,132 @@ void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
     button++;
   }
 
+  if (getenv("IGRAPHICS_BENCHMARK"))
+    StartBenchmark();
+}
+
+// the order of the tests in the switch statement in LayoutUI(), starting with 1
+static const char* kTestNames[] = {"DrawRect", "FillRect", "DrawRoundRect", "FillRoundRect", "DrawEllipse", "FillEllipse", "DrawArc", "FillArc", "DrawLine", "DrawDottedLine", "DrawFittedBitmap", "DrawSVG"};
+
+void IGraphicsStressTest::StartBenchmark()
+{
+  if (mBenchmarking || !mStressControl)
+    return;
+
+  IGraphics* pGraphics = mStressControl->GetUI();
+  mBenchmarking = true;
+  mKindOfThing = 1;
+  mBenchmarkCountIdx = 0;
+  mBenchmarkResults.Set("backend,test,count,frames,draw_mean_ms,draw_p50_ms,draw_p95_ms,draw_p99_ms,draw_max_ms,frame_mean_ms,frame_p95_ms,frame_max_ms\n");
+  mDrawTimes.reserve(kBenchmarkFrames);
+  mFrameTimes.reserve(kBenchmarkFrames);
+
+  pGraphics->GetControlWithTag(kCtrlTagNumThings)->Hide(true);
+  pGraphics->GetControlWithTag(kCtrlTagTestNum)->Hide(true);
+
+  // an animation function keeps the control dirty, so it's redrawn every frame
+  mStressControl->SetAnimation([](IControl*) {});
+
+  StartBenchmarkTest();
+}
+
+void IGraphicsStressTest::StartBenchmarkTest()
+{
+  mNumberOfThings = kBenchmarkCounts[mBenchmarkCountIdx];
+  mBenchmarkFrame = 0;
+  mDrawTimes.clear();
+  mFrameTimes.clear();
+  mLastFrameStart = std::chrono::steady_clock::now();
+  srand(1); // the same random rectangles and colours for every backend
+}
+
+void IGraphicsStressTest::OnBenchmarkFrame(double drawMs, double frameMs)
+{
+  if (mBenchmarkFrame++ >= kBenchmarkWarmupFrames)
+  {
+    mDrawTimes.push_back(drawMs);
+    mFrameTimes.push_back(frameMs);
+  }
+
+  if (mBenchmarkFrame < kBenchmarkWarmupFrames + kBenchmarkFrames)
+    return;
+
+  auto percentile = [](std::vector<double>& times, double p) {
+    std::sort(times.begin(), times.end());
+    return times[std::min(times.size() - 1, static_cast<size_t>(p / 100. * (times.size() - 1) + 0.5))];
+  };
+
+  auto mean = [](const std::vector<double>& times) {
+    return std::accumulate(times.begin(), times.end(), 0.) / times.size();
+  };
+
+  // percentile() sorts, so back() is the maximum after these
+  const double drawMean = mean(mDrawTimes), drawP50 = percentile(mDrawTimes, 50.), drawP95 = percentile(mDrawTimes, 95.), drawP99 = percentile(mDrawTimes, 99.);
+  const double frameMean = mean(mFrameTimes), frameP95 = percentile(mFrameTimes, 95.);
+
+  mBenchmarkResults.AppendFormatted(256, "%s,%s,%i,%i,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n",
+                                    mStressControl->GetUI()->GetDrawingAPIStr(), kTestNames[mKindOfThing - 1], mNumberOfThings, kBenchmarkFrames,
+                                    drawMean, drawP50, drawP95, drawP99, mDrawTimes.back(), frameMean, frameP95, mFrameTimes.back());
+
+  if (++mBenchmarkCountIdx >= static_cast<int>(kBenchmarkCounts.size()))
+  {
+    mBenchmarkCountIdx = 0;
+
+    if (++mKindOfThing > kNumTests)
+    {
+      FinishBenchmark();
+      return;
+    }
+  }
+
+  StartBenchmarkTest();
+}
+
+void IGraphicsStressTest::FinishBenchmark()
+{
+  IGraphics* pGraphics = mStressControl->GetUI();
+  mStressControl->SetAnimation(nullptr);
+  mBenchmarking = false;
+  mKindOfThing = 0;
+  mNumberOfThings = 16;
+
+  WDL_String path;
+
+  if (const char* csvPath = getenv("IGRAPHICS_BENCHMARK_CSV"))
+  {
+    path.Set(csvPath);
+  }
+  else
+  {
+#ifdef OS_WIN
+    const char* home = getenv("USERPROFILE");
+#else
+    const char* home = getenv("HOME");
+#endif
+    WDL_String backend(pGraphics->GetDrawingAPIStr());
+
+    for (char* c = backend.Get(); *c; c++)
+    {
+      if (!isalnum(static_cast<unsigned char>(*c)))
+        *c = '_';
+    }
+
+    path.SetFormatted(1024, "%s/IGraphicsStressTest-%s.csv", home ? home : ".", backend.Get());
+  }
+
+  if (FILE* pFile = fopen(path.Get(), "w"))
+  {
+    fputs(mBenchmarkResults.Get(), pFile);
+    fclose(pFile);
+    DBGMSG("Benchmark results written to %s\n", path.Get());
+  }
+  else
+  {
+    DBGMSG("Could not write benchmark results to %s\n", path.Get());
+  }
+
+  pGraphics->GetControlWithTag(kCtrlTagNumThings)->Hide(false);
+  pGraphics->GetControlWithTag(kCtrlTagTestNum)->Hide(false);
+  pGraphics->SetAllControlsDirty();
 }
 #endif
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <chrono>
+#include <vector>
+
 #include "IPlug_include_in_plug_hdr.h"
 
 enum EParam
@@ -16,7 +19,8 @@ enum EControlTags
   kCtrlTagButton2,
   kCtrlTagButton3,
   kCtrlTagButton4,
-  kCtrlTagButton5
+  kCtrlTagButton5,
+  kCtrlTagButton6
 };
 
 using namespace iplug;
@@ -28,8 +32,37 @@ public:
   IGraphicsStressTest(const InstanceInfo& info);
 #if IPLUG_EDITOR
   void LayoutUI(IGraphics* pGraphics) override;
+
+  /** Sweep every test across kBenchmarkCounts, drawing a fixed number of frames of each, then write frame time statistics to a CSV file.
+   * Starts when the UI opens if the IGRAPHICS_BENCHMARK environment variable is set, or with the "Benchmark" button or the B key.
+   * The file is IGRAPHICS_BENCHMARK_CSV if that is set, otherwise IGraphicsStressTest-<backend>.csv in the home folder */
+  void StartBenchmark();
+
+  /** Called at the end of each benchmark frame by the drawing control
+   * @param drawMs How long the test's drawing calls took on the CPU
+   * @param frameMs Time since the previous frame started, which includes presenting it and is limited by PLUG_FPS and vsync */
+  void OnBenchmarkFrame(double drawMs, double frameMs);
+
 public:
   int mNumberOfThings = 16;
   int mKindOfThing = 0;
+
+  static constexpr int kNumTests = 12;
+  static constexpr int kBenchmarkWarmupFrames = 10;
+  static constexpr int kBenchmarkFrames = 120;
+  const std::vector<int> kBenchmarkCounts {1, 16, 64, 256, 1024};
+
+  IControl* mStressControl = nullptr;
+  bool mBenchmarking = false;
+  int mBenchmarkCountIdx = 0;
+  int mBenchmarkFrame = 0;
+  std::chrono::steady_clock::time_point mLastFrameStart;
+  std::vector<double> mDrawTimes;
+  std::vector<double> mFrameTimes;
+  WDL_String mBenchmarkResults;
+
+private:
+  void StartBenchmarkTest();
+  void FinishBenchmark();
 #endif
 };
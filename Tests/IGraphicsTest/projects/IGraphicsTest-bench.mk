@@ -0,0 +1,17 @@
+# IPLUG2_ROOT should point to the top level IPLUG2 folder from the project folder
+# By default, that is three directories up from /Tests/IGraphicsTest/projects
+# Build with: make -f IGraphicsTest-bench.mk, then time the UI and check it against a reference image with
+# ../build-bench/IGraphicsTest-bench --ui-frames 1000 --ui-reference reference.pam
+IPLUG2_ROOT = ../../..
+
+BENCH_UI = 1
+
+include ../../../common-bench.mk
+
+SRC += $(PROJECT_ROOT)/IGraphicsTest.cpp
+
+TARGET = ../build-bench/IGraphicsTest-bench
+
+$(TARGET): $(SRC)
+	mkdir -p $(dir $@)
+	$(CXX) $(CFLAGS) $(EXTRA_CFLAGS) $(LDFLAGS) -o $@ $(SRC)
@@ -31,6 +31,10 @@
 #define ID_SHOW_DRAWN                   40026
 #define ID_SHOW_FPS                     40027
 #define ID_SHOW_BOUNDS                  40028
+#define ID_SHOW_DRAW_TIMES              40029
+#define IDC_STATIC_AUDIO_STATS          40030
+#define IDC_BUTTON_MEASURE_LATENCY      40031
+#define IDC_BUTTON_RESET_STATS          40032
 
 // Next default values for new objects
 //
@@ -0,0 +1,98 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Command line tests for MidiSynth's handling of MIDI. Each test prints PASS or FAIL, and the exit code is the number of failures.
+ * Build with make -f MidiSynthTest.mk
+ */
+
+#include <cstdio>
+#include <vector>
+
+#include "MidiSynth.h"
+
+using namespace iplug;
+
+namespace
+{
+
+// counts the triggers and releases it receives, and stays busy from one to the other
+class CountingVoice : public SynthVoice
+{
+public:
+  bool GetBusy() const override { return mBusy; }
+  void Trigger(double level, bool isRetrigger) override { mBusy = true; mNTriggers++; }
+  void Release() override { mBusy = false; mNReleases++; }
+
+  bool mBusy = false;
+  int mNTriggers = 0;
+  int mNReleases = 0;
+};
+
+int sNFailures = 0;
+
+void Check(bool passed, const char* name)
+{
+  printf("%s %s\n", passed ? "PASS" : "FAIL", name);
+
+  if (!passed)
+    sNFailures++;
+}
+
+void ProcessBlock(MidiSynth& synth, int nFrames)
+{
+  std::vector<sample> left(nFrames), right(nFrames);
+  sample* outputs[2] = {left.data(), right.data()};
+  synth.ProcessBlock(nullptr, outputs, 0, 2, nFrames);
+}
+
+// a block with more messages than the synth converts at once carries the rest over, and they must not be dropped. The event arena
+// holds a block's worth of messages, the MIDI queue is rounded up to a whole page, so a big enough block can queue more than fit
+void TestArenaOverflowKeepsNoteOff()
+{
+  const int blockSize = MidiSynth::kMinInputEvents + 64;
+  const int nControlChanges = blockSize;
+
+  MidiSynth synth(VoiceAllocator::kPolyModePoly);
+  CountingVoice voice;
+  synth.AddVoice(&voice, 0);
+  synth.SetSampleRateAndBlockSize(44100., blockSize);
+  voice.mNReleases = 0; // Reset() releases every voice
+
+  IMidiMsg noteOn, noteOff;
+  noteOn.MakeNoteOnMsg(60, 100, 0);
+  synth.AddMidiMsgToQueue(noteOn);
+
+  for (auto i = 0; i < nControlChanges; i++)
+  {
+    IMidiMsg cc;
+    cc.MakeControlChangeMsg(IMidiMsg::kModWheel, (i % 128) / 127., 10);
+    synth.AddMidiMsgToQueue(cc);
+  }
+
+  noteOff.MakeNoteOffMsg(60, 20);
+  synth.AddMidiMsgToQueue(noteOff);
+
+  ProcessBlock(synth, blockSize);
+  Check(voice.mNTriggers == 1 && voice.mNReleases == 0, "arena overflow: the note is on after the first block");
+
+  ProcessBlock(synth, blockSize);
+  Check(voice.mNReleases == 1 && !voice.GetBusy(), "arena overflow: the carried over note-off is delivered in the next block");
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  TestArenaOverflowKeepsNoteOff();
+
+  return sNFailures;
+}
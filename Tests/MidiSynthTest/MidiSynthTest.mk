@@ -0,0 +1,37 @@
+# Builds the MidiSynth command line tests, see MidiSynthTest.cpp
+# Build with: make -f MidiSynthTest.mk, then run ./build-test/MidiSynthTest
+
+IPLUG2_ROOT = ../..
+WDL_PATH = $(IPLUG2_ROOT)/WDL
+IPLUG_PATH = $(IPLUG2_ROOT)/IPlug
+IPLUG_EXTRAS_PATH = $(IPLUG_PATH)/Extras
+IPLUG_SYNTH_PATH = $(IPLUG_EXTRAS_PATH)/Synth
+
+CXX ?= c++
+
+INCLUDE_PATHS = -I$(WDL_PATH) \
+-I$(IPLUG_PATH) \
+-I$(IPLUG_EXTRAS_PATH) \
+-I$(IPLUG_SYNTH_PATH)
+
+SRC = MidiSynthTest.cpp \
+	$(IPLUG_SYNTH_PATH)/MidiSynth.cpp \
+	$(IPLUG_SYNTH_PATH)/VoiceAllocator.cpp
+
+CFLAGS = $(INCLUDE_PATHS) \
+-std=c++14 \
+-O1 \
+-include $(IPLUG_PATH)/IPlugPlatform.h \
+-Wno-multichar
+
+LDFLAGS = -pthread
+
+TARGET = build-test/MidiSynthTest
+
+$(TARGET): $(SRC)
+	mkdir -p $(dir $@)
+	$(CXX) $(CFLAGS) $(EXTRA_CFLAGS) -o $@ $(SRC) $(LDFLAGS)
+
+.PHONY: test
+test: $(TARGET)
+	./$(TARGET)
@@ -0,0 +1,86 @@
+# Builds the headless benchmark (BENCH_API), see IPlug/BENCH/IPlugBench_main.cpp
+# Include this from a project's -bench.mk after setting IPLUG2_ROOT, then add the plug-in sources to SRC
+# macOS only for now: IPlugTimer and IPlugPaths must be built for the host platform
+
+PROJECT_ROOT = $(PWD)/..
+WDL_PATH = $(IPLUG2_ROOT)/WDL
+IPLUG_PATH = $(IPLUG2_ROOT)/IPlug
+IPLUG_EXTRAS_PATH = $(IPLUG_PATH)/Extras
+IPLUG_SYNTH_PATH = $(IPLUG_EXTRAS_PATH)/Synth
+IPLUG_BENCH_PATH = $(IPLUG_PATH)/BENCH
+DEPS_PATH = $(IPLUG2_ROOT)/Dependencies
+IGRAPHICS_PATH = $(IPLUG2_ROOT)/IGraphics
+
+CXX ?= clang++
+
+IPLUG_SRC = $(IPLUG_PATH)/IPlugAPIBase.cpp \
+	$(IPLUG_PATH)/IPlugParameter.cpp \
+	$(IPLUG_PATH)/IPlugPluginBase.cpp \
+	$(IPLUG_PATH)/IPlugProcessor.cpp \
+	$(IPLUG_PATH)/IPlugTimer.cpp \
+	$(IPLUG_PATH)/IPlugPaths.mm
+
+BENCH_SRC = $(IPLUG_BENCH_PATH)/IPlugBench.cpp \
+	$(IPLUG_BENCH_PATH)/IPlugBench_main.cpp
+
+INCLUDE_PATHS = -I$(PROJECT_ROOT) \
+-I$(PROJECT_ROOT)/config \
+-I$(WDL_PATH) \
+-I$(IPLUG_PATH) \
+-I$(IPLUG_EXTRAS_PATH) \
+-I$(IPLUG_SYNTH_PATH) \
+-I$(IPLUG_BENCH_PATH) \
+-I$(IGRAPHICS_PATH) \
+-I$(IGRAPHICS_PATH)/Controls \
+-I$(IGRAPHICS_PATH)/Drawing \
+-I$(IGRAPHICS_PATH)/Platforms \
+-I$(DEPS_PATH)/IGraphics/NanoSVG/src
+
+SRC = $(IPLUG_SRC) $(BENCH_SRC)
+
+# the IGraphics paths are only there so that a plug-in's UI headers resolve, NO_IGRAPHICS and IPLUG_EDITOR=0 keep the UI code out
+
+# the benchmark should measure the same code as a release build of the plug-in
+CFLAGS = $(INCLUDE_PATHS) \
+-std=c++14 \
+-O3 \
+-DNDEBUG \
+-DBENCH_API \
+-DNO_IGRAPHICS \
+-DIPLUG_EDITOR=0 \
+-DIPLUG_DSP=1
+
+LDFLAGS = -framework CoreFoundation \
+-framework Foundation \
+-framework AppKit
+
+# make BENCH_UI=1 builds the plug-in's UI too, drawn by IGraphicsHeadless with Skia's raster backend, for the --ui options
+# It links the Skia library built by the dependency scripts
+ifeq ($(BENCH_UI),1)
+SKIA_PATH = $(DEPS_PATH)/Build/src/skia
+BUILT_LIBS_LIB_PATH = $(DEPS_PATH)/Build/mac/lib
+
+SRC += $(IGRAPHICS_PATH)/IGraphics.cpp \
+	$(IGRAPHICS_PATH)/IControl.cpp \
+	$(IGRAPHICS_PATH)/IGraphicsEditorDelegate.cpp \
+	$(IGRAPHICS_PATH)/Platforms/IGraphicsHeadless.cpp \
+	$(wildcard $(IGRAPHICS_PATH)/Controls/*.cpp)
+
+CFLAGS := $(filter-out -DNO_IGRAPHICS -DIPLUG_EDITOR=0,$(CFLAGS)) \
+-I$(DEPS_PATH)/IGraphics/STB \
+-I$(SKIA_PATH) \
+-I$(SKIA_PATH)/include/core \
+-I$(SKIA_PATH)/include/effects \
+-I$(SKIA_PATH)/include/config \
+-I$(SKIA_PATH)/include/utils \
+-I$(SKIA_PATH)/include/utils/mac \
+-I$(SKIA_PATH)/include/gpu \
+-DIPLUG_EDITOR=1 \
+-DIGRAPHICS_HEADLESS \
+-DIGRAPHICS_SKIA \
+-DIGRAPHICS_CPU
+
+LDFLAGS += $(BUILT_LIBS_LIB_PATH)/libskia.a \
+-framework CoreGraphics \
+-framework CoreText
+endif
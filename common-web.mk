@@ -77,13 +77,21 @@ WAM_CFLAGS = -DWAM_API \
 -DNO_IGRAPHICS \
 -DSAMPLE_TYPE_FLOAT
 
+# make WAM_SIMD=1 builds the processor with WebAssembly SIMD128, so that the lane loops in IPlug/Extras are vectorised
+# and the intrinsics in IPlugPeakRMS.h are used. makedist-web.sh builds it as -wam-simd.js next to the scalar -wam.js,
+# and the -awn.js script loads it in browsers that support SIMD
+ifeq ($(WAM_SIMD), 1)
+WAM_CFLAGS += -msimd128
+endif
+
 WEB_CFLAGS = -DWEB_API \
 -DIPLUG_EDITOR=1
 
 WAM_EXPORTS = "[\
   '_createModule','_wam_init','_wam_terminate','_wam_resize', \
   '_wam_onprocess', '_wam_onmidi', '_wam_onsysex', '_wam_onparam', \
-  '_wam_onmessageN', '_wam_onmessageS', '_wam_onmessageA', '_wam_onpatch' \
+  '_wam_onmessageN', '_wam_onmessageS', '_wam_onmessageA', '_wam_onpatch', \
+  '_iplug_wam_getmsgs', '_iplug_wam_getmsgssize', '_iplug_wam_clearmsgs' \
   ]"
 
 WEB_EXPORTS = "['_main', '_iplug_fsready', '_iplug_syncfs']"